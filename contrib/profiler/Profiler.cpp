@@ -24,6 +24,11 @@
 
 #include "Profiler.h"
 
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
 #if defined(USE_CHRONO)
 #undef __PROFILER_SMP__
 #include <atomic>
@@ -637,6 +642,22 @@ namespace Profiler {
 			FILE *mFile;
 		};
 
+		struct FormatJsonTop {
+			FormatJsonTop( FILE *f ) : mFile(f) {}
+			void operator()( Caller *item, bool islast ) const {
+				u64 selfticks = ( item->mTimer.ticks >= item->mChildTicks ) ? ( item->mTimer.ticks - item->mChildTicks ) : 0;
+				fputs( "{\"name\":\"", mFile );
+				for ( const char *c = item->mName; *c; c++ ) {
+					if ( *c == '"' || *c == '\\' )
+						fputc( '\\', mFile );
+					fputc( *c, mFile );
+				}
+				fprintf( mFile, "\",\"calls\":%u,\"ms\":%.4f,\"selfms\":%.4f}%s\n",
+					item->mTimer.calls, Timer::ms( item->mTimer.ticks ), Timer::ms( selfticks ), islast ? "" : "," );
+			}
+			FILE *mFile;
+		};
+
 		/*
 			Methods
 		*/
@@ -711,6 +732,11 @@ namespace Profiler {
 			return mTimer;
 		}
 
+		// valid once ComputeChildTicks has run
+		u64 GetSelfTicks() const {
+			return ( mTimer.ticks >= mChildTicks ) ? ( mTimer.ticks - mChildTicks ) : 0;
+		}
+
 		const char *GetName() const {
 			return mName;
 		}
@@ -1002,6 +1028,149 @@ namespace Profiler {
 	GlobalThreadList threads = { NULL, {0} };
 	threadlocal Caller *root = NULL;
 
+	/*
+	=============
+	Capture - the zones of every thread, and events from outside the
+	profiler, kept over many frames
+	=============
+	*/
+
+	struct CaptureEvent {
+		const char *name;
+		u32 track;
+		u64 begin, end; // Clock ticks
+		u64 id; // non-zero for async spans
+	};
+
+	struct CaptureTrack {
+		const void *key; // the thread state of a thread, or the name of an event track
+		const char *name;
+		// the zones still open at the last harvest, outermost first, and how
+		// many of them were carried over to the start of the zone buffer
+		std::vector<CaptureEvent> open;
+		u32 carried;
+	};
+
+	struct Capture {
+		std::atomic<bool> active{ false };
+		std::mutex lock;
+		u64 ringTicks = 0;
+		u64 startTicks = 0;
+		std::deque<CaptureEvent> events;
+		std::vector<CaptureTrack> tracks;
+
+		u32 FindTrack( const void *key, const char *name ) {
+			for ( u32 i = 0; i < tracks.size(); i++ )
+				if ( tracks[i].key == key )
+					return i;
+			tracks.push_back( { key, name, {}, 0 } );
+			return u32( tracks.size() - 1 );
+		}
+
+		// drop the events that ended before the ring; events from outside the
+		// profiler arrive late, so this is only roughly in order
+		void Trim() {
+			if ( !ringTicks )
+				return;
+			u64 now = Clock::getticks();
+			while ( !events.empty() && events.front().end + ringTicks < now )
+				events.pop_front();
+		}
+	} capture;
+
+	// Moves the zones a thread recorded since the last harvest into the
+	// capture, pairing them up into complete events. Called with the capture
+	// locked, and the thread if it is active.
+	void captureThread( Root &thread, u64 clockStart, f64 toClock ) {
+		u32 index = capture.FindTrack( thread.threadState, thread.root->GetName() );
+		CaptureTrack &track = capture.tracks[index];
+
+		// a thread that is gone can't be read any more
+		if ( !thread.root->IsActive() ) {
+			track.open.clear();
+			track.carried = 0;
+			return;
+		}
+
+		// the zones carried over from the last harvest are open already
+		Buffer<Zone> &zones = *thread.threadState->threadZones;
+		for ( u32 i = min( track.carried, zones.Size() ); i < zones.Size(); i++ ) {
+			const Zone &z = zones.Data()[i];
+			u64 at = clockStart + u64( z.time * toClock );
+			if ( z.type == ZoneEnter ) {
+				track.open.push_back( { z.str(), index, at, at, 0 } );
+			} else if ( !track.open.empty() ) {
+				CaptureEvent ev = track.open.back();
+				track.open.pop_back();
+				ev.end = at;
+				capture.events.push_back( ev );
+			}
+		}
+		track.carried = thread.threadState->activeZoneStack->Size();
+	}
+
+	// Exports the capture in Chrome Tracing format, each thread and event
+	// track on a row of its own
+	void writeCapture( const char *dir, const std::vector<CaptureEvent> &events, const std::vector<const char *> &tracks ) {
+		char timeFormat[256], fileFormat[4096];
+		time_t now;
+		time( &now );
+		strftime( timeFormat, 255, "%Y%m%d_%H%M%S", localtime( &now ) );
+		snprintf( fileFormat, 4096, "%s%s%s-capture-%s-chrome.json", dir ? dir : "", dir ? "/" : "", programName ? programName : "no-info-given", timeFormat );
+
+		FILE *f = fopen( fileFormat, "wb+" );
+		if ( !f )
+			return;
+
+		u64 base = events.empty() ? 0 : events[0].begin;
+		for ( const CaptureEvent &ev : events )
+			base = ( ev.begin < base ) ? ev.begin : base;
+
+		fprintf( f, "{\"traceEvents\":[\n" );
+		for ( u32 i = 0; i < tracks.size(); i++ )
+			fprintf( f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n", i, tracks[i] );
+
+		for ( const CaptureEvent &ev : events ) {
+			f64 at = Clock::ms( ev.begin - base ) * 1000.0, dur = Clock::ms( ev.end - ev.begin ) * 1000.0;
+			if ( !ev.id ) {
+				fprintf( f, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n",
+					ev.name, ev.track, at, dur );
+			} else {
+				fprintf( f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"b\",\"id\":" PRINTFU64() ",\"pid\":0,\"tid\":%u,\"ts\":%.3f},\n",
+					ev.name, tracks[ev.track], ev.id, ev.track, at );
+				fprintf( f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"e\",\"id\":" PRINTFU64() ",\"pid\":0,\"tid\":%u,\"ts\":%.3f},\n",
+					ev.name, tracks[ev.track], ev.id, ev.track, at + dur );
+			}
+		}
+
+		fprintf( f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"%s\"}}\n]}\n", programName ? programName : "unnamed" );
+		fclose( f );
+	}
+
+	void startCapture( f64 ringSeconds ) {
+		std::lock_guard<std::mutex> lock( capture.lock );
+		capture.ringTicks = ringSeconds > 0 ?
+			u64( std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<f64>( ringSeconds ) ).count() ) : 0;
+		capture.startTicks = Clock::getticks();
+		capture.events.clear();
+		capture.tracks.clear();
+		capture.active = true;
+	}
+
+	void stopCapture() {
+		std::lock_guard<std::mutex> lock( capture.lock );
+		capture.active = false;
+		capture.events.clear();
+		capture.tracks.clear();
+	}
+
+	void captureEvent( const char *track, const char *name, u64 begin, u64 end, u64 id ) {
+		if ( !capture.active )
+			return;
+		std::lock_guard<std::mutex> lock( capture.lock );
+		capture.events.push_back( { name, capture.FindTrack( track, track ), begin, end, id } );
+	}
+
 
 	/*
 		Thread Dumping
@@ -1208,6 +1377,40 @@ namespace Profiler {
 		u32 threadIndex;
 	};
 
+	// the accumulated totals of every function as a json array, for tools
+	struct TotalsDumper {
+		void Init(const char *file) {
+			f = fopen( file, "wb+" );
+			if ( f )
+				fputs( "[\n", f );
+		}
+
+		void GlobalInfo( u64, u64 ) {}
+		void ThreadsInfo( u64, f64, f64 ) {}
+		void PrintThread( Caller * ) {}
+
+		void PrintAccumulated( Caller *accumulated ) {
+			if ( !f )
+				return;
+			Buffer<Caller *> sorted;
+			accumulated->CopyToListNonEmpty( sorted );
+			sorted.Sort( Caller::compare::SelfTicks() );
+			sorted.ForEach( Caller::FormatJsonTop(f) );
+		}
+
+		void DumpZones( Buffer<Zone> *, u64, f64 ) {}
+
+		void Finish() {
+			if ( !f )
+				return;
+			fputs( "]\n", f );
+			fclose( f );
+		}
+
+	protected:
+		FILE *f;
+	};
+
 	struct PrintfDumper {
 		void Init(const char *dir) {
 		}
@@ -1365,6 +1568,36 @@ namespace Profiler {
 		char timeFormat[256], fileFormat[4096];
 	};
 
+	// the callers with the most self time, summed over the threads, into arrays;
+	// the dumper is copied, so the count is kept outside
+	struct TopDumper {
+		TopDumper( const char **names, f64 *selfms, u32 max, u32 *count ) :
+			mNames(names), mSelfMs(selfms), mMax(max), mCount(count) {}
+
+		void Init( const char * ) {}
+		void GlobalInfo( u64, u64 ) {}
+		void ThreadsInfo( u64, f64, f64 ) {}
+		void PrintThread( Caller * ) {}
+
+		void PrintAccumulated( Caller *accumulated ) {
+			Buffer<Caller *> sorted;
+			accumulated->CopyToListNonEmpty( sorted );
+			sorted.Sort( Caller::compare::SelfTicks() );
+			for ( ; *mCount < mMax && *mCount < sorted.Size(); ( *mCount )++ ) {
+				mNames[*mCount] = sorted[*mCount]->GetName();
+				mSelfMs[*mCount] = Timer::ms( sorted[*mCount]->GetSelfTicks() );
+			}
+		}
+
+		void DumpZones( Buffer<Zone> *, u64, f64 ) {}
+		void Finish() {}
+
+		const char **mNames;
+		f64 *mSelfMs;
+		u32 mMax;
+		u32 *mCount;
+	};
+
 	template< class Dumper >
 	void dumpThreads( Dumper dumper, const char *dir ) {
 		PROFILE_SCOPED()
@@ -1466,18 +1699,31 @@ namespace Profiler {
 	}
 
 	void resetThreads() {
+		// the zone times of the frame that ends here, converted to Clock ticks
+		u64 clockStart = globalClockStart;
+		u64 rawDuration = ( Timer::getticks() - globalStart );
+		f64 toClock = rawDuration ? f64( Clock::getticks() - globalClockStart ) / f64( rawDuration ) : 1.0;
+
 		globalStart = Timer::getticks();
 		globalClockStart = Clock::getticks();
 
 #if defined(__PROFILER_SMP__)
 		threads.AcquireGlobalLock();
 
+		std::unique_lock<std::mutex> captureLock( capture.lock, std::defer_lock );
+		if ( capture.active )
+			captureLock.lock();
+
 		Buffer<Root> &threadsref = *threads.list;
 		u32 cnt = threadsref.Size(), last = cnt - 1;
 		for ( u32 i = 0; i < cnt; i++ ) {
 			Root &thread = threadsref[i];
 			if ( !thread.root->IsActive() ) {
 				// thread isn't active, remove it
+#ifdef __PROFILER_WITH_ZONES__
+				if ( captureLock )
+					captureThread( thread, clockStart, toClock );
+#endif
 				delete thread.root;
 				Root removed = threadsref.Pop();
 				if ( i != last )
@@ -1493,6 +1739,10 @@ namespace Profiler {
 					iter->GetTimer().calls = 1;
 
 #ifdef __PROFILER_WITH_ZONES__
+				// the capture takes the zones before they are cleared
+				if ( captureLock )
+					captureThread( thread, clockStart, toClock );
+
 				// clear the list of thread zones and add the current active set of zones to the new buffer
 				thread.threadState->threadZones->Clear();
 				for (u32 i = 0; i < thread.threadState->activeZoneStack->Size(); i++) {
@@ -1506,6 +1756,11 @@ namespace Profiler {
 			}
 		}
 
+		if ( captureLock ) {
+			capture.Trim();
+			captureLock.unlock();
+		}
+
 		threads.ReleaseGlobalLock();
 #else
 		if ( root )
@@ -1513,6 +1768,53 @@ namespace Profiler {
 #endif
 	}
 
+	void dumpCapture( const char *dir ) {
+		PROFILE_SCOPED()
+		if ( !capture.active )
+			return;
+
+		std::vector<CaptureEvent> events;
+		std::vector<const char *> tracks;
+
+#ifdef __PROFILER_WITH_ZONES__
+		threads.AcquireGlobalLock();
+		{
+			std::lock_guard<std::mutex> lock( capture.lock );
+
+			// harvest the frame so far, and carry the zones still open over
+			// with their times; the profiler isn't reset here
+			u64 rawDuration = ( Timer::getticks() - globalStart );
+			f64 toClock = rawDuration ? f64( Clock::getticks() - globalClockStart ) / f64( rawDuration ) : 1.0;
+
+			Buffer<Root> &threadsref = *threads.list;
+			for ( u32 i = 0; i < threadsref.Size(); i++ ) {
+				Root &thread = threadsref[i];
+				bool active = ( thread.root->IsActive() );
+				if ( active )
+					thread.threadState->threadLock.Acquire();
+
+				captureThread( thread, globalClockStart, toClock );
+
+				if ( active ) {
+					Buffer<Zone> &zones = *thread.threadState->threadZones;
+					zones.Clear();
+					for ( u32 j = 0; j < thread.threadState->activeZoneStack->Size(); j++ )
+						zones.Push( thread.threadState->activeZoneStack->Data()[j] );
+					thread.threadState->threadLock.Release();
+				}
+			}
+
+			capture.Trim();
+			events.assign( capture.events.begin(), capture.events.end() );
+			for ( const CaptureTrack &track : capture.tracks )
+				tracks.push_back( track.name );
+		}
+		threads.ReleaseGlobalLock();
+#endif
+
+		writeCapture( dir, events, tracks );
+	}
+
 	void enterThread( const char *name ) {
 		Caller *tmp = new Caller( name );
 
@@ -1649,6 +1951,17 @@ namespace Profiler {
 	void dumptrace(const char *dir) { dumpThreads( TraceDumper(), dir ); }
 	void dumpzones(const char *dir) { dumpThreads( ZoneDumper(), dir ); }
 	void dumphtml(const char *dir) { dumpThreads( HTMLDumper(), dir ); }
+	void dumptotals(const char *file) { dumpThreads( TotalsDumper(), file ); }
+	u32 topcallers( const char **names, f64 *selfms, u32 max ) {
+		u32 count = 0;
+		dumpThreads( TopDumper( names, selfms, max, &count ), 0 );
+		return count;
+	}
+	void capturestart( f64 ringSeconds ) { startCapture( ringSeconds ); }
+	void capturestop() { stopCapture(); }
+	bool capturing() { return capture.active; }
+	void capturedump( const char *dir ) { dumpCapture( dir ); }
+	void captureevent( const char *track, const char *name, u64 begin, u64 end, u64 id ) { captureEvent( track, name, begin, end, id ); }
 	void fastcall enter( const char *name ) { enterCaller( name ); }
 	void fastcall exit() { exitCaller(); }
 	void fastcall pause() { pauseCaller(); }
@@ -1663,6 +1976,13 @@ namespace Profiler {
 	void dumptrace(const char *dir) {}
 	void dumpzones(const char *dir) {}
 	void dumphtml(const char *dir) {}
+	void dumptotals(const char *file) {}
+	u32 topcallers( const char **names, f64 *selfms, u32 max ) { return 0; }
+	void capturestart( f64 ringSeconds ) {}
+	void capturestop() {}
+	bool capturing() { return false; }
+	void capturedump( const char *dir ) {}
+	void captureevent( const char *track, const char *name, u64 begin, u64 end, u64 id ) {}
 	void fastcall enter( const char *name ) {}
 	void fastcall exit() {}
 	void fastcall pause() {}
@@ -255,6 +255,24 @@ namespace Profiler {
 	void dumptrace(const char *dir = 0);
 	void dumpzones(const char *dir = 0);
 	void dumphtml(const char *dir = 0);
+	// writes the accumulated totals to the file, rather than into a directory
+	void dumptotals(const char *file);
+	// the names and self times in ms of the functions that took the most time
+	// since the last reset, over every thread; returns how many were filled in
+	u32 topcallers( const char **names, f64 *selfms, u32 max );
+	// Trace capture: keeps the zones of every thread over many frames, past
+	// reset(), along with the events given to captureevent(), to be written
+	// as a Chrome trace. With ringSeconds > 0 only the last ringSeconds are
+	// kept, so a capture can run all the time and be dumped after a hitch.
+	void capturestart( f64 ringSeconds = 0 );
+	void capturestop();
+	bool capturing();
+	// writes what has been captured so far to the directory and goes on capturing
+	void capturedump( const char *dir = 0 );
+	// adds an event from outside the profiler, shown on its own track; begin
+	// and end are Clock ticks. Events with an id are async spans, which may
+	// overlap the others on their track. track and name must outlive the capture
+	void captureevent( const char *track, const char *name, u64 begin, u64 end, u64 id = 0 );
 	void fastcall enter( const char *name );
 	void fastcall exit();
 	void fastcall pause();
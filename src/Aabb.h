@@ -121,6 +121,7 @@ struct AABB {
 	auto Intersects(const AABB &rhs) const { return min < rhs.max && max > rhs.min; }
 };
 
+using AABBf = AABB<vector3f>;
 using AABBd = AABB<vector3d>;
 
 #endif /* _AABB_H */
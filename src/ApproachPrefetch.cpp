@@ -0,0 +1,178 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "ApproachPrefetch.h"
+
+#include "Frame.h"
+#include "Pi.h"
+#include "Planet.h"
+#include "Ship.h"
+#include "ShipAICmd.h"
+#include "Space.h"
+#include "SpaceStation.h"
+#include "core/Log.h"
+#include "graphics/Renderer.h"
+#include "graphics/Stats.h"
+#include "profiler/Profiler.h"
+#include "scenegraph/Model.h"
+
+#include <algorithm>
+
+double ApproachPrefetch::s_lookAheadTime = 60.0;
+Uint32 ApproachPrefetch::s_numHits = 0;
+Uint32 ApproachPrefetch::s_numMisses = 0;
+
+// the body the autopilot of the player is flying to, if any
+static const Body *GetAutopilotTarget(const Ship *player)
+{
+	const AICommand *cmd = player->GetAICommand();
+	if (!cmd)
+		return nullptr;
+	if (cmd->GetType() == AICommand::CMD_DOCK)
+		return static_cast<const AICmdDock *>(cmd)->GetTarget();
+	if (cmd->GetType() == AICommand::CMD_FLYTO)
+		return static_cast<const AICmdFlyTo *>(cmd)->GetTarget();
+	return nullptr;
+}
+
+ApproachPrefetch::ApproachPrefetch(Space *space) :
+	m_space(space),
+	m_started(false)
+{
+}
+
+double ApproachPrefetch::GetDetailDistance(const Body *body)
+{
+	if (body->IsType(ObjectType::PLANET))
+		return body->GetSystemBody()->GetRadius() * PLANET_DETAIL_RADII;
+	if (body->IsType(ObjectType::SPACESTATION))
+		return body->GetPhysRadius() * STATION_DETAIL_RADII;
+	return 0.0;
+}
+
+bool ApproachPrefetch::PredictApproach(const vector3d &pos, const vector3d &vel, double detailDist, double &arrival, vector3d &nearest)
+{
+	const double speedSqr = vel.LengthSqr();
+	if (speedSqr <= 0.0)
+		return false;
+
+	// the first time |pos + vel * t| = detailDist
+	const double b = pos.Dot(vel);
+	const double c = pos.LengthSqr() - detailDist * detailDist;
+	const double disc = b * b - speedSqr * c;
+	if (disc < 0.0)
+		return false;
+	arrival = (-b - sqrt(disc)) / speedSqr;
+	if (arrival < 0.0 || arrival > s_lookAheadTime)
+		return false;
+
+	const double closest = std::min(-b / speedSqr, s_lookAheadTime);
+	nearest = pos + vel * closest;
+	return true;
+}
+
+void ApproachPrefetch::Prefetch(Body *body, const vector3d &nearest, double distance)
+{
+	if (body->IsType(ObjectType::PLANET)) {
+		// not into the ground
+		TerrainBody *terrain = static_cast<TerrainBody *>(body);
+		const double minDist = terrain->GetMaxFeatureRadius();
+		terrain->PrefetchTerrain(nearest.LengthSqr() < minDist * minDist ? nearest.NormalizedSafe() * minDist : nearest);
+	} else if (body->IsType(ObjectType::SPACESTATION)) {
+		if (SceneGraph::Model *model = static_cast<SpaceStation *>(body)->GetModel())
+			model->RequestTextureDetail(float(std::max(distance, body->GetPhysRadius())));
+	}
+}
+
+void ApproachPrefetch::Update(Body *body, double time, bool isNear, bool prefetch)
+{
+	auto iter = m_approaches.find(body);
+	if (!isNear && !prefetch) {
+		// turned away, or left; another approach counts afresh
+		if (iter != m_approaches.end())
+			m_approaches.erase(iter);
+		return;
+	}
+	if (iter == m_approaches.end())
+		iter = m_approaches.emplace(body, Approach()).first;
+
+	Approach &approach = iter->second;
+	if (prefetch && approach.prefetchTime < 0.0)
+		approach.prefetchTime = time;
+
+	if (isNear && !approach.isNear && m_started) {
+		const double lead = approach.prefetchTime < 0.0 ? 0.0 : time - approach.prefetchTime;
+		if (lead >= MIN_LEAD_TIME) {
+			++s_numHits;
+			Log::Verbose("Approach prefetch hit for {}, {:.1f}s ahead\n", body->GetLabel(), lead);
+		} else {
+			++s_numMisses;
+			Log::Verbose("Approach prefetch miss for {}, {:.1f}s ahead\n", body->GetLabel(), lead);
+		}
+	}
+	approach.isNear = isNear;
+}
+
+void ApproachPrefetch::TimeStep(double time, const Ship *player)
+{
+	if (s_lookAheadTime <= 0.0 || !player)
+		return;
+
+	PROFILE_SCOPED()
+
+	// the autopilot gets there whichever way the player is moving now
+	const Body *target = GetAutopilotTarget(player);
+	const Body *targetPlanet = nullptr;
+	bool targetApproaching = false;
+	if (target && GetDetailDistance(target) > 0.0) {
+		const vector3d pos = player->GetPositionRelTo(target);
+		const double dist = pos.Length();
+		const double closing = dist > 0.0 ? -pos.Dot(player->GetVelocityRelTo(target)) / dist : 0.0;
+		targetApproaching = closing > 0.0 && (dist - GetDetailDistance(target)) < closing * s_lookAheadTime;
+
+		if (target->IsType(ObjectType::SPACESTATION) && static_cast<const SpaceStation *>(target)->IsGroundStation())
+			targetPlanet = Frame::GetFrame(target->GetFrame())->GetBody();
+	}
+
+	for (Body *body : m_space->GetBodies()) {
+		const double detailDist = GetDetailDistance(body);
+		if (detailDist <= 0.0)
+			continue;
+
+		const vector3d pos = player->GetPositionRelTo(body);
+		const bool isNear = pos.LengthSqr() < detailDist * detailDist;
+
+		double arrival;
+		vector3d nearest;
+		bool prefetch = !isNear && PredictApproach(pos, player->GetVelocityRelTo(body), detailDist, arrival, nearest);
+		if (!prefetch && !isNear && targetApproaching) {
+			if (body == target) {
+				prefetch = true;
+				nearest = pos.NormalizedSafe() * body->GetPhysRadius();
+			} else if (body == targetPlanet) {
+				// where the station is
+				prefetch = true;
+				nearest = target->GetPosition();
+			}
+		}
+
+		if (prefetch)
+			Prefetch(body, nearest, nearest.Length());
+		Update(body, time, isNear, prefetch);
+	}
+	m_started = true;
+
+	Graphics::Stats &stats = Pi::renderer->GetStats();
+	stats.SetStatCount(Graphics::Stats::STAT_APPROACH_PREFETCH_HITS, s_numHits);
+	stats.SetStatCount(Graphics::Stats::STAT_APPROACH_PREFETCH_MISSES, s_numMisses);
+}
+
+void ApproachPrefetch::NotifyRemoved(const std::vector<const Body *> &removedBodies)
+{
+	for (auto iter = m_approaches.begin(); iter != m_approaches.end();) {
+		if (std::binary_search(removedBodies.begin(), removedBodies.end(), iter->first))
+			iter = m_approaches.erase(iter);
+		else
+			++iter;
+	}
+}
@@ -0,0 +1,82 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _APPROACHPREFETCH_H
+#define _APPROACHPREFETCH_H
+
+#include "vector3.h"
+
+#include <SDL_stdinc.h>
+#include <unordered_map>
+#include <vector>
+
+class Body;
+class Ship;
+class Space;
+
+// Gets the detail of the planets and stations the player is flying towards
+// ready before it is drawn: the terrain patches on the way to where the
+// player will be nearest (see GeoSphere::SetApproachPoint), and the top
+// mips of the station textures at the distance it will be seen from. The
+// approach to a body is the player's straight line motion relative to it
+// over the look-ahead time; the target of the autopilot is taken to be
+// reached at the current closing speed, and for a ground station so is its
+// planet. Only bodies already loaded are looked at, the models of the
+// stations come with the Space.
+//
+// A body needs its detail once the player is within its detail distance.
+// Getting there is a hit if the body has been prefetched for at least
+// MIN_LEAD_TIME, and a miss otherwise; the totals are in the renderer's
+// stats, for tuning the look-ahead time.
+class ApproachPrefetch {
+public:
+	ApproachPrefetch(Space *space);
+
+	void TimeStep(double time, const Ship *player);
+	// the removed bodies are sorted
+	void NotifyRemoved(const std::vector<const Body *> &removedBodies);
+
+	// 0 turns prefetching off
+	static void SetLookAheadTime(double seconds) { s_lookAheadTime = seconds; }
+	static double GetLookAheadTime() { return s_lookAheadTime; }
+
+	static Uint32 GetNumHits() { return s_numHits; }
+	static Uint32 GetNumMisses() { return s_numMisses; }
+
+private:
+	// game seconds a prefetch must have been running to count as a hit
+	static constexpr double MIN_LEAD_TIME = 1.0;
+	// the distance from a planet within which its terrain needs detail,
+	// and from a station within which its textures do, in body radii
+	static constexpr double PLANET_DETAIL_RADII = 2.0;
+	static constexpr double STATION_DETAIL_RADII = 20.0;
+
+	struct Approach {
+		// game time the body was first prefetched on this approach, or
+		// negative if it wasn't
+		double prefetchTime = -1.0;
+		bool isNear = false;
+	};
+
+	// how far from a body the player has to be for its detail to be
+	// needed, or 0 if it doesn't have any to prefetch
+	static double GetDetailDistance(const Body *body);
+	// When the player at pos relative to body and moving at vel will be
+	// within detailDist of it, and where it will be nearest within the
+	// look-ahead time
+	static bool PredictApproach(const vector3d &pos, const vector3d &vel, double detailDist, double &arrival, vector3d &nearest);
+
+	void Prefetch(Body *body, const vector3d &nearest, double distance);
+	void Update(Body *body, double time, bool isNear, bool prefetch);
+
+	Space *m_space;
+	std::unordered_map<const Body *, Approach> m_approaches;
+	// bodies the player starts out near are not counted
+	bool m_started;
+
+	static double s_lookAheadTime;
+	static Uint32 s_numHits;
+	static Uint32 s_numMisses;
+};
+
+#endif /* _APPROACHPREFETCH_H */
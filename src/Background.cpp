@@ -42,6 +42,22 @@ namespace {
 	constexpr Uint32 NUM_HYPERSPACE_STARS = 8000;
 	static RefCountedPtr<Graphics::Texture> s_defaultCubeMap;
 
+	// What Random::Double(min, limit) makes of the number a
+	// Random::FillDouble(out, count) gave
+	inline double RandomInRange(double unit, double min, double limit)
+	{
+		return (limit - min) * unit + min;
+	}
+
+	// A point on the unit sphere, from two of Random::FillDouble's numbers;
+	// this is proper random distribution on a sphere's surface
+	inline vector3f RandomOnSphere(const double *unit)
+	{
+		const float theta = float(RandomInRange(unit[0], 0.0, 2.0 * M_PI));
+		const float u = float(RandomInRange(unit[1], -1.0, 1.0));
+		return vector3f(sqrt(1.0f - u * u) * cos(theta), u, sqrt(1.0f - u * u) * sin(theta));
+	}
+
 	static Uint32 GetNumSkyboxes()
 	{
 		char filename[1024];
@@ -439,11 +455,53 @@ namespace Background {
 		return spherical_segment_volume(h, r1_sq, r2_sq);
 	}
 
+	// The stars of a Fill while they are being picked and generated. Sampling
+	// the galaxy runs first, its median brightness is needed to size the
+	// stars, which then runs together with generating the random ones.
+	struct Starfield::PendingFill {
+		enum Stage {
+			SAMPLING,
+			SIZING,
+		};
+
+		PendingFill(Uint32 seed) :
+			rand(seed) {}
+
+		Stage stage;
+		SystemPath systemPath;
+		RefCountedPtr<Galaxy> galaxy;
+		StarQueryInfo info;
+		Uint32 numStars;
+		// for the random stars, they follow those picked from the galaxy
+		Random rand;
+		vector3f colorMin;
+		vector3f colorMax;
+
+		std::vector<StarInfo> taskStars;
+		std::vector<double> taskMedians;
+		StarInfo randomStars;
+		std::unique_ptr<TaskSet::Handle> handle;
+	};
+
+	Starfield::~Starfield()
+	{
+		CancelFill();
+	}
+
+	void Starfield::CancelFill()
+	{
+		if (m_pendingFill && m_pendingFill->handle)
+			Pi::GetApp()->GetTaskGraph()->WaitForTaskSet(*m_pendingFill->handle);
+		m_pendingFill.reset();
+	}
+
 	void Starfield::Fill(Random &rand, const SystemPath *const systemPath, RefCountedPtr<Galaxy> galaxy)
 	{
 		PROFILE_SCOPED()
 
+		CancelFill();
 		m_pointSprites.reset(new Graphics::Drawables::PointSprites);
+		m_animMesh.reset();
 
 		const Uint32 NUM_BG_STARS = MathUtil::mix(BG_STAR_MIN, BG_STAR_MAX, Pi::GetAmountBackgroundStars());
 		// user doesn't want to see stars
@@ -452,169 +510,216 @@ namespace Background {
 		const float brightnessApparentSizeFactor = Pi::GetStarFieldStarSizeFactor() / 7.0;
 		// dividing by 7 to make sure that 100% star size isn't too big to clash with UI elements
 
-		m_hyperVtx.reset(new vector3f[NUM_HYPERSPACE_STARS * 3]);
-		m_hyperCol.reset(new Color[NUM_HYPERSPACE_STARS * 3]);
+		m_pendingFill.reset(new PendingFill(rand.Int32()));
+		PendingFill &fill = *m_pendingFill;
+		fill.numStars = NUM_BG_STARS;
+		fill.colorMin = vector3f(m_rMin, m_gMin, m_bMin);
+		fill.colorMax = vector3f(m_rMax, m_gMax, m_bMax);
+
+		PROFILE_START_DESC("Fill Hyperspace Stars")
 		{
+			// a streak from each star outwards to twice as far; the animation
+			// moves all of them along the direction of flight
 			Graphics::VertexBufferDesc vbd = VertexBufferDesc::FromAttribSet(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE);
-			vbd.usage = Graphics::BUFFER_USAGE_DYNAMIC;
+			vbd.usage = Graphics::BUFFER_USAGE_STATIC;
 			vbd.numVertices = NUM_HYPERSPACE_STARS * 2;
 			// this vertex buffer will be owned by the animMesh object
 			Graphics::VertexBuffer *vtxBuffer = m_renderer->CreateVertexBuffer(vbd);
-			m_animMesh.reset(m_renderer->CreateMeshObject(vtxBuffer));
-		}
+			assert(sizeof(StarVert) == 16);
+			assert(vtxBuffer->GetDesc().stride == sizeof(StarVert));
 
-		assert(sizeof(StarVert) == 16);
+			std::vector<double> unit(NUM_HYPERSPACE_STARS * 2);
+			rand.FillDouble(unit.data(), unit.size());
 
-		StarInfo stars;
-		stars.pos.reserve(NUM_BG_STARS);
-		stars.color.reserve(NUM_BG_STARS);
-		stars.brightness.reserve(NUM_BG_STARS);
-
-		//fill the array
-		Uint32 num = 0;
-		if (systemPath && galaxy.Valid()) {
-			PROFILE_SCOPED_DESC("Pick Stars from Galaxy")
-
-			TaskGraph *graph = Pi::GetApp()->GetTaskGraph();
-
-			// judging by the current sector generator, maximum average number
-			// of stars in a sector is 6
-			// It’s easy to express what the radius of a ball should be so that
-			// at such a density it would contain approximately NUM_BG_STARS stars:
-			const double density = 6.0;
-			const double maxBall = pow(3.0 / 4.0 / M_PI * (double)NUM_BG_STARS / density, 1.0 / 3.0);
-			const int32_t visibleRadius = std::min<int32_t>(BG_STAR_RADIUS_MAX, maxBall * Sector::SIZE);
-
-			StarQueryInfo info;
-			info.systemPath = systemPath;
-			info.sectorMin = -(visibleRadius / Sector::SIZE); // lyrs_radius / sector_size_in_lyrs
-			info.sectorMax = visibleRadius / Sector::SIZE;	  // lyrs_radius / sector_size_in_lyrs
-			info.visibleRadiusSqr = (visibleRadius * visibleRadius);
-			info.colorMin = Color((Uint8)(m_rMin * 255), (Uint8)(m_gMin * 255), (Uint8)(m_rMin * 255));
-			info.colorMax = Color((Uint8)(m_rMax * 255), (Uint8)(m_gMax * 255), (Uint8)(m_rMax * 255));
-			info.brightnessFactor = brightnessApparentSizeFactor;
-
-			// We want the main thread to participate in this work as well,
-			// but don't split the number of stars too much that we have visible brightness "patches"
-			// also we want a piece of at least size 1
-			const uint32_t numTasks = std::min({ graph->GetNumWorkerThreads() + 1, 8U, uint32_t(info.sectorMax - info.sectorMin) });
-
-			TaskSet *sampleStarsTaskSet = new TaskSet();
-
-			int32_t starsLeft = NUM_BG_STARS;
-			const double realRadius = info.sectorMax;
-			const double realDensity = NUM_BG_STARS / (M_PI / 0.75 * realRadius * realRadius * realRadius);
-
-			std::vector<StarInfo> taskStars(numTasks);
-			std::vector<double> taskMedians(numTasks);
-
-			// Split the visible area of the galaxy up into separate tasks
-			uint32_t current = 0;
-			// divide the ball more evenly into tasks, when the number of tasks
-			// is comparable to the diameter of the ball (in sectors)
-			float range_step = (info.sectorMax - info.sectorMin) / (float)numTasks;
-
-			for (size_t i = 0; i < numTasks; i++) {
-				int32_t starsLimit;
-				uint32_t end = std::max(uint32_t(range_step * (i + 1)), current + 1);
-				if (i + 1 == numTasks) {
-					end = (info.sectorMax - info.sectorMin);
-					starsLimit = starsLeft;
-				} else {
-					starsLimit = realDensity * task_spherical_segment_volume(current, end, realRadius);
-					starsLeft -= starsLimit;
-				}
+			auto vtxPtr = vtxBuffer->Map<StarVert>(Graphics::BUFFER_MAP_WRITE);
+			for (uint32_t i = 0; i < NUM_HYPERSPACE_STARS; i++) {
+				// squeeze the starfield a bit to get more density near horizon using matrix3x3f::Scale
+				const auto star = matrix3x3f::Scale(1.0, 0.4, 1.0) * (RandomOnSphere(&unit[i * 2]).Normalized() * 1000.0f);
 
-				// in the task the loop runs from current to end inclusive
-				sampleStarsTaskSet->AddTask(new SampleStarsTask(galaxy, info, starsLimit, taskStars[i], taskMedians[i], { current, end - 1 }));
-				current = end;
+				vtxPtr[i * 2].pos = star * 2.0f;
+				vtxPtr[i * 2].col = Color::WHITE * 0.8;
+				vtxPtr[i * 2 + 1].pos = star;
+				vtxPtr[i * 2 + 1].col = Color::WHITE * 0.8;
 			}
+			vtxBuffer->Unmap();
+			m_animMesh.reset(m_renderer->CreateMeshObject(vtxBuffer));
+		}
+		PROFILE_STOP()
 
-			// We can't make progress until all stars are gathered, so run the
-			// star collection on the 'main' thread as well.
-			auto sampleHandle = graph->QueueTaskSet(sampleStarsTaskSet);
-			graph->WaitForTaskSet(sampleHandle);
+		TaskGraph *graph = Pi::GetApp()->GetTaskGraph();
 
-			double medianBrightness = std::reduce(taskMedians.begin(), taskMedians.end()) / taskMedians.size();
+		if (!systemPath || !galaxy.Valid()) {
+			// nothing to pick, straight to the random stars
+			UpdateFill();
+			return;
+		}
 
-			TaskSet *sortStarsTaskSet = new TaskSet();
-			for (size_t i = 0; i < numTasks; i++) {
-				sortStarsTaskSet->AddTask(new SortStarsTask(info, taskStars[i], medianBrightness));
+		PROFILE_SCOPED_DESC("Pick Stars from Galaxy")
+
+		// judging by the current sector generator, maximum average number
+		// of stars in a sector is 6
+		// It’s easy to express what the radius of a ball should be so that
+		// at such a density it would contain approximately NUM_BG_STARS stars:
+		const double density = 6.0;
+		const double maxBall = pow(3.0 / 4.0 / M_PI * (double)NUM_BG_STARS / density, 1.0 / 3.0);
+		const int32_t visibleRadius = std::min<int32_t>(BG_STAR_RADIUS_MAX, maxBall * Sector::SIZE);
+
+		fill.systemPath = *systemPath;
+		fill.galaxy = galaxy;
+
+		StarQueryInfo &info = fill.info;
+		info.systemPath = &fill.systemPath;
+		info.sectorMin = -(visibleRadius / Sector::SIZE); // lyrs_radius / sector_size_in_lyrs
+		info.sectorMax = visibleRadius / Sector::SIZE;	  // lyrs_radius / sector_size_in_lyrs
+		info.visibleRadiusSqr = (visibleRadius * visibleRadius);
+		info.colorMin = Color((Uint8)(m_rMin * 255), (Uint8)(m_gMin * 255), (Uint8)(m_rMin * 255));
+		info.colorMax = Color((Uint8)(m_rMax * 255), (Uint8)(m_gMax * 255), (Uint8)(m_rMax * 255));
+		info.brightnessFactor = brightnessApparentSizeFactor;
+
+		// don't split the number of stars too much that we have visible brightness "patches"
+		// also we want a piece of at least size 1
+		const uint32_t numTasks = std::min({ graph->GetNumWorkerThreads() + 1, 8U, uint32_t(info.sectorMax - info.sectorMin) });
+
+		TaskSet *sampleStarsTaskSet = new TaskSet();
+
+		int32_t starsLeft = NUM_BG_STARS;
+		const double realRadius = info.sectorMax;
+		const double realDensity = NUM_BG_STARS / (M_PI / 0.75 * realRadius * realRadius * realRadius);
+
+		fill.taskStars.resize(numTasks);
+		fill.taskMedians.resize(numTasks);
+
+		// Split the visible area of the galaxy up into separate tasks
+		uint32_t current = 0;
+		// divide the ball more evenly into tasks, when the number of tasks
+		// is comparable to the diameter of the ball (in sectors)
+		float range_step = (info.sectorMax - info.sectorMin) / (float)numTasks;
+
+		for (size_t i = 0; i < numTasks; i++) {
+			int32_t starsLimit;
+			uint32_t end = std::max(uint32_t(range_step * (i + 1)), current + 1);
+			if (i + 1 == numTasks) {
+				end = (info.sectorMax - info.sectorMin);
+				starsLimit = starsLeft;
+			} else {
+				starsLimit = realDensity * task_spherical_segment_volume(current, end, realRadius);
+				starsLeft -= starsLimit;
 			}
-			auto sortHandle = graph->QueueTaskSet(sortStarsTaskSet);
-			graph->WaitForTaskSet(sortHandle);
 
-			for(auto &item : taskStars) {
-				stars.pos.insert(stars.pos.end(), item.pos.begin(), item.pos.end());
-				stars.color.insert(stars.color.end(), item.color.begin(), item.color.end());
-				stars.brightness.insert(stars.brightness.end(), item.brightness.begin(), item.brightness.end());
-			}
+			// in the task the loop runs from current to end inclusive
+			sampleStarsTaskSet->AddTask(new SampleStarsTask(galaxy, info, starsLimit, fill.taskStars[i], fill.taskMedians[i], { current, end - 1 }));
+			current = end;
 		}
-		num = stars.pos.size();
-		Output("Stars picked from galaxy: %d\n", stars.pos.size());
-
-		stars.pos.resize(NUM_BG_STARS);
-		stars.color.resize(NUM_BG_STARS);
-		stars.brightness.resize(NUM_BG_STARS);
-
-		PROFILE_START_DESC("Generate Random Stars")
-		// fill out the remaining target count with generated points and also fill hyperspace stars
-		Output("Generating %d random stars\n", NUM_BG_STARS - num);
-		for (Uint32 i = num; i < NUM_BG_STARS; i++) {
-			const double size = rand.Double(0.2, 0.9);
-			const Uint8 colScale = size * 255;
-
-			const Color col(
-				rand.Double(m_rMin, m_rMax) * colScale,
-				rand.Double(m_gMin, m_gMax) * colScale,
-				rand.Double(m_bMin, m_bMax) * colScale,
-				255);
-
-			// this is proper random distribution on a sphere's surface
-			const float theta = float(rand.Double(0.0, 2.0 * M_PI));
-			const float u = float(rand.Double(-1.0, 1.0));
-
-			// squeeze the starfield a bit to get more density near horizon using matrix3x3f::Scale
-			const auto star = matrix3x3f::Scale(1.0, 1.0, 0.4) * (vector3f(sqrt(1.0f - u * u) * cos(theta), u, sqrt(1.0f - u * u) * sin(theta)).Normalized() * 1000.0f);
-
-			stars.pos[i] = star;
-			stars.color[i] = col;
-			stars.brightness[i] = size;
-			num++;
+
+		fill.stage = PendingFill::SAMPLING;
+		fill.handle.reset(new TaskSet::Handle(graph->QueueTaskSet(sampleStarsTaskSet)));
+	}
+
+	void Starfield::UpdateFill()
+	{
+		if (!m_pendingFill || (m_pendingFill->handle && !m_pendingFill->handle->IsComplete()))
+			return;
+
+		PROFILE_SCOPED()
+		PendingFill &fill = *m_pendingFill;
+		TaskGraph *graph = Pi::GetApp()->GetTaskGraph();
+		if (fill.handle) {
+			graph->CompleteTaskSet(*fill.handle);
+			fill.handle.reset();
+		} else {
+			// no galaxy to pick from
+			fill.stage = PendingFill::SAMPLING;
 		}
-		PROFILE_STOP()
 
-		PROFILE_START_DESC("Fill Hyperspace Stars")
-		for (uint32_t i = 0; i < NUM_HYPERSPACE_STARS; i++) {
-			// this is proper random distribution on a sphere's surface
-			const float theta = float(rand.Double(0.0, 2.0 * M_PI));
-			const float u = float(rand.Double(-1.0, 1.0));
+		if (fill.stage == PendingFill::SAMPLING) {
+			TaskSet *sortStarsTaskSet = new TaskSet();
+
+			size_t num = 0;
+			if (!fill.taskStars.empty()) {
+				const double medianBrightness = std::reduce(fill.taskMedians.begin(), fill.taskMedians.end()) / fill.taskMedians.size();
+				for (StarInfo &stars : fill.taskStars) {
+					sortStarsTaskSet->AddTask(new SortStarsTask(fill.info, stars, medianBrightness));
+					num += stars.pos.size();
+				}
+			}
+			Output("Stars picked from galaxy: %d\n", int(num));
+
+			// fill out the remaining target count with generated points
+			const Uint32 numRandom = fill.numStars - std::min<size_t>(num, fill.numStars);
+			Output("Generating %d random stars\n", numRandom);
+			PendingFill *pending = m_pendingFill.get();
+			sortStarsTaskSet->AddTaskLambda({ 0, 1 }, [pending, numRandom](TaskRange) {
+				PROFILE_SCOPED_DESC("Generate Random Stars")
+				Random &rand = pending->rand;
+				StarInfo &stars = pending->randomStars;
+				stars.pos.reserve(numRandom);
+				stars.color.reserve(numRandom);
+				stars.brightness.reserve(numRandom);
+
+				// size, colour and position, drawn in the order they were
+				// when each was asked for in turn, a chunk of stars at a time
+				constexpr Uint32 NUMBERS_PER_STAR = 6;
+				constexpr Uint32 CHUNK_STARS = 1024;
+				std::vector<double> unit(CHUNK_STARS * NUMBERS_PER_STAR);
+
+				for (Uint32 i = 0; i < numRandom; i++) {
+					if (i % CHUNK_STARS == 0)
+						rand.FillDouble(unit.data(), std::min(CHUNK_STARS, numRandom - i) * NUMBERS_PER_STAR);
+
+					const double *starUnit = &unit[(i % CHUNK_STARS) * NUMBERS_PER_STAR];
+					const double size = RandomInRange(starUnit[0], 0.2, 0.9);
+					const Uint8 colScale = size * 255;
+
+					const Color col(
+						RandomInRange(starUnit[1], pending->colorMin.x, pending->colorMax.x) * colScale,
+						RandomInRange(starUnit[2], pending->colorMin.y, pending->colorMax.y) * colScale,
+						RandomInRange(starUnit[3], pending->colorMin.z, pending->colorMax.z) * colScale,
+						255);
+
+					// squeeze the starfield a bit to get more density near horizon using matrix3x3f::Scale
+					const auto star = matrix3x3f::Scale(1.0, 1.0, 0.4) * (RandomOnSphere(&starUnit[4]).Normalized() * 1000.0f);
+
+					stars.pos.push_back(star);
+					stars.color.push_back(col);
+					stars.brightness.push_back(size);
+				}
+			});
 
-			// squeeze the starfield a bit to get more density near horizon using matrix3x3f::Scale
-			const auto star = matrix3x3f::Scale(1.0, 0.4, 1.0) * (vector3f(sqrt(1.0f - u * u) * cos(theta), u, sqrt(1.0f - u * u) * sin(theta)).Normalized() * 1000.0f);
+			fill.stage = PendingFill::SIZING;
+			fill.handle.reset(new TaskSet::Handle(graph->QueueTaskSet(sortStarsTaskSet)));
+			return;
+		}
 
-			m_hyperVtx[NUM_HYPERSPACE_STARS * 2 + i] = star;
-			m_hyperCol[NUM_HYPERSPACE_STARS * 2 + i] = Color::WHITE * 0.8;
+		StarInfo stars;
+		stars.pos.reserve(fill.numStars);
+		stars.color.reserve(fill.numStars);
+		stars.brightness.reserve(fill.numStars);
+		fill.taskStars.push_back(std::move(fill.randomStars));
+		for (auto &item : fill.taskStars) {
+			stars.pos.insert(stars.pos.end(), item.pos.begin(), item.pos.end());
+			stars.color.insert(stars.color.end(), item.color.begin(), item.color.end());
+			stars.brightness.insert(stars.brightness.end(), item.brightness.begin(), item.brightness.end());
 		}
-		PROFILE_STOP()
+		stars.pos.resize(fill.numStars);
+		stars.color.resize(fill.numStars);
+		stars.brightness.resize(fill.numStars);
 
-		Output("Final stars number: %d\n", num);
+		Output("Final stars number: %d\n", fill.numStars);
 
-		m_pointSprites->SetData(NUM_BG_STARS, std::move(stars.pos), std::move(stars.color), std::move(stars.brightness));
+		m_pointSprites->SetData(fill.numStars, std::move(stars.pos), std::move(stars.color), std::move(stars.brightness));
+		m_pendingFill.reset();
 	}
 
 	void Starfield::Draw()
 	{
 		PROFILE_SCOPED()
+		UpdateFill();
+
 		// XXX would be nice to get rid of the Pi:: stuff here
 		if (!Pi::game || Pi::player->GetFlightState() != Ship::HYPERSPACE) {
-			m_pointSprites->Draw(m_renderer, m_material.Get());
-		} else {
-			Graphics::VertexBuffer *buffer = m_animMesh->GetVertexBuffer();
-			assert(sizeof(StarVert) == 16);
-			assert(buffer->GetDesc().stride == sizeof(StarVert));
-			auto vtxPtr = buffer->Map<StarVert>(Graphics::BUFFER_MAP_WRITE);
-
+			if (m_pointSprites)
+				m_pointSprites->Draw(m_renderer, m_material.Get());
+		} else if (m_animMesh) {
 			// roughly, the multiplier gets smaller as the duration gets larger.
 			// the time-looking bits in this are completely arbitrary - I figured
 			// it out by tweaking the numbers until it looked sort of right
@@ -622,22 +727,12 @@ namespace Background {
 
 			const double hyperspaceProgress = Pi::game->GetHyperspaceProgress();
 
-			const Sint32 numStars = buffer->GetDesc().numVertices / 2;
-
 			const vector3d oz = Pi::player->GetOrient().VectorZ(); //back vector in Y-up space
 			const vector3d pz = vector3d(oz.z, oz.x, oz.y); // back vector rotated into Z-up space
 
-			for (int i = 0; i < numStars; i++) {
-				vector3f v = m_hyperVtx[numStars * 2 + i] + vector3f(pz * hyperspaceProgress * mult);
-				const Color &c = m_hyperCol[numStars * 2 + i];
-
-				vtxPtr[i * 2].pos = m_hyperVtx[i * 2] = m_hyperVtx[numStars * 2 + i] + v;
-				vtxPtr[i * 2].col = m_hyperCol[i * 2] = c;
-
-				vtxPtr[i * 2 + 1].pos = m_hyperVtx[i * 2 + 1] = v;
-				vtxPtr[i * 2 + 1].col = m_hyperCol[i * 2 + 1] = c;
-			}
-			buffer->Unmap();
+			// every streak moves by the same amount, so moving the mesh does it
+			Graphics::Renderer::MatrixTicket mt(m_renderer);
+			m_renderer->SetTransform(m_renderer->GetTransform() * matrix4x4f::Translation(vector3f(pz * hyperspaceProgress * mult)));
 			m_renderer->DrawMesh(m_animMesh.get(), m_materialStreaks.Get());
 		}
 	}
@@ -62,18 +62,26 @@ namespace Background {
 	public:
 		//does not Fill the starfield
 		Starfield(Graphics::Renderer *r);
+		~Starfield();
 		void Draw();
-		//create or recreate the starfield
+		//create or recreate the starfield. The stars are picked from the
+		//galaxy and generated on the task graph without waiting for them,
+		//the first Draw after they are done uploads them.
 		void Fill(Random &rand, const SystemPath *const systemPath, RefCountedPtr<Galaxy> galaxy);
+		// move the pending fill along, on the main thread; Draw does this
+		// itself, a starfield that isn't drawn yet needs it called
+		void UpdateFill();
 
 	private:
+		struct PendingFill;
+
 		void Init();
+		void CancelFill();
 
 		std::unique_ptr<Graphics::Drawables::PointSprites> m_pointSprites;
+		std::unique_ptr<PendingFill> m_pendingFill;
 
-		//hyperspace animation vertex data
-		std::unique_ptr<vector3f[]> m_hyperVtx; // BG_STAR_MAX * 3
-		std::unique_ptr<Color[]> m_hyperCol;	// BG_STAR_MAX * 3
+		//hyperspace animation: static streaks that are only moved as a whole
 		std::unique_ptr<Graphics::MeshObject> m_animMesh;
 	};
 
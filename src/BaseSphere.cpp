@@ -89,7 +89,7 @@ void BaseSphere::DrawAtmosphereSurface(Graphics::Renderer *renderer,
 
 static size_t s_baseSphereData = "BaseSphereData"_hash;
 static size_t s_numShadows = "NumShadows"_hash;
-void BaseSphere::SetMaterialParameters(const matrix4x4d &trans, const float radius, const std::vector<Camera::Shadow> &shadows, const AtmosphereParameters &ap)
+void BaseSphere::SetMaterialParameters(const matrix4x4d &trans, const float radius, const Camera::ShadowList &shadows, const AtmosphereParameters &ap)
 {
 	BaseSphereDataBlock matData{};
 
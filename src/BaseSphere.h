@@ -24,9 +24,16 @@ public:
 	virtual ~BaseSphere();
 
 	virtual void Update() = 0;
-	virtual void Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const std::vector<Camera::Shadow> &shadows) = 0;
+	virtual void Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const Camera::ShadowList &shadows) = 0;
 
 	virtual double GetHeight(const vector3d &p) const { return 0.0; }
+	// Height at p taken from the terrain generated for rendering, if it is
+	// there at full detail. Must not be called while Update() runs.
+	virtual bool GetGeneratedHeight(const vector3d &p, double &height) const { return false; }
+
+	// Have what can be seen from p (in sbody radii) ready soon, in the
+	// next Update only
+	virtual void SetApproachPoint(const vector3d &p) {}
 
 	static void Init();
 	static void Uninit();
@@ -59,7 +66,7 @@ protected:
 	RefCountedPtr<Graphics::Material> m_atmosphereMaterial;
 
 	// set up shader data for this geosphere's atmosphere
-	void SetMaterialParameters(const matrix4x4d &t, const float r, const std::vector<Camera::Shadow> &s, const AtmosphereParameters &ap);
+	void SetMaterialParameters(const matrix4x4d &t, const float r, const Camera::ShadowList &s, const AtmosphereParameters &ap);
 
 	// atmosphere geometry
 	std::unique_ptr<Graphics::Drawables::Sphere3D> m_atmos;
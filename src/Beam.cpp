@@ -3,14 +3,15 @@
 
 #include "Beam.h"
 
-#include "CargoBody.h"
 #include "Frame.h"
 #include "Game.h"
 #include "GameSaveError.h"
 #include "JsonUtils.h"
 #include "Pi.h"
 #include "Planet.h"
+#include "Projectile.h"
 #include "Player.h"
+#include "ProjectilePool.h"
 #include "Sfx.h"
 #include "Ship.h"
 #include "Space.h"
@@ -26,6 +27,9 @@
 #include "lua/LuaEvent.h"
 #include "lua/LuaUtils.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace {
 	static float lifetime = 0.1f;
 }
@@ -34,6 +38,28 @@ std::unique_ptr<Graphics::MeshObject> Beam::s_sideMesh;
 std::unique_ptr<Graphics::MeshObject> Beam::s_glowMesh;
 std::unique_ptr<Graphics::Material> Beam::s_sideMat;
 std::unique_ptr<Graphics::Material> Beam::s_glowMat;
+std::unique_ptr<Graphics::Material> Beam::s_sideInstMat;
+std::unique_ptr<Graphics::Material> Beam::s_glowInstMat;
+
+bool Beam::s_batching = false;
+std::vector<Beam::BatchEntry> Beam::s_sideBatch;
+std::vector<Beam::BatchEntry> Beam::s_glowBatch;
+
+// number of steps the alpha is rounded to while batching
+static constexpr float BATCH_LEVELS = 32.f;
+
+static uint32_t color_key(const Color &c)
+{
+	return uint32_t(c.r) << 24 | uint32_t(c.g) << 16 | uint32_t(c.b) << 8 | c.a;
+}
+
+// the instanced variant of a material, for the renderer to merge draws with
+static Graphics::Material *instanced_material(Graphics::Material *mat)
+{
+	Graphics::MaterialDescriptor mdesc = mat->GetDescriptor();
+	mdesc.instanced = true;
+	return Pi::renderer->CloneMaterial(mat, mdesc, Pi::renderer->GetMaterialRenderState(mat));
+}
 
 void Beam::BuildModel()
 {
@@ -53,6 +79,8 @@ void Beam::BuildModel()
 	s_glowMat.reset(Pi::renderer->CreateMaterial("unlit", desc, rsd));
 	s_glowMat->SetTexture("texture0"_hash,
 		Graphics::TextureBuilder::Billboard("textures/projectile_w.dds").GetOrCreateTexture(Pi::renderer, "billboard"));
+	s_sideInstMat.reset(instanced_material(s_sideMat.get()));
+	s_glowInstMat.reset(instanced_material(s_glowMat.get()));
 
 	//zero at projectile position
 	//+x down
@@ -116,6 +144,8 @@ void Beam::FreeModel()
 {
 	s_sideMat.reset();
 	s_glowMat.reset();
+	s_sideInstMat.reset();
+	s_glowInstMat.reset();
 	s_sideMesh.reset();
 	s_glowMesh.reset();
 }
@@ -129,6 +159,7 @@ Beam::Beam(Body *parent, const ProjectileData &prData, const vector3d &pos, cons
 	m_flags |= FLAG_DRAW_LAST;
 
 	m_parent = parent;
+	Pi::game->GetSpace()->WatchBody(this, m_parent);
 	m_dir = dir;
 	m_baseDam = prData.damage;
 	m_length = prData.length;
@@ -190,6 +221,7 @@ void Beam::PostLoadFixup(Space *space)
 {
 	Body::PostLoadFixup(space);
 	m_parent = space->GetBodyByIndex(m_parentIndex);
+	space->WatchBody(this, m_parent);
 }
 
 void Beam::UpdateInterpTransform(double alpha)
@@ -224,39 +256,6 @@ double Beam::GetRadius() const
 	return sqrt(m_length * m_length);
 }
 
-static void MiningLaserSpawnTastyStuff(FrameId fId, const SystemBody *asteroid, const vector3d &pos)
-{
-	lua_State *l = Lua::manager->GetLuaState();
-
-	// lua can't push "const SystemBody", needs to convert to non-const
-	RefCountedPtr<StarSystem> s = Pi::game->GetGalaxy()->GetStarSystem(asteroid->GetPath());
-	SystemBody *liveasteroid = s->GetBodyByPath(asteroid->GetPath());
-
-	// this is an adapted version of "CallMethod", because;
-	// 1, there is no template for LuaObject<LuaTable>::CallMethod(..., SystemBody)
-	// 2, this leaves the return value on the lua stack to be used by "new CargoBody()"
-	LUA_DEBUG_START(l);
-	LuaObject<Player>::PushToLua(Pi::player);
-	lua_pushstring(l, "SpawnMiningContainer");
-	lua_gettable(l, -2);
-	lua_pushvalue(l, -2);
-	lua_remove(l, -3);
-	LuaObject<SystemBody>::PushToLua(liveasteroid);
-	pi_lua_protected_call(l, 2, 1);
-
-	CargoBody *cargo = new CargoBody(LuaRef(l, -1));
-	lua_pop(l, 1);
-	LUA_DEBUG_END(l, 0);
-
-	cargo->SetFrame(fId);
-	cargo->SetPosition(pos);
-	const double x = Pi::rng.Double();
-	vector3d dir = pos.Normalized();
-	dir.ArbRotate(vector3d(x, 1 - x, 0), Pi::rng.Double() - .5);
-	cargo->SetVelocity(Pi::rng.Double(100.0, 200.0) * dir);
-	Pi::game->GetSpace()->AddBody(cargo);
-}
-
 void Beam::StaticUpdate(const float timeStep)
 {
 	PROFILE_SCOPED()
@@ -302,11 +301,15 @@ void Beam::StaticUpdate(const float timeStep)
 void Beam::Render(Graphics::Renderer *renderer, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform)
 {
 	PROFILE_SCOPED()
-	const vector3d _from = viewTransform * GetInterpPosition();
-	const vector3d _to = viewTransform * (GetInterpPosition() + (-m_dir));
-	const vector3d _dir = _to - _from;
-	const vector3f from(&_from.x);
-	const vector3f dir = vector3f(_dir).Normalized();
+	DrawShot(renderer, viewCoords, viewTransform.ApplyRotationOnly(-m_dir), m_length, 1.0f, m_color, 1.0f);
+}
+
+void Beam::DrawShot(Graphics::Renderer *renderer, const vector3d &viewPos, const vector3d &viewDir, float shotLength, float shotWidth, const Color &shotColor, float baseAlpha)
+{
+	if (!s_sideMat) BuildModel();
+
+	const vector3f from(&viewPos.x);
+	const vector3f dir = vector3f(viewDir).Normalized();
 
 	vector3f v1, v2;
 	matrix4x4f m = matrix4x4f::Identity();
@@ -331,39 +334,95 @@ void Beam::Render(Graphics::Renderer *renderer, const Camera *camera, const vect
 
 	// increase visible size based on distance from camera, z is always negative
 	// allows them to be smaller while maintaining visibility for game play
-	const float dist_scale = float(viewCoords.z / -500);
-	const float length = m_length + dist_scale;
-	const float width = 1.0f + dist_scale;
+	const float dist_scale = float(viewPos.z / -500);
+	const float length = shotLength + dist_scale;
+	const float width = shotWidth + dist_scale;
 
-	renderer->SetTransform(m * matrix4x4f::ScaleMatrix(width, width, length));
+	const matrix4x4f trans = m * matrix4x4f::ScaleMatrix(width, width, length);
 
-	Color color = m_color;
-	// fade them out as they age so they don't suddenly disappear
-	// this matches the damage fall-off calculation
-	const float base_alpha = 1.0f;
 	// fade out side quads when viewing nearly edge on
-	vector3f view_dir = vector3f(viewCoords).Normalized();
-	color.a = (base_alpha * (1.f - powf(fabs(dir.Dot(view_dir)), length))) * 255;
-
-	if (color.a > 3) {
-		s_sideMat->diffuse = color;
-		renderer->DrawMesh(s_sideMesh.get(), s_sideMat.get());
-	}
-
+	const vector3f view_dir = vector3f(viewPos).Normalized();
+	float sideAlpha = baseAlpha * (1.f - powf(fabs(dir.Dot(view_dir)), length));
 	// fade out glow quads when viewing nearly edge on
 	// these and the side quads fade at different rates
 	// so that they aren't both at the same alpha as that looks strange
-	color.a = (base_alpha * powf(fabs(dir.Dot(view_dir)), width)) * 255;
+	float glowAlpha = baseAlpha * powf(fabs(dir.Dot(view_dir)), width);
 
+	if (s_batching) {
+		sideAlpha = std::round(sideAlpha * BATCH_LEVELS) / BATCH_LEVELS;
+		glowAlpha = std::round(glowAlpha * BATCH_LEVELS) / BATCH_LEVELS;
+	}
+
+	Color color = shotColor;
+	color.a = sideAlpha * 255;
+	if (color.a > 3) {
+		if (s_batching)
+			s_sideBatch.push_back({ trans, color });
+		else {
+			s_sideMat->diffuse = color;
+			renderer->SetTransform(trans);
+			renderer->DrawMesh(s_sideMesh.get(), s_sideMat.get());
+		}
+	}
+
+	color.a = glowAlpha * 255;
 	if (color.a > 3) {
-		s_glowMat->diffuse = color;
-		renderer->DrawMesh(s_glowMesh.get(), s_glowMat.get());
+		if (s_batching)
+			s_glowBatch.push_back({ trans, color });
+		else {
+			s_glowMat->diffuse = color;
+			renderer->SetTransform(trans);
+			renderer->DrawMesh(s_glowMesh.get(), s_glowMat.get());
+		}
 	}
 }
 
+void Beam::BeginBatch()
+{
+	s_batching = true;
+	s_sideBatch.clear();
+	s_glowBatch.clear();
+}
+
+void Beam::EndBatch(Graphics::Renderer *renderer)
+{
+	PROFILE_SCOPED()
+	s_batching = false;
+	if (s_sideBatch.empty() && s_glowBatch.empty())
+		return;
+
+	Graphics::Renderer::MatrixTicket ticket(renderer);
+
+	// the shots blend additively without writing depth, so they can be
+	// drawn in any order
+	auto byColor = [](const BatchEntry &a, const BatchEntry &b) {
+		return color_key(a.color) < color_key(b.color);
+	};
+	std::sort(s_sideBatch.begin(), s_sideBatch.end(), byColor);
+	for (const BatchEntry &entry : s_sideBatch) {
+		s_sideMat->diffuse = entry.color;
+		renderer->SetTransform(entry.trans);
+		renderer->DrawMeshBatched(s_sideMesh.get(), s_sideMat.get(), s_sideInstMat.get());
+	}
+
+	std::sort(s_glowBatch.begin(), s_glowBatch.end(), byColor);
+	for (const BatchEntry &entry : s_glowBatch) {
+		s_glowMat->diffuse = entry.color;
+		renderer->SetTransform(entry.trans);
+		renderer->DrawMeshBatched(s_glowMesh.get(), s_glowMat.get(), s_glowInstMat.get());
+	}
+
+	s_sideBatch.clear();
+	s_glowBatch.clear();
+}
+
 // static
 void Beam::Add(Body *parent, const ProjectileData &prData, const vector3d &pos, const vector3d &baseVel, const vector3d &dir)
 {
+	if (ProjectilePool::IsEnabled()) {
+		Pi::game->GetSpace()->GetProjectiles()->AddBeam(parent, prData, pos, baseVel, dir);
+		return;
+	}
 	Beam *p = new Beam(parent, prData, pos, baseVel, dir);
 	Pi::game->GetSpace()->AddBody(p);
 }
@@ -11,6 +11,8 @@
 #include "matrix4x4.h"
 #include "vector3.h"
 
+#include <vector>
+
 class Camera;
 class Space;
 
@@ -41,6 +43,15 @@ public:
 
 	static void FreeModel();
 
+	// Draw one shot at viewPos, pointing along viewDir, both in view
+	// coordinates; baseAlpha is the fade with age
+	static void DrawShot(Graphics::Renderer *r, const vector3d &viewPos, const vector3d &viewDir, float length, float width, const Color &color, float baseAlpha);
+	// Between BeginBatch and EndBatch shots are queued instead of drawn.
+	// EndBatch draws the queue sorted by colour, so the renderer can merge
+	// the draws of the same colour into instanced draws.
+	static void BeginBatch();
+	static void EndBatch(Graphics::Renderer *r);
+
 protected:
 	virtual void SaveToJson(Json &jsonObj, Space *space) override final;
 
@@ -59,12 +70,23 @@ private:
 
 	int m_parentIndex; // deserialisation
 
+	struct BatchEntry {
+		matrix4x4f trans;
+		Color color;
+	};
+
 	static void BuildModel();
 
 	static std::unique_ptr<Graphics::MeshObject> s_sideMesh;
 	static std::unique_ptr<Graphics::MeshObject> s_glowMesh;
 	static std::unique_ptr<Graphics::Material> s_sideMat;
 	static std::unique_ptr<Graphics::Material> s_glowMat;
+	static std::unique_ptr<Graphics::Material> s_sideInstMat;
+	static std::unique_ptr<Graphics::Material> s_glowInstMat;
+
+	static bool s_batching;
+	static std::vector<BatchEntry> s_sideBatch;
+	static std::vector<BatchEntry> s_glowBatch;
 };
 
 #endif /* _BEAM_H */
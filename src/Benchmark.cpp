@@ -0,0 +1,271 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Benchmark.h"
+
+#include "Game.h"
+#include "GameSaveError.h"
+#include "Json.h"
+#include "MathUtil.h"
+#include "Pi.h"
+#include "Player.h"
+#include "Space.h"
+#include "SpaceStation.h"
+#include "StartupReport.h"
+#include "graphics/Renderer.h"
+#include "graphics/Stats.h"
+#include "lua/LuaRef.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static Json read_json(const std::string &filename)
+{
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file) {
+		Output("benchmark: could not open \"%s\": %s\n", filename.c_str(), strerror(errno));
+		return Json();
+	}
+	std::string text;
+	char buf[4096];
+	size_t len;
+	while ((len = fread(buf, 1, sizeof(buf), file)) > 0)
+		text.append(buf, len);
+	fclose(file);
+	return Json::parse(text, nullptr, false);
+}
+
+static Body *find_body(const std::string &label)
+{
+	for (Body *b : Pi::game->GetSpace()->GetBodies())
+		if (b->GetLabel() == label)
+			return b;
+	return nullptr;
+}
+
+// the frame times of the range, in milliseconds
+static Json frame_time_summary(std::vector<float> frames)
+{
+	Json summary = Json::object();
+	summary["frames"] = frames.size();
+	if (frames.empty())
+		return summary;
+
+	double sum = 0.0;
+	for (float ms : frames)
+		sum += ms;
+	std::sort(frames.begin(), frames.end());
+	const auto percentile = [&frames](double p) {
+		return frames[std::min(frames.size() - 1, size_t(p * frames.size()))];
+	};
+
+	summary["mean"] = sum / frames.size();
+	summary["p50"] = percentile(0.50);
+	summary["p90"] = percentile(0.90);
+	summary["p95"] = percentile(0.95);
+	summary["p99"] = percentile(0.99);
+	summary["max"] = frames.back();
+	return summary;
+}
+
+Benchmark::Benchmark(const std::string &scriptFile, const std::string &outputFile) :
+	m_valid(false),
+	m_outputFile(outputFile),
+	m_startPath(0, 0, 0, 0, 18),
+	m_seed(0),
+	m_timeStep(1.0f / 60.0f),
+	m_step(0),
+	m_stepFrame(0)
+{
+	const Json script = read_json(scriptFile);
+	if (!script.is_object()) {
+		Output("benchmark: \"%s\" is not a json object\n", scriptFile.c_str());
+		return;
+	}
+
+	try {
+		m_save = script.value("save", "");
+		if (script.count("start"))
+			m_startPath = SystemPath::Parse(script["start"].get<std::string>().c_str());
+		m_seed = script.value("seed", 0u);
+		m_timeStep = script.value("timestep", m_timeStep);
+
+		for (const Json &stepObj : script.at("steps")) {
+			Step step;
+			step.action = stepObj.at("action").get<std::string>();
+			step.target = stepObj.value("target", "");
+			step.frames = stepObj.value("frames", 600u);
+			step.timeAccel = stepObj.value("timeAccel", int(Game::TIMEACCEL_1X));
+			step.duration = stepObj.value("duration", 0.0);
+			m_steps.push_back(step);
+		}
+	} catch (const Json::exception &e) {
+		Output("benchmark: bad script \"%s\": %s\n", scriptFile.c_str(), e.what());
+		return;
+	} catch (const SystemPath::ParseFailure &) {
+		Output("benchmark: bad start path in \"%s\"\n", scriptFile.c_str());
+		return;
+	}
+
+	m_valid = !m_steps.empty() && m_timeStep > 0.0f;
+	if (!m_valid)
+		Output("benchmark: \"%s\" has no steps to run\n", scriptFile.c_str());
+}
+
+Game *Benchmark::CreateGame() const
+{
+	if (m_save.empty())
+		return new Game(m_startPath, 0.0);
+
+	try {
+		return Game::LoadGame(m_save);
+	} catch (const SavedGameCorruptException &) {
+	} catch (const SavedGameWrongVersionException &) {
+	} catch (const CouldNotOpenFileException &) {
+	}
+	Output("benchmark: could not load the save \"%s\"\n", m_save.c_str());
+	return nullptr;
+}
+
+void Benchmark::Start()
+{
+	m_step = 0;
+	m_stepFrame = 0;
+	m_frameMs.clear();
+	m_stepStart.clear();
+	m_stats.clear();
+
+	m_frameClock.SoftReset();
+	StartStep(m_steps[0]);
+}
+
+bool Benchmark::NextFrame()
+{
+	if (m_step == m_steps.size())
+		return false;
+
+	// the time since the last frame started covers all of it, the swap
+	// included
+	m_frameClock.SoftStop();
+	m_frameMs.push_back(m_frameClock.milliseconds());
+	m_frameClock.SoftReset();
+
+	SampleStats();
+
+	if (++m_stepFrame < m_steps[m_step].frames)
+		return true;
+
+	m_stepFrame = 0;
+	if (++m_step == m_steps.size()) {
+		WriteResults();
+		return false;
+	}
+
+	StartStep(m_steps[m_step]);
+	return true;
+}
+
+void Benchmark::StartStep(const Step &step)
+{
+	Output("benchmark: step %d: %s %s\n", int(m_stepStart.size()), step.action.c_str(), step.target.c_str());
+	m_stepStart.push_back(m_frameMs.size());
+
+	Player *player = Pi::player;
+	Body *target = step.target.empty() ? nullptr : find_body(step.target);
+	if (!step.target.empty() && !target && step.action != "hyperjump")
+		Output("benchmark: no body \"%s\"\n", step.target.c_str());
+
+	if (step.action == "undock") {
+		player->Undock();
+	} else if (step.action == "flyto") {
+		if (target)
+			player->AIFlyTo(target);
+	} else if (step.action == "dock") {
+		if (target && target->IsType(ObjectType::SPACESTATION))
+			player->AIDock(static_cast<SpaceStation *>(target));
+	} else if (step.action == "hyperjump") {
+		try {
+			const SystemPath dest = SystemPath::Parse(step.target.c_str());
+			const Ship::HyperjumpStatus status = player->InitiateHyperjumpTo(dest, 5, step.duration, HyperdriveSoundsTable(), LuaRef());
+			if (status != Ship::HYPERJUMP_OK)
+				Output("benchmark: hyperjump to %s refused (%d)\n", step.target.c_str(), int(status));
+		} catch (const SystemPath::ParseFailure &) {
+			Output("benchmark: bad hyperjump target \"%s\"\n", step.target.c_str());
+		}
+	} else if (step.action == "fight") {
+		if (!target)
+			target = Pi::game->GetSpace()->FindNearestTo(player, ObjectType::SHIP);
+		if (target && target->IsType(ObjectType::SHIP)) {
+			Ship *enemy = static_cast<Ship *>(target);
+			player->AIKill(enemy);
+			enemy->AIKill(player);
+		}
+	} else if (step.action != "wait") {
+		Output("benchmark: unknown action \"%s\"\n", step.action.c_str());
+	}
+
+	Pi::game->RequestTimeAccel(Game::TimeAccel(Clamp(step.timeAccel, int(Game::TIMEACCEL_PAUSED), int(Game::TIMEACCEL_10000X))));
+}
+
+void Benchmark::SampleStats()
+{
+	for (const auto &counter : Pi::renderer->GetStats().GetFullStats()) {
+		StatTotal &total = m_stats[counter.first];
+		total.sum += counter.second;
+		total.max = std::max(total.max, counter.second);
+	}
+}
+
+void Benchmark::WriteResults()
+{
+	Json results = Json::object();
+	results["seed"] = m_seed;
+	results["timestep"] = m_timeStep;
+	results["frameMs"] = frame_time_summary(m_frameMs);
+
+	Json steps = Json::array();
+	for (size_t i = 0; i < m_steps.size(); i++) {
+		const auto begin = m_frameMs.begin() + m_stepStart[i];
+		const auto end = i + 1 < m_stepStart.size() ? m_frameMs.begin() + m_stepStart[i + 1] : m_frameMs.end();
+		Json step = Json::object();
+		step["action"] = m_steps[i].action;
+		step["target"] = m_steps[i].target;
+		step["frameMs"] = frame_time_summary(std::vector<float>(begin, end));
+		steps.push_back(step);
+	}
+	results["steps"] = steps;
+
+	Json stats = Json::object();
+	for (const auto &total : m_stats) {
+		Json stat = Json::object();
+		stat["mean"] = total.second.sum / std::max<size_t>(m_frameMs.size(), 1);
+		stat["max"] = total.second.max;
+		stats[total.first] = stat;
+	}
+	results["stats"] = stats;
+	results["startup"] = StartupReport::ToJson();
+
+#ifdef PIONEER_PROFILER
+	// the profiler has been accumulating since the game started, see
+	// GameLoop::Start
+	const std::string profileFile = m_outputFile + ".profile";
+	Profiler::dumptotals(profileFile.c_str());
+	results["profile"] = read_json(profileFile);
+	remove(profileFile.c_str());
+#endif
+
+	const std::string text = results.dump(1, '\t');
+	FILE *file = m_outputFile == "-" ? stdout : fopen(m_outputFile.c_str(), "w");
+	if (!file) {
+		Output("benchmark: could not open \"%s\" for writing: %s\n", m_outputFile.c_str(), strerror(errno));
+		return;
+	}
+	fwrite(text.data(), 1, text.size(), file);
+	fputc('\n', file);
+	if (file != stdout)
+		fclose(file);
+	Output("benchmark: %d frames written to %s\n", int(m_frameMs.size()), m_outputFile.c_str());
+}
@@ -0,0 +1,93 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+#include "JsonFwd.h"
+#include "galaxy/SystemPath.h"
+#include "profiler/Profiler.h"
+
+#include <SDL_stdinc.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Game;
+
+// A scripted run of the game for measuring performance, started with
+// "pioneer -benchmark script.json [output.json]".
+//
+// The script names a save (or a start path) and a list of steps, each an
+// action given to the player's autopilot and run for a number of frames:
+//
+//   {
+//     "save": "benchmark", "seed": 1, "timestep": 0.0166667,
+//     "steps": [
+//       { "action": "undock", "frames": 600 },
+//       { "action": "flyto", "target": "Mars", "frames": 1800, "timeAccel": 3 },
+//       { "action": "dock", "target": "Cydonia", "frames": 3600, "timeAccel": 2 },
+//       { "action": "hyperjump", "target": "-1,0,0", "duration": 86400, "frames": 1200 },
+//       { "action": "fight", "frames": 1800 }
+//     ]
+//   }
+//
+// Each frame advances the game by the same timestep and the random generator
+// is seeded from the script, so two runs of a script do the same work and
+// only the wall clock differs. When the last step ends the frame times, the
+// renderer stats, the profiler totals and the startup breakdown (see
+// StartupReport) are written as json and the game quits.
+class Benchmark {
+public:
+	Benchmark(const std::string &scriptFile, const std::string &outputFile);
+
+	bool IsValid() const { return m_valid; }
+
+	Uint32 GetSeed() const { return m_seed; }
+	float GetTimeStep() const { return m_timeStep; }
+
+	// Load the save or start a new game at the start path; null on failure
+	Game *CreateGame() const;
+
+	void Start();
+	// Call at the start of each game frame. Returns false once the last
+	// step has ended and the results are written.
+	bool NextFrame();
+
+private:
+	struct Step {
+		std::string action;
+		std::string target;
+		Uint32 frames;
+		int timeAccel;
+		double duration;
+	};
+
+	struct StatTotal {
+		double sum;
+		Uint32 max;
+	};
+
+	void StartStep(const Step &step);
+	void SampleStats();
+	void WriteResults();
+
+	bool m_valid;
+	std::string m_outputFile;
+	std::string m_save;
+	SystemPath m_startPath;
+	Uint32 m_seed;
+	float m_timeStep;
+	std::vector<Step> m_steps;
+
+	size_t m_step;
+	Uint32 m_stepFrame;
+
+	Profiler::Clock m_frameClock;
+	// the wall clock time of every frame, and the frame each step started at
+	std::vector<float> m_frameMs;
+	std::vector<size_t> m_stepStart;
+	std::map<std::string, StatTotal> m_stats;
+};
+
+#endif /* _BENCHMARK_H */
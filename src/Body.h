@@ -203,7 +203,8 @@ public:
 		FLAG_CAN_MOVE_FRAME = (1 << 0),
 		FLAG_LABEL_HIDDEN = (1 << 1),
 		FLAG_DRAW_LAST = (1 << 2),	 // causes the body drawn after other bodies in the z-sort
-		FLAG_DRAW_EXCLUDE = (1 << 3) // do not draw this body, intended for e.g. when camera is inside
+		FLAG_DRAW_EXCLUDE = (1 << 3), // do not draw this body, intended for e.g. when camera is inside
+		FLAG_NOTIFY_REMOVALS = (1 << 4) // NotifyRemoved is called for every body leaving the space, see Space::WatchBody
 	};
 
 private:
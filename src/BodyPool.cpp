@@ -0,0 +1,105 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "BodyPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <new>
+
+namespace {
+	std::mutex s_poolsLock;
+	std::map<int, BodyPool *> s_pools;
+} // namespace
+
+// static
+BodyPool *BodyPool::Get(ObjectType type, const char *name, size_t slotSize, size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(s_poolsLock);
+	auto it = s_pools.find(int(type));
+	if (it != s_pools.end())
+		return it->second;
+
+	BodyPool *pool = new BodyPool(name, slotSize, alignment);
+	s_pools.emplace(int(type), pool);
+	return pool;
+}
+
+// static
+void BodyPool::GetAllStats(std::vector<Stats> &out)
+{
+	out.clear();
+	std::lock_guard<std::mutex> lock(s_poolsLock);
+	for (const auto &it : s_pools)
+		out.push_back(it.second->GetStats());
+}
+
+static size_t align_up(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+BodyPool::BodyPool(const char *name, size_t slotSize, size_t alignment) :
+	m_name(name),
+	m_slotSize(align_up(slotSize, alignof(std::max_align_t))),
+	m_slotsPerChunk(std::max(MIN_CHUNK_SLOTS, CHUNK_SIZE / m_slotSize))
+{
+	// chunks come from operator new, which aligns no further than this
+	assert(alignment <= alignof(std::max_align_t));
+}
+
+BodyPool::~BodyPool()
+{
+	assert(m_numInUse == 0);
+	for (char *chunk : m_chunks)
+		::operator delete(chunk);
+}
+
+void BodyPool::AddChunk()
+{
+	char *chunk = static_cast<char *>(::operator new(m_slotSize * m_slotsPerChunk));
+	m_chunks.push_back(chunk);
+	// pushed last to first, so that a fresh chunk is handed out in order
+	for (size_t i = m_slotsPerChunk; i-- > 0;)
+		m_free.push_back(chunk + i * m_slotSize);
+}
+
+void *BodyPool::Allocate(size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_numAllocs++;
+	if (size > m_slotSize) {
+		m_numFallbacks++;
+		return ::operator new(size);
+	}
+
+	if (m_free.empty())
+		AddChunk();
+	void *ptr = m_free.back();
+	m_free.pop_back();
+	m_highWater = std::max(m_highWater, ++m_numInUse);
+	return ptr;
+}
+
+void BodyPool::Free(void *ptr, size_t size)
+{
+	if (!ptr)
+		return;
+	if (size > m_slotSize) {
+		::operator delete(ptr);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	assert(m_numInUse > 0);
+	m_numInUse--;
+	m_free.push_back(ptr);
+}
+
+BodyPool::Stats BodyPool::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return { m_name, m_slotSize, m_numInUse, m_highWater,
+		m_chunks.size() * m_slotsPerChunk, m_chunks.size(), m_numAllocs, m_numFallbacks };
+}
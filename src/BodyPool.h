@@ -0,0 +1,91 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _BODYPOOL_H
+#define _BODYPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+enum class ObjectType;
+
+// Fixed-size slots for the bodies of one ObjectType, carved out of chunks
+// holding a few dozen of them side by side. The bodies that come and go all
+// the time (ships, cargo, missiles, hyperspace clouds) are new'd and deleted
+// through their pool with POOLED_BODY, so a battle or a busy station reuses
+// the same warm memory instead of going back to the heap for each one, and
+// bodies of one type stay close to each other.
+//
+// Freed slots are reused last in, first out. Chunks are kept for the
+// lifetime of the pool: it holds on to the peak number of bodies of its type.
+class BodyPool {
+public:
+	struct Stats {
+		const char *name;
+		size_t slotSize;
+		size_t numInUse;
+		size_t highWater;
+		size_t numSlots;
+		size_t numChunks;
+		uint64_t numAllocs;
+		// allocations too big for a slot, made by subclasses without a pool
+		uint64_t numFallbacks;
+	};
+
+	// Returns the pool for bodies of the given type, creating it with slots
+	// fitting (size, alignment) on first use. Pools live for the lifetime of
+	// the program.
+	static BodyPool *Get(ObjectType type, const char *name, size_t slotSize, size_t alignment);
+
+	// The stats of every pool made so far
+	static void GetAllStats(std::vector<Stats> &out);
+
+	BodyPool(const char *name, size_t slotSize, size_t alignment);
+	~BodyPool();
+
+	BodyPool(const BodyPool &) = delete;
+	BodyPool &operator=(const BodyPool &) = delete;
+
+	// size is what operator new asked for; anything bigger than a slot goes
+	// to the heap, and Free must be given the same size to tell them apart
+	void *Allocate(size_t size);
+	void Free(void *ptr, size_t size);
+
+	Stats GetStats() const;
+
+private:
+	void AddChunk();
+
+	// the target size of a chunk; chunks hold at least MIN_CHUNK_SLOTS
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+	static constexpr size_t MIN_CHUNK_SLOTS = 8;
+
+	const char *m_name;
+	const size_t m_slotSize;
+	const size_t m_slotsPerChunk;
+
+	mutable std::mutex m_lock;
+	std::vector<char *> m_chunks;
+	std::vector<void *> m_free;
+	size_t m_numInUse = 0;
+	size_t m_highWater = 0;
+	uint64_t m_numAllocs = 0;
+	uint64_t m_numFallbacks = 0;
+};
+
+// Routes new and delete of a body class through the pool of its type. A
+// subclass inherits them; if it is bigger (Player is a Ship) its instances
+// just come from the heap, as the size tells them apart.
+#define POOLED_BODY(__thisClass, __TYPE)                                                    \
+	static BodyPool *GetBodyPool()                                                          \
+	{                                                                                       \
+		static BodyPool *pool = BodyPool::Get(ObjectType::__TYPE, #__thisClass,             \
+			sizeof(__thisClass), alignof(__thisClass));                                     \
+		return pool;                                                                        \
+	}                                                                                       \
+	static void *operator new(size_t size) { return GetBodyPool()->Allocate(size); }        \
+	static void operator delete(void *ptr, size_t size) { GetBodyPool()->Free(ptr, size); }
+
+#endif /* _BODYPOOL_H */
@@ -3,18 +3,27 @@
 
 #include "Camera.h"
 
+#include "Beam.h"
 #include "Body.h"
 #include "Frame.h"
 #include "Game.h"
+#include "NavLights.h"
 #include "Pi.h"
 #include "Planet.h"
 #include "Player.h"
+#include "Projectile.h"
+#include "ProjectilePool.h"
 #include "Sfx.h"
 #include "Space.h"
+#include "core/TaskGraph.h"
 #include "galaxy/StarSystem.h"
 #include "graphics/TextureBuilder.h"
 #include "graphics/Types.h"
 #include "graphics/RenderState.h"
+#include "scenegraph/Thruster.h"
+
+#include <algorithm>
+#include <cassert>
 
 using namespace Graphics;
 
@@ -24,6 +33,27 @@ static const float OBJECT_HIDDEN_PIXEL_THRESHOLD = 2.0f;
 // if a terrain object would render smaller than this many pixels, draw a billboard instead
 static const float BILLBOARD_PIXEL_THRESHOLD = 8.0f;
 
+// the bodies are evaluated and their lighting worked out in parallel from
+// this many, in pieces of the grain size
+static const uint32_t PARALLEL_MIN_BODIES = 64;
+static const uint32_t PARALLEL_GRAIN_SIZE = 32;
+
+// the lighting of a body is kept while no light has moved relative to it by
+// more than this fraction of its distance (about 150m at 1AU), and for at
+// most this many frames, so that eclipsing bodies catch up
+static const double LIGHTING_CACHE_TOLERANCE = 1e-6;
+static const Uint32 LIGHTING_CACHE_MAX_AGE = 60;
+
+// the shadows on a body are solved again once the light or an occluder has
+// turned by this much as seen from it (radians; the sun from the Earth is
+// ~4.6e-3 across). Occluders outside the cone are looked at again at least
+// this often, in frames, in case one has moved into it
+static const double SHADOW_CACHE_ANGLE = 1e-5;
+static const Uint32 SHADOW_CACHE_MAX_AGE = 30;
+// an occluder is near the cone if it's within this multiple of the distance
+// at which it could cast a shadow
+static const double SHADOW_NEAR_CONE_FACTOR = 2.0;
+
 CameraContext::CameraContext(float width, float height, float fovAng, float zNear, float zFar) :
 	m_width(width),
 	m_height(height),
@@ -144,89 +174,121 @@ static void position_system_lights(Frame *camFrame, Frame *frame, std::vector<Ca
 	}
 }
 
-void Camera::Update()
+bool Camera::EvaluateBody(Body *b, FrameId camFrame, BodyAttrs &attrs) const
 {
-	FrameId camFrame = m_context->GetTempFrame();
-
-	// evaluate each body and determine if/where/how to draw it
-	m_sortedBodies.clear();
-	for (Body *b : Pi::game->GetSpace()->GetBodies()) {
-		BodyAttrs attrs;
-		attrs.body = b;
-		attrs.billboard = false; // false by default
-		attrs.calcAtmosphereLighting = false; // false by default
-
-		// If the body wishes to be excluded from the draw, skip it.
-		if (b->GetFlags() & Body::FLAG_DRAW_EXCLUDE)
-			continue;
+	attrs.body = b;
+	attrs.billboard = false; // false by default
+	attrs.calcAtmosphereLighting = false; // false by default
 
-		// determine position and transform for draw
-		//		Frame::GetFrameTransform(b->GetFrame(), camFrame, attrs.viewTransform);		// doesn't use interp coords, so breaks in some cases
-		Frame *f = Frame::GetFrame(b->GetFrame());
-		attrs.viewTransform = f->GetInterpOrientRelTo(camFrame);
-		attrs.viewTransform.SetTranslate(f->GetInterpPositionRelTo(camFrame));
-		attrs.viewCoords = attrs.viewTransform * b->GetInterpPosition();
+	// If the body wishes to be excluded from the draw, skip it.
+	if (b->GetFlags() & Body::FLAG_DRAW_EXCLUDE)
+		return false;
 
-		// cull off-screen objects
-		double rad = b->GetClipRadius();
-		if (!m_context->GetFrustum().TestPointInfinite(attrs.viewCoords, rad))
-			continue;
+	// determine position and transform for draw
+	//		Frame::GetFrameTransform(b->GetFrame(), camFrame, attrs.viewTransform);		// doesn't use interp coords, so breaks in some cases
+	Frame *f = Frame::GetFrame(b->GetFrame());
+	attrs.viewTransform = f->GetInterpOrientRelTo(camFrame);
+	attrs.viewTransform.SetTranslate(f->GetInterpPositionRelTo(camFrame));
+	attrs.viewCoords = attrs.viewTransform * b->GetInterpPosition();
 
-		attrs.camDist = attrs.viewCoords.Length();
-		attrs.bodyFlags = b->GetFlags();
-
-		// approximate pixel width (disc diameter) of body on screen
-		// FIXME: this should reference a property set on the camera instead of querying the window size
-		const float pixSize = m_renderer->GetWindowHeight() * 2.0 * rad / (attrs.camDist * Graphics::GetFovFactor());
-
-		// terrain objects are visible from distance but might not have any discernable features
-		if (b->IsType(ObjectType::TERRAINBODY)) {
-			if (pixSize < BILLBOARD_PIXEL_THRESHOLD) {
-				attrs.billboard = true;
-
-				// project the position
-				vector3d pos;
-				m_context->GetFrustum().TranslatePoint(attrs.viewCoords, pos);
-				attrs.billboardPos = vector3f(pos);
-
-				// limit the minimum billboard size for planets so they're always a little visible
-				attrs.billboardSize = std::max(1.0f, pixSize);
-				if (b->IsType(ObjectType::STAR)) {
-					attrs.billboardColor = StarSystem::starRealColors[b->GetSystemBody()->GetType()];
-				} else if (b->IsType(ObjectType::PLANET)) {
-					// XXX this should incorporate some lighting effect
-					// (ie, colour of the illuminating star(s))
-					attrs.billboardColor = b->GetSystemBody()->GetAlbedo();
-				} else {
-					attrs.billboardColor = Color::WHITE;
-				}
+	// cull off-screen objects
+	double rad = b->GetClipRadius();
+	if (!m_context->GetFrustum().TestPointInfinite(attrs.viewCoords, rad))
+		return false;
 
-				// this should always be the main star in the system - except for the star itself!
-				if (!m_lightSources.empty() && !b->IsType(ObjectType::STAR)) {
-					const Graphics::Light &light = m_lightSources[0].GetLight();
-					attrs.billboardColor *= light.GetDiffuse(); // colour the billboard a little with the Starlight
-				}
+	attrs.camDist = attrs.viewCoords.Length();
+	attrs.bodyFlags = b->GetFlags();
+
+	// approximate pixel width (disc diameter) of body on screen
+	// FIXME: this should reference a property set on the camera instead of querying the window size
+	const float pixSize = m_renderer->GetWindowHeight() * 2.0 * rad / (attrs.camDist * Graphics::GetFovFactor());
+
+	// terrain objects are visible from distance but might not have any discernable features
+	if (b->IsType(ObjectType::TERRAINBODY)) {
+		if (pixSize < BILLBOARD_PIXEL_THRESHOLD) {
+			attrs.billboard = true;
+
+			// project the position
+			vector3d pos;
+			m_context->GetFrustum().TranslatePoint(attrs.viewCoords, pos);
+			attrs.billboardPos = vector3f(pos);
+
+			// limit the minimum billboard size for planets so they're always a little visible
+			attrs.billboardSize = std::max(1.0f, pixSize);
+			if (b->IsType(ObjectType::STAR)) {
+				attrs.billboardColor = StarSystem::starRealColors[b->GetSystemBody()->GetType()];
+			} else if (b->IsType(ObjectType::PLANET)) {
+				// XXX this should incorporate some lighting effect
+				// (ie, colour of the illuminating star(s))
+				attrs.billboardColor = b->GetSystemBody()->GetAlbedo();
+			} else {
+				attrs.billboardColor = Color::WHITE;
+			}
 
-				attrs.billboardColor.a = 255; // no alpha, these things are hard enough to see as it is
+			// this should always be the main star in the system - except for the star itself!
+			if (!m_lightSources.empty() && !b->IsType(ObjectType::STAR)) {
+				const Graphics::Light &light = m_lightSources[0].GetLight();
+				attrs.billboardColor *= light.GetDiffuse(); // colour the billboard a little with the Starlight
 			}
-		} else if (pixSize < OBJECT_HIDDEN_PIXEL_THRESHOLD) {
-			continue;
+
+			attrs.billboardColor.a = 255; // no alpha, these things are hard enough to see as it is
 		}
+	} else if (pixSize < OBJECT_HIDDEN_PIXEL_THRESHOLD) {
+		return false;
+	}
 
-		Body *parentBody = f->GetBody();
-		if (parentBody && parentBody->GetType() == ObjectType::PLANET) {
-			auto *planet = static_cast<Planet *>(parentBody);
+	Body *parentBody = f->GetBody();
+	if (parentBody && parentBody->GetType() == ObjectType::PLANET) {
+		auto *planet = static_cast<Planet *>(parentBody);
 
-			double atmo_rad_sqr = planet->GetAtmosphereRadius() * planet->GetAtmosphereRadius();
-			if (b->IsType(ObjectType::MODELBODY) && b->GetPosition().LengthSqr() <= atmo_rad_sqr)
-				attrs.calcAtmosphereLighting = true;
-		}
+		double atmo_rad_sqr = planet->GetAtmosphereRadius() * planet->GetAtmosphereRadius();
+		if (b->IsType(ObjectType::MODELBODY) && b->GetPosition().LengthSqr() <= atmo_rad_sqr)
+			attrs.calcAtmosphereLighting = true;
+	}
+
+	attrs.lighting = nullptr;
+	return true;
+}
+
+void Camera::Update()
+{
+	PROFILE_SCOPED()
+	FrameId camFrame = m_context->GetTempFrame();
+
+	// evaluate each body and determine if/where/how to draw it; each body
+	// has its own slot, so big spaces are done in parallel
+	auto bodies = Pi::game->GetSpace()->GetBodies();
+	const uint32_t numBodies = uint32_t(bodies.end() - bodies.begin());
+	m_sortedBodies.resize(numBodies);
+	m_bodyVisible.resize(numBodies);
+
+	auto evaluate = [this, &bodies, camFrame](TaskRange range) {
+		for (uint32_t i = range.begin; i < range.end; i++)
+			m_bodyVisible[i] = EvaluateBody(bodies[i], camFrame, m_sortedBodies[i]);
+	};
+	if (numBodies >= PARALLEL_MIN_BODIES) {
+		TaskGraph *taskGraph = Pi::GetApp()->GetTaskGraph();
+		TaskSet *set = new TaskSet();
+		set->AddTaskRangeLambda({ 0, numBodies }, PARALLEL_GRAIN_SIZE, std::move(evaluate));
+		TaskSet::Handle handle = taskGraph->QueueTaskSet(set);
+		taskGraph->WaitForTaskSet(handle);
+	} else {
+		evaluate({ 0, numBodies });
+	}
 
-		m_sortedBodies.push_back(attrs);
+	// keep the visible ones, in the order of the space
+	size_t numVisible = 0;
+	for (uint32_t i = 0; i < numBodies; i++) {
+		if (!m_bodyVisible[i])
+			continue;
+		if (numVisible != i)
+			m_sortedBodies[numVisible] = m_sortedBodies[i];
+		numVisible++;
 	}
+	m_sortedBodies.resize(numVisible);
 
-	// depth sort
-	m_sortedBodies.sort();
+	// depth sort, keeping the order of bodies that compare equal
+	std::stable_sort(m_sortedBodies.begin(), m_sortedBodies.end());
 }
 
 void Camera::Draw(const Body *excludeBody)
@@ -256,6 +318,8 @@ void Camera::Draw(const Body *excludeBody)
 		m_lightSources.push_back(LightSource(0, light));
 	}
 
+	PrepareOccluders();
+
 	//fade space background based on atmosphere thickness and light angle
 	float bgIntensity = 1.f;
 	Frame *camParent = Frame::GetFrame(camFrame->GetParent());
@@ -287,26 +351,44 @@ void Camera::Draw(const Body *excludeBody)
 	}
 
 	Pi::game->GetSpace()->GetBackground()->SetIntensity(bgIntensity);
-	Pi::game->GetSpace()->GetBackground()->Draw(trans2bg);
+	{
+		Graphics::Renderer::GPUTimerTicket timer(m_renderer, "Background");
+		Pi::game->GetSpace()->GetBackground()->Draw(trans2bg);
+	}
 
 	{
-		std::vector<Graphics::Light> rendererLights;
+		FrameVector<Graphics::Light> rendererLights;
 		rendererLights.reserve(m_lightSources.size());
 		for (size_t i = 0; i < m_lightSources.size(); i++)
 			rendererLights.push_back(m_lightSources[i].GetLight());
 		m_renderer->SetLights(rendererLights.size(), &rendererLights[0]);
 	}
 
-	std::vector<float> oldIntensities;
-	std::vector<float> lightIntensities;
-	for (size_t i = 0; i < m_lightSources.size(); i++) {
-		lightIntensities.push_back(1.0);
+	// binned once for all the draws of the view
+	m_pointLights.clear();
+	SfxManager::CollectLights(rootFrameId, camFrameId, m_pointLights);
+	m_renderer->SetPointLights(m_pointLights.size(), m_pointLights.data());
+
+	FrameVector<float> oldIntensities;
+	for (size_t i = 0; i < m_lightSources.size(); i++)
 		oldIntensities.push_back(m_renderer->GetLight(i).GetIntensity());
-	}
+
+	PrepareLighting(excludeBody);
 
 	Graphics::VertexArray billboards(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL);
 
-	for (std::list<BodyAttrs>::iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
+	// Bodies are timed by kind. The timer only switches scopes where the kind
+	// changes, so draws inside a scope can still be sorted together.
+	const char *timerScope = nullptr;
+
+	// the thrusters and nav lights of all the ships and all the shots are
+	// drawn together after the bodies
+	SceneGraph::Thruster::BeginBatch();
+	NavLights::BeginBatch();
+	Projectile::BeginBatch();
+	Beam::BeginBatch();
+
+	for (std::vector<BodyAttrs>::iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
 		BodyAttrs *attrs = &(*i);
 
 		// explicitly exclude a single body if specified (eg player)
@@ -319,30 +401,149 @@ void Camera::Draw(const Body *excludeBody)
 			continue;
 		}
 
-		double ambient = 0.05, direct = 1.0;
-		if (attrs->calcAtmosphereLighting)
-			CalcLighting(attrs->body, ambient, direct);
-
-		for (size_t i = 0; i < m_lightSources.size(); i++)
-			lightIntensities[i] = direct * ShadowedIntensity(i, attrs->body);
-
 		// Setup dynamic lighting parameters
+		const double ambient = attrs->lighting->ambient;
 		m_renderer->SetAmbientColor(Color(ambient * 255, ambient * 255, ambient * 255));
-		m_renderer->SetLightIntensity(m_lightSources.size(), lightIntensities.data());
+		m_renderer->SetLightIntensity(m_lightSources.size(), attrs->lighting->lightIntensities);
+
+		const char *bodyScope = attrs->body->IsType(ObjectType::TERRAINBODY) ? "Planets" : "Models";
+		if (bodyScope != timerScope) {
+			if (timerScope)
+				m_renderer->EndGPUTimer();
+			m_renderer->BeginGPUTimer(bodyScope);
+			timerScope = bodyScope;
+		}
 
 		attrs->body->Render(m_renderer, this, attrs->viewCoords, attrs->viewTransform);
 	}
 
+	if (timerScope)
+		m_renderer->EndGPUTimer();
+
+	Pi::game->GetSpace()->GetProjectiles()->Render(m_renderer, m_context.Get(), OBJECT_HIDDEN_PIXEL_THRESHOLD);
+
 	// Restore default ambient color and direct light intensities
 	m_renderer->SetAmbientColor(Color(255, 255, 255));
 	m_renderer->SetLightIntensity(m_lightSources.size(), oldIntensities.data());
 
+	{
+		Graphics::Renderer::GPUTimerTicket timer(m_renderer, "Thrusters");
+		SceneGraph::Thruster::EndBatch(m_renderer);
+	}
+
+	{
+		Graphics::Renderer::GPUTimerTicket timer(m_renderer, "NavLights");
+		NavLights::EndBatch(m_renderer);
+	}
+
+	{
+		Graphics::Renderer::GPUTimerTicket timer(m_renderer, "Projectiles");
+		Projectile::EndBatch(m_renderer);
+		Beam::EndBatch(m_renderer);
+	}
+
 	if (!billboards.IsEmpty()) {
 		Graphics::Renderer::MatrixTicket mt(m_renderer, matrix4x4f::Identity());
 		m_renderer->DrawBuffer(&billboards, m_billboardMaterial.get());
 	}
 
 	SfxManager::RenderAll(m_renderer, rootFrameId, camFrameId);
+
+	// views drawn after this one have their own
+	m_renderer->SetPointLights(0, nullptr);
+}
+
+// Works out the light on each body to be drawn as a model, or takes it from
+// the cache if neither it nor the lights have moved much since
+void Camera::PrepareLighting(const Body *excludeBody)
+{
+	PROFILE_SCOPED()
+	assert(m_lightSources.size() <= MAX_LIGHTS);
+	m_lightingFrame++;
+
+	// the cache entries are made here, so the parallel pass only fills them in
+	for (BodyAttrs &attrs : m_sortedBodies) {
+		attrs.lighting = nullptr;
+		if (attrs.billboard || attrs.body == excludeBody)
+			continue;
+
+		auto result = m_lightingCache.emplace(attrs.body, CachedLighting());
+		CachedLighting &cached = result.first->second;
+		if (result.second)
+			cached.numLights = 0; // never computed
+		cached.usedFrame = m_lightingFrame;
+		attrs.lighting = &cached;
+	}
+
+	auto update = [this](TaskRange range) {
+		for (uint32_t i = range.begin; i < range.end; i++) {
+			const BodyAttrs &attrs = m_sortedBodies[i];
+			if (attrs.lighting)
+				UpdateLighting(attrs, *attrs.lighting);
+		}
+	};
+	const uint32_t numBodies = uint32_t(m_sortedBodies.size());
+	if (numBodies >= PARALLEL_MIN_BODIES) {
+		TaskGraph *taskGraph = Pi::GetApp()->GetTaskGraph();
+		TaskSet *set = new TaskSet();
+		set->AddTaskRangeLambda({ 0, numBodies }, PARALLEL_GRAIN_SIZE, std::move(update));
+		TaskSet::Handle handle = taskGraph->QueueTaskSet(set);
+		taskGraph->WaitForTaskSet(handle);
+	} else {
+		update({ 0, numBodies });
+	}
+
+	// forget the bodies that weren't drawn, as they may be gone
+	for (auto it = m_lightingCache.begin(); it != m_lightingCache.end();) {
+		if (it->second.usedFrame != m_lightingFrame)
+			it = m_lightingCache.erase(it);
+		else
+			++it;
+	}
+}
+
+void Camera::UpdateLighting(const BodyAttrs &attrs, CachedLighting &cached) const
+{
+	const Body *b = attrs.body;
+	const size_t numLights = m_lightSources.size();
+
+	bool valid = cached.numLights == numLights &&
+		cached.atmosphereLighting == attrs.calcAtmosphereLighting &&
+		m_lightingFrame - cached.computedFrame < LIGHTING_CACHE_MAX_AGE;
+
+	vector3d lightPositions[MAX_LIGHTS];
+	for (size_t i = 0; i < numLights; i++) {
+		const Body *lightBody = m_lightSources[i].GetBody();
+		lightPositions[i] = lightBody ? lightBody->GetPositionRelTo(b) : vector3d(0.0);
+		const double tolerance = LIGHTING_CACHE_TOLERANCE * lightPositions[i].Length();
+		if (valid && (lightPositions[i] - cached.lightPositions[i]).LengthSqr() > tolerance * tolerance)
+			valid = false;
+	}
+
+	const vector3d bodyPosition = b->GetPosition();
+	if (valid && attrs.calcAtmosphereLighting) {
+		const double tolerance = LIGHTING_CACHE_TOLERANCE * bodyPosition.Length();
+		if (cached.bodyFrame != b->GetFrame() || (bodyPosition - cached.bodyPosition).LengthSqr() > tolerance * tolerance)
+			valid = false;
+	}
+
+	if (valid)
+		return;
+
+	double ambient = 0.05, direct = 1.0;
+	if (attrs.calcAtmosphereLighting)
+		CalcLighting(b, ambient, direct);
+
+	cached.ambient = ambient;
+	for (size_t i = 0; i < numLights; i++) {
+		cached.lightIntensities[i] = direct * ShadowedIntensity(i, b);
+		cached.lightPositions[i] = lightPositions[i];
+	}
+	cached.numLights = numLights;
+	cached.bodyPosition = bodyPosition;
+	cached.bodyFrame = b->GetFrame();
+	cached.atmosphereLighting = attrs.calcAtmosphereLighting;
+	cached.computedFrame = m_lightingFrame;
 }
 
 // Calculates the ambiently and directly lit portions of the lighting model taking into account the atmosphere and sun positions at a given location
@@ -447,6 +648,41 @@ void Camera::CalcLighting(const Body *b, double &ambient, double &direct) const
 	ambient = std::max(minAmbient, ambient);
 }
 
+// Finds the bodies that can cast shadows, and where they and the lights are,
+// once for all the bodies lit this frame
+void Camera::PrepareOccluders()
+{
+	m_rootFrame = Pi::game->GetSpace()->GetRootFrame();
+	m_occluders.clear();
+	for (const Body *b : Pi::game->GetSpace()->GetBodies()) {
+		if (b->IsType(ObjectType::PLANET) || b->IsType(ObjectType::STAR))
+			m_occluders.push_back({ b, b->GetSystemBody()->GetRadius(), b->GetPositionRelTo(m_rootFrame) });
+	}
+
+	assert(m_lightSources.size() <= MAX_LIGHTS);
+	for (size_t i = 0; i < m_lightSources.size(); i++) {
+		const Body *lightBody = m_lightSources[i].GetBody();
+		m_lightRootPositions[i] = lightBody ? lightBody->GetPositionRelTo(m_rootFrame) : vector3d(0.0);
+	}
+}
+
+bool Camera::IsShadowSetValid(const ShadowSet &set, const Body *lightBody, const vector3d &lightDir, const vector3d &bRootPos) const
+{
+	static const double minCos = cos(SHADOW_CACHE_ANGLE);
+	if (!set.valid || set.lightBody != lightBody || m_lightingFrame - set.solvedFrame >= SHADOW_CACHE_MAX_AGE)
+		return false;
+	if (set.lightDir.Dot(lightDir) < minCos)
+		return false;
+
+	for (const auto &near : set.nearOccluders) {
+		const Body *b2 = near.first;
+		auto it = std::find_if(m_occluders.begin(), m_occluders.end(), [b2](const Occluder &o) { return o.body == b2; });
+		if (it == m_occluders.end() || near.second.Dot((it->rootPosition - bRootPos).Normalized()) < minCos)
+			return false;
+	}
+	return true;
+}
+
 void Camera::CalcShadows(const int lightNum, const Body *b, std::vector<Shadow> &shadowsOut) const
 {
 	// Set up data for eclipses. All bodies are assumed to be spheres.
@@ -454,9 +690,37 @@ void Camera::CalcShadows(const int lightNum, const Body *b, std::vector<Shadow>
 	if (!lightBody)
 		return;
 
+	// Work in the root frame, where the occluders are already placed, and
+	// turn the shadows into b's frame at the end
+	const vector3d bRootPos = b->GetPositionRelTo(m_rootFrame);
+	const vector3d bLightPos = m_lightRootPositions[lightNum] - bRootPos;
+	const double lightDist = bLightPos.Length();
+	const vector3d lightDir = bLightPos / lightDist;
+	const matrix3x3d toBodyFrame = Frame::GetFrame(m_rootFrame)->GetOrientRelTo(b->GetFrame());
+
+	// The shadows of bodies being drawn are kept in their lighting cache.
+	// Only ever look the entry up: this runs in parallel for many bodies.
+	ShadowSet *set = nullptr;
+	auto cached = m_lightingCache.find(b);
+	if (cached != m_lightingCache.end())
+		set = &cached->second.shadowSets[lightNum];
+
+	if (set && IsShadowSetValid(*set, lightBody, lightDir, bRootPos)) {
+		for (const Shadow &shadow : set->shadows)
+			shadowsOut.push_back({ toBodyFrame * shadow.centre, shadow.srad, shadow.lrad });
+		return;
+	}
+
+	if (set) {
+		set->valid = true;
+		set->lightBody = lightBody;
+		set->lightDir = lightDir;
+		set->nearOccluders.clear();
+		set->shadows.clear();
+		set->solvedFrame = m_lightingFrame;
+	}
+
 	const double lightRadius = lightBody->GetPhysRadius();
-	const vector3d bLightPos = lightBody->GetPositionRelTo(b);
-	const vector3d lightDir = bLightPos.Normalized();
 
 	double bRadius;
 	if (b->IsType(ObjectType::TERRAINBODY))
@@ -465,18 +729,31 @@ void Camera::CalcShadows(const int lightNum, const Body *b, std::vector<Shadow>
 		bRadius = b->GetPhysRadius();
 
 	// Look for eclipsing third bodies:
-	for (const Body *b2 : Pi::game->GetSpace()->GetBodies()) {
-		if (b2 == b || b2 == lightBody || !(b2->IsType(ObjectType::PLANET) || b2->IsType(ObjectType::STAR)))
+	for (const Occluder &occluder : m_occluders) {
+		const Body *b2 = occluder.body;
+		if (b2 == b || b2 == lightBody)
 			continue;
 
-		double b2Radius = b2->GetSystemBody()->GetRadius();
-		vector3d b2pos = b2->GetPositionRelTo(b);
+		const double b2Radius = occluder.radius;
+		const vector3d b2pos = occluder.rootPosition - bRootPos;
 		const double perpDist = lightDir.Dot(b2pos);
 
-		if (perpDist <= 0 || perpDist > bLightPos.Length())
+		if (perpDist <= 0 || perpDist > lightDist)
 			// b2 isn't between b and lightBody; no eclipse
 			continue;
 
+		// Bounding cone: b2 can only eclipse b if it comes within the sum of
+		// the radii of b, b2 and the light disc at b2's distance of the line
+		// from b to the light
+		const double lateralSqr = std::max(0.0, b2pos.LengthSqr() - perpDist * perpDist);
+		const double reach = bRadius + b2Radius + lightRadius * perpDist / lightDist;
+		if (lateralSqr > reach * reach * SHADOW_NEAR_CONE_FACTOR * SHADOW_NEAR_CONE_FACTOR)
+			continue;
+		if (set)
+			set->nearOccluders.emplace_back(b2, b2pos.Normalized());
+		if (lateralSqr > reach * reach)
+			continue;
+
 		// Project to the plane perpendicular to lightDir, taking the line between the shadowed sphere
 		// (b) and the light source as zero. Our calculations assume that the light source is at
 		// infinity. All lengths are normalised such that b has radius 1. srad is then the radius of the
@@ -487,7 +764,7 @@ void Camera::CalcShadows(const int lightNum, const Body *b, std::vector<Shadow>
 		// disc of radius srad centred at projectedCentre-p. To determine the light intensity at p, we
 		// then just need to estimate the proportion of the light disc being occulted.
 		const double srad = b2Radius / bRadius;
-		const double lrad = (lightRadius / bLightPos.Length()) * perpDist / bRadius;
+		const double lrad = (lightRadius / lightDist) * perpDist / bRadius;
 		if (srad / lrad < 0.01) {
 			// any eclipse would have negligible effect - ignore
 			continue;
@@ -496,6 +773,9 @@ void Camera::CalcShadows(const int lightNum, const Body *b, std::vector<Shadow>
 		if (projectedCentre.Length() < 1 + srad + lrad) {
 			// some part of b is (partially) eclipsed
 			Camera::Shadow shadow = { projectedCentre, static_cast<float>(srad), static_cast<float>(lrad) };
+			if (set)
+				set->shadows.push_back(shadow);
+			shadow.centre = toBodyFrame * projectedCentre;
 			shadowsOut.push_back(shadow);
 		}
 	}
@@ -526,7 +806,8 @@ float discCovered(const float dist, const float rad)
 	return Clamp((th + radsq * th2 - dist * d) / float(M_PI), 0.f, 1.f);
 }
 
-static std::vector<Camera::Shadow> shadows;
+// reused between calls; each thread working out lighting has its own
+static thread_local std::vector<Camera::Shadow> shadows;
 
 float Camera::ShadowedIntensity(const int lightNum, const Body *b) const
 {
@@ -540,7 +821,7 @@ float Camera::ShadowedIntensity(const int lightNum, const Body *b) const
 }
 
 // PrincipalShadows(b,n): returns the n biggest shadows on b in order of size
-void Camera::PrincipalShadows(const Body *b, const int n, std::vector<Shadow> &shadowsOut) const
+void Camera::PrincipalShadows(const Body *b, const int n, ShadowList &shadowsOut) const
 {
 	shadows.clear();
 	shadows.reserve(16);
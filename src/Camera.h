@@ -7,13 +7,14 @@
 #include "Color.h"
 #include "FrameId.h"
 #include "RefCounted.h"
+#include "core/FrameArena.h"
 #include "graphics/Frustum.h"
 #include "graphics/Light.h"
 #include "matrix4x4.h"
 #include "vector3.h"
 
-#include <list>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 class Body;
@@ -117,13 +118,68 @@ public:
 	void CalcLighting(const Body *b, double &ambient, double &direct) const;
 	void CalcShadows(const int lightNum, const Body *b, std::vector<Shadow> &shadowsOut) const;
 	float ShadowedIntensity(const int lightNum, const Body *b) const;
-	void PrincipalShadows(const Body *b, const int n, std::vector<Shadow> &shadowsOut) const;
+	// the shadows on a body while drawing it, in frame memory
+	typedef FrameVector<Shadow> ShadowList;
+	void PrincipalShadows(const Body *b, const int n, ShadowList &shadowsOut) const;
 
 	// lights with properties in camera space
 	const std::vector<LightSource> &GetLightSources() const { return m_lightSources; }
 	int GetNumLightSources() const { return static_cast<Uint32>(m_lightSources.size()); }
 
 private:
+	// at most this many system lights are picked
+	static constexpr size_t MAX_LIGHTS = 4;
+
+	// A planet or star that can cast shadows, where it is this frame
+	struct Occluder {
+		const Body *body;
+		double radius;
+		vector3d rootPosition;
+	};
+
+	// The shadows cast on a body by one light, kept until the light or one
+	// of the occluders near its cone has turned by more than a threshold as
+	// seen from the body. Directions and shadow centres are in root frame
+	// coordinates, so the body turning doesn't count as a change.
+	struct ShadowSet {
+		bool valid = false;
+		const Body *lightBody;
+		vector3d lightDir;
+		// occluders close enough to the cone to the light to cast a shadow
+		// soon, and their directions when solved
+		std::vector<std::pair<const Body *, vector3d>> nearOccluders;
+		std::vector<Shadow> shadows;
+		Uint32 solvedFrame;
+	};
+
+	// The light on a body, kept from frame to frame while the body hasn't
+	// moved relative to the lights by more than a tolerance
+	struct CachedLighting {
+		double ambient;
+		float lightIntensities[MAX_LIGHTS];
+
+		// what it was computed from: the lights relative to the body, and
+		// the body in its frame for atmosphere lighting
+		size_t numLights;
+		vector3d lightPositions[MAX_LIGHTS];
+		vector3d bodyPosition;
+		FrameId bodyFrame;
+		bool atmosphereLighting;
+
+		Uint32 computedFrame;
+		Uint32 usedFrame;
+
+		ShadowSet shadowSets[MAX_LIGHTS];
+	};
+
+	struct BodyAttrs;
+
+	bool EvaluateBody(Body *b, FrameId camFrame, BodyAttrs &attrs) const;
+	void PrepareLighting(const Body *excludeBody);
+	void UpdateLighting(const BodyAttrs &attrs, CachedLighting &cached) const;
+	void PrepareOccluders();
+	bool IsShadowSetValid(const ShadowSet &set, const Body *lightBody, const vector3d &lightDir, const vector3d &bRootPos) const;
+
 	RefCountedPtr<CameraContext> m_context;
 	Graphics::Renderer *m_renderer;
 
@@ -152,6 +208,9 @@ private:
 		float billboardSize;
 		Color billboardColor;
 
+		// set by PrepareLighting for the bodies drawn as models
+		CachedLighting *lighting;
+
 		// for sorting. "should a be drawn before b?"
 		// NOTE: Add below function (thus an indirection) in order
 		// to decouple Camera from Body.h
@@ -162,8 +221,21 @@ private:
 		};
 	};
 
-	std::list<BodyAttrs> m_sortedBodies;
+	std::vector<BodyAttrs> m_sortedBodies;
+	// which bodies are drawn, by their index in the space, while updating
+	std::vector<Uint8> m_bodyVisible;
 	std::vector<LightSource> m_lightSources;
+	// the lights of explosions and the like, for the clustered lighting
+	std::vector<Graphics::PointLight> m_pointLights;
+
+	// for the shadows of this frame
+	FrameId m_rootFrame;
+	std::vector<Occluder> m_occluders;
+	vector3d m_lightRootPositions[MAX_LIGHTS];
+
+	// mutable for the shadow sets, which CalcShadows fills in
+	mutable std::unordered_map<const Body *, CachedLighting> m_lightingCache;
+	Uint32 m_lightingFrame = 0;
 };
 
 #endif
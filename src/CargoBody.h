@@ -4,6 +4,7 @@
 #ifndef _CARGOBODY_H
 #define _CARGOBODY_H
 
+#include "BodyPool.h"
 #include "DynamicBody.h"
 #include "lua/LuaRef.h"
 
@@ -14,6 +15,7 @@ namespace Graphics {
 class CargoBody : public DynamicBody {
 public:
 	OBJDEF(CargoBody, DynamicBody, CARGOBODY);
+	POOLED_BODY(CargoBody, CARGOBODY);
 	CargoBody() = delete;
 	CargoBody(const LuaRef &cargo, float selfdestructTimer = 86400.0f);						   // default to 24 h lifetime
 	CargoBody(const char *modelName, const LuaRef &cargo, float selfdestructTimer = 86400.0f); // default to 24 h lifetime
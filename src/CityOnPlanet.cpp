@@ -27,6 +27,10 @@
 
 #include "utils.h"
 
+// buildings that look smaller than this from the nearest point of their cell
+// (radius over distance) are not drawn
+static constexpr double MIN_BUILDING_SIZE = 1.0 / 400.0;
+
 std::vector<CityOnPlanet::CityFlavourType> CityOnPlanet::s_cityFlavours;
 std::unique_ptr<Graphics::Material> CityOnPlanet::s_debugMat;
 
@@ -74,13 +78,51 @@ void CityOnPlanet::AddStaticGeomsToCollisionSpace()
 		}
 	}
 
+	UpdateRenderCells();
+
 	// reset the reset flag
 	m_detailLevel = Pi::detail.cities;
 }
 
+void CityOnPlanet::UpdateRenderCells()
+{
+	PROFILE_SCOPED()
+	m_renderCells.clear();
+	m_renderCells.resize(m_numRenderCells);
+	for (uint32_t i = 0; i < m_enabledBuildings.size(); i++)
+		m_renderCells[m_enabledBuildings[i].renderCell].buildings.push_back(i);
+
+	for (RenderCell &cell : m_renderCells) {
+		if (cell.buildings.empty())
+			continue;
+
+		Aabb aabb;
+		for (uint32_t index : cell.buildings)
+			aabb.Update(m_enabledBuildings[index].pos);
+		cell.centre = aabb.min + (aabb.max - aabb.min) * 0.5;
+
+		cell.radius = 0.0;
+		for (uint32_t index : cell.buildings) {
+			const BuildingInstance &building = m_enabledBuildings[index];
+			cell.radius = std::max(cell.radius, (building.pos - cell.centre).Length() + building.clipRadius);
+		}
+
+		// the detail falloff only has to look at the start of the list
+		std::sort(cell.buildings.begin(), cell.buildings.end(), [this](uint32_t a, uint32_t b) {
+			return m_enabledBuildings[a].clipRadius > m_enabledBuildings[b].clipRadius;
+		});
+	}
+
+	m_renderCells.erase(std::remove_if(m_renderCells.begin(), m_renderCells.end(), [](const RenderCell &cell) {
+		return cell.buildings.empty();
+	}),
+		m_renderCells.end());
+}
+
 void CityOnPlanet::RemoveStaticGeomsFromCollisionSpace()
 {
 	m_enabledBuildings.clear();
+	m_renderCells.clear();
 	for (unsigned int i = 0; i < m_buildings.size(); i++) {
 		Frame *f = Frame::GetFrame(m_frame);
 		f->RemoveStaticGeom(m_buildings[i].geom);
@@ -104,6 +146,7 @@ void CityOnPlanet::LoadBuildingType(std::string_view key, const Json &buildingDe
 	}
 
 	out.model = Pi::FindModel(modelPath);
+	Pi::modelCache->PinModel(out.model);
 
 	if (!out.model->GetCollisionMesh().Get()) {
 		out.model->CreateCollisionMesh();
@@ -351,6 +394,9 @@ void CityOnPlanet::Generate(SpaceStation *station)
 	m_citySize = cityExtents * 2;
 	m_gridPitch = std::ceil(m_citySize / 8.0);
 
+	const uint32_t renderCellsPerRow = (m_citySize + RENDER_CELLS - 1) / RENDER_CELLS;
+	m_numRenderCells = renderCellsPerRow * renderCellsPerRow;
+
 	Log::Verbose("Generating City for spacestation {}", station->GetSystemBody()->GetName());
 	Log::Verbose("\tpopulation: {0} size {1}x{1}c (radius {2})",
 		m_body->GetPopulation(), m_citySize, m_cityRadius);
@@ -536,7 +582,8 @@ void CityOnPlanet::Generate(SpaceStation *station)
 			Geom *geom = new Geom(cmesh->GetGeomTree(), orientcalc[orient], pos, GetPlanet());
 
 			// add it to the list of buildings to render
-			m_buildings.push_back({ typeIndex, float(cmesh->GetRadius()), orient, pos, geom });
+			const uint32_t renderCell = (y / RENDER_CELLS) * renderCellsPerRow + x / RENDER_CELLS;
+			m_buildings.push_back({ typeIndex, float(cmesh->GetRadius()), orient, pos, geom, renderCell });
 
 		}
 	}
@@ -700,17 +747,30 @@ void CityOnPlanet::Render(Graphics::Renderer *r, const Graphics::Frustum &frustu
 		transform[i].reserve(m_buildingCounts[i]);
 	}
 
-	for (const auto &building : m_enabledBuildings) {
-		const vector3d pos = viewTransform * building.pos;
-
-		if (!frustum.TestPoint(pos, building.clipRadius))
+	for (const RenderCell &cell : m_renderCells) {
+		const vector3d cellPos = viewTransform * cell.centre;
+		if (!frustum.TestPoint(cellPos, cell.radius))
 			continue;
 
-		matrix4x4f instanceRot = matrix4x4f(rotf[building.rotation]);
-		instanceRot.SetTranslate(vector3f(pos));
+		// the buildings of a cell that is entirely in view don't need testing
+		const bool contained = frustum.TestPointContained(cellPos, cell.radius);
+		const double minRadius = std::max(cellPos.Length() - cell.radius, 0.0) * MIN_BUILDING_SIZE;
 
-		transform[building.instIndex].push_back(instanceRot);
-		++uCount;
+		for (uint32_t index : cell.buildings) {
+			const BuildingInstance &building = m_enabledBuildings[index];
+			if (building.clipRadius < minRadius)
+				break;
+
+			const vector3d pos = viewTransform * building.pos;
+			if (!contained && !frustum.TestPoint(pos, building.clipRadius))
+				continue;
+
+			matrix4x4f instanceRot = matrix4x4f(rotf[building.rotation]);
+			instanceRot.SetTranslate(vector3f(pos));
+
+			transform[building.instIndex].push_back(instanceRot);
+			++uCount;
+		}
 	}
 
 	// render the building models using instancing
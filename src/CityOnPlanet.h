@@ -55,6 +55,8 @@ public:
 	// maximum number of cells a single building may take up
 	static constexpr uint32_t CELLMAX = 32;
 	static constexpr uint32_t CELLMASK = CELLMAX - 1;
+	// width of a square of grid cells that is culled as a whole
+	static constexpr uint32_t RENDER_CELLS = 16;
 
 private:
 
@@ -121,8 +123,19 @@ private:
 		int rotation; // 0-3
 		vector3d pos;
 		Geom *geom;
+		uint32_t renderCell;
 	};
 
+	// the enabled buildings in one square of RENDER_CELLS grid cells
+	struct RenderCell {
+		vector3d centre;
+		double radius;
+		// indices into m_enabledBuildings, largest buildings first
+		std::vector<uint32_t> buildings;
+	};
+
+	void UpdateRenderCells();
+
 	const SystemBody *m_body;
 	Planet *m_planet;
 
@@ -136,6 +149,8 @@ private:
 	std::vector<BuildingInstance> m_buildings;
 	std::vector<BuildingInstance> m_enabledBuildings;
 	std::vector<Uint32> m_buildingCounts;
+	std::vector<RenderCell> m_renderCells;
+	uint32_t m_numRenderCells;
 
 	// bitmask occupancy grid for quick population of the city
 	std::unique_ptr<uint8_t[]> m_gridBitset;
@@ -34,12 +34,12 @@ void CollMesh::Load(Serializer::Reader &rd)
 	m_aabb.min = rd.Vector3d();
 	m_aabb.radius = rd.Double();
 
-	m_geomTree = new GeomTree(rd);
+	SetGeomTree(new GeomTree(rd));
 
 	const Uint32 numDynGeomTrees = rd.Int32();
 	m_dynGeomTrees.reserve(numDynGeomTrees);
 	for (Uint32 it = 0; it < numDynGeomTrees; ++it) {
-		m_dynGeomTrees.push_back(new GeomTree(rd));
+		AddDynGeomTree(new GeomTree(rd));
 	}
 
 	m_totalTris = rd.Int32();
@@ -48,8 +48,23 @@ void CollMesh::Load(Serializer::Reader &rd)
 CollMesh::~CollMesh()
 {
 	for (auto it = m_dynGeomTrees.begin(); it != m_dynGeomTrees.end(); ++it)
-		delete *it;
-	delete m_geomTree;
+		GeomTree::Release(*it);
+	GeomTree::Release(m_geomTree);
+}
+
+GeomTree *CollMesh::SetGeomTree(GeomTree *t)
+{
+	assert(t);
+	GeomTree::Release(m_geomTree);
+	m_geomTree = GeomTree::Share(t);
+	return m_geomTree;
+}
+
+GeomTree *CollMesh::AddDynGeomTree(GeomTree *t)
+{
+	assert(t);
+	m_dynGeomTrees.push_back(GeomTree::Share(t));
+	return m_dynGeomTrees.back();
 }
 
 const std::vector<vector3f> &CollMesh::GetGeomTreeVertices() const
@@ -22,7 +22,8 @@ class CollMesh : public RefCounted {
 public:
 	CollMesh() :
 		m_geomTree(0),
-		m_totalTris(0)
+		m_totalTris(0),
+		m_sourceHash(0)
 	{}
 	virtual ~CollMesh();
 
@@ -42,23 +43,22 @@ public:
 
 	inline GeomTree *GetGeomTree() const { return m_geomTree; }
 
-	inline void SetGeomTree(GeomTree *t)
-	{
-		assert(t);
-		m_geomTree = t;
-	}
+	// Both take ownership of a newly built tree and swap it for the shared
+	// tree with the same content (see GeomTree::Share), which is returned
+	GeomTree *SetGeomTree(GeomTree *t);
 
 	inline const std::vector<GeomTree *> &GetDynGeomTrees() const { return m_dynGeomTrees; }
-	inline void AddDynGeomTree(GeomTree *t)
-	{
-		assert(t);
-		m_dynGeomTrees.push_back(t);
-	}
+	GeomTree *AddDynGeomTree(GeomTree *t);
 
 	//for statistics
 	inline unsigned int GetNumTriangles() const { return m_totalTris; }
 	inline void SetNumTriangles(unsigned int i) { m_totalTris = i; }
 
+	//hash of the geometry the trees were built from, 0 if not known
+	//(see CollisionVisitor::CreateCollisionMesh)
+	inline uint64_t GetSourceHash() const { return m_sourceHash; }
+	inline void SetSourceHash(uint64_t hash) { m_sourceHash = hash; }
+
 	void Save(Serializer::Writer &wr) const;
 	void Load(Serializer::Reader &rd);
 
@@ -67,6 +67,7 @@ protected:
 	GeomTree *m_geomTree;
 	std::vector<GeomTree *> m_dynGeomTrees;
 	unsigned int m_totalTris;
+	uint64_t m_sourceHash;
 };
 
 #endif
@@ -0,0 +1,245 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "DiskCache.h"
+
+#include "FileSystem.h"
+#include "core/LZ4Format.h"
+#include "core/Log.h"
+#include "profiler/Profiler.h"
+#include "scenegraph/Serializer.h"
+
+#include <set>
+#include <vector>
+
+static const char INDEX_NAME[] = "index";
+
+static bool WriteFile(const std::string &path, const std::string &data)
+{
+	FILE *f = FileSystem::userFiles.OpenWriteStream(path);
+	if (!f)
+		return false;
+	const bool ok = fwrite(data.data(), data.size(), 1, f) == 1;
+	fclose(f);
+	return ok;
+}
+
+DiskCache::DiskCache(const std::string &dirName, Uint32 version) :
+	m_dirName(dirName),
+	m_version(version),
+	m_enabled(false),
+	m_maxBytes(0),
+	m_totalBytes(0)
+{
+}
+
+std::string DiskCache::GetEntryName(uint64_t key) const
+{
+	return fmt::format("{:016x}.bin", key);
+}
+
+std::string DiskCache::GetEntryPath(uint64_t key) const
+{
+	return FileSystem::JoinPath(m_dirName, GetEntryName(key));
+}
+
+void DiskCache::Evict()
+{
+	while (m_totalBytes > m_maxBytes && !m_entries.empty()) {
+		const Entry &entry = m_entries.front();
+		FileSystem::userFiles.RemoveFile(GetEntryPath(entry.key));
+		m_totalBytes -= entry.size;
+		m_entryMap.erase(entry.key);
+		m_entries.pop_front();
+	}
+}
+
+void DiskCache::Forget(uint64_t key)
+{
+	auto it = m_entryMap.find(key);
+	if (it == m_entryMap.end())
+		return;
+	m_totalBytes -= it->second->size;
+	m_entries.erase(it->second);
+	m_entryMap.erase(it);
+}
+
+void DiskCache::LoadIndex()
+{
+	RefCountedPtr<FileSystem::FileData> data = FileSystem::userFiles.ReadFile(FileSystem::JoinPath(m_dirName, INDEX_NAME));
+	if (!data)
+		return;
+
+	try {
+		Serializer::Reader rd(data->AsByteRange());
+		if (rd.Int32() != m_version)
+			return;
+		const Uint32 numEntries = rd.Int32();
+		for (Uint32 i = 0; i < numEntries; i++) {
+			Entry entry;
+			entry.key = rd.Int64();
+			entry.size = rd.Int32();
+			if (m_entryMap.count(entry.key))
+				continue;
+			m_entries.push_back(entry);
+			m_entryMap[entry.key] = std::prev(m_entries.end());
+			m_totalBytes += entry.size;
+		}
+	} catch (const std::out_of_range &) {
+		Log::Warning("DiskCache: ignoring truncated index in {}\n", m_dirName);
+	}
+}
+
+void DiskCache::SaveIndex()
+{
+	Serializer::Writer wr;
+	wr.Int32(m_version);
+	wr.Int32(Uint32(m_entries.size()));
+	for (const Entry &entry : m_entries) {
+		wr.Int64(entry.key);
+		wr.Int32(Uint32(entry.size));
+	}
+
+	if (!WriteFile(FileSystem::JoinPath(m_dirName, INDEX_NAME), wr.GetData()))
+		Log::Warning("DiskCache: could not write index in {}\n", m_dirName);
+}
+
+// Delete files not listed in the index and drop index entries without files
+void DiskCache::RemoveUnknownFiles()
+{
+	std::set<std::string> names;
+	for (const Entry &entry : m_entries)
+		names.insert(GetEntryName(entry.key));
+
+	std::set<std::string> found;
+	std::vector<FileSystem::FileInfo> files;
+	FileSystem::userFiles.ReadDirectory(m_dirName, files);
+	for (const FileSystem::FileInfo &info : files) {
+		if (!info.IsFile() || info.GetName() == INDEX_NAME)
+			continue;
+		if (names.count(info.GetName()))
+			found.insert(info.GetName());
+		else
+			FileSystem::userFiles.RemoveFile(info.GetPath());
+	}
+
+	for (auto it = m_entries.begin(); it != m_entries.end();) {
+		const Entry &entry = *(it++);
+		if (!found.count(GetEntryName(entry.key)))
+			Forget(entry.key);
+	}
+}
+
+void DiskCache::Init(size_t maxBytes)
+{
+	PROFILE_SCOPED()
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_maxBytes = maxBytes;
+	m_enabled = maxBytes > 0 && FileSystem::userFiles.MakeDirectory(m_dirName);
+	if (!m_enabled)
+		return;
+
+	LoadIndex();
+	RemoveUnknownFiles();
+	Evict();
+	Log::Verbose("DiskCache {}: {} entries, {:.1f} of {:.1f} MB\n", m_dirName, m_entries.size(), m_totalBytes / (1024.0 * 1024.0), m_maxBytes / (1024.0 * 1024.0));
+}
+
+void DiskCache::Uninit()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (m_enabled)
+		SaveIndex();
+
+	m_enabled = false;
+	m_totalBytes = 0;
+	m_entries.clear();
+	m_entryMap.clear();
+}
+
+bool DiskCache::IsEnabled() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_enabled;
+}
+
+size_t DiskCache::GetSize() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_totalBytes;
+}
+
+bool DiskCache::Load(uint64_t key, std::string &data)
+{
+	PROFILE_SCOPED()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto it = m_entryMap.find(key);
+		if (!m_enabled || it == m_entryMap.end())
+			return false;
+
+		// mark as most recently used
+		m_entries.splice(m_entries.end(), m_entries, it->second);
+	}
+
+	RefCountedPtr<FileSystem::FileData> file = FileSystem::userFiles.ReadFile(GetEntryPath(key));
+	bool valid = false;
+	if (file) {
+		try {
+			const std::string contents = lz4::DecompressLZ4(file->AsStringView());
+			Serializer::Reader rd(ByteRange(contents.data(), contents.size()));
+			valid = rd.Int32() == m_version && rd.Int64() == key;
+			if (valid) {
+				const ByteRange blob = rd.Blob();
+				data.assign(blob.begin, blob.Size());
+			}
+		} catch (const std::exception &) {
+			valid = false;
+		}
+	}
+
+	if (!valid)
+		Remove(key);
+	return valid;
+}
+
+void DiskCache::Store(uint64_t key, const std::string &data)
+{
+	PROFILE_SCOPED()
+	if (!IsEnabled())
+		return;
+
+	Serializer::Writer wr;
+	wr.Int32(m_version);
+	wr.Int64(key);
+	wr.Blob(ByteRange(data.data(), data.size()));
+
+	std::string compressed;
+	try {
+		compressed = lz4::CompressLZ4(wr.GetData(), 0);
+	} catch (const lz4::CompressionFailedException &) {
+		return;
+	}
+
+	// callers never store the same key from two threads at once, so nobody
+	// else reads or writes this file until it is added to the index
+	if (!WriteFile(GetEntryPath(key), compressed))
+		return;
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (!m_enabled)
+		return;
+
+	Forget(key);
+	m_entries.push_back({ key, compressed.size() });
+	m_entryMap[key] = std::prev(m_entries.end());
+	m_totalBytes += compressed.size();
+	Evict();
+}
+
+void DiskCache::Remove(uint64_t key)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	Forget(key);
+	FileSystem::userFiles.RemoveFile(GetEntryPath(key));
+}
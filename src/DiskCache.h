@@ -0,0 +1,69 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _DISKCACHE_H
+#define _DISKCACHE_H
+
+#include <SDL_stdinc.h>
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Thread-safe, size limited cache of generated data, stored LZ4-compressed
+// as one file per entry in a directory of the user files.
+//
+// Entries are evicted least-recently-used first once the cache grows beyond
+// its size limit. The order of use is kept in an index file written by
+// Uninit(); files the index doesn't know about (e.g. after a crash) are
+// removed by the next Init(). Entries written with a different version are
+// ignored, so bump it whenever the layout or generation of the data changes.
+class DiskCache {
+public:
+	DiskCache(const std::string &dirName, Uint32 version);
+
+	// Enable the cache with the given size limit; 0 disables it
+	void Init(size_t maxBytes);
+	void Uninit();
+
+	bool IsEnabled() const;
+	// Total size of the cached files, in bytes
+	size_t GetSize() const;
+
+	// Fetch the data stored for key. Returns false if there is no valid entry.
+	bool Load(uint64_t key, std::string &data);
+	void Store(uint64_t key, const std::string &data);
+	// Drop an entry, e.g. because its data turned out to be unusable
+	void Remove(uint64_t key);
+
+private:
+	struct Entry {
+		uint64_t key;
+		size_t size;
+	};
+
+	std::string GetEntryName(uint64_t key) const;
+	std::string GetEntryPath(uint64_t key) const;
+
+	// these are called with m_lock held
+	void Evict();
+	void Forget(uint64_t key);
+	void LoadIndex();
+	void SaveIndex();
+	void RemoveUnknownFiles();
+
+	const std::string m_dirName;
+	const Uint32 m_version;
+
+	mutable std::mutex m_lock;
+	bool m_enabled;
+	size_t m_maxBytes;
+	size_t m_totalBytes;
+	// least recently used entries first
+	std::list<Entry> m_entries;
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> m_entryMap;
+};
+
+#endif /* _DISKCACHE_H */
@@ -14,6 +14,8 @@
 
 static const float KINETIC_ENERGY_MULT = 0.00001f;
 const double DynamicBody::DEFAULT_DRAG_COEFF = 0.1; // 'smooth sphere'
+bool DynamicBody::s_deferIntegration = false;
+static PhysicsStore &s_physics = PhysicsStore::Get();
 
 DynamicBody::DynamicBody() :
 	ModelBody()
@@ -21,20 +23,14 @@ DynamicBody::DynamicBody() :
 	m_dragCoeff = DEFAULT_DRAG_COEFF;
 	m_flags = Body::FLAG_CAN_MOVE_FRAME;
 	m_oldPos = GetPosition();
-	m_oldAngDisplacement = vector3d(0.0);
-	m_force = vector3d(0.0);
-	m_torque = vector3d(0.0);
-	m_vel = vector3d(0.0);
-	m_angVel = vector3d(0.0);
-	m_mass = 1;
-	m_angInertia = 1;
+	// a new entry is a moving body at rest with unit mass and inertia, and
+	// without external forces (do external forces calc instead?)
+	m_physics = s_physics.Add();
 	m_massRadius = 1;
-	m_isMoving = true;
+	m_onRails = false;
+	m_railsTime = 0.0;
 	m_atmosForce = vector3d(0.0);
 	m_gravityForce = vector3d(0.0);
-	m_externalForce = vector3d(0.0); // do external forces calc instead?
-	m_lastForce = vector3d(0.0);
-	m_lastTorque = vector3d(0.0);
 	m_aiMessage = AIError::AIERROR_NONE;
 	m_decelerating = false;
 }
@@ -42,35 +38,36 @@ DynamicBody::DynamicBody() :
 DynamicBody::DynamicBody(const Json &jsonObj, Space *space) :
 	ModelBody(jsonObj, space),
 	m_dragCoeff(DEFAULT_DRAG_COEFF),
-	m_externalForce(vector3d(0.0)),
+	m_physics(s_physics.Add()),
+	m_onRails(false),
+	m_railsTime(0.0),
 	m_atmosForce(vector3d(0.0)),
-	m_gravityForce(vector3d(0.0)),
-	m_lastForce(vector3d(0.0)),
-	m_lastTorque(vector3d(0.0))
+	m_gravityForce(vector3d(0.0))
 {
 	m_flags = Body::FLAG_CAN_MOVE_FRAME;
 	m_oldPos = GetPosition();
-	m_oldAngDisplacement = vector3d(0.0);
 
 	try {
 		Json dynamicBodyObj = jsonObj["dynamic_body"];
 
-		m_force = dynamicBodyObj["force"];
-		m_torque = dynamicBodyObj["torque"];
-		m_vel = dynamicBodyObj["vel"];
-		m_angVel = dynamicBodyObj["ang_vel"];
-		m_mass = dynamicBodyObj["mass"];
+		s_physics.force[m_physics] = dynamicBodyObj["force"];
+		s_physics.torque[m_physics] = dynamicBodyObj["torque"];
+		s_physics.vel[m_physics] = dynamicBodyObj["vel"];
+		s_physics.angVel[m_physics] = dynamicBodyObj["ang_vel"];
+		s_physics.mass[m_physics] = dynamicBodyObj["mass"];
 		m_massRadius = dynamicBodyObj["mass_radius"];
-		m_angInertia = dynamicBodyObj["ang_inertia"];
+		s_physics.angInertia[m_physics] = dynamicBodyObj["ang_inertia"];
+		s_physics.invMass[m_physics] = 1.0 / s_physics.mass[m_physics];
+		s_physics.invAngInertia[m_physics] = 1.0 / s_physics.angInertia[m_physics];
 		SetMoving(dynamicBodyObj["is_moving"]);
 	} catch (Json::type_error &) {
 		throw SavedGameCorruptException();
 	}
 
 	// fix saves with nans
-	// SAVEBUMP: This can be removed starting with save version 91
-	if (std::isnan(m_angVel.x) || std::isnan(m_angVel.y) || std::isnan(m_angVel.z)) {
-		m_angVel = vector3d(0.0);
+	// SAVEBUMP: This can be removed once version 90 saves are no longer loaded
+	if (std::isnan(s_physics.angVel[m_physics].x) || std::isnan(s_physics.angVel[m_physics].y) || std::isnan(s_physics.angVel[m_physics].z)) {
+		s_physics.angVel[m_physics] = vector3d(0.0);
 	}
 
 	m_aiMessage = AIError::AIERROR_NONE;
@@ -79,13 +76,13 @@ DynamicBody::DynamicBody(const Json &jsonObj, Space *space) :
 
 void DynamicBody::SetMoving(bool isMoving)
 {
-	m_isMoving = isMoving;
+	s_physics.moving[m_physics] = isMoving;
 
-	if (!m_isMoving) {
-		m_vel = vector3d(0.0);
-		m_angVel = vector3d(0.0);
-		m_force = vector3d(0.0);
-		m_torque = vector3d(0.0);
+	if (!s_physics.moving[m_physics]) {
+		s_physics.vel[m_physics] = vector3d(0.0);
+		s_physics.angVel[m_physics] = vector3d(0.0);
+		s_physics.force[m_physics] = vector3d(0.0);
+		s_physics.torque[m_physics] = vector3d(0.0);
 	}
 }
 
@@ -95,14 +92,14 @@ void DynamicBody::SaveToJson(Json &jsonObj, Space *space)
 
 	Json dynamicBodyObj = Json::object(); // Create JSON object to contain dynamic body data.
 
-	dynamicBodyObj["force"] = m_force;
-	dynamicBodyObj["torque"] = m_torque;
-	dynamicBodyObj["vel"] = m_vel;
-	dynamicBodyObj["ang_vel"] = m_angVel;
-	dynamicBodyObj["mass"] = m_mass;
+	dynamicBodyObj["force"] = s_physics.force[m_physics];
+	dynamicBodyObj["torque"] = s_physics.torque[m_physics];
+	dynamicBodyObj["vel"] = s_physics.vel[m_physics];
+	dynamicBodyObj["ang_vel"] = s_physics.angVel[m_physics];
+	dynamicBodyObj["mass"] = s_physics.mass[m_physics];
 	dynamicBodyObj["mass_radius"] = m_massRadius;
-	dynamicBodyObj["ang_inertia"] = m_angInertia;
-	dynamicBodyObj["is_moving"] = m_isMoving;
+	dynamicBodyObj["ang_inertia"] = s_physics.angInertia[m_physics];
+	dynamicBodyObj["is_moving"] = s_physics.moving[m_physics];
 
 	jsonObj["dynamic_body"] = dynamicBodyObj; // Add dynamic body object to supplied object.
 }
@@ -128,50 +125,56 @@ void DynamicBody::PostLoadFixup(Space *space)
 
 DynamicBody::~DynamicBody()
 {
+	s_physics.Remove(m_physics);
 }
 
 void DynamicBody::SetForce(const vector3d &f)
 {
-	m_force = f;
+	s_physics.force[m_physics] = f;
 }
 
 void DynamicBody::AddForce(const vector3d &f)
 {
-	m_force += f;
+	s_physics.force[m_physics] += f;
 }
 
 void DynamicBody::AddTorque(const vector3d &t)
 {
-	m_torque += t;
+	s_physics.torque[m_physics] += t;
 }
 
 void DynamicBody::AddRelForce(const vector3d &f)
 {
-	m_force += GetOrient() * f;
+	s_physics.force[m_physics] += GetOrient() * f;
 }
 
 void DynamicBody::AddRelTorque(const vector3d &t)
 {
-	m_torque += GetOrient() * t;
+	s_physics.torque[m_physics] += GetOrient() * t;
 }
 
 void DynamicBody::SetTorque(const vector3d &t)
 {
-	m_torque = t;
+	s_physics.torque[m_physics] = t;
 }
 
 void DynamicBody::SetMass(double mass)
 {
-	m_mass = mass;
+	const double angInertia = (2 / 5.0) * mass * m_massRadius * m_massRadius;
+	s_physics.mass[m_physics] = mass;
+	s_physics.invMass[m_physics] = 1.0 / mass;
 	// This is solid sphere mass distribution, my friend
-	m_angInertia = (2 / 5.0) * m_mass * m_massRadius * m_massRadius;
+	s_physics.angInertia[m_physics] = angInertia;
+	s_physics.invAngInertia[m_physics] = 1.0 / angInertia;
 }
 
 void DynamicBody::SetFrame(FrameId fId)
 {
+	// the orbit is around the body of the old frame
+	StopOnRails();
 	ModelBody::SetFrame(fId);
 	// external forces will be wrong after frame transition
-	m_externalForce = m_gravityForce = m_atmosForce = vector3d(0.0);
+	s_physics.externalForce[m_physics] = m_gravityForce = m_atmosForce = vector3d(0.0);
 }
 
 double DynamicBody::CalcAtmosphericDrag(double velSqr, double area, double coeff) const
@@ -185,11 +188,11 @@ double DynamicBody::CalcAtmosphericDrag(double velSqr, double area, double coeff
 
 vector3d DynamicBody::CalcAtmosphericForce() const
 {
-	vector3d dragDir = -m_vel.NormalizedSafe();
+	vector3d dragDir = -s_physics.vel[m_physics].NormalizedSafe();
 
 	// We assume the object is a perfect sphere in the size of the clip radius.
 	// Most things are /not/ using the default DynamicBody code, but this is still better than before.
-	return CalcAtmosphericDrag(m_vel.LengthSqr(), GetClipRadius() * GetClipRadius() * M_PI, m_dragCoeff) * dragDir;
+	return CalcAtmosphericDrag(s_physics.vel[m_physics].LengthSqr(), GetClipRadius() * GetClipRadius() * M_PI, m_dragCoeff) * dragDir;
 }
 
 void DynamicBody::CalcExternalForce()
@@ -203,10 +206,10 @@ void DynamicBody::CalcExternalForce()
 		double m1m2 = GetMass() * body->GetMass();
 		double invrsqr = 1.0 / b1b2.LengthSqr();
 		double force = G * m1m2 * invrsqr;
-		m_externalForce = -b1b2 * sqrt(invrsqr) * force;
+		s_physics.externalForce[m_physics] = -b1b2 * sqrt(invrsqr) * force;
 	} else
-		m_externalForce = vector3d(0.0);
-	m_gravityForce = m_externalForce;
+		s_physics.externalForce[m_physics] = vector3d(0.0);
+	m_gravityForce = s_physics.externalForce[m_physics];
 
 	// atmospheric drag
 	if (body && f->IsRotFrame() && body->IsType(ObjectType::PLANET)) {
@@ -221,61 +224,148 @@ void DynamicBody::CalcExternalForce()
 		else
 			m_atmosForce = fAtmoForce;
 
-		m_externalForce += m_atmosForce;
+		s_physics.externalForce[m_physics] += m_atmosForce;
 	} else
 		m_atmosForce = vector3d(0.0);
 
 	// centrifugal and coriolis forces for rotating frames
 	if (f->IsRotFrame()) {
 		vector3d angRot(0, f->GetAngSpeed(), 0);
-		m_externalForce -= m_mass * angRot.Cross(angRot.Cross(GetPosition())); // centrifugal
-		m_externalForce -= 2 * m_mass * angRot.Cross(GetVelocity());		   // coriolis
+		s_physics.externalForce[m_physics] -= s_physics.mass[m_physics] * angRot.Cross(angRot.Cross(GetPosition())); // centrifugal
+		s_physics.externalForce[m_physics] -= 2 * s_physics.mass[m_physics] * angRot.Cross(GetVelocity());		   // coriolis
 	}
 }
 
 void DynamicBody::TimeStepUpdate(const float timeStep)
 {
 	m_oldPos = GetPosition();
-	if (m_isMoving) {
-		m_force += m_externalForce;
+	if (!m_onRails || !PropagateOnRails(timeStep)) {
+		StopOnRails();
+		if (s_deferIntegration)
+			s_physics.pending[m_physics] = 1;
+		else
+			IntegrateTimeStep(timeStep);
+	}
+
+	ModelBody::TimeStepUpdate(timeStep);
+}
+
+void DynamicBody::IntegrateTimeStep(const float timeStep)
+{
+	s_physics.Integrate(m_physics, timeStep);
+	FinishTimeStep(timeStep);
+}
 
-		m_vel += double(timeStep) * m_force * (1.0 / m_mass);
-		m_angVel += double(timeStep) * m_torque * (1.0 / m_angInertia);
+void DynamicBody::FinishTimeStep(const float timeStep)
+{
+	if (s_physics.moving[m_physics]) {
+		const vector3d &vel = s_physics.vel[m_physics];
+		const vector3d &angVel = s_physics.angVel[m_physics];
 
-		double len = m_angVel.Length();
+		double len = angVel.Length();
 		if (len > 1e-16) {
-			vector3d axis = m_angVel * (1.0 / len);
+			vector3d axis = angVel * (1.0 / len);
 			matrix3x3d r = matrix3x3d::Rotate(len * timeStep, axis);
 			SetOrient(r * GetOrient());
 		}
-		m_oldAngDisplacement = m_angVel * timeStep;
 
-		SetPosition(GetPosition() + m_vel * double(timeStep));
+		SetPosition(GetPosition() + vel * double(timeStep));
+		SetGeomVelocity(vel);
 
 		//if (this->IsType(ObjectType::PLAYER))
 		//Output("pos = %.1f,%.1f,%.1f, vel = %.1f,%.1f,%.1f, force = %.1f,%.1f,%.1f, external = %.1f,%.1f,%.1f\n",
-		//	pos.x, pos.y, pos.z, m_vel.x, m_vel.y, m_vel.z, m_force.x, m_force.y, m_force.z,
-		//	m_externalForce.x, m_externalForce.y, m_externalForce.z);
+		//	pos.x, pos.y, pos.z, vel.x, vel.y, vel.z, GetLastForce().x, GetLastForce().y, GetLastForce().z,
+		//	GetExternalForce().x, GetExternalForce().y, GetExternalForce().z);
 
-		m_lastForce = m_force;
-		m_lastTorque = m_torque;
-		m_force = vector3d(0.0);
-		m_torque = vector3d(0.0);
 		CalcExternalForce(); // regenerate for new pos/vel
 	} else {
-		m_oldAngDisplacement = vector3d(0.0);
+		SetGeomVelocity(vector3d(0.0));
 	}
+}
 
-	ModelBody::TimeStepUpdate(timeStep);
+bool DynamicBody::StartOnRails()
+{
+	if (m_onRails)
+		return true;
+
+	Frame *f = Frame::GetFrame(GetFrame());
+	if (!IsMoving() || !f || f->IsRotFrame() || !f->GetSystemBody())
+		return false;
+	const double centralMass = f->GetSystemBody()->GetMass();
+	if (centralMass <= 0.0)
+		return false;
+
+	// the orbit has to start where the body is, which it doesn't for
+	// degenerate cases such as falling straight down
+	const vector3d pos = GetPosition();
+	const Orbit orbit = Orbit::FromBodyState(pos, GetVelocity(), centralMass);
+	const vector3d start = orbit.OrbitalPosAtTime(0.0);
+	if (!std::isfinite(start.LengthSqr()) || (start - pos).Length() > 1e-6 * pos.Length() + 1.0)
+		return false;
+
+	m_onRails = true;
+	m_railsOrbit = orbit;
+	m_railsTime = 0.0;
+	m_railsPos = pos;
+	if (IsColliding())
+		SetGeomsEnabled(false);
+	return true;
+}
+
+void DynamicBody::StopOnRails()
+{
+	if (!m_onRails)
+		return;
+
+	m_onRails = false;
+	if (IsColliding())
+		SetGeomsEnabled(true);
+}
+
+bool DynamicBody::PropagateOnRails(const float timeStep)
+{
+	// anything else acting on the body takes it off the rails, it is then
+	// integrated as usual for this step
+	const vector3d &force = s_physics.force[m_physics];
+	const vector3d &torque = s_physics.torque[m_physics];
+	if (!force.ExactlyEqual(vector3d(0.0)) || !torque.ExactlyEqual(vector3d(0.0)) || !GetPosition().ExactlyEqual(m_railsPos))
+		return false;
+
+	const double time = m_railsTime + timeStep;
+	vector3d pos, vel;
+	m_railsOrbit.OrbitalStateAtTime(time, pos, vel);
+	if (!std::isfinite(pos.LengthSqr()) || !std::isfinite(vel.LengthSqr()))
+		return false;
+
+	// the body keeps spinning as it was
+	const vector3d &angVel = s_physics.angVel[m_physics];
+	const double len = angVel.Length();
+	if (len > 1e-16) {
+		vector3d axis = angVel * (1.0 / len);
+		matrix3x3d r = matrix3x3d::Rotate(len * timeStep, axis);
+		SetOrient(r * GetOrient());
+	}
+	s_physics.angDisplacement[m_physics] = angVel * timeStep;
+
+	m_railsTime = time;
+	m_railsPos = pos;
+	SetPosition(pos);
+	s_physics.vel[m_physics] = vel;
+	SetGeomVelocity(vel);
+
+	s_physics.lastForce[m_physics] = s_physics.externalForce[m_physics];
+	s_physics.lastTorque[m_physics] = vector3d(0.0);
+	CalcExternalForce();
+	return true;
 }
 
 void DynamicBody::UpdateInterpTransform(double alpha)
 {
 	m_interpPos = alpha * GetPosition() + (1.0 - alpha) * m_oldPos;
 
-	double len = m_oldAngDisplacement.Length() * (1.0 - alpha);
+	double len = s_physics.angDisplacement[m_physics].Length() * (1.0 - alpha);
 	if (len > 1e-16) {
-		vector3d axis = m_oldAngDisplacement.Normalized();
+		vector3d axis = s_physics.angDisplacement[m_physics].Normalized();
 		matrix3x3d rot = matrix3x3d::Rotate(-len, axis); // rotate backwards
 		m_interpOrient = rot * GetOrient();
 	} else
@@ -288,32 +378,34 @@ void DynamicBody::SetMassDistributionFromModel()
 	// XXX totally arbitrarily pick to distribute mass over a half
 	// bounding sphere area
 	m_massRadius = m->GetRadius() * 0.5f;
-	SetMass(m_mass);
+	SetMass(s_physics.mass[m_physics]);
 }
 
 vector3d DynamicBody::GetAngularMomentum() const
 {
-	return m_angInertia * m_angVel;
+	return s_physics.angInertia[m_physics] * s_physics.angVel[m_physics];
 }
 
 vector3d DynamicBody::GetVelocity() const
 {
-	return m_vel;
+	return s_physics.vel[m_physics];
 }
 
 void DynamicBody::SetVelocity(const vector3d &v)
 {
-	m_vel = v;
+	StopOnRails();
+	s_physics.vel[m_physics] = v;
+	SetGeomVelocity(v);
 }
 
 vector3d DynamicBody::GetAngVelocity() const
 {
-	return m_angVel;
+	return s_physics.angVel[m_physics];
 }
 
 void DynamicBody::SetAngVelocity(const vector3d &v)
 {
-	m_angVel = v;
+	s_physics.angVel[m_physics] = v;
 }
 
 bool DynamicBody::OnCollision(Body *o, Uint32 flags, double relVel)
@@ -327,7 +419,7 @@ bool DynamicBody::OnCollision(Body *o, Uint32 flags, double relVel)
 	if (o->IsType(ObjectType::DYNAMICBODY)) {
 		kineticEnergy = KINETIC_ENERGY_MULT * static_cast<DynamicBody *>(o)->GetMass() * relVel * relVel;
 	} else {
-		kineticEnergy = KINETIC_ENERGY_MULT * m_mass * relVel * relVel;
+		kineticEnergy = KINETIC_ENERGY_MULT * s_physics.mass[m_physics] * relVel * relVel;
 	}
 
 	// damage (kineticEnergy is being passed as a damage value) is measured in kilograms
@@ -5,6 +5,8 @@
 #define _DYNAMICBODY_H
 
 #include "ModelBody.h"
+#include "Orbit.h"
+#include "PhysicsStore.h"
 #include "matrix4x4.h"
 #include "vector3.h"
 
@@ -30,11 +32,11 @@ public:
 	void SetAngVelocity(const vector3d &v) override;
 	virtual bool OnCollision(Body *o, Uint32 flags, double relVel) override;
 	vector3d GetAngularMomentum() const;
-	double GetAngularInertia() const { return m_angInertia; }
+	double GetAngularInertia() const { return PhysicsStore::Get().angInertia[m_physics]; }
 	void SetMassDistributionFromModel();
 	void SetMoving(bool isMoving);
-	bool IsMoving() const { return m_isMoving; }
-	virtual double GetMass() const override { return m_mass; } // XXX don't override this
+	bool IsMoving() const { return PhysicsStore::Get().moving[m_physics]; }
+	virtual double GetMass() const override { return PhysicsStore::Get().mass[m_physics]; } // XXX don't override this
 	virtual void TimeStepUpdate(const float timeStep) override;
 	double CalcAtmosphericDrag(double velSqr, double area, double coeff) const;
 	void CalcExternalForce();
@@ -44,16 +46,38 @@ public:
 	void AddTorque(const vector3d &);
 	void SetForce(const vector3d &);
 	void SetTorque(const vector3d &);
-	vector3d GetLastForce() const { return m_lastForce; }
-	vector3d GetLastTorque() const { return m_lastTorque; }
+	vector3d GetLastForce() const { return PhysicsStore::Get().lastForce[m_physics]; }
+	vector3d GetLastTorque() const { return PhysicsStore::Get().lastTorque[m_physics]; }
 	// body-relative forces
 	void AddRelForce(const vector3d &);
 	void AddRelTorque(const vector3d &);
-	vector3d GetExternalForce() const { return m_externalForce; }
+	vector3d GetExternalForce() const { return PhysicsStore::Get().externalForce[m_physics]; }
 	vector3d GetAtmosForce() const { return m_atmosForce; }
 	vector3d GetGravityForce() const { return m_gravityForce; }
 	virtual void UpdateInterpTransform(double alpha) override;
 
+	// Apply the forces and torques accumulated this step to the body's
+	// velocity, position and orientation. Normally called by TimeStepUpdate;
+	// while integration is deferred TimeStepUpdate only marks the body, and
+	// Space integrates the velocities of all marked bodies in one pass of
+	// PhysicsStore::IntegratePending and then calls FinishTimeStep on each,
+	// possibly in parallel. Only touches the state of this body.
+	void IntegrateTimeStep(const float timeStep);
+	void FinishTimeStep(const float timeStep);
+	bool HasPendingIntegration() const { return PhysicsStore::Get().pending[m_physics]; }
+	static void SetDeferIntegration(bool defer) { s_deferIntegration = defer; }
+
+	// On rails, the body follows the Kepler orbit it is on around the body
+	// of its (non-rotating) frame instead of having its forces integrated,
+	// and it doesn't collide. That is exact for a body on which only the
+	// frame's gravity acts, at any time step. The body comes off the rails
+	// by itself when it changes frame, is moved or given a velocity, or
+	// when any force other than gravity is applied to it.
+	// Fails if the body can't be put on rails where it is.
+	bool StartOnRails();
+	void StopOnRails();
+	bool IsOnRails() const { return m_onRails; }
+
 	virtual void PostLoadFixup(Space *space) override;
 
 	Orbit ComputeOrbit() const;
@@ -94,24 +118,26 @@ protected:
 	AIError m_aiMessage;
 
 private:
+	// one step along the orbit; false if the body has to come off the rails
+	bool PropagateOnRails(const float timeStep);
+
 	vector3d m_oldPos;
-	vector3d m_oldAngDisplacement;
-
-	vector3d m_force;
-	vector3d m_torque;
-	vector3d m_vel;
-	vector3d m_angVel;
-	double m_mass;
-	double m_massRadius; // set in a mickey-mouse fashion from the collision mesh and used to calculate m_angInertia
-	double m_angInertia; // always sphere mass distribution
-	bool m_isMoving;
-
-	vector3d m_externalForce;
+
+	// this body's entry in the PhysicsStore, which holds its forces,
+	// velocities and mass; its angular inertia is always a sphere's
+	Uint32 m_physics;
+	double m_massRadius; // set in a mickey-mouse fashion from the collision mesh and used to calculate the angular inertia
+
+	static bool s_deferIntegration;
+
+	bool m_onRails;
+	Orbit m_railsOrbit;
+	// time along the orbit, and where the body was put last
+	double m_railsTime;
+	vector3d m_railsPos;
+
 	vector3d m_atmosForce;
 	vector3d m_gravityForce;
-	// for time accel reduction fudge
-	vector3d m_lastForce;
-	vector3d m_lastTorque;
 };
 
 #endif /* _DYNAMICBODY_H */
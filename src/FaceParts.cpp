@@ -62,6 +62,8 @@ namespace {
 				output.push_back(std::move(part));
 		}
 
+		virtual const char *GetJobName() const override { return "ScanPartJob"; }
+
 	protected:
 		std::vector<Part> &output;
 		std::vector<Part> cache;
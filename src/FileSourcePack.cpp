@@ -0,0 +1,272 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "FileSourcePack.h"
+#include "utils.h"
+#include "lz4/lz4.h"
+#include "lz4/lz4hc.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace FileSystem {
+
+	namespace {
+		const char MAGIC[8] = { 'P', 'I', 'O', 'N', 'P', 'A', 'K', '1' };
+		const size_t HEADER_SIZE = 24;
+		const size_t RECORD_SIZE = 32;
+
+		// an uncompressed entry pointing into the pack, keeping it alive
+		class FileDataPacked : public FileData {
+		public:
+			FileDataPacked(const FileInfo &info, size_t size, const char *data, std::shared_ptr<const void> pack) :
+				FileData(info, size, const_cast<char *>(data)),
+				m_pack(std::move(pack)) {}
+
+		private:
+			std::shared_ptr<const void> m_pack;
+		};
+
+		Uint64 read_le(const char *p, int bytes)
+		{
+			Uint64 value = 0;
+			for (int i = bytes - 1; i >= 0; i--)
+				value = (value << 8) | Uint8(p[i]);
+			return value;
+		}
+
+		void write_le(std::string &out, Uint64 value, int bytes)
+		{
+			for (int i = 0; i < bytes; i++)
+				out += char((value >> (8 * i)) & 0xff);
+		}
+
+		std::string pack_key(const std::string &path)
+		{
+			std::string key = NormalisePath(path);
+			if (!key.empty() && key[0] == '/')
+				key.erase(0, 1);
+			return key;
+		}
+	} // namespace
+
+	FileSourcePack::FileSourcePack(FileSourceFS &fs, const std::string &packPath) :
+		FileSource(packPath)
+	{
+		m_modTime = fs.Lookup(packPath).GetModificationTime();
+		Open(fs.MapFile(packPath));
+	}
+
+	FileSourcePack::FileSourcePack(RefCountedPtr<FileData> data, const std::string &name) :
+		FileSource(name)
+	{
+		Open(data);
+	}
+
+	FileSourcePack::~FileSourcePack()
+	{
+	}
+
+	void FileSourcePack::Open(RefCountedPtr<FileData> data)
+	{
+		m_directories[""];
+
+		if (!data) {
+			Output("FileSourcePack: unable to open '%s'\n", GetRoot().c_str());
+			return;
+		}
+
+		const char *base = data->GetData();
+		const Uint64 size = data->GetSize();
+		if (size < HEADER_SIZE || memcmp(base, MAGIC, sizeof(MAGIC)) != 0 || read_le(base + 8, 4) != VERSION) {
+			Output("FileSourcePack: '%s' is not a data pack of version %u\n", GetRoot().c_str(), VERSION);
+			return;
+		}
+
+		const Uint32 numEntries = read_le(base + 12, 4);
+		const Uint64 indexOffset = read_le(base + 16, 8);
+		if (indexOffset > size || (size - indexOffset) / RECORD_SIZE < numEntries) {
+			Output("FileSourcePack: the index of '%s' is truncated\n", GetRoot().c_str());
+			return;
+		}
+
+		const Uint64 pathsOffset = indexOffset + Uint64(numEntries) * RECORD_SIZE;
+		m_entries.reserve(numEntries);
+		m_lookup.reserve(numEntries);
+		for (Uint32 i = 0; i < numEntries; i++) {
+			const char *record = base + indexOffset + i * RECORD_SIZE;
+			Entry entry;
+			entry.offset = read_le(record, 8);
+			entry.storedSize = read_le(record + 8, 8);
+			entry.size = read_le(record + 16, 8);
+			const Uint64 pathOffset = pathsOffset + read_le(record + 24, 4);
+			const Uint64 pathLength = read_le(record + 28, 2);
+			entry.flags = read_le(record + 30, 2);
+
+			if (entry.offset > indexOffset || entry.storedSize > indexOffset - entry.offset || pathOffset + pathLength > size ||
+				((entry.flags & FLAG_LZ4) ? entry.size > LZ4_MAX_INPUT_SIZE : entry.storedSize != entry.size)) {
+				Output("FileSourcePack: entry %u of '%s' is corrupt\n", i, GetRoot().c_str());
+				m_entries.clear();
+				m_lookup.clear();
+				return;
+			}
+
+			entry.path = std::string_view(base + pathOffset, pathLength);
+			m_lookup.emplace(entry.path, Uint32(m_entries.size()));
+			m_entries.push_back(entry);
+		}
+
+		// the directories are only known from the paths of their files
+		for (const Entry &entry : m_entries) {
+			std::string path(entry.path);
+			size_t slash = path.rfind('/');
+			std::string parent = slash == std::string::npos ? std::string() : path.substr(0, slash);
+			m_directories[parent].push_back(MakeFileInfo(path, FileInfo::FT_FILE, m_modTime));
+
+			// add the directories above it, up to the first one already known
+			while (!parent.empty() && m_directories[parent].size() == 1) {
+				path = parent;
+				slash = path.rfind('/');
+				parent = slash == std::string::npos ? std::string() : path.substr(0, slash);
+				m_directories[parent].push_back(MakeFileInfo(path, FileInfo::FT_DIR, m_modTime));
+			}
+		}
+
+		for (auto &dir : m_directories)
+			std::sort(dir.second.begin(), dir.second.end());
+
+		m_pack = std::make_shared<RefCountedPtr<FileData>>(data);
+	}
+
+	const FileSourcePack::Entry *FileSourcePack::FindEntry(const std::string &path) const
+	{
+		auto it = m_lookup.find(pack_key(path));
+		return it != m_lookup.end() ? &m_entries[it->second] : nullptr;
+	}
+
+	FileInfo FileSourcePack::Lookup(const std::string &path)
+	{
+		if (FindEntry(path))
+			return MakeFileInfo(path, FileInfo::FT_FILE, m_modTime);
+		if (m_directories.count(pack_key(path)))
+			return MakeFileInfo(path, FileInfo::FT_DIR, m_modTime);
+		return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
+	}
+
+	RefCountedPtr<FileData> FileSourcePack::ReadFile(const std::string &path)
+	{
+		const Entry *entry = FindEntry(path);
+		if (!entry || !m_pack)
+			return RefCountedPtr<FileData>();
+
+		const FileInfo info = MakeFileInfo(path, FileInfo::FT_FILE, m_modTime);
+		const char *data = (*m_pack)->GetData() + entry->offset;
+		if (!(entry->flags & FLAG_LZ4))
+			return RefCountedPtr<FileData>(new FileDataPacked(info, entry->size, data, m_pack));
+
+		char *out = static_cast<char *>(std::malloc(entry->size));
+		const int read = LZ4_decompress_safe(data, out, int(entry->storedSize), int(entry->size));
+		if (read < 0 || Uint64(read) != entry->size) {
+			Output("FileSourcePack::ReadFile: couldn't decompress '%s'\n", path.c_str());
+			std::free(out);
+			return RefCountedPtr<FileData>();
+		}
+
+		return RefCountedPtr<FileData>(new FileDataMalloc(info, entry->size, out));
+	}
+
+	bool FileSourcePack::ReadDirectory(const std::string &path, std::vector<FileInfo> &output)
+	{
+		auto it = m_directories.find(pack_key(path));
+		if (it == m_directories.end())
+			return false;
+
+		output.insert(output.end(), it->second.begin(), it->second.end());
+		return true;
+	}
+
+	// static
+	bool FileSourcePack::Write(FileSource &source, const std::string &dir, FILE *out, bool compress, const std::string &exclude)
+	{
+		struct Record {
+			std::string path;
+			Uint64 offset;
+			Uint64 storedSize;
+			Uint64 size;
+			Uint16 flags;
+		};
+		std::vector<Record> records;
+
+		// the header is written last, once the index offset is known
+		Uint64 offset = PAGE_SIZE;
+		std::vector<char> padding(PAGE_SIZE, 0);
+		if (fwrite(padding.data(), 1, PAGE_SIZE, out) != PAGE_SIZE)
+			return false;
+
+		std::vector<char> compressed;
+		for (FileEnumerator files(source, dir, FileEnumerator::Recurse); !files.Finished(); files.Next()) {
+			const FileInfo &info = files.Current();
+			const std::string path = GetRelativePath(dir, info.GetPath());
+			if (path == exclude)
+				continue;
+			if (path.size() > 0xffff) {
+				Output("FileSourcePack::Write: the path '%s' is too long\n", path.c_str());
+				return false;
+			}
+
+			RefCountedPtr<FileData> file = info.Read();
+			if (!file) {
+				Output("FileSourcePack::Write: couldn't read '%s'\n", info.GetPath().c_str());
+				return false;
+			}
+
+			Record record = { path, offset, file->GetSize(), file->GetSize(), 0 };
+			const char *data = file->GetData();
+
+			if (compress && file->GetSize() > 0 && file->GetSize() <= LZ4_MAX_INPUT_SIZE) {
+				compressed.resize(LZ4_compressBound(int(file->GetSize())));
+				const int len = LZ4_compress_HC(data, compressed.data(), int(file->GetSize()), int(compressed.size()), LZ4HC_CLEVEL_DEFAULT);
+				// not worth inflating when it saves less than an eighth
+				if (len > 0 && Uint64(len) < file->GetSize() - file->GetSize() / 8) {
+					record.storedSize = len;
+					record.flags |= FLAG_LZ4;
+					data = compressed.data();
+				}
+			}
+
+			const Uint64 padded = (record.storedSize + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+			if (fwrite(data, 1, record.storedSize, out) != record.storedSize ||
+				fwrite(padding.data(), 1, padded - record.storedSize, out) != padded - record.storedSize)
+				return false;
+
+			offset += padded;
+			records.push_back(std::move(record));
+		}
+
+		std::sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+			return a.path < b.path;
+		});
+
+		std::string index, paths;
+		for (const Record &record : records) {
+			write_le(index, record.offset, 8);
+			write_le(index, record.storedSize, 8);
+			write_le(index, record.size, 8);
+			write_le(index, paths.size(), 4);
+			write_le(index, record.path.size(), 2);
+			write_le(index, record.flags, 2);
+			paths += record.path;
+		}
+		index += paths;
+
+		std::string header(MAGIC, sizeof(MAGIC));
+		write_le(header, VERSION, 4);
+		write_le(header, records.size(), 4);
+		write_le(header, offset, 8);
+
+		return fwrite(index.data(), 1, index.size(), out) == index.size() &&
+			fseek(out, 0, SEEK_SET) == 0 &&
+			fwrite(header.data(), 1, header.size(), out) == header.size();
+	}
+
+} // namespace FileSystem
@@ -0,0 +1,79 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _FILESOURCEPACK_H
+#define _FILESOURCEPACK_H
+
+#include "FileSystem.h"
+#include <SDL_stdinc.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace FileSystem {
+
+	// A whole directory tree packed into a single file, see the datapack tool.
+	//
+	// The pack is mapped into memory and its index is read once when it is
+	// opened, so looking up a file doesn't touch the disk. Uncompressed
+	// entries are handed out as views into the mapping.
+	//
+	// Layout, all numbers little-endian:
+	//   header:  "PIONPAK1", u32 version, u32 entry count, u64 index offset
+	//   data:    the entries, each starting on a PAGE_SIZE boundary
+	//   index:   one record per entry sorted by path, then the paths
+	//   record:  u64 offset, u64 stored size, u64 size, u32 path offset
+	//            (from the end of the records), u16 path length, u16 flags
+	// Directories aren't stored, they are implied by the paths of the files.
+	class FileSourcePack : public FileSource {
+	public:
+		static constexpr Uint32 VERSION = 1;
+		static constexpr Uint64 PAGE_SIZE = 4096;
+		// the entry is a single LZ4 block
+		static constexpr Uint16 FLAG_LZ4 = 1;
+
+		FileSourcePack(FileSourceFS &fs, const std::string &packPath);
+		// for packs that are already in memory
+		FileSourcePack(RefCountedPtr<FileData> data, const std::string &name);
+		virtual ~FileSourcePack();
+
+		bool IsOpen() const { return bool(m_pack); }
+
+		virtual FileInfo Lookup(const std::string &path);
+		virtual RefCountedPtr<FileData> ReadFile(const std::string &path);
+		virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output);
+		virtual bool IsReadOnly() const { return true; }
+
+		// Pack every file below dir in source, with paths relative to dir.
+		// Files whose path is in exclude are left out. Entries are LZ4
+		// compressed when compress is set and it makes them smaller.
+		static bool Write(FileSource &source, const std::string &dir, FILE *out, bool compress, const std::string &exclude = std::string());
+
+	private:
+		struct Entry {
+			std::string_view path;
+			Uint64 offset;
+			Uint64 storedSize;
+			Uint64 size;
+			Uint16 flags;
+		};
+
+		void Open(RefCountedPtr<FileData> data);
+		const Entry *FindEntry(const std::string &path) const;
+
+		// shared with the files read from it, so it can be released on any thread
+		std::shared_ptr<RefCountedPtr<FileData>> m_pack;
+		Time::DateTime m_modTime;
+
+		std::vector<Entry> m_entries;
+		// the paths point into the pack
+		std::unordered_map<std::string_view, Uint32> m_lookup;
+		// the entries of each directory sorted by name, the root is ""
+		std::unordered_map<std::string, std::vector<FileInfo>> m_directories;
+	};
+
+} // namespace FileSystem
+
+#endif
@@ -2,6 +2,7 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "FileSourceZip.h"
+#include "core/TaskGraph.h"
 #include "utils.h"
 #include <algorithm>
 #include <cstdio>
@@ -13,43 +14,43 @@ extern "C" {
 
 namespace FileSystem {
 
-	FileSourceZip::FileSourceZip(FileSourceFS &fs, const std::string &zipPath) :
-		FileSource(zipPath),
-		m_archive(0)
-	{
-		mz_zip_archive *zip = static_cast<mz_zip_archive *>(std::calloc(1, sizeof(mz_zip_archive)));
-		FILE *file = fs.OpenReadStream(zipPath);
-		if (!mz_zip_reader_init_file_stream(zip, file, 0)) {
-			Output("FileSourceZip: unable to open '%s'\n", zipPath.c_str());
-			std::free(zip);
-			return;
-		}
-
-		mz_zip_archive_file_stat zipStat;
-
-		Uint32 numFiles = mz_zip_reader_get_num_files(zip);
-		for (Uint32 i = 0; i < numFiles; i++) {
-			if (mz_zip_reader_file_stat(zip, i, &zipStat)) {
-				bool is_dir = mz_zip_reader_is_file_a_directory(zip, i);
-				if (!mz_zip_reader_is_file_encrypted(zip, i)) {
-					std::string fname = zipStat.m_filename;
-					if ((fname.size() > 1) && (fname[fname.size() - 1] == '/')) {
-						fname.resize(fname.size() - 1);
-					}
-					AddFile(zipStat.m_filename, FileStat(i, zipStat.m_uncomp_size, MakeFileInfo(fname, is_dir ? FileInfo::FT_DIR : FileInfo::FT_FILE)));
-				}
-			}
+	struct FileSourceZip::Archive {
+		Archive() :
+			zip(),
+			open(false) {}
+		~Archive()
+		{
+			if (open) mz_zip_reader_end(&zip);
 		}
 
-		m_archive = static_cast<void *>(zip);
-	}
-
-	FileSourceZip::~FileSourceZip()
-	{
-		if (!m_archive) return;
-		mz_zip_archive *zip = static_cast<mz_zip_archive *>(m_archive);
-		mz_zip_reader_end(zip);
-	}
+		// the whole .zip file, mapped if the platform allows it
+		RefCountedPtr<FileData> file;
+		mz_zip_archive zip;
+		bool open;
+	};
+
+	namespace {
+		// an uncompressed entry pointing into the archive, keeping it alive;
+		// the shared_ptr may be released on any thread, the RefCounted file can't
+		class FileDataArchive : public FileData {
+		public:
+			FileDataArchive(const FileInfo &info, size_t size, const char *data, std::shared_ptr<const void> archive) :
+				FileData(info, size, const_cast<char *>(data)),
+				m_archive(std::move(archive)) {}
+
+		private:
+			std::shared_ptr<const void> m_archive;
+		};
+
+		// from the zip format's local file header
+		const Uint32 LOCAL_HEADER_SIGNATURE = 0x04034b50;
+		const size_t LOCAL_HEADER_SIZE = 30;
+		const size_t LOCAL_HEADER_FILENAME_LEN = 26;
+		const size_t LOCAL_HEADER_EXTRA_LEN = 28;
+
+		Uint32 read_le16(const Uint8 *p) { return Uint32(p[0]) | (Uint32(p[1]) << 8); }
+		Uint32 read_le32(const Uint8 *p) { return read_le16(p) | (read_le16(p + 2) << 16); }
+	} // namespace
 
 	static void SplitPath(const std::string &path, std::vector<std::string> &output)
 	{
@@ -72,84 +73,169 @@ namespace FileSystem {
 		}
 	}
 
-	bool FileSourceZip::FindDirectoryAndFile(const std::string &path, const Directory *&dir, std::string &filename)
+	FileSourceZip::FileSourceZip(FileSourceFS &fs, const std::string &zipPath) :
+		FileSource(zipPath)
 	{
-		std::vector<std::string> fragments;
-		SplitPath(NormalisePath(path), fragments);
+		m_directories[""];
 
-		assert(fragments.size() > 0);
+		std::shared_ptr<Archive> archive = std::make_shared<Archive>();
+		archive->file = fs.MapFile(zipPath);
+		if (!archive->file || !mz_zip_reader_init_mem(&archive->zip, archive->file->GetData(), archive->file->GetSize(), 0)) {
+			Output("FileSourceZip: unable to open '%s'\n", zipPath.c_str());
+			return;
+		}
+		archive->open = true;
 
-		dir = &m_root;
+		mz_zip_archive *zip = &archive->zip;
+		const Uint8 *base = reinterpret_cast<const Uint8 *>(archive->file->GetData());
+		const Uint64 archiveSize = archive->file->GetSize();
+		mz_zip_archive_file_stat zipStat;
+
+		Uint32 numFiles = mz_zip_reader_get_num_files(zip);
+		for (Uint32 i = 0; i < numFiles; i++) {
+			if (mz_zip_reader_file_stat(zip, i, &zipStat)) {
+				bool is_dir = mz_zip_reader_is_file_a_directory(zip, i);
+				if (!mz_zip_reader_is_file_encrypted(zip, i)) {
+					std::string fname = zipStat.m_filename;
+					if ((fname.size() > 1) && (fname[fname.size() - 1] == '/')) {
+						fname.resize(fname.size() - 1);
+					}
+					FileStat st(i, zipStat.m_uncomp_size, MakeFileInfo(fname, is_dir ? FileInfo::FT_DIR : FileInfo::FT_FILE));
+
+					// the data of a stored entry follows its local header as it is
+					const Uint64 header = zipStat.m_local_header_ofs;
+					if (!is_dir && zipStat.m_method == 0 && zipStat.m_comp_size == zipStat.m_uncomp_size &&
+						header + LOCAL_HEADER_SIZE <= archiveSize && read_le32(base + header) == LOCAL_HEADER_SIGNATURE) {
+						const Uint64 offset = header + LOCAL_HEADER_SIZE +
+							read_le16(base + header + LOCAL_HEADER_FILENAME_LEN) + read_le16(base + header + LOCAL_HEADER_EXTRA_LEN);
+						if (offset + zipStat.m_uncomp_size <= archiveSize)
+							st.storedOffset = offset;
+					}
 
-		if (fragments.size() > 1) {
-			for (unsigned int i = 0; i < fragments.size() - 1; i++) {
-				std::map<std::string, Directory>::const_iterator it = dir->subdirs.find(fragments[i]);
-				if (it == dir->subdirs.end())
-					return false;
-				dir = &((*it).second);
+					AddFile(zipStat.m_filename, st);
+				}
 			}
 		}
 
-		filename = fragments.back();
-		return true;
+		for (auto &dir : m_directories)
+			std::sort(dir.second.begin(), dir.second.end());
+
+		m_archive = std::move(archive);
 	}
 
-	FileInfo FileSourceZip::Lookup(const std::string &path)
+	FileSourceZip::~FileSourceZip()
 	{
-		const Directory *dir;
-		std::string filename;
-		if (!FindDirectoryAndFile(path, dir, filename))
-			return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
+	}
+
+	const FileSourceZip::FileStat *FileSourceZip::FindFile(const std::string &path) const
+	{
+		std::string key = NormalisePath(path);
+		if (!key.empty() && key[0] == '/')
+			key.erase(0, 1);
+
+		auto it = m_files.find(key);
+		return it != m_files.end() ? &it->second : nullptr;
+	}
 
-		std::map<std::string, FileStat>::const_iterator i = dir->files.find(filename);
-		if (i == dir->files.end())
+	FileInfo FileSourceZip::Lookup(const std::string &path)
+	{
+		const FileStat *st = FindFile(path);
+		if (!st)
 			return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
+		return st->info;
+	}
 
-		return (*i).second.info;
+	RefCountedPtr<FileData> FileSourceZip::ReadStored(const FileStat &st) const
+	{
+		const char *data = m_archive->file->GetData() + st.storedOffset;
+		return RefCountedPtr<FileData>(new FileDataArchive(st.info, st.size, data, m_archive));
 	}
 
 	RefCountedPtr<FileData> FileSourceZip::ReadFile(const std::string &path)
 	{
 		if (!m_archive) return RefCountedPtr<FileData>();
-		mz_zip_archive *zip = static_cast<mz_zip_archive *>(m_archive);
-
-		const Directory *dir;
-		std::string filename;
-		if (!FindDirectoryAndFile(path, dir, filename))
-			return RefCountedPtr<FileData>();
 
-		std::map<std::string, FileStat>::const_iterator i = dir->files.find(filename);
-		if (i == dir->files.end())
+		const FileStat *st = FindFile(path);
+		if (!st || !st->info.IsFile())
 			return RefCountedPtr<FileData>();
 
-		const FileStat &st = (*i).second;
+		if (st->storedOffset)
+			return ReadStored(*st);
 
-		char *data = static_cast<char *>(std::malloc(st.size));
-		if (!mz_zip_reader_extract_to_mem(zip, st.index, data, st.size, 0)) {
+		char *data = static_cast<char *>(std::malloc(st->size));
+		if (!mz_zip_reader_extract_to_mem_no_alloc(&m_archive->zip, st->index, data, st->size, 0, nullptr, 0)) {
 			Output("FileSourceZip::ReadFile: couldn't extract '%s'\n", path.c_str());
+			std::free(data);
 			return RefCountedPtr<FileData>();
 		}
 
-		return RefCountedPtr<FileData>(new FileDataMalloc(st.info, st.size, data));
+		return RefCountedPtr<FileData>(new FileDataMalloc(st->info, st->size, data));
 	}
 
-	bool FileSourceZip::ReadDirectory(const std::string &path, std::vector<FileInfo> &output)
+	void FileSourceZip::ReadFiles(const std::vector<std::string> &paths, std::vector<RefCountedPtr<FileData>> &output, TaskGraph *taskGraph)
 	{
-		const Directory *dir;
-		std::string filename;
-		if (!FindDirectoryAndFile(path, dir, filename))
-			return false;
+		output.assign(paths.size(), RefCountedPtr<FileData>());
+		if (!m_archive) return;
 
-		{
-			std::map<std::string, Directory>::const_iterator i = dir->subdirs.find(filename);
-			if (i == dir->subdirs.end())
-				return false;
-			dir = &((*i).second);
+		// the stored entries are handed out right away; FileData isn't safe
+		// to create off this thread, so only the raw buffers are inflated there
+		struct Pending {
+			size_t output;
+			const FileStat *stat;
+			char *data;
+			bool ok;
+		};
+		std::vector<Pending> pending;
+
+		for (size_t i = 0; i < paths.size(); i++) {
+			const FileStat *st = FindFile(paths[i]);
+			if (!st || !st->info.IsFile())
+				continue;
+			if (st->storedOffset)
+				output[i] = ReadStored(*st);
+			else
+				pending.push_back({ i, st, static_cast<char *>(std::malloc(st->size)), false });
+		}
+
+		// reading from memory, miniz only touches the archive's central directory
+		mz_zip_archive *zip = &m_archive->zip;
+		auto inflate = [zip, &pending](TaskRange range) {
+			for (uint32_t i = range.begin; i < range.end; i++) {
+				Pending &p = pending[i];
+				p.ok = mz_zip_reader_extract_to_mem_no_alloc(zip, p.stat->index, p.data, p.stat->size, 0, nullptr, 0);
+			}
+		};
+
+		if (taskGraph && pending.size() > 1) {
+			TaskSet *set = new TaskSet();
+			set->AddTaskRangeLambda({ 0, uint32_t(pending.size()) }, 1, std::move(inflate));
+			TaskSet::Handle handle = taskGraph->QueueTaskSet(set);
+			taskGraph->WaitForTaskSet(handle);
+		} else {
+			inflate({ 0, uint32_t(pending.size()) });
+		}
+
+		for (Pending &p : pending) {
+			if (p.ok) {
+				output[p.output] = RefCountedPtr<FileData>(new FileDataMalloc(p.stat->info, p.stat->size, p.data));
+			} else {
+				Output("FileSourceZip::ReadFiles: couldn't extract '%s'\n", paths[p.output].c_str());
+				std::free(p.data);
+			}
 		}
+	}
+
+	bool FileSourceZip::ReadDirectory(const std::string &path, std::vector<FileInfo> &output)
+	{
+		std::string key = NormalisePath(path);
+		if (!key.empty() && key[0] == '/')
+			key.erase(0, 1);
 
-		for (std::map<std::string, FileStat>::const_iterator i = dir->files.begin(); i != dir->files.end(); ++i)
-			output.push_back((*i).second.info);
+		auto it = m_directories.find(key);
+		if (it == m_directories.end())
+			return false;
 
+		output.insert(output.end(), it->second.begin(), it->second.end());
 		return true;
 	}
 
@@ -160,27 +246,26 @@ namespace FileSystem {
 
 		assert(fragments.size() > 0);
 
-		Directory *dir = &m_root;
-
-		if (fragments.size() > 1) {
-			std::string fullPath;
-
-			for (unsigned int i = 0; i < fragments.size() - 1; i++) {
-				fullPath += ((i > 0) ? "/" : "") + fragments[i];
+		// make sure all the directories above it exist
+		std::string dirPath;
+		for (size_t i = 0; i + 1 < fragments.size(); i++) {
+			const std::string parent = dirPath;
+			dirPath += (i > 0 ? "/" : "") + fragments[i];
 
-				std::map<std::string, FileStat>::const_iterator it = dir->files.find(fragments[i]);
-				if (it == dir->files.end())
-					dir->files.insert(std::make_pair(fragments[i], FileStat(Uint32(-1), 0, MakeFileInfo(fullPath, FileInfo::FT_DIR))));
-				dir = &(dir->subdirs[fragments[i]]);
+			const FileInfo info = MakeFileInfo(dirPath, FileInfo::FT_DIR);
+			if (m_files.emplace(dirPath, FileStat(Uint32(-1), 0, info)).second) {
+				m_directories[parent].push_back(info);
+				m_directories[dirPath];
 			}
 		}
 
-		const std::string &filename = fragments.back();
+		const std::string key = dirPath + (dirPath.empty() ? "" : "/") + fragments.back();
+		if (!m_files.emplace(key, fileStat).second)
+			return;
 
+		m_directories[dirPath].push_back(fileStat.info);
 		if (fileStat.info.IsDir())
-			dir->subdirs.insert(std::make_pair(filename, Directory()));
-
-		dir->files.insert(std::make_pair(filename, fileStat));
+			m_directories[key];
 	}
 
 } // namespace FileSystem
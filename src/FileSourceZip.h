@@ -6,43 +6,58 @@
 
 #include "FileSystem.h"
 #include <SDL_stdinc.h>
-#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
+
+class TaskGraph;
 
 namespace FileSystem {
 
+	// The archive is mapped into memory and kept there as long as the source
+	// or any file read from it is alive. Entries stored without compression
+	// are handed out as views into the mapping instead of copies.
 	class FileSourceZip : public FileSource {
 	public:
 		// for now this needs to be FileSourceFS rather than just FileSource,
-		// because we need a FILE* stream access to the .zip file
+		// because the .zip file is mapped from the real filesystem
 		FileSourceZip(FileSourceFS &fs, const std::string &zipPath);
 		virtual ~FileSourceZip();
 
 		virtual FileInfo Lookup(const std::string &path);
 		virtual RefCountedPtr<FileData> ReadFile(const std::string &path);
 		virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output);
+		virtual bool IsReadOnly() const { return true; }
+
+		// Read several files at once, inflating the compressed ones in
+		// parallel on the task graph if one is given. output[i] is the file
+		// at paths[i], or null if it couldn't be read.
+		void ReadFiles(const std::vector<std::string> &paths, std::vector<RefCountedPtr<FileData>> &output, TaskGraph *taskGraph = nullptr);
 
 	private:
-		void *m_archive;
+		struct Archive;
+		std::shared_ptr<Archive> m_archive;
 
 		struct FileStat {
 			FileStat(Uint32 _index, Uint64 _size, const FileInfo &_info) :
 				index(_index),
 				size(_size),
+				storedOffset(0),
 				info(_info) {}
 			const Uint32 index;
 			const Uint64 size;
+			// offset of the data in the archive for uncompressed entries, 0 otherwise
+			Uint64 storedOffset;
 			const FileInfo info;
 		};
 
-		struct Directory {
-			std::map<std::string, Directory> subdirs;
-			std::map<std::string, FileStat> files;
-		};
-
-		Directory m_root;
+		// keyed by the normalised path without a leading '/'
+		std::unordered_map<std::string, FileStat> m_files;
+		// the entries of each directory sorted by name, the root is ""
+		std::unordered_map<std::string, std::vector<FileInfo>> m_directories;
 
-		bool FindDirectoryAndFile(const std::string &path, const Directory *&dir, std::string &filename);
+		const FileStat *FindFile(const std::string &path) const;
+		RefCountedPtr<FileData> ReadStored(const FileStat &st) const;
 		void AddFile(const std::string &path, const FileStat &fileStat);
 	};
 
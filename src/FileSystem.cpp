@@ -2,12 +2,14 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "FileSystem.h"
+#include "FileSourcePack.h"
 #include "StringRange.h"
 
 #include <algorithm>
 #include <cassert>
 #include <iterator>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 
@@ -15,8 +17,10 @@ namespace FileSystem {
 
 	static FileSourceFS dataFilesApp(GetDataDir(), true);
 	static FileSourceFS dataFilesUser(JoinPath(GetUserDir(), "data"));
+	static std::unique_ptr<FileSourcePack> dataFilesPack;
 	FileSourceUnion gameDataFiles;
 	FileSourceFS userFiles(GetUserDir());
+	const char DATA_PACK_NAME[] = "data.pack";
 
 	// note: some functions (GetUserDir(), GetDataDir()) are in FileSystem{Posix,Win32}.cpp
 	std::string SanitiseFileName(const std::string &a)
@@ -189,6 +193,18 @@ namespace FileSystem {
 	void Init()
 	{
 		gameDataFiles.AppendSource(&dataFilesUser);
+
+		// a packed copy of the data directory is used instead of it, so
+		// the tree doesn't have to be walked on every lookup
+		if (dataFilesApp.Lookup(DATA_PACK_NAME).IsFile()) {
+			dataFilesPack = std::make_unique<FileSourcePack>(dataFilesApp, DATA_PACK_NAME);
+			if (dataFilesPack->IsOpen()) {
+				gameDataFiles.AppendSource(dataFilesPack.get());
+				return;
+			}
+			dataFilesPack.reset();
+		}
+
 		gameDataFiles.AppendSource(&dataFilesApp);
 	}
 
@@ -235,6 +251,7 @@ namespace FileSystem {
 		assert(fs);
 		RemoveSource(fs);
 		m_sources.insert(m_sources.begin(), fs);
+		ClearCache();
 	}
 
 	void FileSourceUnion::AppendSource(FileSource *fs)
@@ -242,45 +259,84 @@ namespace FileSystem {
 		assert(fs);
 		RemoveSource(fs);
 		m_sources.push_back(fs);
+		ClearCache();
 	}
 
 	void FileSourceUnion::RemoveSource(FileSource *fs)
 	{
 		std::vector<FileSource *>::iterator nend = std::remove(m_sources.begin(), m_sources.end(), fs);
 		m_sources.erase(nend, m_sources.end());
+		ClearCache();
 	}
 
-	FileInfo FileSourceUnion::Lookup(const std::string &path)
+	void FileSourceUnion::ClearCache()
 	{
-		for (std::vector<FileSource *>::const_iterator
-				 it = m_sources.begin();
-			 it != m_sources.end(); ++it) {
-			FileInfo info = (*it)->Lookup(path);
-			if (info.Exists()) {
-				return info;
-			}
-		}
-		return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
+		std::lock_guard<std::mutex> lock(m_cacheLock);
+		m_lookupCache.clear();
+		m_directoryCache.clear();
 	}
 
-	std::vector<FileInfo> FileSourceUnion::LookupAll(const std::string &path)
+	std::vector<FileInfo> FileSourceUnion::FindAll(const std::string &path)
 	{
-		std::vector<FileInfo> outFiles;
+		std::vector<FileInfo> archived;
+		bool cached;
+		{
+			std::lock_guard<std::mutex> lock(m_cacheLock);
+			auto it = m_lookupCache.find(path);
+			cached = it != m_lookupCache.end();
+			if (cached)
+				archived = it->second;
+		}
+
+		if (!cached) {
+			// probe the archives without holding the lock, another thread
+			// looking up the same path finds the same files
+			for (FileSource *fs : m_sources) {
+				if (!fs->IsReadOnly())
+					continue;
+				FileInfo info = fs->Lookup(path);
+				if (info.Exists()) archived.push_back(info);
+			}
 
+			std::lock_guard<std::mutex> lock(m_cacheLock);
+			m_lookupCache.emplace(path, archived);
+		}
+
+		// the other sources are asked every time, in their place in the order
+		std::vector<FileInfo> found;
+		auto next = archived.begin();
 		for (FileSource *fs : m_sources) {
-			FileInfo info = fs->Lookup(path);
-			if (info.Exists()) outFiles.push_back(info);
+			if (fs->IsReadOnly()) {
+				if (next != archived.end() && &next->GetSource() == fs)
+					found.push_back(*next++);
+			} else {
+				FileInfo info = fs->Lookup(path);
+				if (info.Exists()) found.push_back(info);
+			}
 		}
+		return found;
+	}
+
+	FileInfo FileSourceUnion::Lookup(const std::string &path)
+	{
+		const std::vector<FileInfo> found = FindAll(path);
+		if (!found.empty())
+			return found.front();
+		return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
+	}
 
-		return outFiles;
+	std::vector<FileInfo> FileSourceUnion::LookupAll(const std::string &path)
+	{
+		return FindAll(path);
 	}
 
 	RefCountedPtr<FileData> FileSourceUnion::ReadFile(const std::string &path)
 	{
-		for (std::vector<FileSource *>::const_iterator
-				 it = m_sources.begin();
-			 it != m_sources.end(); ++it) {
-			RefCountedPtr<FileData> data = (*it)->ReadFile(path);
+		// only the sources that have a file there are asked to read it
+		for (const FileInfo &info : FindAll(path)) {
+			if (!info.IsFile())
+				continue;
+			RefCountedPtr<FileData> data = info.Read();
 			if (data) {
 				return data;
 			}
@@ -334,14 +390,44 @@ namespace FileSystem {
 			return m_sources.front()->ReadDirectory(path, output);
 		}
 
+		std::vector<CachedDirectory> archived;
+		bool cached;
+		{
+			std::lock_guard<std::mutex> lock(m_cacheLock);
+			auto it = m_directoryCache.find(path);
+			cached = it != m_directoryCache.end();
+			if (cached)
+				archived = it->second;
+		}
+
+		if (!cached) {
+			for (FileSource *fs : m_sources) {
+				std::vector<FileInfo> files;
+				if (fs->IsReadOnly() && fs->ReadDirectory(path, files))
+					archived.push_back(CachedDirectory{ fs, std::move(files) });
+			}
+
+			std::lock_guard<std::mutex> lock(m_cacheLock);
+			m_directoryCache.emplace(path, archived);
+		}
+
 		bool founddir = false;
 
 		std::vector<FileInfo> merged;
+		auto nextArchived = archived.begin();
 		for (std::vector<FileSource *>::const_iterator
 				 it = m_sources.begin();
 			 it != m_sources.end(); ++it) {
 			std::vector<FileInfo> nextfiles;
-			if ((*it)->ReadDirectory(path, nextfiles)) {
+			bool found;
+			if ((*it)->IsReadOnly()) {
+				found = nextArchived != archived.end() && nextArchived->source == *it;
+				if (found)
+					nextfiles.swap((nextArchived++)->files);
+			} else {
+				found = (*it)->ReadDirectory(path, nextfiles);
+			}
+			if (found) {
 				founddir = true;
 
 				std::vector<FileInfo> prevfiles;
@@ -10,7 +10,9 @@
 #include "StringRange.h"
 #include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 /*
@@ -36,6 +38,10 @@ namespace FileSystem {
 	extern FileSourceUnion gameDataFiles;
 	extern FileSourceFS userFiles;
 
+	// if the data directory has a pack of this name, see the datapack
+	// tool, the game data is read from it instead
+	extern const char DATA_PACK_NAME[];
+
 	std::string GetUserDir();
 	std::string GetDataDir();
 	bool IsValidFilename(const std::string &fileName);
@@ -275,6 +281,9 @@ namespace FileSystem {
 		}
 
 		bool IsTrusted() const { return m_trusted; }
+		// true when the files can't change while the source is mounted, so
+		// what is found in it may be remembered
+		virtual bool IsReadOnly() const { return false; }
 
 	protected:
 		FileInfo MakeFileInfo(const std::string &path, FileInfo::FileType entryType, Time::DateTime modTime);
@@ -294,6 +303,10 @@ namespace FileSystem {
 		virtual RefCountedPtr<FileData> ReadFile(const std::string &path);
 		virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output);
 
+		// like ReadFile, but the file is mapped into memory instead of read
+		// where the platform allows it
+		RefCountedPtr<FileData> MapFile(const std::string &path);
+
 		bool MakeDirectory(const std::string &path);
 
 		enum WriteFlags {
@@ -305,6 +318,9 @@ namespace FileSystem {
 		// similar to fopen(path, "wb")
 		FILE *OpenWriteStream(const std::string &path, int flags = 0);
 		bool RemoveFile(const std::string &relativePath);
+		// replaces the file at the new path if there is one, atomically where
+		// the platform allows it
+		bool RenameFile(const std::string &relativeFrom, const std::string &relativeTo);
 		bool IsChildOfRoot(const std::string &path);
 	};
 
@@ -320,13 +336,33 @@ namespace FileSystem {
 		void AppendSource(FileSource *fs);
 		void RemoveSource(FileSource *fs);
 
+		// Lookups and directory listings in read-only sources (archives) are
+		// remembered until the sources change; the other sources are asked
+		// every time, so files written to them are seen at once. Call this
+		// if the file behind a mounted archive is replaced.
+		void ClearCache();
+
 		virtual FileInfo Lookup(const std::string &path);
 		std::vector<FileInfo> LookupAll(const std::string &path);
 		virtual RefCountedPtr<FileData> ReadFile(const std::string &path);
 		virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output);
 
 	private:
+		struct CachedDirectory {
+			const FileSource *source;
+			std::vector<FileInfo> files;
+		};
+
+		// every source that has something at the path, in priority order
+		std::vector<FileInfo> FindAll(const std::string &path);
+
 		std::vector<FileSource *> m_sources;
+
+		// what the read-only sources have at each path, in priority order;
+		// filled from any thread, and only read while holding the lock
+		std::mutex m_cacheLock;
+		std::unordered_map<std::string, std::vector<FileInfo>> m_lookupCache;
+		std::unordered_map<std::string, std::vector<CachedDirectory>> m_directoryCache;
 	};
 
 } // namespace FileSystem
@@ -8,11 +8,36 @@
 #include "JsonUtils.h"
 #include "Sfx.h"
 #include "Space.h"
+#include "collider/CollisionContact.h"
 #include "collider/CollisionSpace.h"
+#include "core/TaskGraph.h"
 #include "utils.h"
 
 std::vector<Frame> Frame::s_frames;
+Uint32 Frame::s_transformGeneration = 1;
 std::vector<CollisionSpace *> Frame::s_collisionSpaces;
+std::vector<std::vector<CollisionContact>> Frame::s_contactBuffers;
+
+namespace {
+	// the contact buffer for the collision space being processed by this thread
+	thread_local std::vector<CollisionContact> *t_contactBuffer = nullptr;
+
+	void BufferContact(CollisionContact *c)
+	{
+		t_contactBuffer->push_back(*c);
+	}
+
+	// recently used frame pairs, per thread as bodies may be updated in
+	// parallel; an entry of an older generation is empty
+	struct TransformMemo {
+		Uint32 generation = 0;
+		FrameId from;
+		FrameId to;
+		matrix4x4d transform;
+	};
+	const size_t TRANSFORM_MEMO_SIZE = 32;
+	thread_local TransformMemo t_transformMemo[TRANSFORM_MEMO_SIZE];
+} // namespace
 
 Frame::Frame(const Dummy &d, FrameId parent, const char *label, unsigned int flags, double radius) :
 	m_parent(parent),
@@ -240,9 +265,11 @@ void Frame::DeleteFrames()
 	});
 	// then delete it
 	s_frames.clear();
+	++s_transformGeneration;
 
 	// remember to delete CollisionSpaces
 	s_collisionSpaces.clear();
+	s_contactBuffers.clear();
 }
 
 Frame *Frame::GetFrame(FrameId fId)
@@ -284,6 +311,7 @@ void Frame::DeleteCameraFrame(FrameId camera)
 #endif // NDEBUG
 	s_frames.back().d.madeWithFactory = true;
 	s_frames.pop_back();
+	++s_transformGeneration;
 }
 
 void Frame::PostUnserializeFixup(FrameId fId, Space *space)
@@ -297,16 +325,49 @@ void Frame::PostUnserializeFixup(FrameId fId, Space *space)
 		PostUnserializeFixup(kid, space);
 }
 
-void Frame::CollideFrames(void (*callback)(CollisionContact *))
+void Frame::CollideFrames(void (*callback)(CollisionContact *), TaskGraph *taskGraph)
 {
 	PROFILE_SCOPED()
 
-	for (auto &frame : s_frames) {
-		if (!frame.m_collisionSpace)
-			continue;
+	if (!taskGraph) {
+		for (auto &frame : s_frames) {
+			if (!frame.m_collisionSpace)
+				continue;
 
-		PROFILE_SCOPED_DESC(frame.m_label.c_str())
-		frame.m_collisionSpace->Collide(callback);
+			PROFILE_SCOPED_DESC(frame.m_label.c_str())
+			frame.m_collisionSpace->Collide(callback);
+		}
+
+		return;
+	}
+
+	// Each collision space only references its own geoms, so the spaces can
+	// be collided independently. Contacts are buffered per space and replayed
+	// in frame order to keep collision responses deterministic.
+	if (s_contactBuffers.size() < s_frames.size())
+		s_contactBuffers.resize(s_frames.size());
+
+	TaskSet *set = new TaskSet();
+	set->AddTaskRangeLambda({ 0, uint32_t(s_frames.size()) }, 1, [](TaskRange range) {
+		for (uint32_t idx = range.begin; idx < range.end; idx++) {
+			Frame &frame = s_frames[idx];
+			if (!frame.m_collisionSpace)
+				continue;
+
+			PROFILE_SCOPED_DESC(frame.m_label.c_str())
+			t_contactBuffer = &s_contactBuffers[idx];
+			frame.m_collisionSpace->Collide(&BufferContact);
+			t_contactBuffer = nullptr;
+		}
+	});
+
+	TaskSet::Handle handle = taskGraph->QueueTaskSet(set);
+	taskGraph->WaitForTaskSet(handle);
+
+	for (std::vector<CollisionContact> &contacts : s_contactBuffers) {
+		for (CollisionContact &c : contacts)
+			callback(&c);
+		contacts.clear();
 	}
 }
 
@@ -349,6 +410,12 @@ vector3d Frame::GetVelocityRelTo(FrameId relToId) const
 }
 
 vector3d Frame::GetPositionRelTo(FrameId relToId) const
+{
+	if (m_thisId == relToId) return vector3d(0, 0, 0);
+	return GetMemoTransformRelTo(relToId).GetTranslate();
+}
+
+vector3d Frame::CalcPositionRelTo(FrameId relToId) const
 {
 	// early-outs for simple cases, required for accuracy in large systems
 	if (m_thisId == relToId) return vector3d(0, 0, 0);
@@ -405,6 +472,12 @@ vector3d Frame::GetInterpPositionRelTo(FrameId relToId) const
 }
 
 matrix3x3d Frame::GetOrientRelTo(FrameId relToId) const
+{
+	if (m_thisId == relToId) return matrix3x3d::Identity();
+	return GetMemoTransformRelTo(relToId).GetOrient();
+}
+
+matrix3x3d Frame::CalcOrientRelTo(FrameId relToId) const
 {
 	if (m_thisId == relToId) return matrix3x3d::Identity();
 	return Frame::GetFrame(relToId)->m_rootOrient.Transpose() * m_rootOrient;
@@ -425,7 +498,20 @@ matrix3x3d Frame::GetInterpOrientRelTo(FrameId relToId) const
 
 matrix4x4d Frame::GetTransformRelTo(FrameId relToId) const
 {
-	return matrix4x4d(GetOrientRelTo(relToId), GetPositionRelTo(relToId));
+	if (m_thisId == relToId) return matrix4x4d::Identity();
+	return GetMemoTransformRelTo(relToId);
+}
+
+const matrix4x4d &Frame::GetMemoTransformRelTo(FrameId relToId) const
+{
+	TransformMemo &memo = t_transformMemo[(m_thisId.id() * 31 + relToId.id()) % TRANSFORM_MEMO_SIZE];
+	if (memo.generation != s_transformGeneration || memo.from != m_thisId || memo.to != relToId) {
+		memo.generation = s_transformGeneration;
+		memo.from = m_thisId;
+		memo.to = relToId;
+		memo.transform = matrix4x4d(CalcOrientRelTo(relToId), CalcPositionRelTo(relToId));
+	}
+	return memo.transform;
 }
 
 matrix4x4d Frame::GetInterpTransformRelTo(FrameId relToId) const
@@ -461,10 +547,7 @@ void Frame::UpdateInterpTransform(double alpha)
 
 void Frame::GetFrameTransform(const FrameId fFromId, const FrameId fToId, matrix4x4d &m)
 {
-	matrix3x3d forient = Frame::GetFrame(fFromId)->GetOrientRelTo(fToId);
-	vector3d fpos = Frame::GetFrame(fFromId)->GetPositionRelTo(fToId);
-	m = forient;
-	m.SetTranslate(fpos);
+	m = Frame::GetFrame(fFromId)->GetTransformRelTo(fToId);
 }
 
 void Frame::ClearMovement()
@@ -477,22 +560,38 @@ void Frame::ClearMovement()
 	m_oldAngDisplacement = 0.0;
 }
 
-void Frame::UpdateOrbitRails(double time, double timestep)
+void Frame::UpdateOrbitRails(double time, double timestep, TaskGraph *taskGraph)
 {
 	PROFILE_SCOPED()
-	std::for_each(begin(s_frames), end(s_frames), [&time, &timestep](Frame &frame) {
-		frame.m_oldPos = frame.m_pos;
-		frame.m_oldAngDisplacement = frame.m_angSpeed * timestep;
 
-		// update frame position and velocity
+	// solve the orbits of all the frames on rails at once, the position and
+	// velocity of each come from the same solve
+	std::vector<Frame *> onRails;
+	std::vector<const Orbit *> orbits;
+	for (Frame &frame : s_frames) {
 		if (frame.m_parent.valid() && frame.m_sbody && !frame.IsRotFrame()) {
-			frame.m_pos = frame.m_sbody->GetOrbit().OrbitalPosAtTime(time);
-			vector3d pos2 = frame.m_sbody->GetOrbit().OrbitalPosAtTime(time + timestep);
-			frame.m_vel = (pos2 - frame.m_pos) / timestep;
+			onRails.push_back(&frame);
+			orbits.push_back(&frame.m_sbody->GetOrbit());
 		}
+	}
+	std::vector<vector3d> pos(orbits.size()), vel(orbits.size());
+	Orbit::OrbitalStatesAtTime(orbits.data(), orbits.size(), time, pos.data(), vel.data(), taskGraph);
+
+	for (size_t i = 0; i < onRails.size(); i++) {
+		onRails[i]->m_oldPos = onRails[i]->m_pos;
+		onRails[i]->m_pos = pos[i];
+		onRails[i]->m_vel = vel[i];
+	}
+
+	// the root-relative values need the parents updated first
+	std::for_each(begin(s_frames), end(s_frames), [&time, &timestep](Frame &frame) {
+		frame.m_oldAngDisplacement = frame.m_angSpeed * timestep;
+
 		// temporary test thing
-		else
+		if (!(frame.m_parent.valid() && frame.m_sbody && !frame.IsRotFrame())) {
+			frame.m_oldPos = frame.m_pos;
 			frame.m_pos = frame.m_pos + frame.m_vel * timestep;
+		}
 
 		// update frame rotation
 		double ang = fmod(frame.m_angSpeed * time, 2.0 * M_PI);
@@ -512,6 +611,7 @@ void Frame::UpdateOrbitRails(double time, double timestep)
 
 void Frame::SetInitialOrient(const matrix3x3d &m, double time)
 {
+	++s_transformGeneration;
 	m_initialOrient = m;
 	double ang = fmod(m_angSpeed * time, 2.0 * M_PI);
 	if (!is_zero_exact(ang)) {						// frequently used with e^-10 etc
@@ -524,6 +624,7 @@ void Frame::SetInitialOrient(const matrix3x3d &m, double time)
 
 void Frame::SetOrient(const matrix3x3d &m, double time)
 {
+	++s_transformGeneration;
 	m_orient = m;
 	double ang = fmod(m_angSpeed * time, 2.0 * M_PI);
 	if (!is_zero_exact(ang)) {					   // frequently used with e^-10 etc
@@ -536,6 +637,8 @@ void Frame::SetOrient(const matrix3x3d &m, double time)
 
 void Frame::UpdateRootRelativeVars()
 {
+	++s_transformGeneration;
+
 	// update pos & vel relative to parent frame
 	Frame *parent = Frame::GetFrame(m_parent);
 	if (!parent) {
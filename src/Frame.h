@@ -20,6 +20,7 @@ class Geom;
 class SystemBody;
 class SfxManager;
 class Space;
+class TaskGraph;
 
 struct CollisionContact;
 
@@ -66,7 +67,11 @@ public:
 	const std::string &GetLabel() const { return m_label; }
 	void SetLabel(const char *label) { m_label = label; }
 
-	void SetPosition(const vector3d &pos) { m_pos = pos; }
+	void SetPosition(const vector3d &pos)
+	{
+		m_pos = pos;
+		++s_transformGeneration;
+	}
 	vector3d GetPosition() const { return m_pos; }
 	void SetInitialOrient(const matrix3x3d &m, double time);
 	void SetOrient(const matrix3x3d &m, double time);
@@ -108,8 +113,12 @@ public:
 	void SetPlanetGeom(double radius, Body *);
 	CollisionSpace *GetCollisionSpace() const;
 
-	static void UpdateOrbitRails(double time, double timestep);
-	static void CollideFrames(void (*callback)(CollisionContact *));
+	static void UpdateOrbitRails(double time, double timestep, TaskGraph *taskGraph = nullptr);
+	// Collide the geoms in every frame's collision space. If a TaskGraph is
+	// given, the collision spaces are processed in parallel and the contacts
+	// are reported through the callback afterwards on the calling thread, in
+	// frame order.
+	static void CollideFrames(void (*callback)(CollisionContact *), TaskGraph *taskGraph = nullptr);
 	void UpdateInterpTransform(double alpha);
 	void ClearMovement();
 
@@ -117,6 +126,8 @@ public:
 	// must attain this velocity within rotating frame to be stationary.
 	vector3d GetStasisVelocity(const vector3d &pos) const { return -vector3d(0, m_angSpeed, 0).Cross(pos); }
 
+	// The same frame pairs are asked for many times in a step, so the
+	// transforms between them are remembered until any frame moves.
 	vector3d GetPositionRelTo(FrameId relTo) const;
 	vector3d GetVelocityRelTo(FrameId relTo) const;
 	matrix3x3d GetOrientRelTo(FrameId relTo) const;
@@ -136,6 +147,9 @@ private:
 	FrameId m_thisId;
 
 	void UpdateRootRelativeVars();
+	const matrix4x4d &GetMemoTransformRelTo(FrameId relTo) const;
+	vector3d CalcPositionRelTo(FrameId relTo) const;
+	matrix3x3d CalcOrientRelTo(FrameId relTo) const;
 
 	FrameId m_parent;				 // if parent is null then frame position is absolute
 	std::vector<FrameId> m_children; // child frames, first may be rotating
@@ -166,7 +180,12 @@ private:
 	int m_astroBodyIndex; // deserialisation
 
 	static std::vector<Frame> s_frames;
+	// changed whenever a frame moves or frames come and go, which forgets
+	// the remembered transforms
+	static Uint32 s_transformGeneration;
 	static std::vector<CollisionSpace *> s_collisionSpaces;
+	// contacts for each collision space during a parallel CollideFrames
+	static std::vector<std::vector<CollisionContact>> s_contactBuffers;
 
 	// A trick in order to avoid a direct call of ctor or dtor: use factory methods instead
 	struct Dummy {
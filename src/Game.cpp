@@ -11,12 +11,17 @@
 #include "GameLog.h"
 #include "GameSaveError.h"
 #include "HyperspaceCloud.h"
+#include "JobQueue.h"
 #include "JsonUtils.h"
 #include "MathUtil.h"
 #include "collider/CollisionSpace.h"
-#include "core/GZipFormat.h"
+#include "core/JsonArena.h"
+#include "core/LZ4Format.h"
+#include "core/Log.h"
+#include "fmt/format.h"
 #include "galaxy/Economy.h"
 #include "lua/LuaEvent.h"
+#include "lua/LuaTimer.h"
 #include "lua/LuaSerializer.h"
 #include "pigui/LuaPiGui.h"
 #if WITH_OBJECTVIEWER
@@ -34,7 +39,22 @@
 #include "pigui/PiGuiView.h"
 #include "ship/PlayerShipController.h"
 
-static const int s_saveVersion = 90;
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+
+static const int s_saveVersion = 91;
+// 90 differs only in encoding (gzipped json, vectors as strings), which
+// the readers still handle. Its bodies may carry NaN angular velocities,
+// cleared in the DynamicBody constructor.
+// SAVEBUMP: raising this past 90 retires that fix-up
+static const int s_oldestSaveVersion = 90;
+
+static bool IsLoadableSaveVersion(const Json &version)
+{
+	return version.is_number_integer() && version.get<int>() >= s_oldestSaveVersion && version.get<int>() <= s_saveVersion;
+}
 
 Game::Game(const SystemPath &path, const double startDateTime, const char *shipType) :
 	m_galaxy(GalaxyGenerator::Create()),
@@ -46,7 +66,8 @@ Game::Game(const SystemPath &path, const double startDateTime, const char *shipT
 	m_hyperspaceEndTime(0),
 	m_timeAccel(TIMEACCEL_1X),
 	m_requestedTimeAccel(TIMEACCEL_1X),
-	m_forceTimeAccel(false)
+	m_forceTimeAccel(false),
+	m_fastForwarding(false)
 {
 	PROFILE_SCOPED()
 	// Now that we have a Galaxy, check the starting location
@@ -143,14 +164,15 @@ Game::~Game()
 Game::Game(const Json &jsonObj) :
 	m_timeAccel(TIMEACCEL_PAUSED),
 	m_requestedTimeAccel(TIMEACCEL_PAUSED),
-	m_forceTimeAccel(false)
+	m_forceTimeAccel(false),
+	m_fastForwarding(false)
 {
 	PROFILE_SCOPED()
 	try {
 		int version = jsonObj["version"];
 		Output("savefile version: %d\n", version);
-		if (version != s_saveVersion) {
-			Output("can't load savefile, expected version: %d\n", s_saveVersion);
+		if (!IsLoadableSaveVersion(jsonObj["version"])) {
+			Output("can't load savefile, expected version: %d to %d\n", s_oldestSaveVersion, s_saveVersion);
 			throw SavedGameWrongVersionException();
 		}
 	} catch (Json::type_error &) {
@@ -312,11 +334,17 @@ void Game::ToJson(Json &jsonObj)
 void Game::TimeStep(float step)
 {
 	PROFILE_SCOPED()
+	const int fastForwardSteps = GetFastForwardSteps(step);
+	m_fastForwarding = fastForwardSteps > 1 && m_player->CanGoOnRails() && m_player->StartOnRails();
+	if (m_fastForwarding)
+		step *= fastForwardSteps;
+
 	m_time += step; // otherwise planets lag time accel changes by a frame
 	if (m_state == State::HYPERSPACE && Pi::game->GetTime() >= m_hyperspaceEndTime)
 		m_time = m_hyperspaceEndTime;
 
 	m_space->TimeStep(step);
+	m_fastForwarding = false;
 
 	SfxManager::TimeStepAll(step, m_space->GetRootFrame());
 
@@ -337,6 +365,55 @@ void Game::TimeStep(float step)
 	}
 }
 
+int Game::GetFastForwardSteps(float step) const
+{
+	PROFILE_SCOPED()
+	// a day in a few hundred steps
+	const int MAX_FAST_FORWARD_STEPS = 100;
+
+	if (!s_fastForwardEnabled || m_timeAccel != TIMEACCEL_10000X || m_state != State::NORMAL || m_wantHyperspace)
+		return 1;
+	// whether the player coasts is up to Ship::CanGoOnRails
+	if (m_player->GetAlertState() != Ship::ALERT_NONE)
+		return 1;
+
+	double limit = MAX_FAST_FORWARD_STEPS * double(step);
+
+	double nextTimeout;
+	if (Pi::luaTimer->GetNextTimeoutBound(nextTimeout))
+		limit = std::min(limit, nextTimeout - m_time);
+
+	for (const Body *b : m_space->GetBodies()) {
+		if (b == m_player.get())
+			continue;
+
+		if (b->IsType(ObjectType::HYPERSPACECLOUD)) {
+			const HyperspaceCloud *cloud = static_cast<const HyperspaceCloud *>(b);
+			if (cloud->IsArrival())
+				limit = std::min(limit, cloud->GetDueDate() - m_time);
+			continue;
+		}
+
+		// anything that isn't following its orbit can't take a long step
+		if (b->IsType(ObjectType::SHIP)) {
+			const Ship *ship = static_cast<const Ship *>(b);
+			if (ship->GetFlightState() != Ship::DOCKED && ship->GetFlightState() != Ship::LANDED && !ship->IsOnRails())
+				return 1;
+		} else if (b->IsType(ObjectType::DYNAMICBODY) && !static_cast<const DynamicBody *>(b)->IsOnRails()) {
+			return 1;
+		}
+
+		// the distance at which UpdateTimeAccel drops below 10000x, reached no
+		// sooner than closing in at twice the current speed
+		const double rad = std::max(b->GetPhysRadius(), 10000.0);
+		const double margin = b->GetPositionRelTo(m_player.get()).Length() - std::min(rad + 0.1 * AU, rad * 500.0);
+		const double speed = std::max(b->GetVelocityRelTo(m_player.get()).Length(), 1.0);
+		limit = std::min(limit, 0.5 * margin / speed);
+	}
+
+	return std::max(int(limit / step), 1);
+}
+
 bool Game::UpdateTimeAccel()
 {
 	PROFILE_SCOPED()
@@ -524,9 +601,12 @@ void Game::SwitchToNormalSpace()
 	// remove the player from hyperspace
 	m_space->RemoveBody(m_player.get());
 
+	// what has been got ready of the system during the jump
+	std::unique_ptr<Space::ArrivalPrefetch> arrival = m_space->TakeArrivalPrefetch();
+
 	// create a new space for the system
 	m_space.reset(); // HACK: Here because next line will create Frames *before* deleting existing ones
-	m_space.reset(new Space(this, m_galaxy, m_hyperspaceDest, m_space.get()));
+	m_space.reset(new Space(this, m_galaxy, m_hyperspaceDest, m_space.get(), arrival.get()));
 	m_state = State::NORMAL;
 
 	// put the player in it
@@ -651,6 +731,8 @@ void Game::SwitchToNormalSpace()
 	Frame::GetFrame(m_player->GetFrame())->GetCollisionSpace()->RebuildObjectTrees();
 }
 
+bool Game::s_fastForwardEnabled = false;
+
 const float Game::s_timeAccelRates[] = {
 	0.0f,	  // paused
 	1.0f,	  // 1x
@@ -901,26 +983,52 @@ Json Game::LoadGameToJson(const std::string &filename)
 		Output("Loading saved game '%s' failed.\n", filename.c_str());
 		throw SavedGameCorruptException();
 	}
-	if (!rootNode["version"].is_number_integer() || rootNode["version"].get<int>() != s_saveVersion) {
+	if (!IsLoadableSaveVersion(rootNode["version"])) {
 		Output("Loading saved game '%s' failed: wrong save file version.\n", filename.c_str());
 		throw SavedGameCorruptException();
 	}
 	return rootNode;
 }
 
+Json Game::LoadGameSummary(const std::string &filename)
+{
+	PROFILE_SCOPED()
+	Json summary = JsonUtils::LoadSaveSummary(FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, filename), FileSystem::userFiles);
+	if (!summary.is_object())
+		return LoadGameToJson(filename); // saved before the summaries were
+	if (!IsLoadableSaveVersion(summary["version"])) {
+		Output("Loading saved game '%s' failed: wrong save file version.\n", filename.c_str());
+		throw SavedGameCorruptException();
+	}
+	return summary;
+}
+
 Game *Game::LoadGame(const std::string &filename)
 {
 	Output("Game::LoadGame('%s')\n", filename.c_str());
 
-	Json rootNode = LoadGameToJson(filename);
+	// the tree is parsed into an arena and freed in one go once the game has
+	// been built from it; the game itself is built outside of the arena, as
+	// what it keeps must outlive the tree
+	JsonArena arena;
+	Json rootNode;
+	{
+		JsonArena::Scope scope(arena);
+		rootNode = LoadGameToJson(filename);
+	}
 
+	Game *game = nullptr;
 	try {
-		return new Game(rootNode);
+		game = new Game(rootNode);
 	} catch (const Json::type_error &) {
-		throw SavedGameCorruptException();
 	} catch (const Json::out_of_range &) {
-		throw SavedGameCorruptException();
 	}
+
+	JsonArena::Scope scope(arena);
+	rootNode = Json();
+	if (!game)
+		throw SavedGameCorruptException();
+	return game;
 }
 
 bool Game::CanLoadGame(const std::string &filename)
@@ -949,54 +1057,202 @@ bool Game::DeleteSave(const std::string &filename)
 	return FileSystem::userFiles.RemoveFile(filePath);
 }
 
+// Saves are written to a temporary file in the user dir, out of the way of
+// the list of saves, and renamed over the old save once complete, so a half-written save never
+// replaces a good one. Every save gets a serial number: a save that finishes
+// after a newer one of the same file is dropped.
+namespace {
+	std::mutex s_saveMutex;
+	std::condition_variable s_saveDone;
+	Uint64 s_nextSaveSerial = 1;
+	std::map<std::string, Uint64> s_writtenSaveSerials;
+	// saves queued or being written
+	int s_pendingSaves = 0;
+	std::unique_ptr<JobSet> s_saveJobs;
+
+	// what the list of saves shows, stored in the header of the save
+	Json SaveSummary(const Json &rootNode)
+	{
+		Json summary = Json::object();
+		summary["version"] = rootNode["version"];
+		summary["time"] = rootNode["time"];
+		summary["game_info"] = rootNode["game_info"];
+		return summary;
+	}
+
+	Uint64 NextSaveSerial()
+	{
+		std::lock_guard<std::mutex> lock(s_saveMutex);
+		return s_nextSaveSerial++;
+	}
+
+	// the checks done before anything is written, throw like SaveGame
+	std::string CheckSavePath(const std::string &filename, Game *game)
+	{
+		if (game->IsHyperspace())
+			throw CannotSaveInHyperspace();
+
+		if (game->GetPlayer()->IsDead())
+			throw CannotSaveDeadPlayer();
+
+		if (!FileSystem::userFiles.MakeDirectory(Pi::SAVE_DIR_NAME))
+			throw CouldNotOpenFileException();
+
+		if (!FileSystem::IsValidFilename(filename))
+			throw std::invalid_argument(filename);
+
+		try {
+			return FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, filename);
+		} catch (const std::invalid_argument &) {
+			throw CouldNotOpenFileException();
+		}
+	}
+
+	// throws CouldNotOpenFileException or CouldNotWriteToFileException
+	void WriteSaveFile(const std::string &path, Uint64 serial, const std::string &data)
+	{
+		const std::string tempPath = fmt::format("savegame.{}.saving", serial);
+		FILE *f = FileSystem::userFiles.OpenWriteStream(tempPath);
+		if (!f)
+			throw CouldNotOpenFileException();
+
+		const size_t nwritten = fwrite(data.data(), data.size(), 1, f);
+		if (fclose(f) != 0 || nwritten != 1) {
+			FileSystem::userFiles.RemoveFile(tempPath);
+			throw CouldNotWriteToFileException();
+		}
+
+		std::lock_guard<std::mutex> lock(s_saveMutex);
+		Uint64 &written = s_writtenSaveSerials[path];
+		if (serial < written) {
+			// a newer save of this file is already there
+			FileSystem::userFiles.RemoveFile(tempPath);
+			return;
+		}
+
+		if (!FileSystem::userFiles.RenameFile(tempPath, path)) {
+			FileSystem::userFiles.RemoveFile(tempPath);
+			throw CouldNotWriteToFileException();
+		}
+		written = serial;
+	}
+
+	class SaveGameJob : public Job {
+	public:
+		SaveGameJob(const std::string &path, Uint64 serial, Json &&rootNode, std::unique_ptr<JsonArena> &&arena) :
+			m_path(path),
+			m_serial(serial),
+			m_arena(std::move(arena)),
+			m_rootNode(std::move(rootNode))
+		{}
+
+		virtual void OnRun() override
+		{
+			PROFILE_SCOPED()
+			{
+				JsonArena::Scope scope(*m_arena);
+				try {
+					WriteSaveFile(m_path, m_serial, JsonUtils::EncodeSaveData(m_rootNode, SaveSummary(m_rootNode)));
+				} catch (const lz4::CompressionFailedException &) {
+					m_error = "compression failed";
+				} catch (const CouldNotOpenFileException &) {
+					m_error = "couldn't open the file";
+				} catch (const CouldNotWriteToFileException &) {
+					m_error = "couldn't write the file";
+				}
+				m_rootNode = Json();
+			}
+			m_arena.reset();
+
+			std::lock_guard<std::mutex> lock(s_saveMutex);
+			s_pendingSaves--;
+			s_saveDone.notify_all();
+		}
+
+		virtual void OnFinish() override
+		{
+			if (!m_error.empty())
+				Log::Warning("Saving the game to {} failed: {}\n", m_path, m_error);
+		}
+
+		virtual const char *GetJobName() const override { return "SaveGameJob"; }
+
+	private:
+		std::string m_path;
+		Uint64 m_serial;
+		// the tree is built from the arena, so goes first
+		std::unique_ptr<JsonArena> m_arena;
+		Json m_rootNode;
+		std::string m_error;
+	};
+} // namespace
+
 void Game::SaveGame(const std::string &filename, Game *game)
 {
 	PROFILE_SCOPED()
 	assert(game);
 
-	if (game->IsHyperspace())
-		throw CannotSaveInHyperspace();
+	const std::string path = CheckSavePath(filename, game);
+	const Uint64 serial = NextSaveSerial();
 
-	if (game->GetPlayer()->IsDead())
-		throw CannotSaveDeadPlayer();
+	// the tree is built in an arena and thrown away in one go once written
+	JsonArena arena;
+	JsonArena::Scope scope(arena);
 
-	if (!FileSystem::userFiles.MakeDirectory(Pi::SAVE_DIR_NAME))
-		throw CouldNotOpenFileException();
+	Json rootNode;
+	game->ToJson(rootNode); // Encode the game data as JSON and give to the root value.
 
-	if (!FileSystem::IsValidFilename(filename))
-		throw std::invalid_argument(filename);
-	FILE *f;
 	try {
-		f = FileSystem::userFiles.OpenWriteStream(FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, filename));
-	} catch (const std::invalid_argument &) {
-		throw CouldNotOpenFileException();
+		// Compress the CBOR data.
+		WriteSaveFile(path, serial, JsonUtils::EncodeSaveData(rootNode, SaveSummary(rootNode)));
+	} catch (const lz4::CompressionFailedException &) {
+		throw CouldNotWriteToFileException();
 	}
-	if (!f)
-		throw CouldNotOpenFileException();
+
+	Pi::GetApp()->RequestProfileFrame("SaveGame");
+}
+
+void Game::SaveGameInBackground(const std::string &filename, Game *game)
+{
+	PROFILE_SCOPED()
+	assert(game);
+
+	const std::string path = CheckSavePath(filename, game);
+	const Uint64 serial = NextSaveSerial();
+
+	// the Json tree is the snapshot, the job has the only copy of it and
+	// frees it along with the arena it is built in
+	std::unique_ptr<JsonArena> arena(new JsonArena());
 	Json rootNode;
-	game->ToJson(rootNode); // Encode the game data as JSON and give to the root value.
-	std::vector<uint8_t> jsonData;
 	{
-		PROFILE_SCOPED_DESC("json.to_cbor");
-		jsonData = Json::to_cbor(rootNode); // Convert the JSON data to CBOR.
+		JsonArena::Scope scope(*arena);
+		game->ToJson(rootNode);
 	}
 
-	try {
-		// Compress the CBOR data.
-		const std::string comressed_data = gzip::CompressGZip(
-			std::string(reinterpret_cast<const char *>(jsonData.data()), jsonData.size()),
-			filename + ".json");
-		size_t nwritten = fwrite(comressed_data.data(), comressed_data.size(), 1, f);
-		fclose(f);
-		if (nwritten != 1) throw CouldNotWriteToFileException();
-	} catch (gzip::CompressionFailedException) {
-		fclose(f);
-		throw CouldNotWriteToFileException();
+	if (!s_saveJobs)
+		s_saveJobs.reset(new JobSet(Pi::GetAsyncJobQueue()));
+
+	{
+		std::lock_guard<std::mutex> lock(s_saveMutex);
+		s_pendingSaves++;
 	}
+	s_saveJobs->Order(new SaveGameJob(path, serial, std::move(rootNode), std::move(arena)));
 
 	Pi::GetApp()->RequestProfileFrame("SaveGame");
 }
 
+void Game::FinishBackgroundSaves()
+{
+	PROFILE_SCOPED()
+	{
+		std::unique_lock<std::mutex> lock(s_saveMutex);
+		s_saveDone.wait(lock, [] { return s_pendingSaves == 0; });
+	}
+
+	// the jobs have all run, the handles can go before the job queue does
+	s_saveJobs.reset();
+}
+
 int Game::CurrentSaveVersion()
 {
 	return s_saveVersion;
@@ -38,12 +38,22 @@ class ObjectViewerView;
 class Game {
 public:
 	static Json LoadGameToJson(const std::string &filename);
+	// The version, time and game_info of a saved game, read from the header
+	// of the file; falls back to the whole game for saves without one
+	static Json LoadGameSummary(const std::string &filename);
 	// LoadGame and SaveGame throw exceptions on failure
 	static Game *LoadGame(const std::string &filename);
 	static bool CanLoadGame(const std::string &filename);
 	// XXX game arg should be const, and this should probably be a member function
 	// (or LoadGame/SaveGame should be somewhere else entirely)
 	static void SaveGame(const std::string &filename, Game *game);
+	// Like SaveGame, but only the snapshot of the game is taken right away;
+	// it's compressed and written on a worker thread. Failing to write it is
+	// only logged.
+	static void SaveGameInBackground(const std::string &filename, Game *game);
+	// Block until the saves started by SaveGameInBackground are written;
+	// must be called before the job queue is destroyed
+	static void FinishBackgroundSaves();
 	static bool DeleteSave(const std::string &filename);
 	static int CurrentSaveVersion();
 
@@ -70,6 +80,18 @@ public:
 	// physics step
 	void TimeStep(float step);
 
+	// Fast forward: at 10000x, while the player coasts with autopilot off
+	// and every other ship is on rails (see Ship::SetOnRailsEnabled), docked
+	// or landed, runs of steps are taken as one. The player is put on rails
+	// as well, so every body follows its orbit exactly however long the
+	// step. A run never passes the next Lua timer or hyperspace arrival, nor
+	// the point where the player could have come close enough to anything
+	// for the time acceleration to drop.
+	static void SetFastForwardEnabled(bool enabled) { s_fastForwardEnabled = enabled; }
+	static bool IsFastForwardEnabled() { return s_fastForwardEnabled; }
+	// Whether the step being taken is a fast forward one
+	bool IsFastForwarding() const { return m_fastForwarding; }
+
 	// update time acceleration once per render frame
 	// returns true if timeaccel was changed
 	bool UpdateTimeAccel();
@@ -157,6 +179,9 @@ private:
 	void SwitchToHyperspace();
 	void SwitchToNormalSpace();
 
+	// How many steps the next one can be fast forwarded by, 1 for none
+	int GetFastForwardSteps(float step) const;
+
 	std::unique_ptr<Player> m_player;
 
 	RefCountedPtr<Galaxy> m_galaxy;
@@ -182,6 +207,8 @@ private:
 	TimeAccel m_timeAccel;
 	TimeAccel m_requestedTimeAccel;
 	bool m_forceTimeAccel;
+	bool m_fastForwarding;
+	static bool s_fastForwardEnabled;
 	static const float s_timeAccelRates[];
 	static const float s_timeInvAccelRates[];
 };
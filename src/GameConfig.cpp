@@ -18,6 +18,24 @@ GameConfig::GameConfig(const map_string &override_)
 	map["UIScaleFactor"] = "1";
 	map["DetailCities"] = "1";
 	map["DetailPlanets"] = "1";
+	map["QualityGovernorTargetMs"] = "0";
+	map["GeoPatchCacheMB"] = "256";
+	map["TextureStreamingMB"] = "1024";
+	map["AsyncTextureLoading"] = "1";
+	map["CompressTexturesOnLoad"] = "1";
+	map["TextureCacheMB"] = "256";
+	map["ModelCacheMB"] = "256";
+	map["GeoPatchLookAhead"] = "2.0";
+	map["GeoPatchCoherentCulling"] = "0";
+	map["ApproachPrefetchTime"] = "60.0";
+	map["GasGiantCacheMB"] = "128";
+	map["ShaderCacheMB"] = "32";
+	map["VRAMBudgetMB"] = "0";
+	map["GLUploadThread"] = "0";
+	map["LuaCacheMB"] = "16";
+	map["GalaxyCacheMB"] = "64";
+	map["SectorCacheMB"] = "16";
+	map["StarSystemCacheMB"] = "32";
 	map["SfxVolume"] = "0.8";
 	map["EnableJoystick"] = "1";
 	map["InvertMouseY"] = "0";
@@ -34,16 +52,30 @@ GameConfig::GameConfig(const map_string &override_)
 	map["SectorViewZRotation"] = "0";
 	map["SectorViewZoom"] = "2.0";
 	map["MaxPhysicsCyclesPerRender"] = "4";
+	map["PhysicsBudgetMs"] = "0";
 	map["AntiAliasingMode"] = "2";
 	map["JoystickDeadzone"] = "0.2"; // 20% deadzone is common
 	map["DefaultLowThrustPower"] = "0.25";
 	map["VSync"] = "1";
 	map["UseTextureCompression"] = "1";
 	map["WorkerThreads"] = "0";
+	map["WorkStealing"] = "1";
+	map["JobFinishBudgetMs"] = "4.0";
+	map["LuaGCFrameTargetMs"] = "16.0";
+	map["ParallelBodyUpdate"] = "0";
+	map["ParallelCollision"] = "0";
+	map["BodyNearGrid"] = "1";
+	map["CollisionContactCache"] = "1";
+	map["ShipsOnRails"] = "1";
+	map["FastForward"] = "0";
+	map["AILevelOfDetail"] = "1";
+	map["ProjectilePool"] = "1";
+	map["TrafficRelevanceRadius"] = "1e8";
 	map["SpeedLines"] = "0";
 	map["EnableCockpit"] = "0";
 	map["HudTrails"] = "0";
 	map["EnableServerAgent"] = "0";
+	map["ServerAgentMaxRequests"] = "4";
 	map["AmountOfBackgroundStars"] = "0.25";
 	map["StarFieldStarSizeFactor"] = "0.7";
 	map["UseAnisotropicFiltering"] = "0";
@@ -54,6 +86,9 @@ GameConfig::GameConfig(const map_string &override_)
 	map["LogVerbose"] = "1";
 	map["ProfileSlowFrames"] = "0";
 	map["ProfilerZoneOutput"] = "0";
+	map["ProfilerCaptureSeconds"] = "0";
+	map["ProfilerHitchCaptureFrames"] = "0";
+	map["HitchThresholdMs"] = "100";
 	map["CameraSmoothing"] = "0";
 	map["AimingSensitivity"] = "1.0";
 
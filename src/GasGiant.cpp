@@ -3,10 +3,14 @@
 
 #include "GasGiant.h"
 
+#include "DiskCache.h"
 #include "FileSystem.h"
 #include "Game.h"
 #include "GameConfig.h"
+#include "GeoPatchCache.h"
 #include "Pi.h"
+#include "core/FNV1a.h"
+#include "core/MemoryTag.h"
 #include "galaxy/AtmosphereParameters.h"
 #include "graphics/Frustum.h"
 #include "graphics/Graphics.h"
@@ -17,9 +21,14 @@
 #include "graphics/Types.h"
 #include "graphics/VertexArray.h"
 #include "perlin.h"
+#include "scenegraph/Serializer.h"
 #include "utils.h"
 #include "vcacheopt/vcacheopt.h"
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 RefCountedPtr<GasPatchContext> GasGiant::s_patchContext;
 Graphics::RenderTarget *GasGiant::s_renderTarget;
 
@@ -32,6 +41,10 @@ namespace {
 	static float s_initialGPUDelayTime = 5.0f;	// (perhaps) 5 seconds seems like a reasonable default
 	static std::vector<GasGiant *> s_allGasGiants;
 
+	// bump this whenever the texture generation changes, so old entries are ignored
+	static const Uint32 TEXTURE_CACHE_VERSION = 1;
+	static DiskCache s_textureCache("gasgiant_cache", TEXTURE_CACHE_VERSION);
+
 	static const std::string GGJupiter("GGJupiter");
 	static const std::string GGNeptune("GGNeptune");
 	static const std::string GGNeptune2("GGNeptune2");
@@ -178,6 +191,7 @@ public:
 #endif
 
 		//create buffer & copy
+		MemoryTag::Scope memoryScope(MemoryTag::TERRAIN);
 		indexBuffer.Reset(Pi::renderer->CreateIndexBuffer(pl_short.size(), Graphics::BUFFER_USAGE_STATIC));
 		Uint32 *idxPtr = indexBuffer->Map(Graphics::BUFFER_MAP_WRITE);
 		for (Uint32 j = 0; j < pl_short.size(); j++) {
@@ -230,6 +244,7 @@ public:
 	{
 		PROFILE_SCOPED()
 		//create buffer and upload data
+		MemoryTag::Scope memoryScope(MemoryTag::TERRAIN);
 		auto vbd = Graphics::VertexBufferDesc::FromAttribSet(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL);
 		vbd.numVertices = ctx->NUMVERTICES();
 		vbd.usage = Graphics::BUFFER_USAGE_STATIC;
@@ -301,6 +316,8 @@ GasGiant::GasGiant(const SystemBody *body) :
 	m_hasTempCampos(false),
 	m_tempCampos(0.0),
 	m_hasGpuJobRequest(false),
+	m_hasCacheJobRequest(false),
+	m_textureCacheKey(0),
 	m_timeDelay(s_initialCPUDelayTime)
 {
 	s_allGasGiants.push_back(this);
@@ -336,6 +353,8 @@ void GasGiant::Reset()
 			m_hasJobRequest[i] = false;
 		}
 	}
+	m_cacheLoadJob = Job::Handle();
+	m_hasCacheJobRequest = false;
 
 	for (int p = 0; p < NUM_PATCHES; p++) {
 		// delete patches
@@ -347,6 +366,8 @@ void GasGiant::Reset()
 	m_surfaceTextureSmall.Reset();
 	m_surfaceTexture.Reset();
 	m_surfaceMaterial.Reset();
+	m_uploadingTexture.Reset();
+	m_uploadTicket.Reset();
 }
 
 //static
@@ -385,6 +406,112 @@ bool GasGiant::OnAddGPUGenResult(const SystemPath &path, GasGiantJobs::SGPUGenRe
 	return false;
 }
 
+//static
+bool GasGiant::OnAddTextureCacheResult(const SystemPath &path, GasGiantJobs::STextureCacheResult *res)
+{
+	// Find the correct GasGiant via it's system path, and give it the cached faces
+	for (std::vector<GasGiant *>::iterator i = s_allGasGiants.begin(), iEnd = s_allGasGiants.end(); i != iEnd; ++i) {
+		if (path == (*i)->GetSystemBody()->GetPath()) {
+			(*i)->AddTextureCacheResult(res);
+			return true;
+		}
+	}
+	delete res;
+	return false;
+}
+
+static void UpdateCubeFaces(Graphics::Texture *texture, Color *const *faces, const vector3f &dataSize)
+{
+	Graphics::TextureCubeData tcd;
+	tcd.posX = faces[0];
+	tcd.negX = faces[1];
+	tcd.posY = faces[2];
+	tcd.negY = faces[3];
+	tcd.posZ = faces[4];
+	tcd.negZ = faces[5];
+	texture->Update(tcd, dataSize, Graphics::TEXTURE_RGBA_8888);
+}
+
+void GasGiant::CreateSurfaceTexture(Color *const *faces, Sint32 uvDims)
+{
+	const vector2f texSize(1.0f, 1.0f);
+	const vector3f dataSize(uvDims, uvDims, 0.0f);
+	const Graphics::TextureDescriptor texDesc(
+		Graphics::TEXTURE_RGBA_8888,
+		dataSize, texSize, Graphics::LINEAR_CLAMP,
+		true, false, false, 0, Graphics::TEXTURE_CUBE_MAP);
+	RefCountedPtr<Graphics::Texture> texture(Pi::renderer->CreateTexture(texDesc));
+
+	if (Pi::renderer->HasUploadThread()) {
+		// the faces aren't ours to keep, so the upload thread gets a copy;
+		// the small texture is drawn until it's done
+		const size_t faceSize = size_t(uvDims) * size_t(uvDims);
+		auto data = std::make_shared<std::vector<Color>>(faceSize * NUM_PATCHES);
+		for (int i = 0; i < NUM_PATCHES; i++)
+			std::copy(faces[i], faces[i] + faceSize, data->begin() + i * faceSize);
+
+		m_uploadingTexture = texture;
+		m_uploadTicket = Pi::renderer->UploadTexture(texture.Get(), [data, faceSize, dataSize](Graphics::Texture *tex) {
+			Color *copies[NUM_PATCHES];
+			for (int i = 0; i < NUM_PATCHES; i++)
+				copies[i] = data->data() + i * faceSize;
+			UpdateCubeFaces(tex, copies, dataSize);
+		});
+		FinishUpload();
+		return;
+	}
+
+	UpdateCubeFaces(texture.Get(), faces, dataSize);
+	SetSurfaceTexture(texture);
+}
+
+void GasGiant::FinishUpload()
+{
+	if (!m_uploadTicket || !m_uploadTicket->IsDone())
+		return;
+	SetSurfaceTexture(m_uploadingTexture);
+	m_uploadingTexture.Reset();
+	m_uploadTicket.Reset();
+}
+
+void GasGiant::SetSurfaceTexture(RefCountedPtr<Graphics::Texture> texture)
+{
+	m_surfaceTexture = texture;
+
+	// change the planet texture for the new higher resolution texture
+	if (m_surfaceMaterial.Get()) {
+		m_surfaceMaterial->SetTexture("texture0"_hash,
+			m_surfaceTexture.Get());
+		m_surfaceTextureSmall.Reset();
+	}
+}
+
+// Hand the generated faces to a job that writes them to the disk cache
+void GasGiant::StoreFaces(std::unique_ptr<Color[]> *faces, Sint32 uvDims)
+{
+	if (!s_textureCache.IsEnabled())
+		return;
+	m_cacheStoreJob = Pi::GetAsyncJobQueue()->Queue(new GasGiantJobs::TextureCacheStoreJob(&s_textureCache, m_textureCacheKey, uvDims, faces));
+}
+
+bool GasGiant::AddTextureCacheResult(GasGiantJobs::STextureCacheResult *res)
+{
+	assert(res);
+	m_hasCacheJobRequest = false;
+
+	if (res->Found()) {
+		Color *faces[NUM_PATCHES];
+		for (int i = 0; i < NUM_PATCHES; i++)
+			faces[i] = res->Colors(i);
+		CreateSurfaceTexture(faces, res->UVDims());
+	} else {
+		GenerateFaces();
+	}
+
+	delete res;
+	return true;
+}
+
 bool GasGiant::AddTextureFaceResult(GasGiantJobs::STextureFaceResult *res)
 {
 	bool result = false;
@@ -404,36 +531,17 @@ bool GasGiant::AddTextureFaceResult(GasGiantJobs::STextureFaceResult *res)
 	}
 
 	if (bCreateTexture) {
-		// create texture
-		const vector2f texSize(1.0f, 1.0f);
-		const vector3f dataSize(uvDims, uvDims, 0.0f);
-		const Graphics::TextureDescriptor texDesc(
-			Graphics::TEXTURE_RGBA_8888,
-			dataSize, texSize, Graphics::LINEAR_CLAMP,
-			true, false, false, 0, Graphics::TEXTURE_CUBE_MAP);
-		m_surfaceTexture.Reset(Pi::renderer->CreateTexture(texDesc));
-
-		// update with buffer from above
-		Graphics::TextureCubeData tcd;
-		tcd.posX = m_jobColorBuffers[0].get();
-		tcd.negX = m_jobColorBuffers[1].get();
-		tcd.posY = m_jobColorBuffers[2].get();
-		tcd.negY = m_jobColorBuffers[3].get();
-		tcd.posZ = m_jobColorBuffers[4].get();
-		tcd.negZ = m_jobColorBuffers[5].get();
-		m_surfaceTexture->Update(tcd, dataSize, Graphics::TEXTURE_RGBA_8888);
-
-		// cleanup the temporary color buffer storage
+		// create texture with buffer from above
+		Color *faces[NUM_PATCHES];
+		for (int i = 0; i < NUM_PATCHES; i++)
+			faces[i] = m_jobColorBuffers[i].get();
+		CreateSurfaceTexture(faces, uvDims);
+
+		// the cache store takes over the temporary color buffer storage
+		StoreFaces(m_jobColorBuffers, uvDims);
 		for (int i = 0; i < NUM_PATCHES; i++) {
 			m_jobColorBuffers[i].reset();
 		}
-
-		// change the planet texture for the new higher resolution texture
-		if (m_surfaceMaterial.Get()) {
-			m_surfaceMaterial->SetTexture("texture0"_hash,
-				m_surfaceTexture.Get());
-			m_surfaceTextureSmall.Reset();
-		}
 	}
 
 	return result;
@@ -445,10 +553,8 @@ bool GasGiant::AddGPUGenResult(GasGiantJobs::SGPUGenResult *res)
 	assert(res);
 	m_hasGpuJobRequest = false;
 	assert(!m_gpuJob.HasJob());
-#ifndef NDEBUG
 	const Sint32 uvDims = res->data().uvDims;
 	assert(uvDims > 0 && uvDims <= 4096);
-#endif
 
 	// tidyup
 	delete res;
@@ -457,6 +563,18 @@ bool GasGiant::AddGPUGenResult(GasGiantJobs::SGPUGenResult *res)
 		m_surfaceTexture = m_builtTexture;
 		m_builtTexture.Reset();
 
+		// read the faces back once, so next time they can come from the cache
+		if (s_textureCache.IsEnabled()) {
+			std::unique_ptr<Color[]> faces[NUM_PATCHES];
+			bool valid = true;
+			for (int i = 0; valid && i < NUM_PATCHES; i++) {
+				faces[i].reset(new Color[uvDims * uvDims]);
+				valid = m_surfaceTexture->ReadPixels(faces[i].get(), i);
+			}
+			if (valid)
+				StoreFaces(faces, uvDims);
+		}
+
 		// these won't be automatically generated otherwise since we used it as a render target
 		m_surfaceTexture->BuildMipmaps();
 
@@ -481,12 +599,10 @@ void GasGiant::GenerateTexture()
 {
 	using namespace GasGiantJobs;
 	for (int i = 0; i < NUM_PATCHES; i++) {
-		if (m_hasGpuJobRequest || m_hasJobRequest[i])
+		if (m_hasGpuJobRequest || m_hasCacheJobRequest || m_hasJobRequest[i])
 			return;
 	}
 
-	const bool bEnableGPUJobs = (Pi::config->Int("EnableGPUJobs") == 1);
-
 	// scope the small texture generation
 	{
 		const vector2f texSize(1.0f, 1.0f);
@@ -536,7 +652,70 @@ void GasGiant::GenerateTexture()
 		m_surfaceTextureSmall->Update(tcd, dataSize, Graphics::TEXTURE_RGBA_8888);
 	}
 
-	// create small texture
+	// look for the faces in the disk cache first, GenerateFaces is called if they aren't there
+	if (s_textureCache.IsEnabled()) {
+		const bool bEnableGPUJobs = (Pi::config->Int("EnableGPUJobs") == 1);
+		const Uint32 uvDims = bEnableGPUJobs ? s_texture_size_gpu[Pi::detail.planets] : s_texture_size_cpu[Pi::detail.planets];
+		m_textureCacheKey = GetTextureCacheKey(bEnableGPUJobs, uvDims);
+
+		assert(!m_cacheLoadJob.HasJob());
+		m_hasCacheJobRequest = true;
+		m_cacheLoadJob = Pi::GetAsyncJobQueue()->Queue(new GasGiantJobs::TextureCacheLoadJob(&s_textureCache, m_textureCacheKey, GetSystemBody()->GetPath(), uvDims));
+		return;
+	}
+
+	GenerateFaces();
+}
+
+void GasGiant::GetGPUGenParams(Uint32 &gasGiantType, float &hueShift) const
+{
+	using namespace GasGiantJobs;
+	const std::string ColorFracName = GetTerrain()->GetColorFractalName();
+
+	gasGiantType = GasGiantTexture::GEN_JUPITER_TEXTURE;
+	if (ColorFracName == GGSaturn) {
+		gasGiantType = GasGiantTexture::GEN_SATURN_TEXTURE;
+	} else if (ColorFracName == GGSaturn2) {
+		gasGiantType = GasGiantTexture::GEN_SATURN2_TEXTURE;
+	} else if (ColorFracName == GGNeptune) {
+		gasGiantType = GasGiantTexture::GEN_NEPTUNE_TEXTURE;
+	} else if (ColorFracName == GGNeptune2) {
+		gasGiantType = GasGiantTexture::GEN_NEPTUNE2_TEXTURE;
+	} else if (ColorFracName == GGUranus) {
+		gasGiantType = GasGiantTexture::GEN_URANUS_TEXTURE;
+	}
+	const Uint32 octaves = (Pi::config->Int("AMD_MESA_HACKS") == 0) ? s_noiseOctaves[Pi::detail.planets] : std::min(5U, s_noiseOctaves[Pi::detail.planets]);
+	gasGiantType = (octaves << 16) | gasGiantType;
+
+	Random rng(GetSystemBody()->GetSeed() + 4609837);
+	const std::string parentname = GetSystemBody()->GetParent()->GetName();
+	hueShift = (parentname == "Sol") ? 0.0f : float(((rng.Double() * 2.0) - 1.0) * 0.9);
+}
+
+// Key covering everything the generated faces depend on
+uint64_t GasGiant::GetTextureCacheKey(bool gpu, Uint32 uvDims) const
+{
+	Serializer::Writer wr;
+	wr.Int64(GeoPatchCache::GetTerrainKey(GetSystemBody(), GetTerrain()));
+	wr.Bool(gpu);
+	wr.Int32(uvDims);
+	if (gpu) {
+		Uint32 gasGiantType;
+		float hueShift;
+		GetGPUGenParams(gasGiantType, hueShift);
+		wr.Int32(gasGiantType);
+		wr.Float(hueShift);
+	}
+
+	const std::string &data = wr.GetData();
+	return hash_64_fnv1a(data.data(), data.size());
+}
+
+void GasGiant::GenerateFaces()
+{
+	using namespace GasGiantJobs;
+	const bool bEnableGPUJobs = (Pi::config->Int("EnableGPUJobs") == 1);
+
 	if (!bEnableGPUJobs) {
 		for (int i = 0; i < NUM_PATCHES; i++) {
 			assert(!m_hasJobRequest[i]);
@@ -556,31 +735,15 @@ void GasGiant::GenerateTexture()
 			true, false, false, 0, Graphics::TEXTURE_CUBE_MAP);
 		m_builtTexture.Reset(Pi::renderer->CreateTexture(texDesc));
 
-		const std::string ColorFracName = GetTerrain()->GetColorFractalName();
-		Output("Color Fractal name: %s\n", ColorFracName.c_str());
-
-		Uint32 GasGiantType = GasGiantTexture::GEN_JUPITER_TEXTURE;
-		if (ColorFracName == GGSaturn) {
-			GasGiantType = GasGiantTexture::GEN_SATURN_TEXTURE;
-		} else if (ColorFracName == GGSaturn2) {
-			GasGiantType = GasGiantTexture::GEN_SATURN2_TEXTURE;
-		} else if (ColorFracName == GGNeptune) {
-			GasGiantType = GasGiantTexture::GEN_NEPTUNE_TEXTURE;
-		} else if (ColorFracName == GGNeptune2) {
-			GasGiantType = GasGiantTexture::GEN_NEPTUNE2_TEXTURE;
-		} else if (ColorFracName == GGUranus) {
-			GasGiantType = GasGiantTexture::GEN_URANUS_TEXTURE;
-		}
-		const Uint32 octaves = (Pi::config->Int("AMD_MESA_HACKS") == 0) ? s_noiseOctaves[Pi::detail.planets] : std::min(5U, s_noiseOctaves[Pi::detail.planets]);
-		GasGiantType = (octaves << 16) | GasGiantType;
+		Output("Color Fractal name: %s\n", GetTerrain()->GetColorFractalName());
+
+		Uint32 GasGiantType;
+		float hueShift;
+		GetGPUGenParams(GasGiantType, hueShift);
 
 		assert(!m_hasGpuJobRequest);
 		assert(!m_gpuJob.HasJob());
 
-		Random rng(GetSystemBody()->GetSeed() + 4609837);
-		const std::string parentname = GetSystemBody()->GetParent()->GetName();
-		const float hueShift = (parentname == "Sol") ? 0.0f : float(((rng.Double() * 2.0) - 1.0) * 0.9);
-
 		GasGiantJobs::GenFaceQuad *pQuad = new GasGiantJobs::GenFaceQuad(Pi::renderer, vector2f(s_texture_size_gpu[Pi::detail.planets], s_texture_size_gpu[Pi::detail.planets]), GasGiantType);
 
 		GasGiantJobs::SGPUGenRequest *pGPUReq = new GasGiantJobs::SGPUGenRequest(GetSystemBody()->GetPath(), s_texture_size_gpu[Pi::detail.planets], GetTerrain(), GetSystemBody()->GetRadius(), hueShift, pQuad, m_builtTexture.Get());
@@ -595,7 +758,7 @@ void GasGiant::Update()
 	// assuming that we haven't already generated the texture from the render call.
 	if (m_timeDelay > 0.0f) {
 		m_timeDelay -= Pi::game->GetTimeStep();
-		if (m_timeDelay <= 0.0001f && !m_surfaceTexture.Valid()) {
+		if (m_timeDelay <= 0.0001f && !m_surfaceTexture.Valid() && !m_uploadTicket) {
 			// Use the fact that we have a patch as a latch to prevent repeat generation requests.
 			if (m_patches[0].get())
 				return;
@@ -606,10 +769,11 @@ void GasGiant::Update()
 	}
 }
 
-void GasGiant::Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const std::vector<Camera::Shadow> &shadows)
+void GasGiant::Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const Camera::ShadowList &shadows)
 {
 	PROFILE_SCOPED()
-	if (!m_surfaceTexture.Valid()) {
+	FinishUpload();
+	if (!m_surfaceTexture.Valid() && !m_uploadTicket) {
 		// Use the fact that we have a patch as a latch to prevent repeat generation requests.
 		if (!m_patches[0].get()) {
 			BuildFirstPatches();
@@ -762,10 +926,13 @@ void GasGiant::Init()
 		s_patchContext.Reset(new GasPatchContext(127));
 	}
 	CreateRenderTarget(s_texture_size_gpu[Pi::detail.planets], s_texture_size_gpu[Pi::detail.planets]);
+
+	s_textureCache.Init(size_t(std::max(0, Pi::config->Int("GasGiantCacheMB"))) * 1024 * 1024);
 }
 
 void GasGiant::Uninit()
 {
+	s_textureCache.Uninit();
 	s_patchContext.Reset();
 }
 
@@ -15,6 +15,7 @@ namespace Graphics {
 	class Renderer;
 	class RenderTarget;
 	class Texture;
+	class UploadTicket;
 } // namespace Graphics
 
 class SystemBody;
@@ -36,7 +37,7 @@ public:
 	virtual ~GasGiant();
 
 	virtual void Update() override;
-	virtual void Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const std::vector<Camera::Shadow> &shadows) override;
+	virtual void Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const Camera::ShadowList &shadows) override;
 
 	virtual double GetHeight(const vector3d &p) const override final { return 0.0; }
 
@@ -47,6 +48,7 @@ public:
 
 	static bool OnAddTextureFaceResult(const SystemPath &path, GasGiantJobs::STextureFaceResult *res);
 	static bool OnAddGPUGenResult(const SystemPath &path, GasGiantJobs::SGPUGenResult *res);
+	static bool OnAddTextureCacheResult(const SystemPath &path, GasGiantJobs::STextureCacheResult *res);
 	static void Init();
 	static void Uninit();
 	static void UpdateAllGasGiants();
@@ -61,8 +63,17 @@ public:
 private:
 	void BuildFirstPatches();
 	void GenerateTexture();
+	void GenerateFaces();
+	void GetGPUGenParams(Uint32 &gasGiantType, float &hueShift) const;
+	uint64_t GetTextureCacheKey(bool gpu, Uint32 uvDims) const;
+	void CreateSurfaceTexture(Color *const *faces, Sint32 uvDims);
+	// use the texture once the upload thread is done with it
+	void FinishUpload();
+	void SetSurfaceTexture(RefCountedPtr<Graphics::Texture> texture);
+	void StoreFaces(std::unique_ptr<Color[]> *faces, Sint32 uvDims);
 	bool AddTextureFaceResult(GasGiantJobs::STextureFaceResult *res);
 	bool AddGPUGenResult(GasGiantJobs::SGPUGenResult *res);
+	bool AddTextureCacheResult(GasGiantJobs::STextureCacheResult *res);
 
 	static RefCountedPtr<GasPatchContext> s_patchContext;
 
@@ -77,6 +88,9 @@ private:
 	RefCountedPtr<Graphics::Texture> m_surfaceTextureSmall;
 	RefCountedPtr<Graphics::Texture> m_surfaceTexture;
 	RefCountedPtr<Graphics::Texture> m_builtTexture;
+	// the surface texture while it's on the upload thread
+	RefCountedPtr<Graphics::Texture> m_uploadingTexture;
+	RefCountedPtr<Graphics::UploadTicket> m_uploadTicket;
 
 	std::unique_ptr<Color[]> m_jobColorBuffers[NUM_PATCHES];
 	Job::Handle m_job[NUM_PATCHES];
@@ -85,6 +99,12 @@ private:
 	Job::Handle m_gpuJob;
 	bool m_hasGpuJobRequest;
 
+	// the disk cache is looked up before any faces are generated
+	Job::Handle m_cacheLoadJob;
+	bool m_hasCacheJobRequest;
+	Job::Handle m_cacheStoreJob;
+	uint64_t m_textureCacheKey;
+
 	float m_timeDelay;
 };
 
@@ -3,6 +3,7 @@
 
 #include "GasGiantJobs.h"
 
+#include "DiskCache.h"
 #include "GasGiant.h"
 #include "Pi.h"
 #include "RefCounted.h"
@@ -18,6 +19,7 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <deque>
 
 namespace GasGiantJobs {
@@ -105,6 +107,61 @@ namespace GasGiantJobs {
 		mpResults = nullptr;
 	}
 
+	// ********************************************************************************
+	bool STextureCacheResult::Load(DiskCache *cache, uint64_t key)
+	{
+		PROFILE_SCOPED()
+		std::string data;
+		if (!cache->Load(key, data))
+			return false;
+
+		const size_t faceSize = size_t(uvDims) * uvDims * sizeof(Color);
+		if (data.size() != NUM_FACES * faceSize) {
+			cache->Remove(key);
+			return false;
+		}
+
+		for (Uint32 i = 0; i < NUM_FACES; i++) {
+			colors[i].reset(new Color[uvDims * uvDims]);
+			std::memcpy(colors[i].get(), data.data() + i * faceSize, faceSize);
+		}
+		return true;
+	}
+
+	void TextureCacheLoadJob::OnRun() // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+	{
+		PROFILE_SCOPED()
+		mpResults.reset(new STextureCacheResult(uvDims));
+		mpResults->Load(cache, key);
+	}
+
+	void TextureCacheLoadJob::OnFinish() // runs in primary thread of the context
+	{
+		PROFILE_SCOPED()
+		GasGiant::OnAddTextureCacheResult(sysPath, mpResults.release());
+	}
+
+	TextureCacheStoreJob::TextureCacheStoreJob(DiskCache *cache_, const uint64_t key_, const Sint32 uvDims_, std::unique_ptr<Color[]> *faces) :
+		cache(cache_),
+		key(key_),
+		uvDims(uvDims_)
+	{
+		for (Uint32 i = 0; i < STextureCacheResult::NUM_FACES; i++)
+			colors[i] = std::move(faces[i]);
+	}
+
+	void TextureCacheStoreJob::OnRun() // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+	{
+		PROFILE_SCOPED()
+		const size_t faceSize = size_t(uvDims) * uvDims * sizeof(Color);
+		std::string data;
+		data.reserve(STextureCacheResult::NUM_FACES * faceSize);
+		for (Uint32 i = 0; i < STextureCacheResult::NUM_FACES; i++)
+			data.append(reinterpret_cast<const char *>(colors[i].get()), faceSize);
+
+		cache->Store(key, data);
+	}
+
 	// ********************************************************************************
 
 	struct GenFaceDataBlock {
@@ -15,6 +15,9 @@
 #include "vector3.h"
 
 #include <deque>
+#include <memory>
+
+class DiskCache;
 
 namespace Graphics {
 	class Renderer;
@@ -134,6 +137,7 @@ namespace GasGiantJobs {
 		virtual void OnRun();
 		virtual void OnFinish();
 		virtual void OnCancel() {}
+		virtual const char *GetJobName() const { return "SingleTextureFaceJob"; }
 
 	private:
 		// deliberately prevent copy constructor access
@@ -143,6 +147,77 @@ namespace GasGiantJobs {
 		STextureFaceResult *mpResults;
 	};
 
+	// ********************************************************************************
+	// The six faces of a generated texture as kept in the disk cache: uvDims *
+	// uvDims texels per face, in the order +x, -x, +y, -y, +z, -z
+	// ********************************************************************************
+	class STextureCacheResult {
+	public:
+		static const Uint32 NUM_FACES = 6;
+
+		STextureCacheResult(const Sint32 uvDims_) :
+			uvDims(uvDims_) {}
+
+		// RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+		// Fill the faces from the cache; returns false if it has no valid entry
+		bool Load(DiskCache *cache, uint64_t key);
+
+		inline bool Found() const { return colors[0] != nullptr; }
+		inline Sint32 UVDims() const { return uvDims; }
+		Color *Colors(const Uint32 face) const { return colors[face].get(); }
+
+	protected:
+		// deliberately prevent copy constructor access
+		STextureCacheResult(const STextureCacheResult &r) = delete;
+
+		const Sint32 uvDims;
+		std::unique_ptr<Color[]> colors[NUM_FACES];
+	};
+
+	// ********************************************************************************
+	// Looks the faces up in the disk cache, handing the (possibly empty) result
+	// to GasGiant::OnAddTextureCacheResult
+	// ********************************************************************************
+	class TextureCacheLoadJob : public Job {
+	public:
+		TextureCacheLoadJob(DiskCache *cache_, const uint64_t key_, const SystemPath &sysPath_, const Sint32 uvDims_) :
+			cache(cache_),
+			key(key_),
+			sysPath(sysPath_),
+			uvDims(uvDims_)
+		{ /* empty */
+		}
+
+		virtual void OnRun();
+		virtual void OnFinish();
+		virtual const char *GetJobName() const { return "TextureCacheLoadJob"; }
+
+	private:
+		DiskCache *cache;
+		const uint64_t key;
+		const SystemPath sysPath;
+		const Sint32 uvDims;
+		std::unique_ptr<STextureCacheResult> mpResults;
+	};
+
+	// ********************************************************************************
+	// Compresses and writes generated faces to the disk cache
+	// ********************************************************************************
+	class TextureCacheStoreJob : public Job {
+	public:
+		TextureCacheStoreJob(DiskCache *cache_, const uint64_t key_, const Sint32 uvDims_, std::unique_ptr<Color[]> *faces);
+
+		virtual void OnRun();
+		virtual void OnFinish() {}
+		virtual const char *GetJobName() const { return "TextureCacheStoreJob"; }
+
+	private:
+		DiskCache *cache;
+		const uint64_t key;
+		const Sint32 uvDims;
+		std::unique_ptr<Color[]> colors[STextureCacheResult::NUM_FACES];
+	};
+
 	// ********************************************************************************
 	// a quad with reversed winding
 	class GenFaceQuad {
@@ -228,6 +303,7 @@ namespace GasGiantJobs {
 		virtual void OnRun();
 		virtual void OnFinish();
 		virtual void OnCancel() {}
+		virtual const char *GetJobName() const { return "SingleGPUGenJob"; }
 
 	private:
 		SingleGPUGenJob() {}
@@ -35,6 +35,18 @@
 
 // tri edge lengths
 static const double GEOPATCH_SUBDIVIDE_AT_CAMDIST = 5.0;
+// a queued split is cancelled once the camera path is this many rough
+// lengths away from the patch, so requests don't flicker at the boundary
+static const double GEOPATCH_CANCEL_SPLIT_DIST = 1.5;
+
+// distance from p to the closest point on the segment [a, b]
+static double DistanceToSegment(const vector3d &p, const vector3d &a, const vector3d &b)
+{
+	const vector3d ab = b - a;
+	const double lenSqr = ab.LengthSqr();
+	const double t = lenSqr > 0.0 ? Clamp((p - a).Dot(ab) / lenSqr, 0.0, 1.0) : 0.0;
+	return (p - (a + ab * t)).Length();
+}
 
 GeoPatch::GeoPatch(const RefCountedPtr<GeoPatchContext> &ctx_, GeoSphere *gs,
 	const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_,
@@ -45,13 +57,16 @@ GeoPatch::GeoPatch(const RefCountedPtr<GeoPatchContext> &ctx_, GeoSphere *gs,
 	m_v2(v2_),
 	m_v3(v3_),
 	m_heights(nullptr),
+	m_heightOrigin(0.0),
 	m_normals(nullptr),
 	m_colors(nullptr),
 	m_parent(nullptr),
 	m_geosphere(gs),
 	m_depth(depth),
 	m_PatchID(ID_),
-	m_HasJobRequest(false)
+	m_HasJobRequest(false),
+	m_vertexScale(1.0),
+	m_uploadingScale(1.0)
 {
 
 	m_clipCentroid = (m_v0 + m_v1 + m_v2 + m_v3) * 0.25;
@@ -80,37 +95,69 @@ GeoPatch::~GeoPatch()
 	m_heights.reset();
 	m_normals.reset();
 	m_colors.reset();
+	GeoPatchContext::ReleaseMesh(std::move(m_patchMesh));
+	// a mesh still being uploaded isn't pooled, it goes with the upload
+}
+
+void GeoPatch::FinishUpload()
+{
+	if (!m_uploadTicket || !m_uploadTicket->IsDone())
+		return;
+	GeoPatchContext::ReleaseMesh(std::move(m_patchMesh));
+	m_patchMesh = std::move(m_uploadingMesh);
+	m_vertexScale = m_uploadingScale;
+	m_uploadTicket.Reset();
 }
 
 void GeoPatch::UpdateVBOs(Graphics::Renderer *renderer)
 {
 	PROFILE_SCOPED()
-	if (m_needUpdateVBOs) {
+	FinishUpload();
+	// one upload at a time, a newer one waits for it
+	if (m_needUpdateVBOs && !m_uploadTicket) {
 		assert(renderer);
 		m_needUpdateVBOs = false;
 
-		//create buffer and upload data
-		auto vbd = Graphics::VertexBufferDesc::FromAttribSet(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL | Graphics::ATTRIB_DIFFUSE | Graphics::ATTRIB_UV0);
-		vbd.numVertices = m_ctx->NUMVERTICES();
-		vbd.usage = Graphics::BUFFER_USAGE_STATIC;
-		Graphics::VertexBuffer *vtxBuffer = renderer->CreateVertexBuffer(vbd);
-
-		GeoPatchContext::VBOVertex *VBOVtxPtr = vtxBuffer->Map<GeoPatchContext::VBOVertex>(Graphics::BUFFER_MAP_WRITE);
+		// with an upload thread a fresh mesh is filled from memory of our
+		// own and the old one drawn until the new one has arrived, else
+		// the mesh is taken from the pool unless we still have one, and
+		// refilled in place
+		const bool threaded = renderer->HasUploadThread();
+		std::vector<Uint8> staging;
+		Graphics::VertexBuffer *vtxBuffer;
+		GeoPatchContext::VBOVertex *VBOVtxPtr;
+		if (threaded) {
+			m_uploadingMesh = GeoPatchContext::AcquireMesh(renderer);
+			vtxBuffer = m_uploadingMesh->GetVertexBuffer();
+			staging.resize(vtxBuffer->GetDesc().numVertices * vtxBuffer->GetDesc().stride);
+			VBOVtxPtr = reinterpret_cast<GeoPatchContext::VBOVertex *>(staging.data());
+		} else {
+			if (!m_patchMesh)
+				m_patchMesh = GeoPatchContext::AcquireMesh(renderer);
+			vtxBuffer = m_patchMesh->GetVertexBuffer();
+			VBOVtxPtr = vtxBuffer->Map<GeoPatchContext::VBOVertex>(Graphics::BUFFER_MAP_WRITE);
+		}
 		assert(vtxBuffer->GetDesc().stride == sizeof(GeoPatchContext::VBOVertex));
 
 		const Sint32 edgeLen = m_ctx->GetEdgeLen();
 		const double frac = m_ctx->GetFrac();
-		const double *pHts = m_heights.get();
+		const float *pHts = m_heights.get();
 		const vector3f *pNorm = m_normals.get();
 		const Color3ub *pColr = m_colors.get();
 
+		// positions can only be quantised once the extent of the patch,
+		// skirts included, is known, so they are collected here first
+		static std::vector<vector3f> s_positions;
+		s_positions.resize(m_ctx->NUMVERTICES());
+		double maxLength = 0.0;
+
 		double minh = DBL_MAX;
 
 		// ----------------------------------------------------
 		// inner loops
 		for (Sint32 y = 1; y < edgeLen - 1; y++) {
 			for (Sint32 x = 1; x < edgeLen - 1; x++) {
-				const double height = *pHts;
+				const double height = m_heightOrigin + *pHts;
 				minh = std::min(height, minh);
 				const double xFrac = double(x - 1) * frac;
 				const double yFrac = double(y - 1) * frac;
@@ -118,11 +165,10 @@ void GeoPatch::UpdateVBOs(Graphics::Renderer *renderer)
 				m_clipRadius = std::max(m_clipRadius, p.Length());
 
 				GeoPatchContext::VBOVertex *vtxPtr = &VBOVtxPtr[x + (y * edgeLen)];
-				vtxPtr->pos = vector3f(p);
+				s_positions[x + (y * edgeLen)] = vector3f(p);
 				++pHts; // next height
 
-				const vector3f norma(pNorm->Normalized());
-				vtxPtr->norm = norma;
+				vtxPtr->SetNormal(pNorm->Normalized());
 				++pNorm; // next normal
 
 				vtxPtr->col[0] = pColr->r;
@@ -132,12 +178,10 @@ void GeoPatch::UpdateVBOs(Graphics::Renderer *renderer)
 				++pColr; // next colour
 
 				// uv coords
-				vtxPtr->uv.x = 1.0f - xFrac;
-				vtxPtr->uv.y = yFrac;
-
-				++vtxPtr; // next vertex
+				vtxPtr->SetUV(1.0f - xFrac, yFrac);
 			}
 		}
+		maxLength = m_clipRadius;
 		const double minhScale = (minh + 1.0) * 0.999995;
 		// ----------------------------------------------------
 		const Sint32 innerLeft = 1;
@@ -151,13 +195,12 @@ void GeoPatch::UpdateVBOs(Graphics::Renderer *renderer)
 			const double xFrac = double(x - 1) * frac;
 			const double yFrac = double(y - 1) * frac;
 			const vector3d p((GetSpherePoint(xFrac, yFrac) * minhScale) - m_clipCentroid);
+			maxLength = std::max(maxLength, p.Length());
 
 			GeoPatchContext::VBOVertex *vtxPtr = &VBOVtxPtr[outerLeft + (y * edgeLen)];
 			GeoPatchContext::VBOVertex *vtxInr = &VBOVtxPtr[innerLeft + (y * edgeLen)];
-			vtxPtr->pos = vector3f(p);
-			vtxPtr->norm = vtxInr->norm;
-			vtxPtr->col = vtxInr->col;
-			vtxPtr->uv = vtxInr->uv;
+			s_positions[outerLeft + (y * edgeLen)] = vector3f(p);
+			*vtxPtr = *vtxInr;
 		}
 		// right-edge
 		for (Sint32 y = 1; y < edgeLen - 1; y++) {
@@ -165,13 +208,12 @@ void GeoPatch::UpdateVBOs(Graphics::Renderer *renderer)
 			const double xFrac = double(x - 1) * frac;
 			const double yFrac = double(y - 1) * frac;
 			const vector3d p((GetSpherePoint(xFrac, yFrac) * minhScale) - m_clipCentroid);
+			maxLength = std::max(maxLength, p.Length());
 
 			GeoPatchContext::VBOVertex *vtxPtr = &VBOVtxPtr[outerRight + (y * edgeLen)];
 			GeoPatchContext::VBOVertex *vtxInr = &VBOVtxPtr[innerRight + (y * edgeLen)];
-			vtxPtr->pos = vector3f(p);
-			vtxPtr->norm = vtxInr->norm;
-			vtxPtr->col = vtxInr->col;
-			vtxPtr->uv = vtxInr->uv;
+			s_positions[outerRight + (y * edgeLen)] = vector3f(p);
+			*vtxPtr = *vtxInr;
 		}
 		// ----------------------------------------------------
 		const Sint32 innerTop = 1;
@@ -185,13 +227,12 @@ void GeoPatch::UpdateVBOs(Graphics::Renderer *renderer)
 			const double xFrac = double(x - 1) * frac;
 			const double yFrac = double(y - 1) * frac;
 			const vector3d p((GetSpherePoint(xFrac, yFrac) * minhScale) - m_clipCentroid);
+			maxLength = std::max(maxLength, p.Length());
 
 			GeoPatchContext::VBOVertex *vtxPtr = &VBOVtxPtr[x + (outerTop * edgeLen)];
 			GeoPatchContext::VBOVertex *vtxInr = &VBOVtxPtr[x + (innerTop * edgeLen)];
-			vtxPtr->pos = vector3f(p);
-			vtxPtr->norm = vtxInr->norm;
-			vtxPtr->col = vtxInr->col;
-			vtxPtr->uv = vtxInr->uv;
+			s_positions[x + (outerTop * edgeLen)] = vector3f(p);
+			*vtxPtr = *vtxInr;
 		}
 		// bottom-edge
 		for (Sint32 x = 1; x < edgeLen - 1; x++) {
@@ -199,47 +240,43 @@ void GeoPatch::UpdateVBOs(Graphics::Renderer *renderer)
 			const double xFrac = double(x - 1) * frac;
 			const double yFrac = double(y - 1) * frac;
 			const vector3d p((GetSpherePoint(xFrac, yFrac) * minhScale) - m_clipCentroid);
+			maxLength = std::max(maxLength, p.Length());
 
 			GeoPatchContext::VBOVertex *vtxPtr = &VBOVtxPtr[x + (outerBottom * edgeLen)];
 			GeoPatchContext::VBOVertex *vtxInr = &VBOVtxPtr[x + (innerBottom * edgeLen)];
-			vtxPtr->pos = vector3f(p);
-			vtxPtr->norm = vtxInr->norm;
-			vtxPtr->col = vtxInr->col;
-			vtxPtr->uv = vtxInr->uv;
+			s_positions[x + (outerBottom * edgeLen)] = vector3f(p);
+			*vtxPtr = *vtxInr;
 		}
 		// ----------------------------------------------------
-		// corners
-		{
-			// top left
-			GeoPatchContext::VBOVertex *tarPtr = &VBOVtxPtr[0];
-			GeoPatchContext::VBOVertex *srcPtr = &VBOVtxPtr[1];
-			(*tarPtr) = (*srcPtr);
-		}
-		{
-			// top right
-			GeoPatchContext::VBOVertex *tarPtr = &VBOVtxPtr[(edgeLen - 1)];
-			GeoPatchContext::VBOVertex *srcPtr = &VBOVtxPtr[(edgeLen - 2)];
-			(*tarPtr) = (*srcPtr);
-		}
-		{
-			// bottom left
-			GeoPatchContext::VBOVertex *tarPtr = &VBOVtxPtr[(edgeLen - 1) * edgeLen];
-			GeoPatchContext::VBOVertex *srcPtr = &VBOVtxPtr[(edgeLen - 2) * edgeLen];
-			(*tarPtr) = (*srcPtr);
-		}
-		{
-			// bottom right
-			GeoPatchContext::VBOVertex *tarPtr = &VBOVtxPtr[(edgeLen - 1) + ((edgeLen - 1) * edgeLen)];
-			GeoPatchContext::VBOVertex *srcPtr = &VBOVtxPtr[(edgeLen - 1) + ((edgeLen - 2) * edgeLen)];
-			(*tarPtr) = (*srcPtr);
+		// corners: top left, top right, bottom left and bottom right, each
+		// copied from its neighbour
+		const Sint32 corners[4][2] = {
+			{ 0, 1 },
+			{ edgeLen - 1, edgeLen - 2 },
+			{ (edgeLen - 1) * edgeLen, (edgeLen - 2) * edgeLen },
+			{ (edgeLen - 1) + ((edgeLen - 1) * edgeLen), (edgeLen - 1) + ((edgeLen - 2) * edgeLen) }
+		};
+		for (const auto &corner : corners) {
+			VBOVtxPtr[corner[0]] = VBOVtxPtr[corner[1]];
+			s_positions[corner[0]] = s_positions[corner[1]];
 		}
 
 		// ----------------------------------------------------
-		// end of mapping
-		vtxBuffer->Unmap();
+		// quantise the positions
+		const double vertexScale = maxLength > 0.0 ? maxLength : 1.0;
+		const float invScale = float(1.0 / vertexScale);
+		for (Sint32 i = 0; i < m_ctx->NUMVERTICES(); i++)
+			VBOVtxPtr[i].SetPos(s_positions[i], invScale);
 
-		// use the new vertex buffer and the shared index buffer
-		m_patchMesh.reset(renderer->CreateMeshObject(vtxBuffer, m_ctx->GetIndexBuffer()));
+		// ----------------------------------------------------
+		// end of mapping
+		if (threaded) {
+			m_uploadingScale = vertexScale;
+			m_uploadTicket = renderer->UploadVertexBuffer(vtxBuffer, std::move(staging));
+		} else {
+			m_vertexScale = vertexScale;
+			vtxBuffer->Unmap();
+		}
 
 		// Don't need this anymore so throw it away
 		m_normals.reset();
@@ -254,44 +291,149 @@ void GeoPatch::UpdateVBOs(Graphics::Renderer *renderer)
 		case 3: mat->diffuse = Color::BLUE; break;
 		default: mat->diffuse = Color::BLACK; break;
 		}
-		m_boundsphere.reset(new Graphics::Drawables::Sphere3D(Pi::renderer, mat, 1, m_clipRadius));
+		// drawn with the patch transform, which includes the vertex scale
+		m_boundsphere.reset(new Graphics::Drawables::Sphere3D(Pi::renderer, mat, 1, m_clipRadius / vertexScale));
 #endif
 	}
+	FinishUpload();
+}
+
+bool GeoPatch::GetPatchCoords(const vector3d &p, double &x, double &y) const
+{
+	// solve for the unnormalised bilinear point being parallel to p, i.e.
+	// for its components along two directions perpendicular to p being zero
+	const vector3d dir = p.Normalized();
+	const vector3d e1 = dir.Cross(std::abs(dir.x) < 0.9 ? vector3d(1.0, 0.0, 0.0) : vector3d(0.0, 1.0, 0.0)).Normalized();
+	const vector3d e2 = dir.Cross(e1);
+
+	x = y = 0.5;
+	for (int i = 0; i < 5; i++) {
+		const vector3d f = m_v0 * ((1.0 - x) * (1.0 - y)) + m_v1 * (x * (1.0 - y)) + m_v2 * (x * y) + m_v3 * ((1.0 - x) * y);
+		const vector3d dfdx = (m_v1 - m_v0) * (1.0 - y) + (m_v2 - m_v3) * y;
+		const vector3d dfdy = (m_v3 - m_v0) * (1.0 - x) + (m_v2 - m_v1) * x;
+		const double g1 = f.Dot(e1), g2 = f.Dot(e2);
+		const double j11 = dfdx.Dot(e1), j12 = dfdy.Dot(e1);
+		const double j21 = dfdx.Dot(e2), j22 = dfdy.Dot(e2);
+		const double det = j11 * j22 - j12 * j21;
+		if (std::abs(det) < 1e-30)
+			return false;
+		x -= (g1 * j22 - j12 * g2) / det;
+		y -= (j11 * g2 - j21 * g1) / det;
+	}
+
+	static const double EDGE_EPSILON = 1e-9;
+	if (x < -EDGE_EPSILON || x > 1.0 + EDGE_EPSILON || y < -EDGE_EPSILON || y > 1.0 + EDGE_EPSILON)
+		return false;
+	// the other side of the planet solves the same equations
+	return GetSpherePoint(Clamp(x, 0.0, 1.0), Clamp(y, 0.0, 1.0)).Dot(dir) > 0.0;
+}
+
+bool GeoPatch::GetGeneratedHeight(const vector3d &p, double &height) const
+{
+	double x, y;
+	if (!GetPatchCoords(p, x, y))
+		return false;
+
+	if (m_kids[0]) {
+		for (int i = 0; i < NUM_KIDS; i++)
+			if (m_kids[i]->GetGeneratedHeight(p, height))
+				return true;
+		return false;
+	}
+
+	if (!m_heights || m_depth < m_geosphere->GetMaxDepth())
+		return false;
+
+	// the heights are the inner (non-skirt) vertices, edgeLen - 2 on a side
+	const Sint32 numSide = m_ctx->GetEdgeLen() - 2;
+	const double fx = Clamp(x, 0.0, 1.0) * (numSide - 1);
+	const double fy = Clamp(y, 0.0, 1.0) * (numSide - 1);
+	const Sint32 ix = std::min(Sint32(fx), numSide - 2);
+	const Sint32 iy = std::min(Sint32(fy), numSide - 2);
+	const double tx = fx - ix, ty = fy - iy;
+
+	const float *row0 = m_heights.get() + iy * numSide + ix;
+	const float *row1 = row0 + numSide;
+	height = m_heightOrigin + (row0[0] * (1.0 - tx) + row0[1] * tx) * (1.0 - ty) + (row1[0] * (1.0 - tx) + row1[1] * tx) * ty;
+	return true;
 }
 
 // the default sphere we do the horizon culling against
 static const SSphere s_sph;
-void GeoPatch::Render(Graphics::Renderer *renderer, const vector3d &campos, const matrix4x4d &modelView, const Graphics::Frustum &frustum)
+
+GeoPatch::CullResult GeoPatch::TestFrustum(const Graphics::Frustum &frustum) const
+{
+	if (!frustum.TestPoint(m_clipCentroid, m_clipRadius))
+		return CULL_OUTSIDE;
+	return frustum.TestPointContained(m_clipCentroid, m_clipRadius) ? CULL_INSIDE : CULL_INTERSECT;
+}
+
+GeoPatch::CullResult GeoPatch::TestHorizon(const vector3d &campos) const
+{
+	// nothing can be culled against the horizon from below the sphere, or
+	// from inside the patch's own bounds
+	if (campos.LengthSqr() <= 1.0 || (campos - m_clipCentroid).LengthSqr() <= m_clipRadius * m_clipRadius)
+		return CULL_INTERSECT;
+
+	SSphere obj;
+	obj.m_centre = m_clipCentroid;
+	obj.m_radius = m_clipRadius;
+	if (s_sph.IsInFrontOfHorizon(campos, obj))
+		return CULL_INSIDE;
+	return s_sph.HorizonCulling(campos, obj) ? CULL_INTERSECT : CULL_OUTSIDE;
+}
+
+void GeoPatch::Render(Graphics::Renderer *renderer, const vector3d &campos, const matrix4x4d &modelView, const Graphics::Frustum &frustum, Uint32 cullTests, std::vector<GeoPatch *> *visibleCut)
 {
 	PROFILE_SCOPED()
 	// must update the VBOs to calculate the clipRadius...
 	UpdateVBOs(renderer);
 	// ...before doing the furstum culling that relies on it.
-	if (!frustum.TestPoint(m_clipCentroid, m_clipRadius))
-		return; // nothing below this patch is visible
-
-	// only want to horizon cull patches that can actually be over the horizon!
-	const vector3d camDir(campos - m_clipCentroid);
-	const vector3d camDirNorm(camDir.Normalized());
-	const vector3d cenDir(m_clipCentroid.Normalized());
-	const double dotProd = camDirNorm.Dot(cenDir);
-
-	if (dotProd < 0.25 && (camDir.LengthSqr() > (m_clipRadius * m_clipRadius))) {
-		SSphere obj;
-		obj.m_centre = m_clipCentroid;
-		obj.m_radius = m_clipRadius;
+	if (cullTests & CULL_FRUSTUM) {
+		const CullResult result = TestFrustum(frustum);
+		if (result == CULL_OUTSIDE) {
+			renderer->GetStats().AddToStatCount(Graphics::Stats::STAT_GEOPATCH_CULLED_FRUSTUM, 1);
+			if (visibleCut)
+				visibleCut->push_back(this);
+			return; // nothing below this patch is visible
+		}
+		if (result == CULL_INSIDE)
+			cullTests &= ~CULL_FRUSTUM;
+	}
 
-		if (!s_sph.HorizonCulling(campos, obj)) {
+	if (cullTests & CULL_HORIZON) {
+		const CullResult result = TestHorizon(campos);
+		if (result == CULL_OUTSIDE) {
+			renderer->GetStats().AddToStatCount(Graphics::Stats::STAT_GEOPATCH_CULLED_HORIZON, 1);
+			if (visibleCut)
+				visibleCut->push_back(this);
 			return; // nothing below this patch is visible
 		}
+		if (result == CULL_INSIDE)
+			cullTests &= ~CULL_HORIZON;
 	}
 
 	if (m_kids[0]) {
-		for (int i = 0; i < NUM_KIDS; i++)
-			m_kids[i]->Render(renderer, campos, modelView, frustum);
-	} else if (m_heights) {
+		// kids whose meshes are still on the upload thread would leave a
+		// hole, so this patch stands in for them until they all have one
+		bool kidsReady = true;
+		for (int i = 0; i < NUM_KIDS; i++) {
+			m_kids[i]->UpdateVBOs(renderer);
+			kidsReady = kidsReady && m_kids[i]->m_patchMesh;
+		}
+		if (kidsReady || !m_patchMesh) {
+			for (int i = 0; i < NUM_KIDS; i++)
+				m_kids[i]->Render(renderer, campos, modelView, frustum, cullTests, visibleCut);
+			return;
+		}
+	}
+
+	if (visibleCut)
+		visibleCut->push_back(this);
+	if (m_heights && m_patchMesh) {
 		const vector3d relpos = m_clipCentroid - campos;
-		renderer->SetTransform(matrix4x4f(modelView * matrix4x4d::Translation(relpos)));
+		// the vertex positions are stored relative to the clip centroid, divided by m_vertexScale
+		renderer->SetTransform(matrix4x4f(modelView * matrix4x4d::Translation(relpos) * matrix4x4d::ScaleMatrix(m_vertexScale)));
 
 		Pi::statSceneTris += (m_ctx->GetNumTris());
 		++Pi::statNumPatches;
@@ -315,14 +457,27 @@ void GeoPatch::Render(Graphics::Renderer *renderer, const vector3d &campos, cons
 		}
 #endif
 		renderer->GetStats().AddToStatCount(Graphics::Stats::STAT_PATCHES, 1);
+		renderer->GetStats().AddToStatCount(Graphics::Stats::STAT_GEOPATCH_DRAWN, 1);
 	}
 }
 
-void GeoPatch::LODUpdate(const vector3d &campos, const Graphics::Frustum &frustum)
+void GeoPatch::LODUpdate(const vector3d &campos, const vector3d &predictedCampos, const Graphics::Frustum &frustum)
 {
-	// there should be no LOD update when we have active split requests
-	if (m_HasJobRequest)
+	// there should be no LOD update when we have active split requests,
+	// but keep the pending job's priority up to date as the camera moves
+	// and drop it if the patch isn't wanted anymore
+	if (m_HasJobRequest) {
+		if (m_parent && m_job.HasJob()) {
+			if (DistanceToSegment(m_centroid, campos, predictedCampos) >= m_roughLength * GEOPATCH_CANCEL_SPLIT_DIST) {
+				m_job = Job::Handle(); // cancels the job
+				m_HasJobRequest = false;
+				GeoSphere::CountCancelledSplit();
+			} else {
+				m_job.SetPriority(Job::PRIORITY_NORMAL, float((campos - m_centroid).Length()));
+			}
+		}
 		return;
+	}
 
 	bool canSplit = true;
 	bool canMerge = bool(m_kids[0]);
@@ -330,8 +485,9 @@ void GeoPatch::LODUpdate(const vector3d &campos, const Graphics::Frustum &frustu
 	// always split at first level
 	double centroidDist = DBL_MAX;
 	if (m_parent) {
-		centroidDist = (campos - m_centroid).Length();		 // distance from camera to centre of the patch
-		const bool tooFar = (centroidDist >= m_roughLength); // check if the distance is greater than the rough length, which is how far it should be before it can split
+		centroidDist = (campos - m_centroid).Length();							 // distance from camera to centre of the patch
+		const double pathDist = DistanceToSegment(m_centroid, campos, predictedCampos); // distance from the camera's predicted path to centre of the patch
+		const bool tooFar = (pathDist >= m_roughLength);						 // check if the distance is greater than the rough length, which is how far it should be before it can split
 		if (m_depth >= std::min(GEOPATCH_MAX_DEPTH, m_geosphere->GetMaxDepth()) || tooFar) {
 			canSplit = false; // we're too deep in the quadtree or too far away so cannot split
 		}
@@ -340,38 +496,25 @@ void GeoPatch::LODUpdate(const vector3d &campos, const Graphics::Frustum &frustu
 	if (canSplit) {
 		if (!m_kids[0]) {
 			// Test if this patch is visible
-			if (!frustum.TestPoint(m_clipCentroid, m_clipRadius))
+			if (TestFrustum(frustum) == CULL_OUTSIDE || TestHorizon(campos) == CULL_OUTSIDE)
 				return; // nothing below this patch is visible
 
-			// only want to horizon cull patches that can actually be over the horizon!
-			const vector3d camDir(campos - m_clipCentroid);
-			const vector3d camDirNorm(camDir.Normalized());
-			const vector3d cenDir(m_clipCentroid.Normalized());
-			const double dotProd = camDirNorm.Dot(cenDir);
-
-			if (dotProd < 0.25 && (camDir.LengthSqr() > (m_clipRadius * m_clipRadius))) {
-				SSphere obj;
-				obj.m_centre = m_clipCentroid;
-				obj.m_radius = m_clipRadius;
-
-				if (!s_sph.HorizonCulling(campos, obj)) {
-					return; // nothing below this patch is visible
-				}
-			}
-
 			// we can see this patch so submit the jobs!
 			assert(!m_HasJobRequest);
 			m_HasJobRequest = true;
 
+			if (centroidDist >= m_roughLength)
+				GeoSphere::CountPrefetchedSplit();
+
 			SQuadSplitRequest *ssrd = new SQuadSplitRequest(m_v0, m_v1, m_v2, m_v3, m_centroid.Normalized(), m_depth,
 				m_geosphere->GetSystemBody()->GetPath(), m_PatchID, m_ctx->GetEdgeLen() - 2,
-				m_ctx->GetFrac(), m_geosphere->GetTerrain());
+				m_ctx->GetFrac(), m_geosphere->GetTerrain(), m_geosphere->GetTerrainKey());
 
 			// add to the GeoSphere to be processed at end of all LODUpdate requests
 			m_geosphere->AddQuadSplitRequest(centroidDist, ssrd, this);
 		} else {
 			for (int i = 0; i < NUM_KIDS; i++) {
-				m_kids[i]->LODUpdate(campos, frustum);
+				m_kids[i]->LODUpdate(campos, predictedCampos, frustum);
 			}
 		}
 	} else if (canMerge) {
@@ -382,6 +525,7 @@ void GeoPatch::LODUpdate(const vector3d &campos, const Graphics::Frustum &frustu
 			for (int i = 0; i < NUM_KIDS; i++) {
 				m_kids[i].reset();
 			}
+			m_geosphere->InvalidateVisibleCut();
 		}
 	}
 }
@@ -392,8 +536,12 @@ void GeoPatch::RequestSinglePatch()
 		assert(!m_HasJobRequest);
 		m_HasJobRequest = true;
 		SSingleSplitRequest *ssrd = new SSingleSplitRequest(m_v0, m_v1, m_v2, m_v3, m_centroid.Normalized(), m_depth,
-			m_geosphere->GetSystemBody()->GetPath(), m_PatchID, m_ctx->GetEdgeLen() - 2, m_ctx->GetFrac(), m_geosphere->GetTerrain());
-		m_job = Pi::GetAsyncJobQueue()->Queue(new SinglePatchJob(ssrd));
+			m_geosphere->GetSystemBody()->GetPath(), m_PatchID, m_ctx->GetEdgeLen() - 2, m_ctx->GetFrac(), m_geosphere->GetTerrain(),
+			m_geosphere->GetTerrainKey());
+		SinglePatchJob *job = new SinglePatchJob(ssrd);
+		// the root patches must exist before anything else can be generated
+		job->SetPriority(Job::PRIORITY_HIGH);
+		m_job = Pi::GetAsyncJobQueue()->Queue(job);
 	}
 }
 
@@ -443,9 +591,11 @@ void GeoPatch::ReceiveHeightmap(const SSingleSplitResult *psr)
 
 void GeoPatch::ReceiveHeightResult(const SSplitResultData &data)
 {
-	m_heights.reset(data.heights);
-	m_normals.reset(data.normals);
-	m_colors.reset(data.colors);
+	assert(data.pool);
+	m_heights = data.pool->MakePtr(data.heights);
+	m_heightOrigin = data.heightOrigin;
+	m_normals = data.pool->MakePtr(data.normals);
+	m_colors = data.pool->MakePtr(data.colors);
 
 	// skirt vertices are not present in the heights array
 	const int edgeLen = m_ctx->GetEdgeLen() - 2;
@@ -455,10 +605,11 @@ void GeoPatch::ReceiveHeightResult(const SSplitResultData &data)
 	const double h2 = m_heights[edgeLen * (edgeLen - 1)];
 	const double h3 = m_heights[edgeLen * edgeLen - 1];
 
-	const double height = (h0 + h1 + h2 + h3) * 0.25;
+	const double height = m_heightOrigin + (h0 + h1 + h2 + h3) * 0.25;
 	m_centroid *= (1.0 + height);
 
 	NeedToUpdateVBOs();
+	m_geosphere->InvalidateVisibleCut();
 }
 
 void GeoPatch::ReceiveJobHandle(Job::Handle job)
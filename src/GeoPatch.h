@@ -7,6 +7,7 @@
 #include <SDL_stdinc.h>
 
 #include "Color.h"
+#include "GeoPatchDataPool.h"
 #include "GeoPatchID.h"
 #include "JobQueue.h"
 #include "RefCounted.h"
@@ -14,6 +15,7 @@
 #include "vector3.h"
 #include <deque>
 #include <memory>
+#include <vector>
 
 //#define DEBUG_BOUNDING_SPHERES
 
@@ -28,6 +30,7 @@ namespace Graphics {
 	class Renderer;
 	class Frustum;
 	class MeshObject;
+	class UploadTicket;
 } // namespace Graphics
 
 class GeoPatchContext;
@@ -67,7 +70,27 @@ public:
 		return (m_v0 + x * (1.0 - y) * (m_v1 - m_v0) + x * y * (m_v2 - m_v0) + (1.0 - x) * y * (m_v3 - m_v0)).Normalized();
 	}
 
-	void Render(Graphics::Renderer *r, const vector3d &campos, const matrix4x4d &modelView, const Graphics::Frustum &frustum);
+	// inverse of GetSpherePoint: the patch surface coords of the point in
+	// direction p, false if p isn't over this patch
+	bool GetPatchCoords(const vector3d &p, double &x, double &y) const;
+
+	// Interpolate the height at direction p from the heights of the leaf
+	// patch over it, if that patch is at the maximum depth
+	bool GetGeneratedHeight(const vector3d &p, double &height) const;
+
+	// Visibility tests a patch still has to pass. The kids of a patch lying
+	// entirely inside the frustum or in front of the horizon skip that test.
+	enum CullTest : Uint32 {
+		CULL_FRUSTUM = 1 << 0,
+		CULL_HORIZON = 1 << 1,
+		CULL_ALL = CULL_FRUSTUM | CULL_HORIZON
+	};
+
+	// Draw the visible leaves below this patch. The patches where the
+	// traversal stopped, because they were drawn or culled, are appended to
+	// visibleCut if it isn't null.
+	void Render(Graphics::Renderer *r, const vector3d &campos, const matrix4x4d &modelView, const Graphics::Frustum &frustum,
+		Uint32 cullTests = CULL_ALL, std::vector<GeoPatch *> *visibleCut = nullptr);
 
 	inline bool canBeMerged() const
 	{
@@ -81,7 +104,10 @@ public:
 		return merge;
 	}
 
-	void LODUpdate(const vector3d &campos, const Graphics::Frustum &frustum);
+	// Split or merge patches for the given camera position. Patches are also
+	// split if they are close to the path between campos and predictedCampos,
+	// and queued splits are cancelled once they are far from it.
+	void LODUpdate(const vector3d &campos, const vector3d &predictedCampos, const Graphics::Frustum &frustum);
 
 	void RequestSinglePatch();
 	void ReceiveHeightmaps(SQuadSplitResult *psr);
@@ -94,11 +120,25 @@ public:
 private:
 	static const int NUM_KIDS = 4;
 
+	enum CullResult {
+		CULL_OUTSIDE,	// certainly not visible
+		CULL_INTERSECT, // may be visible
+		CULL_INSIDE		// everything below this patch passes the test
+	};
+	CullResult TestFrustum(const Graphics::Frustum &frustum) const;
+	// test against the horizon of the unit sphere, which the terrain never dips below
+	CullResult TestHorizon(const vector3d &campos) const;
+	// swap in the mesh from the upload thread once it has arrived
+	void FinishUpload();
+
 	RefCountedPtr<GeoPatchContext> m_ctx;
 	const vector3d m_v0, m_v1, m_v2, m_v3;
-	std::unique_ptr<double[]> m_heights;
-	std::unique_ptr<vector3f[]> m_normals;
-	std::unique_ptr<Color3ub[]> m_colors;
+	// heights relative to m_heightOrigin, the lowest of them, so they fit in
+	// a float without losing the precision collisions need
+	GeoPatchDataPool::Ptr<float> m_heights;
+	double m_heightOrigin;
+	GeoPatchDataPool::Ptr<vector3f> m_normals;
+	GeoPatchDataPool::Ptr<Color3ub> m_colors;
 	std::unique_ptr<Graphics::MeshObject> m_patchMesh;
 	std::unique_ptr<GeoPatch> m_kids[NUM_KIDS];
 	GeoPatch *m_parent;
@@ -112,6 +152,13 @@ private:
 	const GeoPatchID m_PatchID;
 	Job::Handle m_job;
 	bool m_HasJobRequest;
+	// positions in the vertex buffer are divided by this to fit their compact format
+	double m_vertexScale;
+	// the mesh on the upload thread and the scale of its positions, drawn
+	// instead of m_patchMesh once the ticket is done
+	std::unique_ptr<Graphics::MeshObject> m_uploadingMesh;
+	RefCountedPtr<Graphics::UploadTicket> m_uploadTicket;
+	double m_uploadingScale;
 #ifdef DEBUG_BOUNDING_SPHERES
 	std::unique_ptr<Graphics::Drawables::Sphere3D> m_boundsphere;
 #endif
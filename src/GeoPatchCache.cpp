@@ -0,0 +1,149 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "GeoPatchCache.h"
+
+#include "DiskCache.h"
+#include "GeoPatchID.h"
+#include "core/FNV1a.h"
+#include "galaxy/SystemBody.h"
+#include "profiler/Profiler.h"
+#include "scenegraph/Serializer.h"
+#include "terrain/Terrain.h"
+
+#include <cstring>
+
+namespace {
+	// bump this whenever the terrain generation changes, so old entries are ignored
+	static const Uint32 CACHE_VERSION = 3;
+
+	DiskCache s_cache("geopatch_cache", CACHE_VERSION);
+} // namespace
+
+// static
+void GeoPatchCache::Init(size_t maxBytes)
+{
+	s_cache.Init(maxBytes);
+}
+
+// static
+void GeoPatchCache::Uninit()
+{
+	s_cache.Uninit();
+}
+
+// static
+bool GeoPatchCache::IsEnabled()
+{
+	return s_cache.IsEnabled();
+}
+
+// static
+size_t GeoPatchCache::GetSize()
+{
+	return s_cache.GetSize();
+}
+
+// static
+uint64_t GeoPatchCache::GetTerrainKey(const SystemBody *body, const Terrain *terrain)
+{
+	// everything the terrain reads from the body when it is created
+	const SystemPath &path = body->GetPath();
+	Serializer::Writer wr;
+	wr.Int32(CACHE_VERSION);
+	wr.Int32(path.sectorX);
+	wr.Int32(path.sectorY);
+	wr.Int32(path.sectorZ);
+	wr.Int32(path.systemIndex);
+	wr.Int32(path.bodyIndex);
+	wr.Int32(body->GetSeed());
+	wr.Int32(body->GetType());
+	wr.Double(body->GetRadius());
+	wr.Double(body->GetMass());
+	wr.Double(body->GetAspectRatio());
+	wr.Int32(body->GetAverageTemp());
+	wr.Int64(body->GetMetallicityAsFixed().v);
+	wr.Int64(body->GetVolatileGasAsFixed().v);
+	wr.Int64(body->GetVolatileLiquidAsFixed().v);
+	wr.Int64(body->GetVolatileIcesAsFixed().v);
+	wr.Int64(body->GetVolcanicityAsFixed().v);
+	wr.Int64(body->GetLifeAsFixed().v);
+	wr.String(body->GetHeightMapFilename());
+	wr.Int32(body->GetHeightMapFractal());
+	wr.String(terrain->GetHeightFractalName());
+	wr.String(terrain->GetColorFractalName());
+
+	const std::string &data = wr.GetData();
+	return hash_64_fnv1a(data.data(), data.size());
+}
+
+// static
+uint64_t GeoPatchCache::GetPatchKey(uint64_t terrainKey, const GeoPatchID &patchID, int depth, int edgeLen, double fracStep, int numPatches)
+{
+	Serializer::Writer wr;
+	wr.Int64(terrainKey);
+	wr.Int64(patchID.GetValue());
+	wr.Int32(depth);
+	wr.Int32(edgeLen);
+	wr.Double(fracStep);
+	wr.Int32(numPatches);
+
+	const std::string &data = wr.GetData();
+	return hash_64_fnv1a(data.data(), data.size());
+}
+
+// static
+bool GeoPatchCache::Load(uint64_t key, uint32_t numVertices, uint32_t numPatches, float *const *heights, double *heightOrigins, vector3f *const *normals, Color3ub *const *colors)
+{
+	PROFILE_SCOPED()
+	std::string data;
+	if (!s_cache.Load(key, data))
+		return false;
+
+	bool valid = false;
+	try {
+		Serializer::Reader rd(ByteRange(data.data(), data.size()));
+		valid = rd.Int32() == numVertices && rd.Int32() == numPatches;
+
+		for (uint32_t i = 0; valid && i < numPatches; i++) {
+			heightOrigins[i] = rd.Double();
+			const ByteRange h = rd.Blob();
+			const ByteRange n = rd.Blob();
+			const ByteRange c = rd.Blob();
+			valid = h.Size() == numVertices * sizeof(float) && n.Size() == numVertices * sizeof(vector3f) && c.Size() == numVertices * sizeof(Color3ub);
+			if (valid) {
+				std::memcpy(heights[i], h.begin, h.Size());
+				std::memcpy(normals[i], n.begin, n.Size());
+				std::memcpy(colors[i], c.begin, c.Size());
+			}
+		}
+	} catch (const std::exception &) {
+		valid = false;
+	}
+
+	if (!valid)
+		s_cache.Remove(key);
+	return valid;
+}
+
+// static
+void GeoPatchCache::Store(uint64_t key, uint32_t numVertices, uint32_t numPatches, const float *const *heights, const double *heightOrigins, const vector3f *const *normals, const Color3ub *const *colors)
+{
+	PROFILE_SCOPED()
+	if (!s_cache.IsEnabled())
+		return;
+
+	Serializer::Writer wr;
+	wr.Int32(numVertices);
+	wr.Int32(numPatches);
+	for (uint32_t i = 0; i < numPatches; i++) {
+		wr.Double(heightOrigins[i]);
+		wr.Blob(ByteRange(reinterpret_cast<const char *>(heights[i]), numVertices * sizeof(float)));
+		wr.Blob(ByteRange(reinterpret_cast<const char *>(normals[i]), numVertices * sizeof(vector3f)));
+		wr.Blob(ByteRange(reinterpret_cast<const char *>(colors[i]), numVertices * sizeof(Color3ub)));
+	}
+
+	// jobs for the same patch never run at the same time, so the store
+	// can't race with another one for the same key
+	s_cache.Store(key, wr.GetData());
+}
@@ -0,0 +1,47 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _GEOPATCHCACHE_H
+#define _GEOPATCHCACHE_H
+
+#include "Color.h"
+#include "vector3.h"
+
+#include <cstdint>
+
+class GeoPatchID;
+class SystemBody;
+class Terrain;
+
+// Thread-safe on-disk cache of the heights, normals and colours generated by
+// GeoPatch jobs, stored LZ4-compressed in the user directory. Patch data only
+// depends on the body, its terrain and the patch, so revisiting a planet can
+// load it instead of evaluating the terrain fractals again.
+//
+// Entries are evicted least-recently-used first once the cache grows beyond
+// its size limit. The order of use is kept in an index file written by
+// Uninit(); files the index doesn't know about (e.g. after a crash) are
+// removed by the next Init().
+class GeoPatchCache {
+public:
+	// Enable the cache with the given size limit; 0 disables it
+	static void Init(size_t maxBytes);
+	static void Uninit();
+
+	static bool IsEnabled();
+	// Total size of the cached files, in bytes
+	static size_t GetSize();
+
+	// Key covering everything about a body's terrain that patch data depends on
+	static uint64_t GetTerrainKey(const SystemBody *body, const Terrain *terrain);
+	// Key for the output of one patch job, i.e. numPatches patches generated
+	// for the patch with the given id and depth
+	static uint64_t GetPatchKey(uint64_t terrainKey, const GeoPatchID &patchID, int depth, int edgeLen, double fracStep, int numPatches);
+
+	// Fill numPatches arrays of numVertices heights, normals and colours
+	// from the cache. Returns false if there is no valid entry for the key.
+	static bool Load(uint64_t key, uint32_t numVertices, uint32_t numPatches, float *const *heights, double *heightOrigins, vector3f *const *normals, Color3ub *const *colors);
+	static void Store(uint64_t key, uint32_t numVertices, uint32_t numPatches, const float *const *heights, const double *heightOrigins, const vector3f *const *normals, const Color3ub *const *colors);
+};
+
+#endif /* _GEOPATCHCACHE_H */
@@ -4,6 +4,7 @@
 #include "GeoPatchContext.h"
 
 #include "Pi.h"
+#include "core/MemoryTag.h"
 #include "graphics/Graphics.h"
 #include "graphics/Renderer.h"
 #include "utils.h"
@@ -19,6 +20,11 @@ int GeoPatchContext::m_numTris = 0;
 double GeoPatchContext::m_frac = 0.0;
 RefCountedPtr<Graphics::IndexBuffer> GeoPatchContext::m_indices;
 int GeoPatchContext::m_prevEdgeLen = 0;
+std::vector<std::unique_ptr<Graphics::MeshObject>> GeoPatchContext::m_meshPool;
+
+// enough for the patches of a planet and its moons splitting and merging
+// as the camera moves, without holding on to too much GPU memory
+static const size_t MAX_POOLED_MESHES = 256;
 
 //static
 void GeoPatchContext::GenerateIndices()
@@ -26,6 +32,9 @@ void GeoPatchContext::GenerateIndices()
 	if (m_prevEdgeLen == m_edgeLen)
 		return;
 
+	// pooled meshes have the old size and index buffer
+	ClearMeshPool();
+
 	std::vector<Uint32> pl_short;
 
 	int tri_count = 0;
@@ -67,11 +76,20 @@ void GeoPatchContext::GenerateIndices()
 #else
 		vco.Optimize(&pl_short[0], tri_count);
 #endif
-		//create buffer & copy
-		m_indices.Reset(Pi::renderer->CreateIndexBuffer(pl_short.size(), Graphics::BUFFER_USAGE_STATIC));
-		Uint32 *idxPtr = m_indices->Map(Graphics::BUFFER_MAP_WRITE);
-		for (Uint32 j = 0; j < pl_short.size(); j++) {
-			idxPtr[j] = pl_short[j];
+		//create buffer & copy, with 16-bit indices whenever the patch is small enough
+		MemoryTag::Scope memoryScope(MemoryTag::TERRAIN);
+		if (NUMVERTICES() <= 0x10000) {
+			m_indices.Reset(Pi::renderer->CreateIndexBuffer(pl_short.size(), Graphics::BUFFER_USAGE_STATIC, Graphics::INDEX_BUFFER_16BIT));
+			Uint16 *idxPtr = m_indices->Map16(Graphics::BUFFER_MAP_WRITE);
+			for (Uint32 j = 0; j < pl_short.size(); j++) {
+				idxPtr[j] = Uint16(pl_short[j]);
+			}
+		} else {
+			m_indices.Reset(Pi::renderer->CreateIndexBuffer(pl_short.size(), Graphics::BUFFER_USAGE_STATIC));
+			Uint32 *idxPtr = m_indices->Map(Graphics::BUFFER_MAP_WRITE);
+			for (Uint32 j = 0; j < pl_short.size(); j++) {
+				idxPtr[j] = pl_short[j];
+			}
 		}
 		m_indices->Unmap();
 	}
@@ -79,6 +97,52 @@ void GeoPatchContext::GenerateIndices()
 	m_prevEdgeLen = m_edgeLen;
 }
 
+//static
+Graphics::VertexBufferDesc GeoPatchContext::GetVertexBufferDesc()
+{
+	Graphics::VertexBufferDesc vbd;
+	vbd.attrib[0] = { Graphics::ATTRIB_POSITION, Graphics::ATTRIB_FORMAT_SHORT4_NORM, offsetof(VBOVertex, pos) };
+	vbd.attrib[1] = { Graphics::ATTRIB_NORMAL, Graphics::ATTRIB_FORMAT_BYTE4_NORM, offsetof(VBOVertex, norm) };
+	vbd.attrib[2] = { Graphics::ATTRIB_DIFFUSE, Graphics::ATTRIB_FORMAT_UBYTE4, offsetof(VBOVertex, col) };
+	vbd.attrib[3] = { Graphics::ATTRIB_UV0, Graphics::ATTRIB_FORMAT_USHORT2_NORM, offsetof(VBOVertex, uv) };
+	vbd.stride = sizeof(VBOVertex);
+	vbd.numVertices = NUMVERTICES();
+	vbd.usage = Graphics::BUFFER_USAGE_STATIC;
+	return vbd;
+}
+
+//static
+std::unique_ptr<Graphics::MeshObject> GeoPatchContext::AcquireMesh(Graphics::Renderer *renderer)
+{
+	if (!m_meshPool.empty()) {
+		std::unique_ptr<Graphics::MeshObject> mesh = std::move(m_meshPool.back());
+		m_meshPool.pop_back();
+		renderer->GetStats().AddToStatCount(Graphics::Stats::STAT_GEOPATCH_MESHES_REUSED, 1);
+		return mesh;
+	}
+
+	MemoryTag::Scope memoryScope(MemoryTag::TERRAIN);
+	Graphics::VertexBuffer *vtxBuffer = renderer->CreateVertexBuffer(GetVertexBufferDesc());
+	return std::unique_ptr<Graphics::MeshObject>(renderer->CreateMeshObject(vtxBuffer, m_indices.Get()));
+}
+
+//static
+void GeoPatchContext::ReleaseMesh(std::unique_ptr<Graphics::MeshObject> mesh)
+{
+	if (!mesh || m_meshPool.size() >= MAX_POOLED_MESHES)
+		return;
+	// drop meshes created before the edge length changed
+	if (mesh->GetIndexBuffer() != m_indices.Get() || mesh->GetVertexBuffer()->GetDesc().numVertices != Uint32(NUMVERTICES()))
+		return;
+	m_meshPool.push_back(std::move(mesh));
+}
+
+//static
+void GeoPatchContext::ClearMeshPool()
+{
+	m_meshPool.clear();
+}
+
 void GeoPatchContext::Init()
 {
 	m_frac = 1.0 / double(m_edgeLen - 3);
@@ -10,19 +10,52 @@
 #include "graphics/VertexBuffer.h"
 #include "vector3.h"
 
+#include <algorithm>
+#include <cmath>
 #include <deque>
+#include <memory>
+#include <vector>
 
 // maximumpatch depth
 #define GEOPATCH_MAX_DEPTH 15
 
+namespace Graphics {
+	class Renderer;
+}
+
 class GeoPatchContext : public RefCounted {
 public:
+	// Compact patch vertex, 20 bytes instead of 36 for float positions,
+	// normals and uvs. Positions are relative to the patch's clip centroid
+	// and divided by a per-patch scale, which the patch puts back in its
+	// transform when drawing.
 	struct VBOVertex {
-		vector3f pos;
-		vector3f norm;
+		Sint16 pos[4];
+		Sint8 norm[4];
 		Color4ub col;
-		vector2f uv;
+		Uint16 uv[2];
+
+		void SetPos(const vector3f &p, float invScale)
+		{
+			for (int i = 0; i < 3; i++)
+				pos[i] = PackSnorm16(p[i] * invScale);
+			pos[3] = 32767; // w = 1
+		}
+		void SetNormal(const vector3f &n)
+		{
+			for (int i = 0; i < 3; i++)
+				norm[i] = Sint8(std::lround(std::clamp(n[i], -1.0f, 1.0f) * 127.0f));
+			norm[3] = 0;
+		}
+		void SetUV(float u, float v)
+		{
+			uv[0] = Uint16(std::lround(std::clamp(u, 0.0f, 1.0f) * 65535.0f));
+			uv[1] = Uint16(std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+		}
+
+		static Sint16 PackSnorm16(float f) { return Sint16(std::lround(std::clamp(f, -1.0f, 1.0f) * 32767.0f)); }
 	};
+	static_assert(sizeof(VBOVertex) == 20, "GeoPatch vertices should be packed");
 
 	GeoPatchContext(const int _edgeLen)
 	{
@@ -37,7 +70,17 @@ public:
 
 	static void Init();
 
+	// shared by all patches with the current edge length
 	static inline Graphics::IndexBuffer *GetIndexBuffer() { return m_indices.Get(); }
+	static Graphics::VertexBufferDesc GetVertexBufferDesc();
+
+	// Patch meshes all have the same size, so instead of creating and
+	// deleting GL buffers as patches split and merge, released meshes are
+	// kept here and handed out again.
+	static std::unique_ptr<Graphics::MeshObject> AcquireMesh(Graphics::Renderer *renderer);
+	static void ReleaseMesh(std::unique_ptr<Graphics::MeshObject> mesh);
+	static void ClearMeshPool();
+	static inline Uint32 GetNumPooledMeshes() { return Uint32(m_meshPool.size()); }
 
 	static inline int NUMVERTICES() { return m_edgeLen * m_edgeLen; }
 
@@ -61,6 +104,8 @@ private:
 	static RefCountedPtr<Graphics::IndexBuffer> m_indices;
 	static int m_prevEdgeLen;
 
+	static std::vector<std::unique_ptr<Graphics::MeshObject>> m_meshPool;
+
 	static void GenerateIndices();
 };
 
@@ -0,0 +1,68 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "GeoPatchDataPool.h"
+
+#include <map>
+
+std::atomic<size_t> GeoPatchDataPool::s_bytesInUse{ 0 };
+std::atomic<size_t> GeoPatchDataPool::s_bytesHighWater{ 0 };
+std::atomic<size_t> GeoPatchDataPool::s_bytesPooled{ 0 };
+
+namespace {
+	std::mutex s_poolsLock;
+	// pools are never destroyed, arrays may be returned to them at any time
+	std::map<uint32_t, GeoPatchDataPool *> s_pools;
+
+	template <typename T>
+	size_t FreeList(std::vector<T *> &freeList, uint32_t numVertices)
+	{
+		for (T *data : freeList)
+			delete[] data;
+		const size_t bytes = freeList.size() * sizeof(T) * numVertices;
+		freeList.clear();
+		freeList.shrink_to_fit();
+		return bytes;
+	}
+} // namespace
+
+// static
+GeoPatchDataPool *GeoPatchDataPool::Get(uint32_t numVertices)
+{
+	std::lock_guard<std::mutex> lock(s_poolsLock);
+	auto it = s_pools.find(numVertices);
+	if (it != s_pools.end())
+		return it->second;
+
+	GeoPatchDataPool *pool = new GeoPatchDataPool(numVertices);
+	s_pools.emplace(numVertices, pool);
+	return pool;
+}
+
+// static
+void GeoPatchDataPool::FreeUnused()
+{
+	std::lock_guard<std::mutex> lock(s_poolsLock);
+	for (auto &it : s_pools)
+		it.second->FreeAll();
+}
+
+// static
+void GeoPatchDataPool::AddInUse(size_t bytes)
+{
+	const size_t inUse = s_bytesInUse.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	size_t highWater = s_bytesHighWater.load(std::memory_order_relaxed);
+	while (inUse > highWater && !s_bytesHighWater.compare_exchange_weak(highWater, inUse, std::memory_order_relaxed)) {
+	}
+}
+
+void GeoPatchDataPool::FreeAll()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	size_t bytes = 0;
+	bytes += FreeList(std::get<std::vector<float *>>(m_free), m_numVertices);
+	bytes += FreeList(std::get<std::vector<vector3f *>>(m_free), m_numVertices);
+	bytes += FreeList(std::get<std::vector<Color3ub *>>(m_free), m_numVertices);
+	s_bytesPooled.fetch_sub(bytes, std::memory_order_relaxed);
+	MemoryTag::Free(MemoryTag::TERRAIN, bytes);
+}
@@ -0,0 +1,124 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _GEOPATCHDATAPOOL_H
+#define _GEOPATCHDATAPOOL_H
+
+#include "Color.h"
+#include "core/MemoryTag.h"
+#include "vector3.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+// Thread-safe free-list pool for the per-vertex height, normal and colour
+// arrays produced by GeoPatch jobs. There is one pool for each patch vertex
+// count (i.e. GeoPatchContext edge length); arrays are handed out to job
+// requests on worker threads and returned when a GeoPatch merges or is
+// destroyed, avoiding allocator contention and heap fragmentation.
+// Everything the pools allocate, in use or not, counts as MemoryTag::TERRAIN.
+class GeoPatchDataPool {
+public:
+	// Returns the pool for arrays of numVertices elements. Pools live for
+	// the lifetime of the program.
+	static GeoPatchDataPool *Get(uint32_t numVertices);
+
+	// Free all pooled (currently unused) arrays in every pool.
+	static void FreeUnused();
+
+	// Memory currently handed out by all pools, in bytes
+	static size_t GetMemoryInUse() { return s_bytesInUse.load(std::memory_order_relaxed); }
+	// Highest value of GetMemoryInUse() seen so far, in bytes
+	static size_t GetMemoryHighWater() { return s_bytesHighWater.load(std::memory_order_relaxed); }
+	// Memory held in free lists waiting to be reused, in bytes
+	static size_t GetMemoryPooled() { return s_bytesPooled.load(std::memory_order_relaxed); }
+
+	uint32_t GetNumVertices() const { return m_numVertices; }
+
+	template <typename T>
+	T *Acquire();
+
+	template <typename T>
+	void Release(T *data);
+
+	// unique_ptr deleter returning an array to the pool it came from
+	template <typename T>
+	struct Deleter {
+		GeoPatchDataPool *pool = nullptr;
+		void operator()(T *data) const { pool->Release(data); }
+	};
+
+	template <typename T>
+	using Ptr = std::unique_ptr<T[], Deleter<T>>;
+
+	template <typename T>
+	Ptr<T> MakePtr(T *data) { return Ptr<T>(data, Deleter<T>{ this }); }
+
+private:
+	explicit GeoPatchDataPool(uint32_t numVertices) :
+		m_numVertices(numVertices) {}
+
+	void FreeAll();
+	static void AddInUse(size_t bytes);
+
+	// don't hold on to more than this many unused arrays of each type
+	static constexpr size_t MAX_FREE_ARRAYS = 2048;
+
+	const uint32_t m_numVertices;
+
+	std::mutex m_lock;
+	std::tuple<std::vector<float *>, std::vector<vector3f *>, std::vector<Color3ub *>> m_free;
+
+	static std::atomic<size_t> s_bytesInUse;
+	static std::atomic<size_t> s_bytesHighWater;
+	static std::atomic<size_t> s_bytesPooled;
+};
+
+template <typename T>
+T *GeoPatchDataPool::Acquire()
+{
+	const size_t bytes = sizeof(T) * m_numVertices;
+	AddInUse(bytes);
+
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		std::vector<T *> &freeList = std::get<std::vector<T *>>(m_free);
+		if (!freeList.empty()) {
+			T *data = freeList.back();
+			freeList.pop_back();
+			s_bytesPooled.fetch_sub(bytes, std::memory_order_relaxed);
+			return data;
+		}
+	}
+
+	MemoryTag::Allocate(MemoryTag::TERRAIN, bytes);
+	return new T[m_numVertices];
+}
+
+template <typename T>
+void GeoPatchDataPool::Release(T *data)
+{
+	if (!data)
+		return;
+
+	const size_t bytes = sizeof(T) * m_numVertices;
+	s_bytesInUse.fetch_sub(bytes, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		std::vector<T *> &freeList = std::get<std::vector<T *>>(m_free);
+		if (freeList.size() < MAX_FREE_ARRAYS) {
+			freeList.push_back(data);
+			s_bytesPooled.fetch_add(bytes, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	MemoryTag::Free(MemoryTag::TERRAIN, bytes);
+	delete[] data;
+}
+
+#endif /* _GEOPATCHDATAPOOL_H */
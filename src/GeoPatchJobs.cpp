@@ -3,6 +3,7 @@
 
 #include "GeoPatchJobs.h"
 
+#include "GeoPatchCache.h"
 #include "GeoSphere.h"
 #include "MathUtil.h"
 #include "perlin.h"
@@ -21,46 +22,93 @@ inline vector3d GetSpherePoint(const vector3d &v0, const vector3d &v1, const vec
 	return (v0 + x * (1.0 - y) * (v1 - v0) + x * y * (v2 - v0) + (1.0 - x) * y * (v3 - v0)).Normalized();
 }
 
+// Inputs for one row of patch colours, evaluated with a single GetColors call
+struct ColorRow {
+	std::vector<vector3d> points, norms, colors;
+	std::vector<double> heights;
+
+	explicit ColorRow(int len) :
+		points(len),
+		norms(len),
+		colors(len),
+		heights(len)
+	{}
+
+	Color3ub *Evaluate(const Terrain *terrain, Color3ub *out)
+	{
+		terrain->GetColors(points.data(), heights.data(), norms.data(), colors.data(), colors.size());
+		for (const vector3d &c : colors)
+			setColour(*(out++), c);
+		return out;
+	}
+};
+
+// The lowest of the edgeLen^2 heights starting at (xoff, yoff) of a bordered grid
+static double GetMinHeight(const double *borderHeights, const int edgeLen, const int xoff, const int yoff, const int borderedEdgeLen)
+{
+	double minh = borderHeights[xoff + yoff * borderedEdgeLen];
+	for (int y = 0; y < edgeLen; y++) {
+		const double *row = &borderHeights[xoff + (y + yoff) * borderedEdgeLen];
+		for (int x = 0; x < edgeLen; x++)
+			minh = std::min(minh, row[x]);
+	}
+	return minh;
+}
+
+// Fill the vertices and heights of a borderedEdgeLen^2 grid starting
+// BORDER_SIZE steps outside of the patch, one GetHeights call per row
+static void GenerateBorderedHeights(const SBaseRequest &req, vector3d *borderVertexs, double *borderHeights,
+	const int borderedEdgeLen, const double step)
+{
+	PROFILE_SCOPED()
+	const vector3d &v0 = req.v0, &v1 = req.v1, &v2 = req.v2, &v3 = req.v3;
+	for (int y = -BORDER_SIZE; y < borderedEdgeLen - BORDER_SIZE; y++) {
+		vector3d *vrts = &borderVertexs[(y + BORDER_SIZE) * borderedEdgeLen];
+		double *bhts = &borderHeights[(y + BORDER_SIZE) * borderedEdgeLen];
+
+		// the sphere points go where the vertices end up
+		const double yfrac = double(y) * step;
+		for (int x = -BORDER_SIZE; x < borderedEdgeLen - BORDER_SIZE; x++)
+			vrts[x + BORDER_SIZE] = GetSpherePoint(v0, v1, v2, v3, double(x) * step, yfrac);
+
+		req.pTerrain->GetHeights(vrts, bhts, borderedEdgeLen);
+
+		for (int x = 0; x < borderedEdgeLen; x++) {
+			assert(bhts[x] >= 0.0f && bhts[x] <= 1.0f);
+			vrts[x] = vrts[x] * (bhts[x] + 1.0);
+		}
+	}
+}
+
 // ********************************************************************************
 // Overloaded PureJob class to handle generating the mesh for each patch
 // ********************************************************************************
 
 // Generates full-detail vertices, and also non-edge normals and colors
-void SSingleSplitRequest::GenerateMesh() const
+void SSingleSplitRequest::GenerateMesh()
 {
 	PROFILE_SCOPED()
 	const int borderedEdgeLen = edgeLen + (BORDER_SIZE * 2);
-#ifndef NDEBUG
-	const int numBorderedVerts = borderedEdgeLen * borderedEdgeLen;
-#endif
 
 	// generate heights plus a 1 unit border
-	double *bhts = borderHeights.get();
-	vector3d *vrts = borderVertexs.get();
-	for (int y = -BORDER_SIZE; y < borderedEdgeLen - BORDER_SIZE; y++) {
-		const double yfrac = double(y) * fracStep;
-		for (int x = -BORDER_SIZE; x < borderedEdgeLen - BORDER_SIZE; x++) {
-			const double xfrac = double(x) * fracStep;
-			const vector3d p = GetSpherePoint(v0, v1, v2, v3, xfrac, yfrac);
-			const double height = pTerrain->GetHeight(p);
-			assert(height >= 0.0f && height <= 1.0f);
-			*(bhts++) = height;
-			*(vrts++) = p * (height + 1.0);
-		}
-	}
-	assert(bhts == &borderHeights.get()[numBorderedVerts]);
+	GenerateBorderedHeights(*this, borderVertexs.get(), borderHeights.get(), borderedEdgeLen, fracStep);
+	heightOrigin = GetMinHeight(borderHeights.get(), edgeLen, BORDER_SIZE, BORDER_SIZE, borderedEdgeLen);
 
 	// Generate normals & colors for non-edge vertices since they never change
 	Color3ub *col = colors;
 	vector3f *nrm = normals;
-	double *hts = heights;
-	vrts = borderVertexs.get();
+	float *hts = heights;
+	const vector3d *vrts = borderVertexs.get();
+	ColorRow row(edgeLen);
 	for (int y = BORDER_SIZE; y < borderedEdgeLen - BORDER_SIZE; y++) {
 		for (int x = BORDER_SIZE; x < borderedEdgeLen - BORDER_SIZE; x++) {
+			const int i = x - BORDER_SIZE;
+
 			// height
 			const double height = borderHeights[x + y * borderedEdgeLen];
 			assert(hts != &heights[edgeLen * edgeLen]);
-			*(hts++) = height;
+			*(hts++) = float(height - heightOrigin);
+			row.heights[i] = height;
 
 			// normal
 			const vector3d &x1 = vrts[(x - 1) + y * borderedEdgeLen];
@@ -70,13 +118,14 @@ void SSingleSplitRequest::GenerateMesh() const
 			const vector3d n = ((x2 - x1).Cross(y2 - y1)).Normalized();
 			assert(nrm != &normals[edgeLen * edgeLen]);
 			*(nrm++) = vector3f(n);
+			row.norms[i] = n;
 
 			// color
-			const vector3d p = GetSpherePoint(v0, v1, v2, v3, (x - BORDER_SIZE) * fracStep, (y - BORDER_SIZE) * fracStep);
-			setColour(*col, pTerrain->GetColor(p, height, n));
-			assert(col != &colors[edgeLen * edgeLen]);
-			++col;
+			row.points[i] = GetSpherePoint(v0, v1, v2, v3, i * fracStep, (y - BORDER_SIZE) * fracStep);
 		}
+
+		assert(col + edgeLen <= &colors[edgeLen * edgeLen]);
+		col = row.Evaluate(pTerrain.Get(), col);
 	}
 	assert(hts == &heights[edgeLen * edgeLen]);
 	assert(nrm == &normals[edgeLen * edgeLen]);
@@ -100,14 +149,22 @@ void SinglePatchJob::OnRun() // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 
 	const SSingleSplitRequest &srd = *mData;
 
-	// fill out the data
-	mData->GenerateMesh();
+	// fill out the data, from the cache if the patch was generated before
+	const uint64_t cacheKey = GeoPatchCache::GetPatchKey(srd.terrainKey, srd.patchID, srd.depth, srd.edgeLen, srd.fracStep, 1);
+	const uint32_t numVertices = srd.NUMVERTICES(srd.edgeLen);
+	if (!GeoPatchCache::Load(cacheKey, numVertices, 1, &srd.heights, &mData->heightOrigin, &srd.normals, &srd.colors)) {
+		mData->GenerateMesh();
+		GeoPatchCache::Store(cacheKey, numVertices, 1, &srd.heights, &srd.heightOrigin, &srd.normals, &srd.colors);
+	}
 
 	// add this patches data
 	SSingleSplitResult *sr = new SSingleSplitResult(srd.patchID.GetPatchFaceIdx(), srd.depth);
-	sr->addResult(srd.heights, srd.normals, srd.colors,
+	sr->addResult(srd.pool, srd.heights, srd.heightOrigin, srd.normals, srd.colors,
 		srd.v0, srd.v1, srd.v2, srd.v3,
 		srd.patchID.NextPatchID(srd.depth + 1, 0));
+	mData->heights = nullptr;
+	mData->normals = nullptr;
+	mData->colors = nullptr;
 	// store the result
 	mpResults = sr;
 }
@@ -138,7 +195,12 @@ void QuadPatchJob::OnRun() // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 
 	const SQuadSplitRequest &srd = *mData;
 
-	mData->GenerateBorderedData();
+	// the kids' data comes from the cache if the patch was split before
+	const uint64_t cacheKey = GeoPatchCache::GetPatchKey(srd.terrainKey, srd.patchID, srd.depth, srd.edgeLen, srd.fracStep, 4);
+	const uint32_t numVertices = srd.NUMVERTICES(srd.edgeLen);
+	const bool cached = GeoPatchCache::Load(cacheKey, numVertices, 4, srd.heights, mData->heightOrigins, srd.normals, srd.colors);
+	if (!cached)
+		mData->GenerateBorderedData();
 
 	const vector3d v01 = (srd.v0 + srd.v1).Normalized();
 	const vector3d v12 = (srd.v1 + srd.v2).Normalized();
@@ -163,16 +225,27 @@ void QuadPatchJob::OnRun() // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 	SQuadSplitResult *sr = new SQuadSplitResult(srd.patchID.GetPatchFaceIdx(), srd.depth);
 	for (int i = 0; i < 4; i++) {
 		// fill out the data
-		mData->GenerateSubPatchData(i,
-			vecs[i][0], vecs[i][1], vecs[i][2], vecs[i][3],
-			srd.edgeLen, offxy[i][0], offxy[i][1],
-			borderedEdgeLen);
+		if (!cached) {
+			mData->GenerateSubPatchData(i,
+				vecs[i][0], vecs[i][1], vecs[i][2], vecs[i][3],
+				srd.edgeLen, offxy[i][0], offxy[i][1],
+				borderedEdgeLen);
+		}
 
 		// add this patches data
-		sr->addResult(i, srd.heights[i], srd.normals[i], srd.colors[i],
+		sr->addResult(i, srd.pool, srd.heights[i], srd.heightOrigins[i], srd.normals[i], srd.colors[i],
 			vecs[i][0], vecs[i][1], vecs[i][2], vecs[i][3],
 			srd.patchID.NextPatchID(srd.depth + 1, i));
 	}
+	if (!cached)
+		GeoPatchCache::Store(cacheKey, numVertices, 4, srd.heights, srd.heightOrigins, srd.normals, srd.colors);
+
+	// the result owns the arrays now
+	for (int i = 0; i < 4; i++) {
+		mData->heights[i] = nullptr;
+		mData->normals[i] = nullptr;
+		mData->colors[i] = nullptr;
+	}
 	mpResults = sr;
 }
 
@@ -190,25 +263,9 @@ void SQuadSplitRequest::GenerateBorderedData() const
 {
 	PROFILE_SCOPED()
 	const int borderedEdgeLen = (edgeLen * 2) + (BORDER_SIZE * 2) - 1;
-#ifndef NDEBUG
-	const int numBorderedVerts = borderedEdgeLen * borderedEdgeLen;
-#endif
 
 	// generate heights plus a N=BORDER_SIZE unit border
-	double *bhts = borderHeights.get();
-	vector3d *vrts = borderVertexs.get();
-	for (int y = -BORDER_SIZE; y < (borderedEdgeLen - BORDER_SIZE); y++) {
-		const double yfrac = double(y) * (fracStep * 0.5);
-		for (int x = -BORDER_SIZE; x < (borderedEdgeLen - BORDER_SIZE); x++) {
-			const double xfrac = double(x) * (fracStep * 0.5);
-			const vector3d p = GetSpherePoint(v0, v1, v2, v3, xfrac, yfrac);
-			const double height = pTerrain->GetHeight(p);
-			assert(height >= 0.0f && height <= 1.0f);
-			*(bhts++) = height;
-			*(vrts++) = p * (height + 1.0);
-		}
-	}
-	assert(bhts == &borderHeights[numBorderedVerts]);
+	GenerateBorderedHeights(*this, borderVertexs.get(), borderHeights.get(), borderedEdgeLen, fracStep * 0.5);
 }
 
 void SQuadSplitRequest::GenerateSubPatchData(
@@ -220,16 +277,20 @@ void SQuadSplitRequest::GenerateSubPatchData(
 	const int edgeLen,
 	const int xoff,
 	const int yoff,
-	const int borderedEdgeLen) const
+	const int borderedEdgeLen)
 {
 	PROFILE_SCOPED()
+	const double heightOrigin = GetMinHeight(borderHeights.get(), edgeLen, xoff + BORDER_SIZE, yoff + BORDER_SIZE, borderedEdgeLen);
+	heightOrigins[quadrantIndex] = heightOrigin;
+
 	// Generate normals & colors for vertices
 	vector3d *vrts = borderVertexs.get();
 	Color3ub *col = colors[quadrantIndex];
 	vector3f *nrm = normals[quadrantIndex];
-	double *hts = heights[quadrantIndex];
+	float *hts = heights[quadrantIndex];
 
 	// step over the small square
+	ColorRow row(edgeLen);
 	for (int y = 0; y < edgeLen; y++) {
 		const int by = (y + BORDER_SIZE) + yoff;
 		for (int x = 0; x < edgeLen; x++) {
@@ -238,7 +299,8 @@ void SQuadSplitRequest::GenerateSubPatchData(
 			// height
 			const double height = borderHeights[bx + (by * borderedEdgeLen)];
 			assert(hts != &heights[quadrantIndex][edgeLen * edgeLen]);
-			*(hts++) = height;
+			*(hts++) = float(height - heightOrigin);
+			row.heights[x] = height;
 
 			// normal
 			const vector3d &x1 = vrts[(bx - 1) + (by * borderedEdgeLen)];
@@ -248,13 +310,14 @@ void SQuadSplitRequest::GenerateSubPatchData(
 			const vector3d n = ((x2 - x1).Cross(y2 - y1)).Normalized();
 			assert(nrm != &normals[quadrantIndex][edgeLen * edgeLen]);
 			*(nrm++) = vector3f(n);
+			row.norms[x] = n;
 
 			// color
-			const vector3d p = GetSpherePoint(v0, v1, v2, v3, x * fracStep, y * fracStep);
-			setColour(*col, pTerrain->GetColor(p, height, n));
-			assert(col != &colors[quadrantIndex][edgeLen * edgeLen]);
-			++col;
+			row.points[x] = GetSpherePoint(v0, v1, v2, v3, x * fracStep, y * fracStep);
 		}
+
+		assert(col + edgeLen <= &colors[quadrantIndex][edgeLen * edgeLen]);
+		col = row.Evaluate(pTerrain.Get(), col);
 	}
 	assert(hts == &heights[quadrantIndex][edgeLen * edgeLen]);
 	assert(nrm == &normals[quadrantIndex][edgeLen * edgeLen]);
@@ -7,6 +7,7 @@
 #include <SDL_stdinc.h>
 
 #include "Color.h"
+#include "GeoPatchDataPool.h"
 #include "GeoPatchID.h"
 #include "JobQueue.h"
 #include "vector3.h"
@@ -20,7 +21,7 @@ class SBaseRequest {
 public:
 	SBaseRequest(const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const vector3d &cn,
 		const uint32_t depth_, const SystemPath &sysPath_, const GeoPatchID &patchID_, const int edgeLen_, const double fracStep_,
-		Terrain *pTerrain_) :
+		Terrain *pTerrain_, const uint64_t terrainKey_) :
 		v0(v0_),
 		v1(v1_),
 		v2(v2_),
@@ -31,7 +32,8 @@ public:
 		patchID(patchID_),
 		edgeLen(edgeLen_),
 		fracStep(fracStep_),
-		pTerrain(pTerrain_)
+		pTerrain(pTerrain_),
+		terrainKey(terrainKey_)
 	{
 	}
 
@@ -45,6 +47,8 @@ public:
 	const int edgeLen;
 	const double fracStep;
 	RefCountedPtr<Terrain> pTerrain;
+	// GeoPatchCache::GetTerrainKey() of the terrain
+	const uint64_t terrainKey;
 
 protected:
 	// deliberately prevent copy constructor access
@@ -55,31 +59,47 @@ class SQuadSplitRequest : public SBaseRequest {
 public:
 	SQuadSplitRequest(const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const vector3d &cn,
 		const uint32_t depth_, const SystemPath &sysPath_, const GeoPatchID &patchID_, const int edgeLen_, const double fracStep_,
-		Terrain *pTerrain_) :
-		SBaseRequest(v0_, v1_, v2_, v3_, cn, depth_, sysPath_, patchID_, edgeLen_, fracStep_, pTerrain_)
+		Terrain *pTerrain_, const uint64_t terrainKey_) :
+		SBaseRequest(v0_, v1_, v2_, v3_, cn, depth_, sysPath_, patchID_, edgeLen_, fracStep_, pTerrain_, terrainKey_)
 	{
-		const int numVerts = NUMVERTICES(edgeLen_);
+		pool = GeoPatchDataPool::Get(NUMVERTICES(edgeLen_));
 		for (int i = 0; i < 4; ++i) {
-			heights[i] = new double[numVerts];
-			normals[i] = new vector3f[numVerts];
-			colors[i] = new Color3ub[numVerts];
+			heights[i] = pool->Acquire<float>();
+			heightOrigins[i] = 0.0;
+			normals[i] = pool->Acquire<vector3f>();
+			colors[i] = pool->Acquire<Color3ub>();
 		}
 		const int numBorderedVerts = NUMVERTICES((edgeLen_ * 2) + (BORDER_SIZE * 2) - 1);
 		borderHeights.reset(new double[numBorderedVerts]);
 		borderVertexs.reset(new vector3d[numBorderedVerts]);
 	}
 
+	// return the arrays to the pool unless they were given to a result,
+	// e.g. because the job was cancelled before it ran
+	~SQuadSplitRequest()
+	{
+		for (int i = 0; i < 4; ++i) {
+			pool->Release(heights[i]);
+			pool->Release(normals[i]);
+			pool->Release(colors[i]);
+		}
+	}
+
 	// Generates full-detail vertices, and also non-edge normals and colors
 	void GenerateBorderedData() const;
 
 	void GenerateSubPatchData(const int quadrantIndex,
 		const vector3d &v0, const vector3d &v1, const vector3d &v2, const vector3d &v3,
-		const int edgeLen, const int xoff, const int yoff, const int borderedEdgeLen) const;
+		const int edgeLen, const int xoff, const int yoff, const int borderedEdgeLen);
 
-	// these are created with the request and are given to the resulting patches
+	// these are created with the request and are given to the resulting patches,
+	// which leaves them set to nullptr here
 	vector3f *normals[4];
 	Color3ub *colors[4];
-	double *heights[4];
+	// heights are stored relative to the lowest one of each patch
+	float *heights[4];
+	double heightOrigins[4];
+	GeoPatchDataPool *pool;
 
 	// these are created with the request but are destroyed when the request is finished
 	std::unique_ptr<double[]> borderHeights;
@@ -94,26 +114,40 @@ class SSingleSplitRequest : public SBaseRequest {
 public:
 	SSingleSplitRequest(const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const vector3d &cn,
 		const uint32_t depth_, const SystemPath &sysPath_, const GeoPatchID &patchID_, const int edgeLen_, const double fracStep_,
-		Terrain *pTerrain_) :
-		SBaseRequest(v0_, v1_, v2_, v3_, cn, depth_, sysPath_, patchID_, edgeLen_, fracStep_, pTerrain_)
+		Terrain *pTerrain_, const uint64_t terrainKey_) :
+		SBaseRequest(v0_, v1_, v2_, v3_, cn, depth_, sysPath_, patchID_, edgeLen_, fracStep_, pTerrain_, terrainKey_)
 	{
-		const int numVerts = NUMVERTICES(edgeLen_);
-		heights = new double[numVerts];
-		normals = new vector3f[numVerts];
-		colors = new Color3ub[numVerts];
+		pool = GeoPatchDataPool::Get(NUMVERTICES(edgeLen_));
+		heights = pool->Acquire<float>();
+		heightOrigin = 0.0;
+		normals = pool->Acquire<vector3f>();
+		colors = pool->Acquire<Color3ub>();
 
 		const int numBorderedVerts = NUMVERTICES(edgeLen_ + (BORDER_SIZE * 2));
 		borderHeights.reset(new double[numBorderedVerts]);
 		borderVertexs.reset(new vector3d[numBorderedVerts]);
 	}
 
+	// return the arrays to the pool unless they were given to a result,
+	// e.g. because the job was cancelled before it ran
+	~SSingleSplitRequest()
+	{
+		pool->Release(heights);
+		pool->Release(normals);
+		pool->Release(colors);
+	}
+
 	// Generates full-detail vertices, and also non-edge normals and colors
-	void GenerateMesh() const;
+	void GenerateMesh();
 
-	// these are created with the request and are given to the resulting patches
+	// these are created with the request and are given to the resulting patches,
+	// which leaves them set to nullptr here
 	vector3f *normals;
 	Color3ub *colors;
-	double *heights;
+	// heights are stored relative to the lowest one
+	float *heights;
+	double heightOrigin;
+	GeoPatchDataPool *pool;
 
 	// these are created with the request but are destroyed when the request is finished
 	std::unique_ptr<double[]> borderHeights;
@@ -126,11 +160,18 @@ protected:
 
 struct SSplitResultData {
 	SSplitResultData() :
+		heights(nullptr),
+		heightOrigin(0.0),
+		normals(nullptr),
+		colors(nullptr),
+		pool(nullptr),
 		patchID(0) {}
-	SSplitResultData(double *heights_, vector3f *n_, Color3ub *c_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_) :
+	SSplitResultData(GeoPatchDataPool *pool_, float *heights_, double heightOrigin_, vector3f *n_, Color3ub *c_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_) :
 		heights(heights_),
+		heightOrigin(heightOrigin_),
 		normals(n_),
 		colors(c_),
+		pool(pool_),
 		v0(v0_),
 		v1(v1_),
 		v2(v2_),
@@ -138,9 +179,26 @@ struct SSplitResultData {
 		patchID(patchID_)
 	{}
 
-	double *heights;
+	// return any arrays still held to their pool
+	void Release()
+	{
+		if (!pool)
+			return;
+		pool->Release(heights);
+		pool->Release(normals);
+		pool->Release(colors);
+		heights = nullptr;
+		normals = nullptr;
+		colors = nullptr;
+	}
+
+	// heights relative to heightOrigin, the lowest of them
+	float *heights;
+	double heightOrigin;
 	vector3f *normals;
 	Color3ub *colors;
+	// the pool the arrays above were acquired from and must be returned to
+	GeoPatchDataPool *pool;
 	vector3d v0, v1, v2, v3;
 	GeoPatchID patchID;
 };
@@ -176,10 +234,10 @@ public:
 	{
 	}
 
-	void addResult(const int kidIdx, double *h_, vector3f *n_, Color3ub *c_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_)
+	void addResult(const int kidIdx, GeoPatchDataPool *pool_, float *h_, double hOrigin_, vector3f *n_, Color3ub *c_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_)
 	{
 		assert(kidIdx >= 0 && kidIdx < NUM_RESULT_DATA);
-		mData[kidIdx] = (SSplitResultData(h_, n_, c_, v0_, v1_, v2_, v3_, patchID_));
+		mData[kidIdx] = (SSplitResultData(pool_, h_, hOrigin_, n_, c_, v0_, v1_, v2_, v3_, patchID_));
 	}
 
 	inline const SSplitResultData &data(const int32_t idx) const { return mData[idx]; }
@@ -187,18 +245,7 @@ public:
 	virtual void OnCancel()
 	{
 		for (int i = 0; i < NUM_RESULT_DATA; ++i) {
-			if (mData[i].heights) {
-				delete[] mData[i].heights;
-				mData[i].heights = NULL;
-			}
-			if (mData[i].normals) {
-				delete[] mData[i].normals;
-				mData[i].normals = NULL;
-			}
-			if (mData[i].colors) {
-				delete[] mData[i].colors;
-				mData[i].colors = NULL;
-			}
+			mData[i].Release();
 		}
 	}
 
@@ -217,29 +264,16 @@ public:
 	{
 	}
 
-	void addResult(double *h_, vector3f *n_, Color3ub *c_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_)
+	void addResult(GeoPatchDataPool *pool_, float *h_, double hOrigin_, vector3f *n_, Color3ub *c_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_)
 	{
-		mData = (SSplitResultData(h_, n_, c_, v0_, v1_, v2_, v3_, patchID_));
+		mData = (SSplitResultData(pool_, h_, hOrigin_, n_, c_, v0_, v1_, v2_, v3_, patchID_));
 	}
 
 	inline const SSplitResultData &data() const { return mData; }
 
 	virtual void OnCancel()
 	{
-		{
-			if (mData.heights) {
-				delete[] mData.heights;
-				mData.heights = NULL;
-			}
-			if (mData.normals) {
-				delete[] mData.normals;
-				mData.normals = NULL;
-			}
-			if (mData.colors) {
-				delete[] mData.colors;
-				mData.colors = NULL;
-			}
-		}
+		mData.Release();
 	}
 
 protected:
@@ -277,6 +311,7 @@ public:
 
 	virtual void OnRun(); // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 	virtual void OnFinish(); // runs in primary thread of the context
+	virtual const char *GetJobName() const { return "SinglePatchJob"; }
 
 private:
 	std::unique_ptr<SSingleSplitRequest> mData;
@@ -297,6 +332,7 @@ public:
 
 	virtual void OnRun(); // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 	virtual void OnFinish(); // runs in primary thread of the context
+	virtual const char *GetJobName() const { return "QuadPatchJob"; }
 
 private:
 	std::unique_ptr<SQuadSplitRequest> mData;
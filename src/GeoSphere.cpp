@@ -5,7 +5,9 @@
 
 #include "GameConfig.h"
 #include "GeoPatch.h"
+#include "GeoPatchCache.h"
 #include "GeoPatchContext.h"
+#include "GeoPatchDataPool.h"
 #include "GeoPatchJobs.h"
 #include "Pi.h"
 #include "RefCounted.h"
@@ -26,6 +28,11 @@
 #include <deque>
 
 RefCountedPtr<GeoPatchContext> GeoSphere::s_patchContext;
+double GeoSphere::s_splitResultsBudget = GeoSphere::SPLIT_RESULTS_BUDGET_MS;
+double GeoSphere::s_lookAheadTime = 0.0;
+Uint32 GeoSphere::s_numPrefetchedSplits = 0;
+Uint32 GeoSphere::s_numCancelledSplits = 0;
+bool GeoSphere::s_coherentCulling = false;
 
 // must be odd numbers
 static const int detail_edgeLen[5] = {
@@ -38,17 +45,29 @@ static const int detail_edgeLen[5] = {
 };
 
 static const double gs_targetPatchTriLength(100.0);
+// weight of the previous velocity when smoothing the camera velocity each frame
+static const double gs_camVelocitySmoothing = 0.9;
+// camera moves longer than this (in planet radii) in one frame are jumps, not motion
+static const double gs_maxCamFrameMove = 0.5;
+// never look further ahead than this, in planet radii
+static const double gs_maxLookAheadDistance = 0.5;
 static std::vector<GeoSphere *> s_allGeospheres;
 
 void GeoSphere::Init()
 {
 	s_patchContext.Reset(new GeoPatchContext(detail_edgeLen[Pi::detail.planets > 4 ? 4 : Pi::detail.planets]));
+	GeoPatchCache::Init(size_t(std::max(0, Pi::config->Int("GeoPatchCacheMB"))) * 1024 * 1024);
+	s_lookAheadTime = std::max(0.0f, Pi::config->Float("GeoPatchLookAhead"));
+	s_coherentCulling = Pi::config->Int("GeoPatchCoherentCulling") != 0;
 }
 
 void GeoSphere::Uninit()
 {
 	assert(s_patchContext.Unique());
+	GeoPatchContext::ClearMeshPool();
 	s_patchContext.Reset();
+	GeoPatchDataPool::FreeUnused();
+	GeoPatchCache::Uninit();
 }
 
 static void print_info(const SystemBody *sbody, const Terrain *terrain)
@@ -65,9 +84,27 @@ static void print_info(const SystemBody *sbody, const Terrain *terrain)
 void GeoSphere::UpdateAllGeoSpheres()
 {
 	PROFILE_SCOPED()
+	s_splitResultsBudget = SPLIT_RESULTS_BUDGET_MS;
 	for (std::vector<GeoSphere *>::iterator i = s_allGeospheres.begin(); i != s_allGeospheres.end(); ++i) {
 		(*i)->Update();
 	}
+
+	Graphics::Stats &stats = Pi::renderer->GetStats();
+	stats.SetStatCount(Graphics::Stats::STAT_MEM_GEOPATCH_POOL_INUSE, uint32_t(GeoPatchDataPool::GetMemoryInUse()));
+	stats.SetStatCount(Graphics::Stats::STAT_MEM_GEOPATCH_POOL_PEAK, uint32_t(GeoPatchDataPool::GetMemoryHighWater()));
+	stats.SetStatCount(Graphics::Stats::STAT_MEM_GEOPATCH_POOL_FREE, uint32_t(GeoPatchDataPool::GetMemoryPooled()));
+	stats.SetStatCount(Graphics::Stats::STAT_GEOPATCH_SPLITS_PREFETCHED, s_numPrefetchedSplits);
+	stats.SetStatCount(Graphics::Stats::STAT_GEOPATCH_SPLITS_CANCELLED, s_numCancelledSplits);
+	stats.SetStatCount(Graphics::Stats::STAT_GEOPATCH_MESHES_POOLED, GeoPatchContext::GetNumPooledMeshes());
+}
+
+bool GeoSphere::GetGeneratedHeight(const vector3d &p, double &height) const
+{
+	for (int i = 0; i < NUM_PATCHES; i++) {
+		if (m_patches[i] && m_patches[i]->GetGeneratedHeight(p, height))
+			return true;
+	}
+	return false;
 }
 
 // static
@@ -82,6 +119,7 @@ void GeoSphere::OnChangeDetailLevel()
 
 		// reinit the terrain with the new settings
 		(*i)->m_terrain.Reset(Terrain::InstanceTerrain((*i)->GetSystemBody()));
+		(*i)->m_terrainKey = GeoPatchCache::GetTerrainKey((*i)->GetSystemBody(), (*i)->m_terrain.Get());
 		print_info((*i)->GetSystemBody(), (*i)->m_terrain.Get());
 
 		// Reload the atmosphere material (scattering option)
@@ -89,6 +127,9 @@ void GeoSphere::OnChangeDetailLevel()
 			(*i)->CreateAtmosphereMaterial();
 		}
 	}
+
+	// the old edge length's arrays are returned as patches are destroyed
+	GeoPatchDataPool::FreeUnused();
 }
 
 //static
@@ -172,6 +213,7 @@ void GeoSphere::Reset()
 		}
 	}
 
+	InvalidateVisibleCut();
 	CalculateMaxPatchDepth();
 
 	m_initStage = eBuildFirstPatches;
@@ -179,9 +221,15 @@ void GeoSphere::Reset()
 
 GeoSphere::GeoSphere(const SystemBody *body) :
 	BaseSphere(body),
+	m_terrainKey(GeoPatchCache::GetTerrainKey(body, m_terrain.Get())),
 	m_hasTempCampos(false),
+	m_hasApproachPoint(false),
+	m_approachPoint(0.0),
 	m_tempCampos(0.0),
 	m_tempFrustum(800, 600, 0.5, 1.0, 1000.0),
+	m_camVelocity(0.0),
+	m_visibleCutValid(false),
+	m_visibleCutAge(0),
 	m_initStage(eBuildFirstPatches),
 	m_maxDepth(0)
 {
@@ -201,33 +249,27 @@ GeoSphere::~GeoSphere()
 	s_allGeospheres.erase(std::find(s_allGeospheres.begin(), s_allGeospheres.end(), this));
 }
 
-bool GeoSphere::AddQuadSplitResult(SQuadSplitResult *res)
+void GeoSphere::AddQuadSplitResult(SQuadSplitResult *res)
 {
-	bool result = false;
 	assert(res);
-	assert(mQuadSplitResults.size() < MAX_SPLIT_OPERATIONS);
-	if (mQuadSplitResults.size() < MAX_SPLIT_OPERATIONS) {
-		mQuadSplitResults.push_back(res);
-		result = true;
-	}
-	return result;
+	// never refused: a result that isn't received leaves its patch waiting
+	// for it forever, and the backlog carried between frames is bounded by
+	// ProcessSplitResults
+	mQuadSplitResults.push_back(res);
 }
 
-bool GeoSphere::AddSingleSplitResult(SSingleSplitResult *res)
+void GeoSphere::AddSingleSplitResult(SSingleSplitResult *res)
 {
-	bool result = false;
 	assert(res);
-	assert(mSingleSplitResults.size() < MAX_SPLIT_OPERATIONS);
-	if (mSingleSplitResults.size() < MAX_SPLIT_OPERATIONS) {
-		mSingleSplitResults.push_back(res);
-		result = true;
-	}
-	return result;
+	mSingleSplitResults.push_back(res);
 }
 
-void GeoSphere::ProcessSplitResults()
+void GeoSphere::ProcessSplitResults(double maxMilliseconds)
 {
 	PROFILE_SCOPED()
+	Profiler::Clock clock;
+	clock.Start();
+
 	// now handle the single split results that define the base level of the quad tree
 	{
 		std::deque<SSingleSplitResult *>::iterator iter = mSingleSplitResults.begin();
@@ -252,10 +294,16 @@ void GeoSphere::ProcessSplitResults()
 		mSingleSplitResults.clear();
 	}
 
-	// now handle the quad split results
+	// now handle the quad split results, within the time budget; the single
+	// split results above are few and are always needed to start rendering
 	{
 		std::deque<SQuadSplitResult *>::iterator iter = mQuadSplitResults.begin();
 		while (iter != mQuadSplitResults.end()) {
+			// don't let the backlog grow without bound when over budget
+			clock.SoftStop();
+			if (clock.milliseconds() >= maxMilliseconds && mQuadSplitResults.end() - iter <= MAX_SPLIT_RESULTS_BACKLOG)
+				break;
+
 			// finally pass SplitResults
 			SQuadSplitResult *psr = (*iter);
 			assert(psr);
@@ -273,7 +321,7 @@ void GeoSphere::ProcessSplitResults()
 			// Next!
 			++iter;
 		}
-		mQuadSplitResults.clear();
+		mQuadSplitResults.erase(mQuadSplitResults.begin(), iter);
 	}
 }
 
@@ -344,13 +392,27 @@ void GeoSphere::Update()
 		for (int i = 0; i < NUM_PATCHES; i++) {
 			m_patches[i]->NeedToUpdateVBOs();
 		}
+		InvalidateVisibleCut();
 		m_initStage = eDefaultUpdateState;
 	} break;
 	case eDefaultUpdateState:
 		if (m_hasTempCampos) {
-			ProcessSplitResults();
+			Profiler::Clock clock;
+			clock.Start();
+			ProcessSplitResults(s_splitResultsBudget);
+			clock.Stop();
+			s_splitResultsBudget = std::max(0.0, s_splitResultsBudget - clock.milliseconds());
+
+			// request patches along the path the camera is expected to
+			// take, so they are ready by the time it gets there
+			vector3d lookAhead = m_camVelocity * s_lookAheadTime;
+			if (lookAhead.LengthSqr() > gs_maxLookAheadDistance * gs_maxLookAheadDistance)
+				lookAhead = lookAhead.Normalized() * gs_maxLookAheadDistance;
+			const vector3d predictedCampos = m_hasApproachPoint ? m_approachPoint : m_tempCampos + lookAhead;
+			m_hasApproachPoint = false;
+
 			for (int i = 0; i < NUM_PATCHES; i++) {
-				m_patches[i]->LODUpdate(m_tempCampos, m_tempFrustum);
+				m_patches[i]->LODUpdate(m_tempCampos, predictedCampos, m_tempFrustum);
 			}
 			ProcessQuadSplitRequests();
 		}
@@ -358,6 +420,12 @@ void GeoSphere::Update()
 	}
 }
 
+void GeoSphere::SetApproachPoint(const vector3d &p)
+{
+	m_approachPoint = p;
+	m_hasApproachPoint = true;
+}
+
 void GeoSphere::AddQuadSplitRequest(double dist, SQuadSplitRequest *pReq, GeoPatch *pPatch)
 {
 	mQuadSplitRequests.push_back(TDistanceRequest(dist, pReq, pPatch));
@@ -369,14 +437,27 @@ void GeoSphere::ProcessQuadSplitRequests()
 
 	for (auto iter : mQuadSplitRequests) {
 		SQuadSplitRequest *ssrd = iter.mpRequest;
-		iter.mpRequester->ReceiveJobHandle(Pi::GetAsyncJobQueue()->Queue(new QuadPatchJob(ssrd)));
+		QuadPatchJob *job = new QuadPatchJob(ssrd);
+		// split patches nearest the camera first
+		job->SetPriority(Job::PRIORITY_NORMAL, float(iter.mDistance));
+		iter.mpRequester->ReceiveJobHandle(Pi::GetAsyncJobQueue()->Queue(job));
 	}
 	mQuadSplitRequests.clear();
 }
 
-void GeoSphere::Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const std::vector<Camera::Shadow> &shadows)
+void GeoSphere::Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const Camera::ShadowList &shadows)
 {
 	PROFILE_SCOPED()
+	// track the camera's velocity, ignoring jumps such as arriving in a new frame
+	const double frameTime = Pi::GetFrameTime();
+	if (m_hasTempCampos && frameTime > 0.0) {
+		const vector3d move = campos - m_tempCampos;
+		if (move.LengthSqr() < gs_maxCamFrameMove * gs_maxCamFrameMove)
+			m_camVelocity = m_camVelocity * gs_camVelocitySmoothing + (move / frameTime) * (1.0 - gs_camVelocitySmoothing);
+		else
+			m_camVelocity = vector3d(0.0);
+	}
+
 	// store this for later usage in the update method.
 	m_tempCampos = campos;
 	m_hasTempCampos = true;
@@ -441,8 +522,21 @@ void GeoSphere::Render(Graphics::Renderer *renderer, const matrix4x4d &modelView
 
 	renderer->SetTransform(matrix4x4f(modelView));
 
-	for (int i = 0; i < NUM_PATCHES; i++) {
-		m_patches[i]->Render(renderer, campos, modelView, frustum);
+	if (s_coherentCulling && m_visibleCutValid && m_visibleCutAge < MAX_VISIBLE_CUT_AGE) {
+		// re-test where the traversal stopped last frame, descending again
+		// from any culled patch that has come into view
+		m_lastVisibleCut.swap(m_visibleCut);
+		m_visibleCut.clear();
+		for (GeoPatch *patch : m_lastVisibleCut)
+			patch->Render(renderer, campos, modelView, frustum, GeoPatch::CULL_ALL, &m_visibleCut);
+		++m_visibleCutAge;
+	} else {
+		m_visibleCut.clear();
+		for (int i = 0; i < NUM_PATCHES; i++) {
+			m_patches[i]->Render(renderer, campos, modelView, frustum, GeoPatch::CULL_ALL, s_coherentCulling ? &m_visibleCut : nullptr);
+		}
+		m_visibleCutValid = s_coherentCulling;
+		m_visibleCutAge = 0;
 	}
 
 	renderer->SetAmbientColor(oldAmbient);
@@ -11,6 +11,7 @@
 #include "vector3.h"
 
 #include <deque>
+#include <limits>
 
 namespace Graphics {
 	class Renderer;
@@ -32,7 +33,7 @@ public:
 	virtual ~GeoSphere();
 
 	virtual void Update() override;
-	virtual void Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const std::vector<Camera::Shadow> &shadows) override;
+	virtual void Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const Camera::ShadowList &shadows) override;
 
 	virtual double GetHeight(const vector3d &p) const override final
 	{
@@ -50,6 +51,11 @@ public:
 		return h;
 	}
 
+	virtual bool GetGeneratedHeight(const vector3d &p, double &height) const override final;
+	// the patches along the way from the camera to p are split instead of
+	// those along its predicted path; only once the sphere has been drawn
+	virtual void SetApproachPoint(const vector3d &p) override;
+
 	static void Init();
 	static void Uninit();
 	static void UpdateAllGeoSpheres();
@@ -59,16 +65,29 @@ public:
 	// in sbody radii
 	virtual double GetMaxFeatureHeight() const override final { return m_terrain->GetMaxHeight(); }
 
-	bool AddQuadSplitResult(SQuadSplitResult *res);
-	bool AddSingleSplitResult(SSingleSplitResult *res);
-	void ProcessSplitResults();
+	void AddQuadSplitResult(SQuadSplitResult *res);
+	void AddSingleSplitResult(SSingleSplitResult *res);
+	// Receive queued split results, stopping once maxMilliseconds have been
+	// spent (any remaining results are processed in the next call).
+	void ProcessSplitResults(double maxMilliseconds = std::numeric_limits<double>::infinity());
 
 	virtual void Reset() override;
 
 	inline Sint32 GetMaxDepth() const { return m_maxDepth; }
+	// identifies the terrain's output in the GeoPatchCache
+	uint64_t GetTerrainKey() const { return m_terrainKey; }
 
 	void AddQuadSplitRequest(double, SQuadSplitRequest *, GeoPatch *);
 
+	// Split requests made only because of the predicted camera path, and
+	// requests cancelled because their patch was no longer wanted. Both are
+	// running totals over all GeoSpheres, for tuning the look-ahead time.
+	static void CountPrefetchedSplit() { ++s_numPrefetchedSplits; }
+	static void CountCancelledSplit() { ++s_numCancelledSplits; }
+
+	// Must be called whenever patches are added, removed or get new heights
+	void InvalidateVisibleCut() { m_visibleCutValid = false; }
+
 private:
 	void BuildFirstPatches();
 	void CalculateMaxPatchDepth();
@@ -90,14 +109,41 @@ private:
 	};
 	std::deque<TDistanceRequest> mQuadSplitRequests;
 
-	static const uint32_t MAX_SPLIT_OPERATIONS = 128;
+	// quad split results left for the next frame once over budget; any
+	// more than this are received regardless
+	static const uint32_t MAX_SPLIT_RESULTS_BACKLOG = 64;
+	// time shared by all GeoSpheres for receiving split results each frame
+	static constexpr double SPLIT_RESULTS_BUDGET_MS = 2.0;
+	static double s_splitResultsBudget;
 	std::deque<SQuadSplitResult *> mQuadSplitResults;
 	std::deque<SSingleSplitResult *> mSingleSplitResults;
 
+	uint64_t m_terrainKey;
+
 	bool m_hasTempCampos;
+	bool m_hasApproachPoint;
+	vector3d m_approachPoint;
 	vector3d m_tempCampos;
 	Graphics::Frustum m_tempFrustum;
 
+	// smoothed camera velocity in planet radii per second, used to predict
+	// where the camera will be s_lookAheadTime seconds from now
+	vector3d m_camVelocity;
+	static double s_lookAheadTime;
+	static Uint32 s_numPrefetchedSplits;
+	static Uint32 s_numCancelledSplits;
+
+	// The patches where the last full Render traversal stopped, drawn or
+	// culled. With coherent culling enabled, the following frames only
+	// re-test these until the patch tree changes.
+	std::vector<GeoPatch *> m_visibleCut;
+	std::vector<GeoPatch *> m_lastVisibleCut;
+	bool m_visibleCutValid;
+	Uint32 m_visibleCutAge;
+	// the cut only ever gets finer, so rebuild it after this many frames
+	static const Uint32 MAX_VISIBLE_CUT_AGE = 30;
+	static bool s_coherentCulling;
+
 	static RefCountedPtr<GeoPatchContext> s_patchContext;
 
 	virtual void SetUpMaterials() override;
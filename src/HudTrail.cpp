@@ -10,24 +10,22 @@
 #include "graphics/RenderState.h"
 #include "graphics/Renderer.h"
 #include "graphics/Types.h"
+#include "graphics/VertexArray.h"
 
 const float UPDATE_INTERVAL = 0.1f;
-const Uint16 MAX_POINTS = 100;
+
+bool HudTrail::s_batching = false;
+std::unique_ptr<Graphics::VertexArray> HudTrail::s_lines;
+std::unique_ptr<Graphics::Material> HudTrail::s_lineMat;
 
 HudTrail::HudTrail(Body *b, const Color &c) :
 	m_body(b),
 	m_updateTime(0.f),
-	m_color(c)
+	m_color(c),
+	m_firstPoint(0),
+	m_numPoints(0)
 {
 	m_currentFrame = b->GetFrame();
-
-	Graphics::MaterialDescriptor desc;
-
-	Graphics::RenderStateDesc rsd;
-	rsd.blendMode = Graphics::BLEND_ALPHA_ONE;
-	rsd.depthWrite = false;
-	rsd.primitiveType = Graphics::LINE_STRIP;
-	m_lineMat.reset(Pi::renderer->CreateMaterial("vtxColor", desc, rsd));
 }
 
 void HudTrail::Update(float time)
@@ -41,56 +39,93 @@ void HudTrail::Update(float time)
 
 		if (!m_currentFrame) {
 			m_currentFrame = bodyFrameId;
-			m_trailPoints.clear();
+			m_numPoints = 0;
 		}
 
-		if (bodyFrameId == m_currentFrame)
-			m_trailPoints.push_back(m_body->GetInterpPosition());
+		if (bodyFrameId == m_currentFrame) {
+			// once full, the newest point replaces the oldest
+			m_trailPoints[(m_firstPoint + m_numPoints) % MAX_POINTS] = m_body->GetInterpPosition();
+			if (m_numPoints < MAX_POINTS)
+				m_numPoints++;
+			else
+				m_firstPoint = (m_firstPoint + 1) % MAX_POINTS;
+		}
 	}
-
-	while (m_trailPoints.size() > MAX_POINTS)
-		m_trailPoints.pop_front();
 }
 
 void HudTrail::Render(Graphics::Renderer *r)
 {
 	PROFILE_SCOPED();
 	//render trail
-	if (m_trailPoints.size() > 1) {
-		const vector3d vpos = m_transform * m_body->GetInterpPosition();
-		m_transform[12] = vpos.x;
-		m_transform[13] = vpos.y;
-		m_transform[14] = vpos.z;
-		m_transform[15] = 1.0;
-
-		static std::vector<vector3f> tvts;
-		static std::vector<Color> colors;
-		tvts.clear();
-		colors.clear();
-		const vector3d curpos = m_body->GetInterpPosition();
-		tvts.reserve(MAX_POINTS);
-		colors.reserve(MAX_POINTS);
-
-		tvts.push_back(vector3f(0.f));
-		colors.push_back(Color::BLANK);
+	if (m_numPoints > 1) {
+		if (!s_lines)
+			s_lines.reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE, MAX_POINTS * 2));
+
+		// from the body back along the trail, fading out; the points are in
+		// the frame of the body, m_transform takes them to the camera
+		vector3f last(m_transform * m_body->GetInterpPosition());
+		Color lastColor = Color::BLANK;
 		float alpha = 1.f;
-		const float decrement = 1.f / m_trailPoints.size();
-		const Color tcolor = m_color;
-		for (size_t i = m_trailPoints.size() - 1; i > 0; i--) {
-			tvts.push_back(-vector3f(curpos - m_trailPoints[i]));
+		const float decrement = 1.f / m_numPoints;
+		for (Uint16 i = m_numPoints - 1; i > 0; i--) {
+			const vector3f pos(m_transform * m_trailPoints[(m_firstPoint + i) % MAX_POINTS]);
 			alpha -= decrement;
-			colors.push_back(tcolor);
-			colors.back().a = Uint8(alpha * 255);
+			Color color = m_color;
+			color.a = Uint8(alpha * 255);
+
+			// separate segments, so that all trails can share one draw
+			s_lines->Add(last, lastColor);
+			s_lines->Add(pos, color);
+			last = pos;
+			lastColor = color;
 		}
 
-		r->SetTransform(matrix4x4f(m_transform));
-		m_lines.SetData(tvts.size(), &tvts[0], &colors[0]);
-		m_lines.Draw(r, m_lineMat.get());
+		if (!s_batching)
+			Flush(r);
 	}
 }
 
 void HudTrail::Reset(FrameId newFrame)
 {
 	m_currentFrame = newFrame;
-	m_trailPoints.clear();
+	m_numPoints = 0;
+}
+
+void HudTrail::BeginBatch()
+{
+	s_batching = true;
+	if (s_lines)
+		s_lines->Clear();
+}
+
+void HudTrail::EndBatch(Graphics::Renderer *r)
+{
+	s_batching = false;
+	Flush(r);
+}
+
+void HudTrail::Flush(Graphics::Renderer *r)
+{
+	if (!s_lines || s_lines->IsEmpty())
+		return;
+
+	if (!s_lineMat) {
+		Graphics::MaterialDescriptor desc;
+
+		Graphics::RenderStateDesc rsd;
+		rsd.blendMode = Graphics::BLEND_ALPHA_ONE;
+		rsd.depthWrite = false;
+		rsd.primitiveType = Graphics::LINE_SINGLE;
+		s_lineMat.reset(r->CreateMaterial("vtxColor", desc, rsd));
+	}
+
+	r->SetTransform(matrix4x4f::Identity());
+	r->DrawBuffer(s_lines.get(), s_lineMat.get());
+	s_lines->Clear();
+}
+
+void HudTrail::FreeMaterial()
+{
+	s_lineMat.reset();
+	s_lines.reset();
 }
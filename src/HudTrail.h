@@ -6,14 +6,16 @@
 
 #include "Color.h"
 #include "FrameId.h"
-#include "graphics/Drawables.h"
+#include "graphics/Material.h"
 #include "matrix4x4.h"
 
-#include <deque>
+#include <array>
+#include <memory>
 // trail drawn after an object to track motion
 
 namespace Graphics {
 	class Renderer;
+	class VertexArray;
 } // namespace Graphics
 
 class Body;
@@ -29,15 +31,31 @@ public:
 	void SetColor(const Color &c) { m_color = c; }
 	void SetTransform(const matrix4x4d &t) { m_transform = t; }
 
+	// Between BeginBatch and EndBatch trails are written into one shared
+	// array of camera space line segments instead of drawn, EndBatch draws
+	// them all at once
+	static void BeginBatch();
+	static void EndBatch(Graphics::Renderer *r);
+	static void FreeMaterial();
+
+	static const Uint16 MAX_POINTS = 100;
+
 private:
+	static void Flush(Graphics::Renderer *r);
+
 	Body *m_body;
 	FrameId m_currentFrame;
 	float m_updateTime;
 	Color m_color;
 	matrix4x4d m_transform;
-	std::deque<vector3d> m_trailPoints;
-	std::unique_ptr<Graphics::Material> m_lineMat;
-	Graphics::Drawables::Lines m_lines;
+	// the last m_numPoints positions, oldest first from m_firstPoint
+	std::array<vector3d, MAX_POINTS> m_trailPoints;
+	Uint16 m_firstPoint;
+	Uint16 m_numPoints;
+
+	static bool s_batching;
+	static std::unique_ptr<Graphics::VertexArray> s_lines;
+	static std::unique_ptr<Graphics::Material> s_lineMat;
 };
 
 #endif
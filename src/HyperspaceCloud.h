@@ -5,6 +5,7 @@
 #define _HYPERSPACECLOUD_H
 
 #include "Body.h"
+#include "BodyPool.h"
 
 class Frame;
 class Ship;
@@ -18,6 +19,7 @@ namespace Graphics {
 class HyperspaceCloud : public Body {
 public:
 	OBJDEF(HyperspaceCloud, Body, HYPERSPACECLOUD);
+	POOLED_BODY(HyperspaceCloud, HYPERSPACECLOUD);
 	HyperspaceCloud() = delete;
 	HyperspaceCloud(Ship *, double dateDue, bool isArrival);
 	HyperspaceCloud(const Json &jsonObj, Space *space);
@@ -614,6 +614,15 @@ void Manager::RebuildInputFrames()
 			m_modifiers.emplace(chord->modifier2, GetBindingState(chord->modifier2));
 	}
 
+	// Rebuild the dispatch tables of events to the bindings they may match.
+	m_modifiersBySource.clear();
+	for (auto &pair : m_modifiers)
+		m_modifiersBySource[pair.first.SourceId()].push_back(&pair);
+
+	m_chordsBySource.clear();
+	for (auto *chord : m_chords)
+		m_chordsBySource[chord->activator.SourceId()].push_back(chord);
+
 	m_frameListChanged = false;
 }
 
@@ -734,17 +743,29 @@ void Manager::HandleSDLEvent(SDL_Event &event)
 	if (!m_enableBindings)
 		return;
 
+	// Axis motion and the like can't match any key binding
+	const uint64_t source = KeyBinding::SourceId(event);
+	if (!source)
+		return;
+
 	// Update the modifier status from this event
-	for (auto &pair : m_modifiers) {
-		auto r = pair.first.Matches(event);
-		if (r != Response::Ignored) {
-			pair.second = r == Response::Pressed ? true : false;
+	auto modifiers = m_modifiersBySource.find(source);
+	if (modifiers != m_modifiersBySource.end()) {
+		for (auto *pair : modifiers->second) {
+			auto r = pair->first.Matches(event);
+			if (r != Response::Ignored) {
+				pair->second = r == Response::Pressed ? true : false;
+			}
 		}
 	}
 
+	auto chords = m_chordsBySource.find(source);
+	if (chords == m_chordsBySource.end())
+		return;
+
 	// If the event matches one of the key chords we care about, update that chord
 	int num_keys_in_chord = 0;
-	for (auto *chord : m_chords) {
+	for (auto *chord : chords->second) {
 		Response activator = chord->activator.Matches(event);
 		if (activator == Response::Ignored)
 			continue;
@@ -12,6 +12,7 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <unordered_map>
 
 class IniConfig;
 
@@ -262,6 +263,12 @@ private:
 
 	std::map<InputBindings::KeyBinding, bool> m_modifiers;
 	std::vector<InputBindings::KeyChord *> m_chords;
+
+	// m_modifiers and m_chords by the source of their key, so an event only
+	// visits the bindings it may match; the chords keep the order of m_chords
+	typedef std::pair<const InputBindings::KeyBinding, bool> ModifierState;
+	std::unordered_map<uint64_t, std::vector<ModifierState *>> m_modifiersBySource;
+	std::unordered_map<uint64_t, std::vector<InputBindings::KeyChord *>> m_chordsBySource;
 };
 
 #endif
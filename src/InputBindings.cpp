@@ -72,6 +72,47 @@ Response KeyBinding::Matches(const SDL_Event &ev) const
 	return Response::Ignored;
 }
 
+static uint64_t make_source_id(KeyBinding::Type type, uint64_t device, uint64_t code)
+{
+	return (uint64_t(type) << 56) | (device << 32) | code;
+}
+
+uint64_t KeyBinding::SourceId() const
+{
+	switch (type) {
+	case Type::KeyboardKey:
+		return make_source_id(type, 0, uint32_t(keycode));
+	case Type::JoystickButton:
+		return make_source_id(type, joystick.id, joystick.button);
+	case Type::JoystickHat:
+		return make_source_id(type, joystick.id, joystick.hat);
+	case Type::MouseButton:
+		return make_source_id(type, 0, mouse.button);
+	default:
+		return 0;
+	}
+}
+
+// the source of the bindings an event may match, as Matches checks them
+uint64_t KeyBinding::SourceId(const SDL_Event &ev)
+{
+	switch (ev.type) {
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		return make_source_id(Type::KeyboardKey, 0, uint32_t(ev.key.keysym.sym));
+	case SDL_JOYBUTTONDOWN:
+	case SDL_JOYBUTTONUP:
+		return make_source_id(Type::JoystickButton, uint16_t(Input::JoystickFromID(ev.jbutton.which)), ev.jbutton.button);
+	case SDL_JOYHATMOTION:
+		return make_source_id(Type::JoystickHat, uint16_t(Input::JoystickFromID(ev.jhat.which)), ev.jhat.hat);
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		return make_source_id(Type::MouseButton, 0, ev.button.button);
+	default:
+		return 0;
+	}
+}
+
 bool KeyBinding::operator==(const KeyBinding &rhs) const
 {
 	if (type != rhs.type)
@@ -78,6 +78,12 @@ namespace InputBindings {
 		bool Enabled() const { return type != Type::Disabled; }
 		Response Matches(const SDL_Event &ev) const;
 
+		// The key, button or hat the binding listens to, so bindings can be
+		// looked up by the events that may match them. Bindings to different
+		// directions of a hat share it. Zero for none.
+		uint64_t SourceId() const;
+		static uint64_t SourceId(const SDL_Event &ev);
+
 		bool operator==(const KeyBinding &rhs) const;
 		bool operator<(const KeyBinding &rhs) const;
 
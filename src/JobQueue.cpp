@@ -5,6 +5,9 @@
 #include "StringF.h"
 #include "profiler/Profiler.h"
 
+#include <algorithm>
+#include <limits>
+
 void Job::UnlinkHandle()
 {
 	Handle *handle = m_handle.load(std::memory_order_acquire);
@@ -16,6 +19,52 @@ void Job::UnlinkHandle()
 Job::~Job()
 {
 	UnlinkHandle();
+
+	if (m_statsName)
+		JobStats::OnRetired(this);
+}
+
+void Job::MarkQueued()
+{
+	// cache the name, GetJobName can't be called from the destructor
+	m_statsName = GetJobName();
+	m_queueTime = JobStats::Now();
+	JobStats::OnQueued(m_statsName);
+}
+
+bool Job::AddContinuation(Job *next)
+{
+	std::lock_guard<std::mutex> lock(m_continuationLock);
+	if (m_hasRun)
+		return false;
+
+	m_continuations.push_back(next);
+	return true;
+}
+
+std::vector<Job *> Job::TakeContinuations()
+{
+	std::lock_guard<std::mutex> lock(m_continuationLock);
+	m_hasRun = true;
+	return std::move(m_continuations);
+}
+
+bool Job::SetDependencies(std::initializer_list<Job *> dependencies)
+{
+	// hold an extra reference while adding dependencies so the job can't be
+	// released by a dependency finishing part way through
+	m_pendingDependencies.store(1, std::memory_order_relaxed);
+
+	for (Job *dep : dependencies) {
+		if (!dep)
+			continue;
+
+		m_pendingDependencies.fetch_add(1, std::memory_order_relaxed);
+		if (!dep->AddContinuation(this))
+			m_pendingDependencies.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	return ReleaseDependency();
 }
 
 //static
@@ -80,6 +129,12 @@ Job::Handle &Job::Handle::operator=(Handle &&other)
 	return *this;
 }
 
+void Job::Handle::SetPriority(Priority priority, float key)
+{
+	if (m_job && m_queue)
+		m_queue->SetPriority(m_job, priority, key);
+}
+
 Job::Handle::~Handle()
 {
 	if (m_job && m_queue) {
@@ -96,6 +151,8 @@ SyncJobQueue::~SyncJobQueue()
 	// delete any remaining jobs
 	for (Job *j : m_queue)
 		delete j;
+	for (Job *j : m_waiting)
+		delete j;
 	for (Job *j : m_finished)
 		delete j;
 }
@@ -103,24 +160,77 @@ SyncJobQueue::~SyncJobQueue()
 Job::Handle SyncJobQueue::Queue(Job *job, JobClient *client)
 {
 	Job::Handle handle(job, this, client);
-	m_queue.push_back(job);
+	job->m_queueOrder = m_nextQueueOrder++;
+	job->MarkQueued();
+	Push(job);
+
 	return handle;
 }
 
+Job::Handle SyncJobQueue::QueueAfter(Job *job, std::initializer_list<Job *> dependencies, JobClient *client)
+{
+	Job::Handle handle(job, this, client);
+	job->m_queueOrder = m_nextQueueOrder++;
+	job->MarkQueued();
+
+	if (job->SetDependencies(dependencies))
+		Push(job);
+	else
+		m_waiting.insert(job);
+
+	return handle;
+}
+
+void SyncJobQueue::Push(Job *job)
+{
+	m_queue.push_back(job);
+
+	// only sort the queue if the new job doesn't belong at the end
+	if (m_queue.size() > 1 && job->IsBefore(m_queue[m_queue.size() - 2]))
+		m_needsSort = true;
+}
+
+void SyncJobQueue::SetPriority(Job *job, Job::Priority priority, float key)
+{
+	if (job->m_priority == priority && job->m_priorityKey == key)
+		return;
+
+	job->SetPriority(priority, key);
+	m_needsSort = true;
+}
+
 // call OnFinish methods for completed jobs, and clean up
 Uint32 SyncJobQueue::FinishJobs()
+{
+	return FinishJobs(std::numeric_limits<double>::infinity());
+}
+
+Uint32 SyncJobQueue::FinishJobs(double maxMilliseconds, Uint32 maxJobs)
 {
 	PROFILE_SCOPED()
 	Uint32 finished = 0;
+	Uint32 processed = 0;
+
+	Profiler::Clock clock;
+	clock.Start();
+
+	while (!m_finished.empty() && processed < std::max(maxJobs, 1U)) {
+		if (processed > 0) {
+			clock.SoftStop();
+			if (clock.milliseconds() >= maxMilliseconds)
+				break;
+		}
+		processed++;
 
-	while (!m_finished.empty()) {
 		Job *job = m_finished.front();
 		m_finished.pop_front();
 
 		// if its already been cancelled then its taken care of, so we just forget about it
 		if (!job->cancelled) {
 			job->UnlinkHandle();
+			job->MarkFinished();
 			job->OnFinish();
+			job->MarkFinishEnded();
 			finished++;
 		}
 
@@ -135,11 +245,30 @@ void SyncJobQueue::Cancel(Job *job)
 	for (std::deque<Job *>::iterator i = m_queue.begin(); i != m_queue.end(); ++i) {
 		if (*i == job) {
 			i = m_queue.erase(i);
+
+			// don't leave dependent jobs waiting forever
+			for (Job *next : job->TakeContinuations()) {
+				if (next->ReleaseDependency()) {
+					m_waiting.erase(next);
+					Push(next);
+				}
+			}
+
 			delete job;
 			return;
 		}
 	}
 
+	// Jobs waiting on dependencies haven't run yet either, but other jobs may
+	// still hold a pointer to them, so let them pass through the queue as
+	// cancelled jobs instead.
+	if (m_waiting.count(job)) {
+		job->cancelled = true;
+		job->UnlinkHandle();
+		job->OnCancel();
+		return;
+	}
+
 	// Check the finshed list. If it's there then it can't be cancelled, because
 	// it's already finished! We remove it because the caller is saying "I don't care".
 	for (std::deque<Job *>::iterator i = m_finished.begin(); i != m_finished.end(); ++i) {
@@ -161,15 +290,38 @@ Uint32 SyncJobQueue::RunJobs(Uint32 count)
 	PROFILE_SCOPED()
 	Uint32 executed = 0;
 	assert(count >= 1);
+	if (m_needsSort) {
+		std::stable_sort(m_queue.begin(), m_queue.end(), [](const Job *a, const Job *b) { return a->IsBefore(b); });
+		m_needsSort = false;
+	}
+
 	for (Uint32 i = 0; i < count; ++i) {
 		if (m_queue.empty())
 			break;
 
 		Job *job = m_queue.front();
 		m_queue.pop_front();
-		job->OnRun();
+		if (!job->cancelled) {
+			// whoever runs a synchronous queue is counted as the main thread
+			job->MarkStarted(0);
+			job->OnRun();
+			job->MarkEnded();
+		}
 		executed++;
+
+		for (Job *next : job->TakeContinuations()) {
+			if (next->ReleaseDependency()) {
+				m_waiting.erase(next);
+				Push(next);
+			}
+		}
+
 		m_finished.push_back(job);
+
+		if (m_needsSort) {
+			std::stable_sort(m_queue.begin(), m_queue.end(), [](const Job *a, const Job *b) { return a->IsBefore(b); });
+			m_needsSort = false;
+		}
 	}
 	return executed;
 }
@@ -4,11 +4,14 @@
 #ifndef JOBQUEUE_H
 #define JOBQUEUE_H
 
+#include "JobStats.h"
 #include "SDL_thread.h"
 #include "core/TaskGraph.h"
 #include <atomic>
 #include <cassert>
 #include <deque>
+#include <initializer_list>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
@@ -30,8 +33,28 @@ class JobQueue;
 // OnCancel: optional. called from the main thread to tell the job that its
 //           results are not wanted. it should arrange for OnRun to return
 //           as quickly as possible. OnFinish will not be called for the job
+//
+// Queued jobs are run in order of priority class, then by ascending priority
+// key within a class (e.g. distance to the camera), then in the order they
+// were queued. The priority of a job can be changed while it is still queued
+// via Job::Handle::SetPriority.
+//
+// A job can be queued to run after one or more other jobs with
+// JobQueue::QueueAfter. The dependent job is released onto the queue by the
+// worker thread that runs its last outstanding dependency, without waiting
+// for the dependencies' OnFinish to be called on the main thread.
+//
+// Queue wait, run and finish latencies are recorded for every job, grouped
+// by GetJobName(); see JobStats.
 class Job {
 public:
+	enum Priority : Uint8 {
+		PRIORITY_HIGH = 0,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		PRIORITY_MAX
+	};
+
 	// This is the RAII handle for a queued Job. A job is cancelled when the
 	// Job::Handle is destroyed. There is at most one Job::Handle for each Job
 	// (non-queued Jobs have no handle). Job::Handle is not copyable only
@@ -53,6 +76,9 @@ public:
 		bool HasJob() const { return m_job != nullptr; }
 		Job *GetJob() const { return m_job; }
 
+		// Change the priority of the job if it has not yet started running.
+		void SetPriority(Priority priority, float key = 0.0f);
+
 		bool operator<(const Handle &other) const { return m_id < other.m_id; }
 
 	private:
@@ -75,7 +101,19 @@ public:
 public:
 	Job() :
 		cancelled(false),
-		m_handle(nullptr) {}
+		m_handle(nullptr),
+		m_priority(PRIORITY_NORMAL),
+		m_priorityKey(0.0f),
+		m_queueOrder(0),
+		m_pendingDependencies(0),
+		m_hasRun(false),
+		m_statsName(nullptr),
+		m_threadNum(0),
+		m_queueTime(0),
+		m_startTime(0),
+		m_endTime(0),
+		m_finishTime(0),
+		m_finishEndTime(0) {}
 	virtual ~Job();
 
 	Job(const Job &) = delete;
@@ -85,10 +123,36 @@ public:
 	virtual void OnFinish() = 0;
 	virtual void OnCancel() {}
 
+	// Name used to group the statistics of jobs of this type. Must return a
+	// string with static storage duration.
+	virtual const char *GetJobName() const { return "Job"; }
+
+	// Set the initial priority of the job. Call this before queuing the job;
+	// use Job::Handle::SetPriority to change the priority of a queued job.
+	void SetPriority(Priority priority, float key = 0.0f)
+	{
+		m_priority = priority;
+		m_priorityKey = key;
+	}
+
+	Priority GetPriority() const { return m_priority; }
+	float GetPriorityKey() const { return m_priorityKey; }
+
+	// returns true if this job should run before the other job
+	bool IsBefore(const Job *other) const
+	{
+		if (m_priority != other->m_priority)
+			return m_priority < other->m_priority;
+		if (m_priorityKey != other->m_priorityKey)
+			return m_priorityKey < other->m_priorityKey;
+		return m_queueOrder < other->m_queueOrder;
+	}
+
 private:
 	friend class AsyncJobQueue;
 	friend class SyncJobQueue;
 	friend class JobRunner;
+	friend class JobStats;
 
 	// TaskGraph stuff
 	friend class TaskGraph;
@@ -99,8 +163,49 @@ private:
 	void SetHandle(Handle *handle) { m_handle.store(handle, std::memory_order_release); }
 	void ClearHandle() { m_handle = nullptr; }
 
+	// Register a job to be released when this job has run. Returns false if
+	// this job has already run, in which case the dependency is satisfied.
+	bool AddContinuation(Job *next);
+	// Mark this job as having run and return the jobs waiting on it.
+	std::vector<Job *> TakeContinuations();
+	// Returns true when the last outstanding dependency has been released.
+	bool ReleaseDependency() { return m_pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+	// Add the given jobs as dependencies; returns true if the job is ready to run.
+	bool SetDependencies(std::initializer_list<Job *> dependencies);
+
+	// JobStats timestamps, called by the owning queue
+	void MarkQueued();
+	void MarkStarted(Uint32 threadNum)
+	{
+		m_threadNum = threadNum;
+		m_startTime = JobStats::Now();
+	}
+	void MarkEnded() { m_endTime = JobStats::Now(); }
+	void MarkFinished() { m_finishTime = JobStats::Now(); }
+	void MarkFinishEnded() { m_finishEndTime = JobStats::Now(); }
+
 	std::atomic<bool> cancelled;
 	std::atomic<Handle *> m_handle;
+
+	// only modified by the owning queue (or before the job is queued)
+	Priority m_priority;
+	float m_priorityKey;
+	Uint64 m_queueOrder;
+
+	// dependency tracking for QueueAfter
+	std::atomic<uint32_t> m_pendingDependencies;
+	std::mutex m_continuationLock;
+	std::vector<Job *> m_continuations;
+	bool m_hasRun;
+
+	// latency tracking, see JobStats
+	const char *m_statsName;
+	Uint32 m_threadNum;
+	Uint64 m_queueTime;
+	Uint64 m_startTime;
+	Uint64 m_endTime;
+	Uint64 m_finishTime;
+	Uint64 m_finishEndTime;
 };
 
 // the queue management class. create one from the main thread, and feed your
@@ -116,16 +221,33 @@ public:
 	// allocated with new. the queue will delete it once its its completed
 	virtual Job::Handle Queue(Job *job, JobClient *client = nullptr) = 0;
 
+	// Call from the main thread to add a job that will only run once all of
+	// the given jobs have run. Dependencies must be jobs owned by live
+	// handles (see Job::Handle::GetJob); null entries are ignored.
+	// Dependent jobs are still run if a dependency was cancelled.
+	virtual Job::Handle QueueAfter(Job *job, std::initializer_list<Job *> dependencies, JobClient *client = nullptr) = 0;
+
 	// Call from the main thread to cancel a job.
 	// The job will not be run if it is not already executing, and OnFinished
 	// will not be called for the job. OnCancel will be called for the job
 	// when it is eventually processed in a FinishJobs() call
 	virtual void Cancel(Job *job) = 0;
 
+	// Call from the main thread to change the priority of a queued job.
+	// Has no effect if the job is already running or has finished.
+	virtual void SetPriority(Job *job, Job::Priority priority, float key) = 0;
+
 	// call from the main loop. this will call OnFinish for any finished jobs,
 	// and then delete all finished and cancelled jobs. returns the number of
 	// finished jobs (not cancelled)
 	virtual Uint32 FinishJobs() = 0;
+
+	// Budgeted variant of FinishJobs: stops once either maxMilliseconds have
+	// been spent or maxJobs jobs have been processed, leaving the remaining
+	// jobs for the next call. Jobs are processed oldest first, so no job
+	// (or job client) can be starved by a flood of newer results. At least
+	// one job is always processed if any are waiting.
+	virtual Uint32 FinishJobs(double maxMilliseconds, Uint32 maxJobs = UINT32_MAX) = 0;
 };
 
 class SyncJobQueue : public JobQueue {
@@ -134,20 +256,30 @@ public:
 	virtual ~SyncJobQueue();
 
 	virtual Job::Handle Queue(Job *job, JobClient *client = nullptr) override;
+	virtual Job::Handle QueueAfter(Job *job, std::initializer_list<Job *> dependencies, JobClient *client = nullptr) override;
 	virtual void Cancel(Job *job) override;
+	virtual void SetPriority(Job *job, Job::Priority priority, float key) override;
 	virtual Uint32 FinishJobs() override;
+	virtual Uint32 FinishJobs(double maxMilliseconds, Uint32 maxJobs = UINT32_MAX) override;
 
 	Uint32 RunJobs(Uint32 count = 1);
 
 private:
+	void Push(Job *job);
+
 	std::deque<Job *> m_queue;
 	std::deque<Job *> m_finished;
+	// jobs waiting on dependencies; released into m_queue by RunJobs
+	std::set<Job *> m_waiting;
+	Uint64 m_nextQueueOrder = 0;
+	bool m_needsSort = false;
 };
 
 // JobClient is an abstraction to allow transparent management of job handles
 class JobClient {
 public:
 	virtual void Order(Job *job) = 0;
+	virtual void OrderAfter(Job *job, std::initializer_list<Job *> dependencies) = 0;
 	virtual void RemoveJob(Job::Handle *handle) = 0;
 	virtual ~JobClient() {}
 };
@@ -178,6 +310,12 @@ public:
 		(void)x; // suppress unused variable warning
 		assert(x.second);
 	}
+	virtual void OrderAfter(Job *job, std::initializer_list<Job *> dependencies)
+	{
+		auto x = m_jobs.insert(m_queue->QueueAfter(job, dependencies, this));
+		(void)x; // suppress unused variable warning
+		assert(x.second);
+	}
 	virtual void RemoveJob(Job::Handle *handle) { m_jobs.erase(*handle); }
 
 	bool IsEmpty() const { return m_jobs.empty(); }
@@ -0,0 +1,204 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "JobStats.h"
+#include "JobQueue.h"
+#include "profiler/Profiler.h"
+
+#include "SDL_timer.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace {
+	struct Samples {
+		std::array<float, JobStats::MAX_SAMPLES> values;
+		size_t count = 0;
+		size_t next = 0;
+
+		void Add(float value)
+		{
+			values[next] = value;
+			next = (next + 1) % values.size();
+			count = std::min(count + 1, values.size());
+		}
+
+		void GetPercentiles(float out[JobStats::MAX_PERCENTILE]) const
+		{
+			if (!count) {
+				std::fill(out, out + JobStats::MAX_PERCENTILE, 0.0f);
+				return;
+			}
+
+			std::array<float, JobStats::MAX_SAMPLES> sorted;
+			std::copy(values.begin(), values.begin() + count, sorted.begin());
+			std::sort(sorted.begin(), sorted.begin() + count);
+
+			const float fractions[JobStats::MAX_PERCENTILE] = { 0.50f, 0.95f, 0.99f };
+			for (int i = 0; i < JobStats::MAX_PERCENTILE; i++)
+				out[i] = sorted[std::min(count - 1, size_t(fractions[i] * count))];
+		}
+	};
+
+	struct TypeStats {
+		Uint32 queueDepth = 0;
+		Uint64 numFinished = 0;
+		Samples wait;
+		Samples run;
+		Samples finish;
+		Samples total;
+	};
+
+	std::mutex s_lock;
+	std::map<std::string, TypeStats> s_types;
+
+	// OnFinish calls since the last TakeSlowFinishes, the slowest first
+	std::vector<JobStats::FinishCost> s_slowFinishes;
+	float s_finishMs = 0.0f;
+
+	// the most recently retired jobs that ran, s_nextSpan is the oldest once
+	// the timeline is full
+	std::vector<JobStats::Span> s_timeline;
+	size_t s_nextSpan = 0;
+} // namespace
+
+// static
+Uint64 JobStats::Now()
+{
+	return SDL_GetPerformanceCounter();
+}
+
+// static
+double JobStats::ToMilliseconds(Uint64 ticks)
+{
+	static const double scale = 1000.0 / double(SDL_GetPerformanceFrequency());
+	return double(ticks) * scale;
+}
+
+// static
+void JobStats::OnQueued(const char *name)
+{
+	std::lock_guard<std::mutex> lock(s_lock);
+	s_types[name].queueDepth++;
+}
+
+// static
+void JobStats::OnRetired(const Job *job)
+{
+	std::lock_guard<std::mutex> lock(s_lock);
+	const auto type = s_types.emplace(job->m_statsName, TypeStats()).first;
+	// the map's own copy of the name, which outlives the job
+	const char *name = type->first.c_str();
+	TypeStats &stats = type->second;
+	if (stats.queueDepth)
+		stats.queueDepth--;
+
+	if (job->m_startTime && job->m_endTime) {
+		const Span span = { name, job->m_threadNum, job->m_startTime, job->m_endTime, job->m_finishTime, job->m_finishEndTime };
+		if (s_timeline.size() < MAX_SPANS) {
+			s_timeline.push_back(span);
+		} else {
+			s_timeline[s_nextSpan] = span;
+			s_nextSpan = (s_nextSpan + 1) % MAX_SPANS;
+		}
+	}
+
+	// cancelled jobs never get a finish time
+	if (!job->m_finishTime)
+		return;
+
+	const Uint64 start = job->m_startTime ? job->m_startTime : job->m_queueTime;
+	const Uint64 end = job->m_endTime ? job->m_endTime : start;
+
+	stats.numFinished++;
+	stats.wait.Add(ToMilliseconds(start - job->m_queueTime));
+	stats.run.Add(ToMilliseconds(end - start));
+	stats.finish.Add(ToMilliseconds(job->m_finishTime - end));
+	stats.total.Add(ToMilliseconds(job->m_finishTime - job->m_queueTime));
+
+	if (job->m_finishEndTime) {
+		const FinishCost cost = { job->m_statsName, float(ToMilliseconds(job->m_finishEndTime - job->m_finishTime)) };
+		s_finishMs += cost.ms;
+
+		const auto slower = [](const FinishCost &a, const FinishCost &b) { return a.ms > b.ms; };
+		auto it = std::upper_bound(s_slowFinishes.begin(), s_slowFinishes.end(), cost, slower);
+		if (it != s_slowFinishes.end() || s_slowFinishes.size() < MAX_SLOW_FINISHES) {
+			s_slowFinishes.insert(it, cost);
+			if (s_slowFinishes.size() > MAX_SLOW_FINISHES)
+				s_slowFinishes.pop_back();
+		}
+	}
+
+	// a capture shows the job from being queued to finishing, with its
+	// OnRun inside
+	if (Profiler::capturing()) {
+		const Uint64 now = Now();
+		const Profiler::u64 cpuNow = Profiler::Clock::getticks();
+		const auto toClock = [&](Uint64 ticks) {
+			const std::chrono::duration<double, std::milli> ago(ToMilliseconds(now - ticks));
+			return cpuNow - std::chrono::duration_cast<std::chrono::steady_clock::duration>(ago).count();
+		};
+
+		const Profiler::u64 id = Profiler::u64(uintptr_t(job));
+		Profiler::captureevent("Jobs", name, toClock(job->m_queueTime), toClock(job->m_finishTime), id);
+		Profiler::captureevent("Jobs", "OnRun", toClock(start), toClock(end), id);
+	}
+}
+
+// static
+void JobStats::GetSummaries(std::vector<Summary> &out)
+{
+	std::lock_guard<std::mutex> lock(s_lock);
+	out.resize(s_types.size());
+
+	size_t idx = 0;
+	for (const auto &pair : s_types) {
+		Summary &summary = out[idx++];
+		summary.name = pair.first;
+		summary.queueDepth = pair.second.queueDepth;
+		summary.numFinished = pair.second.numFinished;
+		pair.second.wait.GetPercentiles(summary.waitMs);
+		pair.second.run.GetPercentiles(summary.runMs);
+		pair.second.finish.GetPercentiles(summary.finishMs);
+		pair.second.total.GetPercentiles(summary.totalMs);
+	}
+}
+
+// static
+void JobStats::Reset()
+{
+	std::lock_guard<std::mutex> lock(s_lock);
+	for (auto &pair : s_types) {
+		// jobs still in flight are still counted towards the queue depth
+		const Uint32 depth = pair.second.queueDepth;
+		pair.second = TypeStats();
+		pair.second.queueDepth = depth;
+	}
+}
+
+// static
+float JobStats::TakeSlowFinishes(std::vector<FinishCost> &out)
+{
+	std::lock_guard<std::mutex> lock(s_lock);
+	out.swap(s_slowFinishes);
+	s_slowFinishes.clear();
+
+	const float totalMs = s_finishMs;
+	s_finishMs = 0.0f;
+	return totalMs;
+}
+
+// static
+void JobStats::GetTimeline(std::vector<Span> &out, Uint64 since)
+{
+	std::lock_guard<std::mutex> lock(s_lock);
+	out.clear();
+	for (size_t idx = 0; idx < s_timeline.size(); idx++) {
+		const Span &span = s_timeline[(s_nextSpan + idx) % s_timeline.size()];
+		if (std::max(span.endTime, span.finishEndTime) >= since)
+			out.push_back(span);
+	}
+}
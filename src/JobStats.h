@@ -0,0 +1,97 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef JOBSTATS_H
+#define JOBSTATS_H
+
+#include "SDL_stdinc.h"
+
+#include <string>
+#include <vector>
+
+class Job;
+
+// Collects per-job-type latency statistics for all job queues. Jobs are
+// grouped by Job::GetJobName() and timestamped when they are queued, start
+// and end running, and have OnFinish called. Jobs that are cancelled count
+// towards the queue depth but are not included in the latency figures.
+//
+// Queue statistics are updated from the main thread only (where jobs are
+// queued and finished); the timestamps taken on worker threads are handed
+// over with the job itself.
+//
+// The most recent jobs are also kept as a timeline of where and when they
+// ran, to show how busy each worker thread is from frame to frame.
+class JobStats {
+public:
+	enum Percentile {
+		P50 = 0,
+		P95,
+		P99,
+		MAX_PERCENTILE
+	};
+
+	struct Summary {
+		std::string name;
+		// number of jobs queued but not yet finished or cancelled
+		Uint32 queueDepth;
+		// total number of jobs finished
+		Uint64 numFinished;
+		// time spent queued before starting to run
+		float waitMs[MAX_PERCENTILE];
+		// time spent in OnRun
+		float runMs[MAX_PERCENTILE];
+		// time between OnRun completing and OnFinish being called
+		float finishMs[MAX_PERCENTILE];
+		// time from being queued to OnFinish being called
+		float totalMs[MAX_PERCENTILE];
+	};
+
+	// a job's OnFinish call on the main thread
+	struct FinishCost {
+		const char *name;
+		float ms;
+	};
+
+	// a job on the timeline: OnRun on a worker thread, then OnFinish on the
+	// main thread (finishTime is zero for a job cancelled after running)
+	struct Span {
+		const char *name;
+		Uint32 threadNum;
+		Uint64 startTime;
+		Uint64 endTime;
+		Uint64 finishTime;
+		Uint64 finishEndTime;
+	};
+
+	// number of recent jobs of each type the percentiles are computed over
+	static constexpr size_t MAX_SAMPLES = 256;
+	// number of the slowest OnFinish calls kept between TakeSlowFinishes calls
+	static constexpr size_t MAX_SLOW_FINISHES = 8;
+	// number of the most recent jobs kept on the timeline
+	static constexpr size_t MAX_SPANS = 4096;
+
+	static Uint64 Now();
+	static double ToMilliseconds(Uint64 ticks);
+
+	// fill out a summary for every job type seen so far, sorted by name
+	static void GetSummaries(std::vector<Summary> &out);
+
+	static void Reset();
+
+	// take the slowest OnFinish calls since the last call, slowest first, and
+	// return the time spent in all of them
+	static float TakeSlowFinishes(std::vector<FinishCost> &out);
+
+	// copy the jobs on the timeline that were still running or finishing at
+	// the given time, in the order they were retired; the names stay valid
+	static void GetTimeline(std::vector<Span> &out, Uint64 since);
+
+private:
+	friend class Job;
+
+	static void OnQueued(const char *name);
+	static void OnRetired(const Job *job);
+};
+
+#endif
@@ -4,7 +4,8 @@
 #ifndef _JSON_H
 #define _JSON_H
 
+#include "JsonFwd.h"
+#include "core/JsonArena.h"
 #include "json/json.hpp"
-using Json = nlohmann::json;
 
 #endif
@@ -7,6 +7,13 @@
 #define _JSON_FWD_H
 
 #include "json/json_fwd.hpp"
-using Json = nlohmann::json;
+
+template <typename T>
+class JsonAllocator;
+
+// nlohmann::json, with its nodes, arrays and objects allocated through
+// JsonArena when one is in scope (see core/JsonArena.h)
+using Json = nlohmann::basic_json<std::map, std::vector, std::string, bool,
+	std::int64_t, std::uint64_t, double, JsonAllocator>;
 
 #endif
@@ -8,11 +8,17 @@
 #include "JsonUtils.h"
 #include "FileSystem.h"
 #include "base64/base64.hpp"
+#include "core/FNV1a.h"
 #include "core/GZipFormat.h"
+#include "core/LZ4Format.h"
+#include "core/TaskGraph.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
+#include <istream>
+#include <streambuf>
 
 extern "C" {
 #include "miniz/miniz.h"
@@ -42,6 +48,48 @@ namespace {
 	static const Quaterniond identityQuaterniond(1.0, 0.0, 0.0, 0.0);
 } // namespace
 
+// Feeds the parser straight from the decompressor, so a save never has its
+// compressed data, decompressed data and Json tree in memory at once. Data
+// which isn't lz4 compressed is read as it is.
+class JsonUtils::SaveDataReader::StreamBuf : public std::streambuf {
+public:
+	explicit StreamBuf(std::string_view data, bool lz4) :
+		m_consumed(0)
+	{
+		if (lz4) {
+			m_lz4.reset(new lz4::StreamDecompressor(data));
+		} else {
+			char *begin = const_cast<char *>(data.data());
+			setg(begin, begin, begin + data.size());
+		}
+	}
+
+	size_t Tell() const { return m_consumed + (gptr() - eback()); }
+
+protected:
+	int_type underflow() override
+	{
+		if (!m_lz4)
+			return traits_type::eof();
+
+		m_consumed += egptr() - eback();
+		const std::string_view block = m_lz4->Next();
+		if (block.empty()) {
+			setg(nullptr, nullptr, nullptr);
+			return traits_type::eof();
+		}
+
+		char *begin = const_cast<char *>(block.data());
+		setg(begin, begin, begin + block.size());
+		return traits_type::to_int_type(*begin);
+	}
+
+private:
+	std::unique_ptr<lz4::StreamDecompressor> m_lz4;
+	// the bytes of the blocks before the current one
+	size_t m_consumed;
+};
+
 namespace JsonUtils {
 	Json LoadJson(RefCountedPtr<FileSystem::FileData> fd)
 	{
@@ -50,7 +98,7 @@ namespace JsonUtils {
 		Json out;
 
 		try {
-			out = Json::parse(std::string(fd->GetData(), fd->GetSize()));
+			out = Json::parse(fd->GetData(), fd->GetData() + fd->GetSize());
 		} catch (Json::parse_error &e) {
 			Output("error in JSON file '%s': %s\n", fd->GetInfo().GetPath().c_str(), e.what());
 			return nullptr;
@@ -76,32 +124,257 @@ namespace JsonUtils {
 		return out;
 	}
 
+	static const char DATA_CACHE_DIR[] = "data_cache";
+	static const int DATA_CACHE_VERSION = 1;
+
+	uint64_t DataFileStamp(const std::string &filename)
+	{
+		std::vector<FileSystem::FileInfo> files;
+		files.push_back(FileSystem::gameDataFiles.Lookup(filename));
+		for (const FileSystem::FileInfo &info : FileSystem::gameDataFiles.LookupAll(filename + ".patch"))
+			files.push_back(info);
+
+		uint64_t stamp = hash_64_fnv1a(filename.data(), filename.size());
+		for (const FileSystem::FileInfo &info : files) {
+			const std::string path = info.GetAbsolutePath();
+			const int64_t mtime = (info.GetModificationTime() - Time::DateTime()).GetTotalMicroseconds();
+			stamp = stamp * 31 + hash_64_fnv1a(path.data(), path.size());
+			stamp = stamp * 31 + uint64_t(mtime);
+		}
+		return stamp;
+	}
+
+	static Json LoadDataCache(const std::string &path, uint64_t stamp, size_t numFiles)
+	{
+		RefCountedPtr<FileSystem::FileData> file = FileSystem::userFiles.ReadFile(path);
+		if (!file)
+			return Json();
+
+		try {
+			const unsigned char *data = reinterpret_cast<const unsigned char *>(file->GetData());
+			Json cache = Json::from_cbor(data, data + file->GetSize());
+			if (cache.value("version", 0) != DATA_CACHE_VERSION || cache.value("stamp", uint64_t(0)) != stamp)
+				return Json();
+			Json &files = cache["files"];
+			if (!files.is_array() || files.size() != numFiles)
+				return Json();
+			return std::move(files);
+		} catch (Json::exception &) {
+			return Json();
+		}
+	}
+
+	// a failure only means the files get parsed again next time
+	static void WriteDataCache(const std::string &path, uint64_t stamp, const std::vector<Json> &files)
+	{
+		Json cache = Json::object();
+		cache["version"] = DATA_CACHE_VERSION;
+		cache["stamp"] = stamp;
+		cache["files"] = files;
+		const std::vector<uint8_t> cbor = Json::to_cbor(cache);
+
+		FileSystem::userFiles.MakeDirectory(DATA_CACHE_DIR);
+		const std::string tempPath = path + ".tmp";
+		FILE *f = FileSystem::userFiles.OpenWriteStream(tempPath);
+		if (!f)
+			return;
+		const bool written = fwrite(cbor.data(), cbor.size(), 1, f) == 1;
+		if (fclose(f) != 0 || !written || !FileSystem::userFiles.RenameFile(tempPath, path)) {
+			Output("couldn't write the data cache '%s'\n", path.c_str());
+			FileSystem::userFiles.RemoveFile(tempPath);
+		}
+	}
+
+	std::vector<Json> LoadJsonDataFiles(const std::vector<std::string> &filenames, const std::string &cacheName, TaskGraph *taskGraph)
+	{
+		PROFILE_SCOPED()
+		std::string cachePath;
+		uint64_t stamp = hash_64_fnv1a(cacheName.data(), cacheName.size());
+		if (!cacheName.empty()) {
+			for (const std::string &filename : filenames)
+				stamp = stamp * 31 + DataFileStamp(filename);
+
+			cachePath = FileSystem::JoinPath(DATA_CACHE_DIR, FileSystem::SanitiseFileName(cacheName) + ".cbor");
+			Json cached = LoadDataCache(cachePath, stamp, filenames.size());
+			if (!cached.is_null()) {
+				std::vector<Json> out;
+				out.reserve(cached.size());
+				for (Json &data : cached)
+					out.push_back(std::move(data));
+				return out;
+			}
+		}
+
+		std::vector<Json> out(filenames.size());
+		auto load = [&filenames, &out](TaskRange range) {
+			for (uint32_t i = range.begin; i < range.end; i++)
+				out[i] = LoadJsonDataFile(filenames[i]);
+		};
+
+		if (taskGraph && filenames.size() > 1) {
+			TaskSet *set = new TaskSet();
+			set->AddTaskRangeLambda({ 0, uint32_t(filenames.size()) }, 1, std::move(load));
+			TaskSet::Handle handle = taskGraph->QueueTaskSet(set);
+			taskGraph->WaitForTaskSet(handle);
+		} else {
+			load({ 0, uint32_t(filenames.size()) });
+		}
+
+		// a file that failed to load is reported by the caller, and
+		// shouldn't be remembered as missing
+		const bool complete = std::none_of(out.begin(), out.end(), [](const Json &data) { return data.is_null(); });
+		if (!cacheName.empty() && complete)
+			WriteDataCache(cachePath, stamp, out);
+
+		return out;
+	}
+
 	Json LoadJsonSaveFile(const std::string &filename, FileSystem::FileSource &source)
 	{
 		auto file = source.ReadFile(filename);
 		if (!file) return nullptr;
-		const auto file_data = std::string(file->GetData(), file->GetSize());
-		const unsigned char *dataPtr = reinterpret_cast<const unsigned char *>(&file_data[0]);
 		try {
-			std::string plain_data;
-			if (gzip::IsGZipFormat(dataPtr, file_data.size())) {
-				plain_data = gzip::DecompressDeflateOrGZip(dataPtr, file_data.size());
-			} else {
-				plain_data = file_data;
-			}
+			return ParseSaveData(file->AsStringView());
+		} catch (Json::parse_error &e) {
+			Output("error in JSON file '%s': %s\n", file->GetInfo().GetPath().c_str(), e.what());
+			return nullptr;
+		} catch (gzip::DecompressionFailedException) {
+			return nullptr;
+		} catch (const lz4::DecompressionFailedException &) {
+			return nullptr;
+		}
+	}
 
-			Json rootNode;
+	// A saved game can start with a header holding its summary: the magic,
+	// the size of the summary as 4 bytes little-endian and the summary as
+	// CBOR. The compressed game follows.
+	static const char SAVE_HEADER_MAGIC[8] = { 'P', 'I', 'O', 'N', 'S', 'A', 'V', '1' };
+	static const size_t SAVE_HEADER_SIZE = sizeof(SAVE_HEADER_MAGIC) + 4;
+	// much more than a summary needs, anything bigger is corrupt
+	static const uint32_t MAX_SAVE_SUMMARY_SIZE = 1 << 20;
+
+	// the size of the summary, or 0 if the data has no header
+	static uint32_t save_summary_size(std::string_view data)
+	{
+		if (data.size() < SAVE_HEADER_SIZE || memcmp(data.data(), SAVE_HEADER_MAGIC, sizeof(SAVE_HEADER_MAGIC)) != 0)
+			return 0;
+
+		const unsigned char *size = reinterpret_cast<const unsigned char *>(data.data()) + sizeof(SAVE_HEADER_MAGIC);
+		const uint32_t summarySize = uint32_t(size[0]) | uint32_t(size[1]) << 8 | uint32_t(size[2]) << 16 | uint32_t(size[3]) << 24;
+		if (summarySize == 0 || summarySize > MAX_SAVE_SUMMARY_SIZE)
+			throw lz4::DecompressionFailedException("corrupt saved game header");
+		return summarySize;
+	}
+
+	Json ParseSaveData(std::string_view data)
+	{
+		PROFILE_SCOPED()
+		return SaveDataReader(data).Parse();
+	}
+
+	SaveDataReader::SaveDataReader(std::string_view data) :
+		m_cbor(false)
+	{
+		if (const uint32_t summarySize = save_summary_size(data)) {
+			if (data.size() < SAVE_HEADER_SIZE + summarySize)
+				throw lz4::DecompressionFailedException("truncated saved game");
 			try {
-				// Allow loading files in JSON format as well as CBOR
-				if (plain_data[0] == '{')
-					return Json::parse(plain_data);
-				else
-					return Json::from_cbor(plain_data);
-			} catch (Json::parse_error &e) {
-				Output("error in JSON file '%s': %s\n", file->GetInfo().GetPath().c_str(), e.what());
-				return nullptr;
+				const char *summary = data.data() + SAVE_HEADER_SIZE;
+				m_summary = Json::from_cbor(summary, summary + summarySize);
+			} catch (Json::parse_error &) {
+				// only the list of saves needs it, the game itself can still load
 			}
-		} catch (gzip::DecompressionFailedException) {
+			data.remove_prefix(SAVE_HEADER_SIZE + summarySize);
+		}
+
+		// the format is told by its magic bytes, so the saves written before
+		// the switch to lz4 still load
+		const bool lz4 = data.size() >= 4 && lz4::IsLZ4Format(data.data(), data.size());
+		if (!lz4 && gzip::IsGZipFormat(reinterpret_cast<const unsigned char *>(data.data()), data.size())) {
+			m_plainData = gzip::DecompressDeflateOrGZip(reinterpret_cast<const unsigned char *>(data.data()), data.size());
+			data = m_plainData;
+		}
+
+		StreamBuf *buf = new StreamBuf(data, lz4);
+		m_buf.reset(buf);
+
+		// Allow loading files in JSON format as well as CBOR
+		m_cbor = buf->sgetc() != '{';
+	}
+
+	SaveDataReader::~SaveDataReader()
+	{
+	}
+
+	size_t SaveDataReader::Tell() const
+	{
+		return static_cast<const StreamBuf *>(m_buf.get())->Tell();
+	}
+
+	Json SaveDataReader::Parse()
+	{
+		std::istream stream(m_buf.get());
+		if (m_cbor)
+			return Json::from_cbor(stream);
+		else
+			return Json::parse(stream);
+	}
+
+	std::string EncodeSaveData(const Json &rootNode, const Json &summary)
+	{
+		PROFILE_SCOPED()
+		std::vector<uint8_t> cbor;
+		{
+			PROFILE_SCOPED_DESC("json.to_cbor");
+			cbor = Json::to_cbor(rootNode);
+		}
+
+		std::string out;
+		if (summary.is_object())
+			out = EncodeSaveHeader(summary);
+
+		// lz4 decompresses several times faster than deflate, which matters
+		// more for saves than the few percent it loses in size
+		out += lz4::CompressLZ4({ reinterpret_cast<const char *>(cbor.data()), cbor.size() }, 0);
+		return out;
+	}
+
+	std::string EncodeSaveHeader(const Json &summary)
+	{
+		const std::vector<uint8_t> summaryCbor = Json::to_cbor(summary);
+		const uint32_t size = summaryCbor.size();
+
+		std::string out(SAVE_HEADER_MAGIC, sizeof(SAVE_HEADER_MAGIC));
+		for (int i = 0; i < 4; i++)
+			out.push_back(char((size >> (i * 8)) & 0xff));
+		out.append(reinterpret_cast<const char *>(summaryCbor.data()), summaryCbor.size());
+		return out;
+	}
+
+	Json LoadSaveSummary(const std::string &filename, FileSystem::FileSourceFS &source)
+	{
+		PROFILE_SCOPED()
+		FILE *f = source.OpenReadStream(filename);
+		if (!f)
+			return nullptr;
+
+		try {
+			std::string data(SAVE_HEADER_SIZE, '\0');
+			uint32_t summarySize = 0;
+			if (fread(&data[0], SAVE_HEADER_SIZE, 1, f) == 1)
+				summarySize = save_summary_size(data);
+
+			Json summary;
+			if (summarySize) {
+				data.resize(summarySize);
+				if (fread(&data[0], summarySize, 1, f) == 1)
+					summary = Json::from_cbor(data);
+			}
+			fclose(f);
+			return summary.is_object() ? summary : Json();
+		} catch (const std::exception &) {
+			// let the full parse of the file report it
+			fclose(f);
 			return nullptr;
 		}
 	}
@@ -126,7 +399,10 @@ namespace JsonUtils {
 	}
 } // namespace JsonUtils
 
-#define USE_STRING_VERSIONS
+// Vectors and matrices are stored as arrays of numbers, which a binary save
+// keeps as they are. Zero vectors and identity matrices aren't stored at all.
+// Older saves stored them as strings of the bit patterns, which can still
+// be read.
 
 void VectorToJson(Json &jsonObj, const vector2f &vec)
 {
@@ -143,32 +419,17 @@ void VectorToJson(Json &jsonObj, const vector2d &vec)
 void VectorToJson(Json &jsonObj, const vector3f &vec)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
 	if (vec == zeroVector3f)
 		return; // don't store zero vector
-
-	char str[128];
-	Vector3fToStr(vec, str, 128);
-	jsonObj = str; // Add vector array to supplied object.
-#else
-	// Create JSON array to contain vector data.
 	jsonObj = Json::array({ vec.x, vec.y, vec.z });
-#endif
 }
 
 void VectorToJson(Json &jsonObj, const vector3d &vec)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
 	if (vec == zeroVector3d)
 		return; // don't store zero vector
-	char str[128];
-	Vector3dToStr(vec, str, 128);
-	jsonObj = str; // Add vector array to supplied object.
-#else
-	// Create JSON array to contain vector data.
 	jsonObj = Json::array({ vec.x, vec.y, vec.z });
-#endif
 }
 
 void QuaternionToJson(Json &jsonObj, const Quaternionf &quat)
@@ -192,42 +453,25 @@ void QuaternionToJson(Json &jsonObj, const Quaterniond &quat)
 void MatrixToJson(Json &jsonObj, const matrix3x3f &mat)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
 	if (!memcmp(&matrix3x3fIdentity, &mat, sizeof(matrix3x3f))) return;
-	char str[512];
-	Matrix3x3fToStr(mat, str, 512);
-	jsonObj = str;
-#else
 	jsonObj = Json::array({ mat[0], mat[1], mat[2],
 		mat[3], mat[4], mat[5],
 		mat[6], mat[7], mat[8] });
-#endif
 }
 
 void MatrixToJson(Json &jsonObj, const matrix3x3d &mat)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
 	if (!memcmp(&matrix3x3dIdentity, &mat, sizeof(matrix3x3d))) return;
-	char str[512];
-	Matrix3x3dToStr(mat, str, 512);
-	jsonObj = str;
-#else
 	jsonObj = Json::array({ mat[0], mat[1], mat[2],
 		mat[3], mat[4], mat[5],
 		mat[6], mat[7], mat[8] });
-#endif
 }
 
 void MatrixToJson(Json &jsonObj, const matrix4x4f &mat)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
 	if (!memcmp(&matrix4x4fIdentity, &mat, sizeof(matrix4x4f))) return;
-	char str[512];
-	Matrix4x4fToStr(mat, str, 512);
-	jsonObj = str;
-#else
 	jsonObj = Json::array({
 		mat[0],
 		mat[1],
@@ -246,18 +490,12 @@ void MatrixToJson(Json &jsonObj, const matrix4x4f &mat)
 		mat[14],
 		mat[15],
 	});
-#endif
 }
 
 void MatrixToJson(Json &jsonObj, const matrix4x4d &mat)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
 	if (!memcmp(&matrix4x4dIdentity, &mat, sizeof(matrix4x4d))) return;
-	char str[512];
-	Matrix4x4dToStr(mat, str, 512);
-	jsonObj = str;
-#else
 	jsonObj = Json::array({
 		mat[0],
 		mat[1],
@@ -276,7 +514,6 @@ void MatrixToJson(Json &jsonObj, const matrix4x4d &mat)
 		mat[14],
 		mat[15],
 	});
-#endif
 }
 
 void ColorToJson(Json &jsonObj, const Color3ub &col)
@@ -335,35 +572,33 @@ void JsonToVector(vector2d *pVec, const Json &jsonObj)
 void JsonToVector(vector3f *pVec, const Json &jsonObj)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
-	if (!jsonObj.is_string()) {
+	if (jsonObj.is_array()) {
+		pVec->x = jsonObj[0];
+		pVec->y = jsonObj[1];
+		pVec->z = jsonObj[2];
+	} else if (jsonObj.is_string()) {
+		// saves from before the vectors were stored as numbers
+		std::string vecStr = jsonObj;
+		StrToVector3f(vecStr.c_str(), *pVec);
+	} else {
 		*pVec = vector3f(0.0f);
-		return;
 	}
-	std::string vecStr = jsonObj;
-	StrToVector3f(vecStr.c_str(), *pVec);
-#else
-	pVec->x = jsonObj[0];
-	pVec->y = jsonObj[1];
-	pVec->z = jsonObj[2];
-#endif
 }
 
 void JsonToVector(vector3d *pVec, const Json &jsonObj)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
-	if (!jsonObj.is_string()) {
+	if (jsonObj.is_array()) {
+		pVec->x = jsonObj[0];
+		pVec->y = jsonObj[1];
+		pVec->z = jsonObj[2];
+	} else if (jsonObj.is_string()) {
+		// saves from before the vectors were stored as numbers
+		std::string vecStr = jsonObj;
+		StrToVector3d(vecStr.c_str(), *pVec);
+	} else {
 		*pVec = vector3d(0.0);
-		return;
 	}
-	std::string vecStr = jsonObj;
-	StrToVector3d(vecStr.c_str(), *pVec);
-#else
-	pVec->x = jsonObj[0];
-	pVec->y = jsonObj[1];
-	pVec->z = jsonObj[2];
-#endif
 }
 
 void JsonToQuaternion(Quaternionf *pQuat, const Json &jsonObj)
@@ -397,107 +632,103 @@ void JsonToQuaternion(Quaterniond *pQuat, const Json &jsonObj)
 void JsonToMatrix(matrix3x3f *pMat, const Json &jsonObj)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
-	if (!jsonObj.is_string()) {
+	if (jsonObj.is_array()) {
+		(*pMat)[0] = jsonObj[0];
+		(*pMat)[1] = jsonObj[1];
+		(*pMat)[2] = jsonObj[2];
+		(*pMat)[3] = jsonObj[3];
+		(*pMat)[4] = jsonObj[4];
+		(*pMat)[5] = jsonObj[5];
+		(*pMat)[6] = jsonObj[6];
+		(*pMat)[7] = jsonObj[7];
+		(*pMat)[8] = jsonObj[8];
+	} else if (jsonObj.is_string()) {
+		// saves from before the vectors were stored as numbers
+		std::string matStr = jsonObj;
+		StrToMatrix3x3f(matStr.c_str(), *pMat);
+	} else {
 		*pMat = matrix3x3fIdentity;
-		return;
 	}
-	std::string matStr = jsonObj;
-	StrToMatrix3x3f(matStr.c_str(), *pMat);
-#else
-	(*pMat)[0] = jsonObj[0];
-	(*pMat)[1] = jsonObj[1];
-	(*pMat)[2] = jsonObj[2];
-	(*pMat)[3] = jsonObj[3];
-	(*pMat)[4] = jsonObj[4];
-	(*pMat)[5] = jsonObj[5];
-	(*pMat)[6] = jsonObj[6];
-	(*pMat)[7] = jsonObj[7];
-	(*pMat)[8] = jsonObj[8];
-#endif
 }
 
 void JsonToMatrix(matrix3x3d *pMat, const Json &jsonObj)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
-	if (!jsonObj.is_string()) {
+	if (jsonObj.is_array()) {
+		(*pMat)[0] = jsonObj[0];
+		(*pMat)[1] = jsonObj[1];
+		(*pMat)[2] = jsonObj[2];
+		(*pMat)[3] = jsonObj[3];
+		(*pMat)[4] = jsonObj[4];
+		(*pMat)[5] = jsonObj[5];
+		(*pMat)[6] = jsonObj[6];
+		(*pMat)[7] = jsonObj[7];
+		(*pMat)[8] = jsonObj[8];
+	} else if (jsonObj.is_string()) {
+		// saves from before the vectors were stored as numbers
+		std::string matStr = jsonObj;
+		StrToMatrix3x3d(matStr.c_str(), *pMat);
+	} else {
 		*pMat = matrix3x3dIdentity;
-		return;
 	}
-	std::string matStr = jsonObj;
-	StrToMatrix3x3d(matStr.c_str(), *pMat);
-#else
-	(*pMat)[0] = jsonObj[0];
-	(*pMat)[1] = jsonObj[1];
-	(*pMat)[2] = jsonObj[2];
-	(*pMat)[3] = jsonObj[3];
-	(*pMat)[4] = jsonObj[4];
-	(*pMat)[5] = jsonObj[5];
-	(*pMat)[6] = jsonObj[6];
-	(*pMat)[7] = jsonObj[7];
-	(*pMat)[8] = jsonObj[8];
-#endif
 }
 
 void JsonToMatrix(matrix4x4f *pMat, const Json &jsonObj)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
-	if (!jsonObj.is_string()) {
+	if (jsonObj.is_array()) {
+		(*pMat)[0] = jsonObj[0];
+		(*pMat)[1] = jsonObj[1];
+		(*pMat)[2] = jsonObj[2];
+		(*pMat)[3] = jsonObj[3];
+		(*pMat)[4] = jsonObj[4];
+		(*pMat)[5] = jsonObj[5];
+		(*pMat)[6] = jsonObj[6];
+		(*pMat)[7] = jsonObj[7];
+		(*pMat)[8] = jsonObj[8];
+		(*pMat)[9] = jsonObj[9];
+		(*pMat)[10] = jsonObj[10];
+		(*pMat)[11] = jsonObj[11];
+		(*pMat)[12] = jsonObj[12];
+		(*pMat)[13] = jsonObj[13];
+		(*pMat)[14] = jsonObj[14];
+		(*pMat)[15] = jsonObj[15];
+	} else if (jsonObj.is_string()) {
+		// saves from before the vectors were stored as numbers
+		std::string matStr = jsonObj;
+		StrToMatrix4x4f(matStr.c_str(), *pMat);
+	} else {
 		*pMat = matrix4x4fIdentity;
-		return;
 	}
-	std::string matStr = jsonObj;
-	StrToMatrix4x4f(matStr.c_str(), *pMat);
-#else
-	(*pMat)[0] = jsonObj[0];
-	(*pMat)[1] = jsonObj[1];
-	(*pMat)[2] = jsonObj[2];
-	(*pMat)[3] = jsonObj[3];
-	(*pMat)[4] = jsonObj[4];
-	(*pMat)[5] = jsonObj[5];
-	(*pMat)[6] = jsonObj[6];
-	(*pMat)[7] = jsonObj[7];
-	(*pMat)[8] = jsonObj[8];
-	(*pMat)[9] = jsonObj[9];
-	(*pMat)[10] = jsonObj[10];
-	(*pMat)[11] = jsonObj[11];
-	(*pMat)[12] = jsonObj[12];
-	(*pMat)[13] = jsonObj[13];
-	(*pMat)[14] = jsonObj[14];
-	(*pMat)[15] = jsonObj[15];
-#endif
 }
 
 void JsonToMatrix(matrix4x4d *pMat, const Json &jsonObj)
 {
 	PROFILE_SCOPED()
-#ifdef USE_STRING_VERSIONS
-	if (!jsonObj.is_string()) {
+	if (jsonObj.is_array()) {
+		(*pMat)[0] = jsonObj[0];
+		(*pMat)[1] = jsonObj[1];
+		(*pMat)[2] = jsonObj[2];
+		(*pMat)[3] = jsonObj[3];
+		(*pMat)[4] = jsonObj[4];
+		(*pMat)[5] = jsonObj[5];
+		(*pMat)[6] = jsonObj[6];
+		(*pMat)[7] = jsonObj[7];
+		(*pMat)[8] = jsonObj[8];
+		(*pMat)[9] = jsonObj[9];
+		(*pMat)[10] = jsonObj[10];
+		(*pMat)[11] = jsonObj[11];
+		(*pMat)[12] = jsonObj[12];
+		(*pMat)[13] = jsonObj[13];
+		(*pMat)[14] = jsonObj[14];
+		(*pMat)[15] = jsonObj[15];
+	} else if (jsonObj.is_string()) {
+		// saves from before the vectors were stored as numbers
+		std::string matStr = jsonObj;
+		StrToMatrix4x4d(matStr.c_str(), *pMat);
+	} else {
 		*pMat = matrix4x4dIdentity;
-		return;
 	}
-	std::string matStr = jsonObj;
-	StrToMatrix4x4d(matStr.c_str(), *pMat);
-#else
-	(*pMat)[0] = jsonObj[0];
-	(*pMat)[1] = jsonObj[1];
-	(*pMat)[2] = jsonObj[2];
-	(*pMat)[3] = jsonObj[3];
-	(*pMat)[4] = jsonObj[4];
-	(*pMat)[5] = jsonObj[5];
-	(*pMat)[6] = jsonObj[6];
-	(*pMat)[7] = jsonObj[7];
-	(*pMat)[8] = jsonObj[8];
-	(*pMat)[9] = jsonObj[9];
-	(*pMat)[10] = jsonObj[10];
-	(*pMat)[11] = jsonObj[11];
-	(*pMat)[12] = jsonObj[12];
-	(*pMat)[13] = jsonObj[13];
-	(*pMat)[14] = jsonObj[14];
-	(*pMat)[15] = jsonObj[15];
-#endif
 }
 
 void JsonToColor(Color3ub *pCol, const Json &jsonObj)
@@ -18,8 +18,16 @@
 #include "matrix4x4.h"
 #include "vector3.h"
 
+#include <istream>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class TaskGraph;
+
 namespace FileSystem {
 	class FileSource;
+	class FileSourceFS;
 	class FileData;
 } // namespace FileSystem
 
@@ -31,8 +39,65 @@ namespace JsonUtils {
 	// Load a JSON file from the game's data sources, optionally applying all
 	// files with the the name <filename>.patch as Json Merge Patch (RFC 7386) files
 	Json LoadJsonDataFile(const std::string &filename, bool with_merge = true);
+	// Loads several data files as LoadJsonDataFile does, reading and parsing
+	// them in parallel if a task graph is given. With a cache name the
+	// patched files are kept as CBOR in the user directory and read from
+	// there on later runs, for as long as none of them changes.
+	std::vector<Json> LoadJsonDataFiles(const std::vector<std::string> &filenames, const std::string &cacheName = std::string(), TaskGraph *taskGraph = nullptr);
+	// Changes whenever the data file or any of its patches is changed,
+	// added or removed
+	uint64_t DataFileStamp(const std::string &filename);
 	// Loads an optionally-gzipped, optionally-CBOR encoded JSON file from the specified source.
 	Json LoadJsonSaveFile(const std::string &filename, FileSystem::FileSource &source);
+	// Decompresses (lz4, gzip or not at all) and parses (CBOR or JSON text)
+	// the contents of a saved game. Throws the exceptions of the
+	// decompressors and Json::parse_error.
+	Json ParseSaveData(std::string_view data);
+	// Reads a saved game as ParseSaveData does, but can hand it to a
+	// Json::sax_parse handler as it's decompressed instead of building the
+	// tree, so only a block of the decompressed data is in memory at a time.
+	// The data must outlive it. Saves from before the switch to lz4 are
+	// decompressed as a whole, and are read from memory.
+	class SaveDataReader {
+	public:
+		// Throws like ParseSaveData
+		explicit SaveDataReader(std::string_view data);
+		~SaveDataReader();
+
+		// The summary in the header, null if the save has none
+		const Json &GetSummary() const { return m_summary; }
+		// Whether the save is CBOR rather than JSON text
+		bool IsCBOR() const { return m_cbor; }
+		// How far into the decompressed data reading has got, in bytes
+		size_t Tell() const;
+
+		// Can only be called once, and with only one of the overloads
+		template <typename SAX>
+		bool Parse(SAX *sax)
+		{
+			std::istream stream(m_buf.get());
+			return Json::sax_parse(stream, sax, m_cbor ? Json::input_format_t::cbor : Json::input_format_t::json);
+		}
+		Json Parse();
+
+	private:
+		class StreamBuf;
+
+		std::unique_ptr<std::streambuf> m_buf;
+		std::string m_plainData;
+		Json m_summary;
+		bool m_cbor;
+	};
+	// Encodes a saved game as lz4-compressed CBOR, after a small header with
+	// the summary (if it's an object) shown in the list of saves.
+	// Throws lz4::CompressionFailedException.
+	std::string EncodeSaveData(const Json &rootNode, const Json &summary = Json());
+	// The header EncodeSaveData starts with, for writing the compressed game
+	// after it some other way
+	std::string EncodeSaveHeader(const Json &summary);
+	// Reads only the summary in the header of a saved game; null if the file
+	// has no header (or doesn't exist)
+	Json LoadSaveSummary(const std::string &filename, FileSystem::FileSourceFS &source);
 	// Patches a Json object with an extended Merge-Patch object
 	bool ApplyJsonPatch(Json &inObject, const Json &patch, const std::string &filename);
 } // namespace JsonUtils
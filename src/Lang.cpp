@@ -5,10 +5,12 @@
 #include "FileSystem.h"
 #include "JsonUtils.h"
 #include "StringRange.h"
+#include "core/FNV1a.h"
 #include "core/Log.h"
 #include "text/TextSupport.h"
 #include "utils.h"
 
+#include <cstring>
 #include <map>
 #include <set>
 
@@ -33,19 +35,10 @@ namespace Lang {
 		return true;
 	}
 
-	bool Resource::Load()
+	// Read the strings of a language file, later tokens replace earlier ones
+	static void parse_strings(const Json &data, const std::string &filename, std::map<std::string, std::string> &strings)
 	{
-		if (m_loaded)
-			return true;
-
-		std::string filename = "lang/" + m_name + "/" + m_langCode + ".json";
-		Json data = JsonUtils::LoadJsonDataFile(filename);
-		if (data.is_null()) {
-			Log::Warning("couldn't read language file '{}'\n", filename.c_str());
-			return false;
-		}
-
-		for (Json::iterator i = data.begin(); i != data.end(); ++i) {
+		for (Json::const_iterator i = data.begin(); i != data.end(); ++i) {
 			const std::string token = i.key();
 			if (token.empty()) {
 				Log::Info("{}: found empty token, skipping it\n", filename.c_str());
@@ -97,21 +90,199 @@ namespace Lang {
 				text = adjustedText;
 			}
 
-			m_strings[token] = text;
+			strings[token] = text;
+		}
+	}
+
+	// The compiled form of a resource, in the byte order of the machine
+	// that wrote it since it is only cached locally:
+	//   header, entries sorted by token, hash slots, the packed texts
+	// A slot holds an entry index plus one, 0 for an empty slot; a token
+	// is found by linear probing from its hash.
+	static const char CACHE_DIR[] = "lang_cache";
+	static const char COMPILED_MAGIC[8] = { 'P', 'I', 'O', 'N', 'L', 'N', 'G', '1' };
+	static const Uint32 COMPILED_VERSION = 1;
+
+	struct CompiledHeader {
+		char magic[8];
+		Uint32 version;
+		Uint32 numStrings;
+		Uint32 numSlots;
+		Uint32 textSize;
+		// identifies the files it was compiled from
+		Uint64 stamp;
+	};
+
+	struct Resource::Entry {
+		Uint32 hash;
+		Uint32 token;
+		Uint32 tokenLen;
+		Uint32 text;
+		Uint32 textLen;
+	};
+
+	static std::string compile_strings(const std::map<std::string, std::string> &strings, Uint64 stamp)
+	{
+		// at most half full, so the probes stay short
+		Uint32 numSlots = 1;
+		while (numSlots < 2 * strings.size() + 1)
+			numSlots *= 2;
+
+		std::string text;
+		std::vector<Resource::Entry> entries;
+		std::vector<Uint32> slots(numSlots, 0);
+		entries.reserve(strings.size());
+		for (const auto &it : strings) {
+			const Uint32 hash = hash_32_fnv1a(it.first.data(), it.first.size());
+			Uint32 slot = hash & (numSlots - 1);
+			while (slots[slot])
+				slot = (slot + 1) & (numSlots - 1);
+			slots[slot] = Uint32(entries.size()) + 1;
+
+			Resource::Entry entry;
+			entry.hash = hash;
+			entry.token = Uint32(text.size());
+			entry.tokenLen = Uint32(it.first.size());
+			text.append(it.first).push_back('\0');
+			entry.text = Uint32(text.size());
+			entry.textLen = Uint32(it.second.size());
+			text.append(it.second).push_back('\0');
+			entries.push_back(entry);
+		}
+
+		CompiledHeader header = {};
+		memcpy(header.magic, COMPILED_MAGIC, sizeof(COMPILED_MAGIC));
+		header.version = COMPILED_VERSION;
+		header.numStrings = Uint32(entries.size());
+		header.numSlots = numSlots;
+		header.textSize = Uint32(text.size());
+		header.stamp = stamp;
+
+		std::string out;
+		out.reserve(sizeof(header) + entries.size() * sizeof(Resource::Entry) + slots.size() * sizeof(Uint32) + text.size());
+		out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.append(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(Resource::Entry));
+		out.append(reinterpret_cast<const char *>(slots.data()), slots.size() * sizeof(Uint32));
+		out.append(text);
+		return out;
+	}
+
+	// a failure only means it gets compiled again next time
+	static void write_compiled(const std::string &path, const std::string &data)
+	{
+		FileSystem::userFiles.MakeDirectory(CACHE_DIR);
+		const std::string tempPath = path + ".tmp";
+		FILE *f = FileSystem::userFiles.OpenWriteStream(tempPath);
+		if (!f)
+			return;
+		const bool written = fwrite(data.data(), data.size(), 1, f) == 1;
+		if (fclose(f) != 0 || !written || !FileSystem::userFiles.RenameFile(tempPath, path)) {
+			Log::Warning("couldn't write the compiled language file '{}'\n", path);
+			FileSystem::userFiles.RemoveFile(tempPath);
+		}
+	}
+
+	bool Resource::Open(RefCountedPtr<FileSystem::FileData> data, Uint64 stamp)
+	{
+		if (!data || data->GetSize() < sizeof(CompiledHeader))
+			return false;
+
+		const char *base = data->GetData();
+		const CompiledHeader *header = reinterpret_cast<const CompiledHeader *>(base);
+		if (memcmp(header->magic, COMPILED_MAGIC, sizeof(COMPILED_MAGIC)) != 0 || header->version != COMPILED_VERSION || header->stamp != stamp)
+			return false;
+
+		const Uint64 indexSize = Uint64(header->numStrings) * sizeof(Entry) + Uint64(header->numSlots) * sizeof(Uint32);
+		if (sizeof(CompiledHeader) + indexSize + header->textSize != data->GetSize() ||
+			header->numSlots <= header->numStrings || (header->numSlots & (header->numSlots - 1)) != 0)
+			return false;
+
+		const Entry *entries = reinterpret_cast<const Entry *>(base + sizeof(CompiledHeader));
+		const Uint32 *slots = reinterpret_cast<const Uint32 *>(entries + header->numStrings);
+		for (Uint32 i = 0; i < header->numStrings; i++) {
+			const Entry &e = entries[i];
+			if (Uint64(e.token) + e.tokenLen >= header->textSize || Uint64(e.text) + e.textLen >= header->textSize)
+				return false;
+		}
+		for (Uint32 i = 0; i < header->numSlots; i++) {
+			if (slots[i] > header->numStrings)
+				return false;
+		}
+
+		m_data = data;
+		m_entries = entries;
+		m_slots = slots;
+		m_text = reinterpret_cast<const char *>(slots + header->numSlots);
+		m_numStrings = header->numStrings;
+		m_numSlots = header->numSlots;
+		return true;
+	}
+
+	bool Resource::Load()
+	{
+		if (m_loaded)
+			return true;
+
+		std::string filename = "lang/" + m_name + "/" + m_langCode + ".json";
+		if (!FileSystem::gameDataFiles.Lookup(filename).IsFile()) {
+			Log::Warning("couldn't read language file '{}'\n", filename.c_str());
+			return false;
+		}
+
+		const Uint64 stamp = JsonUtils::DataFileStamp(filename);
+		const std::string compiledPath = FileSystem::JoinPath(CACHE_DIR, FileSystem::SanitiseFileName(m_name + "_" + m_langCode) + ".bin");
+		if (FileSystem::userFiles.Lookup(compiledPath).IsFile() && Open(FileSystem::userFiles.MapFile(compiledPath), stamp)) {
+			m_loaded = true;
+			return true;
 		}
 
+		Json data = JsonUtils::LoadJsonDataFile(filename);
+		if (data.is_null()) {
+			Log::Warning("couldn't read language file '{}'\n", filename.c_str());
+			return false;
+		}
+
+		std::map<std::string, std::string> strings;
+		parse_strings(data, filename, strings);
+
+		const std::string compiled = compile_strings(strings, stamp);
+		write_compiled(compiledPath, compiled);
+
+		const FileSystem::FileInfo info = FileSystem::gameDataFiles.Lookup(filename);
+		FileSystem::FileDataMalloc *file = new FileSystem::FileDataMalloc(info, compiled.size());
+		memcpy(const_cast<char *>(file->GetData()), compiled.data(), compiled.size());
+		const bool opened = Open(RefCountedPtr<FileSystem::FileData>(file), stamp);
+		assert(opened);
+		(void)opened;
+
 		m_loaded = true;
 		return true;
 	}
 
-	static const std::string _empty = "";
-	const std::string &Resource::Get(std::string_view token) const
+	std::string_view Resource::Get(std::string_view token) const
 	{
-		std::map<std::string, std::string>::const_iterator i = m_strings.find(token);
-		if (i == m_strings.end()) {
-			return _empty;
+		if (!m_numSlots)
+			return std::string_view();
+
+		const Uint32 hash = hash_32_fnv1a(token.data(), token.size());
+		for (Uint32 slot = hash & (m_numSlots - 1); m_slots[slot]; slot = (slot + 1) & (m_numSlots - 1)) {
+			const Entry &entry = m_entries[m_slots[slot] - 1];
+			if (entry.hash == hash && std::string_view(m_text + entry.token, entry.tokenLen) == token)
+				return std::string_view(m_text + entry.text, entry.textLen);
 		}
-		return (*i).second;
+		return std::string_view();
+	}
+
+	std::string_view Resource::GetToken(Uint32 index) const
+	{
+		assert(index < m_numStrings);
+		return std::string_view(m_text + m_entries[index].token, m_entries[index].tokenLen);
+	}
+
+	std::string_view Resource::GetText(Uint32 index) const
+	{
+		assert(index < m_numStrings);
+		return std::string_view(m_text + m_entries[index].text, m_entries[index].textLen);
 	}
 
 	std::vector<std::string> Resource::GetAvailableLanguages(std::string_view resourceName)
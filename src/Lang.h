@@ -4,45 +4,65 @@
 #ifndef _LANG_H
 #define _LANG_H
 
-#include "IterationProxy.h"
+#include "FileSystem.h"
 #include <SDL_stdinc.h>
-#include <map>
 #include <string>
 #include <string_view>
 #include <vector>
 
 namespace Lang {
 
+	// The strings of a language file, kept in a compiled form: a hash index
+	// of the tokens and the texts packed after it. The compiled file is
+	// cached in the user directory and mapped into memory, so loading a
+	// resource that hasn't changed doesn't parse anything. Copies share it.
 	class Resource {
 	public:
-		using StringMap = std::map<std::string, std::string, std::less<>>;
-
 		Resource(std::string_view name, std::string_view langCode) :
 			m_name(name),
 			m_langCode(langCode),
-			m_loaded(false) {}
+			m_loaded(false),
+			m_entries(nullptr),
+			m_slots(nullptr),
+			m_text(nullptr),
+			m_numStrings(0),
+			m_numSlots(0) {}
 
 		std::string_view GetName() const { return m_name; }
 		std::string_view GetLangCode() const { return m_langCode; }
 
 		bool Load();
 
-		Uint32 GetNumStrings() const { return static_cast<Uint32>(m_strings.size()); }
+		Uint32 GetNumStrings() const { return m_numStrings; }
+
+		// empty if there is no such token; the text is followed by a '\0'
+		std::string_view Get(std::string_view token) const;
 
-		const std::string &Get(std::string_view token) const;
+		// the strings in the order of their tokens
+		std::string_view GetToken(Uint32 index) const;
+		std::string_view GetText(Uint32 index) const;
 
 		static std::vector<std::string> GetAvailableLanguages(std::string_view resourceName);
 
-		IterationProxy<StringMap> GetStrings() { return MakeIterationProxy(m_strings); }
-		const IterationProxy<const StringMap> GetStrings() const { return MakeIterationProxy(m_strings); }
+		// a string in the compiled table
+		struct Entry;
 
 	private:
+
+		bool Open(RefCountedPtr<FileSystem::FileData> data, Uint64 stamp);
+
 		std::string m_name;
 		std::string m_langCode;
 
 		bool m_loaded;
 
-		StringMap m_strings;
+		RefCountedPtr<FileSystem::FileData> m_data;
+		// these point into m_data
+		const Entry *m_entries;
+		const Uint32 *m_slots;
+		const char *m_text;
+		Uint32 m_numStrings;
+		Uint32 m_numSlots;
 	};
 
 // declare all strings
@@ -3,15 +3,18 @@
 
 #include "Missile.h"
 
+#include "Frame.h"
 #include "Game.h"
 #include "Lang.h"
 #include "Json.h"
+#include "MathUtil.h"
 #include "Pi.h"
 #include "Sfx.h"
 #include "Ship.h"
 #include "ShipAICmd.h"
 #include "Space.h"
 #include "collider/CollisionContact.h"
+#include "collider/CollisionSpace.h"
 #include "core/Log.h"
 #include "lua/LuaEvent.h"
 #include "ship/Propulsion.h"
@@ -29,6 +32,7 @@ Missile::Missile(const ShipType::Id &shipId, Body *owner, int power)
 		m_power = power;
 
 	m_owner = owner;
+	Pi::game->GetSpace()->WatchBody(this, m_owner);
 	m_type = &ShipType::types[shipId];
 
 	SetMass(m_type->hullMass * 1000);
@@ -96,6 +100,7 @@ void Missile::PostLoadFixup(Space *space)
 {
 	DynamicBody::PostLoadFixup(space);
 	m_owner = space->GetBodyByIndex(m_ownerIndex);
+	space->WatchBody(this, m_owner);
 	if (m_curAICmd) m_curAICmd->PostLoadFixup(space);
 }
 
@@ -114,6 +119,20 @@ void Missile::ECMAttack(int power_val)
 
 void Missile::StaticUpdate(const float timeStep)
 {
+	// Catch anything we would fly through during this step; at high speeds or
+	// time acceleration the discrete collision check can step right over it.
+	// The owner is usually the closest thing just after launch, so it is left
+	// out of the sweep rather than hiding a target further along; the
+	// missile's own geom moves with the ray, so the sweep never hits it
+	const Geom *ignore = m_owner && m_owner->IsType(ObjectType::MODELBODY) ? static_cast<ModelBody *>(m_owner)->GetGeom() : nullptr;
+	CollisionContact c;
+	Frame::GetFrame(GetFrame())->GetCollisionSpace()->SweepRay(GetPosition(), GetVelocity(), timeStep, &c, ignore);
+	if (c.userData1 && static_cast<Body *>(c.userData1) != m_owner) {
+		SetPosition(c.pos);
+		Explode();
+		return;
+	}
+
 	// Note: direct call to AI->TimeStepUpdate
 
 	if (!m_curAICmd) {
@@ -168,15 +187,23 @@ void Missile::TimeStepUpdate(const float timeStep)
 	if (!m_owner) {
 		Explode();
 	} else if (m_armed) {
-		Space::BodyNearList nearby = Pi::game->GetSpace()->GetBodiesMaybeNear(this, MISSILE_DETECTION_RADIUS);
+		const double stepDist = GetVelocity().Length() * timeStep;
+		Space::BodyNearList nearby = Pi::game->GetSpace()->GetBodiesMaybeNear(this, MISSILE_DETECTION_RADIUS + stepDist);
 		for (Body *body : nearby) {
 			if (body == this) continue;
 
 			if (body != target && !IsValidTarget(body))
 				continue;
 
+			// use the closest approach within the next step so a fast missile
+			// can't pass its target between two proximity checks
+			const vector3d relPos = body->GetPosition() - GetPosition();
+			const vector3d relVel = body->GetVelocityRelTo(GetFrame()) - GetVelocity();
+			const double relSpeedSqr = relVel.LengthSqr();
+			const double t = relSpeedSqr > 0.0 ? Clamp(-relPos.Dot(relVel) / relSpeedSqr, 0.0, double(timeStep)) : 0.0;
+
 			// Explode only when we've gotten as close as we possibly can to the target - if we start moving away then trigger an explosion immediately
-			double dist = (body->GetPosition() - GetPosition()).Length();
+			double dist = (relPos + relVel * t).Length();
 			const bool trigger = dist < MISSILE_DETECTION_RADIUS && body->GetVelocityRelTo(GetFrame()).Dot(GetVelocity()) < 0.0;
 
 			if (trigger || dist < MISSILE_TRIGGER_RADIUS) {
@@ -4,6 +4,7 @@
 #ifndef _MISSILE_H
 #define _MISSILE_H
 
+#include "BodyPool.h"
 #include "DynamicBody.h"
 #include "ShipType.h"
 
@@ -12,6 +13,7 @@ class AICommand;
 class Missile : public DynamicBody {
 public:
 	OBJDEF(Missile, DynamicBody, MISSILE);
+	POOLED_BODY(Missile, MISSILE);
 	Missile() = delete;
 	Missile(const ShipType::Id &type, Body *owner, int power = -1);
 	Missile(const Json &jsonObj, Space *space);
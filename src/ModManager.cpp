@@ -15,6 +15,9 @@ void ModManager::Init()
 
 void ModManager::Uninit()
 {
+	// the mods' sources are going away, so are the lookups cached from them
+	for (const auto &modInfo : m_loadedMods)
+		FileSystem::gameDataFiles.RemoveSource(modInfo.fs.get());
 	m_loadedMods.clear();
 }
 
@@ -30,10 +30,17 @@ public:
 			results.push_back(&cg);
 	}
 
+	// identical dynamic geometries share a tree, so each match is claimed
+	// and the next one with the same tree goes to the next geometry
 	SceneGraph::CollisionGeometry *GetCgForTree(GeomTree *t)
 	{
-		for (auto it = results.begin(); it != results.end(); ++it)
-			if ((*it)->GetGeomTree() == t) return (*it);
+		for (auto it = results.begin(); it != results.end(); ++it) {
+			if ((*it)->GetGeomTree() == t) {
+				SceneGraph::CollisionGeometry *cg = *it;
+				results.erase(it);
+				return cg;
+			}
+		}
 		return 0;
 	}
 };
@@ -131,7 +138,12 @@ void ModelBody::SetStatic(bool isStatic)
 void ModelBody::SetColliding(bool colliding)
 {
 	m_colliding = colliding;
-	if (colliding) {
+	SetGeomsEnabled(colliding);
+}
+
+void ModelBody::SetGeomsEnabled(bool enabled)
+{
+	if (enabled) {
 		m_geom->Enable();
 		for(auto &g : m_dynGeoms) {
 			g->Enable();
@@ -213,6 +225,15 @@ void ModelBody::SetOrient(const matrix3x3d &m)
 	MoveGeoms(m2, GetPosition());
 }
 
+void ModelBody::SetGeomVelocity(const vector3d &vel)
+{
+	if (m_geom)
+		m_geom->SetVelocity(vel);
+
+	for (Geom *geom : m_dynGeoms)
+		geom->SetVelocity(vel);
+}
+
 void ModelBody::SetFrame(FrameId fId)
 {
 	if (fId == GetFrame()) return;
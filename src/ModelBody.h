@@ -51,6 +51,10 @@ public:
 
 protected:
 	virtual void SaveToJson(Json &jsonObj, Space *space) override;
+	// let swept collision queries know how fast the geoms move
+	void SetGeomVelocity(const vector3d &vel);
+	// take the geoms out of collisions without changing IsColliding()
+	void SetGeomsEnabled(bool enabled);
 
 private:
 	void RebuildCollisionMesh();
@@ -2,11 +2,92 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "ModelCache.h"
+#include "core/MemoryTag.h"
+#include "graphics/VertexBuffer.h"
+#include "profiler/Profiler.h"
+#include "scenegraph/BinaryConverter.h"
 #include "scenegraph/Loader.h"
 #include "scenegraph/Model.h"
+#include "scenegraph/NodeVisitor.h"
+#include "scenegraph/StaticGeometry.h"
 
-ModelCache::ModelCache(Graphics::Renderer *r) :
-	m_renderer(r)
+#include <algorithm>
+#include <vector>
+
+// a model has to go unused for this many frames before it can be freed, so
+// a ship type that keeps coming and going isn't reloaded every time
+static constexpr uint32_t MIN_UNUSED_FRAMES = 600;
+
+namespace {
+	// Adds up the size of the vertex and index buffers of a model
+	class GeometrySizeVisitor : public SceneGraph::NodeVisitor {
+	public:
+		virtual void ApplyStaticGeometry(SceneGraph::StaticGeometry &g) override
+		{
+			for (unsigned int i = 0; i < g.GetNumMeshes(); i++) {
+				const SceneGraph::StaticGeometry::Mesh &mesh = g.GetMeshAt(i);
+				if (mesh.vertexBuffer)
+					size += size_t(mesh.vertexBuffer->GetDesc().stride) * mesh.vertexBuffer->GetDesc().numVertices;
+				if (mesh.indexBuffer)
+					size += size_t(mesh.indexBuffer->GetSize()) * (mesh.indexBuffer->GetElementSize() == Graphics::INDEX_BUFFER_16BIT ? 2 : 4);
+			}
+
+			ApplyNode(static_cast<SceneGraph::Node &>(g));
+		}
+
+		size_t size = 0;
+	};
+} // namespace
+
+static size_t model_size(SceneGraph::Model *m)
+{
+	if (!m)
+		return 0;
+
+	GeometrySizeVisitor visitor;
+	m->GetRoot()->Accept(visitor);
+	return visitor.size;
+}
+
+// Reads and decompresses a model's .sgm file
+class ModelCache::ModelReadJob : public Job {
+public:
+	ModelReadJob(const std::string &name, PendingModel *pending) :
+		m_name(name),
+		m_pending(pending),
+		m_found(false)
+	{}
+
+	virtual void OnRun() override
+	{
+		PROFILE_SCOPED()
+		m_found = SceneGraph::BinaryConverter::ReadModelData(m_name, "models", m_dir, m_data);
+	}
+
+	virtual void OnFinish() override
+	{
+		m_pending->done = true;
+		m_pending->found = m_found;
+		m_pending->dir.swap(m_dir);
+		m_pending->data.swap(m_data);
+	}
+
+	virtual const char *GetJobName() const override { return "ModelRead"; }
+
+private:
+	std::string m_name;
+	PendingModel *m_pending;
+	bool m_found;
+	std::string m_dir;
+	std::string m_data;
+};
+
+ModelCache::ModelCache(Graphics::Renderer *r, JobQueue *queue, size_t budgetBytes) :
+	m_renderer(r),
+	m_queue(queue),
+	m_budget(budgetBytes),
+	m_memoryUsed(0),
+	m_frame(0)
 {
 }
 
@@ -20,22 +101,103 @@ SceneGraph::Model *ModelCache::FindModel(const std::string &name)
 	ModelMap::iterator it = m_models.find(name);
 
 	if (it == m_models.end()) {
-		try {
-			SceneGraph::Loader loader(m_renderer);
-			SceneGraph::Model *m = loader.LoadModel(name);
-			m_models[name] = m;
-			return m;
-		} catch (SceneGraph::LoadingError &) {
-			throw ModelNotFoundException();
+		SceneGraph::Model *m = LoadModel(name);
+		const size_t size = model_size(m);
+		m_models[name] = { m, size, m_frame, false };
+		m_memoryUsed += size;
+		MemoryTag::Allocate(MemoryTag::MODELS, size);
+		return m;
+	}
+
+	it->second.lastUsed = m_frame;
+	return it->second.model;
+}
+
+SceneGraph::Model *ModelCache::LoadModel(const std::string &name)
+{
+	PROFILE_SCOPED()
+	// the textures a model loads are counted with it
+	MemoryTag::Scope memoryScope(MemoryTag::MODELS);
+	auto pending = m_pending.find(name);
+	if (pending != m_pending.end()) {
+		// cancels the read if it hasn't finished; it's quicker to read the
+		// file again than to wait for the worker to get to it
+		std::unique_ptr<PendingModel> load = std::move(pending->second);
+		m_pending.erase(pending);
+
+		if (load->done && load->found) {
+			SceneGraph::BinaryConverter bc(m_renderer);
+			SceneGraph::Model *m = bc.LoadFromData(name, load->dir, load->data);
+			if (m)
+				return m;
 		}
 	}
-	return it->second;
+
+	try {
+		SceneGraph::Loader loader(m_renderer);
+		return loader.LoadModel(name);
+	} catch (SceneGraph::LoadingError &) {
+		throw ModelNotFoundException();
+	}
+}
+
+void ModelCache::RequestModel(const std::string &name)
+{
+	if (!m_queue || m_models.count(name) || m_pending.count(name))
+		return;
+
+	std::unique_ptr<PendingModel> &pending = m_pending[name];
+	pending.reset(new PendingModel());
+	pending->job = m_queue->Queue(new ModelReadJob(name, pending.get()));
+}
+
+void ModelCache::PinModel(const SceneGraph::Model *model)
+{
+	for (auto &entry : m_models) {
+		if (entry.second.model == model)
+			entry.second.pinned = true;
+	}
+}
+
+void ModelCache::Update()
+{
+	m_frame++;
+	if (!m_budget || m_memoryUsed <= m_budget)
+		return;
+
+	PROFILE_SCOPED()
+	// free the models nothing is using, least recently looked up first
+	std::vector<ModelMap::iterator> unused;
+	for (ModelMap::iterator it = m_models.begin(); it != m_models.end(); ++it) {
+		const CachedModel &entry = it->second;
+		if (!entry.pinned && entry.model && entry.model->GetNumInstances() == 0 && m_frame - entry.lastUsed >= MIN_UNUSED_FRAMES)
+			unused.push_back(it);
+	}
+
+	std::sort(unused.begin(), unused.end(), [](const ModelMap::iterator &a, const ModelMap::iterator &b) {
+		return a->second.lastUsed < b->second.lastUsed;
+	});
+
+	for (ModelMap::iterator it : unused) {
+		if (m_memoryUsed <= m_budget)
+			break;
+
+		m_memoryUsed -= it->second.size;
+		MemoryTag::Free(MemoryTag::MODELS, it->second.size);
+		delete it->second.model;
+		m_models.erase(it);
+	}
 }
 
 void ModelCache::Flush()
 {
+	// destroying the handles cancels the reads still in flight
+	m_pending.clear();
+
 	for (ModelMap::iterator it = m_models.begin(); it != m_models.end(); ++it) {
-		delete it->second;
+		delete it->second.model;
 	}
+	MemoryTag::Free(MemoryTag::MODELS, m_memoryUsed);
 	m_models.clear();
+	m_memoryUsed = 0;
 }
@@ -4,12 +4,26 @@
 #ifndef _MODELCACHE_H
 #define _MODELCACHE_H
 /*
- * This class is a quick thoughtless hack
- * Also it only deals in New Models
+ * Loads models by name and keeps them around to make instances of.
+ * It only deals in New Models
+ *
+ * A model that will be needed soon can be requested ahead of time: its
+ * file is then read and decompressed on a worker thread, and FindModel
+ * only has to build the scene graph from it.
+ *
+ * When the models take up more memory than the budget, the ones that
+ * haven't been looked up for the longest time are freed, as long as they
+ * have no live instances. Anything that keeps the model returned by
+ * FindModel instead of making an instance of it must pin it.
  */
 
+#include "JobQueue.h"
+
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <stdexcept>
+#include <string>
 
 namespace Graphics {
 	class Renderer;
@@ -24,15 +38,56 @@ public:
 		ModelNotFoundException() :
 			std::runtime_error("Could not find model") {}
 	};
-	ModelCache(Graphics::Renderer *);
+	// Without a queue models are always loaded on the main thread; a budget
+	// of 0 never frees anything
+	ModelCache(Graphics::Renderer *, JobQueue *queue = nullptr, size_t budgetBytes = 0);
 	~ModelCache();
 	SceneGraph::Model *FindModel(const std::string &);
 	void Flush();
 
+	// Start reading a model in the background, if it isn't loaded yet
+	void RequestModel(const std::string &);
+	// Never free this model
+	void PinModel(const SceneGraph::Model *);
+
+	// Free the models over the budget; call once per frame, while nothing
+	// is holding on to an unpinned model outside of the cache
+	void Update();
+
+	size_t GetNumModels() const { return m_models.size(); }
+	size_t GetNumPending() const { return m_pending.size(); }
+	size_t GetMemoryUsed() const { return m_memoryUsed; }
+
 private:
-	typedef std::map<std::string, SceneGraph::Model *> ModelMap;
+	struct CachedModel {
+		SceneGraph::Model *model;
+		// estimated size of the model's geometry
+		size_t size;
+		uint32_t lastUsed;
+		bool pinned;
+	};
+
+	// a model being read by a ModelReadJob
+	struct PendingModel {
+		Job::Handle job;
+		bool done = false;
+		bool found = false;
+		std::string dir;
+		std::string data;
+	};
+
+	class ModelReadJob;
+
+	SceneGraph::Model *LoadModel(const std::string &name);
+
+	typedef std::map<std::string, CachedModel> ModelMap;
 	ModelMap m_models;
+	std::map<std::string, std::unique_ptr<PendingModel>> m_pending;
 	Graphics::Renderer *m_renderer;
+	JobQueue *m_queue;
+	size_t m_budget;
+	size_t m_memoryUsed;
+	uint32_t m_frame;
 };
 
 #endif
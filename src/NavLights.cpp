@@ -19,6 +19,8 @@ static RefCountedPtr<Graphics::Texture> texHalos4x4;
 static RefCountedPtr<Graphics::Material> matHalos4x4;
 
 static bool g_initted = false;
+static bool s_batching = false;
+static std::unique_ptr<Graphics::VertexArray> s_batch;
 static vector2f m_lightColorsUVoffsets[(NavLights::NAVLIGHT_YELLOW + 1)] = {
 	vector2f(0.0f, 0.0f),
 	vector2f(0.5f, 0.0f),
@@ -87,6 +89,8 @@ void NavLights::Init(Graphics::Renderer *renderer)
 	matHalos4x4->SetTexture("texture0"_hash, texHalos4x4.Get());
 	matHalos4x4->SetPushConstant("coordDownScale"_hash, 0.5f);
 
+	s_batch.reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL));
+
 	g_initted = true;
 }
 
@@ -96,6 +100,7 @@ void NavLights::Uninit()
 
 	matHalos4x4.Reset();
 	texHalos4x4.Reset();
+	s_batch.reset();
 
 	g_initted = false;
 }
@@ -104,6 +109,8 @@ NavLights::NavLights(SceneGraph::Model *model, float period) :
 	m_time(0.f),
 	m_period(period),
 	m_enabled(false),
+	m_dirty(true),
+	m_phase(-1),
 	// NB - we're (ab)using the normal type to hold (uv coordinate offset value + point size)
 	m_billboardTris(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL)
 {
@@ -173,14 +180,28 @@ void NavLights::LoadFromJson(const Json &jsonObj)
 
 		m_time = navLightsObj["time"];
 		m_enabled = navLightsObj["enabled"];
+		m_dirty = true;
 	} catch (Json::type_error &) {
 		throw SavedGameCorruptException();
 	}
 }
 
 void NavLights::Update(float time)
+{
+	if (m_enabled)
+		m_time += time;
+}
+
+void NavLights::UpdateBulbs()
 {
 	PROFILE_SCOPED();
+	// the bulbs only change eight times a period
+	const int phase = m_enabled ? int((fmod(m_time, m_period) / m_period) * 8) : -1;
+	if (!m_dirty && phase == m_phase)
+		return;
+	m_dirty = false;
+	m_phase = phase;
+
 	if (!m_enabled) {
 		for (const auto &group : m_groupLights)
 			for (const LightBulb &light : group.second)
@@ -188,9 +209,6 @@ void NavLights::Update(float time)
 		return;
 	}
 
-	m_time += time;
-
-	const int phase((fmod(m_time, m_period) / m_period) * 8);
 	const Uint8 mask = 1 << phase;
 
 	for (const auto &pair : m_groupLights) {
@@ -205,6 +223,13 @@ void NavLights::Update(float time)
 
 void NavLights::Render(Graphics::Renderer *renderer)
 {
+	if (s_batching) {
+		s_batch->position.insert(s_batch->position.end(), m_billboardTris.position.begin(), m_billboardTris.position.end());
+		s_batch->normal.insert(s_batch->normal.end(), m_billboardTris.normal.begin(), m_billboardTris.normal.end());
+		m_billboardTris.Clear();
+		return;
+	}
+
 	if (!m_billboardTris.IsEmpty()) {
 		renderer->SetTransform(matrix4x4f::Identity());
 		renderer->DrawBuffer(&m_billboardTris, matHalos4x4.Get());
@@ -214,6 +239,24 @@ void NavLights::Render(Graphics::Renderer *renderer)
 	}
 }
 
+void NavLights::BeginBatch()
+{
+	s_batching = true;
+	s_batch->Clear();
+}
+
+void NavLights::EndBatch(Graphics::Renderer *renderer)
+{
+	s_batching = false;
+	if (!s_batch->IsEmpty()) {
+		renderer->SetTransform(matrix4x4f::Identity());
+		renderer->DrawBuffer(s_batch.get(), matHalos4x4.Get());
+		renderer->GetStats().AddToStatCount(Graphics::Stats::STAT_BILLBOARD, s_batch->GetNumVerts());
+
+		s_batch->Clear();
+	}
+}
+
 void NavLights::SetColor(unsigned int group, LightColor c)
 {
 	if (!m_groupLights.count(group)) return;
@@ -223,6 +266,7 @@ void NavLights::SetColor(unsigned int group, LightColor c)
 			light.billboard->SetColorUVoffset(get_color(c));
 
 		light.color = c;
+		m_dirty = true;
 	}
 }
 
@@ -230,6 +274,7 @@ void NavLights::SetMask(unsigned int group, uint8_t mask)
 {
 	if (!m_groupLights.count(group)) return;
 	for (LightBulb &light : m_groupLights[group]) {
+		m_dirty |= (light.mask != mask);
 		light.mask = mask;
 	}
 }
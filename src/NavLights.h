@@ -41,8 +41,16 @@ public:
 	virtual void SaveToJson(Json &jsonObj);
 	virtual void LoadFromJson(const Json &jsonObj);
 
-	void SetEnabled(bool on) { m_enabled = on; }
+	void SetEnabled(bool on)
+	{
+		m_dirty |= (on != m_enabled);
+		m_enabled = on;
+	}
 	void Update(float time);
+	// Show the bulbs that are lit at this point of the period. Only needed
+	// just before the model is rendered, and only touches the bulbs when
+	// something changed since the last call.
+	void UpdateBulbs();
 	void Render(Graphics::Renderer *renderer);
 	void SetColor(unsigned int group, LightColor);
 	void SetMask(unsigned int group, uint8_t mask);
@@ -50,11 +58,19 @@ public:
 	static void Init(Graphics::Renderer *);
 	static void Uninit();
 
+	// Between BeginBatch and EndBatch the billboards of every Render are
+	// gathered, EndBatch draws them all at once
+	static void BeginBatch();
+	static void EndBatch(Graphics::Renderer *r);
+
 protected:
 	std::map<Uint32, std::vector<LightBulb>> m_groupLights;
 	float m_time;
 	float m_period;
 	bool m_enabled;
+	// the state shown by the bulbs, see UpdateBulbs
+	bool m_dirty;
+	int m_phase;
 
 	Graphics::VertexArray m_billboardTris;
 };
@@ -4,6 +4,7 @@
 #include "Orbit.h"
 
 #include "MathUtil.h"
+#include "core/TaskGraph.h"
 #include "gameconsts.h"
 
 #ifdef _MSC_VER
@@ -56,6 +57,68 @@ static double calc_velocity_area_per_sec_gravpoint(double semiMajorAxis, double
 	return M_PI * a2 * sqrt((eccentricity < 1.0) ? (1 - e2) : (e2 - 1.0)) / Orbit::OrbitalPeriodTwoBody(semiMajorAxis, totalMass, bodyMass);
 }
 
+// NR method to solve for E: M = E-e*sin(E)  {Kepler's equation}
+static const int KEPLER_ITERATIONS = 10;
+static const double KEPLER_TOLERANCE = 0.0001;
+
+static inline double kepler_step(const double E, const double M, const double e)
+{
+	return (E - e * (sin(E)) - M) / (1.0 - e * cos(E));
+}
+
+// the NR method sometimes can't find the solution, especially when e
+// approaches 1
+static double kepler_bisect(const double M, const double e)
+{
+	//failsafe to bisection method
+	//max(E - M) == 1, so safe interval is M+-1.1
+	double E = M;
+	double Emin = M - 1.1;
+	double Emax = M + 1.1;
+	double Ymin = Emin - e * sin(Emin) - M;
+	double Y;
+	for (int i = 0; i < 14; i++) { // 14 iterations for precision 0.00006
+		E = (Emin + Emax) / 2;
+		Y = E - e * sin(E) - M;
+		if ((Ymin * Y) < 0) {
+			Emax = E;
+		} else {
+			Ymin = Y;
+			Emin = E;
+		}
+	}
+	return E;
+}
+
+// eccentric anomaly of an elliptic orbit
+static double solve_kepler(const double M, const double e)
+{
+	double E = M;
+	int iter;
+	for (iter = 0; iter < KEPLER_ITERATIONS; iter++) {
+		double dE = kepler_step(E, M, e);
+		E = E - dE;
+		if (fabs(dE) < KEPLER_TOLERANCE) break;
+	}
+	if (iter == KEPLER_ITERATIONS) // most likely no solution found
+		E = kepler_bisect(M, e);
+	return E;
+}
+
+// sinh of the hyperbolic anomaly of a hyperbolic orbit
+// NR method to solve for E: M = E-sinh(E)
+// sinh E and cosh E are solved directly, because of inherent numerical instability of tanh(k arctanh x)
+static double solve_kepler_hyperbolic(const double M, const double e)
+{
+	double sh = 2.0;
+	for (int iter = 50; iter > 0; --iter) {
+		double d_sh = (M + e * sh - asinh(sh)) / (e - 1 / sqrt(1 + (sh * sh)));
+		sh = sh - d_sh;
+		if (fabs(d_sh) < 0.0001) break;
+	}
+	return sh;
+}
+
 static void calc_position_from_mean_anomaly(const double M, const double e, const double a, double &cos_v, double &sin_v, double *r)
 {
 	// M is mean anomaly
@@ -70,34 +133,7 @@ static void calc_position_from_mean_anomaly(const double M, const double e, cons
 
 	if (e < 1.0) { // elliptic orbit
 		// eccentric anomaly
-		// NR method to solve for E: M = E-e*sin(E)  {Kepler's equation}
-		double E = M;
-		int iter;
-		for (iter = 0; iter < 10; iter++) {
-			double dE = (E - e * (sin(E)) - M) / (1.0 - e * cos(E));
-			E = E - dE;
-			if (fabs(dE) < 0.0001) break;
-		}
-		// method above sometimes can't find the solution
-		// especially when e approaches 1
-		if (iter == 10) { // most likely no solution found
-			//failsafe to bisection method
-			//max(E - M) == 1, so safe interval is M+-1.1
-			double Emin = M - 1.1;
-			double Emax = M + 1.1;
-			double Ymin = Emin - e * sin(Emin) - M;
-			double Y;
-			for (int i = 0; i < 14; i++) { // 14 iterations for precision 0.00006
-				E = (Emin + Emax) / 2;
-				Y = E - e * sin(E) - M;
-				if ((Ymin * Y) < 0) {
-					Emax = E;
-				} else {
-					Ymin = Y;
-					Emin = E;
-				}
-			}
-		}
+		const double E = solve_kepler(M, e);
 
 		// true anomaly (angle of orbit position)
 		cos_v = (cos(E) - e) / (1.0 - e * cos(E));
@@ -109,16 +145,7 @@ static void calc_position_from_mean_anomaly(const double M, const double e, cons
 		}
 
 	} else { // parabolic or hyperbolic orbit
-		// eccentric anomaly
-		// NR method to solve for E: M = E-sinh(E)
-		// sinh E and cosh E are solved directly, because of inherent numerical instability of tanh(k arctanh x)
-		double sh = 2.0;
-		for (int iter = 50; iter > 0; --iter) {
-			double d_sh = (M + e * sh - asinh(sh)) / (e - 1 / sqrt(1 + (sh * sh)));
-			sh = sh - d_sh;
-			if (fabs(d_sh) < 0.0001) break;
-		}
-
+		const double sh = solve_kepler_hyperbolic(M, e);
 		double ch = sqrt(1 + sh * sh);
 
 		// true anomaly (angle of orbit position)
@@ -156,15 +183,129 @@ double Orbit::MeanAnomalyFromTrueAnomaly(double trueAnomaly) const
 }
 
 double Orbit::MeanAnomalyAtTime(double time) const
+{
+	return MeanMotion() * time + m_orbitalPhaseAtStart;
+}
+
+double Orbit::MeanMotion() const
 {
 	const double e = m_eccentricity;
 	if (e < 1.0) { // elliptic orbit
-		return 2.0 * M_PI * time / Period() + m_orbitalPhaseAtStart;
+		return 2.0 * M_PI / Period();
 	} else {
-		return -2.0 * time * m_velocityAreaPerSecond / (m_semiMajorAxis * m_semiMajorAxis * sqrt(e * e - 1)) + m_orbitalPhaseAtStart;
+		return -2.0 * m_velocityAreaPerSecond / (m_semiMajorAxis * m_semiMajorAxis * sqrt(e * e - 1));
 	}
 }
 
+// The position in the orbital plane follows from the eccentric (or
+// hyperbolic) anomaly, and so does its derivative, given how fast the mean
+// anomaly changes: M = E - e sin(E) for an ellipse, M = H - e sinh(H) for a
+// hyperbola.
+static void elliptic_state(const double E, const double e, const double a, const double n, vector3d &pos, vector3d &vel)
+{
+	const double cosE = cos(E);
+	const double sinE = sin(E);
+	const double b = a * sqrt(1.0 - e * e);
+	const double dE = n / (1.0 - e * cosE);
+	pos = vector3d(-a * (cosE - e), b * sinE, 0.0);
+	vel = vector3d(a * sinE * dE, b * cosE * dE, 0.0);
+}
+
+static void hyperbolic_state(const double sh, const double e, const double a, const double n, vector3d &pos, vector3d &vel)
+{
+	const double ch = sqrt(1 + sh * sh);
+	const double b = a * sqrt(e * e - 1.0);
+	const double dH = n / (1.0 - e * ch);
+	pos = vector3d(a * (ch - e), b * sh, 0.0);
+	vel = vector3d(a * sh * dH, b * ch * dH, 0.0);
+}
+
+void Orbit::OrbitalStateAtTime(double t, vector3d &pos, vector3d &vel) const
+{
+	if (is_zero_general(m_semiMajorAxis)) {
+		pos = m_positionForStaticBody;
+		vel = vector3d(0.0);
+		return;
+	}
+
+	const double M = MeanAnomalyAtTime(t);
+	if (m_eccentricity < 1.0)
+		elliptic_state(solve_kepler(M, m_eccentricity), m_eccentricity, m_semiMajorAxis, MeanMotion(), pos, vel);
+	else
+		hyperbolic_state(solve_kepler_hyperbolic(M, m_eccentricity), m_eccentricity, m_semiMajorAxis, MeanMotion(), pos, vel);
+	pos = m_orient * pos;
+	vel = m_orient * vel;
+}
+
+// orbits per lockstep batch, the arrays are on the stack
+static const size_t BATCH_SIZE = 64;
+// orbits per task when running on the task graph
+static const uint32_t BATCH_GRAIN = 256;
+
+void Orbit::OrbitalStatesAtTime(const Orbit *const *orbits, size_t count, double t, vector3d *pos, vector3d *vel)
+{
+	double M[BATCH_SIZE], e[BATCH_SIZE], E[BATCH_SIZE];
+	bool active[BATCH_SIZE];
+	size_t index[BATCH_SIZE];
+
+	for (size_t start = 0; start < count; start += BATCH_SIZE) {
+		const size_t end = std::min(count, start + BATCH_SIZE);
+
+		// the elliptic orbits go into the batch, the rest are solved alone
+		size_t n = 0;
+		for (size_t i = start; i < end; i++) {
+			const Orbit &o = *orbits[i];
+			if (is_zero_general(o.m_semiMajorAxis) || o.m_eccentricity >= 1.0) {
+				o.OrbitalStateAtTime(t, pos[i], vel[i]);
+				continue;
+			}
+			index[n] = i;
+			M[n] = o.MeanAnomalyAtTime(t);
+			e[n] = o.m_eccentricity;
+			E[n] = M[n];
+			active[n] = true;
+			n++;
+		}
+
+		// the same steps as solve_kepler, each orbit stops where it would
+		// have on its own so the results are the same
+		for (int iter = 0; iter < KEPLER_ITERATIONS; iter++) {
+			bool any = false;
+			for (size_t k = 0; k < n; k++) {
+				const double dE = kepler_step(E[k], M[k], e[k]);
+				E[k] = active[k] ? E[k] - dE : E[k];
+				active[k] = active[k] && !(fabs(dE) < KEPLER_TOLERANCE);
+				any |= active[k];
+			}
+			if (!any) break;
+		}
+
+		for (size_t k = 0; k < n; k++) {
+			const size_t i = index[k];
+			const Orbit &o = *orbits[i];
+			const double anomaly = active[k] ? kepler_bisect(M[k], e[k]) : E[k];
+			elliptic_state(anomaly, e[k], o.m_semiMajorAxis, o.MeanMotion(), pos[i], vel[i]);
+			pos[i] = o.m_orient * pos[i];
+			vel[i] = o.m_orient * vel[i];
+		}
+	}
+}
+
+void Orbit::OrbitalStatesAtTime(const Orbit *const *orbits, size_t count, double t, vector3d *pos, vector3d *vel, TaskGraph *taskGraph)
+{
+	if (!taskGraph || count <= BATCH_GRAIN) {
+		OrbitalStatesAtTime(orbits, count, t, pos, vel);
+		return;
+	}
+
+	TaskSet *set = new TaskSet();
+	set->AddTaskRangeLambda({ 0, uint32_t(count) }, BATCH_GRAIN, [=](TaskRange range) {
+		OrbitalStatesAtTime(orbits + range.begin, range.end - range.begin, t, pos + range.begin, vel + range.begin);
+	});
+	TaskSet::Handle handle = taskGraph->QueueTaskSet(set);
+	taskGraph->WaitForTaskSet(handle);
+}
+
 vector3d Orbit::OrbitalPosAtTime(double t) const
 {
 	if (is_zero_general(m_semiMajorAxis)) return m_positionForStaticBody;
@@ -233,9 +374,13 @@ vector3d Orbit::OrbitalVelocityAtTime(double totalMass, double t) const
 // mean anomaly <-> true anomaly conversion doesn't have
 // to be taken into account
 vector3d Orbit::EvenSpacedPosTrajectory(double t, double timeOffset) const
+{
+	return PosAtTrueAnomaly(2 * M_PI * t + TrueAnomalyAtTime(timeOffset));
+}
+
+vector3d Orbit::PosAtTrueAnomaly(double v) const
 {
 	const double e = m_eccentricity;
-	double v = 2 * M_PI * t + TrueAnomalyFromMeanAnomaly(MeanAnomalyAtTime(timeOffset));
 	double r;
 
 	if (e < 1.0) {
@@ -300,6 +445,90 @@ void Orbit::SetShapeAroundPrimary(double semiMajorAxis, double centralMass, doub
 	m_velocityAreaPerSecond = calc_velocity_area_per_sec(semiMajorAxis, centralMass, eccentricity);
 }
 
+// Stumpff functions of the universal variable z
+static void stumpff(const double z, double &C, double &S)
+{
+	if (z > 1e-6) {
+		const double sz = sqrt(z);
+		C = (1.0 - cos(sz)) / z;
+		S = (sz - sin(sz)) / (sz * z);
+	} else if (z < -1e-6) {
+		const double sz = sqrt(-z);
+		C = (cosh(sz) - 1.0) / -z;
+		S = (sinh(sz) - sz) / (sz * -z);
+	} else {
+		C = 1.0 / 2.0 - z / 24.0;
+		S = 1.0 / 6.0 - z / 120.0;
+	}
+}
+
+static const int LAMBERT_ITERATIONS = 100;
+
+// static
+bool Orbit::SolveLambert(const vector3d &r1, const vector3d &r2, double flightTime, double centralMass, const vector3d &normal, vector3d &v1, vector3d &v2)
+{
+	// universal variable formulation, as in Curtis, "Orbital Mechanics for
+	// Engineering Students", algorithm 5.2
+	const double mu = G * centralMass;
+	const double len1 = r1.Length();
+	const double len2 = r2.Length();
+	if (flightTime <= 0.0 || len1 <= 0.0 || len2 <= 0.0)
+		return false;
+
+	const double cosAngle = Clamp(r1.Dot(r2) / (len1 * len2), -1.0, 1.0);
+	double angle = acos(cosAngle);
+	if (r1.Cross(r2).Dot(normal) < 0.0)
+		angle = 2.0 * M_PI - angle;
+
+	const double A = sin(angle) * sqrt(len1 * len2 / (1.0 - cosAngle));
+	if (!std::isfinite(A) || fabs(A) < 1e-9 * (len1 + len2))
+		return false;
+
+	// y(z) and the time of flight it gives; the time grows with z wherever
+	// y is positive, and too small a z leaves y negative
+	auto y_at = [&](double z) {
+		double C, S;
+		stumpff(z, C, S);
+		return len1 + len2 + A * (z * S - 1.0) / sqrt(C);
+	};
+	auto time_at = [&](double z) {
+		double C, S;
+		stumpff(z, C, S);
+		const double y = len1 + len2 + A * (z * S - 1.0) / sqrt(C);
+		if (y <= 0.0)
+			return -1.0;
+		return (pow(y / C, 1.5) * S + A * sqrt(y)) / sqrt(mu);
+	};
+
+	// a single revolution ends at z = 4 pi^2, where the time goes to
+	// infinity; any closer and C is lost to rounding
+	double zHigh = 4.0 * M_PI * M_PI * (1.0 - 1e-6);
+	double zLow = -4.0 * M_PI * M_PI;
+	for (int i = 0; i < 32 && time_at(zLow) > flightTime; i++)
+		zLow *= 2.0;
+	if (time_at(zLow) > flightTime || !(time_at(zHigh) >= flightTime))
+		return false;
+
+	for (int i = 0; i < LAMBERT_ITERATIONS; i++) {
+		const double z = 0.5 * (zLow + zHigh);
+		if (time_at(z) < flightTime)
+			zLow = z;
+		else
+			zHigh = z;
+	}
+
+	const double y = y_at(0.5 * (zLow + zHigh));
+	if (y <= 0.0)
+		return false;
+
+	const double f = 1.0 - y / len1;
+	const double g = A * sqrt(y / mu);
+	const double gdot = 1.0 - y / len2;
+	v1 = (r2 - f * r1) / g;
+	v2 = (gdot * r2 - r1) / g;
+	return true;
+}
+
 Orbit Orbit::ForStaticBody(const vector3d &position)
 {
 	Orbit ret;
@@ -9,6 +9,9 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstddef>
+
+class TaskGraph;
 
 class Orbit {
 public:
@@ -20,6 +23,12 @@ public:
 	static Orbit FromBodyState(const vector3d &position, const vector3d &velocity, double central_mass);
 	static Orbit ForStaticBody(const vector3d &position);
 
+	// Lambert's problem: the velocities at both ends of the path from r1 to
+	// r2 that takes flightTime, going the way round that has its angular
+	// momentum along normal and less than a full revolution. Returns false
+	// if there is no such path, e.g. when r1 and r2 are (anti)parallel.
+	static bool SolveLambert(const vector3d &r1, const vector3d &r2, double flightTime, double centralMass, const vector3d &normal, vector3d &v1, vector3d &v2);
+
 	Orbit() :
 		m_eccentricity(0.0),
 		m_semiMajorAxis(0.0),
@@ -42,9 +51,19 @@ public:
 	vector3d OrbitalPosAtTime(double t) const;
 	double OrbitalTimeAtPos(const vector3d &pos, double centralMass) const;
 	vector3d OrbitalVelocityAtTime(double totalMass, double t) const;
+	// the position and velocity at time t, from a single solve of Kepler's
+	// equation; the velocity follows from the orbit's own period
+	void OrbitalStateAtTime(double t, vector3d &pos, vector3d &vel) const;
+	// OrbitalStateAtTime for many orbits at once. The elliptic orbits are
+	// solved in lockstep over arrays, which the compiler can vectorise, and
+	// split across the task graph if one is given and there are enough.
+	static void OrbitalStatesAtTime(const Orbit *const *orbits, size_t count, double t, vector3d *pos, vector3d *vel, TaskGraph *taskGraph);
 
 	// 0.0 <= t <= 1.0. Not for finding orbital pos
 	vector3d EvenSpacedPosTrajectory(double t, double timeOffset = 0) const;
+	// the position at the true anomaly v, hyperbolas are cut off short of infinity
+	vector3d PosAtTrueAnomaly(double v) const;
+	double TrueAnomalyAtTime(double time) const { return TrueAnomalyFromMeanAnomaly(MeanAnomalyAtTime(time)); }
 
 	double Period() const;
 	vector3d Apogeum() const;
@@ -60,6 +79,10 @@ private:
 	double TrueAnomalyFromMeanAnomaly(double MeanAnomaly) const;
 	double MeanAnomalyFromTrueAnomaly(double trueAnomaly) const;
 	double MeanAnomalyAtTime(double time) const;
+	// how fast the mean anomaly changes
+	double MeanMotion() const;
+
+	static void OrbitalStatesAtTime(const Orbit *const *orbits, size_t count, double t, vector3d *pos, vector3d *vel);
 
 	vector3d m_positionForStaticBody;
 	double m_eccentricity;
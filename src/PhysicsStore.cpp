@@ -0,0 +1,107 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "PhysicsStore.h"
+#include "core/TaskGraph.h"
+
+#include <cassert>
+
+// entries per task when integrating in parallel
+static const Uint32 INTEGRATE_GRAIN = 256;
+
+PhysicsStore &PhysicsStore::Get()
+{
+	static PhysicsStore s_store;
+	return s_store;
+}
+
+Uint32 PhysicsStore::Add()
+{
+	Uint32 index;
+	if (!m_free.empty()) {
+		index = m_free.back();
+		m_free.pop_back();
+	} else {
+		index = Uint32(vel.size());
+		force.emplace_back();
+		torque.emplace_back();
+		externalForce.emplace_back();
+		vel.emplace_back();
+		angVel.emplace_back();
+		angDisplacement.emplace_back();
+		lastForce.emplace_back();
+		lastTorque.emplace_back();
+		mass.emplace_back();
+		invMass.emplace_back();
+		angInertia.emplace_back();
+		invAngInertia.emplace_back();
+		moving.emplace_back();
+		pending.emplace_back();
+	}
+
+	force[index] = torque[index] = externalForce[index] = vector3d(0.0);
+	vel[index] = angVel[index] = angDisplacement[index] = vector3d(0.0);
+	lastForce[index] = lastTorque[index] = vector3d(0.0);
+	mass[index] = invMass[index] = 1.0;
+	angInertia[index] = invAngInertia[index] = 1.0;
+	moving[index] = 1;
+	pending[index] = 0;
+	return index;
+}
+
+void PhysicsStore::Remove(Uint32 index)
+{
+	assert(index < vel.size());
+	// a free entry is skipped by the integration
+	moving[index] = 0;
+	pending[index] = 0;
+	m_free.push_back(index);
+}
+
+void PhysicsStore::Integrate(Uint32 index, float timeStep)
+{
+	pending[index] = 1;
+	IntegrateRange(index, index + 1, timeStep);
+}
+
+void PhysicsStore::IntegratePending(float timeStep, TaskGraph *taskGraph)
+{
+	const Uint32 count = Uint32(vel.size());
+	if (!taskGraph || count <= INTEGRATE_GRAIN) {
+		IntegrateRange(0, count, timeStep);
+		return;
+	}
+
+	// the entries of a range are only touched by its task
+	TaskSet *set = new TaskSet();
+	set->AddTaskRangeLambda({ 0, count }, INTEGRATE_GRAIN, [this, timeStep](TaskRange range) {
+		IntegrateRange(range.begin, range.end, timeStep);
+	});
+	TaskSet::Handle handle = taskGraph->QueueTaskSet(set);
+	taskGraph->WaitForTaskSet(handle);
+}
+
+void PhysicsStore::IntegrateRange(Uint32 begin, Uint32 end, float timeStep)
+{
+	const double step = timeStep;
+	for (Uint32 i = begin; i < end; i++) {
+		if (!pending[i])
+			continue;
+		pending[i] = 0;
+
+		if (!moving[i]) {
+			angDisplacement[i] = vector3d(0.0);
+			continue;
+		}
+
+		const vector3d totalForce = force[i] + externalForce[i];
+		vel[i] += step * totalForce * invMass[i];
+		angVel[i] += step * torque[i] * invAngInertia[i];
+		angDisplacement[i] = angVel[i] * step;
+
+		lastForce[i] = totalForce;
+		lastTorque[i] = torque[i];
+		force[i] = vector3d(0.0);
+		torque[i] = vector3d(0.0);
+	}
+}
@@ -0,0 +1,57 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _PHYSICSSTORE_H
+#define _PHYSICSSTORE_H
+
+#include "vector3.h"
+#include <SDL_stdinc.h>
+#include <vector>
+
+class TaskGraph;
+
+// The motion state of every DynamicBody, one entry per body in contiguous
+// arrays, so that integrating the forces of a step is a single pass over
+// all of them instead of a call into each body.
+//
+// Entries are only added and removed on the main thread. An entry keeps its
+// index for as long as it lives; freed indices are reused.
+class PhysicsStore {
+public:
+	static PhysicsStore &Get();
+
+	Uint32 Add();
+	void Remove(Uint32 index);
+
+	// Apply the accumulated forces and torques of one entry to its
+	// velocities, then clear them. Position and orientation are left to the
+	// body, see DynamicBody::IntegrateTimeStep.
+	void Integrate(Uint32 index, float timeStep);
+	// Integrate every entry marked pending, on the task graph if given
+	void IntegratePending(float timeStep, TaskGraph *taskGraph = nullptr);
+
+	// for the entries that are moving
+	std::vector<vector3d> force;
+	std::vector<vector3d> torque;
+	std::vector<vector3d> externalForce;
+	std::vector<vector3d> vel;
+	std::vector<vector3d> angVel;
+	// the rotation of the last step, angular velocity times the step
+	std::vector<vector3d> angDisplacement;
+	// the forces of the last step, for the time accel reduction fudge
+	std::vector<vector3d> lastForce;
+	std::vector<vector3d> lastTorque;
+	std::vector<double> mass;
+	std::vector<double> invMass;
+	std::vector<double> angInertia;
+	std::vector<double> invAngInertia;
+	std::vector<Uint8> moving;
+	std::vector<Uint8> pending;
+
+private:
+	void IntegrateRange(Uint32 begin, Uint32 end, float timeStep);
+
+	std::vector<Uint32> m_free;
+};
+
+#endif /* _PHYSICSSTORE_H */
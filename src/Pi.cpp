@@ -8,8 +8,10 @@
 #include "Body.h"
 #include "BodyComponent.h"
 
+#include "ApproachPrefetch.h"
 #include "BaseSphere.h"
 #include "Beam.h"
+#include "Benchmark.h"
 #include "CityOnPlanet.h"
 #include "DeathView.h"
 #include "EnumStrings.h"
@@ -20,8 +22,10 @@
 #include "GameConfig.h"
 #include "GameLog.h"
 #include "GameSaveError.h"
+#include "HudTrail.h"
 #include "Input.h"
 #include "Intro.h"
+#include "JobStats.h"
 #include "Lang.h"
 #include "Missile.h"
 #include "ModManager.h"
@@ -30,6 +34,8 @@
 #include "Player.h"
 #include "PngWriter.h"
 #include "Projectile.h"
+#include "ProjectilePool.h"
+#include "QualityGovernor.h"
 #include "SectorView.h"
 #include "Sfx.h"
 #include "Shields.h"
@@ -37,7 +43,9 @@
 #include "Space.h"
 #include "SpaceStation.h"
 #include "Star.h"
+#include "StartupReport.h"
 #include "StringF.h"
+#include "TrafficPool.h"
 #include "Tombstone.h"
 #include "TransferPlanner.h"
 #include "WorldView.h"
@@ -46,21 +54,32 @@
 #include "ObjectViewerView.h"
 #endif
 
+#include "collider/CollisionSpace.h"
+
+#include "galaxy/GalaxyDiskCache.h"
 #include "galaxy/GalaxyGenerator.h"
 
 #include "graphics/Material.h"
 #include "graphics/RenderState.h"
 #include "graphics/Renderer.h"
+#include "graphics/TextureBuilder.h"
+#include "graphics/TextureLoader.h"
+#include "graphics/TextureStreamer.h"
 #include "graphics/opengl/RendererGL.h"
+#include "scenegraph/LOD.h"
 
 #include "core/GuiApplication.h"
 #include "core/Log.h"
 #include "core/OS.h"
+#include "core/Property.h"
 
 #include "lua/Lua.h"
+#include "lua/LuaAllocProfiler.h"
 #include "lua/LuaConsole.h"
 #include "lua/LuaEvent.h"
+#include "lua/LuaProfiler.h"
 #include "lua/LuaTimer.h"
+#include "lua/LuaUtils.h"
 
 #include "pigui/LuaPiGui.h"
 #include "pigui/PerfInfo.h"
@@ -76,6 +95,7 @@
 #include <SDL.h>
 
 #ifdef PROFILE_LUA_TIME
+#include <chrono>
 #include <time.h>
 #endif
 
@@ -144,35 +164,97 @@ public:
 	}
 
 	std::unique_ptr<JobSet> asyncStartupQueue;
-	std::unique_ptr<JobSet> currentStepQueue;
+	// the jobs of the main thread step being run, they have to finish
+	// before the step is done
+	JobSet *currentStepQueue = nullptr;
 
 protected:
+	// steps that touch the renderer, Lua or the job sets run on the main
+	// thread, one per frame; the others run on the job queue
+	enum Affinity {
+		MAIN_THREAD,
+		ANY_THREAD
+	};
+
 	struct LoadStep {
+		enum State {
+			WAITING,
+			RUNNING,
+			FINISHED
+		};
+
 		// TODO: use a lighter-weight wrapper over lambdas instead of std::function
 		std::function<void()> fn;
 		std::string name;
+		Affinity affinity;
+		// indices of the earlier steps it has to wait for
+		std::vector<size_t> deps;
+
+		State state = WAITING;
+		std::unique_ptr<JobSet> jobs;
+
+		// for the startup report: when the step started, and what its
+		// function took on the thread that ran it
+		StartupReport::Sample start;
+		double runMs = 0.0;
+		double cpuMs = 0.0;
+
+		void Run()
+		{
+			const StartupReport::Sample before = StartupReport::Sample::Now();
+			fn();
+			const StartupReport::Sample after = StartupReport::Sample::Now();
+			runMs = after.wallMs - before.wallMs;
+			cpuMs = after.cpuMs - before.cpuMs;
+		}
+	};
+
+	// Runs a step that doesn't need the main thread; the steps outlive the
+	// jobs, FinishLoadStep waits for them
+	class LoadStepJob : public Job {
+	public:
+		LoadStepJob(LoadStep &step) :
+			m_step(step) {}
+
+		virtual void OnRun() override { m_step.Run(); }
+		virtual void OnFinish() override {}
+		virtual const char *GetJobName() const override { return "LoadStep"; }
+
+	private:
+		LoadStep &m_step;
 	};
 
 	std::vector<LoadStep> m_loaders;
-	size_t m_currentLoader = 0;
-	bool m_hasQueuedJobs = 0;
+	size_t m_numFinished = 0;
 
+	// deps are the names of steps added before this one
 	template <typename T>
-	void AddStep(std::string name, T fn)
+	void AddStep(std::string name, T fn, Affinity affinity = MAIN_THREAD, std::initializer_list<const char *> deps = {})
 	{
-		m_loaders.push_back(LoadStep{ fn, name });
+		LoadStep step;
+		step.fn = fn;
+		step.name = std::move(name);
+		step.affinity = affinity;
+		for (const char *dep : deps) {
+			auto it = std::find_if(m_loaders.begin(), m_loaders.end(), [dep](const LoadStep &s) { return s.name == dep; });
+			assert(it != m_loaders.end());
+			step.deps.push_back(it - m_loaders.begin());
+		}
+		m_loaders.push_back(std::move(step));
 	}
 
 	Profiler::Clock m_loadTimer;
-	Profiler::Clock m_stepTimer;
+	// when the last step finished, and the wait for asyncStartupQueue began
+	StartupReport::Sample m_stepsDone;
 
 	void Start() override;
 	void Update(float) override;
 	void End() override;
 
-	void RunNewLoader();
-	void FinishLoadStep();
-	float GetProgress() { return (m_currentLoader) / float(m_loaders.size()); }
+	bool CanStart(const LoadStep &step) const;
+	void StartLoadStep(LoadStep &step);
+	void FinishLoadStep(LoadStep &step);
+	float GetProgress() { return m_numFinished / float(m_loaders.size()); }
 };
 
 // FIXME: this is a hack, this class should have its lifecycle managed elsewhere
@@ -208,6 +290,10 @@ protected:
 	void InitGame();
 	void EndGame();
 
+	// Steps the game through the time in the accumulator, within the tick
+	// limit or wall time budget, and returns the number of steps taken
+	int RunPhysicsTicks(float step);
+
 	double time_player_died;
 
 	// Used to measure frame and physics performance timing info
@@ -226,6 +312,10 @@ protected:
 	uint32_t startup_ticks;
 
 	int MAX_PHYSICS_TICKS;
+	// With a budget, physics steps as often as fits in that much wall time
+	// each frame instead of a fixed number of times, and the game time it
+	// fell short by is made up in the frames after
+	double physics_budget_ms;
 	double accumulator;
 
 	Uint32 last_stats = SDL_GetTicks();
@@ -266,11 +356,22 @@ void Pi::Init(const std::map<std::string, std::string> &options, bool no_gui)
 	m_instance->Startup();
 }
 
+Pi::App::App() :
+	GuiApplication("Pioneer")
+{}
+
+Pi::App::~App() = default;
+
 void Pi::App::SetStartPath(const SystemPath &startPath)
 {
 	static_cast<MainMenu *>(m_mainMenu.Get())->SetStartPath(startPath);
 }
 
+void Pi::App::SetBenchmark(Benchmark *benchmark)
+{
+	m_benchmark.reset(benchmark);
+}
+
 void TestGPUJobsSupport()
 {
 	PROFILE_SCOPED()
@@ -310,11 +411,72 @@ void TestGPUJobsSupport()
 	}
 }
 
+// a planet this many radii away is a few pixels across, rebuilding its
+// terrain or a city on it isn't seen
+static const double TERRAIN_OUT_OF_SIGHT_RADII = 1000.0;
+
+static bool IsTerrainOutOfSight()
+{
+	if (!Pi::game)
+		return false;
+	if (Pi::game->IsHyperspace())
+		return true;
+
+	for (const Body *body : Pi::game->GetSpace()->GetBodies()) {
+		if (!body->IsType(ObjectType::TERRAINBODY))
+			continue;
+		const double dist = body->GetSystemBody()->GetRadius() * TERRAIN_OUT_OF_SIGHT_RADII;
+		if (Pi::player->GetPositionRelTo(body).LengthSqr() < dist * dist)
+			return false;
+	}
+	return true;
+}
+
+// The detail settings the quality governor may turn down, in the order it
+// does: those that only thin out what is drawn first, then those that are
+// rebuilt when they change. None goes above what the config asks for.
+static void AddQualityKnobs(QualityGovernor *governor, GameConfig *config)
+{
+	// new particles stop being added, the old ones run out as usual
+	static const Uint32 particleLimits[] = { 512, 1024, 2048, 0 };
+	governor->AddKnob({ "Particles", 0, int(COUNTOF(particleLimits)) - 1,
+		[]() { return int(std::find(std::begin(particleLimits), std::end(particleLimits), SfxManager::GetMaxParticles()) - std::begin(particleLimits)); },
+		[](int level) { SfxManager::SetMaxParticles(particleLimits[level]); } });
+
+	// in steps of half the hysteresis of the level selection, which moves
+	// only the models right at a threshold to the next level
+	governor->AddKnob({ "Model detail", 10, 20,
+		[]() { return int(std::lround(SceneGraph::LOD::GetDetailBias() * 20.0f)); },
+		[](int level) { SceneGraph::LOD::SetDetailBias(level / 20.0f); } });
+
+	// the star field is made again, which is only hidden by a jump
+	const int stars = int(std::lround(Pi::GetAmountBackgroundStars() * 10.0f));
+	governor->AddKnob({ "Star field", stars / 2, stars,
+		[]() { return int(std::lround(Pi::GetAmountBackgroundStars() * 10.0f)); },
+		[](int level) { Pi::SetAmountBackgroundStars(level / 10.0f); },
+		[]() { return Pi::game && Pi::game->IsHyperspace(); } });
+
+	governor->AddKnob({ "City detail", 0, config->Int("DetailCities"),
+		[]() { return Pi::detail.cities; },
+		[](int level) { Pi::detail.cities = level; },
+		IsTerrainOutOfSight });
+
+	governor->AddKnob({ "Planet detail", 0, config->Int("DetailPlanets"),
+		[]() { return Pi::detail.planets; },
+		[](int level) {
+			Pi::detail.planets = level;
+			Pi::OnChangeDetailLevel();
+		},
+		IsTerrainOutOfSight });
+}
+
 void Pi::App::OnStartup()
 {
 	PROFILE_SCOPED()
 	Profiler::Clock startupTimer;
 	startupTimer.Start();
+	StartupReport::Begin();
+	StartupReport::BeginPhase("Config and mods");
 
 	SetupProfiler(Pi::config);
 
@@ -349,9 +511,13 @@ void Pi::App::OnStartup()
 	Pi::detail.planets = config->Int("DetailPlanets");
 	Pi::detail.cities = config->Int("DetailCities");
 
+	StartupReport::BeginPhase("Renderer");
 	Graphics::RendererOGL::RegisterRenderer();
-	Pi::renderer = StartupRenderer(Pi::config, false, config->Int("DebugWindowResize"));
+	// a hidden window still draws everything, for benchmarks on machines
+	// nobody looks at
+	Pi::renderer = StartupRenderer(Pi::config, config->Int("HiddenWindow"), config->Int("DebugWindowResize"));
 
+	StartupReport::BeginPhase("Input");
 	Pi::rng.IncRefCount(); // so nothing tries to free it
 	Pi::rng.seed(time(0));
 
@@ -364,6 +530,7 @@ void Pi::App::OnStartup()
 		registrar(Pi::input);
 	}
 
+	StartupReport::BeginPhase("PiGui");
 	Pi::pigui = StartupPiGui();
 
 	// FIXME: move these into the appropriate class!
@@ -371,6 +538,7 @@ void Pi::App::OnStartup()
 	speedLinesDisplayed = (config->Int("SpeedLines")) ? true : false;
 	hudTrailsDisplayed = (config->Int("HudTrails")) ? true : false;
 
+	StartupReport::BeginPhase("Engine data");
 	TestGPUJobsSupport();
 
 	EnumStrings::Init();
@@ -380,6 +548,7 @@ void Pi::App::OnStartup()
 
 	BodyComponentDB::Init();
 
+	StartupReport::BeginPhase("Worker threads");
 	Profiler::Clock threadTimer;
 	threadTimer.Start();
 
@@ -387,9 +556,33 @@ void Pi::App::OnStartup()
 	Uint32 numThreads = config->Int("WorkerThreads");
 	numThreads = numThreads ? numThreads : std::max(OS::GetNumCores() - 1, 1U);
 	GetTaskGraph()->SetWorkerThreads(numThreads);
+	GetTaskGraph()->SetWorkStealing(config->Int("WorkStealing"));
+	SetJobFinishBudget(config->Float("JobFinishBudgetMs"));
+	m_luaGCFrameTarget = config->Float("LuaGCFrameTargetMs");
+	Space::SetParallelBodyUpdate(config->Int("ParallelBodyUpdate"));
+	Space::SetParallelCollision(config->Int("ParallelCollision"));
+	Game::SetFastForwardEnabled(config->Int("FastForward"));
+	Space::SetBodyNearGrid(config->Int("BodyNearGrid"));
+	CollisionSpace::SetContactCache(config->Int("CollisionContactCache"));
+	Ship::SetOnRailsEnabled(config->Int("ShipsOnRails"));
+	Ship::SetAILevelOfDetail(config->Int("AILevelOfDetail"));
+	ProjectilePool::SetEnabled(config->Int("ProjectilePool"));
+	TrafficPool::SetRelevanceRadius(config->Float("TrafficRelevanceRadius"));
+	ApproachPrefetch::SetLookAheadTime(config->Float("ApproachPrefetchTime"));
+	if (config->Float("QualityGovernorTargetMs") > 0.0f) {
+		m_qualityGovernor.reset(new QualityGovernor(config->Float("QualityGovernorTargetMs")));
+		AddQualityKnobs(m_qualityGovernor.get(), config);
+	}
+
+	Graphics::TextureStreamer::Init(GetAsyncJobQueue(), size_t(std::max(0, config->Int("TextureStreamingMB"))) * 1024 * 1024);
+	if (config->Int("AsyncTextureLoading"))
+		Graphics::TextureLoader::Init(GetAsyncJobQueue());
+	Graphics::TextureBuilder::InitCompression(config->Int("UseTextureCompression") && config->Int("CompressTexturesOnLoad"),
+		size_t(std::max(0, config->Int("TextureCacheMB"))) * 1024 * 1024);
 
 	threadTimer.Stop();
 	Output("started %d worker threads in %.2fms\n", numThreads, threadTimer.milliseconds());
+	StartupReport::EndPhase();
 
 	QueueLifecycle(m_loader);
 
@@ -415,6 +608,7 @@ void Pi::App::OnShutdown()
 
 	// This function should only be called at the very end of the shutdown procedure.
 	assert(Pi::game == nullptr);
+	Game::FinishBackgroundSaves();
 	if (Pi::ffmpegFile != nullptr) {
 		_pclose(Pi::ffmpegFile);
 	}
@@ -426,6 +620,7 @@ void Pi::App::OnShutdown()
 	// reference to the renderer
 	Projectile::FreeModel();
 	Beam::FreeModel();
+	HudTrail::FreeMaterial();
 	delete Pi::intro;
 	Pi::luaConsole.reset();
 	NavLights::Uninit();
@@ -435,6 +630,9 @@ void Pi::App::OnShutdown()
 	CityOnPlanet::Uninit();
 	BaseSphere::Uninit();
 	FaceParts::Uninit();
+	Graphics::TextureLoader::Uninit();
+	Graphics::TextureStreamer::Uninit();
+	Graphics::TextureBuilder::UninitCompression();
 	Graphics::Uninit();
 
 	PiGui::Lua::Uninit();
@@ -442,10 +640,12 @@ void Pi::App::OnShutdown()
 	Pi::pigui = nullptr;
 	Lua::UninitModules();
 	Lua::Uninit();
+	pi_lua_uninit_chunk_cache();
 
 	delete Pi::modelCache;
 
 	GalaxyGenerator::Uninit();
+	GalaxyDiskCache::Uninit();
 
 	BodyComponentDB::Uninit();
 
@@ -483,34 +683,37 @@ JobSet *Pi::App::GetAsyncStartupQueue() const
 
 JobSet *Pi::App::GetCurrentLoadStepQueue() const
 {
-	return static_cast<StartupScreen *>(m_loader.Get())->currentStepQueue.get();
+	return static_cast<StartupScreen *>(m_loader.Get())->currentStepQueue;
 }
 
-// TODO: investigate constructing a DAG out of Init functions and dependencies
 void StartupScreen::Start()
 {
 	PROFILE_SCOPED()
 
 	asyncStartupQueue.reset(new JobSet(Pi::GetAsyncJobQueue()));
-	currentStepQueue.reset(new JobSet(Pi::GetAsyncJobQueue()));
 
 	Output("StartupScreen::Start()\n");
 	m_loadTimer.Reset();
 	m_loadTimer.Start();
 
 	Output("ShipType::Init()\n");
+	StartupReport::BeginPhase("ShipType::Init()");
 	// XXX early, Lua init needs it
-	ShipType::Init();
+	ShipType::Init(Pi::GetApp()->GetTaskGraph());
 
 	// XXX UI requires Lua  but Pi::ui must exist before we start loading
 	// templates. so now we have crap everywhere :/
 	Output("Lua::Init()\n");
+	StartupReport::BeginPhase("Lua::Init()");
+	pi_lua_init_chunk_cache(size_t(std::max(0, Pi::config->Int("LuaCacheMB"))) * 1024 * 1024);
 	Lua::Init();
+	Lua::manager->SetManualGC(Pi::config->Float("LuaGCFrameTargetMs") > 0.0);
 
 	// TODO: Get the lua state responsible for drawing the init progress up as fast as possible
 	// Investigate using a pigui-only Lua state that we can initialize without depending on
 	// normal init flow, or drawing the init screen in C++ instead?
 	// Loads just the PiGui class and PiGui-related modules
+	StartupReport::BeginPhase("PiGui::Lua::Init()");
 	PiGui::Lua::Init();
 	// FIXME: this just exists to load the theme out-of-order from Lua::InitModules. Needs a better solution
 	PiGui::LoadThemeFromDisk("default");
@@ -520,6 +723,11 @@ void StartupScreen::Start()
 	Pi::pigui->NewFrame();
 	PiGui::RunHandler(0.01, "init");
 	Pi::pigui->EndFrame();
+	StartupReport::EndPhase();
+
+	AddStep("Prewarm shaders", []() {
+		Pi::renderer->PrewarmShaders();
+	});
 
 	AddStep("Sound::Init", []() {
 		if (Pi::GetApp()->HeadlessMode() || Pi::config->Int("DisableSound"))
@@ -543,31 +751,42 @@ void StartupScreen::Start()
 			const std::string endpoint(Pi::config->String("ServerEndpoint"));
 			if (endpoint.size() > 0) {
 				Output("Server agent enabled, endpoint: %s\n", endpoint.c_str());
-				Pi::serverAgent = new HTTPServerAgent(endpoint);
+				Pi::serverAgent = new HTTPServerAgent(endpoint, Pi::config->Int("ServerAgentMaxRequests"));
 			}
 		}
 		if (!Pi::serverAgent) {
 			Output("Server agent disabled\n");
 			Pi::serverAgent = new NullServerAgent();
 		}
-	});
+	}, ANY_THREAD);
 #endif
 
 	// TODO: expose the AddStep interface so Lua::InitModules can granularize its registration
 	AddStep("Lua::InitModules()", &Lua::InitModules);
 
+	AddStep("GalaxyDiskCache::Init()", []() {
+		GalaxyDiskCache::Init(size_t(std::max(0, Pi::config->Int("GalaxyCacheMB"))) * 1024 * 1024);
+	}, ANY_THREAD);
+
+	// the custom systems and factions are loaded with Lua
 	AddStep("GalaxyGenerator::Init()", []() {
 		if (Pi::config->HasEntry("GalaxyGenerator"))
 			GalaxyGenerator::Init(Pi::config->String("GalaxyGenerator"),
 				Pi::config->Int("GalaxyGeneratorVersion", GalaxyGenerator::LAST_VERSION));
 		else
 			GalaxyGenerator::Init();
-	});
+	}, MAIN_THREAD, { "Lua::InitModules()", "GalaxyDiskCache::Init()" });
 
 	AddStep("FaceParts::Init()", &FaceParts::Init);
 
 	AddStep("new ModelCache", []() {
-		Pi::modelCache = new ModelCache(Pi::renderer);
+		Pi::modelCache = new ModelCache(Pi::renderer, Pi::GetAsyncJobQueue(),
+			size_t(std::max(0, Pi::config->Int("ModelCacheMB"))) * 1024 * 1024);
+
+		// read the ship models in the background while the rest loads, so
+		// the first ship of each type doesn't have to wait for its file
+		for (auto &type : ShipType::types)
+			Pi::modelCache->RequestModel(type.second.modelName);
 	});
 
 	AddStep("Shields::Init", []() {
@@ -576,9 +795,10 @@ void StartupScreen::Start()
 
 	AddStep("BaseSphere::Init", &BaseSphere::Init);
 
-	AddStep("CityOnPlanet::Init", &CityOnPlanet::Init);
+	// the buildings and the stations are models
+	AddStep("CityOnPlanet::Init", &CityOnPlanet::Init, MAIN_THREAD, { "new ModelCache" });
 
-	AddStep("SpaceStation::Init", &SpaceStation::Init);
+	AddStep("SpaceStation::Init", &SpaceStation::Init, MAIN_THREAD, { "new ModelCache" });
 
 	AddStep("NavLights::Init", []() {
 		NavLights::Init(Pi::renderer);
@@ -595,53 +815,86 @@ void StartupScreen::Start()
 		Pi::planner = new TransferPlanner();
 
 		perfInfoDisplay.reset(new PiGui::PerfInfo());
-	});
+	}, MAIN_THREAD, { "Lua::InitModules()" });
 }
 
 void StartupScreen::Update(float deltaTime)
 {
 	PROFILE_SCOPED()
 
-	// if we have queued jobs from the current loader step and they're all done, finish up
-	if (m_hasQueuedJobs && currentStepQueue->IsEmpty())
-		FinishLoadStep();
+	// a step is done once it has returned and the jobs it queued have finished
+	for (LoadStep &step : m_loaders) {
+		if (step.state == LoadStep::RUNNING && step.jobs->IsEmpty())
+			FinishLoadStep(step);
+	}
 
-	if (!m_hasQueuedJobs) {
-		if (m_currentLoader < m_loaders.size())
-			RunNewLoader();
-		// finish loading once all steps are complete and there's nothing left in the queue.
-		else if (asyncStartupQueue->IsEmpty())
-			return RequestEndLifecycle();
+	// all the steps that can go on the job queue start right away, the main
+	// thread runs one step per frame so the progress keeps being drawn
+	bool startedMainStep = false;
+	for (LoadStep &step : m_loaders) {
+		if (!CanStart(step) || (step.affinity == MAIN_THREAD && startedMainStep))
+			continue;
+		startedMainStep |= step.affinity == MAIN_THREAD;
+		StartLoadStep(step);
 	}
 
+	// finish loading once all steps are complete and there's nothing left in the queue.
+	if (m_numFinished == m_loaders.size() && asyncStartupQueue->IsEmpty())
+		return RequestEndLifecycle();
+
 	Pi::pigui->NewFrame();
 	PiGui::EmitEvents();
 	PiGui::RunHandler(GetProgress(), "init");
 	Pi::pigui->Render();
 }
 
-void StartupScreen::RunNewLoader()
+bool StartupScreen::CanStart(const LoadStep &step) const
 {
-	// don't increment the current loader count and run the loader if async jobs haven't finished yet
-	LoadStep &loader = m_loaders[m_currentLoader];
-	Output("Loading [%02.f%%]: %s started\n", GetProgress() * 100., loader.name.c_str());
+	if (step.state != LoadStep::WAITING)
+		return false;
+	for (size_t dep : step.deps) {
+		if (m_loaders[dep].state != LoadStep::FINISHED)
+			return false;
+	}
+	return true;
+}
+
+void StartupScreen::StartLoadStep(LoadStep &step)
+{
+	Output("Loading [%02.f%%]: %s started\n", GetProgress() * 100., step.name.c_str());
+
+	step.state = LoadStep::RUNNING;
+	step.start = StartupReport::Sample::Now();
+	step.jobs.reset(new JobSet(Pi::GetAsyncJobQueue()));
+
+	if (step.affinity == ANY_THREAD) {
+		step.jobs->Order(new LoadStepJob(step));
+		return;
+	}
 
-	m_stepTimer.SoftReset();
-	loader.fn();
+	currentStepQueue = step.jobs.get();
+	step.Run();
+	currentStepQueue = nullptr;
 
-	// if we haven't queued any jobs, just finish this step and skip to the next one
-	m_hasQueuedJobs = !currentStepQueue->IsEmpty();
-	if (currentStepQueue->IsEmpty())
-		FinishLoadStep();
+	// if we haven't queued any jobs, just finish this step
+	if (step.jobs->IsEmpty())
+		FinishLoadStep(step);
 }
 
-void StartupScreen::FinishLoadStep()
+void StartupScreen::FinishLoadStep(LoadStep &step)
 {
-	m_hasQueuedJobs = false;
-	m_stepTimer.Stop();
-	Output("Loading [%02.f%%]: %s took %.2fms\n", GetProgress() * 100.,
-		m_loaders[m_currentLoader].name.c_str(), m_stepTimer.milliseconds());
-	m_currentLoader++;
+	step.state = LoadStep::FINISHED;
+	step.jobs.reset();
+	m_numFinished++;
+
+	const StartupReport::Sample now = StartupReport::Sample::Now();
+	const double wallMs = now.wallMs - step.start.wallMs;
+	StartupReport::AddPhase({ step.name, step.affinity == ANY_THREAD, step.start.wallMs, wallMs,
+		step.runMs, step.cpuMs, now.bytesRead - step.start.bytesRead });
+	Output("Loading [%02.f%%]: %s took %.2fms\n", GetProgress() * 100., step.name.c_str(), wallMs);
+
+	if (m_numFinished == m_loaders.size())
+		m_stepsDone = now;
 }
 
 void StartupScreen::End()
@@ -651,6 +904,14 @@ void StartupScreen::End()
 
 	m_loadTimer.Stop();
 	Output("\n\nPioneer loading took %.2fms\n", m_loadTimer.milliseconds());
+
+	// the main thread keeps drawing the loading screen while it waits
+	const StartupReport::Sample now = StartupReport::Sample::Now();
+	StartupReport::AddPhase({ "asyncStartupQueue", false, m_stepsDone.wallMs, now.wallMs - m_stepsDone.wallMs,
+		0.0, now.cpuMs - m_stepsDone.cpuMs, now.bytesRead - m_stepsDone.bytesRead });
+
+	// steps with jobs and the ones on the job queue are seen to finish once a frame
+	StartupReport::End();
 }
 
 /*
@@ -663,7 +924,15 @@ void MainMenu::Start()
 {
 	// TODO: just calculate this at draw time inside Intro
 	Pi::intro = new Intro(Pi::renderer, Pi::renderer->GetWindowWidth(), Pi::renderer->GetWindowHeight());
-	if (m_skipMenu) {
+	if (Benchmark *benchmark = Pi::GetApp()->GetBenchmark()) {
+		Output("Starting the benchmark\n");
+		Pi::rng.seed(benchmark->GetSeed());
+		Game *game = benchmark->CreateGame();
+		if (game)
+			Pi::StartGame(game);
+		else
+			Pi::RequestQuit();
+	} else if (m_skipMenu) {
 		Output("Loading new game immediately!\n");
 		Pi::StartGame(new Game(m_startPath, 0.0));
 		m_skipMenu = false; // Show the main menu once we're done here.
@@ -773,6 +1042,8 @@ void Pi::HandleKeyDown(SDL_Keysym *key)
 	case SDLK_p: // alert it that we want to profile
 		if (input->KeyState(SDLK_LSHIFT) || input->KeyState(SDLK_RSHIFT))
 			Pi::GetApp()->RequestProfileFrame();
+		else // a trace of the next few seconds
+			Pi::GetApp()->RequestProfileCapture(300);
 		break;
 #endif
 
@@ -859,13 +1130,78 @@ void Pi::App::PreUpdate()
 {
 	PROFILE_SCOPED()
 	Pi::frameTime = DeltaTime();
+	m_frameClock.SoftReset();
+
+	Graphics::TextureStreamer::Update(Pi::renderer->GetStats());
+	if (Pi::modelCache)
+		Pi::modelCache->Update();
+}
+
+// Publish per-job-type queue depth and latency percentiles (in microseconds)
+// as renderer stats so they can be logged alongside the other frame stats
+static void UpdateJobStats()
+{
+	PROFILE_SCOPED()
+	static std::vector<JobStats::Summary> summaries;
+	static const char *percentileNames[JobStats::MAX_PERCENTILE] = { "p50", "p95", "p99" };
+
+	JobStats::GetSummaries(summaries);
+	Graphics::Stats &stats = Pi::renderer->GetStats();
+
+	for (const JobStats::Summary &summary : summaries) {
+		const std::string prefix = "Job " + summary.name + " ";
+		stats.SetNamedStatCount(prefix + "Queue Depth", summary.queueDepth);
+
+		for (int i = 0; i < JobStats::MAX_PERCENTILE; i++) {
+			const std::string suffix = std::string(" ") + percentileNames[i] + " (us)";
+			stats.SetNamedStatCount(prefix + "Wait" + suffix, uint32_t(summary.waitMs[i] * 1000.0f));
+			stats.SetNamedStatCount(prefix + "Run" + suffix, uint32_t(summary.runMs[i] * 1000.0f));
+			stats.SetNamedStatCount(prefix + "Finish" + suffix, uint32_t(summary.finishMs[i] * 1000.0f));
+		}
+	}
+}
+
+// what the top level timer scopes of the last frame the GPU finished took
+static float GetGPUFrameMs()
+{
+	float ms = 0.0f;
+	for (const Graphics::Stats::GPUTiming &timing : Pi::renderer->GetStats().GetGPUTimings()) {
+		if (timing.depth == 0)
+			ms += timing.milliseconds;
+	}
+	return ms;
 }
 
 void Pi::App::PostUpdate()
 {
 	PROFILE_SCOPED()
 
+	UpdateJobStats();
+	if (m_qualityGovernor)
+		m_qualityGovernor->Update(SDL_GetTicks() * 1e-3, Pi::frameTime * 1e3f, GetGPUFrameMs());
 	HandleRequests();
+
+	// the frame has been drawn, collect garbage with the time left over
+	if (Lua::manager && Lua::manager->IsManualGC()) {
+		m_frameClock.SoftStop();
+		Lua::manager->StepGarbageCollector(m_luaGCFrameTarget - m_frameClock.milliseconds());
+		if (perfInfoDisplay)
+			perfInfoDisplay->UpdateCounter(PiGui::PerfInfo::COUNTER_LUAGC, Lua::manager->GetGCStats().lastStepMs / 1e3);
+	}
+}
+
+void Pi::App::OnProfileWritten(const std::string &path)
+{
+	if (LuaProfiler::HasData())
+		LuaProfiler::Dump(path);
+	if (LuaAllocProfiler::HasData())
+		LuaAllocProfiler::Dump(path);
+}
+
+void Pi::App::OnHitch(double frameMs)
+{
+	if (perfInfoDisplay)
+		perfInfoDisplay->ReportHitch(frameMs);
 }
 
 // FIXME: delete/move this function out of Pi.cpp
@@ -914,6 +1250,8 @@ void GameLoop::Start()
 	if (MAX_PHYSICS_TICKS <= 0)
 		MAX_PHYSICS_TICKS = 4;
 
+	physics_budget_ms = std::max(Pi::config->Float("PhysicsBudgetMs"), 0.0f);
+
 	Pi::SetGameTickAlpha(0);
 	// If we have a tombstone loop, we will SetNextLifecycle() so it runs before
 	// we jump back to the main menu
@@ -922,11 +1260,27 @@ void GameLoop::Start()
 	profile_startup_ms = Clamp(Pi::config->Int("ProfileStartupMs", 0), 0, 10000);
 	startup_ticks = SDL_GetTicks();
 	SetProfilerAccumulate(profile_startup_ms > 0);
+
+	// the benchmark takes the profile of the whole run
+	if (Benchmark *benchmark = Pi::GetApp()->GetBenchmark()) {
+		benchmark->Start();
+		profile_startup_ms = 0;
+		SetProfilerAccumulate(true);
+	}
 }
 
 void GameLoop::Update(float deltaTime)
 {
 	PROFILE_SCOPED()
+	// a benchmark steps the game the same amount each frame, whatever the
+	// frame took, so that every run does the same work
+	Benchmark *benchmark = Pi::GetApp()->GetBenchmark();
+	if (benchmark) {
+		if (!benchmark->NextFrame())
+			Pi::RequestQuit();
+		deltaTime = benchmark->GetTimeStep();
+	}
+
 	perfTimer.SoftReset();			   // Reset() + Start()
 	frame_time_real = deltaTime * 1e3; // convert to ms
 	frame_stat++;
@@ -949,26 +1303,16 @@ void GameLoop::Update(float deltaTime)
 	const float step = Pi::game->GetTimeStep();
 	if (step > 0.0f) {
 		PROFILE_SCOPED_RAW("Physics Update [unpaused]")
-		int phys_ticks = 0;
-		while (accumulator >= step) {
-			if (++phys_ticks >= MAX_PHYSICS_TICKS) {
-				accumulator = 0.0;
-				break;
-			}
-
-			Pi::game->TimeStep(step);
-			BaseSphere::UpdateAllBaseSphereDerivatives();
-
-			accumulator -= step;
-		}
+		const int phys_ticks = RunPhysicsTicks(step);
 
 		// rendering interpolation between frames: don't use when docked
 		// FIXME: this is the player's concern, the player should be responsible for calling Pi::SetInterpolation(false) when docked
+		// the accumulator holds more than a step when the budget ran out
 		int pstate = Pi::game->GetPlayer()->GetFlightState();
 		if (pstate == Ship::DOCKED || pstate == Ship::DOCKING || pstate == Ship::UNDOCKING)
 			Pi::SetGameTickAlpha(1.0);
 		else
-			Pi::SetGameTickAlpha(accumulator / step);
+			Pi::SetGameTickAlpha(std::min(accumulator / step, 1.0));
 
 		phys_stat += phys_ticks;
 	} else {
@@ -1028,6 +1372,9 @@ void GameLoop::Update(float deltaTime)
 	// TODO: the escape menu depends on HandleEvents() being called before NewFrame()
 	// Move HandleEvents to either the end of the loop or the very start of the loop
 	// The goal is to be able to call imgui functions for debugging inside C++ code
+	// the property changes of this frame, before the UI draws them
+	PropertyMap::DispatchChanges();
+
 	perfTimer.SoftReset();
 	Pi::pigui->NewFrame();
 
@@ -1074,7 +1421,7 @@ void GameLoop::Update(float deltaTime)
 	perfInfoDisplay->UpdateCounter(PiGui::PerfInfo::COUNTER_PIGUI, pigui_time);
 
 	// XXX: profile game startup
-	if (GetProfilerAccumulate() && (SDL_GetTicks() - startup_ticks) >= profile_startup_ms) {
+	if (!benchmark && GetProfilerAccumulate() && (SDL_GetTicks() - startup_ticks) >= profile_startup_ms) {
 		SetProfilerAccumulate(false);
 		Pi::GetApp()->RequestProfileFrame();
 	}
@@ -1105,6 +1452,50 @@ void GameLoop::Update(float deltaTime)
 #endif
 }
 
+int GameLoop::RunPhysicsTicks(float step)
+{
+	int phys_ticks = 0;
+
+	if (physics_budget_ms <= 0.0) {
+		while (accumulator >= step) {
+			if (++phys_ticks >= MAX_PHYSICS_TICKS) {
+				accumulator = 0.0;
+				break;
+			}
+
+			Pi::game->TimeStep(step);
+			BaseSphere::UpdateAllBaseSphereDerivatives();
+
+			accumulator -= step;
+		}
+
+		return phys_ticks;
+	}
+
+	// past this many steps behind the game just runs slower, rather than
+	// spending ever longer catching up
+	const double MAX_BACKLOG_STEPS = 8.0;
+
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point deadline = Clock::now() +
+		std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(physics_budget_ms));
+
+	// always at least one step, so the game moves however slow it is
+	while (accumulator >= step) {
+		Pi::game->TimeStep(step);
+		BaseSphere::UpdateAllBaseSphereDerivatives();
+
+		accumulator -= step;
+		phys_ticks++;
+
+		if (Clock::now() >= deadline)
+			break;
+	}
+
+	accumulator = std::min(accumulator, step * MAX_BACKLOG_STEPS);
+	return phys_ticks;
+}
+
 void GameLoop::End()
 {
 	// Process any pending UI events
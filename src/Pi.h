@@ -8,8 +8,10 @@
 #include "MathUtil.h"
 #include "core/GuiApplication.h"
 #include "gameconsts.h"
+#include "profiler/Profiler.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -21,6 +23,7 @@ namespace PiGui {
 	class Instance;
 } //namespace PiGui
 
+class Benchmark;
 class Game;
 class GameConfig;
 class Intro;
@@ -31,6 +34,7 @@ class LuaTimer;
 class ModelCache;
 class ObjectViewerView;
 class Player;
+class QualityGovernor;
 class SystemPath;
 class TransferPlanner;
 class View;
@@ -73,6 +77,13 @@ public:
 
 		void SetStartPath(const SystemPath &startPath);
 
+		// Run the benchmark instead of the main menu, then quit
+		void SetBenchmark(Benchmark *benchmark);
+		Benchmark *GetBenchmark() const { return m_benchmark.get(); }
+
+		// nullptr unless QualityGovernorTargetMs is set
+		QualityGovernor *GetQualityGovernor() const { return m_qualityGovernor.get(); }
+
 		// Returns a pointer to the async JobSet for the current startup loading step.
 		// The current load step will not complete until all ordered jobs have finished.
 		// NOTE: this queue runs on a different thread.
@@ -92,8 +103,8 @@ public:
 		friend class GameLoop;
 		friend class TombstoneLoop;
 
-		App() :
-			GuiApplication("Pioneer") {}
+		App();
+		~App();
 
 		void OnStartup() override;
 		void OnShutdown() override;
@@ -101,6 +112,9 @@ public:
 		void PreUpdate() override;
 		void PostUpdate() override;
 
+		void OnProfileWritten(const std::string &path) override;
+		void OnHitch(double frameMs) override;
+
 		void RunJobs();
 
 		void HandleRequests();
@@ -117,9 +131,16 @@ public:
 
 		bool m_noGui;
 
+		// the Lua garbage collector runs in what is left of this frame time
+		double m_luaGCFrameTarget = 0.0;
+		Profiler::Clock m_frameClock;
+
 		RefCountedPtr<Lifecycle> m_loader;
 		RefCountedPtr<Lifecycle> m_mainMenu;
 		RefCountedPtr<Lifecycle> m_gameLoop;
+
+		std::unique_ptr<Benchmark> m_benchmark;
+		std::unique_ptr<QualityGovernor> m_qualityGovernor;
 	};
 
 public:
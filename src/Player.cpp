@@ -30,6 +30,8 @@ static Sound::Event s_soundHyperdrive;
 Player::Player(const ShipType::Id &shipId) :
 	Ship(shipId)
 {
+	// the player's targets are set from all over
+	m_flags |= FLAG_NOTIFY_REMOVALS;
 	SetController(new PlayerShipController());
 	InitCockpit();
 	m_fixedGuns->SetShouldUseLeadCalc(true);
@@ -39,6 +41,7 @@ Player::Player(const ShipType::Id &shipId) :
 Player::Player(const Json &jsonObj, Space *space) :
 	Ship(jsonObj, space)
 {
+	m_flags |= FLAG_NOTIFY_REMOVALS;
 	InitCockpit();
 	m_fixedGuns->SetShouldUseLeadCalc(true);
 }
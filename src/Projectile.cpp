@@ -11,6 +11,7 @@
 #include "Pi.h"
 #include "Planet.h"
 #include "Player.h"
+#include "ProjectilePool.h"
 #include "Sfx.h"
 #include "Ship.h"
 #include "Space.h"
@@ -26,10 +27,35 @@
 #include "lua/LuaEvent.h"
 #include "lua/LuaUtils.h"
 
+#include <algorithm>
+#include <cmath>
+
 std::unique_ptr<Graphics::MeshObject> Projectile::s_sideMesh;
 std::unique_ptr<Graphics::MeshObject> Projectile::s_glowMesh;
 std::unique_ptr<Graphics::Material> Projectile::s_sideMat;
 std::unique_ptr<Graphics::Material> Projectile::s_glowMat;
+std::unique_ptr<Graphics::Material> Projectile::s_sideInstMat;
+std::unique_ptr<Graphics::Material> Projectile::s_glowInstMat;
+
+bool Projectile::s_batching = false;
+std::vector<Projectile::BatchEntry> Projectile::s_sideBatch;
+std::vector<Projectile::BatchEntry> Projectile::s_glowBatch;
+
+// number of steps the alpha is rounded to while batching
+static constexpr float BATCH_LEVELS = 32.f;
+
+static uint32_t color_key(const Color &c)
+{
+	return uint32_t(c.r) << 24 | uint32_t(c.g) << 16 | uint32_t(c.b) << 8 | c.a;
+}
+
+// the instanced variant of a material, for the renderer to merge draws with
+static Graphics::Material *instanced_material(Graphics::Material *mat)
+{
+	Graphics::MaterialDescriptor mdesc = mat->GetDescriptor();
+	mdesc.instanced = true;
+	return Pi::renderer->CloneMaterial(mat, mdesc, Pi::renderer->GetMaterialRenderState(mat));
+}
 
 void Projectile::BuildModel()
 {
@@ -48,6 +74,8 @@ void Projectile::BuildModel()
 	s_glowMat.reset(Pi::renderer->CreateMaterial("unlit", desc, rsd));
 	s_glowMat->SetTexture("texture0"_hash,
 		Graphics::TextureBuilder::Billboard("textures/projectile_w.dds").GetOrCreateTexture(Pi::renderer, "billboard"));
+	s_sideInstMat.reset(instanced_material(s_sideMat.get()));
+	s_glowInstMat.reset(instanced_material(s_glowMat.get()));
 
 	//zero at projectile position
 	//+x down
@@ -110,6 +138,8 @@ void Projectile::FreeModel()
 {
 	s_sideMat.reset();
 	s_glowMat.reset();
+	s_sideInstMat.reset();
+	s_glowInstMat.reset();
 	s_sideMesh.reset();
 	s_glowMesh.reset();
 }
@@ -121,6 +151,7 @@ Projectile::Projectile(Body *parent, const ProjectileData &prData, const vector3
 	m_flags |= FLAG_DRAW_LAST;
 
 	m_parent = parent;
+	Pi::game->GetSpace()->WatchBody(this, m_parent);
 	m_lifespan = prData.lifespan;
 	m_baseDam = prData.damage;
 	m_length = prData.length;
@@ -190,6 +221,7 @@ void Projectile::PostLoadFixup(Space *space)
 {
 	Body::PostLoadFixup(space);
 	m_parent = space->GetBodyByIndex(m_parentIndex);
+	space->WatchBody(this, m_parent);
 }
 
 void Projectile::UpdateInterpTransform(double alpha)
@@ -261,10 +293,10 @@ void Projectile::StaticUpdate(const float timeStep)
 {
 	PROFILE_SCOPED()
 	CollisionContact c;
-	// Collision spaces don't store velocity, so dirvel-only is still wrong but less awful than dirvel+basevel
-	vector3d vel = m_dirVel * timeStep;
+	// sweep the whole step against moving geoms, so fast shots can't skip over small ships
+	const Geom *ignore = m_parent && m_parent->IsType(ObjectType::MODELBODY) ? static_cast<ModelBody *>(m_parent)->GetGeom() : nullptr;
 	Frame *frame = Frame::GetFrame(GetFrame());
-	frame->GetCollisionSpace()->TraceRay(GetPosition(), vel.Normalized(), vel.Length(), &c);
+	frame->GetCollisionSpace()->SweepRay(GetPosition(), m_baseVel + m_dirVel, timeStep, &c, ignore);
 
 	if (c.userData1) {
 		Body *hit = static_cast<Body *>(c.userData1);
@@ -299,11 +331,18 @@ void Projectile::StaticUpdate(const float timeStep)
 void Projectile::Render(Graphics::Renderer *renderer, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform)
 {
 	PROFILE_SCOPED()
-	vector3d _from = viewTransform * GetInterpPosition();
-	vector3d _to = viewTransform * (GetInterpPosition() + m_dirVel);
-	vector3d _dir = _to - _from;
-	vector3f from(&_from.x);
-	vector3f dir = vector3f(_dir).Normalized();
+	// fade them out as they age so they don't suddenly disappear
+	// this matches the damage fall-off calculation
+	const float base_alpha = sqrt(1.0f - m_age / m_lifespan);
+	DrawShot(renderer, viewCoords, viewTransform.ApplyRotationOnly(m_dirVel), m_length, m_width, m_color, base_alpha);
+}
+
+void Projectile::DrawShot(Graphics::Renderer *renderer, const vector3d &viewPos, const vector3d &viewDir, float shotLength, float shotWidth, const Color &shotColor, float baseAlpha)
+{
+	if (!s_sideMat) BuildModel();
+
+	const vector3f from(&viewPos.x);
+	const vector3f dir = vector3f(viewDir).Normalized();
 
 	vector3f v1, v2;
 	matrix4x4f m = matrix4x4f::Identity();
@@ -328,34 +367,86 @@ void Projectile::Render(Graphics::Renderer *renderer, const Camera *camera, cons
 
 	// increase visible size based on distance from camera, z is always negative
 	// allows them to be smaller while maintaining visibility for game play
-	const float dist_scale = float(viewCoords.z / -500);
-	const float length = m_length + dist_scale;
-	const float width = m_width + dist_scale;
+	const float dist_scale = float(viewPos.z / -500);
+	const float length = shotLength + dist_scale;
+	const float width = shotWidth + dist_scale;
 
-	renderer->SetTransform(m * matrix4x4f::ScaleMatrix(width, width, length));
+	const matrix4x4f trans = m * matrix4x4f::ScaleMatrix(width, width, length);
 
-	Color color = m_color;
-	// fade them out as they age so they don't suddenly disappear
-	// this matches the damage fall-off calculation
-	const float base_alpha = sqrt(1.0f - m_age / m_lifespan);
 	// fade out side quads when viewing nearly edge on
-	vector3f view_dir = vector3f(viewCoords).Normalized();
-	color.a = (base_alpha * (1.f - powf(fabs(dir.Dot(view_dir)), length))) * 255;
-
-	if (color.a > 3) {
-		s_sideMat->diffuse = color;
-		renderer->DrawMesh(s_sideMesh.get(), s_sideMat.get());
-	}
-
+	const vector3f view_dir = vector3f(viewPos).Normalized();
+	float sideAlpha = baseAlpha * (1.f - powf(fabs(dir.Dot(view_dir)), length));
 	// fade out glow quads when viewing nearly edge on
 	// these and the side quads fade at different rates
 	// so that they aren't both at the same alpha as that looks strange
-	color.a = (base_alpha * powf(fabs(dir.Dot(view_dir)), width)) * 255;
+	float glowAlpha = baseAlpha * powf(fabs(dir.Dot(view_dir)), width);
+
+	if (s_batching) {
+		sideAlpha = std::round(sideAlpha * BATCH_LEVELS) / BATCH_LEVELS;
+		glowAlpha = std::round(glowAlpha * BATCH_LEVELS) / BATCH_LEVELS;
+	}
 
+	Color color = shotColor;
+	color.a = sideAlpha * 255;
 	if (color.a > 3) {
-		s_glowMat->diffuse = color;
-		renderer->DrawMesh(s_glowMesh.get(), s_glowMat.get());
+		if (s_batching)
+			s_sideBatch.push_back({ trans, color });
+		else {
+			s_sideMat->diffuse = color;
+			renderer->SetTransform(trans);
+			renderer->DrawMesh(s_sideMesh.get(), s_sideMat.get());
+		}
+	}
+
+	color.a = glowAlpha * 255;
+	if (color.a > 3) {
+		if (s_batching)
+			s_glowBatch.push_back({ trans, color });
+		else {
+			s_glowMat->diffuse = color;
+			renderer->SetTransform(trans);
+			renderer->DrawMesh(s_glowMesh.get(), s_glowMat.get());
+		}
+	}
+}
+
+void Projectile::BeginBatch()
+{
+	s_batching = true;
+	s_sideBatch.clear();
+	s_glowBatch.clear();
+}
+
+void Projectile::EndBatch(Graphics::Renderer *renderer)
+{
+	PROFILE_SCOPED()
+	s_batching = false;
+	if (s_sideBatch.empty() && s_glowBatch.empty())
+		return;
+
+	Graphics::Renderer::MatrixTicket ticket(renderer);
+
+	// the shots blend additively without writing depth, so they can be
+	// drawn in any order
+	auto byColor = [](const BatchEntry &a, const BatchEntry &b) {
+		return color_key(a.color) < color_key(b.color);
+	};
+	std::sort(s_sideBatch.begin(), s_sideBatch.end(), byColor);
+	for (const BatchEntry &entry : s_sideBatch) {
+		s_sideMat->diffuse = entry.color;
+		renderer->SetTransform(entry.trans);
+		renderer->DrawMeshBatched(s_sideMesh.get(), s_sideMat.get(), s_sideInstMat.get());
 	}
+
+	std::sort(s_glowBatch.begin(), s_glowBatch.end(), byColor);
+	for (const BatchEntry &entry : s_glowBatch) {
+		s_glowMat->diffuse = entry.color;
+		renderer->SetTransform(entry.trans);
+		renderer->DrawMeshBatched(s_glowMesh.get(), s_glowMat.get(), s_glowInstMat.get());
+	}
+
+	s_sideBatch.clear();
+	s_glowBatch.clear();
 }
 
 void Projectile::Add(Body *parent, float lifespan, float dam, float length, float width, bool mining, const Color &color, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel)
@@ -367,12 +458,15 @@ void Projectile::Add(Body *parent, float lifespan, float dam, float length, floa
 	prData.width = width;
 	prData.mining = mining;
 	prData.color = color;
-	Projectile *p = new Projectile(parent, prData, pos, baseVel, dirVel);
-	Pi::game->GetSpace()->AddBody(p);
+	Add(parent, prData, pos, baseVel, dirVel);
 }
 
 void Projectile::Add(Body *parent, const ProjectileData &prData, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel)
 {
+	if (ProjectilePool::IsEnabled()) {
+		Pi::game->GetSpace()->GetProjectiles()->AddProjectile(parent, prData, pos, baseVel, dirVel);
+		return;
+	}
 	Projectile *p = new Projectile(parent, prData, pos, baseVel, dirVel);
 	Pi::game->GetSpace()->AddBody(p);
 }
@@ -5,7 +5,11 @@
 #define _PROJECTILE_H
 
 #include "Body.h"
+#include "BodyPool.h"
 #include "Color.h"
+#include "matrix4x4.h"
+
+#include <vector>
 
 struct ProjectileData {
 	ProjectileData() :
@@ -28,6 +32,10 @@ struct ProjectileData {
 };
 
 class Frame;
+class SystemBody;
+
+// Spawn the cargo a mining laser breaks off an asteroid at pos
+void MiningLaserSpawnTastyStuff(FrameId fId, const SystemBody *asteroid, const vector3d &pos);
 
 namespace Graphics {
 	class Material;
@@ -38,6 +46,7 @@ namespace Graphics {
 class Projectile : public Body {
 public:
 	OBJDEF(Projectile, Body, PROJECTILE);
+	POOLED_BODY(Projectile, PROJECTILE);
 
 	static void Add(Body *parent, float lifespan, float dam, float length, float width, bool mining, const Color &color, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel);
 	static void Add(Body *parent, const ProjectileData &prData, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel);
@@ -55,6 +64,15 @@ public:
 
 	static void FreeModel();
 
+	// Draw one shot at viewPos, pointing along viewDir, both in view
+	// coordinates; baseAlpha is the fade with age
+	static void DrawShot(Graphics::Renderer *r, const vector3d &viewPos, const vector3d &viewDir, float length, float width, const Color &color, float baseAlpha);
+	// Between BeginBatch and EndBatch shots are queued instead of drawn.
+	// EndBatch draws the queue sorted by colour, so the renderer can merge
+	// the draws of the same colour into instanced draws.
+	static void BeginBatch();
+	static void EndBatch(Graphics::Renderer *r);
+
 protected:
 	virtual void SaveToJson(Json &jsonObj, Space *space) override final;
 
@@ -74,12 +92,23 @@ private:
 
 	int m_parentIndex; // deserialisation
 
+	struct BatchEntry {
+		matrix4x4f trans;
+		Color color;
+	};
+
 	static void BuildModel();
 
 	static std::unique_ptr<Graphics::MeshObject> s_sideMesh;
 	static std::unique_ptr<Graphics::MeshObject> s_glowMesh;
 	static std::unique_ptr<Graphics::Material> s_sideMat;
 	static std::unique_ptr<Graphics::Material> s_glowMat;
+	static std::unique_ptr<Graphics::Material> s_sideInstMat;
+	static std::unique_ptr<Graphics::Material> s_glowInstMat;
+
+	static bool s_batching;
+	static std::vector<BatchEntry> s_sideBatch;
+	static std::vector<BatchEntry> s_glowBatch;
 };
 
 #endif /* _PROJECTILE_H */
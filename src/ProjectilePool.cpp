@@ -0,0 +1,330 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "ProjectilePool.h"
+
+#include "Beam.h"
+#include "Camera.h"
+#include "Frame.h"
+#include "Game.h"
+#include "GameSaveError.h"
+#include "JsonUtils.h"
+#include "ModelBody.h"
+#include "Pi.h"
+#include "Planet.h"
+#include "Projectile.h"
+#include "Sfx.h"
+#include "Ship.h"
+#include "Space.h"
+#include "collider/CollisionContact.h"
+#include "collider/CollisionSpace.h"
+#include "galaxy/SystemBody.h"
+#include "graphics/Graphics.h"
+#include "graphics/Renderer.h"
+#include "lua/LuaEvent.h"
+
+#include <algorithm>
+#include <numeric>
+
+// how long a beam pulse is drawn, as for Beam bodies
+static const float BEAM_LIFETIME = 0.1f;
+static const float BEAM_WIDTH = 1.0f;
+
+bool ProjectilePool::s_enabled = true;
+
+ProjectilePool::ProjectilePool()
+{
+}
+
+ProjectilePool::~ProjectilePool()
+{
+}
+
+void ProjectilePool::ToJson(Json &jsonObj, Space *space) const
+{
+	Json shotArray = Json::array();
+	for (size_t i = 0; i < m_frame.size(); i++) {
+		if (m_flags[i] & SHOT_DEAD)
+			continue;
+
+		Json shotObj({});
+		shotObj["index_for_frame"] = m_frame[i];
+		shotObj["pos"] = m_pos[i];
+		shotObj["base_vel"] = m_baseVel[i];
+		shotObj["dir_vel"] = m_dirVel[i];
+		shotObj["age"] = m_age[i];
+		shotObj["life_span"] = m_lifespan[i];
+		shotObj["base_dam"] = m_damage[i];
+		shotObj["length"] = m_length[i];
+		shotObj["width"] = m_width[i];
+		shotObj["color"] = m_color[i];
+		shotObj["flags"] = m_flags[i];
+		shotObj["index_for_body"] = space->GetIndexForBody(m_parent[i]);
+		shotArray.push_back(shotObj);
+	}
+	jsonObj = shotArray;
+}
+
+void ProjectilePool::FromJson(const Json &jsonObj, Space *space)
+{
+	try {
+		for (const Json &shotObj : jsonObj.get<Json::array_t>()) {
+			m_frame.push_back(shotObj["index_for_frame"].get<FrameId>());
+			m_pos.push_back(shotObj["pos"].get<vector3d>());
+			m_baseVel.push_back(shotObj["base_vel"].get<vector3d>());
+			m_dirVel.push_back(shotObj["dir_vel"].get<vector3d>());
+			m_age.push_back(shotObj["age"].get<float>());
+			m_lifespan.push_back(shotObj["life_span"].get<float>());
+			m_damage.push_back(shotObj["base_dam"].get<float>());
+			m_length.push_back(shotObj["length"].get<float>());
+			m_width.push_back(shotObj["width"].get<float>());
+			m_color.push_back(shotObj["color"].get<Color>());
+			m_flags.push_back(shotObj["flags"].get<Uint8>());
+			m_parent.push_back(space->GetBodyByIndex(shotObj["index_for_body"].get<Uint32>()));
+		}
+	} catch (Json::type_error &) {
+		throw SavedGameCorruptException();
+	}
+}
+
+void ProjectilePool::Add(Body *parent, const ProjectileData &prData, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel, float lifespan, float width, Uint8 flags)
+{
+	if (prData.mining)
+		flags |= SHOT_MINING;
+
+	m_frame.push_back(parent->GetFrame());
+	m_pos.push_back(pos);
+	m_baseVel.push_back(baseVel);
+	m_dirVel.push_back(dirVel);
+	m_age.push_back(0.0f);
+	m_lifespan.push_back(lifespan);
+	m_damage.push_back(prData.damage);
+	m_length.push_back(prData.length);
+	m_width.push_back(width);
+	m_color.push_back(prData.color);
+	m_flags.push_back(flags);
+	m_parent.push_back(parent);
+}
+
+void ProjectilePool::AddProjectile(Body *parent, const ProjectileData &prData, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel)
+{
+	Add(parent, prData, pos, baseVel, dirVel, prData.lifespan, prData.width, 0);
+}
+
+void ProjectilePool::AddBeam(Body *parent, const ProjectileData &prData, const vector3d &pos, const vector3d &baseVel, const vector3d &dir)
+{
+	Add(parent, prData, pos, baseVel, dir, BEAM_LIFETIME, BEAM_WIDTH, SHOT_BEAM);
+}
+
+void ProjectilePool::NotifyRemoved(const std::vector<const Body *> &removedBodies)
+{
+	if (removedBodies.empty())
+		return;
+
+	for (Body *&parent : m_parent) {
+		if (parent && std::binary_search(removedBodies.begin(), removedBodies.end(), parent))
+			parent = nullptr;
+	}
+}
+
+/* In hull kg */
+float ProjectilePool::GetDamage(size_t i) const
+{
+	if (m_flags[i] & SHOT_BEAM)
+		return m_damage[i];
+	return m_damage[i] * sqrt((m_lifespan[i] - m_age[i]) / m_lifespan[i]);
+}
+
+void ProjectilePool::Hit(size_t i, Body *hit, const CollisionContact &c)
+{
+	Body *parent = m_parent[i];
+	if (hit == parent)
+		return;
+
+	hit->OnDamage(parent, GetDamage(i), c);
+	// a beam is not stopped by what it hits, it only stops doing damage
+	m_flags[i] |= (m_flags[i] & SHOT_BEAM) ? SHOT_SPENT : SHOT_DEAD;
+	if (hit->IsType(ObjectType::SHIP))
+		LuaEvent::Queue("onShipHit", dynamic_cast<Ship *>(hit), parent);
+}
+
+void ProjectilePool::MiningHit(size_t i)
+{
+	// mining lasers can break off chunks of terrain
+	Body *frameBody = Frame::GetFrame(m_frame[i])->GetBody();
+	if (!frameBody || !frameBody->IsType(ObjectType::PLANET))
+		return;
+
+	Planet *const planet = static_cast<Planet *>(frameBody);
+	const vector3d &pos = m_pos[i];
+	const double terrainHeight = planet->GetTerrainHeight(pos.Normalized());
+	if (terrainHeight <= pos.Length())
+		return;
+
+	const SystemBody *b = planet->GetSystemBody();
+	if (b->GetType() == SystemBody::TYPE_PLANET_ASTEROID) {
+		const vector3d n = pos.Normalized();
+		MiningLaserSpawnTastyStuff(planet->GetFrame(), b, n * terrainHeight + 5.0 * n);
+		SfxManager::Add(m_frame[i], pos, vector3d(0.0), TYPE_EXPLOSION);
+	}
+	m_flags[i] |= (m_flags[i] & SHOT_BEAM) ? SHOT_SPENT : SHOT_DEAD;
+}
+
+void ProjectilePool::TimeStep(float timeStep)
+{
+	PROFILE_SCOPED()
+	const size_t count = m_frame.size();
+	if (!count)
+		return;
+
+	// sweep the projectiles of each frame through its collision space in
+	// one go, the whole step against moving geoms so that fast shots can't
+	// skip over small ships
+	m_sweepIndex.resize(count);
+	std::iota(m_sweepIndex.begin(), m_sweepIndex.end(), 0);
+	std::stable_sort(m_sweepIndex.begin(), m_sweepIndex.end(), [this](Uint32 a, Uint32 b) {
+		return m_frame[a].id() < m_frame[b].id();
+	});
+
+	for (size_t begin = 0; begin < count;) {
+		const FrameId frameId = m_frame[m_sweepIndex[begin]];
+		CollisionSpace *collSpace = Frame::GetFrame(frameId)->GetCollisionSpace();
+
+		m_sweepPos.clear();
+		m_sweepVel.clear();
+		m_sweepIgnore.clear();
+		size_t end = begin;
+		for (; end < count && m_frame[m_sweepIndex[end]] == frameId; end++) {
+			const Uint32 i = m_sweepIndex[end];
+			Body *parent = m_parent[i];
+			const Geom *ignore = parent && parent->IsType(ObjectType::MODELBODY) ? static_cast<ModelBody *>(parent)->GetGeom() : nullptr;
+
+			if (m_flags[i] & SHOT_BEAM) {
+				// This is just to stop it from hitting things repeatedly, it's dead in effect but still rendered
+				if (m_flags[i] & SHOT_SPENT)
+					continue;
+				CollisionContact c;
+				collSpace->TraceRay(m_pos[i], m_dirVel[i].Normalized(), m_length[i], &c, ignore);
+				if (c.userData1)
+					Hit(i, static_cast<Body *>(c.userData1), c);
+				continue;
+			}
+
+			// the projectiles are swept together below, reorder them to
+			// the front of this frame's range
+			m_sweepIndex[begin + m_sweepPos.size()] = i;
+			m_sweepPos.push_back(m_pos[i]);
+			m_sweepVel.push_back(m_baseVel[i] + m_dirVel[i]);
+			m_sweepIgnore.push_back(ignore);
+		}
+
+		const size_t numSweeps = m_sweepPos.size();
+		m_sweepContact.resize(numSweeps);
+		collSpace->SweepRays(numSweeps, m_sweepPos.data(), m_sweepVel.data(), timeStep, m_sweepContact.data(), m_sweepIgnore.data());
+		for (size_t s = 0; s < numSweeps; s++) {
+			const CollisionContact &c = m_sweepContact[s];
+			if (c.userData1)
+				Hit(m_sweepIndex[begin + s], static_cast<Body *>(c.userData1), c);
+		}
+
+		begin = end;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if ((m_flags[i] & SHOT_MINING) && !(m_flags[i] & (SHOT_SPENT | SHOT_DEAD)))
+			MiningHit(i);
+	}
+
+	// move and age them, beams drift with their parent's velocity
+	for (size_t i = 0; i < count; i++) {
+		const vector3d vel = (m_flags[i] & SHOT_BEAM) ? m_baseVel[i] : m_baseVel[i] + m_dirVel[i];
+		m_pos[i] += vel * double(timeStep);
+		m_age[i] += timeStep;
+		if (m_age[i] > m_lifespan[i])
+			m_flags[i] |= SHOT_DEAD;
+	}
+
+	RemoveDead();
+}
+
+void ProjectilePool::RemoveDead()
+{
+	size_t i = 0;
+	while (i < m_frame.size()) {
+		if (!(m_flags[i] & SHOT_DEAD)) {
+			i++;
+			continue;
+		}
+
+		const size_t last = m_frame.size() - 1;
+		if (i != last) {
+			m_frame[i] = m_frame[last];
+			m_pos[i] = m_pos[last];
+			m_baseVel[i] = m_baseVel[last];
+			m_dirVel[i] = m_dirVel[last];
+			m_age[i] = m_age[last];
+			m_lifespan[i] = m_lifespan[last];
+			m_damage[i] = m_damage[last];
+			m_length[i] = m_length[last];
+			m_width[i] = m_width[last];
+			m_color[i] = m_color[last];
+			m_flags[i] = m_flags[last];
+			m_parent[i] = m_parent[last];
+		}
+		m_frame.pop_back();
+		m_pos.pop_back();
+		m_baseVel.pop_back();
+		m_dirVel.pop_back();
+		m_age.pop_back();
+		m_lifespan.pop_back();
+		m_damage.pop_back();
+		m_length.pop_back();
+		m_width.pop_back();
+		m_color.pop_back();
+		m_flags.pop_back();
+		m_parent.pop_back();
+	}
+}
+
+void ProjectilePool::Render(Graphics::Renderer *r, const CameraContext *context, float minPixelSize) const
+{
+	PROFILE_SCOPED()
+	const FrameId camFrame = context->GetTempFrame();
+	const Graphics::Frustum &frustum = context->GetFrustum();
+	const double pixelScale = r->GetWindowHeight() * 2.0 / Graphics::GetFovFactor();
+
+	// shots are drawn where they were between the last two steps, like bodies
+	const double behind = (1.0 - Pi::GetGameTickAlpha()) * Pi::game->GetTimeStep();
+
+	// most shots are in a few frames, so keep the transform of the last one
+	FrameId lastFrame;
+	matrix4x4d viewTransform;
+
+	for (size_t i = 0; i < m_frame.size(); i++) {
+		if (m_frame[i] != lastFrame) {
+			Frame *f = Frame::GetFrame(m_frame[i]);
+			viewTransform = f->GetInterpOrientRelTo(camFrame);
+			viewTransform.SetTranslate(f->GetInterpPositionRelTo(camFrame));
+			lastFrame = m_frame[i];
+		}
+
+		const bool beam = m_flags[i] & SHOT_BEAM;
+		const vector3d vel = beam ? m_baseVel[i] : m_baseVel[i] + m_dirVel[i];
+		const vector3d viewCoords = viewTransform * (m_pos[i] - vel * behind);
+
+		const double rad = sqrt(m_length[i] * m_length[i] + m_width[i] * m_width[i]);
+		if (!frustum.TestPointInfinite(viewCoords, rad))
+			continue;
+		if (pixelScale * rad / viewCoords.Length() < minPixelSize)
+			continue;
+
+		if (beam) {
+			Beam::DrawShot(r, viewCoords, viewTransform.ApplyRotationOnly(-m_dirVel[i]), m_length[i], m_width[i], m_color[i], 1.0f);
+		} else {
+			// fade them out as they age so they don't suddenly disappear
+			// this matches the damage fall-off calculation
+			const float base_alpha = sqrt(1.0f - m_age[i] / m_lifespan[i]);
+			Projectile::DrawShot(r, viewCoords, viewTransform.ApplyRotationOnly(m_dirVel[i]), m_length[i], m_width[i], m_color[i], base_alpha);
+		}
+	}
+}
@@ -0,0 +1,101 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _PROJECTILEPOOL_H
+#define _PROJECTILEPOOL_H
+
+#include "Color.h"
+#include "FrameId.h"
+#include "JsonFwd.h"
+#include "vector3.h"
+
+#include <SDL_stdinc.h>
+#include <vector>
+
+class Body;
+class CameraContext;
+class Geom;
+struct CollisionContact;
+class Space;
+struct ProjectileData;
+
+namespace Graphics {
+	class Renderer;
+}
+
+// The shots of projectile and beam weapons, one entry per shot in contiguous
+// arrays instead of one Body each. A shot only hits things and gets drawn;
+// nothing else looks for it, so a battle filling a frame with thousands of
+// them costs a pass over these arrays rather than thousands of bodies to
+// update, notify of removals and sort for drawing.
+//
+// A removed shot is replaced by the last one, so shots don't keep an index.
+class ProjectilePool {
+public:
+	ProjectilePool();
+	~ProjectilePool();
+
+	// the parents are looked up in the body index of the space
+	void ToJson(Json &jsonObj, Space *space) const;
+	void FromJson(const Json &jsonObj, Space *space);
+
+	void AddProjectile(Body *parent, const ProjectileData &prData, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel);
+	void AddBeam(Body *parent, const ProjectileData &prData, const vector3d &pos, const vector3d &baseVel, const vector3d &dir);
+
+	// Hit test, then move and age every shot, like the StaticUpdate and
+	// TimeStepUpdate of the shot bodies
+	void TimeStep(float timeStep);
+	// the removed bodies are sorted
+	void NotifyRemoved(const std::vector<const Body *> &removedBodies);
+
+	// Draw the shots seen from the context, skipping those smaller than
+	// minPixelSize on screen
+	void Render(Graphics::Renderer *r, const CameraContext *context, float minPixelSize) const;
+
+	size_t GetNumShots() const { return m_frame.size(); }
+
+	// new shots go into the pool instead of being added as bodies
+	static void SetEnabled(bool enabled) { s_enabled = enabled; }
+	static bool IsEnabled() { return s_enabled; }
+
+private:
+	enum ShotFlags : Uint8 {
+		SHOT_BEAM = (1 << 0),
+		SHOT_MINING = (1 << 1),
+		// a beam that has hit something is still drawn until it dies
+		SHOT_SPENT = (1 << 2),
+		SHOT_DEAD = (1 << 3),
+	};
+
+	void Add(Body *parent, const ProjectileData &prData, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel, float lifespan, float width, Uint8 flags);
+	float GetDamage(size_t i) const;
+	void Hit(size_t i, Body *hit, const CollisionContact &c);
+	void MiningHit(size_t i);
+	void RemoveDead();
+
+	std::vector<FrameId> m_frame;
+	std::vector<vector3d> m_pos;
+	std::vector<vector3d> m_baseVel;
+	// the velocity of a projectile relative to its parent, or the direction
+	// of a beam
+	std::vector<vector3d> m_dirVel;
+	std::vector<float> m_age;
+	std::vector<float> m_lifespan;
+	std::vector<float> m_damage;
+	std::vector<float> m_length;
+	std::vector<float> m_width;
+	std::vector<Color> m_color;
+	std::vector<Uint8> m_flags;
+	std::vector<Body *> m_parent;
+
+	// scratch for the batched sweeps
+	std::vector<Uint32> m_sweepIndex;
+	std::vector<vector3d> m_sweepPos;
+	std::vector<vector3d> m_sweepVel;
+	std::vector<const Geom *> m_sweepIgnore;
+	std::vector<CollisionContact> m_sweepContact;
+
+	static bool s_enabled;
+};
+
+#endif /* _PROJECTILEPOOL_H */
@@ -0,0 +1,130 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "QualityGovernor.h"
+
+#include "core/Log.h"
+
+#include <algorithm>
+
+QualityGovernor::QualityGovernor(float targetMs) :
+	m_targetMs(targetMs),
+	m_framePercentile(0.0f),
+	m_gpuPercentile(0.0f),
+	m_state(STATE_MEASURING),
+	m_underSince(-1.0),
+	m_raiseHold(RAISE_HOLD),
+	m_lastKnob(-1),
+	m_lastRaised(false),
+	m_lastChangeTime(0.0),
+	m_settling(false)
+{
+	m_frameSamples.reserve(WINDOW_FRAMES);
+	m_gpuSamples.reserve(WINDOW_FRAMES);
+}
+
+void QualityGovernor::AddKnob(const Knob &knob)
+{
+	m_knobs.push_back(knob);
+}
+
+float QualityGovernor::Percentile(std::vector<float> &samples)
+{
+	auto nth = samples.begin() + std::min(samples.size() - 1, size_t(PERCENTILE * samples.size()));
+	std::nth_element(samples.begin(), nth, samples.end());
+	return *nth;
+}
+
+void QualityGovernor::Changed(int knob, double time)
+{
+	const Knob &k = m_knobs[knob];
+	Log::Verbose("Quality governor: {} {} to {}, frames at {:.2f} ms, GPU at {:.2f} ms\n",
+		k.name, m_lastRaised ? "up" : "down", k.get(), m_framePercentile, m_gpuPercentile);
+
+	m_lastKnob = knob;
+	m_lastChangeTime = time;
+	m_settling = true;
+}
+
+bool QualityGovernor::Lower(double time)
+{
+	for (int idx = 0; idx < int(m_knobs.size()); idx++) {
+		const Knob &knob = m_knobs[idx];
+		const int level = knob.get();
+		if (level <= knob.min || (knob.canChange && !knob.canChange()))
+			continue;
+
+		// taking back a raise that didn't fit waits longer before the next
+		if (m_lastRaised && time - m_lastChangeTime < m_raiseHold)
+			m_raiseHold = std::min(m_raiseHold * 2.0, MAX_RAISE_HOLD);
+		else
+			m_raiseHold = RAISE_HOLD;
+
+		knob.set(level - 1);
+		m_lastRaised = false;
+		Changed(idx, time);
+		return true;
+	}
+	return false;
+}
+
+bool QualityGovernor::Raise(double time)
+{
+	for (int idx = int(m_knobs.size()) - 1; idx >= 0; idx--) {
+		const Knob &knob = m_knobs[idx];
+		const int level = knob.get();
+		if (level >= knob.max || (knob.canChange && !knob.canChange()))
+			continue;
+
+		knob.set(level + 1);
+		m_lastRaised = true;
+		Changed(idx, time);
+		return true;
+	}
+	return false;
+}
+
+void QualityGovernor::Update(double time, float frameMs, float gpuMs)
+{
+	m_frameSamples.push_back(frameMs);
+	if (gpuMs > 0.0f)
+		m_gpuSamples.push_back(gpuMs);
+	if (m_frameSamples.size() < WINDOW_FRAMES)
+		return;
+
+	m_framePercentile = Percentile(m_frameSamples);
+	m_gpuPercentile = m_gpuSamples.empty() ? 0.0f : Percentile(m_gpuSamples);
+	m_frameSamples.clear();
+	m_gpuSamples.clear();
+
+	if (m_settling) {
+		m_settling = false;
+		m_state = STATE_MEASURING;
+		return;
+	}
+
+	const float load = std::max(m_framePercentile, m_gpuPercentile);
+	if (load > m_targetMs * (1.0f + LOWER_MARGIN)) {
+		m_underSince = -1.0;
+		m_state = Lower(time) ? STATE_MEASURING : STATE_OVER_BUDGET;
+	} else if (load < m_targetMs * RAISE_FRACTION) {
+		const bool belowMax = std::any_of(m_knobs.begin(), m_knobs.end(), [](const Knob &knob) { return knob.get() < knob.max; });
+		if (!belowMax) {
+			m_underSince = -1.0;
+			m_state = STATE_STEADY;
+			return;
+		}
+
+		if (m_underSince < 0.0)
+			m_underSince = time;
+		if (time - m_underSince >= m_raiseHold && Raise(time)) {
+			m_underSince = -1.0;
+			m_state = STATE_MEASURING;
+		} else {
+			m_state = STATE_WAITING_TO_RAISE;
+		}
+	} else {
+		m_underSince = -1.0;
+		m_state = STATE_STEADY;
+	}
+}
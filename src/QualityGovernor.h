@@ -0,0 +1,99 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _QUALITYGOVERNOR_H
+#define _QUALITYGOVERNOR_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Holds the frame time near a target by turning detail settings ("knobs")
+// down when frames take too long, and back up when there has long been time
+// to spare. The measure is the 90th percentile of the frame times since the
+// last change, and of the GPU times where the renderer has them; frames are
+// never faster than the display with vsync, so the target wants to be above
+// its refresh interval.
+//
+// Knobs go down as soon as a window of frames is over the target by
+// LOWER_MARGIN, one step at a time, and only come up once every window has
+// been under RAISE_FRACTION of it for the raise hold. A change that has to
+// be taken back soon after doubles the hold, so a setting right at the edge
+// isn't flipped back and forth. The first knob added is the first to be
+// turned down and the last to be turned up again. A change that would be
+// seen (rebuilding the terrain of a planet in view, say) waits until the
+// knob's canChange says it wouldn't be; the other knobs are used meanwhile.
+class QualityGovernor {
+public:
+	struct Knob {
+		std::string name;
+		int min;
+		int max;
+		std::function<int()> get;
+		std::function<void(int)> set;
+		// empty if the knob can change at any time
+		std::function<bool()> canChange;
+	};
+
+	enum State {
+		// filling the first window, or the one after a change
+		STATE_MEASURING,
+		STATE_STEADY,
+		// over the target with nothing it can turn down now
+		STATE_OVER_BUDGET,
+		STATE_WAITING_TO_RAISE
+	};
+
+	QualityGovernor(float targetMs);
+
+	void AddKnob(const Knob &knob);
+
+	// time is the wall clock in seconds; gpuMs is 0 when not known
+	void Update(double time, float frameMs, float gpuMs);
+
+	float GetTargetMs() const { return m_targetMs; }
+	State GetState() const { return m_state; }
+	const std::vector<Knob> &GetKnobs() const { return m_knobs; }
+	// of the last full window
+	float GetFramePercentile() const { return m_framePercentile; }
+	float GetGPUPercentile() const { return m_gpuPercentile; }
+	double GetRaiseHold() const { return m_raiseHold; }
+	// -1 before the first change
+	int GetLastChangedKnob() const { return m_lastKnob; }
+	double GetLastChangeTime() const { return m_lastChangeTime; }
+
+	static constexpr size_t WINDOW_FRAMES = 60;
+	static constexpr float PERCENTILE = 0.9f;
+	static constexpr float LOWER_MARGIN = 0.1f;
+	static constexpr float RAISE_FRACTION = 0.75f;
+	// seconds
+	static constexpr double RAISE_HOLD = 10.0;
+	static constexpr double MAX_RAISE_HOLD = 160.0;
+
+private:
+	static float Percentile(std::vector<float> &samples);
+
+	bool Lower(double time);
+	bool Raise(double time);
+	void Changed(int knob, double time);
+
+	float m_targetMs;
+	std::vector<Knob> m_knobs;
+
+	std::vector<float> m_frameSamples;
+	std::vector<float> m_gpuSamples;
+	float m_framePercentile;
+	float m_gpuPercentile;
+
+	State m_state;
+	// when the frames first had time to spare, or negative
+	double m_underSince;
+	double m_raiseHold;
+	int m_lastKnob;
+	bool m_lastRaised;
+	double m_lastChangeTime;
+	// the window after a change is left out, it has the cost of making it
+	bool m_settling;
+};
+
+#endif /* _QUALITYGOVERNOR_H */
@@ -10,6 +10,7 @@
 #ifndef RAND_H
 #define RAND_H
 
+#include <algorithm>
 #include <assert.h>
 #include <cmath>
 #include <cstdint>
@@ -27,7 +28,51 @@ extern "C" {
 
 // A deterministic random number generator
 class Random : public RefCounted {
-	pcg32 mPCG;
+	// pcg32, with its state opened up to step several lanes of the sequence
+	// at once
+	class Engine : public pcg32 {
+	public:
+		// The next count numbers, as count calls of operator() give them
+		void Fill(Uint32 *out, size_t count)
+		{
+			// lane i starts i steps along and every lane takes LANES steps at
+			// a time, so the lanes are independent of each other and the
+			// compiler can interleave or vectorise them
+			constexpr size_t LANES = 8;
+			if (count < LANES * 2) {
+				for (size_t idx = 0; idx < count; idx++)
+					out[idx] = (*this)();
+				return;
+			}
+
+			state_type lanes[LANES];
+			lanes[0] = state_;
+			for (size_t lane = 1; lane < LANES; lane++)
+				lanes[lane] = bump(lanes[lane - 1]);
+
+			// LANES steps of the LCG taken as one
+			state_type mult = 1u, inc = 0u;
+			for (size_t lane = 0; lane < LANES; lane++) {
+				inc = inc * multiplier() + increment();
+				mult *= multiplier();
+			}
+
+			const size_t numBlocks = count / LANES;
+			for (size_t block = 0; block < numBlocks; block++) {
+				Uint32 *blockOut = out + block * LANES;
+				for (size_t lane = 0; lane < LANES; lane++) {
+					blockOut[lane] = output(lanes[lane]);
+					lanes[lane] = lanes[lane] * mult + inc;
+				}
+			}
+
+			state_ = lanes[0];
+			for (size_t idx = numBlocks * LANES; idx < count; idx++)
+				out[idx] = (*this)();
+		}
+	};
+
+	Engine mPCG;
 
 	// For storing second rand from Normal
 	bool cached;
@@ -231,6 +276,60 @@ public:
 		return k;
 	}
 
+	//
+	// Bulk generators.
+	//
+	// Each fills out with count numbers, exactly those that count calls of
+	// the generator of the same name would return in turn, and leaves the
+	// sequence where those calls would. Long runs are generated several
+	// numbers at a time, which is much faster than calling one by one.
+	//
+
+	// interval [0, 2**32)
+	void FillInt32(Uint32 *out, size_t count)
+	{
+		mPCG.Fill(out, count);
+	}
+
+	// interval [0, choices)
+	void FillInt32(Uint32 *out, size_t count, const int choices)
+	{
+		mPCG.Fill(out, count);
+		for (size_t idx = 0; idx < count; idx++)
+			out[idx] %= choices;
+	}
+
+	// interval [min, max]
+	void FillInt32(int *out, size_t count, const int min, const int max)
+	{
+		static_assert(sizeof(int) == sizeof(Uint32), "ints are filled in place");
+		Uint32 *values = reinterpret_cast<Uint32 *>(out);
+		mPCG.Fill(values, count);
+		for (size_t idx = 0; idx < count; idx++)
+			out[idx] = (values[idx] % (1 + max - min)) + min;
+	}
+
+	// interval [0, 1), as Double()
+	void FillDouble(double *out, size_t count)
+	{
+		FillDouble(out, count, 0.0, 1.0);
+	}
+
+	// interval [min, limit), as Double(min, limit)
+	void FillDouble(double *out, size_t count, double min, double limit)
+	{
+		// generated in chunks, so that doubles can take the place of the
+		// numbers they're made of
+		constexpr size_t CHUNK_SIZE = 256;
+		Uint32 values[CHUNK_SIZE];
+		for (size_t start = 0; start < count; start += CHUNK_SIZE) {
+			const size_t num = std::min(CHUNK_SIZE, count - start);
+			mPCG.Fill(values, num);
+			for (size_t idx = 0; idx < num; idx++)
+				out[start + idx] = (limit - min) * (double(values[idx]) * (1. / 4294967296.)) + min;
+		}
+	}
+
 	// Pick a fixed-point integer half open interval [0,1)
 	inline fixed Fixed()
 	{
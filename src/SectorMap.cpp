@@ -31,6 +31,10 @@ static const int DRAW_RAD = 5;
 #define INNER_RADIUS (Sector::SIZE * 1.5f)
 #define OUTER_RADIUS (Sector::SIZE * float(DRAW_RAD))
 static const float FAR_THRESHOLD = 7.5f;
+// edge length in sectors of the blocks DrawFarSectors() skips if they are empty
+static const int FAR_BLOCK_SIZE = 8;
+// far chunks built per frame, so moving the view never stalls on the build
+static const int FAR_CHUNKS_PER_FRAME = 4;
 static const float FAR_LIMIT = 36.f;
 static const float FAR_MAX = 46.f;
 
@@ -514,6 +518,9 @@ void SectorMap::InitDefaults()
 	const float farPos = static_cast<float>(INT_MAX);
 	m_secPosFar = vector3f(farPos, farPos, farPos);
 	m_radiusFar = 0;
+	m_farQuadsSize = 0.f;
+	m_farSectorsPublished = 0;
+	m_farSectorsMissing = false;
 	m_cacheXMin = 0;
 	m_cacheXMax = 0;
 	m_cacheYMin = 0;
@@ -522,6 +529,8 @@ void SectorMap::InitDefaults()
 	m_cacheYMax = 0;
 
 	m_sectorCache = m_context.galaxy->NewSectorSlaveCache();
+	m_onSectorAdded = m_sectorCache->onAdded.connect([this](Sector *sec) { m_nameIndex.AddSector(sec); });
+	m_onSectorRemoved = m_sectorCache->onRemoved.connect([this](Sector *sec) { m_nameIndex.RemoveSector(sec->GetPath()); });
 	InputBindings.RegisterBindings();
 	m_size.x = m_context.renderer->GetWindowWidth();
 	m_size.y = m_context.renderer->GetWindowHeight();
@@ -556,7 +565,11 @@ void SectorMap::InitObject()
 	m_drawList.reset(new ImDrawList(ImGui::GetDrawListSharedData()));
 }
 
-SectorMap::~SectorMap() {}
+SectorMap::~SectorMap()
+{
+	m_onSectorAdded.disconnect();
+	m_onSectorRemoved.disconnect();
+}
 
 void SectorMap::SaveToJson(Json &jsonObj)
 {
@@ -1038,6 +1051,28 @@ void SectorMap::DrawNearSector(const int sx, const int sy, const int sz, const m
 	}
 }
 
+bool SectorMap::IsEmptySpace(const SystemPath &min, const SystemPath &max) const
+{
+	return m_context.galaxy->GetMaxSectorDensity(min, max) == 0 && !m_context.galaxy->GetCustomSystems()->HasCustomSystemsIn(min, max);
+}
+
+// the largest distance of a point of the box [lo, hi] from the centre
+static float farthest_in_box(const vector3f &lo, const vector3f &hi, const vector3f &centre)
+{
+	const vector3f a = lo - centre;
+	const vector3f b = hi - centre;
+	return vector3f(std::max(fabsf(a.x), fabsf(b.x)), std::max(fabsf(a.y), fabsf(b.y)), std::max(fabsf(a.z), fabsf(b.z))).Length();
+}
+
+static bool same_orient(const matrix4x4f &a, const matrix4x4f &b)
+{
+	for (int i : { 0, 1, 2, 4, 5, 6, 8, 9, 10 }) {
+		if (a[i] != b[i])
+			return false;
+	}
+	return true;
+}
+
 void SectorMap::DrawFarSectors(const matrix4x4f &modelview)
 {
 	PROFILE_SCOPED()
@@ -1046,64 +1081,210 @@ void SectorMap::DrawFarSectors(const matrix4x4f &modelview)
 
 	const vector3f secOrigin = vector3f(int(floorf(m_pos.x)), int(floorf(m_pos.y)), int(floorf(m_pos.z)));
 
-	// build vertex and colour arrays for all the stars we want to see, if we don't already have them
-	if (m_toggledFaction || buildRadius != m_radiusFar || !secOrigin.ExactlyEqual(m_secPosFar)) {
-		m_farstars.clear();
-		m_farstarsColor.clear();
-		m_visibleFactions.clear();
-
-		for (int sx = secOrigin.x - buildRadius; sx <= secOrigin.x + buildRadius; sx++) {
-			for (int sy = secOrigin.y - buildRadius; sy <= secOrigin.y + buildRadius; sy++) {
-				for (int sz = secOrigin.z - buildRadius; sz <= secOrigin.z + buildRadius; sz++) {
-					if ((vector3f(sx, sy, sz) - secOrigin).Length() <= buildRadius) {
-						BuildFarSector(GetCached(SystemPath(sx, sy, sz)), Sector::SIZE * secOrigin, m_farstars, m_farstarsColor);
-					}
-				}
-			}
+	m_sectorCache->PublishPending();
+	if (!m_sectorCache->IsFilling())
+		m_farSectorsRequested.clear();
+
+	// pick up the sectors that have been generated since the last build
+	const bool farSectorsArrived = m_farSectorsMissing &&
+		(m_sectorCache->GetNumPublished() != m_farSectorsPublished || m_farSectorsRequested.empty());
+
+	// find the chunks we want to see that we don't already have
+	if (m_toggledFaction || farSectorsArrived || buildRadius != m_radiusFar || !secOrigin.ExactlyEqual(m_secPosFar)) {
+		if (m_toggledFaction) {
+			for (auto &chunk : m_farChunks)
+				chunk.second->valid = false;
 		}
 
+		QueueFarChunks(secOrigin, buildRadius);
+
+		m_farSectorsPublished = m_sectorCache->GetNumPublished();
 		m_secPosFar = secOrigin;
 		m_radiusFar = buildRadius;
 		m_toggledFaction = false;
 	}
 
-	// always draw the stars, slightly altering their size for different different resolutions, so they still look okay
-	if (m_farstars.size() > 0) {
-		// TODO: this should query screen DPI instead of platform window height
-		float sizeFactor = 0.25f * (m_context.renderer->GetWindowHeight() / 720.f);
-		m_farstarsPoints.SetData(m_context.renderer, m_farstars.size(), &m_farstars[0], &m_farstarsColor[0], modelview, sizeFactor);
-		m_farstarsPoints.Draw(m_context.renderer, m_farStarsMat.Get());
+	// build a few of them; the others keep showing what they had until then.
+	// Generating the sectors can take seconds when zoomed out, so the
+	// missing ones are left to the cache jobs instead of blocking on them
+	if (!m_farBuildQueue.empty()) {
+		SectorCache::PathVector missing;
+		const size_t count = std::min(m_farBuildQueue.size(), size_t(FAR_CHUNKS_PER_FRAME));
+		for (size_t i = 0; i < count; i++) {
+			const SystemPath &block = m_farBuildQueue[m_farBuildQueue.size() - 1 - i];
+			std::unique_ptr<FarChunk> &chunk = m_farChunks[block];
+			if (!chunk)
+				chunk.reset(new FarChunk());
+			BuildFarChunk(block, *chunk, missing);
+		}
+		m_farBuildQueue.resize(m_farBuildQueue.size() - count);
+
+		if (!missing.empty())
+			m_sectorCache->FillCache(missing);
+	}
+
+	m_farSectorsMissing = false;
+	m_visibleFactions.clear();
+	for (const auto &chunk : m_farChunks) {
+		m_farSectorsMissing |= !chunk.second->complete;
+		m_visibleFactions.insert(chunk.second->factions.begin(), chunk.second->factions.end());
+	}
+
+	// always draw the stars, slightly altering their size for different different resolutions, so they still look okay.
+	// The billboards only have to be made again when the view turns, not when it moves
+	// TODO: this should query screen DPI instead of platform window height
+	const float sizeFactor = 0.25f * (m_context.renderer->GetWindowHeight() / 720.f);
+	const bool quadsValid = sizeFactor == m_farQuadsSize && same_orient(modelview, m_farQuadsView);
+	m_farQuadsView = modelview;
+	m_farQuadsSize = sizeFactor;
+
+	for (auto &entry : m_farChunks) {
+		FarChunk &chunk = *entry.second;
+		if (chunk.stars.empty())
+			continue;
+
+		if (!quadsValid || !chunk.quadsValid) {
+			chunk.points.SetData(m_context.renderer, chunk.stars.size(), &chunk.stars[0], &chunk.colors[0], modelview, sizeFactor);
+			chunk.quadsValid = true;
+		}
+
+		const SystemPath &block = entry.first;
+		matrix4x4f trans = modelview;
+		trans.Translate(Sector::SIZE * (vector3f(block.sectorX, block.sectorY, block.sectorZ) - secOrigin));
+		m_context.renderer->SetTransform(trans);
+		chunk.points.Draw(m_context.renderer, m_farStarsMat.Get());
 	}
+	m_context.renderer->SetTransform(modelview);
 
 	// also add labels for any faction homeworlds among the systems we've drawn
 	PutFactionLabels(Sector::SIZE * secOrigin);
 }
 
-void SectorMap::BuildFarSector(RefCountedPtr<Sector> sec, const vector3f &origin, std::vector<vector3f> &points, std::vector<Color> &colors)
+void SectorMap::QueueFarChunks(const vector3f &secOrigin, int buildRadius)
+{
+	PROFILE_SCOPED()
+	const vector3f viewCentre = m_pos * Sector::SIZE;
+	const float viewRadius = (m_zoomClamped / FAR_THRESHOLD) * OUTER_RADIUS;
+	const SystemPath buildMin(secOrigin.x - buildRadius, secOrigin.y - buildRadius, secOrigin.z - buildRadius);
+	const SystemPath buildMax(secOrigin.x + buildRadius, secOrigin.y + buildRadius, secOrigin.z + buildRadius);
+
+	// blocks are aligned to the grid so that they can be kept as the view moves
+	auto blockStart = [](int s) { return s - ((s % FAR_BLOCK_SIZE) + FAR_BLOCK_SIZE) % FAR_BLOCK_SIZE; };
+
+	std::vector<std::pair<float, SystemPath>> queue;
+	std::set<SystemPath> wanted;
+	for (int bx = blockStart(buildMin.sectorX); bx <= buildMax.sectorX; bx += FAR_BLOCK_SIZE) {
+		for (int by = blockStart(buildMin.sectorY); by <= buildMax.sectorY; by += FAR_BLOCK_SIZE) {
+			for (int bz = blockStart(buildMin.sectorZ); bz <= buildMax.sectorZ; bz += FAR_BLOCK_SIZE) {
+				const vector3f lo(bx, by, bz);
+				const vector3f hi = lo + vector3f(FAR_BLOCK_SIZE - 1);
+				// the nearest sector of the block must be in the build volume
+				const vector3f nearest(Clamp(secOrigin.x, lo.x, hi.x), Clamp(secOrigin.y, lo.y, hi.y), Clamp(secOrigin.z, lo.z, hi.z));
+				if ((nearest - secOrigin).Length() > buildRadius)
+					continue;
+
+				// most of a large build volume is empty space above and below the
+				// galactic plane, so skip whole blocks of sectors without generating them
+				const SystemPath block(bx, by, bz);
+				if (IsEmptySpace(block, SystemPath(bx + FAR_BLOCK_SIZE - 1, by + FAR_BLOCK_SIZE - 1, bz + FAR_BLOCK_SIZE - 1)))
+					continue;
+				wanted.insert(block);
+
+				const bool inside = farthest_in_box(lo, hi, secOrigin) <= buildRadius &&
+					farthest_in_box(Sector::SIZE * lo, Sector::SIZE * (hi + vector3f(1.f)), viewCentre) <= viewRadius;
+
+				auto it = m_farChunks.find(block);
+				if (it != m_farChunks.end()) {
+					const FarChunk &chunk = *it->second;
+					if (chunk.valid && chunk.complete && (chunk.inside ? inside : (chunk.radius == buildRadius && chunk.origin.ExactlyEqual(secOrigin))))
+						continue;
+				}
+				queue.emplace_back((Sector::SIZE * (lo + vector3f(0.5f * FAR_BLOCK_SIZE)) - viewCentre).Length(), block);
+			}
+		}
+	}
+
+	// drop the chunks that have left the build volume
+	for (auto it = m_farChunks.begin(); it != m_farChunks.end();) {
+		if (!wanted.count(it->first))
+			it = m_farChunks.erase(it);
+		else
+			++it;
+	}
+
+	// the queue is built from the back
+	std::sort(queue.begin(), queue.end(), [](const std::pair<float, SystemPath> &a, const std::pair<float, SystemPath> &b) {
+		return a.first > b.first;
+	});
+	m_farBuildQueue.clear();
+	for (const auto &entry : queue)
+		m_farBuildQueue.push_back(entry.second);
+}
+
+void SectorMap::BuildFarChunk(const SystemPath &block, FarChunk &chunk, SectorCache::PathVector &missing)
+{
+	PROFILE_SCOPED()
+	const vector3f secOrigin = m_secPosFar;
+	const int buildRadius = m_radiusFar;
+	const vector3f lo(block.sectorX, block.sectorY, block.sectorZ);
+	const vector3f hi = lo + vector3f(FAR_BLOCK_SIZE - 1);
+
+	chunk.stars.clear();
+	chunk.colors.clear();
+	chunk.factions.clear();
+	chunk.origin = secOrigin;
+	chunk.radius = buildRadius;
+	chunk.inside = farthest_in_box(lo, hi, secOrigin) <= buildRadius &&
+		farthest_in_box(Sector::SIZE * lo, Sector::SIZE * (hi + vector3f(1.f)), m_pos * Sector::SIZE) <= (m_zoomClamped / FAR_THRESHOLD) * OUTER_RADIUS;
+	chunk.complete = true;
+	chunk.valid = true;
+	chunk.quadsValid = false;
+
+	for (int sx = block.sectorX; sx < block.sectorX + FAR_BLOCK_SIZE; sx++) {
+		for (int sy = block.sectorY; sy < block.sectorY + FAR_BLOCK_SIZE; sy++) {
+			for (int sz = block.sectorZ; sz < block.sectorZ + FAR_BLOCK_SIZE; sz++) {
+				if (!chunk.inside && (vector3f(sx, sy, sz) - secOrigin).Length() > buildRadius)
+					continue;
+
+				const SystemPath path(sx, sy, sz);
+				RefCountedPtr<Sector> sec = m_sectorCache->GetIfCached(path);
+				if (sec) {
+					BuildFarSector(sec, Sector::SIZE * lo, !chunk.inside, chunk);
+				} else if (!IsEmptySpace(path, path)) {
+					chunk.complete = false;
+					if (m_farSectorsRequested.insert(path).second)
+						missing.push_back(path);
+				}
+			}
+		}
+	}
+}
+
+void SectorMap::BuildFarSector(RefCountedPtr<Sector> sec, const vector3f &origin, bool cull, FarChunk &chunk)
 {
 	PROFILE_SCOPED()
 	Color starColor;
 	for (std::vector<Sector::System>::iterator i = sec->m_systems.begin(); i != sec->m_systems.end(); ++i) {
 		// skip the system if it doesn't fall within the sphere we're viewing.
-		if ((m_pos * Sector::SIZE - (*i).GetFullPosition()).Length() > (m_zoomClamped / FAR_THRESHOLD) * OUTER_RADIUS) continue;
+		if (cull && (m_pos * Sector::SIZE - (*i).GetFullPosition()).Length() > (m_zoomClamped / FAR_THRESHOLD) * OUTER_RADIUS) continue;
 
 		if (!i->IsExplored()) {
-			points.push_back((*i).GetFullPosition() - origin);
-			colors.push_back({ 100, 100, 100, 155 }); // flat gray for unexplored systems
+			chunk.stars.push_back((*i).GetFullPosition() - origin);
+			chunk.colors.push_back({ 100, 100, 100, 155 }); // flat gray for unexplored systems
 			continue;
 		}
 
 		// if the system belongs to a faction we've chosen to hide also skip it, if it's not selectd in some way
-		m_visibleFactions.insert(i->GetFaction());
+		chunk.factions.insert(i->GetFaction());
 		if (m_hiddenFactions.find(i->GetFaction()) != m_hiddenFactions.end()) continue;
 
-		// otherwise add the system's position (origin must be m_pos's *sector* or we get judder)
-		// and faction color to the list to draw
+		// otherwise add the system's position (relative to the corner of the
+		// chunk, or we get judder) and faction color to the list to draw
 		starColor = i->GetFaction()->colour;
 		starColor.a = 120;
 
-		points.push_back((*i).GetFullPosition() - origin);
-		colors.push_back(starColor);
+		chunk.stars.push_back((*i).GetFullPosition() - origin);
+		chunk.colors.push_back(starColor);
 	}
 }
 
@@ -1260,32 +1441,9 @@ double SectorMap::GetZoomLevel() const
 
 std::vector<SystemPath> SectorMap::GetNearbyStarSystemsByName(std::string pattern)
 {
-	std::vector<SystemPath> result;
-	for (auto i = m_sectorCache->Begin(); i != m_sectorCache->End(); ++i) {
-		for (unsigned int systemIndex = 0; systemIndex < (*i).second->m_systems.size(); systemIndex++) {
-			const Sector::System *ss = &((*i).second->m_systems[systemIndex]);
-
-			// compare with the start of the current system
-			if (strncasecmp(pattern.c_str(), ss->GetName().c_str(), pattern.size()) == 0
-				// look for the pattern term somewhere within the current system
-				|| pi_strcasestr(ss->GetName().c_str(), pattern.c_str())) {
-				SystemPath match((*i).first);
-				match.systemIndex = systemIndex;
-				result.push_back(match);
-			}
-			// now also check other names of this system, if there are any
-			for (const std::string &other_name : ss->GetOtherNames()) {
-				if (strncasecmp(pattern.c_str(), other_name.c_str(), pattern.size()) == 0
-					// look for the pattern term somewhere within the current system
-					|| pi_strcasestr(other_name.c_str(), pattern.c_str())) {
-					SystemPath match((*i).first);
-					match.systemIndex = systemIndex;
-					result.push_back(match);
-				}
-			}
-		}
-	}
-	return result;
+	// called on every keystroke in the search box
+	static const double SEARCH_TIME_BUDGET_MS = 1.0;
+	return m_nameIndex.Find(pattern, m_pos * Sector::SIZE, SEARCH_TIME_BUDGET_MS);
 }
 
 void SectorMap::SetFactionVisible(const Faction *faction, bool visible)
@@ -10,6 +10,7 @@
 #include "RefCounted.h"
 #include "galaxy/Factions.h"
 #include "galaxy/Sector.h"
+#include "galaxy/SystemNameIndex.h"
 #include "galaxy/SystemPath.h"
 #include "graphics/Drawables.h"
 #include "imgui/imgui.h"
@@ -98,8 +99,15 @@ private:
 	void PutSystemLabels(RefCountedPtr<Sector> sec, const vector3f &origin, int drawRadius);
 	void PutSystemLabel(const Sector::System &sys, bool shadow);
 
+	struct FarChunk;
+
 	void DrawFarSectors(const matrix4x4f &modelview);
-	void BuildFarSector(RefCountedPtr<Sector> sec, const vector3f &origin, std::vector<vector3f> &points, std::vector<Color> &colors);
+	// True if no sector in the box can have any systems
+	bool IsEmptySpace(const SystemPath &min, const SystemPath &max) const;
+	// Queue the blocks of the build volume whose chunk is missing or out of date
+	void QueueFarChunks(const vector3f &secOrigin, int buildRadius);
+	void BuildFarChunk(const SystemPath &block, FarChunk &chunk, SectorCache::PathVector &missing);
+	void BuildFarSector(RefCountedPtr<Sector> sec, const vector3f &origin, bool cull, FarChunk &chunk);
 	void PutFactionLabels(const vector3f &secPos);
 
 	void OnClickLabel(const SystemPath &path);
@@ -141,13 +149,46 @@ private:
 	sigc::connection m_onViewReset;
 
 	RefCountedPtr<SectorCache::Slave> m_sectorCache;
-
-	std::vector<vector3f> m_farstars;
-	std::vector<Color> m_farstarsColor;
+	// names of the systems in m_sectorCache, kept up to date as sectors
+	// enter and leave it
+	SystemNameIndex m_nameIndex;
+	sigc::connection m_onSectorAdded;
+	sigc::connection m_onSectorRemoved;
+
+	// The stars of one FAR_BLOCK_SIZE block of sectors, relative to the
+	// corner of the block so the view can move without rebuilding it. A
+	// chunk that fits inside the build volume isn't cut to its sphere and is
+	// kept as the view moves; only the chunks on the edge are built again.
+	struct FarChunk {
+		std::vector<vector3f> stars;
+		std::vector<Color> colors;
+		std::set<const Faction *> factions;
+		Graphics::Drawables::Points points;
+		// the build volume the chunk was cut to, unless it's inside it
+		vector3f origin;
+		int radius = 0;
+		bool inside = false;
+		// false while some of its sectors are still being generated
+		bool complete = false;
+		bool valid = false;
+		// the billboards face the view they were made for
+		bool quadsValid = false;
+	};
+	std::map<SystemPath, std::unique_ptr<FarChunk>> m_farChunks;
+	// blocks to build, nearest first, a few of them each frame
+	std::vector<SystemPath> m_farBuildQueue;
+	// the view rotation and star size the billboards were made for
+	matrix4x4f m_farQuadsView;
+	float m_farQuadsSize;
 
 	vector3f m_secPosFar;
 	int m_radiusFar;
 	bool m_toggledFaction;
+	// far sectors are generated in the background; the stars are rebuilt
+	// as they arrive until none are missing
+	std::set<SystemPath> m_farSectorsRequested;
+	unsigned m_farSectorsPublished;
+	bool m_farSectorsMissing;
 
 	int m_cacheXMin;
 	int m_cacheXMax;
@@ -175,7 +216,6 @@ private:
 	Graphics::Drawables::Lines m_lines;
 	Graphics::Drawables::Lines m_customlines;
 	Graphics::Drawables::Lines m_sectorlines;
-	Graphics::Drawables::Points m_farstarsPoints;
 
 	struct SphereParam {
 		matrix4x4f trans;
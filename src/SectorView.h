@@ -17,6 +17,8 @@
 
 class Game;
 class Galaxy;
+struct JumpCost;
+class RoutePlanner;
 class SectorMap;
 struct SectorMapContext;
 
@@ -57,7 +59,15 @@ public:
 	bool RemoveRouteItem(const std::vector<SystemPath>::size_type element);
 	void ClearRoute();
 	std::vector<SystemPath> GetRoute();
-	const std::string AutoRoute(const SystemPath &start, const SystemPath &target, std::vector<SystemPath> &outRoute) const;
+	// Replace the current route with the quickest one from start to target.
+	// Returns "OKAY", "NO_VALID_ROUTE", or "NO_DRIVE" if the player has no
+	// hyperdrive.
+	const std::string AutoRoute(const SystemPath &start, const SystemPath &target);
+	// The same without blocking: returns "PLANNING" or "NO_DRIVE", and the
+	// onAutoRouteFinished event is queued with "OKAY" or "NO_VALID_ROUTE"
+	// once the route has been replaced, or not.
+	const std::string StartAutoRoute(const SystemPath &start, const SystemPath &target);
+	bool IsAutoRoutePlanning() const;
 	void SetDrawRouteLines(bool value);
 
 	sigc::signal<void> onHyperspaceTargetChanged;
@@ -83,6 +93,9 @@ private:
 	void InitObject();
 	const SystemPath &CheckPathInRoute(const SystemPath &path);
 	void SetSelected(const SystemPath &path);
+	// false if the player has no hyperdrive
+	bool GetAutoRouteCost(JumpCost &cost) const;
+	void SetAutoRoute(const std::vector<SystemPath> &route, const SystemPath &target);
 	void SetupLines(const vector3f &playerAbsPos, const matrix4x4f &trans);
 	void GetPlayerPosAndStarSize(vector3f &playerPosOut, float &currentStarSizeOut);
 
@@ -109,6 +122,7 @@ private:
 	Game &m_game;
 	std::unique_ptr<SectorMap> m_map;
 	std::vector<SystemPath> m_route;
+	std::unique_ptr<RoutePlanner> m_routePlanner;
 
 };
 
@@ -10,9 +10,10 @@
 #include "Ship.h"
 #include "Space.h"
 
+#include <algorithm>
+
 Sensors::RadarContact::RadarContact() :
 	body(0),
-	trail(0),
 	distance(0.0),
 	iff(IFF_UNKNOWN),
 	fresh(true)
@@ -21,17 +22,17 @@ Sensors::RadarContact::RadarContact() :
 
 Sensors::RadarContact::RadarContact(Body *b) :
 	body(b),
-	trail(0),
 	distance(0.0),
 	iff(IFF_UNKNOWN),
 	fresh(true)
 {
 }
 
+Sensors::RadarContact::RadarContact(RadarContact &&) noexcept = default;
+Sensors::RadarContact &Sensors::RadarContact::operator=(RadarContact &&) noexcept = default;
+
 Sensors::RadarContact::~RadarContact()
 {
-	body = 0;
-	delete trail;
 }
 
 Color Sensors::IFFColor(IFF iff)
@@ -46,9 +47,9 @@ Color Sensors::IFFColor(IFF iff)
 	}
 }
 
-bool Sensors::ContactDistanceSort(const RadarContact &a, const RadarContact &b)
+bool Sensors::ContactDistanceSort(const RadarContact *a, const RadarContact *b)
 {
-	return a.distance < b.distance;
+	return a->distance < b->distance;
 }
 
 Sensors::Sensors(Ship *owner)
@@ -56,6 +57,10 @@ Sensors::Sensors(Ship *owner)
 	m_owner = owner;
 }
 
+Sensors::~Sensors()
+{
+}
+
 Body* Sensors::ChooseTarget(TargetingCriteria crit, const Body* oldTarget )
 {
 	PROFILE_SCOPED();
@@ -65,26 +70,25 @@ Body* Sensors::ChooseTarget(TargetingCriteria crit, const Body* oldTarget )
 		
 	const Body* currTarget = oldTarget;
 
-	m_radarContacts.sort(ContactDistanceSort);
-
-	for (auto it = m_radarContacts.begin(); it != m_radarContacts.end(); ++it) {
+	// the contacts are sorted by Update
+	for (const RadarContact *contact : m_sortedContacts) {
 		//match object type
 		//match iff
-		if (it->body->IsType(ObjectType::SHIP)) {
+		if (contact->body->IsType(ObjectType::SHIP)) {
 
 			if(crit == CYCLE_HOSTILE && currTarget) {
-				if(currTarget == it->body) {
+				if(currTarget == contact->body) {
 					currTarget = nullptr;
 					//next hostile will be selected
 				}
 				continue;
 			}
 
-			if (it->iff != IFF_HOSTILE) continue;
+			if (contact->iff != IFF_HOSTILE) continue;
 			//should move the target to ship after all (from PlayerShipController)
 			//targeting inputs stay in PSC
 
-			return it->body;
+			return contact->body;
 		}
 	}
 
@@ -115,8 +119,6 @@ void Sensors::Update(float time)
 	PROFILE_SCOPED();
 	if (m_owner != Pi::player) return;
 
-	PopulateStaticContacts(); //no need to do all the time
-
 	//Find nearby contacts, same range as radar scanner. It should use these
 	//contacts, worldview labels too.
 	Space::BodyNearList nearby = Pi::game->GetSpace()->GetBodiesMaybeNear(m_owner, 100000.0f);
@@ -124,61 +126,93 @@ void Sensors::Update(float time)
 		if (body == m_owner || !body->IsType(ObjectType::SHIP)) continue;
 		if (body->IsDead()) continue;
 
-		auto cit = m_radarContacts.begin();
-		while (cit != m_radarContacts.end()) {
-			if (cit->body == body) break;
-			++cit;
+		//create new contact or refresh old
+		auto found = m_contactIndex.find(body);
+		if (found == m_contactIndex.end())
+			AddContact(body);
+		else
+			m_radarContacts[found->second].fresh = true;
+	}
+
+	//update contacts and delete stale ones
+	m_sortedContacts.clear();
+	for (Uint32 i = 0; i < m_radarContacts.size(); i++) {
+		RadarContact &rc = m_radarContacts[i];
+		if (!rc.body) continue;
+		if (!rc.fresh) {
+			RemoveContact(i);
+			continue;
 		}
 
-		//create new contact or refresh old
-		if (cit == m_radarContacts.end()) {
-			m_radarContacts.push_back(RadarContact());
-			RadarContact &rc = m_radarContacts.back();
-			rc.body = body;
+		const Ship *ship = rc.body->IsType(ObjectType::SHIP) ? static_cast<Ship *>(rc.body) : nullptr;
+		if (ship && Ship::FLYING == ship->GetFlightState()) {
+			rc.distance = m_owner->GetPositionRelTo(rc.body).Length();
 			rc.iff = CheckIFF(rc.body);
-			rc.trail = new HudTrail(rc.body, IFFColor(rc.iff));
+			rc.trail->SetColor(IFFColor(rc.iff));
+			rc.trail->Update(time);
 		} else {
-			cit->fresh = true;
+			rc.trail->Reset(FrameId::Invalid);
 		}
+		rc.fresh = false;
+		m_sortedContacts.push_back(&rc);
 	}
+	std::sort(m_sortedContacts.begin(), m_sortedContacts.end(), ContactDistanceSort);
+}
 
-	//update contacts and delete stale ones
-	auto it = m_radarContacts.begin();
-	while (it != m_radarContacts.end()) {
-		if (!it->fresh) {
-			m_radarContacts.erase(it++);
-		} else {
-			const Ship *ship = it->body->IsType(ObjectType::SHIP) ? static_cast<Ship *>(it->body) : nullptr;
-			if (ship && Ship::FLYING == ship->GetFlightState()) {
-				it->distance = m_owner->GetPositionRelTo(it->body).Length();
-				it->iff = CheckIFF(it->body);
-				it->trail->SetColor(IFFColor(it->iff));
-				it->trail->Update(time);
-			} else {
-				it->trail->Reset(FrameId::Invalid);
-			}
-			it->fresh = false;
-			++it;
-		}
+void Sensors::AddContact(Body *body)
+{
+	Uint32 index;
+	if (!m_freeContacts.empty()) {
+		index = m_freeContacts.back();
+		m_freeContacts.pop_back();
+	} else {
+		index = Uint32(m_radarContacts.size());
+		m_radarContacts.emplace_back();
 	}
+
+	RadarContact &rc = m_radarContacts[index];
+	rc.body = body;
+	rc.distance = 0.0;
+	rc.fresh = true;
+	rc.iff = CheckIFF(rc.body);
+	rc.trail.reset(new HudTrail(rc.body, IFFColor(rc.iff)));
+	m_contactIndex[body] = index;
+}
+
+void Sensors::RemoveContact(Uint32 index)
+{
+	RadarContact &rc = m_radarContacts[index];
+	m_contactIndex.erase(rc.body);
+	rc.body = nullptr;
+	rc.trail.reset();
+	m_freeContacts.push_back(index);
 }
 
 void Sensors::UpdateIFF(Body *b)
 {
 	PROFILE_SCOPED();
-	for (auto it = m_radarContacts.begin(); it != m_radarContacts.end(); ++it) {
-		if (it->body == b) {
-			it->iff = CheckIFF(b);
-			it->trail->SetColor(IFFColor(it->iff));
-		}
+	auto found = m_contactIndex.find(b);
+	if (found != m_contactIndex.end()) {
+		RadarContact &rc = m_radarContacts[found->second];
+		rc.iff = CheckIFF(b);
+		rc.trail->SetColor(IFFColor(rc.iff));
 	}
 }
 
 void Sensors::ResetTrails()
 {
 	PROFILE_SCOPED();
-	for (auto it = m_radarContacts.begin(); it != m_radarContacts.end(); ++it)
-		it->trail->Reset(Pi::player->GetFrame());
+	for (RadarContact &rc : m_radarContacts) {
+		if (rc.body)
+			rc.trail->Reset(Pi::player->GetFrame());
+	}
+}
+
+const std::vector<Sensors::RadarContact> &Sensors::GetStaticContacts()
+{
+	// only gathered when asked for, rather than from every body on every update
+	PopulateStaticContacts();
+	return m_staticContacts;
 }
 
 void Sensors::PopulateStaticContacts()
@@ -195,8 +229,6 @@ void Sensors::PopulateStaticContacts()
 		default:
 			continue;
 		}
-		m_staticContacts.push_back(RadarContact(b));
-		RadarContact &rc = m_staticContacts.back();
-		rc.fresh = true;
+		m_staticContacts.emplace_back(b);
 	}
 }
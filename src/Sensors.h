@@ -13,7 +13,9 @@
  */
 #include "Body.h"
 
-#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 class Body;
 class HudTrail;
@@ -21,7 +23,7 @@ class Ship;
 
 class Sensors {
 public:
-	enum IFF {
+	enum IFF { // <enum scope='Sensors' name=SensorsIFF prefix=IFF_ public>
 		IFF_UNKNOWN, //also applies to inert objects
 		IFF_NEUTRAL,
 		IFF_ALLY,
@@ -36,33 +38,46 @@ public:
 	struct RadarContact {
 		RadarContact();
 		RadarContact(Body *);
+		RadarContact(RadarContact &&) noexcept;
+		RadarContact &operator=(RadarContact &&) noexcept;
 		~RadarContact();
 		Body *body;
-		HudTrail *trail;
+		std::unique_ptr<HudTrail> trail;
 		double distance;
 		IFF iff;
 		bool fresh;
 	};
 
-	typedef std::list<RadarContact> ContactList;
+	// the contacts in range, nearest first
+	typedef std::vector<const RadarContact *> ContactList;
 
 	static Color IFFColor(IFF);
-	static bool ContactDistanceSort(const RadarContact &a, const RadarContact &b);
+	static bool ContactDistanceSort(const RadarContact *a, const RadarContact *b);
 
 	Sensors(Ship *owner);
+	~Sensors();
 	Body* ChooseTarget(TargetingCriteria, const Body* oldTarget);
 	IFF CheckIFF(Body *other);
-	const ContactList &GetContacts() { return m_radarContacts; }
-	const ContactList &GetStaticContacts() { return m_staticContacts; }
+	// valid until the next Update
+	const ContactList &GetContacts() { return m_sortedContacts; }
+	const std::vector<RadarContact> &GetStaticContacts();
 	void Update(float time);
 	void UpdateIFF(Body *);
 	void ResetTrails();
 
 private:
 	Ship *m_owner;
-	ContactList m_radarContacts;
-	ContactList m_staticContacts; //things we know of regardless of range
+	// A contact keeps its slot for as long as it is in range, so only the
+	// bodies coming into and going out of range change the storage. Free
+	// slots have no body and are reused.
+	std::vector<RadarContact> m_radarContacts;
+	std::vector<Uint32> m_freeContacts;
+	std::unordered_map<const Body *, Uint32> m_contactIndex;
+	ContactList m_sortedContacts;
+	std::vector<RadarContact> m_staticContacts; //things we know of regardless of range
 
+	void AddContact(Body *body);
+	void RemoveContact(Uint32 index);
 	void PopulateStaticContacts();
 };
 
@@ -13,6 +13,8 @@
 
 #include "ServerAgent.h"
 #include "StringF.h"
+#include <algorithm>
+#include <cassert>
 #include <curl/curl.h>
 
 void NullServerAgent::Call(const std::string &method, const Json &data, SuccessCallback onSuccess, FailCallback onFail, void *userdata)
@@ -31,28 +33,28 @@ void NullServerAgent::ProcessResponses()
 
 bool HTTPServerAgent::s_initialised = false;
 
-HTTPServerAgent::HTTPServerAgent(const std::string &endpoint) :
-	m_endpoint(endpoint)
+HTTPServerAgent::HTTPServerAgent(const std::string &endpoint, int maxConcurrentRequests) :
+	m_endpoint(endpoint),
+	m_maxConcurrentRequests(std::max(maxConcurrentRequests, 1)),
+	m_quit(false)
 {
-	if (!s_initialised)
+	if (!s_initialised) {
 		curl_global_init(CURL_GLOBAL_ALL);
+		s_initialised = true;
+	}
 
-	m_curl = curl_easy_init();
-	//curl_easy_setopt(m_curl, CURLOPT_VERBOSE, 1);
-
-	curl_easy_setopt(m_curl, CURLOPT_POST, 1);
-
-	curl_easy_setopt(m_curl, CURLOPT_READFUNCTION, HTTPServerAgent::FillRequestBuffer);
-	curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, HTTPServerAgent::FillResponseBuffer);
+	m_multi = curl_multi_init();
+	// calls to the server share one connection if it multiplexes them, and
+	// otherwise keep up to one connection per call in flight alive
+	curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, long(CURLPIPE_MULTIPLEX));
+	curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS, long(m_maxConcurrentRequests));
+	curl_multi_setopt(m_multi, CURLMOPT_MAXCONNECTS, long(m_maxConcurrentRequests));
 
 	m_curlHeaders = 0;
 	m_curlHeaders = curl_slist_append(m_curlHeaders, ("User-agent: " + UserAgent()).c_str());
 	m_curlHeaders = curl_slist_append(m_curlHeaders, "Content-type: application/json");
-	curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, m_curlHeaders);
 
 	m_requestQueueLock = SDL_CreateMutex();
-	m_requestQueueCond = SDL_CreateCond();
-
 	m_responseQueueLock = SDL_CreateMutex();
 
 	m_thread = SDL_CreateThread(&HTTPServerAgent::ThreadEntry, "HTTPServerAgent", this);
@@ -60,29 +62,21 @@ HTTPServerAgent::HTTPServerAgent(const std::string &endpoint) :
 
 HTTPServerAgent::~HTTPServerAgent()
 {
-	// flush the queue
+	// drop the calls that haven't started, and tell the thread to finish
+	// up the ones that have
 	SDL_LockMutex(m_requestQueueLock);
-	while (m_requestQueue.size() > 0)
-		m_requestQueue.pop();
+	m_quit = true;
+	std::queue<Request>().swap(m_requestQueue);
 	SDL_UnlockMutex(m_requestQueueLock);
 
-	// signal the thread. empty queue will cause it to exit
-	SDL_CondBroadcast(m_requestQueueCond);
+	curl_multi_wakeup(m_multi);
+	SDL_WaitThread(m_thread, nullptr);
 
-	// first thing the queue does is check the queue, so we must
-	// not shut down until its done that. it will release the queue
-	// lock before it dies, so try to take it
-	SDL_LockMutex(m_requestQueueLock);
-
-	// we have the lock, so we know the thread won't doing anything
-	// else. we can clean up now
 	SDL_DestroyMutex(m_responseQueueLock);
 	SDL_DestroyMutex(m_requestQueueLock);
-	SDL_DestroyCond(m_requestQueueCond);
 
+	curl_multi_cleanup(m_multi);
 	curl_slist_free_all(m_curlHeaders);
-
-	curl_easy_cleanup(m_curl);
 }
 
 void HTTPServerAgent::Call(const std::string &method, const Json &data, SuccessCallback onSuccess, FailCallback onFail, void *userdata)
@@ -91,19 +85,18 @@ void HTTPServerAgent::Call(const std::string &method, const Json &data, SuccessC
 	m_requestQueue.push(Request(method, data, onSuccess, onFail, userdata));
 	SDL_UnlockMutex(m_requestQueueLock);
 
-	SDL_CondBroadcast(m_requestQueueCond);
+	// wakes the thread from waiting on the network
+	curl_multi_wakeup(m_multi);
 }
 
 void HTTPServerAgent::ProcessResponses()
 {
 	std::queue<Response> responseQueue;
 
-	// make a copy of the response queue so we can process
-	// the response at our leisure
+	// take the whole response queue, so we can process the
+	// responses at our leisure and the worker isn't kept waiting
 	SDL_LockMutex(m_responseQueueLock);
-	responseQueue = m_responseQueue;
-	while (!m_responseQueue.empty())
-		m_responseQueue.pop();
+	std::swap(responseQueue, m_responseQueue);
 	SDL_UnlockMutex(m_responseQueueLock);
 
 	while (!responseQueue.empty()) {
@@ -126,77 +119,117 @@ int HTTPServerAgent::ThreadEntry(void *data)
 
 void HTTPServerAgent::ThreadMain()
 {
-	while (1) {
+	std::vector<Request> starting;
 
-		// look for requests
+	while (1) {
+		// take as many requests as there is room for in one go
 		SDL_LockMutex(m_requestQueueLock);
+		if (m_quit) {
+			SDL_UnlockMutex(m_requestQueueLock);
+			break;
+		}
+		while (!m_requestQueue.empty() && m_transfers.size() + starting.size() < m_maxConcurrentRequests) {
+			starting.emplace_back(std::move(m_requestQueue.front()));
+			m_requestQueue.pop();
+		}
+		const bool moreQueued = !m_requestQueue.empty();
+		SDL_UnlockMutex(m_requestQueueLock);
 
-		// if there's no requests, wait until the main thread wakes us
-		if (m_requestQueue.empty())
-			SDL_CondWait(m_requestQueueCond, m_requestQueueLock);
+		for (Request &req : starting)
+			StartTransfer(std::make_unique<Transfer>(std::move(req)));
+		starting.clear();
 
-		// woken up but nothing on the queue means we're being destroyed
-		if (m_requestQueue.empty()) {
-			// main thread is waiting for this lock, and will start
-			// cleanup as soon as it has it
-			SDL_UnlockMutex(m_requestQueueLock);
+		int running;
+		curl_multi_perform(m_multi, &running);
 
-			// might be cleaned up already, so don't do anything else,
-			// just get out of here
-			return;
+		int pending;
+		while (CURLMsg *msg = curl_multi_info_read(m_multi, &pending)) {
+			if (msg->msg == CURLMSG_DONE)
+				FinishTransfer(msg->easy_handle, msg->data.result);
 		}
 
-		// grab a request
-		Request req = m_requestQueue.front();
-		m_requestQueue.pop();
-
-		// done with the queue
-		SDL_UnlockMutex(m_requestQueueLock);
+		// if calls are waiting for the ones that just finished, start them
+		// right away; otherwise wait for the network or for a new call
+		if (!moreQueued || m_transfers.size() >= m_maxConcurrentRequests)
+			curl_multi_poll(m_multi, nullptr, 0, 1000, nullptr);
+	}
 
-		Json::FastWriter writer;
-		req.buffer = writer.write(req.data);
+	for (std::unique_ptr<Transfer> &transfer : m_transfers) {
+		curl_multi_remove_handle(m_multi, transfer->curl);
+		curl_easy_cleanup(transfer->curl);
+	}
+	m_transfers.clear();
+	for (CURL *curl : m_idleHandles)
+		curl_easy_cleanup(curl);
+	m_idleHandles.clear();
+}
 
-		Response resp(req.onSuccess, req.onFail, req.userdata);
+void HTTPServerAgent::StartTransfer(std::unique_ptr<Transfer> transfer)
+{
+	transfer->url = m_endpoint + "/" + transfer->request.method;
+	transfer->body = transfer->request.data.dump();
+
+	CURL *curl;
+	if (!m_idleHandles.empty()) {
+		curl = m_idleHandles.back();
+		m_idleHandles.pop_back();
+	} else {
+		curl = curl_easy_init();
+		//curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, m_curlHeaders);
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, HTTPServerAgent::FillResponseBuffer);
+		curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+		curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, long(CURL_HTTP_VERSION_2TLS));
+		// rather wait for a connection that can be multiplexed than open another
+		curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+	}
 
-		curl_easy_setopt(m_curl, CURLOPT_URL, std::string(m_endpoint + "/" + req.method).c_str());
-		curl_easy_setopt(m_curl, CURLOPT_POSTFIELDSIZE, req.buffer.size());
-		curl_easy_setopt(m_curl, CURLOPT_READDATA, &req);
-		curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, &resp);
+	curl_easy_setopt(curl, CURLOPT_URL, transfer->url.c_str());
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, transfer->body.data());
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, long(transfer->body.size()));
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer->response);
 
-		CURLcode rc = curl_easy_perform(m_curl);
-		resp.success = rc == CURLE_OK;
-		if (!resp.success)
-			resp.buffer = std::string("call failed: " + std::string(curl_easy_strerror(rc)));
-
-		if (resp.success) {
-			uint32_t code;
-			curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &code);
-			if (code != 200) {
-				resp.success = false;
-				resp.buffer = stringf("call returned HTTP status: %0{d}", code);
-			}
-		}
+	transfer->curl = curl;
+	curl_multi_add_handle(m_multi, curl);
+	m_transfers.push_back(std::move(transfer));
+}
 
-		if (resp.success) {
-			Json::Reader reader;
-			resp.success = reader.parse(resp.buffer, resp.data, false);
-			if (!resp.success)
-				resp.buffer = std::string("JSON parse error: " + reader.getFormattedErrorMessages());
+void HTTPServerAgent::FinishTransfer(CURL *curl, CURLcode rc)
+{
+	auto it = std::find_if(m_transfers.begin(), m_transfers.end(),
+		[curl](const std::unique_ptr<Transfer> &transfer) { return transfer->curl == curl; });
+	assert(it != m_transfers.end());
+	Response &resp = (*it)->response;
+
+	resp.success = rc == CURLE_OK;
+	if (!resp.success)
+		resp.buffer = std::string("call failed: " + std::string(curl_easy_strerror(rc)));
+
+	if (resp.success) {
+		long code = 0;
+		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+		if (code != 200) {
+			resp.success = false;
+			resp.buffer = stringf("call returned HTTP status: %0{d}", int(code));
 		}
+	}
 
-		SDL_LockMutex(m_responseQueueLock);
-		m_responseQueue.push(resp);
-		SDL_UnlockMutex(m_responseQueueLock);
+	if (resp.success) {
+		resp.data = Json::parse(resp.buffer, nullptr, false);
+		resp.success = !resp.data.is_discarded();
+		if (!resp.success)
+			resp.buffer = std::string("JSON parse error");
 	}
-}
 
-size_t HTTPServerAgent::FillRequestBuffer(char *ptr, size_t size, size_t nmemb, void *userdata)
-{
-	HTTPServerAgent::Request *req = reinterpret_cast<HTTPServerAgent::Request *>(userdata);
-	size_t amount = std::max(size * nmemb, req->buffer.size());
-	memcpy(ptr, req->buffer.data(), amount);
-	req->buffer.erase(0, amount);
-	return amount;
+	// the handle keeps its settings for the next call
+	curl_multi_remove_handle(m_multi, curl);
+	m_idleHandles.push_back(curl);
+
+	SDL_LockMutex(m_responseQueueLock);
+	m_responseQueue.push(std::move(resp));
+	SDL_UnlockMutex(m_responseQueueLock);
+
+	m_transfers.erase(it);
 }
 
 size_t HTTPServerAgent::FillResponseBuffer(char *ptr, size_t size, size_t nmemb, void *userdata)
@@ -5,11 +5,13 @@
 #ifndef SERVERAGENT_H
 #define SERVERAGENT_H
 
+#include "Json.h"
 #include "libs.h"
 #include <curl/curl.h>
-#include <json/json.h>
 #include <map>
+#include <memory>
 #include <queue>
+#include <vector>
 
 class ServerAgent {
 public:
@@ -47,9 +49,13 @@ private:
 	std::queue<Response> m_queue;
 };
 
+// Runs the calls on a worker thread through one curl multi handle, so that
+// several are in flight at once and share their connections: they are kept
+// alive between calls, and multiplexed over one connection when the server
+// speaks HTTP/2. ProcessResponses only takes the finished calls off a queue.
 class HTTPServerAgent : public ServerAgent {
 public:
-	HTTPServerAgent(const std::string &endpoint);
+	HTTPServerAgent(const std::string &endpoint, int maxConcurrentRequests = 4);
 	virtual ~HTTPServerAgent();
 
 	virtual void Call(const std::string &method, const Json &data, SuccessCallback onSuccess = sigc::ptr_fun(&ServerAgent::IgnoreSuccessCallback), FailCallback onFail = sigc::ptr_fun(&ServerAgent::IgnoreFailCallback), void *userdata = 0);
@@ -65,10 +71,8 @@ private:
 			onFail(_onFail),
 			userdata(_userdata) {}
 
-		const std::string method;
-		const Json data;
-
-		std::string buffer;
+		std::string method;
+		Json data;
 
 		SuccessCallback onSuccess;
 		FailCallback onFail;
@@ -95,26 +99,48 @@ private:
 		void *userdata;
 	};
 
+	// a call in flight, owned by the worker thread
+	struct Transfer {
+		Transfer(Request &&_request) :
+			request(std::move(_request)),
+			response(request.onSuccess, request.onFail, request.userdata),
+			curl(nullptr) {}
+
+		Request request;
+		Response response;
+		std::string url;
+		std::string body;
+		CURL *curl;
+	};
+
 	static int ThreadEntry(void *data);
 	void ThreadMain();
 
+	void StartTransfer(std::unique_ptr<Transfer> transfer);
+	void FinishTransfer(CURL *curl, CURLcode rc);
+
 	static const std::string &UserAgent();
 
-	static size_t FillRequestBuffer(char *ptr, size_t size, size_t nmemb, void *userdata);
 	static size_t FillResponseBuffer(char *ptr, size_t size, size_t nmemb, void *userdata);
 
 	static bool s_initialised;
 
 	const std::string m_endpoint;
+	const size_t m_maxConcurrentRequests;
 
 	SDL_Thread *m_thread;
 
-	CURL *m_curl;
+	// worker thread only
+	CURLM *m_multi;
 	curl_slist *m_curlHeaders;
+	std::vector<std::unique_ptr<Transfer>> m_transfers;
+	// easy handles of finished transfers, kept for their settings and
+	// connection state
+	std::vector<CURL *> m_idleHandles;
 
 	std::queue<Request> m_requestQueue;
+	bool m_quit;
 	SDL_mutex *m_requestQueueLock;
-	SDL_cond *m_requestQueueCond;
 
 	std::queue<Response> m_responseQueue;
 	SDL_mutex *m_responseQueueLock;
@@ -17,15 +17,26 @@
 #include "graphics/Graphics.h"
 #include "graphics/Material.h"
 #include "graphics/RenderState.h"
+#include "graphics/Light.h"
 #include "graphics/Renderer.h"
 #include "graphics/TextureBuilder.h"
 #include "graphics/Types.h"
 #include "graphics/VertexArray.h"
 #include "matrix4x4.h"
 
+#include <algorithm>
+
 using namespace Graphics;
 
 namespace {
+	// how long the particles of each type live, in seconds
+	const float LIFETIME[TYPE_NONE] = { 0.0f, 3.2f, 2.0f, 8.0f };
+
+	float AgeBlend(SFX_TYPE t, float age)
+	{
+		return (LIFETIME[t] - age) / LIFETIME[t];
+	}
+
 	float SizeToPixels(int screenHeight, const vector3f &trans, const float size)
 	{
 		//some hand-tweaked scaling, to make the lights seem larger from distance (final size is in pixels)
@@ -35,16 +46,16 @@ namespace {
 		return (size * Graphics::GetFovFactor()) * pixrad;
 	}
 
-	float GetParticleSpeed(int screenHeight, SFX_TYPE t, const vector3f &pos, const Sfx &inst)
+	float GetParticleSpeed(int screenHeight, SFX_TYPE t, const vector3f &pos, float speed, float age)
 	{
 		switch (t) {
 		case TYPE_NONE: assert(false);
 		case TYPE_EXPLOSION:
-			return SizeToPixels(screenHeight, pos, inst.m_speed);
+			return SizeToPixels(screenHeight, pos, speed);
 		case TYPE_DAMAGE:
 			return SizeToPixels(screenHeight, pos, 20.f);
 		case TYPE_SMOKE:
-			return Clamp(SizeToPixels(screenHeight, pos, (inst.m_speed * inst.m_age)), 0.1f, 50.0f);
+			return Clamp(SizeToPixels(screenHeight, pos, (speed * age)), 0.1f, 50.0f);
 		default:
 			return 0.f;
 		}
@@ -57,82 +68,30 @@ std::unique_ptr<Graphics::Material> SfxManager::smokeParticle;
 std::unique_ptr<Graphics::Material> SfxManager::explosionParticle;
 SfxManager::MaterialData SfxManager::m_materialData[TYPE_NONE];
 
-Sfx::Sfx(const vector3d &pos, const vector3d &vel, const float speed, const SFX_TYPE type) :
-	m_pos(pos),
-	m_vel(vel),
-	m_age(0.0f),
-	m_speed(speed),
-	m_type(type)
-{
-}
-
-Sfx::Sfx(const Json &jsonObj)
-{
-	try {
-		Json sfxObj = jsonObj["sfx"];
-
-		m_pos = sfxObj["pos"];
-		m_vel = sfxObj["vel"];
-		m_age = sfxObj["age"];
-		m_type = sfxObj["type"];
-	} catch (Json::type_error &) {
-		throw SavedGameCorruptException();
-	}
-}
-
-void Sfx::SaveToJson(Json &jsonObj)
-{
-	Json sfxObj({}); // Create JSON object to contain sfx data.
-
-	sfxObj["pos"] = m_pos;
-	sfxObj["vel"] = m_vel;
-	sfxObj["age"] = m_age;
-	sfxObj["type"] = m_type;
+std::unique_ptr<Graphics::VertexArray> SfxManager::s_pointArrays[TYPE_NONE];
+std::unique_ptr<Graphics::VertexArray> SfxManager::s_ecmArray;
+std::vector<SfxManager::ECMCloud> SfxManager::s_ecmClouds;
+Uint32 SfxManager::s_maxParticles = 0;
 
-	jsonObj["sfx"] = sfxObj; // Add sfx object to supplied object.
-}
-
-void Sfx::SetPosition(const vector3d &p)
+void SfxManager::Particles::Add(const vector3d &pos, const vector3d &v, double time, float s)
 {
-	m_pos = p;
+	origin.push_back(pos);
+	vel.push_back(v);
+	spawnTime.push_back(time);
+	speed.push_back(s);
 }
 
-void Sfx::TimeStepUpdate(const float timeStep)
+void SfxManager::Particles::EraseFront(size_t count)
 {
-	PROFILE_SCOPED()
-	m_age += timeStep;
-	m_pos += m_vel * double(timeStep);
-
-	switch (m_type) {
-	case TYPE_EXPLOSION:
-		if (m_age > 3.2) m_type = TYPE_NONE;
-		break;
-	case TYPE_DAMAGE:
-		if (m_age > 2.0) m_type = TYPE_NONE;
-		break;
-	case TYPE_SMOKE:
-		if (m_age > 8.0) m_type = TYPE_NONE;
-		break;
-	case TYPE_NONE: break;
-	}
-}
-
-float Sfx::AgeBlend() const
-{
-	switch (m_type) {
-	case TYPE_EXPLOSION: return (3.2 - m_age) / 3.2;
-	case TYPE_DAMAGE: return (2.0 - m_age) / 2.0;
-	case TYPE_SMOKE: return (8.0 - m_age) / 8.0;
-	case TYPE_NONE: return 0.0f;
-	}
-	return 0.0f;
+	origin.erase(origin.begin(), origin.begin() + count);
+	vel.erase(vel.begin(), vel.begin() + count);
+	spawnTime.erase(spawnTime.begin(), spawnTime.begin() + count);
+	speed.erase(speed.begin(), speed.begin() + count);
 }
 
-SfxManager::SfxManager()
+SfxManager::SfxManager() :
+	m_time(0.0)
 {
-	for (size_t t = 0; t < TYPE_NONE; t++) {
-		m_instances[t].clear();
-	}
 }
 
 void SfxManager::ToJson(Json &jsonObj, const FrameId fId)
@@ -141,14 +100,22 @@ void SfxManager::ToJson(Json &jsonObj, const FrameId fId)
 	Json sfxArray = Json::array(); // Create JSON array to contain sfx data.
 
 	if (f->m_sfx) {
+		const SfxManager &sfxman = *f->m_sfx;
 		for (size_t t = TYPE_EXPLOSION; t < TYPE_NONE; t++) {
-			for (size_t i = 0; i < f->m_sfx->GetNumberInstances(SFX_TYPE(t)); i++) {
-				Sfx &inst(f->m_sfx->GetInstanceByIndex(SFX_TYPE(t), i));
-				if (inst.m_type != TYPE_NONE) {
-					Json sfxArrayEl({}); // Create JSON object to contain sfx element.
-					inst.SaveToJson(sfxArrayEl);
-					sfxArray.push_back(sfxArrayEl); // Append sfx object to array.
-				}
+			const Particles &particles = sfxman.m_particles[t];
+			for (size_t i = 0; i < particles.spawnTime.size(); i++) {
+				const double age = sfxman.m_time - particles.spawnTime[i];
+
+				Json sfxObj({}); // Create JSON object to contain sfx data.
+				sfxObj["pos"] = particles.origin[i] + particles.vel[i] * age;
+				sfxObj["vel"] = particles.vel[i];
+				sfxObj["age"] = float(age);
+				sfxObj["speed"] = particles.speed[i];
+				sfxObj["type"] = t;
+
+				Json sfxArrayEl({}); // Create JSON object to contain sfx element.
+				sfxArrayEl["sfx"] = sfxObj;
+				sfxArray.push_back(sfxArrayEl); // Append sfx object to array.
 			}
 		}
 	}
@@ -164,8 +131,23 @@ void SfxManager::FromJson(const Json &jsonObj, FrameId fId)
 
 	if (sfxArray.size()) f->m_sfx.reset(new SfxManager);
 	for (unsigned int i = 0; i < sfxArray.size(); ++i) {
-		Sfx inst(sfxArray[i]);
-		f->m_sfx->AddInstance(inst);
+		try {
+			const Json &sfxObj = sfxArray[i]["sfx"];
+
+			const vector3d pos = sfxObj["pos"];
+			const vector3d vel = sfxObj["vel"];
+			const float age = sfxObj["age"];
+			const int type = sfxObj["type"];
+			// older saves have no size, 200 is what Add gives
+			const float speed = sfxObj.value("speed", 200.0f);
+			if (type < TYPE_EXPLOSION || type >= TYPE_NONE)
+				throw SavedGameCorruptException();
+
+			// saved oldest first, the clock starts at the saved time
+			f->m_sfx->m_particles[type].Add(pos - vel * double(age), vel, -double(age), speed);
+		} catch (Json::type_error &) {
+			throw SavedGameCorruptException();
+		}
 	}
 }
 
@@ -181,13 +163,17 @@ SfxManager *SfxManager::AllocSfxInFrame(FrameId fId)
 }
 
 void SfxManager::Add(const Body *b, SFX_TYPE t)
+{
+	Add(b->GetFrame(), b->GetPosition(), b->GetVelocity(), t);
+}
+
+void SfxManager::Add(FrameId f, const vector3d &pos, const vector3d &baseVel, SFX_TYPE t)
 {
 	assert(t != TYPE_NONE);
-	SfxManager *sfxman = AllocSfxInFrame(b->GetFrame());
+	SfxManager *sfxman = AllocSfxInFrame(f);
 	if (!sfxman) return;
-	vector3d vel(b->GetVelocity() + 200.0 * vector3d(Pi::rng.Double() - 0.5, Pi::rng.Double() - 0.5, Pi::rng.Double() - 0.5));
-	Sfx sfx(b->GetPosition(), vel, 200, t);
-	sfxman->AddInstance(sfx);
+	vector3d vel(baseVel + 200.0 * vector3d(Pi::rng.Double() - 0.5, Pi::rng.Double() - 0.5, Pi::rng.Double() - 0.5));
+	sfxman->AddParticle(t, pos, vel, 200);
 }
 
 void SfxManager::AddExplosion(Body *b)
@@ -200,8 +186,7 @@ void SfxManager::AddExplosion(Body *b)
 		ModelBody *mb = static_cast<ModelBody *>(b);
 		speed = mb->GetAabb().radius * 8.0;
 	}
-	Sfx sfx(b->GetPosition(), b->GetVelocity(), speed, TYPE_EXPLOSION);
-	sfxman->AddInstance(sfx);
+	sfxman->AddParticle(TYPE_EXPLOSION, b->GetPosition(), b->GetVelocity(), speed);
 }
 
 void SfxManager::AddThrustSmoke(const Body *b, const float speed, const vector3d &adjustpos)
@@ -209,8 +194,15 @@ void SfxManager::AddThrustSmoke(const Body *b, const float speed, const vector3d
 	SfxManager *sfxman = AllocSfxInFrame(b->GetFrame());
 	if (!sfxman) return;
 
-	Sfx sfx(b->GetPosition() + adjustpos, vector3d(0, 0, 0), speed, TYPE_SMOKE);
-	sfxman->AddInstance(sfx);
+	sfxman->AddParticle(TYPE_SMOKE, b->GetPosition() + adjustpos, vector3d(0, 0, 0), speed);
+}
+
+void SfxManager::AddECMCloud(const matrix4x4f &viewTransform, float radius, const Color &c)
+{
+	// sixteen steps of fading are enough to tell, and let clouds share draws
+	Color quantised = c;
+	quantised.a = (c.a & 0xf0) | 0x08;
+	s_ecmClouds.push_back({ viewTransform, radius, quantised });
 }
 
 void SfxManager::TimeStepAll(const float timeStep, FrameId fId)
@@ -220,12 +212,7 @@ void SfxManager::TimeStepAll(const float timeStep, FrameId fId)
 	Frame *f = Frame::GetFrame(fId);
 
 	if (f->m_sfx) {
-		for (size_t t = TYPE_EXPLOSION; t < TYPE_NONE; t++) {
-			for (size_t i = 0; i < f->m_sfx->GetNumberInstances(SFX_TYPE(t)); i++) {
-				Sfx &inst(f->m_sfx->GetInstanceByIndex(SFX_TYPE(t), i));
-				inst.TimeStepUpdate(timeStep);
-			}
-		}
+		f->m_sfx->m_time += timeStep;
 		f->m_sfx->Cleanup();
 	}
 
@@ -237,79 +224,154 @@ void SfxManager::TimeStepAll(const float timeStep, FrameId fId)
 void SfxManager::Cleanup()
 {
 	for (size_t t = TYPE_EXPLOSION; t < TYPE_NONE; t++) {
-		const size_t numInstances = GetNumberInstances(SFX_TYPE(t));
-		if (!numInstances)
-			continue;
-
-		for (Sint64 i = Sint64(numInstances - 1); i >= 0; i--) {
-			Sfx &inst(GetInstanceByIndex(SFX_TYPE(t), i));
-			if (inst.m_type == TYPE_NONE) {
-				m_instances[t].erase(m_instances[t].begin() + i);
-			}
-		}
+		Particles &particles = m_particles[t];
+		const double oldest = m_time - LIFETIME[t];
+		const auto alive = std::find_if(particles.spawnTime.begin(), particles.spawnTime.end(),
+			[oldest](double spawnTime) { return spawnTime >= oldest; });
+		if (alive != particles.spawnTime.begin())
+			particles.EraseFront(alive - particles.spawnTime.begin());
 	}
 }
 
-void SfxManager::RenderAll(Renderer *renderer, FrameId fId, FrameId camFrameId)
+void SfxManager::CollectAll(int screenHeight, FrameId fId, FrameId camFrameId)
 {
 	Frame *f = Frame::GetFrame(fId);
-	int screenHeight = renderer->GetWindowHeight();
 
-	PROFILE_SCOPED()
 	if (f->m_sfx) {
+		const SfxManager &sfxman = *f->m_sfx;
 		matrix4x4d ftran;
 		Frame::GetFrameTransform(fId, camFrameId, ftran);
 
 		for (size_t t = TYPE_EXPLOSION; t < TYPE_NONE; t++) {
-			const size_t numInstances = f->m_sfx->GetNumberInstances(SFX_TYPE(t));
+			const Particles &particles = sfxman.m_particles[t];
+			const size_t numInstances = particles.spawnTime.size();
 			if (!numInstances)
 				continue;
 
-			Graphics::Material *material = nullptr;
-			switch (t) {
-			case TYPE_NONE: assert(false); break;
-			case TYPE_EXPLOSION:
-				material = explosionParticle.get();
-				break;
-			case TYPE_DAMAGE:
-				material = damageParticle.get();
-				break;
-			case TYPE_SMOKE:
-				material = smokeParticle.get();
-				break;
-			}
-
 			// NB - we're (ab)using the normal type to hold (uv coordinate offset value + point size)
-			Graphics::VertexArray pointArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL, numInstances);
-
+			Graphics::VertexArray &pointArray = *s_pointArrays[t];
 			for (size_t i = 0; i < numInstances; i++) {
-				Sfx &inst(f->m_sfx->GetInstanceByIndex(SFX_TYPE(t), i));
-
-				assert(inst.m_type == t);
+				const double age = sfxman.m_time - particles.spawnTime[i];
 
 				// make the particle position relative to the camera frame
-				const vector3f pos(ftran * inst.m_pos);
+				const vector3f pos(ftran * (particles.origin[i] + particles.vel[i] * age));
 				// pack UV offset and particle size in normal attribute
-				const vector2f offset = CalculateOffset(SFX_TYPE(t), inst);
-				const float speed = GetParticleSpeed(screenHeight, SFX_TYPE(t), pos, inst);
+				const vector2f offset = CalculateOffset(SFX_TYPE(t), age);
+				const float speed = GetParticleSpeed(screenHeight, SFX_TYPE(t), pos, particles.speed[i], age);
 
 				pointArray.Add(pos, vector3f(offset, Clamp(speed, 0.1f, FLT_MAX)));
 			}
+		}
+	}
+
+	for (FrameId kid : f->GetChildren()) {
+		CollectAll(screenHeight, kid, camFrameId);
+	}
+}
 
-			renderer->SetTransform(matrix4x4f::Identity());
-			renderer->DrawBuffer(&pointArray, material);
+void SfxManager::CollectLights(FrameId fId, FrameId camFrameId, std::vector<Graphics::PointLight> &lights)
+{
+	// how far the light of an explosion reaches, in explosion sizes
+	static const float EXPLOSION_LIGHT_RADII = 10.0f;
+	static const Color EXPLOSION_LIGHT_COLOR(255, 160, 64);
+
+	Frame *f = Frame::GetFrame(fId);
+
+	if (f->m_sfx) {
+		const SfxManager &sfxman = *f->m_sfx;
+		const Particles &particles = sfxman.m_particles[TYPE_EXPLOSION];
+		if (!particles.spawnTime.empty()) {
+			matrix4x4d ftran;
+			Frame::GetFrameTransform(fId, camFrameId, ftran);
+
+			for (size_t i = 0; i < particles.spawnTime.size(); i++) {
+				const double age = sfxman.m_time - particles.spawnTime[i];
+				const vector3f pos(ftran * (particles.origin[i] + particles.vel[i] * age));
+				lights.push_back({ pos, particles.speed[i] * EXPLOSION_LIGHT_RADII, EXPLOSION_LIGHT_COLOR, AgeBlend(TYPE_EXPLOSION, age) });
+			}
 		}
 	}
 
 	for (FrameId kid : f->GetChildren()) {
-		RenderAll(renderer, kid, camFrameId);
+		CollectLights(kid, camFrameId, lights);
 	}
 }
 
-vector2f SfxManager::CalculateOffset(const enum SFX_TYPE type, const Sfx &inst)
+void SfxManager::RenderAll(Renderer *renderer, FrameId fId, FrameId camFrameId)
+{
+	PROFILE_SCOPED()
+
+	for (size_t t = TYPE_EXPLOSION; t < TYPE_NONE; t++)
+		s_pointArrays[t]->Clear();
+	CollectAll(renderer->GetWindowHeight(), fId, camFrameId);
+
+	renderer->SetTransform(matrix4x4f::Identity());
+	for (size_t t = TYPE_EXPLOSION; t < TYPE_NONE; t++) {
+		if (s_pointArrays[t]->IsEmpty())
+			continue;
+
+		Graphics::Material *material = nullptr;
+		switch (t) {
+		case TYPE_NONE: assert(false); break;
+		case TYPE_EXPLOSION:
+			material = explosionParticle.get();
+			break;
+		case TYPE_DAMAGE:
+			material = damageParticle.get();
+			break;
+		case TYPE_SMOKE:
+			material = smokeParticle.get();
+			break;
+		}
+
+		renderer->DrawBuffer(s_pointArrays[t].get(), material);
+	}
+
+	RenderECMClouds(renderer);
+}
+
+void SfxManager::RenderECMClouds(Renderer *renderer)
+{
+	constexpr uint32_t NUM_ECM_PARTICLES = 100;
+	if (s_ecmClouds.empty())
+		return;
+
+	// the colour is a material parameter, so clouds of the same colour go
+	// into one draw
+	std::sort(s_ecmClouds.begin(), s_ecmClouds.end(), [](const ECMCloud &a, const ECMCloud &b) {
+		return a.color.a < b.color.a;
+	});
+
+	Graphics::VertexArray &particles = *s_ecmArray;
+	for (size_t begin = 0; begin < s_ecmClouds.size();) {
+		const Color c = s_ecmClouds[begin].color;
+		particles.Clear();
+
+		size_t end = begin;
+		for (; end < s_ecmClouds.size() && s_ecmClouds[end].color == c; end++) {
+			// ECM effect: a cloud of particles for a sparkly effect
+			const ECMCloud &cloud = s_ecmClouds[end];
+			for (uint32_t i = 0; i < NUM_ECM_PARTICLES; i++) {
+				const double r1 = Pi::rng.Double() - 0.5;
+				const double r2 = Pi::rng.Double() - 0.5;
+				const double r3 = Pi::rng.Double() - 0.5;
+				const vector3f pos(cloud.radius * vector3d(r1, r2, r3).NormalizedSafe());
+				particles.Add(cloud.transform * pos, vector3f(0.f, 0.f, 50.f));
+			}
+		}
+
+		ecmParticle->diffuse = c;
+		renderer->DrawBuffer(&particles, ecmParticle.get());
+		begin = end;
+	}
+
+	s_ecmClouds.clear();
+}
+
+vector2f SfxManager::CalculateOffset(const enum SFX_TYPE type, float age)
 {
 	if (m_materialData[type].effect == Graphics::EFFECT_BILLBOARD_ATLAS) {
-		const int spriteframe = inst.AgeBlend() * (m_materialData[type].num_textures - 1);
+		const int spriteframe = AgeBlend(type, age) * (m_materialData[type].num_textures - 1);
 		const Sint32 numImgsWide = m_materialData[type].num_imgs_wide;
 		const int u = (spriteframe % numImgsWide); // % is the "modulo operator", the remainder of i / width;
 		const int v = (spriteframe / numImgsWide); // where "/" is an integer division
@@ -396,7 +458,7 @@ void SfxManager::Init(Graphics::Renderer *r)
 	Graphics::MaterialDescriptor desc;
 	desc.textures = 1;
 
-	// ECM effect is different, not managed by Sfx at all, should it be factored out?
+	// ECM effect is different, its clouds come from the ships, see AddECMCloud
 	desc.effect = Graphics::EFFECT_BILLBOARD;
 	ecmParticle.reset(r->CreateMaterial("billboards", desc, additiveAlphaState));
 	ecmParticle->SetTexture("texture0"_hash,
@@ -430,6 +492,10 @@ void SfxManager::Init(Graphics::Renderer *r)
 	if (desc.effect == Graphics::EFFECT_BILLBOARD_ATLAS)
 		explosionParticle->SetPushConstant("coordDownScale"_hash,
 			m_materialData[TYPE_EXPLOSION].coord_downscale);
+
+	for (size_t t = TYPE_EXPLOSION; t < TYPE_NONE; t++)
+		s_pointArrays[t].reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL));
+	s_ecmArray.reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL));
 }
 
 void SfxManager::Uninit()
@@ -438,4 +504,9 @@ void SfxManager::Uninit()
 	ecmParticle.reset();
 	smokeParticle.reset();
 	explosionParticle.reset();
+
+	for (size_t t = TYPE_EXPLOSION; t < TYPE_NONE; t++)
+		s_pointArrays[t].reset();
+	s_ecmArray.reset();
+	s_ecmClouds.clear();
 }
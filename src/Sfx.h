@@ -7,14 +7,17 @@
 #include "FrameId.h"
 #include "JsonFwd.h"
 #include "graphics/Material.h"
+#include "matrix4x4.h"
 
-#include <deque>
+#include <vector>
 
 class Body;
 class Frame;
 
 namespace Graphics {
 	class Renderer;
+	class VertexArray;
+	struct PointLight;
 } // namespace Graphics
 
 enum SFX_TYPE {
@@ -24,35 +27,29 @@ enum SFX_TYPE {
 	TYPE_NONE
 };
 
-struct Sfx {
-	Sfx() = delete;
-	Sfx(const vector3d &pos, const vector3d &vel, const float speed, const SFX_TYPE type);
-	Sfx(const Json &jsonObj);
-
-	const vector3d &GetPosition() const { return m_pos; }
-
-	float AgeBlend() const;
-	void SetPosition(const vector3d &p);
-
-	void TimeStepUpdate(const float timeStep);
-	void SaveToJson(Json &jsonObj);
-
-	vector3d m_pos;
-	vector3d m_vel;
-	float m_age;
-	float m_speed;
-	enum SFX_TYPE m_type;
-};
-
+// The particle effects of a frame, kept per effect type in contiguous arrays.
+// A particle moves in a straight line, so where it is follows from where and
+// when it was spawned: a time step only advances the clock of the manager and
+// drops the particles that have grown too old. Particles of a type all live
+// equally long and are added in order, so those are always the oldest ones
+// at the front.
 class SfxManager {
 public:
-	friend struct Sfx;
-
 	static void Add(const Body *, SFX_TYPE);
+	// for things that aren't bodies, moving at vel in frame f
+	static void Add(FrameId f, const vector3d &pos, const vector3d &vel, SFX_TYPE);
 	static void AddExplosion(Body *);
 	static void AddThrustSmoke(const Body *b, float speed, const vector3d &adjustpos);
+	// An ECM discharge around a ship, drawn by the next RenderAll together
+	// with the other ones of the same colour. viewTransform places the cloud
+	// in camera space like the ship's model.
+	static void AddECMCloud(const matrix4x4f &viewTransform, float radius, const Color &c);
 	static void TimeStepAll(const float timeStep, FrameId f);
+	// Draw the particles of f and its children, one draw per effect type
 	static void RenderAll(Graphics::Renderer *r, FrameId f, const FrameId camFrame);
+	// A light at each explosion in f and its children, fading with it, for
+	// the clustered lighting of the view from camFrame
+	static void CollectLights(FrameId f, const FrameId camFrame, std::vector<Graphics::PointLight> &lights);
 	static void ToJson(Json &jsonObj, const FrameId f);
 	static void FromJson(const Json &jsonObj, FrameId f);
 
@@ -64,9 +61,14 @@ public:
 	static std::unique_ptr<Graphics::Material> smokeParticle;
 	static std::unique_ptr<Graphics::Material> explosionParticle;
 
+	// The most particles of a type kept in a frame, 0 for no limit; past
+	// it new ones aren't added, so those already there don't vanish
+	static void SetMaxParticles(Uint32 count) { s_maxParticles = count; }
+	static Uint32 GetMaxParticles() { return s_maxParticles; }
+
 	SfxManager();
 
-	size_t GetNumberInstances(const SFX_TYPE t) const { return m_instances[t].size(); }
+	size_t GetNumberInstances(const SFX_TYPE t) const { return m_particles[t].spawnTime.size(); }
 	void Cleanup();
 
 private:
@@ -83,20 +85,50 @@ private:
 		float coord_downscale;
 	};
 
-	Sfx &GetInstanceByIndex(const SFX_TYPE t, const size_t i) { return m_instances[t][i]; }
-	void AddInstance(Sfx &inst) { return m_instances[inst.m_type].push_back(inst); }
+	// the particles of one effect type, oldest first
+	struct Particles {
+		// where and when each was spawned, in the frame and clock of the manager
+		std::vector<vector3d> origin;
+		std::vector<vector3d> vel;
+		std::vector<double> spawnTime;
+		// the size of explosions and the growth of smoke
+		std::vector<float> speed;
+
+		void Add(const vector3d &pos, const vector3d &v, double time, float s);
+		void EraseFront(size_t count);
+	};
+
+	struct ECMCloud {
+		matrix4x4f transform;
+		float radius;
+		Color color;
+	};
+
+	void AddParticle(SFX_TYPE t, const vector3d &pos, const vector3d &vel, float speed)
+	{
+		if (!s_maxParticles || m_particles[t].spawnTime.size() < s_maxParticles)
+			m_particles[t].Add(pos, vel, m_time, speed);
+	}
 
 	// methods
 	static SfxManager *AllocSfxInFrame(FrameId f);
-	static vector2f CalculateOffset(const enum SFX_TYPE, const Sfx &);
+	static vector2f CalculateOffset(const enum SFX_TYPE, float age);
 	static bool SplitMaterialData(const std::string &spec, MaterialData &output);
+	static void CollectAll(int screenHeight, FrameId f, const FrameId camFrame);
+	static void RenderECMClouds(Graphics::Renderer *r);
 
 	// static members
 	static MaterialData m_materialData[TYPE_NONE];
+	// filled by CollectAll, kept to reuse their storage
+	static std::unique_ptr<Graphics::VertexArray> s_pointArrays[TYPE_NONE];
+	static std::unique_ptr<Graphics::VertexArray> s_ecmArray;
+	static std::vector<ECMCloud> s_ecmClouds;
+	static Uint32 s_maxParticles;
 
 	// members
 	// per-frame
-	std::deque<Sfx> m_instances[TYPE_NONE];
+	double m_time;
+	Particles m_particles[TYPE_NONE];
 };
 
 #endif /* _SFX_H */
@@ -12,10 +12,12 @@
 #include "graphics/UniformBuffer.h"
 #include "scenegraph/NodeVisitor.h"
 #include "scenegraph/MatrixTransform.h"
+#include "scenegraph/Model.h"
 #include "scenegraph/StaticGeometry.h"
 #include "scenegraph/Node.h"
 
 #include <SDL_timer.h>
+#include <map>
 
 REGISTER_COMPONENT_TYPE(Shields) {
 	BodyComponentDB::RegisterComponent<Shields>("Shields");
@@ -45,6 +47,18 @@ namespace {
 	}
 } // namespace
 
+// One instance of a shield model with its own material, drawn for every
+// object using that model. Each draw takes the material state as it is when
+// it's submitted, so the hits of an object are set right before drawing it.
+struct Shields::SharedModel {
+	std::unique_ptr<SceneGraph::Model> model;
+	RefCountedPtr<Graphics::Material> material;
+	std::vector<SceneGraph::StaticGeometry *> geometry;
+};
+
+// the shared instances of each shield model, gone with the last object using them
+static std::map<const SceneGraph::Model *, std::weak_ptr<Shields::SharedModel>> s_sharedModels;
+
 //static
 bool Shields::s_initialised = false;
 
@@ -93,7 +107,9 @@ void Shields::Uninit()
 {
 	assert(s_initialised);
 
+	s_sharedModels.clear();
 	s_matShield.Reset();
+	s_matUniformBuffer.Reset();
 
 	s_initialised = false;
 }
@@ -107,7 +123,9 @@ struct ShieldNodeAccumulator : SceneGraph::NodeVisitor {
 };
 
 Shields::Shields() :
-	m_enabled(false)
+	m_enabled(false),
+	m_coolDown(0.0f),
+	m_strength(0.0f)
 {
 	using namespace SceneGraph;
 	assert(s_initialised);
@@ -122,28 +140,45 @@ void Shields::ApplyModel(SceneGraph::Model *model)
 {
 	assert(model);
 
-	// Clone the global material and use a per-model instance
-	Graphics::Renderer *r = model->GetRenderer();
-	Graphics::Material *globalShield = GetGlobalShieldMaterial().Get();
-	m_shieldMaterial.Reset(r->CloneMaterial(globalShield, globalShield->GetDescriptor(), r->GetMaterialRenderState(globalShield)));
-
-	// Find all static geometry nodes in the shield model
-	ShieldNodeAccumulator accum = {};
-	model->GetRoot()->Accept(accum);
-
-	m_shields.clear();
-
-	for (SceneGraph::StaticGeometry *shieldGeom : accum.nodes) {
-		// Update node materials
-		shieldGeom->SetNodeMask(SceneGraph::NODE_TRANSPARENT);
+	// forget the instances of models nothing uses any more
+	for (auto it = s_sharedModels.begin(); it != s_sharedModels.end();) {
+		if (it->second.expired())
+			it = s_sharedModels.erase(it);
+		else
+			++it;
+	}
 
-		for (uint32_t iMesh = 0; iMesh < shieldGeom->GetNumMeshes(); ++iMesh) {
-			// NOTE: model instances must contain unique StaticGeometry nodes for this to function.
-			// Sharing of StaticGeometry nodes between instances is forbidden.
-			SceneGraph::StaticGeometry::Mesh &rMesh = shieldGeom->GetMeshAt(iMesh);
-			rMesh.material = m_shieldMaterial;
+	m_model = s_sharedModels[model].lock();
+	if (!m_model) {
+		m_model = std::make_shared<SharedModel>();
+		s_sharedModels[model] = m_model;
+
+		// Clone the global material and use one per shield model
+		m_model->model.reset(model->MakeUniqueInstance());
+		Graphics::Renderer *r = model->GetRenderer();
+		Graphics::Material *globalShield = GetGlobalShieldMaterial().Get();
+		m_model->material.Reset(r->CloneMaterial(globalShield, globalShield->GetDescriptor(), r->GetMaterialRenderState(globalShield)));
+
+		// Find all static geometry nodes in the shield model
+		ShieldNodeAccumulator accum = {};
+		m_model->model->GetRoot()->Accept(accum);
+		m_model->geometry = accum.nodes;
+
+		for (SceneGraph::StaticGeometry *shieldGeom : accum.nodes) {
+			// Update node materials
+			shieldGeom->SetNodeMask(SceneGraph::NODE_TRANSPARENT);
+
+			for (uint32_t iMesh = 0; iMesh < shieldGeom->GetNumMeshes(); ++iMesh) {
+				// NOTE: the instance must contain unique StaticGeometry nodes for this to function.
+				// Sharing of StaticGeometry nodes with the loaded model is forbidden.
+				SceneGraph::StaticGeometry::Mesh &rMesh = shieldGeom->GetMeshAt(iMesh);
+				rMesh.material = m_model->material;
+			}
 		}
+	}
 
+	m_shields.clear();
+	for (SceneGraph::StaticGeometry *shieldGeom : m_model->geometry) {
 		matrix4x4f shieldTransform = shieldGeom->GetParent()->CalcGlobalTransform();
 		m_shields.push_back(Shield(Color3ub(255), shieldTransform, shieldGeom));
 	}
@@ -152,7 +187,7 @@ void Shields::ApplyModel(SceneGraph::Model *model)
 void Shields::ClearModel()
 {
 	m_shields.clear();
-	m_shieldMaterial.Reset();
+	m_model.reset();
 }
 
 void Shields::SaveToJson(Json &jsonObj)
@@ -214,42 +249,43 @@ void Shields::Update(const float coolDown, const float shieldStrength)
 		}
 	}
 
-	if (!m_enabled) {
-		for (const auto &shield : m_shields) {
-			shield.m_mesh->SetNodeMask(0x0);
-		}
+	m_coolDown = coolDown;
+	m_strength = m_enabled ? shieldStrength : 0.0f;
+}
+
+void Shields::Render(const matrix4x4f &trans)
+{
+	if (!m_model || !(m_strength > 0.0f))
 		return;
-	}
 
+	PROFILE_SCOPED()
 	// setup the render params
-	if (shieldStrength > 0.0f && m_shieldMaterial) {
-		ShieldData renderData{};
+	const Uint32 tickTime = SDL_GetTicks();
+	ShieldData renderData{};
 
-		Uint32 numHits = std::min(m_hits.size(), MAX_SHIELD_HITS);
-		for (Uint32 i = 0; i < numHits; ++i) {
-			const Hits &hit = m_hits[i];
+	Uint32 numHits = std::min(m_hits.size(), MAX_SHIELD_HITS);
+	for (Uint32 i = 0; i < numHits; ++i) {
+		const Hits &hit = m_hits[i];
 
-			//Calculate the impact's radius dependant on time
-			Uint32 dif1 = hit.end - hit.start;
-			Uint32 dif2 = tickTime - hit.start;
-			//Range from start (0.0) to end (1.0)
-			float dif = float(dif2 / (dif1 * 1.0f));
+		//Calculate the impact's radius dependant on time
+		Uint32 dif1 = hit.end - hit.start;
+		Uint32 dif2 = tickTime - hit.start;
+		//Range from start (0.0) to end (1.0)
+		float dif = float(dif2 / (dif1 * 1.0f));
 
-			renderData.hits[i].hitPos = vector3f(hit.pos.x, hit.pos.y, hit.pos.z);
-			renderData.hits[i].radii = dif;
-		}
+		renderData.hits[i].hitPos = vector3f(hit.pos.x, hit.pos.y, hit.pos.z);
+		renderData.hits[i].radii = dif;
+	}
 
-		renderData.shieldStrength = shieldStrength;
-		renderData.shieldCooldown = coolDown;
+	renderData.shieldStrength = m_strength;
+	renderData.shieldCooldown = m_coolDown;
 
-		m_shieldMaterial->SetBufferDynamic(s_shieldDataName, &renderData);
-		m_shieldMaterial->SetPushConstant(s_numHitsName, int(numHits));
-	}
+	// the data is taken from the per-frame uniform buffer, so the hits of
+	// all the shields drawn this frame end up in the same buffer
+	m_model->material->SetBufferDynamic(s_shieldDataName, &renderData);
+	m_model->material->SetPushConstant(s_numHitsName, int(numHits));
 
-	// update the shield visibility
-	for (const auto &shield : m_shields) {
-		shield.m_mesh->SetNodeMask(shieldStrength > 0.0f ? SceneGraph::NODE_TRANSPARENT : 0x0);
-	}
+	m_model->model->Render(trans);
 }
 
 void Shields::SetColor(const Color3ub &inCol)
@@ -14,6 +14,7 @@
 #include "vector3.h"
 
 #include <deque>
+#include <memory>
 
 namespace Graphics {
 	class Renderer;
@@ -38,11 +39,14 @@ public:
 	virtual void SaveToJson(Json &jsonObj);
 	virtual void LoadFromJson(const Json &jsonObj);
 
+	// The shields of all objects given the same model share one instance of
+	// it and one material; the hits of each are set just before drawing it
 	void ApplyModel(SceneGraph::Model *model);
 	void ClearModel();
 
 	void SetEnabled(const bool on) { m_enabled = on; }
 	void Update(const float coolDown, const float shieldStrength);
+	void Render(const matrix4x4f &trans);
 	void SetColor(const Color3ub &);
 	void AddHit(const vector3d &hitPos);
 
@@ -51,6 +55,9 @@ public:
 
 	SceneGraph::StaticGeometry *GetFirstShieldMesh();
 
+	// the instance of a shield model shared by the objects using it
+	struct SharedModel;
+
 protected:
 	struct Hits {
 		Hits(const vector3d &_pos, const Uint32 _start, const Uint32 _end);
@@ -61,9 +68,11 @@ protected:
 
 	std::deque<Hits> m_hits;
 	std::vector<Shield> m_shields;
-	RefCountedPtr<Graphics::Material> m_shieldMaterial;
+	std::shared_ptr<SharedModel> m_model;
 
 	bool m_enabled;
+	float m_coolDown;
+	float m_strength;
 
 	static bool s_initialised;
 };
@@ -3,6 +3,7 @@
 
 #include "EnumStrings.h"
 #include "Frame.h"
+#include "Game.h"
 #include "Pi.h"
 #include "Planet.h"
 #include "Player.h"
@@ -16,12 +17,72 @@
 #include "ship/Propulsion.h"
 
 // returns true if command is complete
+// AI level of detail: the player's distance up to which the AI runs every
+// step, each ten times further doubles the steps between updates
+static const double AI_FULL_RATE_DISTANCE = 20000.0;
+static const Uint32 AI_MAX_INTERVAL = 8;
+// bodies closer than this are checked for how soon the ship could hit them
+static const double AI_CLEARANCE_RANGE = 50000.0;
+
+Uint32 Ship::AIUpdateInterval() const
+{
+	if (!s_aiLevelOfDetail || !Pi::player || this == Pi::player || m_flightState != FLYING)
+		return 1;
+
+	// manoeuvres that are close to something, or follow a target step by step
+	switch (m_curAICmd->GetType()) {
+	case AICommand::CMD_DOCK:
+	case AICommand::CMD_KILL:
+	case AICommand::CMD_KAMIKAZE:
+	case AICommand::CMD_HOLDPOSITION:
+	case AICommand::CMD_FORMATION:
+		return 1;
+	default:
+		break;
+	}
+
+	// in combat, or near a planet or station
+	if (m_alertState != ALERT_NONE || Frame::GetFrame(GetFrame())->IsRotFrame())
+		return 1;
+
+	Uint32 interval = 1;
+	for (double range = AI_FULL_RATE_DISTANCE; interval < AI_MAX_INTERVAL; range *= 10.0) {
+		if (GetPositionRelTo(Pi::player).LengthSqr() < range * range)
+			break;
+		interval *= 2;
+	}
+	if (interval == 1)
+		return 1;
+
+	// never hold the orders for more than a quarter of the time it could
+	// take to reach anything nearby
+	const double stepTime = Pi::game->GetTimeStep();
+	for (Body *body : Pi::game->GetSpace()->GetBodiesMaybeNear(this, AI_CLEARANCE_RANGE)) {
+		if (body == this) continue;
+		const double gap = GetPositionRelTo(body).Length() - GetPhysRadius() - body->GetPhysRadius();
+		const double closing = GetVelocityRelTo(body).Length();
+		if (gap <= 0.0)
+			interval = 1;
+		else if (closing * stepTime * 4.0 * interval > gap)
+			interval = std::max(1.0, gap / (closing * stepTime * 4.0));
+		if (interval == 1)
+			break;
+	}
+	return interval;
+}
+
 bool Ship::AITimeStep(float timeStep)
 {
 	PROFILE_SCOPED()
 	// allow the launch thruster thing to happen
 	if (m_launchLockTimeout > 0.0) return false;
 
+	// between updates the thrusters keep the orders they were given last
+	if (m_curAICmd && m_aiStepsToSkip > 0) {
+		m_aiStepsToSkip--;
+		return false;
+	}
+
 	m_decelerating = false;
 	if (!m_curAICmd) {
 		if (this == Pi::player) return true;
@@ -33,6 +94,11 @@ bool Ship::AITimeStep(float timeStep)
 		return true;
 	}
 
+	// a ship that changes interval starts at its own offset into it
+	const Uint32 interval = AIUpdateInterval();
+	m_aiStepsToSkip = interval == m_aiInterval ? interval - 1 : (interval - 1) - m_aiPhase % interval;
+	m_aiInterval = interval;
+
 	if (m_curAICmd->TimeStepUpdate()) {
 		AIClearInstructions();
 		//		ClearThrusterState();		// otherwise it does one timestep at 10k and gravity is fatal
@@ -48,6 +114,7 @@ void Ship::AIClearInstructions()
 
 	delete m_curAICmd; // rely on destructor to kill children
 	m_curAICmd = 0;
+	m_aiStepsToSkip = 0; // a new command starts right away
 	m_decelerating = false; // don't adjust unless AI is running
 }
 
@@ -41,6 +41,10 @@
 static const float TONS_HULL_PER_SHIELD = 10.f;
 const float Ship::DEFAULT_SHIELD_COOLDOWN_TIME = 1.0f;
 const double Ship::DEFAULT_LIFT_TO_DRAG_RATIO = 0.001;
+const double Ship::ON_RAILS_CLEARANCE = 100000.0;
+bool Ship::s_onRailsEnabled = true;
+bool Ship::s_aiLevelOfDetail = true;
+Uint32 Ship::s_aiShipCount = 0;
 
 namespace {
 	static constexpr size_t s_heatingNormalParam = "heatingNormal"_hash;
@@ -221,6 +225,9 @@ Ship::~Ship()
 void Ship::Init()
 {
 	m_invulnerable = false;
+	m_aiInterval = 1;
+	m_aiStepsToSkip = 0;
+	m_aiPhase = s_aiShipCount++;
 
 	m_sensors.reset(new Sensors(this));
 
@@ -998,9 +1005,12 @@ void Ship::TimeStepUpdate(const float timeStep)
 	// If docked, station is responsible for updating position/orient of ship
 	// but we call this crap anyway and hope it doesn't do anything bad
 
-	const vector3d thrust = m_propulsion->GetActualLinThrust();
-	AddRelForce(thrust);
-	AddRelTorque(m_propulsion->GetActualAngThrust());
+	// a fast forward step is far too long to thrust through, the controls
+	// of the player take effect from the next step, which is an ordinary one
+	if (!(IsType(ObjectType::PLAYER) && Pi::game->IsFastForwarding())) {
+		AddRelForce(m_propulsion->GetActualLinThrust());
+		AddRelTorque(m_propulsion->GetActualAngThrust());
+	}
 
 	//apply extra atmospheric flight forces
 	AddTorque(CalcAtmoTorque());
@@ -1414,6 +1424,39 @@ void Ship::StaticUpdate(const float timeStep)
 			}
 		}
 	}
+
+	// the player only goes on rails for the game's fast forward steps; the
+	// game checks it can before each one and it stays on to the end
+	if (IsType(ObjectType::PLAYER)) {
+		if (!Pi::game->IsFastForwarding())
+			StopOnRails();
+	} else if (CanGoOnRails())
+		StartOnRails();
+	else
+		StopOnRails();
+}
+
+bool Ship::CanGoOnRails() const
+{
+	if (!s_onRailsEnabled || m_flightState != FLYING || AIIsActive())
+		return false;
+	if (m_hyperspace.countdown > 0.0f || m_hyperspace.now || m_wheelTransition || !is_equal_exact(m_wheelState, 0.0f))
+		return false;
+	if (!m_propulsion->GetActualLinThrust().ExactlyEqual(vector3d(0.0)) || !m_propulsion->GetActualAngThrust().ExactlyEqual(vector3d(0.0)))
+		return false;
+	if (m_fixedGuns->IsFiring())
+		return false;
+
+	// the player's targets are watched closely
+	if (Pi::player && (Pi::player->GetCombatTarget() == this || Pi::player->GetNavTarget() == this))
+		return false;
+
+	// nothing close to it to collide or interact with
+	for (Body *b : Pi::game->GetSpace()->GetBodiesMaybeNear(this, ON_RAILS_CLEARANCE)) {
+		if (b != this && GetPositionRelTo(b).Length() - b->GetPhysRadius() < ON_RAILS_CLEARANCE)
+			return false;
+	}
+	return true;
 }
 
 void Ship::NotifyRemoved(const Body *const removedBody)
@@ -1483,39 +1526,26 @@ void Ship::Render(Graphics::Renderer *renderer, const Camera *camera, const vect
 	m_shields->Update(m_shieldCooldown, 0.01f * GetPercentShields());
 
 	//strncpy(params.pText[0], GetLabel().c_str(), sizeof(params.pText));
+	m_navLights->UpdateBulbs();
 	RenderModel(renderer, camera, viewCoords, viewTransform);
 	m_navLights->Render(renderer);
 
-	if (m_shieldModel && shieldsVisible)
-		m_shieldModel->Render(matrix4x4f(viewTransform * GetInterpMatrix()));
+	if (shieldsVisible)
+		m_shields->Render(matrix4x4f(viewTransform * GetInterpMatrix()));
 
 	renderer->GetStats().AddToStatCount(Graphics::Stats::STAT_SHIPS, 1);
 
 	if (m_ecmRecharge > 0.0f) {
-		constexpr uint32_t NUM_ECM_PARTICLES = 100;
-		// ECM effect: a cloud of particles for a sparkly effect
-		Graphics::VertexArray particles(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL, NUM_ECM_PARTICLES);
-		for (uint32_t i = 0; i < NUM_ECM_PARTICLES; i++) {
-			const double r1 = Pi::rng.Double() - 0.5;
-			const double r2 = Pi::rng.Double() - 0.5;
-			const double r3 = Pi::rng.Double() - 0.5;
-			vector3f pos(GetPhysRadius() * vector3d(r1, r2, r3).NormalizedSafe());
-			particles.Add(pos, vector3f(0.f, 0.f, 50.f));
-		}
-
 		Color c(128, 128, 255, 255);
 		float totalRechargeTime = GetECMRechargeTime();
 		if (totalRechargeTime >= 0.0f) {
 			c.a = (m_ecmRecharge / totalRechargeTime) * 255;
 		}
 
-		SfxManager::ecmParticle->diffuse = c;
-
 		matrix4x4f t(viewTransform);
 		t.SetTranslate(vector3f(viewCoords));
 
-		renderer->SetTransform(t);
-		renderer->DrawBuffer(&particles, SfxManager::ecmParticle.get());
+		SfxManager::AddECMCloud(t, GetPhysRadius(), c);
 	}
 }
 
@@ -1584,13 +1614,10 @@ void Ship::SetupShields()
 	// TODO: remove the fallback path once all shields are extracted to their own models
 	SceneGraph::Model *sm = Pi::FindModel(m_type->shieldName, false);
 
-	if (sm) {
-		m_shieldModel.reset(sm->MakeInstance());
-		m_shields->ApplyModel(m_shieldModel.get());
-	} else {
-		m_shieldModel.reset();
+	if (sm)
+		m_shields->ApplyModel(sm);
+	else
 		m_shields->ClearModel();
-	}
 }
 
 void Ship::SetShipId(const ShipType::Id &shipId)
@@ -6,6 +6,7 @@
 
 #include <unordered_map>
 
+#include "BodyPool.h"
 #include "DynamicBody.h"
 #include "ShipType.h"
 #include "galaxy/SystemPath.h"
@@ -67,6 +68,7 @@ class Ship : public DynamicBody {
 
 public:
 	OBJDEF(Ship, DynamicBody, SHIP);
+	POOLED_BODY(Ship, SHIP);
 	Ship() = delete;
 	Ship(const Json &jsonObj, Space *space);
 	Ship(const ShipType::Id &shipId);
@@ -112,6 +114,22 @@ public:
 
 	void TimeAccelAdjust(const float timeStep);
 
+	// Put NPC ships that coast with nothing around them on rails (see
+	// DynamicBody::StartOnRails), so they cost next to nothing to update,
+	// at any time acceleration. They are back under full simulation as
+	// soon as they thrust, get near anything or become the player's target.
+	static void SetOnRailsEnabled(bool enabled) { s_onRailsEnabled = enabled; }
+	static bool IsOnRailsEnabled() { return s_onRailsEnabled; }
+	// Whether the ship coasts with nothing around it, so that it could
+	// follow its orbit on rails
+	bool CanGoOnRails() const;
+
+	// Run the AI of NPC ships far from the player only every few steps,
+	// spread over the steps; in between the thrusters keep their last
+	// orders. See AIUpdateInterval for when it runs every step regardless.
+	static void SetAILevelOfDetail(bool enabled) { s_aiLevelOfDetail = enabled; }
+	static bool IsAILevelOfDetail() { return s_aiLevelOfDetail; }
+
 	bool IsDecelerating() const { return m_decelerating; }
 
 	virtual void NotifyRemoved(const Body *const removedBody) override;
@@ -285,6 +303,7 @@ private:
 	void TestLanded();
 	void UpdateAlertState();
 	void UpdateFuel(float timeStep);
+	Uint32 AIUpdateInterval() const; // Note: defined in Ship-AI.cpp
 	void SetShipId(const ShipType::Id &shipId);
 	void SetupShields();
 	void EnterHyperspace();
@@ -294,6 +313,11 @@ private:
 	bool m_invulnerable;
 
 	static const double DEFAULT_LIFT_TO_DRAG_RATIO;
+	// how far a ship on rails has to be from any other body
+	static const double ON_RAILS_CLEARANCE;
+	static bool s_onRailsEnabled;
+	static bool s_aiLevelOfDetail;
+	static Uint32 s_aiShipCount;
 
 	static const float DEFAULT_SHIELD_COOLDOWN_TIME;
 	float m_shieldCooldown;
@@ -301,8 +325,6 @@ private:
 	const ShipType *m_type;
 	SceneGraph::ModelSkin m_skin;
 
-	std::unique_ptr<SceneGraph::Model> m_shieldModel;
-
 	Sound::Event m_beamLaser[2];
 
 	FlightState m_flightState;
@@ -322,6 +344,11 @@ private:
 	HyperspaceCloud *m_hyperspaceCloud;
 
 	AICommand *m_curAICmd;
+	// steps between AI updates, and until the next one
+	Uint32 m_aiInterval;
+	Uint32 m_aiStepsToSkip;
+	// offsets the updates of ships with the same interval
+	Uint32 m_aiPhase;
 
 	double m_landingMinOffset; // offset from the centre of the ship used during docking
 
@@ -14,6 +14,8 @@
 #include "perlin.h"
 #include "ship/Propulsion.h"
 
+#include <limits>
+
 static const double VICINITY_MIN = 15000.0;
 static const double VICINITY_MUL = 4.0;
 
@@ -81,6 +83,13 @@ void AICommand::PostLoadFixup(Space *space)
 	if (m_child) m_child->PostLoadFixup(space);
 }
 
+void AICommand::WatchBody(const Body *target, Space *space)
+{
+	if (!space)
+		space = Pi::game->GetSpace();
+	space->WatchBody(m_dBody, target);
+}
+
 bool AICommand::ProcessChild()
 {
 	if (!m_child) return true; // no child present
@@ -234,6 +243,7 @@ AICmdKamikaze::AICmdKamikaze(DynamicBody *dBody, Body *target) :
 	AICommand(dBody, CMD_KAMIKAZE)
 {
 	m_target = target;
+	WatchBody(m_target);
 	m_prop = m_dBody->GetComponent<Propulsion>();
 	assert(m_prop != nullptr);
 }
@@ -258,6 +268,7 @@ void AICmdKamikaze::PostLoadFixup(Space *space)
 {
 	AICommand::PostLoadFixup(space);
 	m_target = space->GetBodyByIndex(m_targetIndex);
+	WatchBody(m_target, space);
 	// Ensure needed sub-system:
 	m_prop = m_dBody->GetComponent<Propulsion>();
 	assert(m_prop != nullptr);
@@ -324,6 +335,7 @@ AICmdKill::AICmdKill(DynamicBody *dBody, Ship *target) :
 	AICommand(dBody, CMD_KILL)
 {
 	m_target = target;
+	WatchBody(m_target);
 	m_leadTime = m_evadeTime = m_closeTime = 0.0;
 	m_lastVel = m_target->GetVelocity();
 	m_prop = m_dBody->GetComponent<Propulsion>();
@@ -356,6 +368,7 @@ void AICmdKill::PostLoadFixup(Space *space)
 {
 	AICommand::PostLoadFixup(space);
 	m_target = static_cast<Ship *>(space->GetBodyByIndex(m_targetIndex));
+	WatchBody(m_target, space);
 	m_leadTime = m_evadeTime = m_closeTime = 0.0;
 	m_lastVel = m_target->GetVelocity();
 	// Ensure needed sub-system:
@@ -793,10 +806,12 @@ int CheckCollision(DynamicBody *dBody, const vector3d &pathdir, double pathdist,
 }
 
 // ok, need thing to step down through bodies and find closest approach
-// modify targpos directly to aim short of dangerous bodies
-static bool ParentSafetyAdjust(DynamicBody *dBody, FrameId targframeId, vector3d &targpos, vector3d &targvel)
+// margin is how far the ship is from crossing into or out of one of the
+// frames looked at, which would change the answer
+static Body *FindSafetyBody(DynamicBody *dBody, FrameId targframeId, double &margin)
 {
 	Body *body = nullptr;
+	margin = std::numeric_limits<double>::max();
 	FrameId frameId = Frame::GetFrame(targframeId)->GetNonRotFrame();
 	Frame *frame = Frame::GetFrame(frameId);
 	while (frame) {
@@ -805,6 +820,7 @@ static bool ParentSafetyAdjust(DynamicBody *dBody, FrameId targframeId, vector3d
 		if (frame->GetBody()) body = frame->GetBody();	// ignore grav points?
 
 		double sdist = dBody->GetPositionRelTo(frameId).Length();
+		margin = std::min(margin, std::abs(sdist - frame->GetRadius()));
 		if (sdist < frame->GetRadius()) break; // ship inside frame, stop
 
 		// we should always be inside the root frame, so if we're not inside 'frame'
@@ -815,6 +831,12 @@ static bool ParentSafetyAdjust(DynamicBody *dBody, FrameId targframeId, vector3d
 		frameId = parent->GetNonRotFrame();
 		frame = Frame::GetFrame(frameId); // check next frame down
 	}
+	return body;
+}
+
+// modify targpos directly to aim short of dangerous bodies
+static bool ParentSafetyAdjust(DynamicBody *dBody, Body *body, vector3d &targpos, vector3d &targvel)
+{
 	if (!body) return false;
 
 	// aim for zero velocity at surface of that body
@@ -890,6 +912,10 @@ void AICmdFlyTo::OnDeleted(const Body *body)
 {
 	AICommand::OnDeleted(body);
 	if (m_target == body) m_target = 0;
+	if (m_planBody == body) {
+		m_planBody = nullptr;
+		m_planValid = false;
+	}
 }
 
 void AICmdFlyTo::GetStatusText(char *str)
@@ -908,6 +934,7 @@ void AICmdFlyTo::PostLoadFixup(Space *space)
 {
 	AICommand::PostLoadFixup(space);
 	m_target = space->GetBodyByIndex(m_targetIndex);
+	WatchBody(m_target, space);
 	m_frameId = m_target ? m_target->GetFrame() : FrameId();
 	// Ensure needed sub-system:
 	m_prop = m_dBody->GetComponent<Propulsion>();
@@ -941,6 +968,7 @@ AICmdFlyTo::AICmdFlyTo(DynamicBody *dBody, Body *target) :
 	} else {
 		m_target = target;
 		m_targframeId = FrameId::Invalid;
+		WatchBody(m_target);
 	}
 
 	if (dBody->GetPositionRelTo(target).Length() <= VICINITY_MIN) m_targframeId = FrameId::Invalid;
@@ -1035,7 +1063,25 @@ bool AICmdFlyTo::TimeStepUpdate()
 		targvel = GetVelInFrame(m_dBody->GetFrame(), m_targframeId, m_posoff);
 	}
 	FrameId targframeId = m_target ? m_target->GetFrame() : m_targframeId;
-	ParentSafetyAdjust(m_dBody, targframeId, targpos, targvel);
+
+	// the body to aim short of is kept from step to step, until the ship
+	// changes frame, it or the target has moved too far, or it is old
+	const double time = Pi::game->GetTime();
+	if (!m_planValid || m_planFrameId != m_dBody->GetFrame() || m_planTargFrameId != targframeId ||
+		(m_dBody->GetPosition() - m_planPos).Length() > m_planTolerance ||
+		(targpos - m_planTargPos).Length() > m_planTolerance || time - m_planTime > PLAN_MAX_AGE) {
+		double margin;
+		m_planBody = FindSafetyBody(m_dBody, targframeId, margin);
+		WatchBody(m_planBody);
+		m_planValid = true;
+		m_planFrameId = m_dBody->GetFrame();
+		m_planTargFrameId = targframeId;
+		m_planPos = m_dBody->GetPosition();
+		m_planTargPos = targpos;
+		m_planTolerance = 0.25 * margin;
+		m_planTime = time;
+	}
+	ParentSafetyAdjust(m_dBody, m_planBody, targpos, targvel);
 	vector3d relpos = targpos - m_dBody->GetPosition();
 	double targdist = relpos.Length();
 
@@ -1258,6 +1304,7 @@ void AICmdDock::PostLoadFixup(Space *space)
 {
 	AICommand::PostLoadFixup(space);
 	m_target = static_cast<SpaceStation *>(space->GetBodyByIndex(m_targetIndex));
+	WatchBody(m_target, space);
 	// Ensure needed sub-system:
 	m_prop = m_dBody->GetComponent<Propulsion>();
 	assert(m_prop != nullptr);
@@ -1268,6 +1315,7 @@ AICmdDock::AICmdDock(DynamicBody *dBody, SpaceStation *target) :
 	m_target(target),
 	m_state(eDockGetDataStart)
 {
+	WatchBody(m_target);
 	Ship *ship = nullptr;
 	if (!dBody->IsType(ObjectType::SHIP)) return;
 	ship = static_cast<Ship *>(dBody);
@@ -1692,6 +1740,7 @@ AICmdFormation::AICmdFormation(DynamicBody *dBody, DynamicBody *target, const ve
 	m_target(target),
 	m_posoff(posoff)
 {
+	WatchBody(m_target);
 	m_prop = dBody->GetComponent<Propulsion>();
 	assert(m_prop != nullptr);
 }
@@ -1723,6 +1772,7 @@ void AICmdFormation::PostLoadFixup(Space *space)
 {
 	AICommand::PostLoadFixup(space);
 	m_target = static_cast<Ship *>(space->GetBodyByIndex(m_targetIndex));
+	WatchBody(m_target, space);
 	// Ensure needed sub-system:
 	m_prop = m_dBody->GetComponent<Propulsion>();
 	assert(m_prop != nullptr);
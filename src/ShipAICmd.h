@@ -63,6 +63,10 @@ public:
 	CmdName GetType() const { return m_cmdName; }
 
 protected:
+	// have OnDeleted called when target leaves the space, which is the
+	// current one unless given
+	void WatchBody(const Body *target, Space *space = nullptr);
+
 	DynamicBody *m_dBody;
 	Propulsion *m_prop;
 
@@ -78,6 +82,8 @@ public:
 	virtual bool TimeStepUpdate();
 	AICmdDock(DynamicBody *dBody, SpaceStation *target);
 
+	const SpaceStation *GetTarget() const { return m_target; }
+
 	virtual void GetStatusText(char *str);
 	virtual void SaveToJson(Json &jsonObj);
 	AICmdDock(const Json &jsonObj);
@@ -121,6 +127,9 @@ public:
 	AICmdFlyTo(DynamicBody *dBody, FrameId targframeId, const vector3d &posoff, double endvel, bool tangent);
 	AICmdFlyTo(DynamicBody *dBody, Body *target);
 
+	// nullptr when flying to a point in a frame
+	const Body *GetTarget() const { return m_target; }
+
 	virtual void GetStatusText(char *str);
 	virtual void SaveToJson(Json &jsonObj);
 	AICmdFlyTo(const Json &jsonObj);
@@ -141,6 +150,17 @@ private:
 	vector3d m_reldir; // target direction relative to ship at last frame change
 	FrameId m_frameId; // last frame of ship
 	bool m_suicideRecovery;
+
+	// the body found to aim short of, see TimeStepUpdate; not saved
+	static constexpr double PLAN_MAX_AGE = 1.0;
+	bool m_planValid = false;
+	Body *m_planBody = nullptr;
+	FrameId m_planFrameId;
+	FrameId m_planTargFrameId;
+	vector3d m_planPos;		// ship and target position when planned
+	vector3d m_planTargPos;
+	double m_planTolerance = 0.0; // how far they may move until then
+	double m_planTime = 0.0;
 };
 
 class AICmdFlyAround : public AICommand {
@@ -4,11 +4,14 @@
 #ifndef _SHIPTYPE_H
 #define _SHIPTYPE_H
 
+#include "JsonFwd.h"
 #include "ship/Propulsion.h"
 #include <map>
 #include <string>
 #include <vector>
 
+class TaskGraph;
+
 struct ShipType {
 	enum DualLaserOrientation { // <enum scope='ShipType' name='DualLaserOrientation' prefix='DUAL_LASERS_' public>
 		DUAL_LASERS_HORIZONTAL,
@@ -24,7 +27,7 @@ struct ShipType {
 	typedef std::string Id;
 
 	ShipType(){};
-	ShipType(const Id &id, const std::string &path);
+	ShipType(const Id &id, const std::string &path, Json data);
 
 	////////
 	Tag tag;
@@ -88,7 +91,7 @@ struct ShipType {
 	static std::vector<Id> static_ships;
 	static std::vector<Id> missile_ships;
 
-	static void Init();
+	static void Init(TaskGraph *taskGraph = nullptr);
 	static const ShipType *Get(const char *name)
 	{
 		std::map<Id, const ShipType>::iterator t = types.find(name);
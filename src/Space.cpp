@@ -3,6 +3,7 @@
 
 #include "Space.h"
 
+#include "ApproachPrefetch.h"
 #include "Body.h"
 #include "CityOnPlanet.h"
 #include "Frame.h"
@@ -12,24 +13,39 @@
 #include "JsonUtils.h"
 #include "Lang.h"
 #include "MathUtil.h"
+#include "ModelCache.h"
 #include "Pi.h"
 #include "Planet.h"
 #include "Player.h"
+#include "ProjectilePool.h"
+#include "Ship.h"
 #include "SpaceStation.h"
 #include "Star.h"
 #include "SystemView.h"
+#include "TrafficPool.h"
 #include "collider/CollisionContact.h"
 #include "collider/CollisionSpace.h"
 #include "core/Log.h"
+#include "core/TaskGraph.h"
 #include "galaxy/Galaxy.h"
 #include "graphics/Graphics.h"
 #include "lua/LuaEvent.h"
 #include "lua/LuaTimer.h"
+#include "ship/PrecalcPath.h"
 #include <algorithm>
 #include <functional>
 
 //#define DEBUG_CACHE
 
+static std::unique_ptr<Background::Container> MakeSystemBackground(const SystemPath &path, RefCountedPtr<Galaxy> galaxy)
+{
+	Uint32 _init[5] = { path.systemIndex, Uint32(path.sectorX), Uint32(path.sectorY), Uint32(path.sectorZ), UNIVERSE_SEED };
+	Random rand(_init, 5);
+	std::unique_ptr<Background::Container> background(new Background::Container(Pi::renderer, rand));
+	background->GetStarfield()->Fill(rand, &path, galaxy);
+	return background;
+}
+
 static void RelocateStarportIfNecessary(SystemBody *sbody, Planet *planet, vector3d &pos, matrix3x3d &rot, const std::vector<vector3d> &prevPositions)
 {
 	const double radius = planet->GetSystemBody()->GetRadius();
@@ -159,6 +175,15 @@ void Space::BodyNearFinder::Prepare()
 {
 	PROFILE_SCOPED()
 	m_bodyDist.clear();
+	m_grid.Clear();
+
+	if (s_bodyNearGrid) {
+		for (Body *b : m_space->GetBodies())
+			m_grid.Add(b->GetPositionRelTo(m_space->GetRootFrame()), b);
+
+		m_grid.Build();
+		return;
+	}
 
 	for (Body *b : m_space->GetBodies())
 		m_bodyDist.emplace_back(b, b->GetPositionRelTo(m_space->GetRootFrame()).Length());
@@ -173,6 +198,12 @@ Space::BodyNearList Space::BodyNearFinder::GetBodiesMaybeNear(const Body *b, dou
 
 Space::BodyNearList Space::BodyNearFinder::GetBodiesMaybeNear(const vector3d &pos, double dist)
 {
+	if (s_bodyNearGrid) {
+		m_nearBodies.clear();
+		m_grid.Query(pos, dist, m_nearBodies);
+		return std::move(m_nearBodies);
+	}
+
 	if (m_bodyDist.empty()) {
 		m_nearBodies.clear();
 		return std::move(m_nearBodies);
@@ -202,16 +233,27 @@ Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, Space *oldSpace) :
 	m_processingFinalizationQueue(false)
 #endif
 {
+	m_projectiles = std::make_unique<ProjectilePool>();
+	m_traffic = std::make_unique<TrafficPool>(this);
+	m_approachPrefetch = std::make_unique<ApproachPrefetch>(this);
+
 	RefreshBackground();
 
 	m_rootFrameId = Frame::CreateFrame(FrameId::Invalid, Lang::SYSTEM, Frame::FLAG_DEFAULT, FLT_MAX);
 
-	GenSectorCache(galaxy, &game->GetHyperspaceDest());
+	// the destination goes first in the queue, ahead of its neighbours
+	const SystemPath &dest = game->GetHyperspaceDest();
+	m_arrival.reset(new ArrivalPrefetch());
+	m_arrival->path = dest.SystemOnly();
+	m_arrival->starSystemCache = m_starSystemCache;
+	m_arrival->background = MakeSystemBackground(m_arrival->path, galaxy);
+	m_starSystemCache->FillCache({ m_arrival->path });
+
+	GenSectorCache(galaxy, &dest);
 }
 
-Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const SystemPath &path, Space *oldSpace) :
+Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const SystemPath &path, Space *oldSpace, ArrivalPrefetch *arrival) :
 	m_starSystemCache(oldSpace ? oldSpace->m_starSystemCache : galaxy->NewStarSystemSlaveCache()),
-	m_starSystem(galaxy->GetStarSystem(path)),
 	m_game(game),
 	m_bodyIndexValid(false),
 	m_sbodyIndexValid(false),
@@ -222,7 +264,27 @@ Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const SystemPath &path, S
 #endif
 {
 	PROFILE_SCOPED()
-	RefreshBackground();
+	m_projectiles = std::make_unique<ProjectilePool>();
+	m_traffic = std::make_unique<TrafficPool>(this);
+	m_approachPrefetch = std::make_unique<ApproachPrefetch>(this);
+
+	if (arrival && arrival->path.IsSameSystem(path)) {
+		// after a short jump the destination's job may not have run yet. It
+		// was queued ahead of its neighbours on the synchronous queue, so
+		// running that queue up to it publishes the system, rather than the
+		// system being generated here and again by the job
+		m_starSystemCache = arrival->starSystemCache;
+		const SystemPath systemPath = path.SystemOnly();
+		m_starSystem = arrival->starSystem ? arrival->starSystem : m_starSystemCache->GetIfCached(systemPath);
+		while (!m_starSystem && m_starSystemCache->IsFilling() && Pi::GetApp()->RunSyncJobs() > 0)
+			m_starSystem = m_starSystemCache->GetIfCached(systemPath);
+		if (!m_starSystem)
+			m_starSystem = m_starSystemCache->GetCached(systemPath);
+		m_background = std::move(arrival->background);
+	} else {
+		m_starSystem = galaxy->GetStarSystem(path);
+		RefreshBackground();
+	}
 
 	CityOnPlanet::SetCityModelPatterns(m_starSystem->GetPath());
 
@@ -247,6 +309,10 @@ Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const Json &jsonObj, doub
 #endif
 {
 	PROFILE_SCOPED()
+	m_projectiles = std::make_unique<ProjectilePool>();
+	m_traffic = std::make_unique<TrafficPool>(this);
+	m_approachPrefetch = std::make_unique<ApproachPrefetch>(this);
+
 	Json spaceObj = jsonObj["space"];
 
 	m_starSystem = StarSystem::FromJson(galaxy, spaceObj);
@@ -265,7 +331,7 @@ Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const Json &jsonObj, doub
 		for (Uint32 i = 0; i < bodyArray.size(); i++) {
 			if (bodyArray[i].count("is_not_in_space") > 0)
 				continue;
-			m_bodies.push_back(Body::FromJson(bodyArray[i], this));
+			AddBody(Body::FromJson(bodyArray[i], this));
 		}
 	} catch (Json::type_error &) {
 		throw SavedGameCorruptException();
@@ -273,6 +339,12 @@ Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const Json &jsonObj, doub
 
 	RebuildBodyIndex();
 
+	// older saves have their shots as bodies
+	if (spaceObj.count("projectiles"))
+		m_projectiles->FromJson(spaceObj["projectiles"], this);
+	if (spaceObj.count("traffic"))
+		m_traffic->FromJson(spaceObj["traffic"], this);
+
 	Frame::PostUnserializeFixup(m_rootFrameId, this);
 	for (Body *b : m_bodies)
 		b->PostLoadFixup(this);
@@ -325,15 +397,15 @@ void Space::RefreshBackground()
 {
 	PROFILE_SCOPED()
 	if (m_starSystem.Valid()) {
-		const SystemPath &path = m_starSystem->GetPath();
-		Uint32 _init[5] = { path.systemIndex, Uint32(path.sectorX), Uint32(path.sectorY), Uint32(path.sectorZ), UNIVERSE_SEED };
-		Random rand(_init, 5);
-		m_background.reset(new Background::Container(Pi::renderer, rand));
-		m_background->GetStarfield()->Fill(rand, &this->GetStarSystem()->GetPath(), m_game->GetGalaxy());
+		m_background = MakeSystemBackground(m_starSystem->GetPath(), m_game->GetGalaxy());
 	} else {
 		m_background.reset(new Background::Container(Pi::renderer, Pi::rng));
 		m_background->GetStarfield()->Fill(Pi::rng, nullptr, m_game->GetGalaxy());
 	}
+
+	// the settings have changed for the destination, too
+	if (m_arrival)
+		m_arrival->background = MakeSystemBackground(m_arrival->path, m_game->GetGalaxy());
 }
 
 void Space::ToJson(Json &jsonObj)
@@ -373,9 +445,84 @@ void Space::ToJson(Json &jsonObj)
 	}
 	spaceObj["bodies"] = bodyArray; // Add body array to space object.
 
+	Json projectileArray;
+	m_projectiles->ToJson(projectileArray, this);
+	spaceObj["projectiles"] = projectileArray;
+
+	Json trafficObj;
+	m_traffic->ToJson(trafficObj, this);
+	spaceObj["traffic"] = trafficObj;
+
 	jsonObj["space"] = spaceObj; // Add space object to supplied object.
 }
 
+extern int CheckCollision(DynamicBody *dBody, const vector3d &pathdir, double pathdist, double targAlt, double endvel, double r);
+extern double MaxEffectRad(const Body *body, Propulsion *prop);
+
+void Space::PutShipOnRoute(Ship *ship, const Body *target, double t_ratio)
+{
+	const ShipType *st = ship->GetShipType();
+	const shipstats_t ss = ship->GetStats();
+	const vector3d route = target->GetPositionRelTo(ship->GetFrame()) - ship->GetPosition();
+	PrecalcPath pp(
+		route.Length(), // distance
+		0.0,			// velocity at start
+		st->effectiveExhaustVelocity,
+		st->linThrust[THRUSTER_FORWARD],
+		st->linAccelerationCap[THRUSTER_FORWARD],
+		1000 * (ss.static_mass + ss.fuel_tank_mass_left), // 100% mass of the ship
+		1000 * ss.fuel_tank_mass_left * 0.8,			  // multipied to 0.8 have fuel reserve
+		0.85);											  // braking margin
+	// determine the place of the ship on the route
+	pp.setTRatio(t_ratio);
+	ship->SetPosition(ship->GetPosition() + route.Normalized() * pp.getDist());
+	ship->SetVelocity(route.Normalized() * pp.getVel() + target->GetVelocityRelTo(ship->GetFrame()));
+	ship->SetFuel((0.001 * pp.getMass() - ss.static_mass) / st->fuelTankMass);
+
+	ship->UpdateFrame();
+	// check for collision at spawn position
+	const vector3d shippos = ship->GetPosition();
+	const vector3d targpos = target->GetPositionRelTo(ship->GetFrame());
+	double targAlt = targpos.Length();
+	const vector3d relpos = targpos - shippos;
+	const vector3d reldir = relpos.NormalizedSafe();
+	const double targdist = relpos.Length();
+	Body *body = Frame::GetFrame(ship->GetFrame())->GetBody();
+	const double erad = MaxEffectRad(body, ship->GetPropulsion());
+	const int coll = CheckCollision(ship, reldir, targdist, targAlt, 0, erad);
+	if (coll) {
+		// need to correct positon, to avoid collision
+		if (targAlt > erad) {
+			// target is above the effective radius of obstructor - rotate the ship's position
+			// around the target position, so that the obstructor's "effective radius" does not cross the path
+			// direction obstructor -> target
+			const vector3d z = targpos / targAlt;
+			// the axis around which the position of the ship will rotate
+			const vector3d y = z.Cross(shippos).NormalizedSafe();
+			// just the third axis of this basis
+			const vector3d x = y.Cross(z);
+
+			// this is the basis in which the position of the ship will rotate
+			const matrix3x3d corrCS = matrix3x3d::FromVectors(x, y, z).Transpose();
+			const double len = targAlt;
+			// two possible positions of the ship, when flying around the obstructor to the right or left
+			// rotate (in the given basis) the direction from the target to the obstructor, so that it passes tangentially to the obstructor
+			const vector3d safe1 = corrCS.Transpose() * (matrix3x3d::RotateY(+asin(erad / len)) * corrCS * -targpos).Normalized() * targdist;
+			const vector3d safe2 = corrCS.Transpose() * (matrix3x3d::RotateY(-asin(erad / len)) * corrCS * -targpos).Normalized() * targdist;
+			// choose the one that is closer to the current position of the ship
+			if ((safe1 + relpos).Length() < (safe2 + relpos).Length())
+				ship->SetPosition(safe1 + targpos);
+			else
+				ship->SetPosition(safe2 + targpos);
+		} else {
+			// target below the effective radius of obstructor. Position the ship direct above the target
+			ship->SetPosition(targpos + targpos / targAlt * targdist);
+		}
+		// update velocity direction
+		ship->SetVelocity((targpos - ship->GetPosition()).Normalized() * pp.getVel() + target->GetVelocityRelTo(ship->GetFrame()));
+	}
+}
+
 Body *Space::GetBodyByIndex(Uint32 idx) const
 {
 	assert(m_bodyIndexValid);
@@ -454,9 +601,42 @@ void Space::RebuildSystemBodyIndex()
 	m_sbodyIndexValid = true;
 }
 
+// remove the first copy of value from v, if there is one
+template <typename T, typename U>
+static void erase_value(std::vector<T> &v, const U &value)
+{
+	auto it = std::find(v.begin(), v.end(), value);
+	if (it != v.end())
+		v.erase(it);
+}
+
 void Space::AddBody(Body *b)
 {
+	if (m_bodySlots.count(b)) {
+		// added back before its removal was processed, so it just stays
+		m_assignedBodies.erase(std::remove_if(m_assignedBodies.begin(), m_assignedBodies.end(), [b](const std::pair<Body *, BodyAssignation> &a) {
+			return a.first == b && a.second == BodyAssignation::REMOVE;
+		}),
+			m_assignedBodies.end());
+		return;
+	}
+
+	m_bodySlots[b] = Uint32(m_bodies.size());
 	m_bodies.push_back(b);
+	if (b->GetFlags() & Body::FLAG_NOTIFY_REMOVALS)
+		m_removalListeners.push_back(b);
+}
+
+void Space::WatchBody(Body *watcher, const Body *target)
+{
+	if (!target || target == watcher || (watcher->GetFlags() & Body::FLAG_NOTIFY_REMOVALS))
+		return;
+
+	std::vector<const Body *> &watched = m_watched[watcher];
+	if (std::find(watched.begin(), watched.end(), target) != watched.end())
+		return;
+	watched.push_back(target);
+	m_watchers[target].push_back(watcher);
 }
 
 void Space::RemoveBody(Body *b)
@@ -566,9 +746,24 @@ Body *Space::FindNearestTo(const Body *b, ObjectType t) const
 	return nearest;
 }
 
-std::vector<Space::BodyDist> Space::BodiesInAngle(const Body *b, const vector3d &offset, const vector3d &view_dir, double cosOfMaxAngle) const
+template <typename Function>
+void Space::ForEachBodyInAngle(const Body *b, const vector3d &offset, const vector3d &view_dir, double cosOfMaxAngle, Function &&fn) const
 {
-	std::vector<BodyDist> ret;
+	// the grid only holds the bodies of the last timestep; bodies are only
+	// ever deleted right before it is rebuilt, so a matching count means
+	// none were added since
+	const SpatialGrid<Body *> &grid = m_bodyNearFinder.GetGrid();
+	if (s_bodyNearGrid && grid.GetNumObjects() == m_bodies.size()) {
+		const matrix3x3d orient = b->GetOrientRelTo(m_rootFrameId);
+		const vector3d apex = b->GetPositionRelTo(m_rootFrameId) + orient * offset;
+
+		grid.QueryCone(apex, orient * view_dir, cosOfMaxAngle, [&](Body *body, double d) {
+			if (body != b && !body->IsDead())
+				fn(body, d);
+		});
+		return;
+	}
+
 	for (Body *const body : m_bodies) {
 		if (body == b) continue;
 		if (body->IsDead()) continue;
@@ -583,11 +778,44 @@ std::vector<Space::BodyDist> Space::BodiesInAngle(const Body *b, const vector3d
 		if (dirBody.Dot(view_dir) < cosOfMaxAngle)
 			continue;
 
-		ret.emplace_back(body, d);
+		fn(body, d);
 	}
+}
+
+std::vector<Space::BodyDist> Space::BodiesInAngle(const Body *b, const vector3d &offset, const vector3d &view_dir, double cosOfMaxAngle) const
+{
+	PROFILE_SCOPED()
+	std::vector<BodyDist> ret;
+	ForEachBodyInAngle(b, offset, view_dir, cosOfMaxAngle, [&](Body *body, double d) {
+		ret.emplace_back(body, d);
+	});
 	return ret;
 }
 
+size_t Space::BodiesInAngle(const Body *b, const vector3d &offset, const vector3d &view_dir, double cosOfMaxAngle, BodyDist *out, size_t maxCount) const
+{
+	PROFILE_SCOPED()
+	if (!maxCount)
+		return 0;
+
+	// out[0, count) is a max-heap on distance, so the farthest body is
+	// replaced whenever a nearer one turns up
+	size_t count = 0;
+	ForEachBodyInAngle(b, offset, view_dir, cosOfMaxAngle, [&](Body *body, double d) {
+		if (count < maxCount) {
+			out[count++] = BodyDist(body, d);
+			std::push_heap(out, out + count);
+		} else if (d < out[0].dist) {
+			std::pop_heap(out, out + count);
+			out[count - 1] = BodyDist(body, d);
+			std::push_heap(out, out + count);
+		}
+	});
+
+	std::sort_heap(out, out + count);
+	return count;
+}
+
 Body *Space::FindBodyForPath(const SystemPath *path) const
 {
 	if (!m_game->IsNormalSpace() || !path->IsSameSystem(m_starSystem->GetPath()))
@@ -679,6 +907,27 @@ void Space::GenSectorCache(RefCountedPtr<Galaxy> galaxy, const SystemPath *here)
 	m_sectorCache->FillCache(paths, [this, center]() { UpdateStarSystemCache(&center); });
 }
 
+void Space::UpdateArrivalPrefetch()
+{
+	PROFILE_SCOPED()
+
+	// it isn't drawn until it is taken over
+	if (m_arrival->background)
+		m_arrival->background->GetStarfield()->UpdateFill();
+
+	if (m_arrival->starSystem)
+		return;
+	m_arrival->starSystem = m_starSystemCache->GetIfCached(m_arrival->path);
+	if (!m_arrival->starSystem)
+		return;
+
+	for (const SystemBody *sbody : m_arrival->starSystem->GetSpaceStations()) {
+		Random rand(sbody->GetSeed());
+		if (const SpaceStationType *type = SpaceStation::GetStationType(sbody, rand))
+			Pi::modelCache->RequestModel(type->ModelName());
+	}
+}
+
 static bool WithinBox(const SystemPath &here, const int Xmin, const int Xmax, const int Ymin, const int Ymax, const int Zmin, const int Zmax)
 {
 	PROFILE_SCOPED()
@@ -1023,33 +1272,98 @@ static void hitCallback(CollisionContact *c)
 }
 
 // temporary one-point version
-static void CollideWithTerrain(Body *body, float timeStep)
+// only reads the body and its frame, so may be called from worker threads
+static bool TestTerrainCollision(Body *body, float timeStep, CollisionContact &contact)
 {
 	PROFILE_SCOPED()
 	if (!body->IsType(ObjectType::DYNAMICBODY))
-		return;
+		return false;
 	DynamicBody *dynBody = static_cast<DynamicBody *>(body);
 	if (!dynBody->IsMoving())
-		return;
+		return false;
 
 	Frame *f = Frame::GetFrame(body->GetFrame());
 	if (!f || !f->GetBody() || f->GetId() != f->GetBody()->GetFrame())
-		return;
+		return false;
 	if (!f->GetBody()->IsType(ObjectType::TERRAINBODY))
-		return;
+		return false;
 	TerrainBody *terrain = static_cast<TerrainBody *>(f->GetBody());
 
 	const Aabb &aabb = dynBody->GetAabb();
 	double altitude = body->GetPosition().Length() + aabb.min.y;
 	if (altitude >= (terrain->GetMaxFeatureRadius() * 2.0))
-		return;
+		return false;
 
-	double terrHeight = terrain->GetTerrainHeight(body->GetPosition().Normalized());
+	double terrHeight = terrain->GetGeneratedTerrainHeight(body->GetPosition().Normalized());
 	if (altitude >= terrHeight)
-		return;
+		return false;
+
+	contact = CollisionContact(body->GetPosition(), body->GetPosition().Normalized(), terrHeight - altitude, timeStep, static_cast<void *>(body), static_cast<void *>(f->GetBody()));
+	return true;
+}
+
+static void CollideWithTerrain(Body *body, float timeStep)
+{
+	CollisionContact c;
+	if (TestTerrainCollision(body, timeStep, c))
+		hitCallback(&c);
+}
+
+// Run fn(idx) for every idx in [0, count) on the TaskGraph and wait for it
+template <typename Function>
+static void ParallelFor(size_t count, Function &&fn)
+{
+	TaskGraph *graph = Pi::GetApp()->GetTaskGraph();
+
+	TaskSet *set = new TaskSet();
+	set->AddTaskRangeLambda({ 0, uint32_t(count) }, 16, [&fn](TaskRange range) {
+		for (uint32_t idx = range.begin; idx < range.end; idx++)
+			fn(idx);
+	});
+
+	TaskSet::Handle handle = graph->QueueTaskSet(set);
+	graph->WaitForTaskSet(handle);
+}
+
+//static
+bool Space::s_parallelBodyUpdate = false;
+//static
+bool Space::s_parallelCollision = false;
+bool Space::s_bodyNearGrid = true;
+
+// Test all bodies against the terrain in parallel, then report the contacts
+// serially in body order so collision responses are deterministic
+void Space::CollideWithTerrainParallel(float step)
+{
+	PROFILE_SCOPED()
+	m_terrainContacts.assign(m_bodies.size(), CollisionContact());
+
+	ParallelFor(m_bodies.size(), [this, step](uint32_t idx) {
+		TestTerrainCollision(m_bodies[idx], step, m_terrainContacts[idx]);
+	});
+
+	for (CollisionContact &c : m_terrainContacts) {
+		if (c.userData1)
+			hitCallback(&c);
+	}
+}
+
+// Integrate the bodies whose integration was deferred by TimeStepUpdate:
+// their velocities all at once in the PhysicsStore, then their positions
+void Space::IntegrateBodiesParallel(float step)
+{
+	PROFILE_SCOPED()
+	m_integrateBodies.clear();
+	for (Body *b : m_bodies) {
+		if (b->IsType(ObjectType::DYNAMICBODY) && static_cast<DynamicBody *>(b)->HasPendingIntegration())
+			m_integrateBodies.push_back(static_cast<DynamicBody *>(b));
+	}
 
-	CollisionContact c(body->GetPosition(), body->GetPosition().Normalized(), terrHeight - altitude, timeStep, static_cast<void *>(body), static_cast<void *>(f->GetBody()));
-	hitCallback(&c);
+	PhysicsStore::Get().IntegratePending(step, Pi::GetApp()->GetTaskGraph());
+
+	ParallelFor(m_integrateBodies.size(), [this, step](uint32_t idx) {
+		m_integrateBodies[idx]->FinishTimeStep(step);
+	});
 }
 
 void Space::TimeStep(float step)
@@ -1059,12 +1373,21 @@ void Space::TimeStep(float step)
 	if (Pi::MustRefreshBackgroundClearFlag())
 		RefreshBackground();
 
+	if (m_arrival)
+		UpdateArrivalPrefetch();
+
 	m_bodyIndexValid = m_sbodyIndexValid = false;
 
-	Frame::CollideFrames(&hitCallback);
+	const bool parallel = s_parallelBodyUpdate && m_bodies.size() >= MIN_PARALLEL_BODIES;
 
-	for (Body *b : m_bodies)
-		CollideWithTerrain(b, step);
+	Frame::CollideFrames(&hitCallback, s_parallelCollision ? Pi::GetApp()->GetTaskGraph() : nullptr);
+
+	if (parallel) {
+		CollideWithTerrainParallel(step);
+	} else {
+		for (Body *b : m_bodies)
+			CollideWithTerrain(b, step);
+	}
 
 	// update frames of reference
 	for (Body *b : m_bodies)
@@ -1083,10 +1406,22 @@ void Space::TimeStep(float step)
 		auto b = m_bodies[i];
 		b->StaticUpdate(step);
 	}
-	Frame::UpdateOrbitRails(m_game->GetTime(), m_game->GetTimeStep());
+	m_projectiles->TimeStep(step);
+	Frame::UpdateOrbitRails(m_game->GetTime(), step, s_parallelBodyUpdate ? Pi::GetApp()->GetTaskGraph() : nullptr);
 
+	// in parallel mode, bodies run their serial update logic first (in body
+	// order) and the actual integration is then done for all of them at once;
+	// integration only touches the body being integrated
+	DynamicBody::SetDeferIntegration(parallel);
 	for (Body *b : m_bodies)
 		b->TimeStepUpdate(step);
+	DynamicBody::SetDeferIntegration(false);
+
+	if (parallel)
+		IntegrateBodiesParallel(step);
+
+	m_traffic->TimeStep(m_game->GetTime(), m_game->GetPlayer());
+	m_approachPrefetch->TimeStep(m_game->GetTime(), m_game->GetPlayer());
 
 	LuaEvent::Emit();
 	Pi::luaTimer->Tick();
@@ -1103,23 +1438,74 @@ void Space::UpdateBodies()
 	m_processingFinalizationQueue = true;
 #endif
 
-	// removing or deleting bodies from space
+	// pending Lua events may still refer to the bodies about to be deleted
+	if (!m_assignedBodies.empty())
+		LuaEvent::Flush();
+
+	// take them all out of the body list first, then tell their listeners
+	// and watchers about them, and only then delete the killed ones. A body
+	// assigned twice is only handled the first time.
+	m_removedBodies.clear();
+	size_t numAssigned = 0;
 	for (const auto &b : m_assignedBodies) {
-		auto remove_iterator = m_bodies.end();
-		for (auto it = m_bodies.begin(); it != m_bodies.end(); ++it) {
-			if (*it != b.first)
-				(*it)->NotifyRemoved(b.first);
-			else
-				remove_iterator = it;
+		auto slot = m_bodySlots.find(b.first);
+		if (slot == m_bodySlots.end())
+			continue;
+
+		// swap the last body into its place
+		const Uint32 index = slot->second;
+		m_bodySlots.erase(slot);
+		Body *last = m_bodies.back();
+		m_bodies.pop_back();
+		if (last != b.first) {
+			m_bodies[index] = last;
+			m_bodySlots[last] = index;
 		}
-		if (remove_iterator != m_bodies.end()) {
-			*remove_iterator = m_bodies.back();
-			m_bodies.pop_back();
-			if (b.second == BodyAssignation::KILL)
-				delete b.first;
-			else
-				b.first->SetFrame(FrameId::Invalid);
+
+		if (b.first->GetFlags() & Body::FLAG_NOTIFY_REMOVALS)
+			erase_value(m_removalListeners, b.first);
+		m_removedBodies.push_back(b.first);
+		m_assignedBodies[numAssigned++] = b;
+	}
+	m_assignedBodies.resize(numAssigned);
+
+	for (const Body *removed : m_removedBodies) {
+		for (Body *listener : m_removalListeners)
+			listener->NotifyRemoved(removed);
+
+		auto it = m_watchers.find(removed);
+		if (it == m_watchers.end())
+			continue;
+		// taken out first, a watcher may watch something else in return
+		const std::vector<Body *> watchers = std::move(it->second);
+		m_watchers.erase(it);
+		for (Body *watcher : watchers) {
+			erase_value(m_watched[watcher], removed);
+			watcher->NotifyRemoved(removed);
+		}
+	}
+
+	std::sort(m_removedBodies.begin(), m_removedBodies.end());
+	m_projectiles->NotifyRemoved(m_removedBodies);
+	m_traffic->NotifyRemoved(m_removedBodies);
+	m_approachPrefetch->NotifyRemoved(m_removedBodies);
+
+	for (const auto &b : m_assignedBodies) {
+		// a body that has left doesn't hear about its targets any more
+		auto watched = m_watched.find(b.first);
+		if (watched != m_watched.end()) {
+			for (const Body *target : watched->second) {
+				auto watchers = m_watchers.find(target);
+				if (watchers != m_watchers.end())
+					erase_value(watchers->second, b.first);
+			}
+			m_watched.erase(watched);
 		}
+
+		if (b.second == BodyAssignation::KILL)
+			delete b.first;
+		else
+			b.first->SetFrame(FrameId::Invalid);
 	}
 
 	m_assignedBodies.clear();
@@ -8,12 +8,21 @@
 #include "FrameId.h"
 #include "IterationProxy.h"
 #include "RefCounted.h"
+#include "SpatialGrid.h"
+#include "collider/CollisionContact.h"
 #include "galaxy/StarSystem.h"
 #include "vector3.h"
 
+#include <unordered_map>
+
 class Body;
+class DynamicBody;
 class Frame;
 class Game;
+class ApproachPrefetch;
+class ProjectilePool;
+class Ship;
+class TrafficPool;
 enum class ObjectType;
 
 class Space {
@@ -21,8 +30,21 @@ public:
 	// empty space (eg for hyperspace)
 	Space(Game *game, RefCountedPtr<Galaxy> galaxy, Space *oldSpace = nullptr);
 
-	// initialise with system bodies
-	Space(Game *game, RefCountedPtr<Galaxy> galaxy, const SystemPath &path, Space *oldSpace = nullptr);
+	// What the hyperspace Space of a jump gets ready of the destination
+	// while the jump lasts: its star system is generated before any other
+	// (along with those around it, in the same star system cache) and its
+	// starfield picked on worker threads, and once the system is known the
+	// models of its stations are read in the background.
+	struct ArrivalPrefetch {
+		SystemPath path;
+		RefCountedPtr<StarSystemCache::Slave> starSystemCache;
+		RefCountedPtr<StarSystem> starSystem;
+		std::unique_ptr<Background::Container> background;
+	};
+
+	// initialise with system bodies, taking over what arrival has prepared
+	// if it is for the same system
+	Space(Game *game, RefCountedPtr<Galaxy> galaxy, const SystemPath &path, Space *oldSpace = nullptr, ArrivalPrefetch *arrival = nullptr);
 
 	// initialise from save file
 	Space(Game *game, RefCountedPtr<Galaxy> galaxy, const Json &jsonObj, double at_time);
@@ -47,8 +69,41 @@ public:
 	void RemoveBody(Body *);
 	void KillBody(Body *);
 
+	// Have watcher->NotifyRemoved(target) called when target leaves the
+	// space. Bodies with Body::FLAG_NOTIFY_REMOVALS are told about every
+	// removal without asking; the others are only told about what they
+	// watch. A watch lasts until either body leaves, so a body that stops
+	// referring to its target early only gets a notification it ignores.
+	void WatchBody(Body *watcher, const Body *target);
+
 	void TimeStep(float step);
 
+	// the shots of the guns fired in this space
+	ProjectilePool *GetProjectiles() { return m_projectiles.get(); }
+	// the NPC ships flying between the stations of this space
+	TrafficPool *GetTraffic() { return m_traffic.get(); }
+
+	// Move ship, starting at rest where it is, to where it would be at
+	// t_ratio (0 to 1) of the way along a flight to target, with the speed
+	// and fuel it would have there, clear of anything in the way
+	static void PutShipOnRoute(Ship *ship, const Body *target, double t_ratio);
+
+	// Run terrain collision and DynamicBody integration for all bodies on
+	// TaskGraph worker threads. Anything with side effects outside a single
+	// body still runs serially, in body order.
+	static void SetParallelBodyUpdate(bool enabled) { s_parallelBodyUpdate = enabled; }
+	static bool IsParallelBodyUpdate() { return s_parallelBodyUpdate; }
+
+	// Collide the frames' collision spaces on TaskGraph worker threads; see
+	// Frame::CollideFrames.
+	static void SetParallelCollision(bool enabled) { s_parallelCollision = enabled; }
+	static bool IsParallelCollision() { return s_parallelCollision; }
+
+	// Answer GetBodiesMaybeNear from a spatial grid of the bodies instead of
+	// a list sorted by their distance from the system origin.
+	static void SetBodyNearGrid(bool enabled) { s_bodyNearGrid = enabled; }
+	static bool IsBodyNearGrid() { return s_bodyNearGrid; }
+
 	void GetHyperspaceExitParams(const SystemPath &source, const SystemPath &dest,
 		vector3d &pos, vector3d &vel) const;
 	vector3d GetHyperspaceExitPoint(const SystemPath &source, const SystemPath &dest) const
@@ -72,6 +127,9 @@ public:
 	Background::Container *GetBackground() { return m_background.get(); }
 	void RefreshBackground();
 
+	// for the Space of the destination, once the jump is over
+	std::unique_ptr<ArrivalPrefetch> TakeArrivalPrefetch() { return std::move(m_arrival); }
+
 	// body finder delegates
 	typedef const std::vector<Body *> BodyNearList;
 	BodyNearList GetBodiesMaybeNear(const Body *b, double dist)
@@ -86,6 +144,9 @@ public:
 	void DebugDumpFrames(bool details);
 
 	struct BodyDist {
+		BodyDist() :
+			body(nullptr),
+			dist(0.0) {}
 		BodyDist(Body *_body, double _dist) :
 			body(_body),
 			dist(_dist) {}
@@ -100,13 +161,16 @@ public:
 
 	//Find bodies within angle to given direction. dir and offset relative to b like in ship coordinates
 	//returns unsorted vector of bodies with their distance from b+offset
-	//It calculates distance from b for all the bodies so it is quite inefficiet,
-	//it is not designed to be called in each game loop!
+	//With the body near grid, only bodies in grid cells overlapping the cone are tested
 	std::vector<BodyDist> BodiesInAngle(const Body *b, const vector3d &offset, const vector3d &dir, double cosOfMaxAngle) const;
+	//As above, but write the (at most) maxCount nearest bodies to out, sorted by distance,
+	//and return how many were written
+	size_t BodiesInAngle(const Body *b, const vector3d &offset, const vector3d &dir, double cosOfMaxAngle, BodyDist *out, size_t maxCount) const;
 
 private:
 	void GenSectorCache(RefCountedPtr<Galaxy> galaxy, const SystemPath *here);
 	void UpdateStarSystemCache(const SystemPath *here);
+	void UpdateArrivalPrefetch();
 	void GenBody(const double at_time, SystemBody *b, FrameId fId, std::vector<vector3d> &posAccum);
 	// make sure SystemBody* is in Pi::currentSystem
 	FrameId GetFrameWithSystemBody(const SystemBody *b) const;
@@ -115,6 +179,18 @@ private:
 
 	void CollideFrame(FrameId fId);
 
+	template <typename Function>
+	void ForEachBodyInAngle(const Body *b, const vector3d &offset, const vector3d &dir, double cosOfMaxAngle, Function &&fn) const;
+
+	void CollideWithTerrainParallel(float step);
+	void IntegrateBodiesParallel(float step);
+
+	// below this many bodies the serial update is faster
+	static constexpr size_t MIN_PARALLEL_BODIES = 64;
+	static bool s_parallelBodyUpdate;
+	static bool s_parallelCollision;
+	static bool s_bodyNearGrid;
+
 	FrameId m_rootFrameId;
 
 	RefCountedPtr<SectorCache::Slave> m_sectorCache;
@@ -126,6 +202,23 @@ private:
 
 	// all the bodies we know about
 	std::vector<Body *> m_bodies;
+	// where each body is in m_bodies, for removing it in constant time
+	std::unordered_map<const Body *, Uint32> m_bodySlots;
+	std::unique_ptr<ProjectilePool> m_projectiles;
+	std::unique_ptr<TrafficPool> m_traffic;
+	std::unique_ptr<ApproachPrefetch> m_approachPrefetch;
+
+	// the bodies with Body::FLAG_NOTIFY_REMOVALS
+	std::vector<Body *> m_removalListeners;
+	// the watchers of each body, and the bodies each watcher watches
+	std::unordered_map<const Body *, std::vector<Body *>> m_watchers;
+	std::unordered_map<const Body *, std::vector<const Body *>> m_watched;
+	// scratch for the removals of a step, sorted
+	std::vector<const Body *> m_removedBodies;
+
+	// scratch storage for the parallel body update
+	std::vector<CollisionContact> m_terrainContacts;
+	std::vector<DynamicBody *> m_integrateBodies;
 
 	// bodies that were removed/killed this timestep and need pruning at the end
 	enum class BodyAssignation {
@@ -148,18 +241,31 @@ private:
 	//e.g. starfield and milky way)
 	std::unique_ptr<Background::Container> m_background;
 
+	// in hyperspace, the destination being prepared
+	std::unique_ptr<ArrivalPrefetch> m_arrival;
+
 	class BodyNearFinder {
 	public:
+		// grid levels from 1km to 1024km cells cover everything from
+		// missile fuses to sensor range
+		static constexpr double GRID_CELL_SIZE = 1000.0;
+		static constexpr uint32_t GRID_LEVELS = 6;
+
 		BodyNearFinder(const Space *space) :
-			m_space(space) {}
+			m_space(space),
+			m_grid(GRID_CELL_SIZE, GRID_LEVELS) {}
 		void Prepare();
 
 		BodyNearList GetBodiesMaybeNear(const Body *b, double dist);
 		BodyNearList GetBodiesMaybeNear(const vector3d &pos, double dist);
 
+		// Grid of body positions relative to the root frame, as of the last Prepare()
+		const SpatialGrid<Body *> &GetGrid() const { return m_grid; }
+
 	private:
 		const Space *m_space;
 		std::vector<BodyDist> m_bodyDist;
+		SpatialGrid<Body *> m_grid;
 		std::vector<Body *> m_nearBodies;
 	};
 
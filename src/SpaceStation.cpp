@@ -37,6 +37,8 @@ SpaceStation::SpaceStation(const SystemBody *sbody) :
 	m_type(nullptr)
 {
 	m_sbody = sbody;
+	// hears about the ships leaving its docking ports
+	m_flags |= FLAG_NOTIFY_REMOVALS;
 
 	m_oldAngDisplacement = 0.0;
 
@@ -50,6 +52,7 @@ SpaceStation::SpaceStation(const Json &jsonObj, Space *space) :
 	m_type(nullptr)
 {
 	GetModel()->SetLabel(GetLabel());
+	m_flags |= FLAG_NOTIFY_REMOVALS;
 
 	try {
 		Json spaceStationObj = jsonObj["space_station"];
@@ -102,7 +105,7 @@ SpaceStation::SpaceStation(const Json &jsonObj, Space *space) :
 
 void SpaceStation::Init()
 {
-	SpaceStationType::Init();
+	SpaceStationType::Init(Pi::GetApp()->GetTaskGraph());
 }
 
 void SpaceStation::SaveToJson(Json &jsonObj, Space *space)
@@ -159,7 +162,7 @@ void SpaceStation::PostLoadFixup(Space *space)
 	ModelBody::PostLoadFixup(space);
 	for (Uint32 i = 0; i < m_shipDocking.size(); i++) {
 		auto &sd = m_shipDocking[i];
-		sd.ship = static_cast<Ship *>(space->GetBodyByIndex(m_shipDocking[i].shipIndex));
+		SetBayShip(i, static_cast<Ship *>(space->GetBodyByIndex(m_shipDocking[i].shipIndex)));
 
 		if (!sd.ship) continue;
 
@@ -170,6 +173,19 @@ void SpaceStation::PostLoadFixup(Space *space)
 	}
 }
 
+const SpaceStationType *SpaceStation::GetStationType(const SystemBody *sbody, Random &rand)
+{
+	const std::string &space_station_type = sbody->GetSpaceStationType();
+	if (space_station_type != "") {
+		const SpaceStationType *type = SpaceStationType::FindByName(space_station_type);
+		if (type)
+			return type;
+		Output("WARNING: SpaceStation::InitStation wants to initialize a custom station of type %s, but no station type with that id has been found.\n", space_station_type.c_str());
+	}
+	const bool ground = sbody->GetType() == SystemBody::TYPE_STARPORT_ORBITAL ? false : true;
+	return SpaceStationType::RandomStationType(rand, ground);
+}
+
 void SpaceStation::InitStation()
 {
 	PROFILE_SCOPED()
@@ -178,14 +194,7 @@ void SpaceStation::InitStation()
 		m_staticSlot[i] = false;
 	Random rand(m_sbody->GetSeed());
 	const bool ground = m_sbody->GetType() == SystemBody::TYPE_STARPORT_ORBITAL ? false : true;
-	const std::string &space_station_type = m_sbody->GetSpaceStationType();
-	if (space_station_type != "") {
-		m_type = SpaceStationType::FindByName(space_station_type);
-		if (m_type == nullptr)
-			Output("WARNING: SpaceStation::InitStation wants to initialize a custom station of type %s, but no station type with that id has been found.\n", space_station_type.c_str());
-	}
-	if (m_type == nullptr)
-		m_type = SpaceStationType::RandomStationType(rand, ground);
+	m_type = GetStationType(m_sbody, rand);
 
 	if (m_shipDocking.empty()) {
 		m_shipDocking.reserve(m_type->NumDockingPorts());
@@ -196,6 +205,7 @@ void SpaceStation::InitStation()
 		m_doorAnimationStep = m_doorAnimationState = 0.0;
 	}
 	assert(m_shipDocking.size() == m_type->NumDockingPorts());
+	RebuildBayIndex();
 
 	// This SpaceStation's bay ports are an instance of...
 	if (m_ports.size() != m_type->Ports().size()) {
@@ -247,41 +257,98 @@ void SpaceStation::NotifyRemoved(const Body *const removedBody)
 {
 	for (Uint32 i = 0; i < m_shipDocking.size(); i++) {
 		if (m_shipDocking[i].ship == removedBody) {
-			m_shipDocking[i].ship = 0;
+			SetBayShip(i, nullptr);
 		}
 	}
 }
 
-int SpaceStation::GetMyDockingPort(const Ship *s) const
+static int lowest_set_bit(Uint64 bits)
 {
-	for (Uint32 i = 0; i < m_shipDocking.size(); i++) {
-		if (s == m_shipDocking[i].ship) return i;
+#if defined(__GNUC__)
+	return __builtin_ctzll(bits);
+#else
+	int bit = 0;
+	while (!(bits & 1)) {
+		bits >>= 1;
+		bit++;
 	}
-	return -1;
+	return bit;
+#endif
 }
 
-int SpaceStation::NumShipsDocked() const
+void SpaceStation::SetBayShip(int bay, Ship *ship)
 {
-	Sint32 numShipsDocked = 0;
+	shipDocking_t &sd = m_shipDocking[bay];
+	if (sd.ship == ship)
+		return;
+
+	if (sd.ship) {
+		auto it = m_shipBays.find(sd.ship);
+		if (it != m_shipBays.end() && it->second == bay) {
+			m_shipBays.erase(it);
+			// a ship moving between bays is briefly in both
+			for (Uint32 i = 0; i < m_shipDocking.size(); i++) {
+				if (int(i) != bay && m_shipDocking[i].ship == sd.ship) {
+					m_shipBays[sd.ship] = i;
+					break;
+				}
+			}
+		}
+		m_numShipsDocked--;
+	}
+
+	sd.ship = ship;
+	const Uint64 bit = Uint64(1) << (bay % 64);
+	if (ship) {
+		// the lowest bay, as a scan of them would find
+		auto result = m_shipBays.emplace(ship, bay);
+		if (!result.second && bay < result.first->second)
+			result.first->second = bay;
+		m_freeBays[bay / 64] &= ~bit;
+		m_numShipsDocked++;
+	} else {
+		m_freeBays[bay / 64] |= bit;
+	}
+}
+
+void SpaceStation::RebuildBayIndex()
+{
+	assert(m_shipDocking.size() <= MAX_DOCKING_PORTS);
+	m_freeBays.fill(0);
+	m_shipBays.clear();
+	m_numShipsDocked = 0;
 	for (Uint32 i = 0; i < m_shipDocking.size(); i++) {
-		if (NULL != m_shipDocking[i].ship)
-			++numShipsDocked;
+		Ship *ship = m_shipDocking[i].ship;
+		m_shipDocking[i].ship = nullptr;
+		m_freeBays[i / 64] |= Uint64(1) << (i % 64);
+		SetBayShip(i, ship);
 	}
-	return numShipsDocked;
+}
+
+int SpaceStation::GetMyDockingPort(const Ship *s) const
+{
+	auto it = m_shipBays.find(s);
+	return it == m_shipBays.end() ? -1 : it->second;
+}
+
+int SpaceStation::NumShipsDocked() const
+{
+	return m_numShipsDocked;
 }
 
 int SpaceStation::GetFreeDockingPort(const Ship *s) const
 {
 	assert(s);
-	for (unsigned int i = 0; i < m_type->NumDockingPorts(); i++) {
-		if (m_shipDocking[i].ship == nullptr) {
+	const Aabb &bbox = s->GetAabb();
+	const double bboxRad = bbox.GetRadius();
+
+	for (size_t word = 0; word < m_freeBays.size(); word++) {
+		for (Uint64 bits = m_freeBays[word]; bits; bits &= bits - 1) {
+			const int i = int(word * 64) + lowest_set_bit(bits);
 			// size-of-ship vs size-of-bay check
 			const SpaceStationType::SPort *const pPort = m_type->FindPortByBay(i);
 			if (!pPort) continue;
 
-			const Aabb &bbox = s->GetAabb();
-			const double bboxRad = bbox.GetRadius();
-
 			if (pPort->minShipSize < bboxRad && bboxRad < pPort->maxShipSize) {
 				return i;
 			}
@@ -293,7 +360,7 @@ int SpaceStation::GetFreeDockingPort(const Ship *s) const
 void SpaceStation::SetDocked(Ship *ship, const int bay)
 {
 	assert(m_shipDocking.size() > Uint32(bay));
-	m_shipDocking[bay].ship = ship;
+	SetBayShip(bay, ship);
 
 	// have to do this crap again in case it was called directly (Ship::SetDockWith())
 	ship->SetFlightState(Ship::DOCKED);
@@ -313,7 +380,7 @@ void SpaceStation::SwapDockedShipsPort(const int oldBay, const int newBay)
 	assert(ship);
 	ship->SetDockedWith(this, newBay);
 
-	m_shipDocking[oldBay].ship = nullptr;
+	SetBayShip(oldBay, nullptr);
 	SwitchToStage(oldBay, DockStage::NONE);
 }
 
@@ -334,7 +401,7 @@ bool SpaceStation::LaunchShip(Ship *ship, const int bay)
 	if (SpaceStationType::IsUndockStage(sd.stage)) return true; // already launching
 	LockPort(bay, true);
 
-	sd.ship = ship;
+	SetBayShip(bay, ship);
 	sd.stagePos = 0.0;
 
 	m_doorAnimationStep = 0.3; // open door
@@ -363,42 +430,43 @@ int SpaceStation::GetNearbyTraffic(double radius)
 bool SpaceStation::GetDockingClearance(Ship *s)
 {
 	assert(m_shipDocking.size() == m_type->NumDockingPorts());
-	for (Uint32 i = 0; i < m_shipDocking.size(); i++) {
-		if (m_shipDocking[i].ship == s) {
-			LuaEvent::Queue("onDockingClearanceDenied", this, s,
-				EnumStrings::GetString("DockingRefusedReason", int(DockingRefusedReason::ClearanceAlreadyGranted)));
-			return (m_shipDocking[i].stage != DockStage::NONE); // grant docking only if the ship is not already docked/undocking
-		}
+	const int myBay = GetMyDockingPort(s);
+	if (myBay >= 0) {
+		LuaEvent::Queue("onDockingClearanceDenied", this, s,
+			EnumStrings::GetString("DockingRefusedReason", int(DockingRefusedReason::ClearanceAlreadyGranted)));
+		return (m_shipDocking[myBay].stage != DockStage::NONE); // grant docking only if the ship is not already docked/undocking
 	}
 
 	const Aabb &bbox = s->GetAabb();
 	const float bboxRad = vector2f(float(bbox.max.x), float(bbox.max.z)).Length();
 
-	for (Uint32 i = 0; i < m_shipDocking.size(); i++) {
-		// initial unoccupied check
-		if (m_shipDocking[i].ship != 0) continue;
-
-		// size-of-ship vs size-of-bay check
-		const SpaceStationType::SPort *const pPort = m_type->FindPortByBay(i);
-		if (!pPort) continue;
-
-		// distance-to-station check
-		const double shipDist = s->GetPositionRelTo(this).Length();
-		double requestDist = 100000.0; //100km
-		if (s->IsType(ObjectType::PLAYER) && shipDist > requestDist) {
-			LuaEvent::Queue("onDockingClearanceDenied", this, s,
-				EnumStrings::GetString("DockingRefusedReason", int(DockingRefusedReason::TooFarFromStation)));
-			return false;
-		}
+	// only the unoccupied bays
+	for (size_t word = 0; word < m_freeBays.size(); word++) {
+		for (Uint64 bits = m_freeBays[word]; bits; bits &= bits - 1) {
+			const int i = int(word * 64) + lowest_set_bit(bits);
 
-		if (pPort->minShipSize < bboxRad && bboxRad < pPort->maxShipSize) {
-			shipDocking_t &sd = m_shipDocking[i];
-			sd.ship = s;
-			sd.stagePos = 0;
-			sd.maxOffset = calculate_max_offset_squared(pPort->maxShipSize, bboxRad);
-			LuaEvent::Queue("onDockingClearanceGranted", this, s);
-			SwitchToStage(i, DockStage::CLEARANCE_GRANTED);
-			return true;
+			// size-of-ship vs size-of-bay check
+			const SpaceStationType::SPort *const pPort = m_type->FindPortByBay(i);
+			if (!pPort) continue;
+
+			// distance-to-station check
+			const double shipDist = s->GetPositionRelTo(this).Length();
+			double requestDist = 100000.0; //100km
+			if (s->IsType(ObjectType::PLAYER) && shipDist > requestDist) {
+				LuaEvent::Queue("onDockingClearanceDenied", this, s,
+					EnumStrings::GetString("DockingRefusedReason", int(DockingRefusedReason::TooFarFromStation)));
+				return false;
+			}
+
+			if (pPort->minShipSize < bboxRad && bboxRad < pPort->maxShipSize) {
+				shipDocking_t &sd = m_shipDocking[i];
+				SetBayShip(i, s);
+				sd.stagePos = 0;
+				sd.maxOffset = calculate_max_offset_squared(pPort->maxShipSize, bboxRad);
+				LuaEvent::Queue("onDockingClearanceGranted", this, s);
+				SwitchToStage(i, DockStage::CLEARANCE_GRANTED);
+				return true;
+			}
 		}
 	}
 
@@ -417,13 +485,7 @@ bool SpaceStation::OnCollision(Body *b, Uint32 flags, double relVel)
 
 	bool touchOrbitalPad = (flags & SceneGraph::CollisionGeometry::DOCKING) && !IsGroundStation();
 
-	int bay = -1;
-	for (Uint32 i = 0; i < m_shipDocking.size(); i++) {
-		if (m_shipDocking[i].ship == s) {
-			bay = i;
-			break;
-		}
-	}
+	const int bay = GetMyDockingPort(s);
 
 	bool bayUnavailable = bay == -1 || IsPortLocked(bay) || m_shipDocking[bay].stage == DockStage::NONE;
 	if (bayUnavailable) {
@@ -462,7 +524,7 @@ bool SpaceStation::OnCollision(Body *b, Uint32 flags, double relVel)
 	// set up a control structure
 	// from now on, the location of the ship will be set by the station using this data
 	shipDocking_t &sd = m_shipDocking[bay];
-	sd.ship = s;
+	SetBayShip(bay, s);
 	sd.stagePos = 0;
 	// capture the current location of the ship
 	sd.fromPos = (s->GetPosition() - GetPosition()) * GetOrient(); // station space
@@ -536,7 +598,7 @@ void SpaceStation::SwitchToStage(Uint32 bay, DockStage stage)
 
 	case DockStage::LEAVE:
 		LuaEvent::Queue("onShipUndocked", dt.ship, this);
-		dt.ship = nullptr;
+		SetBayShip(bay, nullptr);
 		dt.stagePos = 0;
 		dt.maxOffset = 0;
 		LockPort(bay, false);
@@ -587,7 +649,7 @@ void SpaceStation::DockingUpdate(const double timeStep)
 		case DockStage::CLEARANCE_GRANTED: // waiting for collision
 			if (dt.stagePos >= 1.0) {
 				LuaEvent::Queue("onDockingClearanceExpired", this, dt.ship);
-				dt.ship = nullptr;
+				SetBayShip(i, nullptr);
 				m_doorAnimationStep = -0.3; // close door
 				SwitchToStage(i, DockStage::NONE);
 			}
@@ -785,6 +847,7 @@ void SpaceStation::Render(Graphics::Renderer *r, const Camera *camera, const vec
 
 	if (!b->IsType(ObjectType::PLANET)) {
 		// orbital spaceport -- don't make city turds or change lighting based on atmosphere
+		m_navLights->UpdateBulbs();
 		RenderModel(r, camera, viewCoords, viewTransform);
 		m_navLights->Render(r);
 		r->GetStats().AddToStatCount(Graphics::Stats::STAT_SPACESTATIONS, 1);
@@ -802,6 +865,7 @@ void SpaceStation::Render(Graphics::Renderer *r, const Camera *camera, const vec
 
 		m_adjacentCity->Render(r, camera->GetContext()->GetFrustum(), this, viewCoords, viewTransform);
 
+		m_navLights->UpdateBulbs();
 		RenderModel(r, camera, viewCoords, viewTransform);
 		m_navLights->Render(r);
 
@@ -840,38 +904,29 @@ vector3d SpaceStation::GetTargetIndicatorPosition() const
 {
 	// return the next waypoint if permission has been granted for player,
 	// and the docking point's position once the docking anim starts
-	for (Uint32 i = 0; i < m_shipDocking.size(); i++) {
-		if ((m_shipDocking[i].ship == Pi::player) &&
-				(m_shipDocking[i].stage == DockStage::CLEARANCE_GRANTED)) { // last part is "not currently docked" ????
-			return vector3d(m_type->GetStageTransform(i, DockStage::DOCKED).GetTranslate());
-		}
+	const int bay = GetMyDockingPort(Pi::player);
+	if (bay >= 0 && m_shipDocking[bay].stage == DockStage::CLEARANCE_GRANTED) { // last part is "not currently docked" ????
+		return vector3d(m_type->GetStageTransform(bay, DockStage::DOCKED).GetTranslate());
 	}
 	return Body::GetTargetIndicatorPosition();
 }
 
+// m_ports is a copy of the ports of the station type, so the type's index of
+// bays to ports holds for it too
 bool SpaceStation::IsPortLocked(const int bay) const
 {
-	for (auto &bayIter : m_ports) {
-		for (auto &idIter : bayIter.bayIDs) {
-			if (idIter.first == bay) {
-				return bayIter.inUse;
-			}
-		}
-	}
+	const int port = m_type->FindPortIndexByBay(bay);
+	if (port >= 0 && size_t(port) < m_ports.size())
+		return m_ports[port].inUse;
 	// is it safer to return that the is loacked?
 	return true;
 }
 
 void SpaceStation::LockPort(const int bay, const bool lockIt)
 {
-	for (auto &bayIter : m_ports) {
-		for (auto &idIter : bayIter.bayIDs) {
-			if (idIter.first == bay) {
-				bayIter.inUse = lockIt;
-				return;
-			}
-		}
-	}
+	const int port = m_type->FindPortIndexByBay(bay);
+	if (port >= 0 && size_t(port) < m_ports.size())
+		m_ports[port].inUse = lockIt;
 }
 
 matrix4x4d SpaceStation::GetBayTransform(Uint32 bay) const {
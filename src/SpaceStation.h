@@ -8,6 +8,9 @@
 #include "Quaternion.h"
 #include "SpaceStationType.h"
 
+#include <array>
+#include <unordered_map>
+
 #define MAX_DOCKING_PORTS 240 //256-(0x10), 0x10 is used because the collision surfaces use it as an identifying flag
 
 class Body;
@@ -17,6 +20,7 @@ class Frame;
 class NavLights;
 class Ship;
 class Space;
+class Random;
 class SystemBody;
 
 namespace Graphics {
@@ -43,6 +47,10 @@ public:
 	SpaceStation(const SystemBody *);
 	SpaceStation(const Json &jsonObj, Space *space);
 
+	// The type a station of sbody is made as, taking what the random choice
+	// needs from rand, which is seeded with the body's seed
+	static const SpaceStationType *GetStationType(const SystemBody *sbody, Random &rand);
+
 	virtual ~SpaceStation();
 	virtual vector3d GetAngVelocity() const override { return vector3d(0, m_type->AngVel(), 0); }
 	virtual bool OnCollision(Body *b, Uint32 flags, double relVel) override;
@@ -119,6 +127,15 @@ private:
 	typedef std::vector<shipDocking_t>::iterator shipDockingIter;
 	std::vector<shipDocking_t> m_shipDocking;
 
+	// Which bays have no ship, one bit per bay, and the bay of each ship so
+	// the docking queries of AI ships don't scan them all. Change the ship
+	// of a bay with SetBayShip to keep them up to date.
+	void SetBayShip(int bay, Ship *ship);
+	void RebuildBayIndex();
+	std::array<Uint64, (MAX_DOCKING_PORTS + 63) / 64> m_freeBays;
+	std::unordered_map<const Ship *, int> m_shipBays;
+	int m_numShipsDocked;
+
 	SpaceStationType::TPorts m_ports;
 
 	double m_oldAngDisplacement;
@@ -5,6 +5,7 @@
 #include "FileSystem.h"
 #include "JsonUtils.h"
 #include "MathUtil.h"
+#include "ModelCache.h"
 #include "Pi.h"
 #include "Ship.h"
 #include "StringF.h"
@@ -21,7 +22,7 @@ struct StationTypeLoadError {};
 std::vector<SpaceStationType> SpaceStationType::surfaceTypes;
 std::vector<SpaceStationType> SpaceStationType::orbitalTypes;
 
-SpaceStationType::SpaceStationType(const std::string &id_, const std::string &path_) :
+SpaceStationType::SpaceStationType(const std::string &id_, const std::string &path_, const Json &data) :
 	id(id_),
 	model(0),
 	modelName(""),
@@ -33,7 +34,6 @@ SpaceStationType::SpaceStationType(const std::string &id_, const std::string &pa
 	parkingDistance(0),
 	parkingGapSize(0)
 {
-	Json data = JsonUtils::LoadJsonDataFile(path_);
 	if (data.is_null()) {
 		Output("couldn't read station def '%s'\n", path_.c_str());
 		throw StationTypeLoadError();
@@ -63,6 +63,8 @@ SpaceStationType::SpaceStationType(const std::string &id_, const std::string &pa
 		Output("couldn't initialize station type '%s' because the corresponding model ('%s') could not be found.\n", path_.c_str(), modelName.c_str());
 		throw StationTypeLoadError();
 	}
+	// the station type keeps the model itself
+	Pi::modelCache->PinModel(model);
 	OnSetupComplete();
 }
 
@@ -211,57 +213,72 @@ void SpaceStationType::OnSetupComplete()
 	numDockingPorts = m_bayPaths.size();
 
 	assert(!m_bayPaths.empty());
-}
 
-const SpaceStationType::SPort *SpaceStationType::FindPortByBay(const int zeroBaseBayID) const
-{
-	for (TPorts::const_iterator bayIter = m_ports.begin(), grpEnd = m_ports.end(); bayIter != grpEnd; ++bayIter) {
-		for (auto idIter : (*bayIter).bayIDs) {
-			if (idIter.first == zeroBaseBayID) {
-				return &(*bayIter);
+	m_bayPorts.assign(numDockingPorts, -1);
+	for (size_t p = 0; p < m_ports.size(); p++) {
+		for (const auto &bay : m_ports[p].bayIDs) {
+			if (bay.first >= 0 && size_t(bay.first) < m_bayPorts.size() && m_bayPorts[bay.first] < 0)
+				m_bayPorts[bay.first] = int(p);
+		}
+	}
+
+	for (const SPort &port : m_ports) {
+		for (const auto &bay : port.bayIDs) {
+			const size_t index = size_t(bay.first) * 2;
+			if (m_approachWaypoints.size() < index + 2) {
+				m_approachWaypoints.resize(index + 2);
+				m_hasApproach.resize(index + 2, false);
+			}
+			for (int stage = 0; stage < 2; stage++) {
+				// the first port with the bay has it, as in FindPortByBay
+				const auto it = port.m_approach.find(stage ? DockStage::APPROACH2 : DockStage::APPROACH1);
+				if (it == port.m_approach.end() || m_hasApproach[index + stage])
+					continue;
+				positionOrient_t &out = m_approachWaypoints[index + stage];
+				out.pos = vector3d(it->second.GetTranslate());
+				out.xaxis = vector3d(it->second.GetOrient().VectorX()).Normalized();
+				out.yaxis = vector3d(it->second.GetOrient().VectorY()).Normalized();
+				out.zaxis = vector3d(it->second.GetOrient().VectorZ()).Normalized();
+				m_hasApproach[index + stage] = true;
 			}
 		}
 	}
+}
+
+int SpaceStationType::FindPortIndexByBay(const int zeroBaseBayID) const
+{
+	if (zeroBaseBayID < 0 || size_t(zeroBaseBayID) >= m_bayPorts.size())
+		return SPort::BAD_PORT_ID;
+	return m_bayPorts[zeroBaseBayID];
+}
+
+const SpaceStationType::SPort *SpaceStationType::FindPortByBay(const int zeroBaseBayID) const
+{
+	const int index = FindPortIndexByBay(zeroBaseBayID);
 	// is it safer to return that the bay is locked?
-	return 0;
+	return index < 0 ? nullptr : &m_ports[index];
 }
 
 SpaceStationType::SPort *SpaceStationType::GetPortByBay(const int zeroBaseBayID)
 {
-	for (TPorts::iterator bayIter = m_ports.begin(), grpEnd = m_ports.end(); bayIter != grpEnd; ++bayIter) {
-		for (auto idIter : (*bayIter).bayIDs) {
-			if (idIter.first == zeroBaseBayID) {
-				return &(*bayIter);
-			}
-		}
-	}
-	// is it safer to return that the bay is locked?
-	return 0;
+	const int index = FindPortIndexByBay(zeroBaseBayID);
+	return index < 0 ? nullptr : &m_ports[index];
 }
 
 bool SpaceStationType::GetShipApproachWaypoints(const unsigned int port, DockStage stage, positionOrient_t &outPosOrient) const
 {
-	bool gotOrient = false;
-
-	const SPort *pPort = FindPortByBay(port);
-	if (pPort) {
-		TMapBayIDMat::const_iterator stageDataIt = pPort->m_approach.find(stage);
-		if (stageDataIt != pPort->m_approach.end()) {
-			const matrix4x4f &mt = pPort->m_approach.at(stage);
-			outPosOrient.pos = vector3d(mt.GetTranslate());
-			outPosOrient.xaxis = vector3d(mt.GetOrient().VectorX());
-			outPosOrient.yaxis = vector3d(mt.GetOrient().VectorY());
-			outPosOrient.zaxis = vector3d(mt.GetOrient().VectorZ());
-			outPosOrient.xaxis = outPosOrient.xaxis.Normalized();
-			outPosOrient.yaxis = outPosOrient.yaxis.Normalized();
-			outPosOrient.zaxis = outPosOrient.zaxis.Normalized();
-			gotOrient = true;
-		}
-	}
-	return gotOrient;
+	if (stage != DockStage::APPROACH1 && stage != DockStage::APPROACH2)
+		return false;
+
+	const size_t index = size_t(port) * 2 + (stage == DockStage::APPROACH2 ? 1 : 0);
+	if (index >= m_hasApproach.size() || !m_hasApproach[index])
+		return false;
+
+	outPosOrient = m_approachWaypoints[index];
+	return true;
 }
 /*static*/
-void SpaceStationType::Init()
+void SpaceStationType::Init(TaskGraph *taskGraph)
 {
 	PROFILE_SCOPED()
 	static bool isInitted = false;
@@ -269,22 +286,32 @@ void SpaceStationType::Init()
 		return;
 	isInitted = true;
 
-	// load all station definitions
+	// load all station definitions; the files are parsed all at once, the
+	// models have to be set up here
 	namespace fs = FileSystem;
+	std::vector<fs::FileInfo> defs;
 	for (fs::FileEnumerator files(fs::gameDataFiles, "stations", 0); !files.Finished(); files.Next()) {
-		const fs::FileInfo &info = files.Current();
-		if (ends_with_ci(info.GetPath(), ".json")) {
-			const std::string id(info.GetName().substr(0, info.GetName().size() - 5));
-			try {
-				SpaceStationType st = SpaceStationType(id, info.GetPath());
-				switch (st.dockMethod) {
-				case SURFACE: surfaceTypes.push_back(st); break;
-				case ORBITAL: orbitalTypes.push_back(st); break;
-				}
-			} catch (StationTypeLoadError) {
-				// TODO: Actual error handling would be nice.
-				Error("Error while loading Space Station data (check stdout/output.txt).\n");
+		if (ends_with_ci(files.Current().GetPath(), ".json"))
+			defs.push_back(files.Current());
+	}
+
+	std::vector<std::string> paths;
+	for (const fs::FileInfo &info : defs)
+		paths.push_back(info.GetPath());
+	const std::vector<Json> data = JsonUtils::LoadJsonDataFiles(paths, "stations", taskGraph);
+
+	for (size_t i = 0; i < defs.size(); i++) {
+		const fs::FileInfo &info = defs[i];
+		const std::string id(info.GetName().substr(0, info.GetName().size() - 5));
+		try {
+			SpaceStationType st = SpaceStationType(id, info.GetPath(), data[i]);
+			switch (st.dockMethod) {
+			case SURFACE: surfaceTypes.push_back(st); break;
+			case ORBITAL: orbitalTypes.push_back(st); break;
 			}
+		} catch (StationTypeLoadError) {
+			// TODO: Actual error handling would be nice.
+			Error("Error while loading Space Station data (check stdout/output.txt).\n");
 		}
 	}
 }
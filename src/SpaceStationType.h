@@ -4,6 +4,7 @@
 #ifndef _SPACESTATIONTYPE_H
 #define _SPACESTATIONTYPE_H
 
+#include "JsonFwd.h"
 #include "Random.h"
 #include "matrix4x4.h"
 #include "vector3.h"
@@ -15,6 +16,7 @@
 //Space station definition, loaded from data/stations
 
 class Ship;
+class TaskGraph;
 namespace SceneGraph {
 	class Model;
 }
@@ -113,13 +115,19 @@ private:
 	float parkingGapSize;
 	BayPathMap m_bayPaths;
 	TPorts m_ports;
+	// the approach waypoints of every bay, two stages per bay, worked out
+	// once for all the ships docking there; a bay without a port has none
+	std::vector<positionOrient_t> m_approachWaypoints;
+	std::vector<bool> m_hasApproach;
+	// the index in m_ports of the first port with each bay, or -1
+	std::vector<int> m_bayPorts;
 	float padOffset;
 
 	static std::vector<SpaceStationType> surfaceTypes;
 	static std::vector<SpaceStationType> orbitalTypes;
 
 public:
-	SpaceStationType(const std::string &id, const std::string &path);
+	SpaceStationType(const std::string &id, const std::string &path, const Json &data);
 
 	static bool IsDockStage(DockStage s) {
 		return
@@ -142,6 +150,8 @@ public:
 	void OnSetupComplete();
 	const SPort *FindPortByBay(const int zeroBaseBayID) const;
 	SPort *GetPortByBay(const int zeroBaseBayID);
+	// the index in Ports() of the port with the bay, or -1 if none has it
+	int FindPortIndexByBay(const int zeroBaseBayID) const;
 
 	// Call functions in the station .lua
 	bool GetShipApproachWaypoints(const unsigned int port, DockStage stage, positionOrient_t &outPosOrient) const;
@@ -161,7 +171,7 @@ public:
 	float ParkingGapSize() const { return parkingGapSize; }
 	const TPorts &Ports() const { return m_ports; }
 
-	static void Init();
+	static void Init(TaskGraph *taskGraph = nullptr);
 
 	static const SpaceStationType *RandomStationType(Random &random, const bool bIsGround);
 	static const SpaceStationType *FindByName(const std::string &name);
@@ -0,0 +1,210 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include "vector3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Sparse, multi-level uniform grid of point objects, meant to be refilled
+ * every timestep.
+ *
+ * Each level sorts the objects by the cell they fall into and only stores
+ * occupied cells; every level has cells LEVEL_SCALE times larger than the one
+ * below. A radius query uses the finest level whose cells are at least as
+ * large as the radius, so it visits at most 3x3 rows of cells (one binary
+ * search per row) and its cost depends on the number of nearby objects, not
+ * on the total. Queries larger than the coarsest cells scan its occupied
+ * cells instead.
+ */
+template <typename T>
+class SpatialGrid {
+public:
+	static constexpr double LEVEL_SCALE = 4.0;
+
+	SpatialGrid(double minCellSize, uint32_t numLevels)
+	{
+		double cellSize = minCellSize;
+		for (uint32_t i = 0; i < numLevels; i++, cellSize *= LEVEL_SCALE)
+			m_levels.push_back({ cellSize, 1.0 / cellSize, {}, {} });
+	}
+
+	void Clear()
+	{
+		m_objects.clear();
+		for (Level &level : m_levels) {
+			level.entries.clear();
+			level.cells.clear();
+		}
+	}
+
+	// Objects added after the last Build() are not returned by queries
+	void Add(const vector3d &pos, T item) { m_objects.push_back({ pos, item }); }
+
+	void Build()
+	{
+		for (Level &level : m_levels) {
+			level.entries.clear();
+			for (const Object &obj : m_objects)
+				level.entries.push_back({ obj.pos, level.GetCell(obj.pos), obj.item });
+
+			// stable, so that objects in the same cell stay in the order they were added
+			std::stable_sort(level.entries.begin(), level.entries.end(), [](const Entry &a, const Entry &b) { return a.cell < b.cell; });
+
+			level.cells.clear();
+			for (uint32_t i = 0; i < level.entries.size(); i++) {
+				if (level.cells.empty() || !(level.cells.back().cell == level.entries[i].cell))
+					level.cells.push_back({ level.entries[i].cell, i, i });
+				level.cells.back().end = i + 1;
+			}
+		}
+	}
+
+	// Append all objects within radius of pos to out
+	void Query(const vector3d &pos, double radius, std::vector<T> &out) const
+	{
+		if (m_objects.empty() || m_levels.empty())
+			return;
+
+		const Level *level = &m_levels.back();
+		for (const Level &l : m_levels) {
+			if (l.cellSize >= radius) {
+				level = &l;
+				break;
+			}
+		}
+
+		const Cell lo = level->GetCell(pos - radius);
+		const Cell hi = level->GetCell(pos + radius);
+		const double radiusSqr = radius * radius;
+
+		const double numRows = (double(hi.x) - lo.x + 1.0) * (double(hi.y) - lo.y + 1.0);
+		if (numRows >= double(level->cells.size())) {
+			for (const CellRange &range : level->cells) {
+				const Cell &c = range.cell;
+				if (c.x >= lo.x && c.x <= hi.x && c.y >= lo.y && c.y <= hi.y && c.z >= lo.z && c.z <= hi.z)
+					level->AddEntries(range, pos, radiusSqr, out);
+			}
+			return;
+		}
+
+		// cells are sorted by x, y, then z, so each row is contiguous and
+		// later rows never start before earlier ones. Narrowing the search to
+		// the slab of cells in [lo.x, hi.x] first makes empty space cheap.
+		const auto cellLess = [](const CellRange &range, const Cell &cell) { return range.cell < cell; };
+		auto it = std::lower_bound(level->cells.begin(), level->cells.end(), Cell{ lo.x, INT32_MIN, INT32_MIN }, cellLess);
+		const auto last = std::lower_bound(it, level->cells.end(), Cell{ hi.x + 1, INT32_MIN, INT32_MIN }, cellLess);
+
+		for (int32_t x = lo.x; x <= hi.x && it != last; x++) {
+			for (int32_t y = lo.y; y <= hi.y && it != last; y++) {
+				it = std::lower_bound(it, last, Cell{ x, y, lo.z }, cellLess);
+				for (; it != last && it->cell.x == x && it->cell.y == y && it->cell.z <= hi.z; ++it)
+					level->AddEntries(*it, pos, radiusSqr, out);
+			}
+		}
+	}
+
+	// Call fn(item, dist) for every object within the cone of the given
+	// apex, normalized axis and cosine of the half-angle, where dist is the
+	// distance from the apex. The cone has no far end, so cells of the
+	// coarsest level are culled against it and only objects in cells that
+	// overlap the cone are tested.
+	template <typename Fn>
+	void QueryCone(const vector3d &apex, const vector3d &dir, double cosAngle, Fn &&fn) const
+	{
+		if (m_objects.empty() || m_levels.empty())
+			return;
+
+		const Level &level = m_levels.back();
+		const double cellRadius = level.cellSize * (0.5 * std::sqrt(3.0));
+		const double angle = std::acos(std::clamp(cosAngle, -1.0, 1.0));
+
+		for (const CellRange &range : level.cells) {
+			const vector3d center = vector3d(range.cell.x + 0.5, range.cell.y + 0.5, range.cell.z + 0.5) * level.cellSize;
+			const vector3d toCell = center - apex;
+			const double cellDist = toCell.Length();
+
+			// the bounding sphere of the cell subtends asin(r / d) around its center
+			if (cellDist > cellRadius) {
+				const double cellAngle = std::acos(std::clamp(toCell.Dot(dir) / cellDist, -1.0, 1.0));
+				if (cellAngle > angle + std::asin(cellRadius / cellDist))
+					continue;
+			}
+
+			for (uint32_t i = range.begin; i < range.end; i++) {
+				const vector3d toObj = level.entries[i].pos - apex;
+				const double dist = toObj.Length();
+				if (toObj.Dot(dir) >= cosAngle * dist)
+					fn(level.entries[i].item, dist);
+			}
+		}
+	}
+
+	size_t GetNumObjects() const { return m_objects.size(); }
+	size_t GetNumLevels() const { return m_levels.size(); }
+	size_t GetNumCells(uint32_t level) const { return m_levels[level].cells.size(); }
+
+private:
+	struct Cell {
+		int32_t x, y, z;
+
+		bool operator==(const Cell &a) const { return x == a.x && y == a.y && z == a.z; }
+		bool operator<(const Cell &a) const
+		{
+			if (x != a.x) return x < a.x;
+			if (y != a.y) return y < a.y;
+			return z < a.z;
+		}
+	};
+
+	struct Object {
+		vector3d pos;
+		T item;
+	};
+
+	struct Entry {
+		vector3d pos;
+		Cell cell;
+		T item;
+	};
+
+	struct CellRange {
+		Cell cell;
+		uint32_t begin, end;
+	};
+
+	struct Level {
+		double cellSize;
+		double invCellSize;
+		std::vector<Entry> entries;
+		std::vector<CellRange> cells;
+
+		int32_t GetCoord(double v) const
+		{
+			// keep far away (or broken) positions in range instead of overflowing
+			static constexpr double LIMIT = double(1 << 30);
+			const double c = std::floor(v * invCellSize);
+			return int32_t(c > -LIMIT ? (c < LIMIT ? c : LIMIT) : -LIMIT);
+		}
+
+		Cell GetCell(const vector3d &pos) const { return { GetCoord(pos.x), GetCoord(pos.y), GetCoord(pos.z) }; }
+
+		void AddEntries(const CellRange &range, const vector3d &pos, double radiusSqr, std::vector<T> &out) const
+		{
+			for (uint32_t i = range.begin; i < range.end; i++)
+				if ((entries[i].pos - pos).LengthSqr() <= radiusSqr)
+					out.push_back(entries[i].item);
+		}
+	};
+
+	std::vector<Object> m_objects;
+	std::vector<Level> m_levels;
+};
+
+#endif /* SPATIALGRID_H */
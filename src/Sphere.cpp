@@ -47,3 +47,11 @@ bool SSphere::HorizonCulling(const vector3d &view, const SSphere &obj) const
 
 	return status;
 }
+
+bool SSphere::IsInFrontOfHorizon(const vector3d &view, const SSphere &obj) const
+{
+	const vector3d N = (view - m_centre).Normalized();
+	// the horizon circle lies in the plane R^2 / D from the centre towards the view point
+	const double y = m_radius * m_radius / (view - m_centre).Length();
+	return N.Dot(obj.m_centre - m_centre) - y > obj.m_radius;
+}
@@ -20,6 +20,9 @@ struct SSphere {
 
 	// Adapted from Ysaneya here: http://www.gamedev.net/blog/73/entry-1666972-horizon-culling/
 	bool HorizonCulling(const vector3d &view, const SSphere &obj) const;
+	// true if the object's bounding sphere lies entirely in front of the plane
+	// of this sphere's horizon, so none of it can be hidden by this sphere
+	bool IsInFrontOfHorizon(const vector3d &view, const SSphere &obj) const;
 };
 
 #endif /* _SPHERE_H */
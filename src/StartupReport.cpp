@@ -0,0 +1,119 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "StartupReport.h"
+
+#include "Json.h"
+#include "core/OS.h"
+#include "profiler/Profiler.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace {
+	Profiler::Clock s_clock;
+	std::mutex s_lock;
+	std::vector<StartupReport::Phase> s_phases;
+
+	// the main thread phase in progress
+	std::string s_phaseName;
+	StartupReport::Sample s_phaseStart;
+
+	// the totals, from Begin() to End()
+	StartupReport::Sample s_begin;
+	StartupReport::Sample s_end;
+	double s_processCpuBegin = 0.0;
+	double s_processCpuEnd = 0.0;
+	bool s_ended = false;
+} // namespace
+
+namespace StartupReport {
+
+	Sample Sample::Now()
+	{
+		return { s_clock.currentmilliseconds(), OS::GetThreadCPUTime(), OS::GetProcessBytesRead() };
+	}
+
+	void Begin()
+	{
+		s_clock.Start();
+		s_begin = Sample::Now();
+		s_processCpuBegin = OS::GetProcessCPUTime();
+	}
+
+	void BeginPhase(const char *name)
+	{
+		EndPhase();
+		s_phaseName = name;
+		s_phaseStart = Sample::Now();
+	}
+
+	void EndPhase()
+	{
+		if (s_phaseName.empty())
+			return;
+
+		const Sample now = Sample::Now();
+		const double wallMs = now.wallMs - s_phaseStart.wallMs;
+		AddPhase({ s_phaseName, false, s_phaseStart.wallMs, wallMs, wallMs,
+			now.cpuMs - s_phaseStart.cpuMs, now.bytesRead - s_phaseStart.bytesRead });
+		s_phaseName.clear();
+	}
+
+	void AddPhase(const Phase &phase)
+	{
+		std::lock_guard<std::mutex> lock(s_lock);
+		s_phases.push_back(phase);
+	}
+
+	void End()
+	{
+		EndPhase();
+		s_end = Sample::Now();
+		s_processCpuEnd = OS::GetProcessCPUTime();
+		s_ended = true;
+
+		const double mainCpuMs = s_end.cpuMs - s_begin.cpuMs;
+		const double processCpuMs = s_processCpuEnd - s_processCpuBegin;
+
+		std::lock_guard<std::mutex> lock(s_lock);
+		Output("\nStartup took %.2fms: %.2fms CPU on the main thread, %.2fms on the others, %.2f MB read\n",
+			s_end.wallMs - s_begin.wallMs, mainCpuMs, std::max(processCpuMs - mainCpuMs, 0.0),
+			(s_end.bytesRead - s_begin.bytesRead) / (1024.0 * 1024.0));
+		Output("%10s %10s %10s %10s %10s  %-6s %s\n", "start ms", "wall ms", "run ms", "cpu ms", "read KB", "thread", "phase");
+		for (const Phase &phase : s_phases) {
+			Output("%10.2f %10.2f %10.2f %10.2f %10.1f  %-6s %s\n", phase.startMs, phase.wallMs, phase.runMs,
+				phase.cpuMs, phase.bytesRead / 1024.0, phase.async ? "async" : "main", phase.name.c_str());
+		}
+	}
+
+	Json ToJson()
+	{
+		std::lock_guard<std::mutex> lock(s_lock);
+		Json report = Json::object();
+		if (s_ended) {
+			const double mainCpuMs = s_end.cpuMs - s_begin.cpuMs;
+			report["wallMs"] = s_end.wallMs - s_begin.wallMs;
+			report["mainCpuMs"] = mainCpuMs;
+			report["asyncCpuMs"] = std::max(s_processCpuEnd - s_processCpuBegin - mainCpuMs, 0.0);
+			report["bytesRead"] = s_end.bytesRead - s_begin.bytesRead;
+		}
+
+		Json phases = Json::array();
+		for (const Phase &phase : s_phases) {
+			Json entry = Json::object();
+			entry["name"] = phase.name;
+			entry["thread"] = phase.async ? "async" : "main";
+			entry["startMs"] = phase.startMs;
+			entry["wallMs"] = phase.wallMs;
+			entry["runMs"] = phase.runMs;
+			entry["cpuMs"] = phase.cpuMs;
+			entry["bytesRead"] = phase.bytesRead;
+			phases.push_back(entry);
+		}
+		report["phases"] = phases;
+		return report;
+	}
+
+} // namespace StartupReport
@@ -0,0 +1,64 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _STARTUPREPORT_H
+#define _STARTUPREPORT_H
+
+#include "JsonFwd.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Where the time of starting the game goes. The phases of Pi::App::OnStartup
+// and the load steps of the startup screen are each measured for wall time,
+// CPU time and the bytes read from storage, and End() prints the breakdown.
+//
+// The CPU time is that of the thread running the phase, the main thread or a
+// worker for the load steps queued as jobs; the jobs they queue themselves
+// only show in the totals, as the difference between the CPU time of the
+// process and that of the main thread. The bytes read are counted for the
+// whole process, so phases running at the same time share them.
+namespace StartupReport {
+
+	struct Phase {
+		std::string name;
+		// run as a job rather than on the main thread
+		bool async;
+		// from Begin()
+		double startMs;
+		// until the phase was done, including the jobs it queued
+		double wallMs;
+		// of the function running the phase itself
+		double runMs;
+		double cpuMs;
+		uint64_t bytesRead;
+	};
+
+	// the clocks when a phase starts, taken on the thread that runs it
+	struct Sample {
+		double wallMs;
+		double cpuMs;
+		uint64_t bytesRead;
+
+		static Sample Now();
+	};
+
+	// call at the very start, and at the end, of the startup
+	void Begin();
+	void End();
+
+	// the engine startup on the main thread as a series of phases, each of
+	// which ends where the next begins
+	void BeginPhase(const char *name);
+	void EndPhase();
+
+	// add a phase measured by the caller; safe to call from any thread
+	void AddPhase(const Phase &phase);
+
+	// the phases in the order they were done, and the totals, once End() was called
+	Json ToJson();
+
+} // namespace StartupReport
+
+#endif /* _STARTUPREPORT_H */
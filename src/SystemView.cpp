@@ -27,6 +27,8 @@
 #include "graphics/RenderState.h"
 #include "graphics/TextureBuilder.h"
 #include "graphics/Types.h"
+#include "graphics/VertexArray.h"
+#include "graphics/VertexBuffer.h"
 
 #include "imgui/imgui.h"
 #include "SDL_keycode.h"
@@ -34,6 +36,9 @@
 using namespace Graphics;
 
 static constexpr Uint16 N_VERTICES_MAX = 100;
+// the vertices of a cached orbit line, more for large and eccentric ones
+static constexpr Uint32 ORBIT_LINE_VERTICES_MIN = 32;
+static constexpr Uint32 ORBIT_LINE_VERTICES_MAX = 512;
 static const float MIN_ZOOM = 1e-30f; // Just to avoid having 0
 static const float MAX_ZOOM = 1e30f;
 static const float MIN_ATLAS_ZOOM = 0.5f; // Just to avoid having 0
@@ -166,6 +171,7 @@ void SystemView::Update()
 {
 	const float ft = Pi::GetFrameTime();
 	m_map->SetReferenceTime(m_game->GetTime());
+	m_planner->UpdatePorkchop();
 
 	SystemPath path = m_game->GetSectorView()->GetSelected().SystemOnly();
 	m_viewingCurrentSystem = m_game->IsNormalSpace() && m_game->GetSpace()->GetStarSystem()->GetPath().IsSameSystem(path);
@@ -377,6 +383,7 @@ void SystemMapViewport::SetCurrentSystem(RefCountedPtr<StarSystem> system)
 	ClearSelectedObject();
 
 	m_system = system;
+	m_orbitLines.clear();
 
 	if (m_system) {
 		SystemBody *body = m_system->GetRootBody().Get();
@@ -388,58 +395,63 @@ void SystemMapViewport::SetCurrentSystem(RefCountedPtr<StarSystem> system)
 	ResetViewpoint();
 }
 
-void SystemMapViewport::RenderOrbit(Projectable p, const ProjectedOrbit *orbitData, const vector3d &offset)
+static const float startTrailPercent = 0.85;
+static const float fadedColorParameter = 0.8;
+
+void SystemMapViewport::RenderOrbit(Projectable p, const ProjectedOrbit *orbitData, const vector3d &offset, double projectedSize)
 {
 	PROFILE_SCOPED()
 
-	double ecc = orbitData->orbit.GetEccentricity();
-	double timeshift = ecc > 0.6 ? 0.0 : 0.5;
-	double maxT = 1.;
-	unsigned short num_vertices = 0;
-	for (unsigned short i = 0; i < N_VERTICES_MAX; ++i) {
-		const double t = (double(i) + timeshift) / double(N_VERTICES_MAX);
-		const vector3d pos = orbitData->orbit.EvenSpacedPosTrajectory(t);
-		if (pos.Length() < orbitData->planetRadius) {
-			maxT = t;
-			break;
-		}
-	}
-
-	static const float startTrailPercent = 0.85;
-	static const float fadedColorParameter = 0.8;
-
-	Uint16 fadingColors = 0;
 	const double tMinust0 = p.base == Projectable::SYSTEMBODY ? m_time : m_time - m_refTime;
-	for (unsigned short i = 0; i < N_VERTICES_MAX; ++i) {
-		const double t = (double(i) + timeshift) / double(N_VERTICES_MAX) * maxT;
-		if (fadingColors == 0 && t >= startTrailPercent * maxT)
-			fadingColors = i;
-		const vector3d pos = orbitData->orbit.EvenSpacedPosTrajectory(t, tMinust0);
-		m_orbitVts[i] = vector3f(offset + pos);
-		++num_vertices;
-		if (pos.Length() < orbitData->planetRadius)
-			break;
-	}
+	if (!RenderCachedOrbit(p, orbitData, offset, projectedSize, tMinust0)) {
+		// orbits that leave or hit the planet start wherever the object is
+		double ecc = orbitData->orbit.GetEccentricity();
+		double timeshift = ecc > 0.6 ? 0.0 : 0.5;
+		double maxT = 1.;
+		const double v0 = orbitData->orbit.TrueAnomalyAtTime(0);
+		for (unsigned short i = 0; i < N_VERTICES_MAX; ++i) {
+			const double t = (double(i) + timeshift) / double(N_VERTICES_MAX);
+			const vector3d pos = orbitData->orbit.PosAtTrueAnomaly(2 * M_PI * t + v0);
+			if (pos.Length() < orbitData->planetRadius) {
+				maxT = t;
+				break;
+			}
+		}
 
-	if (num_vertices > 1) {
-		//close the loop for thin ellipses
-		if (!(maxT < 1. || ecc > 1.0 || ecc < 0.6)) {
-			m_orbitVts[num_vertices] = m_orbitVts[0];
-			m_orbitColors[num_vertices] = m_orbitColors[0];
+		unsigned short num_vertices = 0;
+		Uint16 fadingColors = 0;
+		const double v = orbitData->orbit.TrueAnomalyAtTime(tMinust0);
+		for (unsigned short i = 0; i < N_VERTICES_MAX; ++i) {
+			const double t = (double(i) + timeshift) / double(N_VERTICES_MAX) * maxT;
+			if (fadingColors == 0 && t >= startTrailPercent * maxT)
+				fadingColors = i;
+			const vector3d pos = orbitData->orbit.PosAtTrueAnomaly(2 * M_PI * t + v);
+			m_orbitVts[i] = vector3f(offset + pos);
 			++num_vertices;
+			if (pos.Length() < orbitData->planetRadius)
+				break;
 		}
 
-		// fade trail
-		const Color fadedColor = orbitData->color * fadedColorParameter;
-		std::fill_n(m_orbitColors.get(), num_vertices, fadedColor);
-		const Uint16 trailLength = num_vertices - fadingColors;
-		for (Uint16 currentColor = 0; currentColor < trailLength; ++currentColor) {
-			float scalingParameter = (1.f - static_cast<float>(currentColor) / (trailLength - 1));
-			m_orbitColors[currentColor + fadingColors] = fadedColor * scalingParameter;
-		}
+		if (num_vertices > 1) {
+			//close the loop for thin ellipses
+			if (!(maxT < 1. || ecc > 1.0 || ecc < 0.6)) {
+				m_orbitVts[num_vertices] = m_orbitVts[0];
+				m_orbitColors[num_vertices] = m_orbitColors[0];
+				++num_vertices;
+			}
 
-		m_orbits.SetData(num_vertices, m_orbitVts.get(), m_orbitColors.get());
-		m_orbits.Draw(m_renderer, m_lineMat.get());
+			// fade trail
+			const Color fadedColor = orbitData->color * fadedColorParameter;
+			std::fill_n(m_orbitColors.get(), num_vertices, fadedColor);
+			const Uint16 trailLength = num_vertices - fadingColors;
+			for (Uint16 currentColor = 0; currentColor < trailLength; ++currentColor) {
+				float scalingParameter = (1.f - static_cast<float>(currentColor) / (trailLength - 1));
+				m_orbitColors[currentColor + fadingColors] = fadedColor * scalingParameter;
+			}
+
+			m_orbits.SetData(num_vertices, m_orbitVts.get(), m_orbitColors.get());
+			m_orbits.Draw(m_renderer, m_lineMat.get());
+		}
 	}
 
 	AddProjected(p, Projectable::PERIAPSIS, offset + orbitData->orbit.Perigeum());
@@ -460,6 +472,83 @@ void SystemMapViewport::RenderOrbit(Projectable p, const ProjectedOrbit *orbitDa
 	}
 }
 
+static bool same_orbit_shape(double ecc, double sma, const matrix3x3d &plane, const Orbit &orbit)
+{
+	// contact orbits are computed from their state every frame, so a little
+	// noise in the elements doesn't count as a change
+	static const double EPSILON = 1e-6;
+	if (fabs(ecc - orbit.GetEccentricity()) > EPSILON || fabs(sma - orbit.GetSemiMajorAxis()) > EPSILON * fabs(sma))
+		return false;
+	for (int i = 0; i < 9; i++) {
+		if (fabs(plane[i] - orbit.GetPlane()[i]) > EPSILON)
+			return false;
+	}
+	return true;
+}
+
+bool SystemMapViewport::RenderCachedOrbit(const Projectable &p, const ProjectedOrbit *orbitData, const vector3d &offset, double projectedSize, double tMinust0)
+{
+	const Orbit &orbit = orbitData->orbit;
+	const double ecc = orbit.GetEccentricity();
+	if (!(ecc < 1.0) || orbit.GetSemiMajorAxis() * (1.0 - ecc) < orbitData->planetRadius)
+		return false;
+
+	OrbitLine &line = m_orbitLines[std::make_pair(int(p.base), static_cast<const void *>(p.getRef()))];
+	// a second orbit for the same object this frame
+	if (line.va && line.frame == m_orbitLinesFrame)
+		return false;
+	line.frame = m_orbitLinesFrame;
+
+	// sharp ends of eccentric orbits and orbits filling the screen need
+	// more vertices; doubling keeps them from changing with every zoom step
+	const double wanted = 128.0 * projectedSize * (1.0 + 3.0 * ecc);
+	Uint32 numVertices = ORBIT_LINE_VERTICES_MIN;
+	while (numVertices < ORBIT_LINE_VERTICES_MAX && numVertices < wanted)
+		numVertices *= 2;
+
+	bool changed = !line.va || line.ring.size() != numVertices || line.color != orbitData->color ||
+		!same_orbit_shape(line.eccentricity, line.semiMajorAxis, line.plane, orbit);
+	if (changed) {
+		line.eccentricity = ecc;
+		line.semiMajorAxis = orbit.GetSemiMajorAxis();
+		line.plane = orbit.GetPlane();
+		line.color = orbitData->color;
+		line.ring.resize(numVertices);
+		for (Uint32 i = 0; i < numVertices; i++)
+			line.ring[i] = vector3f(orbit.PosAtTrueAnomaly(2 * M_PI * double(i) / double(numVertices)));
+	}
+
+	// the line starts at the first vertex ahead of the object
+	const double phase = orbit.TrueAnomalyAtTime(tMinust0) / (2 * M_PI);
+	const Uint32 start = Uint32(ceil((phase - floor(phase)) * numVertices)) % numVertices;
+	if (changed || start != line.start) {
+		line.start = start;
+		if (!line.va)
+			line.va.reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE, numVertices + 1));
+		line.va->Clear();
+
+		// the loop is closed and fades out over its last part
+		const Color fadedColor = orbitData->color * fadedColorParameter;
+		const Uint32 fadingColors = Uint32(ceil(startTrailPercent * numVertices));
+		for (Uint32 i = 0; i <= numVertices; i++) {
+			const float scalingParameter = i < fadingColors ? 1.f : 1.f - float(i - fadingColors) / float(numVertices - fadingColors);
+			line.va->Add(line.ring[(start + i) % numVertices], fadedColor * scalingParameter);
+		}
+
+		if (line.mesh && line.mesh->GetVertexBuffer()->GetCapacity() >= line.va->GetNumVerts())
+			line.mesh->GetVertexBuffer()->Populate(*line.va);
+		else
+			line.mesh.Reset(m_renderer->CreateMeshObjectFromArray(line.va.get()));
+	}
+
+	matrix4x4f trans = m_cameraSpace;
+	trans.Translate(vector3f(offset));
+	m_renderer->SetTransform(trans);
+	m_renderer->DrawMesh(line.mesh.Get(), m_lineMat.get());
+	m_renderer->SetTransform(m_cameraSpace);
+	return true;
+}
+
 // returns the position of the ground spaceport relative to the center of the planet at the specified time
 static vector3d position_of_surface_starport_relative_to_parent(const SystemBody *starport, double time, double radius)
 {
@@ -647,8 +736,9 @@ void SystemMapViewport::DrawOrreryView()
 
 			//semimajor axis radius should be at least 1% of screen width to show the orbit
 			//FIXME: this has never worked, the returned size is not in screen %
-			if (ProjectedSize(axisZoom, viewpos) > 0.01) {
-				RenderOrbit(track, orbitData, viewpos);
+			const double projectedSize = ProjectedSize(axisZoom, viewpos);
+			if (projectedSize > 0.01) {
+				RenderOrbit(track, orbitData, viewpos, projectedSize);
 			}
 		} else {
 			AddProjected(track, track.type, viewpos);
@@ -661,6 +751,15 @@ void SystemMapViewport::DrawOrreryView()
 
 	m_renderer->SetTransform(m_cameraSpace);
 
+	// forget the lines of orbits that weren't drawn
+	for (auto it = m_orbitLines.begin(); it != m_orbitLines.end();) {
+		if (it->second.frame != m_orbitLinesFrame)
+			it = m_orbitLines.erase(it);
+		else
+			++it;
+	}
+	++m_orbitLinesFrame;
+
 	if (m_gridDrawing != GridDrawing::OFF) {
 		// calculate lines for this system:
 		DrawGrid(std::floor(m_system->GetRootBody()->GetMaxChildOrbitalDistance() * 1.2 / AU));
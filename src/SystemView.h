@@ -324,7 +324,9 @@ private:
 	// Project a track to screenspace with the current renderer state and add it to the list of projected objects
 	void AddProjected(Projectable p, Projectable::types type, const vector3d &transformedPos, float screensize = 0.f);
 	void RenderBody(const SystemBody *b, const vector3d &pos, const matrix4x4f &trans);
-	void RenderOrbit(Projectable p, const ProjectedOrbit *orbitData, const vector3d &transformedPos);
+	void RenderOrbit(Projectable p, const ProjectedOrbit *orbitData, const vector3d &transformedPos, double projectedSize);
+	// Draw a closed orbit from its cached line, false if it isn't one
+	bool RenderCachedOrbit(const Projectable &p, const ProjectedOrbit *orbitData, const vector3d &transformedPos, double projectedSize, double tMinust0);
 
 	// draw a grid with `radius` * 2 gridlines on an evenly spaced 1-AU grid
 	void DrawGrid(uint32_t radius);
@@ -384,6 +386,25 @@ private:
 	std::unique_ptr<vector3f[]> m_orbitVts;
 	std::unique_ptr<Color[]> m_orbitColors;
 
+	// The line of a closed orbit, tessellated around its focus once and
+	// only uploaded again when the orbit changes or the object has moved
+	// on to the next vertex. Drawing it is then just a transform.
+	struct OrbitLine {
+		double eccentricity;
+		double semiMajorAxis;
+		matrix3x3d plane;
+		Color color;
+		// the vertices at even steps of true anomaly, starting at periapsis
+		std::vector<vector3f> ring;
+		// the vertex the line starts at, after the object
+		Uint32 start;
+		std::unique_ptr<Graphics::VertexArray> va;
+		RefCountedPtr<Graphics::MeshObject> mesh;
+		Uint32 frame;
+	};
+	std::map<std::pair<int, const void *>, OrbitLine> m_orbitLines;
+	Uint32 m_orbitLinesFrame = 0;
+
 	std::unique_ptr<Graphics::VertexArray> m_lineVerts;
 	Graphics::Drawables::Lines m_lines;
 };
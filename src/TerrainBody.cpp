@@ -12,6 +12,8 @@
 #include "galaxy/SystemBody.h"
 #include "graphics/Renderer.h"
 
+#include <limits>
+
 TerrainBody::TerrainBody(SystemBody *sbody) :
 	Body(),
 	m_sbody(sbody),
@@ -20,6 +22,14 @@ TerrainBody::TerrainBody(SystemBody *sbody) :
 	InitTerrainBody();
 }
 
+// picks the height cache slot for a position; close directions share a slot
+static int GetHeightCacheSlot(const vector3d &pos, int numSlots)
+{
+	const vector3d dir = pos.Normalized() * 1048576.0;
+	const Uint64 hash = Uint64(std::llround(dir.x)) * 0x9E3779B97F4A7C15ULL ^ Uint64(std::llround(dir.y)) * 0xC2B2AE3D27D4EB4FULL ^ Uint64(std::llround(dir.z)) * 0x165667B19E3779F9ULL;
+	return int((hash >> 32) % Uint64(numSlots));
+}
+
 TerrainBody::~TerrainBody()
 {
 	m_baseSphere.reset();
@@ -29,6 +39,9 @@ void TerrainBody::InitTerrainBody()
 {
 	PROFILE_SCOPED()
 	assert(m_sbody);
+	// NaN positions never match a query
+	for (HeightCacheEntry &entry : m_heightCache)
+		entry.pos = vector3d(std::numeric_limits<double>::quiet_NaN());
 	m_mass = m_sbody->GetMass();
 	if (!m_baseSphere) {
 		if (SystemBody::SUPERTYPE_GAS_GIANT == m_sbody->GetSuperType()) {
@@ -103,10 +116,10 @@ void TerrainBody::Render(Graphics::Renderer *renderer, const Camera *camera, con
 
 	campos = campos * (1.0 / rad); // position of camera relative to planet "model"
 
-	std::vector<Camera::Shadow> shadows;
+	Camera::ShadowList shadows;
 	if (camera) {
 		camera->PrincipalShadows(this, 3, shadows);
-		for (std::vector<Camera::Shadow>::iterator it = shadows.begin(), itEnd = shadows.end(); it != itEnd; ++it) {
+		for (Camera::ShadowList::iterator it = shadows.begin(), itEnd = shadows.end(); it != itEnd; ++it) {
 			it->centre = ftran * it->centre;
 		}
 	}
@@ -143,13 +156,39 @@ double TerrainBody::GetTerrainHeight(const vector3d &pos_) const
 {
 	double radius = m_sbody->GetRadius();
 	if (m_baseSphere) {
-		return radius * (1.0 + m_baseSphere->GetHeight(pos_));
+		HeightCacheEntry &entry = m_heightCache[GetHeightCacheSlot(pos_, HEIGHT_CACHE_SIZE)];
+		{
+			std::lock_guard<std::mutex> lock(m_heightCacheLock);
+			if (entry.pos == pos_)
+				return entry.height;
+		}
+
+		const double height = radius * (1.0 + m_baseSphere->GetHeight(pos_));
+
+		std::lock_guard<std::mutex> lock(m_heightCacheLock);
+		entry.pos = pos_;
+		entry.height = height;
+		return height;
 	} else {
 		assert(0);
 		return radius;
 	}
 }
 
+void TerrainBody::PrefetchTerrain(const vector3d &pos)
+{
+	if (m_baseSphere)
+		m_baseSphere->SetApproachPoint(pos / m_sbody->GetRadius());
+}
+
+double TerrainBody::GetGeneratedTerrainHeight(const vector3d &pos) const
+{
+	double height;
+	if (m_baseSphere && m_baseSphere->GetGeneratedHeight(pos, height))
+		return m_sbody->GetRadius() * (1.0 + height);
+	return GetTerrainHeight(pos);
+}
+
 //static
 void TerrainBody::OnChangeDetailLevel()
 {
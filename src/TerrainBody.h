@@ -8,6 +8,8 @@
 #include "JsonFwd.h"
 #include "matrix4x4.h"
 
+#include <mutex>
+
 class BaseSphere;
 class Camera;
 class Frame;
@@ -28,8 +30,17 @@ public:
 	virtual bool OnCollision(Body *b, Uint32 flags, double relVel) override { return true; }
 	virtual double GetMass() const override { return m_mass; }
 	double GetTerrainHeight(const vector3d &pos) const;
+	// Same as GetTerrainHeight, but near the camera returns the height of
+	// the generated terrain mesh instead, which is much cheaper. For
+	// collisions and altitude readouts, not for anything that must not
+	// depend on what has been rendered.
+	double GetGeneratedTerrainHeight(const vector3d &pos) const;
 	virtual const SystemBody *GetSystemBody() const override { return m_sbody; }
 
+	// Have the terrain seen from pos (in the body's frame) ready soon; see
+	// ApproachPrefetch
+	void PrefetchTerrain(const vector3d &pos);
+
 	// returns value in metres
 	double GetMaxFeatureRadius() const { return m_maxFeatureHeight; }
 
@@ -51,6 +62,18 @@ private:
 	double m_mass;
 	std::unique_ptr<BaseSphere> m_baseSphere;
 	double m_maxFeatureHeight;
+
+	// Recent GetTerrainHeight results. The slot is picked by the quantised
+	// direction of the query, but only the exact same position hits, so
+	// results don't depend on the cache. Collisions are tested on worker
+	// threads, hence the lock.
+	struct HeightCacheEntry {
+		vector3d pos;
+		double height;
+	};
+	static const int HEIGHT_CACHE_SIZE = 64;
+	mutable HeightCacheEntry m_heightCache[HEIGHT_CACHE_SIZE];
+	mutable std::mutex m_heightCacheLock;
 };
 
 #endif
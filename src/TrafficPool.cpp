@@ -0,0 +1,253 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "TrafficPool.h"
+
+#include "GameSaveError.h"
+#include "JsonUtils.h"
+#include "Player.h"
+#include "Ship.h"
+#include "ShipType.h"
+#include "Space.h"
+#include "SpaceStation.h"
+#include "lua/LuaEvent.h"
+#include "profiler/Profiler.h"
+
+#include <algorithm>
+
+double TrafficPool::s_relevanceRadius = 1e8;
+
+TrafficPool::TrafficPool(Space *space) :
+	m_space(space),
+	m_nextId(1)
+{
+}
+
+TrafficPool::~TrafficPool()
+{
+}
+
+void TrafficPool::ToJson(Json &jsonObj, Space *space) const
+{
+	Json recordArray = Json::array();
+	for (const Record &record : m_records) {
+		Json recordObj({});
+		recordObj["id"] = record.id;
+		recordObj["ship_type"] = record.shipType;
+		recordObj["index_for_from"] = space->GetIndexForBody(record.from);
+		recordObj["index_for_to"] = space->GetIndexForBody(record.to);
+		recordObj["departure"] = record.departure;
+		recordObj["arrival"] = record.arrival;
+		recordObj["index_for_ship"] = space->GetIndexForBody(record.ship);
+		recordArray.push_back(recordObj);
+	}
+
+	jsonObj = Json::object();
+	jsonObj["next_id"] = m_nextId;
+	jsonObj["records"] = recordArray;
+}
+
+void TrafficPool::FromJson(const Json &jsonObj, Space *space)
+{
+	try {
+		m_nextId = jsonObj["next_id"].get<Id>();
+
+		for (const Json &recordObj : jsonObj["records"].get<Json::array_t>()) {
+			Record record;
+			record.id = recordObj["id"].get<Id>();
+			record.shipType = recordObj["ship_type"].get<std::string>();
+			record.from = static_cast<SpaceStation *>(space->GetBodyByIndex(recordObj["index_for_from"].get<Uint32>()));
+			record.to = static_cast<SpaceStation *>(space->GetBodyByIndex(recordObj["index_for_to"].get<Uint32>()));
+			record.departure = recordObj["departure"].get<double>();
+			record.arrival = recordObj["arrival"].get<double>();
+			record.ship = static_cast<Ship *>(space->GetBodyByIndex(recordObj["index_for_ship"].get<Uint32>()));
+
+			if (!record.from || !record.to || !ShipType::Get(record.shipType.c_str()))
+				throw SavedGameCorruptException();
+
+			m_index[record.id] = m_records.size();
+			m_records.push_back(record);
+		}
+	} catch (Json::type_error &) {
+		throw SavedGameCorruptException();
+	}
+}
+
+TrafficPool::Id TrafficPool::Add(const std::string &shipType, SpaceStation *from, SpaceStation *to, double departure, double arrival)
+{
+	Record record;
+	record.id = m_nextId++;
+	record.shipType = shipType;
+	record.from = from;
+	record.to = to;
+	record.departure = departure;
+	record.arrival = std::max(arrival, departure);
+	record.ship = nullptr;
+
+	m_index[record.id] = m_records.size();
+	m_records.push_back(record);
+	return record.id;
+}
+
+void TrafficPool::Remove(Id id)
+{
+	auto iter = m_index.find(id);
+	if (iter == m_index.end())
+		return;
+
+	const size_t index = iter->second;
+	m_index.erase(iter);
+
+	// swap the last record into its place
+	if (index != m_records.size() - 1) {
+		m_records[index] = m_records.back();
+		m_index[m_records[index].id] = index;
+	}
+	m_records.pop_back();
+}
+
+const TrafficPool::Record *TrafficPool::Get(Id id) const
+{
+	auto iter = m_index.find(id);
+	return iter == m_index.end() ? nullptr : &m_records[iter->second];
+}
+
+size_t TrafficPool::GetNumShips() const
+{
+	return std::count_if(m_records.begin(), m_records.end(), [](const Record &record) { return record.ship != nullptr; });
+}
+
+vector3d TrafficPool::GetRecordPosition(const Record &record, double time, const Body *player) const
+{
+	const vector3d fromPos = record.from->GetPositionRelTo(player);
+	if (time <= record.departure)
+		return fromPos;
+
+	// a straight line is near enough to tell whether the player is close
+	const double duration = record.arrival - record.departure;
+	const double ratio = duration > 0.0 ? std::min((time - record.departure) / duration, 1.0) : 1.0;
+	return fromPos + (record.to->GetPositionRelTo(player) - fromPos) * ratio;
+}
+
+bool TrafficPool::Spawn(Record &record, double time)
+{
+	Ship *ship = new Ship(record.shipType);
+
+	if (time < record.departure) {
+		const int port = record.from->GetFreeDockingPort(ship);
+		if (port < 0) {
+			// no room to wait in, it appears once it has left instead
+			delete ship;
+			return false;
+		}
+
+		ship->SetFrame(record.from->GetFrame());
+		m_space->AddBody(ship);
+		ship->SetDockedWith(record.from, port);
+	} else {
+		ship->SetFrame(record.from->GetFrame());
+		ship->SetPosition(record.from->GetPosition());
+		m_space->AddBody(ship);
+
+		const double duration = record.arrival - record.departure;
+		const double ratio = duration > 0.0 ? std::min((time - record.departure) / duration, 1.0) : 1.0;
+		Space::PutShipOnRoute(ship, record.to, ratio);
+		ship->AIDock(record.to);
+	}
+
+	record.ship = ship;
+	LuaEvent::Queue("onTrafficShipSpawned", record.id, ship);
+	return true;
+}
+
+bool TrafficPool::Despawn(Record &record, const Body *player)
+{
+	Ship *ship = record.ship;
+
+	// not in the middle of anything that can't be picked up again
+	const Ship::FlightState state = ship->GetFlightState();
+	if (state != Ship::FLYING && !(state == Ship::DOCKED && ship->GetDockedWith() == record.from))
+		return false;
+
+	if (const Player *p = player && player->IsType(ObjectType::PLAYER) ? static_cast<const Player *>(player) : nullptr) {
+		if (p->GetNavTarget() == ship || p->GetCombatTarget() == ship)
+			return false;
+	}
+
+	// cleared first so that NotifyRemoved doesn't take it as lost
+	record.ship = nullptr;
+	m_space->KillBody(ship);
+	return true;
+}
+
+void TrafficPool::Finish(size_t index)
+{
+	const Record record = m_records[index];
+	Remove(record.id);
+	LuaEvent::Queue("onTrafficArrived", record.id, record.to);
+}
+
+void TrafficPool::TimeStep(double time, const Body *player)
+{
+	PROFILE_SCOPED()
+
+	const double spawnDistSqr = s_relevanceRadius * s_relevanceRadius;
+	const double despawnDistSqr = spawnDistSqr * HYSTERESIS * HYSTERESIS;
+
+	std::vector<Id> finished;
+	for (Record &record : m_records) {
+		Ship *ship = record.ship;
+		if (!ship) {
+			if (time >= record.arrival)
+				finished.push_back(record.id);
+			else if (player && GetRecordPosition(record, time, player).LengthSqr() < spawnDistSqr)
+				Spawn(record, time);
+			continue;
+		}
+
+		const Ship::FlightState state = ship->GetFlightState();
+		if (state == Ship::DOCKED && ship->GetDockedWith() == record.to) {
+			finished.push_back(record.id);
+			continue;
+		}
+
+		if (!player || ship->GetPositionRelTo(player).LengthSqr() > despawnDistSqr) {
+			if (Despawn(record, player))
+				continue;
+		}
+
+		if (state == Ship::DOCKED && ship->GetDockedWith() == record.from && time >= record.departure)
+			ship->Undock();
+		else if (state == Ship::FLYING && !ship->AIIsActive())
+			ship->AIDock(record.to);
+	}
+
+	// looked up again, finishing one moves another
+	for (Id id : finished)
+		Finish(m_index[id]);
+}
+
+void TrafficPool::NotifyRemoved(const std::vector<const Body *> &removedBodies)
+{
+	if (removedBodies.empty())
+		return;
+
+	auto isRemoved = [&](const Body *body) {
+		return std::binary_search(removedBodies.begin(), removedBodies.end(), body);
+	};
+
+	std::vector<Id> lost, dropped;
+	for (const Record &record : m_records) {
+		if (record.ship && isRemoved(record.ship))
+			lost.push_back(record.id);
+		else if (isRemoved(record.from) || isRemoved(record.to))
+			dropped.push_back(record.id);
+	}
+
+	for (Id id : lost) {
+		Remove(id);
+		LuaEvent::Queue("onTrafficShipLost", id);
+	}
+	for (Id id : dropped)
+		Remove(id);
+}
@@ -0,0 +1,102 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _TRAFFICPOOL_H
+#define _TRAFFICPOOL_H
+
+#include "JsonFwd.h"
+#include "vector3.h"
+
+#include <SDL_stdinc.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Body;
+class Ship;
+class Space;
+class SpaceStation;
+
+// NPC ships flying between the stations of a system, kept as records of
+// where they go and when while nobody can see them. A record only becomes a
+// Ship body while it is within the relevance radius of the player: docked at
+// its origin before it leaves, put on its route part of the way along it
+// (see Space::PutShipOnRoute) while in flight, and then flown to its
+// destination by the AI. A ship that falls behind the player again goes back
+// to being a record, which arrives on time.
+//
+// Scripts refer to the ships by the number Add gives them, which stays the
+// same whether the ship is a record or a body at the moment:
+//   onTrafficShipSpawned(id, ship) - the record became ship
+//   onTrafficArrived(id, station)  - the journey is over; a ship body stays
+//                                    docked at the station as an ordinary ship
+//   onTrafficShipLost(id)          - the body was destroyed, or removed by
+//                                    something else, and the record with it
+class TrafficPool {
+public:
+	typedef Uint32 Id;
+
+	struct Record {
+		Id id;
+		// a ShipType::Id
+		std::string shipType;
+		SpaceStation *from;
+		SpaceStation *to;
+		double departure;
+		double arrival;
+		// while the record is a body
+		Ship *ship;
+	};
+
+	TrafficPool(Space *space);
+	~TrafficPool();
+
+	// the stations and ships are looked up in the body index of the space
+	void ToJson(Json &jsonObj, Space *space) const;
+	void FromJson(const Json &jsonObj, Space *space);
+
+	// A ship of the type leaving from at departure and docking at to at
+	// arrival, both game times
+	Id Add(const std::string &shipType, SpaceStation *from, SpaceStation *to, double departure, double arrival);
+	// The record is dropped, and a ship body made from it is left to
+	// whatever it was doing
+	void Remove(Id id);
+
+	// nullptr once the journey is over
+	const Record *Get(Id id) const;
+
+	// Make the records the player comes near into bodies, and those the
+	// player has left far behind into records again; then finish every
+	// journey that has arrived. A pass over the records, then one more for
+	// each that changed.
+	void TimeStep(double time, const Body *player);
+	// the removed bodies are sorted
+	void NotifyRemoved(const std::vector<const Body *> &removedBodies);
+
+	size_t GetNumRecords() const { return m_records.size(); }
+	size_t GetNumShips() const;
+
+	// Distance from the player within which the records are bodies; they are
+	// taken out of space again at HYSTERESIS times that
+	static void SetRelevanceRadius(double radius) { s_relevanceRadius = radius; }
+	static double GetRelevanceRadius() { return s_relevanceRadius; }
+
+private:
+	static constexpr double HYSTERESIS = 1.5;
+
+	// where a record in flight would be, relative to the player
+	vector3d GetRecordPosition(const Record &record, double time, const Body *player) const;
+
+	bool Spawn(Record &record, double time);
+	bool Despawn(Record &record, const Body *player);
+	void Finish(size_t index);
+
+	Space *m_space;
+	std::vector<Record> m_records;
+	std::unordered_map<Id, size_t> m_index;
+	Id m_nextId;
+
+	static double s_relevanceRadius;
+};
+
+#endif /* _TRAFFICPOOL_H */
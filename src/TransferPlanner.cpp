@@ -8,9 +8,57 @@
 #include "Orbit.h"
 #include "Pi.h"
 #include "Player.h"
+#include "core/TaskGraph.h"
 
+#include <atomic>
+#include <cmath>
+#include <limits>
 #include <sstream>
 
+struct TransferPlanner::Porkchop {
+	// both around the same mass, at the time the grid was started
+	Orbit playerOrbit;
+	Orbit targetOrbit;
+	double centralMass;
+	double startTime;
+
+	std::vector<double> departTimes;
+	std::vector<double> flightTimes;
+	// departTimes.size() rows of flightTimes.size() cells
+	std::vector<float> dv;
+	// a row is only read once its flag is set
+	std::unique_ptr<std::atomic<bool>[]> rowDone;
+	std::atomic<bool> cancel;
+	std::unique_ptr<TaskSet::Handle> handle;
+
+	void SolveRow(unsigned row);
+};
+
+void TransferPlanner::Porkchop::SolveRow(unsigned row)
+{
+	const size_t numFlights = flightTimes.size();
+	float *out = &dv[row * numFlights];
+
+	vector3d pos1, vel1;
+	playerOrbit.OrbitalStateAtTime(departTimes[row], pos1, vel1);
+	// prograde with respect to the orbit the player is on
+	const vector3d normal = pos1.Cross(vel1);
+
+	for (size_t i = 0; i < numFlights; i++) {
+		if (cancel.load(std::memory_order_relaxed))
+			break;
+
+		vector3d pos2, vel2, v1, v2;
+		targetOrbit.OrbitalStateAtTime(departTimes[row] + flightTimes[i], pos2, vel2);
+		if (Orbit::SolveLambert(pos1, pos2, flightTimes[i], centralMass, normal, v1, v2))
+			out[i] = float((v1 - vel1).Length() + (vel2 - v2).Length());
+		else
+			out[i] = std::numeric_limits<float>::quiet_NaN();
+	}
+
+	rowDone[row].store(true, std::memory_order_release);
+}
+
 TransferPlanner::TransferPlanner() :
 	m_position(0., 0., 0.),
 	m_velocity(0., 0., 0.)
@@ -22,6 +70,11 @@ TransferPlanner::TransferPlanner() :
 	m_factor = 1;
 }
 
+TransferPlanner::~TransferPlanner()
+{
+	CancelPorkchop();
+}
+
 vector3d TransferPlanner::GetVel() const { return m_velocity + GetOffsetVel(); }
 
 vector3d TransferPlanner::GetOffsetVel() const
@@ -48,8 +101,7 @@ void TransferPlanner::AddStartTime(double timeStep)
 		Frame *frame = Frame::GetFrame(frameId);
 		Orbit playerOrbit = Orbit::FromBodyState(Pi::player->GetPositionRelTo(frameId), Pi::player->GetVelocityRelTo(frameId), frame->GetSystemBody()->GetMass());
 
-		m_position = playerOrbit.OrbitalPosAtTime(deltaT);
-		m_velocity = playerOrbit.OrbitalVelocityAtTime(frame->GetSystemBody()->GetMass(), deltaT);
+		playerOrbit.OrbitalStateAtTime(deltaT, m_position, m_velocity);
 	} else
 		ResetStartTime();
 }
@@ -144,3 +196,137 @@ void TransferPlanner::DecreaseFactor(void)
 vector3d TransferPlanner::GetPosition() const { return m_position; }
 
 void TransferPlanner::SetPosition(const vector3d &position) { m_position = position; }
+
+void TransferPlanner::StartPorkchop(const Body *target, double departSpan, double minFlight, double maxFlight, unsigned departSteps, unsigned flightSteps)
+{
+	CancelPorkchop();
+	if (!target || target == Pi::player || departSteps == 0 || flightSteps == 0 || minFlight <= 0.0 || maxFlight < minFlight)
+		return;
+
+	FrameId frameId = Frame::GetFrame(Pi::player->GetFrame())->GetNonRotFrame();
+	Frame *frame = Frame::GetFrame(frameId);
+	if (!frame->GetSystemBody())
+		return;
+
+	m_porkchop.reset(new Porkchop());
+	Porkchop &grid = *m_porkchop;
+	grid.centralMass = frame->GetSystemBody()->GetMass();
+	grid.startTime = Pi::game->GetTime();
+	grid.playerOrbit = Orbit::FromBodyState(Pi::player->GetPositionRelTo(frameId), Pi::player->GetVelocityRelTo(frameId), grid.centralMass);
+	grid.targetOrbit = Orbit::FromBodyState(target->GetPositionRelTo(frameId), target->GetVelocityRelTo(frameId), grid.centralMass);
+
+	for (unsigned i = 0; i < departSteps; i++)
+		grid.departTimes.push_back(departSteps > 1 ? departSpan * i / (departSteps - 1) : 0.0);
+	for (unsigned i = 0; i < flightSteps; i++)
+		grid.flightTimes.push_back(flightSteps > 1 ? minFlight + (maxFlight - minFlight) * i / (flightSteps - 1) : minFlight);
+
+	grid.dv.resize(size_t(departSteps) * flightSteps, std::numeric_limits<float>::quiet_NaN());
+	grid.rowDone.reset(new std::atomic<bool>[departSteps]());
+	grid.cancel = false;
+
+	// one task per departure time, they fill separate rows
+	Porkchop *porkchop = m_porkchop.get();
+	TaskSet *set = new TaskSet();
+	set->AddTaskRangeLambda({ 0, departSteps }, 1, [porkchop](TaskRange range) {
+		for (uint32_t row = range.begin; row < range.end; row++)
+			porkchop->SolveRow(row);
+	});
+	grid.handle.reset(new TaskSet::Handle(Pi::GetApp()->GetTaskGraph()->QueueTaskSet(set)));
+}
+
+void TransferPlanner::CancelPorkchop()
+{
+	if (!m_porkchop)
+		return;
+
+	if (m_porkchop->handle) {
+		m_porkchop->cancel = true;
+		Pi::GetApp()->GetTaskGraph()->WaitForTaskSet(*m_porkchop->handle);
+	}
+	m_porkchop.reset();
+}
+
+void TransferPlanner::UpdatePorkchop()
+{
+	if (m_porkchop && m_porkchop->handle && m_porkchop->handle->IsComplete()) {
+		Pi::GetApp()->GetTaskGraph()->CompleteTaskSet(*m_porkchop->handle);
+		m_porkchop->handle.reset();
+	}
+}
+
+bool TransferPlanner::IsPorkchopDone() const
+{
+	return m_porkchop && !m_porkchop->handle;
+}
+
+unsigned TransferPlanner::GetPorkchopDepartSteps() const
+{
+	return m_porkchop ? m_porkchop->departTimes.size() : 0;
+}
+
+unsigned TransferPlanner::GetPorkchopFlightSteps() const
+{
+	return m_porkchop ? m_porkchop->flightTimes.size() : 0;
+}
+
+double TransferPlanner::GetPorkchopDepartTime(unsigned departStep) const
+{
+	if (departStep >= GetPorkchopDepartSteps())
+		return 0.0;
+	return m_porkchop->startTime + m_porkchop->departTimes[departStep];
+}
+
+double TransferPlanner::GetPorkchopFlightTime(unsigned flightStep) const
+{
+	if (flightStep >= GetPorkchopFlightSteps())
+		return 0.0;
+	return m_porkchop->flightTimes[flightStep];
+}
+
+bool TransferPlanner::IsPorkchopRowDone(unsigned departStep) const
+{
+	if (departStep >= GetPorkchopDepartSteps())
+		return false;
+	return m_porkchop->rowDone[departStep].load(std::memory_order_acquire);
+}
+
+float TransferPlanner::GetPorkchopDv(unsigned departStep, unsigned flightStep) const
+{
+	if (!IsPorkchopRowDone(departStep) || flightStep >= GetPorkchopFlightSteps())
+		return std::numeric_limits<float>::quiet_NaN();
+	return m_porkchop->dv[departStep * m_porkchop->flightTimes.size() + flightStep];
+}
+
+bool TransferPlanner::ApplyPorkchop(unsigned departStep, unsigned flightStep)
+{
+	if (std::isnan(GetPorkchopDv(departStep, flightStep)))
+		return false;
+
+	const Porkchop &grid = *m_porkchop;
+	const double departTime = grid.departTimes[departStep];
+	vector3d pos, vel, pos2, vel2, v1, v2;
+	grid.playerOrbit.OrbitalStateAtTime(departTime, pos, vel);
+	grid.targetOrbit.OrbitalStateAtTime(departTime + grid.flightTimes[flightStep], pos2, vel2);
+	if (!Orbit::SolveLambert(pos, pos2, grid.flightTimes[flightStep], grid.centralMass, pos.Cross(vel), v1, v2))
+		return false;
+
+	// split the burn along the directions of GetOffsetVel(); prograde and
+	// radial need not be at right angles, normal is to both
+	const vector3d burn = v1 - vel;
+	const vector3d prograde = vel.Normalized();
+	const vector3d radial = pos.Normalized();
+	const double k = prograde.Dot(radial);
+	const double det = 1.0 - k * k;
+	if (det < 1e-12)
+		return false;
+	const double bp = burn.Dot(prograde);
+	const double br = burn.Dot(radial);
+
+	m_startTime = grid.startTime + departTime;
+	m_position = pos;
+	m_velocity = vel;
+	m_dvPrograde = (bp - k * br) / det;
+	m_dvRadial = (br - k * bp) / det;
+	m_dvNormal = burn.Dot(pos.Cross(vel).Normalized());
+	return true;
+}
@@ -5,6 +5,10 @@
 
 #include "vector3.h"
 
+#include <memory>
+
+class Body;
+
 class TransferPlanner {
 public:
 	enum BurnDirection {
@@ -14,6 +18,7 @@ public:
 	};
 
 	TransferPlanner();
+	~TransferPlanner();
 	vector3d GetVel() const;
 	vector3d GetOffsetVel() const;
 	vector3d GetPosition() const;
@@ -28,7 +33,31 @@ public:
 	void ResetDv(BurnDirection d);
 	void ResetDv();
 
+	// Porkchop plot: the delta-v of going from the player's orbit to the
+	// orbit of target, for a grid of departure times from now on and flight
+	// times, both counted in seconds. Both orbits are taken around the
+	// player's non-rotating frame. The rows of the grid, one per departure
+	// time, are solved on the task graph and can be read as they come in.
+	void StartPorkchop(const Body *target, double departSpan, double minFlight, double maxFlight, unsigned departSteps, unsigned flightSteps);
+	void CancelPorkchop();
+	// Finish the grid once all rows are in, call once a frame
+	void UpdatePorkchop();
+	bool HasPorkchop() const { return bool(m_porkchop); }
+	bool IsPorkchopDone() const;
+	unsigned GetPorkchopDepartSteps() const;
+	unsigned GetPorkchopFlightSteps() const;
+	double GetPorkchopDepartTime(unsigned departStep) const;
+	double GetPorkchopFlightTime(unsigned flightStep) const;
+	bool IsPorkchopRowDone(unsigned departStep) const;
+	// total delta-v of both burns, NaN where there is no transfer or the
+	// row isn't done
+	float GetPorkchopDv(unsigned departStep, unsigned flightStep) const;
+	// Plan the departure burn of a cell
+	bool ApplyPorkchop(unsigned departStep, unsigned flightStep);
+
 private:
+	struct Porkchop;
+
 	double m_dvPrograde;
 	double m_dvNormal;
 	double m_dvRadial;
@@ -37,4 +66,5 @@ private:
 	vector3d m_position;
 	vector3d m_velocity;
 	double m_startTime;
+	std::unique_ptr<Porkchop> m_porkchop;
 };
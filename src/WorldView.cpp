@@ -159,6 +159,7 @@ void WorldView::Draw3D()
 	assert(Pi::player);
 	assert(!Pi::player->IsDead());
 
+	Graphics::Renderer::GPUTimerTicket timer(m_renderer, "WorldView");
 	m_cameraContext->ApplyDrawTransforms(m_renderer);
 
 	m_camera->Draw();
@@ -174,8 +175,10 @@ void WorldView::Draw3D()
 
 	// Contact trails
 	if (Pi::AreHudTrailsDisplayed()) {
-		for (auto it = Pi::player->GetSensors()->GetContacts().begin(); it != Pi::player->GetSensors()->GetContacts().end(); ++it)
-			it->trail->Render(m_renderer);
+		HudTrail::BeginBatch();
+		for (const Sensors::RadarContact *contact : Pi::player->GetSensors()->GetContacts())
+			contact->trail->Render(m_renderer);
+		HudTrail::EndBatch(m_renderer);
 	}
 
 	m_cameraContext->EndFrame();
@@ -244,11 +247,11 @@ void WorldView::Update()
 		matrix4x4d trans;
 		Frame::GetFrameTransform(playerFrameId, camFrameId, trans);
 
-		for (auto it = Pi::player->GetSensors()->GetContacts().begin(); it != Pi::player->GetSensors()->GetContacts().end(); ++it)
-			it->trail->SetTransform(trans);
+		for (const Sensors::RadarContact *contact : Pi::player->GetSensors()->GetContacts())
+			contact->trail->SetTransform(trans);
 	} else {
-		for (auto it = Pi::player->GetSensors()->GetContacts().begin(); it != Pi::player->GetSensors()->GetContacts().end(); ++it)
-			it->trail->Reset(playerFrameId);
+		for (const Sensors::RadarContact *contact : Pi::player->GetSensors()->GetContacts())
+			contact->trail->Reset(playerFrameId);
 	}
 }
 
@@ -605,6 +608,107 @@ static vector3d projectToScreenSpace(const vector3d &pos, RefCountedPtr<CameraCo
 	return proj;
 }
 
+namespace {
+	// projectToScreenSpace, with everything that doesn't change from one
+	// position to the next looked up once
+	class ScreenProjector {
+	public:
+		ScreenProjector(RefCountedPtr<CameraContext> cameraContext) :
+			m_frustum(cameraContext->GetFrustum()),
+			m_width(cameraContext->GetWidth()),
+			m_height(cameraContext->GetHeight()),
+			m_cameraFrame(cameraContext->GetCameraFrame()),
+			m_cameraPos(cameraContext->GetCameraPos()),
+			m_cameraOrient(cameraContext->GetCameraOrient())
+		{}
+
+		// pos is relative to frame
+		WorldView::ScreenProjection Project(const vector3d &pos, FrameId frame)
+		{
+			vector3d camFramePos = pos;
+			if (frame != m_cameraFrame) {
+				const FrameTransform &transform = GetFrameTransform(frame);
+				camFramePos = transform.orient * pos + transform.pos;
+			}
+			return Project((camFramePos - m_cameraPos) * m_cameraOrient);
+		}
+
+		// pos is in camera space
+		WorldView::ScreenProjection Project(const vector3d &pos) const
+		{
+			WorldView::ScreenProjection result;
+			vector3d &proj = result.screenPos;
+			if (!m_frustum.ProjectPoint(pos, proj)) {
+				proj = vector3d(m_width / 2, m_height / 2, 0);
+			} else {
+				proj.x *= m_width;
+				proj.y = m_height - proj.y * m_height;
+				proj.z = pos.z < 0 ? -1 : 1;
+			}
+			result.onScreen = !(proj == vector3d(0.0)) && proj.z <= 0 &&
+				proj.x >= 0 && proj.y >= 0 && proj.x <= m_width && proj.y <= m_height;
+			return result;
+		}
+
+		WorldView::ScreenProjection Hidden() const
+		{
+			return { vector3d(0.0), false };
+		}
+
+	private:
+		struct FrameTransform {
+			FrameId frame;
+			matrix3x3d orient;
+			vector3d pos;
+		};
+
+		// there are only ever a few frames with markers in them
+		const FrameTransform &GetFrameTransform(FrameId frame)
+		{
+			for (const FrameTransform &transform : m_transforms)
+				if (transform.frame == frame)
+					return transform;
+			const Frame *f = Frame::GetFrame(frame);
+			m_transforms.push_back({ frame, f->GetInterpOrientRelTo(m_cameraFrame), f->GetInterpPositionRelTo(m_cameraFrame) });
+			return m_transforms.back();
+		}
+
+		const Graphics::Frustum &m_frustum;
+		const float m_width;
+		const float m_height;
+		const FrameId m_cameraFrame;
+		const vector3d m_cameraPos;
+		const matrix3x3d m_cameraOrient;
+		std::vector<FrameTransform> m_transforms;
+	};
+} // namespace
+
+void WorldView::WorldSpaceToScreenSpace(const std::vector<vector3d> &positions, const std::vector<FrameId> &frames, std::vector<ScreenProjection> &out) const
+{
+	PROFILE_SCOPED()
+	assert(frames.empty() || frames.size() == positions.size());
+	ScreenProjector projector(m_cameraContext);
+	const FrameId cameraFrame = m_cameraContext->GetCameraFrame();
+	out.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		out[i] = projector.Project(positions[i], frames.empty() ? cameraFrame : frames[i]);
+}
+
+void WorldView::WorldSpaceToScreenSpace(const std::vector<Body *> &bodies, std::vector<ScreenProjection> &out) const
+{
+	PROFILE_SCOPED()
+	ScreenProjector projector(m_cameraContext);
+	const bool hidePlayer = !shipView->IsExteriorView();
+	out.resize(bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++) {
+		const Body *body = bodies[i];
+		if (hidePlayer && body->IsType(ObjectType::PLAYER))
+			out[i] = projector.Hidden();
+		else
+			out[i] = projector.Project(body->GetInterpPosition(), body->GetFrame());
+	}
+}
+
 // project a body in world-space to a screen-space location
 vector3d WorldView::WorldSpaceToScreenSpace(const Body *body) const
 {
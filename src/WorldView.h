@@ -5,6 +5,7 @@
 #define _WORLDVIEW_H
 
 #include "ConnectionTicket.h"
+#include "FrameId.h"
 #include "graphics/Drawables.h"
 #include "pigui/PiGuiView.h"
 #include "ship/ShipViewController.h"
@@ -57,6 +58,22 @@ public:
 	vector3d GetTargetIndicatorScreenPosition(const Body *body) const;
 	vector3d CameraSpaceToScreenSpace(const vector3d &pos) const;
 
+	// A position projected by the batched calls below: screenPos is what
+	// WorldSpaceToScreenSpace returns for it, and onScreen says whether it
+	// is in front of the camera and inside the viewport
+	struct ScreenProjection {
+		vector3d screenPos;
+		bool onScreen;
+	};
+
+	// Projects many positions at once, each relative to the frame of the
+	// same index, or to the parent frame of the camera if frames is empty.
+	// The transform of each frame to the camera is worked out only once,
+	// so this is much cheaper than projecting the markers one by one.
+	void WorldSpaceToScreenSpace(const std::vector<vector3d> &positions, const std::vector<FrameId> &frames, std::vector<ScreenProjection> &out) const;
+	// as WorldSpaceToScreenSpace(const Body *) for each of the bodies
+	void WorldSpaceToScreenSpace(const std::vector<Body *> &bodies, std::vector<ScreenProjection> &out) const;
+
 	void BeginCameraFrame() { m_cameraContext->BeginFrame(); };
 	void EndCameraFrame() { m_cameraContext->EndFrame(); };
 
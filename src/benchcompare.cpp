@@ -0,0 +1,195 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Json.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Exit codes, for scripts to tell a regression from a broken run
+enum ExitCode {
+	EXIT_SAME = 0,
+	EXIT_REGRESSED = 1,
+	EXIT_ERROR = 2
+};
+
+int info()
+{
+	printf(
+		"benchcompare - Compare two sets of benchmark results for regressions.\n"
+		"USAGE: benchcompare [options] <base.json> <new.json>\n"
+		"       benchcompare [options] <base.json>... -- <new.json>...\n"
+		"  Reads the output of the benchmarks target or of pioneer -benchmark.\n"
+		"  Samples of a metric from several files (repeated runs) are pooled.\n"
+		"  A metric regressed when its median got slower by more than the\n"
+		"  threshold and by more than the given number of standard errors,\n"
+		"  estimated from the median absolute deviation of the samples.\n"
+		"  -t, --threshold pct  smallest slowdown reported (default 5)\n"
+		"  -k, --sigmas k       standard errors a slowdown must exceed (default 3)\n"
+		"  -a, --all            list the metrics that didn't change too\n"
+		"  Exits with 0 when nothing regressed, 1 when something did and 2 when\n"
+		"  the results could not be read.\n");
+	return EXIT_ERROR;
+}
+
+// The samples of each metric, all of them times where lower is better
+typedef std::map<std::string, std::vector<double>> Metrics;
+
+static void add_frame_times(Metrics &metrics, const std::string &prefix, const Json &summary)
+{
+	for (const char *key : { "mean", "p50", "p95", "p99" }) {
+		if (summary.count(key))
+			metrics[prefix + " " + key].push_back(summary[key].get<double>());
+	}
+}
+
+static bool read_results(const std::string &filename, Metrics &metrics)
+{
+	std::ifstream file(filename);
+	if (!file) {
+		printf("Could not open file %s.\n", filename.c_str());
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+
+	const Json root = Json::parse(text.str(), nullptr, false);
+	if (!root.is_object()) {
+		printf("%s is not a JSON object.\n", filename.c_str());
+		return false;
+	}
+
+	try {
+		// the benchmarks target: each kernel was timed a number of times
+		if (root.count("results")) {
+			for (const Json &result : root["results"]) {
+				const std::string name = result["suite"].get<std::string>() + "/" + result["name"].get<std::string>();
+				std::vector<double> &samples = metrics[name];
+				if (result.count("timesMs")) {
+					for (const Json &ms : result["timesMs"])
+						samples.push_back(ms.get<double>());
+				} else {
+					samples.push_back(result["medianMs"].get<double>());
+				}
+			}
+		}
+
+		// a scripted benchmark: one sample of each percentile per run
+		if (root.count("frameMs")) {
+			add_frame_times(metrics, "frame", root["frameMs"]);
+			int index = 0;
+			for (const Json &step : root.value("steps", Json::array())) {
+				const std::string prefix = "step " + std::to_string(++index) + " " + step.value("action", "");
+				add_frame_times(metrics, prefix, step["frameMs"]);
+			}
+		}
+	} catch (const Json::exception &e) {
+		printf("%s is not a benchmark result: %s\n", filename.c_str(), e.what());
+		return false;
+	}
+
+	return true;
+}
+
+static double median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	const size_t mid = values.size() / 2;
+	return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) * 0.5;
+}
+
+// The standard error of the median, from the median absolute deviation: the
+// MAD is scaled to a standard deviation as if the noise was normal, which
+// holds up against the odd sample slowed down by something else running
+static double median_error(const std::vector<double> &values, double center)
+{
+	std::vector<double> deviations;
+	for (double value : values)
+		deviations.push_back(std::fabs(value - center));
+	const double sigma = 1.4826 * median(deviations);
+	return 1.2533 * sigma / std::sqrt(double(values.size()));
+}
+
+extern "C" int main(int argc, char **argv)
+{
+	double threshold = 5.0;
+	double sigmas = 3.0;
+	bool listAll = false;
+	std::vector<std::string> baseFiles, newFiles;
+	bool separated = false;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		if ((arg == "-t" || arg == "--threshold") && i + 1 < argc)
+			threshold = atof(argv[++i]);
+		else if ((arg == "-k" || arg == "--sigmas") && i + 1 < argc)
+			sigmas = atof(argv[++i]);
+		else if (arg == "-a" || arg == "--all")
+			listAll = true;
+		else if (arg == "--")
+			separated = true;
+		else if (arg[0] == '-')
+			return info();
+		else
+			(separated ? newFiles : baseFiles).push_back(arg);
+	}
+
+	if (!separated && baseFiles.size() == 2) {
+		newFiles.push_back(baseFiles.back());
+		baseFiles.pop_back();
+	}
+	if (baseFiles.empty() || newFiles.empty())
+		return info();
+
+	Metrics baseMetrics, newMetrics;
+	for (const std::string &filename : baseFiles)
+		if (!read_results(filename, baseMetrics))
+			return EXIT_ERROR;
+	for (const std::string &filename : newFiles)
+		if (!read_results(filename, newMetrics))
+			return EXIT_ERROR;
+
+	int numRegressed = 0, numImproved = 0, numCompared = 0;
+	printf("%-56s %12s %12s %9s  %s\n", "metric", "base ms", "new ms", "change", "");
+	for (const auto &entry : baseMetrics) {
+		const auto other = newMetrics.find(entry.first);
+		if (other == newMetrics.end() || entry.second.empty() || other->second.empty())
+			continue;
+		numCompared++;
+
+		const double baseMedian = median(entry.second);
+		const double newMedian = median(other->second);
+		const double error = std::hypot(median_error(entry.second, baseMedian), median_error(other->second, newMedian));
+		const double change = newMedian - baseMedian;
+		const double percent = baseMedian > 0.0 ? 100.0 * change / baseMedian : 0.0;
+
+		// a single run on either side has no noise to go by, only the threshold
+		const bool significant = std::fabs(percent) > threshold && std::fabs(change) > sigmas * error;
+		const char *verdict = "";
+		if (significant && change > 0.0) {
+			verdict = "REGRESSED";
+			numRegressed++;
+		} else if (significant) {
+			verdict = "improved";
+			numImproved++;
+		} else if (!listAll) {
+			continue;
+		}
+
+		printf("%-56s %12.4f %12.4f %+8.1f%%  %s\n", entry.first.c_str(), baseMedian, newMedian, percent, verdict);
+	}
+
+	for (const auto &entry : newMetrics)
+		if (!baseMetrics.count(entry.first))
+			printf("%-56s only in the new results\n", entry.first.c_str());
+
+	printf("%d metrics compared: %d regressed, %d improved\n", numCompared, numRegressed, numImproved);
+	return numRegressed ? EXIT_REGRESSED : EXIT_SAME;
+}
@@ -0,0 +1,58 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#pragma once
+
+#include "JsonFwd.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A small harness for timing engine kernels, run by the benchmarks target.
+//
+// Each BenchX.cpp registers its suites with a static Bench::Register. A
+// suite builds its scene and hands the kernels to the runner, which times
+// them a number of times and writes the median (and the spread) as json, so
+// that two commits can be compared with a diff of the results. The memory
+// each suite leaves with the tagged subsystems (see core/MemoryTag.h), and
+// their peaks, are written along with the times.
+namespace Bench {
+
+	class Runner {
+	public:
+		Runner(const std::string &suite, uint32_t samples, Json &results);
+
+		// Times fn, which does items units of work per call (rays traced,
+		// systems generated...): one call to warm up, then samples calls
+		void Run(const std::string &name, uint64_t items, const std::function<void()> &fn);
+
+	private:
+		std::string m_suite;
+		uint32_t m_samples;
+		Json &m_results;
+	};
+
+	using SuiteFn = void (*)(Runner &);
+
+	struct Suite {
+		const char *name;
+		SuiteFn fn;
+		// needs the game data and the galaxy, see InitGameData() in benchmarks.cpp
+		bool needsGameData;
+	};
+
+	std::vector<Suite> &GetSuites();
+
+	struct Register {
+		Register(const char *name, SuiteFn fn, bool needsGameData = false)
+		{
+			GetSuites().push_back({ name, fn, needsGameData });
+		}
+	};
+
+	// Keeps the compiler from dropping the work whose result isn't used
+	void Consume(double value);
+
+} // namespace Bench
@@ -0,0 +1,204 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Bench.h"
+
+#include "collider/CollisionContact.h"
+#include "collider/CollisionSpace.h"
+#include "collider/Geom.h"
+#include "collider/GeomTree.h"
+#include "collider/RayTri.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+static constexpr int GRID_SIZE = 64;
+static constexpr int NUM_RAYS = 10000;
+static constexpr int NUM_GEOMS = 2000;
+static constexpr int NUM_TRIS = 1024;
+static constexpr int NUM_PACKET_RAYS = 64;
+
+// A bumpy, station-sized height field of a few thousand triangles
+static std::unique_ptr<GeomTree> MakeHeightField(std::mt19937 &rng)
+{
+	std::uniform_real_distribution<float> height(-20.0f, 20.0f);
+	std::vector<vector3f> vertices;
+	std::vector<Uint32> indices;
+	for (int y = 0; y <= GRID_SIZE; y++)
+		for (int x = 0; x <= GRID_SIZE; x++)
+			vertices.emplace_back((x - GRID_SIZE / 2) * 16.0f, height(rng), (y - GRID_SIZE / 2) * 16.0f);
+
+	for (int y = 0; y < GRID_SIZE; y++) {
+		for (int x = 0; x < GRID_SIZE; x++) {
+			const Uint32 v = y * (GRID_SIZE + 1) + x;
+			indices.insert(indices.end(), { v, v + GRID_SIZE + 1, v + 1 });
+			indices.insert(indices.end(), { v + 1, v + GRID_SIZE + 1, v + GRID_SIZE + 2 });
+		}
+	}
+	const std::vector<Uint32> triFlags(indices.size() / 3, 0);
+	return std::make_unique<GeomTree>(int(vertices.size()), int(triFlags.size()), vertices, indices, triFlags);
+}
+
+// A closed box with the given half extents
+static std::unique_ptr<GeomTree> MakeBox(const vector3f &size)
+{
+	std::vector<vector3f> vertices;
+	for (int i = 0; i < 8; i++)
+		vertices.emplace_back(i & 1 ? size.x : -size.x, i & 2 ? size.y : -size.y, i & 4 ? size.z : -size.z);
+
+	const std::vector<Uint32> indices = {
+		0, 2, 1, 1, 2, 3, // -z
+		4, 5, 6, 5, 7, 6, // +z
+		0, 1, 4, 1, 5, 4, // -y
+		2, 6, 3, 3, 6, 7, // +y
+		0, 4, 2, 2, 4, 6, // -x
+		1, 3, 5, 3, 7, 5, // +x
+	};
+	const std::vector<Uint32> triFlags(12, 0);
+	return std::make_unique<GeomTree>(8, 12, vertices, indices, triFlags);
+}
+
+// The packet kernels against the scalar ones they replace on the paths
+// GeomTree takes: one ray through a leaf's triangles, and a packet of rays
+// against one triangle
+static void RayTriangles(Bench::Runner &runner)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> pos(-10.0f, 10.0f);
+	std::vector<vector3f> vertices;
+	for (int i = 0; i < NUM_TRIS * 2; i++)
+		vertices.emplace_back(pos(rng), pos(rng), pos(rng));
+
+	std::uniform_int_distribution<Uint32> vtx(0, Uint32(vertices.size() - 1));
+	std::vector<Uint32> indices;
+	std::vector<int> triOffsets;
+	for (int i = 0; i < NUM_TRIS; i++) {
+		triOffsets.push_back(int(indices.size()));
+		indices.insert(indices.end(), { vtx(rng), vtx(rng), vtx(rng) });
+	}
+
+	const vector3f origin = vector3f(pos(rng), pos(rng), pos(rng)) * 0.1f;
+	std::vector<vector3f> dirs;
+	for (int i = 0; i < NUM_PACKET_RAYS; i++)
+		dirs.push_back(vector3f(pos(rng), pos(rng), pos(rng)).Normalized());
+
+	for (bool packet : { true, false }) {
+		const std::string kernel = packet ? RayTri::GetKernelName() : "scalar";
+		runner.Run("RayTri::RayTriangles " + kernel, NUM_PACKET_RAYS * NUM_TRIS, [&]() {
+			isect_t isect = { -1, 1e6f };
+			for (const vector3f &dir : dirs) {
+				isect.dist = 1e6f;
+				if (packet)
+					RayTri::RayTriangles(origin, dir, vertices.data(), indices.data(), triOffsets.data(), NUM_TRIS, &isect);
+				else
+					RayTri::RayTrianglesScalar(origin, dir, vertices.data(), indices.data(), triOffsets.data(), NUM_TRIS, &isect);
+			}
+			Bench::Consume(isect.dist);
+		});
+
+		std::vector<isect_t> isects;
+		runner.Run("RayTri::RaysTriangle " + kernel, NUM_PACKET_RAYS * NUM_TRIS, [&]() {
+			isects.assign(NUM_PACKET_RAYS, isect_t{ -1, 1e6f });
+			for (int offset : triOffsets) {
+				const vector3f &a = vertices[indices[offset + 0]];
+				const vector3f &b = vertices[indices[offset + 1]];
+				const vector3f &c = vertices[indices[offset + 2]];
+				if (packet)
+					RayTri::RaysTriangle(origin, dirs.data(), NUM_PACKET_RAYS, a, b, c, offset / 3, isects.data());
+				else
+					RayTri::RaysTriangleScalar(origin, dirs.data(), NUM_PACKET_RAYS, a, b, c, offset / 3, isects.data());
+			}
+			Bench::Consume(isects[0].dist);
+		});
+	}
+}
+
+static int s_numContacts;
+
+static void CountContact(CollisionContact *)
+{
+	s_numContacts++;
+}
+
+static void Collision(Bench::Runner &runner)
+{
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<float> pos(-500.0f, 500.0f);
+
+	std::unique_ptr<GeomTree> field = MakeHeightField(rng);
+	std::vector<vector3f> starts, dirs;
+	for (int i = 0; i < NUM_RAYS; i++) {
+		starts.emplace_back(pos(rng), 100.0f, pos(rng));
+		dirs.push_back((vector3f(pos(rng), -150.0f, pos(rng)) - starts.back()).Normalized());
+	}
+
+	runner.Run("GeomTree::TraceRay", NUM_RAYS, [&]() {
+		int hits = 0;
+		for (int i = 0; i < NUM_RAYS; i++) {
+			isect_t isect = { -1, 2000.0f };
+			field->TraceRay(starts[i], dirs[i], &isect);
+			hits += isect.triIdx >= 0;
+		}
+		Bench::Consume(hits);
+	});
+
+	// many loaded meshes, so the trees no longer fit into the cache
+	{
+		std::mt19937 treeRng(12345);
+		std::vector<std::unique_ptr<GeomTree>> trees;
+		for (int i = 0; i < 16; i++)
+			trees.push_back(MakeHeightField(treeRng));
+
+		runner.Run("GeomTree::TraceRay, 16 trees", NUM_RAYS, [&]() {
+			int hits = 0;
+			for (int i = 0; i < NUM_RAYS; i++) {
+				isect_t isect = { -1, 2000.0f };
+				trees[i % trees.size()]->TraceRay(starts[i], dirs[i], &isect);
+				hits += isect.triIdx >= 0;
+			}
+			Bench::Consume(hits);
+		});
+	}
+
+	// a ship-sized box resting on the field, touching a few dozen triangles
+	std::unique_ptr<GeomTree> box = MakeBox(vector3f(30.0f, 10.0f, 30.0f));
+	int fieldData = 0, boxData = 0;
+	Geom fieldGeom(field.get(), matrix4x4d::Identity(), vector3d(0.0), &fieldData);
+	Geom boxGeom(box.get(), matrix4x4d::RotateYMatrix(0.3), vector3d(40.0, 5.0, -60.0), &boxData);
+
+	runner.Run("Geom::Collide", 100, [&]() {
+		s_numContacts = 0;
+		for (int i = 0; i < 100; i++)
+			boxGeom.Collide(&fieldGeom, &CountContact);
+		Bench::Consume(s_numContacts);
+	});
+
+	// a crowded space: the trees over the geoms are rebuilt every step
+	std::vector<std::unique_ptr<Geom>> geoms;
+	CollisionSpace space;
+	std::uniform_real_distribution<double> spread(-20000.0, 20000.0);
+	for (int i = 0; i < NUM_GEOMS; i++) {
+		geoms.push_back(std::make_unique<Geom>(box.get(), matrix4x4d::Identity(), vector3d(spread(rng), spread(rng), spread(rng)), &boxData));
+		if (i % 4 == 0)
+			space.AddStaticGeom(geoms.back().get());
+		else
+			space.AddGeom(geoms.back().get());
+	}
+
+	runner.Run("CollisionSpace::RebuildObjectTrees", NUM_GEOMS, [&]() {
+		space.FlagRebuildObjectTrees();
+		space.RebuildObjectTrees();
+	});
+
+	runner.Run("CollisionSpace::Collide", NUM_GEOMS, [&]() {
+		s_numContacts = 0;
+		space.FlagRebuildObjectTrees();
+		space.Collide(&CountContact);
+		Bench::Consume(s_numContacts);
+	});
+
+	RayTriangles(runner);
+}
+
+static Bench::Register s_collision("Collision", &Collision);
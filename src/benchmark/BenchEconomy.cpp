@@ -0,0 +1,42 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Bench.h"
+
+#include "galaxy/MarketTable.h"
+
+#include <random>
+#include <vector>
+
+using namespace GalacticEconomy;
+
+static constexpr int NUM_MARKETS = 5000;
+static constexpr int NUM_COMMODITIES = 40;
+
+static void Economy(Bench::Runner &runner)
+{
+	// trade levels in the range the system generator produces
+	std::mt19937 rng(13579);
+	std::uniform_real_distribution<float> price(1.0f, 500.0f);
+	std::uniform_int_distribution<int> level(-30, 30);
+
+	std::vector<float> basePrices = { 0.0f };
+	for (int i = 1; i <= NUM_COMMODITIES; i++)
+		basePrices.push_back(price(rng));
+
+	MarketTable table(basePrices);
+	for (int m = 0; m < NUM_MARKETS; m++) {
+		const size_t market = table.AddMarket();
+		for (CommodityId c = 1; c <= NUM_COMMODITIES; c++) {
+			table.SetTradeLevel(c, market, level(rng));
+			table.SetLegal(c, market, rng() % 8 != 0);
+		}
+	}
+
+	runner.Run("MarketTable::Update", NUM_MARKETS * NUM_COMMODITIES, [&]() {
+		table.Update();
+		Bench::Consume(table.GetPrices(1)[0]);
+	});
+}
+
+static Bench::Register s_economy("Economy", &Economy);
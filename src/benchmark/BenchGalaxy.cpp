@@ -0,0 +1,81 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Bench.h"
+
+#include "galaxy/Galaxy.h"
+#include "galaxy/GalaxyCache.h"
+#include "galaxy/GalaxyGenerator.h"
+#include "galaxy/Sector.h"
+#include "galaxy/StarSystem.h"
+#include "terrain/Terrain.h"
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr int SECTOR_RADIUS = 2;
+static constexpr int NUM_POINTS = 4096;
+
+static void GalaxyGeneration(Bench::Runner &runner)
+{
+	RefCountedPtr<Galaxy> galaxy = GalaxyGenerator::Create();
+	RefCountedPtr<GalaxyGenerator> generator = galaxy->GetGenerator();
+
+	// the block of sectors about Sol, generated without the caches so that
+	// every sample pays for the full generation
+	std::vector<SystemPath> sectorPaths;
+	for (int x = -SECTOR_RADIUS; x <= SECTOR_RADIUS; x++)
+		for (int y = -SECTOR_RADIUS; y <= SECTOR_RADIUS; y++)
+			for (int z = -SECTOR_RADIUS; z <= SECTOR_RADIUS; z++)
+				sectorPaths.emplace_back(x, y, z);
+
+	std::vector<RefCountedPtr<Sector>> sectors;
+	runner.Run("Sector generation", sectorPaths.size(), [&]() {
+		sectors.clear();
+		for (const SystemPath &path : sectorPaths)
+			sectors.push_back(generator->Generate<Sector, SectorCache>(galaxy, path, nullptr));
+	});
+
+	std::vector<SystemPath> systemPaths;
+	for (const RefCountedPtr<Sector> &sector : sectors)
+		for (const Sector::System &system : sector->m_systems)
+			systemPaths.push_back(system.GetPath());
+
+	std::vector<RefCountedPtr<StarSystem>> systems;
+	runner.Run("StarSystem generation", systemPaths.size(), [&]() {
+		systems.clear();
+		for (const SystemPath &path : systemPaths)
+			systems.push_back(generator->Generate<StarSystem, StarSystemCache>(galaxy, path, nullptr, GalaxyDetail::FULL));
+	});
+
+	// one terrain for each height fractal found in the systems; heightmap
+	// terrains are left out, they read their maps from disk
+	std::map<std::string, RefCountedPtr<Terrain>> terrains;
+	for (const RefCountedPtr<StarSystem> &system : systems) {
+		for (const RefCountedPtr<SystemBody> &body : system->GetBodies()) {
+			if (body->GetSuperType() < SystemBody::SUPERTYPE_STAR || body->GetSuperType() > SystemBody::SUPERTYPE_GAS_GIANT || !body->GetHeightMapFilename().empty())
+				continue;
+			RefCountedPtr<Terrain> terrain(Terrain::InstanceTerrain(body.Get()));
+			terrains.emplace(terrain->GetHeightFractalName(), terrain);
+		}
+	}
+
+	std::mt19937 rng(86420);
+	std::uniform_real_distribution<double> unit(-1.0, 1.0);
+	std::vector<vector3d> points;
+	for (int i = 0; i < NUM_POINTS; i++)
+		points.push_back(vector3d(unit(rng), unit(rng), unit(rng)).NormalizedSafe());
+
+	std::vector<double> heights(NUM_POINTS);
+	for (const auto &entry : terrains) {
+		const Terrain *terrain = entry.second.Get();
+		runner.Run(std::string("Terrain::GetHeights ") + entry.first, NUM_POINTS, [&]() {
+			terrain->GetHeights(points.data(), heights.data(), NUM_POINTS);
+			Bench::Consume(heights[0]);
+		});
+	}
+}
+
+static Bench::Register s_galaxy("Galaxy", &GalaxyGeneration, true);
@@ -0,0 +1,61 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Bench.h"
+
+#include "galaxy/JumpGraph.h"
+#include "galaxy/Sector.h"
+
+#include <random>
+#include <vector>
+
+static constexpr int NUM_SECTORS = 24; // along x; a slab 4 sectors thick
+static constexpr int SYSTEMS_PER_SECTOR = 4;
+static constexpr float JUMP_RANGE = 9.0f;
+
+static void AddSectors(JumpGraph &graph, const std::vector<vector3f> &positions)
+{
+	auto pos = positions.begin();
+	for (int x = 0; x < NUM_SECTORS; x++)
+		for (int y = 0; y < 4; y++)
+			for (int z = 0; z < 4; z++, pos += SYSTEMS_PER_SECTOR)
+				graph.AddSector(SystemPath(x, y, z), std::vector<vector3f>(pos, pos + SYSTEMS_PER_SECTOR));
+}
+
+static void JumpGraphs(Bench::Runner &runner)
+{
+	// a hyperdrive whose jumps take longer the further they go
+	JumpCost cost;
+	cost.range = JUMP_RANGE;
+	for (int i = 0; i <= 64; i++) {
+		const float d = JUMP_RANGE * i / 64;
+		cost.durations.push_back(1.0f + d * d);
+	}
+
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> sectorPos(0.0f, Sector::SIZE);
+	std::vector<vector3f> positions;
+	for (int i = 0; i < NUM_SECTORS * 16 * SYSTEMS_PER_SECTOR; i++)
+		positions.emplace_back(sectorPos(rng), sectorPos(rng), sectorPos(rng));
+
+	// a route across the whole slab takes dozens of jumps; the first search
+	// also works out the edges of every system it visits
+	const SystemPath start(0, 0, 0, 0), target(NUM_SECTORS - 1, 3, 3, 0);
+	std::vector<SystemPath> route;
+	runner.Run("JumpGraph::FindRoute first", 1, [&]() {
+		JumpGraph graph(JUMP_RANGE);
+		AddSectors(graph, positions);
+		graph.FindRoute(start, target, cost, route);
+		Bench::Consume(route.size());
+	});
+
+	JumpGraph graph(JUMP_RANGE);
+	AddSectors(graph, positions);
+	graph.FindRoute(start, target, cost, route);
+	runner.Run("JumpGraph::FindRoute cached", 1, [&]() {
+		graph.FindRoute(start, target, cost, route);
+		Bench::Consume(route.size());
+	});
+}
+
+static Bench::Register s_jumpGraph("JumpGraph", &JumpGraphs);
@@ -0,0 +1,65 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Bench.h"
+
+#include "terrain/FracDef.h"
+#include "terrain/TerrainNoise.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace TerrainNoise;
+
+static constexpr size_t NUM_POINTS = 1000;
+
+static void Noise(Bench::Runner &runner)
+{
+	std::mt19937 rng(97531);
+	std::uniform_real_distribution<double> unit(-1.0, 1.0);
+	std::vector<vector3d> points;
+	for (size_t i = 0; i < NUM_POINTS; i++)
+		points.push_back(vector3d(unit(rng), unit(rng), unit(rng)).Normalized());
+
+	fracdef_t def;
+	def.frequency = 600.0;
+	def.lacunarity = 2.0;
+	def.octaves = 8;
+
+	// the batched octave noise against a loop over the per-point version
+	std::vector<double> out(NUM_POINTS);
+	runner.Run("TerrainNoise::octavenoise batched", NUM_POINTS, [&]() {
+		octavenoise(def, 0.5, points.data(), out.data(), NUM_POINTS);
+		Bench::Consume(out[0]);
+	});
+
+	runner.Run("TerrainNoise::octavenoise", NUM_POINTS, [&]() {
+		for (size_t i = 0; i < NUM_POINTS; i++)
+			out[i] = octavenoise(def, 0.5, points[i]);
+		Bench::Consume(out[0]);
+	});
+
+	// the unrolled octave sums against the runtime loop they replace
+	for (int octaves : { 4, 8, 12 }) {
+		fracdef_t octaveDef = def;
+		octaveDef.octaves = octaves;
+		const std::string suffix = " " + std::to_string(octaves) + " octaves";
+
+		runner.Run("TerrainNoise::octave_sum" + suffix, NUM_POINTS, [&]() {
+			double sum = 0.0;
+			for (size_t i = 0; i < NUM_POINTS; i++)
+				sum += detail::octave_sum<false>(octaveDef, 0.5, points[i]);
+			Bench::Consume(sum);
+		});
+
+		runner.Run("TerrainNoise::octave_sum_any" + suffix, NUM_POINTS, [&]() {
+			double sum = 0.0;
+			for (size_t i = 0; i < NUM_POINTS; i++)
+				sum += detail::octave_sum_any<false>(octaveDef, 0.5, points[i]);
+			Bench::Consume(sum);
+		});
+	}
+}
+
+static Bench::Register s_noise("Noise", &Noise);
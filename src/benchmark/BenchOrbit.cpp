@@ -0,0 +1,70 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Bench.h"
+
+#include "Orbit.h"
+#include "gameconsts.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+static constexpr int NUM_ORBITS = 20000;
+
+static void Orbits(Bench::Runner &runner)
+{
+	// circular to strongly eccentric orbits, and a few hyperbolic ones, from
+	// low orbit out to the moon
+	std::mt19937 rng(2468);
+	std::uniform_real_distribution<double> radius(7e6, 4e8);
+	std::uniform_real_distribution<double> speed(0.7, 1.5);
+	std::uniform_real_distribution<double> unit(-1.0, 1.0);
+
+	std::vector<vector3d> startPos, startVel;
+	for (int i = 0; i < NUM_ORBITS; i++) {
+		const double r = radius(rng);
+		startPos.push_back(vector3d(unit(rng), unit(rng), unit(rng)).NormalizedSafe() * r);
+		const vector3d side = startPos.back().Cross(vector3d(unit(rng), unit(rng), unit(rng))).NormalizedSafe();
+		// about the circular speed, times a factor that makes some orbits escape
+		startVel.push_back(side * speed(rng) * sqrt(G * EARTH_MASS / r));
+	}
+
+	std::vector<Orbit> orbits(NUM_ORBITS);
+	runner.Run("Orbit::FromBodyState", NUM_ORBITS, [&]() {
+		for (int i = 0; i < NUM_ORBITS; i++)
+			orbits[i] = Orbit::FromBodyState(startPos[i], startVel[i], EARTH_MASS);
+		Bench::Consume(orbits[0].GetEccentricity());
+	});
+
+	std::vector<const Orbit *> orbitPtrs;
+	for (const Orbit &orbit : orbits)
+		orbitPtrs.push_back(&orbit);
+
+	runner.Run("Orbit::OrbitalPosAtTime", NUM_ORBITS, [&]() {
+		double sum = 0.0;
+		for (int i = 0; i < NUM_ORBITS; i++)
+			sum += orbits[i].OrbitalPosAtTime(1e4 + i).x;
+		Bench::Consume(sum);
+	});
+
+	std::vector<vector3d> pos(NUM_ORBITS), vel(NUM_ORBITS);
+	runner.Run("Orbit::OrbitalStatesAtTime", NUM_ORBITS, [&]() {
+		Orbit::OrbitalStatesAtTime(orbitPtrs.data(), orbitPtrs.size(), 1e4, pos.data(), vel.data(), nullptr);
+		Bench::Consume(pos[0].x);
+	});
+
+	runner.Run("Orbit::SolveLambert", NUM_ORBITS, [&]() {
+		double sum = 0.0;
+		for (int i = 0; i < NUM_ORBITS; i++) {
+			const vector3d r1 = orbits[i].OrbitalPosAtTime(0.0);
+			const vector3d r2 = orbits[(i + 7) % NUM_ORBITS].OrbitalPosAtTime(0.0);
+			vector3d v1, v2;
+			if (Orbit::SolveLambert(r1, r2, 86400.0, EARTH_MASS, r1.Cross(r2).NormalizedSafe(), v1, v2))
+				sum += v1.x;
+		}
+		Bench::Consume(sum);
+	});
+}
+
+static Bench::Register s_orbits("Orbit", &Orbits);
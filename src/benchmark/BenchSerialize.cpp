@@ -0,0 +1,134 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Bench.h"
+
+#include "Json.h"
+#include "JsonUtils.h"
+#include "core/JsonArena.h"
+#include "lua/Lua.h"
+#include "lua/LuaManager.h"
+#include "lua/LuaSerializer.h"
+#include "lua/LuaUtils.h"
+#include "utils.h"
+
+#include <random>
+#include <string>
+
+static constexpr int NUM_BODIES = 5000;
+
+// Shaped like the space of a saved game: bodies with their frames, motion
+// and a bit of ship state each
+static Json MakeSave()
+{
+	std::mt19937 rng(97531);
+	std::uniform_real_distribution<double> pos(-1e11, 1e11);
+	std::uniform_real_distribution<double> unit(-1.0, 1.0);
+
+	Json bodies = Json::array();
+	for (int i = 0; i < NUM_BODIES; i++) {
+		Json body = Json::object();
+		body["index"] = i;
+		body["label"] = "Body " + std::to_string(i);
+		body["frame"] = i % 40;
+		VectorToJson(body["pos"], vector3d(pos(rng), pos(rng), pos(rng)));
+		VectorToJson(body["vel"], vector3d(unit(rng), unit(rng), unit(rng)) * 1e4);
+		MatrixToJson(body["orient"], matrix3x3d::RotateY(unit(rng) * M_PI) * matrix3x3d::RotateX(unit(rng) * M_PI));
+
+		Json equipment = Json::array();
+		for (int j = 0; j < 12; j++)
+			equipment.push_back({ { "slot", j }, { "id", "equipment_" + std::to_string((i + j) % 57) }, { "count", j % 3 } });
+		body["equipment"] = equipment;
+		bodies.push_back(body);
+	}
+
+	Json root = Json::object();
+	root["version"] = 90;
+	root["time"] = 1234567.0;
+	root["space"]["bodies"] = bodies;
+	return root;
+}
+
+// A data table like the ones the Lua modules save: lists of records with
+// nested tables, some shared between records
+static const char *LUA_DATA = R"(
+	local Serializer = require 'Serializer'
+
+	local factions = {}
+	for i = 1, 20 do
+		factions[i] = { name = "Faction " .. i, reputation = i * 0.5, allies = {} }
+	end
+
+	local data = { missions = {}, crew = {} }
+	for i = 1, 5000 do
+		local cargo = {}
+		for j = 1, 12 do
+			cargo[j] = { commodity = "commodity_" .. ((i + j) % 40), amount = j * 3, price = i * 0.01 + j }
+		end
+		data.missions[i] = {
+			id = i,
+			title = "Deliver cargo to system " .. (i % 300),
+			reward = i * 12.5,
+			due = 1234567.0 + i * 3600,
+			urgent = (i % 7 == 0),
+			faction = factions[i % 20 + 1],
+			cargo = cargo,
+		}
+	end
+
+	Serializer:Register("Benchmark", function() return data end, function(loaded) end)
+)";
+
+static void Serialize(Bench::Runner &runner)
+{
+	runner.Run("Build save tree", NUM_BODIES, [&]() {
+		const Json built = MakeSave();
+		Bench::Consume(built.size());
+	});
+
+	runner.Run("Build save tree (JsonArena)", NUM_BODIES, [&]() {
+		JsonArena arena;
+		JsonArena::Scope scope(arena);
+		const Json built = MakeSave();
+		Bench::Consume(built.size());
+	});
+
+	const Json save = MakeSave();
+	std::string encoded;
+	runner.Run("JsonUtils::EncodeSaveData", NUM_BODIES, [&]() {
+		encoded = JsonUtils::EncodeSaveData(save);
+		Bench::Consume(encoded.size());
+	});
+
+	runner.Run("JsonUtils::ParseSaveData", NUM_BODIES, [&]() {
+		const Json loaded = JsonUtils::ParseSaveData(encoded);
+		Bench::Consume(loaded.size());
+	});
+
+	// the serializer is used the way Pi sets it up for a game
+	lua_State *l = Lua::manager->GetLuaState();
+	LuaObject<LuaSerializer>::RegisterClass();
+	LuaSerializer serializer;
+	serializer.InitTableRefs();
+
+	if (luaL_loadbuffer(l, LUA_DATA, strlen(LUA_DATA), "BenchSerialize") != LUA_OK) {
+		Output("BenchSerialize: %s\n", lua_tostring(l, -1));
+		lua_pop(l, 1);
+		return;
+	}
+	pi_lua_protected_call(l, 0, 0);
+
+	Json pickled;
+	runner.Run("LuaSerializer::ToJson", 5000, [&]() {
+		pickled = Json::object();
+		serializer.ToJson(pickled);
+	});
+
+	runner.Run("LuaSerializer::FromJson", 5000, [&]() {
+		serializer.FromJson(pickled);
+	});
+
+	serializer.UninitTableRefs();
+}
+
+static Bench::Register s_serialize("Serialize", &Serialize);
@@ -0,0 +1,58 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Bench.h"
+
+#include "SpatialGrid.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr uint32_t NUM_OBJECTS = 2000;
+static constexpr uint32_t NUM_QUERIES = 2000;
+static constexpr uint32_t NUM_CLUSTERS = 8;
+static constexpr double CELL_SIZE = 1000.0;
+static constexpr uint32_t NUM_LEVELS = 6;
+
+static void SpatialGrids(Bench::Runner &runner)
+{
+	// traffic around a few stations spread over a star system
+	std::mt19937 rng(1357);
+	std::uniform_real_distribution<double> system(-1e12, 1e12);
+	std::normal_distribution<double> traffic(0.0, 20000.0);
+	std::uniform_int_distribution<uint32_t> cluster(0, NUM_CLUSTERS - 1);
+
+	std::vector<vector3d> centers;
+	for (uint32_t i = 0; i < NUM_CLUSTERS; i++)
+		centers.emplace_back(system(rng), system(rng), system(rng) * 0.01);
+
+	std::vector<vector3d> positions;
+	for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+		positions.push_back(centers[cluster(rng)] + vector3d(traffic(rng), traffic(rng), traffic(rng)));
+
+	SpatialGrid<uint32_t> grid(CELL_SIZE, NUM_LEVELS);
+	runner.Run("SpatialGrid::Build", NUM_OBJECTS, [&]() {
+		grid.Clear();
+		for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+			grid.Add(positions[i], i);
+		grid.Build();
+		Bench::Consume(grid.GetNumCells(0));
+	});
+
+	// the ranges used by missiles, ECM, docking traffic and sensors
+	std::vector<uint32_t> found;
+	for (double range : { 100.0, 2000.0, 4000.0, 20000.0, 100000.0 }) {
+		runner.Run("SpatialGrid::Query " + std::to_string(int(range)) + "m", NUM_QUERIES, [&]() {
+			size_t numFound = 0;
+			for (uint32_t q = 0; q < NUM_QUERIES; q++) {
+				found.clear();
+				grid.Query(positions[q % NUM_OBJECTS], range, found);
+				numFound += found.size();
+			}
+			Bench::Consume(numFound);
+		});
+	}
+}
+
+static Bench::Register s_spatialGrid("SpatialGrid", &SpatialGrids);
@@ -0,0 +1,65 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Bench.h"
+
+#include "core/TaskGraph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+static constexpr uint32_t NUM_TASKS = 4096;
+
+// Tasks that do next to nothing, so what is timed is the cost of queueing,
+// running and completing them
+class EmptyTask : public Task {
+public:
+	EmptyTask(std::atomic<uint32_t> &count) :
+		m_count(count) {}
+
+	void OnExecute(TaskRange) override { m_count.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint32_t> &m_count;
+};
+
+static void TaskGraphs(Bench::Runner &runner)
+{
+	std::unique_ptr<TaskGraph> graph(new TaskGraph());
+	graph->SetWorkerThreads(std::max(std::thread::hardware_concurrency(), 2U) - 1);
+	std::atomic<uint32_t> count(0);
+
+	runner.Run("TaskSet of tasks", NUM_TASKS, [&]() {
+		TaskSet *set = new TaskSet();
+		for (uint32_t i = 0; i < NUM_TASKS; i++)
+			set->AddTask(new EmptyTask(count));
+		TaskSet::Handle handle = graph->QueueTaskSet(set);
+		graph->WaitForTaskSet(handle);
+	});
+
+	// one task split in ranges of a single item, as the parallel loops do
+	runner.Run("TaskSet of a range", NUM_TASKS, [&]() {
+		TaskSet *set = new TaskSet();
+		set->AddTaskRangeLambda({ 0, NUM_TASKS }, 1, [&count](TaskRange range) {
+			count.fetch_add(range.end - range.begin, std::memory_order_relaxed);
+		});
+		TaskSet::Handle handle = graph->QueueTaskSet(set);
+		graph->WaitForTaskSet(handle);
+	});
+
+	// the latency of a round trip through the workers, one small set at a time
+	runner.Run("TaskSet round trip", 256, [&]() {
+		for (int i = 0; i < 256; i++) {
+			TaskSet *set = new TaskSet();
+			set->AddTask(new EmptyTask(count));
+			TaskSet::Handle handle = graph->QueueTaskSet(set);
+			graph->WaitForTaskSet(handle);
+		}
+	});
+
+	Bench::Consume(count.load());
+}
+
+static Bench::Register s_taskGraph("TaskGraph", &TaskGraphs);
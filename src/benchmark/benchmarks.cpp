@@ -0,0 +1,181 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Bench.h"
+
+#include "FileSystem.h"
+#include "GameConfig.h"
+#include "Json.h"
+#include "Pi.h"
+#include "buildopts.h"
+#include "core/MemoryTag.h"
+#include "galaxy/Economy.h"
+#include "galaxy/Galaxy.h"
+#include "galaxy/GalaxyGenerator.h"
+#include "lua/Lua.h"
+#include "lua/LuaNameGen.h"
+#include "profiler/Profiler.h"
+#include "utils.h"
+
+#include "argh/argh.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace Bench {
+
+	std::vector<Suite> &GetSuites()
+	{
+		static std::vector<Suite> s_suites;
+		return s_suites;
+	}
+
+	static volatile double s_sink;
+
+	void Consume(double value)
+	{
+		s_sink = s_sink + value;
+	}
+
+	Runner::Runner(const std::string &suite, uint32_t samples, Json &results) :
+		m_suite(suite),
+		m_samples(std::max(samples, 1U)),
+		m_results(results)
+	{}
+
+	void Runner::Run(const std::string &name, uint64_t items, const std::function<void()> &fn)
+	{
+		fn();
+
+		std::vector<double> times;
+		for (uint32_t i = 0; i < m_samples; i++) {
+			Profiler::Clock clock{};
+			clock.Start();
+			fn();
+			clock.Stop();
+			times.push_back(clock.milliseconds());
+		}
+		std::sort(times.begin(), times.end());
+		const double median = times[times.size() / 2];
+
+		Json result = Json::object();
+		result["suite"] = m_suite;
+		result["name"] = name;
+		result["items"] = items;
+		result["samples"] = times.size();
+		result["minMs"] = times.front();
+		result["medianMs"] = median;
+		result["maxMs"] = times.back();
+		result["nsPerItem"] = items ? median * 1e6 / items : 0.0;
+		// every sample, for benchcompare to tell noise from a regression
+		result["timesMs"] = times;
+		m_results.push_back(result);
+
+		Output("%-16s %-40s %12.4fms %12.2fns/item\n", m_suite.c_str(), name.c_str(), median, items ? median * 1e6 / items : 0.0);
+	}
+
+	// What each subsystem held at the end of the suite, and its peak during it
+	static Json MemoryUsage(const char *suite)
+	{
+		Json usage = Json::object();
+		for (int i = MemoryTag::UNTAGGED + 1; i < MemoryTag::MAX_TAGS; i++) {
+			const MemoryTag::Tag tag = MemoryTag::Tag(i);
+			const MemoryTag::Stats stats = MemoryTag::GetStats(tag);
+			if (!stats.highWater)
+				continue;
+
+			usage[MemoryTag::GetName(tag)] = { { "bytes", stats.bytes }, { "highWaterBytes", stats.highWater } };
+			Output("%-16s %-40s %12.3fMB %12.3fMB peak\n", suite, (std::string("memory: ") + MemoryTag::GetName(tag)).c_str(),
+				stats.bytes / (1024.0 * 1024.0), stats.highWater / (1024.0 * 1024.0));
+		}
+		return usage;
+	}
+
+} // namespace Bench
+
+// What the galaxy and the terrains need from the game, short of starting it:
+// the config, the name generator and the economy
+static bool InitGameData()
+{
+	if (!FileSystem::gameDataFiles.Lookup("galaxy_dense.bmp").IsFile()) {
+		Output("game data not found in %s, skipping the suites that need it\n", FileSystem::GetDataDir().c_str());
+		return false;
+	}
+
+	Pi::config = new GameConfig();
+	Pi::luaNameGen = new LuaNameGen(Lua::manager);
+	GalacticEconomy::Init();
+	GalaxyGenerator::Init();
+	return true;
+}
+
+extern "C" int main(int argc, char **argv)
+{
+	argh::parser cmdline(argc, argv);
+
+	if (cmdline[{ "-h", "--help" }]) {
+		Output(
+			"usage: benchmarks [options...]\n"
+			"    -o, --output file   write the results to file (default benchmarks.json, - for stdout)\n"
+			"    -f, --filter name   only run the suites whose name contains name\n"
+			"    -s, --samples n     time each kernel n times (default 10)\n"
+			"    -l, --list          list the suites\n");
+		return 0;
+	}
+
+	std::vector<Bench::Suite> suites = Bench::GetSuites();
+	std::sort(suites.begin(), suites.end(), [](const Bench::Suite &a, const Bench::Suite &b) {
+		return strcmp(a.name, b.name) < 0;
+	});
+
+	if (cmdline[{ "-l", "--list" }]) {
+		for (const Bench::Suite &suite : suites)
+			Output("%s%s\n", suite.name, suite.needsGameData ? " (needs game data)" : "");
+		return 0;
+	}
+
+	std::string output, filter;
+	uint32_t samples;
+	cmdline({ "-o", "--output" }, "benchmarks.json") >> output;
+	cmdline({ "-f", "--filter" }, "") >> filter;
+	cmdline({ "-s", "--samples" }, 10) >> samples;
+
+	FileSystem::Init();
+	FileSystem::userFiles.MakeDirectory(""); // ensure the config directory exists
+	Lua::Init();
+
+	bool needsGameData = false;
+	for (const Bench::Suite &suite : suites)
+		needsGameData |= suite.needsGameData && strstr(suite.name, filter.c_str());
+	const bool hasGameData = needsGameData && InitGameData();
+
+	Json root = Json::object();
+	root["version"] = PIONEER_VERSION;
+	root["extraversion"] = PIONEER_EXTRAVERSION;
+	root["results"] = Json::array();
+	root["memory"] = Json::object();
+
+	for (const Bench::Suite &suite : suites) {
+		if (!strstr(suite.name, filter.c_str()) || (suite.needsGameData && !hasGameData))
+			continue;
+		MemoryTag::ResetHighWater();
+		Bench::Runner runner(suite.name, samples, root["results"]);
+		suite.fn(runner);
+		root["memory"][suite.name] = Bench::MemoryUsage(suite.name);
+	}
+
+	const std::string text = root.dump(1, '\t');
+	FILE *file = output == "-" ? stdout : fopen(output.c_str(), "w");
+	if (!file) {
+		Output("benchmarks: could not open \"%s\" for writing: %s\n", output.c_str(), strerror(errno));
+		return 1;
+	}
+	fwrite(text.data(), 1, text.size(), file);
+	fputc('\n', file);
+	if (file != stdout)
+		fclose(file);
+
+	return 0;
+}
@@ -8,6 +8,9 @@
 #include "core/Log.h"
 #include "core/macros.h"
 #include "profiler/Profiler.h"
+#include "scenegraph/Serializer.h"
+
+#include <cmath>
 
 const int MAX_SPLITPOS_RETRIES = 15;
 
@@ -202,10 +205,152 @@ double BVHTree::CalculateSAH() const
 
 // ===================================================================
 
+// Round a double-precision bound outwards to the nearest float
+static float RoundDown(double v)
+{
+	const float f = float(v);
+	return f > v ? std::nextafter(f, -FLT_MAX) : f;
+}
+
+static float RoundUp(double v)
+{
+	const float f = float(v);
+	return f < v ? std::nextafter(f, FLT_MAX) : f;
+}
+
+CompactBVHTree::CompactBVHTree() :
+	m_objects(1, 0),
+	m_rootBounds{ vector3f(0.0f), vector3f(0.0f) },
+	m_root(LEAF_BIT)
+{
+}
+
+CompactBVHTree::CompactBVHTree(BVHTree &tree)
+{
+	PROFILE_SCOPED()
+	BVHNode *root = tree.GetRoot();
+	for (int axis = 0; axis < 3; axis++) {
+		m_rootBounds.min[axis] = RoundDown(root->aabb.min[axis]);
+		m_rootBounds.max[axis] = RoundUp(root->aabb.max[axis]);
+	}
+
+	// a full binary tree has one inner node less than it has leaves
+	m_nodes.reserve(tree.GetNumNodes() / 2);
+
+	if (root->IsLeaf()) {
+		m_root = AddLeaf(root);
+	} else {
+		m_root = 0;
+		m_nodes.emplace_back();
+		BuildNode(0, root, m_rootBounds);
+	}
+}
+
+CompactBVHTree::CompactBVHTree(Serializer::Reader &rd)
+{
+	PROFILE_SCOPED()
+	m_root = rd.Int32();
+	rd >> m_rootBounds.min >> m_rootBounds.max;
+	rd.Array(m_nodes);
+	rd.Array(m_objects);
+}
+
+void CompactBVHTree::Save(Serializer::Writer &wr) const
+{
+	PROFILE_SCOPED()
+	wr.Int32(m_root);
+	wr << m_rootBounds.min << m_rootBounds.max;
+	wr.Array(m_nodes);
+	wr.Array(m_objects);
+}
+
+void CompactBVHTree::BuildNode(uint32_t index, BVHNode *node, const AABBf &bounds)
+{
+	QuantizeChild(m_nodes[index], 0, bounds, node->kids[0]->aabb);
+	QuantizeChild(m_nodes[index], 1, bounds, node->kids[1]->aabb);
+
+	AABBf kidBounds[2];
+	GetChildBounds(m_nodes[index], bounds, kidBounds);
+
+	// allocate both children before descending so siblings stay adjacent
+	uint32_t kids[2];
+	for (int i = 0; i < 2; i++) {
+		if (node->kids[i]->IsLeaf()) {
+			kids[i] = AddLeaf(node->kids[i]);
+		} else {
+			kids[i] = m_nodes.size();
+			m_nodes.emplace_back();
+		}
+	}
+
+	m_nodes[index].kids[0] = kids[0];
+	m_nodes[index].kids[1] = kids[1];
+
+	for (int i = 0; i < 2; i++) {
+		if (!IsLeaf(kids[i]))
+			BuildNode(kids[i], node->kids[i], kidBounds[i]);
+	}
+}
+
+uint32_t CompactBVHTree::AddLeaf(BVHNode *node)
+{
+	const uint32_t ref = LEAF_BIT | uint32_t(m_objects.size());
+	m_objects.push_back(node->numTris);
+	m_objects.insert(m_objects.end(), node->triIndicesStart, node->triIndicesStart + node->numTris);
+	return ref;
+}
+
+void CompactBVHTree::QuantizeChild(Node &node, int child, const AABBf &bounds, const Aabb &childAabb)
+{
+	uint16_t *q = node.bounds[child];
+	for (int axis = 0; axis < 3; axis++) {
+		const double extent = bounds.max[axis] - bounds.min[axis];
+		if (extent <= 0.0) {
+			q[axis] = 0;
+			q[axis + 3] = 65535;
+			continue;
+		}
+
+		const double lo = std::floor((childAabb.min[axis] - bounds.min[axis]) / extent * 65535.0);
+		const double hi = std::ceil((childAabb.max[axis] - bounds.min[axis]) / extent * 65535.0);
+		q[axis] = uint16_t(Clamp(lo, 0.0, 65535.0));
+		q[axis + 3] = uint16_t(Clamp(hi, 0.0, 65535.0));
+	}
+
+	// Decoding happens in single precision, so widen any bound which would
+	// not contain the original child after the roundtrip.
+	for (bool grown = true; grown;) {
+		AABBf kidBounds[2];
+		GetChildBounds(node, bounds, kidBounds);
+
+		grown = false;
+		for (int axis = 0; axis < 3; axis++) {
+			if (kidBounds[child].min[axis] > childAabb.min[axis] && q[axis] > 0) {
+				q[axis]--;
+				grown = true;
+			}
+			if (kidBounds[child].max[axis] < childAabb.max[axis] && q[axis + 3] < 65535) {
+				q[axis + 3]++;
+				grown = true;
+			}
+		}
+	}
+}
+
+// ===================================================================
+
+static double SurfaceArea(const AABBd &aabb)
+{
+	const vector3d size = aabb.max - aabb.min;
+	return 2.0 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
 SingleBVHTree::SingleBVHTree() :
 	m_treeHeight(0),
 	m_boundsCenter(0.0, 0.0, 0.0),
-	m_inv_scale_factor(1.0)
+	m_inv_scale_factor(1.0),
+	m_buildArea(0.0),
+	m_area(0.0)
 {
 	Clear();
 }
@@ -213,6 +358,7 @@ SingleBVHTree::SingleBVHTree() :
 void SingleBVHTree::Clear()
 {
 	m_nodes.clear();
+	m_buildArea = m_area = 0.0;
 
 	// Build a default / invalid node for this BVHTree
 	AABBd aabb = AABBd::Invalid();
@@ -245,6 +391,32 @@ void SingleBVHTree::Build(const AABBd &bounds, AABBd *objAabbs, uint32_t numObjs
 	}
 
 	BuildNode(&m_nodes.emplace_back(), sortKeys.data(), numObjs, objAabbs, 0);
+
+	m_buildArea = 0.0;
+	for (const Node &node : m_nodes)
+		m_buildArea += SurfaceArea(node.aabb);
+	m_area = m_buildArea;
+}
+
+void SingleBVHTree::Refit(const AABBd *objAabbs)
+{
+	PROFILE_SCOPED()
+
+	// child nodes are always allocated after their parent, so walking the
+	// node array backwards visits both kids before the parent
+	m_area = 0.0;
+	for (size_t idx = m_nodes.size(); idx-- > 0;) {
+		Node &node = m_nodes[idx];
+
+		if (node.kids[0] == 0) {
+			node.aabb = objAabbs[node.leafIndex];
+		} else {
+			node.aabb = m_nodes[node.kids[0]].aabb;
+			node.aabb.Update(m_nodes[node.kids[1]].aabb);
+		}
+
+		m_area += SurfaceArea(node.aabb);
+	}
 }
 
 void SingleBVHTree::BuildNode(Node *node, SortKey *keys, uint32_t numKeys, AABBd *objAabbs, uint32_t height)
@@ -348,7 +520,7 @@ void SingleBVHTree::ComputeOverlap(uint32_t nodeId, const AABBd &nodeAabb, std::
 	}
 }
 
-void SingleBVHTree::TraceRay(const vector3d &start, const vector3d &inv_dir, double len, std::vector<uint32_t> &out_isect) const
+void SingleBVHTree::TraceRay(const vector3d &start, const vector3d &inv_dir, double len, std::vector<uint32_t> &out_isect, double margin) const
 {
 	PROFILE_SCOPED()
 
@@ -361,8 +533,13 @@ void SingleBVHTree::TraceRay(const vector3d &start, const vector3d &inv_dir, dou
 		const SingleBVHTree::Node *node = &m_nodes[nodeIdx];
 
 		// Didn't intersect with the node, ignore it
-		if (!node->aabb.IntersectsRay(start, inv_dir, len))
+		if (margin > 0.0) {
+			const AABBd aabb{ node->aabb.min - margin, node->aabb.max + margin };
+			if (!aabb.IntersectsRay(start, inv_dir, len))
+				continue;
+		} else if (!node->aabb.IntersectsRay(start, inv_dir, len)) {
 			continue;
+		}
 
 		// Leaf node - mark intersection and continue
 		if (node->kids[0] == 0) {
@@ -375,6 +552,59 @@ void SingleBVHTree::TraceRay(const vector3d &start, const vector3d &inv_dir, dou
 	}
 }
 
+void SingleBVHTree::TraceRays(uint32_t numRays, const uint32_t *rayIdx, const vector3d *starts, const vector3d *inv_dirs, const double *lens,
+	std::vector<std::pair<uint32_t, uint32_t>> &out_isect) const
+{
+	PROFILE_SCOPED()
+
+	struct StackEntry {
+		uint32_t node;
+		// range of the rays to test against this node in activeRays
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	if (!numRays)
+		return;
+
+	// each node filters its parent's rays into a new range; both kids of a
+	// node share the same range
+	std::vector<uint32_t> activeRays(rayIdx, rayIdx + numRays);
+	activeRays.reserve(numRays * 4);
+
+	int32_t stackLevel = 0;
+	StackEntry *stack = stackalloc(StackEntry, m_treeHeight + 1);
+	stack[stackLevel++] = { 0, 0, numRays };
+
+	while (stackLevel > 0) {
+		const StackEntry entry = stack[--stackLevel];
+		const SingleBVHTree::Node *node = &m_nodes[entry.node];
+
+		const uint32_t offset = activeRays.size();
+		for (uint32_t idx = entry.offset; idx < entry.offset + entry.count; idx++) {
+			const uint32_t ray = activeRays[idx];
+			if (node->aabb.IntersectsRay(starts[ray], inv_dirs[ray], lens[ray]))
+				activeRays.push_back(ray);
+		}
+
+		const uint32_t count = activeRays.size() - offset;
+		if (!count)
+			continue;
+
+		// Leaf node - mark intersection for every ray that reached it
+		if (node->kids[0] == 0) {
+			for (uint32_t idx = offset; idx < offset + count; idx++)
+				out_isect.push_back({ activeRays[idx], node->leafIndex });
+
+			activeRays.resize(offset);
+			continue;
+		}
+
+		stack[stackLevel++] = { node->kids[1], offset, count };
+		stack[stackLevel++] = { node->kids[0], offset, count };
+	}
+}
+
 double SingleBVHTree::CalculateSAH() const
 {
 	double outSAH = 0.0;
@@ -6,8 +6,14 @@
 
 #include "../Aabb.h"
 #include "../vector3.h"
+#include <cstdint>
 #include <vector>
 
+namespace Serializer {
+	class Reader;
+	class Writer;
+} // namespace Serializer
+
 struct BVHNode {
 	Aabb aabb;
 
@@ -61,6 +67,68 @@ private:
 	size_t m_nodeAllocMax;
 };
 
+/*
+ * Read-only, cache-friendly copy of a BVHTree.
+ *
+ * Each 32-byte node stores the bounds of both of its children, quantized to
+ * 16 bits relative to the node's own bounds. Traversal therefore decodes the
+ * bounds of a child from its parent and never has to fetch a node only to
+ * reject it. Children are referenced either by node index or, with LEAF_BIT
+ * set, by an offset into the object list where the leaf's object count is
+ * stored right before its objects.
+ */
+class CompactBVHTree {
+public:
+	static constexpr uint32_t LEAF_BIT = 0x80000000;
+
+	struct Node {
+		// quantized { min.xyz, max.xyz } of each child
+		uint16_t bounds[2][6];
+		uint32_t kids[2];
+	};
+	static_assert(sizeof(Node) == 32, "CompactBVHTree::Node should fit in 32 bytes");
+
+	CompactBVHTree();
+	explicit CompactBVHTree(BVHTree &tree);
+	explicit CompactBVHTree(Serializer::Reader &rd);
+	void Save(Serializer::Writer &wr) const;
+
+	static bool IsLeaf(uint32_t ref) { return ref & LEAF_BIT; }
+
+	uint32_t GetRoot() const { return m_root; }
+	const AABBf &GetRootBounds() const { return m_rootBounds; }
+	const Node &GetNode(uint32_t ref) const { return m_nodes[ref]; }
+
+	// Number of objects in / pointer to the objects of the given leaf
+	int GetLeafCount(uint32_t ref) const { return m_objects[ref & ~LEAF_BIT]; }
+	const int *GetLeafObjects(uint32_t ref) const { return &m_objects[(ref & ~LEAF_BIT) + 1]; }
+
+	// Decode the bounds of both children of a node with the given bounds.
+	// The decoded bounds always contain the original child bounds.
+	static void GetChildBounds(const Node &node, const AABBf &bounds, AABBf kids[2])
+	{
+		const vector3f scale = (bounds.max - bounds.min) * (1.0f / 65535.0f);
+		for (int i = 0; i < 2; i++) {
+			const uint16_t *q = node.bounds[i];
+			kids[i].min = bounds.min + vector3f(q[0] * scale.x, q[1] * scale.y, q[2] * scale.z);
+			kids[i].max = bounds.max - vector3f((65535 - q[3]) * scale.x, (65535 - q[4]) * scale.y, (65535 - q[5]) * scale.z);
+		}
+	}
+
+	size_t GetNumNodes() const { return m_nodes.size(); }
+	size_t GetMemoryUsage() const { return m_nodes.size() * sizeof(Node) + m_objects.size() * sizeof(int); }
+
+private:
+	void BuildNode(uint32_t index, BVHNode *node, const AABBf &bounds);
+	uint32_t AddLeaf(BVHNode *node);
+	void QuantizeChild(Node &node, int child, const AABBf &bounds, const Aabb &childAabb);
+
+	std::vector<Node> m_nodes;
+	std::vector<int> m_objects;
+	AABBf m_rootBounds;
+	uint32_t m_root;
+};
+
 /*
  * Single-node binary-tree Bounding Volume Hierarchy tree.
  *
@@ -83,18 +151,33 @@ public:
 	// Individual nodes will have leaf indices into this array
 	void Build(const AABBd &bounds, AABBd *objAabbs, uint32_t numObjs);
 
+	// Update the AABBs of all nodes from the given list of AABBs, keeping the
+	// existing tree structure. The list must hold the same objects in the
+	// same order as when the tree was built.
+	void Refit(const AABBd *objAabbs);
+
 	// Return a pointer to the node at the given index
 	const Node *GetNode(uint32_t index) const { return m_nodes.data() + index; }
 
 	// Compute a list of { objId, leafIndex } intersections and add it to the passed array
 	void ComputeOverlap(uint32_t objId, const AABBd &objAabb, std::vector<std::pair<uint32_t, uint32_t>> &out_isect) const;
 	// Trace a ray through this AABB and add the list of intersected leaves to the passed array
-	void TraceRay(const vector3d &start, const vector3d &inv_dir, double len, std::vector<uint32_t> &out_isect) const;
+	// A non-zero margin grows every node AABB by that distance, e.g. to cover objects moving during a step
+	void TraceRay(const vector3d &start, const vector3d &inv_dir, double len, std::vector<uint32_t> &out_isect, double margin = 0.0) const;
+	// Trace a packet of rays through this AABB in a single traversal and add a list of { rayIdx, leafIndex }
+	// intersections to the passed array. The leaves of each ray are added in the same order as TraceRay would.
+	void TraceRays(uint32_t numRays, const uint32_t *rayIdx, const vector3d *starts, const vector3d *inv_dirs, const double *lens,
+		std::vector<std::pair<uint32_t, uint32_t>> &out_isect) const;
 
 	size_t GetNumNodes() const { return m_nodes.size(); }
 	uint32_t GetHeight() const { return m_treeHeight; }
 	double CalculateSAH() const;
 
+	// Ratio of the summed surface area of all nodes to the area right after
+	// the tree was built. Refitting moving objects grows this value as the
+	// tree quality degrades.
+	double GetAreaGrowth() const { return m_buildArea > 0.0 ? m_area / m_buildArea : 1.0; }
+
 private:
 	struct SortKey {
 		vector3f center;
@@ -108,6 +191,8 @@ private:
 	uint32_t m_treeHeight;
 	vector3d m_boundsCenter;
 	double m_inv_scale_factor;
+	double m_buildArea;
+	double m_area;
 };
 
 #endif /* _BVHTREE_H */
@@ -10,16 +10,50 @@
 #include "profiler/Profiler.h"
 
 #include <algorithm>
+#include <cmath>
 
 int CollisionSpace::s_nextHandle = 1;
+bool CollisionSpace::s_contactCache = true;
+
+// Largest change in the relative rotation (matrix elements) and translation
+// (metres) of a geom pair for which last step's contacts are reused
+static constexpr double CONTACT_CACHE_ROTATION_TOLERANCE = 1e-6;
+static constexpr double CONTACT_CACHE_POSITION_TOLERANCE = 1e-4;
+
+// Contacts generated by Geom::Collide are gathered here before being cached
+// and passed on, as the collision callback carries no user data
+static thread_local std::vector<CollisionContact> *t_capturedContacts = nullptr;
+
+static void CaptureContact(CollisionContact *contact)
+{
+	t_capturedContacts->push_back(*contact);
+}
+
+static bool IsSameRelativeTransform(const matrix4x4d &a, const matrix4x4d &b)
+{
+	for (int col = 0; col < 3; col++)
+		for (int row = 0; row < 3; row++)
+			if (std::abs(a[col * 4 + row] - b[col * 4 + row]) > CONTACT_CACHE_ROTATION_TOLERANCE)
+				return false;
+
+	return (a.GetTranslate() - b.GetTranslate()).LengthSqr() <=
+		CONTACT_CACHE_POSITION_TOLERANCE * CONTACT_CACHE_POSITION_TOLERANCE;
+}
+
+// Rebuild the dynamic object tree from scratch once refitting has grown the
+// summed node surface area by this factor
+static constexpr double MAX_REFIT_AREA_GROWTH = 1.5;
 
 CollisionSpace::CollisionSpace() :
 	m_staticObjectTree(new SingleBVHTree()),
 	m_dynamicObjectTree(new SingleBVHTree()),
 	m_enabledStaticGeoms(0),
 	m_enabledDynGeoms(0),
+	m_maxGeomSpeed(0.0),
 	m_needStaticGeomRebuild(true),
-	m_duringCollision(false)
+	m_needDynamicGeomRebuild(true),
+	m_duringCollision(false),
+	m_collideStep(0)
 {
 	sphere.radius = 0;
 }
@@ -34,6 +68,7 @@ void CollisionSpace::AddGeom(Geom *geom)
 	assert(!m_duringCollision);
 
 	m_geoms.push_back(geom);
+	m_needDynamicGeomRebuild = true;
 }
 
 void CollisionSpace::RemoveGeom(Geom *geom)
@@ -48,6 +83,9 @@ void CollisionSpace::RemoveGeom(Geom *geom)
 	if (m_geoms.size() > 1)
 		std::swap(*iter, m_geoms.back());
 	m_geoms.pop_back();
+	m_needDynamicGeomRebuild = true;
+
+	EvictCachedPairs(geom);
 }
 
 void CollisionSpace::AddStaticGeom(Geom *geom)
@@ -73,6 +111,8 @@ void CollisionSpace::RemoveStaticGeom(Geom *geom)
 	if (m_staticGeoms.size() > 1)
 		std::swap(*iter, m_staticGeoms.back());
 	m_staticGeoms.pop_back();
+
+	EvictCachedPairs(geom);
 }
 
 void CollisionSpace::CollideRaySphere(const vector3d &start, const vector3d &dir, isect_t *isect)
@@ -137,20 +177,233 @@ void CollisionSpace::TraceRay(const vector3d &start, const vector3d &dir, double
 		}
 	}
 
-	{
-		isect_t isect;
-		isect.dist = float(c->distance);
-		isect.triIdx = -1;
-		CollideRaySphere(start, dir, &isect);
-		if (isect.triIdx != -1) {
-			c->pos = start + dir * double(isect.dist);
-			c->normal = vector3d(0.0);
-			c->depth = len - isect.dist;
-			c->triIdx = -1;
-			c->userData1 = sphere.userData;
-			c->userData2 = 0;
-			c->geomFlag = 0;
-			c->distance = isect.dist;
+	TraceRaySphere(start, dir, len, c);
+}
+
+void CollisionSpace::SweepRay(const vector3d &start, const vector3d &vel, double timeStep, CollisionContact *c, const Geom *ignore)
+{
+	PROFILE_SCOPED()
+	std::vector<uint32_t> isect_result;
+	isect_result.reserve(8);
+	SweepRayImpl(start, vel, timeStep, c, ignore, isect_result);
+}
+
+void CollisionSpace::SweepRays(size_t numRays, const vector3d *starts, const vector3d *vels, double timeStep, CollisionContact *out, const Geom *const *ignores)
+{
+	PROFILE_SCOPED()
+	// one list of tree hits serves all the points
+	std::vector<uint32_t> isect_result;
+	isect_result.reserve(8);
+	for (size_t idx = 0; idx < numRays; idx++) {
+		out[idx] = CollisionContact();
+		SweepRayImpl(starts[idx], vels[idx], timeStep, &out[idx], ignores ? ignores[idx] : nullptr, isect_result);
+	}
+}
+
+void CollisionSpace::SweepRayImpl(const vector3d &start, const vector3d &vel, double timeStep, CollisionContact *c, const Geom *ignore, std::vector<uint32_t> &isect_result)
+{
+	const double speed = vel.Length();
+	const double len = speed * timeStep;
+	c->distance = len;
+	if (len <= 0.0)
+		return;
+
+	const vector3d dir = vel * (1.0 / speed);
+	const vector3d invDir(1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z);
+	double hitTime = timeStep;
+
+	isect_result.clear();
+
+	if (m_enabledStaticGeoms > 0) {
+		m_staticObjectTree->TraceRay(start, invDir, len, isect_result);
+
+		for (uint32_t &idx : isect_result)
+			SweepRayGeom(m_staticGeoms[idx], start, vel, hitTime, c);
+
+		isect_result.clear();
+	}
+
+	// a geom can move into the path from anywhere within its own travel
+	// distance, so inflate the tree nodes by as much as any geom moves
+	if (m_enabledDynGeoms > 0) {
+		m_dynamicObjectTree->TraceRay(start, invDir, len, isect_result, m_maxGeomSpeed * timeStep);
+
+		for (uint32_t &idx : isect_result) {
+			Geom *g = m_geoms[idx];
+
+			if (g != ignore)
+				SweepRayGeom(g, start, vel, hitTime, c);
+		}
+	}
+
+	// the planet doesn't move within its own frame
+	isect_t isect;
+	isect.dist = float(hitTime * speed);
+	isect.triIdx = -1;
+	CollideRaySphere(start, dir, &isect);
+	if (isect.triIdx != -1) {
+		hitTime = isect.dist / speed;
+		c->pos = start + dir * double(isect.dist);
+		c->normal = vector3d(0.0);
+		c->triIdx = -1;
+		c->userData1 = sphere.userData;
+		c->userData2 = 0;
+		c->geomFlag = 0;
+	}
+
+	c->distance = hitTime * speed;
+	c->depth = len - c->distance;
+	c->timestep = hitTime;
+}
+
+void CollisionSpace::SweepRayGeom(Geom *g, const vector3d &start, const vector3d &vel, double &hitTime, CollisionContact *c)
+{
+	PROFILE_SCOPED()
+
+	// trace the motion relative to the geom in its own coordinates, treating
+	// the geom as moving in a straight line without rotating during the step
+	const vector3d relVel = vel - g->GetVelocity();
+	const double relSpeed = relVel.Length();
+	if (relSpeed <= 0.0)
+		return;
+
+	const matrix4x4d &invTrans = g->GetInvTransform();
+	const vector3f modelStart = vector3f(invTrans * start);
+	const vector3f modelDir = vector3f(invTrans.ApplyRotationOnly(relVel * (1.0 / relSpeed)));
+
+	isect_t isect;
+	isect.dist = float(hitTime * relSpeed);
+	isect.triIdx = -1;
+	g->GetGeomTree()->TraceRay(modelStart, modelDir, &isect);
+	if (isect.triIdx != -1) {
+		hitTime = isect.dist / relSpeed;
+		// where the point is at the time of the hit
+		c->pos = start + vel * hitTime;
+
+		vector3f n = g->GetGeomTree()->GetTriNormal(isect.triIdx);
+		c->normal = g->GetTransform().ApplyRotationOnly(vector3d(n.x, n.y, n.z));
+
+		c->triIdx = isect.triIdx;
+		c->userData1 = g->GetUserData();
+		c->userData2 = 0;
+		c->geomFlag = g->GetGeomTree()->GetTriFlag(isect.triIdx);
+	}
+}
+
+void CollisionSpace::TraceRaySphere(const vector3d &start, const vector3d &dir, double len, CollisionContact *c)
+{
+	isect_t isect;
+	isect.dist = float(c->distance);
+	isect.triIdx = -1;
+	CollideRaySphere(start, dir, &isect);
+	if (isect.triIdx != -1) {
+		c->pos = start + dir * double(isect.dist);
+		c->normal = vector3d(0.0);
+		c->depth = len - isect.dist;
+		c->triIdx = -1;
+		c->userData1 = sphere.userData;
+		c->userData2 = 0;
+		c->geomFlag = 0;
+		c->distance = isect.dist;
+	}
+}
+
+// spread the low 10 bits of v out to every third bit
+static uint32_t SpreadBits10(uint32_t v)
+{
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+void CollisionSpace::TraceRays(size_t numRays, const vector3d *starts, const vector3d *dirs, const double *lens, CollisionContact *out, const Geom *ignore /*= nullptr*/)
+{
+	PROFILE_SCOPED()
+
+	// rays are traced in packets of similar rays, so nodes tested for one
+	// ray in a packet are likely to be hit by the others as well
+	static constexpr size_t PACKET_SIZE = 64;
+
+	if (!numRays)
+		return;
+	assert(numRays < UINT32_MAX);
+
+	std::vector<vector3d> invDirs(numRays);
+	AABBd startBounds = AABBd::Invalid();
+	for (size_t idx = 0; idx < numRays; idx++) {
+		invDirs[idx] = vector3d(1.0 / dirs[idx].x, 1.0 / dirs[idx].y, 1.0 / dirs[idx].z);
+		startBounds.Update(starts[idx]);
+
+		out[idx] = CollisionContact();
+		out[idx].distance = lens[idx];
+	}
+
+	// sort rays by direction octant, then by the Morton code of their start
+	// position within the batch
+	const vector3d boundsSize = startBounds.max - startBounds.min;
+	const vector3d scale(
+		boundsSize.x > 0.0 ? 1023.0 / boundsSize.x : 0.0,
+		boundsSize.y > 0.0 ? 1023.0 / boundsSize.y : 0.0,
+		boundsSize.z > 0.0 ? 1023.0 / boundsSize.z : 0.0);
+
+	std::vector<std::pair<uint64_t, uint32_t>> order(numRays);
+	for (size_t idx = 0; idx < numRays; idx++) {
+		const vector3d &dir = dirs[idx];
+		const uint64_t octant = (dir.x < 0.0 ? 1 : 0) | (dir.y < 0.0 ? 2 : 0) | (dir.z < 0.0 ? 4 : 0);
+
+		const vector3d pos = starts[idx] - startBounds.min;
+		const uint64_t morton = SpreadBits10(uint32_t(std::min(pos.x * scale.x, 1023.0))) |
+			(SpreadBits10(uint32_t(std::min(pos.y * scale.y, 1023.0))) << 1) |
+			(SpreadBits10(uint32_t(std::min(pos.z * scale.z, 1023.0))) << 2);
+
+		order[idx] = { (octant << 30) | morton, uint32_t(idx) };
+	}
+	std::sort(order.begin(), order.end());
+
+	std::vector<uint32_t> rayIdx(numRays);
+	for (size_t idx = 0; idx < numRays; idx++)
+		rayIdx[idx] = order[idx].second;
+
+	std::vector<Intersection> isect_result;
+	isect_result.reserve(PACKET_SIZE * 2);
+
+	for (size_t first = 0; first < numRays; first += PACKET_SIZE) {
+		const uint32_t count = uint32_t(std::min(PACKET_SIZE, numRays - first));
+		const uint32_t *packet = &rayIdx[first];
+
+		// static geoms first, then dynamic geoms, then the planet, the same
+		// order as TraceRay; each ray keeps its leaves in traversal order
+		if (m_enabledStaticGeoms > 0) {
+			m_staticObjectTree->TraceRays(count, packet, starts, invDirs.data(), lens, isect_result);
+
+			for (const Intersection &isect : isect_result) {
+				const uint32_t ray = isect.first;
+				TraceRayGeom(m_staticGeoms[isect.second], starts[ray], dirs[ray], lens[ray], &out[ray]);
+			}
+
+			isect_result.clear();
+		}
+
+		if (m_enabledDynGeoms > 0) {
+			m_dynamicObjectTree->TraceRays(count, packet, starts, invDirs.data(), lens, isect_result);
+
+			for (const Intersection &isect : isect_result) {
+				const uint32_t ray = isect.first;
+				Geom *g = m_geoms[isect.second];
+
+				if (g != ignore)
+					TraceRayGeom(g, starts[ray], dirs[ray], lens[ray], &out[ray]);
+			}
+
+			isect_result.clear();
+		}
+
+		for (uint32_t idx = 0; idx < count; idx++) {
+			const uint32_t ray = packet[idx];
+			TraceRaySphere(starts[ray], dirs[ray], lens[ray], &out[ray]);
 		}
 	}
 }
@@ -201,7 +454,68 @@ void CollisionSpace::CollideGeom(Geom *a, Geom *b, void (*callback)(CollisionCon
 	double r2 = b->GetGeomTree()->GetRadius();
 
 	if ((pos1 - pos2).Length() <= (r1 + r2)) {
-		a->Collide(b, callback);
+		if (s_contactCache)
+			CollideGeomCached(a, b, callback);
+		else
+			a->Collide(b, callback);
+	}
+}
+
+void CollisionSpace::CollideGeomCached(Geom *a, Geom *b, void (*callback)(CollisionContact *))
+{
+	const matrix4x4d relTransform = b->GetInvTransform() * a->GetTransform();
+
+	auto iter = m_pairCache.find({ a, b });
+	if (iter != m_pairCache.end()) {
+		CachedPair &pair = iter->second;
+
+		// geoms may have been replaced by another one at the same address
+		const bool sameGeoms = pair.treeA == a->GetGeomTree() && pair.treeB == b->GetGeomTree();
+		if (sameGeoms && pair.lastStep + 1 == m_collideStep &&
+			IsSameRelativeTransform(pair.relTransform, relTransform)) {
+			pair.lastStep = m_collideStep;
+
+			// pairs which didn't touch last step are skipped entirely
+			for (const CollisionContact &cached : pair.contacts) {
+				CollisionContact contact = cached;
+				contact.pos = a->GetTransform() * cached.pos;
+				contact.normal = a->GetTransform().ApplyRotationOnly(cached.normal);
+				callback(&contact);
+			}
+			return;
+		}
+	} else {
+		iter = m_pairCache.emplace(GeomPair(a, b), CachedPair()).first;
+	}
+
+	CachedPair &pair = iter->second;
+	pair.relTransform = relTransform;
+	pair.treeA = a->GetGeomTree();
+	pair.treeB = b->GetGeomTree();
+	pair.lastStep = m_collideStep;
+	pair.contacts.clear();
+
+	std::vector<CollisionContact> *prevCapture = t_capturedContacts;
+	t_capturedContacts = &pair.contacts;
+	a->Collide(b, &CaptureContact);
+	t_capturedContacts = prevCapture;
+
+	for (CollisionContact &cached : pair.contacts) {
+		CollisionContact contact = cached;
+		callback(&contact);
+
+		cached.pos = a->GetInvTransform() * cached.pos;
+		cached.normal = a->GetInvTransform().ApplyRotationOnly(cached.normal);
+	}
+}
+
+void CollisionSpace::EvictCachedPairs(const Geom *geom)
+{
+	for (auto iter = m_pairCache.begin(); iter != m_pairCache.end();) {
+		if (iter->first.first == geom || iter->first.second == geom)
+			iter = m_pairCache.erase(iter);
+		else
+			++iter;
 	}
 }
 
@@ -222,11 +536,40 @@ void CollisionSpace::RebuildObjectTrees()
 	// NOTE: we store AABBs in m_geomAabbs for fast O(1) lookup during Collide()
 	// This doubles the memory cost but allows SingleBVHTree to store leaf nodes
 	// in a cache-friendly order.
-	m_enabledDynGeoms = SortEnabledGeoms(m_geoms);
-	RebuildBVHTree(m_dynamicObjectTree.get(), m_enabledDynGeoms, m_geoms, m_geomAabbs);
+	bool reordered = false;
+	uint32_t numEnabled = SortEnabledGeoms(m_geoms, &reordered);
+	RefitDynamicTree(numEnabled, reordered);
+
+	m_maxGeomSpeed = 0.0;
+	for (uint32_t idx = 0; idx < numEnabled; idx++)
+		m_maxGeomSpeed = std::max(m_maxGeomSpeed, m_geoms[idx]->GetVelocity().Length());
 }
 
-uint32_t CollisionSpace::SortEnabledGeoms(std::vector<Geom *> &geoms)
+void CollisionSpace::RefitDynamicTree(uint32_t numEnabled, bool reordered)
+{
+	PROFILE_SCOPED()
+
+	// Most geoms only move a little between steps, so updating the node
+	// AABBs of the existing tree is usually enough. The tree has to be
+	// rebuilt when the set or order of enabled geoms changes.
+	const bool needRebuild = m_needDynamicGeomRebuild || reordered || numEnabled != m_enabledDynGeoms;
+
+	m_enabledDynGeoms = numEnabled;
+	m_needDynamicGeomRebuild = false;
+
+	if (needRebuild || !numEnabled) {
+		RebuildBVHTree(m_dynamicObjectTree.get(), numEnabled, m_geoms, m_geomAabbs);
+		return;
+	}
+
+	AABBd bounds = UpdateGeomAabbs(numEnabled, m_geoms, m_geomAabbs);
+	m_dynamicObjectTree->Refit(m_geomAabbs.data());
+
+	if (m_dynamicObjectTree->GetAreaGrowth() > MAX_REFIT_AREA_GROWTH)
+		m_dynamicObjectTree->Build(bounds, m_geomAabbs.data(), m_geomAabbs.size());
+}
+
+uint32_t CollisionSpace::SortEnabledGeoms(std::vector<Geom *> &geoms, bool *reordered)
 {
 	PROFILE_SCOPED()
 
@@ -244,6 +587,11 @@ uint32_t CollisionSpace::SortEnabledGeoms(std::vector<Geom *> &geoms)
 		} else {
 			endIdx--;
 			std::swap(geoms[startIdx], geoms[endIdx]);
+
+			// shuffling disabled geoms around doesn't matter, only moving an
+			// enabled geom to a new slot changes the order of enabled geoms
+			if (reordered && geoms[startIdx]->IsEnabled())
+				*reordered = true;
 		}
 	}
 
@@ -260,6 +608,12 @@ void CollisionSpace::RebuildBVHTree(SingleBVHTree *tree, uint32_t numGeoms, cons
 		return;
 	}
 
+	AABBd bounds = UpdateGeomAabbs(numGeoms, geoms, aabbs);
+	tree->Build(bounds, aabbs.data(), aabbs.size());
+}
+
+AABBd CollisionSpace::UpdateGeomAabbs(uint32_t numGeoms, const std::vector<Geom *> &geoms, std::vector<AABBd> &aabbs)
+{
 	aabbs.resize(0);
 	aabbs.reserve(numGeoms);
 
@@ -278,13 +632,14 @@ void CollisionSpace::RebuildBVHTree(SingleBVHTree *tree, uint32_t numGeoms, cons
 		bounds.Update(aabb);
 	}
 
-	tree->Build(bounds, aabbs.data(), aabbs.size());
+	return bounds;
 }
 
 void CollisionSpace::Collide(void (*callback)(CollisionContact *))
 {
 	PROFILE_SCOPED()
 	m_duringCollision = true;
+	m_collideStep++;
 
 	RebuildObjectTrees();
 
@@ -325,6 +680,14 @@ void CollisionSpace::Collide(void (*callback)(CollisionContact *))
 
 	CollidePlanet(callback);
 
+	// forget pairs which are no longer close enough to be tested
+	for (auto iter = m_pairCache.begin(); iter != m_pairCache.end();) {
+		if (iter->second.lastStep != m_collideStep)
+			iter = m_pairCache.erase(iter);
+		else
+			++iter;
+	}
+
 	m_duringCollision = false;
 }
 
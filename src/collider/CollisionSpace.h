@@ -5,16 +5,19 @@
 #define _COLLISION_SPACE
 
 #include "../Aabb.h"
+#include "../matrix4x4.h"
 #include "../vector3.h"
+#include "CollisionContact.h"
 
+#include <map>
 #include <memory>
 #include <vector>
 
 class Geom;
+class GeomTree;
 class SingleBVHTree;
 
 struct isect_t;
-struct CollisionContact;
 
 struct Sphere {
 	vector3d pos;
@@ -34,6 +37,19 @@ public:
 	void AddStaticGeom(Geom *);
 	void RemoveStaticGeom(Geom *);
 	void TraceRay(const vector3d &start, const vector3d &dir, double len, CollisionContact *c, const Geom *ignore = nullptr);
+	// Trace numRays rays at once, giving the same results as calling TraceRay for
+	// each of them. out[i] is reset for every ray; it hit something if userData1 is set.
+	void TraceRays(size_t numRays, const vector3d *starts, const vector3d *dirs, const double *lens, CollisionContact *out, const Geom *ignore = nullptr);
+	// Sweep a point moving with vel over timeStep against all geoms, taking the
+	// velocity of each geom into account, so fast objects can't pass through
+	// each other between two steps. Reports the earliest hit along the path;
+	// c->distance is the distance the point travels before it and c->timestep
+	// the time into the step at which it happens.
+	void SweepRay(const vector3d &start, const vector3d &vel, double timeStep, CollisionContact *c, const Geom *ignore = nullptr);
+	// Sweep numRays points at once, giving the same results as calling
+	// SweepRay for each of them; ignores may be null, or give the geom each
+	// point should not hit. out[i] is reset for every point.
+	void SweepRays(size_t numRays, const vector3d *starts, const vector3d *vels, double timeStep, CollisionContact *out, const Geom *const *ignores = nullptr);
 	void Collide(void (*callback)(CollisionContact *));
 	void SetSphere(const vector3d &pos, double radius, void *user_data)
 	{
@@ -41,7 +57,7 @@ public:
 		sphere.radius = radius;
 		sphere.userData = user_data;
 	}
-	void FlagRebuildObjectTrees() { m_needStaticGeomRebuild = true; }
+	void FlagRebuildObjectTrees() { m_needStaticGeomRebuild = m_needDynamicGeomRebuild = true; }
 	void RebuildObjectTrees();
 
 	const SingleBVHTree *GetDynamicTree() const { return m_dynamicObjectTree.get(); }
@@ -57,16 +73,39 @@ public:
 		return s_nextHandle++;
 	}
 
+	// Reuse the contacts of geom pairs whose relative transform hasn't
+	// changed since the previous step instead of colliding their meshes.
+	static void SetContactCache(bool enabled) { s_contactCache = enabled; }
+	static bool IsContactCache() { return s_contactCache; }
+
 private:
 	using Intersection = std::pair<uint32_t, uint32_t>;
+	using GeomPair = std::pair<const Geom *, const Geom *>;
+
+	struct CachedPair {
+		// transform from a's to b's coordinates when the contacts were made
+		matrix4x4d relTransform;
+		const GeomTree *treeA;
+		const GeomTree *treeB;
+		uint32_t lastStep;
+		// contact positions and normals are in a's coordinates
+		std::vector<CollisionContact> contacts;
+	};
 
 	void CollideRaySphere(const vector3d &start, const vector3d &dir, isect_t *isect);
-	uint32_t SortEnabledGeoms(std::vector<Geom *> &geoms);
+	void TraceRaySphere(const vector3d &start, const vector3d &dir, double len, CollisionContact *c);
+	uint32_t SortEnabledGeoms(std::vector<Geom *> &geoms, bool *reordered = nullptr);
+	AABBd UpdateGeomAabbs(uint32_t numGeoms, const std::vector<Geom *> &geoms, std::vector<AABBd> &aabbs);
 	void RebuildBVHTree(SingleBVHTree *tree, uint32_t numEnabled, const std::vector<Geom *> &geoms, std::vector<AABBd> &aabbs);
+	void RefitDynamicTree(uint32_t numEnabled, bool reordered);
 
 	void CollideGeom(Geom *a, Geom *b, void (*callback)(CollisionContact *));
+	void CollideGeomCached(Geom *a, Geom *b, void (*callback)(CollisionContact *));
+	void EvictCachedPairs(const Geom *geom);
 	void CollidePlanet(void (*callback)(CollisionContact *));
 	void TraceRayGeom(Geom *g, const vector3d &start, const vector3d &dir, double len, CollisionContact *c);
+	void SweepRayGeom(Geom *g, const vector3d &start, const vector3d &vel, double &hitTime, CollisionContact *c);
+	void SweepRayImpl(const vector3d &start, const vector3d &vel, double timeStep, CollisionContact *c, const Geom *ignore, std::vector<uint32_t> &isect_result);
 
 	std::unique_ptr<SingleBVHTree> m_staticObjectTree;
 	std::unique_ptr<SingleBVHTree> m_dynamicObjectTree;
@@ -80,10 +119,18 @@ private:
 	std::vector<AABBd> m_geomAabbs;
 	Sphere sphere;
 
+	// speed of the fastest enabled dynamic geom, as of the last tree update
+	double m_maxGeomSpeed;
+
 	bool m_needStaticGeomRebuild;
+	bool m_needDynamicGeomRebuild;
 	bool m_duringCollision;
 
+	std::map<GeomPair, CachedPair> m_pairCache;
+	uint32_t m_collideStep;
+
 	static int s_nextHandle;
+	static bool s_contactCache;
 };
 
 #endif /* _COLLISION_SPACE */
@@ -14,6 +14,7 @@ static const unsigned int MAX_CONTACTS = 8;
 
 Geom::Geom(const GeomTree *geomtree, const matrix4x4d &m, const vector3d &pos, void *data) :
 	m_pos(pos),
+	m_vel(0.0),
 	m_geomtree(geomtree),
 	m_orient(m),
 	m_data(data),
@@ -76,6 +77,14 @@ void Geom::CollideSphere(Sphere &sphere, void (*callback)(CollisionContact *)) c
 void Geom::Collide(Geom *b, void (*callback)(CollisionContact *)) const
 {
 	PROFILE_SCOPED()
+	// the convex proxies are much tighter than the overlapping AABBs that
+	// got us here, and separating them rules out any contact
+	const Aabb &aabbA = GetGeomTree()->GetAabb();
+	const Aabb &aabbB = b->GetGeomTree()->GetAabb();
+	if (GetGeomTree()->GetHull().IsSeparatedFrom(aabbB.min, aabbB.max, m_invOrient * b->m_orient) ||
+		b->GetGeomTree()->GetHull().IsSeparatedFrom(aabbA.min, aabbA.max, b->m_invOrient * m_orient))
+		return;
+
 	int max_contacts = MAX_CONTACTS;
 	matrix4x4d transTo;
 	//unsigned int t = SDL_GetTicks();
@@ -94,9 +103,9 @@ void Geom::Collide(Geom *b, void (*callback)(CollisionContact *)) const
 	//	Output("%d 'rays' in %dms (%f rps)\n", numEdges, t, 1000.0*numEdges / (double)t);
 }
 
-static bool rotatedAabbIsectsNormalOne(Aabb &a, const matrix4x4d &transA, Aabb &b)
+static bool rotatedAabbIsectsNormalOne(const AABBf &a, const matrix4x4d &transA, const AABBf &b)
 {
-	Aabb arot;
+	AABBd arot;
 	vector3d p[8];
 	p[0] = transA * vector3d(a.min.x, a.min.y, a.min.z);
 	p[1] = transA * vector3d(a.min.x, a.min.y, a.max.z);
@@ -109,7 +118,7 @@ static bool rotatedAabbIsectsNormalOne(Aabb &a, const matrix4x4d &transA, Aabb &
 	arot.min = arot.max = p[0];
 	for (int i = 1; i < 8; i++)
 		arot.Update(p[i]);
-	return b.Intersects(arot);
+	return AABBd{ vector3d(b.min), vector3d(b.max) }.Intersects(arot);
 }
 
 /*
@@ -120,52 +129,54 @@ void Geom::CollideEdgesWithTrisOf(int &maxContacts, const Geom *b, const matrix4
 {
 	PROFILE_SCOPED()
 	struct stackobj {
-		BVHNode *edgeNode;
-		BVHNode *triNode;
+		uint32_t edgeNode;
+		uint32_t triNode;
+		AABBf edgeBounds;
+		AABBf triBounds;
 	} stack[32];
 	int stackpos = 0;
 
-	stack[0].edgeNode = GetGeomTree()->GetEdgeTree()->GetRoot();
-	stack[0].triNode = b->GetGeomTree()->GetTriTree()->GetRoot();
+	const CompactBVHTree *edgeTree = GetGeomTree()->GetEdgeTree();
+	const CompactBVHTree *triTree = b->GetGeomTree()->GetTriTree();
+	stack[0] = { edgeTree->GetRoot(), triTree->GetRoot(), edgeTree->GetRootBounds(), triTree->GetRootBounds() };
 
 	while ((stackpos >= 0) && (maxContacts > 0)) {
-		BVHNode *edgeNode = stack[stackpos].edgeNode;
-		BVHNode *triNode = stack[stackpos].triNode;
+		const stackobj top = stack[stackpos];
 		stackpos--;
 
 		// does the edgeNode (with its aabb described in 6 planes transformed and rotated to
 		// b's coordinates) intersect with one or other of b's child nodes?
-		if (triNode->triIndicesStart || edgeNode->triIndicesStart) {
+		if (CompactBVHTree::IsLeaf(top.triNode) || CompactBVHTree::IsLeaf(top.edgeNode)) {
 			// reached triangle leaf node or edge leaf node.
 			// Intersect all edges under edgeNode with this leaf
-			CollideEdgesTris(maxContacts, edgeNode, transTo, b, triNode, callback);
+			CollideEdgesTris(maxContacts, top.edgeNode, transTo, b, top.triNode, top.triBounds, callback);
 		} else {
-			BVHNode *left = triNode->kids[0];
-			BVHNode *right = triNode->kids[1];
-			bool edgeNodeIsectsLeftChild = rotatedAabbIsectsNormalOne(edgeNode->aabb, transTo, left->aabb);
-			bool edgeNodeIsectsRightChild = rotatedAabbIsectsNormalOne(edgeNode->aabb, transTo, right->aabb);
+			const CompactBVHTree::Node &triNode = triTree->GetNode(top.triNode);
+			AABBf triKids[2];
+			CompactBVHTree::GetChildBounds(triNode, top.triBounds, triKids);
+			bool edgeNodeIsectsLeftChild = rotatedAabbIsectsNormalOne(top.edgeBounds, transTo, triKids[0]);
+			bool edgeNodeIsectsRightChild = rotatedAabbIsectsNormalOne(top.edgeBounds, transTo, triKids[1]);
 			//edgeNodeIsectsRightChild = edgeNodeIsectsLeftChild = true;
 			if (edgeNodeIsectsRightChild) {
 				if (edgeNodeIsectsLeftChild) {
 					// isects both. split edgeNode and try again
+					const CompactBVHTree::Node &edgeNode = edgeTree->GetNode(top.edgeNode);
+					AABBf edgeKids[2];
+					CompactBVHTree::GetChildBounds(edgeNode, top.edgeBounds, edgeKids);
 					++stackpos;
-					stack[stackpos].edgeNode = edgeNode->kids[0];
-					stack[stackpos].triNode = triNode;
+					stack[stackpos] = { edgeNode.kids[0], top.triNode, edgeKids[0], top.triBounds };
 					++stackpos;
-					stack[stackpos].edgeNode = edgeNode->kids[1];
-					stack[stackpos].triNode = triNode;
+					stack[stackpos] = { edgeNode.kids[1], top.triNode, edgeKids[1], top.triBounds };
 				} else {
 					// hits only right child. go down into that
 					// side with same edge node
 					++stackpos;
-					stack[stackpos].edgeNode = edgeNode;
-					stack[stackpos].triNode = triNode->kids[1];
+					stack[stackpos] = { top.edgeNode, triNode.kids[1], top.edgeBounds, triKids[1] };
 				}
 			} else if (edgeNodeIsectsLeftChild) {
 				// hits only left child
 				++stackpos;
-				stack[stackpos].edgeNode = edgeNode;
-				stack[stackpos].triNode = triNode->kids[0];
+				stack[stackpos] = { top.edgeNode, triNode.kids[0], top.edgeBounds, triKids[0] };
 			} else {
 				// hits none
 			}
@@ -177,36 +188,39 @@ void Geom::CollideEdgesWithTrisOf(int &maxContacts, const Geom *b, const matrix4
  * Collide one edgeNode (all edges below it) of this Geom with the triangle
  * BVH of another geom (b), starting from btriNode.
  */
-void Geom::CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const matrix4x4d &transToB,
-	const Geom *b, const BVHNode *btriNode, void (*callback)(CollisionContact *)) const
+void Geom::CollideEdgesTris(int &maxContacts, uint32_t edgeNode, const matrix4x4d &transToB,
+	const Geom *b, uint32_t btriNode, const AABBf &btriBounds, void (*callback)(CollisionContact *)) const
 {
 	// PROFILE_SCOPED() // verbose profiling only, this gets called a LOT
 	if (maxContacts <= 0) return;
-	if (edgeNode->triIndicesStart) {
+	const CompactBVHTree *edgeTree = GetGeomTree()->GetEdgeTree();
+	if (CompactBVHTree::IsLeaf(edgeNode)) {
 		const GeomTree::Edge *edges = this->GetGeomTree()->GetEdges();
+		const int *edgeIdxs = edgeTree->GetLeafObjects(edgeNode);
+		const int numEdges = edgeTree->GetLeafCount(edgeNode);
 		int numContacts = 0;
 		vector3f dir;
 		isect_t isect;
 		const std::vector<vector3f> &rVertices = GetGeomTree()->GetVertices();
-		for (int i = 0; i < edgeNode->numTris; i++) {
-			const int vtxNum = edges[edgeNode->triIndicesStart[i]].v1i;
+		for (int i = 0; i < numEdges; i++) {
+			const int vtxNum = edges[edgeIdxs[i]].v1i;
 			const vector3d v1 = transToB * vector3d(rVertices[vtxNum]);
 			const vector3f _from(float(v1.x), float(v1.y), float(v1.z));
 
 			vector3d _dir(
-				double(edges[edgeNode->triIndicesStart[i]].dir.x),
-				double(edges[edgeNode->triIndicesStart[i]].dir.y),
-				double(edges[edgeNode->triIndicesStart[i]].dir.z));
+				double(edges[edgeIdxs[i]].dir.x),
+				double(edges[edgeIdxs[i]].dir.y),
+				double(edges[edgeIdxs[i]].dir.z));
 			_dir = transToB.ApplyRotationOnly(_dir);
 			dir = vector3f(&_dir.x);
-			isect.dist = edges[edgeNode->triIndicesStart[i]].len;
+			isect.dist = edges[edgeIdxs[i]].len;
 			isect.triIdx = -1;
 
-			b->GetGeomTree()->TraceRay(btriNode, _from, dir, &isect);
+			b->GetGeomTree()->TraceRay(btriNode, btriBounds, _from, dir, &isect);
 
 			if (isect.triIdx == -1) continue;
 			numContacts++;
-			const double depth = edges[edgeNode->triIndicesStart[i]].len - isect.dist;
+			const double depth = edges[edgeIdxs[i]].len - isect.dist;
 			// in world coords
 			CollisionContact contact;
 			contact.pos = b->GetTransform() * (v1 + vector3d(&dir.x) * double(isect.dist));
@@ -221,12 +235,13 @@ void Geom::CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const mat
 			contact.userData2 = b->m_data;
 			// contact geomFlag is bitwise OR of triangle's and edge's flags
 			contact.geomFlag = b->m_geomtree->GetTriFlag(isect.triIdx) |
-				edges[edgeNode->triIndicesStart[i]].triFlag;
+				edges[edgeIdxs[i]].triFlag;
 			callback(&contact);
 			if (--maxContacts <= 0) return;
 		}
 	} else {
-		CollideEdgesTris(maxContacts, edgeNode->kids[0], transToB, b, btriNode, callback);
-		CollideEdgesTris(maxContacts, edgeNode->kids[1], transToB, b, btriNode, callback);
+		const CompactBVHTree::Node &node = edgeTree->GetNode(edgeNode);
+		CollideEdgesTris(maxContacts, node.kids[0], transToB, b, btriNode, btriBounds, callback);
+		CollideEdgesTris(maxContacts, node.kids[1], transToB, b, btriNode, btriBounds, callback);
 	}
 }
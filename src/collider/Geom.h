@@ -4,6 +4,7 @@
 #ifndef _GEOM_H
 #define _GEOM_H
 
+#include "../Aabb.h"
 #include "../matrix4x4.h"
 #include "../vector3.h"
 
@@ -11,7 +12,6 @@ struct CollisionContact;
 class GeomTree;
 struct isect_t;
 struct Sphere;
-struct BVHNode;
 
 class Geom {
 public:
@@ -22,6 +22,9 @@ public:
 	inline const matrix4x4d &GetTransform() const { return m_orient; }
 	//matrix4x4d GetRotation() const;
 	inline const vector3d &GetPosition() const { return m_pos; }
+	// velocity relative to the collision space, used by swept queries
+	inline void SetVelocity(const vector3d &vel) { m_vel = vel; }
+	inline const vector3d &GetVelocity() const { return m_vel; }
 	inline void Enable() { m_active = true; }
 	inline void Disable() { m_active = false; }
 	inline bool IsEnabled() const { return m_active; }
@@ -36,11 +39,12 @@ public:
 
 private:
 	void CollideEdgesWithTrisOf(int &maxContacts, const Geom *b, const matrix4x4d &transTo, void (*callback)(CollisionContact *)) const;
-	void CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const matrix4x4d &transToB,
-		const Geom *b, const BVHNode *btriNode, void (*callback)(CollisionContact *)) const;
+	void CollideEdgesTris(int &maxContacts, uint32_t edgeNode, const matrix4x4d &transToB,
+		const Geom *b, uint32_t btriNode, const AABBf &btriBounds, void (*callback)(CollisionContact *)) const;
 
 	// double-buffer position so we can keep previous position
 	vector3d m_pos;
+	vector3d m_vel;
 	const GeomTree *m_geomtree;
 	matrix4x4d m_orient, m_invOrient;
 
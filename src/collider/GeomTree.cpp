@@ -4,14 +4,21 @@
 #include "GeomTree.h"
 
 #include "BVHTree.h"
+#include "RayTri.h"
 #include "Weld.h"
 #include "scenegraph/Serializer.h"
 #include "../utils.h"
+#include "jenkins/lookup3.h"
 
+#include <cstring>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 
 #pragma GCC optimize("O3")
 
+static_assert(sizeof(GeomTree::Edge) == 28, "GeomTree::Edge is padded differently on this platform and will not serialize properly.");
+
 GeomTree::~GeomTree()
 {
 }
@@ -91,6 +98,12 @@ GeomTree::GeomTree(const int numVerts, const int numTris, const std::vector<vect
 	}
 	m_radius = sqrt(m_radius);
 
+	// the proxy only ever rejects, so keep it a little loose to stay clear
+	// of float rounding in the ray tests
+	for (const vector3f &v : m_vertices)
+		m_hull.Update(v);
+	m_hull.Inflate(1e-3f + 1e-5f * float(m_radius));
+
 	{
 		Aabb *aabbs = new Aabb[activeTris.size()];
 		for (Uint32 i = 0; i < activeTris.size(); i++) {
@@ -103,7 +116,8 @@ GeomTree::GeomTree(const int numVerts, const int numTris, const std::vector<vect
 		}
 
 		//int t = SDL_GetTicks();
-		m_triTree.reset(new BVHTree(activeTris.size(), &activeTris[0], aabbs));
+		BVHTree triTree(activeTris.size(), &activeTris[0], aabbs);
+		m_triTree.reset(new CompactBVHTree(triTree));
 		delete[] aabbs;
 	}
 	//Output("Tri tree of %d tris build in %dms\n", activeTris.size(), SDL_GetTicks() - t);
@@ -111,7 +125,7 @@ GeomTree::GeomTree(const int numVerts, const int numTris, const std::vector<vect
 	m_numEdges = edges.size();
 	m_edges.resize(m_numEdges);
 	// to build Edge bvh tree with.
-	m_aabbs.resize(m_numEdges);
+	std::vector<Aabb> edgeAabbs(m_numEdges);
 	int *edgeIdxs = new int[m_numEdges];
 
 	int pos = 0;
@@ -133,12 +147,13 @@ GeomTree::GeomTree(const int numVerts, const int numTris, const std::vector<vect
 		m_edges[pos].dir = dir;
 
 		edgeIdxs[pos] = pos;
-		m_aabbs[pos].min = m_aabbs[pos].max = vector3d(v1);
-		m_aabbs[pos].Update(vector3d(v2));
+		edgeAabbs[pos].min = edgeAabbs[pos].max = vector3d(v1);
+		edgeAabbs[pos].Update(vector3d(v2));
 	}
 
 	//t = SDL_GetTicks();
-	m_edgeTree.reset(new BVHTree(m_numEdges, edgeIdxs, &m_aabbs[0]));
+	BVHTree edgeTree(m_numEdges, edgeIdxs, &edgeAabbs[0]);
+	m_edgeTree.reset(new CompactBVHTree(edgeTree));
 	delete[] edgeIdxs;
 	//Output("Edge tree of %d edges build in %dms\n", m_numEdges, SDL_GetTicks() - t);
 
@@ -158,84 +173,42 @@ GeomTree::GeomTree(Serializer::Reader &rd)
 	m_aabb.min = rd.Vector3d();
 	m_aabb.radius = rd.Double();
 
-	const Uint32 numAabbs = rd.Int32();
-	m_aabbs.resize(numAabbs);
-	for (Uint32 iAabb = 0; iAabb < numAabbs; ++iAabb) {
-		rd >> m_aabbs[iAabb];
-	}
-
-	{
-		PROFILE_SCOPED_DESC("GeomTree::LoadEdges")
-		m_edges.resize(m_numEdges);
-		for (Sint32 iEdge = 0; iEdge < m_numEdges; ++iEdge) {
-			auto &ed = m_edges[iEdge];
-			rd >> ed.v1i >> ed.v2i >> ed.len >> ed.dir >> ed.triFlag;
-		}
-	}
-
-	m_vertices.resize(m_numVertices);
-	for (Sint32 iVert = 0; iVert < m_numVertices; ++iVert) {
-		m_vertices[iVert] = rd.Vector3f();
-	}
-
-	const int numIndicies(m_numTris * 3);
-	m_indices.resize(numIndicies);
-	for (Sint32 iIndi = 0; iIndi < numIndicies; ++iIndi) {
-		m_indices[iIndi] = rd.Int32();
-	}
-
-	m_triFlags.resize(m_numTris);
-	for (Sint32 iTri = 0; iTri < m_numTris; ++iTri) {
-		m_triFlags[iTri] = rd.Int32();
-	}
-
-	// activeTris = tris we are still trying to put into leaves
-	std::vector<int> activeTris;
-	activeTris.reserve(m_numTris);
-	for (int i = 0; i < m_numTris; i++) {
-		activeTris.push_back(i * 3);
-	}
+	// everything is stored in its final in-memory layout, so loading is a
+	// single copy per array and the BVH trees don't have to be rebuilt
+	rd.Array(m_edges);
+	rd.Array(m_vertices);
+	rd.Array(m_indices);
+	rd.Array(m_triFlags);
 
-	// regenerate the aabb data
-	Aabb *aabbs = new Aabb[activeTris.size()];
-	for (Uint32 i = 0; i < activeTris.size(); i++) {
-		const vector3d v1 = vector3d(m_vertices[m_indices[activeTris[i] + 0]]);
-		const vector3d v2 = vector3d(m_vertices[m_indices[activeTris[i] + 1]]);
-		const vector3d v3 = vector3d(m_vertices[m_indices[activeTris[i] + 2]]);
-		aabbs[i].min = aabbs[i].max = v1;
-		aabbs[i].Update(v2);
-		aabbs[i].Update(v3);
-	}
-	m_triTree.reset(new BVHTree(activeTris.size(), &activeTris[0], aabbs));
-	delete[] aabbs;
+	m_triTree.reset(new CompactBVHTree(rd));
+	m_edgeTree.reset(new CompactBVHTree(rd));
 
-	//
-	int *edgeIdxs = new int[m_numEdges];
-	memset(edgeIdxs, 0, sizeof(int) * m_numEdges);
-	for (int i = 0; i < m_numEdges; i++) {
-		edgeIdxs[i] = i;
+	for (int i = 0; i < KDop::NUM_AXES; i++) {
+		m_hull.min[i] = rd.Float();
+		m_hull.max[i] = rd.Float();
 	}
 
-	m_edgeTree.reset(new BVHTree(m_numEdges, edgeIdxs, &m_aabbs[0]));
-	delete[] edgeIdxs;
+	if (m_edges.size() != size_t(m_numEdges) || m_vertices.size() != size_t(m_numVertices) ||
+		m_indices.size() != size_t(m_numTris) * 3 || m_triFlags.size() != size_t(m_numTris))
+		throw std::out_of_range("GeomTree: array sizes do not match the stored counts.");
 }
 
-static bool SlabsRayAabbTest(const BVHNode *n, const vector3f &start, const vector3f &invDir, isect_t *isect)
+static bool SlabsRayAabbTest(const AABBf &aabb, const vector3f &start, const vector3f &invDir, isect_t *isect)
 {
 	// PROFILE_SCOPED()
 	float
-		l1 = (n->aabb.min.x - start.x) * invDir.x,
-		l2 = (n->aabb.max.x - start.x) * invDir.x,
+		l1 = (aabb.min.x - start.x) * invDir.x,
+		l2 = (aabb.max.x - start.x) * invDir.x,
 		lmin = std::min(l1, l2),
 		lmax = std::max(l1, l2);
 
-	l1 = (n->aabb.min.y - start.y) * invDir.y;
-	l2 = (n->aabb.max.y - start.y) * invDir.y;
+	l1 = (aabb.min.y - start.y) * invDir.y;
+	l2 = (aabb.max.y - start.y) * invDir.y;
 	lmin = std::max(std::min(l1, l2), lmin);
 	lmax = std::min(std::max(l1, l2), lmax);
 
-	l1 = (n->aabb.min.z - start.z) * invDir.z;
-	l2 = (n->aabb.max.z - start.z) * invDir.z;
+	l1 = (aabb.min.z - start.z) * invDir.z;
+	l2 = (aabb.max.z - start.z) * invDir.z;
 	lmin = std::max(std::min(l1, l2), lmin);
 	lmax = std::min(std::max(l1, l2), lmax);
 
@@ -244,34 +217,58 @@ static bool SlabsRayAabbTest(const BVHNode *n, const vector3f &start, const vect
 
 void GeomTree::TraceRay(const vector3f &start, const vector3f &dir, isect_t *isect) const
 {
-	TraceRay(m_triTree->GetRoot(), start, dir, isect);
+	// most rays that reach a model from a distance miss it entirely
+	if (!m_hull.IntersectsRay(start, dir, isect->dist))
+		return;
+
+	TraceRay(m_triTree->GetRoot(), m_triTree->GetRootBounds(), start, dir, isect);
 }
 
-void GeomTree::TraceRay(const BVHNode *currnode, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const
+void GeomTree::TraceRay(uint32_t currnode, const AABBf &startBounds, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const
 {
 	// PROFILE_SCOPED()
-	BVHNode *stack[32];
+	struct stackobj {
+		uint32_t node;
+		AABBf bounds;
+	} stack[32];
 	int stackpos = -1;
+	AABBf bounds = startBounds;
 	const vector3f invDir( // avoid division by zero please
 		is_zero_exact(a_dir.x) ? 0.0f : (1.0f / a_dir.x),
 		is_zero_exact(a_dir.y) ? 0.0f : (1.0f / a_dir.y),
 		is_zero_exact(a_dir.z) ? 0.0f : (1.0f / a_dir.z));
 
+	if (!CompactBVHTree::IsLeaf(currnode) && !SlabsRayAabbTest(startBounds, a_origin, invDir, isect))
+		return;
+
+	// Child bounds are decoded from their parent, so both children are tested
+	// together and only those the ray actually hits are visited.
 	for (;;) {
-		while (!currnode->IsLeaf()) {
-			if (!SlabsRayAabbTest(currnode, a_origin, invDir, isect)) goto pop_bstack;
+		while (!CompactBVHTree::IsLeaf(currnode)) {
+			const CompactBVHTree::Node &node = m_triTree->GetNode(currnode);
+			AABBf kids[2];
+			CompactBVHTree::GetChildBounds(node, bounds, kids);
+
+			const bool hitLeft = SlabsRayAabbTest(kids[0], a_origin, invDir, isect);
+			const bool hitRight = SlabsRayAabbTest(kids[1], a_origin, invDir, isect);
+			if (hitLeft && hitRight) {
+				stackpos++;
+				stack[stackpos] = { node.kids[1], kids[1] };
+			} else if (!hitLeft && !hitRight) {
+				goto pop_bstack;
+			}
 
-			stackpos++;
-			stack[stackpos] = currnode->kids[1];
-			currnode = currnode->kids[0];
+			const int next = hitLeft ? 0 : 1;
+			currnode = node.kids[next];
+			bounds = kids[next];
 		}
 		// triangle intersection jizz
-		for (int i = 0; i < currnode->numTris; i++) {
-			RayTriIntersect(1, a_origin, &a_dir, currnode->triIndicesStart[i], isect);
-		}
+		RayTri::RayTriangles(a_origin, a_dir, &m_vertices[0], &m_indices[0],
+			m_triTree->GetLeafObjects(currnode), m_triTree->GetLeafCount(currnode), isect);
 	pop_bstack:
 		if (stackpos < 0) break;
-		currnode = stack[stackpos];
+		currnode = stack[stackpos].node;
+		bounds = stack[stackpos].bounds;
 		stackpos--;
 	}
 }
@@ -279,31 +276,9 @@ void GeomTree::TraceRay(const BVHNode *currnode, const vector3f &a_origin, const
 void GeomTree::RayTriIntersect(int numRays, const vector3f &origin, const vector3f *dirs, int triIdx, isect_t *isects) const
 {
 	// PROFILE_SCOPED()
-	const vector3f a(m_vertices[m_indices[triIdx + 0]]);
-	const vector3f b(m_vertices[m_indices[triIdx + 1]]);
-	const vector3f c(m_vertices[m_indices[triIdx + 2]]);
-
-	const vector3f n = (c - a).Cross(b - a);
-	const float nominator = n.Dot(a - origin);
-
-	const vector3f v0_cross((c - origin).Cross(b - origin));
-	const vector3f v1_cross((b - origin).Cross(a - origin));
-	const vector3f v2_cross((a - origin).Cross(c - origin));
-
-	for (int i = 0; i < numRays; i++) {
-		const float v0d = v0_cross.Dot(dirs[i]);
-		const float v1d = v1_cross.Dot(dirs[i]);
-		const float v2d = v2_cross.Dot(dirs[i]);
-
-		if (((v0d > 0) && (v1d > 0) && (v2d > 0)) ||
-			((v0d < 0) && (v1d < 0) && (v2d < 0))) {
-			const float dist = nominator / dirs[i].Dot(n);
-			if ((dist > 0) && (dist < isects[i].dist)) {
-				isects[i].dist = dist;
-				isects[i].triIdx = triIdx / 3;
-			}
-		}
-	}
+	RayTri::RaysTriangle(origin, dirs, numRays,
+		m_vertices[m_indices[triIdx + 0]], m_vertices[m_indices[triIdx + 1]], m_vertices[m_indices[triIdx + 2]],
+		triIdx / 3, isects);
 }
 
 vector3f GeomTree::GetTriNormal(int triIdx) const
@@ -316,6 +291,115 @@ vector3f GeomTree::GetTriNormal(int triIdx) const
 	return (b - a).Cross(c - a).Normalized();
 }
 
+namespace {
+	// every shared tree, by content hash; trees with colliding hashes but
+	// different content just sit side by side
+	std::mutex s_sharedLock;
+	std::unordered_multimap<uint64_t, GeomTree *> s_sharedTrees;
+} // namespace
+
+template <typename T>
+static void hash_array(const std::vector<T> &v, uint32_t &a, uint32_t &b)
+{
+	const uint32_t size = v.size();
+	lookup3_hashlittle2(&size, sizeof(size), &a, &b);
+	if (!v.empty())
+		lookup3_hashlittle2(v.data(), v.size() * sizeof(T), &a, &b);
+}
+
+template <typename T>
+static bool same_array(const std::vector<T> &a, const std::vector<T> &b)
+{
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+uint64_t GeomTree::ContentHash() const
+{
+	// the BVH trees, edges and bounds follow from the welded mesh, so that's
+	// all that needs to be compared
+	uint32_t a = 0, b = 0;
+	hash_array(m_vertices, a, b);
+	hash_array(m_indices, a, b);
+	hash_array(m_triFlags, a, b);
+	return (uint64_t(a) << 32) | b;
+}
+
+bool GeomTree::SameContent(const GeomTree &other) const
+{
+	return same_array(m_vertices, other.m_vertices) &&
+		same_array(m_indices, other.m_indices) &&
+		same_array(m_triFlags, other.m_triFlags);
+}
+
+// static
+GeomTree *GeomTree::Share(GeomTree *tree)
+{
+	PROFILE_SCOPED()
+	assert(tree && tree->m_numShares == 0);
+	const uint64_t hash = tree->ContentHash();
+
+	std::lock_guard<std::mutex> lock(s_sharedLock);
+	auto range = s_sharedTrees.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second->SameContent(*tree)) {
+			it->second->m_numShares++;
+			delete tree;
+			return it->second;
+		}
+	}
+
+	tree->m_contentHash = hash;
+	tree->m_numShares = 1;
+	s_sharedTrees.emplace(hash, tree);
+	return tree;
+}
+
+// static
+void GeomTree::Release(GeomTree *tree)
+{
+	if (!tree)
+		return;
+
+	std::lock_guard<std::mutex> lock(s_sharedLock);
+	assert(tree->m_numShares > 0);
+	if (--tree->m_numShares > 0)
+		return;
+
+	auto range = s_sharedTrees.equal_range(tree->m_contentHash);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == tree) {
+			s_sharedTrees.erase(it);
+			break;
+		}
+	}
+	delete tree;
+}
+
+// static
+GeomTree::SharedStats GeomTree::GetSharedStats()
+{
+	std::lock_guard<std::mutex> lock(s_sharedLock);
+	SharedStats stats = { s_sharedTrees.size(), 0, 0, 0 };
+	for (const auto &it : s_sharedTrees) {
+		const size_t size = it.second->GetMemoryUsage();
+		stats.numUses += it.second->m_numShares;
+		stats.memoryUsed += size;
+		stats.memorySaved += size * (it.second->m_numShares - 1);
+	}
+	return stats;
+}
+
+size_t GeomTree::GetMemoryUsage() const
+{
+	return sizeof(GeomTree) +
+		m_edges.size() * sizeof(Edge) +
+		m_vertices.size() * sizeof(vector3f) +
+		m_indices.size() * sizeof(Uint32) +
+		m_triFlags.size() * sizeof(Uint32) +
+		m_triTree->GetMemoryUsage() +
+		m_edgeTree->GetMemoryUsage();
+}
+
 void GeomTree::Save(Serializer::Writer &wr) const
 {
 	PROFILE_SCOPED()
@@ -328,25 +412,16 @@ void GeomTree::Save(Serializer::Writer &wr) const
 	wr.Vector3d(m_aabb.min);
 	wr.Double(m_aabb.radius);
 
-	wr.Int32(m_numEdges);
-	for (Sint32 iAabb = 0; iAabb < m_numEdges; ++iAabb) {
-		wr << m_aabbs[iAabb];
-	}
-
-	for (Sint32 iEdge = 0; iEdge < m_numEdges; ++iEdge) {
-		auto &ed = m_edges[iEdge];
-		wr << ed.v1i << ed.v2i << ed.len << ed.dir << ed.triFlag;
-	}
-
-	for (Sint32 iVert = 0; iVert < m_numVertices; ++iVert) {
-		wr.Vector3f(m_vertices[iVert]);
-	}
+	wr.Array(m_edges);
+	wr.Array(m_vertices);
+	wr.Array(m_indices);
+	wr.Array(m_triFlags);
 
-	for (Sint32 iIndi = 0; iIndi < (m_numTris * 3); ++iIndi) {
-		wr.Int32(m_indices[iIndi]);
-	}
+	m_triTree->Save(wr);
+	m_edgeTree->Save(wr);
 
-	for (Sint32 iTri = 0; iTri < m_numTris; ++iTri) {
-		wr.Int32(m_triFlags[iTri]);
+	for (int i = 0; i < KDop::NUM_AXES; i++) {
+		wr.Float(m_hull.min[i]);
+		wr.Float(m_hull.max[i]);
 	}
 }
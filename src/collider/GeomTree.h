@@ -5,6 +5,7 @@
 #define _GEOMTREE_H
 
 #include "Aabb.h"
+#include "KDop.h"
 
 #include <memory>
 #include <vector>
@@ -20,8 +21,7 @@ struct isect_t {
 	float dist;
 };
 
-class BVHTree;
-struct BVHNode;
+class CompactBVHTree;
 
 class GeomTree {
 public:
@@ -31,12 +31,34 @@ public:
 
 	~GeomTree();
 
+	// Trees are shared between every collision mesh that ends up with the
+	// same vertices, indices and flags (station variants, city buildings,
+	// ships built from the same hull pieces). Share takes ownership of a newly
+	// built tree and returns the registered tree with that content, deleting
+	// the given one if there already was one. Each Share must be matched by
+	// a Release; the last Release deletes the tree.
+	static GeomTree *Share(GeomTree *tree);
+	static void Release(GeomTree *tree);
+
+	struct SharedStats {
+		size_t numTrees;
+		// number of Shares not yet released
+		size_t numUses;
+		size_t memoryUsed;
+		// what the duplicates would have used without sharing
+		size_t memorySaved;
+	};
+	static SharedStats GetSharedStats();
+
 	const Aabb &GetAabb() const { return m_aabb; }
+	// Coarse convex proxy of the mesh, for rejecting queries before
+	// touching the BVH trees
+	const KDop &GetHull() const { return m_hull; }
 	// dir should be unit length,
 	// isect.dist should be ray length
 	// isect.triIdx should be -1 unless repeat calls with same isect_t
 	void TraceRay(const vector3f &start, const vector3f &dir, isect_t *isect) const;
-	void TraceRay(const BVHNode *startNode, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const;
+	void TraceRay(uint32_t startNode, const AABBf &startBounds, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const;
 	vector3f GetTriNormal(int triIdx) const;
 	Uint32 GetTriFlag(int triIdx) const { return m_triFlags[triIdx]; }
 	double GetRadius() const { return m_radius; }
@@ -58,8 +80,8 @@ public:
 	}
 	int GetNumEdges() const { return m_numEdges; }
 
-	BVHTree *GetTriTree() const { return m_triTree.get(); }
-	BVHTree *GetEdgeTree() const { return m_edgeTree.get(); }
+	const CompactBVHTree *GetTriTree() const { return m_triTree.get(); }
+	const CompactBVHTree *GetEdgeTree() const { return m_edgeTree.get(); }
 
 	const std::vector<vector3f> &GetVertices() const { return m_vertices; }
 	const Uint32 *GetIndices() const { return &m_indices[0]; }
@@ -67,25 +89,35 @@ public:
 	int GetNumVertices() const { return m_numVertices; }
 	int GetNumTris() const { return m_numTris; }
 
+	// Approximate number of bytes used by the mesh and both BVH trees
+	size_t GetMemoryUsage() const;
+
 private:
 	void RayTriIntersect(int numRays, const vector3f &origin, const vector3f *dirs, int triIdx, isect_t *isects) const;
 
+	uint64_t ContentHash() const;
+	bool SameContent(const GeomTree &other) const;
+
 	int m_numVertices;
 	int m_numEdges;
 	int m_numTris;
 
 	double m_radius;
 	Aabb m_aabb;
-	std::vector<Aabb> m_aabbs;
+	KDop m_hull;
 
-	std::unique_ptr<BVHTree> m_triTree;
-	std::unique_ptr<BVHTree> m_edgeTree;
+	std::unique_ptr<CompactBVHTree> m_triTree;
+	std::unique_ptr<CompactBVHTree> m_edgeTree;
 
 	std::vector<Edge> m_edges;
 
 	std::vector<vector3f> m_vertices;
 	std::vector<Uint32> m_indices;
 	std::vector<Uint32> m_triFlags;
+
+	// guarded by the shared tree registry's lock
+	uint64_t m_contentHash = 0;
+	int m_numShares = 0;
 };
 
 #endif /* _GEOMTREE_H */
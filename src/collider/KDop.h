@@ -0,0 +1,115 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _KDOP_H
+#define _KDOP_H
+
+#include "../matrix4x4.h"
+#include "../vector3.h"
+
+#include <algorithm>
+#include <cfloat>
+
+/*
+ * 26-sided discrete oriented polytope: the convex volume bounded by planes
+ * along the 3 coordinate axes, the 6 edge diagonals and the 4 corner
+ * diagonals of a box. It hugs rounded and rotated shapes much more closely
+ * than an AABB while being as cheap to build (one pass over the vertices)
+ * and only a little more expensive to test against.
+ *
+ * The axes are not normalized; all extents are measured in the same units
+ * as the projections onto them, so this does not matter for the tests.
+ */
+struct KDop {
+	static constexpr int NUM_AXES = 13;
+
+	float min[NUM_AXES];
+	float max[NUM_AXES];
+
+	KDop() { Reset(); }
+
+	static vector3f GetAxis(int i)
+	{
+		static const float axes[NUM_AXES][3] = {
+			{ 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 },
+			{ 1, 1, 0 }, { 1, -1, 0 }, { 1, 0, 1 }, { 1, 0, -1 }, { 0, 1, 1 }, { 0, 1, -1 },
+			{ 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { 1, -1, -1 }
+		};
+		return vector3f(axes[i][0], axes[i][1], axes[i][2]);
+	}
+
+	void Reset()
+	{
+		std::fill(min, min + NUM_AXES, FLT_MAX);
+		std::fill(max, max + NUM_AXES, -FLT_MAX);
+	}
+
+	void Update(const vector3f &p)
+	{
+		for (int i = 0; i < NUM_AXES; i++) {
+			const float d = GetAxis(i).Dot(p);
+			min[i] = std::min(min[i], d);
+			max[i] = std::max(max[i], d);
+		}
+	}
+
+	// Grow every plane outwards, e.g. to absorb rounding in the ray tests
+	void Inflate(float margin)
+	{
+		for (int i = 0; i < NUM_AXES; i++) {
+			min[i] -= margin;
+			max[i] += margin;
+		}
+	}
+
+	// Slab test; false if the ray segment [0, len] certainly misses the volume
+	bool IntersectsRay(const vector3f &start, const vector3f &dir, float len) const
+	{
+		float tmin = 0.0f, tmax = len;
+		for (int i = 0; i < NUM_AXES; i++) {
+			const vector3f axis = GetAxis(i);
+			const float s = axis.Dot(start);
+			const float d = axis.Dot(dir);
+
+			if (std::abs(d) < 1e-12f) {
+				if (s < min[i] || s > max[i])
+					return false;
+				continue;
+			}
+
+			const float t0 = (min[i] - s) / d;
+			const float t1 = (max[i] - s) / d;
+			tmin = std::max(tmin, std::min(t0, t1));
+			tmax = std::min(tmax, std::max(t0, t1));
+			if (tmin > tmax)
+				return false;
+		}
+		return true;
+	}
+
+	// True if the box, transformed into the space of this volume, lies
+	// entirely outside one of its planes
+	bool IsSeparatedFrom(const vector3d &boxMin, const vector3d &boxMax, const matrix4x4d &boxToThis) const
+	{
+		vector3f corners[8];
+		for (int c = 0; c < 8; c++) {
+			const vector3d p((c & 1) ? boxMax.x : boxMin.x, (c & 2) ? boxMax.y : boxMin.y, (c & 4) ? boxMax.z : boxMin.z);
+			corners[c] = vector3f(boxToThis * p);
+		}
+
+		for (int i = 0; i < NUM_AXES; i++) {
+			const vector3f axis = GetAxis(i);
+			float lo = FLT_MAX, hi = -FLT_MAX;
+			for (int c = 0; c < 8; c++) {
+				const float d = axis.Dot(corners[c]);
+				lo = std::min(lo, d);
+				hi = std::max(hi, d);
+			}
+			if (lo > max[i] || hi < min[i])
+				return true;
+		}
+		return false;
+	}
+};
+
+#endif /* _KDOP_H */
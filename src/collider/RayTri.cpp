@@ -0,0 +1,296 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "RayTri.h"
+#include "GeomTree.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RAYTRI_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RAYTRI_SSE 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RAYTRI_NEON 1
+#endif
+
+#pragma GCC optimize("O3")
+
+void RayTri::RaysTriangleScalar(const vector3f &origin, const vector3f *dirs, int numRays,
+	const vector3f &a, const vector3f &b, const vector3f &c, int triNum, isect_t *isects)
+{
+	const vector3f n = (c - a).Cross(b - a);
+	const float nominator = n.Dot(a - origin);
+
+	const vector3f v0_cross((c - origin).Cross(b - origin));
+	const vector3f v1_cross((b - origin).Cross(a - origin));
+	const vector3f v2_cross((a - origin).Cross(c - origin));
+
+	for (int i = 0; i < numRays; i++) {
+		const float v0d = v0_cross.Dot(dirs[i]);
+		const float v1d = v1_cross.Dot(dirs[i]);
+		const float v2d = v2_cross.Dot(dirs[i]);
+
+		if (((v0d > 0) && (v1d > 0) && (v2d > 0)) ||
+			((v0d < 0) && (v1d < 0) && (v2d < 0))) {
+			const float dist = nominator / dirs[i].Dot(n);
+			if ((dist > 0) && (dist < isects[i].dist)) {
+				isects[i].dist = dist;
+				isects[i].triIdx = triNum;
+			}
+		}
+	}
+}
+
+void RayTri::RayTrianglesScalar(const vector3f &origin, const vector3f &dir, const vector3f *vertices,
+	const Uint32 *indices, const int *triOffsets, int numTris, isect_t *isect)
+{
+	for (int i = 0; i < numTris; i++) {
+		const int offset = triOffsets[i];
+		RaysTriangleScalar(origin, &dir, 1,
+			vertices[indices[offset + 0]], vertices[indices[offset + 1]], vertices[indices[offset + 2]],
+			offset / 3, isect);
+	}
+}
+
+#if defined(RAYTRI_AVX) || defined(RAYTRI_SSE) || defined(RAYTRI_NEON)
+
+namespace {
+	// Minimal wrapper over one vector register of floats. Comparisons return
+	// all-ones lanes stored in the same register type.
+#if defined(RAYTRI_AVX)
+	struct floatN {
+		static constexpr int WIDTH = 8;
+		__m256 v;
+	};
+
+	inline floatN Broadcast(float f) { return { _mm256_set1_ps(f) }; }
+	inline floatN Load(const float *p) { return { _mm256_loadu_ps(p) }; }
+	inline void Store(float *p, floatN a) { _mm256_storeu_ps(p, a.v); }
+	inline floatN operator+(floatN a, floatN b) { return { _mm256_add_ps(a.v, b.v) }; }
+	inline floatN operator-(floatN a, floatN b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	inline floatN operator*(floatN a, floatN b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	inline floatN operator/(floatN a, floatN b) { return { _mm256_div_ps(a.v, b.v) }; }
+	inline floatN operator&(floatN a, floatN b) { return { _mm256_and_ps(a.v, b.v) }; }
+	inline floatN operator|(floatN a, floatN b) { return { _mm256_or_ps(a.v, b.v) }; }
+	inline floatN GreaterThan(floatN a, floatN b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+	inline floatN LessThan(floatN a, floatN b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+	inline int MoveMask(floatN a) { return _mm256_movemask_ps(a.v); }
+#elif defined(RAYTRI_SSE)
+	struct floatN {
+		static constexpr int WIDTH = 4;
+		__m128 v;
+	};
+
+	inline floatN Broadcast(float f) { return { _mm_set1_ps(f) }; }
+	inline floatN Load(const float *p) { return { _mm_loadu_ps(p) }; }
+	inline void Store(float *p, floatN a) { _mm_storeu_ps(p, a.v); }
+	inline floatN operator+(floatN a, floatN b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline floatN operator-(floatN a, floatN b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline floatN operator*(floatN a, floatN b) { return { _mm_mul_ps(a.v, b.v) }; }
+	inline floatN operator/(floatN a, floatN b) { return { _mm_div_ps(a.v, b.v) }; }
+	inline floatN operator&(floatN a, floatN b) { return { _mm_and_ps(a.v, b.v) }; }
+	inline floatN operator|(floatN a, floatN b) { return { _mm_or_ps(a.v, b.v) }; }
+	inline floatN GreaterThan(floatN a, floatN b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+	inline floatN LessThan(floatN a, floatN b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+	inline int MoveMask(floatN a) { return _mm_movemask_ps(a.v); }
+#elif defined(RAYTRI_NEON)
+	struct floatN {
+		static constexpr int WIDTH = 4;
+		float32x4_t v;
+	};
+
+	inline floatN Broadcast(float f) { return { vdupq_n_f32(f) }; }
+	inline floatN Load(const float *p) { return { vld1q_f32(p) }; }
+	inline void Store(float *p, floatN a) { vst1q_f32(p, a.v); }
+	inline floatN operator+(floatN a, floatN b) { return { vaddq_f32(a.v, b.v) }; }
+	inline floatN operator-(floatN a, floatN b) { return { vsubq_f32(a.v, b.v) }; }
+	inline floatN operator*(floatN a, floatN b) { return { vmulq_f32(a.v, b.v) }; }
+	inline floatN operator/(floatN a, floatN b) { return { vdivq_f32(a.v, b.v) }; }
+	inline floatN operator&(floatN a, floatN b) { return { vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) }; }
+	inline floatN operator|(floatN a, floatN b) { return { vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) }; }
+	inline floatN GreaterThan(floatN a, floatN b) { return { vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v)) }; }
+	inline floatN LessThan(floatN a, floatN b) { return { vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)) }; }
+	inline int MoveMask(floatN a)
+	{
+		const uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(a.v), 31);
+		return int(vgetq_lane_u32(bits, 0) | (vgetq_lane_u32(bits, 1) << 1) |
+			(vgetq_lane_u32(bits, 2) << 2) | (vgetq_lane_u32(bits, 3) << 3));
+	}
+#endif
+
+	constexpr int WIDTH = floatN::WIDTH;
+
+	// structure-of-arrays vector, one lane per ray or triangle
+	struct vector3N {
+		floatN x, y, z;
+	};
+
+	inline vector3N Broadcast(const vector3f &v) { return { Broadcast(v.x), Broadcast(v.y), Broadcast(v.z) }; }
+	inline vector3N operator-(const vector3N &a, const vector3N &b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+
+	// same operation order as vector3::Cross and vector3::Dot
+	inline vector3N Cross(const vector3N &a, const vector3N &b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	inline floatN Dot(const vector3N &a, const vector3N &b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	// lanes where the ray passes through the triangle in front of the origin
+	inline int HitMask(floatN v0d, floatN v1d, floatN v2d, floatN dist)
+	{
+		const floatN zero = Broadcast(0.0f);
+		const floatN front = GreaterThan(v0d, zero) & GreaterThan(v1d, zero) & GreaterThan(v2d, zero);
+		const floatN back = LessThan(v0d, zero) & LessThan(v1d, zero) & LessThan(v2d, zero);
+		return MoveMask((front | back) & GreaterThan(dist, zero));
+	}
+} // namespace
+
+int RayTri::GetPacketWidth()
+{
+	return WIDTH;
+}
+
+const char *RayTri::GetKernelName()
+{
+#if defined(RAYTRI_AVX)
+	return "AVX";
+#elif defined(RAYTRI_SSE)
+	return "SSE";
+#else
+	return "NEON";
+#endif
+}
+
+void RayTri::RaysTriangle(const vector3f &origin, const vector3f *dirs, int numRays,
+	const vector3f &a, const vector3f &b, const vector3f &c, int triNum, isect_t *isects)
+{
+	const int numPacked = numRays - numRays % WIDTH;
+	if (numPacked) {
+		const vector3f n = (c - a).Cross(b - a);
+		const floatN nominator = Broadcast(n.Dot(a - origin));
+
+		const vector3N nN = Broadcast(n);
+		const vector3N v0_cross = Broadcast((c - origin).Cross(b - origin));
+		const vector3N v1_cross = Broadcast((b - origin).Cross(a - origin));
+		const vector3N v2_cross = Broadcast((a - origin).Cross(c - origin));
+
+		for (int i = 0; i < numPacked; i += WIDTH) {
+			alignas(32) float x[WIDTH], y[WIDTH], z[WIDTH], dist[WIDTH];
+			for (int lane = 0; lane < WIDTH; lane++) {
+				x[lane] = dirs[i + lane].x;
+				y[lane] = dirs[i + lane].y;
+				z[lane] = dirs[i + lane].z;
+			}
+
+			const vector3N dir = { Load(x), Load(y), Load(z) };
+			const floatN v0d = Dot(v0_cross, dir);
+			const floatN v1d = Dot(v1_cross, dir);
+			const floatN v2d = Dot(v2_cross, dir);
+			const floatN distN = nominator / Dot(dir, nN);
+
+			int mask = HitMask(v0d, v1d, v2d, distN);
+			if (!mask)
+				continue;
+
+			Store(dist, distN);
+			for (int lane = 0; mask; lane++, mask >>= 1) {
+				isect_t &isect = isects[i + lane];
+				if ((mask & 1) && dist[lane] < isect.dist) {
+					isect.dist = dist[lane];
+					isect.triIdx = triNum;
+				}
+			}
+		}
+	}
+
+	if (numPacked < numRays)
+		RaysTriangleScalar(origin, dirs + numPacked, numRays - numPacked, a, b, c, triNum, isects + numPacked);
+}
+
+void RayTri::RayTriangles(const vector3f &origin, const vector3f &dir, const vector3f *vertices,
+	const Uint32 *indices, const int *triOffsets, int numTris, isect_t *isect)
+{
+	const int numPacked = numTris - numTris % WIDTH;
+	if (numPacked) {
+		const vector3N originN = Broadcast(origin);
+		const vector3N dirN = Broadcast(dir);
+
+		for (int i = 0; i < numPacked; i += WIDTH) {
+			alignas(32) float v[9][WIDTH];
+			for (int lane = 0; lane < WIDTH; lane++) {
+				const Uint32 *tri = &indices[triOffsets[i + lane]];
+				for (int corner = 0; corner < 3; corner++) {
+					const vector3f &p = vertices[tri[corner]];
+					v[corner * 3 + 0][lane] = p.x;
+					v[corner * 3 + 1][lane] = p.y;
+					v[corner * 3 + 2][lane] = p.z;
+				}
+			}
+
+			const vector3N a = { Load(v[0]), Load(v[1]), Load(v[2]) };
+			const vector3N b = { Load(v[3]), Load(v[4]), Load(v[5]) };
+			const vector3N c = { Load(v[6]), Load(v[7]), Load(v[8]) };
+
+			const vector3N n = Cross(c - a, b - a);
+			const floatN nominator = Dot(n, a - originN);
+
+			const vector3N v0_cross = Cross(c - originN, b - originN);
+			const vector3N v1_cross = Cross(b - originN, a - originN);
+			const vector3N v2_cross = Cross(a - originN, c - originN);
+
+			const floatN v0d = Dot(v0_cross, dirN);
+			const floatN v1d = Dot(v1_cross, dirN);
+			const floatN v2d = Dot(v2_cross, dirN);
+			const floatN distN = nominator / Dot(dirN, n);
+
+			int mask = HitMask(v0d, v1d, v2d, distN);
+			if (!mask)
+				continue;
+
+			// resolve hits in triangle order to match the scalar kernel
+			alignas(32) float dist[WIDTH];
+			Store(dist, distN);
+			for (int lane = 0; mask; lane++, mask >>= 1) {
+				if ((mask & 1) && dist[lane] < isect->dist) {
+					isect->dist = dist[lane];
+					isect->triIdx = triOffsets[i + lane] / 3;
+				}
+			}
+		}
+	}
+
+	if (numPacked < numTris)
+		RayTrianglesScalar(origin, dir, vertices, indices, triOffsets + numPacked, numTris - numPacked, isect);
+}
+
+#else
+
+int RayTri::GetPacketWidth()
+{
+	return 1;
+}
+
+const char *RayTri::GetKernelName()
+{
+	return "scalar";
+}
+
+void RayTri::RaysTriangle(const vector3f &origin, const vector3f *dirs, int numRays,
+	const vector3f &a, const vector3f &b, const vector3f &c, int triNum, isect_t *isects)
+{
+	RaysTriangleScalar(origin, dirs, numRays, a, b, c, triNum, isects);
+}
+
+void RayTri::RayTriangles(const vector3f &origin, const vector3f &dir, const vector3f *vertices,
+	const Uint32 *indices, const int *triOffsets, int numTris, isect_t *isect)
+{
+	RayTrianglesScalar(origin, dir, vertices, indices, triOffsets, numTris, isect);
+}
+
+#endif
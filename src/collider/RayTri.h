@@ -0,0 +1,51 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _COLLIDER_RAYTRI_H
+#define _COLLIDER_RAYTRI_H
+
+#include "SDL_stdinc.h"
+#include "vector3.h"
+
+struct isect_t;
+
+/*
+ * Ray/triangle intersection kernels used by GeomTree.
+ *
+ * The packet kernels test several rays against one triangle or one ray
+ * against several triangles at a time using the widest vector instruction
+ * set the build targets (AVX, SSE or AArch64 NEON, see USE_SSE42/USE_AVX2),
+ * and fall back to the scalar kernels otherwise.
+ *
+ * All kernels perform the same floating point operations in the same order
+ * and update the intersections in the same order, so they report exactly
+ * the same hits as the scalar versions.
+ */
+namespace RayTri {
+
+	// Number of rays or triangles tested at once by the packet kernels,
+	// 1 if only the scalar kernels are available
+	int GetPacketWidth();
+	const char *GetKernelName();
+
+	// Test numRays rays from a common origin against the triangle (a, b, c).
+	// isects[i] is updated with triNum and the distance if ray i hits the
+	// triangle closer than isects[i].dist.
+	void RaysTriangle(const vector3f &origin, const vector3f *dirs, int numRays,
+		const vector3f &a, const vector3f &b, const vector3f &c, int triNum, isect_t *isects);
+
+	// Test one ray against numTris triangles, each given as the offset of
+	// its first vertex index in indices. isect is updated with the closest
+	// hit, preferring the earliest triangle on ties.
+	void RayTriangles(const vector3f &origin, const vector3f &dir, const vector3f *vertices,
+		const Uint32 *indices, const int *triOffsets, int numTris, isect_t *isect);
+
+	void RaysTriangleScalar(const vector3f &origin, const vector3f *dirs, int numRays,
+		const vector3f &a, const vector3f &b, const vector3f &c, int triNum, isect_t *isects);
+
+	void RayTrianglesScalar(const vector3f &origin, const vector3f &dir, const vector3f *vertices,
+		const Uint32 *indices, const int *triOffsets, int numTris, isect_t *isect);
+
+} // namespace RayTri
+
+#endif /* _COLLIDER_RAYTRI_H */
@@ -3,6 +3,7 @@
 
 #include "Application.h"
 #include "FileSystem.h"
+#include "FrameArena.h"
 #include "JobQueue.h"
 #include "OS.h"
 #include "SDL.h"
@@ -12,6 +13,7 @@
 
 #include "SDL_timer.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 static constexpr Uint32 SYNC_JOBS_PER_LOOP = 1;
@@ -74,6 +76,32 @@ void Application::RequestProfileFrame(const std::string &path)
 #endif
 }
 
+void Application::RequestProfileCapture(int numFrames, const std::string &path)
+{
+#ifdef PIONEER_PROFILER
+	m_capturePath = path.empty() ? m_profilerPath : FileSystem::JoinPathBelow(m_profilerPath, path);
+	FileSystem::userFiles.MakeDirectory(m_capturePath);
+
+	// a ring would cut a long capture short
+	m_captureFrames = std::max(numFrames, 1);
+	Profiler::capturestart();
+#endif
+}
+
+void Application::SetProfileCaptureRing(double seconds)
+{
+#ifdef PIONEER_PROFILER
+	m_captureRing = seconds;
+	if (m_captureFrames)
+		return;
+
+	if (seconds > 0.0)
+		Profiler::capturestart(seconds);
+	else
+		Profiler::capturestop();
+#endif
+}
+
 void Application::SetProfilerPath(const std::string &path)
 {
 #ifdef PIONEER_PROFILER
@@ -90,6 +118,13 @@ JobQueue *Application::GetSyncJobQueue()
 	return m_syncJobQueue.get();
 }
 
+uint32_t Application::RunSyncJobs(uint32_t count)
+{
+	const uint32_t run = m_syncJobQueue->RunJobs(count);
+	m_syncJobQueue->FinishJobs();
+	return run;
+}
+
 JobQueue *Application::GetAsyncJobQueue()
 {
 	return m_taskGraph->GetJobQueue();
@@ -151,8 +186,13 @@ void Application::HandleJobs()
 {
 	m_taskGraph->RunPinnedTasks();
 	m_syncJobQueue->RunJobs(SYNC_JOBS_PER_LOOP);
-	m_syncJobQueue->FinishJobs();
-	m_taskGraph->GetJobQueue()->FinishJobs();
+	if (m_jobFinishBudget > 0.0) {
+		m_syncJobQueue->FinishJobs(m_jobFinishBudget * 0.5);
+		m_taskGraph->GetJobQueue()->FinishJobs(m_jobFinishBudget * 0.5);
+	} else {
+		m_syncJobQueue->FinishJobs();
+		m_taskGraph->GetJobQueue()->FinishJobs();
+	}
 
 	// Reclaim StringTable memory periodically
 	StringTable::Get()->Reclaim();
@@ -185,6 +225,8 @@ void Application::Run()
 		if (!m_activeLifecycle)
 			break;
 
+		// what was allocated for the frame before last is reused from here on
+		FrameArena::NextFrame();
 		BeginFrame();
 
 		// The PreUpdate hook should be used for setting up per-frame state, etc.
@@ -199,6 +241,15 @@ void Application::Run()
 
 		EndFrame();
 
+		// report frames over the hitch threshold while the profiler still has
+		// their zones
+		m_runtime.SoftStop();
+		thisTime = m_runtime.seconds();
+		const bool isHitch = thisTime - m_totalTime > m_hitchThreshold;
+		// loading and the startup profile run long frames on purpose
+		if (isHitch && !m_activeLifecycle->m_profilerAccumulate)
+			OnHitch((thisTime - m_totalTime) * 1e3);
+
 #ifdef PIONEER_PROFILER
 		const bool profileReset = (m_activeLifecycle && !m_activeLifecycle->m_profilerAccumulate);
 #endif
@@ -209,11 +260,9 @@ void Application::Run()
 
 #ifdef PIONEER_PROFILER
 		// TODO: potential pigui frame profile inspector
-		m_runtime.SoftStop();
-		thisTime = m_runtime.seconds();
 
-		// profile frames taking longer than 100ms
-		bool isSlowProfile = (m_doSlowProfile && thisTime - m_totalTime > 0.100);
+		// profile frames over the hitch threshold
+		bool isSlowProfile = (m_doSlowProfile && isHitch);
 		if (m_doTempProfile || isSlowProfile) {
 			const std::string path = FileSystem::JoinPathBelow(FileSystem::userFiles.GetRoot(),
 				m_tempProfilePath.empty() ? m_profilerPath : m_tempProfilePath);
@@ -227,6 +276,29 @@ void Application::Run()
 				else
 					Profiler::dumpzones(path.c_str());
 			}
+
+			OnProfileWritten(path);
+		}
+
+		// write out the capture when it has all its frames, or the ring after a
+		// hitch; without a ring a hitch can start a capture of the frames after it
+		const bool isCaptureDone = m_captureFrames > 0 && --m_captureFrames == 0;
+		const bool isRingHitch = isHitch && !m_captureFrames && m_captureRing > 0.0 &&
+			thisTime - m_lastCaptureDump > m_captureRing;
+		const bool isCaptureHitch = isHitch && !m_captureFrames && m_captureRing <= 0.0 && m_hitchCaptureFrames > 0 &&
+			thisTime - m_lastCaptureDump > 1.0;
+		if (isCaptureDone || isRingHitch) {
+			const std::string path = FileSystem::JoinPathBelow(FileSystem::userFiles.GetRoot(),
+				isCaptureDone ? m_capturePath : m_profilerPath);
+			Profiler::capturedump(path.c_str());
+			m_lastCaptureDump = thisTime;
+
+			if (isCaptureDone)
+				SetProfileCaptureRing(m_captureRing);
+
+			OnProfileWritten(path);
+		} else if (isCaptureHitch) {
+			RequestProfileCapture(m_hitchCaptureFrames);
 		}
 
 		// reset the profiler at the end of the frame
@@ -5,6 +5,7 @@
 
 #include "RefCounted.h"
 
+#include <cstdint>
 #include <memory>
 #include <queue>
 #include <string>
@@ -87,9 +88,26 @@ public:
 
 	JobQueue *GetSyncJobQueue();
 	JobQueue *GetAsyncJobQueue();
+	// Run up to count synchronous jobs now rather than in a later frame, and
+	// finish them; returns the number run
+	uint32_t RunSyncJobs(uint32_t count = 1);
 
 	void RequestProfileFrame(const std::string &path = "");
 
+	// Capture the zones of every thread, job lifetimes and GPU timer scopes
+	// over the next numFrames frames and write them as a Chrome trace (for
+	// chrome://tracing or ui.perfetto.dev) to the profiler directory
+	void RequestProfileCapture(int numFrames, const std::string &path = "");
+
+	// Limit the time spent per frame delivering finished job results on the
+	// main thread. A budget of zero (the default) processes all finished jobs.
+	void SetJobFinishBudget(double milliseconds) { m_jobFinishBudget = milliseconds; }
+	double GetJobFinishBudget() const { return m_jobFinishBudget; }
+
+	// Frames that take longer than this are hitches, see OnHitch()
+	void SetHitchThreshold(double milliseconds) { m_hitchThreshold = milliseconds * 1e-3; }
+	double GetHitchThreshold() const { return m_hitchThreshold * 1e3; }
+
 protected:
 	// Hooks for inheriting classes to add their own behaviors to.
 
@@ -114,6 +132,13 @@ protected:
 	// Runs at the bottom of each frame.
 	virtual void EndFrame() {}
 
+	// Runs after a frame profile has been written to the given directory
+	virtual void OnProfileWritten(const std::string &path) {}
+
+	// Runs at the end of a frame that took longer than the hitch threshold,
+	// before the profiler is reset
+	virtual void OnHitch(double frameMs) {}
+
 	// Request the application quit immediately at the end of the update,
 	// ignoring all queued lifecycles
 	void RequestQuit() { m_applicationRunning = false; }
@@ -123,6 +148,11 @@ protected:
 	void SetProfileSlowFrames(bool enabled) { m_doSlowProfile = enabled; }
 	void SetProfileZones(bool enabled) { m_profileZones = enabled; }
 	void SetProfileTrace(bool enabled) { m_profileTrace = enabled; }
+	// Keep a capture of the last few seconds running all the time, and write
+	// it out after any frame over the hitch threshold
+	void SetProfileCaptureRing(double seconds);
+	// Without a ring, capture this many frames after a hitch (0 to not)
+	void SetProfileHitchCapture(int numFrames) { m_hitchCaptureFrames = numFrames; }
 
 private:
 	bool StartLifecycle();
@@ -133,11 +163,18 @@ private:
 	bool m_doSlowProfile = false;
 	bool m_profileZones = false;
 	bool m_profileTrace = false;
+	int m_captureFrames = 0;
+	int m_hitchCaptureFrames = 0;
+	double m_captureRing = 0.0;
+	double m_lastCaptureDump = 0.0;
 	float m_deltaTime = 0.f;
 	double m_totalTime = 0.f;
+	double m_jobFinishBudget = 0.0;
+	double m_hitchThreshold = 0.100;
 
 	std::string m_profilerPath;
 	std::string m_tempProfilePath;
+	std::string m_capturePath;
 
 	// The lifecycle we're actually running right now
 	RefCountedPtr<Lifecycle> m_activeLifecycle;
@@ -0,0 +1,125 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "FrameArena.h"
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+
+namespace {
+	// the standard blocks are kept for the next frames, the oversized ones
+	// only until the half they were allocated in is reused
+	struct Half {
+		std::vector<std::unique_ptr<char[]>> blocks;
+		std::vector<std::unique_ptr<char[]>> oversized;
+		size_t block = 0;
+		size_t offset = 0;
+
+		void Rewind()
+		{
+			FreeOversized();
+			block = 0;
+			offset = 0;
+		}
+
+		void FreeOversized();
+		void *Allocate(size_t size, size_t alignment);
+	};
+
+	std::atomic<uint32_t> s_frame{ 0 };
+	std::atomic<uint64_t> s_numBlockAllocs{ 0 };
+	std::atomic<size_t> s_capacity{ 0 };
+
+	struct ThreadArena {
+		Half halves[2];
+		uint32_t current = 0;
+		uint32_t frame = 0;
+
+		~ThreadArena()
+		{
+			for (Half &half : halves) {
+				half.FreeOversized();
+				s_capacity.fetch_sub(half.blocks.size() * FrameArena::BLOCK_SIZE, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	thread_local ThreadArena t_arena;
+
+	void Half::FreeOversized()
+	{
+		size_t bytes = 0;
+		for (auto &block : oversized)
+			bytes += reinterpret_cast<size_t *>(block.get())[0];
+		s_capacity.fetch_sub(bytes, std::memory_order_relaxed);
+		oversized.clear();
+	}
+
+	void *Half::Allocate(size_t size, size_t alignment)
+	{
+		if (size + alignment > FrameArena::BLOCK_SIZE) {
+			// the size of the block goes in front of it, for the stats
+			const size_t total = sizeof(size_t) + alignment + size;
+			oversized.emplace_back(new char[total]);
+			reinterpret_cast<size_t *>(oversized.back().get())[0] = total;
+			s_numBlockAllocs.fetch_add(1, std::memory_order_relaxed);
+			s_capacity.fetch_add(total, std::memory_order_relaxed);
+
+			const uintptr_t start = reinterpret_cast<uintptr_t>(oversized.back().get()) + sizeof(size_t);
+			return reinterpret_cast<void *>((start + alignment - 1) & ~uintptr_t(alignment - 1));
+		}
+
+		while (true) {
+			if (block == blocks.size()) {
+				blocks.emplace_back(new char[FrameArena::BLOCK_SIZE]);
+				s_numBlockAllocs.fetch_add(1, std::memory_order_relaxed);
+				s_capacity.fetch_add(FrameArena::BLOCK_SIZE, std::memory_order_relaxed);
+			}
+
+			const uintptr_t base = reinterpret_cast<uintptr_t>(blocks[block].get());
+			const uintptr_t start = (base + offset + alignment - 1) & ~uintptr_t(alignment - 1);
+			if (start + size <= base + FrameArena::BLOCK_SIZE) {
+				offset = start + size - base;
+				return reinterpret_cast<void *>(start);
+			}
+
+			block++;
+			offset = 0;
+		}
+	}
+} // namespace
+
+namespace FrameArena {
+
+	void NextFrame()
+	{
+		s_frame.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void *Allocate(size_t size, size_t alignment)
+	{
+		assert(alignment && (alignment & (alignment - 1)) == 0);
+		ThreadArena &arena = t_arena;
+
+		// a thread only notices the new frame when it next allocates; what
+		// it allocated two frames ago is reused, or both halves if it has
+		// been longer
+		const uint32_t frame = s_frame.load(std::memory_order_relaxed);
+		if (frame != arena.frame) {
+			if (frame - arena.frame > 1)
+				arena.halves[arena.current].Rewind();
+			arena.current ^= 1;
+			arena.halves[arena.current].Rewind();
+			arena.frame = frame;
+		}
+
+		return arena.halves[arena.current].Allocate(size, alignment);
+	}
+
+	Stats GetStats()
+	{
+		return { s_numBlockAllocs.load(std::memory_order_relaxed), s_capacity.load(std::memory_order_relaxed) };
+	}
+
+} // namespace FrameArena
@@ -0,0 +1,61 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Scratch memory for data that only lives for a frame, so the containers
+// built and thrown away every frame don't go through the heap.
+//
+// Each thread allocates from its own arena by bumping a pointer, without
+// locks. The arenas are double-buffered: what is allocated in one frame stays
+// valid until the end of the next one, and is reused after that. Nothing is
+// freed one allocation at a time; keep to locals and to containers that are
+// thrown away within the frame, not members that can go unused for a frame.
+namespace FrameArena {
+
+	// the size of the blocks an arena grows by; bigger allocations get a
+	// block of their own, freed when the arena is reused
+	constexpr size_t BLOCK_SIZE = 256 * 1024;
+
+	struct Stats {
+		// blocks allocated from the heap by all the arenas, ever
+		uint64_t numBlockAllocs;
+		// held in blocks by all the arenas
+		size_t capacity;
+	};
+
+	// Call from the main thread at the start of each frame
+	void NextFrame();
+
+	// Memory valid until the end of the next frame; safe to call from any thread
+	void *Allocate(size_t size, size_t alignment);
+
+	Stats GetStats();
+
+} // namespace FrameArena
+
+// An allocator for standard containers out of the frame arena
+template <typename T>
+class FrameAllocator {
+public:
+	typedef T value_type;
+
+	FrameAllocator() = default;
+	template <typename U>
+	FrameAllocator(const FrameAllocator<U> &) {}
+
+	T *allocate(size_t n) { return static_cast<T *>(FrameArena::Allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T *, size_t) {}
+
+	template <typename U>
+	bool operator==(const FrameAllocator<U> &) const { return true; }
+	template <typename U>
+	bool operator!=(const FrameAllocator<U> &) const { return false; }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
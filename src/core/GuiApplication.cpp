@@ -147,11 +147,16 @@ void GuiApplication::SetupProfiler(IniConfig *config)
 	bool profileSlow   = config->Int("ProfileSlowFrames", 0);
 	bool profileZones  = config->Int("ProfilerZoneOutput", 0);
 	bool profileTraces = config->Int("ProfilerTraceOutput", 0);
+	double captureSeconds = config->Float("ProfilerCaptureSeconds", 0.0f);
+	int hitchCaptureFrames = config->Int("ProfilerHitchCaptureFrames", 0);
 
 	SetProfilerPath("profiler/");
 	SetProfileSlowFrames(profileSlow);
 	SetProfileZones(profileZones || profileTraces);
 	SetProfileTrace(profileTraces);
+	SetProfileCaptureRing(captureSeconds);
+	SetProfileHitchCapture(hitchCaptureFrames);
+	SetHitchThreshold(config->Float("HitchThresholdMs", 100.0f));
 }
 
 Graphics::Renderer *GuiApplication::StartupRenderer(IniConfig *config, bool hidden, bool resizable)
@@ -186,6 +191,9 @@ Graphics::Renderer *GuiApplication::StartupRenderer(IniConfig *config, bool hidd
 	videoSettings.useAnisotropicFiltering = (config->Int("UseAnisotropicFiltering") != 0);
 	videoSettings.enableDebugMessages = (config->Int("EnableGLDebug") != 0);
 	videoSettings.gl3ForwardCompatible = (config->Int("GL3ForwardCompatible") != 0);
+	videoSettings.shaderCacheMB = config->Int("ShaderCacheMB");
+	videoSettings.vramBudgetMB = config->Int("VRAMBudgetMB");
+	videoSettings.uploadThread = (config->Int("GLUploadThread") != 0);
 	videoSettings.iconFile = OS::GetIconFilename();
 	videoSettings.title = m_applicationTitle.c_str();
 
@@ -0,0 +1,113 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "JsonArena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <map>
+#include <mutex>
+
+namespace {
+	// the blocks of every live arena, by start address, for telling arena
+	// memory from the heap when it's freed outside of its scope
+	std::atomic<int> s_numArenas{ 0 };
+	std::mutex s_blocksLock;
+	std::map<uintptr_t, uintptr_t> s_blocks;
+} // namespace
+
+thread_local JsonArena *JsonArena::s_current = nullptr;
+
+JsonArena::JsonArena() :
+	m_cursor(0),
+	m_end(0),
+	m_nextBlockSize(FIRST_BLOCK_SIZE),
+	m_used(0),
+	m_capacity(0)
+{
+	s_numArenas.fetch_add(1, std::memory_order_relaxed);
+}
+
+JsonArena::~JsonArena()
+{
+	assert(s_current != this);
+	{
+		std::lock_guard<std::mutex> lock(s_blocksLock);
+		for (const auto &range : m_ranges)
+			s_blocks.erase(range.first);
+	}
+
+	for (char *block : m_blocks)
+		::operator delete(block);
+	s_numArenas.fetch_sub(1, std::memory_order_relaxed);
+}
+
+JsonArena::Scope::Scope(JsonArena &arena) :
+	m_previous(s_current)
+{
+	s_current = &arena;
+}
+
+JsonArena::Scope::~Scope()
+{
+	s_current = m_previous;
+}
+
+void JsonArena::AddBlock(size_t minSize)
+{
+	const size_t size = std::max(m_nextBlockSize, minSize);
+	m_nextBlockSize = std::min(m_nextBlockSize * 2, MAX_BLOCK_SIZE);
+
+	char *block = static_cast<char *>(::operator new(size));
+	m_blocks.push_back(block);
+	m_capacity += size;
+
+	const std::pair<uintptr_t, uintptr_t> range(reinterpret_cast<uintptr_t>(block), reinterpret_cast<uintptr_t>(block) + size);
+	m_ranges.insert(std::upper_bound(m_ranges.begin(), m_ranges.end(), range), range);
+	{
+		std::lock_guard<std::mutex> lock(s_blocksLock);
+		s_blocks.emplace(range.first, range.second);
+	}
+
+	m_cursor = range.first;
+	m_end = range.second;
+}
+
+void *JsonArena::Allocate(size_t size, size_t alignment)
+{
+	assert(alignment && (alignment & (alignment - 1)) == 0);
+	uintptr_t start = (m_cursor + alignment - 1) & ~uintptr_t(alignment - 1);
+	if (!m_cursor || start + size > m_end) {
+		// blocks come from operator new, aligned for anything a Json holds
+		AddBlock(size);
+		start = m_cursor;
+	}
+
+	m_cursor = start + size;
+	m_used += size;
+	return reinterpret_cast<void *>(start);
+}
+
+bool JsonArena::Contains(uintptr_t addr) const
+{
+	auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), std::make_pair(addr, UINTPTR_MAX));
+	return it != m_ranges.begin() && addr < (--it)->second;
+}
+
+// static
+bool JsonArena::Owns(const void *ptr)
+{
+	// nothing to look up outside of saving and loading
+	if (!ptr || !s_numArenas.load(std::memory_order_relaxed))
+		return false;
+
+	// trees are mostly freed in the scope they were built in
+	const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+	if (s_current && s_current->Contains(addr))
+		return true;
+
+	std::lock_guard<std::mutex> lock(s_blocksLock);
+	auto it = s_blocks.upper_bound(addr);
+	return it != s_blocks.begin() && addr < (--it)->second;
+}
@@ -0,0 +1,109 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Monotonic memory for the big Json trees of saved games. Building the tree
+// of a large universe makes millions of small node, array and object
+// allocations, and freeing them one by one takes nearly as long again.
+//
+// While a Scope is open on a thread, the Json values created by that thread
+// take their memory from the arena by bumping a pointer; freeing them is a
+// no-op, and the memory goes back in one go when the arena is destroyed.
+// Json values from the heap and from arenas can be mixed freely in a tree
+// and freed on any thread, but a value built from an arena must not outlive
+// it, so keep scopes to trees that are thrown away as a whole.
+//
+// Keys and string values are std::strings with their own allocator, but
+// most keys are short enough to be stored inside the string.
+class JsonArena {
+public:
+	JsonArena();
+	~JsonArena();
+
+	JsonArena(const JsonArena &) = delete;
+	JsonArena &operator=(const JsonArena &) = delete;
+
+	// Makes the Json values created on this thread come from the arena for
+	// the lifetime of the scope; scopes nest
+	class Scope {
+	public:
+		explicit Scope(JsonArena &arena);
+		~Scope();
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+	private:
+		JsonArena *m_previous;
+	};
+
+	// The arena of the innermost scope open on this thread, if any
+	static JsonArena *Current() { return s_current; }
+
+	void *Allocate(size_t size, size_t alignment);
+
+	// Whether the memory came from any arena still alive
+	static bool Owns(const void *ptr);
+
+	// bytes handed out, and held in blocks
+	size_t GetUsed() const { return m_used; }
+	size_t GetCapacity() const { return m_capacity; }
+
+private:
+	bool Contains(uintptr_t addr) const;
+	void AddBlock(size_t minSize);
+
+	// blocks start at this size and double up to the maximum; allocations
+	// that don't fit get a block of their own
+	static constexpr size_t FIRST_BLOCK_SIZE = 256 * 1024;
+	static constexpr size_t MAX_BLOCK_SIZE = 16 * 1024 * 1024;
+
+	static thread_local JsonArena *s_current;
+
+	std::vector<char *> m_blocks;
+	// [start, end) of each block, sorted by start
+	std::vector<std::pair<uintptr_t, uintptr_t>> m_ranges;
+	uintptr_t m_cursor;
+	uintptr_t m_end;
+	size_t m_nextBlockSize;
+	size_t m_used;
+	size_t m_capacity;
+};
+
+// The allocator of the Json type. It can't carry any state, as the Json
+// library default-constructs one whenever it needs it, so the arena comes
+// from the scope open on the allocating thread.
+template <typename T>
+class JsonAllocator {
+public:
+	typedef T value_type;
+
+	JsonAllocator() = default;
+	template <typename U>
+	JsonAllocator(const JsonAllocator<U> &) {}
+
+	T *allocate(size_t n)
+	{
+		if (JsonArena *arena = JsonArena::Current())
+			return static_cast<T *>(arena->Allocate(n * sizeof(T), alignof(T)));
+		return static_cast<T *>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T *ptr, size_t)
+	{
+		if (!JsonArena::Owns(ptr))
+			::operator delete(ptr);
+	}
+
+	template <typename U>
+	bool operator==(const JsonAllocator<U> &) const { return true; }
+	template <typename U>
+	bool operator!=(const JsonAllocator<U> &) const { return false; }
+};
@@ -5,6 +5,8 @@
 #include "lz4/lz4frame.h"
 #include "profiler/Profiler.h"
 #include <SDL_endian.h>
+#include <algorithm>
+#include <cstring>
 #include <functional>
 #include <memory>
 
@@ -68,6 +70,51 @@ std::string lz4::DecompressLZ4(const std::string_view data)
 	return out;
 }
 
+lz4::StreamDecompressor::StreamDecompressor(const std::string_view data) :
+	m_dctx(nullptr),
+	m_read(data.data()),
+	m_end(data.data() + data.size()),
+	m_nextLen(0)
+{
+	LZ4F_errorCode_t err = LZ4F_createDecompressionContext(&m_dctx, LZ4F_VERSION);
+	checkError<lz4::DecompressionFailedException>(err);
+
+	LZ4F_frameInfo_t frame = LZ4F_INIT_FRAMEINFO;
+	std::size_t read_len = data.size();
+	m_nextLen = LZ4F_getFrameInfo(m_dctx, &frame, m_read, &read_len);
+	if (LZ4F_isError(m_nextLen)) {
+		LZ4F_freeDecompressionContext(m_dctx);
+		checkError<lz4::DecompressionFailedException>(m_nextLen);
+	}
+	m_read += read_len;
+
+	m_buffer.reset(new char[BUFFER_LEN]);
+}
+
+lz4::StreamDecompressor::~StreamDecompressor()
+{
+	LZ4F_freeDecompressionContext(m_dctx);
+}
+
+std::string_view lz4::StreamDecompressor::Next()
+{
+	// a block can decompress to nothing, keep going until there's output
+	while (m_nextLen != 0) {
+		std::size_t read_len = m_end - m_read;
+		std::size_t write_len = BUFFER_LEN;
+		m_nextLen = LZ4F_decompress(m_dctx, m_buffer.get(), &write_len, m_read, &read_len, NULL);
+		checkError<lz4::DecompressionFailedException>(m_nextLen);
+		m_read += read_len;
+
+		if (write_len)
+			return std::string_view(m_buffer.get(), write_len);
+		if (m_nextLen != 0 && m_read == m_end)
+			throw lz4::DecompressionFailedException("truncated lz4 frame");
+	}
+
+	return std::string_view();
+}
+
 std::string lz4::CompressLZ4(const std::string_view data, const int lz4_preset)
 {
 	PROFILE_SCOPED()
@@ -83,3 +130,67 @@ std::string lz4::CompressLZ4(const std::string_view data, const int lz4_preset)
 
 	return std::string(out.get(), outSize);
 }
+
+lz4::StreamCompressor::StreamCompressor(WriteFn write, const int lz4_preset) :
+	m_write(write),
+	m_inputLen(0),
+	m_input(new char[BUFFER_LEN])
+{
+	LZ4F_preferences_t pref = LZ4F_INIT_PREFERENCES;
+	pref.compressionLevel = lz4_preset;
+
+	// enough for the frame header, or for a full input buffer and the end of
+	// the frame after it
+	m_outputCapacity = std::max<std::size_t>(LZ4F_compressBound(BUFFER_LEN, &pref), LZ4F_HEADER_SIZE_MAX);
+	m_output.reset(new char[m_outputCapacity]);
+
+	checkError<lz4::CompressionFailedException>(LZ4F_createCompressionContext(&m_cctx, LZ4F_VERSION));
+
+	const std::size_t outSize = LZ4F_compressBegin(m_cctx, m_output.get(), m_outputCapacity, &pref);
+	if (LZ4F_isError(outSize)) {
+		LZ4F_freeCompressionContext(m_cctx);
+		throw lz4::CompressionFailedException(LZ4F_getErrorName(outSize));
+	}
+
+	m_write(std::string_view(m_output.get(), outSize));
+}
+
+lz4::StreamCompressor::~StreamCompressor()
+{
+	LZ4F_freeCompressionContext(m_cctx);
+}
+
+void lz4::StreamCompressor::CompressInput()
+{
+	const std::size_t outSize = LZ4F_compressUpdate(m_cctx, m_output.get(), m_outputCapacity, m_input.get(), m_inputLen, NULL);
+	checkError<lz4::CompressionFailedException>(outSize);
+	m_inputLen = 0;
+
+	// lz4 keeps partial blocks to itself
+	if (outSize)
+		m_write(std::string_view(m_output.get(), outSize));
+}
+
+void lz4::StreamCompressor::Write(std::string_view data)
+{
+	while (!data.empty()) {
+		const std::size_t len = std::min(data.size(), BUFFER_LEN - m_inputLen);
+		memcpy(m_input.get() + m_inputLen, data.data(), len);
+		m_inputLen += len;
+		data.remove_prefix(len);
+
+		if (m_inputLen == BUFFER_LEN)
+			CompressInput();
+	}
+}
+
+void lz4::StreamCompressor::Finish()
+{
+	PROFILE_SCOPED()
+	if (m_inputLen)
+		CompressInput();
+
+	const std::size_t outSize = LZ4F_compressEnd(m_cctx, m_output.get(), m_outputCapacity, NULL);
+	checkError<lz4::CompressionFailedException>(outSize);
+	m_write(std::string_view(m_output.get(), outSize));
+}
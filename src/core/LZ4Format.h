@@ -3,11 +3,15 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 
+struct LZ4F_cctx_s;
+struct LZ4F_dctx_s;
+
 namespace lz4 {
 
 	struct DecompressionFailedException : public std::runtime_error {
@@ -25,8 +29,64 @@ namespace lz4 {
 	// If the input fails format checks or checksum then it will throw an exception.
 	std::string DecompressLZ4(const std::string_view data);
 
+	// Decompresses lz4 format data one block at a time, so the whole output
+	// never has to be in memory at once. The data must outlive it.
+	// Throws DecompressionFailedException like DecompressLZ4.
+	class StreamDecompressor {
+	public:
+		explicit StreamDecompressor(const std::string_view data);
+		~StreamDecompressor();
+
+		StreamDecompressor(const StreamDecompressor &) = delete;
+		StreamDecompressor &operator=(const StreamDecompressor &) = delete;
+
+		// The next block of output, valid until the next call; empty at the
+		// end of the frame
+		std::string_view Next();
+
+	private:
+		static constexpr std::size_t BUFFER_LEN = 1 << 16;
+
+		LZ4F_dctx_s *m_dctx;
+		const char *m_read;
+		const char *m_end;
+		std::size_t m_nextLen;
+		std::unique_ptr<char[]> m_buffer;
+	};
+
 	// Compresses a block of data according to the lz4 framing format.
 	// If compression fails it throws an exception.
 	// lz4_speed is the compression preset; 0 = default compression, 3-12 = HC compression
 	std::string CompressLZ4(const std::string_view data, const int lz4_preset);
+
+	// Compresses data given to it in any number of pieces into a single lz4
+	// frame, handing the output to write a block at a time, so neither the
+	// input nor the output has to be in memory at once.
+	// Throws CompressionFailedException like CompressLZ4.
+	class StreamCompressor {
+	public:
+		using WriteFn = std::function<void(std::string_view)>;
+
+		StreamCompressor(WriteFn write, const int lz4_preset);
+		~StreamCompressor();
+
+		StreamCompressor(const StreamCompressor &) = delete;
+		StreamCompressor &operator=(const StreamCompressor &) = delete;
+
+		void Write(std::string_view data);
+		// Writes out the rest of the frame; nothing can be written after it
+		void Finish();
+
+	private:
+		static constexpr std::size_t BUFFER_LEN = 1 << 16;
+
+		void CompressInput();
+
+		LZ4F_cctx_s *m_cctx;
+		WriteFn m_write;
+		std::size_t m_inputLen;
+		std::unique_ptr<char[]> m_input;
+		std::size_t m_outputCapacity;
+		std::unique_ptr<char[]> m_output;
+	};
 } // namespace lz4
@@ -0,0 +1,90 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "MemoryTag.h"
+
+namespace {
+	MemoryTag::Counter s_counters[MemoryTag::MAX_TAGS];
+
+	thread_local MemoryTag::Tag s_current = MemoryTag::UNTAGGED;
+} // namespace
+
+namespace MemoryTag {
+
+	void Counter::Allocate(size_t bytes)
+	{
+		m_numAllocs.fetch_add(1, std::memory_order_relaxed);
+		const size_t inUse = m_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		size_t highWater = m_highWater.load(std::memory_order_relaxed);
+		while (inUse > highWater && !m_highWater.compare_exchange_weak(highWater, inUse, std::memory_order_relaxed)) {
+		}
+	}
+
+	void Counter::Free(size_t bytes)
+	{
+		m_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+	}
+
+	Stats Counter::GetStats() const
+	{
+		return { m_bytes.load(std::memory_order_relaxed),
+			m_highWater.load(std::memory_order_relaxed),
+			m_numAllocs.load(std::memory_order_relaxed) };
+	}
+
+	void Counter::ResetHighWater()
+	{
+		m_highWater.store(m_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	const char *GetName(Tag tag)
+	{
+		switch (tag) {
+		case UNTAGGED: return "Untagged";
+		case TERRAIN: return "Terrain";
+		case MODELS: return "Models";
+		case GALAXY: return "Galaxy";
+		case LUA: return "Lua";
+		case TEXTURES: return "Textures";
+		default: return "?";
+		}
+	}
+
+	void Allocate(Tag tag, size_t bytes)
+	{
+		s_counters[tag].Allocate(bytes);
+	}
+
+	void Free(Tag tag, size_t bytes)
+	{
+		s_counters[tag].Free(bytes);
+	}
+
+	Stats GetStats(Tag tag)
+	{
+		return s_counters[tag].GetStats();
+	}
+
+	void ResetHighWater()
+	{
+		for (Counter &counter : s_counters)
+			counter.ResetHighWater();
+	}
+
+	Tag GetCurrent(Tag fallback)
+	{
+		return s_current == UNTAGGED ? fallback : s_current;
+	}
+
+	Scope::Scope(Tag tag) :
+		m_previous(s_current)
+	{
+		s_current = tag;
+	}
+
+	Scope::~Scope()
+	{
+		s_current = m_previous;
+	}
+
+} // namespace MemoryTag
@@ -0,0 +1,78 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Memory accounting by subsystem, to tell where the memory of a long session
+// goes. The allocators and caches of each subsystem report what they hold
+// with Allocate() and Free(); nothing is hooked into operator new, so an
+// untagged allocation simply isn't counted.
+//
+// A Scope sets the tag of the current thread, for hooks that can be reached
+// from more than one subsystem: a texture loaded for a model is counted with
+// the models, one loaded for the UI with the textures.
+namespace MemoryTag {
+
+	enum Tag : uint8_t {
+		UNTAGGED,
+		TERRAIN, // GeoPatch vertex data and the terrain meshes
+		MODELS, // cached models and what they load
+		GALAXY, // sectors and star systems known to the galaxy caches
+		LUA, // the Lua heap
+		TEXTURES, // textures, in GPU memory
+		MAX_TAGS
+	};
+
+	struct Stats {
+		size_t bytes;
+		size_t highWater;
+		uint64_t numAllocs;
+	};
+
+	// The totals behind one tag, for other accounting (see Graphics::GPUMemory)
+	// to keep its own
+	class Counter {
+	public:
+		void Allocate(size_t bytes);
+		void Free(size_t bytes);
+		Stats GetStats() const;
+		void ResetHighWater();
+
+	private:
+		std::atomic<size_t> m_bytes{ 0 };
+		std::atomic<size_t> m_highWater{ 0 };
+		std::atomic<uint64_t> m_numAllocs{ 0 };
+	};
+
+	const char *GetName(Tag tag);
+
+	// Safe to call from any thread
+	void Allocate(Tag tag, size_t bytes);
+	void Free(Tag tag, size_t bytes);
+
+	Stats GetStats(Tag tag);
+
+	// Lowers the high-water marks to the current totals, so that the next
+	// peak can be told apart from the last
+	void ResetHighWater();
+
+	// The tag of the innermost Scope on this thread, or fallback if there is none
+	Tag GetCurrent(Tag fallback = UNTAGGED);
+
+	class Scope {
+	public:
+		explicit Scope(Tag tag);
+		~Scope();
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+	private:
+		Tag m_previous;
+	};
+
+} // namespace MemoryTag
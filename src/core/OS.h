@@ -8,6 +8,7 @@
  * raising a message dialog
  */
 
+#include <cstdint>
 #include <string>
 
 namespace OS {
@@ -40,6 +41,15 @@ namespace OS {
 
 	// Mark application as DPI-aware
 	void SetDPIAware();
+
+	// CPU time in milliseconds used by the whole process, and by the calling
+	// thread, since they started
+	double GetProcessCPUTime();
+	double GetThreadCPUTime();
+
+	// bytes the process has read from storage since it started, not counting
+	// what came from the OS file cache where it can tell; 0 where unsupported
+	uint64_t GetProcessBytesRead();
 } // namespace OS
 
 #endif
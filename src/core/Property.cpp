@@ -6,6 +6,9 @@
 #include "Json.h"
 #include "JsonUtils.h"
 
+#include <algorithm>
+#include <cassert>
+
 PropertyMapWrapper::PropertyMapWrapper(PropertyMap *m) :
 	m_map(m)
 {
@@ -129,21 +132,38 @@ PropertyMap::iterator PropertyMap::iterator::operator++(int)
 
 // =============================================================================
 
+// the maps with changes waiting for the next dispatch, and the ones left to
+// go through in the current one
+static std::vector<PropertyMap *> s_changedMaps;
+static std::vector<PropertyMap *> s_dispatchMaps;
+// the map calling its observers, reset if one of them destroys it
+static PropertyMap *s_dispatching = nullptr;
+
 PropertyMap::PropertyMap() :
 	m_keys(),
 	m_values(),
-	m_entries(0)
+	m_entries(0),
+	m_nextObserverId(1)
 {}
 
 PropertyMap::PropertyMap(uint32_t size) :
 	m_keys(size),
 	m_values(size),
-	m_entries(0)
+	m_entries(0),
+	m_nextObserverId(1)
 {}
 
 PropertyMap::~PropertyMap()
 {
+	// destroyed by one of its own observers, which runs from a copy
+	if (s_dispatching == this)
+		s_dispatching = nullptr;
+	m_observers.clear();
 	Clear();
+
+	if (!m_changed.empty())
+		s_changedMaps.erase(std::remove(s_changedMaps.begin(), s_changedMaps.end(), this), s_changedMaps.end());
+	s_dispatchMaps.erase(std::remove(s_dispatchMaps.begin(), s_dispatchMaps.end(), this), s_dispatchMaps.end());
 }
 
 // =============================================================================
@@ -212,8 +232,11 @@ void PropertyMap::Clear()
 {
 	for (uint32_t idx = 0; idx < m_keys.size(); idx++) {
 		uint32_t probed_key = m_keys[idx];
-		if (probed_key)
+		if (probed_key) {
+			if (!m_observers.empty())
+				MarkChanged(m_values[idx].first);
 			m_values[idx] = {};
+		}
 	}
 
 	if (m_keys.size())
@@ -251,3 +274,77 @@ void PropertyMap::Grow()
 	std::swap(m_keys, newMap.m_keys);
 	std::swap(m_values, newMap.m_values);
 }
+
+// =============================================================================
+
+uint32_t PropertyMap::Observe(std::string_view key, ChangeCallback callback)
+{
+	const uint32_t id = m_nextObserverId++;
+	m_observers.push_back({ id, key.empty() ? 0 : hash_32_fnv1a(key.data(), key.size()), std::move(callback) });
+	return id;
+}
+
+void PropertyMap::Unobserve(uint32_t id)
+{
+	auto it = std::find_if(m_observers.begin(), m_observers.end(), [=](const Observer &o) { return o.id == id; });
+	if (it == m_observers.end())
+		return;
+
+	// the observers being called are only removed once they are all done
+	if (s_dispatching == this)
+		it->callback = nullptr;
+	else
+		m_observers.erase(it);
+}
+
+void PropertyMap::MarkChanged(const StringName &key)
+{
+	for (const StringName &changed : m_changed) {
+		if (changed.hash() == key.hash())
+			return;
+	}
+
+	if (m_changed.empty())
+		s_changedMaps.push_back(this);
+	m_changed.push_back(key);
+}
+
+void PropertyMap::Dispatch()
+{
+	// the keys set by the observers go to the next dispatch
+	std::vector<StringName> changed;
+	changed.swap(m_changed);
+
+	s_dispatching = this;
+	for (const StringName &key : changed) {
+		for (size_t idx = 0; idx < m_observers.size(); idx++) {
+			const Observer &observer = m_observers[idx];
+			if (!observer.callback || (observer.key && observer.key != key.hash()))
+				continue;
+
+			// the observer may remove itself or add others
+			ChangeCallback callback = observer.callback;
+			callback(key, Get(key));
+			if (s_dispatching != this)
+				return; // an observer destroyed the map
+		}
+	}
+	s_dispatching = nullptr;
+
+	m_observers.erase(std::remove_if(m_observers.begin(), m_observers.end(), [](const Observer &o) { return !o.callback; }), m_observers.end());
+}
+
+// static
+void PropertyMap::DispatchChanges()
+{
+	assert(s_dispatchMaps.empty() && "PropertyMap::DispatchChanges is not reentrant");
+
+	// in the order the maps were first changed
+	s_dispatchMaps.swap(s_changedMaps);
+	std::reverse(s_dispatchMaps.begin(), s_dispatchMaps.end());
+	while (!s_dispatchMaps.empty()) {
+		PropertyMap *map = s_dispatchMaps.back();
+		s_dispatchMaps.pop_back();
+		map->Dispatch();
+	}
+}
@@ -11,6 +11,7 @@
 #include "vector2.h"
 #include "vector3.h"
 
+#include <functional>
 #include <string>
 #include <string_view>
 #include <type_traits>
@@ -167,6 +168,11 @@ void to_json(Json &obj, const Property &n);
  * Internally, a power-of-two based Robin-Hood hash map is used to associate
  * StringName keys with Property values with extremely low hashing and lookup
  * overhead.
+ *
+ * Observers are told about changes once per frame, not on every Set: the
+ * keys set since the last DispatchChanges are collected, and each observer
+ * of a key is called once with its value at the time of the dispatch.
+ * Like the rest of the map, this is main-thread only.
  */
 class PropertyMap : public RefCounted {
 public:
@@ -174,6 +180,8 @@ public:
 	using reference = const value_type &;
 	using pointer = const value_type *;
 
+	using ChangeCallback = std::function<void(const StringName &key, const Property &value)>;
+
 	struct iterator {
 		iterator(const PropertyMap *m, uint32_t i) :
 			map(m),
@@ -220,7 +228,12 @@ public:
 	const Property &Get(const StringName &str) const { return GetRef(str.hash()).second; }
 	const Property &Get(std::string_view str) const { return GetRef(hash_32_fnv1a(str.data(), str.size())).second; }
 
-	void Set(const StringName &key, Property &&prop) { SetRef(key.hash(), { key, std::move(prop) }); }
+	void Set(const StringName &key, Property &&prop)
+	{
+		if (!m_observers.empty())
+			MarkChanged(key);
+		SetRef(key.hash(), { key, std::move(prop) });
+	}
 	void Set(std::string_view str, Property &&prop) { Set(StringName(str), std::move(prop)); }
 
 	// Use template-based forwarding for older compilers which cannot convert e.g. int to Property&&
@@ -231,6 +244,15 @@ public:
 
 	void Clear();
 
+	// Observe the changes of one key, or of every key if the key is empty;
+	// returns the id to remove the observer with
+	uint32_t Observe(std::string_view key, ChangeCallback callback);
+	void Unobserve(uint32_t id);
+
+	// Call the observers of the keys set since the last dispatch, once for
+	// each key; called once per frame
+	static void DispatchChanges();
+
 	iterator begin() { return iterator{ this, 0 }; }
 	iterator end() { return iterator{ this, uint32_t(m_keys.size()) }; }
 	iterator cbegin() const { return iterator{ this, 0 }; }
@@ -245,9 +267,24 @@ private:
 	PropertyMap(uint32_t size);
 	void Grow();
 
+	void MarkChanged(const StringName &key);
+	void Dispatch();
+
+	struct Observer {
+		uint32_t id;
+		// 0 observes every key
+		uint32_t key;
+		ChangeCallback callback;
+	};
+
 	std::vector<uint32_t> m_keys;
 	std::vector<value_type> m_values;
 	uint32_t m_entries;
+
+	std::vector<Observer> m_observers;
+	uint32_t m_nextObserverId;
+	// the keys set since the last dispatch, only kept while observed
+	std::vector<StringName> m_changed;
 };
 
 inline auto PropertyMapWrapper::begin() { return m_map->begin(); }
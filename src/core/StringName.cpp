@@ -55,151 +55,218 @@ StringName &StringName::operator=(StringName &&rhs)
 
 StringName::StringData *StringName::make_data(const char *c, uint32_t s, uint32_t h)
 {
-	auto &entry = StringTable::Get()->FindOrCreate(h);
-	if (!entry) {
-		entry = new (std::malloc(sizeof(StringData) + s + 1)) StringData();
-		std::memcpy(entry->get(), c, s);
-		entry->get()[s] = '\0';
-	}
-
-	entry->ref();
-	return entry;
+	return StringTable::Get()->Intern(c, s, h);
 }
 
 // =============================================================================
 
-StringTable::Data *StringTable::Find(uint32_t key)
+StringTable::Table::Table(uint32_t size) :
+	mask(size - 1),
+	slots(new Slot[size])
 {
-	if (!key)
-		return nullptr;
-
-	uint8_t slot_dist = 0;
-	for (uint32_t idx = key;; idx++, slot_dist++) {
-		idx &= keys.size() - 1;
+	assert((size & mask) == 0);
 
-		uint32_t probed_key = keys[idx];
-		if (probed_key == key)
-			return &values[idx];
-
-		if (!probed_key || dist[idx] < slot_dist)
-			return nullptr;
+	for (uint32_t idx = 0; idx < size; idx++) {
+		slots[idx].key.store(0, std::memory_order_relaxed);
+		slots[idx].value.store(nullptr, std::memory_order_relaxed);
 	}
 }
 
-StringTable::Data *StringTable::Create(uint32_t key)
+// returns the slot holding this key, or the empty slot it would be stored in
+StringTable::Slot *StringTable::Table::FindSlot(uint32_t key) const
 {
-	if (entries > uint32_t(keys.size() * 0.9))
-		Grow();
-
-	uint8_t slot_dist = 0;
-	uint32_t ret = 0;
-	for (uint32_t idx = key;; idx++, slot_dist++) {
-		idx &= keys.size() - 1;
+	for (uint32_t idx = key;; idx++) {
+		Slot &slot = slots[idx & mask];
 
-		uint32_t probed_key = keys[idx];
-		if (probed_key == key)
-			return &values[idx];
+		uint32_t probed_key = slot.key.load(std::memory_order_acquire);
+		if (probed_key == key || !probed_key)
+			return &slot;
+	}
+}
 
-		if (!probed_key || dist[idx] < slot_dist) {
-			ret = idx;
-			break;
-		}
+StringTable::StringTable(uint32_t size)
+{
+	// at least a few slots per shard so the load factor limit can be met
+	uint32_t shard_size = 16;
+	while (shard_size * NUM_SHARDS < size)
+		shard_size *= 2;
+
+	for (Shard &shard : m_shards) {
+		shard.owned.reset(new Table(shard_size));
+		shard.table.store(shard.owned.get(), std::memory_order_release);
 	}
+}
 
-	StringTable::Data cached_value = {};
-	for (uint32_t idx = ret;; idx++, slot_dist++) {
-		idx &= keys.size() - 1;
-
-		uint32_t probed_key = keys[idx];
-		if (!probed_key || dist[idx] < slot_dist) {
-			std::swap(keys[idx], key);
-			std::swap(dist[idx], slot_dist);
-			std::swap(values[idx], cached_value);
-			if (!probed_key)
-				break;
+StringTable::~StringTable()
+{
+	for (Shard &shard : m_shards) {
+		Table *table = shard.owned.get();
+		for (uint32_t idx = 0; idx <= table->mask; idx++) {
+			if (Data data = table->slots[idx].value.load(std::memory_order_relaxed))
+				std::free(data);
 		}
+
+		for (auto &retired : shard.retiredData)
+			for (Data data : retired)
+				std::free(data);
 	}
+}
+
+size_t StringTable::Size() const
+{
+	size_t size = 0;
+	for (const Shard &shard : m_shards)
+		size += shard.entries.load(std::memory_order_relaxed);
 
-	entries++;
-	return &values[ret];
+	return size;
 }
 
-void StringTable::Erase(uint32_t key)
+size_t StringTable::Capacity() const
 {
-	uint8_t slot_dist = 0;
-	for (uint32_t idx = key;; idx++, slot_dist++) {
-		idx &= keys.size() - 1;
-
-		uint32_t probed_key = keys[idx];
-		if (probed_key == key) {
-			entries--;
-
-			// backshift all following entries
-			for (uint32_t jdx = idx + 1;; idx++, jdx++) {
-				idx &= keys.size() - 1;
-				jdx &= keys.size() - 1;
-
-				// stopcode, no need to continue swapping
-				if (!keys[jdx] || !dist[jdx]) {
-					keys[idx] = 0;
-					dist[idx] = 0;
-					values[idx] = nullptr;
-					return;
-				} else {
-					keys[idx] = keys[jdx];
-					dist[idx] = dist[jdx] - 1;
-					values[idx] = values[jdx];
-				}
-			}
-		}
+	size_t capacity = 0;
+	for (const Shard &shard : m_shards)
+		capacity += shard.table.load(std::memory_order_acquire)->mask + 1;
 
-		if (!probed_key || dist[idx] < slot_dist)
-			return;
-	}
+	return capacity;
 }
 
-void StringTable::Reclaim(bool force)
+StringTable::Data StringTable::Find(uint32_t key) const
 {
-	m_reclaimClock.SoftStop();
-	if (m_reclaimClock.seconds() < 15.0 && !force)
-		return;
+	key = SlotKey(key);
 
-	m_reclaimClock.SoftReset();
-	for (uint32_t idx = 0; idx < keys.size(); idx++) {
-		uint32_t probed_key = keys[idx];
-
-		// the refcount can be decremented to zero from another thread,
-		// and it can be incremented on another thread as long as it is >0
-		// but only this thread can increment it from zero
-		if (probed_key && !values[idx]->get_ref()) {
-			Erase(probed_key);
+	const Table *table = GetShard(key).table.load(std::memory_order_acquire);
+	const Slot *slot = table->FindSlot(key);
+
+	// the value is always stored before the key is published
+	if (slot->key.load(std::memory_order_acquire) != key)
+		return nullptr;
+
+	return slot->value.load(std::memory_order_acquire);
+}
+
+StringTable::Data StringTable::Intern(const char *str, uint32_t size, uint32_t key)
+{
+	key = SlotKey(key);
+
+	// fast path: the string already exists and is referenced elsewhere
+	Data data = Find(key);
+	if (data && data->try_ref())
+		return data;
+
+	Shard &shard = GetShard(key);
+	std::lock_guard<std::mutex> lock(shard.lock);
+
+	Slot *slot = shard.table.load(std::memory_order_relaxed)->FindSlot(key);
+	if (slot->key.load(std::memory_order_relaxed)) {
+		// reclaiming only happens with the shard lock held, so it is safe to
+		// revive an unreferenced string here
+		data = slot->value.load(std::memory_order_relaxed);
+		if (data) {
+			data->ref();
+			return data;
+		}
+	} else {
+		Table *table = shard.table.load(std::memory_order_relaxed);
+		if (shard.usedSlots + 1 > (table->mask + 1) / 4 * 3) {
+			Grow(shard);
+			slot = shard.table.load(std::memory_order_relaxed)->FindSlot(key);
 		}
 	}
+
+	data = new (std::malloc(sizeof(StringName::StringData) + size + 1)) StringName::StringData();
+	std::memcpy(data->get(), str, size);
+	data->get()[size] = '\0';
+	data->refcount.store(1, std::memory_order_relaxed);
+
+	slot->value.store(data, std::memory_order_release);
+	if (!slot->key.load(std::memory_order_relaxed)) {
+		slot->key.store(key, std::memory_order_release);
+		shard.usedSlots++;
+	}
+
+	shard.entries.fetch_add(1, std::memory_order_relaxed);
+	return data;
 }
 
-void StringTable::Grow()
+void StringTable::Grow(Shard &shard)
 {
-	size_t new_size = keys.size() * 2;
-	dist = std::vector<uint8_t>(new_size);
+	Table *old_table = shard.owned.get();
+	uint32_t old_size = old_table->mask + 1;
+
+	// only grow if most of the used slots hold live strings, otherwise
+	// rebuilding at the same size is enough to get rid of reclaimed slots
+	uint32_t entries = shard.entries.load(std::memory_order_relaxed);
+	uint32_t new_size = entries * 2 >= old_size / 2 ? old_size * 2 : old_size;
+
+	std::unique_ptr<Table> new_table(new Table(new_size));
+	uint32_t used = 0;
+	for (uint32_t idx = 0; idx < old_size; idx++) {
+		Slot &old_slot = old_table->slots[idx];
+
+		Data data = old_slot.value.load(std::memory_order_relaxed);
+		if (!data)
+			continue;
+
+		uint32_t key = old_slot.key.load(std::memory_order_relaxed);
+		Slot *slot = new_table->FindSlot(key);
+		slot->value.store(data, std::memory_order_relaxed);
+		slot->key.store(key, std::memory_order_relaxed);
+		used++;
+	}
 
-	std::vector<uint32_t> old_keys(new_size);
-	std::swap(keys, old_keys);
+	shard.usedSlots = used;
+	shard.table.store(new_table.get(), std::memory_order_release);
 
-	std::vector<Data> old_values(new_size);
-	std::swap(values, old_values);
+	// readers may still be probing the old table
+	shard.retiredTables[0].push_back(std::move(shard.owned));
+	shard.owned = std::move(new_table);
+}
+
+void StringTable::Reclaim(bool force)
+{
+	std::lock_guard<std::mutex> reclaim_lock(m_reclaimLock);
 
-	for (uint32_t idx = 0; idx < old_keys.size(); idx++) {
-		uint32_t hash = old_keys[idx];
+	m_reclaimClock.SoftStop();
+	if (m_reclaimClock.seconds() < 15.0 && !force)
+		return;
 
-		if (hash)
-			*Create(hash) = old_values[idx];
+	m_reclaimClock.SoftReset();
+	for (Shard &shard : m_shards) {
+		std::lock_guard<std::mutex> lock(shard.lock);
+
+		// anything retired during the previous interval can no longer be
+		// seen by a reader
+		for (Data data : shard.retiredData[1])
+			std::free(data);
+		shard.retiredData[1] = std::move(shard.retiredData[0]);
+		shard.retiredData[0].clear();
+		shard.retiredTables[1] = std::move(shard.retiredTables[0]);
+		shard.retiredTables[0].clear();
+
+		Table *table = shard.owned.get();
+		for (uint32_t idx = 0; idx <= table->mask; idx++) {
+			Slot &slot = table->slots[idx];
+			Data data = slot.value.load(std::memory_order_relaxed);
+
+			// the refcount can be decremented to zero from any thread, but
+			// can only be incremented from zero with the shard lock held
+			if (data && !data->get_ref()) {
+				slot.value.store(nullptr, std::memory_order_relaxed);
+				shard.entries.fetch_sub(1, std::memory_order_relaxed);
+				shard.retiredData[0].push_back(data);
+			}
+		}
 	}
 }
 
 // Lookup is extremely cheap when the string table has low to medium occupancy,
-// and resize/rehash is extremely expensive. We trade some static memory
-// allocated once for each thread to make reallocations very unlikely.
+// and resize/rehash is expensive. We trade some static memory allocated once
+// to make reallocations very unlikely.
 
-// 16k slots == 208kb per thread
-thread_local StringTable tl_stringTable = StringTable(1 << 14);
-StringTable *StringTable::Get() { return &tl_stringTable; }
+// 16k slots == 256kb for the whole process. The table is intentionally never
+// destroyed: StringName objects with static storage may outlive it otherwise.
+StringTable *StringTable::Get()
+{
+	static StringTable *s_stringTable = new StringTable(1 << 14);
+	return s_stringTable;
+}
@@ -7,13 +7,15 @@
 #include "profiler/Profiler.h"
 
 #include <atomic>
+#include <memory>
+#include <mutex>
 #include <string_view>
 #include <type_traits>
 #include <vector>
 
 /*
  * Lightweight immutable refcounted string class. Internally stores string data
- * in the string object or in a thread-local hashtable for storage efficiency.
+ * in the string object or in a shared hashtable for storage efficiency.
  */
 class StringName {
 	static constexpr uint32_t MAX_SSO_SIZE = 15;
@@ -66,6 +68,16 @@ private:
 		uint32_t ref() const { return refcount.fetch_add(1) + 1; }
 		uint32_t unref() const { return refcount.fetch_sub(1) - 1; }
 		uint32_t get_ref() const { return refcount.load(); }
+
+		// take a reference only if the string is still referenced elsewhere;
+		// strings without references may be reclaimed at any time
+		bool try_ref() const
+		{
+			uint32_t count = refcount.load(std::memory_order_relaxed);
+			while (count && !refcount.compare_exchange_weak(count, count + 1))
+				;
+			return count != 0;
+		}
 	};
 
 	// handle interning and de-duplicating the string memory
@@ -80,49 +92,84 @@ private:
 };
 
 /*
- * Thread-local hash table for efficient storage of immutable strings.
- * StringTable uses a power-of-two based robin-hood hash table to keep
- * indexing overhead as small as possible.
+ * Process-wide hash table for efficient storage of immutable strings.
+ *
+ * The table is split into shards by the top bits of the hash. Each shard is
+ * an open-addressed, linearly probed table which is read without locking;
+ * inserting a new string or growing the table takes only that shard's lock.
+ *
+ * Entries are never moved or removed from a table while it is visible to
+ * readers: Reclaim() clears the value of unreferenced entries and Grow()
+ * publishes a new table. Retired strings and tables are freed by the
+ * following call to Reclaim(), so no lookup may take longer than the
+ * interval between two reclaims.
  */
 class StringTable {
 public:
 	using Data = StringName::StringData *;
 
-	StringTable(uint32_t size) :
-		keys(size),
-		dist(size),
-		values(size),
-		entries(0) {}
+	static constexpr uint32_t SHARD_BITS = 4;
+	static constexpr uint32_t NUM_SHARDS = 1 << SHARD_BITS;
+
+	StringTable(uint32_t size);
+	~StringTable();
 
 	static StringTable *Get();
 
-	size_t Size() const { return entries; }
-	size_t Capacity() const { return keys.size(); }
+	// number of strings currently interned
+	size_t Size() const;
+	size_t Capacity() const;
 
-	Data *Find(uint32_t key);
-	Data *Create(uint32_t key);
+	// Lock-free lookup of the string stored for this hash. The returned data
+	// is not referenced and may be reclaimed once it is unreferenced.
+	Data Find(uint32_t key) const;
 
-	Data &FindOrCreate(uint32_t key)
-	{
-		if (auto *ptr = Find(key))
-			return *ptr;
-
-		return *Create(key);
-	}
+	// Return the string stored for this hash with a reference added, creating
+	// it from the passed string data if not present.
+	Data Intern(const char *str, uint32_t size, uint32_t key);
 
-	void Erase(uint32_t key);
-
-	// Quiescent memory reclamation - call this function every 30s or so
-	// from the owning thread
+	// Quiescent memory reclamation - call this function every 15s or so
+	// from the main thread
 	void Reclaim(bool force = false);
 
 private:
-	void Grow();
+	struct Slot {
+		std::atomic<uint32_t> key;
+		std::atomic<Data> value;
+	};
+
+	struct Table {
+		Table(uint32_t size);
+
+		Slot *FindSlot(uint32_t key) const;
+
+		uint32_t mask;
+		std::unique_ptr<Slot[]> slots;
+	};
+
+	struct alignas(64) Shard {
+		std::mutex lock;
+		std::atomic<Table *> table;
+		std::unique_ptr<Table> owned;
+
+		// slots with a key assigned, including entries that were reclaimed
+		uint32_t usedSlots = 0;
+		std::atomic<uint32_t> entries{ 0 };
+
+		// memory waiting for the next and the current grace period to end
+		std::vector<Data> retiredData[2];
+		std::vector<std::unique_ptr<Table>> retiredTables[2];
+	};
+
+	static uint32_t SlotKey(uint32_t hash) { return hash ? hash : 1; }
+	Shard &GetShard(uint32_t key) { return m_shards[key >> (32 - SHARD_BITS)]; }
+	const Shard &GetShard(uint32_t key) const { return m_shards[key >> (32 - SHARD_BITS)]; }
+
+	void Grow(Shard &shard);
+
+	Shard m_shards[NUM_SHARDS];
 
-	std::vector<uint32_t> keys;
-	std::vector<uint8_t> dist;
-	std::vector<Data> values;
-	uint32_t entries;
+	std::mutex m_reclaimLock;
 	Profiler::Clock m_reclaimClock;
 };
 
@@ -5,11 +5,14 @@
 
 #include "JobQueue.h"
 #include "SDL_timer.h"
-#include "core/StringName.h"
 #include "fmt/format.h"
 #include "profiler/Profiler.h"
 #include <atomic_queue/atomic_queue.h>
+#include <algorithm>
 #include <atomic>
+#include <deque>
+#include <limits>
+#include <mutex>
 
 static constexpr size_t MAX_TASK_QUEUE_SIZE = 1024;
 static constexpr size_t MAX_JOB_QUEUE_SIZE = 1024;
@@ -20,6 +23,116 @@ static constexpr size_t MAX_SPIN_COUNT = 10000;
 class AsyncTaskQueueImpl : public atomic_queue::AtomicQueue2<Task *, MAX_TASK_QUEUE_SIZE> {};
 class AsyncJobQueueImpl : public atomic_queue::AtomicQueue2<Job *, MAX_JOB_QUEUE_SIZE> {};
 
+// Priority-ordered queue of background jobs, implemented as a binary heap.
+// Jobs are coarse-grained enough that a simple lock has no measurable cost,
+// and the lock allows the priority of queued jobs to be changed; the heap is
+// lazily rebuilt the next time a job is popped.
+class PriorityJobQueueImpl {
+public:
+	void push(Job *job)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_jobs.push_back(job);
+		if (!m_dirty)
+			std::push_heap(m_jobs.begin(), m_jobs.end(), &PriorityJobQueueImpl::RunsAfter);
+		m_size.store(m_jobs.size(), std::memory_order_release);
+	}
+
+	bool try_pop(Job *&job)
+	{
+		if (!was_size())
+			return false;
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_jobs.empty())
+			return false;
+
+		if (m_dirty) {
+			std::make_heap(m_jobs.begin(), m_jobs.end(), &PriorityJobQueueImpl::RunsAfter);
+			m_dirty = false;
+		}
+
+		std::pop_heap(m_jobs.begin(), m_jobs.end(), &PriorityJobQueueImpl::RunsAfter);
+		job = m_jobs.back();
+		m_jobs.pop_back();
+		m_size.store(m_jobs.size(), std::memory_order_release);
+		return true;
+	}
+
+	// change the priority of a job which may or may not still be queued
+	void set_priority(Job *job, Job::Priority priority, float key)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (job->GetPriority() == priority && job->GetPriorityKey() == key)
+			return;
+
+		job->SetPriority(priority, key);
+		m_dirty = true;
+	}
+
+	size_t was_size() const { return m_size.load(std::memory_order_relaxed); }
+
+private:
+	static bool RunsAfter(const Job *a, const Job *b) { return b->IsBefore(a); }
+
+	std::mutex m_lock;
+	std::vector<Job *> m_jobs;
+	std::atomic<size_t> m_size = 0;
+	bool m_dirty = false;
+};
+
+// Per-thread work-stealing queue. The owning thread pushes and pops tasks at
+// the back of the queue (LIFO, for cache locality with recently split
+// ranges), while other threads steal the oldest (and usually largest) tasks
+// from the front.
+class LocalTaskQueueImpl {
+public:
+	void push(Task *task)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_tasks.push_back(task);
+		m_size.store(m_tasks.size(), std::memory_order_release);
+	}
+
+	bool try_pop(Task *&task)
+	{
+		if (!was_size())
+			return false;
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_tasks.empty())
+			return false;
+
+		task = m_tasks.back();
+		m_tasks.pop_back();
+		m_size.store(m_tasks.size(), std::memory_order_release);
+		return true;
+	}
+
+	bool try_steal(Task *&task)
+	{
+		if (!was_size())
+			return false;
+
+		// don't contend with the owning thread or other thieves
+		std::unique_lock<std::mutex> lock(m_lock, std::try_to_lock);
+		if (!lock.owns_lock() || m_tasks.empty())
+			return false;
+
+		task = m_tasks.front();
+		m_tasks.pop_front();
+		m_size.store(m_tasks.size(), std::memory_order_release);
+		return true;
+	}
+
+	size_t was_size() const { return m_size.load(std::memory_order_relaxed); }
+
+private:
+	std::mutex m_lock;
+	std::deque<Task *> m_tasks;
+	std::atomic<size_t> m_size = 0;
+};
+
 // =============================================================================
 
 // implementation structure to maintain backwards compatibility with existing Job API
@@ -29,15 +142,21 @@ public:
 		m_graph(graph) {}
 
 	virtual Job::Handle Queue(Job *job, JobClient *client) override;
+	virtual Job::Handle QueueAfter(Job *job, std::initializer_list<Job *> dependencies, JobClient *client) override;
 	virtual void Cancel(Job *job) override;
+	virtual void SetPriority(Job *job, Job::Priority priority, float key) override;
 	virtual Uint32 FinishJobs() override;
+	virtual Uint32 FinishJobs(double maxMilliseconds, Uint32 maxJobs) override;
 
 	TaskGraph *m_graph;
+	std::atomic<Uint64> m_nextQueueOrder = 0;
 };
 
 Job::Handle TaskGraphJobQueueImpl::Queue(Job *job, JobClient *client)
 {
 	Job::Handle handle(job, this, client);
+	job->m_queueOrder = m_nextQueueOrder.fetch_add(1, std::memory_order_relaxed);
+	job->MarkQueued();
 
 	m_graph->m_jobQueue->push(job);
 
@@ -47,23 +166,70 @@ Job::Handle TaskGraphJobQueueImpl::Queue(Job *job, JobClient *client)
 	return handle;
 }
 
+Job::Handle TaskGraphJobQueueImpl::QueueAfter(Job *job, std::initializer_list<Job *> dependencies, JobClient *client)
+{
+	Job::Handle handle(job, this, client);
+	job->m_queueOrder = m_nextQueueOrder.fetch_add(1, std::memory_order_relaxed);
+	job->MarkQueued();
+
+	// if any dependencies are outstanding, the job will be pushed to the
+	// queue by the thread which runs the last of them
+	if (job->SetDependencies(dependencies)) {
+		m_graph->m_jobQueue->push(job);
+
+		std::atomic_thread_fence(std::memory_order_release);
+		m_graph->WakeForNewTasks();
+	}
+
+	return handle;
+}
+
 void TaskGraphJobQueueImpl::Cancel(Job *job)
 {
 	job->cancelled.store(true, std::memory_order_release);
 	job->m_handle.store(nullptr, std::memory_order_release);
 }
 
+void TaskGraphJobQueueImpl::SetPriority(Job *job, Job::Priority priority, float key)
+{
+	m_graph->m_jobQueue->set_priority(job, priority, key);
+}
+
 Uint32 TaskGraphJobQueueImpl::FinishJobs()
+{
+	return FinishJobs(std::numeric_limits<double>::infinity(), UINT32_MAX);
+}
+
+Uint32 TaskGraphJobQueueImpl::FinishJobs(double maxMilliseconds, Uint32 maxJobs)
 {
 	uint32_t numFinished = 0;
+	uint32_t numProcessed = 0;
 	Job *job = nullptr;
 
-	while (m_graph->m_jobFinishedQueue->try_pop(job)) {
+	Profiler::Clock clock;
+	clock.Start();
+
+	// The finished queue is FIFO, so leaving jobs in it when the budget is
+	// exhausted preserves fairness between job types across frames.
+	while (numProcessed < std::max(maxJobs, 1U)) {
+		if (numProcessed > 0) {
+			clock.SoftStop();
+			if (clock.milliseconds() >= maxMilliseconds)
+				break;
+		}
+
+		if (!m_graph->m_jobFinishedQueue->try_pop(job))
+			break;
+
+		numProcessed++;
+
 		job->UnlinkHandle();
 		if (job->cancelled.load(std::memory_order_relaxed)) {
 			job->OnCancel();
 		} else {
+			job->MarkFinished();
 			job->OnFinish();
+			job->MarkFinishEnded();
 			numFinished++;
 		}
 
@@ -102,8 +268,12 @@ TaskGraph::TaskGraph() :
 	m_taskQueue(new AsyncTaskQueueImpl()),
 	m_pinnedTasks(new AsyncTaskQueueImpl()),
 	m_jobHandlerImpl(new TaskGraphJobQueueImpl(this)),
-	m_jobQueue(new AsyncJobQueueImpl()),
+	m_jobQueue(new PriorityJobQueueImpl()),
 	m_jobFinishedQueue(new AsyncJobQueueImpl()),
+	m_localQueues{},
+	m_numLocalQueues(0),
+	m_nextLocalQueue(0),
+	m_workStealing(false),
 	m_isRunning(true),
 	m_numAliveThreads(0)
 {
@@ -138,14 +308,23 @@ TaskGraph::~TaskGraph()
 		delete task;
 	}
 
+	for (uint32_t idx = 0; idx < m_numLocalQueues.load(); idx++) {
+		while (m_localQueues[idx]->try_pop(task)) {
+			delete task;
+		}
+
+		delete m_localQueues[idx];
+	}
+
 	// clean up pinned tasks from this thread
 	while (m_pinnedTasks->try_pop(task)) {
 		delete task;
 	}
 
-	// cleanup leftover job objects
+	// cleanup leftover job objects, including any jobs waiting on them
 	Job *job = nullptr;
 	while (m_jobQueue->try_pop(job)) {
+		ReleaseContinuations(job);
 		job->UnlinkHandle();
 		job->OnCancel();
 		delete job;
@@ -174,6 +353,7 @@ uint32_t TaskGraph::GetNumWorkerThreads() const
 void TaskGraph::SetWorkerThreads(uint32_t numThreads)
 {
 	// numThreads + 1 because we have an implicit thread entry for the "main" thread
+	numThreads = std::min(numThreads, MAX_LOCAL_QUEUES - 1);
 	if (numThreads + 1 <= m_threads.size())
 		return;
 
@@ -187,6 +367,13 @@ void TaskGraph::SetWorkerThreads(uint32_t numThreads)
 		thr->threadNum = idx;
 		thr->graph = this;
 		thr->isJobThread = idx > 0;
+		thr->localTasks = new LocalTaskQueueImpl();
+		thr->stealIndex = idx;
+
+		// publish the local queue before the thread can start stealing
+		m_localQueues[idx] = thr->localTasks;
+		m_numLocalQueues.store(idx + 1, std::memory_order_release);
+
 		m_numAliveThreads.fetch_add(1, std::memory_order_release);
 		if (idx > 0)
 			thr->threadHandle = new std::thread(&ThreadData::RunThread, thr);
@@ -197,11 +384,18 @@ void TaskGraph::SetWorkerThreads(uint32_t numThreads)
 	assert(m_numAliveThreads == numThreads + 1);
 }
 
+void TaskGraph::SetWorkStealing(bool enabled)
+{
+	// Tasks already queued to local queues remain visible to HasTasks and
+	// TryRunTask regardless of the mode, so this can be toggled at any time.
+	m_workStealing.store(enabled, std::memory_order_release);
+}
+
 TaskSet::Handle TaskGraph::QueueTaskSet(TaskSet *taskSet)
 {
 	taskSet->m_executing = true;
 	for (auto task : taskSet->m_tasks) {
-		m_taskQueue->push(task);
+		PushTask(task);
 	}
 
 	std::atomic_thread_fence(std::memory_order_release);
@@ -211,12 +405,32 @@ TaskSet::Handle TaskGraph::QueueTaskSet(TaskSet *taskSet)
 
 void TaskGraph::QueueTask(Task *task)
 {
-	m_taskQueue->push(task);
+	PushTask(task);
 
 	// wake all threads that can run this task
 	WakeForNewTasks();
 }
 
+void TaskGraph::PushTask(Task *task)
+{
+	if (!m_workStealing.load(std::memory_order_relaxed)) {
+		m_taskQueue->push(task);
+		return;
+	}
+
+	// Worker threads keep the tasks they create close to home; tasks from
+	// the main thread (or any other thread) are dealt out round-robin so
+	// every worker starts with something to do.
+	ThreadData *thread = GetThreadData();
+	if (thread && thread->graph == this && thread->isJobThread) {
+		thread->localTasks->push(task);
+	} else {
+		uint32_t numQueues = m_numLocalQueues.load(std::memory_order_acquire);
+		uint32_t idx = m_nextLocalQueue.fetch_add(1, std::memory_order_relaxed) % numQueues;
+		m_localQueues[idx]->push(task);
+	}
+}
+
 TaskSet::Handle TaskGraph::QueueTaskSetPinned(TaskSet *taskSet)
 {
 	taskSet->m_executing = true;
@@ -256,6 +470,12 @@ void TaskGraph::WaitForTaskSet(TaskSet::Handle &setHandle)
 	if (!setHandle.m_set)
 		return;
 
+	// Jobs may wait for task sets of their own; they must help out as the
+	// worker they are running on, not with the main thread's queues.
+	ThreadData *thread = GetThreadData();
+	if (!thread || thread->graph != this)
+		thread = m_threads[0];
+
 	// if the currently running thread can't accomplish anything until the
 	// TaskSet has finished executing, this thread is implicitly free to assist
 	// in executing the TaskSet to minimize overall latency.
@@ -263,9 +483,14 @@ void TaskGraph::WaitForTaskSet(TaskSet::Handle &setHandle)
 	while (m_isRunning && !setHandle.IsComplete()) {
 		// We don't want to run any background Jobs during this loop as they
 		// cannot contribute towards the goal of completing the TaskSet
-		if (!TryRunTask(m_threads[0], false)) {
+		if (!TryRunTask(thread, false)) {
 			if (++spinCount > MAX_SPIN_COUNT) {
-				WaitForFinishedTask();
+				// only the main thread is guaranteed to be woken by the
+				// finished task semaphore
+				if (thread->threadNum == 0)
+					WaitForFinishedTask();
+				else
+					std::this_thread::yield();
 			} else {
 				atomic_queue::spin_loop_pause();
 			}
@@ -308,7 +533,8 @@ void TaskGraph::RunPinnedTasks()
 		if (!m_pinnedTasks->try_pop(task))
 			break;
 
-		ExecTask(task);
+		// pinned tasks must not be split onto other threads
+		ExecTask(task, false);
 	}
 }
 
@@ -350,9 +576,6 @@ void TaskGraph::ThreadData::RunThread()
 			}
 		} else {
 			spinCount = 0;
-
-			// reclaim used space in this thread's StringTable periodically
-			StringTable::Get()->Reclaim();
 		}
 	}
 
@@ -384,6 +607,12 @@ bool TaskGraph::HasTasks(ThreadData *thread)
 	if (m_taskQueue->was_size())
 		return true;
 
+	uint32_t numQueues = m_numLocalQueues.load(std::memory_order_acquire);
+	for (uint32_t idx = 0; idx < numQueues; idx++) {
+		if (m_localQueues[idx]->was_size())
+			return true;
+	}
+
 	if (thread->isJobThread && m_jobQueue->was_size())
 		return true;
 
@@ -399,9 +628,15 @@ bool TaskGraph::TryRunTask(ThreadData *thread, bool allowJobs)
 	if (thread->threadNum == 0)
 		hasTask = m_pinnedTasks->try_pop(taskToRun);
 
+	if (!hasTask)
+		hasTask = thread->localTasks->try_pop(taskToRun);
+
 	if (!hasTask)
 		hasTask = m_taskQueue->try_pop(taskToRun);
 
+	if (!hasTask)
+		hasTask = TryStealTask(thread, taskToRun);
+
 	if (hasTask) {
 		ExecTask(taskToRun);
 		return true;
@@ -409,8 +644,14 @@ bool TaskGraph::TryRunTask(ThreadData *thread, bool allowJobs)
 
 	Job *job = nullptr;
 	if (allowJobs && thread->isJobThread && m_jobQueue->try_pop(job)) {
-		if (!job->cancelled.load(std::memory_order_acquire))
+		if (!job->cancelled.load(std::memory_order_acquire)) {
+			job->MarkStarted(thread->threadNum);
 			job->OnRun();
+			job->MarkEnded();
+		}
+
+		// release dependent jobs before the main thread can delete this one
+		ReleaseContinuations(job);
 		m_jobFinishedQueue->push(job);
 
 		return true;
@@ -419,13 +660,77 @@ bool TaskGraph::TryRunTask(ThreadData *thread, bool allowJobs)
 	return false;
 }
 
-void TaskGraph::ExecTask(Task *task)
+void TaskGraph::ReleaseContinuations(Job *job)
+{
+	bool released = false;
+	for (Job *next : job->TakeContinuations()) {
+		if (next->ReleaseDependency()) {
+			m_jobQueue->push(next);
+			released = true;
+		}
+	}
+
+	if (released)
+		WakeForNewTasks();
+}
+
+bool TaskGraph::TryStealTask(ThreadData *thread, Task *&task)
 {
-	task->OnExecute(task->m_range);
+	uint32_t numQueues = m_numLocalQueues.load(std::memory_order_acquire);
+
+	// start at a different victim each time to spread contention
+	uint32_t start = thread->stealIndex++;
+	for (uint32_t idx = 0; idx < numQueues; idx++) {
+		uint32_t victim = (start + idx) % numQueues;
+		if (victim == thread->threadNum)
+			continue;
+
+		if (m_localQueues[victim]->try_steal(task))
+			return true;
+	}
+
+	return false;
+}
+
+void TaskGraph::ExecTask(Task *task, bool allowSplit)
+{
+	TaskRange range = task->m_range;
+
+	// Recursively split divisible tasks, leaving the lower half of the range
+	// on this thread and making the upper half available to other threads.
+	if (allowSplit && task->m_grainSize) {
+		bool split = false;
+		while (range.end - range.begin > task->m_grainSize) {
+			uint32_t mid = range.begin + (range.end - range.begin) / 2;
+			Task *child = task->OnSplit({ mid, range.end });
+			if (!child)
+				break;
+
+			child->m_grainSize = task->m_grainSize;
+			child->m_isSplit = true;
+			if (task->m_owner)
+				child->SetOwner(task->m_owner);
+
+			PushTask(child);
+			range.end = mid;
+			split = true;
+		}
+
+		if (split)
+			WakeForNewTasks();
+	}
 
-	if (task->m_owner)
-		task->m_owner->m_dependants.fetch_sub(1);
-	else
+	task->OnExecute(range);
+
+	if (task->m_owner) {
+		// split tasks are not known to their owning TaskSet, so we are
+		// responsible for deleting them here
+		bool isSplit = task->m_isSplit;
+		CompleteNotifier *owner = task->m_owner;
+		if (isSplit)
+			delete task;
+		owner->m_dependants.fetch_sub(1);
+	} else
 		delete task;
 
 	// Notify threads in WaitForTaskSet that a task has been completed, so they
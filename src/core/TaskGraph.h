@@ -4,6 +4,7 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
 #include <thread>
 #include <vector>
 
@@ -16,7 +17,10 @@ struct TaskRange {
 
 class AsyncTaskQueueImpl;
 class AsyncJobQueueImpl;
+class LocalTaskQueueImpl;
+class PriorityJobQueueImpl;
 
+class Job;
 class JobQueue;
 class TaskGraphJobQueueImpl;
 class TaskGraph;
@@ -49,11 +53,19 @@ public:
 //
 //   OnComplete: used to synchronize reporting of task results, called by the
 //     task owner at a synchronization point on the task owner's thread.
+//
+// Tasks with a non-zero grain size are divisible: before executing, the
+// TaskGraph will repeatedly call OnSplit to hand the upper half of the range
+// to a new task until the remaining range is no larger than the grain size.
+// Split-off tasks are owned by the TaskGraph and only the original task has
+// its OnComplete method called.
 class Task {
 public:
-	Task(TaskRange range = {}) :
+	Task(TaskRange range = {}, uint32_t grainSize = 0) :
 		m_owner(nullptr),
-		m_range(range) {}
+		m_range(range),
+		m_grainSize(grainSize),
+		m_isSplit(false) {}
 	virtual ~Task() = default;
 
 	// Runs on a worker thread. Do all work in the task here.
@@ -63,6 +75,11 @@ public:
 	// If the task has no owner, this function will not be called.
 	virtual void OnComplete(){};
 
+	// Called on a worker thread to create a new task responsible for the
+	// given subrange of this task's work. Return nullptr if the task cannot
+	// be split.
+	virtual Task *OnSplit(TaskRange range) { return nullptr; }
+
 	// Sets the task owner (responsible for calling task completion callbacks)
 	void SetOwner(CompleteNotifier *);
 
@@ -70,6 +87,8 @@ private:
 	friend class TaskGraph;
 	CompleteNotifier *m_owner;
 	TaskRange m_range;
+	uint32_t m_grainSize;
+	bool m_isSplit;
 };
 
 // Helper task define to enable easy creation with lambdas.
@@ -87,6 +106,27 @@ private:
 	Function m_lambda;
 };
 
+// Helper task define for divisible lambda tasks. The lambda is shared between
+// all subranges split from the original task and must be safe to call from
+// multiple threads at once.
+template <typename Function>
+class RangeLambdaTask : public Task {
+public:
+	RangeLambdaTask(TaskRange r, uint32_t grainSize, Function &&lambda) :
+		Task(r, grainSize),
+		m_lambda(std::make_shared<Function>(std::move(lambda))) {}
+
+	void OnExecute(TaskRange range) override { (*m_lambda)(range); }
+	Task *OnSplit(TaskRange range) override { return new RangeLambdaTask(range, m_lambda); }
+
+private:
+	RangeLambdaTask(TaskRange r, std::shared_ptr<Function> lambda) :
+		Task(r),
+		m_lambda(lambda) {}
+
+	std::shared_ptr<Function> m_lambda;
+};
+
 // Represents a group of related tasks and is responsible for handling
 // post-task operations on the main thread.
 class TaskSet : public CompleteNotifier {
@@ -126,6 +166,15 @@ public:
 		return AddTask(new LambdaTask<Function>(range, std::move(fn)));
 	}
 
+	// Adds a divisible lambda task to this TaskSet. The range will be split
+	// recursively across worker threads into pieces of at most grainSize
+	// elements as the task executes.
+	template <typename Function>
+	bool AddTaskRangeLambda(TaskRange range, uint32_t grainSize, Function &&fn)
+	{
+		return AddTask(new RangeLambdaTask<Function>(range, grainSize, std::move(fn)));
+	}
+
 	bool IsExecuting() { return m_executing; }
 
 private:
@@ -145,6 +194,12 @@ public:
 	void SetWorkerThreads(uint32_t numThreads);
 	uint32_t GetNumWorkerThreads() const;
 
+	// Enable or disable work stealing. When enabled, each thread queues new
+	// tasks to its own local queue and idle threads steal tasks from other
+	// threads before looking for background jobs.
+	void SetWorkStealing(bool enabled);
+	bool IsWorkStealing() const { return m_workStealing.load(std::memory_order_relaxed); }
+
 	// Queues all tasks in a TaskSet for execution. The TaskGraph now owns
 	// the underlying TaskSet and is responsible for deletion.
 	TaskSet::Handle QueueTaskSet(TaskSet *set);
@@ -159,6 +214,7 @@ public:
 	// Wait for a queued task set to complete and run task completion callbacks.
 	// This will execute tasks on the calling thread until the given TaskSet
 	// handle has completed all queued tasks.
+	// Jobs may call this too, to split their work into tasks.
 	void WaitForTaskSet(TaskSet::Handle &set);
 
 	// Runs completion callbacks for a TaskSet and destroys the underlying
@@ -182,6 +238,10 @@ private:
 		TaskGraph *graph;
 		bool isJobThread;
 
+		// per-thread task queue used when work stealing is enabled
+		LocalTaskQueueImpl *localTasks;
+		uint32_t stealIndex;
+
 		void RunThread();
 		void WaitForTasks();
 	};
@@ -189,7 +249,10 @@ private:
 	static thread_local ThreadData *tl_threadData;
 
 	bool TryRunTask(ThreadData *thread, bool allowJobs = true);
-	void ExecTask(Task *task);
+	bool TryStealTask(ThreadData *thread, Task *&task);
+	void ReleaseContinuations(Job *job);
+	void ExecTask(Task *task, bool allowSplit = true);
+	void PushTask(Task *task);
 	bool HasTasks(ThreadData *thread);
 	static ThreadData *GetThreadData();
 
@@ -198,6 +261,8 @@ private:
 
 	void WaitForFinishedTask();
 
+	static constexpr uint32_t MAX_LOCAL_QUEUES = 64;
+
 	std::vector<ThreadData *> m_threads;
 
 	// queue for short-lived high-priority tasks
@@ -209,10 +274,17 @@ private:
 	// with the old JobQueue system
 	TaskGraphJobQueueImpl *m_jobHandlerImpl;
 
-	// queue for long-lived low-priority background jobs
-	AsyncJobQueueImpl *m_jobQueue;
+	// priority-ordered queue for long-lived low-priority background jobs
+	PriorityJobQueueImpl *m_jobQueue;
 	AsyncJobQueueImpl *m_jobFinishedQueue;
 
+	// fixed-size view of every thread's local queue which stealing threads
+	// can safely iterate while new worker threads are being started
+	LocalTaskQueueImpl *m_localQueues[MAX_LOCAL_QUEUES];
+	std::atomic<uint32_t> m_numLocalQueues;
+	std::atomic<uint32_t> m_nextLocalQueue;
+	std::atomic<bool> m_workStealing;
+
 	std::atomic<bool> m_isRunning;
 	std::atomic<uint32_t> m_numAliveThreads;
 
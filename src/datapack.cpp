@@ -0,0 +1,54 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "FileSourcePack.h"
+#include "FileSystem.h"
+#include <SDL.h>
+#include <cstdio>
+
+int info()
+{
+	printf(
+		"datapack - Pack a data directory into a single file.\n"
+		"USAGE: datapack [--lz4] <data dir> [output]\n"
+		"  The output defaults to <data dir>/%s, which the game reads\n"
+		"  instead of the directory. --lz4 compresses the files that\n"
+		"  get smaller for it.\n",
+		FileSystem::DATA_PACK_NAME);
+	return 1;
+}
+
+extern "C" int main(int argc, char **argv)
+{
+	int shift = 0;
+	bool compress = false;
+	if (argc > 1 && std::string(argv[1]) == "--lz4") {
+		compress = true;
+		shift = 1;
+	}
+
+	if (argc < shift + 2 || argc > shift + 3) return info();
+	const std::string dataDir = argv[shift + 1];
+	const std::string outname = argc > shift + 2 ? argv[shift + 2] : FileSystem::JoinPath(dataDir, FileSystem::DATA_PACK_NAME);
+
+	FileSystem::FileSourceFS source(dataDir);
+	if (!source.Lookup("").IsDir()) {
+		printf("Data directory %s could not be found.\n", dataDir.c_str());
+		return 1;
+	}
+
+	FILE *outFile = fopen(outname.c_str(), "wb");
+	if (!outFile) {
+		printf("Could not open output file %s.\n", outname.c_str());
+		return 1;
+	}
+
+	// don't pack an old pack into the new one
+	const bool ok = FileSystem::FileSourcePack::Write(source, "", outFile, compress, FileSystem::DATA_PACK_NAME);
+	if (fclose(outFile) != 0 || !ok) {
+		printf("Could not write to output file %s.\n", outname.c_str());
+		return 2;
+	}
+
+	return 0;
+}
@@ -23,6 +23,7 @@
 #include "lua/Lua.h"
 #include "graphics/opengl/RendererGL.h"
 
+#include "system/SystemBatch.h"
 #include "system/SystemEditor.h"
 
 using namespace Editor;
@@ -60,6 +61,12 @@ void EditorApp::Initialize(argh::parser &cmdline)
 		return;
 	}
 
+	if (cmdline["--batch-systems"]) {
+		QueueLifecycle(RefCountedPtr<SystemBatchRunner>(new SystemBatchRunner(this, cmdline)));
+		SetAppName("SystemBatch");
+		return;
+	}
+
 	if (cmdline["--system"]) {
 		std::string systemPath = cmdline[1];
 
@@ -103,6 +110,7 @@ void EditorApp::OnStartup()
 	m_editorCfg->SetInt("ScrHeight", 900);
 	m_editorCfg->SetInt("VSync", 1);
 	m_editorCfg->SetInt("AntiAliasingMode", 4);
+	m_editorCfg->SetInt("WorkStealing", 1);
 
 	m_editorCfg->Read(FileSystem::userFiles, "editor.ini");
 	m_editorCfg->Save(); // write defaults if the file doesn't exist
@@ -117,13 +125,14 @@ void EditorApp::OnStartup()
 	Uint32 numThreads = m_editorCfg->Int("WorkerThreads");
 	numThreads = numThreads ? numThreads : std::max(OS::GetNumCores() - 1, 1U);
 	GetTaskGraph()->SetWorkerThreads(numThreads);
+	GetTaskGraph()->SetWorkStealing(m_editorCfg->Int("WorkStealing"));
 
 	Lang::Resource &res(Lang::GetResource("core", m_editorCfg->String("Lang", "en")));
 	Lang::MakeCore(res);
 
 	Graphics::RendererOGL::RegisterRenderer();
 
-	m_renderer = StartupRenderer(m_editorCfg.get(), false, true);
+	m_renderer = StartupRenderer(m_editorCfg.get(), m_headless, true);
 	StartupInput(m_editorCfg.get());
 
 	StartupPiGui();
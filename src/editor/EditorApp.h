@@ -30,6 +30,10 @@ namespace Editor {
 
 		void SetAppName(std::string_view name);
 
+		// Keep the window hidden, for runs which only process files; must be
+		// set before Startup()
+		void SetHeadless(bool headless) { m_headless = headless; }
+
 		template<typename T, typename ...Args>
 		RefCountedPtr<T> PushModal(Args&& ...args)
 		{
@@ -58,6 +62,7 @@ namespace Editor {
 		std::unique_ptr<IniConfig> m_editorCfg;
 
 		std::string m_appName;
+		bool m_headless = false;
 	};
 
 	class LoadingPhase : public Application::Lifecycle {
@@ -121,6 +121,8 @@ void Draw::ShowUndoDebugWindow(UndoSystem *undo, bool *p_open)
 
 	ImGui::AlignTextToFramePadding();
 	ImGui::Text("Undo Depth: %ld", undo->GetEntryDepth());
+	ImGui::SameLine();
+	ImGui::TextDisabled("(%zu / %zu KiB)", undo->GetMemoryUsage() / 1024, undo->GetMemoryLimit() / 1024);
 
 	if (ImGui::IsKeyDown(ImGuiKey_LeftAlt) && undo->GetEntryDepth()) {
 		ImGui::SameLine(ImGui::GetContentRegionAvail().x - ImGui::GetStyle().WindowPadding.x * 2.f, 0.f);
@@ -34,6 +34,9 @@ namespace {
 	static constexpr const char *TAGS_WND_NAME = "Tags";
 	static constexpr const char *HIERARCHY_WND_NAME = "Hierarchy";
 	static constexpr const char *LOG_WND_NAME = "Log";
+
+	// seconds between looking for changes to the files of the model
+	static constexpr double SOURCE_CHECK_INTERVAL = 0.5;
 }
 
 ModelViewer::ModelViewer(EditorApp *app, LuaManager *lm) :
@@ -63,7 +66,7 @@ void ModelViewer::Start()
 {
 	NavLights::Init(m_renderer);
 	Shields::Init(m_renderer);
-	ShipType::Init();
+	ShipType::Init(m_app->GetTaskGraph());
 
 	UpdateModelList();
 	UpdateDecalList();
@@ -226,6 +229,11 @@ void ModelViewer::Update(float deltaTime)
 		m_requestedModelName.clear();
 	}
 
+	if (m_autoReload && !m_watchedModelName.empty() && m_app->GetTime() - m_lastSourceCheck > SOURCE_CHECK_INTERVAL) {
+		m_lastSourceCheck = m_app->GetTime();
+		CheckModelSources();
+	}
+
 	HandleInput();
 
 	UpdateShield();
@@ -261,6 +269,7 @@ void ModelViewer::HandleInput()
 	if (m_input->IsKeyPressed(SDLK_ESCAPE)) {
 		if (m_modelWindow->GetModel()) {
 			ClearModel();
+			m_watchedModelName.clear();
 			UpdateModelList();
 			UpdateDecalList();
 		} else {
@@ -382,12 +391,56 @@ void ModelViewer::SetModel(const std::string &filename)
 
 	//this is necessary to reload textures
 	m_renderer->RemoveAllCachedTextures();
+	m_modelWindow->GetImportCache().Clear();
 
 	ClearModel();
+	m_watchedModelName.clear();
 
 	if (m_modelWindow->LoadModel(filename)) {
 		m_modelName = filename;
+		m_watchedModelName = filename;
+		OnModelLoaded();
+	}
+}
+
+void ModelViewer::CheckModelSources()
+{
+	bool modelChanged = false;
+	for (const auto &source : m_modelWindow->GetImportCache().FindModifiedSources()) {
+		switch (source.type) {
+		case SceneGraph::ImportCache::SOURCE_TEXTURE:
+		case SceneGraph::ImportCache::SOURCE_NORMAL_MAP:
+			Log::Info("Reloading texture {}", source.path);
+			m_modelWindow->ReloadTexture(source.path, source.type == SceneGraph::ImportCache::SOURCE_NORMAL_MAP);
+			break;
+		default:
+			Log::Info("{} was modified", source.path);
+			modelChanged = true;
+			break;
+		}
+	}
+
+	if (modelChanged)
+		UpdateModel();
+}
+
+// Load the watched model again, only importing the files that changed and
+// keeping the view as it is
+void ModelViewer::UpdateModel()
+{
+	Log::Info("Updating model {}...", m_watchedModelName);
+
+	const bool attachGuns = m_attachGuns;
+	const bool showShields = m_showShields;
+	ClearModel();
+
+	if (m_modelWindow->LoadModel(m_watchedModelName, true)) {
+		m_modelName = m_watchedModelName;
 		OnModelLoaded();
+
+		if (attachGuns)
+			ToggleGuns();
+		m_showShields = showShields;
 	}
 }
 
@@ -437,8 +490,8 @@ void ModelViewer::OnModelLoaded()
 
 void ModelViewer::RenderModelExtras()
 {
-	if (m_shieldModel && m_modelHasShields) {
-		m_shieldModel->Render(m_modelWindow->GetModelViewMat());
+	if (m_modelHasShields) {
+		m_shields->Render(m_modelWindow->GetModelViewMat());
 	}
 }
 
@@ -453,6 +506,11 @@ void ModelViewer::DrawModelSelector()
 		ImGui::SameLine();
 		if (ImGui::Button("Reload Model"))
 			ReloadModel();
+
+		ImGui::SameLine();
+		ImGui::Checkbox("Auto Reload", &m_autoReload);
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("Update the model when its files change");
 	}
 
 	if (ImGui::BeginChild("FileList")) {
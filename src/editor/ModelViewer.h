@@ -63,6 +63,10 @@ private:
 	void ClearModel();
 	void OnModelLoaded();
 
+	// Reload what changed in the files of the model on disk
+	void CheckModelSources();
+	void UpdateModel();
+
 	void ToggleGuns();
 	void HitIt();
 
@@ -99,6 +103,11 @@ private:
 	std::string m_modelName;
 	std::string m_requestedModelName;
 
+	// the model kept up to date with its files, even while it fails to load
+	std::string m_watchedModelName;
+	double m_lastSourceCheck = 0.0;
+	bool m_autoReload = true;
+
 	SceneGraph::Tag *m_selectedTag = nullptr;
 
 	bool m_modelSupportsDecals = false;
@@ -54,6 +54,7 @@ ModelViewerWidget::ModelViewerWidget(EditorApp *app) :
 	m_bindings(app->GetInput()),
 	m_input(app->GetInput()),
 	m_renderer(app->GetRenderer()),
+	m_importCache(new SceneGraph::ImportCache()),
 	m_options({}),
 	m_colors({ Color(255, 0, 0),
 		Color(0, 255, 0),
@@ -86,8 +87,13 @@ SceneGraph::Model *ModelViewerWidget::GetModel()
 	return m_model.get();
 }
 
-bool ModelViewerWidget::LoadModel(std::string_view path)
+bool ModelViewerWidget::LoadModel(std::string_view path, bool keepView)
 {
+	const float zoom = m_zoom;
+	const vector2f rot = m_rot;
+	const vector3f viewPos = m_viewPos;
+	const matrix3x3f viewRot = m_viewRot;
+
 	ClearModel();
 
 	try {
@@ -99,6 +105,7 @@ bool ModelViewerWidget::LoadModel(std::string_view path)
 		} else {
 			std::string modelName = std::string(path);
 			SceneGraph::Loader loader(m_renderer, true, false);
+			loader.SetImportCache(m_importCache.get());
 			m_model.reset(loader.LoadModel(modelName));
 
 			//dump warnings
@@ -143,6 +150,13 @@ bool ModelViewerWidget::LoadModel(std::string_view path)
 	}
 
 	OnModelLoaded();
+
+	if (keepView) {
+		m_zoom = zoom;
+		m_rot = rot;
+		m_viewPos = viewPos;
+		m_viewRot = viewRot;
+	}
 	return true;
 }
 
@@ -150,6 +164,7 @@ void ModelViewerWidget::ClearModel()
 {
 	ResetCamera();
 	m_model.reset();
+	m_retiredTextures.clear();
 
 	m_animations.clear();
 	m_currentAnimation = nullptr;
@@ -178,6 +193,32 @@ void ModelViewerWidget::OnModelLoaded()
 	}
 }
 
+void ModelViewerWidget::ReloadTexture(const std::string &path, bool normalMap)
+{
+	Graphics::Texture *oldTexture = m_renderer->GetCachedTexture("model", path);
+	if (!oldTexture)
+		return; // not loaded yet, or not at all
+
+	m_retiredTextures.emplace_back(oldTexture);
+	m_renderer->RemoveCachedTexture("model", path);
+
+	Graphics::TextureBuilder builder = normalMap ? Graphics::TextureBuilder::Normal(path) : Graphics::TextureBuilder::Model(path);
+	Graphics::Texture *texture = builder.GetOrCreateTexture(m_renderer, "model");
+	if (!m_model)
+		return;
+
+	static constexpr size_t slots[] = {
+		"texture0"_hash, "texture1"_hash, "texture2"_hash, "texture3"_hash, "texture6"_hash
+	};
+	for (unsigned int i = 0; i < m_model->GetNumMaterials(); i++) {
+		Graphics::Material *mat = m_model->GetMaterialByIndex(i).Get();
+		for (size_t slot : slots) {
+			if (mat->GetTexture(slot) == oldTexture)
+				mat->SetTexture(slot, texture);
+		}
+	}
+}
+
 void ModelViewerWidget::CreateTestResources()
 {
 	//landingpad model for scale test
@@ -575,6 +616,7 @@ void ModelViewerWidget::DrawModel(matrix4x4f trans)
 		(m_options.showGeomBBox ? SceneGraph::Model::DEBUG_GEOMBBOX : 0x0) |
 		(m_options.wireframe ? SceneGraph::Model::DEBUG_WIREFRAME : 0x0));
 
+	m_navLights->UpdateBulbs();
 	m_model->Render(m_modelViewMat);
 	m_navLights->Render(m_renderer);
 }
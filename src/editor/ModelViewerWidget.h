@@ -7,6 +7,7 @@
 
 #include "Color.h"
 #include "Input.h"
+#include "RefCounted.h"
 #include "core/Log.h"
 
 #include "vector2.h"
@@ -21,11 +22,13 @@ class NavLights;
 namespace SceneGraph {
 	class Model;
 	class Animation;
+	class ImportCache;
 }
 
 namespace Graphics {
 	class MeshObject;
 	class Material;
+	class Texture;
 
 	namespace Drawables {
 		class GridLines;
@@ -72,9 +75,17 @@ namespace Editor
 		ModelViewerWidget(EditorApp *app);
 		~ModelViewerWidget();
 
-		bool LoadModel(std::string_view path);
+		// keepView leaves the camera where it is, for reloading the same model
+		bool LoadModel(std::string_view path, bool keepView = false);
 		void ClearModel();
 
+		// What the model was loaded from; .model files are loaded through it
+		SceneGraph::ImportCache &GetImportCache() { return *m_importCache; }
+
+		// Load a model texture file again and swap it into the materials
+		// that use it, without reloading the model
+		void ReloadTexture(const std::string &path, bool normalMap);
+
 		void OnAppearing() override;
 		void OnDisappearing() override;
 
@@ -156,6 +167,9 @@ namespace Editor
 
 		std::unique_ptr<SceneGraph::Model> m_model;
 		std::unique_ptr<NavLights> m_navLights;
+		std::unique_ptr<SceneGraph::ImportCache> m_importCache;
+		// replaced textures other models may still point at
+		std::vector<RefCountedPtr<Graphics::Texture>> m_retiredTextures;
 
 		std::unique_ptr<Graphics::MeshObject> m_bgMesh;
 		std::unique_ptr<Graphics::Material> m_bgMaterial;
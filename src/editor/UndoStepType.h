@@ -5,8 +5,22 @@
 
 #include "editor/UndoSystem.h"
 
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
 namespace Editor {
 
+	// Approximate heap memory owned by a value stored in an undo step
+	template<typename T>
+	inline size_t UndoValueMemory(const T &) { return 0; }
+
+	inline size_t UndoValueMemory(const std::string &str) { return str.capacity(); }
+
+	template<typename T>
+	inline size_t UndoValueMemory(const std::vector<T> &vec) { return vec.capacity() * sizeof(T); }
+
 	// ========================================================================
 	//  UndoClosure Helper
 	// ========================================================================
@@ -67,6 +81,13 @@ namespace Editor {
 		// Implement HasChanged as !(a == b) to reduce the number of operator overloads required
 		bool HasChanged() const override { return !(*m_dataRef == m_state); }
 
+		bool HasSameTarget(const UndoStep &other) const override
+		{
+			return static_cast<const UndoSingleValueStep &>(other).m_dataRef == m_dataRef;
+		}
+
+		size_t GetMemoryUsage() const override { return sizeof(*this) + UndoValueMemory(m_state); }
+
 	private:
 		ValueType *m_dataRef;
 		ValueType m_state;
@@ -135,6 +156,13 @@ namespace Editor {
 
 		bool HasChanged() const override { return !((m_dataRef->*GetterFn)() == m_state); }
 
+		bool HasSameTarget(const UndoStep &other) const override
+		{
+			return static_cast<const UndoGetSetValueStep &>(other).m_dataRef == m_dataRef;
+		}
+
+		size_t GetMemoryUsage() const override { return sizeof(*this) + UndoValueMemory(m_state); }
+
 	private:
 		Obj *m_dataRef;
 		ValueType m_state;
@@ -218,6 +246,8 @@ namespace Editor {
 			m_insert = !m_insert;
 		}
 
+		size_t GetMemoryUsage() const override { return sizeof(*this) + UndoValueMemory(m_value); }
+
 	private:
 		Container &m_container;
 		ValueType m_value;
@@ -257,6 +287,14 @@ namespace Editor {
 
 		bool HasChanged() const override { return !(m_container[m_index] == m_state); }
 
+		bool HasSameTarget(const UndoStep &other) const override
+		{
+			const UndoVectorSingleValueStep &step = static_cast<const UndoVectorSingleValueStep &>(other);
+			return &step.m_container == &m_container && step.m_index == m_index;
+		}
+
+		size_t GetMemoryUsage() const override { return sizeof(*this) + UndoValueMemory(m_state); }
+
 	private:
 		Container &m_container;
 		size_t m_index;
@@ -313,4 +351,114 @@ namespace Editor {
 		s->AddUndoStep<UndoClosure<UpdateClosure, UndoVectorSingleValueStep<T>>>(std::move(closure), containerRef, idx);
 	}
 
+	// ========================================================================
+	//  UndoDeltaValue Helper
+	// ========================================================================
+
+	// UndoDelta stores a block of bytes as its difference from another block:
+	// the bytes both have in common at the start and the end are left out,
+	// and what's in between is compressed with LZ4 if that makes it smaller.
+	// Restoring the block needs the same base block it was stored against.
+
+	class UndoDelta {
+	public:
+		void Store(const char *data, size_t size, const char *base, size_t baseSize);
+		void Restore(char *out, const char *base, size_t baseSize) const;
+
+		// size of the stored block
+		size_t GetSize() const { return size_t(m_prefix) + m_middleSize + m_suffix; }
+		size_t GetMemoryUsage() const { return m_middle.capacity(); }
+
+	private:
+		uint32_t m_prefix = 0;
+		uint32_t m_suffix = 0;
+		uint32_t m_middleSize = 0;
+		bool m_compressed = false;
+		std::vector<char> m_middle;
+	};
+
+	// UndoDeltaValueStep is an UndoSingleValueStep for large contiguous values
+	// (std::string, or std::vector of trivially copyable values) where edits
+	// usually only touch a small part. Once the entry is committed the prior
+	// state is kept as an UndoDelta against the current one, so a long edit
+	// history of a large value costs about as much as the parts that changed.
+
+	template<typename ValueType>
+	class UndoDeltaValueStep : public UndoStep
+	{
+		using ElementType = typename ValueType::value_type;
+		static_assert(std::is_trivially_copyable_v<ElementType>, "UndoDeltaValueStep needs trivially copyable elements");
+
+	public:
+		UndoDeltaValueStep(ValueType *data) :
+			m_dataRef(data),
+			m_state(*m_dataRef),
+			m_isDelta(false)
+		{
+		}
+
+		void Swap() override
+		{
+			// the entry is being reset before it was committed
+			if (!m_isDelta) {
+				std::swap(*m_dataRef, m_state);
+				return;
+			}
+
+			ValueType state;
+			state.resize(m_delta.GetSize() / sizeof(ElementType));
+			m_delta.Restore(reinterpret_cast<char *>(state.data()), Bytes(*m_dataRef), BytesSize(*m_dataRef));
+
+			// what's current now becomes the state to restore, relative to the restored one
+			m_delta.Store(Bytes(*m_dataRef), BytesSize(*m_dataRef), Bytes(state), BytesSize(state));
+			*m_dataRef = std::move(state);
+		}
+
+		bool HasChanged() const override { return m_isDelta || !(*m_dataRef == m_state); }
+
+		bool HasSameTarget(const UndoStep &other) const override
+		{
+			return static_cast<const UndoDeltaValueStep &>(other).m_dataRef == m_dataRef;
+		}
+
+		void Compact() override
+		{
+			if (m_isDelta)
+				return;
+
+			m_delta.Store(Bytes(m_state), BytesSize(m_state), Bytes(*m_dataRef), BytesSize(*m_dataRef));
+			m_state = ValueType();
+			m_isDelta = true;
+		}
+
+		size_t GetMemoryUsage() const override
+		{
+			return sizeof(*this) + (m_isDelta ? m_delta.GetMemoryUsage() : UndoValueMemory(m_state));
+		}
+
+	private:
+		static const char *Bytes(const ValueType &value) { return reinterpret_cast<const char *>(value.data()); }
+		static size_t BytesSize(const ValueType &value) { return value.size() * sizeof(ElementType); }
+
+		ValueType *m_dataRef;
+		// the full prior state, until the entry is committed
+		ValueType m_state;
+		UndoDelta m_delta;
+		bool m_isDelta;
+	};
+
+	// Helper functions to construct the above UndoStep helpers
+
+	template<typename T>
+	inline void AddUndoDeltaValue(UndoSystem *s, T *dataRef)
+	{
+		s->AddUndoStep<UndoDeltaValueStep<T>>(dataRef);
+	}
+
+	template<typename T, typename UpdateClosure>
+	inline void AddUndoDeltaValueClosure(UndoSystem *s, T *dataRef, UpdateClosure closure)
+	{
+		s->AddUndoStep<UndoClosure<UpdateClosure, UndoDeltaValueStep<T>>>(std::move(closure), dataRef);
+	}
+
 } // namespace Editor
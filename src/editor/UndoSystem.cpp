@@ -2,12 +2,15 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "UndoSystem.h"
+#include "UndoStepType.h"
 #include "utils.h"
 
+#include "lz4/lz4.h"
 #define XXH_INLINE_ALL
 #include "lz4/xxhash.h"
 
 #include <cassert>
+#include <typeinfo>
 
 using namespace Editor;
 
@@ -32,11 +35,81 @@ bool UndoEntry::HasChanged() const
 	return false;
 }
 
+void UndoEntry::MergeLastStep()
+{
+	const size_t numSteps = m_steps.size();
+	if (numSteps < 2)
+		return;
+
+	const UndoStep &last = *m_steps[numSteps - 1];
+	const UndoStep &prev = *m_steps[numSteps - 2];
+	if (typeid(last) == typeid(prev) && last.HasSameTarget(prev))
+		m_steps.pop_back();
+}
+
+// ============================================================================
+
+// the in-between bytes of smaller deltas aren't worth compressing
+static constexpr size_t DELTA_COMPRESS_MIN_SIZE = 256;
+
+void UndoDelta::Store(const char *data, size_t size, const char *base, size_t baseSize)
+{
+	const size_t common = std::min(size, baseSize);
+
+	size_t prefix = 0;
+	while (prefix < common && data[prefix] == base[prefix])
+		prefix++;
+
+	size_t suffix = 0;
+	while (suffix < common - prefix && data[size - suffix - 1] == base[baseSize - suffix - 1])
+		suffix++;
+
+	m_prefix = uint32_t(prefix);
+	m_suffix = uint32_t(suffix);
+	m_middleSize = uint32_t(size - prefix - suffix);
+	m_compressed = false;
+
+	const char *middle = data + prefix;
+	if (m_middleSize >= DELTA_COMPRESS_MIN_SIZE) {
+		m_middle.resize(LZ4_compressBound(int(m_middleSize)));
+		const int len = LZ4_compress_default(middle, m_middle.data(), int(m_middleSize), int(m_middle.size()));
+		if (len > 0 && uint32_t(len) < m_middleSize) {
+			m_middle.resize(len);
+			m_middle.shrink_to_fit();
+			m_compressed = true;
+			return;
+		}
+	}
+
+	m_middle.assign(middle, middle + m_middleSize);
+	m_middle.shrink_to_fit();
+}
+
+void UndoDelta::Restore(char *out, const char *base, size_t baseSize) const
+{
+	assert(size_t(m_prefix) + m_suffix <= baseSize);
+
+	if (m_prefix)
+		memcpy(out, base, m_prefix);
+	if (m_compressed) {
+		const int len = LZ4_decompress_safe(m_middle.data(), out + m_prefix, int(m_middle.size()), int(m_middleSize));
+		assert(len == int(m_middleSize));
+		(void)len;
+	} else if (m_middleSize) {
+		memcpy(out + m_prefix, m_middle.data(), m_middleSize);
+	}
+	if (m_suffix)
+		memcpy(out + m_prefix + m_middleSize, base + baseSize - m_suffix, m_suffix);
+}
+
 // ============================================================================
 
 UndoSystem::UndoSystem() :
 	m_openUndoDepth(0),
 	m_entryId(0),
+	m_baseId(0),
+	m_memoryUsage(0),
+	m_memoryLimit(DEFAULT_MEMORY_LIMIT),
 	m_doing(false)
 {
 }
@@ -70,11 +143,10 @@ const UndoEntry *UndoSystem::GetEntry(size_t stackIdx) const
 
 size_t UndoSystem::GetStateHash()
 {
-	size_t hash = "UndoState"_hash;
-	for (auto &entry_ptr : m_undoStack)
-		hash = XXH64(&entry_ptr->m_id, sizeof(size_t), hash);
-
-	return hash;
+	// entry ids are never reused, so the newest entry identifies everything
+	// below it in the undo stack
+	const size_t id = m_undoStack.empty() ? m_baseId : m_undoStack.back()->m_id;
+	return XXH64(&id, sizeof(size_t), "UndoState"_hash);
 }
 
 void UndoSystem::Undo()
@@ -116,11 +188,31 @@ void UndoSystem::Clear()
 	m_openUndoDepth = 0;
 
 	m_entryId = 0;
+	m_baseId = 0;
+	m_memoryUsage = 0;
 
 	m_redoStack.clear();
 	m_undoStack.clear();
 }
 
+void UndoSystem::SetMemoryLimit(size_t bytes)
+{
+	m_memoryLimit = bytes;
+	TrimHistory();
+}
+
+void UndoSystem::TrimHistory()
+{
+	// the redo stack only holds entries that were in the undo stack when it
+	// last fit, so trimming from the bottom of the undo stack is enough
+	while (m_memoryUsage > m_memoryLimit && m_undoStack.size() > 1) {
+		UndoEntry *oldest = m_undoStack.front().get();
+		m_memoryUsage -= oldest->m_memoryUsage;
+		m_baseId = oldest->m_id;
+		m_undoStack.pop_front();
+	}
+}
+
 void UndoSystem::BeginEntry(std::string_view name)
 {
 	assert(!m_doing && "Cannot begin an entry inside an undo step!");
@@ -153,12 +245,26 @@ void UndoSystem::EndEntry()
 
 	// if the entry represents a change to the application state, commit it to
 	// the undo stack and clear redo state
+	m_openUndoEntry->MergeLastStep();
+
 	if (m_openUndoEntry->HasChanged()) {
 		UndoEntry *entry = m_openUndoEntry.release();
+
+		entry->m_memoryUsage = sizeof(UndoEntry);
+		for (auto &step : entry->m_steps) {
+			step->Compact();
+			entry->m_memoryUsage += step->GetMemoryUsage();
+		}
+
 		m_undoStack.emplace_back(entry);
+		m_memoryUsage += entry->m_memoryUsage;
 
+		for (auto &redo : m_redoStack)
+			m_memoryUsage -= redo->m_memoryUsage;
 		if (!m_redoStack.empty())
 			m_redoStack.clear();
+
+		TrimHistory();
 	} else {
 		// otherwise, just get rid of the entry without touching redo state
 		m_openUndoEntry.reset();
@@ -170,5 +276,8 @@ void UndoSystem::AddUndoStep(UndoStep *undo)
 	assert(!m_doing && "Cannot add an undo step inside an undo step!");
 	assert(m_openUndoEntry && "Cannot add an undo step without a valid open undo entry!");
 
+	// the previous step is complete by now (helpers apply their change right
+	// after adding it), so it can be merged into the one before
+	m_openUndoEntry->MergeLastStep();
 	m_openUndoEntry->m_steps.emplace_back(undo);
 }
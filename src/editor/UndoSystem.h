@@ -5,6 +5,7 @@
 
 #include "core/StringName.h"
 
+#include <deque>
 #include <memory>
 #include <string_view>
 #include <vector>
@@ -45,6 +46,21 @@ public:
 	// Optimization step: entries for which none of the steps represent a
 	// change in state will not be added to the undo stack
 	virtual bool HasChanged() const { return true; }
+
+	// Optimization step: of two consecutive steps of the same type in an entry
+	// that store the same piece of state, the later one is redundant (undoing
+	// the earlier one restores the state from before both) and is discarded.
+	// Only called with a step of the exact same type as this one.
+	virtual bool HasSameTarget(const UndoStep &other) const { return false; }
+
+	// Called when the entry is committed to the undo stack, after which the
+	// application state is always the same whenever the step is undone.
+	// Steps can use this to store their state more compactly.
+	virtual void Compact() {}
+
+	// Approximate number of bytes kept alive by the step, used to keep the
+	// undo history within its memory limit
+	virtual size_t GetMemoryUsage() const { return sizeof(UndoStep); }
 };
 
 /*
@@ -68,8 +84,12 @@ private:
 
 	bool HasChanged() const;
 
+	// Discard the last step if it's redundant with the one before
+	void MergeLastStep();
+
 	StringName m_name;
 	size_t m_id;
+	size_t m_memoryUsage = 0;
 	std::vector<std::unique_ptr<UndoStep>> m_steps;
 };
 
@@ -108,6 +128,12 @@ private:
  * of the application, you can call ResetEntry() each frame to undo and discard
  * all submitted UndoSteps() in the currently active entry. All submitted steps
  * will be undone, regardless of BeginEntry() recursion level.
+ *
+ * ============================================================================
+ *
+ * The history is kept within a memory limit: when committing an entry takes
+ * it over, the oldest entries are discarded until it fits again. The newest
+ * entry is always kept, however large.
  */
 class UndoSystem {
 public:
@@ -139,6 +165,13 @@ public:
 	// Destroy all undo/redo history (e.g. when closing a file)
 	void Clear();
 
+	// Approximate memory used by the undo and redo history
+	size_t GetMemoryUsage() const { return m_memoryUsage; }
+
+	// Discard the oldest entries while the history is over this many bytes
+	void SetMemoryLimit(size_t bytes);
+	size_t GetMemoryLimit() const { return m_memoryLimit; }
+
 	// Begin a new undo entry (can be recursive)
 	void BeginEntry(std::string_view name);
 
@@ -162,13 +195,21 @@ public:
 
 private:
 	void AddUndoStep(UndoStep *undo);
+	void TrimHistory();
 
-	std::vector<std::unique_ptr<UndoEntry>> m_undoStack;
+	static constexpr size_t DEFAULT_MEMORY_LIMIT = 64 * 1024 * 1024;
+
+	std::deque<std::unique_ptr<UndoEntry>> m_undoStack;
 	std::vector<std::unique_ptr<UndoEntry>> m_redoStack;
 
 	std::unique_ptr<UndoEntry> m_openUndoEntry;
 	size_t m_openUndoDepth;
 	size_t m_entryId;
+	// id of the newest entry discarded from the bottom of the undo stack
+	size_t m_baseId;
+
+	size_t m_memoryUsage;
+	size_t m_memoryLimit;
 
 	bool m_doing;
 };
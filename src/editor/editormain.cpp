@@ -13,6 +13,9 @@ extern "C" int main(int argc, char **argv) {
 
 	Editor::EditorApp *app = Editor::EditorApp::Get(); // instance the editor application
 
+	// batch runs only process files, there's nothing to show
+	app->SetHeadless(cmdline["--batch-systems"]);
+
 	app->Startup();
 	app->Initialize(cmdline);
 
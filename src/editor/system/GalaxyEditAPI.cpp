@@ -12,6 +12,7 @@
 #include "editor/EditorDraw.h"
 
 #include "EnumStrings.h"
+#include "Json.h"
 #include "galaxy/Sector.h"
 #include "galaxy/Galaxy.h"
 #include "galaxy/NameGenerator.h"
@@ -246,6 +247,64 @@ void StarSystem::EditorAPI::GenerateStarList(StarSystem *system)
 
 }
 
+RefCountedPtr<StarSystem> StarSystem::EditorAPI::LoadCustomSystem(RefCountedPtr<Galaxy> galaxy, const CustomSystem *csys, CustomSystemInfo &custom)
+{
+	SystemPath path = {csys->sectorX, csys->sectorY, csys->sectorZ, csys->systemIndex};
+	Uint32 _init[5] = { Uint32(csys->seed), Uint32(csys->sectorX), Uint32(csys->sectorY), Uint32(csys->sectorZ), UNIVERSE_SEED };
+	Random rng(_init, 5);
+
+	RefCountedPtr<StarSystem::GeneratorAPI> system(new StarSystem::GeneratorAPI(path, galaxy, nullptr, rng));
+	auto customStage = std::make_unique<StarSystemCustomGenerator>();
+
+	if (!customStage->ApplyToSystem(rng, system, csys)) {
+		Log::Error("System is fully random, cannot load from file");
+		return {};
+	}
+
+	// NOTE: we don't run the PopulateSystem generator here, due to its
+	// reliance on filled-out Sector information
+	// As a result, population information will not be correct
+
+	if (!system->GetRootBody()) {
+		Log::Error("Custom system doesn't have a root body");
+		return {};
+	}
+
+	CustomSystemInfo::ExplorationState explored = csys->explored ?
+		CustomSystemInfo::EXPLORE_ExploredAtStart :
+		CustomSystemInfo::EXPLORE_Unexplored;
+
+	custom.explored = csys->want_rand_explored ? CustomSystemInfo::EXPLORE_Random : explored;
+	custom.randomLawlessness = csys->want_rand_lawlessness;
+	custom.randomFaction = csys->faction == nullptr;
+	custom.faction = csys->faction ? csys->faction->name : "";
+
+	return system;
+}
+
+void StarSystem::EditorAPI::SaveCustomSystem(StarSystem *system, const CustomSystemInfo &custom, Json &systemdef)
+{
+	// Generate the list of stars in this system
+	GenerateStarList(system);
+
+	system->DumpToJson(systemdef);
+
+	if (custom.randomFaction)
+		systemdef.erase("faction");
+	else
+		systemdef["faction"] = custom.faction;
+
+	if (custom.randomLawlessness)
+		systemdef.erase("lawlessness");
+
+	if (custom.explored == CustomSystemInfo::EXPLORE_Random)
+		systemdef.erase("explored");
+	else
+		systemdef["explored"] = custom.explored == CustomSystemInfo::EXPLORE_ExploredAtStart;
+
+	systemdef["comment"] = custom.comment;
+}
+
 void StarSystem::EditorAPI::EditName(StarSystem *system, Random &rng, UndoSystem *undo)
 {
 	ImGui::BeginGroup();
@@ -311,7 +370,7 @@ void StarSystem::EditorAPI::EditName(StarSystem *system, Random &rng, UndoSystem
 	ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
 	ImGui::InputTextMultiline("##Long Description", &system->m_longDesc, ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 5.f + ImGui::GetStyle().WindowPadding.y * 2.f));
 	if (Draw::UndoHelper("Edit System Long Description", undo))
-		AddUndoSingleValue(undo, &system->m_longDesc);
+		AddUndoDeltaValue(undo, &system->m_longDesc);
 }
 
 void StarSystem::EditorAPI::EditProperties(StarSystem *system, CustomSystemInfo &custom, FactionsDatabase *factions, UndoSystem *undo)
@@ -489,12 +548,28 @@ size_t SystemBody::EditorAPI::GetIndexInParent(SystemBody *body)
 	return std::distance(parent->GetChildren().begin(), iter);
 }
 
-void SystemBody::EditorAPI::EditOrbitalParameters(SystemBody *body, UndoSystem *undo)
+void SystemBody::EditorAPI::UpdateDerived(SystemBody *body, uint32_t flags)
+{
+	if (flags & UPDATE_Orbit)
+		body->SetOrbitFromParameters();
+
+	if (flags & UPDATE_Atmosphere)
+		body->SetAtmFromParameters();
+
+	// only the direct satellites orbit the body's mass; their own satellites
+	// orbit them and are unaffected
+	if (flags & UPDATE_Satellites) {
+		for (SystemBody *child : body->GetChildren())
+			child->SetOrbitFromParameters();
+	}
+}
+
+uint32_t SystemBody::EditorAPI::EditOrbitalParameters(SystemBody *body, UndoSystem *undo)
 {
 	ImGui::SeparatorText("Orbital Parameters");
 
 	bool orbitChanged = false;
-	auto updateBodyOrbit = [=](){ body->SetOrbitFromParameters(); };
+	auto updateBodyOrbit = [=](){ UpdateDerived(body, UPDATE_Orbit); };
 
 	orbitChanged |= Draw::InputFixedDistance("Semi-Major Axis", &body->m_semiMajorAxis);
 	if (Draw::UndoHelper("Edit Semi-Major Axis", undo))
@@ -569,9 +644,7 @@ void SystemBody::EditorAPI::EditOrbitalParameters(SystemBody *body, UndoSystem *
 	if (Draw::UndoHelper("Edit Rotation Period", undo))
 		AddUndoSingleValueClosure(undo, &body->m_rotationPeriod, updateBodyOrbit);
 
-	if (orbitChanged)
-		body->SetOrbitFromParameters();
-
+	return orbitChanged ? UPDATE_Orbit : 0;
 }
 
 void SystemBody::EditorAPI::EditEconomicProperties(SystemBody *body, UndoSystem *undo)
@@ -598,26 +671,27 @@ void SystemBody::EditorAPI::EditEconomicProperties(SystemBody *body, UndoSystem
 	ImGui::EndDisabled();
 }
 
-void SystemBody::EditorAPI::EditStarportProperties(SystemBody *body, UndoSystem *undo)
+uint32_t SystemBody::EditorAPI::EditStarportProperties(SystemBody *body, UndoSystem *undo)
 {
-	bool orbitChanged = false;
+	uint32_t updateFlags = 0;
 
 	if (body->GetType() == TYPE_STARPORT_SURFACE) {
 		ImGui::SeparatorText("Surface Parameters");
 
-		orbitChanged |= Draw::InputFixedDegrees("Latitude", &body->m_inclination);
+		auto updateBodyOrbit = [=](){ UpdateDerived(body, UPDATE_Orbit); };
+
+		if (Draw::InputFixedDegrees("Latitude", &body->m_inclination))
+			updateFlags |= UPDATE_Orbit;
 		if (Draw::UndoHelper("Edit Latitude", undo))
-			AddUndoSingleValueClosure(undo, &body->m_inclination, [=](){ body->SetOrbitFromParameters(); });
+			AddUndoSingleValueClosure(undo, &body->m_inclination, updateBodyOrbit);
 
-		orbitChanged |= Draw::InputFixedDegrees("Longitude", &body->m_orbitalOffset);
+		if (Draw::InputFixedDegrees("Longitude", &body->m_orbitalOffset))
+			updateFlags |= UPDATE_Orbit;
 		if (Draw::UndoHelper("Edit Longitude", undo))
-			AddUndoSingleValueClosure(undo, &body->m_orbitalOffset, [=](){ body->SetOrbitFromParameters(); });
-
-		if (orbitChanged)
-			body->SetOrbitFromParameters();
+			AddUndoSingleValueClosure(undo, &body->m_orbitalOffset, updateBodyOrbit);
 
 	} else {
-		EditOrbitalParameters(body, undo);
+		updateFlags |= EditOrbitalParameters(body, undo);
 	}
 
 	EditEconomicProperties(body, undo);
@@ -629,6 +703,8 @@ void SystemBody::EditorAPI::EditStarportProperties(SystemBody *body, UndoSystem
 		AddUndoSingleValue(undo, &body->m_spaceStationType);
 
 	Draw::HelpMarker("Model name (without extension) to use for this starport.\nA random model is chosen if not specified.");
+
+	return updateFlags;
 }
 
 void SystemBody::EditorAPI::EditBodyName(SystemBody *body, Random &rng, LuaNameGen *nameGen, UndoSystem *undo)
@@ -653,13 +729,20 @@ void SystemBody::EditorAPI::EditBodyName(SystemBody *body, Random &rng, LuaNameG
 		AddUndoSingleValue(undo, &body->m_name);
 }
 
-void SystemBody::EditorAPI::EditProperties(SystemBody *body, Random &rng, UndoSystem *undo)
+uint32_t SystemBody::EditorAPI::EditProperties(SystemBody *body, Random &rng, UndoSystem *undo)
 {
 	bool isStar = body->GetSuperType() <= SUPERTYPE_STAR;
 
+	uint32_t updateFlags = 0;
 	bool bodyChanged = false;
+	bool massChanged = false;
 	auto updateBodyDerived = [=]() {
-		body->SetAtmFromParameters();
+		UpdateDerived(body, UPDATE_Atmosphere);
+	};
+	// the orbits of the body around a barycentre and of its satellites
+	// depend on its mass
+	auto updateBodyMass = [=]() {
+		UpdateDerived(body, UPDATE_Orbit | UPDATE_Atmosphere | UPDATE_Satellites);
 	};
 
 	Draw::EditEnum("Edit Body Type", "Body Type", "BodyType", reinterpret_cast<int *>(&body->m_type), BodyType::TYPE_MAX, undo);
@@ -672,16 +755,16 @@ void SystemBody::EditorAPI::EditProperties(SystemBody *body, Random &rng, UndoSy
 
 		if ((!isStar || body->GetType() == TYPE_BROWN_DWARF) && ImGui::Button(EICON_RANDOM " Body Stats")) {
 			GenerateDerivedStats(body, rng, undo);
-			bodyChanged = true;
+			massChanged = true;
 		}
 
 		ImGui::SetItemTooltip("Generate body type, radius, temperature, and surface parameters using the same method as procedural system generation.");
 
 		ImGui::SeparatorText("Body Parameters");
 
-		bodyChanged |= Draw::InputFixedMass("Mass", &body->m_mass, isStar);
+		massChanged |= Draw::InputFixedMass("Mass", &body->m_mass, isStar);
 		if (Draw::UndoHelper("Edit Mass", undo))
-			AddUndoSingleValueClosure(undo, &body->m_mass, updateBodyDerived);
+			AddUndoSingleValueClosure(undo, &body->m_mass, updateBodyMass);
 
 		bodyChanged |= Draw::InputFixedRadius("Radius",  &body->m_radius, isStar);
 		if (Draw::UndoHelper("Edit Radius", undo))
@@ -732,16 +815,18 @@ void SystemBody::EditorAPI::EditProperties(SystemBody *body, Random &rng, UndoSy
 		}
 
 	} else {
-		EditStarportProperties(body, undo);
-		return;
+		return EditStarportProperties(body, undo);
 	}
 
+	if (massChanged)
+		updateFlags |= UPDATE_Orbit | UPDATE_Atmosphere | UPDATE_Satellites;
+
 	if (body->GetParent()) {
-		EditOrbitalParameters(body, undo);
+		updateFlags |= EditOrbitalParameters(body, undo);
 	}
 
 	if (isStar) {
-		return;
+		return updateFlags;
 	}
 
 	ImGui::SeparatorText("Surface Parameters");
@@ -800,12 +885,12 @@ void SystemBody::EditorAPI::EditProperties(SystemBody *body, Random &rng, UndoSy
 
 	Draw::HelpMarker("Fractal type index for use with a custom heightmap file.");
 
+	if (bodyChanged)
+		updateFlags |= UPDATE_Atmosphere;
+
 	if (Draw::DerivedValues("Surface Parameters")) {
 		ImGui::BeginDisabled();
 
-		if (bodyChanged)
-			body->SetAtmFromParameters();
-
 		double pressure_p0 = body->GetAtmSurfacePressure();
 		ImGui::InputDouble("Surface Pressure", &pressure_p0, 0.0, 0.0, "%.4f atm");
 
@@ -819,6 +904,8 @@ void SystemBody::EditorAPI::EditProperties(SystemBody *body, Random &rng, UndoSy
 	}
 
 	EditEconomicProperties(body, undo);
+
+	return updateFlags;
 }
 
 void SystemBody::EditorAPI::GenerateDerivedStats(SystemBody *body, Random &rng, UndoSystem *undo)
@@ -847,3 +934,70 @@ void SystemBody::EditorAPI::GenerateDerivedStats(SystemBody *body, Random &rng,
 
 	undo->EndEntry();
 }
+
+size_t SystemBody::EditorAPI::EditBodies(const std::vector<SystemBody *> &bodies, const std::function<uint32_t(SystemBody *)> &fn)
+{
+	std::vector<uint32_t> flags(bodies.size());
+	for (size_t idx = 0; idx < bodies.size(); idx++)
+		flags[idx] = fn(bodies[idx]);
+
+	// the derived data depends on the parameters of the parent as well, so
+	// only update once every body has been edited
+	size_t numEdited = 0;
+	for (size_t idx = 0; idx < bodies.size(); idx++) {
+		if (!flags[idx])
+			continue;
+
+		UpdateDerived(bodies[idx], flags[idx]);
+		numEdited++;
+	}
+
+	return numEdited;
+}
+
+size_t SystemBody::EditorAPI::ValidateBodies(const std::vector<SystemBody *> &bodies, std::vector<std::string> &issues)
+{
+	const size_t numIssues = issues.size();
+	auto report = [&](const SystemBody *body, std::string_view message) {
+		issues.push_back(fmt::format("{} ({}): {}", body->m_name, body->m_path.bodyIndex, message));
+	};
+
+	for (const SystemBody *body : bodies) {
+		const SystemBody *parent = body->m_parent;
+		const bool isStarport = body->GetSuperType() == SystemBody::SUPERTYPE_STARPORT;
+		const bool isSurface = body->GetType() == SystemBody::TYPE_STARPORT_SURFACE;
+
+		if (body->m_name.empty())
+			report(body, "has no name");
+
+		if (!isStarport && body->GetType() != SystemBody::TYPE_GRAVPOINT) {
+			if (body->m_radius <= 0)
+				report(body, "has no radius");
+			if (body->m_mass <= 0)
+				report(body, "has no mass");
+		}
+
+		if (isSurface && (!parent || parent->GetSuperType() != SystemBody::SUPERTYPE_ROCKY_PLANET))
+			report(body, "is a surface starport not on a rocky planet");
+
+		if (!parent || isSurface)
+			continue;
+
+		if (body->m_eccentricity < 0 || body->m_eccentricity >= 1)
+			report(body, fmt::format("has eccentricity {:.3f} outside of [0, 1)", body->m_eccentricity.ToDouble()));
+
+		if (body->m_semiMajorAxis <= 0) {
+			report(body, "does not orbit its parent");
+			continue;
+		}
+
+		const double periapsis = (body->m_semiMajorAxis * (fixed(1, 1) - body->m_eccentricity)).ToDouble() * AU;
+		if (parent->GetType() != SystemBody::TYPE_GRAVPOINT && periapsis < parent->GetRadius())
+			report(body, fmt::format("passes through parent {} at periapsis", parent->m_name));
+
+		if (!isStarport && parent->GetType() != SystemBody::TYPE_GRAVPOINT && body->GetMass() > parent->GetMass())
+			report(body, fmt::format("is more massive than parent {}", parent->m_name));
+	}
+
+	return issues.size() - numIssues;
+}
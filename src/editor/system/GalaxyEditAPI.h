@@ -3,9 +3,13 @@
 
 #pragma once
 
+#include "JsonFwd.h"
 #include "galaxy/StarSystem.h"
 #include "galaxy/SystemBody.h"
 
+#include <functional>
+
+class CustomSystem;
 class LuaNameGen;
 class FactionsDatabase;
 
@@ -49,12 +53,33 @@ public:
 	// Regenerate the system's internal list of stars for export
 	static void GenerateStarList(StarSystem *system);
 
+	// Build an editable system from a complete custom system definition, and
+	// fill in the parts of the definition the system doesn't keep. Returns
+	// null if the definition leaves the system's bodies to be random.
+	static RefCountedPtr<StarSystem> LoadCustomSystem(RefCountedPtr<Galaxy> galaxy, const CustomSystem *csys, Editor::CustomSystemInfo &custom);
+
+	// Write the system out as a custom system definition
+	static void SaveCustomSystem(StarSystem *system, const Editor::CustomSystemInfo &custom, Json &systemdef);
+
 	static void EditName(StarSystem *system, Random &rng, Editor::UndoSystem *undo);
 	static void EditProperties(StarSystem *system, Editor::CustomSystemInfo &custom, FactionsDatabase *factions, Editor::UndoSystem *undo);
 };
 
 class SystemBody::EditorAPI {
 public:
+	// The derived data an edit of a body's parameters makes stale. The edit
+	// functions return these rather than recomputing on every change, so the
+	// editor can batch the updates while a value is being dragged.
+	enum UpdateFlags : uint32_t {
+		UPDATE_Orbit = 1 << 0,		// the body's own orbit
+		UPDATE_Atmosphere = 1 << 1, // the body's atmosphere
+		UPDATE_Satellites = 1 << 2, // the orbits around the body, after a mass change
+	};
+
+	// Recomputes the derived data of the body and of the satellites whose
+	// orbits depend on it; nothing else in the system changes
+	static void UpdateDerived(SystemBody *body, uint32_t flags);
+
 	static void GenerateDefaultName(SystemBody *body);
 	static void GenerateCustomName(SystemBody *body, Random &rng);
 
@@ -62,11 +87,23 @@ public:
 	static SystemBody *RemoveChild(SystemBody *parent, size_t idx = -1);
 	static size_t GetIndexInParent(SystemBody *body);
 
-	static void EditOrbitalParameters(SystemBody *body, Editor::UndoSystem *undo);
+	// these return the UpdateFlags of the changes made this frame
+	static uint32_t EditOrbitalParameters(SystemBody *body, Editor::UndoSystem *undo);
 	static void EditEconomicProperties(SystemBody *body, Editor::UndoSystem *undo);
-	static void EditStarportProperties(SystemBody *body, Editor::UndoSystem *undo);
+	static uint32_t EditStarportProperties(SystemBody *body, Editor::UndoSystem *undo);
 	static void EditBodyName(SystemBody *body, Random &rng, LuaNameGen *nameGen, Editor::UndoSystem *undo);
-	static void EditProperties(SystemBody *body, Random &rng, Editor::UndoSystem *undo);
+	static uint32_t EditProperties(SystemBody *body, Random &rng, Editor::UndoSystem *undo);
 
 	static void GenerateDerivedStats(SystemBody *body, Random &rng, Editor::UndoSystem *undo);
+
+	// Bulk edits and checks over many bodies at once, for tooling; these
+	// bypass the UI and the undo system entirely.
+
+	// Calls fn on every body, then updates each body by the UpdateFlags fn
+	// returned for it. Returns the number of bodies fn changed.
+	static size_t EditBodies(const std::vector<SystemBody *> &bodies, const std::function<uint32_t(SystemBody *)> &fn);
+
+	// Appends a line to issues for each problem with the parameters of the
+	// bodies. Returns the number of problems found.
+	static size_t ValidateBodies(const std::vector<SystemBody *> &bodies, std::vector<std::string> &issues);
 };
@@ -0,0 +1,381 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "SystemBatch.h"
+
+#include "FileSystem.h"
+#include "JsonUtils.h"
+#include "core/Log.h"
+#include "core/StringUtils.h"
+#include "core/TaskGraph.h"
+
+#include "editor/EditorApp.h"
+#include "editor/UndoSystem.h"
+
+#include "galaxy/Galaxy.h"
+#include "galaxy/GalaxyGenerator.h"
+
+#include "argh/argh.h"
+
+#include <chrono>
+
+using namespace Editor;
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double SecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	void LogThroughput(std::string_view stage, size_t numSystems, size_t numBodies, double seconds)
+	{
+		// keep very fast stages from dividing by zero
+		const double rate = 1.0 / std::max(seconds, 1e-6);
+		Log::Info("{:>8}: {} systems in {:.3f}s, {:.1f} systems/s, {:.1f} bodies/s",
+			stage, numSystems, seconds, numSystems * rate, numBodies * rate);
+	}
+
+	void RunValidate(SystemBatch::System &system)
+	{
+		SystemBody::EditorAPI::ValidateBodies(system.bodies, system.issues);
+	}
+
+	void RunSort(SystemBatch::System &system)
+	{
+		// the sort records what it did for the editor's undo stack
+		UndoSystem undo;
+		undo.BeginEntry("Sort Bodies");
+		StarSystem::EditorAPI::SortBodyHierarchy(system.system.Get(), &undo);
+		undo.EndEntry();
+
+		for (size_t idx = 0; idx < system.bodies.size(); idx++) {
+			if (system.system->GetBodies()[idx].Get() != system.bodies[idx]) {
+				system.edited = true;
+				break;
+			}
+		}
+	}
+
+	void RunDefaultNames(SystemBatch::System &system)
+	{
+		// a new name doesn't make any derived data stale, so EditBodies
+		// wouldn't count it
+		size_t numNamed = 0;
+		SystemBody::EditorAPI::EditBodies(system.bodies, [&](SystemBody *body) -> uint32_t {
+			if (body->GetName().empty()) {
+				SystemBody::EditorAPI::GenerateDefaultName(body);
+				numNamed++;
+			}
+
+			return 0;
+		});
+
+		system.edited |= numNamed > 0;
+	}
+
+	const std::pair<std::string_view, void (*)(SystemBatch::System &)> s_builtinPasses[] = {
+		{ "validate", &RunValidate },
+		{ "sort", &RunSort },
+		{ "default-names", &RunDefaultNames },
+	};
+} // namespace
+
+// ============================================================================
+//  SystemBatch
+// ============================================================================
+
+SystemBatch::SystemBatch(TaskGraph *taskGraph, RefCountedPtr<Galaxy> galaxy) :
+	m_taskGraph(taskGraph),
+	m_galaxy(galaxy),
+	m_systemLoader(new CustomSystemsDatabase(galaxy.Get(), "systems"))
+{
+}
+
+SystemBatch::~SystemBatch()
+{
+}
+
+bool SystemBatch::GetBuiltinPass(std::string_view name, Pass &pass)
+{
+	for (const auto &builtin : s_builtinPasses) {
+		if (builtin.first == name) {
+			pass = { std::string(name), builtin.second };
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::vector<std::string_view> SystemBatch::GetBuiltinPassNames()
+{
+	std::vector<std::string_view> names;
+	for (const auto &builtin : s_builtinPasses)
+		names.push_back(builtin.first);
+
+	return names;
+}
+
+void SystemBatch::AddPass(Pass pass)
+{
+	m_passes.push_back(std::move(pass));
+}
+
+size_t SystemBatch::AddPath(const std::string &path)
+{
+	const size_t numFiles = m_files.size();
+
+	if (ends_with_ci(path, ".json")) {
+		std::string dirpath = path.substr(0, path.find_last_of("/\\"));
+		std::string filename = path.substr(dirpath.size() + 1);
+
+		m_files.push_back({ dirpath, filename });
+		return 1;
+	}
+
+	FileSystem::FileSourceFS fs(path);
+	for (const FileSystem::FileInfo &info : fs.Enumerate("", FileSystem::FileEnumerator::Recurse)) {
+		if (info.IsFile() && ends_with_ci(info.GetPath(), ".json"))
+			m_files.push_back({ path, info.GetPath() });
+	}
+
+	// the enumeration order depends on the file system
+	std::sort(m_files.begin() + numFiles, m_files.end(), [](const File &a, const File &b) {
+		return a.filepath < b.filepath;
+	});
+
+	return m_files.size() - numFiles;
+}
+
+void SystemBatch::RunTasks(const std::function<void(size_t)> &fn)
+{
+	TaskSet *set = new TaskSet();
+	set->AddTaskRangeLambda({ 0, uint32_t(m_systems.size()) }, 1, [&](TaskRange range) {
+		for (uint32_t idx = range.begin; idx < range.end; idx++)
+			fn(idx);
+	});
+
+	TaskSet::Handle handle = m_taskGraph->QueueTaskSet(set);
+	m_taskGraph->WaitForTaskSet(handle);
+}
+
+void SystemBatch::GatherBodies(System &system)
+{
+	system.bodies.clear();
+	for (const RefCountedPtr<SystemBody> &body : system.system->GetBodies())
+		system.bodies.push_back(body.Get());
+}
+
+bool SystemBatch::LoadSystem(const File &file, System &system)
+{
+	system.filepath = FileSystem::JoinPath(file.basedir, file.filepath);
+
+	FileSystem::FileSourceFS fs(file.basedir);
+	RefCountedPtr<FileSystem::FileData> data = fs.ReadFile(file.filepath);
+	if (!data) {
+		Log::Warning("Cannot open file path {}", system.filepath);
+		return false;
+	}
+
+	// parsing the text is the bulk of the work, and can be done on any thread
+	const Json systemdef = JsonUtils::LoadJson(data);
+	if (systemdef.is_null())
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_loaderLock);
+
+	std::unique_ptr<CustomSystem> csys(m_systemLoader->LoadSystemFromJSON(file.filepath, systemdef, false));
+	if (!csys)
+		return false;
+
+	system.system = StarSystem::EditorAPI::LoadCustomSystem(m_galaxy, csys.get(), system.info);
+	if (!system.system)
+		return false;
+
+	system.info.comment = systemdef.value("comment", "");
+	GatherBodies(system);
+
+	return true;
+}
+
+bool SystemBatch::WriteSystem(const File &file, System &system)
+{
+	Json systemdef = Json::object();
+	StarSystem::EditorAPI::SaveCustomSystem(system.system.Get(), system.info, systemdef);
+
+	const std::string jsonData = systemdef.dump(1, '\t');
+
+	FileSystem::FileSourceFS fs(m_outputDir.empty() ? file.basedir : m_outputDir);
+
+	const size_t dirEnd = file.filepath.find_last_of("/\\");
+	if (dirEnd != std::string::npos && !fs.MakeDirectory(file.filepath.substr(0, dirEnd)))
+		return false;
+
+	// write next to the file first, so a failed write doesn't leave a
+	// truncated definition behind
+	const std::string tempPath = file.filepath + ".tmp";
+	FILE *f = fs.OpenWriteStream(tempPath, FileSystem::FileSourceFS::WRITE_TEXT);
+	if (!f)
+		return false;
+
+	const bool ok = fwrite(jsonData.data(), 1, jsonData.size(), f) == jsonData.size();
+	fclose(f);
+
+	if (!ok || !fs.RenameFile(tempPath, file.filepath)) {
+		fs.RemoveFile(tempPath);
+		return false;
+	}
+
+	return true;
+}
+
+SystemBatch::Stats SystemBatch::Run()
+{
+	Stats stats = {};
+	stats.numFiles = m_files.size();
+
+	m_systems.clear();
+	for (size_t idx = 0; idx < m_files.size(); idx++)
+		m_systems.emplace_back(new System());
+
+	// Load
+	Clock::time_point start = Clock::now();
+
+	std::vector<char> loaded(m_systems.size(), false);
+	RunTasks([&](size_t idx) {
+		loaded[idx] = LoadSystem(m_files[idx], *m_systems[idx]);
+	});
+
+	stats.loadTime = SecondsSince(start);
+
+	for (size_t idx = 0; idx < m_systems.size(); idx++) {
+		if (!loaded[idx]) {
+			Log::Warning("Could not load custom system {}", m_systems[idx]->filepath);
+			stats.numFailed++;
+		}
+
+		stats.numBodies += m_systems[idx]->bodies.size();
+	}
+
+	LogThroughput("load", m_systems.size(), stats.numBodies, stats.loadTime);
+
+	// Passes; each one finishes on every system before the next starts, so
+	// a pass can rely on the results of the one before
+	start = Clock::now();
+
+	for (const Pass &pass : m_passes) {
+		Clock::time_point passStart = Clock::now();
+
+		RunTasks([&](size_t idx) {
+			if (!loaded[idx])
+				return;
+
+			pass.run(*m_systems[idx]);
+			// the pass may have added, removed or reordered bodies
+			GatherBodies(*m_systems[idx]);
+		});
+
+		LogThroughput(pass.name, m_systems.size() - stats.numFailed, stats.numBodies, SecondsSince(passStart));
+	}
+
+	stats.passTime = SecondsSince(start);
+
+	// Write
+	if (m_writeEdited) {
+		start = Clock::now();
+
+		std::vector<char> written(m_systems.size(), false);
+		RunTasks([&](size_t idx) {
+			if (loaded[idx] && m_systems[idx]->edited)
+				written[idx] = WriteSystem(m_files[idx], *m_systems[idx]);
+		});
+
+		stats.writeTime = SecondsSince(start);
+
+		size_t numEditedBodies = 0;
+		for (size_t idx = 0; idx < m_systems.size(); idx++) {
+			if (!loaded[idx] || !m_systems[idx]->edited)
+				continue;
+
+			if (written[idx]) {
+				stats.numWritten++;
+				numEditedBodies += m_systems[idx]->bodies.size();
+			} else {
+				Log::Warning("Could not write custom system {}", m_systems[idx]->filepath);
+			}
+		}
+
+		LogThroughput("write", stats.numWritten, numEditedBodies, stats.writeTime);
+	}
+
+	for (const auto &system : m_systems)
+		stats.numIssues += system->issues.size();
+
+	return stats;
+}
+
+// ============================================================================
+//  SystemBatchRunner
+// ============================================================================
+
+SystemBatchRunner::SystemBatchRunner(EditorApp *app, argh::parser &cmdline) :
+	m_app(app),
+	m_dryRun(cmdline["--dry-run"])
+{
+	// the first positional argument is the editor itself
+	for (size_t idx = 1; idx < cmdline.size(); idx++)
+		m_paths.push_back(FileSystem::JoinPath(FileSystem::GetDataDir(), cmdline[idx]));
+
+	std::string passes;
+	cmdline("--pass", "validate") >> passes;
+	for (std::string_view pass : SplitString(passes, ","))
+		m_passes.emplace_back(pass);
+
+	cmdline("--output", "") >> m_outputDir;
+}
+
+SystemBatchRunner::~SystemBatchRunner()
+{
+}
+
+void SystemBatchRunner::Start()
+{
+	SystemBatch batch(m_app->GetTaskGraph(), GalaxyGenerator::Create());
+	batch.SetOutputDir(m_outputDir);
+	batch.SetWriteEdited(!m_dryRun);
+
+	for (const std::string &name : m_passes) {
+		SystemBatch::Pass pass;
+		if (!SystemBatch::GetBuiltinPass(name, pass)) {
+			std::string names;
+			for (std::string_view builtin : SystemBatch::GetBuiltinPassNames())
+				names += fmt::format("{}{}", names.empty() ? "" : ", ", builtin);
+
+			Log::Error("Unknown batch pass {}, expected one of: {}", name, names);
+			return;
+		}
+
+		batch.AddPass(std::move(pass));
+	}
+
+	for (const std::string &path : m_paths)
+		batch.AddPath(path);
+
+	SystemBatch::Stats stats = batch.Run();
+
+	for (const auto &system : batch.GetSystems()) {
+		for (const std::string &issue : system->issues)
+			Log::Info("{}: {}", system->filepath, issue);
+	}
+
+	Log::Info("Processed {} custom systems ({} bodies) in {:.3f}s: {} failed to load, {} issues, {} written",
+		stats.numFiles, stats.numBodies, stats.loadTime + stats.passTime + stats.writeTime,
+		stats.numFailed, stats.numIssues, stats.numWritten);
+}
+
+void SystemBatchRunner::Update(float dt)
+{
+	RequestEndLifecycle();
+}
@@ -0,0 +1,139 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#pragma once
+
+#include "GalaxyEditAPI.h"
+
+#include "RefCounted.h"
+#include "core/Application.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace argh {
+	class parser;
+} // namespace argh
+
+class CustomSystemsDatabase;
+class Galaxy;
+class TaskGraph;
+
+namespace Editor {
+
+	class EditorApp;
+
+	// Loads a large number of custom system definitions, runs edit and
+	// validation passes over their bodies and writes the edited systems back
+	// out, without going through any of the editor UI. Every stage is run on
+	// the task graph with one task per system.
+	class SystemBatch {
+	public:
+		struct System {
+			std::string filepath;
+			RefCountedPtr<StarSystem> system;
+			CustomSystemInfo info;
+			// all bodies of the system, in index order
+			std::vector<SystemBody *> bodies;
+			std::vector<std::string> issues;
+			// set by passes which changed the system and want it written out
+			bool edited = false;
+		};
+
+		// Passes are run on many systems at once, and must not touch anything
+		// but the system they are given
+		struct Pass {
+			std::string name;
+			std::function<void(System &system)> run;
+		};
+
+		struct Stats {
+			size_t numFiles = 0;
+			size_t numFailed = 0;
+			size_t numBodies = 0;
+			size_t numIssues = 0;
+			size_t numWritten = 0;
+			// wall time of each stage, in seconds
+			double loadTime = 0.0;
+			double passTime = 0.0;
+			double writeTime = 0.0;
+		};
+
+		SystemBatch(TaskGraph *taskGraph, RefCountedPtr<Galaxy> galaxy);
+		~SystemBatch();
+
+		// validate, sort, default-names
+		static bool GetBuiltinPass(std::string_view name, Pass &pass);
+		static std::vector<std::string_view> GetBuiltinPassNames();
+
+		void AddPass(Pass pass);
+
+		// Adds the .json definition at path, or every one in the directory at
+		// path and below. Returns the number of files added.
+		size_t AddPath(const std::string &path);
+
+		// Where edited systems are written, keeping their path relative to the
+		// directory they were added from; empty overwrites them in place
+		void SetOutputDir(const std::string &dir) { m_outputDir = dir; }
+		// Whether edited systems are written at all
+		void SetWriteEdited(bool write) { m_writeEdited = write; }
+
+		// Loads, processes and writes every file added, and logs the
+		// throughput of each stage
+		Stats Run();
+
+		const std::vector<std::unique_ptr<System>> &GetSystems() const { return m_systems; }
+
+	private:
+		struct File {
+			std::string basedir;
+			std::string filepath;
+		};
+
+		// runs fn(idx) for every system, spread over the task graph
+		void RunTasks(const std::function<void(size_t)> &fn);
+
+		bool LoadSystem(const File &file, System &system);
+		bool WriteSystem(const File &file, System &system);
+
+		static void GatherBodies(System &system);
+
+		TaskGraph *m_taskGraph;
+		RefCountedPtr<Galaxy> m_galaxy;
+		std::unique_ptr<CustomSystemsDatabase> m_systemLoader;
+		// turning a parsed definition into a system looks up factions and
+		// takes references on the galaxy, neither of which is thread-safe
+		std::mutex m_loaderLock;
+
+		std::vector<Pass> m_passes;
+		std::vector<File> m_files;
+		std::vector<std::unique_ptr<System>> m_systems;
+
+		std::string m_outputDir;
+		bool m_writeEdited = true;
+	};
+
+	// Runs a SystemBatch from the command line and quits once it is done:
+	//   editor --batch-systems [--pass=validate,sort] [--output=<dir>] [--dry-run] <paths...>
+	class SystemBatchRunner : public Application::Lifecycle {
+	public:
+		SystemBatchRunner(EditorApp *app, argh::parser &cmdline);
+		~SystemBatchRunner();
+
+	protected:
+		void Start() override;
+		void Update(float dt) override;
+
+	private:
+		EditorApp *m_app;
+
+		std::vector<std::string> m_paths;
+		std::vector<std::string> m_passes;
+		std::string m_outputDir;
+		bool m_dryRun;
+	};
+
+} // namespace Editor
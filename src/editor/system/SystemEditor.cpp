@@ -51,6 +51,10 @@ namespace {
 	static constexpr const char *OUTLINE_WND_ID = "Outline";
 	static constexpr const char *PROPERTIES_WND_ID = "Properties";
 	static constexpr const char *VIEWPORT_WND_ID = "Viewport";
+
+	// while a value is being dragged, the bodies it affects are updated at
+	// most this often (in seconds) rather than on every change
+	static constexpr double BODY_UPDATE_INTERVAL = 0.1;
 }
 
 const char *Editor::GetBodyIcon(const SystemBody *body) {
@@ -251,26 +255,7 @@ bool SystemEditor::WriteSystem(const std::string &filepath)
 	}
 
 	Json systemdef = Json::object();
-
-	// Generate the list of stars in this system
-	StarSystem::EditorAPI::GenerateStarList(m_system.Get());
-
-	m_system->DumpToJson(systemdef);
-
-	if (m_systemInfo.randomFaction)
-		systemdef.erase("faction");
-	else
-		systemdef["faction"] = m_systemInfo.faction;
-
-	if (m_systemInfo.randomLawlessness)
-		systemdef.erase("lawlessness");
-
-	if (m_systemInfo.explored == CustomSystemInfo::EXPLORE_Random)
-		systemdef.erase("explored");
-	else
-		systemdef["explored"] = m_systemInfo.explored == CustomSystemInfo::EXPLORE_ExploredAtStart;
-
-	systemdef["comment"] = m_systemInfo.comment;
+	StarSystem::EditorAPI::SaveCustomSystem(m_system.Get(), m_systemInfo, systemdef);
 
 	std::string jsonData = systemdef.dump(1, '\t');
 
@@ -283,39 +268,13 @@ bool SystemEditor::WriteSystem(const std::string &filepath)
 
 bool SystemEditor::LoadCustomSystem(const CustomSystem *csys)
 {
-	SystemPath path = {csys->sectorX, csys->sectorY, csys->sectorZ, csys->systemIndex};
-	Uint32 _init[5] = { Uint32(csys->seed), Uint32(csys->sectorX), Uint32(csys->sectorY), Uint32(csys->sectorZ), UNIVERSE_SEED };
-	Random rng(_init, 5);
-
-	RefCountedPtr<StarSystem::GeneratorAPI> system(new StarSystem::GeneratorAPI(path, m_galaxy, nullptr, rng));
-	auto customStage = std::make_unique<StarSystemCustomGenerator>();
-
-	if (!customStage->ApplyToSystem(rng, system, csys)) {
-		Log::Error("System is fully random, cannot load from file");
-		return false;
-	}
-
-	// NOTE: we don't run the PopulateSystem generator here, due to its
-	// reliance on filled-out Sector information
-	// As a result, population information will not be correct
-
-	if (!system->GetRootBody()) {
-		Log::Error("Custom system doesn't have a root body");
+	RefCountedPtr<StarSystem> system = StarSystem::EditorAPI::LoadCustomSystem(m_galaxy, csys, m_systemInfo);
+	if (!system)
 		return false;
-	}
 
 	m_system = system;
 	m_viewport->SetSystem(system);
 
-	CustomSystemInfo::ExplorationState explored = csys->explored ?
-		CustomSystemInfo::EXPLORE_ExploredAtStart :
-		CustomSystemInfo::EXPLORE_Unexplored;
-
-	m_systemInfo.explored = csys->want_rand_explored ? CustomSystemInfo::EXPLORE_Random : explored;
-	m_systemInfo.randomLawlessness = csys->want_rand_lawlessness;
-	m_systemInfo.randomFaction = csys->faction == nullptr;
-	m_systemInfo.faction = csys->faction ? csys->faction->name : "";
-
 	return true;
 }
 
@@ -343,6 +302,10 @@ void SystemEditor::LoadSystemFromGalaxy(RefCountedPtr<StarSystem> system)
 
 void SystemEditor::ClearSystem()
 {
+	// the bodies are going away
+	m_updateBody = nullptr;
+	m_updateFlags = 0;
+
 	GetUndo()->Clear();
 	m_lastSavedUndoStack = GetUndo()->GetStateHash();
 
@@ -363,6 +326,8 @@ RefCountedPtr<Galaxy> SystemEditor::GetGalaxy() { return m_galaxy; }
 
 void SystemEditor::SetSelectedBody(SystemBody *body)
 {
+	ApplyBodyUpdates(true);
+
 	// note: using const_cast here to work with Projectables which store a const pointer
 	m_selectedBody = body;
 	m_contextBody = body;
@@ -570,13 +535,18 @@ void SystemEditor::Update(float deltaTime)
 {
 	ImGuiID editorID = ImGui::GetID("System Editor");
 	if (ImGui::Shortcut(ImGuiMod_Ctrl | ImGuiMod_Shift | ImGuiKey_Z, editorID, ImGuiInputFlags_RouteGlobal)) {
+		ApplyBodyUpdates(true);
 		GetUndo()->Redo();
 	} else if (ImGui::Shortcut(ImGuiMod_Ctrl | ImGuiKey_Z, editorID, ImGuiInputFlags_RouteGlobal)) {
+		ApplyBodyUpdates(true);
 		GetUndo()->Undo();
 	}
 
 	DrawInterface();
 
+	// body operations may remove the edited body, so finish with it first
+	ApplyBodyUpdates(!ImGui::IsAnyItemActive() || m_pendingOp.type != BodyRequest::TYPE_None);
+
 	HandleBodyOperations();
 
 	if (m_openFile && m_openFile->ready(0)) {
@@ -1009,6 +979,23 @@ bool SystemEditor::DrawBodyNode(SystemBody *body, bool isRoot)
 	return open && body->GetNumChildren();
 }
 
+// Recomputes what the edits of a body made stale: only that body and the
+// satellites that depend on it, and only every so often while dragging
+void SystemEditor::ApplyBodyUpdates(bool immediate)
+{
+	if (!m_updateFlags)
+		return;
+
+	const double now = ImGui::GetTime();
+	if (!immediate && now - m_lastUpdateTime < BODY_UPDATE_INTERVAL)
+		return;
+
+	SystemBody::EditorAPI::UpdateDerived(m_updateBody, m_updateFlags);
+	m_updateBody = nullptr;
+	m_updateFlags = 0;
+	m_lastUpdateTime = now;
+}
+
 void SystemEditor::DrawBodyProperties()
 {
 	ImGui::PushFont(m_app->GetPiGui()->GetFont("pionillium", 16));
@@ -1021,7 +1008,13 @@ void SystemEditor::DrawBodyProperties()
 
 	SystemBody::EditorAPI::EditBodyName(m_selectedBody, GetRng(), m_nameGen.get(), GetUndo());
 
-	SystemBody::EditorAPI::EditProperties(m_selectedBody, GetRng(), GetUndo());
+	const uint32_t updateFlags = SystemBody::EditorAPI::EditProperties(m_selectedBody, GetRng(), GetUndo());
+	if (updateFlags) {
+		if (m_updateBody != m_selectedBody)
+			ApplyBodyUpdates(true);
+		m_updateBody = m_selectedBody;
+		m_updateFlags |= updateFlags;
+	}
 
 	ImGui::PopID();
 }
@@ -90,6 +90,7 @@ private:
 
 	void HandlePendingFileRequest();
 	void HandleBodyOperations();
+	void ApplyBodyUpdates(bool immediate);
 
 	void SetupLayout(ImGuiID dockspaceID);
 	void DrawInterface();
@@ -160,6 +161,12 @@ private:
 
 	BodyRequest m_pendingOp;
 
+	// the derived data of an edited body waiting to be recomputed, as
+	// SystemBody::EditorAPI::UpdateFlags
+	SystemBody *m_updateBody = nullptr;
+	uint32_t m_updateFlags = 0;
+	double m_lastUpdateTime = 0.0;
+
 	FileRequestType m_pendingFileReq;
 
 	std::unique_ptr<pfd::open_file> m_openFile;
@@ -7,6 +7,7 @@
 #include "enum_table.h"
 #include "Body.h"
 #include "DynamicBody.h"
+#include "Sensors.h"
 #include "Ship.h"
 #include "ShipAICmd.h"
 #include "ShipType.h"
@@ -42,6 +43,14 @@ const struct EnumItem ENUM_AltitudeType[] = {
 	{ 0, 0 },
 };
 
+const struct EnumItem ENUM_SensorsIFF[] = {
+	{ "UNKNOWN", int(Sensors::IFF_UNKNOWN) },
+	{ "NEUTRAL", int(Sensors::IFF_NEUTRAL) },
+	{ "ALLY", int(Sensors::IFF_ALLY) },
+	{ "HOSTILE", int(Sensors::IFF_HOSTILE) },
+	{ 0, 0 },
+};
+
 const struct EnumItem ENUM_ShipAIError[] = {
 	{ "NONE", int(Ship::AIERROR_NONE) },
 	{ "GRAV_TOO_HIGH", int(Ship::AIERROR_GRAV_TOO_HIGH) },
@@ -341,6 +350,7 @@ const struct EnumItem ENUM_ShipControllerFlightControlState[] = {
 const struct EnumTable ENUM_TABLES[] = {
 	{ "PhysicsObjectType", ENUM_PhysicsObjectType },
 	{ "AltitudeType", ENUM_AltitudeType },
+	{ "SensorsIFF", ENUM_SensorsIFF },
 	{ "ShipAIError", ENUM_ShipAIError },
 	{ "ShipFlightState", ENUM_ShipFlightState },
 	{ "ShipJumpStatus", ENUM_ShipJumpStatus },
@@ -372,6 +382,7 @@ const struct EnumTable ENUM_TABLES[] = {
 const struct EnumTable ENUM_TABLES_PUBLIC[] = {
 	{ "PhysicsObjectType", ENUM_PhysicsObjectType },
 	{ "AltitudeType", ENUM_AltitudeType },
+	{ "SensorsIFF", ENUM_SensorsIFF },
 	{ "ShipAIError", ENUM_ShipAIError },
 	{ "ShipFlightState", ENUM_ShipFlightState },
 	{ "ShipJumpStatus", ENUM_ShipJumpStatus },
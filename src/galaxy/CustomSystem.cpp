@@ -16,6 +16,7 @@
 #include "Factions.h"
 #include "FileSystem.h"
 #include "Polit.h"
+#include "galaxy/GalaxyDiskCache.h"
 #include "galaxy/StarSystemGenerator.h"
 #include "galaxy/SystemBody.h"
 #include "lua/LuaConstants.h"
@@ -24,7 +25,10 @@
 #include "lua/LuaVector.h"
 
 #include "profiler/Profiler.h"
+#include "scenegraph/Serializer.h"
 
+#include <algorithm>
+#include <climits>
 #include <map>
 
 const CustomSystemsDatabase::SystemList CustomSystemsDatabase::s_emptySystemList; // see: Null Object pattern
@@ -442,6 +446,7 @@ static int l_csys_faction(lua_State *L)
 	CustomSystem *cs = l_csys_check(L, 1);
 
 	std::string factionName = luaL_checkstring(L, 2);
+	cs->factionName = factionName;
 	if (!s_activeCustomSystemsDatabase->GetGalaxy()->GetFactions()->IsInitialized()) {
 		s_activeCustomSystemsDatabase->GetGalaxy()->GetFactions()->RegisterCustomSystem(cs, factionName);
 		lua_settop(L, 1);
@@ -770,6 +775,10 @@ void CustomSystemsDatabase::Load()
 {
 	PROFILE_SCOPED()
 
+	std::vector<SourceFile> sources = GetSourceFiles();
+	if (LoadFromCache(sources))
+		return;
+
 	LoadAllLuaSystems();
 
 	// Load Json array files containing random-fill system definitions
@@ -804,6 +813,122 @@ void CustomSystemsDatabase::Load()
 
 		LoadSystemFromJSON(file.GetPath(), JsonUtils::LoadJsonDataFile(file.GetPath()));
 	}
+
+	StoreInCache(sources);
+}
+
+// ------ CustomSystem cache ------
+
+// bump this whenever the layout of the cached systems or the way the
+// definitions are turned into systems changes
+static const Uint32 CUSTOM_SYSTEMS_CACHE_VERSION = 1;
+
+static uint64_t HashFile(const std::string &path)
+{
+	RefCountedPtr<FileSystem::FileData> data = FileSystem::gameDataFiles.ReadFile(path);
+	return data ? hash_64_fnv1a(data->GetData(), data->GetSize()) : 0;
+}
+
+std::vector<CustomSystemsDatabase::SourceFile> CustomSystemsDatabase::GetSourceFiles() const
+{
+	PROFILE_SCOPED()
+	std::vector<SourceFile> sources;
+	if (!GalaxyDiskCache::IsEnabled())
+		return sources;
+
+	for (const FileSystem::FileInfo &info : FileSystem::gameDataFiles.Enumerate(m_customSysDirectory, FileSystem::FileEnumerator::Recurse))
+		sources.push_back({ info.GetPath(), (info.GetModificationTime() - Time::DateTime()).GetTotalMicroseconds(), 0 });
+
+	// the enumeration order depends on the file system
+	std::sort(sources.begin(), sources.end(), [](const SourceFile &a, const SourceFile &b) { return a.path < b.path; });
+	return sources;
+}
+
+bool CustomSystemsDatabase::LoadFromCache(const std::vector<SourceFile> &sources)
+{
+	PROFILE_SCOPED()
+	std::string data;
+	if (!GalaxyDiskCache::LoadData(m_customSysDirectory, data))
+		return false;
+
+	std::vector<CustomSystem *> systems;
+	bool touched = false;
+	try {
+		Serializer::Reader rd(ByteRange(data.data(), data.size()));
+		if (rd.Int32() != CUSTOM_SYSTEMS_CACHE_VERSION || rd.Int32() != sources.size())
+			return false;
+
+		// a file that has only been touched is still fine, as long as its
+		// contents are the same
+		for (const SourceFile &source : sources) {
+			const std::string path = rd.String();
+			const int64_t modTime = rd.Int64();
+			const uint64_t hash = rd.Int64();
+			if (path != source.path)
+				return false;
+			if (modTime != source.modTime) {
+				if (hash != HashFile(path))
+					return false;
+				touched = true;
+			}
+		}
+
+		const Uint32 numSystems = rd.Int32();
+		for (Uint32 i = 0; i < numSystems; i++) {
+			systems.push_back(new CustomSystem());
+			systems.back()->LoadFromCache(rd);
+		}
+		if (rd.Pos() != data.size())
+			throw std::out_of_range("CustomSystemsDatabase::LoadFromCache: trailing data");
+	} catch (const std::exception &) {
+		for (CustomSystem *sys : systems)
+			delete sys;
+		GalaxyDiskCache::RemoveData(m_customSysDirectory);
+		return false;
+	}
+
+	for (CustomSystem *sys : systems) {
+		if (!sys->factionName.empty())
+			SetFaction(sys, sys->factionName, m_customSysDirectory);
+		// the systems were stored grouped by sector, in index order
+		m_sectorMap[SystemPath(sys->sectorX, sys->sectorY, sys->sectorZ)].push_back(sys);
+	}
+
+	// remember the new timestamps so the files aren't hashed every time
+	if (touched) {
+		std::vector<SourceFile> current = sources;
+		StoreInCache(current);
+	}
+
+	Log::Info("Loaded {} custom systems from the cache", systems.size());
+	return true;
+}
+
+void CustomSystemsDatabase::StoreInCache(std::vector<SourceFile> &sources) const
+{
+	if (!GalaxyDiskCache::IsEnabled())
+		return;
+
+	PROFILE_SCOPED()
+	Serializer::Writer wr;
+	wr.Int32(CUSTOM_SYSTEMS_CACHE_VERSION);
+	wr.Int32(sources.size());
+	for (SourceFile &source : sources) {
+		source.hash = HashFile(source.path);
+		wr.String(source.path);
+		wr.Int64(source.modTime);
+		wr.Int64(source.hash);
+	}
+
+	size_t numSystems = 0;
+	for (const auto &sector : m_sectorMap)
+		numSystems += sector.second.size();
+	wr.Int32(numSystems);
+	for (const auto &sector : m_sectorMap)
+		for (const CustomSystem *sys : sector.second)
+			sys->SaveToCache(wr);
+
+	GalaxyDiskCache::StoreData(m_customSysDirectory, wr.GetData());
 }
 
 void CustomSystemsDatabase::LoadAllLuaSystems()
@@ -864,17 +989,8 @@ CustomSystem *CustomSystemsDatabase::LoadSystemFromJSON(std::string_view filenam
 
 		// Set system faction pointer
 		auto factionName = systemdef.value<std::string>("faction", "");
-		if (!factionName.empty()) {
-			if (!GetGalaxy()->GetFactions()->IsInitialized()) {
-				GetGalaxy()->GetFactions()->RegisterCustomSystem(sys, factionName);
-			} else {
-				sys->faction = GetGalaxy()->GetFactions()->GetFaction(factionName);
-				if (sys->faction->idx == Faction::BAD_FACTION_IDX) {
-					Log::Warning("Unknown faction {} for custom system {} ({}).", factionName, sys->name, filename);
-					sys->faction = nullptr;
-				}
-			}
-		}
+		if (!factionName.empty())
+			SetFaction(sys, factionName, filename);
 
 		if (sys->want_rand_seed) {
 			Random rand = {
@@ -945,6 +1061,20 @@ CustomSystem *CustomSystemsDatabase::LoadSystemFromJSON(std::string_view filenam
 	}
 }
 
+void CustomSystemsDatabase::SetFaction(CustomSystem *sys, const std::string &factionName, std::string_view filename)
+{
+	sys->factionName = factionName;
+	if (!GetGalaxy()->GetFactions()->IsInitialized()) {
+		GetGalaxy()->GetFactions()->RegisterCustomSystem(sys, factionName);
+	} else {
+		sys->faction = GetGalaxy()->GetFactions()->GetFaction(factionName);
+		if (sys->faction->idx == Faction::BAD_FACTION_IDX) {
+			Log::Warning("Unknown faction {} for custom system {} ({}).", factionName, sys->name, filename);
+			sys->faction = nullptr;
+		}
+	}
+}
+
 CustomSystemsDatabase::~CustomSystemsDatabase()
 {
 	for (SectorMap::iterator secIt = m_sectorMap.begin(); secIt != m_sectorMap.end(); ++secIt) {
@@ -963,6 +1093,17 @@ const CustomSystemsDatabase::SystemList &CustomSystemsDatabase::GetCustomSystems
 	return (it != m_sectorMap.end()) ? it->second : s_emptySystemList;
 }
 
+bool CustomSystemsDatabase::HasCustomSystemsIn(const SystemPath &min, const SystemPath &max) const
+{
+	// the map is ordered by x first, so only the sectors in the x range are visited
+	for (auto it = m_sectorMap.lower_bound(SystemPath(min.sectorX, INT_MIN, INT_MIN)); it != m_sectorMap.end() && it->first.sectorX <= max.sectorX; ++it) {
+		const SystemPath &path = it->first;
+		if (!it->second.empty() && path.sectorY >= min.sectorY && path.sectorY <= max.sectorY && path.sectorZ >= min.sectorZ && path.sectorZ <= max.sectorZ)
+			return true;
+	}
+	return false;
+}
+
 void CustomSystemsDatabase::AddCustomSystem(const SystemPath &path, CustomSystem *csys)
 {
 	SystemList &sectorSystems = m_sectorMap[path];
@@ -1096,6 +1237,91 @@ void CustomSystem::SanityChecks()
 		sBody->SanityChecks();
 }
 
+void CustomSystem::SaveToCache(Serializer::Writer &wr) const
+{
+	wr.String(name);
+	wr.Int32(other_names.size());
+	for (const std::string &other : other_names)
+		wr.String(other);
+
+	wr.Int32(numStars);
+	for (int i = 0; i < 4; ++i)
+		wr.Int32(primaryType[i]);
+	wr.Int32(sectorX);
+	wr.Int32(sectorY);
+	wr.Int32(sectorZ);
+	wr.Int32(systemIndex);
+	wr.Vector3f(pos);
+	wr.Int32(seed);
+	wr.Bool(want_rand_seed);
+	wr.Bool(want_rand_explored);
+	wr.Bool(explored);
+	wr.String(factionName);
+	wr.Int32(govType);
+	wr.Bool(want_rand_lawlessness);
+	wr.Int64(lawlessness.v);
+	wr.String(shortDesc);
+	wr.String(longDesc);
+
+	wr.Int32(bodies.size());
+	for (const CustomSystemBody *body : bodies) {
+		body->SaveToCache(wr);
+		wr.Int32(body->children.size());
+		for (const CustomSystemBody *child : body->children)
+			wr.Int32(std::find(bodies.begin(), bodies.end(), child) - bodies.begin());
+	}
+}
+
+void CustomSystem::LoadFromCache(Serializer::Reader &rd)
+{
+	name = rd.String();
+	nameHash = hash_64_fnv1a(name.data(), name.size());
+	other_names.resize(rd.Int32());
+	for (std::string &other : other_names)
+		other = rd.String();
+
+	numStars = rd.Int32();
+	for (int i = 0; i < 4; ++i)
+		primaryType[i] = SystemBody::BodyType(rd.Int32());
+	sectorX = rd.Int32();
+	sectorY = rd.Int32();
+	sectorZ = rd.Int32();
+	systemIndex = rd.Int32();
+	pos = rd.Vector3f();
+	seed = rd.Int32();
+	want_rand_seed = rd.Bool();
+	want_rand_explored = rd.Bool();
+	explored = rd.Bool();
+	factionName = rd.String();
+	govType = Polit::GovType(rd.Int32());
+	want_rand_lawlessness = rd.Bool();
+	lawlessness.v = rd.Int64();
+	shortDesc = rd.String();
+	longDesc = rd.String();
+
+	const Uint32 numBodies = rd.Int32();
+	for (Uint32 i = 0; i < numBodies; ++i) {
+		bodies.push_back(new CustomSystemBody());
+		// the root owns all other bodies through their parents
+		if (!sBody)
+			sBody = bodies[0];
+
+		bodies.back()->LoadFromCache(rd);
+		bodies.back()->childIndicies.resize(rd.Int32());
+		for (uint32_t &childIdx : bodies.back()->childIndicies)
+			childIdx = rd.Int32();
+	}
+
+	for (CustomSystemBody *body : bodies) {
+		for (uint32_t childIdx : body->childIndicies) {
+			// the root, or a child index from a bad entry
+			if (childIdx == 0 || childIdx >= bodies.size())
+				throw std::out_of_range("CustomSystem::LoadFromCache: bad child index");
+			body->children.push_back(bodies[childIdx]);
+		}
+	}
+}
+
 CustomSystemBody::CustomSystemBody() :
 	want_rand_offset(true),
 	want_rand_phase(true),
@@ -1114,6 +1340,26 @@ CustomSystemBody::~CustomSystemBody()
 	}
 }
 
+void CustomSystemBody::SaveToCache(Serializer::Writer &wr) const
+{
+	bodyData.SaveToCache(wr);
+	wr.Bool(want_rand_offset);
+	wr.Bool(want_rand_phase);
+	wr.Bool(want_rand_arg_periapsis);
+	wr.Bool(want_rand_seed);
+	wr.Int32(ringStatus);
+}
+
+void CustomSystemBody::LoadFromCache(Serializer::Reader &rd)
+{
+	bodyData.LoadFromCache(rd);
+	want_rand_offset = rd.Bool();
+	want_rand_phase = rd.Bool();
+	want_rand_arg_periapsis = rd.Bool();
+	want_rand_seed = rd.Bool();
+	ringStatus = RingStatus(rd.Int32());
+}
+
 static void checks(CustomSystemBody &csb)
 {
 	if (csb.bodyData.m_name.empty()) {
@@ -15,6 +15,11 @@
 class Faction;
 class Galaxy;
 
+namespace Serializer {
+	class Reader;
+	class Writer;
+} // namespace Serializer
+
 class CustomSystemBody {
 public:
 	enum RingStatus {
@@ -40,6 +45,11 @@ public:
 	RingStatus ringStatus;
 
 	void SanityChecks();
+
+	// Binary copy for the custom systems cache; children are stored by
+	// their index in the system's bodies and resolved by CustomSystem
+	void SaveToCache(Serializer::Writer &wr) const;
+	void LoadFromCache(Serializer::Reader &rd);
 };
 
 class CustomSystem {
@@ -74,6 +84,7 @@ public:
 	bool want_rand_explored;
 	bool explored;
 	const Faction *faction;
+	std::string factionName; // as given in the definition, to resolve once the factions are loaded
 	Polit::GovType govType;
 	bool want_rand_lawlessness;
 	fixed lawlessness; // 0.0 = lawful, 1.0 = totally lawless
@@ -86,6 +97,11 @@ public:
 
 	void LoadFromJson(const Json &systemdef);
 	void SaveToJson(Json &obj);
+
+	// Binary copy for the custom systems cache. The faction is stored by
+	// name and has to be resolved again after loading.
+	void SaveToCache(Serializer::Writer &wr) const;
+	void LoadFromCache(Serializer::Reader &rd);
 };
 
 class CustomSystemsDatabase {
@@ -106,6 +122,8 @@ public:
 	typedef std::vector<const CustomSystem *> SystemList;
 	// XXX this is not as const-safe as it should be
 	const SystemList &GetCustomSystemsForSector(int sectorX, int sectorY, int sectorZ) const;
+	// True if any sector in the box from min to max (inclusive) has custom systems
+	bool HasCustomSystemsIn(const SystemPath &min, const SystemPath &max) const;
 	void AddCustomSystem(const SystemPath &path, CustomSystem *csys);
 	Galaxy *GetGalaxy() const { return m_galaxy; }
 
@@ -117,6 +135,19 @@ private:
 
 	lua_State *CreateLoaderState();
 
+	// Running all of the definition scripts takes a while, so the systems
+	// Load() ends up with are cached. The entry is used as long as none of
+	// the files in the custom systems directory have changed.
+	struct SourceFile {
+		std::string path;
+		int64_t modTime;
+		uint64_t hash; // only filled in when needed
+	};
+	std::vector<SourceFile> GetSourceFiles() const;
+	bool LoadFromCache(const std::vector<SourceFile> &sources);
+	void StoreInCache(std::vector<SourceFile> &sources) const;
+	void SetFaction(CustomSystem *sys, const std::string &factionName, std::string_view filename);
+
 	Galaxy *const m_galaxy;
 	const std::string m_customSysDirectory;
 	SectorMap m_sectorMap;
@@ -47,6 +47,8 @@ namespace GalacticEconomy {
 	/* clang-format on */
 
 	std::map<CommodityId, ConsumableInfo> m_consumables;
+	// indexed by commodity id, for the generator's inner loops
+	std::vector<bool> m_isConsumable;
 
 	// map commodity names to commodity ids for loading/saving
 	// references to set/map contents are never invalidated except when pointing to deleted elements
@@ -206,6 +208,7 @@ namespace GalacticEconomy {
 		PROFILE_SCOPED()
 		Json file = JsonUtils::LoadJsonDataFile("economy/consumables.json");
 		const Json &consumables = file["consumables"];
+		m_isConsumable.assign(m_commodities.size() + 1, false);
 
 		if (!consumables.is_object()) {
 			Log::Warning("Could not load consumable commodities list from file economy/consumables.json\n");
@@ -222,6 +225,7 @@ namespace GalacticEconomy {
 			ConsumableInfo value;
 			from_json(pair.value(), value);
 			m_consumables.emplace(id, value);
+			m_isConsumable[id] = true;
 
 			Log::Debug("Loaded consumable data for commodity {} ({}) -> ({}-{}, {:.2f})\n",
 				pair.key().c_str(), id,
@@ -316,6 +320,11 @@ namespace GalacticEconomy {
 		return m_consumables;
 	}
 
+	bool IsConsumable(CommodityId Id)
+	{
+		return Id < m_isConsumable.size() && m_isConsumable[Id];
+	}
+
 	const CommodityInfo &GetCommodityById(CommodityId Id)
 	{
 		return Id && Id <= m_commodities.size() ?
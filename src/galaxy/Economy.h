@@ -92,6 +92,9 @@ namespace GalacticEconomy {
 	// Commodities consumed by populated stations / worlds
 	const std::map<CommodityId, ConsumableInfo> &Consumables();
 
+	// Same as Consumables().count(Id), without the map lookup
+	bool IsConsumable(CommodityId Id);
+
 	// Returns a reference to a null CommodityInfo structure if passed InvalidCommodityId
 	const CommodityInfo &GetCommodityById(CommodityId Id);
 
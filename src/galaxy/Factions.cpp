@@ -517,6 +517,7 @@ void FactionsDatabase::SetHomeSectors()
 	for (auto it = m_factions.begin(); it != m_factions.end(); ++it)
 		if ((*it)->hasHomeworld)
 			(*it)->m_homesector = m_galaxy->GetSector((*it)->homeworld);
+	m_spatial_index.Build(m_factions);
 	m_may_assign_factions = true;
 }
 
@@ -543,7 +544,6 @@ void FactionsDatabase::AddFaction(Faction *faction)
 		}
 		m_missingFactionsMap.erase(it);
 	}
-	m_spatial_index.Add(faction);
 
 	if (faction->hasHomeworld) m_homesystems.insert(faction->homeworld.SystemOnly());
 	faction->idx = m_factions.size() - 1;
@@ -579,9 +579,36 @@ bool FactionsDatabase::MayAssignFactions() const
 	return m_may_assign_factions;
 }
 
+static void GetSectorBounds(const SystemPath &path, vector3f &min, vector3f &max)
+{
+	min = Sector::SIZE * vector3f(float(path.sectorX), float(path.sectorY), float(path.sectorZ));
+	max = min + vector3f(Sector::SIZE);
+}
+
+void FactionsDatabase::GetCandidateFactions(const SystemPath &sectorPath, std::vector<const Faction *> &candidates) const
+{
+	PROFILE_SCOPED()
+	vector3f min, max;
+	GetSectorBounds(sectorPath, min, max);
+
+	candidates.clear();
+	m_spatial_index.Query(min, max, candidates);
+
+	// the order decides between factions with equally good claims
+	std::sort(candidates.begin(), candidates.end(), [](const Faction *a, const Faction *b) { return a->idx < b->idx; });
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
+
 const Faction *FactionsDatabase::GetNearestClaimant(const Sector::System *sys) const
 {
 	PROFILE_SCOPED()
+	std::vector<const Faction *> candidates;
+	GetCandidateFactions(sys->GetPath(), candidates);
+	return GetNearestClaimant(sys, candidates);
+}
+
+const Faction *FactionsDatabase::GetNearestClaimant(const Sector::System *sys, ConstFactionList &candidates) const
+{
 	// firstly if this a custom StarSystem it may already have a faction assigned
 	if (sys->GetCustomSystem() && sys->GetCustomSystem()->faction) {
 		return sys->GetCustomSystem()->faction;
@@ -590,7 +617,6 @@ const Faction *FactionsDatabase::GetNearestClaimant(const Sector::System *sys) c
 	// if it didn't, or it wasn't a custom StarStystem, then we go ahead and assign it a faction allegiance like normal below...
 	const Faction *result = &m_no_faction;
 	double closestFactionDist = HUGE_VAL;
-	ConstFactionList &candidates = m_spatial_index.CandidateFactions(sys);
 
 	for (ConstFactionIterator it = candidates.begin(); it != candidates.end(); ++it) {
 		if ((*it)->IsClaimed(sys->GetPath()))
@@ -794,92 +820,115 @@ Faction::Faction(Galaxy *galaxy) :
 
 // ------ Factions Spatial Indexing ------
 
-void FactionsDatabase::Octsapling::Add(const Faction *faction)
+// nodes this small are not split any further
+static const float MIN_NODE_HALF_SIZE = 2.0f * Sector::SIZE;
+// the distances to homeworlds are calculated in floats, so grow the spheres
+// a little to never miss a faction because of rounding
+static const float VOLUME_MARGIN = 0.5f;
+
+void FactionsDatabase::SpatialIndex::Build(const std::vector<Faction *> &factions)
 {
-	/*  The general principle here is to put the faction in every octbox cell that a system
-	    that is a member of that faction could be in. This should let us cut the number
-		of factions that have to be checked by GetNearestFaction, by eliminating right off
-		all the those Factions that aren't in the same cell.
+	/*  This part happens once, after faction generation, so shouldn't be too
+		performance critical. */
+	PROFILE_SCOPED()
+	Clear();
 
-		As I'm just going for the quick performance win, I'm being very sloppy and
-		treating a Faction as if it was a cube rather than a sphere. I'm also not even
-		attempting to work out real faction boundaries for this.
+	for (const Faction *faction : factions) {
+		RefCountedPtr<const Sector> sec;
+		if (faction->hasHomeworld)
+			sec = faction->GetHomeSector();
 
-		Obviously this all could be improved even without this Octsapling growing into
-		a full Octree.
+		if (!sec || faction->homeworld.systemIndex >= sec->m_systems.size()) {
+			m_everywhere.push_back(faction);
+			continue;
+		}
 
-		This part happens at faction generation time so shouldn't be too performance
-		critical
-	*/
-	RefCountedPtr<const Sector> sec = faction->GetHomeSector();
+		// the sphere the faction has expanded into...
+		const vector3f home = sec->m_systems[faction->homeworld.systemIndex].GetFullPosition();
+		const vector3f radius(std::max(float(faction->Radius()), 0.0f) + VOLUME_MARGIN);
+		m_volumes.push_back({ home - radius, home + radius, faction });
+
+		// ...its home sector, where it automatically gains the allegiance of all
+		// worlds, and any sectors it has claimed (claims of single systems are
+		// treated as claims of their sector)
+		vector3f min, max;
+		GetSectorBounds(faction->homeworld, min, max);
+		m_volumes.push_back({ min, max, faction });
+		for (const SystemPath &claim : faction->m_ownedsystemlist) {
+			GetSectorBounds(claim, min, max);
+			m_volumes.push_back({ min, max, faction });
+		}
+	}
 
-	/* only factions with homeworlds that are available at faction generation time can
-	   be added to specific cells...
-	*/
-	if (faction->hasHomeworld && (faction->homeworld.systemIndex < sec->m_systems.size())) {
-		/* calculate potential indexes for the octbox cells the faction needs to go into
-		*/
-		Sector::System sys = sec->m_systems[faction->homeworld.systemIndex];
+	if (m_volumes.empty())
+		return;
 
-		int xmin = BoxIndex(Sint32(sys.GetFullPosition().x - float((faction->Radius()))));
-		int xmax = BoxIndex(Sint32(sys.GetFullPosition().x + float((faction->Radius()))));
-		int ymin = BoxIndex(Sint32(sys.GetFullPosition().y - float((faction->Radius()))));
-		int ymax = BoxIndex(Sint32(sys.GetFullPosition().y + float((faction->Radius()))));
-		int zmin = BoxIndex(Sint32(sys.GetFullPosition().z - float((faction->Radius()))));
-		int zmax = BoxIndex(Sint32(sys.GetFullPosition().z + float((faction->Radius()))));
+	vector3f min = m_volumes[0].min, max = m_volumes[0].max;
+	for (const Volume &volume : m_volumes) {
+		min = vector3f(std::min(min.x, volume.min.x), std::min(min.y, volume.min.y), std::min(min.z, volume.min.z));
+		max = vector3f(std::max(max.x, volume.max.x), std::max(max.y, volume.max.y), std::max(max.z, volume.max.z));
+	}
+	const vector3f size = max - min;
+	m_nodes.push_back({ 0.5f * (min + max), 0.5f * std::max(size.x, std::max(size.y, size.z)) + VOLUME_MARGIN, 0, {} });
 
-		/* put the faction in all the octbox cells needed in a hideously inexact way that
-		   will generate duplicates in each cell in many cases
-		*/
-		octbox[xmin][ymin][zmin].push_back(faction); // 0,0,0
-		octbox[xmax][ymin][zmin].push_back(faction); // 1,0,0
-		octbox[xmax][ymax][zmin].push_back(faction); // 1,1,0
-		octbox[xmax][ymax][zmax].push_back(faction); // 1,1,1
+	for (Uint32 i = 0; i < m_volumes.size(); i++)
+		Insert(i);
+}
 
-		octbox[xmin][ymax][zmin].push_back(faction); // 0,1,0
-		octbox[xmin][ymax][zmax].push_back(faction); // 0,1,1
-		octbox[xmin][ymin][zmax].push_back(faction); // 0,0,1
-		octbox[xmax][ymin][zmax].push_back(faction); // 1,0,1
+void FactionsDatabase::SpatialIndex::Clear()
+{
+	m_volumes.clear();
+	m_nodes.clear();
+	m_everywhere.clear();
+}
 
-		/* prune any duplicates from the octbox cells making things slightly saner
-		*/
-		PruneDuplicates(0, 0, 0);
-		PruneDuplicates(1, 0, 0);
-		PruneDuplicates(1, 1, 0);
-		PruneDuplicates(1, 1, 1);
+void FactionsDatabase::SpatialIndex::Insert(Uint32 volume)
+{
+	const Volume &v = m_volumes[volume];
 
-		PruneDuplicates(0, 1, 0);
-		PruneDuplicates(0, 1, 1);
-		PruneDuplicates(0, 0, 1);
-		PruneDuplicates(1, 0, 1);
+	// go down as long as the volume fits into a single child
+	Uint32 n = 0;
+	while (m_nodes[n].halfSize > MIN_NODE_HALF_SIZE) {
+		const vector3f center = m_nodes[n].center;
+		const int octant = (v.min.x >= center.x) | (v.min.y >= center.y) << 1 | (v.min.z >= center.z) << 2;
+		if (octant != ((v.max.x >= center.x) | (v.max.y >= center.y) << 1 | (v.max.z >= center.z) << 2))
+			break;
 
-	} else {
-		/* ...other factions, such as ones with no homeworlds, and more annoyingly ones
-	   whose homeworlds don't exist yet because they're custom systems have to go in
-	   *every* octbox cell
-	*/
-		octbox[0][0][0].push_back(faction);
-		octbox[1][0][0].push_back(faction);
-		octbox[1][1][0].push_back(faction);
-		octbox[1][1][1].push_back(faction);
-
-		octbox[0][1][0].push_back(faction);
-		octbox[0][1][1].push_back(faction);
-		octbox[0][0][1].push_back(faction);
-		octbox[1][0][1].push_back(faction);
+		if (!m_nodes[n].children) {
+			const Uint32 children = m_nodes.size();
+			const float halfSize = 0.5f * m_nodes[n].halfSize;
+			for (int i = 0; i < 8; i++) {
+				const vector3f offset((i & 1) ? halfSize : -halfSize, (i & 2) ? halfSize : -halfSize, (i & 4) ? halfSize : -halfSize);
+				m_nodes.push_back({ center + offset, halfSize, 0, {} });
+			}
+			m_nodes[n].children = children;
+		}
+		n = m_nodes[n].children + octant;
 	}
+	m_nodes[n].volumes.push_back(volume);
 }
 
-void FactionsDatabase::Octsapling::PruneDuplicates(const int bx, const int by, const int bz)
+void FactionsDatabase::SpatialIndex::Query(const vector3f &min, const vector3f &max, std::vector<const Faction *> &factions) const
 {
-	octbox[bx][by][bz].erase(std::unique(octbox[bx][by][bz].begin(), octbox[bx][by][bz].end()), octbox[bx][by][bz].end());
+	factions.insert(factions.end(), m_everywhere.begin(), m_everywhere.end());
+	if (!m_nodes.empty())
+		QueryNode(m_nodes[0], min, max, factions);
 }
 
-const std::vector<const Faction *> &FactionsDatabase::Octsapling::CandidateFactions(const Sector::System *sys) const
+void FactionsDatabase::SpatialIndex::QueryNode(const Node &node, const vector3f &min, const vector3f &max, std::vector<const Faction *> &factions) const
 {
-	/* answer the factions that we've put in the same octobox cell as the one the
-	   system would go in. This part happens every time we do GetNearest faction
-	   so *is* performance criticale.e
-	*/
-	return octbox[BoxIndex(sys->sx)][BoxIndex(sys->sy)][BoxIndex(sys->sz)];
+	const vector3f nodeMin = node.center - vector3f(node.halfSize);
+	const vector3f nodeMax = node.center + vector3f(node.halfSize);
+	if (!(min <= nodeMax && nodeMin <= max))
+		return;
+
+	for (Uint32 i : node.volumes) {
+		const Volume &volume = m_volumes[i];
+		if (min <= volume.max && volume.min <= max)
+			factions.push_back(volume.faction);
+	}
+
+	if (node.children)
+		for (int i = 0; i < 8; i++)
+			QueryNode(m_nodes[node.children + i], min, max, factions);
 }
@@ -79,11 +79,6 @@ private:
 	bool IsCloserAndContains(double &closestFactionDist, const Sector::System *sys) const;
 };
 
-/* One day it might grow up to become a full tree, on the  other hand it might be
-   cut down before it's full growth to be replaced by
-   a proper spatial data structure.
-*/
-
 class FactionsDatabase {
 public:
 	FactionsDatabase(Galaxy *galaxy, const std::string &factionDir) :
@@ -105,6 +100,11 @@ public:
 	const Faction *GetFaction(const Uint32 index) const;
 	const Faction *GetFaction(const std::string &factionName) const;
 	const Faction *GetNearestClaimant(const Sector::System *sys) const;
+	// Answer the factions that may claim systems in the sector, in faction
+	// index order; GetNearestClaimant() only needs to look at these for
+	// any system in the sector
+	void GetCandidateFactions(const SystemPath &sectorPath, std::vector<const Faction *> &candidates) const;
+	const Faction *GetNearestClaimant(const Sector::System *sys, const std::vector<const Faction *> &candidates) const;
 	bool IsHomeSystem(const SystemPath &sysPath) const;
 
 	Uint32 GetNumFactions() const;
@@ -112,15 +112,42 @@ public:
 	bool MayAssignFactions() const;
 
 private:
-	class Octsapling {
+	/* Octree over the volumes factions can claim systems in: the sphere of
+	   their radius around the homeworld, the home sector and any claimed
+	   sectors, each as a box in light years. A box is kept in the smallest
+	   node that contains it entirely.
+
+	   It needs the home sectors, so it is built once they are all known,
+	   after which it is read-only.
+	*/
+	class SpatialIndex {
 	public:
-		void Add(const Faction *faction);
-		const std::vector<const Faction *> &CandidateFactions(const Sector::System *sys) const;
+		void Build(const std::vector<Faction *> &factions);
+		void Clear();
+		// factions whose volumes overlap the box, in no particular order and
+		// possibly more than once
+		void Query(const vector3f &min, const vector3f &max, std::vector<const Faction *> &factions) const;
 
 	private:
-		std::vector<const Faction *> octbox[2][2][2];
-		static int BoxIndex(Sint32 sectorIndex) { return sectorIndex < 0 ? 0 : 1; };
-		void PruneDuplicates(const int bx, const int by, const int bz);
+		struct Volume {
+			vector3f min, max;
+			const Faction *faction;
+		};
+		struct Node {
+			vector3f center;
+			float halfSize;
+			Uint32 children; // index of the first of 8 children, 0 for leaves
+			std::vector<Uint32> volumes;
+		};
+
+		void Insert(Uint32 volume);
+		void QueryNode(const Node &node, const vector3f &min, const vector3f &max, std::vector<const Faction *> &factions) const;
+
+		std::vector<Volume> m_volumes;
+		std::vector<Node> m_nodes;
+		// factions without a homeworld (or with one that doesn't exist)
+		// may claim systems anywhere
+		std::vector<const Faction *> m_everywhere;
 	};
 
 	typedef std::vector<Faction *> FactionList;
@@ -140,7 +167,7 @@ private:
 	FactionList m_factions;
 	FactionMap m_factions_byName;
 	HomeSystemSet m_homesystems;
-	Octsapling m_spatial_index;
+	SpatialIndex m_spatial_index;
 	bool m_may_assign_factions;
 	bool m_initialized = false;
 	MissingFactionsMap m_missingFactionsMap;
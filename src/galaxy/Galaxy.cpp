@@ -4,11 +4,19 @@
 #include "Galaxy.h"
 
 #include "FileSystem.h"
+#include "GalaxyDiskCache.h"
 #include "GalaxyGenerator.h"
+#include "GameConfig.h"
 #include "GameSaveError.h"
 #include "Json.h"
+#include "Pi.h"
 #include "Sector.h"
+#include "core/FNV1a.h"
 #include "core/Log.h"
+#include "profiler/Profiler.h"
+#include "scenegraph/Serializer.h"
+
+#include <algorithm>
 
 // FIXME(sturnclaw): don't need to be pulling in SDL_image here
 #include <SDL_image.h>
@@ -19,6 +27,8 @@ Galaxy::Galaxy(RefCountedPtr<GalaxyGenerator> galaxyGenerator, float radius, flo
 	SOL_OFFSET_X(sol_offset_x),
 	SOL_OFFSET_Y(sol_offset_y),
 	m_initialized(false),
+	m_dataKey(0),
+	m_dataDirs({ factionsDir, customSysDir, "economy" }),
 	m_stats(),
 	m_galaxyGenerator(galaxyGenerator),
 	m_sectorCache(this),
@@ -54,12 +64,45 @@ Galaxy::~Galaxy()
 {
 }
 
+void Galaxy::AddToDataKey(const std::string &name, const char *data, size_t size)
+{
+	Serializer::Writer wr;
+	wr.Int64(m_dataKey);
+	wr.String(name);
+	wr.Int64(hash_64_fnv1a(data, size));
+
+	const std::string &buf = wr.GetData();
+	m_dataKey = hash_64_fnv1a(buf.data(), buf.size());
+}
+
 void Galaxy::Init()
 {
+	// reading all of the data is only worth it if something will use the key
+	if (GalaxyDiskCache::IsEnabled()) {
+		PROFILE_SCOPED_DESC("Galaxy data key")
+		std::vector<std::string> paths;
+		for (const std::string &dir : m_dataDirs)
+			for (const FileSystem::FileInfo &info : FileSystem::gameDataFiles.Enumerate(dir, FileSystem::FileEnumerator::Recurse))
+				paths.push_back(info.GetPath());
+
+		// the enumeration order depends on the file system
+		std::sort(paths.begin(), paths.end());
+		for (const std::string &path : paths) {
+			RefCountedPtr<FileSystem::FileData> data = FileSystem::gameDataFiles.ReadFile(path);
+			if (data)
+				AddToDataKey(path, data->GetData(), data->GetSize());
+		}
+	}
+
 	m_customSystems.Load();
 	m_factions.Init();
 	m_initialized = true;
 	m_factions.PostInit(); // So, cached home sectors take persisted state into account
+
+	// generating the factions flushes the caches, so only start retaining
+	// objects from now on
+	m_sectorCache.SetMemoryBudget(size_t(std::max(0, Pi::config->Int("SectorCacheMB"))) * 1024 * 1024);
+	m_starSystemCache.SetMemoryBudget(size_t(std::max(0, Pi::config->Int("StarSystemCacheMB"))) * 1024 * 1024);
 #if 0
 	{
 		Profiler::Timer timer;
@@ -129,6 +172,8 @@ DensityMapGalaxy::DensityMapGalaxy(RefCountedPtr<GalaxyGenerator> galaxyGenerato
 		Error("Galaxy: couldn't load '%s'\n", mapfile.c_str());
 	}
 
+	AddToDataKey(mapfile, filedata->GetData(), filedata->GetSize());
+
 	SDL_RWops *datastream = SDL_RWFromConstMem(filedata->GetData(), filedata->GetSize());
 	SDL_Surface *galaxyImg = SDL_LoadBMP_RW(datastream, 1);
 	if (!galaxyImg) {
@@ -154,25 +199,124 @@ DensityMapGalaxy::DensityMapGalaxy(RefCountedPtr<GalaxyGenerator> galaxyGenerato
 	SDL_UnlockSurface(galaxyImg);
 	if (galaxyImg)
 		SDL_FreeSurface(galaxyImg);
+
+	BuildDensityPyramid();
 }
 
-static const float one_over_256(1.0f / 256.0f);
-Uint8 DensityMapGalaxy::GetSectorDensity(const int sx, const int sy, const int sz) const
+void DensityMapGalaxy::BuildDensityPyramid()
 {
-	// -1.0 to 1.0 then limited to 0.0 to 1.0
-	const float offset_x = (((sx * Sector::SIZE + SOL_OFFSET_X) / GALAXY_RADIUS) + 1.0f) * 0.5f;
-	const float offset_y = (((-sy * Sector::SIZE + SOL_OFFSET_Y) / GALAXY_RADIUS) + 1.0f) * 0.5f;
+	PROFILE_SCOPED()
+	m_densityPyramid.clear();
+	m_densityPyramid.push_back({ m_mapWidth, m_mapHeight,
+		std::vector<float>(m_galaxyMap.get(), m_galaxyMap.get() + m_mapWidth * m_mapHeight), {} });
+	m_densityPyramid.back().max = m_densityPyramid.back().mean;
 
-	const int x = int(floor(offset_x * (m_mapWidth - 1)));
-	const int y = int(floor(offset_y * (m_mapHeight - 1)));
+	while (m_densityPyramid.back().width > 1 || m_densityPyramid.back().height > 1) {
+		const DensityLevel &below = m_densityPyramid.back();
+		DensityLevel level = { (below.width + 1) / 2, (below.height + 1) / 2, {}, {} };
+		level.mean.resize(level.width * level.height);
+		level.max.resize(level.width * level.height);
 
-	float val = m_galaxyMap.get()[x + y * m_mapWidth];
+		// a cell at an odd edge merges fewer than 4 cells
+		for (Sint32 y = 0; y < level.height; y++) {
+			for (Sint32 x = 0; x < level.width; x++) {
+				float sum = 0.0f, maximum = 0.0f;
+				int count = 0;
+				for (Sint32 by = 2 * y; by < std::min(2 * y + 2, below.height); by++) {
+					for (Sint32 bx = 2 * x; bx < std::min(2 * x + 2, below.width); bx++) {
+						sum += below.mean[bx + by * below.width];
+						maximum = std::max(maximum, below.max[bx + by * below.width]);
+						count++;
+					}
+				}
+				level.mean[x + y * level.width] = sum / count;
+				level.max[x + y * level.width] = maximum;
+			}
+		}
 
+		m_densityPyramid.push_back(std::move(level));
+	}
+}
+
+static const float one_over_256(1.0f / 256.0f);
+
+static float ApplyDensityDropoff(float val, int sz)
+{
 	// crappy unrealistic but currently adequate density dropoff with sector z
 	val = val * (256.0f - std::min(float(abs(sz)), 256.0f)) * one_over_256;
 
 	// reduce density somewhat to match real (gliese) density
 	val *= 0.5f;
 
-	return Uint8(val);
+	return val;
+}
+
+void DensityMapGalaxy::GetMapPixel(int sx, int sy, int &x, int &y) const
+{
+	// -1.0 to 1.0 then limited to 0.0 to 1.0
+	const float offset_x = (((sx * Sector::SIZE + SOL_OFFSET_X) / GALAXY_RADIUS) + 1.0f) * 0.5f;
+	const float offset_y = (((-sy * Sector::SIZE + SOL_OFFSET_Y) / GALAXY_RADIUS) + 1.0f) * 0.5f;
+
+	x = int(floor(offset_x * (m_mapWidth - 1)));
+	y = int(floor(offset_y * (m_mapHeight - 1)));
+}
+
+Uint8 DensityMapGalaxy::GetSectorDensity(const int sx, const int sy, const int sz) const
+{
+	int x, y;
+	GetMapPixel(sx, sy, x, y);
+
+	return Uint8(ApplyDensityDropoff(m_galaxyMap.get()[x + y * m_mapWidth], sz));
+}
+
+void DensityMapGalaxy::GetMapDensity(const SystemPath &min, const SystemPath &max, float &mean, float &maximum) const
+{
+	// y runs the opposite way in the map; sectors beyond the edge of the map
+	// count as the edge, which is empty space
+	int x0, y0, x1, y1;
+	GetMapPixel(min.sectorX, max.sectorY, x0, y0);
+	GetMapPixel(max.sectorX, min.sectorY, x1, y1);
+	x0 = Clamp(x0, 0, m_mapWidth - 1);
+	x1 = Clamp(x1, 0, m_mapWidth - 1);
+	y0 = Clamp(y0, 0, m_mapHeight - 1);
+	y1 = Clamp(y1, 0, m_mapHeight - 1);
+
+	size_t l = 0;
+	while ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1)
+		l++;
+
+	const DensityLevel &level = m_densityPyramid[l];
+	float sum = 0.0f;
+	int count = 0;
+	maximum = 0.0f;
+	for (int y = y0 >> l; y <= y1 >> l; y++) {
+		for (int x = x0 >> l; x <= x1 >> l; x++) {
+			sum += level.mean[x + y * level.width];
+			maximum = std::max(maximum, level.max[x + y * level.width]);
+			count++;
+		}
+	}
+	mean = sum / count;
+}
+
+Uint8 DensityMapGalaxy::GetMaxSectorDensity(const SystemPath &min, const SystemPath &max) const
+{
+	float mean, maximum;
+	GetMapDensity(min, max, mean, maximum);
+
+	// the dropoff is largest at the sector closest to the plane
+	const int sz = (min.sectorZ <= 0 && max.sectorZ >= 0) ? 0 : std::min(abs(min.sectorZ), abs(max.sectorZ));
+	return Uint8(ApplyDensityDropoff(maximum, sz));
+}
+
+float DensityMapGalaxy::GetMeanSectorDensity(const SystemPath &min, const SystemPath &max) const
+{
+	float mean, maximum;
+	GetMapDensity(min, max, mean, maximum);
+
+	// there is nothing beyond 256 sectors from the plane
+	float sum = 0.0f;
+	for (int sz = std::max(min.sectorZ, -256); sz <= std::min(max.sectorZ, 256); sz++)
+		sum += ApplyDensityDropoff(mean, sz);
+	return sum / (max.sectorZ - min.sectorZ + 1);
 }
@@ -37,6 +37,12 @@ public:
 	bool IsInitialized() const { return m_initialized; }
 	/* 0 - 255 */
 	virtual Uint8 GetSectorDensity(const int sx, const int sy, const int sz) const = 0;
+	// Density of all the sectors in the box from min to max (inclusive) at
+	// once. The maximum is an upper bound of GetSectorDensity() in the box,
+	// so a box with a maximum of 0 has no random systems; the mean is only
+	// approximate for boxes that don't line up with the underlying data.
+	virtual Uint8 GetMaxSectorDensity(const SystemPath &min, const SystemPath &max) const = 0;
+	virtual float GetMeanSectorDensity(const SystemPath &min, const SystemPath &max) const = 0;
 	FactionsDatabase *GetFactions() { return &m_factions; }				   // XXX const correctness
 	CustomSystemsDatabase *GetCustomSystems() { return &m_customSystems; } // XXX const correctness
 
@@ -44,9 +50,12 @@ public:
 	RefCountedPtr<Sector> GetMutableSector(const SystemPath &path) { return m_sectorCache.GetCached(path); }
 	RefCountedPtr<SectorCache::Slave> NewSectorSlaveCache() { return m_sectorCache.NewSlaveCache(); }
 
-	RefCountedPtr<StarSystem> GetStarSystem(const SystemPath &path) { return m_starSystemCache.GetCached(path); }
+	RefCountedPtr<StarSystem> GetStarSystem(const SystemPath &path, GalaxyDetail detail = GalaxyDetail::FULL) { return m_starSystemCache.GetCached(path, detail); }
 	RefCountedPtr<StarSystemCache::Slave> NewStarSystemSlaveCache() { return m_starSystemCache.NewSlaveCache(); }
 
+	SectorCache &GetSectorCache() { return m_sectorCache; }
+	StarSystemCache &GetStarSystemCache() { return m_starSystemCache; }
+
 	void FlushCaches();
 	void Dump(FILE *file, Sint32 centerX, Sint32 centerY, Sint32 centerZ, Sint32 radius);
 
@@ -57,8 +66,19 @@ public:
 	Perf::Stats &GetStats() { return m_stats; }
 	const Perf::Stats &GetStats() const { return m_stats; }
 
+	// Fingerprint of the game data that generation depends on, so on-disk
+	// caches of generated objects can tell when a mod has changed it
+	uint64_t GetDataKey() const { return m_dataKey; }
+
+protected:
+	// Mix a data file that isn't in one of the data directories into the
+	// data key; call before Init()
+	void AddToDataKey(const std::string &name, const char *data, size_t size);
+
 private:
 	bool m_initialized;
+	uint64_t m_dataKey;
+	std::vector<std::string> m_dataDirs;
 	Perf::Stats m_stats;
 	RefCountedPtr<GalaxyGenerator> m_galaxyGenerator;
 	SectorCache m_sectorCache;
@@ -75,10 +95,28 @@ private:
 
 public:
 	virtual Uint8 GetSectorDensity(const int sx, const int sy, const int sz) const;
+	virtual Uint8 GetMaxSectorDensity(const SystemPath &min, const SystemPath &max) const;
+	virtual float GetMeanSectorDensity(const SystemPath &min, const SystemPath &max) const;
 
 private:
+	// Mip-pyramid of the density map: each level halves the resolution of
+	// the one below, keeping the mean and the maximum of the merged pixels.
+	// Level 0 is the map itself.
+	struct DensityLevel {
+		Sint32 width, height;
+		std::vector<float> mean;
+		std::vector<float> max;
+	};
+
+	void BuildDensityPyramid();
+	void GetMapPixel(int sx, int sy, int &x, int &y) const;
+	// Mean and maximum of the map within the pixel box, from the first
+	// level at which the box spans no more than 2x2 cells
+	void GetMapDensity(const SystemPath &min, const SystemPath &max, float &mean, float &maximum) const;
+
 	std::unique_ptr<float[]> m_galaxyMap;
 	Sint32 m_mapWidth, m_mapHeight;
+	std::vector<DensityLevel> m_densityPyramid;
 };
 
 #endif /* _GALAXY_H */
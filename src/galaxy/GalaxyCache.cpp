@@ -10,11 +10,27 @@
 #include "galaxy/Sector.h"
 #include "galaxy/StarSystem.h"
 #include "core/Log.h"
+#include "core/MemoryTag.h"
+#include "core/StringUtils.h"
+#include "core/TaskGraph.h"
 #include "profiler/Profiler.h"
 #include <utility>
 
 //#define DEBUG_CACHE
 
+// Star systems nothing but the cache holds on to keep only the hot fields
+// of their bodies (see StarSystem::Compact); sectors have nothing to compact.
+// Returns true if the object got smaller.
+static bool CompactObject(Sector *sector)
+{
+	return false;
+}
+
+static bool CompactObject(StarSystem *system)
+{
+	return !system->IsCompact() && system->Compact();
+}
+
 //virtual
 
 template <typename T, typename CompareT>
@@ -22,6 +38,8 @@ GalaxyObjectCache<T, CompareT>::~GalaxyObjectCache()
 {
 	for (Slave *s : m_slaves)
 		s->MasterDeleted();
+	for (auto it = m_retained.begin(); it != m_retained.end();)
+		it = Release(it);
 	assert(m_attic.empty()); // otherwise the objects will deregister at a cache that no longer exists
 }
 
@@ -30,41 +48,133 @@ void GalaxyObjectCache<T, CompareT>::AddToCache(std::vector<RefCountedPtr<T>> &o
 {
 	PROFILE_SCOPED()
 	for (auto it = objects.begin(), itEnd = objects.end(); it != itEnd; ++it) {
-		auto inserted = m_attic.insert(std::make_pair(it->Get()->GetPath(), it->Get()));
-		if (!inserted.second) {
-			it->Reset(inserted.first->second);
+		typename AtticMap::iterator i = m_attic.find(it->Get()->GetPath());
+		if (i != m_attic.end()) {
+			Complete(i->second, (*it)->GetDetail());
+			it->Reset(i->second.object);
+			Touch(i->second);
 		} else {
 			(*it)->SetCache(this);
+			Insert(it->Get());
 		}
 	}
+	Trim();
 }
 
 template <typename T, typename CompareT>
-RefCountedPtr<T> GalaxyObjectCache<T, CompareT>::GetIfCached(const SystemPath &path)
+RefCountedPtr<T> GalaxyObjectCache<T, CompareT>::GetIfCached(const SystemPath &path, GalaxyDetail detail)
 {
 	RefCountedPtr<T> s;
 	typename AtticMap::iterator i = m_attic.find(path);
 	if (i != m_attic.end()) {
-		s.Reset(i->second);
+		s.Reset(i->second.object);
+		Complete(i->second, detail);
+		Touch(i->second);
 	}
 
 	return s;
 }
 
 template <typename T, typename CompareT>
-RefCountedPtr<T> GalaxyObjectCache<T, CompareT>::GetCached(const SystemPath &path)
+RefCountedPtr<T> GalaxyObjectCache<T, CompareT>::GetCached(const SystemPath &path, GalaxyDetail detail)
 {
-	RefCountedPtr<T> s = this->GetIfCached(path);
+	RefCountedPtr<T> s = this->GetIfCached(path, detail);
 	if (!s) {
-		++m_cacheMisses;
-		s = m_galaxy->GetGenerator()->Generate<T, GalaxyObjectCache<T, CompareT>>(RefCountedPtr<Galaxy>(m_galaxy), path, this);
-		m_attic.insert(std::make_pair(path, s.Get()));
+		++m_stats.misses;
+		s = m_galaxy->GetGenerator()->Generate<T, GalaxyObjectCache<T, CompareT>>(RefCountedPtr<Galaxy>(m_galaxy), path, this, detail);
+		Insert(s.Get());
+		Trim();
 	} else {
-		++m_cacheHits;
+		++m_stats.hits;
 	}
 	return s;
 }
 
+template <typename T, typename CompareT>
+void GalaxyObjectCache<T, CompareT>::Insert(T *object)
+{
+	AtticEntry entry = { object, m_retained.end(), object->GetMemoryUsage() };
+	auto inserted = m_attic.insert(std::make_pair(object->GetPath(), entry));
+	if (inserted.second)
+		MemoryTag::Allocate(MemoryTag::GALAXY, entry.size);
+	Touch(inserted.first->second);
+}
+
+template <typename T, typename CompareT>
+void GalaxyObjectCache<T, CompareT>::Complete(AtticEntry &entry, GalaxyDetail detail)
+{
+	if (entry.object->GetDetail() >= detail)
+		return;
+
+	++m_stats.completions;
+	m_galaxy->GetGenerator()->Complete<T>(RefCountedPtr<Galaxy>(m_galaxy), entry.object, detail);
+	UpdateSize(entry);
+}
+
+template <typename T, typename CompareT>
+void GalaxyObjectCache<T, CompareT>::UpdateSize(AtticEntry &entry)
+{
+	const size_t size = entry.object->GetMemoryUsage();
+	if (entry.retained != m_retained.end())
+		m_retainedBytes = m_retainedBytes - entry.size + size;
+	MemoryTag::Free(MemoryTag::GALAXY, entry.size);
+	MemoryTag::Allocate(MemoryTag::GALAXY, size);
+	entry.size = size;
+}
+
+template <typename T, typename CompareT>
+void GalaxyObjectCache<T, CompareT>::Touch(AtticEntry &entry)
+{
+	if (entry.retained == m_retained.end()) {
+		entry.retained = m_retained.insert(m_retained.begin(), RefCountedPtr<T>(entry.object));
+		m_retainedBytes += entry.size;
+	} else {
+		m_retained.splice(m_retained.begin(), m_retained, entry.retained);
+	}
+}
+
+template <typename T, typename CompareT>
+typename GalaxyObjectCache<T, CompareT>::RetainedList::iterator GalaxyObjectCache<T, CompareT>::Release(typename RetainedList::iterator it)
+{
+	AtticEntry &entry = m_attic.find((*it)->GetPath())->second;
+	entry.retained = m_retained.end();
+	m_retainedBytes -= entry.size;
+
+	// the destructor may remove the entry from the attic, so erase first
+	RefCountedPtr<T> object(*it);
+	return m_retained.erase(it);
+}
+
+template <typename T, typename CompareT>
+void GalaxyObjectCache<T, CompareT>::Trim()
+{
+	if (m_retainedBytes <= m_memoryBudget)
+		return;
+
+	PROFILE_SCOPED()
+	auto it = m_retained.end();
+	while (m_retainedBytes > m_memoryBudget && it != m_retained.begin()) {
+		--it;
+		// still used by a slave cache or someone else, so releasing it wouldn't free anything
+		if ((*it)->GetRefCount() > 1)
+			continue;
+		// a system looked at since it was compacted can shrink again instead
+		if (CompactObject(it->Get())) {
+			UpdateSize(m_attic.find((*it)->GetPath())->second);
+			continue;
+		}
+		it = Release(it);
+		++m_stats.evictions;
+	}
+}
+
+template <typename T, typename CompareT>
+void GalaxyObjectCache<T, CompareT>::SetMemoryBudget(size_t bytes)
+{
+	m_memoryBudget = bytes;
+	Trim();
+}
+
 template <typename T, typename CompareT>
 bool GalaxyObjectCache<T, CompareT>::HasCached(const SystemPath &path) const
 {
@@ -76,7 +186,11 @@ bool GalaxyObjectCache<T, CompareT>::HasCached(const SystemPath &path) const
 template <typename T, typename CompareT>
 void GalaxyObjectCache<T, CompareT>::RemoveFromAttic(const SystemPath &path)
 {
-	m_attic.erase(path);
+	typename AtticMap::iterator it = m_attic.find(path);
+	if (it == m_attic.end())
+		return;
+	MemoryTag::Free(MemoryTag::GALAXY, it->second.size);
+	m_attic.erase(it);
 }
 
 template <typename T, typename CompareT>
@@ -84,14 +198,35 @@ void GalaxyObjectCache<T, CompareT>::ClearCache()
 {
 	for (auto it = m_slaves.begin(), itEnd = m_slaves.end(); it != itEnd; ++it)
 		(*it)->ClearCache();
+	for (auto it = m_retained.begin(); it != m_retained.end();)
+		it = Release(it);
 }
 
 template <typename T, typename CompareT>
 void GalaxyObjectCache<T, CompareT>::OutputCacheStatistics(bool reset)
 {
-	Output("%s: misses: %llu, slave hits: %llu, master hits: %llu\n", CACHE_NAME.c_str(), m_cacheMisses, m_cacheHitsSlave, m_cacheHits);
+	Output("%s: misses: %llu, slave hits: %llu, master hits: %llu, completions: %llu, evictions: %llu, retained: " SIZET_FMT " (%.1f MB)\n",
+		CACHE_NAME.c_str(), m_stats.misses, m_stats.slaveHits, m_stats.hits, m_stats.completions, m_stats.evictions, m_retained.size(),
+		m_retainedBytes / (1024.0 * 1024.0));
 	if (reset)
-		m_cacheMisses = m_cacheHitsSlave = m_cacheHits = 0;
+		ResetStats();
+}
+
+template <typename T, typename CompareT>
+typename GalaxyObjectCache<T, CompareT>::Stats GalaxyObjectCache<T, CompareT>::GetStats() const
+{
+	Stats stats = m_stats;
+	stats.numObjects = m_attic.size();
+	stats.numRetained = m_retained.size();
+	stats.retainedBytes = m_retainedBytes;
+	stats.memoryBudget = m_memoryBudget;
+	return stats;
+}
+
+template <typename T, typename CompareT>
+void GalaxyObjectCache<T, CompareT>::ResetStats()
+{
+	m_stats.misses = m_stats.slaveHits = m_stats.hits = m_stats.completions = m_stats.evictions = 0;
 }
 
 template <typename T, typename CompareT>
@@ -104,7 +239,9 @@ template <typename T, typename CompareT>
 GalaxyObjectCache<T, CompareT>::Slave::Slave(GalaxyObjectCache<T, CompareT> *master, RefCountedPtr<Galaxy> galaxy, JobQueue *jobQueue) :
 	m_master(master),
 	m_galaxy(galaxy),
-	m_jobs(Pi::GetAsyncJobQueue())
+	m_jobs(Pi::GetAsyncJobQueue()),
+	m_pending(std::make_shared<PendingObjects>()),
+	m_numPublished(0)
 {
 	m_master->m_slaves.insert(this);
 }
@@ -116,28 +253,41 @@ void GalaxyObjectCache<T, CompareT>::Slave::MasterDeleted()
 }
 
 template <typename T, typename CompareT>
-RefCountedPtr<T> GalaxyObjectCache<T, CompareT>::Slave::GetIfCached(const SystemPath &path)
+RefCountedPtr<T> GalaxyObjectCache<T, CompareT>::Slave::GetIfCached(const SystemPath &path, GalaxyDetail detail)
 {
 	typename CacheMap::iterator i = m_cache.find(path);
-	if (i != m_cache.end())
+	if (i == m_cache.end() && PublishPending())
+		i = m_cache.find(path);
+	if (i != m_cache.end()) {
+		if (m_master && (*i).second->GetDetail() < detail)
+			m_master->GetIfCached(path, detail);
 		return (*i).second;
+	}
 	return RefCountedPtr<T>();
 }
 
 template <typename T, typename CompareT>
-RefCountedPtr<T> GalaxyObjectCache<T, CompareT>::Slave::GetCached(const SystemPath &path)
+RefCountedPtr<T> GalaxyObjectCache<T, CompareT>::Slave::GetCached(const SystemPath &path, GalaxyDetail detail)
 {
 	PROFILE_SCOPED()
 
 	typename CacheMap::iterator i = m_cache.find(path);
+	// a cache job may have just generated it
+	if (i == m_cache.end() && PublishPending())
+		i = m_cache.find(path);
 	if (i != m_cache.end()) {
-		if (m_master)
-			++m_master->m_cacheHitsSlave;
+		if (m_master) {
+			++m_master->m_stats.slaveHits;
+			// everything in a slave cache is in the master's attic, too
+			if ((*i).second->GetDetail() < detail)
+				m_master->GetIfCached(path, detail);
+		}
 		return (*i).second;
 	}
 
 	if (m_master) {
-		auto inserted = m_cache.insert(std::make_pair(path, m_master->GetCached(path)));
+		auto inserted = m_cache.insert(std::make_pair(path, m_master->GetCached(path, detail)));
+		onAdded.emit(inserted.first->second.Get());
 		return inserted.first->second;
 	} else {
 		return RefCountedPtr<T>();
@@ -145,13 +295,27 @@ RefCountedPtr<T> GalaxyObjectCache<T, CompareT>::Slave::GetCached(const SystemPa
 }
 
 template <typename T, typename CompareT>
-void GalaxyObjectCache<T, CompareT>::Slave::Erase(const SystemPath &path) { m_cache.erase(path); }
+void GalaxyObjectCache<T, CompareT>::Slave::Erase(const SystemPath &path)
+{
+	typename CacheMap::iterator i = m_cache.find(path);
+	if (i != m_cache.end())
+		Erase(i);
+}
 
 template <typename T, typename CompareT>
-void GalaxyObjectCache<T, CompareT>::Slave::Erase(const typename CacheMap::const_iterator &it) { m_cache.erase(it); }
+void GalaxyObjectCache<T, CompareT>::Slave::Erase(const typename CacheMap::const_iterator &it)
+{
+	onRemoved.emit(it->second.Get());
+	m_cache.erase(it);
+}
 
 template <typename T, typename CompareT>
-void GalaxyObjectCache<T, CompareT>::Slave::ClearCache() { m_cache.clear(); }
+void GalaxyObjectCache<T, CompareT>::Slave::ClearCache()
+{
+	for (auto &entry : m_cache)
+		onRemoved.emit(entry.second.Get());
+	m_cache.clear();
+}
 
 template <typename T, typename CompareT>
 GalaxyObjectCache<T, CompareT>::Slave::~Slave()
@@ -173,19 +337,39 @@ void GalaxyObjectCache<T, CompareT>::Slave::AddToCache(std::vector<RefCountedPtr
 	if (m_master) {
 		m_master->AddToCache(objects); // This modifies the vector to the sectors already in the master cache
 		for (auto it = objects.begin(), itEnd = objects.end(); it != itEnd; ++it) {
-			m_cache.insert(std::make_pair(it->Get()->GetPath(), *it));
+			if (m_cache.insert(std::make_pair(it->Get()->GetPath(), *it)).second)
+				onAdded.emit(it->Get());
 		}
 	}
 }
 
+template <typename T, typename CompareT>
+size_t GalaxyObjectCache<T, CompareT>::Slave::PublishPending()
+{
+	std::vector<RefCountedPtr<T>> objects;
+	{
+		std::lock_guard<std::mutex> lock(m_pending->lock);
+		objects.swap(m_pending->objects);
+	}
+
+	if (objects.empty())
+		return 0;
+
+	PROFILE_SCOPED()
+	AddToCache(objects);
+	m_numPublished += objects.size();
+	return objects.size();
+}
+
 template <typename T, typename CompareT>
 void GalaxyObjectCache<T, CompareT>::Slave::FillCache(const typename GalaxyObjectCache<T, CompareT>::PathVector &paths,
-	typename GalaxyObjectCache<T, CompareT>::CacheFilledCallback callback)
+	typename GalaxyObjectCache<T, CompareT>::CacheFilledCallback callback, GalaxyDetail detail)
 {
 	// allocate some space for what we're about to chunk up
 	std::vector<std::unique_ptr<PathVector>> vec_paths;
 	vec_paths.reserve(paths.size() / CACHE_JOB_SIZE + 1);
 	std::unique_ptr<PathVector> current_paths;
+	PublishPending();
 #ifdef DEBUG_CACHE
 	size_t alreadyCached = m_cache.size();
 	unsigned masterCached = 0;
@@ -194,9 +378,10 @@ void GalaxyObjectCache<T, CompareT>::Slave::FillCache(const typename GalaxyObjec
 
 	// chop the paths into groups of CACHE_JOB_SIZE
 	for (auto it = paths.begin(), itEnd = paths.end(); it != itEnd; ++it) {
-		RefCountedPtr<T> s = m_master->GetIfCached(*it);
+		RefCountedPtr<T> s = m_master->GetIfCached(*it, detail);
 		if (s) {
-			m_cache[*it] = s;
+			if (m_cache.insert(std::make_pair(*it, s)).second)
+				onAdded.emit(s.Get());
 #ifdef DEBUG_CACHE
 			++masterCached;
 #endif
@@ -231,22 +416,35 @@ void GalaxyObjectCache<T, CompareT>::Slave::FillCache(const typename GalaxyObjec
 	} else {
 		// now add the batched jobs
 		for (auto it = vec_paths.begin(), itEnd = vec_paths.end(); it != itEnd; ++it)
-			m_jobs.Order(new GalaxyObjectCache<T, CompareT>::CacheJob(std::move(*it), this, m_galaxy, callback));
+			m_jobs.Order(new GalaxyObjectCache<T, CompareT>::CacheJob(std::move(*it), this, m_galaxy, detail, callback));
 	}
 }
 
 template <typename T, typename CompareT>
 GalaxyObjectCache<T, CompareT>::CacheJob::CacheJob(std::unique_ptr<std::vector<SystemPath>> path,
-	typename GalaxyObjectCache<T, CompareT>::Slave *slaveCache, RefCountedPtr<Galaxy> galaxy,
+	typename GalaxyObjectCache<T, CompareT>::Slave *slaveCache, RefCountedPtr<Galaxy> galaxy, GalaxyDetail detail,
 	typename GalaxyObjectCache<T, CompareT>::CacheFilledCallback callback) :
 	Job(),
 	m_paths(std::move(path)),
+	m_pending(slaveCache->m_pending),
 	m_slaveCache(slaveCache),
 	m_galaxy(galaxy),
 	m_galaxyGenerator(galaxy->GetGenerator()),
+	m_detail(detail),
 	m_callback(callback)
 {
-	m_objects.reserve(m_paths->size());
+	// background cache fills shouldn't hold up terrain generation near the camera
+	SetPriority(PRIORITY_LOW);
+}
+
+template <typename T, typename CompareT>
+void GalaxyObjectCache<T, CompareT>::CacheJob::Generate(const SystemPath &path) // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+{
+	RefCountedPtr<T> object = m_galaxyGenerator->Generate<T, GalaxyObjectCache<T, CompareT>>(m_galaxy, path, nullptr, m_detail);
+	// filled in bulk, most of them are only ever looked at in passing
+	CompactObject(object.Get());
+	std::lock_guard<std::mutex> lock(m_pending->lock);
+	m_pending->objects.push_back(object);
 }
 
 //virtual
@@ -254,8 +452,8 @@ template <typename T, typename CompareT>
 void GalaxyObjectCache<T, CompareT>::CacheJob::OnRun() // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 {
 	PROFILE_SCOPED()
-	for (auto it = m_paths->begin(), itEnd = m_paths->end(); it != itEnd; ++it)
-		m_objects.push_back(m_galaxyGenerator->Generate<T, GalaxyObjectCache<T, CompareT>>(m_galaxy, *it, nullptr));
+	for (const SystemPath &path : *m_paths)
+		Generate(path);
 }
 
 //virtual
@@ -263,7 +461,7 @@ template <typename T, typename CompareT>
 void GalaxyObjectCache<T, CompareT>::CacheJob::OnFinish() // runs in primary thread of the context
 {
 	PROFILE_SCOPED()
-	m_slaveCache->AddToCache(m_objects);
+	m_slaveCache->PublishPending();
 	if (m_slaveCache->m_jobs.IsEmpty() && m_callback)
 		m_callback();
 }
@@ -273,6 +471,24 @@ void GalaxyObjectCache<T, CompareT>::CacheJob::OnFinish() // runs in primary thr
 template <>
 const std::string GalaxyObjectCache<Sector, SystemPath::LessSectorOnly>::CACHE_NAME("SectorCache");
 
+//virtual
+template <>
+void GalaxyObjectCache<Sector, SystemPath::LessSectorOnly>::CacheJob::OnRun() // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+{
+	PROFILE_SCOPED()
+	// sector generation only reads the galaxy, so there is one task per
+	// sector for idle workers to steal from this one
+	TaskGraph *graph = Pi::GetApp()->GetTaskGraph();
+	TaskSet *set = new TaskSet();
+	set->AddTaskRangeLambda({ 0, uint32_t(m_paths->size()) }, 1, [this](TaskRange range) {
+		for (uint32_t idx = range.begin; idx < range.end; idx++)
+			Generate((*m_paths)[idx]);
+	});
+
+	TaskSet::Handle handle = graph->QueueTaskSet(set);
+	graph->WaitForTaskSet(handle);
+}
+
 template class GalaxyObjectCache<Sector, SystemPath::LessSectorOnly>;
 
 /****** StarSystemCache ******/
@@ -281,7 +497,9 @@ template <>
 GalaxyObjectCache<StarSystem, SystemPath::LessSystemOnly>::Slave::Slave(GalaxyObjectCache<StarSystem, SystemPath::LessSystemOnly> *master, RefCountedPtr<Galaxy> galaxy, JobQueue *jobQueue) :
 	m_master(master),
 	m_galaxy(galaxy),
-	m_jobs(Pi::GetSyncJobQueue())
+	m_jobs(Pi::GetSyncJobQueue()),
+	m_pending(std::make_shared<PendingObjects>()),
+	m_numPublished(0)
 {
 	m_master->m_slaves.insert(this);
 }
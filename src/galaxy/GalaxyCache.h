@@ -8,14 +8,26 @@
 #include "RefCounted.h"
 #include "galaxy/SystemPath.h"
 #include <functional>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <sigc++/signal.h>
 #include <vector>
 
 class GalaxyGenerator;
 class Galaxy;
 
+// How much of a galaxy object has been generated. Sectors are always
+// generated in full. Star systems can be generated with just their bodies,
+// for callers that only need the stars and planets (e.g. routes), and have
+// the rest generated when they are asked for in full.
+enum class GalaxyDetail {
+	BODIES, // names, stars, planets and moons
+	FULL // population, economy, politics and space stations
+};
+
 template <typename T, typename CompareT>
 class GalaxyObjectCache {
 	friend T;
@@ -23,47 +35,96 @@ class GalaxyObjectCache {
 public:
 	static const std::string CACHE_NAME;
 
+	struct Stats {
+		unsigned long long hits; // found in the master cache
+		unsigned long long slaveHits; // found in a slave cache
+		unsigned long long misses; // had to be generated
+		unsigned long long completions; // found, but had to be generated in more detail
+		unsigned long long evictions; // released to stay within the memory budget
+		size_t numObjects; // alive, whether the cache keeps them or not
+		size_t numRetained; // kept alive by the cache itself
+		size_t retainedBytes; // estimated size of the retained objects
+		size_t memoryBudget;
+	};
+
 	GalaxyObjectCache(Galaxy *galaxy) :
 		m_galaxy(galaxy),
-		m_cacheHits(0),
-		m_cacheHitsSlave(0),
-		m_cacheMisses(0) {}
+		m_memoryBudget(0),
+		m_retainedBytes(0),
+		m_stats() {}
 	~GalaxyObjectCache();
 
-	RefCountedPtr<T> GetCached(const SystemPath &path);
-	RefCountedPtr<T> GetIfCached(const SystemPath &path);
-
-	void ClearCache(); // Completely clear slave caches
+	// Objects are generated with at least the requested detail. Cached
+	// objects with less detail are completed in place, so there is still
+	// only one object per path.
+	RefCountedPtr<T> GetCached(const SystemPath &path, GalaxyDetail detail = GalaxyDetail::FULL);
+	RefCountedPtr<T> GetIfCached(const SystemPath &path, GalaxyDetail detail = GalaxyDetail::FULL);
+
+	// The master cache keeps a reference to the objects it has handed out,
+	// so they don't have to be generated again when nothing else happens to
+	// hold on to them. Once their estimated size exceeds the budget, the
+	// least recently used objects that no slave cache or anyone else
+	// references are released. 0 releases them as soon as they are unused.
+	void SetMemoryBudget(size_t bytes);
+
+	// Completely clear slave caches and release everything the master
+	// cache retains. The objects reference the galaxy, so this must be done
+	// before the galaxy can be deleted.
+	void ClearCache();
 	bool IsEmpty() { return m_attic.empty(); }
 
 	void OutputCacheStatistics(bool reset = true);
+	Stats GetStats() const;
+	void ResetStats();
 
 	typedef std::vector<SystemPath> PathVector;
 	typedef std::map<SystemPath, RefCountedPtr<T>, CompareT> CacheMap;
-	typedef std::map<SystemPath, T *, CompareT> AtticMap;
 	typedef std::function<void()> CacheFilledCallback;
 
 	class Slave : public RefCounted {
 		friend class GalaxyObjectCache<T, CompareT>;
 
 	public:
-		RefCountedPtr<T> GetCached(const SystemPath &path);
-		RefCountedPtr<T> GetIfCached(const SystemPath &path);
+		RefCountedPtr<T> GetCached(const SystemPath &path, GalaxyDetail detail = GalaxyDetail::FULL);
+		RefCountedPtr<T> GetIfCached(const SystemPath &path, GalaxyDetail detail = GalaxyDetail::FULL);
 		typename CacheMap::const_iterator Begin() const { return m_cache.begin(); }
 		typename CacheMap::const_iterator End() const { return m_cache.end(); }
 
-		void FillCache(const PathVector &paths, CacheFilledCallback callback = CacheFilledCallback());
+		void FillCache(const PathVector &paths, CacheFilledCallback callback = CacheFilledCallback(), GalaxyDetail detail = GalaxyDetail::FULL);
 		void Erase(const SystemPath &path);
 		void Erase(const typename CacheMap::const_iterator &it);
 		void ClearCache();
 		bool IsEmpty() { return m_cache.empty(); }
 		~Slave();
 
+		// Add the objects FillCache has generated so far to the cache, rather
+		// than waiting for their jobs to finish. Returns how many were added.
+		size_t PublishPending();
+		// Running count of objects added by PublishPending, so users can tell
+		// when they need to look at the cache again
+		unsigned GetNumPublished() const { return m_numPublished; }
+		// True while FillCache still has jobs running
+		bool IsFilling() const { return !m_jobs.IsEmpty(); }
+
+		// Emitted when an object enters or leaves this slave cache, e.g. to
+		// keep an index over its contents up to date
+		sigc::signal<void, T *> onAdded;
+		sigc::signal<void, T *> onRemoved;
+
 	private:
+		// Objects generated by cache jobs, waiting to be added on the main
+		// thread. Shared with the jobs so it can outlive the slave.
+		struct PendingObjects {
+			std::mutex lock;
+			std::vector<RefCountedPtr<T>> objects;
+		};
+
 		GalaxyObjectCache *m_master;
 		RefCountedPtr<Galaxy> m_galaxy;
 		CacheMap m_cache;
 		JobSet m_jobs;
+		std::shared_ptr<PendingObjects> m_pending;
+		unsigned m_numPublished;
 
 		Slave(GalaxyObjectCache *master, RefCountedPtr<Galaxy> galaxy, JobQueue *jobQueue);
 		void MasterDeleted();
@@ -75,27 +136,55 @@ public:
 private:
 	static const unsigned CACHE_JOB_SIZE = 100;
 
+	typedef std::list<RefCountedPtr<T>> RetainedList;
+	struct AtticEntry {
+		T *object;
+		typename RetainedList::iterator retained; // m_retained.end() if not retained
+		size_t size;
+	};
+	typedef std::map<SystemPath, AtticEntry, CompareT> AtticMap;
+
 	void AddToCache(std::vector<RefCountedPtr<T>> &objects);
 	bool HasCached(const SystemPath &path) const;
 	void RemoveFromAttic(const SystemPath &path);
 
+	void Insert(T *object);
+	// Generate more of the object if it has less than the given detail
+	void Complete(AtticEntry &entry, GalaxyDetail detail);
+	// Account for a change in the size of the object
+	void UpdateSize(AtticEntry &entry);
+	// Mark the object as most recently used, retaining it if necessary
+	void Touch(AtticEntry &entry);
+	// Stop retaining the object; this deletes it if nothing else references it
+	typename RetainedList::iterator Release(typename RetainedList::iterator it);
+	// Release unreferenced objects until the retained ones fit the budget
+	void Trim();
+
 	// ********************************************************************************
 	// Overloaded Job class to handle generating a collection of sectors
+	// Each object is handed to the slave as soon as it is done. Sectors are
+	// generated by TaskGraph tasks of their own; star systems look up
+	// sectors in the master cache, which isn't thread safe, so they are
+	// generated one after the other.
 	// ********************************************************************************
 	class CacheJob : public Job {
 	public:
-		CacheJob(std::unique_ptr<std::vector<SystemPath>> path, Slave *slaveCache, RefCountedPtr<Galaxy> galaxy, CacheFilledCallback callback = CacheFilledCallback());
+		CacheJob(std::unique_ptr<std::vector<SystemPath>> path, Slave *slaveCache, RefCountedPtr<Galaxy> galaxy, GalaxyDetail detail, CacheFilledCallback callback = CacheFilledCallback());
 
 		virtual void OnRun(); // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 		virtual void OnFinish(); // runs in primary thread of the context
 		virtual void OnCancel() {} // runs in primary thread of the context
+		virtual const char *GetJobName() const { return "CacheJob"; }
 
 	protected:
+		void Generate(const SystemPath &path); // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+
 		std::unique_ptr<std::vector<SystemPath>> m_paths;
-		std::vector<RefCountedPtr<T>> m_objects;
+		std::shared_ptr<typename Slave::PendingObjects> m_pending;
 		Slave *m_slaveCache;
 		RefCountedPtr<Galaxy> m_galaxy;
 		RefCountedPtr<GalaxyGenerator> m_galaxyGenerator;
+		GalaxyDetail m_detail;
 		CacheFilledCallback m_callback;
 	};
 
@@ -104,10 +193,11 @@ private:
 	AtticMap m_attic; // Those contains non-refcounted pointers which are kept alive by RefCountedPtrs in slave caches
 		// or elsewhere. The Sector destructor ensures that it is removed from here.
 		// This ensures, that there is only ever one object for each Sector.
+	RetainedList m_retained; // most recently used first
+	size_t m_memoryBudget;
+	size_t m_retainedBytes;
 
-	unsigned long long m_cacheHits;
-	unsigned long long m_cacheHitsSlave;
-	unsigned long long m_cacheMisses;
+	Stats m_stats;
 };
 
 class Sector;
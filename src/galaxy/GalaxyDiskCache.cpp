@@ -0,0 +1,159 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "GalaxyDiskCache.h"
+
+#include "DiskCache.h"
+#include "core/FNV1a.h"
+#include "galaxy/Galaxy.h"
+#include "galaxy/Sector.h"
+#include "profiler/Profiler.h"
+#include "scenegraph/Serializer.h"
+
+namespace {
+	// bump this whenever the layout of the cached objects changes; changes to
+	// the generation itself should bump the generator version instead
+	static const Uint32 CACHE_VERSION = 1;
+
+	DiskCache s_cache("galaxy_cache", CACHE_VERSION);
+
+	enum ObjectType : Uint32 {
+		OBJECT_SECTOR,
+		OBJECT_STAR_SYSTEM,
+		OBJECT_DATA
+	};
+
+	uint64_t GetKey(const Galaxy *galaxy, ObjectType type, const SystemPath &path)
+	{
+		Serializer::Writer wr;
+		wr.Int32(CACHE_VERSION);
+		wr.String(galaxy->GetGeneratorName());
+		wr.Int32(galaxy->GetGeneratorVersion());
+		wr.Int64(galaxy->GetDataKey());
+		wr.Int32(type);
+		wr.Int32(path.sectorX);
+		wr.Int32(path.sectorY);
+		wr.Int32(path.sectorZ);
+		wr.Int32(type == OBJECT_STAR_SYSTEM ? path.systemIndex : 0);
+
+		const std::string &data = wr.GetData();
+		return hash_64_fnv1a(data.data(), data.size());
+	}
+
+	uint64_t GetDataKey(const std::string &name)
+	{
+		Serializer::Writer wr;
+		wr.Int32(CACHE_VERSION);
+		wr.Int32(OBJECT_DATA);
+		wr.String(name);
+
+		const std::string &data = wr.GetData();
+		return hash_64_fnv1a(data.data(), data.size());
+	}
+
+	template <typename T>
+	bool LoadObject(Galaxy *galaxy, ObjectType type, const SystemPath &path, T *object, bool &complete)
+	{
+		if (!s_cache.IsEnabled())
+			return false;
+
+		PROFILE_SCOPED()
+		const uint64_t key = GetKey(galaxy, type, path);
+		std::string data;
+		if (!s_cache.Load(key, data))
+			return false;
+
+		try {
+			Serializer::Reader rd(ByteRange(data.data(), data.size()));
+			complete = rd.Bool();
+			object->LoadFromCache(rd);
+			if (rd.Pos() == data.size())
+				return true;
+		} catch (const std::exception &) {
+		}
+
+		s_cache.Remove(key);
+		return false;
+	}
+
+	template <typename T>
+	void StoreObject(Galaxy *galaxy, ObjectType type, const SystemPath &path, const T *object, bool complete)
+	{
+		if (!s_cache.IsEnabled())
+			return;
+
+		PROFILE_SCOPED()
+		Serializer::Writer wr;
+		wr.Bool(complete);
+		object->SaveToCache(wr);
+		s_cache.Store(GetKey(galaxy, type, path), wr.GetData());
+	}
+} // namespace
+
+// static
+void GalaxyDiskCache::Init(size_t maxBytes)
+{
+	s_cache.Init(maxBytes);
+}
+
+// static
+void GalaxyDiskCache::Uninit()
+{
+	s_cache.Uninit();
+}
+
+// static
+bool GalaxyDiskCache::IsEnabled()
+{
+	return s_cache.IsEnabled();
+}
+
+// static
+size_t GalaxyDiskCache::GetSize()
+{
+	return s_cache.GetSize();
+}
+
+// static
+bool GalaxyDiskCache::Load(Galaxy *galaxy, Sector *sector, bool &complete)
+{
+	return LoadObject(galaxy, OBJECT_SECTOR, sector->GetPath(), sector, complete);
+}
+
+// static
+bool GalaxyDiskCache::Load(Galaxy *galaxy, StarSystem::GeneratorAPI *system, bool &complete)
+{
+	return LoadObject(galaxy, OBJECT_STAR_SYSTEM, system->GetPath(), system, complete);
+}
+
+// static
+void GalaxyDiskCache::Store(Galaxy *galaxy, const Sector *sector, bool complete)
+{
+	StoreObject(galaxy, OBJECT_SECTOR, sector->GetPath(), sector, complete);
+}
+
+// static
+void GalaxyDiskCache::Store(Galaxy *galaxy, const StarSystem::GeneratorAPI *system, bool complete)
+{
+	StoreObject(galaxy, OBJECT_STAR_SYSTEM, system->GetPath(), system, complete);
+}
+
+// static
+bool GalaxyDiskCache::LoadData(const std::string &name, std::string &data)
+{
+	return s_cache.IsEnabled() && s_cache.Load(GetDataKey(name), data);
+}
+
+// static
+void GalaxyDiskCache::StoreData(const std::string &name, const std::string &data)
+{
+	if (s_cache.IsEnabled())
+		s_cache.Store(GetDataKey(name), data);
+}
+
+// static
+void GalaxyDiskCache::RemoveData(const std::string &name)
+{
+	if (s_cache.IsEnabled())
+		s_cache.Remove(GetDataKey(name));
+}
@@ -0,0 +1,51 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _GALAXYDISKCACHE_H
+#define _GALAXYDISKCACHE_H
+
+#include "galaxy/StarSystem.h"
+
+#include <cstdint>
+#include <string>
+
+class Galaxy;
+class Sector;
+
+// Thread-safe on-disk cache of generated Sectors and StarSystems, stored
+// LZ4-compressed in the user directory. Generation is deterministic for a
+// given generator, version and game data, so later sessions (and tools
+// scanning the galaxy) can load objects instead of generating them again.
+//
+// Only the output of the cacheable generator stages is stored; stages that
+// layer per-game state on top, like the exploration state kept by
+// SectorPersistenceGenerator, still run after loading.
+class GalaxyDiskCache {
+public:
+	// Enable the cache with the given size limit; 0 disables it
+	static void Init(size_t maxBytes);
+	static void Uninit();
+
+	static bool IsEnabled();
+	// Total size of the cached files, in bytes
+	static size_t GetSize();
+
+	// Fill a newly created object from the cache. Returns false if there is
+	// no valid entry, in which case the object may have been partially
+	// filled and must be discarded. Otherwise complete is set to whether
+	// generation went through all of the cacheable stages or stopped early.
+	static bool Load(Galaxy *galaxy, Sector *sector, bool &complete);
+	static bool Load(Galaxy *galaxy, StarSystem::GeneratorAPI *system, bool &complete);
+
+	static void Store(Galaxy *galaxy, const Sector *sector, bool complete);
+	static void Store(Galaxy *galaxy, const StarSystem::GeneratorAPI *system, bool complete);
+
+	// Entries for other data derived from the game data, like the loaded
+	// custom systems. They are not tied to the galaxy's data key, so the
+	// caller has to check that what it loads is still up to date.
+	static bool LoadData(const std::string &name, std::string &data);
+	static void StoreData(const std::string &name, const std::string &data);
+	static void RemoveData(const std::string &name);
+};
+
+#endif /* _GALAXYDISKCACHE_H */
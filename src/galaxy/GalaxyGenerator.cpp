@@ -6,10 +6,14 @@
 #include "GameSaveError.h"
 #include "Json.h"
 #include "SectorGenerator.h"
+#include "galaxy/Factions.h"
 #include "galaxy/Galaxy.h"
+#include "galaxy/GalaxyDiskCache.h"
 #include "galaxy/StarSystemGenerator.h"
 #include "utils.h"
 
+#include <iterator>
+
 static const GalaxyGenerator::Version LAST_VERSION_LEGACY = 1;
 
 std::string GalaxyGenerator::s_defaultGenerator = "legacy";
@@ -174,25 +178,106 @@ RefCountedPtr<Sector> GalaxyGenerator::GenerateSector(RefCountedPtr<Galaxy> gala
 	Random rng(_init, 4);
 	SectorConfig config;
 	RefCountedPtr<Sector> sector(new Sector(galaxy, path, cache));
-	for (SectorGeneratorStage *secgen : m_sectorStage)
-		if (!secgen->Apply(rng, galaxy, sector, &config))
-			break;
+
+	// while the galaxy is being initialised, sectors may be generated before
+	// the galaxy data is complete
+	const bool useCache = galaxy->IsInitialized() && GalaxyDiskCache::IsEnabled();
+	bool complete = true;
+	auto stage = m_sectorStage.begin();
+	if (useCache && GalaxyDiskCache::Load(galaxy.Get(), sector.Get(), complete)) {
+		while (stage != m_sectorStage.end() && (*stage)->IsCacheable())
+			++stage;
+	} else {
+		if (useCache)
+			sector.Reset(new Sector(galaxy, path, cache));
+		for (; complete && stage != m_sectorStage.end() && (*stage)->IsCacheable(); ++stage)
+			complete = (*stage)->Apply(rng, galaxy, sector, &config);
+		if (useCache)
+			GalaxyDiskCache::Store(galaxy.Get(), sector.Get(), complete);
+		while (stage != m_sectorStage.end() && (*stage)->IsCacheable())
+			++stage;
+	}
+
+	for (; complete && stage != m_sectorStage.end(); ++stage)
+		complete = (*stage)->Apply(rng, galaxy, sector, &config);
 	return sector;
 }
 
-RefCountedPtr<StarSystem> GalaxyGenerator::GenerateStarSystem(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, StarSystemCache *cache)
+RefCountedPtr<StarSystem> GalaxyGenerator::GenerateStarSystem(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, StarSystemCache *cache, GalaxyDetail detail)
 {
 	PROFILE_SCOPED()
 	RefCountedPtr<const Sector> sec = galaxy->GetSector(path);
 	assert(path.systemIndex < sec->m_systems.size());
 	Uint32 seed = sec->m_systems[path.systemIndex].GetSeed();
-	std::string name = sec->m_systems[path.systemIndex].GetName();
 	Uint32 _init[5] = { Uint32(seed), Uint32(path.sectorX), Uint32(path.sectorY), Uint32(path.sectorZ), UNIVERSE_SEED };
-	Random rng(_init, 5);
-	StarSystemConfig config;
-	RefCountedPtr<StarSystem::GeneratorAPI> system(new StarSystem::GeneratorAPI(path, galaxy, cache, rng));
-	for (StarSystemGeneratorStage *sysgen : m_starSystemStage)
-		if (!sysgen->Apply(rng, galaxy, system, &config))
-			break;
+	std::unique_ptr<StarSystemGenerationState> state(new StarSystemGenerationState);
+	state->rng.Reset(new Random(_init, 5));
+	state->nextStage = 0;
+	RefCountedPtr<StarSystem::GeneratorAPI> system(new StarSystem::GeneratorAPI(path, galaxy, cache, *state->rng));
+
+	const bool useCache = galaxy->IsInitialized() && GalaxyDiskCache::IsEnabled();
+	bool complete = true;
+	if (useCache && GalaxyDiskCache::Load(galaxy.Get(), system.Get(), complete)) {
+		auto stage = m_starSystemStage.begin();
+		while (stage != m_starSystemStage.end() && (*stage)->IsCacheable())
+			++stage;
+		state->nextStage = complete ? std::distance(m_starSystemStage.begin(), stage) : m_starSystemStage.size();
+
+		// the cache doesn't keep what depends on the factions, the
+		// exploration state or the language, so redo that here
+		const Sector::System &secSys = sec->m_systems[path.systemIndex];
+		system->SetFaction(galaxy->GetFactions()->GetNearestClaimant(&secSys));
+		system->SetExplored(secSys.GetExplored(), secSys.GetExploredTime());
+		if (secSys.GetCustomSystem() && secSys.GetCustomSystem()->shortDesc.length() > 0)
+			system->SetShortDesc(secSys.GetCustomSystem()->shortDesc);
+		else if (complete)
+			system->MakeShortDescription();
+	} else if (useCache) {
+		system.Reset(new StarSystem::GeneratorAPI(path, galaxy, cache, *state->rng));
+	}
+
+	system->m_generationState = std::move(state);
+	RunStarSystemStages(galaxy, system, detail);
 	return system;
 }
+
+void GalaxyGenerator::CompleteStarSystem(RefCountedPtr<Galaxy> galaxy, StarSystem *system, GalaxyDetail detail)
+{
+	if (system->GetDetail() >= detail)
+		return;
+
+	PROFILE_SCOPED()
+	assert(system->m_generationState);
+	// all generated systems are created as a GeneratorAPI
+	RunStarSystemStages(galaxy, RefCountedPtr<StarSystem::GeneratorAPI>(static_cast<StarSystem::GeneratorAPI *>(system)), detail);
+}
+
+void GalaxyGenerator::RunStarSystemStages(RefCountedPtr<Galaxy> galaxy, RefCountedPtr<StarSystem::GeneratorAPI> system, GalaxyDetail detail)
+{
+	StarSystemGenerationState *state = system->m_generationState.get();
+	const bool useCache = galaxy->IsInitialized() && GalaxyDiskCache::IsEnabled();
+
+	auto stage = std::next(m_starSystemStage.begin(), state->nextStage);
+	while (stage != m_starSystemStage.end() && (*stage)->GetDetail() <= detail) {
+		const bool cacheable = (*stage)->IsCacheable();
+		const bool complete = (*stage)->Apply(*state->rng, galaxy, system, &state->config);
+		if (complete) {
+			++stage;
+			++state->nextStage;
+		} else {
+			stage = m_starSystemStage.end();
+			state->nextStage = m_starSystemStage.size();
+		}
+
+		// store as soon as all cacheable stages have run
+		if (useCache && cacheable && (stage == m_starSystemStage.end() || !(*stage)->IsCacheable()))
+			GalaxyDiskCache::Store(galaxy.Get(), system.Get(), complete);
+	}
+
+	if (stage == m_starSystemStage.end()) {
+		system->m_detail = GalaxyDetail::FULL;
+		system->m_generationState.reset();
+	} else {
+		system->m_detail = detail;
+	}
+}
@@ -45,7 +45,10 @@ public:
 
 	// Templated for the template cache class.
 	template <typename T, typename Cache>
-	RefCountedPtr<T> Generate(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, Cache *cache);
+	RefCountedPtr<T> Generate(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, Cache *cache, GalaxyDetail detail = GalaxyDetail::FULL);
+	// Carry on generating an object until it has at least the given detail
+	template <typename T>
+	void Complete(RefCountedPtr<Galaxy> galaxy, T *object, GalaxyDetail detail);
 
 	GalaxyGenerator *AddSectorStage(SectorGeneratorStage *sectorGenerator);
 	GalaxyGenerator *AddStarSystemStage(StarSystemGeneratorStage *starSystemGenerator);
@@ -70,7 +73,11 @@ private:
 		m_version(version) {}
 
 	virtual RefCountedPtr<Sector> GenerateSector(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, SectorCache *cache);
-	virtual RefCountedPtr<StarSystem> GenerateStarSystem(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, StarSystemCache *cache);
+	virtual RefCountedPtr<StarSystem> GenerateStarSystem(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, StarSystemCache *cache, GalaxyDetail detail);
+	void CompleteStarSystem(RefCountedPtr<Galaxy> galaxy, StarSystem *system, GalaxyDetail detail);
+	// Run the stages from where the system's generation state left off
+	// until one of them provides more than the given detail
+	void RunStarSystemStages(RefCountedPtr<Galaxy> galaxy, RefCountedPtr<StarSystem::GeneratorAPI> system, GalaxyDetail detail);
 
 	const std::string m_name;
 	const Version m_version;
@@ -84,17 +91,36 @@ private:
 };
 
 template <>
-inline RefCountedPtr<Sector> GalaxyGenerator::Generate<Sector, SectorCache>(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, SectorCache *cache)
+inline RefCountedPtr<Sector> GalaxyGenerator::Generate<Sector, SectorCache>(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, SectorCache *cache, GalaxyDetail detail)
 {
 	return GenerateSector(galaxy, path, cache);
 }
 
 template <>
-inline RefCountedPtr<StarSystem> GalaxyGenerator::Generate<StarSystem, StarSystemCache>(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, StarSystemCache *cache)
+inline void GalaxyGenerator::Complete<Sector>(RefCountedPtr<Galaxy> galaxy, Sector *sector, GalaxyDetail detail)
 {
-	return GenerateStarSystem(galaxy, path, cache);
 }
 
+template <>
+inline RefCountedPtr<StarSystem> GalaxyGenerator::Generate<StarSystem, StarSystemCache>(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, StarSystemCache *cache, GalaxyDetail detail)
+{
+	return GenerateStarSystem(galaxy, path, cache, detail);
+}
+
+template <>
+inline void GalaxyGenerator::Complete<StarSystem>(RefCountedPtr<Galaxy> galaxy, StarSystem *system, GalaxyDetail detail)
+{
+	CompleteStarSystem(galaxy, system, detail);
+}
+
+// Where the generation of a star system stopped, so the remaining stages
+// can be run later with the same random numbers they would have had
+struct StarSystemGenerationState {
+	RefCountedPtr<Random> rng;
+	GalaxyGenerator::StarSystemConfig config;
+	size_t nextStage;
+};
+
 class GalaxyGeneratorStage {
 public:
 	virtual ~GalaxyGeneratorStage() {}
@@ -102,6 +128,13 @@ public:
 	virtual void ToJson(Json &jsonObj, RefCountedPtr<Galaxy> galaxy) {}
 	virtual void FromJson(const Json &jsonObj, RefCountedPtr<Galaxy> galaxy) {}
 
+	// Whether the output of this stage only depends on the path, the
+	// generator and the galaxy data files and can be kept in the
+	// GalaxyDiskCache. Stages that aren't must come after all cacheable
+	// stages and must not draw from the rng, since they also run on top of
+	// objects loaded from the cache.
+	virtual bool IsCacheable() const { return true; }
+
 protected:
 	GalaxyGeneratorStage() :
 		m_galaxyGenerator(nullptr) {}
@@ -124,6 +157,10 @@ public:
 	virtual ~StarSystemGeneratorStage() {}
 
 	virtual bool Apply(Random &rng, RefCountedPtr<Galaxy> galaxy, RefCountedPtr<StarSystem::GeneratorAPI> system, GalaxyGenerator::StarSystemConfig *config) = 0;
+
+	// The detail this stage generates. Stages must be added in order of
+	// detail, so generation can stop before the first one nobody needs yet.
+	virtual GalaxyDetail GetDetail() const { return GalaxyDetail::BODIES; }
 };
 
 #endif
@@ -0,0 +1,179 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "JumpGraph.h"
+
+#include "galaxy/Sector.h"
+#include "profiler/Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+float JumpCost::GetDuration(float distance) const
+{
+	if (durations.size() < 2)
+		return durations.empty() ? distance : durations[0];
+
+	const float x = std::max(distance, 0.0f) / range * float(durations.size() - 1);
+	const size_t i = std::min(size_t(x), durations.size() - 2);
+	const float frac = x - float(i);
+	return durations[i] + frac * (durations[i + 1] - durations[i]);
+}
+
+float JumpCost::GetMinRate() const
+{
+	if (durations.size() < 2)
+		return durations.empty() ? 1.0f : 0.0f;
+
+	// between two samples, duration / distance of the interpolated values
+	// lies between its values at the samples
+	float rate = HUGE_VALF;
+	for (size_t i = 1; i < durations.size(); i++)
+		rate = std::min(rate, durations[i] / (range * float(i) / float(durations.size() - 1)));
+	return std::max(rate, 0.0f);
+}
+
+JumpGraph::JumpGraph(float range) :
+	m_range(range)
+{
+}
+
+JumpGraph::CellKey JumpGraph::GetCellKey(const vector3f &pos, int dx, int dy, int dz) const
+{
+	// 21 bits per axis is plenty for any range of at least a light year
+	const float cellSize = std::max(m_range, 1.0f);
+	const Uint64 x = Uint64(Sint64(std::floor(pos.x / cellSize)) + dx + (1 << 20)) & 0x1fffff;
+	const Uint64 y = Uint64(Sint64(std::floor(pos.y / cellSize)) + dy + (1 << 20)) & 0x1fffff;
+	const Uint64 z = Uint64(Sint64(std::floor(pos.z / cellSize)) + dz + (1 << 20)) & 0x1fffff;
+	return x | y << 21 | z << 42;
+}
+
+template <typename F>
+void JumpGraph::ForEachInRange(const vector3f &pos, F func) const
+{
+	const float rangeSqr = m_range * m_range;
+	for (int dz = -1; dz <= 1; dz++)
+		for (int dy = -1; dy <= 1; dy++)
+			for (int dx = -1; dx <= 1; dx++) {
+				auto cell = m_cells.find(GetCellKey(pos, dx, dy, dz));
+				if (cell == m_cells.end())
+					continue;
+				for (Uint32 other : cell->second) {
+					const float distSqr = (m_nodes[other].pos - pos).LengthSqr();
+					if (distSqr <= rangeSqr)
+						func(other, distSqr);
+				}
+			}
+}
+
+void JumpGraph::AddSector(const Sector *sector)
+{
+	std::vector<vector3f> positions;
+	positions.reserve(sector->m_systems.size());
+	for (const Sector::System &sys : sector->m_systems)
+		positions.push_back(sys.GetPosition());
+	AddSector(sector->GetPath(), positions);
+}
+
+void JumpGraph::AddSector(const SystemPath &sectorPath, const std::vector<vector3f> &positions)
+{
+	PROFILE_SCOPED()
+	if (HasSector(sectorPath))
+		return;
+
+	const Uint32 first = m_nodes.size();
+	m_sectors[sectorPath] = std::make_pair(first, Uint32(positions.size()));
+
+	const vector3f sectorPos = Sector::SIZE * vector3f(float(sectorPath.sectorX), float(sectorPath.sectorY), float(sectorPath.sectorZ));
+	for (Uint32 i = 0; i < positions.size(); i++) {
+		const Uint32 node = m_nodes.size();
+		m_nodes.push_back({ SystemPath(sectorPath.sectorX, sectorPath.sectorY, sectorPath.sectorZ, i), sectorPos + positions[i], false, {} });
+
+		// nodes that already know their edges gain one to the new node; the
+		// new node works out its own when it is first needed
+		const vector3f &pos = m_nodes[node].pos;
+		ForEachInRange(pos, [&](Uint32 other, float distSqr) {
+			if (m_nodes[other].hasEdges)
+				m_nodes[other].edges.push_back({ node, std::sqrt(distSqr) });
+		});
+		m_cells[GetCellKey(pos)].push_back(node);
+	}
+}
+
+Uint32 JumpGraph::FindNode(const SystemPath &system) const
+{
+	auto it = m_sectors.find(system);
+	if (it == m_sectors.end() || system.systemIndex < 0 || Uint32(system.systemIndex) >= it->second.second)
+		return INVALID_NODE;
+	return it->second.first + system.systemIndex;
+}
+
+const std::vector<JumpGraph::Edge> &JumpGraph::GetEdges(Uint32 node)
+{
+	Node &n = m_nodes[node];
+	if (!n.hasEdges) {
+		ForEachInRange(n.pos, [&](Uint32 other, float distSqr) {
+			if (other != node)
+				n.edges.push_back({ other, std::sqrt(distSqr) });
+		});
+		n.hasEdges = true;
+	}
+	return n.edges;
+}
+
+bool JumpGraph::FindRoute(const SystemPath &start, const SystemPath &target, const JumpCost &cost, std::vector<SystemPath> &route)
+{
+	PROFILE_SCOPED()
+	route.clear();
+	const Uint32 startNode = FindNode(start);
+	const Uint32 targetNode = FindNode(target);
+	if (startNode == INVALID_NODE || targetNode == INVALID_NODE)
+		return false;
+
+	// the straight line at the lowest duration per light year is never
+	// slower than the real route, so the first time the target comes off
+	// the queue its route is the quickest one
+	const float rate = cost.GetMinRate();
+	const vector3f &targetPos = m_nodes[targetNode].pos;
+	auto estimate = [&](Uint32 node) { return rate * (m_nodes[node].pos - targetPos).Length(); };
+
+	std::vector<float> duration(m_nodes.size(), HUGE_VALF);
+	std::vector<Uint32> prev(m_nodes.size(), INVALID_NODE);
+	std::vector<bool> visited(m_nodes.size(), false);
+
+	typedef std::pair<float, Uint32> QueueEntry;
+	std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> open;
+	duration[startNode] = 0.0f;
+	open.push({ estimate(startNode), startNode });
+
+	while (!open.empty()) {
+		const Uint32 node = open.top().second;
+		open.pop();
+		if (visited[node])
+			continue;
+		visited[node] = true;
+
+		if (node == targetNode)
+			break;
+
+		for (const Edge &edge : GetEdges(node)) {
+			if (visited[edge.node])
+				continue;
+			const float d = duration[node] + cost.GetDuration(edge.distance);
+			if (d < duration[edge.node]) {
+				duration[edge.node] = d;
+				prev[edge.node] = node;
+				open.push({ d + estimate(edge.node), edge.node });
+			}
+		}
+	}
+
+	if (!visited[targetNode])
+		return false;
+
+	for (Uint32 node = targetNode; node != startNode; node = prev[node])
+		route.push_back(m_nodes[node].path);
+	std::reverse(route.begin(), route.end());
+	return true;
+}
@@ -0,0 +1,88 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _JUMPGRAPH_H
+#define _JUMPGRAPH_H
+
+#include "galaxy/SystemPath.h"
+#include "vector3.h"
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+class Sector;
+
+// Duration of a hyperspace jump as a function of its length, sampled at
+// evenly spaced distances from 0 to the range of the drive. The durations
+// come from the Lua hyperdrive, so they are sampled on the main thread and
+// interpolated during the search.
+struct JumpCost {
+	float range;
+	std::vector<float> durations;
+
+	float GetDuration(float distance) const;
+	// Lower bound of the duration per light year of any jump in range, so
+	// rate * distance never overestimates the duration of a route
+	float GetMinRate() const;
+};
+
+// Graph of the systems in a set of sectors, with an edge between every pair
+// of systems within jump range of each other. Sectors are added on the main
+// thread; the edges of a system are only worked out when a search first
+// needs them, so routes can be searched without generating any sectors.
+//
+// Not thread-safe: a graph may be searched by one thread at a time, and not
+// while sectors are being added.
+class JumpGraph {
+public:
+	static const Uint32 INVALID_NODE = ~Uint32(0);
+
+	struct Edge {
+		Uint32 node;
+		float distance; // in light years
+	};
+
+	explicit JumpGraph(float range);
+
+	float GetRange() const { return m_range; }
+	size_t GetNumNodes() const { return m_nodes.size(); }
+	size_t GetNumSectors() const { return m_sectors.size(); }
+
+	bool HasSector(const SystemPath &sectorPath) const { return m_sectors.count(sectorPath) != 0; }
+	void AddSector(const Sector *sector);
+	// positions of the sector's systems relative to the sector, in order
+	void AddSector(const SystemPath &sectorPath, const std::vector<vector3f> &positions);
+
+	Uint32 FindNode(const SystemPath &system) const;
+	const SystemPath &GetPath(Uint32 node) const { return m_nodes[node].path; }
+	const vector3f &GetPosition(Uint32 node) const { return m_nodes[node].pos; }
+	const std::vector<Edge> &GetEdges(Uint32 node);
+
+	// A* search for the route that takes the least time. On success, route
+	// holds the systems after start, ending with target.
+	bool FindRoute(const SystemPath &start, const SystemPath &target, const JumpCost &cost, std::vector<SystemPath> &route);
+
+private:
+	struct Node {
+		SystemPath path;
+		vector3f pos; // in light years
+		bool hasEdges;
+		std::vector<Edge> edges;
+	};
+
+	// nodes are bucketed into cubes the size of the jump range, so all
+	// neighbours of a node are in the 27 cubes around it
+	typedef Uint64 CellKey;
+	CellKey GetCellKey(const vector3f &pos, int dx = 0, int dy = 0, int dz = 0) const;
+	template <typename F>
+	void ForEachInRange(const vector3f &pos, F func) const;
+
+	float m_range;
+	std::vector<Node> m_nodes;
+	// first node of each sector and the number of its systems
+	std::map<SystemPath, std::pair<Uint32, Uint32>, SystemPath::LessSectorOnly> m_sectors;
+	std::unordered_map<CellKey, std::vector<Uint32>> m_cells;
+};
+
+#endif /* _JUMPGRAPH_H */
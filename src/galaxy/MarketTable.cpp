@@ -0,0 +1,104 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "MarketTable.h"
+
+#include "galaxy/StarSystem.h"
+#include "profiler/Profiler.h"
+
+#include <algorithm>
+
+namespace GalacticEconomy {
+
+	static std::vector<float> GetBasePrices()
+	{
+		std::vector<float> prices(Commodities().size() + 1, 0.0f);
+		for (const CommodityInfo &commodity : Commodities())
+			prices[commodity.id] = commodity.price;
+		return prices;
+	}
+
+	MarketTable::MarketTable() :
+		MarketTable(GetBasePrices())
+	{
+	}
+
+	MarketTable::MarketTable(std::vector<float> basePrices) :
+		m_basePrices(std::move(basePrices)),
+		m_numMarkets(0),
+		m_stride(0)
+	{
+	}
+
+	void MarketTable::Reserve(size_t numMarkets)
+	{
+		if (numMarkets <= m_stride)
+			return;
+
+		// move the rows apart; the columns past m_numMarkets are never read
+		const size_t size = m_basePrices.size() * numMarkets;
+		auto regrow = [&](auto &matrix) {
+			std::remove_reference_t<decltype(matrix)> grown(size);
+			for (size_t row = 0; row < m_basePrices.size(); row++)
+				std::copy_n(matrix.begin() + row * m_stride, m_numMarkets, grown.begin() + row * numMarkets);
+			matrix.swap(grown);
+		};
+		regrow(m_tradeLevel);
+		regrow(m_legal);
+		regrow(m_stock);
+		regrow(m_demand);
+		regrow(m_price);
+		m_stride = numMarkets;
+	}
+
+	size_t MarketTable::AddMarket()
+	{
+		if (m_numMarkets == m_stride)
+			Reserve(std::max<size_t>(16, m_stride * 2));
+
+		const size_t market = m_numMarkets++;
+		for (size_t row = 0; row < m_basePrices.size(); row++) {
+			m_tradeLevel[Index(row, market)] = 0.0f;
+			m_legal[Index(row, market)] = true;
+		}
+		return market;
+	}
+
+	size_t MarketTable::AddMarket(const StarSystem *system)
+	{
+		const size_t market = AddMarket();
+		for (const CommodityInfo &commodity : Commodities()) {
+			if (commodity.id >= m_basePrices.size())
+				continue;
+			SetTradeLevel(commodity.id, market, system->GetCommodityBasePriceModPercent(commodity.id));
+			SetLegal(commodity.id, market, system->IsCommodityLegal(commodity.id));
+		}
+		return market;
+	}
+
+	void MarketTable::Update()
+	{
+		PROFILE_SCOPED()
+		const size_t numMarkets = m_numMarkets;
+		if (!numMarkets)
+			return;
+
+		for (size_t row = 0; row < m_basePrices.size(); row++) {
+			// one branch-free loop per row, which the compiler vectorizes
+			// across the markets
+			const float basePrice = m_basePrices[row];
+			const float *level = &m_tradeLevel[row * m_stride];
+			const uint8_t *legal = &m_legal[row * m_stride];
+			float *stock = &m_stock[row * m_stride];
+			float *demand = &m_demand[row * m_stride];
+			float *price = &m_price[row * m_stride];
+
+			for (size_t i = 0; i < numMarkets; i++) {
+				demand[i] = std::max(level[i], 0.0f);
+				stock[i] = std::max(-level[i], 0.0f) * float(legal[i]);
+				price[i] = basePrice * (1.0f + 0.01f * level[i]);
+			}
+		}
+	}
+
+} // namespace GalacticEconomy
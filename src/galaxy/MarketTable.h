@@ -0,0 +1,78 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _MARKETTABLE_H
+#define _MARKETTABLE_H
+
+#include "galaxy/Economy.h"
+
+#include <cstdint>
+#include <vector>
+
+class StarSystem;
+
+namespace GalacticEconomy {
+
+	// The markets of a set of systems (or stations), stored as dense
+	// commodity x market matrices: each commodity is one contiguous row with
+	// a column per market. The whole table is brought up to date by Update()
+	// in a single pass over the rows, which suits comparing many markets at
+	// once, e.g. when looking for trade routes.
+	//
+	// The trade level of a commodity is the percentage its base price is
+	// altered by in the market (see StarSystem::GetCommodityBasePriceModPercent).
+	// A positive level means the commodity is in demand, a negative one that
+	// there is a surplus of it. Stock and demand are the two halves of that
+	// balance, in the same units; there is no legal stock of an illegal
+	// commodity.
+	class MarketTable {
+	public:
+		// One row for every commodity in Commodities()
+		MarketTable();
+		// One row for each given base price, indexed by commodity id; row 0 is
+		// for InvalidCommodityId
+		explicit MarketTable(std::vector<float> basePrices);
+
+		size_t GetNumCommodities() const { return m_basePrices.size(); }
+		size_t GetNumMarkets() const { return m_numMarkets; }
+
+		void Reserve(size_t numMarkets);
+		void Clear() { m_numMarkets = 0; }
+
+		// Returns the column of the new market; all commodities start out at
+		// the base price and legal
+		size_t AddMarket();
+		size_t AddMarket(const StarSystem *system);
+
+		void SetTradeLevel(CommodityId commodity, size_t market, int level) { m_tradeLevel[Index(commodity, market)] = float(level); }
+		void SetLegal(CommodityId commodity, size_t market, bool legal) { m_legal[Index(commodity, market)] = legal; }
+
+		// Recompute stock, demand and price of every commodity in every market
+		void Update();
+
+		float GetStock(CommodityId commodity, size_t market) const { return m_stock[Index(commodity, market)]; }
+		float GetDemand(CommodityId commodity, size_t market) const { return m_demand[Index(commodity, market)]; }
+		float GetPrice(CommodityId commodity, size_t market) const { return m_price[Index(commodity, market)]; }
+
+		// The row of a commodity, GetNumMarkets() values long
+		const float *GetStocks(CommodityId commodity) const { return &m_stock[Index(commodity, 0)]; }
+		const float *GetDemands(CommodityId commodity) const { return &m_demand[Index(commodity, 0)]; }
+		const float *GetPrices(CommodityId commodity) const { return &m_price[Index(commodity, 0)]; }
+
+	private:
+		size_t Index(CommodityId commodity, size_t market) const { return commodity * m_stride + market; }
+
+		std::vector<float> m_basePrices;
+		size_t m_numMarkets;
+		size_t m_stride; // allocated columns per row
+
+		std::vector<float> m_tradeLevel;
+		std::vector<uint8_t> m_legal;
+		std::vector<float> m_stock;
+		std::vector<float> m_demand;
+		std::vector<float> m_price;
+	};
+
+} // namespace GalacticEconomy
+
+#endif /* _MARKETTABLE_H */
@@ -4,6 +4,18 @@
 #include "NameGenerator.h"
 #include "utils.h"
 
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+	// far more than the systems of the sectors about the player; it's
+	// emptied once full, as the names are cheap to make again
+	constexpr size_t MAX_CACHED_NAMES = 16384;
+
+	std::mutex s_cacheLock;
+	std::unordered_map<Uint32, std::string> s_nameCache;
+} // namespace
+
 void NameGenerator::GetSystemName(std::string &name, Random &rng)
 {
 	int nameGen = rng.Int32(0, 3);
@@ -18,6 +30,47 @@ void NameGenerator::GetSystemName(std::string &name, Random &rng)
 	}
 }
 
+void NameGenerator::GetSystemNames(std::vector<std::string> &names, Uint32 firstSeed, Uint32 count)
+{
+	names.resize(count);
+
+	// the names which have to be generated are made outside the lock
+	std::vector<Uint32> missing;
+	{
+		std::lock_guard<std::mutex> lock(s_cacheLock);
+		for (Uint32 idx = 0; idx < count; idx++) {
+			auto iter = s_nameCache.find(firstSeed + idx);
+			if (iter != s_nameCache.end())
+				names[idx] = iter->second;
+			else
+				missing.push_back(idx);
+		}
+	}
+
+	if (missing.empty())
+		return;
+
+	Random rng;
+	for (Uint32 idx : missing) {
+		rng.seed(firstSeed + idx);
+		names[idx].clear();
+		GetSystemName(names[idx], rng);
+	}
+
+	std::lock_guard<std::mutex> lock(s_cacheLock);
+	if (s_nameCache.size() + missing.size() > MAX_CACHED_NAMES)
+		s_nameCache.clear();
+	for (Uint32 idx : missing)
+		s_nameCache.emplace(firstSeed + idx, names[idx]);
+}
+
+std::string NameGenerator::GetSystemName(Uint32 seed)
+{
+	std::vector<std::string> names;
+	GetSystemNames(names, seed, 1);
+	return std::move(names[0]);
+}
+
 namespace FrontierNames {
 	static const char *sys_names[] = {
 		"en", "la", "can", "be",
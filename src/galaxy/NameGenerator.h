@@ -5,10 +5,19 @@
 
 #include "Random.h"
 #include <string>
+#include <vector>
 
 namespace NameGenerator {
 	void GetSystemName(std::string &name, Random &rng);
-}
+
+	// The name GetSystemName gives with a generator seeded with seed. Names
+	// are remembered, so asking for the same seed again doesn't generate it
+	// again. Can be called from any thread.
+	std::string GetSystemName(Uint32 seed);
+	// The names for every seed in [firstSeed, firstSeed + count), in order,
+	// as GetSystemName(seed) gives them
+	void GetSystemNames(std::vector<std::string> &names, Uint32 firstSeed, Uint32 count);
+} // namespace NameGenerator
 
 namespace FrontierNames {
 	void GetName(std::string &name, Random &rng);
@@ -0,0 +1,185 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "RoutePlanner.h"
+
+#include "MathUtil.h"
+#include "Pi.h"
+#include "core/Log.h"
+#include "core/StringUtils.h"
+#include "galaxy/Galaxy.h"
+#include "galaxy/Sector.h"
+#include "profiler/Profiler.h"
+
+#include <algorithm>
+
+// start again with an empty graph rather than let it grow any further
+static const size_t MAX_GRAPH_NODES = 250000;
+// how far from the direct line between start and target systems may be
+static const float MAX_DIST_FROM_STRAIGHT_LINE = Sector::SIZE * 3;
+
+class RoutePlanner::SearchJob : public Job {
+public:
+	SearchJob(RoutePlanner *planner, std::shared_ptr<JumpGraph> graph, const Request &request) :
+		m_planner(planner),
+		m_graph(graph),
+		m_start(request.start),
+		m_target(request.target),
+		m_cost(request.cost),
+		m_found(false),
+		m_numSectors(0)
+	{
+		// the player is waiting for this
+		SetPriority(PRIORITY_HIGH);
+	}
+
+	virtual void OnRun() override // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+	{
+		PROFILE_SCOPED()
+		m_found = m_graph->FindRoute(m_start, m_target, m_cost, m_route);
+		m_numSectors = m_graph->GetNumSectors();
+		// let the planner keep adding to the graph as soon as we're finished
+		m_graph.reset();
+	}
+
+	virtual void OnFinish() override
+	{
+		Output("RoutePlanner: %s, searched " SIZET_FMT " sectors\n", m_found ? "found route" : "no valid route", m_numSectors);
+		m_planner->OnSearchFinished(m_found, m_route);
+	}
+
+	virtual const char *GetJobName() const override { return "RouteSearchJob"; }
+
+private:
+	RoutePlanner *m_planner;
+	std::shared_ptr<JumpGraph> m_graph;
+	const SystemPath m_start;
+	const SystemPath m_target;
+	const JumpCost m_cost;
+	bool m_found;
+	size_t m_numSectors;
+	std::vector<SystemPath> m_route;
+};
+
+RoutePlanner::RoutePlanner(RefCountedPtr<Galaxy> galaxy) :
+	m_galaxy(galaxy),
+	m_sectorCache(galaxy->NewSectorSlaveCache())
+{
+}
+
+RoutePlanner::~RoutePlanner()
+{
+}
+
+void RoutePlanner::Cancel()
+{
+	m_searchJob = Job::Handle();
+	m_request.reset();
+}
+
+void RoutePlanner::PrepareGraph(float range)
+{
+	Cancel();
+
+	// a search that is still running owns the graph until it is finished
+	if (!m_graph || m_graph->GetRange() != range || m_graph->GetNumNodes() > MAX_GRAPH_NODES || m_graph.use_count() > 1)
+		m_graph = std::make_shared<JumpGraph>(range);
+}
+
+std::vector<SystemPath> RoutePlanner::FindMissingSectors(const SystemPath &start, const SystemPath &target) const
+{
+	std::vector<SystemPath> missing;
+	const RefCountedPtr<const Sector> startSec = m_galaxy->GetSector(start);
+	const RefCountedPtr<const Sector> targetSec = m_galaxy->GetSector(target);
+	const vector3f startPos = startSec->m_systems[start.systemIndex].GetFullPosition();
+	const vector3f targetPos = targetSec->m_systems[target.systemIndex].GetFullPosition();
+
+	// the sectors of the box around the start and target that are near
+	// enough to the direct line between them
+	const Sint32 minX = std::min(start.sectorX, target.sectorX) - 2, maxX = std::max(start.sectorX, target.sectorX) + 2;
+	const Sint32 minY = std::min(start.sectorY, target.sectorY) - 2, maxY = std::max(start.sectorY, target.sectorY) + 2;
+	const Sint32 minZ = std::min(start.sectorZ, target.sectorZ) - 2, maxZ = std::max(start.sectorZ, target.sectorZ) + 2;
+	for (Sint32 sx = minX; sx <= maxX; sx++) {
+		for (Sint32 sy = minY; sy <= maxY; sy++) {
+			for (Sint32 sz = minZ; sz <= maxZ; sz++) {
+				const SystemPath secPath(sx, sy, sz);
+				if (m_graph->HasSector(secPath))
+					continue;
+
+				// deliberately conservative, to rather include too many sectors
+				const vector3f secCentre(Sector::SIZE * vector3f(float(sx) + 0.5f, float(sy) + 0.5f, float(sz) + 0.5f));
+				if (MathUtil::DistanceFromLine(startPos, targetPos, secCentre) - Sector::SIZE > MAX_DIST_FROM_STRAIGHT_LINE)
+					continue;
+
+				missing.push_back(secPath);
+			}
+		}
+	}
+	return missing;
+}
+
+void RoutePlanner::PlanRoute(const SystemPath &start, const SystemPath &target, const JumpCost &cost, RouteCallback callback)
+{
+	PROFILE_SCOPED()
+	PrepareGraph(cost.range);
+	m_request.reset(new Request{ start, target, cost, callback, FindMissingSectors(start, target) });
+
+	if (m_request->missing.empty())
+		StartSearch();
+	else
+		m_sectorCache->FillCache(m_request->missing, [this]() { OnSectorsFilled(); });
+}
+
+bool RoutePlanner::FindRoute(const SystemPath &start, const SystemPath &target, const JumpCost &cost, std::vector<SystemPath> &route)
+{
+	PROFILE_SCOPED()
+	PrepareGraph(cost.range);
+	for (const SystemPath &secPath : FindMissingSectors(start, target))
+		m_graph->AddSector(m_galaxy->GetSector(secPath).Get());
+
+	const bool found = m_graph->FindRoute(start, target, cost, route);
+	Output("RoutePlanner: %s, searched " SIZET_FMT " sectors\n", found ? "found route" : "no valid route", m_graph->GetNumSectors());
+	return found;
+}
+
+void RoutePlanner::OnSectorsFilled()
+{
+	// called once all cache jobs are finished, which may include those of
+	// an earlier route
+	if (!m_request || m_searchJob.HasJob())
+		return;
+
+	PROFILE_SCOPED()
+	std::vector<SystemPath> &missing = m_request->missing;
+	for (auto it = missing.begin(); it != missing.end();) {
+		RefCountedPtr<Sector> sec = m_sectorCache->GetIfCached(*it);
+		if (sec) {
+			m_graph->AddSector(sec.Get());
+			// the graph has all it needs from the sector
+			m_sectorCache->Erase(*it);
+			*it = missing.back();
+			missing.pop_back();
+		} else {
+			++it;
+		}
+	}
+
+	StartSearch();
+}
+
+void RoutePlanner::StartSearch()
+{
+	// anything the cache jobs didn't generate
+	for (const SystemPath &secPath : m_request->missing)
+		m_graph->AddSector(m_galaxy->GetSector(secPath).Get());
+	m_request->missing.clear();
+
+	m_searchJob = Pi::GetAsyncJobQueue()->Queue(new SearchJob(this, m_graph, *m_request));
+}
+
+void RoutePlanner::OnSearchFinished(bool found, const std::vector<SystemPath> &route)
+{
+	// the callback may well plan the next route
+	std::unique_ptr<Request> request = std::move(m_request);
+	request->callback(found, route);
+}
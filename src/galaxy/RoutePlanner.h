@@ -0,0 +1,71 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _ROUTEPLANNER_H
+#define _ROUTEPLANNER_H
+
+#include "JobQueue.h"
+#include "RefCounted.h"
+#include "galaxy/GalaxyCache.h"
+#include "galaxy/JumpGraph.h"
+#include "galaxy/SystemPath.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class Galaxy;
+
+// Plans multi-jump hyperspace routes without blocking the main thread. The
+// sectors along the way are generated by cache jobs, copied into a jump
+// graph and the route is searched for by a job; the callback is called on
+// the main thread once it has been found, or not.
+//
+// The graph is kept for the next route as long as the jump range stays the
+// same, so replanning around the same area doesn't need any sectors.
+class RoutePlanner {
+public:
+	// found is false if there is no route; route holds the systems after
+	// start, ending with target
+	typedef std::function<void(bool found, const std::vector<SystemPath> &route)> RouteCallback;
+
+	explicit RoutePlanner(RefCountedPtr<Galaxy> galaxy);
+	~RoutePlanner();
+
+	// Replaces the route still being planned, if any; its callback is not called
+	void PlanRoute(const SystemPath &start, const SystemPath &target, const JumpCost &cost, RouteCallback callback);
+	// The same, but generating the sectors and searching on the calling
+	// thread; returns found and fills route as the callback would be
+	bool FindRoute(const SystemPath &start, const SystemPath &target, const JumpCost &cost, std::vector<SystemPath> &route);
+	void Cancel();
+	bool IsPlanning() const { return bool(m_request); }
+
+private:
+	class SearchJob;
+	struct Request {
+		SystemPath start;
+		SystemPath target;
+		JumpCost cost;
+		RouteCallback callback;
+		// sectors still to be added to the graph
+		std::vector<SystemPath> missing;
+	};
+
+	// cancel the route being planned and make sure there is a graph for the
+	// range that no search job is using
+	void PrepareGraph(float range);
+	// the sectors the graph will need for a route that it hasn't got yet
+	std::vector<SystemPath> FindMissingSectors(const SystemPath &start, const SystemPath &target) const;
+	void OnSectorsFilled();
+	void StartSearch();
+	void OnSearchFinished(bool found, const std::vector<SystemPath> &route);
+
+	RefCountedPtr<Galaxy> m_galaxy;
+	std::unique_ptr<Request> m_request;
+	std::shared_ptr<JumpGraph> m_graph;
+	Job::Handle m_searchJob;
+	// destroyed first, so no cache job calls back into a deleted planner
+	RefCountedPtr<SectorCache::Slave> m_sectorCache;
+};
+
+#endif /* _ROUTEPLANNER_H */
@@ -11,6 +11,7 @@
 
 #include "core/StringUtils.h"
 #include "profiler/Profiler.h"
+#include "scenegraph/Serializer.h"
 
 const float Sector::SIZE = 8.f;
 
@@ -111,6 +112,105 @@ void Sector::Dump(FILE *file, const char *indent) const
 	fprintf(file, "}\n\n");
 }
 
+size_t Sector::GetMemoryUsage() const
+{
+	return sizeof(Sector) + m_systems.capacity() * sizeof(System) + m_strings.capacity();
+}
+
+Uint32 Sector::AddPooledString(const std::string &str)
+{
+	const Uint32 offset = Uint32(m_strings.size());
+	m_strings.append(str.c_str(), str.size() + 1);
+	return offset;
+}
+
+void Sector::SaveToCache(Serializer::Writer &wr) const
+{
+	wr.Int32(m_systems.size());
+	for (const Sector::System &sys : m_systems) {
+		wr.String(sys.GetName());
+		const std::vector<std::string> otherNames = sys.GetOtherNames();
+		wr.Int32(otherNames.size());
+		for (const std::string &name : otherNames)
+			wr.String(name);
+		wr.Vector3f(sys.m_pos);
+		wr.Int32(sys.m_numStars);
+		for (unsigned i = 0; i < sys.m_numStars; i++)
+			wr.Int32(sys.m_starType[i]);
+		wr.Int32(sys.m_seed);
+		wr.Bool(sys.m_customSys != nullptr);
+		wr.Int64(sys.m_population.v);
+		wr.Int32(sys.m_explored);
+		wr.Double(sys.m_exploredTime);
+	}
+}
+
+void Sector::LoadFromCache(Serializer::Reader &rd)
+{
+	// generous limit, only there to reject garbage before allocating for it
+	static const Uint32 MAX_COUNT = 65536;
+	static const Uint32 MAX_OTHER_NAMES = 255;
+
+	const std::vector<const CustomSystem *> &customSystems = m_galaxy->GetCustomSystems()->GetCustomSystemsForSector(sx, sy, sz);
+	const Uint32 numSystems = rd.Int32();
+	if (numSystems > MAX_COUNT)
+		throw std::out_of_range("Sector::LoadFromCache: invalid number of systems");
+
+	m_systems.reserve(numSystems);
+	for (Uint32 idx = 0; idx < numSystems; idx++) {
+		Sector::System sys(this, sx, sy, sz, idx);
+		sys.SetName(rd.String());
+		const Uint32 numNames = rd.Int32();
+		if (numNames > MAX_OTHER_NAMES)
+			throw std::out_of_range("Sector::LoadFromCache: invalid number of names");
+		std::vector<std::string> otherNames(numNames);
+		for (std::string &name : otherNames)
+			name = rd.String();
+		sys.SetOtherNames(otherNames);
+		sys.m_pos = rd.Vector3f();
+		sys.m_numStars = rd.Int32();
+		if (sys.m_numStars > std::size(sys.m_starType))
+			throw std::out_of_range("Sector::LoadFromCache: invalid number of stars");
+		for (unsigned i = 0; i < sys.m_numStars; i++)
+			sys.m_starType[i] = SystemBody::BodyType(rd.Int32());
+		sys.m_seed = rd.Int32();
+		if (rd.Bool()) {
+			// custom systems come first, in the order of the database
+			if (idx >= customSystems.size())
+				throw std::out_of_range("Sector::LoadFromCache: missing custom system");
+			sys.m_customSys = customSystems[idx];
+		}
+		sys.m_population.v = rd.Int64();
+		sys.m_explored = StarSystem::ExplorationState(rd.Int32());
+		sys.m_exploredTime = rd.Double();
+		m_systems.push_back(sys);
+	}
+}
+
+std::vector<std::string> Sector::System::GetOtherNames() const
+{
+	std::vector<std::string> names;
+	names.reserve(m_numOtherNames);
+	Uint32 offset = m_otherNames;
+	for (unsigned i = 0; i < m_numOtherNames; i++) {
+		names.push_back(m_sector->GetPooledString(offset));
+		offset += names.back().size() + 1;
+	}
+	return names;
+}
+
+void Sector::System::SetOtherNames(const std::vector<std::string> &names)
+{
+	assert(names.size() <= 255);
+	m_numOtherNames = Uint8(names.size());
+	m_otherNames = 0;
+	for (size_t i = 0; i < m_numOtherNames; i++) {
+		const Uint32 offset = m_sector->AddPooledString(names[i]);
+		if (!i)
+			m_otherNames = offset;
+	}
+}
+
 float Sector::System::DistanceBetween(const System *a, const System *b)
 {
 	vector3f dv = a->GetPosition() - b->GetPosition();
@@ -120,6 +220,20 @@ float Sector::System::DistanceBetween(const System *a, const System *b)
 
 void Sector::System::AssignFaction() const
 {
-	assert(m_sector->m_galaxy->GetFactions()->MayAssignFactions());
-	m_faction = m_sector->m_galaxy->GetFactions()->GetNearestClaimant(this);
+	m_sector->AssignFactions();
+}
+
+void Sector::AssignFactions() const
+{
+	PROFILE_SCOPED()
+	FactionsDatabase *factions = m_galaxy->GetFactions();
+	assert(factions->MayAssignFactions());
+
+	// all systems of a sector can be claimed by the same factions, so only
+	// look them up once
+	std::vector<const Faction *> candidates;
+	factions->GetCandidateFactions(GetPath(), candidates);
+	for (const System &sys : m_systems)
+		if (!sys.m_faction)
+			sys.m_faction = factions->GetNearestClaimant(&sys, candidates);
 }
@@ -17,6 +17,11 @@
 class Faction;
 class Galaxy;
 
+namespace Serializer {
+	class Reader;
+	class Writer;
+} // namespace Serializer
+
 class Sector : public RefCounted {
 	friend class GalaxyObjectCache<Sector, SystemPath::LessSectorOnly>;
 	friend class GalaxyGenerator;
@@ -36,6 +41,9 @@ public:
 	// get the SystemPath for this sector
 	SystemPath GetPath() const { return SystemPath(sx, sy, sz); }
 
+	// sectors are always generated in full
+	GalaxyDetail GetDetail() const { return GalaxyDetail::FULL; }
+
 	class System {
 	public:
 		System(Sector *sector, int x, int y, int z, Uint32 si) :
@@ -44,27 +52,32 @@ public:
 			sz(z),
 			idx(si),
 			m_sector(sector),
-			m_numStars(0),
-			m_seed(0),
 			m_customSys(nullptr),
 			m_faction(nullptr),
 			m_population(-1),
+			m_exploredTime(0.0),
+			m_seed(0),
+			m_name(0),
+			m_otherNames(0),
+			m_numOtherNames(0),
+			m_numStars(0),
 			m_explored(StarSystem::eUNEXPLORED),
-			m_exploredTime(0.0) {}
+			m_starType{} {}
 
 		static float DistanceBetween(const System *a, const System *b);
 
 		// Check that we've had our habitation status set
 
-		const std::string &GetName() const { return m_name; }
-		const std::vector<std::string> &GetOtherNames() const { return m_other_names; }
+		// the names are kept in the string pool of the sector
+		std::string GetName() const { return m_sector->GetPooledString(m_name); }
+		std::vector<std::string> GetOtherNames() const;
 		const vector3f &GetPosition() const { return m_pos; }
 		vector3f GetFullPosition() const { return Sector::SIZE * vector3f(float(sx), float(sy), float(sz)) + m_pos; };
 		unsigned GetNumStars() const { return m_numStars; }
 		SystemBody::BodyType GetStarType(unsigned i) const
 		{
 			assert(i < m_numStars);
-			return m_starType[i];
+			return SystemBody::BodyType(m_starType[i]);
 		}
 		Uint32 GetSeed() const { return m_seed; }
 		const CustomSystem *GetCustomSystem() const { return m_customSys; }
@@ -75,7 +88,7 @@ public:
 		}
 		fixed GetPopulation() const { return m_population; }
 		void SetPopulation(fixed pop) { m_population = pop; }
-		StarSystem::ExplorationState GetExplored() const { return m_explored; }
+		StarSystem::ExplorationState GetExplored() const { return StarSystem::ExplorationState(m_explored); }
 		double GetExploredTime() const { return m_exploredTime; }
 		bool IsExplored() const { return m_explored != StarSystem::eUNEXPLORED; }
 		void SetExplored(StarSystem::ExplorationState e, double time);
@@ -100,33 +113,54 @@ public:
 		friend class SectorPersistenceGenerator;
 
 		void AssignFaction() const;
+		void SetName(const std::string &name) { m_name = m_sector->AddPooledString(name); }
+		void SetOtherNames(const std::vector<std::string> &names);
 
+		// ordered by size, there are a lot of these in the sector caches
 		Sector *m_sector;
-		std::string m_name;
-		std::vector<std::string> m_other_names;
-		vector3f m_pos;
-		unsigned m_numStars;
-		SystemBody::BodyType m_starType[4];
-		Uint32 m_seed;
 		const CustomSystem *m_customSys;
 		mutable const Faction *m_faction; // mutable because we only calculate on demand
 		fixed m_population;
-		StarSystem::ExplorationState m_explored;
 		double m_exploredTime;
+		vector3f m_pos;
+		Uint32 m_seed;
+		// offsets into the string pool of the sector; the other names follow
+		// each other
+		Uint32 m_name;
+		Uint32 m_otherNames;
+		Uint8 m_numOtherNames;
+		Uint8 m_numStars;
+		Uint8 m_explored; // StarSystem::ExplorationState
+		Uint8 m_starType[4]; // SystemBody::BodyType
 	};
 	std::vector<System> m_systems;
 	const int sx, sy, sz;
 
 	void Dump(FILE *file, const char *indent = "") const;
 
+	// Rough estimate of the heap memory used by this sector, in bytes
+	size_t GetMemoryUsage() const;
+
+	// Binary copy of the systems as generated, for GalaxyDiskCache. Custom
+	// systems are stored by their index in the sector's custom systems.
+	void SaveToCache(Serializer::Writer &wr) const;
+	void LoadFromCache(Serializer::Reader &rd);
+
 	sigc::signal<void, Sector::System *, StarSystem::ExplorationState, double> onSetExplorationState;
 
 private:
 	Sector(const Sector &); // non-copyable
 	Sector &operator=(const Sector &); // non-assignable
 
+	// Strings one after the other, each with its null terminator. Returns
+	// the offset of the string added.
+	Uint32 AddPooledString(const std::string &str);
+	std::string GetPooledString(Uint32 offset) const { return std::string(m_strings.c_str() + offset); }
+
 	RefCountedPtr<Galaxy> m_galaxy;
 	SectorCache *m_cache;
+	// the names of the systems
+	std::string m_strings;
 
 	// Only SectorCache(Job) are allowed to create sectors
 	Sector(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, SectorCache *cache);
@@ -136,6 +170,7 @@ private:
 		m_cache = cache;
 	}
 	// sets appropriate factions for all systems in the sector
+	void AssignFactions() const;
 };
 
 #endif /* _SECTOR_H */
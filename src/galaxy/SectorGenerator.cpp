@@ -34,8 +34,8 @@ bool SectorCustomSystemsGenerator::Apply(Random &rng, RefCountedPtr<Galaxy> gala
 		const CustomSystem *cs = *it;
 		Sector::System s(sector.Get(), sx, sy, sz, sysIdx);
 		s.m_pos = cs->pos;
-		s.m_name = cs->name;
-		s.m_other_names = cs->other_names;
+		s.SetName(cs->name);
+		s.SetOtherNames(cs->other_names);
 		for (s.m_numStars = 0; s.m_numStars < cs->numStars; s.m_numStars++) {
 			if (cs->primaryType[s.m_numStars] == 0) break;
 			s.m_starType[s.m_numStars] = cs->primaryType[s.m_numStars];
@@ -319,8 +319,8 @@ bool SectorRandomSystemsGenerator::Apply(Random &rng, RefCountedPtr<Galaxy> gala
 			//Output("%d: %d%\n", sx, sy);
 		}
 
-		s.m_name = GenName(galaxy, *sector, s, customCount + i, rng);
-		//Output("%s: \n", s.m_name.c_str());
+		s.SetName(GenName(galaxy, *sector, s, customCount + i, rng));
+		//Output("%s: \n", s.GetName().c_str());
 
 		s.m_seed = rng.Int32();
 
@@ -4,6 +4,7 @@
 #include "StarSystem.h"
 
 #include "Galaxy.h"
+#include "GalaxyGenerator.h"
 #include "JsonUtils.h"
 #include "Sector.h"
 
@@ -17,6 +18,7 @@
 #include "lua/LuaEvent.h"
 #include "core/StringUtils.h"
 #include "profiler/Profiler.h"
+#include "scenegraph/Serializer.h"
 
 #include <SDL_stdinc.h>
 #include <algorithm>
@@ -201,6 +203,7 @@ const float StarSystem::starScale[] = {
 SystemBody *StarSystem::GetBodyByPath(const SystemPath &path) const
 {
 	PROFILE_SCOPED()
+	Expand();
 	assert(m_path.IsSameSystem(path));
 	assert(path.IsBodyPath());
 	assert(path.bodyIndex < m_bodies.size());
@@ -232,13 +235,266 @@ StarSystem::StarSystem(const SystemPath &path, RefCountedPtr<Galaxy> galaxy, Sta
 	m_pos(0.0),
 	m_tradeLevel(GalacticEconomy::Commodities().size() + 1, 0),
 	m_commodityLegal(GalacticEconomy::Commodities().size() + 1, true),
-	m_cache(cache)
+	m_isCompact(false),
+	m_cache(cache),
+	m_detail(GalaxyDetail::FULL)
 {
 }
 
 StarSystem::GeneratorAPI::GeneratorAPI(const SystemPath &path, RefCountedPtr<Galaxy> galaxy, StarSystemCache *cache, Random &rand) :
 	StarSystem(path, galaxy, cache, rand) {}
 
+size_t StarSystem::GetMemoryUsage() const
+{
+	size_t size = sizeof(StarSystem) + m_name.capacity() + m_shortDesc.capacity() + m_longDesc.capacity() +
+		m_other_names.capacity() * sizeof(std::string) + m_tradeLevel.capacity() * sizeof(int) + m_commodityLegal.capacity() / 8 +
+		m_bodies.capacity() * sizeof(RefCountedPtr<SystemBody>) + (m_spaceStations.capacity() + m_stars.capacity()) * sizeof(SystemBody *);
+	for (const std::string &name : m_other_names)
+		size += name.capacity();
+
+	std::lock_guard<std::mutex> lock(m_bodyLock);
+	for (const RefCountedPtr<SystemBody> &body : m_bodies)
+		size += body->GetMemoryUsage();
+	if (m_bodyTable) {
+		const BodyTable &table = *m_bodyTable;
+		size += sizeof(BodyTable) + table.bodies.capacity() * sizeof(BodyInfo) +
+			(table.children.capacity() + table.stars.capacity() + table.stations.capacity()) * sizeof(Uint16) +
+			table.names.capacity() + table.compact.capacity();
+	}
+	return size;
+}
+
+void StarSystem::MakeBodyTable() const
+{
+	if (m_bodyTable)
+		return;
+
+	PROFILE_SCOPED()
+	std::unique_ptr<BodyTable> table(new BodyTable);
+	table->bodies.reserve(m_bodies.size());
+	for (const RefCountedPtr<SystemBody> &body : m_bodies) {
+		BodyInfo info;
+		info.type = Uint8(body->GetType());
+		info.parent = body->GetParent() ? Uint16(body->GetParent()->GetPath().bodyIndex) : NO_PARENT;
+		info.firstChild = Uint16(table->children.size());
+		info.numChildren = Uint16(body->GetNumChildren());
+		for (const SystemBody *child : body->GetChildren())
+			table->children.push_back(Uint16(child->GetPath().bodyIndex));
+		info.name = Uint32(table->names.size());
+		table->names.append(body->GetName().c_str(), body->GetName().size() + 1);
+		info.mass = float(body->GetMassAsFixed().ToDouble());
+		info.radius = float(body->GetRadiusAsFixed().ToDouble());
+		info.semiMajorAxis = float(body->GetSemiMajorAxis());
+		info.eccentricity = float(body->GetEccentricity());
+		info.population = float(body->GetPopulation());
+		table->bodies.push_back(info);
+	}
+	for (const SystemBody *star : m_stars)
+		table->stars.push_back(Uint16(star->GetPath().bodyIndex));
+	for (const SystemBody *station : m_spaceStations)
+		table->stations.push_back(Uint16(station->GetPath().bodyIndex));
+	m_bodyTable = std::move(table);
+}
+
+const std::vector<StarSystem::BodyInfo> &StarSystem::GetBodyInfos() const
+{
+	std::lock_guard<std::mutex> lock(m_bodyLock);
+	MakeBodyTable();
+	return m_bodyTable->bodies;
+}
+
+const Uint16 *StarSystem::GetBodyChildren(const BodyInfo &body) const
+{
+	GetBodyInfos();
+	return m_bodyTable->children.data() + body.firstChild;
+}
+
+const char *StarSystem::GetBodyName(const BodyInfo &body) const
+{
+	GetBodyInfos();
+	return m_bodyTable->names.c_str() + body.name;
+}
+
+const std::vector<Uint16> &StarSystem::GetStarIndices() const
+{
+	GetBodyInfos();
+	return m_bodyTable->stars;
+}
+
+const std::vector<Uint16> &StarSystem::GetStationIndices() const
+{
+	GetBodyInfos();
+	return m_bodyTable->stations;
+}
+
+bool StarSystem::Compact()
+{
+	PROFILE_SCOPED()
+	std::lock_guard<std::mutex> lock(m_bodyLock);
+	if (IsCompact())
+		return true;
+	// body indices have to fit the table, and (BODIES) systems still to be
+	// completed need their bodies
+	if (m_generationState || m_bodies.empty() || m_bodies.size() >= NO_PARENT)
+		return false;
+	for (const RefCountedPtr<SystemBody> &body : m_bodies) {
+		if (body->GetRefCount() != (body == m_rootBody ? 2 : 1))
+			return false;
+	}
+
+	MakeBodyTable();
+	Serializer::Writer wr;
+	SaveBodies(wr);
+	m_bodyTable->compact = wr.GetData();
+
+	m_rootBody.Reset();
+	std::vector<RefCountedPtr<SystemBody>>().swap(m_bodies);
+	std::vector<SystemBody *>().swap(m_spaceStations);
+	std::vector<SystemBody *>().swap(m_stars);
+	m_isCompact.store(true, std::memory_order_release);
+	return true;
+}
+
+void StarSystem::ExpandCompact()
+{
+	PROFILE_SCOPED()
+	std::lock_guard<std::mutex> lock(m_bodyLock);
+	// another thread may have got here first
+	if (!IsCompact())
+		return;
+
+	std::string data;
+	data.swap(m_bodyTable->compact);
+	Serializer::Reader rd(ByteRange(data.data(), data.size()));
+	LoadBodies(rd);
+	m_isCompact.store(false, std::memory_order_release);
+}
+
+static const Uint32 NO_BODY = ~0u;
+
+void StarSystem::GeneratorAPI::SaveToCache(Serializer::Writer &wr) const
+{
+	wr.Vector3f(m_pos);
+	wr.Int32(m_numStars);
+	wr.String(m_name);
+	wr.Int32(m_other_names.size());
+	for (const std::string &name : m_other_names)
+		wr.String(name);
+	wr.String(m_longDesc);
+	wr.Int32(m_polit.govType);
+	wr.Int64(m_polit.lawlessness.v);
+	wr.Bool(m_isCustom);
+	wr.Bool(m_hasCustomBodies);
+	wr.Int64(m_metallicity.v);
+	wr.Int64(m_industrial.v);
+	wr.Int32(m_econType);
+	wr.Int32(m_seed);
+	wr.Int64(m_agricultural.v);
+	wr.Int64(m_humanProx.v);
+	wr.Int64(m_totalPop.v);
+
+	wr.Int32(m_tradeLevel.size());
+	for (int level : m_tradeLevel)
+		wr.Int32(level);
+	for (bool legal : m_commodityLegal)
+		wr.Bool(legal);
+
+	SaveBodies(wr);
+}
+
+void StarSystem::SaveBodies(Serializer::Writer &wr) const
+{
+	wr.Int32(m_bodies.size());
+	for (const RefCountedPtr<SystemBody> &body : m_bodies)
+		body->SaveToCache(wr);
+	wr.Int32(m_rootBody ? m_rootBody->GetPath().bodyIndex : NO_BODY);
+	wr.Int32(m_spaceStations.size());
+	for (const SystemBody *station : m_spaceStations)
+		wr.Int32(station->GetPath().bodyIndex);
+	wr.Int32(m_stars.size());
+	for (const SystemBody *star : m_stars)
+		wr.Int32(star->GetPath().bodyIndex);
+}
+
+// generous limits, only there to reject garbage before allocating for it
+static const size_t MAX_NAMES = 256;
+static const size_t MAX_BODIES = 65536;
+
+static Uint32 read_count(Serializer::Reader &rd, size_t max)
+{
+	const Uint32 count = rd.Int32();
+	if (count > max)
+		throw std::out_of_range("StarSystem::LoadFromCache: invalid count");
+	return count;
+}
+
+void StarSystem::GeneratorAPI::LoadFromCache(Serializer::Reader &rd)
+{
+
+	m_pos = rd.Vector3f();
+	m_numStars = rd.Int32();
+	m_name = rd.String();
+	m_other_names.resize(read_count(rd, MAX_NAMES));
+	for (std::string &name : m_other_names)
+		name = rd.String();
+	m_longDesc = rd.String();
+	m_polit.govType = Polit::GovType(rd.Int32());
+	m_polit.lawlessness.v = rd.Int64();
+	m_isCustom = rd.Bool();
+	m_hasCustomBodies = rd.Bool();
+	m_metallicity.v = rd.Int64();
+	m_industrial.v = rd.Int64();
+	m_econType = rd.Int32();
+	m_seed = rd.Int32();
+	m_agricultural.v = rd.Int64();
+	m_humanProx.v = rd.Int64();
+	m_totalPop.v = rd.Int64();
+
+	// the commodities come from the game data, which is part of the key,
+	// but check anyway rather than index out of bounds later
+	if (rd.Int32() != m_tradeLevel.size())
+		throw std::out_of_range("StarSystem::LoadFromCache: commodity count mismatch");
+	for (int &level : m_tradeLevel)
+		level = rd.Int32();
+	for (size_t i = 0; i < m_commodityLegal.size(); i++)
+		m_commodityLegal[i] = rd.Bool();
+
+	LoadBodies(rd);
+}
+
+void StarSystem::LoadBodies(Serializer::Reader &rd)
+{
+	auto readBody = [&]() {
+		const Uint32 idx = rd.Int32();
+		if (idx == NO_BODY)
+			return static_cast<SystemBody *>(nullptr);
+		if (idx >= m_bodies.size())
+			throw std::out_of_range("StarSystem::LoadFromCache: invalid body index");
+		return m_bodies[idx].Get();
+	};
+
+	// create all bodies first, so they can refer to each other
+	const Uint32 numBodies = read_count(rd, MAX_BODIES);
+	for (Uint32 i = 0; i < numBodies; i++)
+		NewBody();
+	for (const RefCountedPtr<SystemBody> &body : m_bodies)
+		body->LoadFromCache(rd, m_bodies);
+
+	m_rootBody.Reset(readBody());
+	m_spaceStations.resize(read_count(rd, numBodies));
+	for (SystemBody *&station : m_spaceStations) {
+		station = readBody();
+		if (!station)
+			throw std::out_of_range("StarSystem::LoadFromCache: missing station");
+	}
+	m_stars.resize(read_count(rd, numBodies));
+	for (SystemBody *&star : m_stars) {
+		star = readBody();
+		if (!star)
+			throw std::out_of_range("StarSystem::LoadFromCache: missing star");
+	}
+}
+
 #ifdef DEBUG_DUMP
 struct thing_t {
 	SystemBody *obj;
@@ -310,17 +566,17 @@ void StarSystem::MakeShortDescription()
 	else if (GetTotalPop() == 0) {
 		SetShortDesc(Lang::SMALL_SCALE_PROSPECTING_NO_SETTLEMENTS);
 	} else if (GetTotalPop() < fixed(1, 10)) {
-		SetShortDesc(Lang::GetCore().Get(
-			GalacticEconomy::GetEconomyById(GetEconType()).l10n_key.small));
+		SetShortDesc(std::string(Lang::GetCore().Get(
+			GalacticEconomy::GetEconomyById(GetEconType()).l10n_key.small)));
 	} else if (GetTotalPop() < fixed(1, 2)) {
-		SetShortDesc(Lang::GetCore().Get(
-			GalacticEconomy::GetEconomyById(GetEconType()).l10n_key.medium));
+		SetShortDesc(std::string(Lang::GetCore().Get(
+			GalacticEconomy::GetEconomyById(GetEconType()).l10n_key.medium)));
 	} else if (GetTotalPop() < fixed(5, 1)) {
-		SetShortDesc(Lang::GetCore().Get(
-			GalacticEconomy::GetEconomyById(GetEconType()).l10n_key.large));
+		SetShortDesc(std::string(Lang::GetCore().Get(
+			GalacticEconomy::GetEconomyById(GetEconType()).l10n_key.large)));
 	} else {
-		SetShortDesc(Lang::GetCore().Get(
-			GalacticEconomy::GetEconomyById(GetEconType()).l10n_key.huge));
+		SetShortDesc(std::string(Lang::GetCore().Get(
+			GalacticEconomy::GetEconomyById(GetEconType()).l10n_key.huge)));
 	}
 }
 
@@ -342,7 +598,8 @@ StarSystem::~StarSystem()
 	PROFILE_SCOPED()
 	// clear parent and children pointers. someone (Lua) might still have a
 	// reference to things that are about to be deleted
-	m_rootBody->Orphan();
+	if (m_rootBody)
+		m_rootBody->Orphan();
 	if (m_cache)
 		m_cache->RemoveFromAttic(m_path);
 }
@@ -494,6 +751,7 @@ void StarSystem::ExportToLua(const char *filename)
 	if (f == 0)
 		return;
 
+	Expand();
 	fprintf(f, "-- Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details\n");
 	fprintf(f, "-- Licensed under the terms of the GPL v3. See licenses/GPL-3.txt\n\n");
 
@@ -523,6 +781,7 @@ void StarSystem::ExportToLua(const char *filename)
 
 void StarSystem::Dump(FILE *file, const char *indent, bool suppressSectorData) const
 {
+	Expand();
 	if (suppressSectorData) {
 		fprintf(file, "%sStarSystem {%s\n", indent, m_hasCustomBodies ? " CUSTOM-ONLY" : m_isCustom ? " CUSTOM" : "");
 	} else {
@@ -562,6 +821,7 @@ void StarSystem::Dump(FILE *file, const char *indent, bool suppressSectorData) c
 
 void StarSystem::DumpToJson(Json &obj)
 {
+	Expand();
 	obj["name"] = m_name;
 
 	if (!m_other_names.empty())  {
@@ -14,14 +14,23 @@
 #include "gameconsts.h"
 
 #include <SDL_stdinc.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+struct StarSystemGenerationState;
 class Faction;
 class Galaxy;
 class CustomSystemBody;
 class CustomSystem;
 
+namespace Serializer {
+	class Reader;
+	class Writer;
+} // namespace Serializer
+
 // doubles - all masses in Kg, all lengths in meters
 // fixed - any mad scheme
 
@@ -29,6 +38,7 @@ class StarSystem : public RefCounted {
 public:
 	friend class SystemBody;
 	friend class GalaxyObjectCache<StarSystem, SystemPath::LessSystemOnly>;
+	friend class GalaxyGenerator;
 	class GeneratorAPI; // Complete definition below
 	class EditorAPI; // Defined in editor module
 
@@ -38,6 +48,8 @@ public:
 		eEXPLORED_AT_START = 2
 	};
 
+	GalaxyDetail GetDetail() const { return m_detail; }
+
 	void ExportToLua(const char *filename);
 
 	const std::string &GetName() const { return m_name; }
@@ -49,6 +61,43 @@ public:
 	const SystemPath &GetPath() const { return m_path; }
 	const vector3f &GetPosition() const { return m_pos; }
 
+	// The hot fields of a body, for queries over many systems that don't
+	// need the SystemBody objects themselves (see Compact())
+	struct BodyInfo {
+		Uint8 type; // SystemBody::BodyType
+		Uint16 parent; // NO_PARENT for the root body
+		Uint16 firstChild; // into GetBodyChildren()
+		Uint16 numChildren;
+		Uint32 name; // into GetBodyName()
+		float mass; // as SystemBody::GetMassAsFixed()
+		float radius; // as SystemBody::GetRadiusAsFixed()
+		float semiMajorAxis; // in AU
+		float eccentricity;
+		float population;
+
+		SystemBodyType::BodyType GetType() const { return SystemBodyType::BodyType(type); }
+	};
+	static const Uint16 NO_PARENT = 0xffff;
+
+	// Indexed like GetBodies(). The table is made from the bodies the first
+	// time it is needed and isn't updated when they change afterwards.
+	const std::vector<BodyInfo> &GetBodyInfos() const;
+	// The body indices of the children of body, numChildren of them
+	const Uint16 *GetBodyChildren(const BodyInfo &body) const;
+	const char *GetBodyName(const BodyInfo &body) const;
+	// The body indices of GetStars() and GetSpaceStations()
+	const std::vector<Uint16> &GetStarIndices() const;
+	const std::vector<Uint16> &GetStationIndices() const;
+	SystemPath GetBodyPath(Uint32 bodyIndex) const { return SystemPath(m_path.sectorX, m_path.sectorY, m_path.sectorZ, m_path.systemIndex, bodyIndex); }
+
+	// Keep only the table of hot fields and a binary copy of the bodies,
+	// for systems loaded in bulk that may never be looked at closely. The
+	// SystemBody objects are made again the first time anything asks for
+	// them. Fails if the system isn't generated in full or something
+	// holds on to its bodies.
+	bool Compact();
+	bool IsCompact() const { return m_isCompact.load(std::memory_order_acquire); }
+
 	const std::string &GetShortDescription() const { return m_shortDesc; }
 	const std::string &GetLongDescription() const { return m_longDesc; }
 	unsigned GetNumStars() const { return m_numStars; }
@@ -59,24 +108,56 @@ public:
 	static const double starLuminosities[];
 	static const float starScale[];
 
-	RefCountedPtr<const SystemBody> GetRootBody() const { return m_rootBody; }
-	RefCountedPtr<SystemBody> GetRootBody() { return m_rootBody; }
-	bool HasSpaceStations() const { return !m_spaceStations.empty(); }
-	Uint32 GetNumSpaceStations() const { return static_cast<Uint32>(m_spaceStations.size()); }
-	IterationProxy<std::vector<SystemBody *>> GetSpaceStations() { return MakeIterationProxy(m_spaceStations); }
-	const IterationProxy<const std::vector<SystemBody *>> GetSpaceStations() const { return MakeIterationProxy(m_spaceStations); }
-	IterationProxy<std::vector<SystemBody *>> GetStars() { return MakeIterationProxy(m_stars); }
-	const IterationProxy<const std::vector<SystemBody *>> GetStars() const { return MakeIterationProxy(m_stars); }
-	Uint32 GetNumBodies() const { return static_cast<Uint32>(m_bodies.size()); }
-	IterationProxy<std::vector<RefCountedPtr<SystemBody>>> GetBodies() { return MakeIterationProxy(m_bodies); }
-	const IterationProxy<const std::vector<RefCountedPtr<SystemBody>>> GetBodies() const { return MakeIterationProxy(m_bodies); }
+	RefCountedPtr<const SystemBody> GetRootBody() const
+	{
+		Expand();
+		return m_rootBody;
+	}
+	RefCountedPtr<SystemBody> GetRootBody()
+	{
+		Expand();
+		return m_rootBody;
+	}
+	bool HasSpaceStations() const { return GetNumSpaceStations() != 0; }
+	Uint32 GetNumSpaceStations() const { return static_cast<Uint32>(IsCompact() ? m_bodyTable->stations.size() : m_spaceStations.size()); }
+	IterationProxy<std::vector<SystemBody *>> GetSpaceStations()
+	{
+		Expand();
+		return MakeIterationProxy(m_spaceStations);
+	}
+	const IterationProxy<const std::vector<SystemBody *>> GetSpaceStations() const
+	{
+		Expand();
+		return MakeIterationProxy(m_spaceStations);
+	}
+	IterationProxy<std::vector<SystemBody *>> GetStars()
+	{
+		Expand();
+		return MakeIterationProxy(m_stars);
+	}
+	const IterationProxy<const std::vector<SystemBody *>> GetStars() const
+	{
+		Expand();
+		return MakeIterationProxy(m_stars);
+	}
+	Uint32 GetNumBodies() const { return static_cast<Uint32>(IsCompact() ? m_bodyTable->bodies.size() : m_bodies.size()); }
+	IterationProxy<std::vector<RefCountedPtr<SystemBody>>> GetBodies()
+	{
+		Expand();
+		return MakeIterationProxy(m_bodies);
+	}
+	const IterationProxy<const std::vector<RefCountedPtr<SystemBody>>> GetBodies() const
+	{
+		Expand();
+		return MakeIterationProxy(m_bodies);
+	}
 
-	bool IsCommodityLegal(const GalacticEconomy::CommodityId t)
+	bool IsCommodityLegal(const GalacticEconomy::CommodityId t) const
 	{
 		return m_commodityLegal[t];
 	}
 
-	int GetCommodityBasePriceModPercent(GalacticEconomy::CommodityId t)
+	int GetCommodityBasePriceModPercent(GalacticEconomy::CommodityId t) const
 	{
 		return m_tradeLevel[t];
 	}
@@ -97,6 +178,9 @@ public:
 
 	void Dump(FILE *file, const char *indent = "", bool suppressSectorData = false) const;
 
+	// Rough estimate of the heap memory used by this system and its bodies, in bytes
+	size_t GetMemoryUsage() const;
+
 	// Dump all information about this system to JSON format suitable for
 	// loading as a custom system
 	void DumpToJson(Json &obj);
@@ -127,6 +211,21 @@ private:
 	std::string ExportBodyToLua(FILE *f, SystemBody *body);
 	std::string GetStarTypes(SystemBody *body);
 
+	// The bodies, the root body, the stations and the stars, for the disk
+	// cache and for compact systems
+	void SaveBodies(Serializer::Writer &wr) const;
+	void LoadBodies(Serializer::Reader &rd);
+
+	// Make the bodies of a compact system again
+	void Expand() const
+	{
+		if (IsCompact())
+			const_cast<StarSystem *>(this)->ExpandCompact();
+	}
+	void ExpandCompact();
+	// with m_bodyLock held
+	void MakeBodyTable() const;
+
 	SystemPath m_path;
 	vector3f m_pos;
 	unsigned m_numStars;
@@ -160,7 +259,24 @@ private:
 	std::vector<SystemBody *> m_stars;
 	std::vector<bool> m_commodityLegal;
 
+	struct BodyTable {
+		std::vector<BodyInfo> bodies;
+		std::vector<Uint16> children;
+		std::vector<Uint16> stars;
+		std::vector<Uint16> stations;
+		std::string names;
+		// the SaveBodies() of a compact system
+		std::string compact;
+	};
+	mutable std::unique_ptr<BodyTable> m_bodyTable;
+	mutable std::mutex m_bodyLock;
+	std::atomic<bool> m_isCompact;
+
 	StarSystemCache *m_cache;
+
+	GalaxyDetail m_detail;
+	// kept by GalaxyGenerator until the system has been generated in full
+	std::unique_ptr<StarSystemGenerationState> m_generationState;
 };
 
 class StarSystem::GeneratorAPI : public StarSystem {
@@ -218,6 +334,13 @@ public:
 	using StarSystem::MakeShortDescription;
 	using StarSystem::NewBody;
 	using StarSystem::SetShortDesc;
+
+	// Binary copy of everything the cacheable generator stages set, for
+	// GalaxyDiskCache. The faction, exploration state and short description
+	// depend on the game and the language, so they are not stored; the
+	// caller sets them up again after loading.
+	void SaveToCache(Serializer::Writer &wr) const;
+	void LoadFromCache(Serializer::Reader &rd);
 };
 
 #endif /* _STARSYSTEM_H */
@@ -1531,7 +1531,7 @@ void PopulateStarSystemGenerator::PopulateStage1(SystemBody *sbody, StarSystem::
 
 		affinity *= rand.Fixed();
 
-		if (GalacticEconomy::Consumables().count(commodity.id)) {
+		if (GalacticEconomy::IsConsumable(commodity.id)) {
 			affinity *= 2;
 		}
 
@@ -66,6 +66,7 @@ private:
 class PopulateStarSystemGenerator : public StarSystemLegacyGeneratorBase {
 public:
 	virtual bool Apply(Random &rng, RefCountedPtr<Galaxy> galaxy, RefCountedPtr<StarSystem::GeneratorAPI> system, GalaxyGenerator::StarSystemConfig *config);
+	virtual GalaxyDetail GetDetail() const { return GalaxyDetail::FULL; }
 
 private:
 	void SetSysPolit(RefCountedPtr<Galaxy> galaxy, RefCountedPtr<StarSystem::GeneratorAPI> system, const fixed &human_infestedness);
@@ -8,6 +8,7 @@
 #include "Game.h"
 #include "JsonUtils.h"
 #include "Lang.h"
+#include "scenegraph/Serializer.h"
 #include "utils.h"
 
 SystemBodyData::SystemBodyData() :
@@ -927,6 +928,122 @@ void SystemBody::Dump(FILE *file, const char *indent) const
 	fprintf(file, "%s}\n", indent);
 }
 
+// every fixed point parameter generation sets, in cache order
+static fixed SystemBodyData::*const s_cachedFixedParams[] = {
+	&SystemBodyData::m_radius,
+	&SystemBodyData::m_aspectRatio,
+	&SystemBodyData::m_mass,
+	&SystemBodyData::m_rotationPeriod,
+	&SystemBodyData::m_rotationalPhaseAtStart,
+	&SystemBodyData::m_humanActivity,
+	&SystemBodyData::m_semiMajorAxis,
+	&SystemBodyData::m_eccentricity,
+	&SystemBodyData::m_orbitalOffset,
+	&SystemBodyData::m_orbitalPhaseAtStart,
+	&SystemBodyData::m_axialTilt,
+	&SystemBodyData::m_inclination,
+	&SystemBodyData::m_argOfPeriapsis,
+	&SystemBodyData::m_metallicity,
+	&SystemBodyData::m_volcanicity,
+	&SystemBodyData::m_volatileLiquid,
+	&SystemBodyData::m_volatileIces,
+	&SystemBodyData::m_volatileGas,
+	&SystemBodyData::m_atmosOxidizing,
+	&SystemBodyData::m_life,
+	&SystemBodyData::m_population,
+	&SystemBodyData::m_agricultural,
+};
+
+size_t SystemBody::GetMemoryUsage() const
+{
+	return sizeof(SystemBody) + m_name.capacity() + m_heightMapFilename.capacity() + m_spaceStationType.capacity() +
+		m_children.capacity() * sizeof(SystemBody *);
+}
+
+static const Uint32 NO_BODY = ~0u;
+
+void SystemBodyData::SaveToCache(Serializer::Writer &wr) const
+{
+	wr.String(m_name);
+	wr.Int32(m_type);
+	wr.Int32(m_seed);
+	wr.Int32(m_averageTemp);
+	for (fixed SystemBodyData::*param : s_cachedFixedParams)
+		wr.Int64((this->*param).v);
+	wr.Int64(m_rings.minRadius.v);
+	wr.Int64(m_rings.maxRadius.v);
+	wr.Color4UB(m_rings.baseColor);
+	wr.Color4UB(m_atmosColor);
+	wr.String(m_heightMapFilename);
+	wr.Int32(m_heightMapFractal);
+	wr.String(m_spaceStationType);
+}
+
+void SystemBodyData::LoadFromCache(Serializer::Reader &rd)
+{
+	m_name = rd.String();
+	m_type = SystemBodyType::BodyType(rd.Int32());
+	m_seed = rd.Int32();
+	m_averageTemp = rd.Int32();
+	for (fixed SystemBodyData::*param : s_cachedFixedParams)
+		(this->*param).v = rd.Int64();
+	m_rings.minRadius.v = rd.Int64();
+	m_rings.maxRadius.v = rd.Int64();
+	m_rings.baseColor = rd.Color4UB();
+	m_atmosColor = rd.Color4UB();
+	m_heightMapFilename = rd.String();
+	m_heightMapFractal = rd.Int32();
+	m_spaceStationType = rd.String();
+}
+
+void SystemBody::SaveToCache(Serializer::Writer &wr) const
+{
+	static_assert(std::is_trivially_copyable<Orbit>::value, "Orbit is cached as a blob");
+
+	SystemBodyData::SaveToCache(wr);
+	wr.Int32(m_parent ? m_parent->GetPath().bodyIndex : NO_BODY);
+	wr.Int32(m_children.size());
+	for (const SystemBody *kid : m_children)
+		wr.Int32(kid->GetPath().bodyIndex);
+
+	wr.Blob(ByteRange(reinterpret_cast<const char *>(&m_orbit), sizeof(Orbit)));
+	wr.Int64(m_orbMin.v);
+	wr.Int64(m_orbMax.v);
+	wr.Bool(m_isCustomBody);
+	wr.Double(m_atmosPressure);
+	wr.Double(m_atmosRadius);
+}
+
+void SystemBody::LoadFromCache(Serializer::Reader &rd, const std::vector<RefCountedPtr<SystemBody>> &bodies)
+{
+	auto getBody = [&](Uint32 idx) {
+		if (idx >= bodies.size())
+			throw std::out_of_range("SystemBody::LoadFromCache: invalid body index");
+		return bodies[idx].Get();
+	};
+
+	SystemBodyData::LoadFromCache(rd);
+
+	const Uint32 parent = rd.Int32();
+	m_parent = parent == NO_BODY ? nullptr : getBody(parent);
+	const Uint32 numChildren = rd.Int32();
+	if (numChildren > bodies.size())
+		throw std::out_of_range("SystemBody::LoadFromCache: invalid number of children");
+	m_children.resize(numChildren);
+	for (SystemBody *&kid : m_children)
+		kid = getBody(rd.Int32());
+
+	const ByteRange orbit = rd.Blob();
+	if (orbit.Size() != sizeof(Orbit))
+		throw std::out_of_range("SystemBody::LoadFromCache: invalid orbit");
+	std::memcpy(&m_orbit, orbit.begin, sizeof(Orbit));
+	m_orbMin.v = rd.Int64();
+	m_orbMax.v = rd.Int64();
+	m_isCustomBody = rd.Bool();
+	m_atmosPressure = rd.Double();
+	m_atmosRadius = rd.Double();
+}
+
 void SystemBody::Orphan()
 {
 	PROFILE_SCOPED()
@@ -18,6 +18,11 @@ class StarSystem;
 
 struct AtmosphereParameters;
 
+namespace Serializer {
+	class Reader;
+	class Writer;
+} // namespace Serializer
+
 // Enum scoped access pattern base class
 // Allows access to e.g. SystemBody::TYPE_GRAVPOINT
 class SystemBodyType {
@@ -93,6 +98,10 @@ public:
 	void SaveToJson(Json &out);
 	void LoadFromJson(const Json &obj);
 
+	// Binary copy of all of the parameters, for the disk caches
+	void SaveToCache(Serializer::Writer &wr) const;
+	void LoadFromCache(Serializer::Reader &rd);
+
 	std::string m_name;
 	SystemBodyType::BodyType m_type = SystemBodyType::TYPE_GRAVPOINT;
 
@@ -302,6 +311,15 @@ public:
 
 	void Dump(FILE *file, const char *indent = "") const;
 
+	// Rough estimate of the heap memory used by this body, in bytes
+	size_t GetMemoryUsage() const;
+
+	// Binary copy of everything generation sets, for GalaxyDiskCache.
+	// Parents and children are stored as body indices and resolved from
+	// the bodies of the system being loaded.
+	void SaveToCache(Serializer::Writer &wr) const;
+	void LoadFromCache(Serializer::Reader &rd, const std::vector<RefCountedPtr<SystemBody>> &bodies);
+
 	StarSystem *GetStarSystem() const { return m_system; }
 
 	const std::string &GetSpaceStationType() const { return m_spaceStationType; }
@@ -0,0 +1,149 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "SystemNameIndex.h"
+
+#include "galaxy/Sector.h"
+#include "profiler/Profiler.h"
+
+#include <algorithm>
+
+namespace {
+	// how many candidates to check between looking at the clock
+	static const size_t CANDIDATES_PER_CLOCK_CHECK = 256;
+
+	// system names are ASCII, and the search has always ignored case the
+	// way strncasecmp does
+	std::string ToLower(const std::string &str)
+	{
+		std::string lower(str);
+		for (char &c : lower)
+			if (c >= 'A' && c <= 'Z')
+				c = c - 'A' + 'a';
+		return lower;
+	}
+
+	inline Uint32 Trigram(const char *s)
+	{
+		return Uint32(Uint8(s[0])) | Uint32(Uint8(s[1])) << 8 | Uint32(Uint8(s[2])) << 16;
+	}
+} // namespace
+
+SystemNameIndex::SystemNameIndex() :
+	m_numRemoved(0)
+{
+}
+
+void SystemNameIndex::AddSector(const Sector *sector)
+{
+	PROFILE_SCOPED()
+	const SystemPath sectorPath = sector->GetPath();
+	RemoveSector(sectorPath);
+
+	for (const Sector::System &sys : sector->m_systems) {
+		const vector3f pos = sys.GetFullPosition();
+		AddName(sys.GetName(), sys.GetPath(), pos);
+		for (const std::string &name : sys.GetOtherNames())
+			AddName(name, sys.GetPath(), pos);
+	}
+}
+
+void SystemNameIndex::AddName(const std::string &name, const SystemPath &path, const vector3f &pos)
+{
+	const Uint32 id = m_entries.size();
+	m_entries.push_back({ ToLower(name), path, pos, false });
+	m_sectors[path].push_back(id);
+
+	const std::string &lower = m_entries.back().name;
+	for (size_t i = 0; i + 3 <= lower.size(); i++) {
+		std::vector<Uint32> &ids = m_trigrams[Trigram(&lower[i])];
+		// names with the same trigram more than once are only listed once
+		if (ids.empty() || ids.back() != id)
+			ids.push_back(id);
+	}
+}
+
+void SystemNameIndex::RemoveSector(const SystemPath &sectorPath)
+{
+	auto it = m_sectors.find(sectorPath);
+	if (it == m_sectors.end())
+		return;
+
+	// the trigram lists are cleaned up by Compact()
+	for (Uint32 id : it->second)
+		m_entries[id].removed = true;
+	m_numRemoved += it->second.size();
+	m_sectors.erase(it);
+
+	if (m_numRemoved > m_entries.size() / 2)
+		Compact();
+}
+
+void SystemNameIndex::Clear()
+{
+	m_entries.clear();
+	m_sectors.clear();
+	m_trigrams.clear();
+	m_numRemoved = 0;
+}
+
+void SystemNameIndex::Compact()
+{
+	PROFILE_SCOPED()
+	std::vector<Entry> entries;
+	entries.swap(m_entries);
+	m_sectors.clear();
+	m_trigrams.clear();
+	m_numRemoved = 0;
+
+	m_entries.reserve(entries.size());
+	for (const Entry &entry : entries)
+		if (!entry.removed)
+			AddName(entry.name, entry.path, entry.pos);
+}
+
+std::vector<SystemPath> SystemNameIndex::Find(const std::string &pattern, const vector3f &pos, double timeBudgetMs) const
+{
+	PROFILE_SCOPED()
+	Profiler::Clock clock;
+	clock.Start();
+
+	const std::string lower = ToLower(pattern);
+
+	// with a trigram, only the names in the shortest list of any of the
+	// pattern's trigrams need to be looked at
+	const std::vector<Uint32> *candidates = nullptr;
+	for (size_t i = 0; i + 3 <= lower.size(); i++) {
+		auto it = m_trigrams.find(Trigram(&lower[i]));
+		if (it == m_trigrams.end())
+			return std::vector<SystemPath>();
+		if (!candidates || it->second.size() < candidates->size())
+			candidates = &it->second;
+	}
+	const size_t numCandidates = candidates ? candidates->size() : m_entries.size();
+
+	std::vector<std::pair<float, const Entry *>> matches;
+	for (size_t i = 0; i < numCandidates; i++) {
+		if (i % CANDIDATES_PER_CLOCK_CHECK == CANDIDATES_PER_CLOCK_CHECK - 1 && clock.currentmilliseconds() > timeBudgetMs)
+			break;
+
+		const Entry &entry = m_entries[candidates ? (*candidates)[i] : i];
+		if (!entry.removed && entry.name.find(lower) != std::string::npos)
+			matches.emplace_back((entry.pos - pos).LengthSqr(), &entry);
+	}
+
+	// a system can match through more than one of its names; those entries
+	// have the same distance, so they end up next to each other
+	std::sort(matches.begin(), matches.end(), [](const std::pair<float, const Entry *> &a, const std::pair<float, const Entry *> &b) {
+		if (a.first != b.first)
+			return a.first < b.first;
+		return a.second->path < b.second->path;
+	});
+
+	std::vector<SystemPath> result;
+	result.reserve(matches.size());
+	for (const auto &match : matches)
+		if (result.empty() || !result.back().IsSameSystem(match.second->path))
+			result.push_back(match.second->path);
+	return result;
+}
@@ -0,0 +1,57 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SYSTEMNAMEINDEX_H
+#define _SYSTEMNAMEINDEX_H
+
+#include "galaxy/SystemPath.h"
+#include "vector3.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Sector;
+
+// Trigram index over the names and other names of the systems in a set of
+// sectors, for searching systems by name. It is updated incrementally as
+// sectors are added and removed, e.g. as they enter and leave a slave cache.
+class SystemNameIndex {
+public:
+	SystemNameIndex();
+
+	// Adding a sector that is already indexed replaces its systems
+	void AddSector(const Sector *sector);
+	void RemoveSector(const SystemPath &sectorPath);
+	void Clear();
+
+	size_t GetNumSectors() const { return m_sectors.size(); }
+
+	// Systems with a name that contains the pattern, ignoring case, closest
+	// to pos (in light years) first. Stops looking for more matches once
+	// the time budget is used up, so very short patterns may not find every
+	// match; the ones found are still ranked.
+	std::vector<SystemPath> Find(const std::string &pattern, const vector3f &pos, double timeBudgetMs) const;
+
+private:
+	struct Entry {
+		std::string name; // lower case
+		SystemPath path;
+		vector3f pos; // in light years
+		bool removed;
+	};
+
+	void AddName(const std::string &name, const SystemPath &path, const vector3f &pos);
+	// Drop removed entries once they make up most of the index
+	void Compact();
+
+	std::vector<Entry> m_entries;
+	// entries of each sector
+	std::map<SystemPath, std::vector<Uint32>, SystemPath::LessSectorOnly> m_sectors;
+	// entries containing each trigram, in ascending order
+	std::unordered_map<Uint32, std::vector<Uint32>> m_trigrams;
+	size_t m_numRemoved;
+};
+
+#endif /* _SYSTEMNAMEINDEX_H */
@@ -0,0 +1,346 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "BlockCompression.h"
+
+#include "profiler/Profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace Graphics;
+
+namespace {
+	struct Colour {
+		float r, g, b;
+	};
+
+	inline uint16_t to_565(const Colour &c)
+	{
+		const int r = std::clamp(int(std::lrint(c.r * 31.f / 255.f)), 0, 31);
+		const int g = std::clamp(int(std::lrint(c.g * 63.f / 255.f)), 0, 63);
+		const int b = std::clamp(int(std::lrint(c.b * 31.f / 255.f)), 0, 31);
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	inline Colour from_565(uint16_t c)
+	{
+		const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+		return { float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2)) };
+	}
+
+	inline float distance_sq(const Colour &a, const Colour &b)
+	{
+		const float dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+		return dr * dr + dg * dg + db * db;
+	}
+
+	inline Colour mix(const Colour &a, const Colour &b, float t)
+	{
+		return { a.r + (b.r - a.r) * t, a.g + (b.g - a.g) * t, a.b + (b.b - a.b) * t };
+	}
+
+	// Pick the nearest of the four colours the endpoints give for each
+	// pixel. Returns the total squared error.
+	float fit_indices(const Colour *pixels, uint16_t c0, uint16_t c1, uint8_t *indices)
+	{
+		const Colour e0 = from_565(c0), e1 = from_565(c1);
+		const Colour palette[4] = { e0, e1, mix(e0, e1, 1.f / 3.f), mix(e0, e1, 2.f / 3.f) };
+
+		float error = 0.f;
+		for (int i = 0; i < 16; i++) {
+			float best = distance_sq(pixels[i], palette[0]);
+			indices[i] = 0;
+			for (uint8_t p = 1; p < 4; p++) {
+				const float d = distance_sq(pixels[i], palette[p]);
+				if (d < best) {
+					best = d;
+					indices[i] = p;
+				}
+			}
+			error += best;
+		}
+		return error;
+	}
+
+	// Endpoints along the principal axis of the block's colours
+	void fit_principal_axis(const Colour *pixels, Colour &end0, Colour &end1)
+	{
+		Colour mean = { 0.f, 0.f, 0.f };
+		for (int i = 0; i < 16; i++) {
+			mean.r += pixels[i].r;
+			mean.g += pixels[i].g;
+			mean.b += pixels[i].b;
+		}
+		mean = { mean.r / 16.f, mean.g / 16.f, mean.b / 16.f };
+
+		float cov[6] = { 0.f };
+		for (int i = 0; i < 16; i++) {
+			const float r = pixels[i].r - mean.r, g = pixels[i].g - mean.g, b = pixels[i].b - mean.b;
+			cov[0] += r * r;
+			cov[1] += r * g;
+			cov[2] += r * b;
+			cov[3] += g * g;
+			cov[4] += g * b;
+			cov[5] += b * b;
+		}
+
+		// power iteration, starting from the luminance direction
+		float axis[3] = { 0.299f, 0.587f, 0.114f };
+		for (int iter = 0; iter < 8; iter++) {
+			const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+			const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+			const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+			const float len = std::max({ std::abs(x), std::abs(y), std::abs(z) });
+			if (len < 1e-6f)
+				break;
+			axis[0] = x / len;
+			axis[1] = y / len;
+			axis[2] = z / len;
+		}
+
+		float minDot = INFINITY, maxDot = -INFINITY;
+		for (int i = 0; i < 16; i++) {
+			const float dot = pixels[i].r * axis[0] + pixels[i].g * axis[1] + pixels[i].b * axis[2];
+			if (dot < minDot) {
+				minDot = dot;
+				end1 = pixels[i];
+			}
+			if (dot > maxDot) {
+				maxDot = dot;
+				end0 = pixels[i];
+			}
+		}
+	}
+
+	// Least squares endpoints for the given indices. Returns false if the
+	// indices don't constrain both endpoints.
+	bool refine_endpoints(const Colour *pixels, const uint8_t *indices, Colour &end0, Colour &end1)
+	{
+		static const float s_weights[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+
+		float aa = 0.f, bb = 0.f, ab = 0.f;
+		Colour ax = { 0.f, 0.f, 0.f }, bx = { 0.f, 0.f, 0.f };
+		for (int i = 0; i < 16; i++) {
+			const float w = s_weights[indices[i]], v = 1.f - w;
+			aa += w * w;
+			bb += v * v;
+			ab += w * v;
+			ax = { ax.r + w * pixels[i].r, ax.g + w * pixels[i].g, ax.b + w * pixels[i].b };
+			bx = { bx.r + v * pixels[i].r, bx.g + v * pixels[i].g, bx.b + v * pixels[i].b };
+		}
+
+		const float det = aa * bb - ab * ab;
+		if (std::abs(det) < 1e-6f)
+			return false;
+
+		const float f = 1.f / det;
+		end0 = { (ax.r * bb - bx.r * ab) * f, (ax.g * bb - bx.g * ab) * f, (ax.b * bb - bx.b * ab) * f };
+		end1 = { (bx.r * aa - ax.r * ab) * f, (bx.g * aa - ax.g * ab) * f, (bx.b * aa - ax.b * ab) * f };
+		return true;
+	}
+
+	// The colour half of both formats, always in four colour mode
+	void compress_colour_block(const uint8_t *rgba, uint8_t *out)
+	{
+		Colour pixels[16];
+		for (int i = 0; i < 16; i++)
+			pixels[i] = { float(rgba[i * 4 + 0]), float(rgba[i * 4 + 1]), float(rgba[i * 4 + 2]) };
+
+		Colour end0, end1;
+		fit_principal_axis(pixels, end0, end1);
+		uint16_t c0 = to_565(end0), c1 = to_565(end1);
+		uint8_t indices[16];
+		float error = fit_indices(pixels, c0, c1, indices);
+
+		if (c0 != c1 && refine_endpoints(pixels, indices, end0, end1)) {
+			uint8_t refined[16];
+			const uint16_t r0 = to_565(end0), r1 = to_565(end1);
+			const float refinedError = fit_indices(pixels, r0, r1, refined);
+			if (refinedError < error) {
+				c0 = r0;
+				c1 = r1;
+				error = refinedError;
+				memcpy(indices, refined, sizeof(indices));
+			}
+		}
+
+		// four colour mode needs c0 > c1: swapping the endpoints swaps the
+		// indices of each pair of colours
+		if (c0 < c1) {
+			std::swap(c0, c1);
+			for (uint8_t &index : indices)
+				index ^= 1;
+		} else if (c0 == c1) {
+			memset(indices, 0, sizeof(indices));
+		}
+
+		uint32_t bits = 0;
+		for (int i = 0; i < 16; i++)
+			bits |= uint32_t(indices[i]) << (i * 2);
+
+		out[0] = c0 & 0xff;
+		out[1] = c0 >> 8;
+		out[2] = c1 & 0xff;
+		out[3] = c1 >> 8;
+		for (int i = 0; i < 4; i++)
+			out[4 + i] = (bits >> (i * 8)) & 0xff;
+	}
+
+	void compress_alpha_block(const uint8_t *rgba, uint8_t *out)
+	{
+		uint8_t a0 = 0, a1 = 255;
+		for (int i = 0; i < 16; i++) {
+			a0 = std::max(a0, rgba[i * 4 + 3]);
+			a1 = std::min(a1, rgba[i * 4 + 3]);
+		}
+
+		// eight alpha mode: the endpoints and six steps between them
+		int palette[8] = { a0, a1 };
+		for (int i = 1; i < 7; i++)
+			palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+
+		uint64_t bits = 0;
+		if (a0 != a1) {
+			for (int i = 0; i < 16; i++) {
+				const int a = rgba[i * 4 + 3];
+				int best = 0;
+				for (int p = 1; p < 8; p++) {
+					if (std::abs(a - palette[p]) < std::abs(a - palette[best]))
+						best = p;
+				}
+				bits |= uint64_t(best) << (i * 3);
+			}
+		}
+
+		out[0] = a0;
+		out[1] = a1;
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = (bits >> (i * 8)) & 0xff;
+	}
+
+	// Copy the 4x4 block at (x, y) of an RGBA image, repeating the edge
+	// pixels of images smaller than a block
+	void get_block(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint8_t *block)
+	{
+		for (uint32_t by = 0; by < 4; by++) {
+			const uint32_t sy = std::min(y + by, height - 1);
+			for (uint32_t bx = 0; bx < 4; bx++) {
+				const uint32_t sx = std::min(x + bx, width - 1);
+				memcpy(block + (by * 4 + bx) * 4, rgba + (sy * width + sx) * 4, 4);
+			}
+		}
+	}
+
+	// Halve an RGBA image with a box filter
+	void downsample(const std::vector<uint8_t> &src, uint32_t width, uint32_t height, std::vector<uint8_t> &dst)
+	{
+		const uint32_t w = std::max(width / 2, 1U), h = std::max(height / 2, 1U);
+		dst.resize(size_t(w) * h * 4);
+		for (uint32_t y = 0; y < h; y++) {
+			const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+			for (uint32_t x = 0; x < w; x++) {
+				const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				for (uint32_t c = 0; c < 4; c++) {
+					const uint32_t sum = src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c] +
+						src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+					dst[(y * w + x) * 4 + c] = uint8_t((sum + 2) / 4);
+				}
+			}
+		}
+	}
+} // namespace
+
+void BlockCompression::CompressBlockDXT1(const uint8_t *rgba, uint8_t *out)
+{
+	compress_colour_block(rgba, out);
+}
+
+void BlockCompression::CompressBlockDXT5(const uint8_t *rgba, uint8_t *out)
+{
+	compress_alpha_block(rgba, out);
+	compress_colour_block(rgba, out + 8);
+}
+
+size_t BlockCompression::GetCompressedSize(TextureFormat format, uint32_t width, uint32_t height, uint32_t numMips)
+{
+	assert(format == TEXTURE_DXT1 || format == TEXTURE_DXT5);
+	const size_t blockSize = format == TEXTURE_DXT1 ? 8 : 16;
+	size_t size = 0;
+	for (uint32_t i = 0; i < numMips; i++) {
+		size += size_t((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+		width = std::max(width / 2, 1U);
+		height = std::max(height / 2, 1U);
+	}
+	return size;
+}
+
+TextureFormat BlockCompression::ChooseFormat(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, uint32_t bytesPerPixel)
+{
+	if (bytesPerPixel == 3)
+		return TEXTURE_DXT1;
+
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = pixels + size_t(y) * pitch;
+		for (uint32_t x = 0; x < width; x++) {
+			if (row[x * 4 + 3] != 255)
+				return TEXTURE_DXT5;
+		}
+	}
+	return TEXTURE_DXT1;
+}
+
+uint32_t BlockCompression::CompressImage(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, uint32_t bytesPerPixel,
+	TextureFormat format, bool mipmaps, std::vector<uint8_t> &out)
+{
+	PROFILE_SCOPED()
+	assert(bytesPerPixel == 3 || bytesPerPixel == 4);
+	assert(format == TEXTURE_DXT1 || format == TEXTURE_DXT5);
+
+	uint32_t numMips = 1;
+	if (mipmaps) {
+		for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+			numMips++;
+	}
+
+	std::vector<uint8_t> level(size_t(width) * height * 4);
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = pixels + size_t(y) * pitch;
+		for (uint32_t x = 0; x < width; x++) {
+			uint8_t *dst = &level[(size_t(y) * width + x) * 4];
+			memcpy(dst, row + x * bytesPerPixel, bytesPerPixel);
+			if (bytesPerPixel == 3)
+				dst[3] = 255;
+		}
+	}
+
+	const size_t blockSize = format == TEXTURE_DXT1 ? 8 : 16;
+	out.resize(GetCompressedSize(format, width, height, numMips));
+	uint8_t *dst = out.data();
+
+	std::vector<uint8_t> next;
+	uint8_t block[64];
+	for (uint32_t mip = 0; mip < numMips; mip++) {
+		for (uint32_t y = 0; y < height; y += 4) {
+			for (uint32_t x = 0; x < width; x += 4) {
+				get_block(level.data(), width, height, x, y, block);
+				if (format == TEXTURE_DXT1)
+					CompressBlockDXT1(block, dst);
+				else
+					CompressBlockDXT5(block, dst);
+				dst += blockSize;
+			}
+		}
+
+		if (mip + 1 < numMips) {
+			downsample(level, width, height, next);
+			level.swap(next);
+			width = std::max(width / 2, 1U);
+			height = std::max(height / 2, 1U);
+		}
+	}
+	assert(dst == out.data() + out.size());
+	return numMips;
+}
@@ -0,0 +1,44 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _BLOCKCOMPRESSION_H
+#define _BLOCKCOMPRESSION_H
+
+#include "Texture.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Graphics {
+
+	// A small DXT1/DXT5 (BC1/BC3) encoder, for compressing uncompressed
+	// textures when they're loaded rather than leaving it to the driver.
+	// Endpoints are fitted along the principal axis of each block's colours
+	// and refined once by least squares, which is close to what offline
+	// tools produce at their fast settings.
+	//
+	// Everything here is thread safe.
+	namespace BlockCompression {
+
+		// Compress a 4x4 block of RGBA pixels, rows first (64 bytes)
+		void CompressBlockDXT1(const uint8_t *rgba, uint8_t *out);
+		void CompressBlockDXT5(const uint8_t *rgba, uint8_t *out);
+
+		// Size of an image and the given number of its mips in a compressed format
+		size_t GetCompressedSize(TextureFormat format, uint32_t width, uint32_t height, uint32_t numMips);
+
+		// The format an image compresses to: DXT5 if it has any transparency,
+		// DXT1 otherwise. bytesPerPixel is 3 (RGB) or 4 (RGBA).
+		TextureFormat ChooseFormat(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, uint32_t bytesPerPixel);
+
+		// Compress an image, and its mip chain down to 1x1 if mipmaps is set,
+		// into out the way a DDS file lays it out. Returns the number of mips.
+		uint32_t CompressImage(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, uint32_t bytesPerPixel,
+			TextureFormat format, bool mipmaps, std::vector<uint8_t> &out);
+
+	} // namespace BlockCompression
+
+} // namespace Graphics
+
+#endif /* _BLOCKCOMPRESSION_H */
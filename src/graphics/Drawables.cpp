@@ -11,6 +11,7 @@
 #include "graphics/RenderState.h"
 #include "graphics/Types.h"
 #include "graphics/VertexBuffer.h"
+#include "jenkins/lookup3.h"
 #include "profiler/Profiler.h"
 
 namespace Graphics {
@@ -204,7 +205,74 @@ namespace Graphics {
 
 		//------------------------------------------------------------
 
+		// Data up to this many vertices is written to the renderer's stream
+		// buffer every time it's drawn; above it, the helpers keep a vertex
+		// buffer of their own which is only written when the data changes.
+		static constexpr Uint32 MAX_STREAMED_VERTICES = 1024;
+
+		// Identifies the data a helper was given, to tell when it changes
+		struct DataHash {
+			template <typename T>
+			DataHash &Add(const T *data, size_t count)
+			{
+				lookup3_hashlittle2(data, count * sizeof(T), &a, &b);
+				return *this;
+			}
+
+			template <typename T>
+			DataHash &Add(const T &value) { return Add(&value, 1); }
+
+			uint64_t Get() const { return (uint64_t(a) << 32) | b; }
+
+			uint32_t a = 0;
+			uint32_t b = 0;
+		};
+
+		// Writes the vertex array into the mesh's buffer. A buffer which is
+		// missing or too small is replaced with one of twice the size, so data
+		// that grows a little every frame doesn't recreate it every frame.
+		static void UploadVertices(Renderer *r, RefCountedPtr<MeshObject> &mesh, const VertexArray &va)
+		{
+			PROFILE_SCOPED()
+			const Uint32 numVerts = va.GetNumVerts();
+
+			if (!mesh.Valid() || mesh->GetVertexBuffer()->GetCapacity() < numVerts) {
+				const Uint32 capacity = mesh.Valid() ? mesh->GetVertexBuffer()->GetCapacity() : 0;
+
+				VertexBufferDesc vbd = VertexBufferDesc::FromAttribSet(va.GetAttributeSet());
+				vbd.usage = BUFFER_USAGE_DYNAMIC;
+				vbd.numVertices = std::max(numVerts, capacity * 2);
+				mesh.Reset(r->CreateMeshObject(r->CreateVertexBuffer(vbd)));
+			}
+
+			mesh->GetVertexBuffer()->Populate(va);
+			mesh->GetVertexBuffer()->SetVertexCount(numVerts);
+		}
+
+		// Draws the vertex array from the stream buffer if it's small enough,
+		// and from the mesh otherwise, uploading the data first if it changed
+		static void DrawVertices(Renderer *r, Material *mat, RefCountedPtr<MeshObject> &mesh, const VertexArray &va, bool &refresh)
+		{
+			if (va.GetNumVerts() <= MAX_STREAMED_VERTICES) {
+				// the buffer would have to be written again once the data grows
+				mesh.Reset();
+				refresh = true;
+				r->DrawBuffer(&va, mat);
+				return;
+			}
+
+			if (refresh || !mesh.Valid()) {
+				refresh = false;
+				UploadVertices(r, mesh, va);
+			}
+
+			r->DrawMesh(mesh.Get(), mat);
+		}
+
+		//------------------------------------------------------------
+
 		Lines::Lines() :
+			m_dataHash(0),
 			m_refreshVertexBuffer(true),
 			m_va(new VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE))
 		{
@@ -217,14 +285,12 @@ namespace Graphics {
 			PROFILE_SCOPED()
 			assert(vertices);
 
-			// somethings changed so even if the number of verts is constant the data must be uploaded
-			m_refreshVertexBuffer = true;
+			const uint64_t hash = DataHash().Add(vertices, vertCount).Add(color).Get();
+			if (hash == m_dataHash && m_va->GetNumVerts() == vertCount)
+				return;
 
-			// if the number of vert mismatches then clear the current vertex buffer
-			if (m_lineMesh.Valid() && m_lineMesh->GetVertexBuffer()->GetCapacity() < vertCount) {
-				// a new one will be created when it is drawn
-				m_lineMesh.Reset();
-			}
+			m_dataHash = hash;
+			m_refreshVertexBuffer = true;
 
 			// populate the VertexArray
 			m_va->Clear(vertCount);
@@ -238,14 +304,12 @@ namespace Graphics {
 			PROFILE_SCOPED()
 			assert(vertices);
 
-			// somethings changed so even if the number of verts is constant the data must be uploaded
-			m_refreshVertexBuffer = true;
+			const uint64_t hash = DataHash().Add(vertices, vertCount).Add(colors, vertCount).Get();
+			if (hash == m_dataHash && m_va->GetNumVerts() == vertCount)
+				return;
 
-			// if the number of vert mismatches then clear the current vertex buffer
-			if (m_lineMesh.Valid() && m_lineMesh->GetVertexBuffer()->GetCapacity() < vertCount) {
-				// a new one will be created when it is drawn
-				m_lineMesh.Reset();
-			}
+			m_dataHash = hash;
+			m_refreshVertexBuffer = true;
 
 			// populate the VertexArray
 			m_va->Clear(vertCount);
@@ -260,31 +324,16 @@ namespace Graphics {
 			if (m_va->IsEmpty())
 				return;
 
-			/*
-			if (!m_lineMesh.Valid()) {
-				Graphics::VertexBufferDesc vbd = VertexBufferDesc::FromAttribSet(m_va->GetAttributeSet());
-				vbd.usage = Graphics::BUFFER_USAGE_DYNAMIC;
-				vbd.numVertices = m_va->GetNumVerts() * 2; // ask for twice as many as we need to reduce buffer thrashing
-				m_lineMesh.Reset(r->CreateMeshObject(r->CreateVertexBuffer(vbd)));
-				m_refreshVertexBuffer = true;
-			}
-
-			if (m_refreshVertexBuffer) {
-				m_refreshVertexBuffer = false;
-				m_lineMesh->GetVertexBuffer()->Populate(*m_va);
-			}
-			*/
-
 			// XXX would be nicer to draw this as a textured triangle strip
 			// can't guarantee linewidth support
 			// glLineWidth(m_width);
-			// r->DrawMesh(m_lineMesh.Get(), mat);
-			r->DrawBuffer(m_va.get(), mat);
+			DrawVertices(r, mat, m_lineMesh, *m_va, m_refreshVertexBuffer);
 			// glLineWidth(1.f);
 		}
 
 		//------------------------------------------------------------
 		PointSprites::PointSprites() :
+			m_dataHash(0),
 			m_refreshVertexBuffer(true),
 			m_va(new VertexArray(ATTRIB_POSITION | ATTRIB_NORMAL | ATTRIB_DIFFUSE))
 		{
@@ -298,6 +347,12 @@ namespace Graphics {
 
 			assert(positions);
 
+			const uint64_t hash = DataHash().Add(positions, count).Add(colours, count).Add(sizes, count).Get();
+			if (hash == m_dataHash && m_va->GetNumVerts() == Uint32(count))
+				return;
+
+			m_dataHash = hash;
+
 			m_va->Clear(count);
 
 			for (int i = 0; i < count; i++) {
@@ -314,6 +369,12 @@ namespace Graphics {
 			if (count < 1)
 				return;
 
+			const uint64_t hash = DataHash().Add(positions.data(), count).Add(colors.data(), count).Add(sizes.data(), count).Get();
+			if (hash == m_dataHash && m_va->GetNumVerts() == Uint32(count))
+				return;
+
+			m_dataHash = hash;
+
 			m_va->Clear();
 			m_va->position = std::move(positions);
 			m_va->diffuse = std::move(colors);
@@ -323,6 +384,8 @@ namespace Graphics {
 				vector3f vSize(sizes[i]);
 				m_va->normal.push_back(vSize);
 			}
+
+			m_refreshVertexBuffer = true;
 		}
 
 		void PointSprites::Draw(Renderer *r, Material *mat)
@@ -333,22 +396,13 @@ namespace Graphics {
 			if (m_va->GetNumVerts() == 0)
 				return;
 
-			if (!m_pointData.Valid()) {
-				m_pointData.Reset(r->CreateMeshObjectFromArray(m_va.get()));
-				m_refreshVertexBuffer = false;
-			}
-
-			if (m_refreshVertexBuffer) {
-				m_refreshVertexBuffer = false;
-				m_pointData->GetVertexBuffer()->Populate(*m_va);
-			}
-
-			r->DrawMesh(m_pointData.Get(), mat);
+			DrawVertices(r, mat, m_pointData, *m_va, m_refreshVertexBuffer);
 		}
 
 		//------------------------------------------------------------
 
 		Points::Points() :
+			m_dataHash(0),
 			m_refreshVertexBuffer(true),
 			m_va(new VertexArray(ATTRIB_POSITION | ATTRIB_DIFFUSE))
 		{
@@ -364,12 +418,19 @@ namespace Graphics {
 			assert(positions);
 			const unsigned int total = (count * 6);
 
-			m_va->Clear(total);
-
 			matrix4x4f rot(trans);
 			rot.ClearToRotOnly();
 			rot = rot.Inverse();
 
+			// the quads only depend on the rotation of the view
+			const uint64_t hash = DataHash().Add(positions, count).Add(&rot[0], 16).Add(color).Add(size).Get();
+			if (hash == m_dataHash && m_va->GetNumVerts() == total)
+				return;
+
+			m_dataHash = hash;
+
+			m_va->Clear(total);
+
 			const float sz = 0.5f * size;
 			const vector3f rotv1 = rot * vector3f(sz, sz, 0.0f);
 			const vector3f rotv2 = rot * vector3f(sz, -sz, 0.0f);
@@ -391,12 +452,6 @@ namespace Graphics {
 				m_va->Add(pos + rotv2, color); //bottom right
 			}
 
-			// if the number of vert mismatches then clear the current vertex buffer
-			if (m_pointMesh.Valid() && m_pointMesh->GetVertexBuffer()->GetCapacity() < total) {
-				// a new one will be created when it is drawn
-				m_pointMesh.Reset();
-			}
-
 			m_refreshVertexBuffer = true;
 		}
 
@@ -409,12 +464,19 @@ namespace Graphics {
 			assert(positions);
 			const unsigned int total = (count * 6);
 
-			m_va->Clear(total);
-
 			matrix4x4f rot(trans);
 			rot.ClearToRotOnly();
 			rot = rot.Inverse();
 
+			// the quads only depend on the rotation of the view
+			const uint64_t hash = DataHash().Add(positions, count).Add(color, count).Add(&rot[0], 16).Add(size).Get();
+			if (hash == m_dataHash && m_va->GetNumVerts() == total)
+				return;
+
+			m_dataHash = hash;
+
+			m_va->Clear(total);
+
 			const float sz = 0.5f * size;
 			const vector3f rotv1 = rot * vector3f(sz, sz, 0.0f);
 			const vector3f rotv2 = rot * vector3f(sz, -sz, 0.0f);
@@ -434,12 +496,6 @@ namespace Graphics {
 				m_va->Add(pos + rotv2, color[i]); //bottom right
 			}
 
-			// if the number of vert mismatches then clear the current vertex buffer
-			if (m_pointMesh.Valid() && m_pointMesh->GetVertexBuffer()->GetCapacity() < total) {
-				// a new one will be created when it is drawn
-				m_pointMesh.Reset();
-			}
-
 			m_refreshVertexBuffer = true;
 		}
 
@@ -449,18 +505,7 @@ namespace Graphics {
 			if (m_va->GetNumVerts() == 0)
 				return;
 
-			if (!m_pointMesh.Valid()) {
-				m_pointMesh.Reset(r->CreateMeshObjectFromArray(m_va.get()));
-				// the vertex buffer will have already been populated during creation
-				m_refreshVertexBuffer = false;
-			}
-
-			if (m_refreshVertexBuffer) {
-				m_refreshVertexBuffer = false;
-				m_pointMesh->GetVertexBuffer()->Populate(*m_va);
-			}
-
-			r->DrawMesh(m_pointMesh.Get(), mat);
+			DrawVertices(r, mat, m_pointMesh, *m_va, m_refreshVertexBuffer);
 		}
 
 		//------------------------------------------------------------
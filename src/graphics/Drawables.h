@@ -80,6 +80,11 @@ namespace Graphics {
 
 		// Three dimensional line segments between two points
 		// Data can be drawn with any of the LINE_* primitive types depending on what the calling code intends
+		//
+		// Lines, PointSprites and Points keep the data they were last given
+		// uploaded, and skip rebuilding and uploading it when SetData is called
+		// with the same data again. Small amounts of data are drawn from the
+		// renderer's stream buffer rather than a buffer of their own.
 		class Lines {
 		public:
 			Lines();
@@ -88,6 +93,7 @@ namespace Graphics {
 			void Draw(Renderer *, Material *);
 
 		private:
+			uint64_t m_dataHash;
 			bool m_refreshVertexBuffer;
 			RefCountedPtr<MeshObject> m_lineMesh;
 			std::unique_ptr<VertexArray> m_va;
@@ -107,6 +113,7 @@ namespace Graphics {
 			void Draw(Renderer *, Material *);
 
 		private:
+			uint64_t m_dataHash;
 			bool m_refreshVertexBuffer;
 			RefCountedPtr<Graphics::MeshObject> m_pointData;
 			std::unique_ptr<VertexArray> m_va;
@@ -122,8 +129,7 @@ namespace Graphics {
 			void Draw(Renderer *, Material *);
 
 		private:
-			void CreateVertexBuffer(Graphics::Renderer *r, const Uint32 size);
-
+			uint64_t m_dataHash;
 			bool m_refreshVertexBuffer;
 			RefCountedPtr<MeshObject> m_pointMesh;
 			std::unique_ptr<VertexArray> m_va;
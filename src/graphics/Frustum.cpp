@@ -84,6 +84,14 @@ namespace Graphics {
 		return true;
 	}
 
+	bool Frustum::TestPointContained(const vector3d &p, double radius) const
+	{
+		for (int i = 0; i < 6; i++)
+			if (m_planes[i].DistanceToPoint(p) - radius < 0)
+				return false;
+		return true;
+	}
+
 	bool Frustum::TestPointInfinite(const vector3d &p, double radius) const
 	{
 		// check all planes except far plane
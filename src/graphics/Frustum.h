@@ -22,6 +22,8 @@ namespace Graphics {
 
 		// test if point (sphere) is in the frustum
 		bool TestPoint(const vector3d &p, double radius) const;
+		// test if point (sphere) lies entirely inside the frustum
+		bool TestPointContained(const vector3d &p, double radius) const;
 		// test if point (sphere) is in the frustum, ignoring the far plane
 		bool TestPointInfinite(const vector3d &p, double radius) const;
 
@@ -0,0 +1,106 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "GPUMemory.h"
+
+#include "core/Log.h"
+
+namespace {
+	MemoryTag::Counter s_counters[Graphics::GPUMemory::MAX_KINDS][MemoryTag::MAX_TAGS];
+	MemoryTag::Counter s_kindTotals[Graphics::GPUMemory::MAX_KINDS];
+	MemoryTag::Counter s_total;
+
+	std::atomic<size_t> s_budget{ 0 };
+	bool s_warned = false;
+} // namespace
+
+namespace Graphics {
+	namespace GPUMemory {
+
+		const char *GetKindName(Kind kind)
+		{
+			switch (kind) {
+			case VERTEX_BUFFER: return "Vertex Buffers";
+			case INDEX_BUFFER: return "Index Buffers";
+			case INSTANCE_BUFFER: return "Instance Buffers";
+			case UNIFORM_BUFFER: return "Uniform Buffers";
+			case RENDER_TARGET: return "Render Targets";
+			case TEXTURE: return "Textures";
+			default: return "?";
+			}
+		}
+
+		void Allocate(Kind kind, MemoryTag::Tag tag, size_t bytes)
+		{
+			s_counters[kind][tag].Allocate(bytes);
+			s_kindTotals[kind].Allocate(bytes);
+			s_total.Allocate(bytes);
+		}
+
+		void Free(Kind kind, MemoryTag::Tag tag, size_t bytes)
+		{
+			s_counters[kind][tag].Free(bytes);
+			s_kindTotals[kind].Free(bytes);
+			s_total.Free(bytes);
+		}
+
+		MemoryTag::Stats GetStats(Kind kind, MemoryTag::Tag tag)
+		{
+			return s_counters[kind][tag].GetStats();
+		}
+
+		MemoryTag::Stats GetTotal(Kind kind)
+		{
+			return s_kindTotals[kind].GetStats();
+		}
+
+		MemoryTag::Stats GetTotal()
+		{
+			return s_total.GetStats();
+		}
+
+		void ResetHighWater()
+		{
+			for (auto &counters : s_counters)
+				for (MemoryTag::Counter &counter : counters)
+					counter.ResetHighWater();
+			for (MemoryTag::Counter &counter : s_kindTotals)
+				counter.ResetHighWater();
+			s_total.ResetHighWater();
+		}
+
+		void SetBudget(size_t bytes)
+		{
+			s_budget.store(bytes, std::memory_order_relaxed);
+			s_warned = false;
+		}
+
+		size_t GetBudget()
+		{
+			return s_budget.load(std::memory_order_relaxed);
+		}
+
+		bool IsNearBudget()
+		{
+			const size_t budget = GetBudget();
+			return budget && double(s_total.GetStats().bytes) > double(budget) * BUDGET_WARNING;
+		}
+
+		void CheckBudget()
+		{
+			const size_t budget = GetBudget();
+			if (!budget)
+				return;
+
+			const size_t bytes = s_total.GetStats().bytes;
+			if (!s_warned && IsNearBudget()) {
+				s_warned = true;
+				Log::Warning("GPU memory: {:.1f} MB in use, {:.0f}% of the {:.0f} MB budget",
+					bytes / (1024.0 * 1024.0), 100.0 * bytes / budget, budget / (1024.0 * 1024.0));
+			} else if (s_warned && double(bytes) < double(budget) * BUDGET_REARM) {
+				s_warned = false;
+			}
+		}
+
+	} // namespace GPUMemory
+} // namespace Graphics
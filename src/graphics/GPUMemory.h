@@ -0,0 +1,53 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#pragma once
+
+#include "core/MemoryTag.h"
+
+namespace Graphics {
+
+	// The GPU memory held by the renderer's resources, by the kind of
+	// resource and by the subsystem that created it: each resource takes the
+	// MemoryTag of its creating thread's scope, and keeps it until it is
+	// destroyed. Sizes are what was asked of the driver, which may round
+	// them up or keep more than one copy.
+	namespace GPUMemory {
+
+		enum Kind : uint8_t {
+			VERTEX_BUFFER,
+			INDEX_BUFFER,
+			INSTANCE_BUFFER,
+			UNIFORM_BUFFER,
+			RENDER_TARGET, // render target attachments, textures included
+			TEXTURE,
+			MAX_KINDS
+		};
+
+		const char *GetKindName(Kind kind);
+
+		// Safe to call from any thread
+		void Allocate(Kind kind, MemoryTag::Tag tag, size_t bytes);
+		void Free(Kind kind, MemoryTag::Tag tag, size_t bytes);
+
+		MemoryTag::Stats GetStats(Kind kind, MemoryTag::Tag tag);
+		// Totals with their own high-water marks: of one kind, and of everything
+		MemoryTag::Stats GetTotal(Kind kind);
+		MemoryTag::Stats GetTotal();
+
+		void ResetHighWater();
+
+		// 0 for no budget. Once a frame ends with the total over
+		// BUDGET_WARNING of it, a warning is logged; it is logged again
+		// after the total went back under BUDGET_REARM.
+		void SetBudget(size_t bytes);
+		size_t GetBudget();
+		bool IsNearBudget();
+		void CheckBudget();
+
+		constexpr double BUDGET_WARNING = 0.9;
+		constexpr double BUDGET_REARM = 0.8;
+
+	} // namespace GPUMemory
+
+} // namespace Graphics
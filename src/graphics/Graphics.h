@@ -35,6 +35,9 @@ namespace Graphics {
 		bool canBeResized;
 		int vsync;
 		int requestedSamples;
+		int shaderCacheMB;
+		int vramBudgetMB; // 0 for none, see GPUMemory::SetBudget()
+		bool uploadThread; // see Renderer::HasUploadThread()
 		int height;
 		int width;
 		const char *iconFile;
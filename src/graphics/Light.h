@@ -41,6 +41,15 @@ namespace Graphics {
 		Color m_specular;
 	};
 
+	// A light of limited reach for the clustered lighting (see
+	// LightClusters), in view space; it falls off to nothing at radius
+	struct PointLight {
+		vector3f position;
+		float radius;
+		Color color;
+		float intensity;
+	};
+
 } // namespace Graphics
 
 #endif
@@ -0,0 +1,134 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "LightClusters.h"
+
+#include "profiler/Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Graphics {
+
+	// a light around the camera reaches this close, which is as good as
+	// covering the whole screen
+	static const float MIN_DEPTH = 1e-4f;
+
+	LightClusters::LightClusters() :
+		m_numLights(0),
+		m_numDropped(0),
+		m_clusters(NUM_CLUSTERS, 0),
+		m_counts(NUM_CLUSTERS, 0)
+	{
+		m_indices.reserve(MAX_INDICES);
+	}
+
+	float LightClusters::GetSliceScale()
+	{
+		return float(SLICES) / std::log(FAR_DEPTH / NEAR_DEPTH);
+	}
+
+	float LightClusters::GetSliceBias()
+	{
+		return -std::log(NEAR_DEPTH) * GetSliceScale();
+	}
+
+	Uint32 LightClusters::GetSlice(float depth)
+	{
+		if (depth <= NEAR_DEPTH)
+			return 0;
+		const float slice = std::log(depth) * GetSliceScale() + GetSliceBias();
+		return std::min(Uint32(slice), SLICES - 1);
+	}
+
+	float LightClusters::GetSliceNear(Uint32 slice)
+	{
+		if (slice == 0)
+			return 0.0f;
+		return NEAR_DEPTH * std::pow(FAR_DEPTH / NEAR_DEPTH, float(slice) / float(SLICES));
+	}
+
+	float LightClusters::GetSliceFar(Uint32 slice)
+	{
+		if (slice >= SLICES - 1)
+			return FAR_DEPTH;
+		return GetSliceNear(slice + 1);
+	}
+
+	bool LightClusters::GetTileRange(float ndcMin, float ndcMax, Uint32 numTiles, Uint32 &first, Uint32 &last)
+	{
+		if (ndcMax < -1.0f || ndcMin > 1.0f)
+			return false;
+		const float scale = 0.5f * float(numTiles);
+		first = Uint32(std::max((ndcMin + 1.0f) * scale, 0.0f));
+		last = std::min(Uint32(std::max((ndcMax + 1.0f) * scale, 0.0f)), numTiles - 1);
+		first = std::min(first, last);
+		return true;
+	}
+
+	void LightClusters::AddLight(const PointLight &light, Uint32 index, float projX, float projY)
+	{
+		// the camera looks down -z
+		const float depth = -light.position.z;
+		const float r = light.radius;
+		const float nearDepth = std::max(depth - r, MIN_DEPTH);
+		const float farDepth = std::min(depth + r, FAR_DEPTH);
+		if (depth + r <= 0.0f || nearDepth > farDepth)
+			return;
+
+		const Uint32 firstSlice = GetSlice(nearDepth);
+		const Uint32 lastSlice = GetSlice(farDepth);
+		for (Uint32 slice = firstSlice; slice <= lastSlice; slice++) {
+			// the box around the light within the slice; x / depth is
+			// monotonic in both, so its extremes are at the corners
+			const float d0 = std::max(nearDepth, GetSliceNear(slice));
+			const float d1 = std::max(std::min(farDepth, GetSliceFar(slice)), d0);
+			const float x0 = light.position.x - r, x1 = light.position.x + r;
+			const float y0 = light.position.y - r, y1 = light.position.y + r;
+
+			Uint32 tx0, tx1, ty0, ty1;
+			if (!GetTileRange(projX * std::min(x0 / d0, x0 / d1), projX * std::max(x1 / d0, x1 / d1), TILES_X, tx0, tx1) ||
+				!GetTileRange(projY * std::min(y0 / d0, y0 / d1), projY * std::max(y1 / d0, y1 / d1), TILES_Y, ty0, ty1))
+				continue;
+
+			for (Uint32 y = ty0; y <= ty1; y++) {
+				for (Uint32 x = tx0; x <= tx1; x++)
+					m_entries.push_back({ GetClusterIndex(x, y, slice), index });
+			}
+		}
+	}
+
+	void LightClusters::Build(const PointLight *lights, Uint32 numLights, float projX, float projY)
+	{
+		PROFILE_SCOPED()
+
+		m_numLights = std::min(numLights, MAX_LIGHTS);
+		m_numDropped = numLights - m_numLights;
+		m_entries.clear();
+		for (Uint32 i = 0; i < m_numLights; i++)
+			AddLight(lights[i], i, projX, projY);
+
+		// counting sort by cluster, keeping the lights in order within one
+		for (const auto &entry : m_entries)
+			m_counts[entry.first]++;
+
+		Uint32 offset = 0;
+		for (Uint32 cluster = 0; cluster < NUM_CLUSTERS; cluster++) {
+			const Uint32 count = std::min({ m_counts[cluster], MAX_LIGHTS_PER_CLUSTER, MAX_INDICES - offset });
+			m_numDropped += m_counts[cluster] - count;
+			m_clusters[cluster] = offset | (count << 24);
+			m_counts[cluster] = 0;
+			offset += count;
+		}
+
+		m_indices.resize(offset);
+		for (const auto &entry : m_entries) {
+			const Uint32 cluster = m_clusters[entry.first];
+			Uint32 &filled = m_counts[entry.first];
+			if (filled < GetClusterCount(cluster))
+				m_indices[GetClusterOffset(cluster) + filled++] = entry.second;
+		}
+		std::fill(m_counts.begin(), m_counts.end(), 0);
+	}
+
+} // namespace Graphics
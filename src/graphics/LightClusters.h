@@ -0,0 +1,90 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _GRAPHICS_LIGHTCLUSTERS_H
+#define _GRAPHICS_LIGHTCLUSTERS_H
+
+#include "Light.h"
+
+#include <SDL_stdinc.h>
+#include <vector>
+
+namespace Graphics {
+
+	// The point lights of a frame binned into clusters of the view: TILES_X
+	// by TILES_Y tiles of the screen, each cut into SLICES in depth that
+	// grow exponentially from NEAR_DEPTH to FAR_DEPTH (the first one starts
+	// at the camera). A fragment finds its cluster from gl_FragCoord and its
+	// view depth, and lights itself with only the lights listed for it, so
+	// a draw costs the same however many lights there are elsewhere.
+	//
+	// The renderer uploads the result once per SetPointLights() to three
+	// uniform blocks, which any shader may declare:
+	//   PointLightData   { vec4 clusterParams; PointLight lights[MAX_LIGHTS]; }
+	//                    with PointLight { vec4 positionRadius; vec4 color; }
+	//                    slice = clamp(int(log(depth) * clusterParams.x +
+	//                    clusterParams.y), 0, SLICES - 1); zw are the tiles
+	//   LightClusterData { uvec4 clusters[NUM_CLUSTERS / 4]; }
+	//                    offset into the indices in the low 24 bits of a
+	//                    cluster, number of lights in the high 8
+	//   LightIndexData   { uvec4 indices[MAX_INDICES / 4]; }
+	// Tiles count from the bottom left, as gl_FragCoord does.
+	class LightClusters {
+	public:
+		static constexpr Uint32 TILES_X = 16;
+		static constexpr Uint32 TILES_Y = 8;
+		static constexpr Uint32 SLICES = 16;
+		static constexpr Uint32 NUM_CLUSTERS = TILES_X * TILES_Y * SLICES;
+		// sized for the 16KB a uniform block is sure to have
+		static constexpr Uint32 MAX_LIGHTS = 256;
+		static constexpr Uint32 MAX_INDICES = 4096;
+		static constexpr Uint32 MAX_LIGHTS_PER_CLUSTER = 255;
+		static constexpr float NEAR_DEPTH = 1.0f;
+		static constexpr float FAR_DEPTH = 1e5f;
+
+		LightClusters();
+
+		// projX and projY scale view space x / depth and y / depth to
+		// normalised device coordinates, elements 0 and 5 of a perspective
+		// projection. Lights past MAX_LIGHTS are left out.
+		void Build(const PointLight *lights, Uint32 numLights, float projX, float projY);
+
+		Uint32 GetNumLights() const { return m_numLights; }
+		const std::vector<Uint32> &GetClusters() const { return m_clusters; }
+		const std::vector<Uint32> &GetIndices() const { return m_indices; }
+		// lights and cluster entries that didn't fit
+		Uint32 GetNumDropped() const { return m_numDropped; }
+
+		// for the clusterParams of the shaders
+		static float GetSliceScale();
+		static float GetSliceBias();
+
+		static Uint32 GetSlice(float depth);
+		// where the slice starts and ends in view depth
+		static float GetSliceNear(Uint32 slice);
+		static float GetSliceFar(Uint32 slice);
+		static Uint32 GetClusterIndex(Uint32 x, Uint32 y, Uint32 slice) { return (slice * TILES_Y + y) * TILES_X + x; }
+
+		static Uint32 GetClusterOffset(Uint32 cluster) { return cluster & 0xffffff; }
+		static Uint32 GetClusterCount(Uint32 cluster) { return cluster >> 24; }
+
+	private:
+		// the tiles covered by an extent in normalised device coordinates,
+		// false if it is off the screen
+		static bool GetTileRange(float ndcMin, float ndcMax, Uint32 numTiles, Uint32 &first, Uint32 &last);
+
+		void AddLight(const PointLight &light, Uint32 index, float projX, float projY);
+
+		Uint32 m_numLights;
+		Uint32 m_numDropped;
+		std::vector<Uint32> m_clusters;
+		std::vector<Uint32> m_indices;
+		// (cluster, light) pairs, sorted into m_indices by cluster
+		std::vector<std::pair<Uint32, Uint32>> m_entries;
+		// entries per cluster while sorting, zero in between
+		std::vector<Uint32> m_counts;
+	};
+
+} // namespace Graphics
+
+#endif
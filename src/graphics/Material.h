@@ -161,6 +161,8 @@ namespace Graphics {
 		virtual bool IsProgramLoaded() const = 0;
 
 		virtual bool SetTexture(size_t hash, Texture *tex) = 0;
+		// Returns the texture bound to the given name, or nullptr
+		virtual Texture *GetTexture(size_t hash) const = 0;
 
 		// Upload the passed data and assign it to the specified buffer binding point.
 		// The data will live until the end of the frame and its lifetime does not need
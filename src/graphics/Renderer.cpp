@@ -3,10 +3,13 @@
 
 #include "Renderer.h"
 #include "Texture.h"
+#include "VertexBuffer.h"
 #include "jenkins/lookup3.h"
 
 #include <SDL.h>
 
+#include <algorithm>
+
 namespace Graphics {
 
 	Renderer::Renderer(SDL_Window *window, int w, int h) :
@@ -44,6 +47,27 @@ namespace Graphics {
 		m_textureCache.erase(i);
 	}
 
+	RefCountedPtr<UploadTicket> Renderer::UploadVertexBuffer(VertexBuffer *buffer, std::vector<Uint8> &&data)
+	{
+		assert(data.size() == buffer->GetDesc().numVertices * buffer->GetDesc().stride);
+		Uint8 *dst = buffer->Map<Uint8>(BUFFER_MAP_WRITE);
+		std::copy(data.begin(), data.end(), dst);
+		buffer->Unmap();
+
+		RefCountedPtr<UploadTicket> ticket(new UploadTicket());
+		ticket->SetDone();
+		return ticket;
+	}
+
+	RefCountedPtr<UploadTicket> Renderer::UploadTexture(Texture *texture, std::function<void(Texture *)> upload)
+	{
+		upload(texture);
+
+		RefCountedPtr<UploadTicket> ticket(new UploadTicket());
+		ticket->SetDone();
+		return ticket;
+	}
+
 	void Renderer::RemoveAllCachedTextures()
 	{
 		for (TextureCacheMap::iterator i = m_textureCache.begin(); i != m_textureCache.end(); ++i)
@@ -11,8 +11,10 @@
 #include "core/StringHash.h"
 #include "graphics/BufferCommon.h"
 #include "matrix4x4.h"
+#include <functional>
 #include <map>
 #include <memory>
+#include <vector>
 
 struct SDL_Window;
 
@@ -40,6 +42,24 @@ namespace Graphics {
 	struct RenderStateDesc;
 	struct RenderTargetDesc;
 
+	// Tells the owner of an upload when its data has reached the GPU and
+	// the resource can be drawn. Owners poll it rather than being called
+	// back, so they may go away with uploads still in flight.
+	class UploadTicket : public RefCounted {
+	public:
+		bool IsDone() const { return m_done; }
+		void SetDone() { m_done = true; }
+
+	private:
+		bool m_done = false;
+	};
+
+	// Draw commands recorded on a worker thread, see Renderer::CreateRecording()
+	class CommandRecording {
+	public:
+		virtual ~CommandRecording() {}
+	};
+
 	// Renderer base, functions return false if
 	// failed/unsupported
 	class Renderer {
@@ -125,6 +145,11 @@ namespace Graphics {
 			return m_lights[idx];
 		}
 		virtual Uint32 GetNumLights() const { return 0; }
+		// The point lights of the view for the clustered lighting (see
+		// LightClusters), in view space of the current projection. They stay
+		// until the next call, which replaces them.
+		virtual void SetPointLights(Uint32 numLights, const PointLight *lights) {}
+		virtual Uint32 GetNumPointLights() const { return 0; }
 		virtual bool SetAmbientColor(const Color &c) = 0;
 		const Color &GetAmbientColor() const { return m_ambient; }
 
@@ -151,6 +176,35 @@ namespace Graphics {
 		virtual bool DrawMesh(MeshObject *, Material *) = 0;
 		// Draw multiple instances of a mesh object using the given material.
 		virtual bool DrawMeshInstanced(MeshObject *, Material *, InstanceBuffer *) = 0;
+		// Draw a single mesh object that could also be drawn instanced with
+		// instancedMaterial, a clone of the material with
+		// MaterialDescriptor::instanced set. The renderer may merge draws of
+		// the same mesh and material state into one instanced draw call.
+		virtual bool DrawMeshBatched(MeshObject *mesh, Material *material, Material *instancedMaterial) { return DrawMesh(mesh, material); }
+
+		// Recording draw commands on other threads, e.g. to spread scene
+		// traversal and material setup over a TaskGraph. A recording keeps the
+		// projection, lights and ambient colour the renderer has when it is
+		// created. While it is bound to a thread, the SetTransform(),
+		// GetTransform(), DrawBufferDynamic() and DrawMesh*() calls made on that
+		// thread go into the recording; nothing else may be called there, and
+		// the materials drawn must not be changed until it is submitted.
+		// Returns nullptr if the renderer can only record on the render thread.
+		virtual std::unique_ptr<CommandRecording> CreateRecording() { return {}; }
+		// Bind a recording to the calling thread, or go back to drawing
+		// directly if null
+		virtual void BindRecording(CommandRecording *rec) {}
+		// Append a finished recording to everything drawn so far. Called on
+		// the render thread; recordings are merged in the order they are
+		// submitted, whatever order they were recorded in.
+		virtual void SubmitRecording(std::unique_ptr<CommandRecording> rec) {}
+
+		// Measure the GPU time of everything drawn between BeginGPUTimer and
+		// EndGPUTimer. Scopes may nest and the name must be a string literal;
+		// the timings show up in GetStats() a few frames later. Call these on
+		// the render thread only, not in a recording.
+		virtual void BeginGPUTimer(const char *name) {}
+		virtual void EndGPUTimer() {}
 
 		//creates a unique material based on the descriptor. It will not be deleted automatically.
 		virtual Material *CreateMaterial(const std::string &shader, const MaterialDescriptor &descriptor, const RenderStateDesc &stateDescriptor) = 0;
@@ -158,8 +212,9 @@ namespace Graphics {
 		virtual Material *CloneMaterial(const Material *mat, const MaterialDescriptor &descriptor, const RenderStateDesc &stateDescriptor) = 0;
 		virtual Texture *CreateTexture(const TextureDescriptor &descriptor) = 0;
 		virtual RenderTarget *CreateRenderTarget(const RenderTargetDesc &) = 0; //returns nullptr if unsupported
-		virtual VertexBuffer *CreateVertexBuffer(const VertexBufferDesc &) = 0;
-		virtual IndexBuffer *CreateIndexBuffer(Uint32 size, BufferUsage, IndexBufferSize = INDEX_BUFFER_32BIT) = 0;
+		// data, if given, is the initial contents of the whole buffer
+		virtual VertexBuffer *CreateVertexBuffer(const VertexBufferDesc &, const void *data = nullptr) = 0;
+		virtual IndexBuffer *CreateIndexBuffer(Uint32 size, BufferUsage, IndexBufferSize = INDEX_BUFFER_32BIT, const void *data = nullptr) = 0;
 		virtual InstanceBuffer *CreateInstanceBuffer(Uint32 size, BufferUsage) = 0;
 		virtual UniformBuffer *CreateUniformBuffer(Uint32 size, BufferUsage) = 0;
 
@@ -171,6 +226,19 @@ namespace Graphics {
 		// This function is not suitable for transient geometry; prefer DrawBuffer instead.
 		virtual MeshObject *CreateMeshObjectFromArray(const VertexArray *vertexArray, IndexBuffer *indexBuffer = nullptr, BufferUsage usage = BUFFER_USAGE_STATIC) = 0;
 
+		// Bulk uploads that may be made on an upload thread of the
+		// renderer's, off the frame. The ticket is done in a later
+		// BeginFrame(), once the GPU has the data; until then the resource
+		// must not be drawn or written to again. Without an upload thread
+		// the upload is made at once and the ticket is done on return.
+		virtual bool HasUploadThread() const { return false; }
+		// Replace the whole of a static vertex buffer with data
+		virtual RefCountedPtr<UploadTicket> UploadVertexBuffer(VertexBuffer *buffer, std::vector<Uint8> &&data);
+		// Call upload with the texture, on the upload thread if there is
+		// one; it may only call the texture's Update() functions, from data
+		// it owns
+		virtual RefCountedPtr<UploadTicket> UploadTexture(Texture *texture, std::function<void(Texture *)> upload);
+
 		// Return a reference to the render state desc that is used by the given material.
 		virtual const RenderStateDesc &GetMaterialRenderState(const Material *mat) = 0;
 
@@ -182,6 +250,9 @@ namespace Graphics {
 		const TextureCache &GetTextureCache() { return m_textureCache; }
 
 		virtual bool ReloadShaders() = 0;
+		// Build the shader variants used in earlier sessions, so they don't
+		// have to be built the first time something is drawn with them
+		virtual void PrewarmShaders() = 0;
 
 		// take a ticket representing the current renderer state. when the ticket
 		// is deleted, the renderer state is restored
@@ -246,6 +317,27 @@ namespace Graphics {
 			matrix4x4f m_storedMat;
 		};
 
+		// Time the GPU work of the commands issued while the ticket exists
+		class GPUTimerTicket {
+		public:
+			GPUTimerTicket(Renderer *r, const char *name) :
+				m_renderer(r)
+			{
+				m_renderer->BeginGPUTimer(name);
+			}
+
+			~GPUTimerTicket()
+			{
+				m_renderer->EndGPUTimer();
+			}
+
+			GPUTimerTicket(const GPUTimerTicket &) = delete;
+			GPUTimerTicket &operator=(const GPUTimerTicket &) = delete;
+
+		private:
+			Renderer *m_renderer;
+		};
+
 		virtual bool Screendump(ScreendumpState &sd) { return false; }
 
 		Stats &GetStats() { return m_stats; }
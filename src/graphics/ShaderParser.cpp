@@ -2,10 +2,13 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "ShaderParser.h"
+#include "FileSystem.h"
+#include "core/FNV1a.h"
 #include "core/Log.h"
 #include "utils.h"
 
 #include <cctype>
+#include <set>
 #include <string_view>
 
 using namespace Graphics::ShaderParser;
@@ -438,3 +441,135 @@ bool Parser::advanceIfLineRemaining()
 
 	return didAdvance;
 }
+
+// ====================================================================
+// Source Cache
+//
+
+SourceCache::SourceCache(ReadFn read) :
+	m_read(std::move(read)),
+	m_generation(1),
+	m_numReads(0),
+	m_numParses(0)
+{
+}
+
+SourceCache &SourceCache::Get()
+{
+	static SourceCache s_cache([](const std::string &path, std::string &out) {
+		RefCountedPtr<FileSystem::FileData> data = FileSystem::gameDataFiles.ReadFile(path);
+		if (!data.Valid())
+			return false;
+
+		out.assign(data->GetData(), data->GetSize());
+		return true;
+	});
+
+	return s_cache;
+}
+
+const SourceCache::File *SourceCache::ReadFile(const std::string &path)
+{
+	File &file = m_files[path];
+	if (file.generation != m_generation) {
+		file.generation = m_generation;
+		file.valid = m_read(path, file.data);
+		file.hash = file.valid ? hash_64_fnv1a(file.data.data(), file.data.size()) : 0;
+		m_numReads++;
+	}
+
+	return file.valid ? &file : nullptr;
+}
+
+bool SourceCache::IsCurrent(const Dependencies &dependencies)
+{
+	for (const auto &dep : dependencies) {
+		const File *file = ReadFile(dep.first);
+		if (!file || file->hash != dep.second)
+			return false;
+	}
+
+	return true;
+}
+
+bool SourceCache::GetShaderInfo(const std::string &path, ShaderInfo &info)
+{
+	const File *file = ReadFile(path);
+	if (!file)
+		return false;
+
+	auto iter = m_definitions.find(path);
+	if (iter == m_definitions.end() || iter->second.hash != file->hash) {
+		ShaderInfo parsed = Parser().Parse(path.substr(path.find_last_of('/') + 1), file->data);
+		iter = m_definitions.insert_or_assign(path, DefinitionEntry{ std::move(parsed), file->hash }).first;
+		m_numParses++;
+	}
+
+	info = iter->second.info;
+	return true;
+}
+
+std::shared_ptr<const std::string> SourceCache::GetExpandedSource(const std::string &path, const std::string &includeDir)
+{
+	const std::string key = includeDir + "\n" + path;
+
+	auto iter = m_sources.find(key);
+	if (iter != m_sources.end() && IsCurrent(iter->second.dependencies))
+		return iter->second.source;
+
+	Dependencies dependencies;
+	std::shared_ptr<const std::string> source = Expand(path, includeDir, dependencies);
+	if (!source) {
+		m_sources.erase(key);
+		return nullptr;
+	}
+
+	m_sources[key] = { source, std::move(dependencies) };
+	return source;
+}
+
+std::shared_ptr<const std::string> SourceCache::Expand(const std::string &path, const std::string &includeDir, Dependencies &dependencies)
+{
+	const File *file = ReadFile(path);
+	if (!file) {
+		Log::Warning("Could not load shader source {}\n", path);
+		return nullptr;
+	}
+
+	dependencies.push_back({ path, file->hash });
+
+	std::string code = file->data;
+	std::set<std::string> previousIncludes;
+
+	// included files can include others in turn, so search from the start
+	// again after each one
+	size_t found = code.find("#include");
+	while (found != std::string::npos) {
+		// find the name of the file to include
+		const size_t begFilename = code.find_first_of("\"", found + 8) + 1;
+		const size_t endFilename = code.find_first_of("\"", begFilename + 1);
+
+		const std::string incFilename = code.substr(begFilename, endFilename - begFilename);
+
+		// check we haven't it already included it (avoids circular dependencies)
+		if (!previousIncludes.insert(incFilename).second) {
+			Log::Warning("Circular, or multiple, include of {} in shader {}\n", incFilename, path);
+			return nullptr;
+		}
+
+		const std::string incPath = includeDir + "/" + incFilename;
+		const File *incFile = ReadFile(incPath);
+		if (!incFile) {
+			Log::Warning("Could not load shader #include {} for shader {}\n", incPath, path);
+			return nullptr;
+		}
+
+		dependencies.push_back({ incPath, incFile->hash });
+
+		// replace the #include and filename with the included files text
+		code.replace(found, (endFilename + 1) - found, incFile->data);
+		found = code.find("#include");
+	}
+
+	return std::make_shared<const std::string>(std::move(code));
+}
@@ -7,6 +7,8 @@
 #include "graphics/Types.h"
 
 #include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -138,6 +140,76 @@ namespace Graphics {
 			std::unique_ptr<Tokenizer> m_tokenizer;
 		};
 
+		// Keeps the parsed shaderdef files and the shader sources with their
+		// #includes expanded, so creating shaders and their variants doesn't
+		// read and parse the same files over and over.
+		//
+		// Each entry remembers the hash of every file it was built from. After
+		// Revalidate() each file is read again the next time it is needed, and
+		// only the entries built from files that changed are rebuilt.
+		class SourceCache {
+		public:
+			// reads the whole file at path into out, returning false if it can't
+			using ReadFn = std::function<bool(const std::string &path, std::string &out)>;
+
+			explicit SourceCache(ReadFn read);
+
+			// the cache of the renderer, reading from the game data
+			static SourceCache &Get();
+
+			// Fills in the parsed definition of the shaderdef file at path;
+			// returns false if the file can't be read
+			bool GetShaderInfo(const std::string &path, ShaderInfo &info);
+
+			// The file at path with each #include "name" replaced by the file
+			// includeDir/name, itself expanded. Returns null if the file or an
+			// include can't be read, or a file is included more than once.
+			std::shared_ptr<const std::string> GetExpandedSource(const std::string &path, const std::string &includeDir);
+
+			// Have the entries check whether their files changed when next used
+			void Revalidate() { m_generation++; }
+
+			// the number of times a file was read and a definition was parsed
+			size_t GetNumReads() const { return m_numReads; }
+			size_t GetNumParses() const { return m_numParses; }
+
+		private:
+			struct File {
+				std::string data;
+				uint64_t hash = 0;
+				uint32_t generation = 0;
+				bool valid = false;
+			};
+
+			// the files an entry was built from, with their hashes at the time
+			typedef std::vector<std::pair<std::string, uint64_t>> Dependencies;
+
+			struct DefinitionEntry {
+				ShaderInfo info;
+				uint64_t hash;
+			};
+
+			struct SourceEntry {
+				std::shared_ptr<const std::string> source;
+				Dependencies dependencies;
+			};
+
+			// the file as of the current generation, or null if it can't be read
+			const File *ReadFile(const std::string &path);
+			bool IsCurrent(const Dependencies &dependencies);
+			std::shared_ptr<const std::string> Expand(const std::string &path, const std::string &includeDir, Dependencies &dependencies);
+
+			ReadFn m_read;
+			uint32_t m_generation;
+
+			std::map<std::string, File> m_files;
+			std::map<std::string, DefinitionEntry> m_definitions;
+			std::map<std::string, SourceEntry> m_sources;
+
+			size_t m_numReads;
+			size_t m_numParses;
+		};
+
 	} // namespace ShaderParser
 
 } // namespace Graphics
@@ -27,10 +27,21 @@ namespace Graphics {
 			GetOrCreateCounter("Num Uniform Draw Buffer Suballocs"),
 			GetOrCreateCounter("Dynamic Draw Buffers In Use"),
 			GetOrCreateCounter("Dynamic Draw Buffers Created", false),
+			GetOrCreateCounter("Dynamic Draw Bytes Streamed"),
 
 			GetOrCreateCounter("Num Cached Render States"),
 			GetOrCreateCounter("Num Cached Shader Programs"),
 			GetOrCreateCounter("Num CommandList Flushes"),
+			GetOrCreateCounter("Program Switches"),
+			GetOrCreateCounter("Program Switches Before Sorting"),
+			GetOrCreateCounter("Render State Switches"),
+			GetOrCreateCounter("Render State Switches Before Sorting"),
+			GetOrCreateCounter("Draw Calls Merged By Instancing"),
+			GetOrCreateCounter("Point Lights"),
+			GetOrCreateCounter("Point Light Cluster Indices"),
+			GetOrCreateCounter("Point Lights Dropped"),
+			GetOrCreateCounter("Threaded Uploads Finished"),
+			GetOrCreateCounter("Threaded Uploads In Flight", false),
 
 			GetOrCreateCounter("Num Buildings"),
 			GetOrCreateCounter("Num Cities"),
@@ -50,10 +61,33 @@ namespace Graphics {
 			GetOrCreateCounter("TextureCube Count", false),
 			GetOrCreateCounter("TextureCube Memory Used", false),
 			GetOrCreateCounter("TextureArray2D Count", false),
-			GetOrCreateCounter("TextureArray2D Memory Used", false)
+			GetOrCreateCounter("TextureArray2D Memory Used", false),
+			GetOrCreateCounter("Streamed Texture Memory Used", false),
+			GetOrCreateCounter("Streamed Texture Mip Loads", false),
+			GetOrCreateCounter("GeoPatch Pool Memory Used", false),
+			GetOrCreateCounter("GeoPatch Pool Memory Peak", false),
+			GetOrCreateCounter("GeoPatch Pool Memory Free", false),
+			GetOrCreateCounter("GeoPatch Splits Prefetched", false),
+			GetOrCreateCounter("GeoPatch Splits Cancelled", false),
+			GetOrCreateCounter("GeoPatch Meshes Pooled", false),
+			GetOrCreateCounter("GeoPatch Meshes Reused"),
+			GetOrCreateCounter("GeoPatches Drawn"),
+			GetOrCreateCounter("GeoPatches Culled by Frustum"),
+			GetOrCreateCounter("GeoPatches Culled by Horizon"),
+			GetOrCreateCounter("Approach Prefetch Hits", false),
+			GetOrCreateCounter("Approach Prefetch Misses", false)
 		};
 	}
 
+	void Stats::SetNamedStatCount(const std::string &name, const uint32_t count)
+	{
+		auto iter = m_namedCounterRefs.find(name);
+		if (iter == m_namedCounterRefs.end())
+			iter = m_namedCounterRefs.emplace(name, GetOrCreateCounter(name, false)).first;
+
+		CounterSet(iter->second, count);
+	}
+
 	void Stats::NextFrame()
 	{
 		Perf::Stats::FlushFrame();
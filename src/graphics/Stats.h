@@ -7,6 +7,8 @@
 #include "PerfStats.h"
 
 #include "SDL_stdinc.h"
+#include <map>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -34,10 +36,21 @@ namespace Graphics {
 			STAT_DRAW_UNIFORM_BUFFER_ALLOCS,
 			STAT_DYNAMIC_DRAW_BUFFER_INUSE,
 			STAT_DYNAMIC_DRAW_BUFFER_CREATED,
+			STAT_DYNAMIC_DRAW_BUFFER_BYTES,
 
 			STAT_NUM_RENDER_STATES,
 			STAT_NUM_SHADER_PROGRAMS,
 			STAT_NUM_CMDLIST_FLUSHES,
+			STAT_PROGRAM_SWITCHES,
+			STAT_PROGRAM_SWITCHES_UNSORTED,
+			STAT_RENDER_STATE_SWITCHES,
+			STAT_RENDER_STATE_SWITCHES_UNSORTED,
+			STAT_DRAWCALLS_BATCHED,
+			STAT_POINT_LIGHTS,
+			STAT_POINT_LIGHT_INDICES,
+			STAT_POINT_LIGHTS_DROPPED,
+			STAT_UPLOADS_FINISHED,
+			STAT_UPLOADS_IN_FLIGHT,
 
 			// objects
 			STAT_BUILDINGS,
@@ -61,6 +74,20 @@ namespace Graphics {
 			STAT_MEM_TEXTURECUBE,
 			STAT_NUM_TEXTUREARRAY2D,
 			STAT_MEM_TEXTUREARRAY2D,
+			STAT_MEM_TEXTURE_STREAMED,
+			STAT_TEXTURE_MIP_LOADS,
+			STAT_MEM_GEOPATCH_POOL_INUSE,
+			STAT_MEM_GEOPATCH_POOL_PEAK,
+			STAT_MEM_GEOPATCH_POOL_FREE,
+			STAT_GEOPATCH_SPLITS_PREFETCHED,
+			STAT_GEOPATCH_SPLITS_CANCELLED,
+			STAT_GEOPATCH_MESHES_POOLED,
+			STAT_GEOPATCH_MESHES_REUSED,
+			STAT_GEOPATCH_DRAWN,
+			STAT_GEOPATCH_CULLED_FRUSTUM,
+			STAT_GEOPATCH_CULLED_HORIZON,
+			STAT_APPROACH_PREFETCH_HITS,
+			STAT_APPROACH_PREFETCH_MISSES,
 
 			MAX_STAT
 		};
@@ -69,6 +96,13 @@ namespace Graphics {
 			uint32_t m_stats[MAX_STAT];
 		};
 
+		// GPU time of a named timer scope, see Renderer::BeginGPUTimer()
+		struct GPUTiming {
+			const char *name;
+			uint32_t depth;
+			float milliseconds;
+		};
+
 		Stats();
 		~Stats() {}
 
@@ -87,16 +121,27 @@ namespace Graphics {
 			CounterSet(m_counterRefs.at(type), count);
 		}
 
+		// Set a counter which isn't one of the predefined StatTypes, creating
+		// it on first use. Named counters are not reset each frame.
+		void SetNamedStatCount(const std::string &name, const uint32_t count);
+
 		void NextFrame();
 
 		const TFrameData &FrameStatsPrevious() const;
 		const FrameInfo &GetFullStats() const { return GetFrameStats(); }
 
+		// Timer scopes of the most recent frame the GPU has finished, in the
+		// order they were opened
+		void SetGPUTimings(const std::vector<GPUTiming> &timings) { m_gpuTimings = timings; }
+		const std::vector<GPUTiming> &GetGPUTimings() const { return m_gpuTimings; }
+
 	private:
 		TFrameData m_frameStats[MAX_FRAMES_STORE];
 		Uint32 m_currentFrame;
 
 		std::vector<Perf::Stats::CounterRef> m_counterRefs;
+		std::map<std::string, Perf::Stats::CounterRef> m_namedCounterRefs;
+		std::vector<GPUTiming> m_gpuTimings;
 	};
 
 } // namespace Graphics
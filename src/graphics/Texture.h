@@ -118,6 +118,16 @@ namespace Graphics {
 		virtual void BuildMipmaps(const uint32_t validMips = 1) = 0;
 		virtual uint32_t GetTextureID() const = 0;
 		virtual uint32_t GetTextureMemSize() const = 0;
+		// Copy the top mip level of an uncompressed RGBA texture (one face of a
+		// cubemap) into data, which must hold dataSize.x * dataSize.y * 4 bytes.
+		// This stalls the GPU, so only do it for one-off results.
+		// Returns false if the texture can't be read back.
+		virtual bool ReadPixels(void *data, uint32_t face = 0) { return false; }
+		// Replace the mips of a compressed 2D texture with the chain from
+		// firstMip down, so the texture only takes up the memory of the mips
+		// uploaded. data is laid out as in a DDS file, starting at firstMip.
+		// Returns false if the texture doesn't support this.
+		virtual bool SetResidentMips(const void *data, uint32_t firstMip) { return false; }
 
 		virtual void Bind() = 0;
 		virtual void Unbind() = 0;
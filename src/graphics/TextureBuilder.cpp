@@ -2,13 +2,18 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "TextureBuilder.h"
+#include "BlockCompression.h"
+#include "DiskCache.h"
 #include "FileSystem.h"
 #include "MathUtil.h"
+#include "TextureStreamer.h"
+#include "core/FNV1a.h"
 #include "profiler/Profiler.h"
 #include "utils.h"
 #include <SDL_image.h>
 #include <SDL_rwops.h>
 #include <algorithm>
+#include <cstring>
 #include <sstream>
 
 namespace Graphics {
@@ -16,6 +21,20 @@ namespace Graphics {
 	//static
 	SDL_mutex *TextureBuilder::m_textureLock = nullptr;
 
+	// Textures compressed on load, keyed by the contents of their file and
+	// the builder options that change the result. Bump the version when the
+	// encoder or the layout of the entries changes.
+	static const Uint32 COMPRESSED_CACHE_VERSION = 1;
+	static DiskCache s_compressedCache("texture_cache", COMPRESSED_CACHE_VERSION);
+	static bool s_compressOnLoad = false;
+
+	struct CompressedHeader {
+		uint32_t width, height;
+		uint32_t virtualWidth, virtualHeight;
+		uint32_t format;
+		uint32_t numMips;
+	};
+
 	TextureBuilder::TextureBuilder(const SDLSurfacePtr &surface, TextureSampleMode sampleMode, bool generateMipmaps, bool potExtend, bool forceRGBA, bool compressTextures, bool anisoFiltering) :
 		m_surface(surface),
 		m_sampleMode(sampleMode),
@@ -26,6 +45,7 @@ namespace Graphics {
 		m_anisotropicFiltering(anisoFiltering),
 		m_textureType(TEXTURE_2D),
 		m_layers(1),
+		m_streamed(false),
 		m_prepared(false)
 	{
 	}
@@ -39,6 +59,7 @@ namespace Graphics {
 		m_anisotropicFiltering(anisoFiltering),
 		m_textureType(textureType),
 		m_layers(layers),
+		m_streamed(false),
 		m_prepared(false)
 	{
 		m_filenames.push_back(filename);
@@ -54,6 +75,7 @@ namespace Graphics {
 		m_anisotropicFiltering(anisoFiltering),
 		m_textureType(textureType),
 		m_layers(layers),
+		m_streamed(false),
 		m_prepared(false)
 	{
 		assert(!m_filenames.empty());
@@ -68,6 +90,19 @@ namespace Graphics {
 		m_textureLock = SDL_CreateMutex();
 	}
 
+	void TextureBuilder::InitCompression(bool enabled, size_t cacheBytes)
+	{
+		s_compressOnLoad = enabled;
+		if (enabled)
+			s_compressedCache.Init(cacheBytes);
+	}
+
+	void TextureBuilder::UninitCompression()
+	{
+		s_compressOnLoad = false;
+		s_compressedCache.Uninit();
+	}
+
 // RGBA and RGBpixel format for converting textures
 // XXX little-endian. if we ever have a port to a big-endian arch, invert shift and mask
 #if SDL_BYTEORDER != SDL_LIL_ENDIAN
@@ -131,11 +166,17 @@ namespace Graphics {
 		PROFILE_SCOPED()
 		if (m_prepared) return;
 
+		uint64_t compressKey = 0;
 		if (!m_surface && !m_filenames.empty()) {
 			std::string filename = m_filenames.front();
 			std::transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
 			if (ends_with_ci(filename, ".dds")) {
 				LoadDDS();
+			} else if (s_compressOnLoad && m_compressTextures && m_textureType == TEXTURE_2D) {
+				if (LoadCompressed(compressKey)) {
+					m_prepared = true;
+					return;
+				}
 			} else {
 				LoadSurface();
 			}
@@ -201,6 +242,13 @@ namespace Graphics {
 				if (width != virtualWidth || height != virtualHeight)
 					Output("WARNING: texture '%s' is not power-of-two and may not display correctly\n", m_filenames.front().c_str());
 			}
+
+			// blocks can't straddle the edge of the top mip
+			if (compressKey && actualWidth % 4 == 0 && actualHeight % 4 == 0) {
+				CompressSurface(compressKey, virtualWidth, virtualHeight);
+				m_prepared = true;
+				return;
+			}
 		} else {
 			if (m_textureType != TEXTURE_2D_ARRAY) {
 				switch (m_dds.GetTextureFormat()) {
@@ -289,6 +337,84 @@ namespace Graphics {
 		m_surface = s;
 	}
 
+	bool TextureBuilder::LoadCompressed(uint64_t &cacheKey)
+	{
+		PROFILE_SCOPED()
+		assert(!m_surface);
+		RefCountedPtr<FileSystem::FileData> filedata = FileSystem::gameDataFiles.ReadFile(m_filenames.front());
+		if (!filedata) {
+			LoadSurface();
+			return false;
+		}
+
+		const uint64_t key[2] = {
+			hash_64_fnv1a(filedata->GetData(), filedata->GetSize()),
+			uint64_t(m_potExtend) | uint64_t(m_forceRGBA) << 1 | uint64_t(m_generateMipmaps) << 2
+		};
+		cacheKey = hash_64_fnv1a(reinterpret_cast<const char *>(key), sizeof(key));
+		cacheKey = cacheKey ? cacheKey : 1;
+
+		std::string data;
+		if (s_compressedCache.Load(cacheKey, data)) {
+			CompressedHeader header;
+			bool valid = data.size() >= sizeof(header);
+			if (valid) {
+				memcpy(&header, data.data(), sizeof(header));
+				const TextureFormat format = TextureFormat(header.format);
+				valid = (format == TEXTURE_DXT1 || format == TEXTURE_DXT5) && header.numMips > 0 &&
+					data.size() == sizeof(header) + BlockCompression::GetCompressedSize(format, header.width, header.height, header.numMips);
+			}
+
+			if (valid) {
+				m_compressed.assign(data.begin() + sizeof(header), data.end());
+				m_descriptor = TextureDescriptor(
+					TextureFormat(header.format),
+					vector3f(header.width, header.height, m_layers),
+					vector2f(float(header.virtualWidth) / float(header.width), float(header.virtualHeight) / float(header.height)),
+					m_sampleMode, m_generateMipmaps, m_compressTextures, m_anisotropicFiltering, header.numMips, m_textureType);
+				return true;
+			}
+			s_compressedCache.Remove(cacheKey);
+		}
+
+		SDL_RWops *datastream = SDL_RWFromConstMem(filedata->GetData(), filedata->GetSize());
+		SDL_Surface *surface = IMG_Load_RW(datastream, 1);
+		if (!surface) {
+			Output("LoadCompressed: %s: %s\n", m_filenames.front().c_str(), IMG_GetError());
+			cacheKey = 0;
+			LoadSurface();
+			return false;
+		}
+		m_surface = SDLSurfacePtr::WrapNew(surface);
+		return false;
+	}
+
+	void TextureBuilder::CompressSurface(uint64_t cacheKey, uint32_t virtualWidth, uint32_t virtualHeight)
+	{
+		PROFILE_SCOPED()
+		const uint8_t *pixels = static_cast<const uint8_t *>(m_surface->pixels);
+		const uint32_t bytesPerPixel = m_surface->format->BytesPerPixel;
+		const TextureFormat format = BlockCompression::ChooseFormat(pixels, m_surface->w, m_surface->h, m_surface->pitch, bytesPerPixel);
+		const uint32_t numMips = BlockCompression::CompressImage(pixels, m_surface->w, m_surface->h, m_surface->pitch, bytesPerPixel,
+			format, m_generateMipmaps, m_compressed);
+
+		const CompressedHeader header = { uint32_t(m_surface->w), uint32_t(m_surface->h), virtualWidth, virtualHeight, uint32_t(format), numMips };
+		if (s_compressedCache.IsEnabled()) {
+			std::string data(reinterpret_cast<const char *>(&header), sizeof(header));
+			data.append(reinterpret_cast<const char *>(m_compressed.data()), m_compressed.size());
+			s_compressedCache.Store(cacheKey, data);
+		}
+
+		m_descriptor = TextureDescriptor(
+			format,
+			vector3f(header.width, header.height, m_layers),
+			vector2f(float(virtualWidth) / float(header.width), float(virtualHeight) / float(header.height)),
+			m_sampleMode, m_generateMipmaps, m_compressTextures, m_anisotropicFiltering, numMips, m_textureType);
+
+		// the compressed mips replace the pixels
+		m_surface = SDLSurfacePtr();
+	}
+
 	void TextureBuilder::LoadDDS()
 	{
 		PROFILE_SCOPED()
@@ -314,7 +440,10 @@ namespace Graphics {
 
 	void TextureBuilder::UpdateTexture(Texture *texture)
 	{
-		if (m_surface) {
+		if (!m_compressed.empty()) {
+			assert(texture->GetDescriptor().type == TEXTURE_2D && m_textureType == TEXTURE_2D);
+			texture->Update(m_compressed.data(), vector3f(m_descriptor.dataSize.x, m_descriptor.dataSize.y, 0.0f), m_descriptor.format, m_descriptor.numberOfMipMaps);
+		} else if (m_surface) {
 			if (texture->GetDescriptor().type == TEXTURE_2D && m_textureType == TEXTURE_2D) {
 				texture->Update(m_surface->pixels, vector3f(m_surface->w, m_surface->h, 0.0f), m_descriptor.format, 0);
 			} else if (texture->GetDescriptor().type == TEXTURE_CUBE_MAP && m_textureType == TEXTURE_CUBE_MAP) {
@@ -336,6 +465,13 @@ namespace Graphics {
 			assert(m_dds.headerdone_);
 			assert(m_descriptor.format == TEXTURE_DXT1 || m_descriptor.format == TEXTURE_DXT5);
 			if (texture->GetDescriptor().type == TEXTURE_2D && m_textureType == TEXTURE_2D) {
+				// streamed textures start out with only their low mips
+				const TextureDescriptor &desc = texture->GetDescriptor();
+				const uint32_t initialMip = m_streamed && TextureStreamer::IsEnabled() ? TextureStreamer::GetInitialMip(desc) : 0;
+				if (initialMip && texture->SetResidentMips(m_dds.imgdata_.imgData + TextureStreamer::GetMipOffset(desc, initialMip), initialMip)) {
+					TextureStreamer::Register(texture, m_filenames.front(), initialMip);
+					return;
+				}
 				texture->Update(m_dds.imgdata_.imgData, vector3f(m_dds.imgdata_.width, m_dds.imgdata_.height, 0.0f), m_descriptor.format, m_dds.imgdata_.numMipMaps);
 			} else if (texture->GetDescriptor().type == TEXTURE_CUBE_MAP && m_textureType == TEXTURE_CUBE_MAP) {
 				TextureCubeData tcd;
@@ -377,4 +513,20 @@ namespace Graphics {
 		return Model("textures/transparent.png").GetOrCreateTexture(r, "model");
 	}
 
+	Texture *TextureBuilder::GetFlatNormalTexture(Renderer *r)
+	{
+		Texture *t = r->GetCachedTexture("model", "flat_normal");
+		if (t)
+			return t;
+
+		// a single texel pointing straight out of the surface
+		SDLSurfacePtr s = SDLSurfacePtr::WrapNew(SDL_CreateRGBSurface(SDL_SWSURFACE, 1, 1, 32,
+			pixelFormatRGBA.Rmask, pixelFormatRGBA.Gmask, pixelFormatRGBA.Bmask, pixelFormatRGBA.Amask));
+		*static_cast<Uint32 *>(s->pixels) = SDL_MapRGBA(s->format, 128, 128, 255, 255);
+
+		t = TextureBuilder(s, LINEAR_REPEAT, false, false, true, false, false).CreateTexture(r);
+		r->AddCachedTexture("model", "flat_normal", t);
+		return t;
+	}
+
 } // namespace Graphics
@@ -28,6 +28,13 @@ namespace Graphics {
 
 		static void Init();
 
+		// Compress the uncompressed textures that allow it to DXT1/DXT5 when
+		// they're prepared (on a worker thread if loading is asynchronous)
+		// instead of leaving it to the driver, keeping the results in a disk
+		// cache of the given size (0 to compress every time)
+		static void InitCompression(bool enabled, size_t cacheBytes);
+		static void UninitCompression();
+
 		// convenience constructors for common texture types
 		static TextureBuilder Model(const std::string &filename)
 		{
@@ -66,6 +73,20 @@ namespace Graphics {
 			return TextureBuilder(filenames, LINEAR_REPEAT, true, true, false, true, true, TEXTURE_2D_ARRAY, layers);
 		}
 
+		// Let the TextureStreamer load the top mips of a compressed texture
+		// when it's needed, instead of uploading them all at once
+		TextureBuilder &SetStreamed(bool streamed = true)
+		{
+			m_streamed = streamed;
+			return *this;
+		}
+
+		const std::string &GetFilename() const
+		{
+			assert(!m_filenames.empty());
+			return m_filenames.front();
+		}
+
 		const TextureDescriptor &GetDescriptor()
 		{
 			PrepareSurface();
@@ -92,6 +113,7 @@ namespace Graphics {
 		//commonly used dummy textures
 		static Texture *GetWhiteTexture(Renderer *);
 		static Texture *GetTransparentTexture(Renderer *);
+		static Texture *GetFlatNormalTexture(Renderer *);
 
 	private:
 		SDLSurfacePtr m_surface;
@@ -99,6 +121,8 @@ namespace Graphics {
 		PicoDDS::DDSImage m_dds;
 		std::vector<PicoDDS::DDSImage> m_ddsarray;
 		std::vector<std::string> m_filenames;
+		// the mip chain of a texture compressed on load
+		std::vector<uint8_t> m_compressed;
 
 		TextureSampleMode m_sampleMode;
 		bool m_generateMipmaps;
@@ -109,6 +133,7 @@ namespace Graphics {
 		bool m_anisotropicFiltering;
 		TextureType m_textureType;
 		size_t m_layers;
+		bool m_streamed;
 
 		TextureDescriptor m_descriptor;
 
@@ -125,6 +150,10 @@ namespace Graphics {
 
 		void LoadSurface();
 		void LoadDDS();
+		// Load a texture to compress on load from the cache, or decode it.
+		// Returns true if it came from the cache, and sets cacheKey otherwise.
+		bool LoadCompressed(uint64_t &cacheKey);
+		void CompressSurface(uint64_t cacheKey, uint32_t virtualWidth, uint32_t virtualHeight);
 
 		static SDL_mutex *m_textureLock;
 	};
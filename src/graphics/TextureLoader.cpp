@@ -0,0 +1,117 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "TextureLoader.h"
+
+#include "JobQueue.h"
+#include "Material.h"
+#include "Renderer.h"
+#include "TextureBuilder.h"
+#include "profiler/Profiler.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace Graphics;
+
+namespace {
+	struct PendingTexture {
+		Renderer *renderer;
+		std::string type;
+		// the material bindings waiting for the texture
+		std::vector<std::pair<RefCountedPtr<Material>, size_t>> targets;
+		Job::Handle job;
+	};
+
+	JobQueue *s_queue = nullptr;
+	// keyed by cache type and filename
+	std::map<std::pair<std::string, std::string>, std::unique_ptr<PendingTexture>> s_pending;
+} // namespace
+
+static void on_texture_decoded(const std::pair<std::string, std::string> &key, TextureBuilder &builder)
+{
+	PROFILE_SCOPED()
+	auto iter = s_pending.find(key);
+	assert(iter != s_pending.end());
+	PendingTexture &pending = *iter->second;
+
+	// the builder has already done the decoding, so this only uploads it
+	Texture *texture = builder.GetOrCreateTexture(pending.renderer, pending.type);
+	for (auto &target : pending.targets)
+		target.first->SetTexture(target.second, texture);
+
+	s_pending.erase(iter);
+}
+
+class TextureDecodeJob : public Job {
+public:
+	TextureDecodeJob(const std::pair<std::string, std::string> &key, const TextureBuilder &builder) :
+		m_key(key),
+		m_builder(builder)
+	{}
+
+	virtual void OnRun() override
+	{
+		PROFILE_SCOPED()
+		// reads, decodes and converts the file
+		m_builder.GetDescriptor();
+	}
+
+	virtual void OnFinish() override
+	{
+		on_texture_decoded(m_key, m_builder);
+	}
+
+	virtual const char *GetJobName() const override { return "TextureDecode"; }
+
+private:
+	std::pair<std::string, std::string> m_key;
+	TextureBuilder m_builder;
+};
+
+void TextureLoader::Init(JobQueue *queue)
+{
+	assert(!s_queue);
+	s_queue = queue;
+}
+
+void TextureLoader::Uninit()
+{
+	// destroying the handles cancels the loads still in flight
+	s_pending.clear();
+	s_queue = nullptr;
+}
+
+bool TextureLoader::IsEnabled()
+{
+	return s_queue != nullptr;
+}
+
+void TextureLoader::SetTexture(Renderer *r, Material *mat, size_t name, const TextureBuilder &builder, const std::string &type, Texture *placeholder)
+{
+	const std::string &filename = builder.GetFilename();
+	Texture *texture = r->GetCachedTexture(type, filename);
+	if (texture || !s_queue) {
+		mat->SetTexture(name, texture ? texture : TextureBuilder(builder).GetOrCreateTexture(r, type));
+		return;
+	}
+
+	mat->SetTexture(name, placeholder);
+
+	const auto key = std::make_pair(type, filename);
+	std::unique_ptr<PendingTexture> &pending = s_pending[key];
+	if (!pending) {
+		pending.reset(new PendingTexture());
+		pending->renderer = r;
+		pending->type = type;
+		pending->job = s_queue->Queue(new TextureDecodeJob(key, builder));
+	}
+
+	pending->targets.emplace_back(RefCountedPtr<Material>(mat), name);
+}
+
+size_t TextureLoader::GetNumPending()
+{
+	return s_pending.size();
+}
@@ -0,0 +1,45 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _TEXTURELOADER_H
+#define _TEXTURELOADER_H
+
+#include <cstddef>
+#include <string>
+
+class JobQueue;
+
+namespace Graphics {
+
+	class Material;
+	class Renderer;
+	class Texture;
+	class TextureBuilder;
+
+	// Reads and decodes textures on worker threads, so loading a model
+	// doesn't stall the frame on texture I/O. Until a texture has been
+	// created on the main thread, the materials waiting for it use a
+	// placeholder instead.
+	//
+	// Everything here must be called on the main thread.
+	class TextureLoader {
+	public:
+		static void Init(JobQueue *queue);
+		static void Uninit();
+
+		static bool IsEnabled();
+
+		// Set the texture the builder describes on a material. A texture
+		// that isn't cached yet is loaded in the background and the
+		// placeholder is set until it's ready; if loading in the background
+		// is disabled it is created right away. The builder must describe a
+		// single file and must not have been prepared yet.
+		static void SetTexture(Renderer *r, Material *mat, size_t name, const TextureBuilder &builder, const std::string &type, Texture *placeholder);
+
+		// Number of textures still waiting to be created
+		static size_t GetNumPending();
+	};
+
+} // namespace Graphics
+
+#endif /* _TEXTURELOADER_H */
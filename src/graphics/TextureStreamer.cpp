@@ -0,0 +1,328 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "TextureStreamer.h"
+
+#include "FileSystem.h"
+#include "JobQueue.h"
+#include "Stats.h"
+#include "Texture.h"
+#include "core/Log.h"
+#include "profiler/Profiler.h"
+
+#include "PicoDDS/PicoDDS.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using namespace Graphics;
+
+namespace {
+	static constexpr uint32_t NO_MIP = ~0U;
+	// new textures start out with mips no larger than this
+	static constexpr uint32_t INITIAL_MIP_SIZE = 128;
+	// textures waiting for more detail beyond this have to wait their turn
+	static constexpr size_t MAX_LOADS_IN_FLIGHT = 4;
+	// a texture has to go undrawn for this many frames before its detail is
+	// dropped, so looking around doesn't make textures reload all the time
+	static constexpr uint32_t MIN_UNUSED_FRAMES = 60;
+
+	struct StreamedTexture {
+		RefCountedPtr<Texture> texture;
+		std::string filename;
+		uint32_t initialMip;
+		// the largest mip uploaded
+		uint32_t residentMip;
+		// the first mip of the chain being loaded, or NO_MIP
+		uint32_t loadingMip = NO_MIP;
+		// the largest mip asked for since the last update, or NO_MIP
+		uint32_t wantedMip = NO_MIP;
+		uint32_t lastUsed = 0;
+		bool failed = false;
+		Job::Handle job;
+		// mips read by a finished load, waiting to be uploaded
+		std::vector<unsigned char> loadedData;
+		bool loaded = false;
+	};
+
+	JobQueue *s_queue = nullptr;
+	size_t s_budget = 0;
+	uint32_t s_frame = 0;
+	std::vector<std::unique_ptr<StreamedTexture>> s_textures;
+	std::unordered_map<const Texture *, StreamedTexture *> s_index;
+	std::vector<StreamedTexture *> s_candidates;
+} // namespace
+
+static size_t mip_size(const TextureDescriptor &desc, uint32_t mip)
+{
+	const size_t width = std::max<size_t>(size_t(desc.dataSize.x) >> mip, 1);
+	const size_t height = std::max<size_t>(size_t(desc.dataSize.y) >> mip, 1);
+	const size_t blockSize = desc.format == TEXTURE_DXT1 ? 8 : 16;
+	return ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
+
+// memory used by a texture with mips firstMip and below uploaded
+static size_t chain_size(const TextureDescriptor &desc, uint32_t firstMip)
+{
+	return TextureStreamer::GetMipOffset(desc, desc.numberOfMipMaps) - TextureStreamer::GetMipOffset(desc, firstMip);
+}
+
+// memory a texture will use once the mips being loaded are in
+static size_t target_size(const StreamedTexture &entry)
+{
+	const uint32_t mip = entry.loadingMip != NO_MIP ? entry.loadingMip : entry.residentMip;
+	return chain_size(entry.texture->GetDescriptor(), mip);
+}
+
+static void upload_mips(StreamedTexture &entry)
+{
+	const uint32_t firstMip = entry.loadingMip;
+	entry.loadingMip = NO_MIP;
+	entry.loaded = false;
+
+	if (entry.loadedData.empty() || !entry.texture->SetResidentMips(entry.loadedData.data(), firstMip))
+		entry.failed = true;
+	else
+		entry.residentMip = firstMip;
+
+	std::vector<unsigned char>().swap(entry.loadedData);
+	if (entry.failed)
+		Log::Warning("TextureStreamer: couldn't load mips of {}, keeping it at its current detail\n", entry.filename);
+}
+
+// Reads the mip chain from firstMip down from the texture's DDS file
+class MipLoadJob : public Job {
+public:
+	MipLoadJob(StreamedTexture *entry, uint32_t firstMip) :
+		m_entry(entry),
+		m_filename(entry->filename),
+		m_desc(entry->texture->GetDescriptor()),
+		m_firstMip(firstMip)
+	{}
+
+	virtual void OnRun() override
+	{
+		PROFILE_SCOPED()
+		RefCountedPtr<FileSystem::FileData> file = FileSystem::gameDataFiles.ReadFile(m_filename);
+		if (!file)
+			return;
+
+		PicoDDS::DDSImage dds;
+		if (!dds.Read(file->GetData(), file->GetSize()))
+			return;
+
+		// the file might have been changed by a mod since the texture was created
+		const PicoDDS::LoaderImgData &img = dds.imgdata_;
+		if (img.width != int(m_desc.dataSize.x) || img.height != int(m_desc.dataSize.y) ||
+			img.numMipMaps != int(m_desc.numberOfMipMaps) || img.numImages != 1)
+			return;
+
+		const size_t offset = TextureStreamer::GetMipOffset(m_desc, m_firstMip);
+		const size_t end = TextureStreamer::GetMipOffset(m_desc, m_desc.numberOfMipMaps);
+		if (end > size_t(img.size))
+			return;
+
+		m_data.assign(img.imgData + offset, img.imgData + end);
+	}
+
+	virtual void OnFinish() override
+	{
+		// the texture is replaced at the start of the next frame, so draws
+		// already queued for this one don't see it change
+		m_entry->loadedData.swap(m_data);
+		m_entry->loaded = true;
+	}
+
+	virtual const char *GetJobName() const override { return "TextureMipLoad"; }
+
+private:
+	StreamedTexture *m_entry;
+	std::string m_filename;
+	TextureDescriptor m_desc;
+	uint32_t m_firstMip;
+	std::vector<unsigned char> m_data;
+};
+
+static void start_load(StreamedTexture &entry, uint32_t firstMip)
+{
+	assert(entry.loadingMip == NO_MIP);
+	entry.loadingMip = firstMip;
+	entry.job = s_queue->Queue(new MipLoadJob(&entry, firstMip));
+}
+
+// Drop the detail of textures that haven't been drawn for a while, oldest
+// first, until at least the given number of bytes will be freed. Returns
+// the number of bytes that will be freed.
+static size_t evict(size_t bytes)
+{
+	s_candidates.clear();
+	for (auto &entry : s_textures) {
+		if (!entry->failed && entry->loadingMip == NO_MIP && entry->residentMip < entry->initialMip &&
+			s_frame - entry->lastUsed >= MIN_UNUSED_FRAMES)
+			s_candidates.push_back(entry.get());
+	}
+
+	std::sort(s_candidates.begin(), s_candidates.end(), [](const StreamedTexture *a, const StreamedTexture *b) {
+		return a->lastUsed < b->lastUsed;
+	});
+
+	size_t freed = 0;
+	for (StreamedTexture *entry : s_candidates) {
+		if (freed >= bytes)
+			break;
+
+		freed += target_size(*entry) - chain_size(entry->texture->GetDescriptor(), entry->initialMip);
+		start_load(*entry, entry->initialMip);
+	}
+
+	return freed;
+}
+
+void TextureStreamer::Init(JobQueue *queue, size_t budgetBytes)
+{
+	assert(!s_queue);
+	if (budgetBytes) {
+		s_queue = queue;
+		s_budget = budgetBytes;
+	}
+}
+
+void TextureStreamer::Uninit()
+{
+	// destroying the handles cancels the loads still in flight
+	s_index.clear();
+	s_textures.clear();
+	s_queue = nullptr;
+	s_budget = 0;
+}
+
+bool TextureStreamer::IsEnabled()
+{
+	return s_queue != nullptr;
+}
+
+uint32_t TextureStreamer::GetInitialMip(const TextureDescriptor &desc)
+{
+	if (desc.type != TEXTURE_2D || (desc.format != TEXTURE_DXT1 && desc.format != TEXTURE_DXT5) || desc.numberOfMipMaps < 2)
+		return 0;
+
+	const uint32_t size = std::max(uint32_t(desc.dataSize.x), uint32_t(desc.dataSize.y));
+	uint32_t mip = 0;
+	while ((size >> mip) > INITIAL_MIP_SIZE && mip + 1 < desc.numberOfMipMaps)
+		mip++;
+	return mip;
+}
+
+size_t TextureStreamer::GetMipOffset(const TextureDescriptor &desc, uint32_t mip)
+{
+	size_t offset = 0;
+	for (uint32_t i = 0; i < mip; i++)
+		offset += mip_size(desc, i);
+	return offset;
+}
+
+void TextureStreamer::Register(Texture *texture, const std::string &filename, uint32_t residentMip)
+{
+	assert(IsEnabled());
+	assert(!IsStreamed(texture));
+
+	s_textures.emplace_back(new StreamedTexture());
+	StreamedTexture &entry = *s_textures.back();
+	entry.texture.Reset(texture);
+	entry.filename = filename;
+	entry.initialMip = residentMip;
+	entry.residentMip = residentMip;
+	entry.lastUsed = s_frame;
+	s_index[texture] = &entry;
+}
+
+bool TextureStreamer::IsStreamed(const Texture *texture)
+{
+	return s_index.count(texture) != 0;
+}
+
+void TextureStreamer::RequestSize(Texture *texture, float pixels)
+{
+	auto iter = s_index.find(texture);
+	if (iter == s_index.end())
+		return;
+
+	StreamedTexture &entry = *iter->second;
+	const TextureDescriptor &desc = texture->GetDescriptor();
+	const uint32_t lastMip = desc.numberOfMipMaps - 1;
+
+	// the mip with about one texel per pixel
+	uint32_t mip = lastMip;
+	if (pixels > 0.0f) {
+		const float texels = std::max(desc.dataSize.x, desc.dataSize.y);
+		mip = uint32_t(std::min(float(lastMip), std::max(0.0f, std::floor(std::log2(texels / pixels)))));
+	}
+
+	entry.wantedMip = std::min(entry.wantedMip, mip);
+}
+
+void TextureStreamer::Update(Stats &stats)
+{
+	if (!s_queue)
+		return;
+
+	PROFILE_SCOPED()
+	s_frame++;
+
+	for (auto &entry : s_textures) {
+		if (entry->loaded)
+			upload_mips(*entry);
+	}
+
+	size_t targetSize = 0;
+	size_t residentSize = 0;
+	size_t numLoading = 0;
+	for (auto &entry : s_textures) {
+		if (entry->wantedMip != NO_MIP)
+			entry->lastUsed = s_frame;
+		targetSize += target_size(*entry);
+		residentSize += entry->texture->GetTextureMemSize();
+		numLoading += entry->loadingMip != NO_MIP;
+	}
+
+	// the textures drawn with too little detail, most blurry first
+	std::vector<StreamedTexture *> loads;
+	for (auto &entry : s_textures) {
+		if (!entry->failed && entry->loadingMip == NO_MIP && entry->wantedMip < entry->residentMip)
+			loads.push_back(entry.get());
+	}
+
+	std::sort(loads.begin(), loads.end(), [](const StreamedTexture *a, const StreamedTexture *b) {
+		return a->residentMip - a->wantedMip > b->residentMip - b->wantedMip;
+	});
+
+	for (StreamedTexture *entry : loads) {
+		if (numLoading >= MAX_LOADS_IN_FLIGHT)
+			break;
+
+		const TextureDescriptor &desc = entry->texture->GetDescriptor();
+		const size_t currentSize = target_size(*entry);
+		if (targetSize + chain_size(desc, entry->wantedMip) - currentSize > s_budget)
+			targetSize -= std::min(targetSize, evict(targetSize + chain_size(desc, entry->wantedMip) - currentSize - s_budget));
+
+		// load as much of the wanted detail as fits in the budget
+		uint32_t mip = entry->wantedMip;
+		while (mip < entry->residentMip && targetSize + chain_size(desc, mip) - currentSize > s_budget)
+			mip++;
+		if (mip == entry->residentMip)
+			continue;
+
+		targetSize += chain_size(desc, mip) - currentSize;
+		start_load(*entry, mip);
+		numLoading++;
+	}
+
+	for (auto &entry : s_textures)
+		entry->wantedMip = NO_MIP;
+
+	stats.SetStatCount(Stats::STAT_MEM_TEXTURE_STREAMED, uint32_t(residentSize));
+	stats.SetStatCount(Stats::STAT_TEXTURE_MIP_LOADS, uint32_t(numLoading));
+}
@@ -0,0 +1,61 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _TEXTURESTREAMER_H
+#define _TEXTURESTREAMER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class JobQueue;
+
+namespace Graphics {
+
+	class Stats;
+	class Texture;
+	class TextureDescriptor;
+
+	// Streams the top mips of large compressed model textures in and out of
+	// VRAM. A streamed texture is created with only its low mips; when it is
+	// drawn big enough to need more detail, the mips it is missing are read
+	// from its DDS file on a worker thread and uploaded on the main thread.
+	//
+	// The memory used by streamed textures is kept under a budget by dropping
+	// the top mips of the textures that haven't been drawn for the longest
+	// time. Textures that aren't streamed don't count towards the budget.
+	//
+	// Everything here must be called on the main thread.
+	class TextureStreamer {
+	public:
+		// Enable streaming with the given VRAM budget; 0 disables it
+		static void Init(JobQueue *queue, size_t budgetBytes);
+		static void Uninit();
+
+		static bool IsEnabled();
+
+		// The first mip to upload when creating a texture, or 0 if the
+		// texture is too small to be worth streaming
+		static uint32_t GetInitialMip(const TextureDescriptor &desc);
+		// Byte offset of a mip in the mip chain of a compressed texture, as
+		// stored in a DDS file
+		static size_t GetMipOffset(const TextureDescriptor &desc, uint32_t mip);
+
+		// Take over a texture created from the DDS file with mips residentMip
+		// and below uploaded
+		static void Register(Texture *texture, const std::string &filename, uint32_t residentMip);
+		static bool IsStreamed(const Texture *texture);
+
+		// Ask for a streamed texture to be sharp when drawn the given number
+		// of pixels across. Call this every frame the texture is drawn.
+		static void RequestSize(Texture *texture, float pixels);
+
+		// Upload the mips loaded since the last call, then evict and load
+		// mips for the textures drawn in the last frame; call this once per
+		// frame before anything is drawn
+		static void Update(Stats &stats);
+	};
+
+} // namespace Graphics
+
+#endif /* _TEXTURESTREAMER_H */
@@ -49,7 +49,13 @@ namespace Graphics {
 		ATTRIB_FORMAT_FLOAT2,
 		ATTRIB_FORMAT_FLOAT3,
 		ATTRIB_FORMAT_FLOAT4,
-		ATTRIB_FORMAT_UBYTE4
+		ATTRIB_FORMAT_UBYTE4,
+		// integer formats read by shaders as floats in [-1, 1] or [0, 1]
+		ATTRIB_FORMAT_SHORT4_NORM,
+		ATTRIB_FORMAT_BYTE4_NORM,
+		ATTRIB_FORMAT_USHORT2_NORM,
+		// two 16-bit half floats
+		ATTRIB_FORMAT_HALF2
 	};
 
 	enum ConstantDataFormat : uint8_t {
@@ -6,6 +6,9 @@
 #include "graphics/Types.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
 
 namespace Graphics {
 
@@ -20,11 +23,125 @@ namespace Graphics {
 			return 16;
 		case ATTRIB_FORMAT_UBYTE4:
 			return 4;
+		case ATTRIB_FORMAT_SHORT4_NORM:
+			return 8;
+		case ATTRIB_FORMAT_BYTE4_NORM:
+		case ATTRIB_FORMAT_USHORT2_NORM:
+		case ATTRIB_FORMAT_HALF2:
+			return 4;
 		default:
 			return 0;
 		}
 	}
 
+	template <typename T>
+	static void decode_components(const Uint8 *in, float *out, int count, float scale)
+	{
+		for (int i = 0; i < count; i++) {
+			T value;
+			memcpy(&value, in + i * sizeof(T), sizeof(T));
+			out[i] = scale == 0.f ? float(value) : std::max(float(value) / scale, -1.f);
+		}
+	}
+
+	template <typename T>
+	static void encode_components(const float *in, Uint8 *out, int count, float scale)
+	{
+		for (int i = 0; i < count; i++) {
+			T value;
+			if (scale == 0.f)
+				value = T(in[i]);
+			else
+				value = T(std::lrint(std::clamp(in[i], std::is_signed<T>::value ? -1.f : 0.f, 1.f) * scale));
+			memcpy(out + i * sizeof(T), &value, sizeof(T));
+		}
+	}
+
+	void VertexBufferDesc::DecodeAttrib(VertexAttribFormat f, const Uint8 *in, float out[4])
+	{
+		out[0] = out[1] = out[2] = out[3] = 0.f;
+		switch (f) {
+		case ATTRIB_FORMAT_FLOAT2: decode_components<float>(in, out, 2, 0.f); break;
+		case ATTRIB_FORMAT_FLOAT3: decode_components<float>(in, out, 3, 0.f); break;
+		case ATTRIB_FORMAT_FLOAT4: decode_components<float>(in, out, 4, 0.f); break;
+		case ATTRIB_FORMAT_UBYTE4: decode_components<Uint8>(in, out, 4, 255.f); break;
+		case ATTRIB_FORMAT_SHORT4_NORM: decode_components<Sint16>(in, out, 4, 32767.f); break;
+		case ATTRIB_FORMAT_BYTE4_NORM: decode_components<Sint8>(in, out, 4, 127.f); break;
+		case ATTRIB_FORMAT_USHORT2_NORM: decode_components<Uint16>(in, out, 2, 65535.f); break;
+		case ATTRIB_FORMAT_HALF2:
+			for (int i = 0; i < 2; i++) {
+				Uint16 half;
+				memcpy(&half, in + i * sizeof(Uint16), sizeof(Uint16));
+				out[i] = HalfToFloat(half);
+			}
+			break;
+		default: assert(false); break;
+		}
+	}
+
+	void VertexBufferDesc::EncodeAttrib(VertexAttribFormat f, const float in[4], Uint8 *out)
+	{
+		switch (f) {
+		case ATTRIB_FORMAT_FLOAT2: encode_components<float>(in, out, 2, 0.f); break;
+		case ATTRIB_FORMAT_FLOAT3: encode_components<float>(in, out, 3, 0.f); break;
+		case ATTRIB_FORMAT_FLOAT4: encode_components<float>(in, out, 4, 0.f); break;
+		case ATTRIB_FORMAT_UBYTE4: encode_components<Uint8>(in, out, 4, 255.f); break;
+		case ATTRIB_FORMAT_SHORT4_NORM: encode_components<Sint16>(in, out, 4, 32767.f); break;
+		case ATTRIB_FORMAT_BYTE4_NORM: encode_components<Sint8>(in, out, 4, 127.f); break;
+		case ATTRIB_FORMAT_USHORT2_NORM: encode_components<Uint16>(in, out, 2, 65535.f); break;
+		case ATTRIB_FORMAT_HALF2:
+			for (int i = 0; i < 2; i++) {
+				const Uint16 half = FloatToHalf(in[i]);
+				memcpy(out + i * sizeof(Uint16), &half, sizeof(Uint16));
+			}
+			break;
+		default: assert(false); break;
+		}
+	}
+
+	Uint16 VertexBufferDesc::FloatToHalf(float f)
+	{
+		Uint32 x;
+		memcpy(&x, &f, sizeof(x));
+		const Uint16 sign = (x >> 16) & 0x8000;
+		x &= 0x7fffffff;
+
+		// infinity and NaN (kept quiet)
+		if (x >= 0x7f800000)
+			return sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0);
+		// 65520 and up round to infinity
+		if (x >= 0x477ff000)
+			return sign | 0x7c00;
+		// below the smallest normal half: a multiple of 2^-24
+		if (x < 0x38800000) {
+			float a;
+			memcpy(&a, &x, sizeof(a));
+			return sign | Uint16(std::lrint(a * 16777216.f));
+		}
+
+		// rebias the exponent and round the mantissa to nearest even; a
+		// carry out of the mantissa correctly bumps the exponent
+		x += 0xc8000fff + ((x >> 13) & 1);
+		return sign | Uint16(x >> 13);
+	}
+
+	float VertexBufferDesc::HalfToFloat(Uint16 h)
+	{
+		const Uint32 sign = Uint32(h & 0x8000) << 16;
+		const Uint32 exponent = (h >> 10) & 0x1f;
+		const Uint32 mantissa = h & 0x3ff;
+
+		if (exponent == 0) {
+			const float value = std::ldexp(float(mantissa), -24);
+			return sign ? -value : value;
+		}
+
+		const Uint32 x = sign | (exponent == 0x1f ? 0x7f800000 | (mantissa << 13) : ((exponent + 112) << 23) | (mantissa << 13));
+		float f;
+		memcpy(&f, &x, sizeof(f));
+		return f;
+	}
+
 	VertexBufferDesc::VertexBufferDesc() :
 		numVertices(0),
 		stride(0),
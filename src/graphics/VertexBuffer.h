@@ -51,6 +51,16 @@ namespace Graphics {
 		static Uint32 CalculateOffset(const VertexBufferDesc &, VertexAttrib);
 		static Uint32 GetAttribSize(VertexAttribFormat);
 
+		//convert one attribute between its format and up to four floats,
+		//the way shaders read it (missing components read as zero, UBYTE4
+		//as normalized like colours). Encoding clamps to the format's range.
+		static void DecodeAttrib(VertexAttribFormat, const Uint8 *in, float out[4]);
+		static void EncodeAttrib(VertexAttribFormat, const float in[4], Uint8 *out);
+
+		//IEEE 754 half floats, rounding to nearest even
+		static Uint16 FloatToHalf(float);
+		static float HalfToFloat(Uint16);
+
 		void CalculateOffsets();
 
 		//semantic ATTRIB_NONE ends description (when not using all attribs)
@@ -15,21 +15,36 @@
 #include "graphics/VertexBuffer.h"
 #include "profiler/Profiler.h"
 
+#include <algorithm>
+#include <cmath>
+#include <new>
+
 using namespace Graphics::OGL;
 
-void CommandList::AddDrawCmd(Graphics::MeshObject *mesh, Graphics::Material *material, Graphics::InstanceBuffer *inst)
+static size_t s_drawDataName = "DrawData"_hash;
+
+void CommandList::AddDrawCmd(Graphics::MeshObject *mesh, Graphics::Material *material, Graphics::InstanceBuffer *inst, Graphics::Material *instancedMaterial)
 {
 	assert(!m_executing && "Attempt to append to a command list while it's being executed!");
 	OGL::Material *mat = static_cast<OGL::Material *>(material);
+	OGL::Material *instMat = static_cast<OGL::Material *>(instancedMaterial);
+	assert(!instMat || (!inst && instMat->GetShader() == mat->GetShader()));
 
 	DrawCmd cmd{};
 	cmd.mesh = static_cast<OGL::MeshObject *>(mesh);
 	cmd.inst = static_cast<OGL::InstanceBuffer *>(inst);
 
-	cmd.program = mat->EvaluateVariant();
+	// shader variants may have to be compiled, so a recording picks them on submit
+	cmd.program = m_recording ? nullptr : mat->EvaluateVariant();
+	cmd.instancedProgram = m_recording || !instMat ? nullptr : instMat->EvaluateVariant();
 	cmd.shader = mat->GetShader();
 	cmd.renderStateHash = mat->m_renderStateHash;
 	cmd.drawData = SetupMaterialData(mat);
+	if (m_recording)
+		m_deferredData.back().instancedMaterial = instMat;
+
+	const matrix4x4f &transform = m_recording ? m_view.transform : m_renderer->GetTransform();
+	cmd.depth = transform.GetTranslate().Length();
 
 	m_drawCmds.emplace_back(std::move(cmd));
 }
@@ -48,7 +63,7 @@ void CommandList::AddDynamicDrawCmd(BufferBinding<Graphics::VertexBuffer> vtxBin
 	cmd.idxBind.offset = idxBind.offset;
 	cmd.idxBind.size = idxBind.size;
 
-	cmd.program = mat->EvaluateVariant();
+	cmd.program = m_recording ? nullptr : mat->EvaluateVariant();
 	cmd.shader = mat->GetShader();
 	cmd.renderStateHash = mat->m_renderStateHash;
 	cmd.drawData = SetupMaterialData(mat);
@@ -61,6 +76,7 @@ void CommandList::AddDynamicDrawCmd(BufferBinding<Graphics::VertexBuffer> vtxBin
 void CommandList::AddRenderPassCmd(RenderTarget *renderTarget, ViewportExtents extents)
 {
 	assert(!m_executing && "Attempt to append to a command list while it's being executed!");
+	assert(!m_recording && "Render passes can't be recorded on a worker thread!");
 
 	RenderPassCmd *lastCmd = IsEmpty() ? nullptr : std::get_if<RenderPassCmd>(&m_drawCmds.back());
 	if (!lastCmd || !lastCmd->setRenderTarget || lastCmd->renderTarget != renderTarget) {
@@ -85,6 +101,7 @@ void CommandList::AddRenderPassCmd(RenderTarget *renderTarget, ViewportExtents e
 void CommandList::AddScissorCmd(ViewportExtents scissor)
 {
 	assert(!m_executing && "Attempt to append to a command list while it's being executed!");
+	assert(!m_recording && "Render passes can't be recorded on a worker thread!");
 
 	RenderPassCmd *lastCmd = IsEmpty() ? nullptr : std::get_if<RenderPassCmd>(&m_drawCmds.back());
 	if (!lastCmd) {
@@ -106,6 +123,7 @@ void CommandList::AddScissorCmd(ViewportExtents scissor)
 void CommandList::AddClearCmd(bool clearColors, bool clearDepth, Color color)
 {
 	assert(!m_executing && "Attempt to append to a command list while it's being executed!");
+	assert(!m_recording && "Render passes can't be recorded on a worker thread!");
 
 	RenderPassCmd *lastCmd = IsEmpty() ? nullptr : std::get_if<RenderPassCmd>(&m_drawCmds.back());
 
@@ -135,6 +153,7 @@ void CommandList::AddBlitRenderTargetCmd(
 	bool linearFilter)
 {
 	assert(!m_executing && "Attempt to append to a command list while it's being executed!");
+	assert(!m_recording && "Render passes can't be recorded on a worker thread!");
 
 	if (resolveMSAA) {
 		assert(srcExtents.w == dstExtents.w && srcExtents.h == dstExtents.h &&
@@ -153,6 +172,14 @@ void CommandList::AddBlitRenderTargetCmd(
 	m_drawCmds.emplace_back(std::move(cmd));
 }
 
+void CommandList::AddGPUTimerCmd(GLuint query)
+{
+	assert(!m_executing && "Attempt to append to a command list while it's being executed!");
+	assert(!m_recording && "GPU timers can't be recorded on a worker thread!");
+
+	m_drawCmds.emplace_back(GPUTimerCmd{ query });
+}
+
 void CommandList::Reset()
 {
 	assert(!m_executing && "Attempt to reset a command list while it's being executed!");
@@ -161,6 +188,222 @@ void CommandList::Reset()
 		bucket.used = 0;
 
 	m_drawCmds.clear();
+	m_deferredData.clear();
+	m_appended.clear();
+	m_numBatchInstances = 0;
+	m_recording = false;
+}
+
+void CommandList::BeginRecording(const ViewState &view)
+{
+	Reset();
+	m_recording = true;
+	m_view = view;
+}
+
+// Sort key of a draw command, from most to least significant: the depth
+// bucket, then (hashes of) the program, the render state and the material's
+// textures and mesh. The depth buckets are powers of two, so near geometry
+// still goes first without splitting up draws that share state, and draws
+// of the same mesh end up next to each other for BatchDrawCmds().
+static uint64_t GetSortKey(const CommandList::DrawCmd &cmd, TextureGL *const *textures, size_t numTextures)
+{
+	const uint64_t depthBucket = std::min(cmd.depth > 1.0f ? uint64_t(std::ilogb(cmd.depth)) + 1 : 0, uint64_t(63));
+	const uint64_t program = (uintptr_t(cmd.program) >> 4) & 0xfffff;
+	const uint64_t renderState = cmd.renderStateHash & 0xffff;
+
+	uint64_t material = uintptr_t(cmd.mesh) >> 4;
+	for (size_t i = 0; i < numTextures; i++)
+		material = material * 31 + (uintptr_t(textures[i]) >> 4);
+
+	return depthBucket << 58 | program << 38 | renderState << 22 | (material & 0x3fffff);
+}
+
+void CommandList::SortDrawCmds(const Graphics::Stats &stats)
+{
+	PROFILE_SCOPED()
+	RenderStateCache *stateCache = m_renderer->GetStateCache();
+
+	// only draws that write depth and don't blend can be drawn in any order
+	std::vector<std::pair<size_t, bool>> sortableStates;
+	auto isSortable = [&](const Cmd &cmd) {
+		const DrawCmd *drawCmd = std::get_if<DrawCmd>(&cmd);
+		if (!drawCmd)
+			return false;
+		for (const auto &state : sortableStates)
+			if (state.first == drawCmd->renderStateHash)
+				return state.second;
+
+		const RenderStateDesc &desc = stateCache->GetRenderState(drawCmd->renderStateHash);
+		const bool sortable = desc.blendMode == BLEND_SOLID && desc.depthTest && desc.depthWrite;
+		sortableStates.emplace_back(drawCmd->renderStateHash, sortable);
+		return sortable;
+	};
+
+	auto countSwitches = [&](Graphics::Stats::StatType programStat, Graphics::Stats::StatType stateStat) {
+		const Program *program = nullptr;
+		size_t renderState = 0;
+		uint32_t programSwitches = 0, stateSwitches = 0;
+		for (const Cmd &cmd : m_drawCmds) {
+			const DrawCmd *drawCmd = std::get_if<DrawCmd>(&cmd);
+			const DynamicDrawCmd *dynDrawCmd = std::get_if<DynamicDrawCmd>(&cmd);
+			if (!drawCmd && !dynDrawCmd)
+				continue;
+			const Program *p = drawCmd ? drawCmd->program : dynDrawCmd->program;
+			const size_t s = drawCmd ? drawCmd->renderStateHash : dynDrawCmd->renderStateHash;
+			programSwitches += p != program;
+			stateSwitches += s != renderState;
+			program = p;
+			renderState = s;
+		}
+		stats.AddToStatCount(programStat, programSwitches);
+		stats.AddToStatCount(stateStat, stateSwitches);
+	};
+
+	countSwitches(Graphics::Stats::STAT_PROGRAM_SWITCHES_UNSORTED, Graphics::Stats::STAT_RENDER_STATE_SWITCHES_UNSORTED);
+
+	size_t runStart = 0;
+	for (size_t i = 0; i <= m_drawCmds.size(); i++) {
+		if (i < m_drawCmds.size() && isSortable(m_drawCmds[i]))
+			continue;
+
+		if (i - runStart > 1) {
+			m_sortKeys.clear();
+			for (size_t j = runStart; j < i; j++) {
+				const DrawCmd &cmd = std::get<DrawCmd>(m_drawCmds[j]);
+				m_sortKeys.emplace_back(GetSortKey(cmd, getTextureBindings(cmd.shader, cmd.drawData), cmd.shader->GetNumTextureBindings()), j);
+			}
+			// equal keys keep their submission order
+			std::sort(m_sortKeys.begin(), m_sortKeys.end());
+
+			m_sortedCmds.clear();
+			for (const auto &key : m_sortKeys)
+				m_sortedCmds.emplace_back(std::move(m_drawCmds[key.second]));
+			std::move(m_sortedCmds.begin(), m_sortedCmds.end(), m_drawCmds.begin() + runStart);
+		}
+		runStart = i + 1;
+	}
+
+	countSwitches(Graphics::Stats::STAT_PROGRAM_SWITCHES, Graphics::Stats::STAT_RENDER_STATE_SWITCHES);
+}
+
+// The per-draw data of a command, as written to the draw uniform buffer
+static const DrawDataBlock *getDrawDataBlock(const Graphics::BufferBinding<UniformBuffer> &binding)
+{
+	if (!binding.buffer || binding.size != sizeof(DrawDataBlock))
+		return nullptr;
+	return reinterpret_cast<const DrawDataBlock *>(static_cast<UniformLinearBuffer *>(binding.buffer)->GetData() + binding.offset);
+}
+
+void CommandList::BatchDrawCmds(const Graphics::Stats &stats)
+{
+	PROFILE_SCOPED()
+
+	// draws can be merged if they only differ in their transform
+	auto canBatch = [](const DrawCmd &a, const Cmd &cmd, uint32_t drawDataIndex) {
+		const DrawCmd *b = std::get_if<DrawCmd>(&cmd);
+		if (!b || b->inst || b->mesh != a.mesh || b->instancedProgram != a.instancedProgram ||
+			b->shader != a.shader || b->renderStateHash != a.renderStateHash)
+			return false;
+
+		const Shader *shader = a.shader;
+		if (memcmp(a.drawData, b->drawData, shader->GetConstantStorageSize()) != 0)
+			return false;
+
+		const BufferBinding<UniformBuffer> *bufA = getBufferBindings(shader, a.drawData);
+		const BufferBinding<UniformBuffer> *bufB = getBufferBindings(shader, b->drawData);
+		for (size_t i = 0; i < shader->GetNumBufferBindings(); i++)
+			if (i != drawDataIndex && bufA[i] != bufB[i])
+				return false;
+
+		if (memcmp(getTextureBindings(shader, a.drawData), getTextureBindings(shader, b->drawData), shader->GetNumTextureBindings() * sizeof(TextureGL *)) != 0)
+			return false;
+
+		const DrawDataBlock *blockA = getDrawDataBlock(bufA[drawDataIndex]);
+		const DrawDataBlock *blockB = getDrawDataBlock(bufB[drawDataIndex]);
+		return blockA && blockB && memcmp(&blockA->diffuse, &blockB->diffuse, sizeof(DrawDataBlock) - offsetof(DrawDataBlock, diffuse)) == 0;
+	};
+
+	uint32_t numMerged = 0;
+	size_t out = 0;
+	for (size_t i = 0; i < m_drawCmds.size();) {
+		const DrawCmd *first = std::get_if<DrawCmd>(&m_drawCmds[i]);
+		BufferBindingData info = {};
+		size_t end = i + 1;
+		if (first && first->instancedProgram && !first->inst) {
+			info = first->shader->GetBufferBindingInfo(s_drawDataName);
+			if (info.binding != Shader::InvalidBinding)
+				while (end < m_drawCmds.size() && canBatch(*first, m_drawCmds[end], info.index))
+					end++;
+		}
+
+		if (end - i > 1) {
+			m_batchTransforms.clear();
+			for (size_t j = i; j < end; j++) {
+				const DrawCmd &cmd = std::get<DrawCmd>(m_drawCmds[j]);
+				m_batchTransforms.push_back(getDrawDataBlock(getBufferBindings(cmd.shader, cmd.drawData)[info.index])->uViewMatrix);
+			}
+
+			if (m_numBatchInstances == m_batchInstances.size())
+				m_batchInstances.emplace_back(new InstanceBuffer(1, BUFFER_USAGE_DYNAMIC, m_renderer->GetStreamBuffer()));
+			InstanceBuffer *inst = m_batchInstances[m_numBatchInstances++].Get();
+
+			if (inst->Stream(m_batchTransforms.data(), uint32_t(m_batchTransforms.size()))) {
+				DrawCmd merged = *first;
+				merged.inst = inst;
+				merged.program = first->instancedProgram;
+				merged.instancedProgram = nullptr;
+
+				const size_t drawDataSize = getDrawDataSize(merged.shader);
+				merged.drawData = AllocData(drawDataSize);
+				memcpy(merged.drawData, first->drawData, drawDataSize);
+
+				// the instance transforms already include the view transform
+				BufferBinding<UniformBuffer> &slot = getBufferBindings(merged.shader, merged.drawData)[info.index];
+				DrawDataBlock block = *getDrawDataBlock(slot);
+				block.uViewProjectionMatrix = block.uViewProjectionMatrix * block.uViewMatrixInverse;
+				block.uViewMatrix = matrix4x4f::Identity();
+				block.uViewMatrixInverse = matrix4x4f::Identity();
+				slot = m_renderer->GetDrawUniformBuffer(sizeof(DrawDataBlock))->Allocate(&block, sizeof(DrawDataBlock));
+
+				m_drawCmds[out++] = merged;
+				numMerged += uint32_t(end - i - 1);
+				i = end;
+				continue;
+			}
+		}
+
+		for (; i < end; i++, out++)
+			if (out != i)
+				m_drawCmds[out] = std::move(m_drawCmds[i]);
+	}
+
+	m_drawCmds.erase(m_drawCmds.begin() + out, m_drawCmds.end());
+	stats.AddToStatCount(Graphics::Stats::STAT_DRAWCALLS_BATCHED, numMerged);
+}
+
+void CommandList::Append(std::unique_ptr<CommandList> recording)
+{
+	PROFILE_SCOPED()
+	assert(!m_executing && "Attempt to append to a command list while it's being executed!");
+	assert(!m_recording && recording->m_recording);
+
+	for (const DeferredData &data : recording->m_deferredData) {
+		Cmd &cmd = recording->m_drawCmds[data.cmd];
+		Program *program = data.material->EvaluateVariant();
+		if (auto *drawCmd = std::get_if<DrawCmd>(&cmd)) {
+			drawCmd->program = program;
+			if (data.instancedMaterial)
+				drawCmd->instancedProgram = data.instancedMaterial->EvaluateVariant();
+		} else
+			std::get<DynamicDrawCmd>(cmd).program = program;
+
+		if (data.drawDataSlot)
+			*data.drawDataSlot = m_renderer->GetDrawUniformBuffer(sizeof(DrawDataBlock))->Allocate(const_cast<DrawDataBlock *>(data.drawDataBlock), sizeof(DrawDataBlock));
+	}
+
+	m_drawCmds.insert(m_drawCmds.end(), recording->m_drawCmds.begin(), recording->m_drawCmds.end());
+	m_appended.emplace_back(std::move(recording));
 }
 
 template <size_t I>
@@ -169,13 +412,8 @@ size_t align(size_t t)
 	return (t + (I - 1)) & ~(I - 1);
 }
 
-char *CommandList::AllocDrawData(const Shader *shader)
+char *CommandList::AllocData(size_t totalSize)
 {
-	size_t constantSize = align<8>(shader->GetConstantStorageSize());
-	size_t bufferSize = align<8>(shader->GetNumBufferBindings() * sizeof(BufferBinding<UniformBuffer>));
-	size_t textureSize = align<8>(shader->GetNumTextureBindings() * sizeof(Texture *));
-	size_t totalSize = constantSize + bufferSize + textureSize;
-
 	char *alloc = nullptr;
 	for (auto &bucket : m_dataBuckets) {
 		if ((alloc = bucket.alloc(totalSize)))
@@ -190,6 +428,22 @@ char *CommandList::AllocDrawData(const Shader *shader)
 	}
 
 	assert(alloc != nullptr);
+	return alloc;
+}
+
+size_t CommandList::getDrawDataSize(const Shader *shader)
+{
+	size_t constantSize = align<8>(shader->GetConstantStorageSize());
+	size_t bufferSize = align<8>(shader->GetNumBufferBindings() * sizeof(BufferBinding<UniformBuffer>));
+	size_t textureSize = align<8>(shader->GetNumTextureBindings() * sizeof(Texture *));
+	return constantSize + bufferSize + textureSize;
+}
+
+char *CommandList::AllocDrawData(const Shader *shader)
+{
+	size_t totalSize = getDrawDataSize(shader);
+
+	char *alloc = AllocData(totalSize);
 	memset(alloc, '\0', totalSize);
 	return alloc;
 }
@@ -210,7 +464,6 @@ TextureGL **CommandList::getTextureBindings(const Shader *shader, char *data)
 char *CommandList::SetupMaterialData(OGL::Material *mat)
 {
 	PROFILE_SCOPED()
-	mat->UpdateDrawData();
 	const Shader *s = mat->GetShader();
 
 	char *alloc = AllocDrawData(s);
@@ -228,6 +481,25 @@ char *CommandList::SetupMaterialData(OGL::Material *mat)
 		textures[index] = static_cast<TextureGL *>(mat->m_textureBindings[index]);
 	}
 
+	if (!m_recording) {
+		ViewState view;
+		view.transform = m_renderer->GetTransform();
+		view.projection = m_renderer->GetProjection();
+		view.ambient = m_renderer->GetAmbientColor();
+		view.numLights = m_renderer->GetNumLights();
+		for (Uint32 i = 0; i < view.numLights; i++)
+			view.lightIntensity[i] = m_renderer->GetLight(i).GetIntensity();
+
+		DrawDataBlock block;
+		if (BufferBinding<UniformBuffer> *slot = mat->UpdateDrawData(view, alloc, buffers, block))
+			*slot = m_renderer->GetDrawUniformBuffer(sizeof(DrawDataBlock))->Allocate(&block, sizeof(DrawDataBlock));
+	} else {
+		// the block stays in the recording's data until it is submitted
+		DrawDataBlock *block = new (AllocData(sizeof(DrawDataBlock))) DrawDataBlock;
+		BufferBinding<UniformBuffer> *slot = mat->UpdateDrawData(m_view, alloc, buffers, *block);
+		m_deferredData.push_back({ m_drawCmds.size(), mat, nullptr, slot, block });
+	}
+
 	return alloc;
 }
 
@@ -356,3 +628,9 @@ void CommandList::ExecuteBlitRenderTargetCmd(const BlitRenderTargetCmd &cmd)
 	CHECKERRORS();
 
 }
+
+void CommandList::ExecuteGPUTimerCmd(const GPUTimerCmd &cmd)
+{
+	glQueryCounter(cmd.query, GL_TIMESTAMP);
+	CHECKERRORS();
+}
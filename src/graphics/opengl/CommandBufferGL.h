@@ -5,10 +5,15 @@
 
 #include "Color.h"
 #include "graphics/Graphics.h"
+#include "graphics/Renderer.h"
 #include "graphics/Types.h"
 #include "graphics/VertexBuffer.h"
 
+#include "MaterialGL.h"
 #include "OpenGLLibs.h"
+#include "RefCounted.h"
+#include "VertexBufferGL.h"
+#include <memory>
 #include <variant>
 
 namespace Graphics {
@@ -33,15 +38,23 @@ namespace Graphics {
 		class UniformBuffer;
 		class VertexBuffer;
 
-		class CommandList {
+		// A command list is either the renderer's own, recorded and executed
+		// on the render thread, or a recording made on a worker thread. A
+		// recording leaves everything that needs the GL context or the
+		// renderer's shared buffers (shader variants, per-draw uniform
+		// allocations) until it is appended to the renderer's list.
+		class CommandList : public Graphics::CommandRecording {
 		public:
 			struct DrawCmd {
 				MeshObject *mesh;
 				InstanceBuffer *inst = nullptr;
 				const Shader *shader = nullptr;
 				Program *program = nullptr;
+				// the instanced variant, if the draw may be merged with others
+				Program *instancedProgram = nullptr;
 				size_t renderStateHash = 0;
 				char *drawData;
+				float depth; // distance from the camera, for sorting
 			};
 
 			struct DynamicDrawCmd {
@@ -74,13 +87,17 @@ namespace Graphics {
 				bool linearFilter;
 			};
 
+			struct GPUTimerCmd {
+				GLuint query;
+			};
+
 			// development asserts to ensure sizes are kept reasonable.
 			// if you need to go beyond these sizes, add a new command instead.
 			static_assert(sizeof(DrawCmd) <= 64);
 			static_assert(sizeof(DynamicDrawCmd) <= 64);
 			static_assert(sizeof(RenderPassCmd) <= 64);
 
-			void AddDrawCmd(Graphics::MeshObject *mesh, Graphics::Material *mat, Graphics::InstanceBuffer *inst = nullptr);
+			void AddDrawCmd(Graphics::MeshObject *mesh, Graphics::Material *mat, Graphics::InstanceBuffer *inst = nullptr, Graphics::Material *instancedMat = nullptr);
 			void AddDynamicDrawCmd(BufferBinding<Graphics::VertexBuffer> vtx, BufferBinding<Graphics::IndexBuffer> idx, Graphics::Material *mat);
 
 			void AddRenderPassCmd(RenderTarget *renderTarget, ViewportExtents extents);
@@ -95,13 +112,40 @@ namespace Graphics {
 				const ViewportExtents &dstExtents,
 				bool resolveMSAA = false, bool blitDepthBuffer = false, bool linearFilter = true);
 
+			// Write the GPU timestamp to the query once the commands before
+			// it have been executed
+			void AddGPUTimerCmd(GLuint query);
+
 		protected:
-			using Cmd = std::variant<DrawCmd, DynamicDrawCmd, RenderPassCmd, BlitRenderTargetCmd>;
+			using Cmd = std::variant<DrawCmd, DynamicDrawCmd, RenderPassCmd, BlitRenderTargetCmd, GPUTimerCmd>;
 			const std::vector<Cmd> &GetDrawCmds() const { return m_drawCmds; }
 
 			bool IsEmpty() const { return m_drawCmds.empty(); }
 			void Reset();
 
+			// Start over as a recording with the given view
+			void BeginRecording(const ViewState &view);
+			bool IsRecording() const { return m_recording; }
+			void SetTransform(const matrix4x4f &m) { m_view.transform = m; }
+			const matrix4x4f &GetTransform() const { return m_view.transform; }
+
+			// Reorder runs of opaque, depth-tested draw commands so that draws
+			// with the same program, render state and material are next to
+			// each other, nearest first. Everything else, including blended
+			// geometry and render passes, keeps its place and order.
+			void SortDrawCmds(const Graphics::Stats &stats);
+
+			// Merge runs of draw commands of the same mesh and material state
+			// that were drawn with DrawMeshBatched() into instanced draws.
+			// Must be called before the renderer's buffers are flushed, as it
+			// writes the instance transforms and new draw data.
+			void BatchDrawCmds(const Graphics::Stats &stats);
+
+			// Resolve the deferred data of a finished recording and move its
+			// commands to the end of this list. The recording is kept until
+			// this list is reset, as the commands point into its data.
+			void Append(std::unique_ptr<CommandList> recording);
+
 		private:
 			friend class Graphics::RendererOGL;
 			CommandList(Graphics::RendererOGL *r) :
@@ -110,6 +154,7 @@ namespace Graphics {
 				m_drawCmds.reserve(32);
 			}
 
+			char *AllocData(size_t size);
 			// Allocate space for all shader data that needs to be cached forward
 			char *AllocDrawData(const Shader *shader);
 			// Create and cache all material data needed for later execution of a draw command
@@ -122,7 +167,9 @@ namespace Graphics {
 			void ExecuteDynamicDrawCmd(const DynamicDrawCmd &);
 			void ExecuteRenderPassCmd(const RenderPassCmd &);
 			void ExecuteBlitRenderTargetCmd(const BlitRenderTargetCmd &);
+			void ExecuteGPUTimerCmd(const GPUTimerCmd &);
 
+			static size_t getDrawDataSize(const Shader *shader);
 			static BufferBinding<UniformBuffer> *getBufferBindings(const Shader *shader, char *data);
 			static TextureGL **getTextureBindings(const Shader *shader, char *data);
 
@@ -145,10 +192,34 @@ namespace Graphics {
 				}
 			};
 
+			// What a recording leaves for Append() to fill in for a draw command
+			struct DeferredData {
+				size_t cmd;
+				OGL::Material *material;
+				OGL::Material *instancedMaterial;
+				BufferBinding<UniformBuffer> *drawDataSlot;
+				const DrawDataBlock *drawDataBlock;
+			};
+
 			Graphics::RendererOGL *m_renderer;
 			std::vector<Cmd> m_drawCmds;
 			std::vector<DataBucket> m_dataBuckets;
 			bool m_executing = false;
+
+			bool m_recording = false;
+			ViewState m_view;
+			std::vector<DeferredData> m_deferredData;
+			std::vector<std::unique_ptr<CommandList>> m_appended;
+
+			// scratch space for SortDrawCmds()
+			std::vector<std::pair<uint64_t, size_t>> m_sortKeys;
+			std::vector<Cmd> m_sortedCmds;
+
+			// instance buffers for merged draws, reused every time the list
+			// is reset
+			std::vector<RefCountedPtr<InstanceBuffer>> m_batchInstances;
+			size_t m_numBatchInstances = 0;
+			std::vector<matrix4x4f> m_batchTransforms;
 		};
 
 	}; // namespace OGL
@@ -4,6 +4,9 @@
 #pragma once
 
 #include "OpenGLLibs.h"
+#include "graphics/GPUMemory.h"
+
+#include <cstdint>
 
 namespace Graphics {
 
@@ -11,13 +14,45 @@ namespace Graphics {
 
 		class GLBufferBase {
 		public:
-			GLBufferBase() :
-				m_written(false) {}
+			GLBufferBase(GPUMemory::Kind memoryKind) :
+				m_written(false),
+				m_memoryKind(memoryKind),
+				m_memoryTag(MemoryTag::GetCurrent()) {}
+			~GLBufferBase() { SetStorageSize(0); }
 			GLuint GetBuffer() const { return m_buffer; }
 
+			// The buffer and offset draws source the data from; dynamic buffers
+			// may keep it in a subrange of the renderer's stream buffer instead
+			GLuint GetBindingBuffer() const { return m_streamBuffer ? m_streamBuffer : m_buffer; }
+			uint32_t GetBindingOffset() const { return m_streamOffset; }
+			bool IsStreamed() const { return m_streamBuffer != 0; }
+
+			// for data written to the buffer behind its back, e.g. on the
+			// upload thread
+			void MarkWritten() { m_written = true; }
+
 		protected:
+			// Records the size of the buffer's own storage after a glBufferData
+			void SetStorageSize(size_t bytes)
+			{
+				if (bytes == m_storageSize)
+					return;
+				if (m_storageSize)
+					GPUMemory::Free(m_memoryKind, m_memoryTag, m_storageSize);
+				if (bytes)
+					GPUMemory::Allocate(m_memoryKind, m_memoryTag, bytes);
+				m_storageSize = bytes;
+			}
+
 			GLuint m_buffer;
 			bool m_written; // to check for invalid data rendering
+			GLuint m_streamBuffer = 0;
+			uint32_t m_streamOffset = 0;
+
+		private:
+			const GPUMemory::Kind m_memoryKind;
+			const MemoryTag::Tag m_memoryTag;
+			size_t m_storageSize = 0;
 		};
 
 	} // namespace OGL
@@ -0,0 +1,136 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "GPUTimer.h"
+
+#include "profiler/Profiler.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+using namespace Graphics::OGL;
+
+GPUTimer::GPUTimer() :
+	m_frame(0)
+{
+	for (Frame &frame : m_frames)
+		glGenQueries(MAX_QUERIES, frame.queries);
+}
+
+GPUTimer::~GPUTimer()
+{
+	for (Frame &frame : m_frames)
+		glDeleteQueries(MAX_QUERIES, frame.queries);
+}
+
+uint32_t GPUTimer::AllocQuery()
+{
+	Frame &frame = m_frames[m_frame];
+	if (frame.numQueries == MAX_QUERIES)
+		return NO_SCOPE;
+	return frame.numQueries++;
+}
+
+GLuint GPUTimer::BeginScope(const char *name)
+{
+	Frame &frame = m_frames[m_frame];
+
+	// keep a query back for the end of the scope
+	const uint32_t query = frame.numQueries + 1 < MAX_QUERIES ? AllocQuery() : NO_SCOPE;
+	if (query == NO_SCOPE) {
+		m_openScopes.push_back(NO_SCOPE);
+		return 0;
+	}
+
+	m_openScopes.push_back(uint32_t(frame.scopes.size()));
+	frame.scopes.push_back({ name, uint32_t(m_openScopes.size() - 1), query, NO_SCOPE });
+	return frame.queries[query];
+}
+
+GLuint GPUTimer::EndScope()
+{
+	assert(!m_openScopes.empty());
+	const uint32_t scope = m_openScopes.back();
+	m_openScopes.pop_back();
+	if (scope == NO_SCOPE)
+		return 0;
+
+	Frame &frame = m_frames[m_frame];
+	frame.scopes[scope].endQuery = AllocQuery();
+	return frame.queries[frame.scopes[scope].endQuery];
+}
+
+bool GPUTimer::ReadFrame(Frame &frame)
+{
+	// the last query of a frame is written last
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.numQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return false;
+
+	// a capture places the scopes on the CPU timeline, by the GPU clock now
+	const bool capturing = Profiler::capturing();
+	GLint64 gpuNow = 0;
+	Profiler::u64 cpuNow = 0;
+	if (capturing) {
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		cpuNow = Profiler::Clock::getticks();
+	}
+	const auto toCpu = [&](GLuint64 gpuTime) {
+		const std::chrono::nanoseconds ago(gpuNow - GLint64(gpuTime));
+		return cpuNow - std::chrono::duration_cast<std::chrono::steady_clock::duration>(ago).count();
+	};
+
+	m_timings.clear();
+	for (const Scope &scope : frame.scopes) {
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(frame.queries[scope.beginQuery], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.queries[scope.endQuery], GL_QUERY_RESULT, &end);
+		const float ms = float(end - begin) * 1e-6f;
+
+		if (capturing)
+			Profiler::captureevent("GPU", scope.name, toCpu(begin), toCpu(end));
+
+		// add to a sibling of the same name, searching back to the parent
+		bool merged = false;
+		for (auto it = m_timings.rbegin(); it != m_timings.rend() && it->depth >= scope.depth; ++it) {
+			if (it->depth == scope.depth && strcmp(it->name, scope.name) == 0) {
+				it->milliseconds += ms;
+				merged = true;
+				break;
+			}
+		}
+
+		if (!merged)
+			m_timings.push_back({ scope.name, scope.depth, ms });
+	}
+
+	return true;
+}
+
+void GPUTimer::EndFrame(Graphics::Stats &stats)
+{
+	PROFILE_SCOPED()
+	assert(m_openScopes.empty());
+	m_openScopes.clear();
+
+	// scopes without an end timestamp can't be measured
+	Frame &current = m_frames[m_frame];
+	for (size_t i = 0; i < current.scopes.size(); i++) {
+		if (current.scopes[i].endQuery == NO_SCOPE) {
+			current.scopes.resize(i);
+			break;
+		}
+	}
+
+	m_frame = (m_frame + 1) % NUM_FRAMES;
+
+	// the oldest frame's queries are about to be reused
+	Frame &oldest = m_frames[m_frame];
+	if (!oldest.scopes.empty() && ReadFrame(oldest))
+		stats.SetGPUTimings(m_timings);
+
+	oldest.numQueries = 0;
+	oldest.scopes.clear();
+}
@@ -0,0 +1,79 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#pragma once
+
+#include "OpenGLLibs.h"
+#include "graphics/Stats.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Graphics {
+
+	namespace OGL {
+
+		/*
+			Measures the GPU time of nested, named scopes with timestamp
+			queries. Each scope takes a query for its start and one for its
+			end; the renderer writes the timestamps when it executes the
+			commands in between.
+
+			The queries of the last few frames are kept in flight, so a
+			frame's results are only read back once the GPU has finished with
+			it and reading them never stalls. The timings of a frame that
+			isn't done yet by then are dropped.
+		*/
+		class GPUTimer {
+		public:
+			GPUTimer();
+			~GPUTimer();
+
+			// Don't copy a timer
+			GPUTimer(const GPUTimer &) = delete;
+			GPUTimer &operator=(const GPUTimer &) = delete;
+
+			// Open a scope and return the query to write its start timestamp
+			// to, or 0 if this frame has run out of queries. The name must
+			// outlive the timer; scopes of the same name next to each other
+			// are added up.
+			GLuint BeginScope(const char *name);
+			// Close the innermost open scope and return the query for its end
+			// timestamp, or 0
+			GLuint EndScope();
+
+			// Finish the current frame and pass the timings of the oldest
+			// frame in flight to the stats, if they are available
+			void EndFrame(Graphics::Stats &stats);
+
+		private:
+			static constexpr uint32_t NUM_FRAMES = 3;
+			static constexpr uint32_t MAX_QUERIES = 256;
+			static constexpr uint32_t NO_SCOPE = ~0U;
+
+			struct Scope {
+				const char *name;
+				uint32_t depth;
+				uint32_t beginQuery;
+				uint32_t endQuery;
+			};
+
+			struct Frame {
+				GLuint queries[MAX_QUERIES];
+				uint32_t numQueries = 0;
+				std::vector<Scope> scopes;
+			};
+
+			GLuint AllocQuery();
+			bool ReadFrame(Frame &frame);
+
+			Frame m_frames[NUM_FRAMES];
+			uint32_t m_frame;
+			// indices of the open scopes in the current frame, innermost last
+			std::vector<uint32_t> m_openScopes;
+			std::vector<Graphics::Stats::GPUTiming> m_timings;
+		};
+
+	} // namespace OGL
+
+} // namespace Graphics
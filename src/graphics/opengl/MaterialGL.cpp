@@ -17,23 +17,10 @@
 namespace Graphics {
 	namespace OGL {
 
-		struct DrawDataBlock {
-			// matrix data
-			matrix4x4f uViewMatrix;
-			matrix4x4f uViewMatrixInverse;
-			matrix4x4f uViewProjectionMatrix;
-
-			// Material Struct
-			Color4f diffuse;
-			Color4f specular;
-			Color4f emission;
-
-			// Scene struct
-			Color4f ambient;
-		};
-		static_assert(sizeof(DrawDataBlock) == 256, "");
-
 		static size_t s_lightDataName = "LightData"_hash;
+		static size_t s_pointLightDataName = "PointLightData"_hash;
+		static size_t s_lightClusterDataName = "LightClusterData"_hash;
+		static size_t s_lightIndexDataName = "LightIndexData"_hash;
 		static size_t s_drawDataName = "DrawData"_hash;
 		static size_t s_lightIntensityName = "lightIntensity"_hash;
 
@@ -93,42 +80,49 @@ namespace Graphics {
 			return m_activeVariant;
 		}
 
-		void Material::UpdateDrawData()
+		template <typename T>
+		bool SetConstant(size_t name, T &data, ConstantDataFormat format, Shader *p, char *stor);
+
+		BufferBinding<UniformBuffer> *Material::UpdateDrawData(const ViewState &view, char *pushConstants, BufferBinding<UniformBuffer> *buffers, DrawDataBlock &block) const
 		{
 			PROFILE_SCOPED()
-
 			if (m_descriptor.lighting) {
-				UniformBuffer *lightBuffer = m_renderer->GetLightUniformBuffer();
-				SetBuffer(s_lightDataName, { lightBuffer, 0, lightBuffer->GetSize() });
+				// the same buffers for every draw, only bound where the
+				// shader has the block
+				const auto bindLightBuffer = [&](size_t name, UniformBuffer *buffer) {
+					BufferBindingData info = m_shader->GetBufferBindingInfo(name);
+					if (info.binding != Shader::InvalidBinding)
+						buffers[info.index] = { buffer, 0, buffer->GetSize() };
+				};
+				bindLightBuffer(s_lightDataName, m_renderer->GetLightUniformBuffer());
+				bindLightBuffer(s_pointLightDataName, m_renderer->GetPointLightBuffer());
+				bindLightBuffer(s_lightClusterDataName, m_renderer->GetLightClusterBuffer());
+				bindLightBuffer(s_lightIndexDataName, m_renderer->GetLightIndexBuffer());
 
 				float intensity[4] = { 0.f, 0.f, 0.f, 0.f };
-				for (uint32_t i = 0; i < m_renderer->GetNumLights(); i++)
-					intensity[i] = m_renderer->GetLight(i).GetIntensity();
+				for (uint32_t i = 0; i < view.numLights; i++)
+					intensity[i] = view.lightIntensity[i];
 
-				SetPushConstant(s_lightIntensityName, Color4f(intensity[0], intensity[1], intensity[2], intensity[3]));
+				Color4f lightIntensity(intensity[0], intensity[1], intensity[2], intensity[3]);
+				SetConstant(s_lightIntensityName, lightIntensity, ConstantDataFormat::DATA_FORMAT_FLOAT4, m_shader, pushConstants);
 			}
 
 			// this should always be present, but just in case...
-			if (m_perDrawBinding != Shader::InvalidBinding) {
-				auto buffer = m_renderer->GetDrawUniformBuffer(sizeof(DrawDataBlock));
-				BufferBinding<UniformBuffer> binding;
-
-				auto dataBlock = buffer->Allocate<DrawDataBlock>(binding);
-				dataBlock->diffuse = this->diffuse.ToColor4f();
-				dataBlock->specular = this->specular.ToColor4f();
-				dataBlock->specular.a = this->shininess;
-				dataBlock->emission = this->emissive.ToColor4f();
-				dataBlock->ambient = m_renderer->GetAmbientColor().ToColor4f();
-
-				// We handle the normal matrix by transposing the orientation part of the inverse view matrix in the shader
-				const matrix4x4f &mv = m_renderer->GetTransform();
-				const matrix4x4f &proj = m_renderer->GetProjection();
-				dataBlock->uViewMatrix = mv;
-				dataBlock->uViewMatrixInverse = mv.Inverse();
-				dataBlock->uViewProjectionMatrix = proj * mv;
-
-				SetBuffer(s_drawDataName, { binding.buffer, binding.offset, binding.size });
-			}
+			if (m_perDrawBinding == Shader::InvalidBinding)
+				return nullptr;
+
+			block.diffuse = this->diffuse.ToColor4f();
+			block.specular = this->specular.ToColor4f();
+			block.specular.a = this->shininess;
+			block.emission = this->emissive.ToColor4f();
+			block.ambient = view.ambient.ToColor4f();
+
+			// We handle the normal matrix by transposing the orientation part of the inverse view matrix in the shader
+			block.uViewMatrix = view.transform;
+			block.uViewMatrixInverse = view.transform.Inverse();
+			block.uViewProjectionMatrix = view.projection * view.transform;
+
+			return &buffers[m_shader->GetBufferBindingInfo(s_drawDataName).index];
 		}
 
 		bool Material::IsProgramLoaded() const
@@ -192,6 +186,15 @@ namespace Graphics {
 			return true;
 		}
 
+		Texture *Material::GetTexture(size_t name) const
+		{
+			TextureBindingData info = m_shader->GetTextureBindingInfo(name);
+			if (info.binding == Shader::InvalidBinding)
+				return nullptr;
+
+			return m_textureBindings.get()[info.index];
+		}
+
 		bool Material::SetBufferDynamic(size_t name, void *buffer, size_t size)
 		{
 			BufferBindingData info = m_shader->GetBufferBindingInfo(name);
@@ -32,6 +32,32 @@ namespace Graphics {
 		class Program;
 		class UniformBuffer;
 
+		// Per-draw uniform block of every shader
+		struct DrawDataBlock {
+			// matrix data
+			matrix4x4f uViewMatrix;
+			matrix4x4f uViewMatrixInverse;
+			matrix4x4f uViewProjectionMatrix;
+
+			// Material Struct
+			Color4f diffuse;
+			Color4f specular;
+			Color4f emission;
+
+			// Scene struct
+			Color4f ambient;
+		};
+		static_assert(sizeof(DrawDataBlock) == 256, "");
+
+		// The renderer state a draw command's data is set up from
+		struct ViewState {
+			matrix4x4f transform;
+			matrix4x4f projection;
+			Color ambient;
+			Uint32 numLights;
+			float lightIntensity[4];
+		};
+
 		class Material : public Graphics::Material {
 		public:
 			Material() {}
@@ -41,6 +67,7 @@ namespace Graphics {
 			virtual const Shader *GetShader() const { return m_shader; }
 
 			virtual bool SetTexture(size_t name, Texture *tex) override;
+			virtual Texture *GetTexture(size_t name) const override;
 
 			virtual bool SetBufferDynamic(size_t name, void *buffer, size_t size) override;
 			virtual bool SetBuffer(size_t name, BufferBinding<Graphics::UniformBuffer> ub) override;
@@ -58,7 +85,11 @@ namespace Graphics {
 			friend class OGL::CommandList;
 			void Copy(OGL::Material *to) const;
 			Program *EvaluateVariant();
-			void UpdateDrawData();
+			// Fill in the lighting data of a copy of this material's push
+			// constants and buffer bindings, and the per-draw block for it,
+			// without changing the material. Returns the slot in the copied
+			// bindings the block has to be bound to, if any.
+			BufferBinding<UniformBuffer> *UpdateDrawData(const ViewState &view, char *pushConstants, BufferBinding<UniformBuffer> *buffers, DrawDataBlock &block) const;
 
 			Shader *m_shader;
 			Program *m_activeVariant;
@@ -2,16 +2,19 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "Program.h"
+#include "DiskCache.h"
 #include "FileSystem.h"
 #include "Shader.h"
 #include "StringF.h"
 #include "StringRange.h"
 #include "graphics/Graphics.h"
 #include "graphics/Renderer.h"
+#include "graphics/ShaderParser.h"
 #include "graphics/Types.h"
 #include "utils.h"
+#include "core/FNV1a.h"
 
-#include <set>
+#include <cstring>
 #include <sstream>
 
 namespace Graphics {
@@ -23,6 +26,14 @@ namespace Graphics {
 		// #version 330 for OpenGL3.3
 		static const char *s_glslVersion = "#version 140\n";
 
+		// Linked program binaries, keyed by the driver and the complete
+		// shader source. Bump the version when anything else that goes
+		// into linking a program (e.g. the attribute bindings) changes.
+		static const Uint32 PROGRAM_CACHE_VERSION = 1;
+		static DiskCache s_binaryCache("shader_cache", PROGRAM_CACHE_VERSION);
+		// binaries are only valid for the driver that produced them
+		static std::string s_driverString;
+
 		// Check and warn about compile & link errors
 		static bool check_glsl_errors(const char *filename, GLuint obj)
 		{
@@ -85,47 +96,17 @@ namespace Graphics {
 		//       ShaderProgram (vertex)
 		//       ShaderProgram (fragment)
 		struct ShaderProgram {
-			ShaderProgram(GLenum type, const std::string &filename, const std::string &defines)
+			ShaderProgram(GLenum type, const std::string &filename, const std::string &defines) :
+				type(type),
+				filename(filename)
 			{
-				RefCountedPtr<FileSystem::FileData> filecode = FileSystem::gameDataFiles.ReadFile(filename);
-
-				if (!filecode.Valid())
+				// the expanded source is shared with the other variants, and
+				// only built again once the files change
+				code = ShaderParser::SourceCache::Get().GetExpandedSource(filename, "shaders/opengl");
+				if (!code)
 					Error("Could not load %s", filename.c_str());
 
-				std::string strCode(filecode->AsStringRange().ToString());
-				size_t found = strCode.find("#include");
-				while (found != std::string::npos) {
-					// find the name of the file to include
-					const size_t begFilename = strCode.find_first_of("\"", found + 8) + 1;
-					const size_t endFilename = strCode.find_first_of("\"", begFilename + 1);
-
-					const std::string incFilename = strCode.substr(begFilename, endFilename - begFilename);
-
-					// check we haven't it already included it (avoids circular dependencies)
-					const std::set<std::string>::const_iterator foundIt = previousIncludes.find(incFilename);
-					if (foundIt != previousIncludes.end()) {
-						Error("Circular, or multiple, include of %s\n", incFilename.c_str());
-					} else {
-						previousIncludes.insert(incFilename);
-					}
-
-					// build path for include
-					const std::string incPathBuffer = stringf("shaders/opengl/%0", incFilename);
-
-					// read included file
-					RefCountedPtr<FileSystem::FileData> incCode = FileSystem::gameDataFiles.ReadFile(incPathBuffer);
-					assert(incCode.Valid());
-
-					if (incCode.Valid()) {
-						// replace the #include and filename with the included files text
-						strCode.replace(found, (endFilename + 1) - found, incCode->GetData(), incCode->GetSize());
-						found = strCode.find("#include");
-					} else {
-						Error("Could not load shader #include %s for shader %s\n", incPathBuffer.c_str(), filename.c_str());
-					}
-				}
-				// Store the modified text with the included files (if any)
-				const StringRange code(strCode.c_str(), strCode.size());
+				const StringRange codeRange(code->c_str(), code->size());
 
 				// Build the final shader text to be compiled
 				AppendSource(s_glslVersion);
@@ -135,7 +116,7 @@ namespace Graphics {
 				} else {
 					AppendSource("#define FRAGMENT_SHADER\n");
 				}
-				AppendSource(code.StripUTF8BOM());
+				AppendSource(codeRange.StripUTF8BOM());
 #if 0
 		static bool s_bDumpShaderSource = true;
 		if (s_bDumpShaderSource) {
@@ -160,17 +141,39 @@ namespace Graphics {
 			}
 		}
 #endif
+			};
+
+			// Create and compile the shader; shader is 0 if that fails.
+			// Without the check, the driver is free to compile it in the
+			// background until the result is asked for.
+			void Compile(bool check = true)
+			{
 				shader = glCreateShader(type);
 				if (glIsShader(shader) != GL_TRUE)
 					throw ShaderCompileException();
 
 				Compile(shader);
 
-				if (!check_glsl_errors(filename.c_str(), shader)) {
+				if (check && !check_glsl_errors(filename.c_str(), shader)) {
 					glDeleteShader(shader);
 					shader = 0;
 				}
-			};
+			}
+
+			// Append the text that gets compiled
+			void AppendSourceTo(std::string &out) const
+			{
+				for (size_t i = 0; i < blocks.size(); i++)
+					out.append(blocks[i], block_sizes[i]);
+			}
+
+			// Take ownership of the shader
+			GLuint Release()
+			{
+				GLuint id = shader;
+				shader = 0;
+				return id;
+			}
 
 			~ShaderProgram()
 			{
@@ -200,30 +203,132 @@ namespace Graphics {
 				glCompileShader(shader_id);
 			}
 
+			GLenum type;
+			std::string filename;
+			// the shader code with its includes; blocks point into it
+			std::shared_ptr<const std::string> code;
 			std::vector<const char *> blocks;
 			std::vector<GLint> block_sizes;
-			std::set<std::string> previousIncludes;
 		};
 
+		// ====================================================================
+		// Program Binary Cache
+		//
+
+		// Returns the program stored for the key, or 0
+		static GLuint load_program_binary(uint64_t key)
+		{
+			PROFILE_SCOPED()
+			std::string data;
+			if (!s_binaryCache.Load(key, data) || data.size() <= sizeof(GLenum))
+				return 0;
+
+			GLenum format;
+			memcpy(&format, data.data(), sizeof(GLenum));
+
+			GLuint program = glCreateProgram();
+			glProgramBinary(program, format, data.data() + sizeof(GLenum), GLsizei(data.size() - sizeof(GLenum)));
+
+			GLint status = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if (status == GL_TRUE)
+				return program;
+
+			// drivers may reject their own binaries, e.g. after an update
+			// that didn't change the version string
+			glDeleteProgram(program);
+			s_binaryCache.Remove(key);
+			return 0;
+		}
+
+		static void store_program_binary(GLuint program, uint64_t key)
+		{
+			PROFILE_SCOPED()
+			GLint length = 0;
+			glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+			if (length <= 0)
+				return;
+
+			// the binary is stored after its format
+			std::string data(sizeof(GLenum) + length, '\0');
+			GLenum format = 0;
+			GLsizei written = 0;
+			glGetProgramBinary(program, length, &written, &format, &data[sizeof(GLenum)]);
+			if (written <= 0)
+				return;
+
+			memcpy(&data[0], &format, sizeof(GLenum));
+			data.resize(sizeof(GLenum) + written);
+			s_binaryCache.Store(key, data);
+		}
+
+		void Program::InitBinaryCache(size_t maxBytes)
+		{
+			GLint numFormats = 0;
+			if (glewIsSupported("GL_ARB_get_program_binary"))
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+
+			if (numFormats <= 0) {
+				Log::Info("Program binaries aren't supported, shaders will be compiled from source\n");
+				return;
+			}
+
+			s_driverString = std::string(glstr_to_str(glGetString(GL_VENDOR))) + "\n" +
+				glstr_to_str(glGetString(GL_RENDERER)) + "\n" +
+				glstr_to_str(glGetString(GL_VERSION)) + "\n";
+			s_binaryCache.Init(maxBytes);
+		}
+
+		void Program::UninitBinaryCache()
+		{
+			s_binaryCache.Uninit();
+		}
+
 		// ====================================================================
 		// Program Setup and Creation
 		//
 
-		Program::Program(Shader *shader, const ProgramDef &def) :
+		Program::Program(Shader *shader, const ProgramDef &def, bool async) :
 			m_program(0),
-			success(false)
+			success(false),
+			m_linking(false),
+			m_pendingShaders{ 0, 0 },
+			m_cacheKey(0)
 		{
-			m_program = LoadShaders(def);
+			m_program = LoadShaders(def, async);
 			if (success)
 				InitUniforms(shader);
 		}
 
 		Program::~Program()
 		{
+			for (GLuint id : m_pendingShaders)
+				if (id)
+					glDeleteShader(id);
 			if (m_program)
 				glDeleteProgram(m_program);
 		}
 
+		void Program::FinishLoading(Shader *shader)
+		{
+			if (!m_linking)
+				return;
+
+			PROFILE_SCOPED()
+			m_linking = false;
+
+			// only the failed shaders log anything
+			for (GLuint &id : m_pendingShaders) {
+				check_glsl_errors(m_name.c_str(), id);
+				glDeleteShader(id);
+				id = 0;
+			}
+
+			m_program = FinishLink(m_program, m_name, m_cacheKey);
+			if (success)
+				InitUniforms(shader);
+		}
+
 		void Program::Reload(Shader *shader, const ProgramDef &def)
 		{
 			GLuint newProg = LoadShaders(def);
@@ -235,14 +340,33 @@ namespace Graphics {
 		}
 
 		//load, compile and link
-		GLuint Program::LoadShaders(const ProgramDef &def)
+		GLuint Program::LoadShaders(const ProgramDef &def, bool async)
 		{
 			PROFILE_SCOPED()
 
-			//load, create and compile shaders
+			//load shader sources
 			ShaderProgram vs(GL_VERTEX_SHADER, def.vertexShader, def.defines);
 			ShaderProgram fs(GL_FRAGMENT_SHADER, def.fragmentShader, def.defines);
 
+			//use the binary linked from the same source last time, if there is one
+			uint64_t cacheKey = 0;
+			if (s_binaryCache.IsEnabled()) {
+				std::string key = s_driverString;
+				vs.AppendSourceTo(key);
+				fs.AppendSourceTo(key);
+				cacheKey = hash_64_fnv1a(key.data(), key.size());
+
+				GLuint program = load_program_binary(cacheKey);
+				if (program) {
+					success = true;
+					return program;
+				}
+			}
+
+			//compile shaders
+			vs.Compile(!async);
+			fs.Compile(!async);
+
 			if (!vs.shader || !fs.shader) {
 				Log::Warning("Error loading GLSL shaders for program {}\n", def.name);
 				success = false;
@@ -271,15 +395,37 @@ namespace Graphics {
 			// TODO: setup fragment output locations from shaderdef attributes
 			glBindFragDataLocation(program, 0, "frag_color");
 
+			if (cacheKey)
+				glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 			glLinkProgram(program);
-			success = check_glsl_errors(def.name.c_str(), program);
+
+			//the errors are checked once the program is needed
+			if (async) {
+				m_pendingShaders[0] = vs.Release();
+				m_pendingShaders[1] = fs.Release();
+				m_name = def.name;
+				m_cacheKey = cacheKey;
+				m_linking = true;
+				return program;
+			}
+
+			//shaders may now be deleted by Shader destructor
+			return FinishLink(program, def.name, cacheKey);
+		}
+
+		GLuint Program::FinishLink(GLuint program, const std::string &name, uint64_t cacheKey)
+		{
+			success = check_glsl_errors(name.c_str(), program);
 
 			if (!success) {
 				glDeleteProgram(program);
 				return 0;
 			}
 
-			//shaders may now be deleted by Shader destructor
+			if (cacheKey)
+				store_program_binary(program, cacheKey);
+
 			return program;
 		}
 
@@ -5,6 +5,7 @@
 
 #include "OpenGLLibs.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -24,22 +25,39 @@ namespace Graphics {
 		*/
 		class Program {
 		public:
-			Program(Shader *shader, const ProgramDef &def);
+			// An async program is compiled and linked in the background if
+			// the driver can; it can't be used until FinishLoading is called
+			Program(Shader *shader, const ProgramDef &def, bool async = false);
 			~Program();
 
+			// Keep linked programs in a cache in the user dir, so they don't
+			// have to be compiled again on the next start; 0 disables it
+			static void InitBinaryCache(size_t maxBytes);
+			static void UninitBinaryCache();
+
 			void Reload(Shader *shader, const ProgramDef &def);
 			bool Loaded() const { return success; }
 
+			// Wait for an async program to be linked and check it for errors
+			void FinishLoading(Shader *shader);
+
 			GLuint GetConstantLocation(uint32_t index) const { return m_constants[index]; }
 			GLuint GetProgramID() const { return m_program; }
 
 		protected:
-			GLuint LoadShaders(const ProgramDef &def);
+			GLuint LoadShaders(const ProgramDef &def, bool async = false);
+			GLuint FinishLink(GLuint program, const std::string &name, uint64_t cacheKey);
 			void InitUniforms(Shader *shader);
 
 			GLuint m_program;
 			bool success;
 
+			// the state of an async program until it's finished
+			bool m_linking;
+			GLuint m_pendingShaders[2];
+			std::string m_name;
+			uint64_t m_cacheKey;
+
 			// map of push constant bindings to glUniform locations
 			std::vector<GLuint> m_constants;
 		};
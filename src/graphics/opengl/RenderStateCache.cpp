@@ -15,6 +15,8 @@ extern "C" {
 #include "jenkins/lookup3.h"
 }
 
+#include <algorithm>
+
 using namespace Graphics::OGL;
 using RenderStateDesc = Graphics::RenderStateDesc;
 
@@ -180,6 +182,10 @@ void RenderStateCache::ResetFrame()
 	for (uint32_t idx = 0; idx < m_textureCache.size(); idx++)
 		SetTexture(idx, nullptr);
 
+	// the same goes for buffers; the bindings themselves can stay as they
+	// are, they will be replaced before they are used again
+	std::fill(m_bufferCache.begin(), m_bufferCache.end(), BufferBinding<UniformBuffer>{ nullptr, 0, 0 });
+
 	if (m_activeRT)
 		m_activeRT->Unbind();
 
@@ -5,6 +5,9 @@
 #include "RenderStateCache.h"
 #include "RendererGL.h"
 #include "TextureGL.h"
+#include "graphics/GPUMemory.h"
+
+#include <algorithm>
 
 namespace Graphics {
 	namespace OGL {
@@ -38,7 +41,9 @@ namespace Graphics {
 			Graphics::RenderTarget(d),
 			m_renderer(r),
 			m_active(false),
-			m_depthRenderBuffer(0)
+			m_depthRenderBuffer(0),
+			m_depthRenderBufferSize(0),
+			m_memoryTag(MemoryTag::GetCurrent())
 		{
 			glGenFramebuffers(1, &m_fbo);
 		}
@@ -48,6 +53,7 @@ namespace Graphics {
 			glDeleteFramebuffers(1, &m_fbo);
 			if (m_depthRenderBuffer)
 				glDeleteRenderbuffers(1, &m_depthRenderBuffer);
+			GPUMemory::Free(GPUMemory::RENDER_TARGET, m_memoryTag, m_depthRenderBufferSize);
 		}
 
 		Texture *RenderTarget::GetColorTexture() const
@@ -122,6 +128,10 @@ namespace Graphics {
 			glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
 			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderBuffer);
+
+			// GL_DEPTH_COMPONENT32F, for each sample
+			m_depthRenderBufferSize = size_t(GetDesc().width) * GetDesc().height * 4 * std::max<size_t>(GetDesc().numSamples, 1);
+			GPUMemory::Allocate(GPUMemory::RENDER_TARGET, m_memoryTag, m_depthRenderBufferSize);
 		}
 
 	} // namespace OGL
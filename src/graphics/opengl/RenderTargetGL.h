@@ -9,6 +9,7 @@
  * 2013-May-05 left out stencil buffer because we don't need it now
  */
 #include "OpenGLLibs.h"
+#include "core/MemoryTag.h"
 #include "graphics/RenderTarget.h"
 
 namespace Graphics {
@@ -50,6 +51,8 @@ namespace Graphics {
 			bool m_active;
 			GLuint m_fbo;
 			GLuint m_depthRenderBuffer;
+			size_t m_depthRenderBufferSize;
+			const MemoryTag::Tag m_memoryTag;
 
 			RefCountedPtr<Texture> m_colorTexture;
 			RefCountedPtr<Texture> m_depthTexture;
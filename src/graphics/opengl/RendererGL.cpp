@@ -2,15 +2,19 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "RendererGL.h"
+#include "FileSystem.h"
 #include "MathUtil.h"
 #include "RefCounted.h"
 #include "SDL_video.h"
 #include "StringF.h"
 
+#include "graphics/GPUMemory.h"
 #include "graphics/Graphics.h"
 #include "graphics/Light.h"
+#include "graphics/LightClusters.h"
 #include "graphics/Material.h"
 #include "graphics/RenderState.h"
+#include "graphics/ShaderParser.h"
 #include "graphics/Texture.h"
 #include "graphics/TextureBuilder.h"
 #include "graphics/Types.h"
@@ -19,19 +23,23 @@
 
 #include "CommandBufferGL.h"
 #include "GLDebug.h"
+#include "GPUTimer.h"
 #include "MaterialGL.h"
 #include "Program.h"
 #include "RenderStateCache.h"
 #include "RenderTargetGL.h"
 #include "Shader.h"
+#include "StreamBuffer.h"
 #include "TextureGL.h"
 #include "UniformBuffer.h"
+#include "UploadThread.h"
 #include "VertexBufferGL.h"
 
 #include "core/Log.h"
 
 #include <SDL.h>
 
+#include <algorithm>
 #include <cstddef> //for offsetof
 #include <iterator>
 #include <ostream>
@@ -43,7 +51,7 @@ namespace Graphics {
 
 	const char *gl_framebuffer_error_to_string(GLuint st);
 
-	static bool CreateWindowAndContext(const char *name, const Graphics::Settings &vs, SDL_Window *&window, SDL_GLContext &context)
+	static bool CreateWindowAndContext(const char *name, const Graphics::Settings &vs, SDL_Window *&window, SDL_GLContext &context, SDL_GLContext &uploadContext)
 	{
 		PROFILE_SCOPED()
 		Uint32 winFlags = 0;
@@ -104,6 +112,19 @@ namespace Graphics {
 			return false;
 		}
 
+		// the upload thread's context shares objects with the main one,
+		// and creating it makes it current, so the main one is made current
+		// again after
+		uploadContext = nullptr;
+		if (vs.uploadThread) {
+			SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+			uploadContext = SDL_GL_CreateContext(window);
+			SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+			if (!uploadContext)
+				Log::Warning("Couldn't create a shared GL context for the upload thread: {}", SDL_GetError());
+			SDL_GL_MakeCurrent(window, context);
+		}
+
 		return true;
 	}
 
@@ -115,8 +136,9 @@ namespace Graphics {
 		const std::string name("Pioneer");
 		SDL_Window *window = nullptr;
 		SDL_GLContext glContext = nullptr;
+		SDL_GLContext uploadContext = nullptr;
 
-		bool ok = CreateWindowAndContext(name.c_str(), vs, window, glContext);
+		bool ok = CreateWindowAndContext(name.c_str(), vs, window, glContext, uploadContext);
 		if (!ok) {
 			Error("Failed to set video mode: %s", SDL_GetError());
 			return nullptr;
@@ -131,7 +153,7 @@ namespace Graphics {
 
 		SDL_GL_SetSwapInterval((vs.vsync != 0) ? -1 : 0);
 
-		return new RendererOGL(window, vs, glContext);
+		return new RendererOGL(window, vs, glContext, uploadContext);
 	}
 
 	struct LightData {
@@ -142,6 +164,16 @@ namespace Graphics {
 	};
 	static_assert(sizeof(LightData) == 48, "LightData glsl struct has incorrect size/alignment in C++");
 
+	struct PointLightData {
+		vector3f position;
+		float radius;
+		Color4f color;
+	};
+	static_assert(sizeof(PointLightData) == 32, "PointLight glsl struct has incorrect size/alignment in C++");
+
+	// the clusterParams ahead of the lights
+	static const size_t POINT_LIGHT_HEADER_SIZE = sizeof(Color4f);
+
 	// static method instantiations
 	void RendererOGL::RegisterRenderer()
 	{
@@ -152,11 +184,16 @@ namespace Graphics {
 	bool RendererOGL::initted = false;
 	RendererOGL::DynamicBufferMap RendererOGL::s_DynamicDrawBufferMap;
 
+	// per-frame space for immediate geometry and UI draw lists
+	static constexpr uint32_t STREAM_BUFFER_FRAME_SIZE = 8 << 20;
+	// initial size of the per-frame arenas for draw data
+	static constexpr uint32_t DRAW_UNIFORM_BUFFER_SIZE = 1 << 20;
+
 	// typedefs
 	typedef std::vector<std::pair<MaterialDescriptor, OGL::Program *>>::const_iterator ProgramIterator;
 
 	// ----------------------------------------------------------------------------
-	RendererOGL::RendererOGL(SDL_Window *window, const Graphics::Settings &vs, SDL_GLContext &glContext) :
+	RendererOGL::RendererOGL(SDL_Window *window, const Graphics::Settings &vs, SDL_GLContext &glContext, SDL_GLContext uploadContext) :
 		Renderer(window, vs.width, vs.height),
 		m_frameNum(0),
 		m_numLights(0),
@@ -169,7 +206,8 @@ namespace Graphics {
 		m_maxZFar(100000000.0f),
 		m_useCompressedTextures(false),
 		m_activeRenderTarget(0),
-		m_glContext(glContext)
+		m_glContext(glContext),
+		m_uploadContext(uploadContext)
 	{
 		PROFILE_SCOPED()
 		glewExperimental = true;
@@ -242,6 +280,9 @@ namespace Graphics {
 
 		TextureBuilder::Init();
 
+		OGL::Program::InitBinaryCache(size_t(std::max(0, vs.shaderCacheMB)) * 1024 * 1024);
+		GPUMemory::SetBudget(size_t(std::max(0, vs.vramBudgetMB)) * 1024 * 1024);
+
 		const bool useDXTnTextures = vs.useTextureCompression;
 		m_useCompressedTextures = useDXTnTextures;
 
@@ -281,24 +322,63 @@ namespace Graphics {
 
 		m_drawCommandList.reset(new OGL::CommandList(this));
 
+		// immediate geometry and UI draw lists are streamed through one ring buffer
+		const bool persistentStreaming = glewIsSupported("GL_ARB_buffer_storage");
+		m_streamBuffer.reset(new OGL::StreamBuffer(STREAM_BUFFER_FRAME_SIZE, persistentStreaming));
+		if (!m_streamBuffer->IsPersistent())
+			Log::Info("GL_ARB_buffer_storage not supported, dynamic geometry will be copied to the GPU each frame");
+
+		if (glewIsSupported("GL_ARB_timer_query"))
+			m_gpuTimer.reset(new OGL::GPUTimer());
+
 		m_viewport = ViewportExtents(0, 0, m_width, m_height);
 		SetRenderTarget(nullptr);
 
+		GLint uniformBufferAlignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferAlignment);
+		m_uniformBufferAlignment = uint32_t(uniformBufferAlignment);
+
 		m_drawUniformBuffers.reserve(8);
 		GetDrawUniformBuffer(0);
 
 		m_lightUniformBuffer.Reset(new OGL::UniformBuffer(sizeof(LightData) * TOTAL_NUM_LIGHTS, BUFFER_USAGE_DYNAMIC));
+
+		m_lightClusters.reset(new LightClusters());
+		m_pointLightBuffer.Reset(new OGL::UniformBuffer(POINT_LIGHT_HEADER_SIZE + sizeof(PointLightData) * LightClusters::MAX_LIGHTS, BUFFER_USAGE_DYNAMIC));
+		m_lightClusterBuffer.Reset(new OGL::UniformBuffer(sizeof(Uint32) * LightClusters::NUM_CLUSTERS, BUFFER_USAGE_DYNAMIC));
+		m_lightIndexBuffer.Reset(new OGL::UniformBuffer(sizeof(Uint32) * LightClusters::MAX_INDICES, BUFFER_USAGE_DYNAMIC));
+		SetPointLights(0, nullptr);
+
+		if (m_uploadContext) {
+			m_uploadThread.reset(new OGL::UploadThread(window, m_uploadContext));
+			if (!m_uploadThread->IsRunning())
+				m_uploadThread.reset();
+			else
+				Log::Info("Uploading buffers and textures on a thread of their own");
+		}
 	}
 
 	RendererOGL::~RendererOGL()
 	{
+		// the uploads in flight hold resources, so they go first
+		m_uploadThread.reset();
+		if (m_uploadContext)
+			SDL_GL_DeleteContext(m_uploadContext);
+
 		for (auto &buffer : m_drawUniformBuffers) {
 			buffer.reset();
 		}
 
 		m_lightUniformBuffer.Reset();
+		m_pointLightBuffer.Reset();
+		m_lightClusterBuffer.Reset();
+		m_lightIndexBuffer.Reset();
 
 		s_DynamicDrawBufferMap.clear();
+		m_streamBuffer.reset();
+		m_gpuTimer.reset();
+
+		SaveShaderVariants();
 
 		// HACK ANDYC - this crashes when shutting down? They'll be released anyway right?
 		while (!m_shaders.empty()) {
@@ -306,6 +386,8 @@ namespace Graphics {
 			m_shaders.pop_back();
 		}
 
+		OGL::Program::UninitBinaryCache();
+
 		SDL_GL_DeleteContext(m_glContext);
 	}
 
@@ -496,12 +578,72 @@ namespace Graphics {
 		m_renderStateCache->SetProgram(nullptr);
 
 		m_frameNum++;
+		BeginGPUTimer("Frame");
+
+		if (m_uploadThread)
+			m_uploadThread->Update(m_stats);
 		return true;
 	}
 
+	bool RendererOGL::HasUploadThread() const
+	{
+		return m_uploadThread != nullptr;
+	}
+
+	RefCountedPtr<UploadTicket> RendererOGL::UploadVertexBuffer(Graphics::VertexBuffer *buffer, std::vector<Uint8> &&data)
+	{
+		if (!m_uploadThread || buffer->GetDesc().usage != BUFFER_USAGE_STATIC)
+			return Renderer::UploadVertexBuffer(buffer, std::move(data));
+
+		PROFILE_SCOPED()
+		assert(data.size() == buffer->GetDesc().numVertices * buffer->GetDesc().stride);
+		RefCountedPtr<UploadTicket> ticket(new UploadTicket());
+		RefCountedPtr<OGL::VertexBuffer> vb(static_cast<OGL::VertexBuffer *>(buffer));
+		const GLuint name = vb->GetBuffer();
+		auto staged = std::make_shared<std::vector<Uint8>>(std::move(data));
+
+		m_uploadThread->Queue(
+			[name, staged]() {
+				// storage of the same size, replaced rather than written into
+				// as draws queued on the main thread may still read the old
+				glBindBuffer(GL_ARRAY_BUFFER, name);
+				glBufferData(GL_ARRAY_BUFFER, staged->size(), staged->data(), GL_STATIC_DRAW);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+			},
+			[vb, ticket]() {
+				vb->MarkWritten();
+				ticket->SetDone();
+			});
+		return ticket;
+	}
+
+	RefCountedPtr<UploadTicket> RendererOGL::UploadTexture(Texture *texture, std::function<void(Texture *)> upload)
+	{
+		if (!m_uploadThread)
+			return Renderer::UploadTexture(texture, std::move(upload));
+
+		PROFILE_SCOPED()
+		RefCountedPtr<UploadTicket> ticket(new UploadTicket());
+		RefCountedPtr<Texture> tex(texture);
+
+		m_uploadThread->Queue(
+			[texture, upload]() { upload(texture); },
+			[tex, ticket]() { ticket->SetDone(); });
+		return ticket;
+	}
+
 	bool RendererOGL::EndFrame()
 	{
 		PROFILE_SCOPED()
+		if (m_gpuTimer) {
+			// everything drawn this frame has to be executed before the
+			// frame's timer scope is closed
+			FlushCommandBuffers();
+			if (GLuint query = m_gpuTimer->EndScope())
+				glQueryCounter(query, GL_TIMESTAMP);
+			m_gpuTimer->EndFrame(m_stats);
+		}
+
 		uint32_t used_tex2d = 0;
 		uint32_t used_texCube = 0;
 		uint32_t used_texArray2d = 0;
@@ -540,17 +682,27 @@ namespace Graphics {
 		stat.SetStatCount(Stats::STAT_MEM_TEXTURECUBE, used_texCube);
 
 		uint32_t numAllocs = 0;
+		uint32_t numBuffersUsed = 0;
+		uint32_t drawDataSize = 0;
 		for (auto &buffer : m_drawUniformBuffers) {
 			numAllocs += buffer->NumAllocs();
+			numBuffersUsed += buffer->NumAllocs() > 0;
+			drawDataSize += buffer->GetSize();
 			buffer->Reset();
 		}
 
-		for (auto &buffer : s_DynamicDrawBufferMap) {
-			buffer.vtxBuffer->Reset();
-		}
+		// If the draw data overflowed into more buffers this frame, grow the
+		// first one to hold all of it so later frames need only one upload
+		// per flush and don't switch buffer bindings between draws. The other
+		// buffers are kept around, as materials may still reference them.
+		if (numBuffersUsed > 1)
+			m_drawUniformBuffers.front()->Grow(ceil_pow2(drawDataSize));
+
+		stat.SetStatCount(Stats::STAT_DYNAMIC_DRAW_BUFFER_BYTES, m_streamBuffer->GetUsedSize());
+		m_streamBuffer->EndFrame();
 
 		stat.SetStatCount(Stats::STAT_DYNAMIC_DRAW_BUFFER_INUSE, s_DynamicDrawBufferMap.size());
-		stat.SetStatCount(Stats::STAT_DRAW_UNIFORM_BUFFER_INUSE, uint32_t(m_drawUniformBuffers.size()));
+		stat.SetStatCount(Stats::STAT_DRAW_UNIFORM_BUFFER_INUSE, numBuffersUsed);
 		stat.SetStatCount(Stats::STAT_DRAW_UNIFORM_BUFFER_ALLOCS, numAllocs);
 
 		uint32_t numShaderPrograms = 0;
@@ -637,6 +789,7 @@ namespace Graphics {
 		m_activeRenderTarget = nullptr;
 		m_renderStateCache->ResetFrame();
 		m_stats.NextFrame();
+		GPUMemory::CheckBudget();
 		return true;
 	}
 
@@ -717,12 +870,23 @@ namespace Graphics {
 		return true;
 	}
 
+	// the recording bound to this thread, if any
+	static thread_local OGL::CommandList *s_boundRecording = nullptr;
+
 	bool RendererOGL::SetTransform(const matrix4x4f &m)
 	{
-		m_modelViewMat = m;
+		if (s_boundRecording)
+			s_boundRecording->SetTransform(m);
+		else
+			m_modelViewMat = m;
 		return true;
 	}
 
+	matrix4x4f RendererOGL::GetTransform() const
+	{
+		return s_boundRecording ? s_boundRecording->GetTransform() : m_modelViewMat;
+	}
+
 	bool RendererOGL::SetPerspectiveProjection(float fov, float aspect, float near_, float far_)
 	{
 		PROFILE_SCOPED()
@@ -795,36 +959,70 @@ namespace Graphics {
 		return true;
 	}
 
+	void RendererOGL::SetPointLights(Uint32 numLights, const PointLight *lights)
+	{
+		PROFILE_SCOPED()
+
+		m_lightClusters->Build(lights, numLights, m_projectionMat[0], m_projectionMat[5]);
+
+		// the lights and indices in use; every cluster is written, so the
+		// ones without lights are empty
+		const Uint32 numUsed = m_lightClusters->GetNumLights();
+		std::vector<char> pointLightData(POINT_LIGHT_HEADER_SIZE + sizeof(PointLightData) * std::max(numUsed, 1U));
+		Color4f &params = *reinterpret_cast<Color4f *>(pointLightData.data());
+		params = Color4f(LightClusters::GetSliceScale(), LightClusters::GetSliceBias(), float(LightClusters::TILES_X), float(LightClusters::TILES_Y));
+
+		PointLightData *gpuLights = reinterpret_cast<PointLightData *>(pointLightData.data() + POINT_LIGHT_HEADER_SIZE);
+		for (Uint32 i = 0; i < numUsed; i++) {
+			gpuLights[i].position = lights[i].position;
+			gpuLights[i].radius = lights[i].radius;
+			gpuLights[i].color = lights[i].color.ToColor4f() * lights[i].intensity;
+		}
+
+		m_pointLightBuffer->BufferData(POINT_LIGHT_HEADER_SIZE + sizeof(PointLightData) * numUsed, pointLightData.data());
+		m_lightClusterBuffer->BufferData(sizeof(Uint32) * LightClusters::NUM_CLUSTERS, const_cast<Uint32 *>(m_lightClusters->GetClusters().data()));
+		if (!m_lightClusters->GetIndices().empty())
+			m_lightIndexBuffer->BufferData(sizeof(Uint32) * m_lightClusters->GetIndices().size(), const_cast<Uint32 *>(m_lightClusters->GetIndices().data()));
+
+		m_stats.AddToStatCount(Stats::STAT_POINT_LIGHTS, numUsed);
+		m_stats.AddToStatCount(Stats::STAT_POINT_LIGHT_INDICES, m_lightClusters->GetIndices().size());
+		m_stats.AddToStatCount(Stats::STAT_POINT_LIGHTS_DROPPED, m_lightClusters->GetNumDropped());
+	}
+
+	Uint32 RendererOGL::GetNumPointLights() const
+	{
+		return m_lightClusters->GetNumLights();
+	}
+
 	bool RendererOGL::SetAmbientColor(const Color &c)
 	{
 		m_ambient = c;
 		return true;
 	}
 
-	// 1MB vertex draw buffer should be enough for most cases, right?
-	static constexpr uint32_t DYNAMIC_DRAW_BUFFER_SIZE = 1 << 20;
 	bool RendererOGL::DrawBuffer(const VertexArray *v, Material *m)
 	{
 		PROFILE_SCOPED()
+		// this writes to the dynamic draw buffers
+		assert(!s_boundRecording && "DrawBuffer can't be recorded on a worker thread!");
 
 		if (v->IsEmpty()) return false;
 
 		const AttributeSet attrs = v->GetAttributeSet();
 
-		// Find a buffer matching our attributes with enough free space
+		// Find the vertex format matching our attributes
 		auto iter = std::find_if(s_DynamicDrawBufferMap.begin(), s_DynamicDrawBufferMap.end(), [&](DynamicBufferData &a) {
-			uint32_t freeSize = a.vtxBuffer->GetCapacity() - a.vtxBuffer->GetSize();
-			return a.attrs == attrs && freeSize >= v->GetNumVerts();
+			return a.attrs == attrs;
 		});
 
 		// If we don't have one, make one
 		if (iter == s_DynamicDrawBufferMap.end()) {
 			auto desc = VertexBufferDesc::FromAttribSet(v->GetAttributeSet());
-			desc.numVertices = DYNAMIC_DRAW_BUFFER_SIZE / desc.stride;
+			desc.numVertices = 0;
 			desc.usage = BUFFER_USAGE_DYNAMIC;
 
 			size_t stateHash = m_renderStateCache->CacheVertexDesc(desc);
-			OGL::CachedVertexBuffer *vb = new OGL::CachedVertexBuffer(desc, stateHash);
+			OGL::CachedVertexBuffer *vb = new OGL::CachedVertexBuffer(desc, stateHash, m_streamBuffer.get());
 			MeshObject *meshObject = CreateMeshObject(vb, nullptr);
 			s_DynamicDrawBufferMap.push_back(DynamicBufferData{ attrs, vb, RefCountedPtr<MeshObject>(meshObject) });
 
@@ -833,13 +1031,17 @@ namespace Graphics {
 			iter = s_DynamicDrawBufferMap.end() - 1;
 		}
 
-		// Write our data into the buffer
-		uint32_t offset = iter->vtxBuffer->GetOffset();
-		iter->vtxBuffer->Populate(*v);
-		CheckRenderErrors(__FUNCTION__, __LINE__);
+		// Write our data into the stream buffer
+		if (!iter->vtxBuffer->Populate(*v)) {
+			static bool s_warned = false;
+			if (!s_warned)
+				Log::Warning("Out of stream buffer space for immediate geometry, dropping draws");
+			s_warned = true;
+			return false;
+		}
 
 		// Append a command to the command list
-		m_drawCommandList->AddDynamicDrawCmd({ iter->mesh->GetVertexBuffer(), offset, v->GetNumVerts() }, {}, m);
+		m_drawCommandList->AddDynamicDrawCmd({ iter->mesh->GetVertexBuffer(), iter->vtxBuffer->GetOffset(), v->GetNumVerts() }, {}, m);
 
 		return true;
 	}
@@ -850,7 +1052,8 @@ namespace Graphics {
 			return false;
 
 		uint32_t indexSize = i && i->GetElementSize() == INDEX_BUFFER_16BIT ? sizeof(uint16_t) : sizeof(uint32_t);
-		m_drawCommandList->AddDynamicDrawCmd(
+		OGL::CommandList *cmdList = s_boundRecording ? s_boundRecording : m_drawCommandList.get();
+		cmdList->AddDynamicDrawCmd(
 			{ v, vtxOffset * v->GetDesc().stride, numElems },
 			{ i, i == nullptr ? 0 : idxOffset * indexSize, numElems },
 			mat);
@@ -860,27 +1063,93 @@ namespace Graphics {
 
 	bool RendererOGL::DrawMesh(MeshObject *mesh, Material *material)
 	{
-		m_drawCommandList->AddDrawCmd(mesh, material, nullptr);
+		OGL::CommandList *cmdList = s_boundRecording ? s_boundRecording : m_drawCommandList.get();
+		cmdList->AddDrawCmd(mesh, material, nullptr);
 		return true;
 	}
 
 	bool RendererOGL::DrawMeshInstanced(MeshObject *mesh, Material *material, InstanceBuffer *inst)
 	{
-		m_drawCommandList->AddDrawCmd(mesh, material, inst);
+		OGL::CommandList *cmdList = s_boundRecording ? s_boundRecording : m_drawCommandList.get();
+		cmdList->AddDrawCmd(mesh, material, inst);
 		return true;
 	}
 
+	bool RendererOGL::DrawMeshBatched(MeshObject *mesh, Material *material, Material *instancedMaterial)
+	{
+		OGL::CommandList *cmdList = s_boundRecording ? s_boundRecording : m_drawCommandList.get();
+		cmdList->AddDrawCmd(mesh, material, nullptr, instancedMaterial);
+		return true;
+	}
+
+	std::unique_ptr<CommandRecording> RendererOGL::CreateRecording()
+	{
+		assert(!s_boundRecording && "Recordings are created on the render thread!");
+		std::unique_ptr<OGL::CommandList> recording;
+		if (!m_freeRecordings.empty()) {
+			recording = std::move(m_freeRecordings.back());
+			m_freeRecordings.pop_back();
+		} else {
+			recording.reset(new OGL::CommandList(this));
+		}
+
+		OGL::ViewState view;
+		view.transform = m_modelViewMat;
+		view.projection = m_projectionMat;
+		view.ambient = GetAmbientColor();
+		view.numLights = m_numLights;
+		for (Uint32 i = 0; i < m_numLights; i++)
+			view.lightIntensity[i] = GetLight(i).GetIntensity();
+		recording->BeginRecording(view);
+
+		return recording;
+	}
+
+	void RendererOGL::BindRecording(CommandRecording *rec)
+	{
+		s_boundRecording = static_cast<OGL::CommandList *>(rec);
+	}
+
+	void RendererOGL::SubmitRecording(std::unique_ptr<CommandRecording> rec)
+	{
+		assert(!s_boundRecording && "Recordings are submitted on the render thread!");
+		m_drawCommandList->Append(std::unique_ptr<OGL::CommandList>(static_cast<OGL::CommandList *>(rec.release())));
+	}
+
+	void RendererOGL::BeginGPUTimer(const char *name)
+	{
+		assert(!s_boundRecording && "GPU timers can't be used in a recording!");
+		if (!m_gpuTimer)
+			return;
+
+		if (GLuint query = m_gpuTimer->BeginScope(name))
+			m_drawCommandList->AddGPUTimerCmd(query);
+	}
+
+	void RendererOGL::EndGPUTimer()
+	{
+		assert(!s_boundRecording && "GPU timers can't be used in a recording!");
+		if (!m_gpuTimer)
+			return;
+
+		if (GLuint query = m_gpuTimer->EndScope())
+			m_drawCommandList->AddGPUTimerCmd(query);
+	}
+
 	bool RendererOGL::FlushCommandBuffers()
 	{
 		PROFILE_SCOPED()
 		if (!m_drawCommandList || m_drawCommandList->IsEmpty())
 			return false;
 
+		// merging draws writes new uniform and instance data
+		m_drawCommandList->SortDrawCmds(m_stats);
+		m_drawCommandList->BatchDrawCmds(m_stats);
+
 		for (auto &buffer : m_drawUniformBuffers)
 			buffer->Flush();
 
-		for (auto &buffer : s_DynamicDrawBufferMap)
-			buffer.vtxBuffer->Flush();
+		m_streamBuffer->Flush();
 
 		m_drawCommandList->m_executing = true;
 
@@ -893,6 +1162,8 @@ namespace Graphics {
 				m_drawCommandList->ExecuteRenderPassCmd(*renderPassCmd);
 			else if (auto *blitRenderTargetCmd = std::get_if<OGL::CommandList::BlitRenderTargetCmd>(&cmd))
 				m_drawCommandList->ExecuteBlitRenderTargetCmd(*blitRenderTargetCmd);
+			else if (auto *timerCmd = std::get_if<OGL::CommandList::GPUTimerCmd>(&cmd))
+				m_drawCommandList->ExecuteGPUTimerCmd(*timerCmd);
 		}
 
 		// we don't manually reset the active vertex array after each drawcall for performance,
@@ -900,6 +1171,8 @@ namespace Graphics {
 		glBindVertexArray(0);
 
 		m_drawCommandList->m_executing = false;
+		for (auto &recording : m_drawCommandList->m_appended)
+			m_freeRecordings.emplace_back(std::move(recording));
 		m_drawCommandList->Reset();
 
 		m_stats.AddToStatCount(Stats::STAT_NUM_CMDLIST_FLUSHES, 1);
@@ -981,10 +1254,10 @@ namespace Graphics {
 		PROFILE_SCOPED()
 
 		glBindVertexArray(m_renderStateCache->GetVertexArrayObject(vtxBind.buffer->GetVertexFormatHash()));
-		glBindVertexBuffer(0, vtxBind.buffer->GetBuffer(), vtxBind.offset, vtxBind.buffer->GetDesc().stride);
+		glBindVertexBuffer(0, vtxBind.buffer->GetBindingBuffer(), vtxBind.offset + vtxBind.buffer->GetBindingOffset(), vtxBind.buffer->GetDesc().stride);
 		if (idxBind.buffer) {
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idxBind.buffer->GetBuffer());
-			glDrawElements(type, idxBind.size, get_element_size(idxBind.buffer), (void *)(uintptr_t)(idxBind.offset));
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idxBind.buffer->GetBindingBuffer());
+			glDrawElements(type, idxBind.size, get_element_size(idxBind.buffer), (void *)(uintptr_t)(idxBind.offset + idxBind.buffer->GetBindingOffset()));
 		} else {
 			glDrawArrays(type, 0, vtxBind.size);
 		}
@@ -1010,23 +1283,24 @@ namespace Graphics {
 		mat->m_descriptor = desc;
 		mat->m_renderStateHash = m_renderStateCache->InternRenderState(stateDescriptor);
 
-		OGL::Shader *s = nullptr;
-		for (auto &pair : m_shaders) {
-			if (pair.first == shader)
-				s = pair.second;
-		}
-
-		if (!s) {
-			s = new OGL::Shader(shader);
-			Log::Info("Created shader {} (address={})\n", shader, (void *)s);
-			CheckRenderErrors(__FUNCTION__, __LINE__);
+		mat->SetShader(GetOrCreateShader(shader));
+		CheckRenderErrors(__FUNCTION__, __LINE__);
+		return mat;
+	}
 
-			m_shaders.push_back({ shader, s });
+	OGL::Shader *RendererOGL::GetOrCreateShader(const std::string &name)
+	{
+		for (auto &pair : m_shaders) {
+			if (pair.first == name)
+				return pair.second;
 		}
 
-		mat->SetShader(s);
+		OGL::Shader *s = new OGL::Shader(name);
+		Log::Info("Created shader {} (address={})\n", name, (void *)s);
 		CheckRenderErrors(__FUNCTION__, __LINE__);
-		return mat;
+
+		m_shaders.push_back({ name, s });
+		return s;
 	}
 
 	Material *RendererOGL::CloneMaterial(const Material *old, const MaterialDescriptor &descriptor, const RenderStateDesc &stateDescriptor)
@@ -1049,6 +1323,8 @@ namespace Graphics {
 		m_renderStateCache->SetProgram(nullptr);
 		Log::Info("Reloading {} shaders...\n", m_shaders.size());
 		Log::Info("Note: runtime shader reloading does not reload uniform assignments. Restart the program when making major changes.\n");
+		// only the sources whose files changed are expanded again
+		ShaderParser::SourceCache::Get().Revalidate();
 		for (auto &pair : m_shaders) {
 			pair.second->Reload();
 		}
@@ -1057,6 +1333,91 @@ namespace Graphics {
 		return true;
 	}
 
+	// The shader variants used this session, read back by PrewarmShaders on
+	// the next start. One line per variant: the shader name, then the fields
+	// of its MaterialDescriptor.
+	static const char SHADER_VARIANTS_FILE[] = "shader_variants.txt";
+	static const int SHADER_VARIANTS_VERSION = 1;
+
+	void RendererOGL::SaveShaderVariants()
+	{
+		std::ostringstream out;
+		out << SHADER_VARIANTS_VERSION << "\n";
+
+		size_t numVariants = 0;
+		for (auto &pair : m_shaders) {
+			for (auto &variant : pair.second->GetVariants()) {
+				const MaterialDescriptor &d = variant.first;
+				out << pair.first << " " << int(d.effect) << " " << d.alphaTest << " " << d.glowMap << " "
+					<< d.ambientMap << " " << d.lighting << " " << d.normalMap << " " << d.specularMap << " "
+					<< d.usePatterns << " " << d.vertexColors << " " << d.instanced << " " << d.textures << " "
+					<< d.dirLights << " " << d.quality << "\n";
+				numVariants++;
+			}
+		}
+
+		// keep the list from the last session if nothing was drawn in this one
+		if (!numVariants)
+			return;
+
+		FILE *f = FileSystem::userFiles.OpenWriteStream(SHADER_VARIANTS_FILE, FileSystem::FileSourceFS::WRITE_TEXT);
+		if (!f) {
+			Log::Warning("Couldn't write {}\n", SHADER_VARIANTS_FILE);
+			return;
+		}
+
+		const std::string text = out.str();
+		fwrite(text.data(), 1, text.size(), f);
+		fclose(f);
+	}
+
+	void RendererOGL::PrewarmShaders()
+	{
+		PROFILE_SCOPED()
+		RefCountedPtr<FileSystem::FileData> data = FileSystem::userFiles.ReadFile(SHADER_VARIANTS_FILE);
+		if (!data)
+			return;
+
+		std::istringstream in(data->AsStringRange().ToString());
+		int version = 0;
+		if (!(in >> version) || version != SHADER_VARIANTS_VERSION)
+			return;
+
+		// let the driver build the programs on its own threads
+		if (glewIsSupported("GL_ARB_parallel_shader_compile"))
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+
+		std::vector<OGL::Shader *> prewarmed;
+		std::string name;
+		int effect;
+		MaterialDescriptor d;
+		while (in >> name >> effect >> d.alphaTest >> d.glowMap >> d.ambientMap >> d.lighting >> d.normalMap >>
+			d.specularMap >> d.usePatterns >> d.vertexColors >> d.instanced >> d.textures >> d.dirLights >> d.quality) {
+			d.effect = EffectType(effect);
+
+			// the shader might have been removed since the list was written
+			OGL::Shader *s = nullptr;
+			try {
+				s = GetOrCreateShader(name);
+			} catch (const OGL::ShaderException &) {
+				continue;
+			}
+
+			s->PrewarmProgram(d);
+			if (std::find(prewarmed.begin(), prewarmed.end(), s) == prewarmed.end())
+				prewarmed.push_back(s);
+		}
+
+		uint32_t numVariants = 0;
+		for (OGL::Shader *s : prewarmed) {
+			s->FinishPrewarm();
+			numVariants += s->GetNumVariants();
+		}
+
+		Log::Info("Prewarmed {} shader variants\n", numVariants);
+		CheckRenderErrors(__FUNCTION__, __LINE__);
+	}
+
 	Texture *RendererOGL::CreateTexture(const TextureDescriptor &descriptor)
 	{
 		PROFILE_SCOPED()
@@ -1080,7 +1441,7 @@ namespace Graphics {
 				false,
 				false,
 				0, Graphics::TEXTURE_2D);
-			OGL::TextureGL *colorTex = new OGL::TextureGL(cdesc, false, false, desc.numSamples);
+			OGL::TextureGL *colorTex = new OGL::TextureGL(cdesc, false, false, desc.numSamples, GPUMemory::RENDER_TARGET);
 			rt->SetColorTexture(colorTex);
 			CHECKERRORS();
 		}
@@ -1095,7 +1456,7 @@ namespace Graphics {
 					false,
 					false,
 					0, Graphics::TEXTURE_2D);
-				OGL::TextureGL *depthTex = new OGL::TextureGL(ddesc, false, false, desc.numSamples);
+				OGL::TextureGL *depthTex = new OGL::TextureGL(ddesc, false, false, desc.numSamples, GPUMemory::RENDER_TARGET);
 				rt->SetDepthTexture(depthTex);
 				CHECKERRORS();
 			} else {
@@ -1119,17 +1480,17 @@ namespace Graphics {
 		return rt;
 	}
 
-	VertexBuffer *RendererOGL::CreateVertexBuffer(const VertexBufferDesc &desc)
+	VertexBuffer *RendererOGL::CreateVertexBuffer(const VertexBufferDesc &desc, const void *data)
 	{
 		m_stats.AddToStatCount(Stats::STAT_CREATE_BUFFER, 1);
 		size_t stateHash = m_renderStateCache->CacheVertexDesc(desc);
-		return new OGL::VertexBuffer(desc, stateHash);
+		return new OGL::VertexBuffer(desc, stateHash, m_streamBuffer.get(), data);
 	}
 
-	IndexBuffer *RendererOGL::CreateIndexBuffer(Uint32 size, BufferUsage usage, IndexBufferSize el)
+	IndexBuffer *RendererOGL::CreateIndexBuffer(Uint32 size, BufferUsage usage, IndexBufferSize el, const void *data)
 	{
 		m_stats.AddToStatCount(Stats::STAT_CREATE_BUFFER, 1);
-		return new OGL::IndexBuffer(size, usage, el);
+		return new OGL::IndexBuffer(size, usage, el, m_streamBuffer.get(), data);
 	}
 
 	InstanceBuffer *RendererOGL::CreateInstanceBuffer(Uint32 size, BufferUsage usage)
@@ -1173,7 +1534,7 @@ namespace Graphics {
 			if (buffer->FreeSize() >= size)
 				return buffer.get();
 
-		auto *buffer = new OGL::UniformLinearBuffer(1 << 20);
+		auto *buffer = new OGL::UniformLinearBuffer(std::max(DRAW_UNIFORM_BUFFER_SIZE, size), m_uniformBufferAlignment);
 		m_drawUniformBuffers.emplace_back(buffer);
 		return buffer;
 	}
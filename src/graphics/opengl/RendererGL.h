@@ -17,12 +17,14 @@ typedef void *SDL_GLContext;
 
 namespace Graphics {
 
+	class LightClusters;
 	class Texture;
 	struct Settings;
 
 	namespace OGL {
 		class CachedVertexBuffer;
 		class CommandList;
+		class GPUTimer;
 		class InstanceBuffer;
 		class IndexBuffer;
 		class Material;
@@ -31,8 +33,10 @@ namespace Graphics {
 		class RenderStateCache;
 		class RenderTarget;
 		class Shader;
+		class StreamBuffer;
 		class UniformBuffer;
 		class UniformLinearBuffer;
+		class UploadThread;
 		class VertexBuffer;
 	} // namespace OGL
 
@@ -40,7 +44,8 @@ namespace Graphics {
 	public:
 		static void RegisterRenderer();
 
-		RendererOGL(SDL_Window *window, const Graphics::Settings &vs, SDL_GLContext &glContext);
+		// uploadContext, if not null, is shared with glContext for the upload thread
+		RendererOGL(SDL_Window *window, const Graphics::Settings &vs, SDL_GLContext &glContext, SDL_GLContext uploadContext);
 		virtual ~RendererOGL() override final;
 
 		virtual const char *GetName() const override final { return "OpenGL 3.1, with extensions, renderer"; }
@@ -78,7 +83,7 @@ namespace Graphics {
 		virtual ViewportExtents GetViewport() const override final { return m_viewport; }
 
 		virtual bool SetTransform(const matrix4x4f &m) override final;
-		virtual matrix4x4f GetTransform() const override final { return m_modelViewMat; }
+		virtual matrix4x4f GetTransform() const override final;
 
 		virtual bool SetPerspectiveProjection(float fov, float aspect, float near_, float far_) override final;
 		virtual bool SetOrthographicProjection(float xmin, float xmax, float ymin, float ymax, float zmin, float zmax) override final;
@@ -90,6 +95,8 @@ namespace Graphics {
 		virtual bool SetLightIntensity(Uint32 numlights, const float *intensity) override final;
 		virtual bool SetLights(Uint32 numlights, const Light *l) override final;
 		virtual Uint32 GetNumLights() const override final { return m_numLights; }
+		virtual void SetPointLights(Uint32 numLights, const PointLight *lights) override final;
+		virtual Uint32 GetNumPointLights() const override final;
 		virtual bool SetAmbientColor(const Color &c) override final;
 
 		virtual bool FlushCommandBuffers() override final;
@@ -98,25 +105,43 @@ namespace Graphics {
 		virtual bool DrawBufferDynamic(VertexBuffer *v, uint32_t vtxOffset, IndexBuffer *i, uint32_t idxOffset, uint32_t numElems, Material *m) override final;
 		virtual bool DrawMesh(MeshObject *, Material *) override final;
 		virtual bool DrawMeshInstanced(MeshObject *, Material *, InstanceBuffer *) override final;
+		virtual bool DrawMeshBatched(MeshObject *, Material *, Material *) override final;
+
+		virtual std::unique_ptr<CommandRecording> CreateRecording() override final;
+		virtual void BindRecording(CommandRecording *rec) override final;
+		virtual void SubmitRecording(std::unique_ptr<CommandRecording> rec) override final;
+
+		virtual void BeginGPUTimer(const char *name) override final;
+		virtual void EndGPUTimer() override final;
 
 		virtual Material *CreateMaterial(const std::string &, const MaterialDescriptor &, const RenderStateDesc &) override final;
 		virtual Material *CloneMaterial(const Material *, const MaterialDescriptor &, const RenderStateDesc &) override final;
 		virtual Texture *CreateTexture(const TextureDescriptor &descriptor) override final;
 		virtual RenderTarget *CreateRenderTarget(const RenderTargetDesc &) override final;
-		virtual VertexBuffer *CreateVertexBuffer(const VertexBufferDesc &) override final;
-		virtual IndexBuffer *CreateIndexBuffer(Uint32 size, BufferUsage, IndexBufferSize) override final;
+		virtual VertexBuffer *CreateVertexBuffer(const VertexBufferDesc &, const void *data = nullptr) override final;
+		virtual IndexBuffer *CreateIndexBuffer(Uint32 size, BufferUsage, IndexBufferSize = INDEX_BUFFER_32BIT, const void *data = nullptr) override final;
 		virtual InstanceBuffer *CreateInstanceBuffer(Uint32 size, BufferUsage) override final;
 		virtual UniformBuffer *CreateUniformBuffer(Uint32 size, BufferUsage) override final;
 		virtual MeshObject *CreateMeshObject(VertexBuffer *v, IndexBuffer *i) override final;
 		virtual MeshObject *CreateMeshObjectFromArray(const VertexArray *v, IndexBuffer *i = nullptr, BufferUsage u = BUFFER_USAGE_STATIC) override final;
 
+		virtual bool HasUploadThread() const override final;
+		virtual RefCountedPtr<UploadTicket> UploadVertexBuffer(Graphics::VertexBuffer *buffer, std::vector<Uint8> &&data) override final;
+		virtual RefCountedPtr<UploadTicket> UploadTexture(Texture *texture, std::function<void(Texture *)> upload) override final;
+
 		virtual const RenderStateDesc &GetMaterialRenderState(const Graphics::Material *m) override final;
 
 		OGL::UniformBuffer *GetLightUniformBuffer();
+		// the blocks of the clustered point lights, see LightClusters
+		OGL::UniformBuffer *GetPointLightBuffer() { return m_pointLightBuffer.Get(); }
+		OGL::UniformBuffer *GetLightClusterBuffer() { return m_lightClusterBuffer.Get(); }
+		OGL::UniformBuffer *GetLightIndexBuffer() { return m_lightIndexBuffer.Get(); }
 		OGL::UniformLinearBuffer *GetDrawUniformBuffer(Uint32 size);
 		OGL::RenderStateCache *GetStateCache() { return m_renderStateCache.get(); }
+		OGL::StreamBuffer *GetStreamBuffer() { return m_streamBuffer.get(); }
 
 		virtual bool ReloadShaders() override final;
+		virtual void PrewarmShaders() override final;
 
 		virtual bool Screendump(ScreendumpState &sd) override final;
 
@@ -125,6 +150,9 @@ namespace Graphics {
 		bool DrawMeshDynamicInternal(BufferBinding<OGL::VertexBuffer> vtxBind, BufferBinding<OGL::IndexBuffer> idxBind, PrimitiveType type);
 
 	protected:
+		OGL::Shader *GetOrCreateShader(const std::string &name);
+		void SaveShaderVariants();
+
 		virtual void PushState() override final{};
 		virtual void PopState() override final{};
 
@@ -140,11 +168,23 @@ namespace Graphics {
 		// TODO: iterate shaderdef files on startup and cache by Shader name directive rather than filename fragment
 		std::vector<std::pair<std::string, OGL::Shader *>> m_shaders;
 		std::vector<std::unique_ptr<OGL::UniformLinearBuffer>> m_drawUniformBuffers;
+		uint32_t m_uniformBufferAlignment;
 		std::unique_ptr<OGL::RenderStateCache> m_renderStateCache;
+		std::unique_ptr<OGL::StreamBuffer> m_streamBuffer;
+		// null if timer queries aren't supported
+		std::unique_ptr<OGL::GPUTimer> m_gpuTimer;
+		// null unless enabled and the shared context could be used
+		std::unique_ptr<OGL::UploadThread> m_uploadThread;
 		RefCountedPtr<OGL::UniformBuffer> m_lightUniformBuffer;
+		std::unique_ptr<LightClusters> m_lightClusters;
+		RefCountedPtr<OGL::UniformBuffer> m_pointLightBuffer;
+		RefCountedPtr<OGL::UniformBuffer> m_lightClusterBuffer;
+		RefCountedPtr<OGL::UniformBuffer> m_lightIndexBuffer;
 		bool m_useNVDepthRanged;
 		OGL::RenderTarget *m_activeRenderTarget = nullptr;
 		std::unique_ptr<OGL::CommandList> m_drawCommandList;
+		// recordings that have been executed, for CreateRecording() to reuse
+		std::vector<std::unique_ptr<OGL::CommandList>> m_freeRecordings;
 
 		matrix4x4f m_modelViewMat;
 		matrix4x4f m_projectionMat;
@@ -163,6 +203,7 @@ namespace Graphics {
 		static DynamicBufferMap s_DynamicDrawBufferMap;
 
 		SDL_GLContext m_glContext;
+		SDL_GLContext m_uploadContext;
 	};
 #define CHECKERRORS() RendererOGL::CheckErrors(__FUNCTION__, __LINE__)
 
@@ -12,6 +12,7 @@
 #include "graphics/ShaderParser.h"
 #include "graphics/Types.h"
 #include "utils.h"
+#include "profiler/Profiler.h"
 
 #include <set>
 #include <sstream>
@@ -40,8 +41,11 @@ Shader::Shader(const std::string &name) :
 		throw ShaderException();
 	}
 
-	RefCountedPtr<FileSystem::FileData> fileData = fileInfo.Read();
-	ShaderParser::ShaderInfo info = ShaderParser::Parser().Parse(fileInfo.GetName(), { fileData->GetData(), fileData->GetSize() });
+	ShaderParser::ShaderInfo info;
+	if (!ShaderParser::SourceCache::Get().GetShaderInfo(fileInfo.GetPath(), info)) {
+		Log::Error("Cannot read shaderdef file {}\n", fileName);
+		throw ShaderException();
+	}
 
 	if (info.name == "<unknown>") {
 		Log::Warning("Shaderdef file {} is missing shader name declaration! Defaulting to {}.\n",
@@ -87,6 +91,9 @@ Shader::Shader(const std::string &name) :
 
 Shader::~Shader()
 {
+	for (auto &variant : m_pendingVariants)
+		delete variant.second;
+
 	while (!m_variants.empty()) {
 		delete m_variants.back().second;
 		m_variants.pop_back();
@@ -95,6 +102,9 @@ Shader::~Shader()
 
 Program *Shader::GetProgramForDesc(const MaterialDescriptor &desc)
 {
+	if (!m_pendingVariants.empty())
+		FinishPrewarm();
+
 	for (auto &pair : m_variants)
 		if (pair.first == desc)
 			return pair.second;
@@ -106,8 +116,38 @@ Program *Shader::GetProgramForDesc(const MaterialDescriptor &desc)
 	return program;
 }
 
+void Shader::PrewarmProgram(const MaterialDescriptor &desc)
+{
+	for (auto &pair : m_variants)
+		if (pair.first == desc)
+			return;
+	for (auto &pair : m_pendingVariants)
+		if (pair.first == desc)
+			return;
+
+	ProgramDef def = m_programDef;
+	def.defines = GetProgramDefines(desc);
+	m_pendingVariants.push_back({ desc, new Program(this, def, true) });
+}
+
+void Shader::FinishPrewarm()
+{
+	PROFILE_SCOPED()
+	for (auto &pair : m_pendingVariants) {
+		pair.second->FinishLoading(this);
+		if (pair.second->Loaded())
+			m_variants.push_back(pair);
+		else
+			delete pair.second;
+	}
+
+	m_pendingVariants.clear();
+}
+
 void Shader::Reload()
 {
+	FinishPrewarm();
+
 	// TODO: reload the shader definition file and regenerate
 	// binding points. This is probably not doable without some
 	// way to also track and reload all materials using this shader
@@ -76,6 +76,13 @@ namespace Graphics {
 
 			Program *GetProgramForDesc(const MaterialDescriptor &desc);
 			uint32_t GetNumVariants() const { return m_variants.size(); }
+			const std::vector<std::pair<MaterialDescriptor, Program *>> &GetVariants() const { return m_variants; }
+
+			// Start building the program for a variant ahead of its first use.
+			// The driver may build several programs at once in the background;
+			// FinishPrewarm waits for them to be done.
+			void PrewarmProgram(const MaterialDescriptor &desc);
+			void FinishPrewarm();
 
 			TextureBindingData GetTextureBindingInfo(size_t name) const;
 			size_t GetNumTextureBindings() const { return m_textureBindingInfo.size(); }
@@ -106,6 +113,8 @@ namespace Graphics {
 			ProgramDef m_programDef;
 			uint32_t m_constantStorageSize;
 			std::vector<std::pair<MaterialDescriptor, Program *>> m_variants;
+			// programs started by PrewarmProgram that aren't finished yet
+			std::vector<std::pair<MaterialDescriptor, Program *>> m_pendingVariants;
 
 			std::vector<TextureBindingData> m_textureBindingInfo;
 			std::vector<PushConstantData> m_pushConstantInfo;
@@ -0,0 +1,126 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "StreamBuffer.h"
+
+#include "graphics/GPUMemory.h"
+#include "profiler/Profiler.h"
+
+#include <cassert>
+#include <cstring>
+
+using namespace Graphics::OGL;
+
+// Allocations are aligned for any vertex attribute or index format
+static constexpr uint32_t STREAM_ALIGNMENT_MASK = 16 - 1;
+
+// Give the GPU a second to finish with a frame before we give up waiting
+static constexpr GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+
+StreamBuffer::StreamBuffer(uint32_t frameSize, bool persistent) :
+	m_frameSize(frameSize),
+	m_frame(0),
+	m_size(0),
+	m_lastFlush(0),
+	m_mapped(nullptr),
+	m_fences{}
+{
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+
+	if (persistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, GLsizeiptr(m_frameSize) * NUM_FRAMES, nullptr, flags);
+		m_mapped = reinterpret_cast<char *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, GLsizeiptr(m_frameSize) * NUM_FRAMES, flags));
+	}
+
+	// a single frame's worth of storage, orphaned at the end of each frame
+	if (!m_mapped) {
+		glBufferData(GL_ARRAY_BUFFER, m_frameSize, nullptr, GL_STREAM_DRAW);
+		m_data.reset(new char[m_frameSize]);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	Graphics::GPUMemory::Allocate(Graphics::GPUMemory::VERTEX_BUFFER, MemoryTag::UNTAGGED, GetStorageSize());
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	Graphics::GPUMemory::Free(Graphics::GPUMemory::VERTEX_BUFFER, MemoryTag::UNTAGGED, GetStorageSize());
+
+	for (GLsync &fence : m_fences)
+		if (fence)
+			glDeleteSync(fence);
+
+	if (m_mapped) {
+		glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	glDeleteBuffers(1, &m_buffer);
+}
+
+char *StreamBuffer::Allocate(uint32_t size, uint32_t &outOffset)
+{
+	const uint32_t alignedSize = (size + STREAM_ALIGNMENT_MASK) & ~STREAM_ALIGNMENT_MASK;
+	if (alignedSize > m_frameSize - m_size)
+		return nullptr;
+
+	const uint32_t offset = m_size;
+	m_size += alignedSize;
+
+	if (m_mapped) {
+		outOffset = m_frame * m_frameSize + offset;
+		return m_mapped + outOffset;
+	}
+
+	outOffset = offset;
+	return m_data.get() + offset;
+}
+
+void StreamBuffer::Flush()
+{
+	PROFILE_SCOPED()
+	// coherent mappings are visible to the GPU as soon as they're written
+	if (m_mapped || m_lastFlush == m_size)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, m_lastFlush, m_size - m_lastFlush, m_data.get() + m_lastFlush);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_lastFlush = m_size;
+}
+
+void StreamBuffer::EndFrame()
+{
+	PROFILE_SCOPED()
+	m_size = 0;
+	m_lastFlush = 0;
+
+	if (!m_mapped) {
+		// respecify the storage to orphan data that might still be in flight
+		glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+		glBufferData(GL_ARRAY_BUFFER, m_frameSize, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+
+	assert(!m_fences[m_frame]);
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_frame = (m_frame + 1) % NUM_FRAMES;
+
+	// the GPU is normally done with the frame before last long before we
+	// get here; only wait if it has fallen behind
+	GLsync fence = m_fences[m_frame];
+	if (!fence)
+		return;
+
+	if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+		PROFILE_SCOPED_DESC("Wait for stream buffer")
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+	}
+
+	glDeleteSync(fence);
+	m_fences[m_frame] = nullptr;
+}
@@ -0,0 +1,78 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#pragma once
+
+#include "OpenGLLibs.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace Graphics {
+
+	namespace OGL {
+
+		/*
+			Renderer-wide ring buffer for geometry that is written once and
+			drawn in the same frame (immediate geometry, ImGui draw lists).
+			Call Allocate to reserve a subrange of the buffer to write into;
+			allocations are released at the end of the frame.
+
+			With GL_ARB_buffer_storage the buffer is mapped once, persistently
+			and coherently, and holds the data of the last few frames; a fence
+			makes sure the GPU is done with a frame's part of the ring before
+			it is written again. Without it the data is staged in client memory
+			and uploaded by Flush, orphaning the buffer at the end of the frame.
+		*/
+		class StreamBuffer {
+		public:
+			// frameSize bytes can be allocated in each frame
+			StreamBuffer(uint32_t frameSize, bool persistent);
+			~StreamBuffer();
+
+			// Don't copy a buffer
+			StreamBuffer(const StreamBuffer &) = delete;
+			StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+			GLuint GetBuffer() const { return m_buffer; }
+			bool IsPersistent() const { return m_mapped != nullptr; }
+
+			uint32_t GetFrameSize() const { return m_frameSize; }
+			uint32_t GetUsedSize() const { return m_size; }
+
+			// Reserve size bytes in this frame's part of the buffer. Returns the
+			// memory to write them to and their offset in the buffer, or nullptr
+			// if the frame's space is used up.
+			char *Allocate(uint32_t size, uint32_t &outOffset);
+
+			// Makes the data written so far visible to the GPU. Call this once
+			// before executing a command list.
+			void Flush();
+
+			// Releases all allocations made in this frame. Waits for the GPU if
+			// it is still reading the part of the ring the next frame will use.
+			void EndFrame();
+
+		private:
+			static constexpr uint32_t NUM_FRAMES = 3;
+
+			size_t GetStorageSize() const { return size_t(m_frameSize) * (m_mapped ? NUM_FRAMES : 1); }
+
+			GLuint m_buffer;
+			uint32_t m_frameSize;
+			uint32_t m_frame;
+			// bytes allocated in the current frame
+			uint32_t m_size;
+			uint32_t m_lastFlush;
+
+			// persistent mapping of the whole ring
+			char *m_mapped;
+			GLsync m_fences[NUM_FRAMES];
+
+			// client-side staging memory if the buffer can't be mapped
+			std::unique_ptr<char[]> m_data;
+		};
+
+	} // namespace OGL
+
+} // namespace Graphics
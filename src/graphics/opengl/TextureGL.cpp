@@ -82,9 +82,27 @@ namespace Graphics {
 			return (format == TEXTURE_DXT1 || format == TEXTURE_DXT5);
 		}
 
-		TextureGL::TextureGL(const TextureDescriptor &descriptor, const bool useCompressed, const bool useAnisoFiltering, const Uint16 numSamples) :
+		// Size of an uncompressed image and its mips as the driver is likely
+		// to store it: RGB padded to four bytes, or compressed on upload
+		inline size_t GetImageSize(TextureFormat format, bool compressOnUpload, size_t width, size_t height, bool mipmaps)
+		{
+			size_t bitsPerPixel;
+			switch (format) {
+			case TEXTURE_RGBA_8888: bitsPerPixel = compressOnUpload ? 8 : 32; break;
+			case TEXTURE_RGB_888: bitsPerPixel = compressOnUpload ? 4 : 32; break;
+			case TEXTURE_RG_88: bitsPerPixel = 16; break;
+			case TEXTURE_DEPTH: bitsPerPixel = 32; break;
+			default: bitsPerPixel = 8; break;
+			}
+			const size_t size = width * height * bitsPerPixel / 8;
+			return mipmaps ? size + size / 3 : size;
+		}
+
+		TextureGL::TextureGL(const TextureDescriptor &descriptor, const bool useCompressed, const bool useAnisoFiltering, const Uint16 numSamples, GPUMemory::Kind memoryKind) :
 			Texture(descriptor),
 			m_allocSize(0),
+			m_memoryTag(MemoryTag::GetCurrent(MemoryTag::TEXTURES)),
+			m_memoryKind(memoryKind),
 			m_useAnisoFiltering(useAnisoFiltering && descriptor.useAnisotropicFiltering)
 		{
 			PROFILE_SCOPED()
@@ -107,6 +125,7 @@ namespace Graphics {
 					m_target, numSamples, GLInternalFormat(descriptor.format),
 					descriptor.dataSize.x, descriptor.dataSize.y, true); // must use fixedsamplelocations when mixed with renderbuffer
 				CHECKERRORS();
+				m_allocSize = GetImageSize(descriptor.format, false, descriptor.dataSize.x, descriptor.dataSize.y, false) * numSamples;
 			} break;
 			case GL_TEXTURE_2D:
 				if (!IsCompressed(descriptor.format)) {
@@ -120,6 +139,7 @@ namespace Graphics {
 						GLImageFormat(descriptor.format),
 						GLImageType(descriptor.format), 0);
 					CHECKERRORS();
+					m_allocSize = GetImageSize(descriptor.format, compressTexture, descriptor.dataSize.x, descriptor.dataSize.y, descriptor.generateMipmaps);
 				} else {
 					size_t Width = descriptor.dataSize.x;
 					size_t Height = descriptor.dataSize.y;
@@ -178,6 +198,7 @@ namespace Graphics {
 						GLImageFormat(descriptor.format),
 						GLImageType(descriptor.format), 0);
 					CHECKERRORS();
+					m_allocSize = GetImageSize(descriptor.format, compressTexture, descriptor.dataSize.x, descriptor.dataSize.y, descriptor.generateMipmaps) * 6;
 				} else {
 					size_t Width = descriptor.dataSize.x;
 					size_t Height = descriptor.dataSize.y;
@@ -220,6 +241,7 @@ namespace Graphics {
 					if (descriptor.generateMipmaps) {
 						glGenerateMipmap(m_target);
 					}
+					m_allocSize = GetImageSize(descriptor.format, compressTexture, descriptor.dataSize.x, descriptor.dataSize.y, descriptor.generateMipmaps) * size_t(descriptor.dataSize.z);
 				} else {
 					size_t Width = descriptor.dataSize.x;
 					size_t Height = descriptor.dataSize.y;
@@ -294,10 +316,14 @@ namespace Graphics {
 			}
 
 			CHECKERRORS();
+			MemoryTag::Allocate(m_memoryTag, m_allocSize);
+			GPUMemory::Allocate(m_memoryKind, m_memoryTag, m_allocSize);
 		}
 
 		TextureGL::~TextureGL()
 		{
+			MemoryTag::Free(m_memoryTag, m_allocSize);
+			GPUMemory::Free(m_memoryKind, m_memoryTag, m_allocSize);
 			glDeleteTextures(1, &m_texture);
 		}
 
@@ -536,5 +562,82 @@ namespace Graphics {
 			}
 		}
 
+		bool TextureGL::ReadPixels(void *data, uint32_t face)
+		{
+			PROFILE_SCOPED()
+			if (GetDescriptor().format != TEXTURE_RGBA_8888)
+				return false;
+
+			GLenum target;
+			switch (m_target) {
+			case GL_TEXTURE_2D:
+				target = GL_TEXTURE_2D;
+				break;
+			case GL_TEXTURE_CUBE_MAP:
+				if (face >= 6)
+					return false;
+				target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+				break;
+			default:
+				return false;
+			}
+
+			glBindTexture(m_target, m_texture);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glGetTexImage(target, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glBindTexture(m_target, 0);
+			CHECKERRORS();
+			return true;
+		}
+
+		bool TextureGL::SetResidentMips(const void *data, uint32_t firstMip)
+		{
+			PROFILE_SCOPED()
+			const TextureDescriptor &descriptor = GetDescriptor();
+			if (m_target != GL_TEXTURE_2D || !IsCompressed(descriptor.format) || firstMip >= descriptor.numberOfMipMaps)
+				return false;
+
+			// the storage of the mips already uploaded can't be released on
+			// its own, so upload the new chain into a new texture and swap it in
+			GLuint texture;
+			glGenTextures(1, &texture);
+			glBindTexture(m_target, texture);
+
+			const unsigned char *pData = static_cast<const unsigned char *>(data);
+			size_t Offset = 0;
+			size_t Width = std::max<size_t>(size_t(descriptor.dataSize.x) >> firstMip, 1ul);
+			size_t Height = std::max<size_t>(size_t(descriptor.dataSize.y) >> firstMip, 1ul);
+
+			const GLint numMips = descriptor.numberOfMipMaps - firstMip;
+			for (GLint i = 0; i < numMips; ++i) {
+				size_t bufSize = ((Width + 3) / 4) * ((Height + 3) / 4) * GetMinSize(descriptor.format);
+				glCompressedTexImage2D(m_target, i, GLInternalFormat(descriptor.format), Width, Height, 0, bufSize, &pData[Offset]);
+
+				Offset += bufSize;
+				Width = std::max<size_t>(Width / 2, 1ul);
+				Height = std::max<size_t>(Height / 2, 1ul);
+			}
+			glTexParameteri(m_target, GL_TEXTURE_MAX_LEVEL, numMips - 1);
+
+			const bool repeat = descriptor.sampleMode == LINEAR_REPEAT || descriptor.sampleMode == NEAREST_REPEAT;
+			glTexParameteri(m_target, GL_TEXTURE_WRAP_S, repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+			glTexParameteri(m_target, GL_TEXTURE_WRAP_T, repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+			glBindTexture(m_target, 0);
+
+			glDeleteTextures(1, &m_texture);
+			m_texture = texture;
+			MemoryTag::Free(m_memoryTag, m_allocSize);
+			MemoryTag::Allocate(m_memoryTag, Offset);
+			GPUMemory::Free(m_memoryKind, m_memoryTag, m_allocSize);
+			GPUMemory::Allocate(m_memoryKind, m_memoryTag, Offset);
+			m_allocSize = Offset;
+
+			// sets the filtering of the new texture
+			SetSampleMode(descriptor.sampleMode);
+			CHECKERRORS();
+			return true;
+		}
+
 	} // namespace OGL
 } // namespace Graphics
@@ -5,6 +5,8 @@
 #define _TEXTUREGL_H
 
 #include "OpenGLLibs.h"
+#include "core/MemoryTag.h"
+#include "graphics/GPUMemory.h"
 #include "graphics/Texture.h"
 
 namespace Graphics {
@@ -15,7 +17,8 @@ namespace Graphics {
 			virtual void Update(const TextureCubeData &data, const vector3f &dataSize, TextureFormat format, const unsigned int numMips) override final;
 			virtual void Update(const vecDataPtr &data, const vector3f &dataSize, const TextureFormat format, const unsigned int numMips) override final;
 
-			TextureGL(const TextureDescriptor &descriptor, const bool useCompressed, const bool useAnisoFiltering, const Uint16 numSamples = 0);
+			TextureGL(const TextureDescriptor &descriptor, const bool useCompressed, const bool useAnisoFiltering, const Uint16 numSamples = 0,
+				GPUMemory::Kind memoryKind = GPUMemory::TEXTURE);
 			virtual ~TextureGL();
 
 			virtual void Bind() override final;
@@ -23,6 +26,8 @@ namespace Graphics {
 
 			virtual void SetSampleMode(TextureSampleMode) override final;
 			virtual void BuildMipmaps(const uint32_t validMips = 1) override final;
+			virtual bool ReadPixels(void *data, uint32_t face = 0) override final;
+			virtual bool SetResidentMips(const void *data, uint32_t firstMip) override final;
 			virtual uint32_t GetTextureID() const override final
 			{
 				static_assert(sizeof(uint32_t) == sizeof(GLuint));
@@ -41,6 +46,9 @@ namespace Graphics {
 			GLenum m_target;
 			GLuint m_texture;
 			uint32_t m_allocSize;
+			// what the texture was loaded for, see MemoryTag::Scope
+			const MemoryTag::Tag m_memoryTag;
+			const GPUMemory::Kind m_memoryKind;
 			const bool m_useAnisoFiltering;
 		};
 	} // namespace OGL
@@ -9,16 +9,18 @@
 using Graphics::BufferBinding;
 using namespace Graphics::OGL;
 
-// From OpenGL, the minimum alignment of a buffer range binding
-static constexpr int MIN_BUFFER_ALIGNMENT_MASK = 256 - 1;
+// From OpenGL, the largest alignment a buffer range binding may require
+static constexpr uint32_t MAX_BUFFER_ALIGNMENT = 256;
 
 UniformBuffer::UniformBuffer(uint32_t size, BufferUsage usage) :
-	Graphics::UniformBuffer(size, usage)
+	Graphics::UniformBuffer(size, usage),
+	GLBufferBase(Graphics::GPUMemory::UNIFORM_BUFFER)
 {
 	glGenBuffers(1, &m_buffer);
 	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
 	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, (usage == BUFFER_USAGE_STATIC) ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	SetStorageSize(size);
 }
 
 UniformBuffer::~UniformBuffer()
@@ -66,15 +68,16 @@ void *UniformBuffer::MapInternal(BufferMapMode mode)
 // Uniform Buffer- Backed Linear Allocator
 //
 
-UniformLinearBuffer::UniformLinearBuffer(uint32_t size) :
+UniformLinearBuffer::UniformLinearBuffer(uint32_t size, uint32_t alignment) :
 	UniformBuffer(size, BUFFER_USAGE_DYNAMIC),
 	m_lastFlush(0),
 	m_numAllocs(0)
 {
-	glGenBuffers(1, &m_buffer);
-	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
-	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	// drivers with a smaller alignment let us pack the draw data tighter
+	if (alignment == 0 || alignment > MAX_BUFFER_ALIGNMENT || (alignment & (alignment - 1)))
+		alignment = MAX_BUFFER_ALIGNMENT;
+	m_alignMask = alignment - 1;
+
 	m_size = 0;
 	m_data.reset(new char[size]);
 }
@@ -82,7 +85,6 @@ UniformLinearBuffer::UniformLinearBuffer(uint32_t size) :
 UniformLinearBuffer::~UniformLinearBuffer()
 {
 	assert(m_mapMode == BUFFER_MAP_NONE);
-	glDeleteBuffers(1, &m_buffer);
 	m_data.reset();
 }
 
@@ -96,6 +98,21 @@ void UniformLinearBuffer::Reset()
 	glBufferData(GL_UNIFORM_BUFFER, m_capacity, nullptr, GL_DYNAMIC_DRAW);
 }
 
+void UniformLinearBuffer::Grow(uint32_t capacity)
+{
+	assert(m_size == 0 && m_mapMode == BUFFER_MAP_NONE);
+	if (capacity <= m_capacity)
+		return;
+
+	m_capacity = capacity;
+	m_data.reset(new char[capacity]);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, m_capacity, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	SetStorageSize(m_capacity);
+}
+
 void UniformLinearBuffer::Flush()
 {
 	PROFILE_SCOPED()
@@ -134,7 +151,7 @@ BufferBinding<UniformBuffer> UniformLinearBuffer::Allocate(void *data, size_t si
 	memcpy(m_data.get() + offset, data, size);
 
 	// Consume the buffer in increments of aligned size
-	m_size += (size + MIN_BUFFER_ALIGNMENT_MASK) & ~MIN_BUFFER_ALIGNMENT_MASK;
+	m_size += (size + m_alignMask) & ~m_alignMask;
 	m_numAllocs++;
 
 	return { this, offset, uint32_t(size) };
@@ -151,7 +168,7 @@ void *UniformLinearBuffer::AllocInternal(size_t size, BufferBinding<UniformBuffe
 
 	uint32_t offset = m_size;
 	// Consume the buffer in increments of aligned size
-	m_size += (size + MIN_BUFFER_ALIGNMENT_MASK) & ~MIN_BUFFER_ALIGNMENT_MASK;
+	m_size += (size + m_alignMask) & ~m_alignMask;
 	m_numAllocs++;
 
 	outBinding = { this, offset, uint32_t(size) };
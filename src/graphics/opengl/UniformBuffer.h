@@ -38,7 +38,9 @@ namespace Graphics {
 		*/
 		class UniformLinearBuffer : public UniformBuffer {
 		public:
-			UniformLinearBuffer(uint32_t maxSize);
+			// alignment is the minimum offset alignment of a buffer range
+			// binding, GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+			UniformLinearBuffer(uint32_t maxSize, uint32_t alignment);
 			~UniformLinearBuffer() override;
 
 			// Don't copy a buffer
@@ -57,7 +59,12 @@ namespace Graphics {
 			// making it ready for a new frame.
 			void Reset();
 
-			uint32_t FreeSize() const { return m_capacity - m_size; }
+			// Reallocate the (reset) buffer with a larger capacity
+			void Grow(uint32_t capacity);
+
+			uint32_t FreeSize() const { return m_size < m_capacity ? m_capacity - m_size : 0; }
+			// the data written to the buffer so far this frame
+			const char *GetData() const { return m_data.get(); }
 			uint32_t NumAllocs() const { return m_numAllocs; }
 
 			template <typename T>
@@ -84,6 +91,7 @@ namespace Graphics {
 			// we can use the same allocator with multiple command lists
 			uint32_t m_lastFlush;
 			uint32_t m_numAllocs;
+			uint32_t m_alignMask;
 		};
 
 	} // namespace OGL
@@ -0,0 +1,126 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "UploadThread.h"
+
+#include "core/Log.h"
+#include "profiler/Profiler.h"
+
+#include <SDL_video.h>
+
+#include <vector>
+
+namespace Graphics {
+
+	namespace OGL {
+
+		UploadThread::UploadThread(SDL_Window *window, SDL_GLContext context) :
+			m_window(window),
+			m_context(context),
+			m_started(false),
+			m_running(false),
+			m_quit(false),
+			m_inFlight(0)
+		{
+			m_thread = std::thread(&UploadThread::Run, this);
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return m_started; });
+		}
+
+		UploadThread::~UploadThread()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_quit = true;
+			}
+			m_wake.notify_all();
+			m_thread.join();
+
+			for (Upload &upload : m_uploaded)
+				glDeleteSync(upload.fence);
+		}
+
+		void UploadThread::Queue(std::function<void()> upload, std::function<void()> done)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_queued.push_back({ std::move(upload), std::move(done) });
+			}
+			m_wake.notify_all();
+			m_inFlight++;
+		}
+
+		void UploadThread::Update(Stats &stats)
+		{
+			PROFILE_SCOPED()
+
+			std::vector<Upload> finished;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				while (!m_uploaded.empty()) {
+					// the fences of one context signal in order, so the first
+					// one that hasn't is as far as this frame gets
+					const GLenum result = glClientWaitSync(m_uploaded.front().fence, 0, 0);
+					if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+						break;
+					glDeleteSync(m_uploaded.front().fence);
+					finished.push_back(std::move(m_uploaded.front()));
+					m_uploaded.pop_front();
+				}
+			}
+
+			for (Upload &upload : finished) {
+				if (upload.done)
+					upload.done();
+			}
+			m_inFlight -= finished.size();
+
+			stats.AddToStatCount(Stats::STAT_UPLOADS_FINISHED, finished.size());
+			stats.SetStatCount(Stats::STAT_UPLOADS_IN_FLIGHT, m_inFlight);
+		}
+
+		void UploadThread::Run()
+		{
+			const bool current = SDL_GL_MakeCurrent(m_window, m_context) == 0;
+			if (!current)
+				Log::Warning("Upload thread couldn't make its GL context current: {}", SDL_GetError());
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_started = true;
+			m_running = current;
+			m_wake.notify_all();
+			if (!current)
+				return;
+
+			while (true) {
+				m_wake.wait(lock, [this]() { return m_quit || !m_queued.empty(); });
+				if (m_quit)
+					break;
+
+				Upload upload = std::move(m_queued.front());
+				m_queued.pop_front();
+				lock.unlock();
+
+				{
+					PROFILE_SCOPED_DESC("Upload")
+					upload.upload();
+				}
+				upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				// the fence can't signal until the commands before it are
+				// submitted, and the main thread won't wait for them
+				glFlush();
+
+				lock.lock();
+				m_uploaded.push_back(std::move(upload));
+			}
+
+			// whatever is left in the queue is released with the thread object,
+			// on the main thread
+			lock.unlock();
+			SDL_GL_MakeCurrent(m_window, nullptr);
+		}
+
+	} // namespace OGL
+
+} // namespace Graphics
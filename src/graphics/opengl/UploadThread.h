@@ -0,0 +1,85 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#pragma once
+
+#include "OpenGLLibs.h"
+#include "graphics/Stats.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct SDL_Window;
+typedef void *SDL_GLContext;
+
+namespace Graphics {
+
+	namespace OGL {
+
+		/*
+			Copies buffer and texture data to the GPU on a thread of its own,
+			with a GL context shared with the renderer's, so that bulk
+			uploads don't stall the frame they are made in.
+
+			Each upload is followed by a fence. The renderer polls the fences
+			once a frame on the main thread, and an upload is finished when
+			its fence has signalled: only then is its done callback called
+			and are the resources it names safe to draw with.
+
+			The upload function runs on the upload thread and may only make
+			GL calls on the objects it was given. Everything an upload holds
+			is released on the main thread, after its done callback, so it
+			may keep RefCountedPtrs to the resources it writes.
+		*/
+		class UploadThread {
+		public:
+			// context must be shared with the renderer's and not current on
+			// any thread
+			UploadThread(SDL_Window *window, SDL_GLContext context);
+			// Waits for the upload in progress; the queued ones are dropped
+			// without their done callbacks
+			~UploadThread();
+
+			UploadThread(const UploadThread &) = delete;
+			UploadThread &operator=(const UploadThread &) = delete;
+
+			// false if the thread couldn't use the context, and nothing
+			// queued would ever be uploaded
+			bool IsRunning() const { return m_running; }
+
+			void Queue(std::function<void()> upload, std::function<void()> done);
+
+			// Call the done callbacks of the uploads the GPU has finished, in
+			// the order they were queued; once per frame on the main thread
+			void Update(Stats &stats);
+
+		private:
+			struct Upload {
+				std::function<void()> upload;
+				std::function<void()> done;
+				GLsync fence = nullptr;
+			};
+
+			void Run();
+
+			SDL_Window *m_window;
+			SDL_GLContext m_context;
+			std::thread m_thread;
+
+			std::mutex m_mutex;
+			std::condition_variable m_wake;
+			bool m_started;
+			bool m_running;
+			bool m_quit;
+			std::deque<Upload> m_queued;
+			std::deque<Upload> m_uploaded;
+			// queued and not finished yet, main thread only
+			uint32_t m_inFlight;
+		};
+
+	} // namespace OGL
+
+} // namespace Graphics
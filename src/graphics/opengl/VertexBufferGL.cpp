@@ -6,6 +6,7 @@
 #include "graphics/Types.h"
 #include "graphics/VertexArray.h"
 #include "graphics/opengl/RendererGL.h"
+#include "graphics/opengl/StreamBuffer.h"
 #include "utils.h"
 #include <algorithm>
 
@@ -27,20 +28,31 @@ namespace Graphics {
 			}
 		}
 
-		static GLuint is_attr_normalized(VertexAttrib semantic)
+		static GLuint is_attr_normalized(VertexAttrib semantic, VertexAttribFormat fmt)
 		{
-			return semantic == ATTRIB_DIFFUSE ? GL_TRUE : GL_FALSE;
+			switch (fmt) {
+			case ATTRIB_FORMAT_SHORT4_NORM:
+			case ATTRIB_FORMAT_BYTE4_NORM:
+			case ATTRIB_FORMAT_USHORT2_NORM:
+				return GL_TRUE;
+			default:
+				return semantic == ATTRIB_DIFFUSE ? GL_TRUE : GL_FALSE;
+			}
 		}
 
 		static GLint get_num_components(VertexAttribFormat fmt)
 		{
 			switch (fmt) {
 			case ATTRIB_FORMAT_FLOAT2:
+			case ATTRIB_FORMAT_USHORT2_NORM:
+			case ATTRIB_FORMAT_HALF2:
 				return 2;
 			case ATTRIB_FORMAT_FLOAT3:
 				return 3;
 			case ATTRIB_FORMAT_FLOAT4:
 			case ATTRIB_FORMAT_UBYTE4:
+			case ATTRIB_FORMAT_SHORT4_NORM:
+			case ATTRIB_FORMAT_BYTE4_NORM:
 				return 4;
 			default:
 				assert(false);
@@ -53,6 +65,14 @@ namespace Graphics {
 			switch (fmt) {
 			case ATTRIB_FORMAT_UBYTE4:
 				return GL_UNSIGNED_BYTE;
+			case ATTRIB_FORMAT_SHORT4_NORM:
+				return GL_SHORT;
+			case ATTRIB_FORMAT_BYTE4_NORM:
+				return GL_BYTE;
+			case ATTRIB_FORMAT_USHORT2_NORM:
+				return GL_UNSIGNED_SHORT;
+			case ATTRIB_FORMAT_HALF2:
+				return GL_HALF_FLOAT;
 			case ATTRIB_FORMAT_FLOAT2:
 			case ATTRIB_FORMAT_FLOAT3:
 			case ATTRIB_FORMAT_FLOAT4:
@@ -74,29 +94,38 @@ namespace Graphics {
 			}
 		}
 
-		VertexBuffer::VertexBuffer(const VertexBufferDesc &desc, size_t stateHash) :
+		VertexBuffer::VertexBuffer(const VertexBufferDesc &desc, size_t stateHash, StreamBuffer *stream, const void *data) :
 			Graphics::VertexBuffer(desc),
-			m_vertexStateHash(stateHash)
+			GLBufferBase(GPUMemory::VERTEX_BUFFER),
+			m_vertexStateHash(stateHash),
+			m_stream(stream)
 		{
 			PROFILE_SCOPED()
 
 			m_desc.CalculateOffsets();
 			assert(m_desc.stride > 0);
 
-			//Allocate GL buffer with undefined contents
+			//Allocate GL buffer with undefined contents, unless they were given
 			//Critical optimisation for some architectures in cases where buffer is created and written in the same frame
 			glGenBuffers(1, &m_buffer);
 			glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
 			const Uint32 dataSize = m_desc.numVertices * m_desc.stride;
-			glBufferData(GL_ARRAY_BUFFER, dataSize, 0, get_buffer_usage(m_desc.usage));
+			glBufferData(GL_ARRAY_BUFFER, dataSize, data, get_buffer_usage(m_desc.usage));
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			SetStorageSize(dataSize);
 
 			// Allocate client data store for dynamic buffers
 			if (GetDesc().usage != BUFFER_USAGE_STATIC) {
 				m_data = new Uint8[dataSize];
-				memset(m_data, 0, dataSize);
+				if (data)
+					memcpy(m_data, data, dataSize);
+				else
+					memset(m_data, 0, dataSize);
 			} else
 				m_data = nullptr;
+
+			if (data)
+				m_written = true;
 		}
 
 		VertexBuffer::~VertexBuffer()
@@ -115,8 +144,13 @@ namespace Graphics {
 				glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
 				if (mode == BUFFER_MAP_READ)
 					return reinterpret_cast<Uint8 *>(glMapBuffer(GL_ARRAY_BUFFER, GL_READ_ONLY));
-				else if (mode == BUFFER_MAP_WRITE)
-					return reinterpret_cast<Uint8 *>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+				else if (mode == BUFFER_MAP_WRITE) {
+					// callers always rewrite the whole buffer, so orphan the old
+					// storage instead of waiting for the GPU to finish with it
+					// (recycled buffers may still be in use by queued draws)
+					const GLsizeiptr dataSize = m_desc.numVertices * m_desc.stride;
+					return reinterpret_cast<Uint8 *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, dataSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+				}
 			}
 
 			return m_data;
@@ -304,13 +338,33 @@ namespace Graphics {
 			return result;
 		}
 
+		// Write the data to a new subrange of the stream buffer, if there is
+		// room for it in this frame
+		static bool stream_buffer_data(StreamBuffer *stream, const size_t size, const void *data, GLuint &outBuffer, uint32_t &outOffset)
+		{
+			char *dst = stream && size > 0 ? stream->Allocate(uint32_t(size), outOffset) : nullptr;
+			if (!dst) {
+				outBuffer = 0;
+				outOffset = 0;
+				return false;
+			}
+
+			memcpy(dst, data, size);
+			outBuffer = stream->GetBuffer();
+			return true;
+		}
+
 		void VertexBuffer::BufferData(const size_t size, void *data)
 		{
 			PROFILE_SCOPED()
 			assert(m_mapMode == BUFFER_MAP_NONE); //must not be currently mapped
 			if (GetDesc().usage == BUFFER_USAGE_DYNAMIC) {
+				if (stream_buffer_data(m_stream, size, data, m_streamBuffer, m_streamOffset))
+					return;
+
 				glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
 				glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(size), static_cast<GLvoid *>(data), GL_DYNAMIC_DRAW);
+				SetStorageSize(size);
 			}
 		}
 
@@ -326,17 +380,24 @@ namespace Graphics {
 		}
 
 		// ------------------------------------------------------------
-		CachedVertexBuffer::CachedVertexBuffer(const VertexBufferDesc &desc, size_t stateHash) :
-			VertexBuffer(desc, stateHash)
+		CachedVertexBuffer::CachedVertexBuffer(const VertexBufferDesc &desc, size_t stateHash, StreamBuffer *stream) :
+			VertexBuffer(desc, stateHash, stream),
+			m_lastOffset(0)
 		{
 			assert(desc.usage == BufferUsage::BUFFER_USAGE_DYNAMIC);
+			assert(m_stream);
+			// our own (empty) storage is never drawn from
+			m_streamBuffer = m_stream->GetBuffer();
+			m_written = true;
 			m_size = 0;
-			m_lastFlushed = 0;
 		}
 
 		bool CachedVertexBuffer::Populate(const VertexArray &va)
 		{
-			assert(m_capacity - m_size >= va.GetNumVerts());
+			PROFILE_SCOPED()
+			uint8_t *vertices = reinterpret_cast<uint8_t *>(m_stream->Allocate(va.GetNumVerts() * m_desc.stride, m_lastOffset));
+			if (!vertices)
+				return false;
 
 			// ugly but effective way of counting the number of non-empty vertex attribute slots
 			uint32_t numAttrs = 0;
@@ -348,7 +409,7 @@ namespace Graphics {
 			for (size_t idx = 0; idx < va.GetNumVerts(); idx++) {
 				for (uint32_t n = 0; n < numAttrs; n++) {
 					// Calculate the location of this component inside the vertex being written
-					uint8_t *data = m_data + (m_size + idx) * m_desc.stride + m_desc.attrib[n].offset;
+					uint8_t *data = vertices + idx * m_desc.stride + m_desc.attrib[n].offset;
 					switch (m_desc.attrib[n].semantic) {
 					case ATTRIB_POSITION:
 						*reinterpret_cast<vector3f *>(data) = va.position[idx];
@@ -372,60 +433,43 @@ namespace Graphics {
 				}
 			}
 
-			m_size += va.GetNumVerts();
 			return true;
 		}
 
-		// Send accumulated data to the GPU prior to using the buffer for rendering
-		bool CachedVertexBuffer::Flush()
-		{
-			uint32_t dataSize = m_size * m_desc.stride;
-			if (m_lastFlushed >= dataSize)
-				return false;
-
-			glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
-			glBufferSubData(GL_ARRAY_BUFFER, m_lastFlushed, dataSize - m_lastFlushed, m_data + m_lastFlushed);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			m_lastFlushed = dataSize;
-			m_written = true;
-			return true;
-		}
-
-		// Reset the cache and associated buffer for use in a new frame
-		void CachedVertexBuffer::Reset()
-		{
-			// respecify the buffer storage to orphan data that theoretically might still be in flight
-			glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
-			glBufferData(GL_ARRAY_BUFFER, m_capacity * m_desc.stride, nullptr, get_buffer_usage(m_desc.usage));
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-			m_size = 0;
-			m_lastFlushed = 0;
-			m_written = false;
-		}
-
 		// ------------------------------------------------------------
-		IndexBuffer::IndexBuffer(Uint32 size, BufferUsage hint, IndexBufferSize elem) :
+		IndexBuffer::IndexBuffer(Uint32 size, BufferUsage hint, IndexBufferSize elem, StreamBuffer *stream, const void *data) :
 			Graphics::IndexBuffer(size, hint, elem),
+			GLBufferBase(GPUMemory::INDEX_BUFFER),
 			m_data(nullptr),
-			m_data16(nullptr)
+			m_data16(nullptr),
+			m_stream(stream)
 		{
 			const GLenum usage = (hint == BUFFER_USAGE_STATIC) ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW;
 			const GLuint gl_size = (elem == INDEX_BUFFER_16BIT ? sizeof(Uint16) : sizeof(Uint32)) * m_size;
 			glGenBuffers(1, &m_buffer);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffer);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, gl_size, 0, usage);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, gl_size, data, usage);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+			SetStorageSize(gl_size);
 
 			if (GetUsage() != BUFFER_USAGE_STATIC) {
+				void *store;
 				if (elem == INDEX_BUFFER_16BIT) {
 					m_data16 = new Uint16[size];
-					memset(m_data16, 0, sizeof(Uint16) * size);
+					store = m_data16;
 				} else {
 					m_data = new Uint32[size];
-					memset(m_data, 0, sizeof(Uint32) * size);
+					store = m_data;
 				}
+
+				if (data)
+					memcpy(store, data, gl_size);
+				else
+					memset(store, 0, gl_size);
 			}
+
+			if (data)
+				m_written = true;
 		}
 
 		IndexBuffer::~IndexBuffer()
@@ -499,8 +543,12 @@ namespace Graphics {
 			PROFILE_SCOPED()
 			assert(m_mapMode == BUFFER_MAP_NONE); //must not be currently mapped
 			if (GetUsage() == BUFFER_USAGE_DYNAMIC) {
+				if (stream_buffer_data(m_stream, size, data, m_streamBuffer, m_streamOffset))
+					return;
+
 				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffer);
 				glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(size), static_cast<GLvoid *>(data), GL_DYNAMIC_DRAW);
+				SetStorageSize(size);
 			}
 		}
 
@@ -516,8 +564,10 @@ namespace Graphics {
 		}
 
 		// ------------------------------------------------------------
-		InstanceBuffer::InstanceBuffer(Uint32 size, BufferUsage hint) :
-			Graphics::InstanceBuffer(size, hint)
+		InstanceBuffer::InstanceBuffer(Uint32 size, BufferUsage hint, StreamBuffer *stream) :
+			Graphics::InstanceBuffer(size, hint),
+			GLBufferBase(GPUMemory::INSTANCE_BUFFER),
+			m_stream(stream)
 		{
 			assert(size > 0);
 
@@ -526,6 +576,7 @@ namespace Graphics {
 			glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
 			glBufferData(GL_ARRAY_BUFFER, sizeof(matrix4x4f) * m_size, 0, usage);
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			SetStorageSize(sizeof(matrix4x4f) * m_size);
 
 			if (GetUsage() != BUFFER_USAGE_STATIC) {
 				m_data.reset(new matrix4x4f[size]);
@@ -572,6 +623,18 @@ namespace Graphics {
 
 			m_mapMode = BUFFER_MAP_NONE;
 			m_written = true;
+			m_streamBuffer = 0;
+			m_streamOffset = 0;
+		}
+
+		bool InstanceBuffer::Stream(const matrix4x4f *transforms, Uint32 count)
+		{
+			if (!stream_buffer_data(m_stream, count * sizeof(matrix4x4f), transforms, m_streamBuffer, m_streamOffset))
+				return false;
+
+			m_instanceCount = count;
+			m_written = true;
+			return true;
 		}
 
 		void InstanceBuffer::Bind()
@@ -584,7 +647,7 @@ namespace Graphics {
 			glEnableVertexAttribArray(INSTOFFS_MAT2);
 			glEnableVertexAttribArray(INSTOFFS_MAT3);
 
-			glBindVertexBuffer(1, m_buffer, 0, sizeof(float) * 16);
+			glBindVertexBuffer(1, GetBindingBuffer(), GetBindingOffset(), sizeof(float) * 16);
 		}
 
 		void InstanceBuffer::Release()
@@ -621,6 +684,9 @@ namespace Graphics {
 
 		void MeshObject::Bind()
 		{
+			// the VAO sources the buffers' own storage
+			assert(!m_vtxBuffer->IsStreamed());
+			assert(!m_idxBuffer || !m_idxBuffer->IsStreamed());
 			glBindVertexArray(m_vao);
 		}
 
@@ -646,7 +712,7 @@ namespace Graphics {
 				// Enable the attribute at that location
 				glEnableVertexAttribArray(attrib);
 				// Tell OpenGL what the array contains
-				glVertexAttribFormat(attrib, get_num_components(attr.format), get_component_type(attr.format), is_attr_normalized(attr.semantic), attr.offset);
+				glVertexAttribFormat(attrib, get_num_components(attr.format), get_component_type(attr.format), is_attr_normalized(attr.semantic, attr.format), attr.offset);
 				// All vertex attribs will be sourced from the same buffer
 				glVertexAttribBinding(attrib, 0);
 			}
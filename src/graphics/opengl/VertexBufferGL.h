@@ -14,9 +14,11 @@ namespace Graphics {
 
 	namespace OGL {
 
+		class StreamBuffer;
+
 		class VertexBuffer : public Graphics::VertexBuffer, public GLBufferBase {
 		public:
-			VertexBuffer(const VertexBufferDesc &, size_t stateHash);
+			VertexBuffer(const VertexBufferDesc &, size_t stateHash, StreamBuffer *stream = nullptr, const void *data = nullptr);
 			~VertexBuffer();
 
 			virtual void Unmap() override;
@@ -25,6 +27,9 @@ namespace Graphics {
 			virtual bool Populate(const VertexArray &) override;
 
 			// change the buffer data without mapping
+			// dynamic buffers write it to the stream buffer, where it lasts
+			// until the end of the frame and can only be drawn with
+			// DrawBufferDynamic()
 			virtual void BufferData(const size_t, void *) override final;
 
 			virtual void Bind() override final;
@@ -36,17 +41,19 @@ namespace Graphics {
 			virtual Uint8 *MapInternal(BufferMapMode) override;
 			Uint8 *m_data;
 			size_t m_vertexStateHash;
+			StreamBuffer *m_stream;
 		};
 
+		// Vertex format for immediate geometry; the vertices of each Populate()
+		// call are written to a new subrange of the stream buffer
 		class CachedVertexBuffer : public VertexBuffer {
 		public:
-			CachedVertexBuffer(const VertexBufferDesc &, size_t stateHash);
+			CachedVertexBuffer(const VertexBufferDesc &, size_t stateHash, StreamBuffer *stream);
 
+			// returns false if the stream buffer is out of space for this frame
 			virtual bool Populate(const VertexArray &) override final;
-			uint32_t GetOffset() { return m_size * m_desc.stride; }
-
-			bool Flush();
-			void Reset();
+			// byte offset of the last populated vertices in the stream buffer
+			uint32_t GetOffset() const { return m_lastOffset; }
 
 		protected:
 			using VertexBuffer::BufferData;
@@ -54,12 +61,12 @@ namespace Graphics {
 			using VertexBuffer::Unmap;
 
 		private:
-			uint32_t m_lastFlushed;
+			uint32_t m_lastOffset;
 		};
 
 		class IndexBuffer : public Graphics::IndexBuffer, public GLBufferBase {
 		public:
-			IndexBuffer(Uint32 size, BufferUsage, IndexBufferSize);
+			IndexBuffer(Uint32 size, BufferUsage, IndexBufferSize, StreamBuffer *stream = nullptr, const void *data = nullptr);
 			~IndexBuffer();
 
 			virtual Uint32 *Map(BufferMapMode) override final;
@@ -67,6 +74,7 @@ namespace Graphics {
 			virtual void Unmap() override final;
 
 			// change the buffer data without mapping
+			// see VertexBuffer::BufferData for dynamic buffers
 			virtual void BufferData(const size_t, void *) override final;
 
 			virtual void Bind() override final;
@@ -75,16 +83,21 @@ namespace Graphics {
 		private:
 			Uint32 *m_data;
 			Uint16 *m_data16;
+			StreamBuffer *m_stream;
 		};
 
 		// Instance buffer
 		class InstanceBuffer final : public Graphics::InstanceBuffer, public GLBufferBase {
 		public:
-			InstanceBuffer(Uint32 size, BufferUsage);
+			InstanceBuffer(Uint32 size, BufferUsage, StreamBuffer *stream = nullptr);
 			virtual ~InstanceBuffer() override final;
 			virtual matrix4x4f *Map(BufferMapMode) override final;
 			virtual void Unmap() override final;
 
+			// Draw the given transforms from the stream buffer instead, until
+			// the end of the frame. Returns false if they don't fit.
+			bool Stream(const matrix4x4f *transforms, Uint32 count);
+
 			virtual void Bind() override final;
 			virtual void Release() override final;
 
@@ -98,6 +111,7 @@ namespace Graphics {
 		protected:
 			friend class MeshObject; // need access to InstOffs enum
 			std::unique_ptr<matrix4x4f[]> m_data;
+			StreamBuffer *m_stream;
 		};
 
 		class MeshObject final : public Graphics::MeshObject {
@@ -26,6 +26,7 @@
 #include "LuaTimer.h"
 #include "LuaVector.h"
 #include "LuaVector2.h"
+#include "LuaWorker.h"
 
 #include "Body.h"
 #include "SectorView.h"
@@ -120,6 +121,7 @@ namespace Lua {
 		LuaShipDef::Register();
 		LuaMusic::Register();
 		LuaDev::Register();
+		LuaWorker::Register();
 		// LuaConsole::Register();
 
 		// XXX sigh
@@ -142,6 +144,7 @@ namespace Lua {
 	void UninitModules()
 	{
 		LuaEvent::Uninit();
+		LuaWorker::Uninit();
 
 		delete Pi::luaNameGen;
 
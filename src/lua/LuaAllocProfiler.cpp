@@ -0,0 +1,304 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "LuaAllocProfiler.h"
+#include "FileSystem.h"
+#include "core/Log.h"
+
+#include "SDL_timer.h"
+
+#include <lua.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <unordered_map>
+
+bool LuaAllocProfiler::s_running = false;
+
+namespace {
+	// a line is its source and its number; allocations made with no Lua
+	// code running are counted against source 0, line -1
+	struct Key {
+		uintptr_t source;
+		int line;
+
+		bool operator==(const Key &other) const { return source == other.source && line == other.line; }
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key &key) const
+		{
+			return std::hash<uintptr_t>()(key.source) * 31 + size_t(key.line);
+		}
+	};
+
+	struct LineStats {
+		std::string function;
+		std::string source;
+		uintptr_t sourceKey = 0;
+		int line = 0;
+		int lineDefined = 0;
+		Uint64 numSamples = 0;
+		Uint64 allocBytes = 0;
+		Uint64 retainedBytes = 0;
+		// allocated in the current window and in the last full one
+		Uint64 windowBytes = 0;
+		Uint64 lastWindowBytes = 0;
+	};
+
+	// a sampled block still held, and the bytes it stands for
+	struct Block {
+		LineStats *line;
+		size_t weight;
+	};
+
+	// frames above the innermost Lua function that are looked at, C
+	// functions called from Lua are usually one or two deep
+	constexpr int MAX_LEVELS = 8;
+
+	lua_State *s_lua = nullptr;
+	size_t s_interval = LuaAllocProfiler::DEFAULT_INTERVAL;
+	size_t s_sinceSample = 0;
+
+	// the nodes of an unordered_map don't move, the blocks point into it
+	std::unordered_map<Key, LineStats, KeyHash> s_lines;
+	std::unordered_map<void *, Block> s_blocks;
+
+	Uint64 s_windowStart = 0;
+	double s_lastWindowSeconds = 1.0;
+
+	LineStats *FindLine()
+	{
+		lua_Debug ar;
+		for (int level = 0; level < MAX_LEVELS && lua_getstack(s_lua, level, &ar); level++) {
+			lua_getinfo(s_lua, "Sln", &ar);
+			if (ar.currentline < 0)
+				continue;
+
+			const Key key = { reinterpret_cast<uintptr_t>(ar.source), ar.currentline };
+			auto it = s_lines.find(key);
+			if (it != s_lines.end())
+				return &it->second;
+
+			LineStats &line = s_lines[key];
+			line.function = ar.name ? ar.name : (ar.what[0] == 'm' ? "main chunk" : "?");
+			line.source = ar.short_src;
+			line.sourceKey = key.source;
+			line.line = ar.currentline;
+			line.lineDefined = ar.linedefined;
+			return &line;
+		}
+
+		LineStats &line = s_lines[{ 0, -1 }];
+		if (line.source.empty()) {
+			line.function = "(no Lua code)";
+			line.source = "[C]";
+			line.line = -1;
+			line.lineDefined = -1;
+		}
+		return &line;
+	}
+
+	void RollWindow()
+	{
+		const Uint64 now = SDL_GetPerformanceCounter();
+		const double seconds = double(now - s_windowStart) / double(SDL_GetPerformanceFrequency());
+		if (seconds < 1.0)
+			return;
+
+		for (auto &it : s_lines) {
+			it.second.lastWindowBytes = it.second.windowBytes;
+			it.second.windowBytes = 0;
+		}
+		s_lastWindowSeconds = seconds;
+		s_windowStart = now;
+	}
+
+	LuaAllocProfiler::Summary MakeSummary(const LineStats &line)
+	{
+		return { line.function, line.source, line.line, line.numSamples, line.allocBytes, line.retainedBytes,
+			line.lastWindowBytes / s_lastWindowSeconds };
+	}
+
+	std::string CsvString(const std::string &str)
+	{
+		std::string out = "\"";
+		for (char c : str) {
+			if (c == '"')
+				out += '"';
+			out += c;
+		}
+		return out + "\"";
+	}
+
+	bool WriteCsv(const std::string &path, const std::vector<LuaAllocProfiler::Summary> &rows)
+	{
+		std::ofstream file(path);
+		file << "function,source,line,samples,alloc_bytes,retained_bytes,bytes_per_second\n";
+		for (const LuaAllocProfiler::Summary &row : rows) {
+			file << CsvString(row.function) << "," << CsvString(row.source) << "," << row.line << ","
+				 << row.numSamples << "," << row.allocBytes << "," << row.retainedBytes << ","
+				 << row.bytesPerSecond << "\n";
+		}
+		return bool(file);
+	}
+} // namespace
+
+// static
+void LuaAllocProfiler::Start(lua_State *l, size_t intervalBytes)
+{
+	if (s_running)
+		return;
+
+	s_lua = l;
+	s_interval = std::max<size_t>(intervalBytes, 1);
+	s_sinceSample = 0;
+	s_windowStart = SDL_GetPerformanceCounter();
+	s_running = true;
+}
+
+// static
+void LuaAllocProfiler::Stop()
+{
+	if (!s_running)
+		return;
+
+	// nothing sees the blocks being freed from now on
+	s_running = false;
+	s_lua = nullptr;
+	s_blocks.clear();
+	for (auto &it : s_lines)
+		it.second.retainedBytes = 0;
+}
+
+// static
+void LuaAllocProfiler::Reset()
+{
+	s_blocks.clear();
+	s_lines.clear();
+}
+
+// static
+bool LuaAllocProfiler::HasData()
+{
+	return !s_lines.empty();
+}
+
+// static
+void *LuaAllocProfiler::Realloc(void *ptr, size_t oldSize, size_t nsize)
+{
+	// the stack is walked before the block moves, it may be what's growing
+	LineStats *sampled = nullptr;
+	size_t weight = 0;
+	if (nsize > oldSize) {
+		s_sinceSample += nsize - oldSize;
+		if (s_sinceSample >= s_interval) {
+			weight = s_sinceSample;
+			s_sinceSample = 0;
+			sampled = FindLine();
+			RollWindow();
+			sampled->numSamples++;
+			sampled->allocBytes += weight;
+			sampled->windowBytes += weight;
+		}
+	}
+
+	Block block = { nullptr, 0 };
+	if (ptr) {
+		auto it = s_blocks.find(ptr);
+		if (it != s_blocks.end()) {
+			block = it->second;
+			s_blocks.erase(it);
+		}
+	}
+
+	if (nsize == 0) {
+		free(ptr);
+		if (block.line)
+			block.line->retainedBytes -= block.weight;
+		return nullptr;
+	}
+
+	void *newPtr = realloc(ptr, nsize);
+	if (!newPtr) {
+		// the old block is still there
+		if (block.line)
+			s_blocks[ptr] = block;
+		return nullptr;
+	}
+
+	// a block grown past the mark is counted against its newest sample
+	if (sampled) {
+		if (block.line)
+			block.line->retainedBytes -= block.weight;
+		block = { sampled, weight };
+		sampled->retainedBytes += weight;
+	}
+	if (block.line)
+		s_blocks[newPtr] = block;
+	return newPtr;
+}
+
+// static
+void LuaAllocProfiler::GetLines(std::vector<Summary> &out)
+{
+	if (s_running)
+		RollWindow();
+
+	out.clear();
+	out.reserve(s_lines.size());
+	for (const auto &it : s_lines)
+		out.push_back(MakeSummary(it.second));
+
+	std::sort(out.begin(), out.end(), [](const Summary &a, const Summary &b) {
+		return a.bytesPerSecond != b.bytesPerSecond ? a.bytesPerSecond > b.bytesPerSecond : a.allocBytes > b.allocBytes;
+	});
+}
+
+// static
+void LuaAllocProfiler::GetFunctions(std::vector<Summary> &out)
+{
+	if (s_running)
+		RollWindow();
+
+	std::unordered_map<Key, Summary, KeyHash> functions;
+	for (const auto &it : s_lines) {
+		const LineStats &line = it.second;
+		auto inserted = functions.emplace(Key{ line.sourceKey, line.lineDefined }, MakeSummary(line));
+		if (inserted.second) {
+			inserted.first->second.line = line.lineDefined;
+			continue;
+		}
+
+		Summary &function = inserted.first->second;
+		function.numSamples += line.numSamples;
+		function.allocBytes += line.allocBytes;
+		function.retainedBytes += line.retainedBytes;
+		function.bytesPerSecond += line.lastWindowBytes / s_lastWindowSeconds;
+	}
+
+	out.clear();
+	out.reserve(functions.size());
+	for (const auto &it : functions)
+		out.push_back(it.second);
+
+	std::sort(out.begin(), out.end(), [](const Summary &a, const Summary &b) {
+		return a.retainedBytes != b.retainedBytes ? a.retainedBytes > b.retainedBytes : a.allocBytes > b.allocBytes;
+	});
+}
+
+// static
+bool LuaAllocProfiler::Dump(const std::string &dir)
+{
+	std::vector<Summary> rows;
+	GetLines(rows);
+	if (!WriteCsv(FileSystem::JoinPath(dir, "lua_alloc_lines.csv"), rows)) {
+		Log::Warning("LuaAllocProfiler: couldn't write the profile to {}", dir);
+		return false;
+	}
+
+	GetFunctions(rows);
+	return WriteCsv(FileSystem::JoinPath(dir, "lua_alloc_functions.csv"), rows);
+}
@@ -0,0 +1,68 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUAALLOCPROFILER_H
+#define _LUAALLOCPROFILER_H
+
+#include "SDL_stdinc.h"
+
+#include <string>
+#include <vector>
+
+struct lua_State;
+
+// Finds the Lua code that allocates the most, and holds on to the most, to
+// tell what drives the garbage collector.
+//
+// While running, the allocator of LuaManager hands the Lua heap to Realloc.
+// Once every interval bytes allocated, the allocation that crosses the mark
+// is sampled: the innermost Lua line running is looked up and the sample
+// stands for all the bytes since the last one. Sampled blocks are followed
+// until they are freed, to estimate the memory each line still holds.
+//
+// Unlike LuaProfiler no hooks are set, so the cost is a counter on every
+// allocation and a lookup on every free. Only the stack of the main thread
+// can be walked from the allocator: what coroutines allocate counts against
+// the line that resumed them.
+class LuaAllocProfiler {
+public:
+	struct Summary {
+		std::string function;
+		std::string source;
+		// the line of a sampled line, or the line a function is defined on
+		int line;
+		Uint64 numSamples;
+		// estimated from the samples
+		Uint64 allocBytes;
+		Uint64 retainedBytes;
+		// allocated in the last full second
+		double bytesPerSecond;
+	};
+
+	static constexpr size_t DEFAULT_INTERVAL = 16 * 1024;
+
+	static void Start(lua_State *l, size_t intervalBytes = DEFAULT_INTERVAL);
+	// keeps what was allocated; what is retained is only known while running
+	static void Stop();
+	static bool IsRunning() { return s_running; }
+
+	// forget everything recorded so far, including the blocks still held
+	static void Reset();
+	static bool HasData();
+
+	// the lines sampled so far, most allocated in the last second first
+	static void GetLines(std::vector<Summary> &out);
+	// the same by function, most retained first
+	static void GetFunctions(std::vector<Summary> &out);
+
+	// write lua_alloc_lines.csv and lua_alloc_functions.csv to the given directory
+	static bool Dump(const std::string &dir);
+
+	// like realloc(), and free() when nsize is 0; oldSize is 0 for a new block
+	static void *Realloc(void *ptr, size_t oldSize, size_t nsize);
+
+private:
+	static bool s_running;
+};
+
+#endif
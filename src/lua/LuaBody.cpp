@@ -226,12 +226,15 @@ static int l_body_set_component(lua_State *l)
  *
  * Get the body's velocity relative to another body as a Vector
  *
- * > body:GetVelocityRelTo(otherBody)
+ * > body:GetVelocityRelTo(otherBody, out)
  *
  * Parameters:
  *
  *   other - the other body
  *
+ *   out - optional. A Vector to store the result in and return, instead of
+ *         creating a new one
+ *
  * Availability:
  *
  *   2017-04
@@ -245,7 +248,7 @@ static int l_body_get_velocity_rel_to(lua_State *l)
 	Body *b = LuaObject<Body>::CheckFromLua(1);
 	const Body *other = LuaObject<Body>::CheckFromLua(2);
 	vector3d velocity = b->GetVelocityRelTo(other);
-	LuaPush(l, velocity);
+	LuaVector::PushToLua(l, velocity, 3);
 	return 1;
 }
 
@@ -359,12 +362,15 @@ static int l_body_is_more_important_than(lua_State *l)
  *
  * Get the body's position relative to another body as a Vector
  *
- * > body:GetPositionRelTo(otherBody)
+ * > body:GetPositionRelTo(otherBody, out)
  *
  * Parameters:
  *
  *   other - the other body
  *
+ *   out - optional. A Vector to store the result in and return, instead of
+ *         creating a new one
+ *
  * Availability:
  *
  *   2017-04
@@ -377,8 +383,8 @@ static int l_body_get_position_rel_to(lua_State *l)
 {
 	Body *b = LuaObject<Body>::CheckFromLua(1);
 	const Body *other = LuaObject<Body>::CheckFromLua(2);
-	vector3d velocity = b->GetPositionRelTo(other);
-	LuaPush<vector3d>(l, velocity);
+	vector3d position = b->GetPositionRelTo(other);
+	LuaVector::PushToLua(l, position, 3);
 	return 1;
 }
 
@@ -5,7 +5,12 @@
 #include "Game.h"
 #include "LuaObject.h"
 #include "Pi.h"
+#include "Planet.h"
+#include "Player.h"
 #include "WorldView.h"
+#include "profiler/Profiler.h"
+#include <fmt/format.h>
+#include <functional>
 #include <sstream>
 
 /*
@@ -251,6 +256,68 @@ static int l_dev_set_camera_offset(lua_State *l)
 	return 0;
 }
 
+/*
+ * Method: BenchmarkBindings
+ *
+ * Time the common steps of calling a Body or Ship binding with the player,
+ * and return the time each takes. Start the game before using!
+ *
+ * > print(require 'Dev'.BenchmarkBindings(100000))
+ *
+ * Parameters:
+ *   iterations - integer, optional, number of times each step is run
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_dev_benchmark_bindings(lua_State *l)
+{
+	if (!Pi::game || !Pi::player)
+		return luaL_error(l, "Dev.BenchmarkBindings only works when there is a game running");
+	const int iterations = std::max(1, int(luaL_optinteger(l, 1, 100000)));
+
+	std::string result;
+	Profiler::Clock clock;
+	auto run = [&](const char *name, const std::function<void()> &step) {
+		clock.Reset();
+		clock.Start();
+		for (int i = 0; i < iterations; i++)
+			step();
+		clock.Stop();
+		result += fmt::format("{:<28} {:8.1f} ns\n", name, clock.milliseconds() * 1e6 / iterations);
+	};
+
+	run("PushToLua(Ship)", [&]() {
+		LuaObject<Ship>::PushToLua(Pi::player);
+		lua_pop(l, 1);
+	});
+
+	LuaObject<Ship>::PushToLua(Pi::player);
+	const int idx = lua_gettop(l);
+	run("CheckFromLua<Ship>", [&]() { LuaObject<Ship>::CheckFromLua(idx); });
+	run("CheckFromLua<Body>", [&]() { LuaObject<Body>::CheckFromLua(idx); });
+	run("GetFromLua<Planet>", [&]() { LuaObject<Planet>::GetFromLua(idx); });
+
+	for (const char *method : { "GetPositionRelTo", "GetVelocityRelTo" }) {
+		run(fmt::format("Body:{}", method).c_str(), [&]() {
+			lua_getfield(l, idx, method);
+			lua_pushvalue(l, idx);
+			lua_pushvalue(l, idx);
+			lua_call(l, 2, 1);
+			lua_pop(l, 1);
+		});
+	}
+	lua_pop(l, 1);
+
+	LuaPush<std::string>(l, result);
+	return 1;
+}
+
 void LuaDev::Register()
 {
 	lua_State *l = Lua::manager->GetLuaState();
@@ -260,6 +327,7 @@ void LuaDev::Register()
 	static const luaL_Reg methods[] = {
 		{ "GalaxyStats", l_dev_galaxy_stats },
 		{ "SetCameraOffset", l_dev_set_camera_offset },
+		{ "BenchmarkBindings", l_dev_benchmark_bindings },
 		{ 0, 0 }
 	};
 
@@ -6,6 +6,8 @@
 #include "LuaObject.h"
 #include "LuaUtils.h"
 #include "galaxy/Economy.h"
+#include "galaxy/MarketTable.h"
+#include "galaxy/StarSystem.h"
 
 #include "LuaEconomy.h"
 
@@ -99,6 +101,38 @@ static int l_economy_get_economy_by_id(lua_State *l)
 	return 1;
 }
 
+// Economy.GetMarkets({ system, ... }) -> { { [commodity name] = { price, stock, demand } }, ... }
+// Works out the markets of all the given systems in one go
+static int l_economy_get_markets(lua_State *l)
+{
+	luaL_checktype(l, 1, LUA_TTABLE);
+	const size_t numSystems = lua_rawlen(l, 1);
+
+	GalacticEconomy::MarketTable markets;
+	markets.Reserve(numSystems);
+	for (size_t i = 1; i <= numSystems; i++) {
+		lua_rawgeti(l, 1, i);
+		markets.AddMarket(LuaObject<StarSystem>::CheckFromLua(-1));
+		lua_pop(l, 1);
+	}
+	markets.Update();
+
+	lua_createtable(l, numSystems, 0);
+	for (size_t market = 0; market < numSystems; market++) {
+		lua_createtable(l, 0, GalacticEconomy::Commodities().size());
+		for (const auto &commodity : GalacticEconomy::Commodities()) {
+			lua_createtable(l, 0, 3);
+			pi_lua_settable(l, "price", markets.GetPrice(commodity.id, market));
+			pi_lua_settable(l, "stock", markets.GetStock(commodity.id, market));
+			pi_lua_settable(l, "demand", markets.GetDemand(commodity.id, market));
+			lua_setfield(l, -2, commodity.name);
+		}
+		lua_rawseti(l, -2, market + 1);
+	}
+
+	return 1;
+}
+
 void LuaEconomy::Register()
 {
 	lua_State *l = Lua::manager->GetLuaState();
@@ -111,6 +145,7 @@ void LuaEconomy::Register()
 		.AddFunction("GetCommodityById", l_economy_get_commodity_by_id)
 		.AddFunction("GetEconomies", l_economy_get_economies)
 		.AddFunction("GetEconomyById", l_economy_get_economy_by_id)
+		.AddFunction("GetMarkets", l_economy_get_markets)
 		.StopRecording();
 
 	lua_getfield(l, LUA_REGISTRYINDEX, "CoreImports");
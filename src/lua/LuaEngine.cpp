@@ -12,11 +12,13 @@
 #include "Lang.h"
 #include "LuaColor.h"
 #include "LuaConstants.h"
+#include "LuaEvent.h"
 #include "LuaObject.h"
 #include "LuaPiGuiInternal.h"
 #include "LuaUtils.h"
 #include "LuaVector.h"
 #include "LuaVector2.h"
+#include "ModelCache.h"
 #include "Pi.h"
 #include "Player.h"
 #include "Random.h"
@@ -1025,6 +1027,8 @@ static int l_engine_get_model(lua_State *l)
 {
 	const std::string name(luaL_checkstring(l, 1));
 	SceneGraph::Model *model = Pi::FindModel(name);
+	// Lua may hold on to the model for as long as it likes
+	Pi::modelCache->PinModel(model);
 	LuaObject<SceneGraph::Model>::PushToLua(model);
 	return 1;
 }
@@ -1040,6 +1044,77 @@ static int l_engine_request_profile_frame(lua_State *l)
 	return 0;
 }
 
+/*
+ * Function: RequestProfileCapture
+ *
+ * Capture a trace of the next few frames, with the zones of every thread,
+ * job lifetimes and GPU timer scopes, and write it to the profiler directory
+ * as a Chrome trace. Does nothing in builds without the profiler.
+ *
+ * > Engine.RequestProfileCapture(frames, path)
+ *
+ * Parameters:
+ *
+ *   frames - the number of frames to capture
+ *
+ *   path - optional, a directory below the profiler directory to write to
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_request_profile_capture(lua_State *l)
+{
+	const int frames = luaL_checkinteger(l, 1);
+	Pi::GetApp()->RequestProfileCapture(frames, luaL_optstring(l, 2, ""));
+	return 0;
+}
+
+/*
+ * Function: GetEventStats
+ *
+ * Returns statistics about the events queued from the engine.
+ *
+ * > stats = Engine.GetEventStats()
+ *
+ * Return:
+ *
+ *   stats - an array of tables, one per event name, with the fields
+ *           name, registered (number of handlers registered), queued
+ *           (events passed to Lua) and dropped (events discarded because
+ *           no handler was ever registered)
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_get_event_stats(lua_State *l)
+{
+	std::vector<LuaEvent::EventStats> stats;
+	LuaEvent::GetEventStats(stats);
+
+	LuaTable out(l, stats.size(), 0);
+	for (const auto &event : stats) {
+		LuaTable t(l, 0, 4);
+		t.Set("name", event.name);
+		t.Set("registered", event.numRegistered);
+		t.Set("queued", double(event.numQueued));
+		t.Set("dropped", double(event.numDropped));
+		out.PushBack(t);
+		lua_pop(l, 1);
+	}
+
+	return 1;
+}
+
 static int l_get_can_browse_user_folders(lua_State *l)
 {
 	lua_pushboolean(l, OS::SupportsFolderBrowser());
@@ -1146,6 +1221,8 @@ void LuaEngine::Register()
 		{ "GetEnumValue", l_engine_get_enum_value },
 
 		{ "RequestProfileFrame", l_engine_request_profile_frame },
+		{ "RequestProfileCapture", l_engine_request_profile_capture },
+		{ "GetEventStats", l_engine_get_event_stats },
 		{ 0, 0 }
 	};
 
@@ -7,11 +7,115 @@
 #include "LuaUtils.h"
 
 #include "core/Log.h"
+#include "profiler/Profiler.h"
+
+#include <map>
 
 namespace LuaEvent {
 
+	namespace detail {
+		struct EventInfo {
+			std::string name;
+			uint32_t numRegistered = 0;
+			uint64_t numQueued = 0;
+			uint64_t numDropped = 0;
+		};
+	} // namespace detail
+
+	using detail::EventInfo;
+	using detail::PendingEvent;
+
 	static LuaRef s_eventTable;
 
+	// true once Event.Register has been wrapped, so handler registrations can
+	// be counted; until then no events are dropped
+	static bool s_trackHandlers = false;
+
+	static std::map<std::string, EventInfo, std::less<>> s_eventInfo;
+
+	static constexpr size_t MAX_PENDING_EVENTS = 512;
+	static PendingEvent s_pending[MAX_PENDING_EVENTS];
+	static size_t s_numPending = 0;
+
+	static EventInfo &_get_event_info(std::string_view name)
+	{
+		auto iter = s_eventInfo.find(name);
+		if (iter == s_eventInfo.end()) {
+			iter = s_eventInfo.emplace(std::string(name), EventInfo()).first;
+			iter->second.name = iter->first;
+		}
+		return iter->second;
+	}
+
+	static void _drop_pending()
+	{
+		for (size_t i = 0; i < s_numPending; i++)
+			s_pending[i].destroyArgs(s_pending[i].args);
+		s_numPending = 0;
+	}
+
+	// Event.Register(name, callback)
+	// Count the handler against the event name and forward to the original
+	// implementation, held as the first upvalue.
+	static int l_register_hook(lua_State *l)
+	{
+		const int nameIdx = lua_istable(l, 1) ? 2 : 1;
+		if (lua_type(l, nameIdx) == LUA_TSTRING) {
+			size_t len;
+			const char *name = lua_tolstring(l, nameIdx, &len);
+			_get_event_info(std::string_view(name, len)).numRegistered++;
+		}
+
+		const int nargs = lua_gettop(l);
+		lua_pushvalue(l, lua_upvalueindex(1));
+		lua_insert(l, 1);
+		lua_call(l, nargs, LUA_MULTRET);
+		return lua_gettop(l);
+	}
+
+	static void _install_register_hook(lua_State *l)
+	{
+		LUA_DEBUG_START(l);
+		s_eventTable.PushCopyToStack();
+
+		lua_getfield(l, -1, "Register");
+		if (!lua_isfunction(l, -1)) {
+			Log::Warning("Lua Event queue has no Register function, all events will be queued\n");
+			lua_pop(l, 2);
+			LUA_DEBUG_END(l, 0);
+			return;
+		}
+
+		lua_pushcclosure(l, l_register_hook, 1);
+		lua_setfield(l, -2, "Register");
+		lua_pop(l, 1);
+		LUA_DEBUG_END(l, 0);
+
+		s_trackHandlers = true;
+	}
+
+	EventInfo *detail::CheckQueue(std::string_view event)
+	{
+		EventInfo &info = _get_event_info(event);
+		if (s_trackHandlers && !info.numRegistered) {
+			info.numDropped++;
+			return nullptr;
+		}
+
+		info.numQueued++;
+		return &info;
+	}
+
+	PendingEvent *detail::AllocPending(EventInfo *info)
+	{
+		if (s_numPending == MAX_PENDING_EVENTS)
+			Flush();
+
+		PendingEvent *pending = &s_pending[s_numPending++];
+		pending->info = info;
+		return pending;
+	}
+
 	static bool _get_method_onto_stack(lua_State *l, const char *method)
 	{
 		LUA_DEBUG_START(l);
@@ -45,15 +149,25 @@ namespace LuaEvent {
 		s_eventTable = LuaRef(l, -1);
 
 		lua_pop(l, 1);
+
+		_install_register_hook(l);
 	}
 
 	void Uninit()
 	{
+		_drop_pending();
 		s_eventTable.Unref();
+		s_trackHandlers = false;
+
+		// handler registrations don't survive the Lua state
+		for (auto &pair : s_eventInfo)
+			pair.second.numRegistered = 0;
 	}
 
 	void Clear()
 	{
+		_drop_pending();
+
 		lua_State *l = Lua::manager->GetLuaState();
 
 		LUA_DEBUG_START(l);
@@ -62,8 +176,40 @@ namespace LuaEvent {
 		LUA_DEBUG_END(l, 0);
 	}
 
+	void Flush()
+	{
+		if (!s_numPending)
+			return;
+
+		PROFILE_SCOPED()
+		if (!s_eventTable.IsValid()) {
+			_drop_pending();
+			return;
+		}
+
+		lua_State *l = Lua::manager->GetLuaState();
+		LUA_DEBUG_START(l);
+
+		ScopedTable queue(s_eventTable);
+		for (size_t i = 0; i < s_numPending; i++) {
+			PendingEvent &pending = s_pending[i];
+
+			ScopedTable ev(l);
+			ev.Set("name", pending.info->name);
+			pending.pushArgs(ev, pending.args);
+			pending.destroyArgs(pending.args);
+
+			queue.PushBack(ev);
+		}
+		s_numPending = 0;
+
+		LUA_DEBUG_END(l, 0);
+	}
+
 	void Emit()
 	{
+		Flush();
+
 		lua_State *l = Lua::manager->GetLuaState();
 
 		LUA_DEBUG_START(l);
@@ -77,4 +223,12 @@ namespace LuaEvent {
 		return s_eventTable;
 	}
 
+	void GetEventStats(std::vector<EventStats> &out)
+	{
+		out.clear();
+		out.reserve(s_eventInfo.size());
+		for (const auto &pair : s_eventInfo)
+			out.push_back({ pair.first, pair.second.numRegistered, pair.second.numQueued, pair.second.numDropped });
+	}
+
 } // namespace LuaEvent
@@ -8,7 +8,25 @@
 #include "LuaObject.h"
 #include "LuaPushPull.h"
 #include "LuaTable.h"
+#include "RefCounted.h"
 
+#include <cstddef>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// Events queued to the global event queue with LuaEvent::Queue(name, ...) are
+// not handed to Lua straight away. Events which no script has ever registered
+// a handler for are dropped immediately; the others are stored with their
+// arguments in a fixed-size C++ buffer, and the Lua event tables are only
+// created when the buffer is flushed by Emit (or Flush).
+//
+// Pointer arguments must remain valid until the next Flush. Space flushes the
+// queue before deleting bodies; RefCounted arguments are kept alive by the
+// queue and string arguments are copied.
 namespace LuaEvent {
 
 	void Init();
@@ -17,8 +35,88 @@ namespace LuaEvent {
 	void Clear();
 	void Emit();
 
+	// Create the Lua values for all pending events and add them to the Lua
+	// event queue, without emitting them.
+	void Flush();
+
 	LuaRef &GetEventQueue();
 
+	struct EventStats {
+		std::string name;
+		// number of times a handler was registered for this event
+		uint32_t numRegistered;
+		// number of events passed on to Lua
+		uint64_t numQueued;
+		// number of events dropped because nothing handles them
+		uint64_t numDropped;
+	};
+
+	// Fill out the statistics for all events seen so far, sorted by name
+	void GetEventStats(std::vector<EventStats> &out);
+
+	namespace detail {
+		struct EventInfo;
+
+		// Returns the event description, or nullptr if events with this
+		// name should be dropped
+		EventInfo *CheckQueue(std::string_view event);
+
+		static constexpr size_t MAX_PENDING_ARGS_SIZE = 64;
+
+		struct PendingEvent {
+			EventInfo *info;
+			void (*pushArgs)(LuaTable &ev, void *args);
+			void (*destroyArgs)(void *args);
+			alignas(std::max_align_t) unsigned char args[MAX_PENDING_ARGS_SIZE];
+		};
+
+		// Returns a free slot at the end of the pending event buffer, flushing
+		// the buffer to Lua first if it is full
+		PendingEvent *AllocPending(EventInfo *info);
+
+		// Arguments are stored by value: strings are copied and RefCounted
+		// objects are referenced so they outlive the call to Queue
+		template <typename T, typename = void>
+		struct Stored {
+			using type = std::decay_t<T>;
+		};
+
+		template <>
+		struct Stored<const char *> {
+			using type = std::string;
+		};
+
+		template <>
+		struct Stored<char *> {
+			using type = std::string;
+		};
+
+		template <>
+		struct Stored<std::string_view> {
+			using type = std::string;
+		};
+
+		template <typename T>
+		struct Stored<T *, std::enable_if_t<std::is_base_of_v<RefCounted, T>>> {
+			using type = RefCountedPtr<T>;
+		};
+
+		template <typename T>
+		using stored_t = typename Stored<std::decay_t<T>>::type;
+
+		template <typename Args>
+		void PushArgs(LuaTable &ev, void *args)
+		{
+			std::apply([&ev](auto &...values) { ev.PushMultiple(values...); }, *static_cast<Args *>(args));
+		}
+
+		template <typename Args>
+		void DestroyArgs(void *args)
+		{
+			static_cast<Args *>(args)->~Args();
+		}
+	} // namespace detail
+
 	// Push an event to the specified event queue, passed as a LuaRef &
 	template <typename... TArgs>
 	inline void Queue(const LuaRef &queue, std::string_view event, TArgs... args)
@@ -39,17 +137,39 @@ namespace LuaEvent {
 		ScopedTable(queue).PushBack(ev);
 	}
 
-	// Push an event to the specified event queue, passed as a LuaRef &
+	// Push an event to the global event queue
 	template <typename... TArgs>
 	inline void Queue(std::string_view event, TArgs... args)
 	{
-		Queue(GetEventQueue(), event, args...);
+		detail::EventInfo *info = detail::CheckQueue(event);
+		if (!info)
+			return;
+
+		using Args = std::tuple<detail::stored_t<TArgs>...>;
+		if constexpr (sizeof(Args) <= detail::MAX_PENDING_ARGS_SIZE && alignof(Args) <= alignof(std::max_align_t)) {
+			detail::PendingEvent *pending = detail::AllocPending(info);
+			new (pending->args) Args(args...);
+			pending->pushArgs = &detail::PushArgs<Args>;
+			pending->destroyArgs = &detail::DestroyArgs<Args>;
+		} else {
+			// too large to store, keep the queue in order and push directly
+			Flush();
+			Queue(GetEventQueue(), event, args...);
+		}
 	}
 
-	// Push an event to the specified event queue, passed as a LuaRef &
+	// Push an event to the global event queue
 	inline void Queue(std::string_view event)
 	{
-		Queue(GetEventQueue(), event);
+		detail::EventInfo *info = detail::CheckQueue(event);
+		if (!info)
+			return;
+
+		using Args = std::tuple<>;
+		detail::PendingEvent *pending = detail::AllocPending(info);
+		new (pending->args) Args();
+		pending->pushArgs = &detail::PushArgs<Args>;
+		pending->destroyArgs = &detail::DestroyArgs<Args>;
 	}
 
 } // namespace LuaEvent
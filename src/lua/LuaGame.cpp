@@ -97,7 +97,8 @@ static int l_game_savegame_stats(lua_State *l)
 	const std::string filename = LuaPull<std::string>(l, 1);
 
 	try {
-		Json rootNode = Game::LoadGameToJson(filename);
+		// only reads the header, unless it's an older save
+		Json rootNode = Game::LoadGameSummary(filename);
 
 		LuaTable t(l, 0, 3);
 
@@ -233,13 +234,18 @@ static int l_game_can_load_game(lua_State *l)
  *
  * Save the current game.
  *
- * > path = Game.SaveGame(filename)
+ * > path = Game.SaveGame(filename, background)
  *
  * Parameters:
  *
  *   filename - Filename to save to. The file will be placed the 'savefiles'
  *              directory in the user's game directory.
  *
+ *   background - optional. If true, only the snapshot of the game is taken
+ *                before returning, and the save is written on a worker
+ *                thread; a failure to write it is only logged. Meant for
+ *                autosaves and quicksaves.
+ *
  * Return:
  *
  *   path - the full path to the saved file (so it can be displayed)
@@ -259,11 +265,15 @@ static int l_game_save_game(lua_State *l)
 	}
 
 	const std::string filename(luaL_checkstring(l, 1));
+	const bool background = lua_toboolean(l, 2);
 	std::string path;
 
 	try {
 		path = FileSystem::JoinPathBelow(Pi::GetSaveDir(), filename);
-		Game::SaveGame(filename, Pi::game);
+		if (background)
+			Game::SaveGameInBackground(filename, Pi::game);
+		else
+			Game::SaveGame(filename, Pi::game);
 		lua_pushlstring(l, path.c_str(), path.size());
 		return 1;
 	} catch (const CannotSaveInHyperspace &) {
@@ -68,11 +68,12 @@ static int l_lang_get_resource(lua_State *l)
 	lua_newtable(l);
 	Lang::Resource &res = Lang::GetResource(resourceName, langCode);
 	if (res.Load()) {
-		for (auto i : res.GetStrings()) {
-			const std::string token(i.first);
-			const std::string text(i.second.empty() ? token : i.second);
-			lua_pushlstring(l, text.c_str(), text.size());
-			lua_setfield(l, -2, token.c_str());
+		for (Uint32 i = 0; i < res.GetNumStrings(); i++) {
+			// both are NUL-terminated in the string table
+			const std::string_view token = res.GetToken(i);
+			const std::string_view text = res.GetText(i).empty() ? token : res.GetText(i);
+			lua_pushlstring(l, text.data(), text.size());
+			lua_setfield(l, -2, token.data());
 		}
 	} else {
 		Log::Warning("Translation module {0} not found! This should be in data/lang/{0}/{1}.json. Returning dummy resource.\n",
@@ -3,21 +3,67 @@
 
 #include "LuaManager.h"
 #include "FileSystem.h"
+#include "LuaAllocProfiler.h"
+#include "MathUtil.h"
+#include "core/MemoryTag.h"
+#include "profiler/Profiler.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cstdlib>
 
+// the collector's pause is kept between these, in percent of the memory in
+// use after a cycle
+static constexpr int MIN_GC_PAUSE = 110;
+static constexpr int MAX_GC_PAUSE = 200;
+static constexpr int GC_PAUSE_STEP = 10;
+// steps are sized to collect this many times as fast as Lua allocates
+static constexpr size_t GC_STEP_RATE = 2;
+static constexpr int MIN_GC_STEP_KB = 8;
+static constexpr int MAX_GC_STEP_KB = 1024;
+// a cycle still running when memory has grown this many times over the
+// threshold is finished at once
+static constexpr size_t GC_FORCE_FACTOR = 2;
+
 bool instantiated = false;
 
+// the allocator luaL_newstate() would use, counting the heap as MemoryTag::LUA
+// and handing it to LuaAllocProfiler while that is sampling
+static void *TaggedAlloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	// without a block, osize is the type of object being allocated
+	const size_t oldSize = ptr ? osize : 0;
+	void *block = nullptr;
+	if (LuaAllocProfiler::IsRunning())
+		block = LuaAllocProfiler::Realloc(ptr, oldSize, nsize);
+	else if (nsize == 0)
+		free(ptr);
+	else
+		block = realloc(ptr, nsize);
+
+	// a failed realloc leaves the old block as it was
+	if (nsize && !block)
+		return nullptr;
+	if (oldSize)
+		MemoryTag::Free(MemoryTag::LUA, oldSize);
+	if (nsize)
+		MemoryTag::Allocate(MemoryTag::LUA, nsize);
+	return block;
+}
+
 LuaManager::LuaManager() :
-	m_lua(0)
+	m_lua(0),
+	m_manualGC(false),
+	m_inCycle(false),
+	m_cycleThreshold(0),
+	m_lastMemory(0)
 {
 	if (instantiated) {
 		Output("Can't instantiate more than one LuaManager");
 		abort();
 	}
 
-	m_lua = luaL_newstate();
+	m_lua = lua_newstate(&TaggedAlloc, nullptr);
 	pi_lua_open_standard_base(m_lua);
 	lua_atpanic(m_lua, pi_lua_panic);
 
@@ -35,6 +81,7 @@ LuaManager::LuaManager() :
 
 LuaManager::~LuaManager()
 {
+	LuaAllocProfiler::Stop();
 	lua_close(m_lua);
 
 	instantiated = false;
@@ -50,4 +97,80 @@ size_t LuaManager::GetMemoryUsage() const
 void LuaManager::CollectGarbage()
 {
 	lua_gc(m_lua, LUA_GCCOLLECT, 0);
+
+	// a full collection finishes the cycle in progress
+	m_inCycle = false;
+	m_lastMemory = GetMemoryUsage();
+	m_cycleThreshold = m_lastMemory * m_gcStats.pause / 100;
+}
+
+void LuaManager::SetManualGC(bool manual)
+{
+	if (manual == m_manualGC)
+		return;
+
+	m_manualGC = manual;
+	if (!manual) {
+		lua_gc(m_lua, LUA_GCRESTART, 0);
+		return;
+	}
+
+	lua_gc(m_lua, LUA_GCSTOP, 0);
+	m_gcStats.pause = MAX_GC_PAUSE;
+	m_gcStats.stepKB = MIN_GC_STEP_KB;
+	m_inCycle = false;
+	m_lastMemory = GetMemoryUsage();
+	m_cycleThreshold = m_lastMemory * m_gcStats.pause / 100;
+}
+
+void LuaManager::StepGarbageCollector(double budgetMs)
+{
+	m_gcStats.lastStepMs = 0.0;
+	m_gcStats.lastNumSteps = 0;
+	if (!m_manualGC)
+		return;
+
+	const size_t memory = GetMemoryUsage();
+	const size_t allocated = memory > m_lastMemory ? memory - m_lastMemory : 0;
+	m_lastMemory = memory;
+
+	if (!m_inCycle) {
+		if (memory < m_cycleThreshold)
+			return;
+		m_inCycle = true;
+	}
+
+	PROFILE_SCOPED()
+	Profiler::Clock clock;
+	clock.Start();
+
+	m_gcStats.stepKB = Clamp(int(allocated * GC_STEP_RATE / 1024), MIN_GC_STEP_KB, MAX_GC_STEP_KB);
+	const bool force = memory > m_cycleThreshold * GC_FORCE_FACTOR;
+
+	// at least one step, so a frame over budget still makes progress
+	bool finished = false;
+	do {
+		finished = lua_gc(m_lua, LUA_GCSTEP, m_gcStats.stepKB);
+		m_gcStats.lastNumSteps++;
+		clock.SoftStop();
+	} while (!finished && (force || clock.milliseconds() < budgetMs));
+
+	m_gcStats.lastStepMs = clock.milliseconds();
+
+	if (finished) {
+		m_inCycle = false;
+		m_gcStats.numCycles++;
+
+		// collect more often when the collector couldn't keep up, less
+		// often again when it could
+		if (force) {
+			m_gcStats.numForcedCycles++;
+			m_gcStats.pause = std::max(m_gcStats.pause - GC_PAUSE_STEP * 2, MIN_GC_PAUSE);
+		} else {
+			m_gcStats.pause = std::min(m_gcStats.pause + GC_PAUSE_STEP, MAX_GC_PAUSE);
+		}
+
+		m_lastMemory = GetMemoryUsage();
+		m_cycleThreshold = m_lastMemory * m_gcStats.pause / 100;
+	}
 }
@@ -6,6 +6,8 @@
 
 #include "LuaUtils.h"
 
+#include <cstdint>
+
 class LuaManager {
 public:
 	LuaManager();
@@ -15,11 +17,42 @@ public:
 	size_t GetMemoryUsage() const;
 	void CollectGarbage();
 
+	struct GCStats {
+		// time spent collecting and steps run by the last StepGarbageCollector
+		double lastStepMs = 0.0;
+		uint32_t lastNumSteps = 0;
+		uint64_t numCycles = 0;
+		// cycles that had to be finished regardless of the time budget
+		uint64_t numForcedCycles = 0;
+		// memory growth that starts the next cycle, in percent
+		int pause = 0;
+		int stepKB = 0;
+	};
+
+	// Stop the automatic collector: garbage is then only collected by
+	// StepGarbageCollector and CollectGarbage
+	void SetManualGC(bool manual);
+	bool IsManualGC() const { return m_manualGC; }
+
+	// Run incremental collection steps for about budgetMs milliseconds.
+	// A cycle only starts once memory has grown by the pause since the last
+	// one. The step size follows the allocation rate, and if allocation
+	// outruns the collector, the cycle is finished regardless of the budget.
+	void StepGarbageCollector(double budgetMs);
+	const GCStats &GetGCStats() const { return m_gcStats; }
+
 private:
 	LuaManager(const LuaManager &);
 	LuaManager &operator=(const LuaManager &) = delete;
 
 	lua_State *m_lua;
+
+	bool m_manualGC;
+	bool m_inCycle;
+	// memory use that starts the next cycle
+	size_t m_cycleThreshold;
+	size_t m_lastMemory;
+	GCStats m_gcStats;
 };
 
 #endif
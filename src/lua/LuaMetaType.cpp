@@ -115,7 +115,7 @@ static int l_index(lua_State *l)
 	if (lua_isstring(l, 2)) {
 		PropertyMap *map = LuaObjectBase::GetPropertiesFromObject(l, 1);
 		if (map) {
-			auto &prop = map->Get(LuaPull<std::string_view>(l, 2));
+			auto &prop = map->Get(LuaPull<StringName>(l, 2));
 			if (!prop.is_null()) {
 				LuaPush(l, prop);
 				return 1;
@@ -179,7 +179,7 @@ static int l_newindex(lua_State *l)
 	if (lua_isstring(l, 2)) {
 		PropertyMap *map = LuaObjectBase::GetPropertiesFromObject(l, 1);
 		if (map) {
-			auto key = LuaPull<std::string_view>(l, 2);
+			auto key = LuaPull<StringName>(l, 2);
 
 			if (!map->Get(key).is_null()) {
 				map->Set(key, LuaPull<Property>(l, 3));
@@ -402,11 +402,11 @@ void *LuaMetaTypeBase::TestUserdata(lua_State *l, int index, const char *type)
 {
 	void *p = lua_touserdata(l, index);
 	if (p != nullptr && lua_getmetatable(l, index)) {
-		if (GetMetatableFromName(l, type) && lua_rawequal(l, -1, -2)) {
-			lua_pop(l, 2);
+		const bool found = GetMetatableFromName(l, type);
+		const bool match = found && lua_rawequal(l, -1, -2);
+		lua_pop(l, found ? 2 : 1);
+		if (match)
 			return p;
-		}
-		lua_pop(l, 1);
 	}
 	return nullptr;
 }
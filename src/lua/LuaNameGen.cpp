@@ -11,12 +11,25 @@ static const std::string DEFAULT_FULL_NAME_FEMALE("Thomasina Mortonella");
 static const std::string DEFAULT_SURNAME("Jameson");
 static const std::string DEFAULT_BODY_NAME("Planet Rock");
 
+// emptied once full, the names can always be made again
+static const size_t MAX_CACHED_NAMES = 4096;
+
+// the NameGen module, kept in the registry so that it's only imported once
+static const char NAMEGEN_REGISTRY_KEY[] = "PiLuaNameGen";
+
 static bool GetNameGenFunc(lua_State *l, const char *func)
 {
 	LUA_DEBUG_START(l);
 
-	if (!pi_lua_import(l, "NameGen"))
-		return false;
+	lua_getfield(l, LUA_REGISTRYINDEX, NAMEGEN_REGISTRY_KEY);
+	if (!lua_istable(l, -1)) {
+		lua_pop(l, 1);
+		if (!pi_lua_import(l, "NameGen"))
+			return false;
+
+		lua_pushvalue(l, -1);
+		lua_setfield(l, LUA_REGISTRYINDEX, NAMEGEN_REGISTRY_KEY);
+	}
 
 	lua_getfield(l, -1, func);
 	if (lua_isnil(l, -1)) {
@@ -80,3 +93,97 @@ std::string LuaNameGen::BodyName(SystemBody *body, RefCountedPtr<Random> &rng)
 
 	return bodyname;
 }
+
+void LuaNameGen::FullNames(std::vector<std::string> &names, size_t count, bool isFemale, RefCountedPtr<Random> &rng)
+{
+	lua_State *l = m_luaManager->GetLuaState();
+	names.clear();
+
+	if (!GetNameGenFunc(l, "FullName")) {
+		names.resize(count, isFemale ? DEFAULT_FULL_NAME_FEMALE : DEFAULT_FULL_NAME_MALE);
+		return;
+	}
+
+	LuaObject<Random>::PushToLua(rng.Get());
+	for (size_t idx = 0; idx < count; idx++) {
+		lua_pushvalue(l, -2);
+		lua_pushboolean(l, isFemale);
+		lua_pushvalue(l, -3);
+		pi_lua_protected_call(l, 2, 1);
+
+		names.push_back(luaL_checkstring(l, -1));
+		lua_pop(l, 1);
+	}
+	lua_pop(l, 2);
+}
+
+void LuaNameGen::Surnames(std::vector<std::string> &names, size_t count, RefCountedPtr<Random> &rng)
+{
+	lua_State *l = m_luaManager->GetLuaState();
+	names.clear();
+
+	if (!GetNameGenFunc(l, "Surname")) {
+		names.resize(count, DEFAULT_SURNAME);
+		return;
+	}
+
+	LuaObject<Random>::PushToLua(rng.Get());
+	for (size_t idx = 0; idx < count; idx++) {
+		lua_pushvalue(l, -2);
+		lua_pushvalue(l, -2);
+		pi_lua_protected_call(l, 1, 1);
+
+		names.push_back(luaL_checkstring(l, -1));
+		lua_pop(l, 1);
+	}
+	lua_pop(l, 2);
+}
+
+void LuaNameGen::BodyNames(std::vector<std::string> &names, const std::vector<SystemBody *> &bodies, RefCountedPtr<Random> &rng)
+{
+	lua_State *l = m_luaManager->GetLuaState();
+	names.clear();
+
+	if (!GetNameGenFunc(l, "BodyName")) {
+		names.resize(bodies.size(), DEFAULT_BODY_NAME);
+		return;
+	}
+
+	LuaObject<Random>::PushToLua(rng.Get());
+	for (SystemBody *body : bodies) {
+		lua_pushvalue(l, -2);
+		LuaObject<SystemBody>::PushToLua(body);
+		lua_pushvalue(l, -3);
+		pi_lua_protected_call(l, 2, 1);
+
+		names.push_back(luaL_checkstring(l, -1));
+		lua_pop(l, 1);
+	}
+	lua_pop(l, 2);
+}
+
+std::string LuaNameGen::GetCachedName(CachedName kind, Uint32 seed)
+{
+	const Uint64 key = (Uint64(kind) << 32) | seed;
+	auto iter = m_nameCache.find(key);
+	if (iter != m_nameCache.end())
+		return iter->second;
+
+	RefCountedPtr<Random> rng(new Random(seed));
+	std::string name = kind == CACHED_SURNAME ? Surname(rng) : FullName(kind == CACHED_FEMALE_NAME, rng);
+
+	if (m_nameCache.size() >= MAX_CACHED_NAMES)
+		m_nameCache.clear();
+	m_nameCache.emplace(key, name);
+	return name;
+}
+
+std::string LuaNameGen::FullName(bool isFemale, Uint32 seed)
+{
+	return GetCachedName(isFemale ? CACHED_FEMALE_NAME : CACHED_MALE_NAME, seed);
+}
+
+std::string LuaNameGen::Surname(Uint32 seed)
+{
+	return GetCachedName(CACHED_SURNAME, seed);
+}
@@ -5,7 +5,10 @@
 #define _LUANAMEGEN_H
 
 #include "RefCounted.h"
+#include <SDL_stdinc.h>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 class LuaManager;
 class Random;
@@ -20,8 +23,28 @@ public:
 	std::string Surname(RefCountedPtr<Random> &rng);
 	std::string BodyName(SystemBody *body, RefCountedPtr<Random> &rng);
 
+	// The same names as that many calls of the functions above, in order,
+	// looking the name generator up and pushing the generator to Lua once
+	void FullNames(std::vector<std::string> &names, size_t count, bool isFemale, RefCountedPtr<Random> &rng);
+	void Surnames(std::vector<std::string> &names, size_t count, RefCountedPtr<Random> &rng);
+	void BodyNames(std::vector<std::string> &names, const std::vector<SystemBody *> &bodies, RefCountedPtr<Random> &rng);
+
+	// The name given with a generator seeded with seed, remembered so
+	// asking for the same seed again doesn't call into Lua
+	std::string FullName(bool isFemale, Uint32 seed);
+	std::string Surname(Uint32 seed);
+
 private:
+	enum CachedName {
+		CACHED_MALE_NAME,
+		CACHED_FEMALE_NAME,
+		CACHED_SURNAME
+	};
+
+	std::string GetCachedName(CachedName kind, Uint32 seed);
+
 	LuaManager *m_luaManager;
+	std::unordered_map<Uint64, std::string> m_nameCache;
 };
 
 #endif
@@ -12,6 +12,8 @@
 #include "lua.h"
 
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <utility>
 
 /*
@@ -90,10 +92,129 @@
  * Status:
  *
  *   stable
+ *
+ *
+ * Method: observeprop
+ *
+ * Calls a function when a property of the object changes.
+ *
+ * > id = object:observeprop(key, function (key, value) ... end)
+ *
+ * The function is called once per frame at most, after the game has been
+ * updated, with the value the property has at that time, however many times
+ * it was set in between.
+ *
+ * Parameters:
+ *
+ *   key - the property to observe, or nil to observe all of them
+ *
+ * Returns:
+ *
+ *   id - the id to pass to <unobserveprop>
+ *
+ * Example:
+ *
+ * > local id = Game.player:observeprop("shieldMassLeft", function (key, value)
+ * >     shieldGauge:SetValue(value)
+ * > end)
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   experimental
+ *
+ *
+ * Method: unobserveprop
+ *
+ * Stops calling a function registered with <observeprop>.
+ *
+ * > object:unobserveprop(id)
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   experimental
  */
 
 static std::map<std::string, std::map<std::string, PromotionTest>> promotions;
 
+// Lookups cached per type, so pushing and pulling objects doesn't search the
+// registry by name every time. The type names are the s_type of the classes
+// and the keys of the promotion table, which never move, so they are keyed by
+// pointer. Everything is dropped whenever a class is created, which also
+// happens first thing for a new lua_State.
+namespace {
+	struct TypePairHash {
+		size_t operator()(const std::pair<const char *, const char *> &types) const
+		{
+			return std::hash<const void *>()(types.first) * 31 + std::hash<const void *>()(types.second);
+		}
+	};
+
+	int s_objectRegistryRef = LUA_NOREF;
+	std::unordered_map<const char *, int> s_metatableRefs;
+	std::unordered_map<std::pair<const char *, const char *>, bool, TypePairHash> s_isaCache;
+	std::unordered_map<const char *, const std::map<std::string, PromotionTest> *> s_promotionCache;
+} // namespace
+
+static void clear_type_caches()
+{
+	// the refs are only dropped, they may belong to a lua_State that's gone
+	s_objectRegistryRef = LUA_NOREF;
+	s_metatableRefs.clear();
+	s_isaCache.clear();
+	s_promotionCache.clear();
+}
+
+// push the (weak) registry of the objects that are in Lua
+static void push_object_registry(lua_State *l)
+{
+	if (s_objectRegistryRef != LUA_NOREF) {
+		lua_rawgeti(l, LUA_REGISTRYINDEX, s_objectRegistryRef);
+		return;
+	}
+
+	lua_getfield(l, LUA_REGISTRYINDEX, "LuaObjectRegistry");
+	assert(lua_istable(l, -1));
+	lua_pushvalue(l, -1);
+	s_objectRegistryRef = luaL_ref(l, LUA_REGISTRYINDEX);
+}
+
+// LuaMetaTypeBase::GetMetatableFromName, for the names that never move
+static bool push_metatable(lua_State *l, const char *type)
+{
+	auto it = s_metatableRefs.find(type);
+	if (it != s_metatableRefs.end()) {
+		lua_rawgeti(l, LUA_REGISTRYINDEX, it->second);
+		return true;
+	}
+
+	if (!LuaMetaTypeBase::GetMetatableFromName(l, type))
+		return false;
+	lua_pushvalue(l, -1);
+	s_metatableRefs.emplace(type, luaL_ref(l, LUA_REGISTRYINDEX));
+	return true;
+}
+
+// the promotions registered for a type, or nullptr if there are none
+static const std::map<std::string, PromotionTest> *find_promotions(const char *type)
+{
+	auto it = s_promotionCache.find(type);
+	if (it != s_promotionCache.end())
+		return it->second;
+
+	auto base_iter = promotions.find(type);
+	const std::map<std::string, PromotionTest> *targets = base_iter != promotions.end() ? &base_iter->second : nullptr;
+	s_promotionCache.emplace(type, targets);
+	return targets;
+}
+
 class LuaObjectHelpers {
 public:
 	// lua method to determine if the underlying object is still present in
@@ -113,6 +234,10 @@ public:
 	// lua method to check the existence of a specific property on an object
 	static int l_hasprop(lua_State *l);
 
+	// lua methods to be told about the changes of the properties of an object
+	static int l_observeprop(lua_State *l);
+	static int l_unobserveprop(lua_State *l);
+
 	// the lua object "destructor" that gets called by the garbage collector.
 	static int l_gc(lua_State *l);
 
@@ -141,7 +266,7 @@ int LuaObjectHelpers::l_hasprop(lua_State *l)
 		if (!o)
 			return luaL_error(l, "Object is no longer valid");
 
-		lua_pushboolean(l, !map->Get(lua_tostring(l, 2)).is_null());
+		lua_pushboolean(l, !map->Get(LuaPull<StringName>(l, 2)).is_null());
 	} else { // Doesn't have properties
 		lua_pushboolean(l, false);
 	}
@@ -152,7 +277,7 @@ int LuaObjectHelpers::l_hasprop(lua_State *l)
 int LuaObjectHelpers::l_unsetprop(lua_State *l)
 {
 	luaL_checktype(l, 1, LUA_TUSERDATA);
-	const std::string key(luaL_checkstring(l, 2));
+	const StringName key = LuaPull<StringName>(l, 2);
 
 	// quick check to make sure this object actually has properties
 	// before we go diving through the stack etc
@@ -172,7 +297,7 @@ int LuaObjectHelpers::l_unsetprop(lua_State *l)
 int LuaObjectHelpers::l_setprop(lua_State *l)
 {
 	luaL_checktype(l, 1, LUA_TUSERDATA);
-	const std::string key(luaL_checkstring(l, 2));
+	const StringName key = LuaPull<StringName>(l, 2);
 
 	int type = lua_type(l, 3);
 	if (type == LUA_TFUNCTION || type == LUA_TTABLE || type == LUA_TTHREAD)
@@ -193,6 +318,88 @@ int LuaObjectHelpers::l_setprop(lua_State *l)
 	return 0;
 }
 
+namespace {
+	// The Lua function of a property observer. A property map can outlive
+	// the lua_State the function is referenced from, so both check that it
+	// is still the current one.
+	class LuaPropertyObserver {
+	public:
+		LuaPropertyObserver(lua_State *l, int idx) :
+			m_lua(l)
+		{
+			lua_pushvalue(l, idx);
+			m_ref = luaL_ref(l, LUA_REGISTRYINDEX);
+		}
+
+		~LuaPropertyObserver()
+		{
+			if (IsCurrent())
+				luaL_unref(m_lua, LUA_REGISTRYINDEX, m_ref);
+		}
+
+		LuaPropertyObserver(const LuaPropertyObserver &) = delete;
+		LuaPropertyObserver &operator=(const LuaPropertyObserver &) = delete;
+
+		void Call(const StringName &key, const Property &value) const
+		{
+			if (!IsCurrent())
+				return;
+
+			lua_rawgeti(m_lua, LUA_REGISTRYINDEX, m_ref);
+			LuaPush(m_lua, key.sv());
+			LuaPush(m_lua, value);
+			pi_lua_protected_call(m_lua, 2, 0);
+		}
+
+	private:
+		bool IsCurrent() const { return Lua::manager && Lua::manager->GetLuaState() == m_lua; }
+
+		lua_State *m_lua;
+		int m_ref;
+	};
+} // namespace
+
+int LuaObjectHelpers::l_observeprop(lua_State *l)
+{
+	luaL_checktype(l, 1, LUA_TUSERDATA);
+	const std::string key = lua_isnil(l, 2) ? std::string() : luaL_checkstring(l, 2);
+	luaL_checktype(l, 3, LUA_TFUNCTION);
+
+	PropertyMap *map = LuaObjectBase::GetPropertiesFromObject(l, 1);
+	if (!map)
+		return luaL_error(l, "Object has no property map");
+
+	LuaObjectBase *lo = static_cast<LuaObjectBase *>(lua_touserdata(l, 1));
+	if (!lo->GetObject())
+		return luaL_error(l, "Object is no longer valid");
+
+	// std::function needs a copyable callable
+	auto observer = std::make_shared<LuaPropertyObserver>(l, 3);
+	const uint32_t id = map->Observe(key, [observer](const StringName &key, const Property &value) {
+		observer->Call(key, value);
+	});
+
+	lua_pushinteger(l, id);
+	return 1;
+}
+
+int LuaObjectHelpers::l_unobserveprop(lua_State *l)
+{
+	luaL_checktype(l, 1, LUA_TUSERDATA);
+	const uint32_t id = luaL_checkunsigned(l, 2);
+
+	PropertyMap *map = LuaObjectBase::GetPropertiesFromObject(l, 1);
+	if (!map)
+		return luaL_error(l, "Object has no property map");
+
+	LuaObjectBase *lo = static_cast<LuaObjectBase *>(lua_touserdata(l, 1));
+	if (!lo->GetObject())
+		return luaL_error(l, "Object is no longer valid");
+
+	map->Unobserve(id);
+	return 0;
+}
+
 int LuaObjectHelpers::l_isa(lua_State *l)
 {
 	luaL_checktype(l, 1, LUA_TUSERDATA);
@@ -317,6 +524,9 @@ void LuaObjectBase::CreateObject(const luaL_Reg *methods, const luaL_Reg *attrs,
 
 static void initialize_object_registry(lua_State *l)
 {
+	// the new class can change every cached lookup
+	clear_type_caches();
+
 	// create the object registry if it doesn't already exist. this is the
 	// best place we have to do this since classes will always be registered
 	// before any objects actually turn up
@@ -412,6 +622,13 @@ void LuaObjectBase::CreateClass(LuaMetaTypeBase *metaType)
 	lua_pushcfunction(l, LuaObjectHelpers::l_hasprop);
 	lua_setfield(l, -2, "hasprop");
 
+	// and observeprop and unobserveprop
+	lua_pushcfunction(l, LuaObjectHelpers::l_observeprop);
+	lua_setfield(l, -2, "observeprop");
+
+	lua_pushcfunction(l, LuaObjectHelpers::l_unobserveprop);
+	lua_setfield(l, -2, "unobserveprop");
+
 	// publish the method table
 	lua_rawset(l, -3);
 
@@ -453,11 +670,10 @@ bool LuaObjectBase::PushRegistered(LuaWrappable *o)
 		return true;
 	}
 
-	lua_getfield(l, LUA_REGISTRYINDEX, "LuaObjectRegistry");
-	assert(lua_istable(l, -1));
+	push_object_registry(l);
 
 	lua_pushlightuserdata(l, o);
-	lua_gettable(l, -2);
+	lua_rawget(l, -2);
 
 	if (lua_isuserdata(l, -1)) {
 		lua_insert(l, -2);
@@ -484,13 +700,14 @@ void LuaObjectBase::Register(LuaObjectBase *lo)
 	bool tried_promote = false;
 
 	while (have_promotions && !tried_promote) {
-		std::map<std::string, std::map<std::string, PromotionTest>>::const_iterator base_iter = promotions.find(lo->m_type);
-		if (base_iter != promotions.end()) {
+		const char *base_type = lo->m_type;
+		const std::map<std::string, PromotionTest> *targets = find_promotions(base_type);
+		if (targets) {
 			tried_promote = true;
 
 			for (
-				std::map<std::string, PromotionTest>::const_iterator target_iter = (*base_iter).second.begin();
-				target_iter != (*base_iter).second.end();
+				std::map<std::string, PromotionTest>::const_iterator target_iter = targets->begin();
+				target_iter != targets->end();
 				++target_iter) {
 				if ((*target_iter).second(lo->GetObject())) {
 					lo->m_type = (*target_iter).first.c_str();
@@ -498,7 +715,7 @@ void LuaObjectBase::Register(LuaObjectBase *lo)
 				}
 			}
 
-			assert(lo->Isa((*base_iter).first.c_str()));
+			assert(lo->Isa(base_type));
 		} else
 			have_promotions = false;
 	}
@@ -507,16 +724,15 @@ void LuaObjectBase::Register(LuaObjectBase *lo)
 
 	LUA_DEBUG_START(l); // lo userdata
 
-	lua_getfield(l, LUA_REGISTRYINDEX, "LuaObjectRegistry"); // lo userdata, registry table
-	assert(lua_istable(l, -1));
+	push_object_registry(l); // lo userdata, registry table
 
 	lua_pushlightuserdata(l, lo->GetObject()); // lo userdata, registry table, o lightuserdata
 	lua_pushvalue(l, -3);					   // lo userdata, registry table, o lightuserdata, lo userdata
-	lua_settable(l, -3);					   // lo userdata, registry table
+	lua_rawset(l, -3);						   // lo userdata, registry table
 
 	lua_pop(l, 1); // lo userdata
 
-	LuaMetaTypeBase::GetMetatableFromName(l, lo->m_type); // lo userdata, lo metatable
+	push_metatable(l, lo->m_type); // lo userdata, lo metatable
 	lua_pushvalue(l, -1);
 	lua_setmetatable(l, -3); // setup the metatable early to make constructor searching work
 
@@ -642,7 +858,7 @@ LuaWrappable *LuaObjectBase::CheckFromLua(int index, const char *type)
 		return 0;
 	}
 
-	if (!lo->Isa(type))
+	if (!lo->IsaCached(type))
 		luaL_error(l, "Object on stack has type %s which can not be used as type %s\n", lo->m_type, type);
 
 	// found it
@@ -662,7 +878,7 @@ LuaWrappable *LuaObjectBase::GetFromLua(int index, const char *type)
 	if (!o)
 		return 0;
 
-	if (!lo->Isa(type))
+	if (!lo->IsaCached(type))
 		return 0;
 
 	// found it
@@ -672,7 +888,7 @@ LuaWrappable *LuaObjectBase::GetFromLua(int index, const char *type)
 bool LuaObjectBase::Isa(const char *base) const
 {
 	// fast path
-	if (strcmp(m_type, base) == 0)
+	if (m_type == base || strcmp(m_type, base) == 0)
 		return true;
 
 	lua_State *l = Lua::manager->GetLuaState();
@@ -705,9 +921,26 @@ bool LuaObjectBase::Isa(const char *base) const
 	return true;
 }
 
+bool LuaObjectBase::IsaCached(const char *base) const
+{
+	// the exact type is by far the most common case
+	if (m_type == base)
+		return true;
+
+	const std::pair<const char *, const char *> key(m_type, base);
+	auto it = s_isaCache.find(key);
+	if (it != s_isaCache.end())
+		return it->second;
+
+	const bool isa = Isa(base);
+	s_isaCache.emplace(key, isa);
+	return isa;
+}
+
 void LuaObjectBase::RegisterPromotion(const char *base_type, const char *target_type, PromotionTest test_fn)
 {
 	promotions[base_type][target_type] = test_fn;
+	s_promotionCache.clear();
 }
 
 void LuaObjectBase::RegisterSerializer(const char *type, SerializerPair pair)
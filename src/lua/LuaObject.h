@@ -225,6 +225,9 @@ private:
 
 	// determine if the object has a class in its ancestry
 	bool Isa(const char *base) const;
+	// same, for a base name that never moves (the s_type of a class); the
+	// result is cached by the pointers of the two names
+	bool IsaCached(const char *base) const;
 
 	// lua type (ie method/metatable name)
 	const char *m_type;
@@ -126,10 +126,20 @@ void *pi_lua_checklightuserdata(lua_State *l, int index)
 	return nullptr;
 }
 
+// Takes a Vector2 or a table { x, y }, so scripts can pass constants
+// without creating a Vector2 for them
 void pi_lua_generic_pull(lua_State *l, int index, ImVec2 &vec)
 {
-	vector2d tr = LuaPull<vector2d>(l, index);
-	vec = ImVec2(tr.x, tr.y);
+	if (lua_istable(l, index)) {
+		lua_rawgeti(l, index, 1);
+		lua_rawgeti(l, index, 2);
+		vec = ImVec2(luaL_checknumber(l, -2), luaL_checknumber(l, -1));
+		lua_pop(l, 2);
+		return;
+	}
+
+	const vector2d *tr = LuaVector2::CheckFromLua(l, index);
+	vec = ImVec2(tr->x, tr->y);
 }
 
 void pi_lua_generic_push(lua_State *l, const ImVec2 &vec)
@@ -1588,6 +1598,158 @@ static int l_pigui_add_rect_filled(lua_State *l)
 	return 0;
 }
 
+// Draw commands for DrawCommands: each is its op code followed by its
+// arguments. Colors are a Color or a number packed like ImU32.
+enum DrawOp {
+	DRAW_OP_LINE = 1,		   // x1 y1 x2 y2 color thickness
+	DRAW_OP_RECT,			   // x1 y1 x2 y2 color rounding corners thickness
+	DRAW_OP_RECT_FILLED,	   // x1 y1 x2 y2 color rounding corners
+	DRAW_OP_CIRCLE,			   // x y radius color segments thickness
+	DRAW_OP_CIRCLE_FILLED,	   // x y radius color segments
+	DRAW_OP_TRIANGLE,		   // x1 y1 x2 y2 x3 y3 color thickness
+	DRAW_OP_TRIANGLE_FILLED,   // x1 y1 x2 y2 x3 y3 color
+	DRAW_OP_TEXT,			   // x y color text
+	DRAW_OP_MAX
+};
+
+static const int s_drawOpArgs[DRAW_OP_MAX] = { 0, 6, 8, 7, 6, 5, 8, 7, 4 };
+
+static int l_attr_draw_ops(lua_State *l)
+{
+	lua_newtable(l);
+	pi_lua_settable(l, "Line", DRAW_OP_LINE);
+	pi_lua_settable(l, "Rect", DRAW_OP_RECT);
+	pi_lua_settable(l, "RectFilled", DRAW_OP_RECT_FILLED);
+	pi_lua_settable(l, "Circle", DRAW_OP_CIRCLE);
+	pi_lua_settable(l, "CircleFilled", DRAW_OP_CIRCLE_FILLED);
+	pi_lua_settable(l, "Triangle", DRAW_OP_TRIANGLE);
+	pi_lua_settable(l, "TriangleFilled", DRAW_OP_TRIANGLE_FILLED);
+	pi_lua_settable(l, "Text", DRAW_OP_TEXT);
+	return 1;
+}
+
+/*
+ * Draw a whole buffer of primitives to the window draw list in one call.
+ *
+ * The buffer is a plain array that the script fills with the op codes from
+ * ui.draw_ops and their arguments, e.g.
+ *
+ * > buf[n + 1], buf[n + 2], ... = ops.Line, x1, y1, x2, y2, color, thickness
+ *
+ * and can be kept and refilled every frame. Only the first count entries are
+ * drawn (default: the whole array), so a shorter frame needn't clear it.
+ * Arguments are read as they are, without the checking of the single
+ * primitive functions.
+ */
+// Pack a Color into a number for DrawCommands, to convert it only once
+static int l_pigui_pack_color(lua_State *l)
+{
+	const ImColor color = LuaPull<ImColor>(l, 1);
+	lua_pushunsigned(l, ImU32(color));
+	return 1;
+}
+
+static int l_pigui_draw_commands(lua_State *l)
+{
+	PROFILE_SCOPED()
+	luaL_checktype(l, 1, LUA_TTABLE);
+	const int count = luaL_optinteger(l, 2, lua_rawlen(l, 1));
+	ImDrawList *draw_list = ImGui::GetWindowDrawList();
+
+	int i = 1;
+	auto number = [&]() {
+		lua_rawgeti(l, 1, i++);
+		const float value = lua_tonumber(l, -1);
+		lua_pop(l, 1);
+		return value;
+	};
+	auto point = [&]() {
+		const float x = number();
+		return ImVec2(x, number());
+	};
+	auto color = [&]() {
+		lua_rawgeti(l, 1, i++);
+		ImU32 col;
+		if (lua_type(l, -1) == LUA_TNUMBER)
+			col = ImGui::GetColorU32(ImU32(lua_tounsigned(l, -1)));
+		else
+			col = ImGui::GetColorU32(LuaPull<ImColor>(l, -1).Value);
+		lua_pop(l, 1);
+		return col;
+	};
+
+	while (i <= count) {
+		const int op = int(number());
+		if (op <= 0 || op >= DRAW_OP_MAX)
+			return luaL_error(l, "Unknown draw op %d at index %d", op, i - 1);
+		if (i + s_drawOpArgs[op] - 1 > count)
+			return luaL_error(l, "Draw op %d at index %d is missing arguments", op, i - 1);
+
+		switch (op) {
+		case DRAW_OP_LINE: {
+			const ImVec2 a = point(), b = point();
+			const ImU32 col = color();
+			draw_list->AddLine(a, b, col, number());
+			break;
+		}
+		case DRAW_OP_RECT: {
+			const ImVec2 a = point(), b = point();
+			const ImU32 col = color();
+			const float rounding = number();
+			const int corners = int(number());
+			draw_list->AddRect(a, b, col, rounding, corners, number());
+			break;
+		}
+		case DRAW_OP_RECT_FILLED: {
+			const ImVec2 a = point(), b = point();
+			const ImU32 col = color();
+			const float rounding = number();
+			draw_list->AddRectFilled(a, b, col, rounding, int(number()));
+			break;
+		}
+		case DRAW_OP_CIRCLE: {
+			const ImVec2 center = point();
+			const float radius = number();
+			const ImU32 col = color();
+			const int segments = int(number());
+			draw_list->AddCircle(center, radius, col, segments, number());
+			break;
+		}
+		case DRAW_OP_CIRCLE_FILLED: {
+			const ImVec2 center = point();
+			const float radius = number();
+			const ImU32 col = color();
+			draw_list->AddCircleFilled(center, radius, col, int(number()));
+			break;
+		}
+		case DRAW_OP_TRIANGLE: {
+			const ImVec2 a = point(), b = point(), c = point();
+			const ImU32 col = color();
+			draw_list->AddTriangle(a, b, c, col, number());
+			break;
+		}
+		case DRAW_OP_TRIANGLE_FILLED: {
+			const ImVec2 a = point(), b = point(), c = point();
+			draw_list->AddTriangleFilled(a, b, c, color());
+			break;
+		}
+		case DRAW_OP_TEXT: {
+			const ImVec2 pos = point();
+			const ImU32 col = color();
+			lua_rawgeti(l, 1, i++);
+			size_t len = 0;
+			const char *text = lua_tolstring(l, -1, &len);
+			if (text)
+				draw_list->AddText(pos, col, text, text + len);
+			lua_pop(l, 1);
+			break;
+		}
+		}
+	}
+
+	return 0;
+}
+
 static int l_pigui_add_quad(lua_State *l)
 {
 	PROFILE_SCOPED()
@@ -1874,14 +2036,14 @@ static int l_pigui_calc_text_size(lua_State *l)
 	PROFILE_SCOPED()
 	std::string text = LuaPull<std::string>(l, 1);
 	ImVec2 size = ImGui::CalcTextSize(text.c_str());
-	LuaPush<vector2d>(l, vector2d(size.x, size.y));
+	LuaVector2::PushToLua(l, vector2d(size.x, size.y), 2);
 	return 1;
 }
 
 static int l_pigui_get_mouse_pos(lua_State *l)
 {
 	ImVec2 pos = ImGui::GetMousePos();
-	LuaPush(l, vector2d(pos.x, pos.y));
+	LuaVector2::PushToLua(l, vector2d(pos.x, pos.y), 1);
 	return 1;
 }
 
@@ -1981,21 +2143,21 @@ static int l_pigui_pop_id(lua_State *l)
 static int l_pigui_get_window_pos(lua_State *l)
 {
 	ImVec2 pos = ImGui::GetWindowPos();
-	LuaPush<vector2d>(l, vector2d(pos.x, pos.y));
+	LuaVector2::PushToLua(l, vector2d(pos.x, pos.y), 1);
 	return 1;
 }
 
 static int l_pigui_get_window_size(lua_State *l)
 {
 	ImVec2 ws = ImGui::GetWindowSize();
-	LuaPush<vector2d>(l, vector2d(ws.x, ws.y));
+	LuaVector2::PushToLua(l, vector2d(ws.x, ws.y), 1);
 	return 1;
 }
 
 static int l_pigui_get_content_region(lua_State *l)
 {
 	ImVec2 cra = ImGui::GetContentRegionAvail();
-	LuaPush<vector2d>(l, vector2d(cra.x, cra.y));
+	LuaVector2::PushToLua(l, vector2d(cra.x, cra.y), 1);
 	return 1;
 }
 
@@ -2044,22 +2206,42 @@ static int l_pigui_get_mouse_clicked_pos(lua_State *l)
 	return 1;
 }
 
-PiGui::TScreenSpace lua_world_space_to_screen_space(const Body *body)
+static PiGui::TScreenSpace lua_screen_space(const WorldView::ScreenProjection &projection)
 {
-	PROFILE_SCOPED()
-	const vector3d p = Pi::game->GetWorldView()->WorldSpaceToScreenSpace(body);
-
-	// TODO: query ImGui viewport or WorldView instead?
+	const vector3d &p = projection.screenPos;
 	const int width = Pi::renderer->GetWindowWidth();
 	const int height = Pi::renderer->GetWindowHeight();
 	const vector3d direction = (p - vector3d(width / 2.0, height / 2.0, 0)).Normalized();
-	if (vector3d(0, 0, 0) == p || p.x < 0 || p.y < 0 || p.x > width || p.y > height || p.z > 0) {
+	if (!projection.onScreen) {
 		return PiGui::TScreenSpace(false, vector2d(0, 0), direction * (p.z > 0 ? -1 : 1));
 	} else {
 		return PiGui::TScreenSpace(true, vector2d(p.x, p.y), direction);
 	}
 }
 
+// the bodies on screen, projected in one go
+static void lua_project_bodies(const std::vector<Body *> &bodies, PiGui::TSS_vector &onScreen)
+{
+	PROFILE_SCOPED()
+	std::vector<WorldView::ScreenProjection> projected;
+	Pi::game->GetWorldView()->WorldSpaceToScreenSpace(bodies, projected);
+	for (size_t i = 0; i < bodies.size(); i++) {
+		if (!projected[i].onScreen) continue;
+		onScreen.emplace_back(lua_screen_space(projected[i]));
+		onScreen.back()._body = bodies[i];
+	}
+}
+
+static void lua_push_screen_space(lua_State *l, const WorldView::ScreenProjection &projection)
+{
+	const PiGui::TScreenSpace res = lua_screen_space(projection);
+	LuaTable object(l, 0, 4);
+	object.Set("onscreen", res._onScreen);
+	object.Set("screenCoordinates", vector2d(projection.screenPos.x, projection.screenPos.y));
+	object.Set("direction", res._direction);
+	object.Set("behind", projection.screenPos.z > 0.0);
+}
+
 bool PiGui::first_body_is_more_important_than(Body *body, Body *other)
 {
 
@@ -2186,20 +2368,20 @@ static int l_pigui_get_projected_bodies_grouped(lua_State *l)
 	const double cluster_size = LuaPull<double>(l, 1);
 	const double ship_max_distance = LuaPull<double>(l, 2);
 
-	PiGui::TSS_vector filtered;
-	filtered.reserve(Pi::game->GetSpace()->GetNumBodies());
-
+	std::vector<Body *> bodies;
+	bodies.reserve(Pi::game->GetSpace()->GetNumBodies());
 	for (Body *body : Pi::game->GetSpace()->GetBodies()) {
 		if (body == Pi::game->GetPlayer()) continue;
 		if (body->GetType() == ObjectType::PROJECTILE) continue;
 		if ((body->GetType() == ObjectType::SHIP || body->GetType() == ObjectType::CARGOBODY || body->GetType() == ObjectType::HYPERSPACECLOUD) &&
 			body->GetPositionRelTo(Pi::player).Length() > ship_max_distance) continue;
-		const PiGui::TScreenSpace res = lua_world_space_to_screen_space(body); // defined in LuaPiGui.cpp
-		if (!res._onScreen) continue;
-		filtered.emplace_back(res);
-		filtered.back()._body = body;
+		bodies.push_back(body);
 	}
 
+	PiGui::TSS_vector filtered;
+	filtered.reserve(bodies.size());
+	lua_project_bodies(bodies, filtered);
+
 	struct GroupInfo {
 		Body *m_mainBody;
 		vector2d m_screenCoords; // screen coords of group
@@ -2292,17 +2474,18 @@ static int l_pigui_get_projected_bodies_grouped(lua_State *l)
 static int l_pigui_get_projected_bodies(lua_State *l)
 {
 	PROFILE_SCOPED()
-	PiGui::TSS_vector filtered;
-	filtered.reserve(Pi::game->GetSpace()->GetNumBodies());
+	std::vector<Body *> bodies;
+	bodies.reserve(Pi::game->GetSpace()->GetNumBodies());
 	for (Body *body : Pi::game->GetSpace()->GetBodies()) {
 		if (body == Pi::game->GetPlayer()) continue;
 		if (body->GetType() == ObjectType::PROJECTILE) continue;
-		const PiGui::TScreenSpace res = lua_world_space_to_screen_space(body); // defined in LuaPiGui.cpp
-		if (!res._onScreen) continue;
-		filtered.emplace_back(res);
-		filtered.back()._body = body;
+		bodies.push_back(body);
 	}
 
+	PiGui::TSS_vector filtered;
+	filtered.reserve(bodies.size());
+	lua_project_bodies(bodies, filtered);
+
 	LuaTable result(l, 0, filtered.size());
 	for (PiGui::TScreenSpace &res : filtered) {
 		LuaTable object(l, 0, 3);
@@ -2318,6 +2501,113 @@ static int l_pigui_get_projected_bodies(lua_State *l)
 	return 1;
 }
 
+/*
+ * Function: ProjectBodies
+ *
+ * Project many bodies onto the screen in one call; much cheaper than
+ * projecting them one at a time.
+ *
+ * > projected = Engine.pigui.ProjectBodies(bodies)
+ *
+ * Parameters:
+ *
+ *   bodies - array of <Body> objects to project
+ *
+ * Returns:
+ *
+ *   projected - array of info records, one per body in the same order
+ *
+ * Fields in info record:
+ *
+ *   onscreen - true if the body is in front of the camera and on screen
+ *   screenCoordinates - the screen-space position of the body
+ *   direction - the screen-space direction from the center of the screen
+ *               to the body, for off-screen markers
+ *   behind - true if the body is behind the camera
+ *
+ * Availability:
+ *
+ *   2024-10
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_pigui_project_bodies(lua_State *l)
+{
+	PROFILE_SCOPED()
+	luaL_checktype(l, 1, LUA_TTABLE);
+	const size_t count = lua_rawlen(l, 1);
+
+	std::vector<Body *> bodies(count);
+	for (size_t i = 0; i < count; i++) {
+		lua_rawgeti(l, 1, i + 1);
+		bodies[i] = LuaObject<Body>::CheckFromLua(-1);
+		lua_pop(l, 1);
+	}
+
+	std::vector<WorldView::ScreenProjection> projected;
+	Pi::game->GetWorldView()->WorldSpaceToScreenSpace(bodies, projected);
+
+	LuaTable result(l, count, 0);
+	for (size_t i = 0; i < count; i++) {
+		lua_push_screen_space(l, projected[i]);
+		lua_rawseti(l, -2, i + 1);
+	}
+	return 1;
+}
+
+/*
+ * Function: ProjectRelPositions
+ *
+ * Project many player-relative positions onto the screen in one call, as
+ * <Engine.ProjectRelPosition> does for one.
+ *
+ * > projected = Engine.pigui.ProjectRelPositions(positions)
+ *
+ * Parameters:
+ *
+ *   positions - array of position Vectors in player-relative space
+ *               (e.g. `body:GetPositionRelTo(player)`)
+ *
+ * Returns:
+ *
+ *   projected - array of info records, one per position in the same order,
+ *               with the same fields as those of <ProjectBodies>
+ *
+ * Availability:
+ *
+ *   2024-10
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_pigui_project_rel_positions(lua_State *l)
+{
+	PROFILE_SCOPED()
+	luaL_checktype(l, 1, LUA_TTABLE);
+	const size_t count = lua_rawlen(l, 1);
+
+	const vector3d playerPos = Pi::player->GetInterpPosition();
+	std::vector<vector3d> positions(count);
+	for (size_t i = 0; i < count; i++) {
+		lua_rawgeti(l, 1, i + 1);
+		positions[i] = LuaPull<vector3d>(l, -1) + playerPos;
+		lua_pop(l, 1);
+	}
+
+	std::vector<WorldView::ScreenProjection> projected;
+	Pi::game->GetWorldView()->WorldSpaceToScreenSpace(positions, {}, projected);
+
+	LuaTable result(l, count, 0);
+	for (size_t i = 0; i < count; i++) {
+		lua_push_screen_space(l, projected[i]);
+		lua_rawseti(l, -2, i + 1);
+	}
+	return 1;
+}
+
 static int l_pigui_get_targets_nearby(lua_State *l)
 {
 	PROFILE_SCOPED()
@@ -2842,14 +3132,14 @@ static int l_pigui_is_key_released(lua_State *l)
 static int l_pigui_get_cursor_pos(lua_State *l)
 {
 	vector2d v(ImGui::GetCursorPos().x, ImGui::GetCursorPos().y);
-	LuaPush<vector2d>(l, v);
+	LuaVector2::PushToLua(l, v, 1);
 	return 1;
 }
 
 static int l_pigui_get_cursor_screen_pos(lua_State *l)
 {
 	vector2d v(ImGui::GetCursorScreenPos().x, ImGui::GetCursorScreenPos().y);
-	LuaPush<vector2d>(l, v);
+	LuaVector2::PushToLua(l, v, 1);
 	return 1;
 }
 
@@ -3308,6 +3598,8 @@ void LuaObject<PiGui::Instance>::RegisterClass()
 		{ "AddImage", l_pigui_add_image },
 		{ "AddImageQuad", l_pigui_add_image_quad },
 		{ "AddBezierCurve", l_pigui_add_bezier_curve },
+		{ "DrawCommands", l_pigui_draw_commands },
+		{ "PackColor", l_pigui_pack_color },
 		{ "AlignTextToFramePadding", l_pigui_align_to_frame_padding },
 		{ "AlignTextToLineHeight", l_pigui_align_to_line_height },
 		{ "GetWindowContentSize", l_pigui_get_window_content_size },
@@ -3432,6 +3724,8 @@ void LuaObject<PiGui::Instance>::RegisterClass()
 		{ "GetTargetsNearby", l_pigui_get_targets_nearby },
 		{ "GetProjectedBodies", l_pigui_get_projected_bodies },
 		{ "GetProjectedBodiesGrouped", l_pigui_get_projected_bodies_grouped },
+		{ "ProjectBodies", l_pigui_project_bodies },
+		{ "ProjectRelPositions", l_pigui_project_rel_positions },
 		{ "CalcTextAlignment", l_pigui_calc_text_alignment },
 		{ "ShouldShowLabels", l_pigui_should_show_labels },
 		{ "LowThrustButton", l_pigui_low_thrust_button },
@@ -3478,6 +3772,7 @@ void LuaObject<PiGui::Instance>::RegisterClass()
 		{ "key_alt", l_attr_key_alt },
 		{ "keys", l_attr_keys },
 		{ "event_queue", l_attr_event_queue },
+		{ "draw_ops", l_attr_draw_ops },
 		{ 0, 0 }
 	};
 
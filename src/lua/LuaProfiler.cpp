@@ -0,0 +1,309 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "LuaProfiler.h"
+#include "FileSystem.h"
+#include "core/Log.h"
+
+#include "SDL_timer.h"
+
+#include <lua.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <unordered_map>
+
+namespace {
+	// a function is its source and the line it is defined on; C functions
+	// are their address and line -1
+	struct Key {
+		uintptr_t source;
+		int line;
+
+		bool operator==(const Key &other) const { return source == other.source && line == other.line; }
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key &key) const
+		{
+			return std::hash<uintptr_t>()(key.source) * 31 + size_t(key.line);
+		}
+	};
+
+	struct FunctionStats {
+		std::string name;
+		std::string source;
+		int line = 0;
+		Uint64 numCalls = 0;
+		Uint64 inclusive = 0;
+		Uint64 exclusive = 0;
+		Uint64 numAllocs = 0;
+		Uint64 allocBytes = 0;
+		// number of calls on the stack, so recursion is only timed once
+		int active = 0;
+	};
+
+	struct LineStats {
+		std::string source;
+		int line = 0;
+		Uint64 numSamples = 0;
+	};
+
+	struct Frame {
+		FunctionStats *function;
+		Uint64 start;
+		Uint64 children;
+		// tail calls replace their caller, both return at once
+		bool tail;
+	};
+
+	typedef std::vector<Frame> Stack;
+
+	bool s_running = false;
+	lua_Alloc s_prevAlloc = nullptr;
+	void *s_prevAllocData = nullptr;
+
+	// the nodes of an unordered_map don't move, the stacks point into it
+	std::unordered_map<Key, FunctionStats, KeyHash> s_functions;
+	std::unordered_map<Key, LineStats, KeyHash> s_lines;
+
+	// one stack for each coroutine, and the one that ran last
+	std::map<lua_State *, Stack> s_stacks;
+	lua_State *s_currentState = nullptr;
+	Stack *s_current = nullptr;
+
+	double ToMilliseconds(Uint64 ticks)
+	{
+		static const double scale = 1000.0 / double(SDL_GetPerformanceFrequency());
+		return double(ticks) * scale;
+	}
+
+	Stack &GetStack(lua_State *l)
+	{
+		if (l != s_currentState) {
+			s_currentState = l;
+			s_current = &s_stacks[l];
+		}
+		return *s_current;
+	}
+
+	FunctionStats *GetFunction(lua_State *l, lua_Debug *ar)
+	{
+		lua_getinfo(l, "Sf", ar);
+		Key key;
+		if (ar->what[0] == 'C') {
+			key = { reinterpret_cast<uintptr_t>(lua_tocfunction(l, -1)), -1 };
+		} else {
+			key = { reinterpret_cast<uintptr_t>(ar->source), ar->linedefined };
+		}
+		lua_pop(l, 1);
+
+		auto it = s_functions.find(key);
+		if (it != s_functions.end())
+			return &it->second;
+
+		FunctionStats &function = s_functions[key];
+		lua_getinfo(l, "n", ar);
+		function.name = ar->name ? ar->name : (ar->what[0] == 'm' ? "main chunk" : "?");
+		function.source = ar->short_src;
+		function.line = ar->linedefined;
+		return &function;
+	}
+
+	void OnCall(lua_State *l, lua_Debug *ar, bool tail)
+	{
+		FunctionStats *function = GetFunction(l, ar);
+		function->numCalls++;
+		function->active++;
+		GetStack(l).push_back({ function, SDL_GetPerformanceCounter(), 0, tail });
+	}
+
+	void OnReturn(lua_State *l)
+	{
+		const Uint64 now = SDL_GetPerformanceCounter();
+		Stack &stack = GetStack(l);
+
+		// the stack is empty for calls made before the profiler started
+		bool tail = true;
+		while (tail && !stack.empty()) {
+			const Frame frame = stack.back();
+			stack.pop_back();
+			tail = frame.tail;
+
+			const Uint64 elapsed = now - frame.start;
+			frame.function->exclusive += elapsed - std::min(elapsed, frame.children);
+			if (--frame.function->active == 0)
+				frame.function->inclusive += elapsed;
+			if (!stack.empty())
+				stack.back().children += elapsed;
+		}
+	}
+
+	void OnSample(lua_State *l, lua_Debug *ar)
+	{
+		lua_getinfo(l, "Sl", ar);
+		if (ar->currentline < 0)
+			return;
+
+		LineStats &line = s_lines[{ reinterpret_cast<uintptr_t>(ar->source), ar->currentline }];
+		if (!line.numSamples) {
+			line.source = ar->short_src;
+			line.line = ar->currentline;
+		}
+		line.numSamples++;
+	}
+
+	void Hook(lua_State *l, lua_Debug *ar)
+	{
+		// coroutines keep the hook they were created with
+		if (!s_running) {
+			lua_sethook(l, nullptr, 0, 0);
+			return;
+		}
+
+		switch (ar->event) {
+		case LUA_HOOKCALL: OnCall(l, ar, false); break;
+		case LUA_HOOKTAILCALL: OnCall(l, ar, true); break;
+		case LUA_HOOKRET: OnReturn(l); break;
+		case LUA_HOOKCOUNT: OnSample(l, ar); break;
+		default: break;
+		}
+	}
+
+	// counts the memory allocated by the function running at the time
+	void *Alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+	{
+		// without a block, osize is the type of the new object
+		const size_t oldSize = ptr ? osize : 0;
+		if (nsize > oldSize && s_current && !s_current->empty()) {
+			FunctionStats *function = s_current->back().function;
+			function->numAllocs++;
+			function->allocBytes += nsize - oldSize;
+		}
+
+		return s_prevAlloc(s_prevAllocData, ptr, osize, nsize);
+	}
+
+	std::string CsvString(const std::string &str)
+	{
+		std::string out = "\"";
+		for (char c : str) {
+			if (c == '"')
+				out += '"';
+			out += c;
+		}
+		return out + "\"";
+	}
+} // namespace
+
+// static
+void LuaProfiler::Start(lua_State *l)
+{
+	if (s_running)
+		return;
+
+	s_running = true;
+	s_prevAlloc = lua_getallocf(l, &s_prevAllocData);
+	lua_setallocf(l, Alloc, nullptr);
+	lua_sethook(l, Hook, LUA_MASKCALL | LUA_MASKRET | LUA_MASKCOUNT, SAMPLE_INTERVAL);
+}
+
+// static
+void LuaProfiler::Stop(lua_State *l)
+{
+	if (!s_running)
+		return;
+
+	s_running = false;
+	lua_sethook(l, nullptr, 0, 0);
+	lua_setallocf(l, s_prevAlloc, s_prevAllocData);
+
+	// the calls still on the stacks won't be timed
+	for (auto &function : s_functions)
+		function.second.active = 0;
+	s_stacks.clear();
+	s_currentState = nullptr;
+	s_current = nullptr;
+}
+
+// static
+bool LuaProfiler::IsRunning()
+{
+	return s_running;
+}
+
+// static
+void LuaProfiler::Reset()
+{
+	s_stacks.clear();
+	s_currentState = nullptr;
+	s_current = nullptr;
+	s_functions.clear();
+	s_lines.clear();
+}
+
+// static
+bool LuaProfiler::HasData()
+{
+	return !s_functions.empty();
+}
+
+// static
+void LuaProfiler::GetFunctions(std::vector<FunctionSummary> &out)
+{
+	out.clear();
+	out.reserve(s_functions.size());
+	for (const auto &it : s_functions) {
+		const FunctionStats &function = it.second;
+		out.push_back({ function.name, function.source, function.line, function.numCalls,
+			ToMilliseconds(function.inclusive), ToMilliseconds(function.exclusive),
+			function.numAllocs, function.allocBytes });
+	}
+
+	std::sort(out.begin(), out.end(), [](const FunctionSummary &a, const FunctionSummary &b) {
+		return a.exclusiveMs > b.exclusiveMs;
+	});
+}
+
+// static
+void LuaProfiler::GetLines(std::vector<LineSummary> &out)
+{
+	out.clear();
+	out.reserve(s_lines.size());
+	for (const auto &it : s_lines)
+		out.push_back({ it.second.source, it.second.line, it.second.numSamples });
+
+	std::sort(out.begin(), out.end(), [](const LineSummary &a, const LineSummary &b) {
+		return a.numSamples > b.numSamples;
+	});
+}
+
+// static
+bool LuaProfiler::Dump(const std::string &dir)
+{
+	std::vector<FunctionSummary> functions;
+	GetFunctions(functions);
+	std::ofstream functionFile(FileSystem::JoinPath(dir, "lua_functions.csv"));
+	if (!functionFile) {
+		Log::Warning("LuaProfiler: couldn't write the profile to {}", dir);
+		return false;
+	}
+
+	functionFile << "function,source,line,calls,inclusive_ms,exclusive_ms,allocs,alloc_bytes\n";
+	for (const FunctionSummary &f : functions) {
+		functionFile << CsvString(f.name) << "," << CsvString(f.source) << "," << f.line << ","
+					 << f.numCalls << "," << f.inclusiveMs << "," << f.exclusiveMs << ","
+					 << f.numAllocs << "," << f.allocBytes << "\n";
+	}
+
+	std::vector<LineSummary> lines;
+	GetLines(lines);
+	std::ofstream lineFile(FileSystem::JoinPath(dir, "lua_lines.csv"));
+	lineFile << "source,line,samples\n";
+	for (const LineSummary &line : lines)
+		lineFile << CsvString(line.source) << "," << line.line << "," << line.numSamples << "\n";
+
+	return bool(lineFile);
+}
@@ -0,0 +1,67 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUAPROFILER_H
+#define _LUAPROFILER_H
+
+#include "SDL_stdinc.h"
+
+#include <string>
+#include <vector>
+
+struct lua_State;
+
+// Profiles the Lua code running on a lua_State with the debug hooks.
+//
+// Every call and return is timed to get the inclusive and exclusive time of
+// each function, and the memory Lua allocates is counted against the
+// function running at the time. Every SAMPLE_INTERVAL instructions the line
+// being run is sampled, to show where the time goes inside a function.
+//
+// Functions are told apart by their source and the line they are defined
+// on, so all the closures made from the same function add up together.
+// Coroutines created before Start are not profiled.
+//
+// All of it happens on the main thread, like everything else with Lua.
+class LuaProfiler {
+public:
+	struct FunctionSummary {
+		std::string name;
+		std::string source;
+		int line;
+		Uint64 numCalls;
+		// time from the call to the return, not counting recursive calls twice
+		double inclusiveMs;
+		// inclusive time minus the time spent in the functions it called
+		double exclusiveMs;
+		Uint64 numAllocs;
+		Uint64 allocBytes;
+	};
+
+	struct LineSummary {
+		std::string source;
+		int line;
+		Uint64 numSamples;
+	};
+
+	// number of instructions between two line samples
+	static constexpr int SAMPLE_INTERVAL = 1000;
+
+	static void Start(lua_State *l);
+	static void Stop(lua_State *l);
+	static bool IsRunning();
+
+	// forget everything recorded so far
+	static void Reset();
+	static bool HasData();
+
+	// the functions seen so far, most exclusive time first
+	static void GetFunctions(std::vector<FunctionSummary> &out);
+	// the lines sampled so far, most samples first
+	static void GetLines(std::vector<LineSummary> &out);
+
+	// write lua_functions.csv and lua_lines.csv to the given directory
+	static bool Dump(const std::string &dir);
+};
+
+#endif
@@ -9,6 +9,41 @@
 #include "LuaVector.h"
 #include "LuaVector2.h"
 
+#include <cstring>
+
+namespace {
+	// direct-mapped by the address of the Lua string data; a string freed
+	// and another allocated at the same address is told apart by comparing
+	// the contents, which is much cheaper than hashing them again
+	struct NameCacheEntry {
+		const char *str = nullptr;
+		StringName name;
+	};
+
+	constexpr size_t NAME_CACHE_SIZE = 512;
+	NameCacheEntry s_nameCache[NAME_CACHE_SIZE];
+} // namespace
+
+void pi_lua_generic_pull(lua_State *l, int idx, StringName &out)
+{
+	size_t len;
+	const char *str = luaL_checklstring(l, idx, &len);
+
+	const uintptr_t addr = reinterpret_cast<uintptr_t>(str);
+	NameCacheEntry &entry = s_nameCache[((addr >> 4) ^ (addr >> 13)) & (NAME_CACHE_SIZE - 1)];
+	if (entry.str != str || entry.name.size() != len || std::memcmp(entry.name.c_str(), str, len) != 0) {
+		entry.str = str;
+		entry.name = StringName(std::string_view(str, len));
+	}
+
+	out = entry.name;
+}
+
+void pi_lua_generic_push(lua_State *l, const StringName &value)
+{
+	lua_pushlstring(l, value.c_str(), value.size());
+}
+
 void pi_lua_generic_pull(lua_State *l, int idx, Property &out)
 {
 	out = nullptr; // default case if no branches match
@@ -18,7 +53,7 @@ void pi_lua_generic_pull(lua_State *l, int idx, Property &out)
 	if (type == LUA_TNUMBER)
 		out = lua_tonumber(l, idx);
 	if (type == LUA_TSTRING)
-		out = LuaPull<std::string_view>(l, idx);
+		out = LuaPull<StringName>(l, idx);
 	if (type == LUA_TUSERDATA) {
 		const vector2d *vec2 = LuaVector2::GetFromLua(l, idx);
 		if (vec2)
@@ -44,7 +79,7 @@ void pi_lua_generic_pull(lua_State *l, int idx, Property &out)
 			}
 
 			Property prop = LuaPull<Property>(l, -1);
-			std::string_view key = LuaPull<std::string_view>(l, -2);
+			StringName key = LuaPull<StringName>(l, -2);
 
 			map->Set(key, std::move(prop));
 			lua_pop(l, 1);
@@ -69,7 +104,7 @@ void pi_lua_generic_push(lua_State *l, const Property &property)
 	if (property.is_quat())
 		return lua_pushnil(l); // for now, quaternions are not exposed to lua
 	if (property.is_string())
-		return LuaPush(l, property.get_string().sv());
+		return LuaPush(l, property.get_string());
 	if (property.is_map())
 		return LuaPush(l, property.get_map());
 }
@@ -78,7 +113,7 @@ static int l_iter_next(lua_State *l)
 {
 	auto &iter = *static_cast<PropertyMap::iterator *>(lua_touserdata(l, 1));
 	if (iter) {
-		LuaPush(l, iter->first.sv());
+		LuaPush(l, iter->first);
 		LuaPush(l, iter->second);
 		++iter;
 		return 2;
@@ -99,12 +134,12 @@ void LuaObject<PropertyMap>::RegisterClass()
 	metaType.StartRecording();
 	metaType.AddMeta("__len", &PropertyMap::Size);
 	metaType.AddMeta("__index", [](lua_State *l, PropertyMap *m) -> int {
-		auto key = LuaPull<std::string_view>(l, 2);
+		auto key = LuaPull<StringName>(l, 2);
 		LuaPush(l, m->Get(key));
 		return 1;
 	});
 	metaType.AddMeta("__newindex", [](lua_State *l, PropertyMap *m) -> int {
-		auto key = LuaPull<std::string_view>(l, 2);
+		auto key = LuaPull<StringName>(l, 2);
 		auto prop = LuaPull<Property>(l, 3);
 		m->Set(key, prop);
 		return 0;
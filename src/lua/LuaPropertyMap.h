@@ -6,6 +6,14 @@
 #include "LuaObject.h"
 
 class Property;
+class StringName;
 
 void pi_lua_generic_pull(lua_State *l, int index, Property &out);
 void pi_lua_generic_push(lua_State *l, const Property &value);
+
+// Property keys come from Lua strings, which Lua interns, so the same key
+// has the same string data every time. The StringName made for a string is
+// kept by the address of that data and handed out again without rehashing
+// or interning it; main-thread only, like the Lua state.
+void pi_lua_generic_pull(lua_State *l, int index, StringName &out);
+void pi_lua_generic_push(lua_State *l, const StringName &value);
@@ -72,17 +72,21 @@ void LuaObject<SectorView>::RegisterClass()
 		.AddFunction("AutoRoute", [](lua_State *l, SectorView *sv) {
 			SystemPath current_path = sv->GetCurrent();
 			SystemPath target_path = sv->GetSelected();
-			std::vector<SystemPath> route;
-			const std::string result = sv->AutoRoute(current_path, target_path, route);
-			if (result == "OKAY") {
-				sv->ClearRoute();
-				for (auto it = route.begin(); it != route.end(); it++) {
-					sv->AddToRoute(*it);
-				}
-			}
+			const std::string result = sv->AutoRoute(current_path, target_path);
+			LuaPush<std::string>(l, result);
+			return 1;
+		})
+		.AddFunction("StartAutoRoute", [](lua_State *l, SectorView *sv) {
+			SystemPath current_path = sv->GetCurrent();
+			SystemPath target_path = sv->GetSelected();
+			const std::string result = sv->StartAutoRoute(current_path, target_path);
 			LuaPush<std::string>(l, result);
 			return 1;
 		})
+		.AddFunction("IsAutoRoutePlanning", [](lua_State *l, SectorView *sv) {
+			LuaPush<bool>(l, sv->IsAutoRoutePlanning());
+			return 1;
+		})
 		.AddFunction("GetRoute", [](lua_State *l, SectorView *sv) {
 			std::vector<SystemPath> route = sv->GetRoute();
 			lua_newtable(l);
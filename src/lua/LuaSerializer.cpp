@@ -13,6 +13,10 @@
 #include "core/Log.h"
 #include "profiler/Profiler.h"
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
 // Well-known names of various serialization-related caches stored in the
 // Lua Registry
 static const char *NS_REFTABLE = "PiSerializerTableRefs";
@@ -63,6 +67,153 @@ static const char *NS_PERSISTENT = "PiSerializerPersistent";
 // on deserialize, the data after an "object" item will be passed to the
 // "Deserialize" function under that namespace. that data returned will be
 // given back to the module
+//
+// The module table itself is pickled by pickle_binary instead, which writes
+// the same structure as a stream of tagged values without building a Json
+// document for it. Every value starts with a tag byte:
+//   TAG_NIL, TAG_FALSE, TAG_TRUE
+//   TAG_INT <zigzag varint>       - numbers that are whole 32 bit integers
+//   TAG_DOUBLE <8 bytes>          - any other number, little-endian
+//   TAG_STRING <varint> <bytes>   - strings, which may contain nulls
+//   TAG_REF <varint>              - a previously-pickled table
+//   TAG_TABLE <varint> ... TAG_END
+//                                 - a new table and its key, value pairs
+//   TAG_CLASS <string> TAG_TABLE ...
+//                                 - a table of a registered Lua class
+//   TAG_USERDATA <varint> <bytes> - the CBOR of what the C++ serializer wrote
+// Table references share the table of refs with the Json pickler, so the
+// module data can refer to tables pickled with the persistent objects.
+
+namespace {
+	enum PickleTag : uint8_t {
+		TAG_END = 0,
+		TAG_NIL,
+		TAG_FALSE,
+		TAG_TRUE,
+		TAG_INT,
+		TAG_DOUBLE,
+		TAG_STRING,
+		TAG_REF,
+		TAG_TABLE,
+		TAG_CLASS,
+		TAG_USERDATA
+	};
+
+	void write_varint(std::string &out, uint64_t value)
+	{
+		while (value >= 0x80) {
+			out.push_back(char((value & 0x7f) | 0x80));
+			value >>= 7;
+		}
+		out.push_back(char(value));
+	}
+
+	void write_bytes(std::string &out, const char *data, size_t len)
+	{
+		write_varint(out, len);
+		out.append(data, len);
+	}
+
+	void write_number(std::string &out, double value)
+	{
+		// the range check also keeps NaN out of the cast
+		if (value >= double(INT32_MIN) && value <= double(INT32_MAX)) {
+			const int32_t i = int32_t(value);
+			if (double(i) == value && !(value == 0.0 && std::signbit(value))) {
+				out.push_back(TAG_INT);
+				write_varint(out, (uint32_t(i) << 1) ^ uint32_t(i >> 31));
+				return;
+			}
+		}
+
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		out.push_back(TAG_DOUBLE);
+		for (int n = 0; n < 8; n++)
+			out.push_back(char(bits >> (n * 8)));
+	}
+
+	// the reader throws on running past the end, so a truncated save is
+	// reported as corrupt instead of crashing
+	uint8_t read_tag(const char *&pos, const char *end)
+	{
+		if (pos >= end)
+			throw SavedGameCorruptException();
+		return uint8_t(*pos++);
+	}
+
+	uint64_t read_varint(const char *&pos, const char *end)
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			const uint8_t byte = read_tag(pos, end);
+			value |= uint64_t(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+				return value;
+		}
+		throw SavedGameCorruptException();
+	}
+
+	const char *read_bytes(const char *&pos, const char *end, size_t &len)
+	{
+		len = read_varint(pos, end);
+		if (len > size_t(end - pos))
+			throw SavedGameCorruptException();
+		const char *data = pos;
+		pos += len;
+		return data;
+	}
+
+	double read_double(const char *&pos, const char *end)
+	{
+		if (end - pos < 8)
+			throw SavedGameCorruptException();
+		uint64_t bits = 0;
+		for (int n = 0; n < 8; n++)
+			bits |= uint64_t(uint8_t(*pos++)) << (n * 8);
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+} // namespace
+
+// Passes the table at the top of the stack through the Unserialize method of
+// the class, leaving its result in place and in the table of refs
+static void unserialize_class(lua_State *l, const char *cl, lua_Integer ptr)
+{
+	lua_getfield(l, LUA_REGISTRYINDEX, NS_CLASSES);
+	lua_pushstring(l, cl);
+	lua_gettable(l, -2);
+	lua_remove(l, -2);
+
+	if (lua_isnil(l, -1)) {
+		lua_pop(l, 1);
+		return;
+	}
+
+	lua_getfield(l, -1, "Unserialize"); // [t] [klass] [klass.Unserialize]
+	if (lua_isnil(l, -1)) {
+		luaL_error(l, "No Unserialize method found for class '%s'\n", cl);
+		return;
+	}
+
+	lua_insert(l, -3); // [klass.Unserialize] [t] [klass]
+	lua_pop(l, 1);	   // [klass.Unserialize] [t]
+
+	pi_lua_protected_call(l, 1, 1); // [t]
+	if (lua_isnil(l, -1)) {
+		luaL_error(l, "The Unserialize method for class '%s' didn't return a value\n", cl);
+	}
+
+	// Update the TableRefs cache with the new value
+	// NOTE: recursive references to the original table will not be affected,
+	// only references in tables deserialized later.
+	lua_getfield(l, LUA_REGISTRYINDEX, NS_REFTABLE); // [t] [refs]
+	lua_pushinteger(l, ptr);						 // [t] [refs] [key]
+	lua_pushvalue(l, -3);							 // [t] [refs] [key] [t]
+	lua_rawset(l, -3);								 // [t] [refs]
+	lua_pop(l, 1);									 // [t]
+}
 
 void LuaSerializer::pickle_json(lua_State *l, int to_serialize, Json &out, const std::string &key)
 {
@@ -300,38 +451,8 @@ void LuaSerializer::unpickle_json(lua_State *l, const Json &value)
 			if (value.count("lua_class")) {
 				const char *cl = value["lua_class"].get_ref<const std::string &>().c_str();
 				// If this was a full definition (not just a reference) then run the class's unserialiser function.
-				if (value.count("table")) {
-					lua_getfield(l, LUA_REGISTRYINDEX, NS_CLASSES);
-					lua_pushstring(l, cl);
-					lua_gettable(l, -2);
-					lua_remove(l, -2);
-
-					if (lua_isnil(l, -1)) {
-						lua_pop(l, 1);
-					} else {
-						lua_getfield(l, -1, "Unserialize"); // [t] [klass] [klass.Unserialize]
-						if (lua_isnil(l, -1)) {
-							luaL_error(l, "No Unserialize method found for class '%s'\n", cl);
-						} else {
-							lua_insert(l, -3); // [klass.Unserialize] [t] [klass]
-							lua_pop(l, 1);	   // [klass.Unserialize] [t]
-
-							pi_lua_protected_call(l, 1, 1); // [t]
-							if (lua_isnil(l, -1)) {
-								luaL_error(l, "The Unserialize method for class '%s' didn't return a value\n", cl);
-							}
-
-							// Update the TableRefs cache with the new value
-							// NOTE: recursive references to the original table will not be affected,
-							// only references in tables deserialized later.
-							lua_getfield(l, LUA_REGISTRYINDEX, NS_REFTABLE); // [t] [refs]
-							lua_pushinteger(l, ptr);						 // [t] [refs] [key]
-							lua_pushvalue(l, -3);							 // [t] [refs] [key] [t]
-							lua_rawset(l, -3);								 // [t] [refs]
-							lua_pop(l, 1);									 // [t]
-						}
-					}
-				}
+				if (value.count("table"))
+					unserialize_class(l, cl, ptr);
 				LUA_DEBUG_CHECK(l, 1);
 			}
 		}
@@ -344,6 +465,261 @@ void LuaSerializer::unpickle_json(lua_State *l, const Json &value)
 	LUA_DEBUG_END(l, 1);
 }
 
+void LuaSerializer::pickle_binary(lua_State *l, int to_serialize, std::string &out, std::string &key)
+{
+	LUA_DEBUG_START(l);
+
+	// tables are pickled recursively, so we can run out of Lua stack space if we're not careful
+	// start by ensuring we have enough (this grows the stack if necessary)
+	// (20 is somewhat arbitrary)
+	if (!lua_checkstack(l, 20))
+		luaL_error(l, "The Lua stack couldn't be extended (out of memory?)");
+
+	to_serialize = lua_absindex(l, to_serialize);
+	int idx = to_serialize;
+	const char *cl = nullptr;
+
+	if (lua_getmetatable(l, idx)) {
+		lua_getfield(l, -1, "class");
+		if (lua_isnil(l, -1))
+			lua_pop(l, 2);
+
+		else {
+			cl = lua_tostring(l, -1);
+
+			lua_getfield(l, LUA_REGISTRYINDEX, NS_CLASSES);
+
+			lua_getfield(l, -1, cl);
+			if (lua_isnil(l, -1))
+				luaL_error(l, "Class '%s' not registered for serialization\n", cl);
+
+			lua_getfield(l, -1, "Serialize");
+			if (lua_isnil(l, -1))
+				luaL_error(l, "No Serialize method found for class '%s'\n", cl);
+
+			lua_pushvalue(l, idx);
+			pi_lua_protected_call(l, 1, 1);
+
+			idx = lua_gettop(l);
+		}
+	}
+
+	switch (lua_type(l, idx)) {
+	case LUA_TNIL:
+		out.push_back(TAG_NIL);
+		break;
+
+	case LUA_TBOOLEAN:
+		out.push_back(lua_toboolean(l, idx) ? TAG_TRUE : TAG_FALSE);
+		break;
+
+	case LUA_TSTRING: {
+		size_t len;
+		const char *str = lua_tolstring(l, idx, &len);
+		out.push_back(TAG_STRING);
+		write_bytes(out, str, len);
+		break;
+	}
+
+	case LUA_TNUMBER:
+		write_number(out, lua_tonumber(l, idx));
+		break;
+
+	case LUA_TTABLE: {
+		lua_Integer ptr = lua_Integer(lua_topointer(l, to_serialize));
+		lua_getfield(l, LUA_REGISTRYINDEX, NS_REFTABLE); // reftable
+		lua_pushinteger(l, ptr);						 // reftable ptr
+		lua_rawget(l, -2);								 // reftable ???
+
+		if (!lua_isnil(l, -1)) {
+			lua_pop(l, 2); // [empty]
+			out.push_back(TAG_REF);
+			write_varint(out, uint64_t(ptr));
+			break;
+		}
+
+		lua_pop(l, 1);					// reftable
+		lua_pushinteger(l, ptr);		// reftable ptr
+		lua_pushvalue(l, to_serialize); // reftable ptr table
+		lua_rawset(l, -3);				// reftable
+		lua_pop(l, 1);					// [empty]
+
+		if (cl) {
+			out.push_back(TAG_CLASS);
+			write_bytes(out, cl, strlen(cl));
+		}
+		out.push_back(TAG_TABLE);
+		write_varint(out, uint64_t(ptr));
+
+		const size_t keyLen = key.size();
+		lua_pushvalue(l, idx);
+		lua_pushnil(l);
+		while (lua_next(l, -2)) {
+			lua_pushvalue(l, -2);
+			const char *k = lua_tostring(l, -1);
+			key += '.';
+			if (k)
+				key += k;
+			else
+				key.append("<").append(lua_typename(l, lua_type(l, -1))).append(">");
+			lua_pop(l, 1);
+
+			pickle_binary(l, -2, out, key);
+			pickle_binary(l, -1, out, key);
+			key.resize(keyLen);
+
+			lua_pop(l, 1);
+		}
+		lua_pop(l, 1);
+
+		out.push_back(TAG_END);
+		break;
+	}
+
+	case LUA_TUSERDATA: {
+		lua_pushvalue(l, idx);
+		Json obj = Json::object();
+		if (LuaObjectBase::SerializeToJson(l, obj)) {
+			const std::vector<uint8_t> cbor = Json::to_cbor(obj);
+			out.push_back(TAG_USERDATA);
+			write_bytes(out, reinterpret_cast<const char *>(cbor.data()), cbor.size());
+		} else {
+			Log::Error("Lua serializer '{}' tried to serialize an invalid object\n"
+					   "The save file may be invalid.\n",
+				key);
+			out.push_back(TAG_NIL);
+		}
+
+		lua_pop(l, 1);
+		break;
+	}
+
+	default:
+		Log::Error("Lua serializer '{}' tried to serialize {} value", key, lua_typename(l, lua_type(l, idx)));
+		out.push_back(TAG_NIL);
+		break;
+	}
+
+	if (idx != to_serialize) // It means we called a transformation function on the data, so we clean it up.
+		lua_pop(l, 5);
+
+	LUA_DEBUG_END(l, 0);
+}
+
+void LuaSerializer::unpickle_binary(lua_State *l, const char *&pos, const char *end)
+{
+	LUA_DEBUG_START(l);
+
+	// tables are also unpickled recursively, so we can run out of Lua stack space if we're not careful
+	// start by ensuring we have enough (this grows the stack if necessary)
+	// (20 is somewhat arbitrary)
+	if (!lua_checkstack(l, 20))
+		luaL_error(l, "The Lua stack couldn't be extended (not enough memory?)");
+
+	uint8_t tag = read_tag(pos, end);
+	std::string cl;
+	if (tag == TAG_CLASS) {
+		size_t len;
+		const char *name = read_bytes(pos, end, len);
+		cl.assign(name, len);
+		tag = read_tag(pos, end);
+		if (tag != TAG_TABLE)
+			throw SavedGameCorruptException();
+	}
+
+	switch (tag) {
+	case TAG_NIL:
+		lua_pushnil(l);
+		break;
+
+	case TAG_FALSE:
+	case TAG_TRUE:
+		lua_pushboolean(l, tag == TAG_TRUE);
+		break;
+
+	case TAG_INT: {
+		const uint32_t zigzag = uint32_t(read_varint(pos, end));
+		lua_pushinteger(l, int32_t((zigzag >> 1) ^ (~(zigzag & 1) + 1)));
+		break;
+	}
+
+	case TAG_DOUBLE:
+		lua_pushnumber(l, read_double(pos, end));
+		break;
+
+	case TAG_STRING: {
+		size_t len;
+		const char *str = read_bytes(pos, end, len);
+		lua_pushlstring(l, str, len);
+		break;
+	}
+
+	case TAG_USERDATA: {
+		size_t len;
+		const char *data = read_bytes(pos, end, len);
+		Json obj;
+		try {
+			obj = Json::from_cbor(data, data + len);
+		} catch (Json::exception &) {
+			throw SavedGameCorruptException();
+		}
+		if (!LuaObjectBase::DeserializeFromJson(l, obj))
+			throw SavedGameCorruptException();
+		break;
+	}
+
+	case TAG_REF: {
+		// Reference to a previously-pickled table.
+		lua_Integer ptr = lua_Integer(read_varint(pos, end));
+		lua_getfield(l, LUA_REGISTRYINDEX, NS_REFTABLE); // [refs]
+		lua_pushinteger(l, ptr);						 // [refs] [key]
+		lua_rawget(l, -2);								 // [refs] [out]
+
+		if (lua_isnil(l, -1))
+			throw SavedGameCorruptException();
+
+		lua_remove(l, -2); // [out]
+		break;
+	}
+
+	case TAG_TABLE: {
+		lua_Integer ptr = lua_Integer(read_varint(pos, end));
+		lua_newtable(l);
+
+		lua_getfield(l, LUA_REGISTRYINDEX, NS_REFTABLE); // [t] [refs]
+		lua_pushinteger(l, ptr);						 // [t] [refs] [key]
+		lua_pushvalue(l, -3);							 // [t] [refs] [key] [t]
+		lua_rawset(l, -3);								 // [t] [refs]
+		lua_pop(l, 1);									 // [t]
+
+		while (true) {
+			if (pos >= end)
+				throw SavedGameCorruptException();
+			if (uint8_t(*pos) == TAG_END)
+				break;
+
+			unpickle_binary(l, pos, end);
+			unpickle_binary(l, pos, end);
+			// a key whose serializer failed can't be stored
+			if (lua_isnil(l, -2))
+				lua_pop(l, 2);
+			else
+				lua_rawset(l, -3);
+		}
+		pos++;
+
+		if (!cl.empty())
+			unserialize_class(l, cl.c_str(), ptr);
+		break;
+	}
+
+	default:
+		throw SavedGameCorruptException();
+	}
+
+	LUA_DEBUG_END(l, 1);
+}
+
 void LuaSerializer::InitTableRefs()
 {
 	lua_State *l = Lua::manager->GetLuaState();
@@ -491,9 +867,10 @@ void LuaSerializer::ToJson(Json &jsonObj)
 
 	lua_pop(l, 1);
 
-	Json pickled;
-	pickle_json(l, savetable, pickled);
-	jsonObj["lua_modules_json"] = std::move(pickled);
+	std::string pickled;
+	std::string key;
+	pickle_binary(l, savetable, pickled, key);
+	BinStrToJson(jsonObj["lua_modules_bin"], pickled);
 
 	lua_pop(l, 1);
 
@@ -507,7 +884,15 @@ void LuaSerializer::FromJson(const Json &jsonObj)
 
 	LUA_DEBUG_START(l);
 
-	if (jsonObj.count("lua_modules_json")) {
+	if (jsonObj.count("lua_modules_bin")) {
+		const std::string pickled = JsonToBinStr(jsonObj["lua_modules_bin"]);
+		const char *pos = pickled.data();
+		const char *end = pos + pickled.size();
+		unpickle_binary(l, pos, end);
+		if (pos != end)
+			throw SavedGameCorruptException();
+	} else if (jsonObj.count("lua_modules_json")) {
+		// saves from before the binary pickler
 		const Json &value = jsonObj["lua_modules_json"];
 		if (!value.is_object()) {
 			throw SavedGameCorruptException();
@@ -37,6 +37,14 @@ private:
 
 	static void pickle_json(lua_State *l, int idx, Json &out, const std::string &key = "");
 	static void unpickle_json(lua_State *l, const Json &value);
+
+	// Write the value straight from the stack to a compact binary stream
+	// appended to out, without building a Json document first. key is the
+	// path of the value for error messages; it is restored on return.
+	static void pickle_binary(lua_State *l, int idx, std::string &out, std::string &key);
+	// Read one value written by pickle_binary from [pos, end) and push it;
+	// pos is left after the value.
+	static void unpickle_binary(lua_State *l, const char *&pos, const char *end);
 };
 
 #endif
@@ -9,19 +9,25 @@
 #include "Game.h"
 #include "HyperspaceCloud.h"
 #include "LuaBody.h"
+#include "LuaConstants.h"
 #include "LuaManager.h"
 #include "LuaObject.h"
+#include "LuaPropertyMap.h"
 #include "LuaUtils.h"
 #include "LuaVector.h"
 #include "MathUtil.h"
+#include "ModelBody.h"
 #include "Pi.h"
 #include "Planet.h"
 #include "Player.h"
+#include "Sensors.h"
 #include "Ship.h"
 #include "Space.h"
 #include "SpaceStation.h"
+#include "TrafficPool.h"
+#include "collider/CollisionContact.h"
+#include "collider/CollisionSpace.h"
 #include "profiler/Profiler.h"
-#include "ship/PrecalcPath.h"
 
 /*
  * Interface: Space
@@ -211,10 +217,6 @@ static int l_space_spawn_ship(lua_State *l)
 	return 1;
 }
 
-// functions from ShipAiCmd.cpp
-extern int CheckCollision(DynamicBody *dBody, const vector3d &pathdir, double pathdist, double targAlt, double endvel, double r);
-extern double MaxEffectRad(const Body *body, Propulsion *prop);
-
 /*
  * Function: PutShipOnRoute
  *
@@ -258,66 +260,7 @@ static int l_space_put_ship_on_route(lua_State *l)
 	Ship *ship = LuaObject<Ship>::CheckFromLua(1);
 	const Body *targetbody = LuaObject<Body>::CheckFromLua(2);
 	const double t_ratio = LuaPull<double>(l, 3);
-	const ShipType *st = ship->GetShipType();
-	const shipstats_t ss = ship->GetStats();
-	const vector3d route = targetbody->GetPositionRelTo(ship->GetFrame()) - ship->GetPosition();
-	PrecalcPath pp(
-		route.Length(), // distance
-		0.0,			// velocity at start
-		st->effectiveExhaustVelocity,
-		st->linThrust[THRUSTER_FORWARD],
-		st->linAccelerationCap[THRUSTER_FORWARD],
-		1000 * (ss.static_mass + ss.fuel_tank_mass_left), // 100% mass of the ship
-		1000 * ss.fuel_tank_mass_left * 0.8,			  // multipied to 0.8 have fuel reserve
-		0.85);											  // braking margin
-	// determine the place of the ship on the route
-	pp.setTRatio(t_ratio);
-	ship->SetPosition(ship->GetPosition() + route.Normalized() * pp.getDist());
-	ship->SetVelocity(route.Normalized() * pp.getVel() + targetbody->GetVelocityRelTo(ship->GetFrame()));
-	ship->SetFuel((0.001 * pp.getMass() - ss.static_mass) / st->fuelTankMass);
-
-	ship->UpdateFrame();
-	// check for collision at spawn position
-	const vector3d shippos = ship->GetPosition();
-	const vector3d targpos = targetbody->GetPositionRelTo(ship->GetFrame());
-	double targAlt = targpos.Length();
-	const vector3d relpos = targpos - shippos;
-	const vector3d reldir = relpos.NormalizedSafe();
-	const double targdist = relpos.Length();
-	Body *body = Frame::GetFrame(ship->GetFrame())->GetBody();
-	const double erad = MaxEffectRad(body, ship->GetPropulsion());
-	const int coll = CheckCollision(ship, reldir, targdist, targAlt, 0, erad);
-	if (coll) {
-		// need to correct positon, to avoid collision
-		if (targAlt > erad) {
-			// target is above the effective radius of obstructor - rotate the ship's position
-			// around the target position, so that the obstructor's "effective radius" does not cross the path
-			// direction obstructor -> target
-			const vector3d z = targpos / targAlt;
-			// the axis around which the position of the ship will rotate
-			const vector3d y = z.Cross(shippos).NormalizedSafe();
-			// just the third axis of this basis
-			const vector3d x = y.Cross(z);
-
-			// this is the basis in which the position of the ship will rotate
-			const matrix3x3d corrCS = matrix3x3d::FromVectors(x, y, z).Transpose();
-			const double len = targAlt;
-			// two possible positions of the ship, when flying around the obstructor to the right or left
-			// rotate (in the given basis) the direction from the target to the obstructor, so that it passes tangentially to the obstructor
-			const vector3d safe1 = corrCS.Transpose() * (matrix3x3d::RotateY(+asin(erad / len)) * corrCS * -targpos).Normalized() * targdist;
-			const vector3d safe2 = corrCS.Transpose() * (matrix3x3d::RotateY(-asin(erad / len)) * corrCS * -targpos).Normalized() * targdist;
-			// choose the one that is closer to the current position of the ship
-			if ((safe1 + relpos).Length() < (safe2 + relpos).Length())
-				ship->SetPosition(safe1 + targpos);
-			else
-				ship->SetPosition(safe2 + targpos);
-		} else {
-			// target below the effective radius of obstructor. Position the ship direct above the target
-			ship->SetPosition(targpos + targpos / targAlt * targdist);
-		}
-		// update velocity direction
-		ship->SetVelocity((targpos - ship->GetPosition()).Normalized() * pp.getVel() + targetbody->GetVelocityRelTo(ship->GetFrame()));
-	}
+	Space::PutShipOnRoute(ship, targetbody, t_ratio);
 	LUA_DEBUG_END(l, 1);
 	return 0;
 }
@@ -1128,6 +1071,594 @@ static int l_space_get_bodies_near(lua_State *l)
 	return 1;
 }
 
+namespace {
+	// A Space.FindBodies filter, pulled from its table once and then tested
+	// against every candidate body without going back to Lua
+	struct BodyFilter {
+		enum CompareOp {
+			CMP_EQ,
+			CMP_NE,
+			CMP_LT,
+			CMP_LE,
+			CMP_GT,
+			CMP_GE
+		};
+
+		struct PropertyTest {
+			StringName key;
+			CompareOp op;
+			Property value;
+		};
+
+		ObjectType type = ObjectType::BODY;
+		Body *near = nullptr;
+		double radius = -1.0;
+		FrameId frame;
+		int iff = -1;
+		int docked = -1;
+		std::vector<PropertyTest> properties;
+		bool sort = false;
+		size_t limit = 0;
+
+		bool Matches(Body *b) const;
+	};
+
+	bool CompareProperty(const Property &a, BodyFilter::CompareOp op, const Property &b)
+	{
+		if (a.is_number() && b.is_number()) {
+			const double x = a.get_number(), y = b.get_number();
+			switch (op) {
+			case BodyFilter::CMP_EQ: return x == y;
+			case BodyFilter::CMP_NE: return x != y;
+			case BodyFilter::CMP_LT: return x < y;
+			case BodyFilter::CMP_LE: return x <= y;
+			case BodyFilter::CMP_GT: return x > y;
+			case BodyFilter::CMP_GE: return x >= y;
+			}
+		}
+
+		// everything else only compares for equality, and a property the
+		// body doesn't have equals nothing
+		bool equal = false;
+		if (a.is_bool() && b.is_bool())
+			equal = a.get_bool() == b.get_bool();
+		else if (a.is_string() && b.is_string())
+			equal = a.get_string() == b.get_string();
+
+		if (op == BodyFilter::CMP_EQ)
+			return equal;
+		if (op == BodyFilter::CMP_NE)
+			return !a.is_null() && !equal;
+		return false;
+	}
+
+	bool BodyFilter::Matches(Body *b) const
+	{
+		if (type != ObjectType::BODY && !b->IsType(type))
+			return false;
+
+		if (frame.valid() && b->GetFrame() != frame)
+			return false;
+
+		if (docked >= 0) {
+			const bool isDocked = b->IsType(ObjectType::SHIP) && static_cast<Ship *>(b)->GetDockedWith();
+			if (isDocked != bool(docked))
+				return false;
+		}
+
+		if (iff >= 0) {
+			if (b == near)
+				return false;
+			if (static_cast<Ship *>(near)->GetSensors()->CheckIFF(b) != Sensors::IFF(iff))
+				return false;
+		}
+
+		for (const PropertyTest &test : properties) {
+			if (!CompareProperty(b->Properties().Get(test.key), test.op, test.value))
+				return false;
+		}
+
+		return true;
+	}
+
+	BodyFilter::CompareOp PullCompareOp(lua_State *l, int index)
+	{
+		const std::string_view op = LuaPull<std::string_view>(l, index);
+		if (op == "==") return BodyFilter::CMP_EQ;
+		if (op == "~=") return BodyFilter::CMP_NE;
+		if (op == "<") return BodyFilter::CMP_LT;
+		if (op == "<=") return BodyFilter::CMP_LE;
+		if (op == ">") return BodyFilter::CMP_GT;
+		if (op == ">=") return BodyFilter::CMP_GE;
+		luaL_error(l, "unknown comparison '%s' in body filter", std::string(op).c_str());
+		return BodyFilter::CMP_EQ;
+	}
+
+	// pushes the field of the table at index, and whether it is set
+	bool GetFilterField(lua_State *l, int index, const char *name)
+	{
+		lua_getfield(l, index, name);
+		if (lua_isnil(l, -1)) {
+			lua_pop(l, 1);
+			return false;
+		}
+		return true;
+	}
+
+	BodyFilter PullBodyFilter(lua_State *l, int index)
+	{
+		luaL_checktype(l, index, LUA_TTABLE);
+
+		BodyFilter filter;
+		if (GetFilterField(l, index, "type")) {
+			filter.type = LuaPull<ObjectType>(l, -1);
+			lua_pop(l, 1);
+		}
+		if (GetFilterField(l, index, "near")) {
+			filter.near = LuaPull<Body *>(l, lua_gettop(l));
+			lua_pop(l, 1);
+		}
+		if (GetFilterField(l, index, "radius")) {
+			filter.radius = LuaPull<double>(l, -1);
+			lua_pop(l, 1);
+		}
+		if (GetFilterField(l, index, "frame")) {
+			filter.frame = LuaPull<Body *>(l, lua_gettop(l))->GetFrame();
+			lua_pop(l, 1);
+		}
+		if (GetFilterField(l, index, "iff")) {
+			filter.iff = LuaConstants::GetConstantFromArg(l, "SensorsIFF", -1);
+			lua_pop(l, 1);
+		}
+		if (GetFilterField(l, index, "docked")) {
+			filter.docked = lua_toboolean(l, -1);
+			lua_pop(l, 1);
+		}
+		if (GetFilterField(l, index, "sort")) {
+			filter.sort = lua_toboolean(l, -1);
+			lua_pop(l, 1);
+		}
+		if (GetFilterField(l, index, "limit")) {
+			filter.limit = std::max(LuaPull<int>(l, -1), 0);
+			lua_pop(l, 1);
+		}
+
+		if (GetFilterField(l, index, "properties")) {
+			const int props = lua_gettop(l);
+			luaL_checktype(l, props, LUA_TTABLE);
+			lua_pushnil(l);
+			while (lua_next(l, props)) {
+				BodyFilter::PropertyTest test;
+				test.key = LuaPull<StringName>(l, -2);
+				if (lua_istable(l, -1)) {
+					// { op, value }
+					lua_rawgeti(l, -1, 1);
+					test.op = PullCompareOp(l, lua_gettop(l));
+					lua_rawgeti(l, -2, 2);
+					test.value = LuaPull<Property>(l, lua_gettop(l));
+					lua_pop(l, 2);
+				} else {
+					test.op = BodyFilter::CMP_EQ;
+					test.value = LuaPull<Property>(l, lua_gettop(l));
+				}
+				filter.properties.push_back(std::move(test));
+				lua_pop(l, 1);
+			}
+			lua_pop(l, 1);
+		}
+
+		if ((filter.radius >= 0.0 || filter.sort) && !filter.near)
+			luaL_error(l, "body filter needs a near body for radius or sort");
+		if (filter.iff >= 0 && !(filter.near && filter.near->IsType(ObjectType::SHIP)))
+			luaL_error(l, "body filter needs a near ship for iff");
+
+		return filter;
+	}
+} // namespace
+
+/*
+ * Function: FindBodies
+ *
+ * Get the <Body> objects that match a filter. The filter is tested for
+ * every body without calling back into Lua, and a radius only looks at the
+ * bodies near enough to be in range, so this is much faster than filtering
+ * the result of <GetBodies> in Lua.
+ *
+ * bodies = Space.FindBodies(filter)
+ *
+ * Parameters:
+ *
+ *   filter - a table with any of the following fields. A body must match
+ *            all of the fields that are set.
+ *
+ *     type - a PhysicsObjectType enum value or Body classname, as for
+ *            <GetBodies>
+ *
+ *     near - a reference <Body> for radius, iff and sort
+ *
+ *     radius - the maximum distance from near
+ *
+ *     frame - a <Body> whose frame of reference the bodies must be in
+ *
+ *     iff - a SensorsIFF enum value (one of Constants.SensorsIFF) that the
+ *           bodies must be to near, which must be a <Ship>. near itself
+ *           never matches.
+ *
+ *     docked - true for only ships that are docked or landed at a station,
+ *              false for only bodies that aren't
+ *
+ *     properties - a table of property name to value. A value matches a
+ *                  property equal to it; a table { op, value } compares
+ *                  the property to value with op, one of "==", "~=", "<",
+ *                  "<=", ">" or ">=". Only numbers compare with anything
+ *                  but "==" and "~=".
+ *
+ *     sort - true to return the bodies nearest to near first
+ *
+ *     limit - the most bodies to return
+ *
+ * Return:
+ *
+ *   bodies - an array containing zero or more <Body> objects that matched the
+ *            filter
+ *
+ * Example:
+ *
+ * > -- the five nearest hostile ships within 20km that are losing hull
+ * > local ships = Space.FindBodies({
+ * >     type = "SHIP", near = Game.player, radius = 20000, iff = "HOSTILE",
+ * >     properties = { hullPercent = { "<", 50 } }, sort = true, limit = 5
+ * > })
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_space_find_bodies(lua_State *l)
+{
+	PROFILE_SCOPED()
+
+	if (!Pi::game) {
+		luaL_error(l, "Game is not started");
+		return 0;
+	}
+
+	LUA_DEBUG_START(l);
+
+	const BodyFilter filter = PullBodyFilter(l, 1);
+	Space *space = Pi::game->GetSpace();
+
+	// matches with their distance from near, squared
+	std::vector<std::pair<double, Body *>> matches;
+	const auto test = [&](Body *b) {
+		if (!filter.Matches(b))
+			return;
+		const double distSqr = filter.near ? b->GetPositionRelTo(filter.near).LengthSqr() : 0.0;
+		if (filter.radius >= 0.0 && distSqr > filter.radius * filter.radius)
+			return;
+		matches.emplace_back(distSqr, b);
+	};
+
+	if (filter.radius >= 0.0) {
+		for (Body *b : space->GetBodiesMaybeNear(filter.near, filter.radius))
+			test(b);
+	} else {
+		for (Body *b : space->GetBodies())
+			test(b);
+	}
+
+	size_t count = matches.size();
+	if (filter.limit)
+		count = std::min(count, filter.limit);
+	if (filter.sort) {
+		const auto nearer = [](const std::pair<double, Body *> &a, const std::pair<double, Body *> &b) { return a.first < b.first; };
+		std::partial_sort(matches.begin(), matches.begin() + count, matches.end(), nearer);
+	}
+
+	lua_createtable(l, int(count), 0);
+	for (size_t i = 0; i < count; i++) {
+		lua_pushinteger(l, i + 1);
+		LuaObject<Body>::PushToLua(matches[i].second);
+		lua_rawset(l, -3);
+	}
+
+	LUA_DEBUG_END(l, 1);
+
+	return 1;
+}
+
+/*
+ * Function: TraceRays
+ *
+ * Trace rays from a body towards a list of targets, and find the first
+ * body each ray hits. All rays are traced together, which is much faster
+ * than checking each target on its own.
+ *
+ * hits = Space.TraceRays(body, targets)
+ *
+ * Parameters:
+ *
+ *   body - the <Body> the rays start from. The body itself is never hit.
+ *
+ *   targets - an array of target <Bodies> or positions. Positions are
+ *             <Vector3> values relative to the frame of reference of body.
+ *
+ * Return:
+ *
+ *   hits - an array with one entry per target, holding the first <Body> hit
+ *          on the way to the target, or false if nothing was hit. A body
+ *          target is visible from body if its entry is the target itself.
+ *
+ * Example:
+ *
+ * > -- which of these ships can the player see?
+ * > local hits = Space.TraceRays(Game.player, ships)
+ * > for i, ship in ipairs(ships) do
+ * >     local visible = hits[i] == ship
+ * > end
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_space_trace_rays(lua_State *l)
+{
+	PROFILE_SCOPED()
+
+	if (!Pi::game) {
+		luaL_error(l, "Game is not started");
+		return 0;
+	}
+
+	LUA_DEBUG_START(l);
+
+	Body *body = LuaPull<Body *>(l, 1);
+	luaL_checktype(l, 2, LUA_TTABLE);
+
+	const FrameId frameId = body->GetFrame();
+	CollisionSpace *space = Frame::GetFrame(frameId)->GetCollisionSpace();
+	const Geom *ignore = body->IsType(ObjectType::MODELBODY) ? static_cast<ModelBody *>(body)->GetGeom() : nullptr;
+
+	const size_t numRays = lua_rawlen(l, 2);
+	std::vector<vector3d> starts(numRays, body->GetPosition());
+	std::vector<vector3d> dirs(numRays);
+	std::vector<double> lens(numRays);
+
+	for (size_t idx = 0; idx < numRays; idx++) {
+		lua_rawgeti(l, 2, idx + 1);
+
+		vector3d target;
+		if (Body *targetBody = LuaObject<Body>::GetFromLua(-1))
+			target = targetBody->GetPositionRelTo(frameId);
+		else
+			target = *LuaVector::CheckFromLua(l, -1);
+
+		lua_pop(l, 1);
+
+		const vector3d delta = target - starts[idx];
+		lens[idx] = delta.Length();
+		dirs[idx] = lens[idx] > 0.0 ? delta / lens[idx] : vector3d(0.0, 0.0, 1.0);
+	}
+
+	std::vector<CollisionContact> contacts(numRays);
+	space->TraceRays(numRays, starts.data(), dirs.data(), lens.data(), contacts.data(), ignore);
+
+	lua_createtable(l, numRays, 0);
+	for (size_t idx = 0; idx < numRays; idx++) {
+		lua_pushinteger(l, idx + 1);
+		if (contacts[idx].userData1)
+			LuaObject<Body>::PushToLua(static_cast<Body *>(contacts[idx].userData1));
+		else
+			lua_pushboolean(l, false);
+		lua_rawset(l, -3);
+	}
+
+	LUA_DEBUG_END(l, 1);
+
+	return 1;
+}
+
+/*
+ * Function: AddTraffic
+ *
+ * Have a ship fly between two stations of the system, without it being a
+ * body while the player is far from it. The ship is made when the player
+ * comes within <TrafficPool> range of where it would be: docked at from
+ * before departure, or on its way to to after it.
+ *
+ * > id = Space.AddTraffic(type, from, to, departure, arrival)
+ *
+ * Parameters:
+ *
+ *   type - the name of the ship
+ *
+ *   from - the <SpaceStation> the ship leaves from
+ *
+ *   to - the <SpaceStation> the ship docks at
+ *
+ *   departure - the game time the ship leaves
+ *
+ *   arrival - the game time the ship docks
+ *
+ * Return:
+ *
+ *   id - the number of the journey, given again by the events
+ *        onTrafficShipSpawned(id, ship), onTrafficArrived(id, station) and
+ *        onTrafficShipLost(id)
+ *
+ * Example:
+ *
+ * > local id = Space.AddTraffic("kanara", here, there, Game.time + 60, Game.time + 3600)
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_space_add_traffic(lua_State *l)
+{
+	if (!Pi::game)
+		luaL_error(l, "Game is not started");
+
+	LUA_DEBUG_START(l);
+
+	const char *type = luaL_checkstring(l, 1);
+	if (!ShipType::Get(type))
+		luaL_error(l, "Unknown ship type '%s'", type);
+
+	SpaceStation *from = LuaObject<SpaceStation>::CheckFromLua(2);
+	SpaceStation *to = LuaObject<SpaceStation>::CheckFromLua(3);
+	const double departure = luaL_checknumber(l, 4);
+	const double arrival = luaL_checknumber(l, 5);
+
+	const TrafficPool::Id id = Pi::game->GetSpace()->GetTraffic()->Add(type, from, to, departure, arrival);
+	lua_pushinteger(l, id);
+
+	LUA_DEBUG_END(l, 1);
+
+	return 1;
+}
+
+/*
+ * Function: GetTraffic
+ *
+ * Get the journey of a ship added with <AddTraffic>.
+ *
+ * > journey = Space.GetTraffic(id)
+ *
+ * Parameters:
+ *
+ *   id - the number <AddTraffic> gave the journey
+ *
+ * Return:
+ *
+ *   journey - a table with the fields shipType, from, to, departure, arrival
+ *             and, while the journey is a body, ship; or nil once the
+ *             journey is over
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_space_get_traffic(lua_State *l)
+{
+	if (!Pi::game)
+		luaL_error(l, "Game is not started");
+
+	LUA_DEBUG_START(l);
+
+	const TrafficPool::Record *record = Pi::game->GetSpace()->GetTraffic()->Get(luaL_checkinteger(l, 1));
+	if (!record) {
+		lua_pushnil(l);
+		LUA_DEBUG_END(l, 1);
+		return 1;
+	}
+
+	lua_newtable(l);
+	pi_lua_settable(l, "shipType", record->shipType.c_str());
+	LuaObject<SpaceStation>::PushToLua(record->from);
+	lua_setfield(l, -2, "from");
+	LuaObject<SpaceStation>::PushToLua(record->to);
+	lua_setfield(l, -2, "to");
+	pi_lua_settable(l, "departure", record->departure);
+	pi_lua_settable(l, "arrival", record->arrival);
+	if (record->ship) {
+		LuaObject<Ship>::PushToLua(record->ship);
+		lua_setfield(l, -2, "ship");
+	}
+
+	LUA_DEBUG_END(l, 1);
+
+	return 1;
+}
+
+/*
+ * Function: GetTrafficShip
+ *
+ * Get the ship of a journey added with <AddTraffic>, if it is a body now.
+ *
+ * > ship = Space.GetTrafficShip(id)
+ *
+ * Parameters:
+ *
+ *   id - the number <AddTraffic> gave the journey
+ *
+ * Return:
+ *
+ *   ship - the <Ship>, or nil while the player is too far away for there to
+ *          be one, or once the journey is over
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_space_get_traffic_ship(lua_State *l)
+{
+	if (!Pi::game)
+		luaL_error(l, "Game is not started");
+
+	LUA_DEBUG_START(l);
+
+	const TrafficPool::Record *record = Pi::game->GetSpace()->GetTraffic()->Get(luaL_checkinteger(l, 1));
+	if (record && record->ship)
+		LuaObject<Ship>::PushToLua(record->ship);
+	else
+		lua_pushnil(l);
+
+	LUA_DEBUG_END(l, 1);
+
+	return 1;
+}
+
+/*
+ * Function: RemoveTraffic
+ *
+ * Forget a journey added with <AddTraffic>. A ship that is a body now is
+ * left to whatever it was doing.
+ *
+ * > Space.RemoveTraffic(id)
+ *
+ * Parameters:
+ *
+ *   id - the number <AddTraffic> gave the journey
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_space_remove_traffic(lua_State *l)
+{
+	if (!Pi::game)
+		luaL_error(l, "Game is not started");
+
+	Pi::game->GetSpace()->GetTraffic()->Remove(luaL_checkinteger(l, 1));
+
+	return 0;
+}
+
 static int l_space_dump_frames(lua_State *l)
 {
 	if (!Pi::game) {
@@ -1180,6 +1711,13 @@ void LuaSpace::Register()
 		{ "GetNumBodies", l_space_get_num_bodies },
 		{ "GetBodies", l_space_get_bodies },
 		{ "GetBodiesNear", l_space_get_bodies_near },
+		{ "FindBodies", l_space_find_bodies },
+		{ "TraceRays", l_space_trace_rays },
+
+		{ "AddTraffic", l_space_add_traffic },
+		{ "GetTraffic", l_space_get_traffic },
+		{ "GetTrafficShip", l_space_get_traffic_ship },
+		{ "RemoveTraffic", l_space_remove_traffic },
 
 		{ "DbgDumpFrames", l_space_dump_frames },
 		{ 0, 0 }
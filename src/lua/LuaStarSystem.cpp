@@ -65,9 +65,10 @@ static int l_starsystem_get_station_paths(lua_State *l)
 
 	lua_newtable(l);
 
-	for (const SystemBody *station : s->GetSpaceStations()) {
+	// from the body table, so that a compact system stays compact
+	for (Uint16 index : s->GetStationIndices()) {
 		lua_pushinteger(l, lua_rawlen(l, -1) + 1);
-		LuaObject<SystemPath>::PushToLua(&station->GetPath());
+		LuaObject<SystemPath>::PushToLua(s->GetBodyPath(index));
 		lua_rawset(l, -3);
 	}
 
@@ -104,9 +105,9 @@ static int l_starsystem_get_body_paths(lua_State *l)
 
 	lua_newtable(l);
 
-	for (RefCountedPtr<const SystemBody> sb : s->GetBodies()) {
+	for (Uint32 index = 0; index < s->GetNumBodies(); index++) {
 		lua_pushinteger(l, lua_rawlen(l, -1) + 1);
-		LuaObject<SystemPath>::PushToLua(&sb->GetPath());
+		LuaObject<SystemPath>::PushToLua(s->GetBodyPath(index));
 		lua_rawset(l, -3);
 	}
 
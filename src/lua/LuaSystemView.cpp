@@ -368,6 +368,91 @@ static int l_systemview_transfer_planner_reset(lua_State *l)
 	return 0;
 }
 
+// sv:TransferPlannerPorkchopStart(target, departSpan, minFlight, maxFlight, departSteps, flightSteps)
+static int l_systemview_transfer_planner_porkchop_start(lua_State *l)
+{
+	SystemView *sv = LuaObject<SystemView>::CheckFromLua(1);
+	Body *target = LuaObject<Body>::CheckFromLua(2);
+	const double departSpan = LuaPull<double>(l, 3);
+	const double minFlight = LuaPull<double>(l, 4);
+	const double maxFlight = LuaPull<double>(l, 5);
+	const int departSteps = LuaPull<int>(l, 6);
+	const int flightSteps = LuaPull<int>(l, 7);
+	if (departSteps <= 0 || flightSteps <= 0)
+		return luaL_error(l, "porkchop grid needs at least one step each way");
+
+	sv->GetTransferPlanner()->StartPorkchop(target, departSpan, minFlight, maxFlight, departSteps, flightSteps);
+	return 0;
+}
+
+static int l_systemview_transfer_planner_porkchop_cancel(lua_State *l)
+{
+	SystemView *sv = LuaObject<SystemView>::CheckFromLua(1);
+	sv->GetTransferPlanner()->CancelPorkchop();
+	return 0;
+}
+
+// the grid so far: { done, departTimes, flightTimes, dv }, where dv holds a
+// table of delta-v per flight time for each departure time that is done,
+// without the cells that have no transfer
+static int l_systemview_transfer_planner_porkchop_get(lua_State *l)
+{
+	SystemView *sv = LuaObject<SystemView>::CheckFromLua(1);
+	TransferPlanner *planner = sv->GetTransferPlanner();
+	if (!planner->HasPorkchop()) {
+		lua_pushnil(l);
+		return 1;
+	}
+
+	const unsigned departSteps = planner->GetPorkchopDepartSteps();
+	const unsigned flightSteps = planner->GetPorkchopFlightSteps();
+
+	LuaTable result(l, 0, 4);
+	result.Set("done", planner->IsPorkchopDone());
+
+	LuaTable departTimes(l, departSteps, 0);
+	for (unsigned i = 0; i < departSteps; i++)
+		departTimes.Set(i + 1, planner->GetPorkchopDepartTime(i));
+	result.Set("departTimes", departTimes);
+	lua_pop(l, 1);
+
+	LuaTable flightTimes(l, flightSteps, 0);
+	for (unsigned i = 0; i < flightSteps; i++)
+		flightTimes.Set(i + 1, planner->GetPorkchopFlightTime(i));
+	result.Set("flightTimes", flightTimes);
+	lua_pop(l, 1);
+
+	LuaTable dv(l, departSteps, 0);
+	for (unsigned i = 0; i < departSteps; i++) {
+		if (!planner->IsPorkchopRowDone(i))
+			continue;
+		LuaTable row(l, flightSteps, 0);
+		for (unsigned j = 0; j < flightSteps; j++) {
+			const float cell = planner->GetPorkchopDv(i, j);
+			if (!std::isnan(cell))
+				row.Set(j + 1, cell);
+		}
+		dv.Set(i + 1, row);
+		lua_pop(l, 1);
+	}
+	result.Set("dv", dv);
+	lua_pop(l, 1);
+	return 1;
+}
+
+// sv:TransferPlannerPorkchopApply(departIndex, flightIndex), 1-based
+static int l_systemview_transfer_planner_porkchop_apply(lua_State *l)
+{
+	SystemView *sv = LuaObject<SystemView>::CheckFromLua(1);
+	const int departIndex = LuaPull<int>(l, 2);
+	const int flightIndex = LuaPull<int>(l, 3);
+	bool applied = false;
+	if (departIndex > 0 && flightIndex > 0)
+		applied = sv->GetTransferPlanner()->ApplyPorkchop(departIndex - 1, flightIndex - 1);
+	LuaPush<bool>(l, applied);
+	return 1;
+}
+
 template <>
 const char *LuaObject<SystemView>::s_type = "SystemView";
 
@@ -399,6 +484,10 @@ void LuaObject<SystemView>::RegisterClass()
 		{ "TransferPlannerAdd", l_systemview_transfer_planner_add },
 		{ "TransferPlannerGet", l_systemview_transfer_planner_get },
 		{ "TransferPlannerReset", l_systemview_transfer_planner_reset },
+		{ "TransferPlannerPorkchopStart", l_systemview_transfer_planner_porkchop_start },
+		{ "TransferPlannerPorkchopCancel", l_systemview_transfer_planner_porkchop_cancel },
+		{ "TransferPlannerPorkchopGet", l_systemview_transfer_planner_porkchop_get },
+		{ "TransferPlannerPorkchopApply", l_systemview_transfer_planner_porkchop_apply },
 
 		{ NULL, NULL }
 	};
@@ -8,10 +8,34 @@
 #include "LuaUtils.h"
 #include "Pi.h"
 #include "profiler/Profiler.h"
+#include "utils.h"
 
 #include <algorithm>
 
-LuaTimer::LuaTimer()
+// Runs the callbacks of the elapsed timers in order, and returns whether
+// each of them asked to be cancelled
+static const char s_dispatcher[] =
+	"local timers = ...\n"
+	"local cancel = {}\n"
+	"for i = 1, #timers do\n"
+	"	cancel[i] = timers[i].callback() and true or false\n"
+	"end\n"
+	"return cancel\n";
+
+// the index of the lowest bit set in a non-zero mask
+static int lowest_bit(uint64_t mask)
+{
+	int bit = 0;
+	while (!(mask & 1)) {
+		mask >>= 1;
+		bit++;
+	}
+	return bit;
+}
+
+LuaTimer::LuaTimer() :
+	m_occupied(),
+	m_currentTick(0)
 {
 	m_called.reserve(8);
 }
@@ -22,15 +46,116 @@ LuaTimer::~LuaTimer()
 
 void LuaTimer::Insert(double at, int callbackId, bool repeats)
 {
-	CallInfo info { at, callbackId, repeats };
+	InsertTimeout({ at, callbackId, repeats });
+}
+
+void LuaTimer::InsertTimeout(const CallInfo &info)
+{
+	// timeouts that are already due go in the slot of the current tick
+	const uint64_t tick = std::max(uint64_t(std::max(info.at / TICK_LENGTH, 0.0)), m_currentTick);
+
+	const uint64_t diff = tick ^ m_currentTick;
+	int level = 0;
+	while (level + 1 < NUM_LEVELS && (diff >> (SLOT_BITS * (level + 1))))
+		level++;
+
+	const int slot = (tick >> (SLOT_BITS * level)) & (NUM_SLOTS - 1);
+	m_wheel[level][slot].push_back(info);
+	m_occupied[level] |= uint64_t(1) << slot;
+}
+
+bool LuaTimer::FindNextSlot(int &level, uint64_t &tick) const
+{
+	for (level = 0; level < NUM_LEVELS; level++) {
+		const int shift = SLOT_BITS * level;
+		const int digit = (m_currentTick >> shift) & (NUM_SLOTS - 1);
+
+		// the current slot only holds timeouts on the lowest level, the
+		// higher levels only hold the slots after it
+		uint64_t mask = m_occupied[level];
+		if (level == 0)
+			mask &= ~((uint64_t(1) << digit) - 1);
+		else
+			mask &= ~((uint64_t(2) << digit) - 1);
+
+		if (!mask)
+			continue;
+
+		// the same higher digits as the current tick, zero lower digits
+		const int blockShift = shift + SLOT_BITS;
+		const uint64_t block = blockShift < 64 ? (m_currentTick >> blockShift) << blockShift : 0;
+		tick = block | (uint64_t(lowest_bit(mask)) << shift);
+		return true;
+	}
+
+	return false;
+}
 
-	// Keep the queue sorted when inserting new elements.
-	// This is O(log N) + O(N/2) worst-case
-	auto iter = std::lower_bound(m_timeouts.cbegin(), m_timeouts.cend(), info, [](const CallInfo &timeout, const CallInfo &val) {
-		return timeout.at < val.at;
+bool LuaTimer::GetNextTimeoutBound(double &at) const
+{
+	// every timeout of a slot is due no earlier than the tick it starts at
+	int level;
+	uint64_t tick;
+	if (!FindNextSlot(level, tick))
+		return false;
+
+	at = tick * TICK_LENGTH;
+	return true;
+}
+
+void LuaTimer::CollectTimeouts(double now)
+{
+	const uint64_t nowTick = std::max(uint64_t(std::max(now / TICK_LENGTH, 0.0)), m_currentTick);
+
+	int level;
+	uint64_t tick;
+	while (FindNextSlot(level, tick) && tick <= nowTick) {
+		m_currentTick = tick;
+
+		const int slot = (tick >> (SLOT_BITS * level)) & (NUM_SLOTS - 1);
+		std::vector<CallInfo> timeouts;
+		timeouts.swap(m_wheel[level][slot]);
+		m_occupied[level] &= ~(uint64_t(1) << slot);
+
+		if (level > 0) {
+			// spread the slot over the lower levels
+			for (const CallInfo &info : timeouts)
+				InsertTimeout(info);
+			continue;
+		}
+
+		// the last tick can hold timeouts later than now
+		for (const CallInfo &info : timeouts) {
+			if (info.at <= now)
+				m_called.push_back(info);
+			else
+				InsertTimeout(info);
+		}
+
+		if (m_occupied[0] & (uint64_t(1) << slot))
+			break;
+	}
+
+	m_currentTick = nowTick;
+
+	// calls are made in the order they are due
+	std::stable_sort(m_called.begin(), m_called.end(), [](const CallInfo &a, const CallInfo &b) {
+		return a.at < b.at;
 	});
+}
+
+void LuaTimer::PushDispatcher(lua_State *l)
+{
+	lua_getfield(l, LUA_REGISTRYINDEX, "PiTimerDispatch");
+	if (!lua_isnil(l, -1))
+		return;
 
-	m_timeouts.insert(iter, std::move(info));
+	lua_pop(l, 1);
+	if (luaL_loadbuffer(l, s_dispatcher, sizeof(s_dispatcher) - 1, "=[timer dispatch]") != LUA_OK)
+		Error("%s\n", lua_tostring(l, -1));
+
+	lua_pushvalue(l, -1);
+	lua_setfield(l, LUA_REGISTRYINDEX, "PiTimerDispatch");
 }
 
 void LuaTimer::RemoveAll()
@@ -39,7 +164,14 @@ void LuaTimer::RemoveAll()
 
 	lua_pushnil(l);
 	lua_setfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
-	m_timeouts.clear();
+
+	for (int level = 0; level < NUM_LEVELS; level++) {
+		for (int slot = 0; slot < NUM_SLOTS; slot++)
+			m_wheel[level][slot].clear();
+		m_occupied[level] = 0;
+	}
+	// the next game can start earlier than this one
+	m_currentTick = 0;
 }
 
 void LuaTimer::Tick()
@@ -51,11 +183,8 @@ void LuaTimer::Tick()
 
 	double now = Pi::game->GetTime();
 
-	// Move called timeouts out of the list into our scratch buffer
-	while (!m_timeouts.empty() && m_timeouts.front().at <= now) {
-		m_called.push_back(m_timeouts.front());
-		m_timeouts.pop_front();
-	}
+	// Move called timeouts out of the wheel into our scratch buffer
+	CollectTimeouts(now);
 
 	if (m_called.empty())
 		return;
@@ -65,22 +194,31 @@ void LuaTimer::Tick()
 	luaL_getsubtable(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
 	int callbackRegistry = lua_gettop(l);
 
-	// Call each callback for the timeout and re-queue if appropriate
-	for (CallInfo &call : m_called) {
-		lua_rawgeti(l, callbackRegistry, call.callbackId);
-		lua_getfield(l, -1, "callback");
+	// Call all the callbacks at once
+	PushDispatcher(l);
+	lua_createtable(l, m_called.size(), 0);
+	for (size_t i = 0; i < m_called.size(); i++) {
+		lua_rawgeti(l, callbackRegistry, m_called[i].callbackId);
+		lua_rawseti(l, -2, i + 1);
+	}
+
+	pi_lua_protected_call(l, 1, 1);
+	int cancelled = lua_gettop(l);
 
-		pi_lua_protected_call(l, 0, 1);
+	// Re-queue the timers if appropriate
+	for (size_t i = 0; i < m_called.size(); i++) {
+		const CallInfo &call = m_called[i];
+		lua_rawgeti(l, cancelled, i + 1);
 		bool cancel = lua_toboolean(l, -1);
 		lua_pop(l, 1);
 
 		if (cancel || !call.repeats) {
 			// Cleanup and remove the callback info
-			lua_pop(l, 1);
 			luaL_unref(l, callbackRegistry, call.callbackId);
 			continue;
 		}
 
+		lua_rawgeti(l, callbackRegistry, call.callbackId);
 		lua_getfield(l, -1, "every");
 		double every = lua_tonumber(l, -1);
 		// will take into account that we could skip the appointed time,
@@ -98,7 +236,7 @@ void LuaTimer::Tick()
 
 	// Clear the scratch buffer
 	m_called.clear();
-	lua_pop(l, 1);
+	lua_pop(l, 2);
 
 	LUA_DEBUG_END(l, 0);
 }
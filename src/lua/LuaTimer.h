@@ -8,7 +8,8 @@
 #include "LuaManager.h"
 #include "JsonFwd.h"
 
-#include <deque>
+#include <cstdint>
+#include <vector>
 
 class LuaTimer : public DeleteEmitter {
 public:
@@ -20,6 +21,10 @@ public:
 	void Tick();
 	void RemoveAll();
 
+	// Sets at to a game time no later than the first timeout still to be
+	// called, if there is any
+	bool GetNextTimeoutBound(double &at) const;
+
 	// For internal use only
 	void Insert(double at, int callbackId, bool repeats);
 
@@ -34,8 +39,33 @@ private:
 		bool repeats;
 	};
 
-	// Queue of tracked 'timeout' entries
-	std::deque<CallInfo> m_timeouts;
+	/*
+	 * The timeouts are kept in a hierarchical timing wheel. Game time is
+	 * counted in ticks of TICK_LENGTH seconds, and each level of the wheel
+	 * has one slot per digit (of SLOT_BITS bits) of the tick number. A
+	 * timeout goes to the level of the highest digit its tick differs from
+	 * the current tick in. When the current tick reaches a slot on a higher
+	 * level, its timeouts are inserted again and end up on lower levels.
+	 */
+	static constexpr double TICK_LENGTH = 1.0;
+	static constexpr int SLOT_BITS = 6;
+	static constexpr int NUM_SLOTS = 1 << SLOT_BITS;
+	// enough levels for every digit of a 64-bit tick
+	static constexpr int NUM_LEVELS = (64 + SLOT_BITS - 1) / SLOT_BITS;
+
+	void InsertTimeout(const CallInfo &info);
+	// Move the timeouts due at the given time to m_called
+	void CollectTimeouts(double now);
+	// Find the lowest level with a timeout due after the current tick, and
+	// the tick its first slot starts at
+	bool FindNextSlot(int &level, uint64_t &tick) const;
+	// The callbacks of m_called are run by a single call to this function
+	void PushDispatcher(lua_State *l);
+
+	std::vector<CallInfo> m_wheel[NUM_LEVELS][NUM_SLOTS];
+	// bit n is set if slot n of the level has timeouts
+	uint64_t m_occupied[NUM_LEVELS];
+	uint64_t m_currentTick;
 	// Scratch buffer for timeouts that elapsed this update
 	std::vector<CallInfo> m_called;
 };
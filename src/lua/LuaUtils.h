@@ -76,6 +76,11 @@ void pi_lua_import_recursive(lua_State *L, const std::string &importName);
 int pi_lua_panic(lua_State *l) __attribute((noreturn));
 void pi_lua_protected_call(lua_State *state, int nargs, int nresults);
 int pi_lua_loadfile(lua_State *l, const FileSystem::FileData &code);
+// Keep the compiled chunks of the files loaded by pi_lua_loadfile in a cache
+// in the user dir, so they don't have to be compiled again on the next
+// start; 0 disables it
+void pi_lua_init_chunk_cache(size_t maxBytes);
+void pi_lua_uninit_chunk_cache();
 void pi_lua_dofile(lua_State *l, const std::string &path, int nret = 0);
 void pi_lua_dofile_recursive(lua_State *l, const std::string &basepath);
 
@@ -15,6 +15,10 @@ void pi_lua_generic_pull(lua_State *l, int index, vector3d *&out)
 
 vector3d construct_vec3(lua_State *L, int index)
 {
+	const vector3d *vec3 = LuaVector::GetFromLua(L, index);
+	if (vec3 != nullptr)
+		return *vec3;
+
 	const vector2d *vec2 = LuaVector2::GetFromLua(L, index);
 	double x, y, z;
 	if (vec2 != nullptr) {
@@ -140,7 +144,44 @@ static int l_vector_new_index(lua_State *L)
 	} else {
 		luaL_error(L, "Expected Vector3, but type is '%s'", luaL_typename(L, 2));
 	}
-	LuaVector::PushToLua(L, *v);
+
+	// __newindex metamethods don't return a value.
+	return 0;
+}
+
+// In-place arithmetic, returning the vector itself so calls can be chained:
+//	pos:addInPlace(vel, dt):addInPlace(acc, 0.5 * dt * dt)
+// updates pos without creating the temporaries of pos + vel * dt + ...
+static int l_vector_add_in_place(lua_State *L)
+{
+	vector3d *v = LuaVector::CheckFromLua(L, 1);
+	const vector3d *other = LuaVector::CheckFromLua(L, 2);
+	*v += *other * luaL_optnumber(L, 3, 1.0);
+	lua_settop(L, 1);
+	return 1;
+}
+
+static int l_vector_sub_in_place(lua_State *L)
+{
+	vector3d *v = LuaVector::CheckFromLua(L, 1);
+	*v -= *LuaVector::CheckFromLua(L, 2);
+	lua_settop(L, 1);
+	return 1;
+}
+
+static int l_vector_scale_in_place(lua_State *L)
+{
+	vector3d *v = LuaVector::CheckFromLua(L, 1);
+	*v *= luaL_checknumber(L, 2);
+	lua_settop(L, 1);
+	return 1;
+}
+
+static int l_vector_normalize_in_place(lua_State *L)
+{
+	vector3d *v = LuaVector::CheckFromLua(L, 1);
+	*v = v->NormalizedSafe();
+	lua_settop(L, 1);
 	return 1;
 }
 
@@ -222,6 +263,10 @@ void LuaVector::Register(lua_State *L)
 		.AddFunction("length", &vector3d::Length)
 		.AddFunction("cross", &vector3d::Cross)
 		.AddFunction("dot", &vector3d::Dot)
+		.AddFunction("addInPlace", &l_vector_add_in_place)
+		.AddFunction("subInPlace", &l_vector_sub_in_place)
+		.AddFunction("scaleInPlace", &l_vector_scale_in_place)
+		.AddFunction("normalizeInPlace", &l_vector_normalize_in_place)
 		.StopRecording();
 
 	// set the meta functions
@@ -248,6 +293,17 @@ vector3d *LuaVector::PushNewToLua(lua_State *L)
 	return ptr;
 }
 
+void LuaVector::PushToLua(lua_State *L, const vector3d &v, int outIdx)
+{
+	vector3d *out = static_cast<vector3d *>(LuaMetaTypeBase::TestUserdata(L, outIdx, LuaVector::TypeName));
+	if (out) {
+		*out = v;
+		lua_pushvalue(L, outIdx);
+	} else {
+		*PushNewToLua(L) = v;
+	}
+}
+
 const vector3d *LuaVector::GetFromLua(lua_State *L, int idx)
 {
 	return static_cast<vector3d *>(LuaMetaTypeBase::TestUserdata(L, idx, LuaVector::TypeName));
@@ -15,6 +15,10 @@ namespace LuaVector {
 	void Register(lua_State *L);
 	vector3d *PushNewToLua(lua_State *L);
 	inline void PushToLua(lua_State *L, const vector3d &v) { *PushNewToLua(L) = v; }
+	// Write v into the Vector3 at outIdx and push it again, or push a new one
+	// if there is no Vector3 there; lets a binding take an optional result
+	// vector so scripts calling it every frame don't allocate.
+	void PushToLua(lua_State *L, const vector3d &v, int outIdx);
 	const vector3d *GetFromLua(lua_State *L, int idx);
 	vector3d *CheckFromLua(lua_State *L, int idx);
 
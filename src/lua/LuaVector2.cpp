@@ -25,6 +25,10 @@ static int l_vector_new(lua_State *L)
 
 vector2d construct_vec2(lua_State *L)
 {
+	const vector2d *vec2 = LuaVector2::GetFromLua(L, 2);
+	if (vec2 != nullptr)
+		return *vec2;
+
 	double x, y;
 	x = luaL_checknumber(L, 2);
 	if (lua_gettop(L) == 2)
@@ -57,6 +61,41 @@ static int l_vector_set(lua_State *L)
 	return 1;
 }
 
+// In-place arithmetic, returning the vector itself so calls can be chained
+// without creating temporaries, e.g. pos:addInPlace(dir, speed)
+static int l_vector_add_in_place(lua_State *L)
+{
+	vector2d *v = LuaVector2::CheckFromLua(L, 1);
+	const vector2d *other = LuaVector2::CheckFromLua(L, 2);
+	*v += *other * luaL_optnumber(L, 3, 1.0);
+	lua_settop(L, 1);
+	return 1;
+}
+
+static int l_vector_sub_in_place(lua_State *L)
+{
+	vector2d *v = LuaVector2::CheckFromLua(L, 1);
+	*v -= *LuaVector2::CheckFromLua(L, 2);
+	lua_settop(L, 1);
+	return 1;
+}
+
+static int l_vector_scale_in_place(lua_State *L)
+{
+	vector2d *v = LuaVector2::CheckFromLua(L, 1);
+	*v *= luaL_checknumber(L, 2);
+	lua_settop(L, 1);
+	return 1;
+}
+
+static int l_vector_normalize_in_place(lua_State *L)
+{
+	vector2d *v = LuaVector2::CheckFromLua(L, 1);
+	*v = v->NormalizedSafe();
+	lua_settop(L, 1);
+	return 1;
+}
+
 static int l_vector_tostring(lua_State *L)
 {
 	const vector2d *v = LuaVector2::CheckFromLua(L, 1);
@@ -236,6 +275,10 @@ void LuaVector2::Register(lua_State *L)
 			LuaVector2::PushToLua(L, vector2d(v->y, -v->x));
 			return 1;
 		})
+		.AddFunction("addInPlace", &l_vector_add_in_place)
+		.AddFunction("subInPlace", &l_vector_sub_in_place)
+		.AddFunction("scaleInPlace", &l_vector_scale_in_place)
+		.AddFunction("normalizeInPlace", &l_vector_normalize_in_place)
 		.StopRecording();
 
 	metaType.GetMetatable();
@@ -261,6 +304,17 @@ vector2d *LuaVector2::PushNewToLua(lua_State *L)
 	return ptr;
 }
 
+void LuaVector2::PushToLua(lua_State *L, const vector2d &v, int outIdx)
+{
+	vector2d *out = static_cast<vector2d *>(LuaMetaTypeBase::TestUserdata(L, outIdx, LuaVector2::TypeName));
+	if (out) {
+		*out = v;
+		lua_pushvalue(L, outIdx);
+	} else {
+		*PushNewToLua(L) = v;
+	}
+}
+
 const vector2d *LuaVector2::GetFromLua(lua_State *L, int idx)
 {
 	return static_cast<vector2d *>(LuaMetaTypeBase::TestUserdata(L, idx, LuaVector2::TypeName));
@@ -15,6 +15,10 @@ namespace LuaVector2 {
 	void Register(lua_State *L);
 	vector2d *PushNewToLua(lua_State *L);
 	inline void PushToLua(lua_State *L, const vector2d &v) { *PushNewToLua(L) = v; }
+	// Write v into the Vector2 at outIdx and push it again, or push a new one
+	// if there is no Vector2 there; lets a binding take an optional result
+	// vector so scripts calling it every frame don't allocate.
+	void PushToLua(lua_State *L, const vector2d &v, int outIdx);
 	const vector2d *GetFromLua(lua_State *L, int idx);
 	vector2d *CheckFromLua(lua_State *L, int idx);
 
@@ -0,0 +1,286 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "LuaWorker.h"
+#include "FileSystem.h"
+#include "JobQueue.h"
+#include "Json.h"
+#include "Lua.h"
+#include "LuaUtils.h"
+#include "Pi.h"
+#include "core/StringUtils.h"
+
+#include <memory>
+
+/*
+ * Interface: Worker
+ *
+ * Run pure data generation modules (mission or NPC generation and the like)
+ * away from the main thread.
+ *
+ * A worker module is a file in the game data that returns a function. The
+ * function is called with the arguments given to <Worker.Run> in a lua_State
+ * of its own, with only the standard sandbox libraries (no io) and nothing
+ * from the engine, not even Random: pass a seed in and use util.hash_random.
+ *
+ * The values passed in and out can only be nil, booleans, numbers, strings
+ * and tables of those; they are copied across, never shared.
+ */
+
+namespace {
+	// tables nested deeper than this (or referring to themselves) are refused
+	static const int MAX_DEPTH = 32;
+
+	// bumped on Uninit so the jobs outliving a lua_State don't touch the next one
+	static int s_generation = 0;
+	static std::unique_ptr<JobSet> s_jobs;
+
+	// Json is only the intermediate form here: a table is an array of its
+	// keys and values one after the other, nothing else is an array
+	static bool to_value(lua_State *l, int idx, Json &out, int depth, std::string &error)
+	{
+		idx = lua_absindex(l, idx);
+		switch (lua_type(l, idx)) {
+		case LUA_TNIL: out = nullptr; return true;
+		case LUA_TBOOLEAN: out = bool(lua_toboolean(l, idx)); return true;
+		case LUA_TNUMBER: out = lua_tonumber(l, idx); return true;
+		case LUA_TSTRING: {
+			size_t len;
+			const char *str = lua_tolstring(l, idx, &len);
+			out = std::string(str, len);
+			return true;
+		}
+		case LUA_TTABLE: {
+			if (depth >= MAX_DEPTH) {
+				error = "tables nested too deep (or a cycle)";
+				return false;
+			}
+			if (!lua_checkstack(l, 3)) {
+				error = "out of stack";
+				return false;
+			}
+			out = Json::array();
+			lua_pushnil(l);
+			while (lua_next(l, idx)) {
+				Json key, value;
+				if (!to_value(l, -2, key, depth + 1, error) || !to_value(l, -1, value, depth + 1, error)) {
+					lua_pop(l, 2);
+					return false;
+				}
+				out.push_back(std::move(key));
+				out.push_back(std::move(value));
+				lua_pop(l, 1);
+			}
+			return true;
+		}
+		default:
+			error = std::string("can't pass a ") + luaL_typename(l, idx) + " to or from a worker";
+			return false;
+		}
+	}
+
+	static void push_value(lua_State *l, const Json &value)
+	{
+		luaL_checkstack(l, 3, nullptr);
+		switch (value.type()) {
+		case Json::value_t::boolean: lua_pushboolean(l, value.get<bool>()); break;
+		case Json::value_t::number_integer:
+		case Json::value_t::number_unsigned:
+		case Json::value_t::number_float: lua_pushnumber(l, value.get<double>()); break;
+		case Json::value_t::string: {
+			const std::string &str = value.get_ref<const std::string &>();
+			lua_pushlstring(l, str.data(), str.size());
+		} break;
+		case Json::value_t::array: {
+			lua_createtable(l, 0, int(value.size() / 2));
+			for (size_t i = 0; i + 1 < value.size(); i += 2) {
+				push_value(l, value[i]);
+				push_value(l, value[i + 1]);
+				if (lua_isnil(l, -2))
+					lua_pop(l, 2);
+				else
+					lua_rawset(l, -3);
+			}
+		} break;
+		default: lua_pushnil(l); break;
+		}
+	}
+
+	static int error_handler(lua_State *l)
+	{
+		luaL_traceback(l, l, lua_tostring(l, 1), 1);
+		return 1;
+	}
+
+	class WorkerJob : public Job {
+	public:
+		WorkerJob(lua_State *l, const std::string &path, std::string &&source, Json &&args, int callback) :
+			m_lua(l),
+			m_generation(s_generation),
+			m_callback(callback),
+			m_path(path),
+			m_source(std::move(source)),
+			m_args(std::move(args)),
+			m_ok(false)
+		{}
+
+		virtual ~WorkerJob()
+		{
+			if (IsLuaAlive())
+				luaL_unref(m_lua, LUA_REGISTRYINDEX, m_callback);
+		}
+
+		virtual void OnRun() override
+		{
+			lua_State *l = luaL_newstate();
+			if (!l) {
+				m_error = "couldn't create a lua_State";
+				return;
+			}
+
+			pi_lua_open_standard_base(l);
+			// the sandbox io only makes sense on the main thread
+			lua_pushnil(l);
+			lua_setglobal(l, LUA_IOLIBNAME);
+
+			lua_pushcfunction(l, error_handler);
+			const int handler = lua_gettop(l);
+
+			// the source was read on the main thread; this doesn't go through
+			// the chunk cache, which isn't safe to use from the workers
+			const std::string chunkName = "@" + m_path;
+			if (luaL_loadbufferx(l, m_source.data(), m_source.size(), chunkName.c_str(), "t") != LUA_OK || lua_pcall(l, 0, 1, handler) != LUA_OK) {
+				m_error = lua_tostring(l, -1);
+			} else if (!lua_isfunction(l, -1)) {
+				m_error = m_path + " doesn't return a function";
+			} else {
+				push_value(l, m_args);
+				if (lua_pcall(l, 1, 1, handler) != LUA_OK)
+					m_error = lua_tostring(l, -1);
+				else
+					m_ok = to_value(l, -1, m_result, 0, m_error);
+			}
+
+			lua_close(l);
+		}
+
+		virtual void OnFinish() override
+		{
+			if (!IsLuaAlive())
+				return;
+
+			lua_State *l = m_lua;
+			LUA_DEBUG_START(l);
+			lua_rawgeti(l, LUA_REGISTRYINDEX, m_callback);
+			if (m_ok) {
+				push_value(l, m_result);
+				lua_pushnil(l);
+			} else {
+				lua_pushnil(l);
+				lua_pushstring(l, m_error.c_str());
+			}
+			pi_lua_protected_call(l, 2, 0);
+			LUA_DEBUG_END(l, 0);
+		}
+
+		virtual const char *GetJobName() const override { return "LuaWorkerJob"; }
+
+	private:
+		bool IsLuaAlive() const
+		{
+			return m_generation == s_generation && ::Lua::manager && ::Lua::manager->GetLuaState() == m_lua;
+		}
+
+		lua_State *m_lua;
+		int m_generation;
+		int m_callback;
+
+		std::string m_path;
+		std::string m_source;
+		Json m_args;
+
+		bool m_ok;
+		Json m_result;
+		std::string m_error;
+	};
+} // namespace
+
+/*
+ * Function: Run
+ *
+ * Run a worker module on a job thread and get its result back later.
+ *
+ * > Worker.Run(path, args, function (result, err) ... end)
+ *
+ * Parameters:
+ *
+ *   path - the .lua file of the module in the game data
+ *
+ *   args - a value passed to the function the module returns
+ *
+ *   callback - called on the main thread with the value the function
+ *              returned, or with nil and an error message when the module
+ *              failed or returned something that can't be passed back
+ *
+ * Availability:
+ *
+ *   2024
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_worker_run(lua_State *l)
+{
+	const std::string path = luaL_checkstring(l, 1);
+	luaL_checktype(l, 3, LUA_TFUNCTION);
+
+	if (!ends_with_ci(path, ".lua"))
+		return luaL_error(l, "worker module %s isn't a .lua file", path.c_str());
+
+	RefCountedPtr<FileSystem::FileData> code = FileSystem::gameDataFiles.ReadFile(path);
+	if (!code)
+		return luaL_error(l, "worker module %s not found", path.c_str());
+
+	Json args;
+	std::string error;
+	if (!to_value(l, 2, args, 0, error))
+		return luaL_error(l, "%s", error.c_str());
+
+	const StringRange source = code->AsStringRange().StripUTF8BOM();
+
+	lua_pushvalue(l, 3);
+	const int callback = luaL_ref(l, LUA_REGISTRYINDEX);
+
+	s_jobs->Order(new WorkerJob(l, path, source.ToString(), std::move(args), callback));
+	return 0;
+}
+
+void LuaWorker::Register()
+{
+	lua_State *l = Lua::manager->GetLuaState();
+
+	LUA_DEBUG_START(l);
+
+	s_jobs.reset(new JobSet(Pi::GetAsyncJobQueue()));
+
+	static const luaL_Reg methods[] = {
+		{ "Run", l_worker_run },
+		{ 0, 0 }
+	};
+
+	lua_getfield(l, LUA_REGISTRYINDEX, "CoreImports");
+	luaL_newlib(l, methods);
+	lua_setfield(l, -2, "Worker");
+	lua_pop(l, 1);
+
+	LUA_DEBUG_END(l, 0);
+}
+
+void LuaWorker::Uninit()
+{
+	// the handles cancel the jobs, the callbacks are unreferenced while the
+	// lua_State is still around
+	s_jobs.reset();
+	s_generation++;
+}
@@ -0,0 +1,17 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUAWORKER_H
+#define _LUAWORKER_H
+
+// Runs data-only Lua modules on the job queue threads, each in a fresh
+// sandboxed lua_State of its own. Nothing of the engine is bound into those
+// states: a module gets plain values in and hands plain values back, which
+// are passed to a callback on the main thread.
+namespace LuaWorker {
+	void Register();
+	// cancel the jobs still queued, their callbacks are never called
+	void Uninit();
+}
+
+#endif
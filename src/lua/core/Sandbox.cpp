@@ -2,13 +2,23 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "CoreFwdDecl.h"
+#include "DiskCache.h"
 #include "FileSystem.h"
 #include "LuaUtils.h"
+#include "core/FNV1a.h"
 #include "core/Log.h"
+#include "profiler/Profiler.h"
 #include "utils.h"
 #include "FileSystem.h"
 #include "LuaFileSystem.h"
 
+#include <cstring>
+
+// Compiled chunks, keyed by the chunk name, the source and the Lua build.
+// Bump the version if the way chunks are loaded changes.
+static const Uint32 CHUNK_CACHE_VERSION = 1;
+static DiskCache s_chunkCache("lua_cache", CHUNK_CACHE_VERSION);
+
 static int l_d_null_userdata(lua_State *L)
 {
 	lua_pushlightuserdata(L, nullptr);
@@ -294,8 +304,38 @@ void pi_lua_protected_call(lua_State *L, int nargs, int nresults)
 	}
 }
 
+void pi_lua_init_chunk_cache(size_t maxBytes)
+{
+	s_chunkCache.Init(maxBytes);
+}
+
+void pi_lua_uninit_chunk_cache()
+{
+	s_chunkCache.Uninit();
+}
+
+static int chunk_writer(lua_State *l, const void *p, size_t sz, void *ud)
+{
+	static_cast<std::string *>(ud)->append(static_cast<const char *>(p), sz);
+	return 0;
+}
+
+static uint64_t chunk_key(const std::string &chunkName, const StringRange &source)
+{
+	// the bytecode format depends on the Lua release and the sizes of its types
+	std::string key = chunkName;
+	key += '\0';
+	key += LUA_RELEASE;
+	key += char('0' + sizeof(lua_Number));
+	key += char('0' + sizeof(size_t));
+	key += '\0';
+	key.append(source.begin, source.Size());
+	return hash_64_fnv1a(key.data(), key.size());
+}
+
 int pi_lua_loadfile(lua_State *l, const FileSystem::FileData &code)
 {
+	PROFILE_SCOPED()
 	assert(l);
 
 	const StringRange source = code.AsStringRange().StripUTF8BOM();
@@ -303,7 +343,30 @@ int pi_lua_loadfile(lua_State *l, const FileSystem::FileData &code)
 	bool trusted = code.GetInfo().GetSource().IsTrusted();
 	const std::string chunkName = (trusted ? "@[T] " : "@") + path;
 
-	return luaL_loadbuffer(l, source.begin, source.Size(), chunkName.c_str());
+	// files that are precompiled already (e.g. shipped that way in a mod)
+	// are loaded as they are
+	const size_t sigLen = strlen(LUA_SIGNATURE);
+	if (!s_chunkCache.IsEnabled() || (source.Size() >= sigLen && !memcmp(source.begin, LUA_SIGNATURE, sigLen)))
+		return luaL_loadbuffer(l, source.begin, source.Size(), chunkName.c_str());
+
+	const uint64_t key = chunk_key(chunkName, source);
+	std::string chunk;
+	if (s_chunkCache.Load(key, chunk)) {
+		if (luaL_loadbufferx(l, chunk.data(), chunk.size(), chunkName.c_str(), "b") == LUA_OK)
+			return LUA_OK;
+
+		Log::Warning("Discarding the cached chunk of {}: {}\n", path, lua_tostring(l, -1));
+		lua_pop(l, 1);
+		s_chunkCache.Remove(key);
+	}
+
+	const int ret = luaL_loadbufferx(l, source.begin, source.Size(), chunkName.c_str(), "t");
+	if (ret == LUA_OK) {
+		chunk.clear();
+		if (lua_dump(l, chunk_writer, &chunk) == 0)
+			s_chunkCache.Store(key, chunk);
+	}
+	return ret;
 }
 
 void pi_lua_dofile(lua_State *l, const FileSystem::FileData &code, int nret)
@@ -1,6 +1,7 @@
 // Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
+#include "Benchmark.h"
 #include "Game.h"
 #include "Pi.h"
 #include "buildopts.h"
@@ -21,6 +22,7 @@ enum RunMode {
 	MODE_GAME,
 	MODE_GALAXYDUMP,
 	MODE_START_AT,
+	MODE_BENCHMARK,
 	MODE_VERSION,
 	MODE_USAGE,
 	MODE_USAGE_ERROR
@@ -62,6 +64,11 @@ extern "C" int main(int argc, char **argv)
 			goto start;
 		}
 
+		if (modeopt == "benchmark" || modeopt == "bm") {
+			mode = MODE_BENCHMARK;
+			goto start;
+		}
+
 		if (modeopt == "version" || modeopt == "v") {
 			mode = MODE_VERSION;
 			goto start;
@@ -81,6 +88,7 @@ start:
 	long int radius = 4;
 	long int sx = 0, sy = 0, sz = 0;
 	std::string filename;
+	std::string outputname;
 	SystemPath startPath(0, 0, 0, 0, 0);
 
 	switch (mode) {
@@ -151,6 +159,24 @@ start:
 		}
 		// fallthrough
 	}
+	case MODE_BENCHMARK: {
+		// fallthrough protect
+		if (mode == MODE_BENCHMARK) {
+			if (argc < 3) {
+				Output("pioneer: benchmark requires a script filename\n");
+				break;
+			}
+			filename = argv[pos];
+			++pos;
+			// output filename (optional)
+			outputname = "benchmark.json";
+			if (argc > pos && !strchr(argv[pos], '=')) {
+				outputname = argv[pos];
+				++pos;
+			}
+		}
+		// fallthrough
+	}
 	case MODE_GAME: {
 		std::map<std::string, std::string> options;
 
@@ -181,6 +207,13 @@ start:
 				Pi::GetApp()->SetStartPath(startPath);
 
 			Pi::GetApp()->Run();
+		} else if (mode == MODE_BENCHMARK) {
+			Benchmark *benchmark = new Benchmark(filename, outputname);
+			if (benchmark->IsValid()) {
+				Pi::GetApp()->SetBenchmark(benchmark);
+				Pi::GetApp()->Run();
+			} else
+				delete benchmark;
 		} else if (mode == MODE_GALAXYDUMP) {
 			// TODO: don't initialize Pi when dumping the galaxy
 			// Galaxy generation is (mostly) self-contained, no need to e.g.
@@ -226,6 +259,8 @@ start:
 			"    -galaxydump  [-gd]    galaxy dumper\n"
 			"    -startat     [-sa]    skip main menu and start at Mars\n"
 			"    -startat=sp  [-sa=sp]  skip main menu and start at systempath x,y,z,si,bi\n"
+			"    -benchmark   [-bm]    run a benchmark script: -bm script.json [output.json]\n"
+			"                          (HiddenWindow=1 to run without showing the window)\n"
 			"    -version     [-v]     show version\n"
 			"    -help        [-h,-?]  this help\n");
 		break;
@@ -15,7 +15,9 @@
 #include "JobQueue.h"
 #include "ModManager.h"
 #include "StringF.h"
+#include "core/FNV1a.h"
 #include "core/OS.h"
+#include "core/TaskGraph.h"
 #include "graphics/Drawables.h"
 #include "graphics/Graphics.h"
 #include "graphics/Light.h"
@@ -27,42 +29,176 @@
 #include "scenegraph/BinaryConverter.h"
 #include "scenegraph/DumpVisitor.h"
 #include "scenegraph/FindNodeVisitor.h"
+#include "scenegraph/Parser.h"
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <SDL.h>
 
 std::unique_ptr<GameConfig> s_config;
 std::unique_ptr<Graphics::Renderer> s_renderer;
 
-//#define USES_THREADS
-#ifdef USES_THREADS
-std::unique_ptr<AsyncJobQueue> asyncJobQueue;
-#endif
-
 static const std::string s_dummyPath("");
 
-// fwd decl'
-void RunCompiler(const std::string &modelName, const std::string &filepath, const bool bInPlace);
+// In batch mode every thread compiles with its own renderer: textures
+// and materials are refcounted without atomics, so they can't be shared
+// between threads. Each renderer keeps its texture cache for all the models
+// compiled on its thread, so a texture shared by many models is still only
+// loaded a few times.
+static std::mutex s_threadRenderersLock;
+static std::vector<std::unique_ptr<Graphics::Renderer>> s_threadRenderers;
 
-// ********************************************************************************
-// Overloaded PureJob class to handle compiling each model
-// ********************************************************************************
-class CompileJob : public Job {
-public:
-	CompileJob(){};
-	CompileJob(const std::string &name, const std::string &path, const bool inPlace) :
-		m_name(name),
-		m_path(path),
-		m_inPlace(inPlace) {}
-
-	virtual void OnRun() override final { RunCompiler(m_name, m_path, m_inPlace); } // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
-	virtual void OnFinish() override final {}
-	virtual void OnCancel() override final {}
-
-protected:
-	std::string m_name;
-	std::string m_path;
-	bool m_inPlace;
-};
+static Graphics::Renderer *GetThreadRenderer()
+{
+	static thread_local Graphics::Renderer *tl_renderer = nullptr;
+	if (!tl_renderer) {
+		std::lock_guard<std::mutex> lock(s_threadRenderersLock);
+		s_threadRenderers.emplace_back(new Graphics::RendererDummy());
+		tl_renderer = s_threadRenderers.back().get();
+	}
+	return tl_renderer;
+}
+
+// Bump this whenever the compiler's output changes without SGM_VERSION
+// changing, so the manifest no longer matches and everything is rebuilt
+static const uint32_t MANIFEST_VERSION = 1;
+static const char *MANIFEST_FILE = "sgm_manifest.txt";
+
+// Maps the path of each .sgm written in batch mode to the hash of the inputs
+// it was compiled from
+typedef std::map<std::string, uint64_t> Manifest;
+
+// textures are shared by many models, so each file is only hashed once
+static std::mutex s_fileHashesLock;
+static std::map<std::string, uint64_t> s_fileHashes;
+
+static uint64_t HashFile(const std::string &path)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_fileHashesLock);
+		auto it = s_fileHashes.find(path);
+		if (it != s_fileHashes.end())
+			return it->second;
+	}
+
+	// a missing file hashes differently from any file, so the model is
+	// compiled (and fails) again rather than being skipped
+	uint64_t hash = 0;
+	RefCountedPtr<FileSystem::FileData> data = FileSystem::gameDataFiles.ReadFile(path);
+	if (data)
+		hash = hash_64_fnv1a(data->GetData(), data->GetSize());
+
+	std::lock_guard<std::mutex> lock(s_fileHashesLock);
+	s_fileHashes[path] = hash;
+	return hash;
+}
+
+// Hash everything a model is compiled from: the .model file, the meshes and
+// textures it names, and the other files next to it (patterns, decals...).
+// Returns 0 if the .model file can't be parsed.
+static uint64_t HashModelInputs(const std::string &fpath, const bool bQuantise)
+{
+	PROFILE_SCOPED()
+	FileSystem::FileInfo info = FileSystem::gameDataFiles.Lookup(fpath);
+	std::string dir = info.GetDir();
+	if (!dir.empty() && dir[dir.length() - 1] == '/')
+		dir = dir.substr(0, dir.length() - 1);
+
+	SceneGraph::ModelDefinition def;
+	try {
+		SceneGraph::Parser p(FileSystem::gameDataFiles, fpath, dir);
+		p.Parse(&def);
+	} catch (const SceneGraph::ParseError &) {
+		return 0;
+	}
+
+	std::vector<std::string> inputs;
+	for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, dir); !files.Finished(); files.Next()) {
+		const FileSystem::FileInfo &file = files.Current();
+		// an in place build writes its output next to the inputs
+		if (file.IsFile() && !ends_with_ci(file.GetPath(), ".sgm") && file.GetName() != MANIFEST_FILE)
+			inputs.push_back(file.GetPath());
+	}
+	for (const SceneGraph::LodDefinition &lod : def.lodDefs)
+		inputs.insert(inputs.end(), lod.meshNames.begin(), lod.meshNames.end());
+	inputs.insert(inputs.end(), def.collisionDefs.begin(), def.collisionDefs.end());
+	for (const SceneGraph::MaterialDefinition &mat : def.matDefs) {
+		for (const std::string *tex : { &mat.tex_diff, &mat.tex_spec, &mat.tex_glow, &mat.tex_ambi, &mat.tex_norm }) {
+			if (!tex->empty())
+				inputs.push_back(*tex);
+		}
+	}
+
+	std::sort(inputs.begin(), inputs.end());
+	inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+
+	std::ostringstream key;
+	key << SceneGraph::SGM_VERSION << " " << MANIFEST_VERSION << (bQuantise ? " quantised" : "") << "\n";
+	for (const std::string &input : inputs)
+		key << input << " " << HashFile(input) << "\n";
+
+	const std::string str = key.str();
+	const uint64_t hash = hash_64_fnv1a(str.data(), str.size());
+	return hash ? hash : 1;
+}
+
+// The file system the batch output and the manifest are written to, and
+// the path of a model's output in it, in the same way as BinaryConverter::Save
+static FileSystem::FileSourceFS &GetOutputFS(const bool bInPlace)
+{
+	static FileSystem::FileSourceFS dataFS(FileSystem::GetDataDir());
+	return bInPlace ? dataFS : FileSystem::userFiles;
+}
+
+static std::string GetOutputPath(const std::string &filepath, const bool bInPlace)
+{
+	const std::string path = FileSystem::NormalisePath(filepath.substr(0, filepath.size() - 6)) + ".sgm";
+	return bInPlace ? path : FileSystem::JoinPathBelow("binarymodels", path);
+}
+
+static std::string GetManifestPath(const bool bInPlace)
+{
+	return FileSystem::JoinPathBelow(bInPlace ? "models" : "binarymodels", MANIFEST_FILE);
+}
+
+static Manifest LoadManifest(const bool bInPlace)
+{
+	Manifest manifest;
+	RefCountedPtr<FileSystem::FileData> data = GetOutputFS(bInPlace).ReadFile(GetManifestPath(bInPlace));
+	if (!data)
+		return manifest;
+
+	std::istringstream in(std::string(data->AsStringView()));
+	std::string path, hash;
+	while (in >> path >> hash)
+		manifest[path] = strtoull(hash.c_str(), nullptr, 16);
+	return manifest;
+}
+
+static void SaveManifest(const Manifest &manifest, const bool bInPlace)
+{
+	std::ostringstream out;
+	for (const auto &entry : manifest) {
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016" PRIx64, entry.second);
+		out << entry.first << " " << hash << "\n";
+	}
+
+	FileSystem::FileSourceFS &fs = GetOutputFS(bInPlace);
+	fs.MakeDirectory(bInPlace ? "models" : "binarymodels");
+	FILE *f = fs.OpenWriteStream(GetManifestPath(bInPlace), FileSystem::FileSourceFS::WRITE_TEXT);
+	if (!f) {
+		Log::Warning("Couldn't write {}\n", GetManifestPath(bInPlace));
+		return;
+	}
+
+	const std::string text = out.str();
+	fwrite(text.data(), 1, text.size(), f);
+	fclose(f);
+}
 
 // ********************************************************************************
 // functions
@@ -98,20 +234,10 @@ void SetupRenderer()
 	videoSettings.iconFile = OS::GetIconFilename();
 	videoSettings.title = "Model Compiler";
 	s_renderer.reset(Graphics::Init(videoSettings));
-
-#ifdef USES_THREADS
-	// get threads up
-	Uint32 numThreads = s_config->Int("WorkerThreads");
-	const int numCores = OS::GetNumCores();
-	assert(numCores > 0);
-	if (numThreads == 0)
-		numThreads = std::max(Uint32(numCores), 1U); // this is a tool, we can use all of the cores for processing unlike Pioneer
-	asyncJobQueue.reset(new AsyncJobQueue(numThreads));
-	Output("started %d worker threads\n", numThreads);
-#endif
 }
 
-void RunCompiler(const std::string &modelName, const std::string &filepath, const bool bInPlace)
+// Returns false if the model couldn't be compiled
+bool RunCompiler(Graphics::Renderer *renderer, const std::string &modelName, const std::string &filepath, const bool bInPlace, const bool bQuantise)
 {
 	PROFILE_SCOPED()
 	Profiler::Timer timer;
@@ -122,7 +248,7 @@ void RunCompiler(const std::string &modelName, const std::string &filepath, cons
 	//and then save it into binary
 	std::unique_ptr<SceneGraph::Model> model;
 	try {
-		SceneGraph::Loader ld(s_renderer.get(), true, false);
+		SceneGraph::Loader ld(renderer, true, false);
 		model.reset(ld.LoadModel(modelName));
 		//dump warnings
 		for (std::vector<std::string>::const_iterator it = ld.GetLogMessages().begin();
@@ -131,19 +257,112 @@ void RunCompiler(const std::string &modelName, const std::string &filepath, cons
 		}
 	} catch (...) {
 		//minimal error handling, this is not expected to happen since we got this far.
-		return;
+		Log::Error("Couldn't load model {}\n", modelName);
+		return false;
+	}
+
+	if (!model) {
+		Log::Error("Couldn't load model {}\n", modelName);
+		return false;
 	}
 
 	try {
 		const std::string DataPath = FileSystem::NormalisePath(filepath.substr(0, filepath.size() - 6));
-		SceneGraph::BinaryConverter bc(s_renderer.get());
+		SceneGraph::BinaryConverter bc(renderer);
+		bc.SetQuantiseVertices(bQuantise);
 		bc.Save(modelName, DataPath, model.get(), bInPlace);
 	} catch (const CouldNotOpenFileException &) {
+		return false;
 	} catch (const CouldNotWriteToFileException &) {
+		return false;
 	}
 
 	timer.Stop();
 	Output("Compiling \"%s\" took: %lf\n", modelName.c_str(), timer.millicycles());
+	return true;
+}
+
+enum BatchFlags {
+	BATCH_FORCE = 1,  // compile every model, up to date or not
+	BATCH_DRY_RUN = 2, // only list the models that are out of date
+	BATCH_QUANTISE = 4 // write meshes in the quantised vertex format
+};
+
+// Compile the models that changed since they were last compiled, on all
+// cores. Returns the number of models that couldn't be compiled.
+static uint32_t RunBatchCompiler(const std::vector<std::pair<std::string, std::string>> &models, const bool bInPlace, const int flags)
+{
+	PROFILE_SCOPED()
+	uint32_t numThreads = s_config->Int("WorkerThreads");
+	if (numThreads == 0)
+		numThreads = std::max(OS::GetNumCores(), 1U); // this is a tool, we can use all of the cores for processing unlike Pioneer
+
+	Profiler::Timer timer;
+	timer.Start();
+
+	// the main thread works on the models too while it waits
+	TaskGraph graph;
+	graph.SetWorkerThreads(numThreads - 1);
+
+	std::vector<uint64_t> hashes(models.size());
+	TaskSet *hashSet = new TaskSet();
+	hashSet->AddTaskRangeLambda({ 0, uint32_t(models.size()) }, 1, [&](TaskRange range) {
+		for (uint32_t idx = range.begin; idx < range.end; idx++)
+			hashes[idx] = HashModelInputs(models[idx].second, flags & BATCH_QUANTISE);
+	});
+	graph.WaitForTaskSet(graph.QueueTaskSet(hashSet));
+
+	Manifest manifest = LoadManifest(bInPlace);
+	FileSystem::FileSourceFS &outputFS = GetOutputFS(bInPlace);
+	std::vector<uint32_t> stale;
+	for (uint32_t idx = 0; idx < models.size(); idx++) {
+		const std::string outputPath = GetOutputPath(models[idx].second, bInPlace);
+		auto entry = manifest.find(outputPath);
+		const bool upToDate = hashes[idx] && entry != manifest.end() && entry->second == hashes[idx] && outputFS.Lookup(outputPath).IsFile();
+		if (!upToDate || (flags & BATCH_FORCE))
+			stale.push_back(idx);
+	}
+
+	if (flags & BATCH_DRY_RUN) {
+		for (uint32_t idx : stale)
+			Output("%s is out of date\n", models[idx].first.c_str());
+		Output("%u of %u models are out of date\n", uint32_t(stale.size()), uint32_t(models.size()));
+		return 0;
+	}
+
+	Output("compiling %u models on %u threads, %u are up to date\n", uint32_t(stale.size()), numThreads, uint32_t(models.size() - stale.size()));
+
+	std::mutex manifestLock;
+	std::atomic<uint32_t> numDone(0);
+	std::atomic<uint32_t> numFailed(0);
+	TaskSet *set = new TaskSet();
+	set->AddTaskRangeLambda({ 0, uint32_t(stale.size()) }, 1, [&](TaskRange range) {
+		for (uint32_t i = range.begin; i < range.end; i++) {
+			const uint32_t idx = stale[i];
+			const bool ok = RunCompiler(GetThreadRenderer(), models[idx].first, models[idx].second, bInPlace, flags & BATCH_QUANTISE);
+			{
+				// a model that failed is compiled again next time
+				std::lock_guard<std::mutex> lock(manifestLock);
+				const std::string outputPath = GetOutputPath(models[idx].second, bInPlace);
+				if (ok && hashes[idx])
+					manifest[outputPath] = hashes[idx];
+				else
+					manifest.erase(outputPath);
+			}
+			if (!ok)
+				numFailed++;
+			Output("[%u/%u] %s %s\n", ++numDone, uint32_t(stale.size()), models[idx].first.c_str(), ok ? "done" : "FAILED");
+		}
+	});
+
+	TaskSet::Handle handle = graph.QueueTaskSet(set);
+	graph.WaitForTaskSet(handle);
+
+	SaveManifest(manifest, bInPlace);
+
+	timer.Stop();
+	Output("compiled %u of %u models in %.1lf ms\n", uint32_t(stale.size()) - numFailed, uint32_t(stale.size()), timer.milliseconds());
+	return numFailed;
 }
 
 // ********************************************************************************
@@ -166,6 +385,7 @@ extern "C" int main(int argc, char **argv)
 #endif
 
 	RunMode mode = MODE_MODELCOMPILER;
+	int exitCode = 0;
 
 	if (argc > 1) {
 		const char switchchar = argv[1][0];
@@ -213,12 +433,16 @@ start:
 	case MODE_MODELCOMPILER: {
 		std::string modelName;
 		std::string filePath;
-		if (argc > 2) {
-			filePath = modelName = argv[2];
+		int argIdx = 2;
+		const bool quantise = argIdx < argc && std::string(argv[argIdx]) == "quantise";
+		if (quantise)
+			argIdx++;
+		if (argc > argIdx) {
+			filePath = modelName = argv[argIdx];
 			// determine if we're meant to be writing these in the source directory
 			bool isInPlace = false;
-			if (argc > 3) {
-				std::string arg3 = argv[3];
+			if (argc > argIdx + 1) {
+				std::string arg3 = argv[argIdx + 1];
 				isInPlace = (arg3 == "inplace" || arg3 == "true");
 
 				// find all of the models
@@ -240,7 +464,8 @@ start:
 				}
 			}
 			SetupRenderer();
-			RunCompiler(modelName, filePath, isInPlace);
+			if (!RunCompiler(s_renderer.get(), modelName, filePath, isInPlace, quantise))
+				exitCode = 1;
 		}
 		break;
 	}
@@ -248,8 +473,21 @@ start:
 	case MODE_MODELBATCHEXPORT: {
 		// determine if we're meant to be writing these in the source directory
 		bool isInPlace = false;
-		if (argc > 2) {
-			std::string arg2 = argv[2];
+		int flags = 0;
+		int argIdx = 2;
+		for (; argIdx < argc; argIdx++) {
+			const std::string arg = argv[argIdx];
+			if (arg == "force")
+				flags |= BATCH_FORCE;
+			else if (arg == "dryrun")
+				flags |= BATCH_DRY_RUN;
+			else if (arg == "quantise")
+				flags |= BATCH_QUANTISE;
+			else
+				break;
+		}
+		if (argIdx < argc) {
+			std::string arg2 = argv[argIdx];
 			isInPlace = (arg2 == "inplace" || arg2 == "true");
 
 			if (!isInPlace && !arg2.empty()) {
@@ -275,27 +513,8 @@ start:
 		}
 
 		SetupRenderer();
-
-#ifndef USES_THREADS
-		for (auto &modelName : list_model) {
-			RunCompiler(modelName.first, modelName.second, isInPlace);
-		}
-#else
-		std::deque<Job::Handle> handles;
-		for (auto &modelName : list_model) {
-			handles.push_back(asyncJobQueue->Queue(new CompileJob(modelName.first, modelName.second, isInPlace)));
-		}
-
-		while (true) {
-			asyncJobQueue->FinishJobs();
-			bool hasJobs = false;
-			for (auto &handle : handles)
-				hasJobs |= handle.HasJob();
-
-			if (!hasJobs)
-				break;
-		}
-#endif
+		if (RunBatchCompiler(list_model, isInPlace, flags))
+			exitCode = 1;
 		break;
 	}
 
@@ -308,6 +527,7 @@ start:
 
 	case MODE_USAGE_ERROR:
 		Output("modelcompiler: unknown mode %s\n", argv[1]);
+		exitCode = 1;
 		// fall through
 
 	case MODE_USAGE:
@@ -316,8 +536,16 @@ start:
 			"available modes:\n"
 			"    -compile          [-c ...]          model compiler\n"
 			"    -compile inplace  [-c ... inplace]  model compiler\n"
+			"    -compile quantise [-c quantise ...] model compiler, writing quantised meshes\n"
 			"    -batch            [-b]              batch mode output into users home/Pioneer directory\n"
 			"    -batch inplace    [-b inplace]      batch mode output into the source folder\n"
+			"    -batch <dir>      [-b <dir>]        batch mode for the models under <dir>, output in place\n"
+			"    -batch force ...  [-b force ...]    batch mode, compiling models that are up to date too\n"
+			"    -batch dryrun ... [-b dryrun ...]   list the models batch mode would compile\n"
+			"    -batch quantise ...                 batch mode, writing quantised meshes (byte normals\n"
+			"                                        and tangents, half float UVs: about half the size)\n"
+			"                                        (batch mode uses all cores unless WorkerThreads is set,\n"
+			"                                        and skips models that haven't changed since the last batch)\n"
 			"    -version          [-v]              show version\n"
 			"    -help             [-h,-?]           this help\n");
 		break;
@@ -327,13 +555,11 @@ start:
 	Profiler::dumphtml(FileSystem::JoinPathBelow(FileSystem::GetUserDir(), "profiler").c_str());
 #endif
 
+	s_threadRenderers.clear();
 	Graphics::Uninit();
 	SDL_Quit();
 	FileSystem::Uninit();
-#ifdef USES_THREADS
-	asyncJobQueue.reset();
-#endif
 	//exit(0);
 
-	return 0;
+	return exitCode;
 }
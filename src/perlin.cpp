@@ -4,6 +4,17 @@
 #include "perlin.h"
 #include <math.h>
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#define PERLIN_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PERLIN_SSE 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PERLIN_NEON 1
+#endif
+
 /* Simplex.cpp
  *
  * Copyright 2007 Eliot Eshelman
@@ -202,6 +213,284 @@ double noise(const vector3d &p)
 	return 32.0 * (n0 + n1 + n2 + n3);
 }
 
+// Batched 3D raw Simplex noise, out[i] = noise(frequency[i] * p[i])
+// Same arithmetic as noise() above, but the corner contributions are
+// selected rather than branched on, so consecutive points don't depend on
+// the branch predictor and the loop can keep several of them in flight.
+static void NoiseScalar(const vector3d *p, const double *frequency, double *out, size_t count)
+{
+	for (size_t idx = 0; idx < count; idx++) {
+		const vector3d pos = frequency[idx] * p[idx];
+
+		const double s = (pos.x + pos.y + pos.z) * F3;
+		const int i = fastfloor(pos.x + s);
+		const int j = fastfloor(pos.y + s);
+		const int k = fastfloor(pos.z + s);
+
+		const double t = (i + j + k) * G3;
+		const double x0 = pos.x - (i - t);
+		const double y0 = pos.y - (j - t);
+		const double z0 = pos.z - (k - t);
+
+		const int x_ge_y = x0 >= y0;
+		const int y_ge_z = y0 >= z0;
+		const int x_ge_z = x0 >= z0;
+
+		const int i1 = x_ge_y & x_ge_z;
+		const int j1 = y_ge_z & (!x_ge_y);
+		const int k1 = (!x_ge_z) & (!y_ge_z);
+
+		const int i2 = x_ge_y | x_ge_z;
+		const int j2 = (!x_ge_y) | y_ge_z;
+		const int k2 = !(x_ge_z & y_ge_z);
+
+		const double x1 = x0 - i1 + G3;
+		const double y1 = y0 - j1 + G3;
+		const double z1 = z0 - k1 + G3;
+		const double x2 = x0 - i2 + G3mul2;
+		const double y2 = y0 - j2 + G3mul2;
+		const double z2 = z0 - k2 + G3mul2;
+		const double x3 = x0 - 1.0 + G3mul3;
+		const double y3 = y0 - 1.0 + G3mul3;
+		const double z3 = z0 - 1.0 + G3mul3;
+
+		const int ii = i & 255;
+		const int jj = j & 255;
+		const int kk = k & 255;
+		const double *g0 = grad3[mod12[perm[ii + perm[jj + perm[kk]]]]];
+		const double *g1 = grad3[mod12[perm[ii + i1 + perm[jj + j1 + perm[kk + k1]]]]];
+		const double *g2 = grad3[mod12[perm[ii + i2 + perm[jj + j2 + perm[kk + k2]]]]];
+		const double *g3 = grad3[mod12[perm[ii + 1 + perm[jj + 1 + perm[kk + 1]]]]];
+
+		const double t0 = 0.6 - x0 * x0 - y0 * y0 - z0 * z0;
+		const double t1 = 0.6 - x1 * x1 - y1 * y1 - z1 * z1;
+		const double t2 = 0.6 - x2 * x2 - y2 * y2 - z2 * z2;
+		const double t3 = 0.6 - x3 * x3 - y3 * y3 - z3 * z3;
+
+		const double n0 = t0 > 0.0 ? (t0 * t0) * (t0 * t0) * dot(g0, x0, y0, z0) : 0.0;
+		const double n1 = t1 > 0.0 ? (t1 * t1) * (t1 * t1) * dot(g1, x1, y1, z1) : 0.0;
+		const double n2 = t2 > 0.0 ? (t2 * t2) * (t2 * t2) * dot(g2, x2, y2, z2) : 0.0;
+		const double n3 = t3 > 0.0 ? (t3 * t3) * (t3 * t3) * dot(g3, x3, y3, z3) : 0.0;
+
+		out[idx] = 32.0 * (n0 + n1 + n2 + n3);
+	}
+}
+
+#if defined(PERLIN_AVX) || defined(PERLIN_SSE) || defined(PERLIN_NEON)
+
+namespace {
+	// Minimal wrapper over one vector register of doubles. Comparisons
+	// return all-ones lanes stored in the same register type; AndNot(a, b)
+	// is ~a & b.
+#if defined(PERLIN_AVX)
+	struct doubleN {
+		static constexpr int WIDTH = 4;
+		__m256d v;
+	};
+
+	inline doubleN Broadcast(double d) { return { _mm256_set1_pd(d) }; }
+	inline doubleN Load(const double *p) { return { _mm256_loadu_pd(p) }; }
+	inline void Store(double *p, doubleN a) { _mm256_storeu_pd(p, a.v); }
+	inline doubleN operator+(doubleN a, doubleN b) { return { _mm256_add_pd(a.v, b.v) }; }
+	inline doubleN operator-(doubleN a, doubleN b) { return { _mm256_sub_pd(a.v, b.v) }; }
+	inline doubleN operator*(doubleN a, doubleN b) { return { _mm256_mul_pd(a.v, b.v) }; }
+	inline doubleN operator&(doubleN a, doubleN b) { return { _mm256_and_pd(a.v, b.v) }; }
+	inline doubleN operator|(doubleN a, doubleN b) { return { _mm256_or_pd(a.v, b.v) }; }
+	inline doubleN AndNot(doubleN a, doubleN b) { return { _mm256_andnot_pd(a.v, b.v) }; }
+	inline doubleN GreaterThan(doubleN a, doubleN b) { return { _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ) }; }
+	inline doubleN GreaterEqual(doubleN a, doubleN b) { return { _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ) }; }
+	inline int MoveMask(doubleN a) { return _mm256_movemask_pd(a.v); }
+	// truncates towards zero into ints, and back into doubles
+	inline doubleN Truncate(doubleN a, int *ints)
+	{
+		const __m128i i = _mm256_cvttpd_epi32(a.v);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(ints), i);
+		return { _mm256_cvtepi32_pd(i) };
+	}
+#elif defined(PERLIN_SSE)
+	struct doubleN {
+		static constexpr int WIDTH = 2;
+		__m128d v;
+	};
+
+	inline doubleN Broadcast(double d) { return { _mm_set1_pd(d) }; }
+	inline doubleN Load(const double *p) { return { _mm_loadu_pd(p) }; }
+	inline void Store(double *p, doubleN a) { _mm_storeu_pd(p, a.v); }
+	inline doubleN operator+(doubleN a, doubleN b) { return { _mm_add_pd(a.v, b.v) }; }
+	inline doubleN operator-(doubleN a, doubleN b) { return { _mm_sub_pd(a.v, b.v) }; }
+	inline doubleN operator*(doubleN a, doubleN b) { return { _mm_mul_pd(a.v, b.v) }; }
+	inline doubleN operator&(doubleN a, doubleN b) { return { _mm_and_pd(a.v, b.v) }; }
+	inline doubleN operator|(doubleN a, doubleN b) { return { _mm_or_pd(a.v, b.v) }; }
+	inline doubleN AndNot(doubleN a, doubleN b) { return { _mm_andnot_pd(a.v, b.v) }; }
+	inline doubleN GreaterThan(doubleN a, doubleN b) { return { _mm_cmpgt_pd(a.v, b.v) }; }
+	inline doubleN GreaterEqual(doubleN a, doubleN b) { return { _mm_cmpge_pd(a.v, b.v) }; }
+	inline int MoveMask(doubleN a) { return _mm_movemask_pd(a.v); }
+	inline doubleN Truncate(doubleN a, int *ints)
+	{
+		const __m128i i = _mm_cvttpd_epi32(a.v);
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(ints), i);
+		return { _mm_cvtepi32_pd(i) };
+	}
+#elif defined(PERLIN_NEON)
+	struct doubleN {
+		static constexpr int WIDTH = 2;
+		float64x2_t v;
+	};
+
+	inline uint64x2_t Bits(doubleN a) { return vreinterpretq_u64_f64(a.v); }
+	inline doubleN FromBits(uint64x2_t a) { return { vreinterpretq_f64_u64(a) }; }
+
+	inline doubleN Broadcast(double d) { return { vdupq_n_f64(d) }; }
+	inline doubleN Load(const double *p) { return { vld1q_f64(p) }; }
+	inline void Store(double *p, doubleN a) { vst1q_f64(p, a.v); }
+	inline doubleN operator+(doubleN a, doubleN b) { return { vaddq_f64(a.v, b.v) }; }
+	inline doubleN operator-(doubleN a, doubleN b) { return { vsubq_f64(a.v, b.v) }; }
+	inline doubleN operator*(doubleN a, doubleN b) { return { vmulq_f64(a.v, b.v) }; }
+	inline doubleN operator&(doubleN a, doubleN b) { return FromBits(vandq_u64(Bits(a), Bits(b))); }
+	inline doubleN operator|(doubleN a, doubleN b) { return FromBits(vorrq_u64(Bits(a), Bits(b))); }
+	inline doubleN AndNot(doubleN a, doubleN b) { return FromBits(vbicq_u64(Bits(b), Bits(a))); }
+	inline doubleN GreaterThan(doubleN a, doubleN b) { return FromBits(vcgtq_f64(a.v, b.v)); }
+	inline doubleN GreaterEqual(doubleN a, doubleN b) { return FromBits(vcgeq_f64(a.v, b.v)); }
+	inline int MoveMask(doubleN a)
+	{
+		const uint64x2_t bits = vshrq_n_u64(Bits(a), 63);
+		return int(vgetq_lane_u64(bits, 0) | (vgetq_lane_u64(bits, 1) << 1));
+	}
+	inline doubleN Truncate(doubleN a, int *ints)
+	{
+		// narrowed to int first, as the scalar path converts long to int
+		const int32x2_t i = vmovn_s64(vcvtq_s64_f64(a.v));
+		vst1_s32(ints, i);
+		return { vcvtq_f64_s64(vmovl_s32(i)) };
+	}
+#endif
+
+	constexpr int WIDTH = doubleN::WIDTH;
+
+	// fastfloor() in lanes
+	inline doubleN FastFloor(doubleN a, int *ints)
+	{
+		const doubleN positive = GreaterThan(a, Broadcast(0.0));
+		return Truncate((positive & a) | AndNot(positive, a - Broadcast(1.0)), ints);
+	}
+
+	// the gradients of the corner of each lane, in lanes
+	struct GradientN {
+		doubleN x, y, z;
+	};
+
+	inline GradientN LoadGradient(const int *gi)
+	{
+		alignas(32) double x[WIDTH], y[WIDTH], z[WIDTH];
+		for (int lane = 0; lane < WIDTH; lane++) {
+			x[lane] = grad3[gi[lane]][0];
+			y[lane] = grad3[gi[lane]][1];
+			z[lane] = grad3[gi[lane]][2];
+		}
+		return { Load(x), Load(y), Load(z) };
+	}
+
+	// one corner's contribution, as in NoiseScalar()
+	inline doubleN Contribution(const GradientN &g, doubleN x, doubleN y, doubleN z)
+	{
+		const doubleN t = Broadcast(0.6) - x * x - y * y - z * z;
+		const doubleN t2 = t * t;
+		const doubleN n = t2 * t2 * (g.x * x + g.y * y + g.z * z);
+		return GreaterThan(t, Broadcast(0.0)) & n;
+	}
+
+	// WIDTH points per iteration; the hashing into the permutation table
+	// is done per lane, everything else in lanes
+	size_t NoiseN(const vector3d *p, const double *frequency, double *out, size_t count)
+	{
+		const doubleN one = Broadcast(1.0);
+		size_t idx = 0;
+		for (; idx + WIDTH <= count; idx += WIDTH) {
+			alignas(32) double px[WIDTH], py[WIDTH], pz[WIDTH];
+			for (int lane = 0; lane < WIDTH; lane++) {
+				px[lane] = p[idx + lane].x;
+				py[lane] = p[idx + lane].y;
+				pz[lane] = p[idx + lane].z;
+			}
+			const doubleN f = Load(frequency + idx);
+			const doubleN x = f * Load(px), y = f * Load(py), z = f * Load(pz);
+
+			const doubleN s = (x + y + z) * Broadcast(F3);
+			alignas(16) int i[4], j[4], k[4];
+			const doubleN fi = FastFloor(x + s, i);
+			const doubleN fj = FastFloor(y + s, j);
+			const doubleN fk = FastFloor(z + s, k);
+
+			// the integer sum is exact in doubles, as long as the ints are
+			const doubleN t = (fi + fj + fk) * Broadcast(G3);
+			const doubleN x0 = x - (fi - t);
+			const doubleN y0 = y - (fj - t);
+			const doubleN z0 = z - (fk - t);
+
+			const doubleN x_ge_y = GreaterEqual(x0, y0);
+			const doubleN y_ge_z = GreaterEqual(y0, z0);
+			const doubleN x_ge_z = GreaterEqual(x0, z0);
+
+			const doubleN i1 = x_ge_y & x_ge_z & one;
+			const doubleN j1 = AndNot(x_ge_y, y_ge_z) & one;
+			const doubleN k1 = AndNot(x_ge_z | y_ge_z, one);
+			const doubleN i2 = (x_ge_y | x_ge_z) & one;
+			const doubleN j2 = AndNot(AndNot(y_ge_z, x_ge_y), one);
+			const doubleN k2 = AndNot(x_ge_z & y_ge_z, one);
+
+			const doubleN x1 = x0 - i1 + Broadcast(G3);
+			const doubleN y1 = y0 - j1 + Broadcast(G3);
+			const doubleN z1 = z0 - k1 + Broadcast(G3);
+			const doubleN x2 = x0 - i2 + Broadcast(G3mul2);
+			const doubleN y2 = y0 - j2 + Broadcast(G3mul2);
+			const doubleN z2 = z0 - k2 + Broadcast(G3mul2);
+			const doubleN x3 = x0 - one + Broadcast(G3mul3);
+			const doubleN y3 = y0 - one + Broadcast(G3mul3);
+			const doubleN z3 = z0 - one + Broadcast(G3mul3);
+
+			const int xy = MoveMask(x_ge_y), yz = MoveMask(y_ge_z), xz = MoveMask(x_ge_z);
+			int gi0[WIDTH], gi1[WIDTH], gi2[WIDTH], gi3[WIDTH];
+			for (int lane = 0; lane < WIDTH; lane++) {
+				const int x_ge_y = (xy >> lane) & 1;
+				const int y_ge_z = (yz >> lane) & 1;
+				const int x_ge_z = (xz >> lane) & 1;
+				const int ii = i[lane] & 255;
+				const int jj = j[lane] & 255;
+				const int kk = k[lane] & 255;
+				const int i1 = x_ge_y & x_ge_z;
+				const int j1 = y_ge_z & (!x_ge_y);
+				const int k1 = (!x_ge_z) & (!y_ge_z);
+				const int i2 = x_ge_y | x_ge_z;
+				const int j2 = (!x_ge_y) | y_ge_z;
+				const int k2 = !(x_ge_z & y_ge_z);
+				gi0[lane] = mod12[perm[ii + perm[jj + perm[kk]]]];
+				gi1[lane] = mod12[perm[ii + i1 + perm[jj + j1 + perm[kk + k1]]]];
+				gi2[lane] = mod12[perm[ii + i2 + perm[jj + j2 + perm[kk + k2]]]];
+				gi3[lane] = mod12[perm[ii + 1 + perm[jj + 1 + perm[kk + 1]]]];
+			}
+
+			const doubleN n0 = Contribution(LoadGradient(gi0), x0, y0, z0);
+			const doubleN n1 = Contribution(LoadGradient(gi1), x1, y1, z1);
+			const doubleN n2 = Contribution(LoadGradient(gi2), x2, y2, z2);
+			const doubleN n3 = Contribution(LoadGradient(gi3), x3, y3, z3);
+
+			Store(out + idx, Broadcast(32.0) * (n0 + n1 + n2 + n3));
+		}
+		return idx;
+	}
+} // namespace
+
+#endif
+
+void noise(const vector3d *p, const double *frequency, double *out, size_t count)
+{
+	size_t done = 0;
+#if defined(PERLIN_AVX) || defined(PERLIN_SSE) || defined(PERLIN_NEON)
+	done = NoiseN(p, frequency, out, count);
+#endif
+	NoiseScalar(p + done, frequency + done, out + done, count - done);
+}
+
 #ifdef UNIT_TEST
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,6 +6,10 @@
 
 #include "vector3.h"
 
+#include <cstddef>
+
 double noise(const vector3d &p);
+// out[i] = noise(frequency[i] * p[i]) for count points
+void noise(const vector3d *p, const double *frequency, double *out, size_t count);
 
 #endif /* _PERLIN_H */
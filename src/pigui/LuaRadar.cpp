@@ -26,6 +26,9 @@ void LuaObject<RadarWidget>::RegisterClass()
 		.AddMember("minZoom", &RadarWidget::GetMinZoom, &RadarWidget::SetMinZoom)
 		.AddMember("radius", &RadarWidget::GetRadius)
 		.AddMember("center", &RadarWidget::GetCenter)
+		.AddMember("drawContacts", &RadarWidget::GetDrawContacts, &RadarWidget::SetDrawContacts)
+		.AddMember("blipSize", &RadarWidget::GetBlipSize, &RadarWidget::SetBlipSize)
+		.AddMember("numContactsDrawn", &RadarWidget::GetNumContactsDrawn)
 		.AddFunction("Draw", &RadarWidget::DrawPiGui)
 		.StopRecording();
 
@@ -2,27 +2,42 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "PerfInfo.h"
+#include "BodyPool.h"
 #include "Frame.h"
 #include "Game.h"
 #include "Input.h"
+#include "JobStats.h"
 #include "LuaPiGui.h"
+#include "ModelCache.h"
 #include "Pi.h"
 #include "Player.h"
+#include "QualityGovernor.h"
 #include "SectorView.h"
 #include "Space.h"
+#include "collider/GeomTree.h"
 #include "core/Log.h"
+#include "core/MemoryTag.h"
+#include "core/TaskGraph.h"
+#include "galaxy/Galaxy.h"
+#include "graphics/GPUMemory.h"
 #include "graphics/Renderer.h"
 #include "graphics/Stats.h"
 #include "graphics/Texture.h"
+#include "graphics/TextureLoader.h"
 #include "lua/Lua.h"
+#include "lua/LuaAllocProfiler.h"
 #include "lua/LuaManager.h"
+#include "lua/LuaProfiler.h"
+#include "profiler/Profiler.h"
 #include "scenegraph/Model.h"
+#include "sound/Sound.h"
 #include "JsonUtils.h"
 #include "FileSystem.h"
 
 #include <fmt/core.h>
 #include <imgui/imgui.h>
 #include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <fstream>
 #include <functional>
@@ -55,9 +70,8 @@ struct PerfInfo::ImGuiState {
 PerfInfo::PerfInfo() :
 	m_state(new ImGuiState({}))
 {
-	m_fpsCounter.history.fill(0.0);
-	m_physCounter.history.fill(0.0);
-	m_piguiCounter.history.fill(0.0);
+	for (CounterType ct : { COUNTER_FPS, COUNTER_PHYS, COUNTER_PIGUI, COUNTER_LUAGC })
+		ClearCounter(ct);
 }
 
 PerfInfo::~PerfInfo()
@@ -118,6 +132,7 @@ PerfInfo::CounterInfo &PerfInfo::GetCounter(CounterType ct)
 	case COUNTER_FPS: return m_fpsCounter;
 	case COUNTER_PHYS: return m_physCounter;
 	case COUNTER_PIGUI: return m_piguiCounter;
+	case COUNTER_LUAGC: return m_luaGCCounter;
 	// default value is never reached, calm down -Werror=return-type
 	default: return m_fpsCounter;
 	}
@@ -130,6 +145,16 @@ void PerfInfo::ClearCounter(CounterType ct)
 	counter.average = 0.;
 	counter.max = 0.;
 	counter.min = 0.;
+
+	counter.samples.fill(0.);
+	counter.numSamples = 0;
+	counter.nextSample = 0;
+	counter.buckets.fill(0.);
+}
+
+static int GetFrameTimeBucket(float ms, int numBuckets)
+{
+	return ms < 1.0f ? 0 : std::min(int(std::log2(ms)) + 1, numBuckets - 1);
 }
 
 void PerfInfo::UpdateCounter(CounterType ct, float deltaTime)
@@ -153,12 +178,30 @@ void PerfInfo::UpdateCounter(CounterType ct, float deltaTime)
 		counter.min = std::min(counter.min, i);
 	});
 	counter.average = timeAccum / double(NUM_FRAMES);
+
+	// the longer window, dropping the oldest sample from its bucket
+	const float ms = deltaTime * 1e3;
+	if (counter.numSamples == NUM_SAMPLES)
+		counter.buckets[GetFrameTimeBucket(counter.samples[counter.nextSample], NUM_BUCKETS)] -= 1.0f;
+	counter.samples[counter.nextSample] = ms;
+	counter.buckets[GetFrameTimeBucket(ms, NUM_BUCKETS)] += 1.0f;
+	counter.nextSample = (counter.nextSample + 1) % NUM_SAMPLES;
+	counter.numSamples = std::min(counter.numSamples + 1, size_t(NUM_SAMPLES));
 }
 
 void PerfInfo::Update(float deltaTime)
 {
 	UpdateCounter(COUNTER_FPS, deltaTime);
 
+	// a hitch report only wants the jobs finished in its own frame
+	static std::vector<JobStats::FinishCost> s_finishes;
+	JobStats::TakeSlowFinishes(s_finishes);
+
+	if (!m_state->updatePause) {
+		std::move(m_frameStarts.begin() + 1, m_frameStarts.end(), m_frameStarts.begin());
+		m_frameStarts.back() = JobStats::Now();
+	}
+
 	lastUpdateTime += deltaTime;
 	if (lastUpdateTime > 1.0) {
 		lastUpdateTime = fmod(lastUpdateTime, 1.0);
@@ -175,6 +218,33 @@ void PerfInfo::UpdateFrameInfo(int fS, int pfS)
 	physFramesThisSecond = pfS;
 }
 
+void PerfInfo::ReportHitch(double frameMs)
+{
+	numHitches++;
+	lastHitchMs = frameMs;
+
+	std::string report = fmt::format("Hitch: frame took {:.1f} ms (update {:.1f} ms, pigui {:.1f} ms, Lua GC {:.1f} ms)\n",
+		frameMs, m_physCounter.history.back(), m_piguiCounter.history.back(), m_luaGCCounter.history.back());
+
+	// self time of every thread, so it can add up to more than the frame
+	constexpr Profiler::u32 MAX_CALLERS = 8;
+	const char *names[MAX_CALLERS];
+	Profiler::f64 selfMs[MAX_CALLERS];
+	const Profiler::u32 numCallers = Profiler::topcallers(names, selfMs, MAX_CALLERS);
+	for (Profiler::u32 i = 0; i < numCallers; i++)
+		report += fmt::format("  {:8.2f} ms  {}\n", selfMs[i], names[i]);
+
+	std::vector<JobStats::FinishCost> finishes;
+	const float finishMs = JobStats::TakeSlowFinishes(finishes);
+	if (!finishes.empty()) {
+		report += fmt::format("  {:.2f} ms in job OnFinish calls, the slowest:\n", finishMs);
+		for (const JobStats::FinishCost &cost : finishes)
+			report += fmt::format("  {:8.2f} ms  {}\n", cost.ms, cost.name);
+	}
+
+	Log::Info("{}", report);
+}
+
 void PerfInfo::SetUpdatePause(bool pause)
 {
 	m_state->updatePause = pause;
@@ -221,6 +291,11 @@ void PerfInfo::DrawPerfWindow()
 		ImGui::PlotLines("Frame Time (ms)", m_fpsCounter.history.data(), m_fpsCounter.history.size(), 0, nullptr, 2.0, 33.0, { 0, 45 });
 		ImGui::PlotLines("Update Time (ms)", m_physCounter.history.data(), m_physCounter.history.size(), 0, nullptr, 0.0, 10.0, { 0, 25 });
 		ImGui::PlotLines("Pigui Time (ms)", m_piguiCounter.history.data(), m_piguiCounter.history.size(), 0, nullptr, 0.0, 5.0, { 0, 25 });
+		if (::Lua::manager->IsManualGC())
+			ImGui::PlotLines("Lua GC Time (ms)", m_luaGCCounter.history.data(), m_luaGCCounter.history.size(), 0, nullptr, 0.0, 5.0, { 0, 25 });
+		DrawGPUTimings();
+		DrawFrameTimeDistribution();
+		DrawQualityGovernor();
 		if (ImGui::Button(m_state->updatePause ? "Unpause" : "Pause")) {
 			SetUpdatePause(!m_state->updatePause);
 		}
@@ -228,6 +303,18 @@ void PerfInfo::DrawPerfWindow()
 		if (process_mem.currentMemSize)
 			ImGui::Text("%.1f MB process memory usage (%.1f MB peak)", (process_mem.currentMemSize * 1e-3), (process_mem.peakMemSize * 1e-3));
 		ImGui::Text("%.3f MB Lua memory usage", double(lua_mem) / scale_MB);
+		if (::Lua::manager->IsManualGC()) {
+			const LuaManager::GCStats &gc = ::Lua::manager->GetGCStats();
+			ImGui::Text("Lua GC: %.2f ms avg (%u steps of %d KB last frame), pause %d%%, %llu cycles (%llu forced)",
+				m_luaGCCounter.average, gc.lastNumSteps, gc.stepKB, gc.pause,
+				(unsigned long long)gc.numCycles, (unsigned long long)gc.numForcedCycles);
+		}
+		DrawMemoryTags();
+		DrawBodyPools();
+		const GeomTree::SharedStats geomTrees = GeomTree::GetSharedStats();
+		ImGui::Text("%zu collision trees in %zu uses: %.3f MB (%.3f MB saved by sharing)",
+			geomTrees.numTrees, geomTrees.numUses, double(geomTrees.memoryUsed) / scale_MB, double(geomTrees.memorySaved) / scale_MB);
+		ImGui::Text("%u audio stream underruns", Sound::GetUnderrunCount());
 		ImGui::Spacing();
 
 		if (ImGui::BeginTabBar("PerfInfoTabs")) {
@@ -237,6 +324,17 @@ void PerfInfo::DrawPerfWindow()
 				ImGui::EndTabItem();
 			}
 
+			if (ImGui::BeginTabItem("Jobs")) {
+				DrawJobTimeline();
+				DrawJobStats();
+				ImGui::EndTabItem();
+			}
+
+			if (ImGui::BeginTabItem("Lua")) {
+				DrawLuaProfiler();
+				ImGui::EndTabItem();
+			}
+
 			if (false && ImGui::BeginTabItem("Input")) {
 				DrawInputDebug();
 				ImGui::EndTabItem();
@@ -247,6 +345,11 @@ void PerfInfo::DrawPerfWindow()
 					DrawWorldViewStats();
 					ImGui::EndTabItem();
 				}
+
+				if (ImGui::BeginTabItem("Galaxy")) {
+					DrawGalaxyCacheStats();
+					ImGui::EndTabItem();
+				}
 			}
 
 			PiGui::RunHandler(Pi::GetFrameTime(), "debug-tabs");
@@ -260,6 +363,171 @@ void PerfInfo::DrawPerfWindow()
 	PiGui::RunHandler(Pi::GetFrameTime(), "debug");
 }
 
+void PerfInfo::DrawGPUTimings()
+{
+	const std::vector<Graphics::Stats::GPUTiming> &timings = Pi::renderer->GetStats().GetGPUTimings();
+	if (timings.empty() || !ImGui::TreeNode("GPU Time"))
+		return;
+
+	// scopes are listed depth-first, so indenting by depth shows the nesting
+	for (const Graphics::Stats::GPUTiming &timing : timings)
+		ImGui::Text("%*s%s: %.2f ms", int(timing.depth * 2), "", timing.name, timing.milliseconds);
+
+	ImGui::TreePop();
+}
+
+void PerfInfo::DrawFrameTimeDistribution()
+{
+	if (!ImGui::TreeNode("Frame Time Distribution"))
+		return;
+
+	const auto counterRow = [](const char *name, const CounterInfo &counter) {
+		if (!counter.numSamples)
+			return;
+
+		std::vector<float> sorted(counter.samples.begin(), counter.samples.begin() + counter.numSamples);
+		std::sort(sorted.begin(), sorted.end());
+		const auto percentile = [&](float fraction) {
+			return sorted[std::min(sorted.size() - 1, size_t(fraction * sorted.size()))];
+		};
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(name);
+		for (float value : { percentile(0.50f), percentile(0.95f), percentile(0.99f), sorted.back() }) {
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", value);
+		}
+	};
+
+	ImGui::Text("over the last %zu frames, in ms", m_fpsCounter.numSamples);
+	if (ImGui::BeginTable("Frame Time Percentiles", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+		for (const char *label : { "", "p50", "p95", "p99", "max" })
+			ImGui::TableSetupColumn(label);
+		ImGui::TableHeadersRow();
+
+		counterRow("Frame", m_fpsCounter);
+		counterRow("Update", m_physCounter);
+		counterRow("PiGui", m_piguiCounter);
+		if (::Lua::manager->IsManualGC())
+			counterRow("Lua GC", m_luaGCCounter);
+		ImGui::EndTable();
+	}
+
+	ImGui::PlotHistogram("Frames by Time", m_fpsCounter.buckets.data(), NUM_BUCKETS, 0,
+		"<1 ms ... >=512 ms, doubling", 0.0f, FLT_MAX, { 0, 45 });
+	ImGui::Text("%d hitches over %.0f ms, the last %.1f ms", numHitches, Pi::GetApp()->GetHitchThreshold(), lastHitchMs);
+
+	ImGui::TreePop();
+}
+
+void PerfInfo::DrawQualityGovernor()
+{
+	const QualityGovernor *governor = Pi::GetApp()->GetQualityGovernor();
+	if (!governor || !ImGui::TreeNode("Quality Governor"))
+		return;
+
+	static const char *stateNames[] = { "measuring", "steady", "over budget, nothing can be turned down now", "time to spare" };
+	ImGui::Text("target %.1f ms, p90 frame %.2f ms, GPU %.2f ms: %s", governor->GetTargetMs(),
+		governor->GetFramePercentile(), governor->GetGPUPercentile(), stateNames[governor->GetState()]);
+	ImGui::Text("raising after %.0f s with time to spare", governor->GetRaiseHold());
+
+	const std::vector<QualityGovernor::Knob> &knobs = governor->GetKnobs();
+	if (ImGui::BeginTable("Quality Knobs", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+		for (const char *label : { "Knob", "Level", "Min", "Max" })
+			ImGui::TableSetupColumn(label);
+		ImGui::TableHeadersRow();
+
+		for (const QualityGovernor::Knob &knob : knobs) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(knob.name.c_str());
+			for (int value : { knob.get(), knob.min, knob.max }) {
+				ImGui::TableNextColumn();
+				ImGui::Text("%d", value);
+			}
+		}
+		ImGui::EndTable();
+	}
+
+	if (governor->GetLastChangedKnob() >= 0)
+		ImGui::Text("last changed %s, %.0f s ago", knobs[governor->GetLastChangedKnob()].name.c_str(),
+			SDL_GetTicks() * 1e-3 - governor->GetLastChangeTime());
+
+	ImGui::TreePop();
+}
+
+void PerfInfo::DrawMemoryTags()
+{
+	if (!ImGui::TreeNode("Memory by Subsystem"))
+		return;
+
+	if (ImGui::BeginTable("Memory Tags", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+		ImGui::TableSetupColumn("");
+		ImGui::TableSetupColumn("In Use (MB)");
+		ImGui::TableSetupColumn("Peak (MB)");
+		ImGui::TableSetupColumn("Allocations");
+		ImGui::TableHeadersRow();
+
+		for (int i = MemoryTag::UNTAGGED + 1; i < MemoryTag::MAX_TAGS; i++) {
+			const MemoryTag::Tag tag = MemoryTag::Tag(i);
+			const MemoryTag::Stats stats = MemoryTag::GetStats(tag);
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(MemoryTag::GetName(tag));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", double(stats.bytes) / scale_MB);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", double(stats.highWater) / scale_MB);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.numAllocs);
+		}
+		ImGui::EndTable();
+	}
+
+	if (ImGui::Button("Reset Peaks"))
+		MemoryTag::ResetHighWater();
+
+	ImGui::TreePop();
+}
+
+void PerfInfo::DrawBodyPools()
+{
+	if (!ImGui::TreeNode("Body Pools"))
+		return;
+
+	std::vector<BodyPool::Stats> pools;
+	BodyPool::GetAllStats(pools);
+	if (ImGui::BeginTable("Body Pools", 6, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+		ImGui::TableSetupColumn("");
+		ImGui::TableSetupColumn("In Use");
+		ImGui::TableSetupColumn("Peak");
+		ImGui::TableSetupColumn("Slots");
+		ImGui::TableSetupColumn("Size (KB)");
+		ImGui::TableSetupColumn("Not Pooled");
+		ImGui::TableHeadersRow();
+
+		for (const BodyPool::Stats &stats : pools) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(stats.name);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", stats.numInUse);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", stats.highWater);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", stats.numSlots);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", double(stats.numSlots * stats.slotSize) / 1024.0);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.numFallbacks);
+		}
+		ImGui::EndTable();
+	}
+
+	ImGui::TreePop();
+}
+
 void PerfInfo::DrawRendererStats()
 {
 	const Graphics::Stats::TFrameData &stats = Pi::renderer->GetStats().FrameStatsPrevious();
@@ -268,10 +536,21 @@ void PerfInfo::DrawRendererStats()
 	const Uint32 numLines = stats.m_stats[Graphics::Stats::STAT_NUM_LINES];
 	const Uint32 numPoints = stats.m_stats[Graphics::Stats::STAT_NUM_POINTS];
 	const Uint32 numCmdListFlushes = stats.m_stats[Graphics::Stats::STAT_NUM_CMDLIST_FLUSHES];
+	const Uint32 numProgramSwitches = stats.m_stats[Graphics::Stats::STAT_PROGRAM_SWITCHES];
+	const Uint32 numProgramSwitchesUnsorted = stats.m_stats[Graphics::Stats::STAT_PROGRAM_SWITCHES_UNSORTED];
+	const Uint32 numStateSwitches = stats.m_stats[Graphics::Stats::STAT_RENDER_STATE_SWITCHES];
+	const Uint32 numStateSwitchesUnsorted = stats.m_stats[Graphics::Stats::STAT_RENDER_STATE_SWITCHES_UNSORTED];
+	const Uint32 numDrawCallsBatched = stats.m_stats[Graphics::Stats::STAT_DRAWCALLS_BATCHED];
+	const Uint32 numPointLights = stats.m_stats[Graphics::Stats::STAT_POINT_LIGHTS];
+	const Uint32 numPointLightIndices = stats.m_stats[Graphics::Stats::STAT_POINT_LIGHT_INDICES];
+	const Uint32 numPointLightsDropped = stats.m_stats[Graphics::Stats::STAT_POINT_LIGHTS_DROPPED];
+	const Uint32 numUploadsFinished = stats.m_stats[Graphics::Stats::STAT_UPLOADS_FINISHED];
+	const Uint32 numUploadsInFlight = stats.m_stats[Graphics::Stats::STAT_UPLOADS_IN_FLIGHT];
 	const Uint32 numBuffersCreated = stats.m_stats[Graphics::Stats::STAT_CREATE_BUFFER];
 	const Uint32 numBuffersInUse = stats.m_stats[Graphics::Stats::STAT_BUFFER_INUSE];
 	const Uint32 numDynamicBuffersCreated = stats.m_stats[Graphics::Stats::STAT_DYNAMIC_DRAW_BUFFER_CREATED];
 	const Uint32 numDynamicBuffersInUse = stats.m_stats[Graphics::Stats::STAT_DYNAMIC_DRAW_BUFFER_INUSE];
+	const Uint32 dynamicBytesStreamed = stats.m_stats[Graphics::Stats::STAT_DYNAMIC_DRAW_BUFFER_BYTES];
 	const Uint32 numDrawBuffers = stats.m_stats[Graphics::Stats::STAT_DRAW_UNIFORM_BUFFER_INUSE];
 	const Uint32 numDrawBufferAllocs = stats.m_stats[Graphics::Stats::STAT_DRAW_UNIFORM_BUFFER_ALLOCS];
 	const Uint32 numRenderStates = stats.m_stats[Graphics::Stats::STAT_NUM_RENDER_STATES];
@@ -296,10 +575,30 @@ void PerfInfo::DrawRendererStats()
 	const Uint32 texArray2dMemUsage = stats.m_stats[Graphics::Stats::STAT_MEM_TEXTUREARRAY2D];
 	const Uint32 numCachedTextures = numTex2ds + numTexCubemaps + numTexArray2ds;
 	const Uint32 cachedTextureMemUsage = tex2dMemUsage + texCubeMemUsage + texArray2dMemUsage;
+	const Uint32 streamedTexMemUsage = stats.m_stats[Graphics::Stats::STAT_MEM_TEXTURE_STREAMED];
+	const Uint32 numTexMipLoads = stats.m_stats[Graphics::Stats::STAT_TEXTURE_MIP_LOADS];
+
+	const Uint32 patchPoolMemUsage = stats.m_stats[Graphics::Stats::STAT_MEM_GEOPATCH_POOL_INUSE];
+	const Uint32 patchPoolMemPeak = stats.m_stats[Graphics::Stats::STAT_MEM_GEOPATCH_POOL_PEAK];
+	const Uint32 patchPoolMemFree = stats.m_stats[Graphics::Stats::STAT_MEM_GEOPATCH_POOL_FREE];
+	const Uint32 patchSplitsPrefetched = stats.m_stats[Graphics::Stats::STAT_GEOPATCH_SPLITS_PREFETCHED];
+	const Uint32 patchMeshesPooled = stats.m_stats[Graphics::Stats::STAT_GEOPATCH_MESHES_POOLED];
+	const Uint32 patchMeshesReused = stats.m_stats[Graphics::Stats::STAT_GEOPATCH_MESHES_REUSED];
+	const Uint32 patchSplitsCancelled = stats.m_stats[Graphics::Stats::STAT_GEOPATCH_SPLITS_CANCELLED];
+	const Uint32 patchesDrawn = stats.m_stats[Graphics::Stats::STAT_GEOPATCH_DRAWN];
+	const Uint32 patchesCulledFrustum = stats.m_stats[Graphics::Stats::STAT_GEOPATCH_CULLED_FRUSTUM];
+	const Uint32 patchesCulledHorizon = stats.m_stats[Graphics::Stats::STAT_GEOPATCH_CULLED_HORIZON];
+	const Uint32 approachPrefetchHits = stats.m_stats[Graphics::Stats::STAT_APPROACH_PREFETCH_HITS];
+	const Uint32 approachPrefetchMisses = stats.m_stats[Graphics::Stats::STAT_APPROACH_PREFETCH_MISSES];
 
 	ImGui::Text("Renderer:");
-	ImGui::Text("%u Draw calls, %u CommandList flushes",
-		numDrawCalls, numCmdListFlushes);
+	ImGui::Text("%u Draw calls (%u merged by instancing), %u CommandList flushes",
+		numDrawCalls, numDrawCallsBatched, numCmdListFlushes);
+	ImGui::Text("%u Program switches (%u unsorted), %u Render state switches (%u unsorted)",
+		numProgramSwitches, numProgramSwitchesUnsorted, numStateSwitches, numStateSwitchesUnsorted);
+	ImGui::Text("%u Point lights in %u cluster entries (%u dropped)", numPointLights, numPointLightIndices, numPointLightsDropped);
+	if (Pi::renderer->HasUploadThread())
+		ImGui::Text("%u Threaded uploads finished, %u in flight", numUploadsFinished, numUploadsInFlight);
 
 	ImGui::Indent();
 	ImGui::Text("%u points", numPoints);
@@ -316,7 +615,14 @@ void PerfInfo::DrawRendererStats()
 		numDrawBillBoards, Pi::statNumPatches, Pi::statSceneTris);
 	ImGui::Text("%u Buffers Created (%u in use)", numBuffersCreated, numBuffersInUse);
 	ImGui::Text("%u Dynamic Draw Buffers Created (%u in use)", numDynamicBuffersCreated, numDynamicBuffersInUse);
+	ImGui::Text("%.1f KB Dynamic geometry streamed", dynamicBytesStreamed / 1024.f);
 	ImGui::Text("%u Draw Uniform Buffers (%u allocations)", numDrawBuffers, numDrawBufferAllocs);
+	ImGui::Text("GeoPatch data pool: %.3f MB in use, %.3f MB peak, %.3f MB free",
+		double(patchPoolMemUsage) / scale_MB, double(patchPoolMemPeak) / scale_MB, double(patchPoolMemFree) / scale_MB);
+	ImGui::Text("GeoPatch splits: %u prefetched, %u cancelled", patchSplitsPrefetched, patchSplitsCancelled);
+	ImGui::Text("Approach prefetch: %u hits, %u misses", approachPrefetchHits, approachPrefetchMisses);
+	ImGui::Text("GeoPatch meshes: %u pooled, %u reused", patchMeshesPooled, patchMeshesReused);
+	ImGui::Text("GeoPatches: %u drawn, %u culled by frustum, %u culled by horizon", patchesDrawn, patchesCulledFrustum, patchesCulledHorizon);
 	ImGui::Spacing();
 
 	ImGui::Text("%u cached shader programs", numShaderPrograms);
@@ -332,6 +638,406 @@ void PerfInfo::DrawRendererStats()
 	ImGui::Text("%u Texture2D in cache (%.3f MB)", numTex2ds, double(tex2dMemUsage) / scale_MB);
 	ImGui::Text("%u Cubemaps in cache (%.3f MB)", numTexCubemaps, double(texCubeMemUsage) / scale_MB);
 	ImGui::Text("%u TextureArray2D in cache (%.3f MB)", numTexArray2ds, double(texArray2dMemUsage) / scale_MB);
+	ImGui::Text("Streamed textures: %.3f MB resident, %u mip loads in flight", double(streamedTexMemUsage) / scale_MB, numTexMipLoads);
+	ImGui::Text("%u textures waiting to be decoded", uint32_t(Graphics::TextureLoader::GetNumPending()));
+	if (Pi::modelCache)
+		ImGui::Text("%u models in cache (%.3f MB of geometry), %u being read",
+			uint32_t(Pi::modelCache->GetNumModels()), double(Pi::modelCache->GetMemoryUsed()) / scale_MB,
+			uint32_t(Pi::modelCache->GetNumPending()));
+
+	DrawGPUMemory();
+}
+
+void PerfInfo::DrawGPUMemory()
+{
+	using namespace Graphics;
+
+	const MemoryTag::Stats total = GPUMemory::GetTotal();
+	const size_t budget = GPUMemory::GetBudget();
+	if (budget)
+		ImGui::Text("GPU memory: %.1f MB in use, %.1f MB peak, of a %.0f MB budget",
+			double(total.bytes) / scale_MB, double(total.highWater) / scale_MB, double(budget) / scale_MB);
+	else
+		ImGui::Text("GPU memory: %.1f MB in use, %.1f MB peak", double(total.bytes) / scale_MB, double(total.highWater) / scale_MB);
+
+	if (GPUMemory::IsNearBudget())
+		ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.2f, 1.0f), "Over %.0f%% of the GPU memory budget", GPUMemory::BUDGET_WARNING * 100.0);
+
+	if (!ImGui::TreeNode("GPU Memory by Subsystem (MB)"))
+		return;
+
+	if (ImGui::BeginTable("GPU Memory", MemoryTag::MAX_TAGS + 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+		ImGui::TableSetupColumn("");
+		for (int tag = 0; tag < MemoryTag::MAX_TAGS; tag++)
+			ImGui::TableSetupColumn(MemoryTag::GetName(MemoryTag::Tag(tag)));
+		ImGui::TableSetupColumn("Total");
+		ImGui::TableSetupColumn("Peak");
+		ImGui::TableHeadersRow();
+
+		for (int kind = 0; kind < GPUMemory::MAX_KINDS; kind++) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(GPUMemory::GetKindName(GPUMemory::Kind(kind)));
+
+			for (int tag = 0; tag < MemoryTag::MAX_TAGS; tag++) {
+				const MemoryTag::Stats stats = GPUMemory::GetStats(GPUMemory::Kind(kind), MemoryTag::Tag(tag));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f", double(stats.bytes) / scale_MB);
+			}
+
+			const MemoryTag::Stats kindTotal = GPUMemory::GetTotal(GPUMemory::Kind(kind));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", double(kindTotal.bytes) / scale_MB);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", double(kindTotal.highWater) / scale_MB);
+		}
+		ImGui::EndTable();
+	}
+
+	if (ImGui::Button("Reset GPU Peaks"))
+		GPUMemory::ResetHighWater();
+
+	ImGui::TreePop();
+}
+
+void PerfInfo::DrawJobStats()
+{
+	std::vector<JobStats::Summary> summaries;
+	JobStats::GetSummaries(summaries);
+
+	ImGui::TextUnformatted("Latency percentiles (p50 / p95 / p99) in milliseconds");
+	if (ImGui::Button("Reset Job Stats"))
+		JobStats::Reset();
+
+	const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+	if (!ImGui::BeginTable("JobStats", 7, flags))
+		return;
+
+	ImGui::TableSetupColumn("Job Type");
+	ImGui::TableSetupColumn("Queued");
+	ImGui::TableSetupColumn("Finished");
+	ImGui::TableSetupColumn("Wait");
+	ImGui::TableSetupColumn("Run");
+	ImGui::TableSetupColumn("Finish");
+	ImGui::TableSetupColumn("Total");
+	ImGui::TableHeadersRow();
+
+	const auto percentileColumn = [](const float ms[JobStats::MAX_PERCENTILE]) {
+		ImGui::TableNextColumn();
+		ImGui::Text("%.2f / %.2f / %.2f", ms[JobStats::P50], ms[JobStats::P95], ms[JobStats::P99]);
+	};
+
+	for (const JobStats::Summary &summary : summaries) {
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(summary.name.c_str());
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", summary.queueDepth);
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", (unsigned long long)summary.numFinished);
+		percentileColumn(summary.waitMs);
+		percentileColumn(summary.runMs);
+		percentileColumn(summary.finishMs);
+		percentileColumn(summary.totalMs);
+	}
+
+	ImGui::EndTable();
+}
+
+// a stable colour for each job type, so the same job reads the same on every row
+static ImU32 GetJobColor(const char *name)
+{
+	uint32_t hash = 2166136261u;
+	for (const char *c = name; *c; c++)
+		hash = (hash ^ uint8_t(*c)) * 16777619u;
+	return ImColor::HSV((hash % 360) / 360.0f, 0.6f, 0.85f);
+}
+
+void PerfInfo::DrawJobTimeline()
+{
+	if (!ImGui::CollapsingHeader("Timeline", ImGuiTreeNodeFlags_DefaultOpen))
+		return;
+
+	const uint64_t begin = m_frameStarts.front();
+	if (!begin) {
+		ImGui::TextUnformatted("Waiting for frames...");
+		return;
+	}
+
+	// while paused, the timeline stays on the frames it was showing
+	const uint64_t end = m_state->updatePause ? m_frameStarts.back() : JobStats::Now();
+	const double windowMs = std::max(JobStats::ToMilliseconds(end - begin), 0.001);
+
+	static std::vector<JobStats::Span> s_spans;
+	JobStats::GetTimeline(s_spans, begin);
+
+	// row 0 is the main thread, where OnFinish runs; the others are the
+	// worker threads of the task graph
+	uint32_t numRows = Pi::GetApp()->GetTaskGraph()->GetNumWorkerThreads() + 1;
+	for (const JobStats::Span &span : s_spans)
+		numRows = std::max(numRows, span.threadNum + 1);
+
+	const float labelWidth = ImGui::CalcTextSize("Thread 00 100%").x + ImGui::GetStyle().ItemSpacing.x;
+	const float rowHeight = ImGui::GetTextLineHeight();
+	const float rowSpacing = 2.0f;
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+	const float width = std::max(ImGui::GetContentRegionAvail().x - labelWidth, 100.0f);
+	const float height = numRows * (rowHeight + rowSpacing);
+	const float left = origin.x + labelWidth;
+
+	ImGui::TextDisabled("Last %d frames, %.2f ms; OnRun on the worker threads, OnFinish on the main thread", TIMELINE_FRAMES, windowMs);
+	const ImVec2 top = ImGui::GetCursorScreenPos();
+	ImGui::Dummy(ImVec2(labelWidth + width, height));
+
+	ImDrawList *drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(ImVec2(left, top.y), ImVec2(left + width, top.y + height), ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+	const auto toX = [&](uint64_t ticks) {
+		const double ms = ticks > begin ? JobStats::ToMilliseconds(ticks - begin) : 0.0;
+		return left + float(std::min(ms / windowMs, 1.0)) * width;
+	};
+
+	const ImVec2 mouse = ImGui::GetIO().MousePos;
+	const JobStats::Span *hovered = nullptr;
+	std::vector<double> busyMs(numRows, 0.0);
+
+	const auto drawSpan = [&](const JobStats::Span &span, uint32_t row, uint64_t start, uint64_t stop) {
+		if (stop < begin || start > end)
+			return;
+		busyMs[row] += JobStats::ToMilliseconds(std::min(stop, end) - std::max(start, begin));
+
+		const float y = top.y + row * (rowHeight + rowSpacing);
+		// at least a pixel wide, or short jobs would vanish
+		const ImVec2 min(toX(start), y);
+		const ImVec2 max(std::max(toX(stop), min.x + 1.0f), y + rowHeight);
+		drawList->AddRectFilled(min, max, GetJobColor(span.name));
+		if (mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y)
+			hovered = &span;
+	};
+
+	for (const JobStats::Span &span : s_spans) {
+		drawSpan(span, span.threadNum, span.startTime, span.endTime);
+		if (span.finishTime)
+			drawSpan(span, 0, span.finishTime, span.finishEndTime);
+	}
+
+	for (uint64_t frameStart : m_frameStarts)
+		drawList->AddLine(ImVec2(toX(frameStart), top.y), ImVec2(toX(frameStart), top.y + height), ImGui::GetColorU32(ImGuiCol_Text), 1.0f);
+
+	// the share of the window each thread spent running jobs; the rest is
+	// the idle gaps between them (or tasks, which aren't on the timeline)
+	for (uint32_t row = 0; row < numRows; row++) {
+		const std::string label = row ? fmt::format("Thread {}", row) : std::string("Main");
+		const float y = top.y + row * (rowHeight + rowSpacing);
+		drawList->AddText(ImVec2(origin.x, y), ImGui::GetColorU32(ImGuiCol_Text),
+			fmt::format("{} {:.0f}%", label, 100.0 * busyMs[row] / windowMs).c_str());
+	}
+
+	if (hovered) {
+		ImGui::BeginTooltip();
+		ImGui::TextUnformatted(hovered->name);
+		ImGui::Text("OnRun: %.3f ms on thread %u", JobStats::ToMilliseconds(hovered->endTime - hovered->startTime), hovered->threadNum);
+		if (hovered->finishTime) {
+			ImGui::Text("Waited %.3f ms for OnFinish", JobStats::ToMilliseconds(hovered->finishTime - hovered->endTime));
+			ImGui::Text("OnFinish: %.3f ms", JobStats::ToMilliseconds(hovered->finishEndTime - hovered->finishTime));
+		} else {
+			ImGui::TextUnformatted("Cancelled");
+		}
+		ImGui::EndTooltip();
+	}
+
+	ImGui::Spacing();
+}
+
+void PerfInfo::DrawLuaProfiler()
+{
+	// the tables only show the most expensive entries, the export has all of them
+	static constexpr size_t MAX_ROWS = 100;
+
+	lua_State *l = ::Lua::manager->GetLuaState();
+	if (ImGui::Button(LuaProfiler::IsRunning() ? "Stop Profiling" : "Start Profiling")) {
+		if (LuaProfiler::IsRunning())
+			LuaProfiler::Stop(l);
+		else
+			LuaProfiler::Start(l);
+	}
+
+	ImGui::SameLine();
+	if (ImGui::Button("Reset")) {
+		LuaProfiler::Reset();
+		LuaAllocProfiler::Reset();
+	}
+
+	ImGui::SameLine();
+	if (ImGui::Button("Export")) {
+#ifdef PIONEER_PROFILER
+		// written next to the C++ profile of the frame
+		Pi::GetApp()->RequestProfileFrame();
+#else
+		FileSystem::userFiles.MakeDirectory("profiler");
+		const std::string dir = FileSystem::JoinPathBelow(FileSystem::userFiles.GetRoot(), "profiler");
+		LuaProfiler::Dump(dir);
+		if (LuaAllocProfiler::HasData())
+			LuaAllocProfiler::Dump(dir);
+#endif
+	}
+
+	ImGui::SameLine();
+	if (ImGui::Button(LuaAllocProfiler::IsRunning() ? "Stop Sampling Allocations" : "Sample Allocations")) {
+		if (LuaAllocProfiler::IsRunning())
+			LuaAllocProfiler::Stop();
+		else
+			LuaAllocProfiler::Start(l);
+	}
+
+	const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollY;
+
+	std::vector<LuaProfiler::FunctionSummary> functions;
+	LuaProfiler::GetFunctions(functions);
+	if (ImGui::CollapsingHeader("Functions", ImGuiTreeNodeFlags_DefaultOpen) &&
+		ImGui::BeginTable("LuaFunctions", 6, flags, ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 16))) {
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Function");
+		ImGui::TableSetupColumn("Source");
+		ImGui::TableSetupColumn("Calls");
+		ImGui::TableSetupColumn("Inclusive (ms)");
+		ImGui::TableSetupColumn("Exclusive (ms)");
+		ImGui::TableSetupColumn("Allocations");
+		ImGui::TableHeadersRow();
+
+		for (size_t i = 0; i < std::min(functions.size(), MAX_ROWS); i++) {
+			const LuaProfiler::FunctionSummary &function = functions[i];
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(function.name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%s:%d", function.source.c_str(), function.line);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)function.numCalls);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", function.inclusiveMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", function.exclusiveMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu (%.1f KB)", (unsigned long long)function.numAllocs, function.allocBytes / 1024.0);
+		}
+
+		ImGui::EndTable();
+	}
+
+	std::vector<LuaProfiler::LineSummary> lines;
+	LuaProfiler::GetLines(lines);
+	if (ImGui::CollapsingHeader("Sampled Lines") &&
+		ImGui::BeginTable("LuaLines", 2, flags, ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 16))) {
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Line");
+		ImGui::TableSetupColumn("Samples");
+		ImGui::TableHeadersRow();
+
+		for (size_t i = 0; i < std::min(lines.size(), MAX_ROWS); i++) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%s:%d", lines[i].source.c_str(), lines[i].line);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)lines[i].numSamples);
+		}
+
+		ImGui::EndTable();
+	}
+
+	// the allocation sampler, one table by the rate each line allocates at
+	// and one by what each function still holds
+	const auto allocTable = [&](const char *id, const char *label, const std::vector<LuaAllocProfiler::Summary> &rows) {
+		if (!ImGui::BeginTable(id, 5, flags, ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 16)))
+			return;
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Function");
+		ImGui::TableSetupColumn(label);
+		ImGui::TableSetupColumn("KB/s");
+		ImGui::TableSetupColumn("Allocated (KB)");
+		ImGui::TableSetupColumn("Retained (KB)");
+		ImGui::TableHeadersRow();
+
+		for (size_t i = 0; i < std::min(rows.size(), MAX_ROWS); i++) {
+			const LuaAllocProfiler::Summary &row = rows[i];
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(row.function.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%s:%d", row.source.c_str(), row.line);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", row.bytesPerSecond / 1024.0);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", row.allocBytes / 1024.0);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", row.retainedBytes / 1024.0);
+		}
+
+		ImGui::EndTable();
+	};
+
+	std::vector<LuaAllocProfiler::Summary> allocs;
+	if (ImGui::CollapsingHeader("Allocation Rate by Line")) {
+		LuaAllocProfiler::GetLines(allocs);
+		allocTable("LuaAllocLines", "Line", allocs);
+	}
+	if (ImGui::CollapsingHeader("Retained Memory by Function")) {
+		LuaAllocProfiler::GetFunctions(allocs);
+		allocTable("LuaAllocFunctions", "Defined At", allocs);
+	}
+}
+
+template <typename Cache>
+static void DrawGalaxyCacheRow(const char *name, const Cache &cache)
+{
+	const typename Cache::Stats stats = cache.GetStats();
+	const unsigned long long lookups = stats.hits + stats.slaveHits + stats.misses;
+
+	ImGui::TableNextRow();
+	ImGui::TableNextColumn();
+	ImGui::TextUnformatted(name);
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", stats.hits);
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", stats.slaveHits);
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu (%.1f%%)", stats.misses, lookups ? 100.0 * stats.misses / lookups : 0.0);
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", stats.completions);
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", stats.evictions);
+	ImGui::TableNextColumn();
+	ImGui::Text("%zu / %zu", stats.numRetained, stats.numObjects);
+	ImGui::TableNextColumn();
+	ImGui::Text("%.2f / %.2f MB", double(stats.retainedBytes) / scale_MB, double(stats.memoryBudget) / scale_MB);
+}
+
+void PerfInfo::DrawGalaxyCacheStats()
+{
+	Galaxy *galaxy = Pi::game->GetGalaxy().Get();
+	if (ImGui::Button("Reset Cache Stats")) {
+		galaxy->GetSectorCache().ResetStats();
+		galaxy->GetStarSystemCache().ResetStats();
+	}
+
+	const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+	if (!ImGui::BeginTable("GalaxyCacheStats", 8, flags))
+		return;
+
+	ImGui::TableSetupColumn("Cache");
+	ImGui::TableSetupColumn("Hits");
+	ImGui::TableSetupColumn("Slave Hits");
+	ImGui::TableSetupColumn("Misses");
+	ImGui::TableSetupColumn("Completions");
+	ImGui::TableSetupColumn("Evictions");
+	ImGui::TableSetupColumn("Retained / Alive");
+	ImGui::TableSetupColumn("Retained Memory / Budget");
+	ImGui::TableHeadersRow();
+
+	DrawGalaxyCacheRow("Sectors", galaxy->GetSectorCache());
+	DrawGalaxyCacheRow("Star Systems", galaxy->GetStarSystemCache());
+
+	ImGui::EndTable();
 }
 
 void PerfInfo::DrawWorldViewStats()
@@ -6,6 +6,7 @@
 #include "PerfStats.h"
 #include "RefCounted.h"
 #include <array>
+#include <cstdint>
 #include <memory>
 
 namespace PiGui {
@@ -18,7 +19,8 @@ namespace PiGui {
 		enum CounterType {
 			COUNTER_FPS,
 			COUNTER_PHYS,
-			COUNTER_PIGUI
+			COUNTER_PIGUI,
+			COUNTER_LUAGC
 		};
 
 		// Information about the current process memory usage in KB.
@@ -37,6 +39,11 @@ namespace PiGui {
 		void Update(float deltaTime);
 		void UpdateFrameInfo(int framesThisSecond, int physFramesThisSecond);
 
+		// Log what took the time in a frame over the hitch threshold: the
+		// counters, the functions with the most profiler time and the
+		// slowest job OnFinish calls
+		void ReportHitch(double frameMs);
+
 		void SetShowDebugInfo(bool open);
 		void SetUpdatePause(bool pause);
 
@@ -46,17 +53,36 @@ namespace PiGui {
 		void DrawTextureInspector();
 
 		void DrawRendererStats();
+		void DrawGPUTimings();
+		void DrawFrameTimeDistribution();
+		void DrawQualityGovernor();
+		void DrawMemoryTags();
+		void DrawBodyPools();
+		void DrawGPUMemory();
 		void DrawWorldViewStats();
 		void DrawImGuiStats();
+		void DrawJobStats();
+		void DrawJobTimeline();
+		void DrawLuaProfiler();
+		void DrawGalaxyCacheStats();
 		void DrawInputDebug();
 		void DrawStatList(const Perf::Stats::FrameInfo &fi);
 
 		static const int NUM_FRAMES = 60;
+		// the percentiles and the histogram cover a longer window, in
+		// buckets of powers of two milliseconds: <1, 1-2, 2-4 ... >=512
+		static const int NUM_SAMPLES = 1024;
+		static const int NUM_BUCKETS = 11;
 		struct CounterInfo {
 			std::array<float, NUM_FRAMES> history;
 			float average = 0.;
 			float min = 0.;
 			float max = 0.;
+
+			std::array<float, NUM_SAMPLES> samples;
+			size_t numSamples = 0;
+			size_t nextSample = 0;
+			std::array<float, NUM_BUCKETS> buckets;
 		};
 
 		CounterInfo &GetCounter(CounterType ct);
@@ -64,6 +90,7 @@ namespace PiGui {
 		CounterInfo m_fpsCounter;
 		CounterInfo m_physCounter;
 		CounterInfo m_piguiCounter;
+		CounterInfo m_luaGCCounter;
 
 		MemoryInfo process_mem;
 		size_t lua_mem = 0;
@@ -72,6 +99,13 @@ namespace PiGui {
 
 		float lastUpdateTime = 0;
 
+		int numHitches = 0;
+		float lastHitchMs = 0;
+
+		// JobStats times of the starts of the frames on the job timeline
+		static const int TIMELINE_FRAMES = 4;
+		std::array<uint64_t, TIMELINE_FRAMES + 1> m_frameStarts = {};
+
 		ImGuiState *m_state;
 	};
 
@@ -506,10 +506,12 @@ void Instance::Render()
 	default:
 	case Graphics::RENDERER_DUMMY:
 		return;
-	case Graphics::RENDERER_OPENGL_3x:
+	case Graphics::RENDERER_OPENGL_3x: {
+		Graphics::Renderer::GPUTimerTicket timer(m_renderer, "PiGui");
 		m_instanceRenderer->RenderDrawData(ImGui::GetDrawData());
 		break;
 	}
+	}
 }
 
 void Instance::ClearFonts()
@@ -19,8 +19,14 @@ using namespace PiGui;
 static constexpr size_t s_textureName = "texture0"_hash;
 static constexpr size_t s_vertexDepthName = "vertexDepth"_hash;
 
+static bool same_rect(const ImVec4 &a, const ImVec4 &b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
 InstanceRenderer::InstanceRenderer(Graphics::Renderer *r) :
-	m_renderer(r)
+	m_renderer(r),
+	m_hasScissor(false)
 {}
 
 void InstanceRenderer::Initialize()
@@ -38,7 +44,7 @@ void InstanceRenderer::Initialize()
 	vbd.usage = Graphics::BUFFER_USAGE_DYNAMIC;
 
 	m_vtxBuffer.reset(m_renderer->CreateVertexBuffer(vbd));
-	m_idxBuffer.reset(m_renderer->CreateIndexBuffer(0, Graphics::BUFFER_USAGE_DYNAMIC, Graphics::INDEX_BUFFER_16BIT));
+	m_idxBuffer.reset(m_renderer->CreateIndexBuffer(0, Graphics::BUFFER_USAGE_DYNAMIC, Graphics::INDEX_BUFFER_32BIT));
 
 	Graphics::RenderStateDesc rsd;
 	rsd.blendMode = Graphics::BLEND_ALPHA;
@@ -95,56 +101,104 @@ void InstanceRenderer::RenderDrawData(ImDrawData *draw_data, Graphics::Material*
 	// we're going to throw all of the vertex and index data straight to the GPU
 	// in a single buffer for each, right before we begin executing commands.
 	// This should make optimal use of transfer resources.
-	std::vector<ImDrawVert> vtxStagingBuffer;
-	vtxStagingBuffer.reserve(1024);
-	std::vector<ImDrawIdx> idxStagingBuffer;
-	idxStagingBuffer.reserve(1024);
+	//
+	// The indices are rebased onto the combined vertex data, which is why the
+	// index buffer is 32-bit: consecutive commands of different lists that
+	// share a texture, clip rect and depth then become a single draw call.
+	// Most of the HUD is windows clipped to the whole screen drawing with
+	// the font atlas, so this saves most of the draws and material updates.
+	m_vtxStaging.clear();
+	m_idxStaging.clear();
+	m_vtxStaging.reserve(draw_data->TotalVtxCount);
+	m_idxStaging.reserve(draw_data->TotalIdxCount);
+	m_hasScissor = false;
+
+	const ImVec2 pos = draw_data->DisplayPos;
+	PendingDraw pending = {};
 
 	for (int n = 0; n < draw_data->CmdListsCount; n++) {
 		const ImDrawList *cmd_list = draw_data->CmdLists[n];
 
 		// coalesce vertex and index data into a single buffer upload
 		auto &imVtxBuffer = cmd_list->VtxBuffer;
-		const size_t vtxOffset = vtxStagingBuffer.size();
-		vtxStagingBuffer.reserve(vtxOffset + imVtxBuffer.Size);
+		const uint32_t vtxOffset = uint32_t(m_vtxStaging.size());
+		m_vtxStaging.insert(m_vtxStaging.end(), imVtxBuffer.Data, imVtxBuffer.Data + imVtxBuffer.Size);
 
 		auto &imIdxBuffer = cmd_list->IdxBuffer;
-		const size_t idxOffset = idxStagingBuffer.size();
-		idxStagingBuffer.reserve(idxOffset + imIdxBuffer.Size);
-
-		// write this command list's data to the tail of the staging array
-		vtxStagingBuffer.insert(vtxStagingBuffer.end(), imVtxBuffer.Data, imVtxBuffer.Data + imVtxBuffer.Size);
-		idxStagingBuffer.insert(idxStagingBuffer.end(), imIdxBuffer.Data, imIdxBuffer.Data + imIdxBuffer.Size);
+		const uint32_t idxOffset = uint32_t(m_idxStaging.size());
+		m_idxStaging.resize(idxOffset + imIdxBuffer.Size);
 
 		// Generate renderer commands for each draw command in the command buffer list.
 		for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
 			const ImDrawCmd *pcmd = &cmd_list->CmdBuffer[cmd_i];
-			if (pcmd->UserCallback)
-				pcmd->UserCallback(cmd_list, pcmd);
-			else {
-				ImVec2 pos = draw_data->DisplayPos;
-				ImVec4 clip_rect = pcmd->ClipRect - ImVec4(pos.x, pos.y, pos.x, pos.y);
-
-				// do a simple screen bounds test
-				if (clip_rect.x < fb_width && clip_rect.y < fb_height && clip_rect.z >= 0.f && clip_rect.w >= 0.f) {
-					Graphics::ViewportExtents vp(clip_rect.x, (fb_height - clip_rect.w), (clip_rect.z - clip_rect.x), (clip_rect.w - clip_rect.y));
-					m_renderer->SetScissor(vp);
-
-					material->SetTexture(s_textureName, reinterpret_cast<Graphics::Texture *>(pcmd->GetTexID()));
-					material->SetPushConstant(s_vertexDepthName, pcmd->PrimDepth);
-					m_renderer->DrawBufferDynamic(m_vtxBuffer.get(), vtxOffset + pcmd->VtxOffset, m_idxBuffer.get(), idxOffset + pcmd->IdxOffset, pcmd->ElemCount, material);
-				}
+
+			// write the command's indices to the tail of the staging array,
+			// offset to where its vertices start in the combined buffer
+			const uint32_t cmdIdxOffset = idxOffset + pcmd->IdxOffset;
+			const uint32_t cmdVtxOffset = vtxOffset + pcmd->VtxOffset;
+			const ImDrawIdx *src = imIdxBuffer.Data + pcmd->IdxOffset;
+			uint32_t *dst = m_idxStaging.data() + cmdIdxOffset;
+			for (unsigned int i = 0; i < pcmd->ElemCount; i++)
+				dst[i] = cmdVtxOffset + src[i];
+
+			if (pcmd->UserCallback) {
+				if (pending.count)
+					FlushDraw(pending, material, fb_height);
+				pending.count = 0;
+
+				if (pcmd->UserCallback == ImDrawCallback_ResetRenderState)
+					m_hasScissor = false;
+				else
+					pcmd->UserCallback(cmd_list, pcmd);
+				continue;
+			}
+
+			if (!pcmd->ElemCount)
+				continue;
+
+			ImVec4 clip_rect = pcmd->ClipRect - ImVec4(pos.x, pos.y, pos.x, pos.y);
+			// do a simple screen bounds test
+			if (!(clip_rect.x < fb_width && clip_rect.y < fb_height && clip_rect.z >= 0.f && clip_rect.w >= 0.f))
+				continue;
+
+			Graphics::Texture *texture = reinterpret_cast<Graphics::Texture *>(pcmd->GetTexID());
+			if (pending.count && pending.texture == texture && same_rect(pending.clipRect, clip_rect) &&
+				pending.depth == pcmd->PrimDepth && pending.idxOffset + pending.count == cmdIdxOffset) {
+				pending.count += pcmd->ElemCount;
+				continue;
 			}
+
+			if (pending.count)
+				FlushDraw(pending, material, fb_height);
+			pending = { texture, clip_rect, pcmd->PrimDepth, cmdIdxOffset, pcmd->ElemCount };
 		}
 	}
 
+	if (pending.count)
+		FlushDraw(pending, material, fb_height);
+
 	// so long as we haven't issued FlushCommandBuffers() yet, we're perfectly fine to do this upload out-of-order.
-	m_vtxBuffer->BufferData(vtxStagingBuffer.size() * sizeof(ImDrawVert), vtxStagingBuffer.data());
-	m_idxBuffer->BufferData(idxStagingBuffer.size() * sizeof(ImDrawIdx), idxStagingBuffer.data());
+	m_vtxBuffer->BufferData(m_vtxStaging.size() * sizeof(ImDrawVert), m_vtxStaging.data());
+	m_idxBuffer->BufferData(m_idxStaging.size() * sizeof(uint32_t), m_idxStaging.data());
 
 	m_renderer->FlushCommandBuffers();
 }
 
+void InstanceRenderer::FlushDraw(const PendingDraw &draw, Graphics::Material *material, int fb_height)
+{
+	const ImVec4 &clip_rect = draw.clipRect;
+	if (!m_hasScissor || !same_rect(m_scissor, clip_rect)) {
+		Graphics::ViewportExtents vp(clip_rect.x, (fb_height - clip_rect.w), (clip_rect.z - clip_rect.x), (clip_rect.w - clip_rect.y));
+		m_renderer->SetScissor(vp);
+		m_scissor = clip_rect;
+		m_hasScissor = true;
+	}
+
+	material->SetTexture(s_textureName, draw.texture);
+	material->SetPushConstant(s_vertexDepthName, draw.depth);
+	m_renderer->DrawBufferDynamic(m_vtxBuffer.get(), 0, m_idxBuffer.get(), draw.idxOffset, draw.count, material);
+}
+
 void InstanceRenderer::CreateFontsTexture()
 {
 	PROFILE_SCOPED()
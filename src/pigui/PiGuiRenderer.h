@@ -4,9 +4,9 @@
 #pragma once
 
 #include "graphics/Renderer.h"
+#include "imgui/imgui.h"
 #include <memory>
-
-struct ImDrawData;
+#include <vector>
 
 namespace PiGui {
 
@@ -33,11 +33,29 @@ namespace PiGui {
 		void DestroyFontsTexture();
 
 	private:
+		// A run of commands drawn with one draw call
+		struct PendingDraw {
+			Graphics::Texture *texture;
+			ImVec4 clipRect;
+			float depth;
+			uint32_t idxOffset;
+			uint32_t count;
+		};
+
+		void FlushDraw(const PendingDraw &draw, Graphics::Material *material, int fb_height);
+
 		Graphics::Renderer *m_renderer;
 
 		std::unique_ptr<Graphics::Material> m_material;
 		std::unique_ptr<Graphics::VertexBuffer> m_vtxBuffer;
 		std::unique_ptr<Graphics::IndexBuffer> m_idxBuffer;
 		std::unique_ptr<Graphics::Texture> m_fontsTexture;
+
+		// kept between frames so the staging doesn't reallocate
+		std::vector<ImDrawVert> m_vtxStaging;
+		std::vector<uint32_t> m_idxStaging;
+		// the scissor last set, to skip setting it again
+		ImVec4 m_scissor;
+		bool m_hasScissor;
 	};
 } // namespace PiGui
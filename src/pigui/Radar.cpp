@@ -1,12 +1,18 @@
 
 #include "Radar.h"
 #include "MathUtil.h"
+#include "Pi.h"
+#include "Player.h"
+#include "Sensors.h"
 #include "imgui/imgui.h"
+#include "imgui/imgui_internal.h"
 #include "profiler/Profiler.h"
 
 using RadarWidget = PiGui::RadarWidget;
 
 static constexpr int RADAR_STEPS = 100;
+// blips reserved at once, so the vertices of one reservation fit 16-bit indices
+static constexpr int BLIPS_PER_RESERVE = 1024;
 
 ImVec2 circlePos(float a, ImVec2 center, ImVec2 radius, float scale = 1.0f)
 {
@@ -94,4 +100,57 @@ void RadarWidget::DrawPiGui()
 		drawList->PathLineTo(circlePos(ang - zoomArc / 2.f, zoomPos, m_radius));
 	}
 	drawList->PathStroke(ImGui::GetColorU32(ImGuiCol_FrameBgActive), false, 6.0f);
+
+	m_blips.clear();
+	if (m_drawContacts)
+		DrawContacts(drawList);
+}
+
+void RadarWidget::DrawContacts(ImDrawList *drawList)
+{
+	PROFILE_SCOPED()
+	if (!Pi::player || m_currentZoom <= 0.f)
+		return;
+
+	// the disk is the plane of the ship seen from above and behind: right is
+	// right, forward is up, and the height above the plane is the stalk
+	const matrix3x3d orient = Pi::player->GetOrient();
+	const vector3d playerPos = Pi::player->GetPosition();
+	const Body *combatTarget = Pi::player->GetCombatTarget();
+	const Body *navTarget = Pi::player->GetNavTarget();
+	const double scale = 1.0 / m_currentZoom;
+
+	for (const Sensors::RadarContact *contact : Pi::player->GetSensors()->GetContacts()) {
+		// the contacts are sorted by distance
+		if (contact->distance > m_currentZoom)
+			break;
+
+		const Body *body = contact->body;
+		const vector3d position = (body->GetFrame() == Pi::player->GetFrame() ?
+			body->GetPosition() - playerPos :
+			body->GetPositionRelTo(Pi::player)) * orient * scale;
+
+		const ImVec2 base(m_center.x + float(position.x) * m_radius.x, m_center.y + float(position.z) * m_radius.y);
+		const ImVec2 top(base.x, base.y - float(position.y) * m_radius.y);
+		const Color c = Sensors::IFFColor(contact->iff);
+		m_blips.push_back({ base, top, IM_COL32(c.r, c.g, c.b, c.a), body == combatTarget || body == navTarget });
+	}
+
+	const ImVec2 uv = drawList->_Data->TexUvWhitePixel;
+	const float half = 0.5f * m_blipSize;
+	for (size_t first = 0; first < m_blips.size(); first += BLIPS_PER_RESERVE) {
+		const int count = int(std::min(m_blips.size() - first, size_t(BLIPS_PER_RESERVE)));
+		// a stalk and a blip each
+		drawList->PrimReserve(count * 12, count * 8);
+		for (int i = 0; i < count; i++) {
+			const Blip &blip = m_blips[first + i];
+			// the stalk is dimmer than the blip, and darker below the plane
+			const ImU32 stalkColor = (blip.color & ~IM_COL32_A_MASK) | ((blip.top.y > blip.base.y ? 0x40u : 0x80u) << IM_COL32_A_SHIFT);
+			drawList->PrimRectUV(ImVec2(blip.base.x - 0.5f, std::min(blip.base.y, blip.top.y)),
+				ImVec2(blip.base.x + 0.5f, std::max(blip.base.y, blip.top.y)), uv, uv, stalkColor);
+
+			const float size = blip.target ? 2.f * half : half;
+			drawList->PrimRectUV(ImVec2(blip.top.x - size, blip.top.y - size), ImVec2(blip.top.x + size, blip.top.y + size), uv, uv, blip.color);
+		}
+	}
 }
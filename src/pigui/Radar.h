@@ -7,6 +7,8 @@
 #include "imgui/imgui.h"
 #include "vector2.h"
 
+#include <vector>
+
 namespace PiGui {
 	class RadarWidget : public RefCounted {
 	public:
@@ -39,7 +41,30 @@ namespace PiGui {
 		// Return the position of the center of the radar disk
 		ImVec2 GetCenter() const { return m_center; }
 
+		// Draw the contacts of the player's sensors as blips on stalks,
+		// instead of leaving them to the caller
+		void SetDrawContacts(bool drawContacts) { m_drawContacts = drawContacts; }
+		bool GetDrawContacts() const { return m_drawContacts; }
+
+		// Set the size of a contact blip in pixels
+		void SetBlipSize(float blipSize) { m_blipSize = blipSize; }
+		float GetBlipSize() const { return m_blipSize; }
+
+		// Return the number of contacts drawn by the last frame
+		int GetNumContactsDrawn() const { return int(m_blips.size()); }
+
 	private:
+		struct Blip {
+			ImVec2 base;
+			ImVec2 top;
+			ImU32 color;
+			bool target;
+		};
+
+		// Project the contacts in range onto the disk, then draw them all
+		// into the draw list with one reservation
+		void DrawContacts(ImDrawList *drawList);
+
 		ImVec2 m_size;
 		ImVec2 m_radius;
 		ImVec2 m_center;
@@ -47,5 +72,10 @@ namespace PiGui {
 		float m_currentZoom;
 		float m_maxZoom;
 		float m_minZoom;
+
+		bool m_drawContacts = false;
+		float m_blipSize = 3.f;
+		// kept to not allocate every frame
+		std::vector<Blip> m_blips;
 	};
 } // namespace PiGui
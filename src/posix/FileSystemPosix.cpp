@@ -5,6 +5,8 @@
 #include "buildopts.h"
 #include "utils.h"
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -214,6 +216,38 @@ namespace FileSystem {
 		return RefCountedPtr<FileData>(0);
 	}
 
+	class FileDataMapped : public FileData {
+	public:
+		FileDataMapped(const FileInfo &info, size_t size, void *data) :
+			FileData(info, size, static_cast<char *>(data)) {}
+		virtual ~FileDataMapped() { munmap(m_data, m_size); }
+	};
+
+	RefCountedPtr<FileData> FileSourceFS::MapFile(const std::string &path)
+	{
+		const std::string fullpath = JoinPathBelow(GetRoot(), path);
+		int fd = open(fullpath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return RefCountedPtr<FileData>(0);
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+			close(fd);
+			return ReadFile(path);
+		}
+
+		Time::DateTime mtime;
+		interpret_stat(info, mtime);
+
+		// the mapping stays valid after the descriptor is closed
+		void *data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+			return ReadFile(path);
+
+		return RefCountedPtr<FileData>(new FileDataMapped(MakeFileInfo(path, FileInfo::FT_FILE, mtime), size_t(info.st_size), data));
+	}
+
 	bool FileSourceFS::ReadDirectory(const std::string &dirpath, std::vector<FileInfo> &output)
 	{
 		const std::string fulldirpath = JoinPathBelow(GetRoot(), dirpath);
@@ -342,4 +376,26 @@ namespace FileSystem {
 			return false;
 		return !unlink(combinedPath.c_str());
 	}
+
+	bool FileSourceFS::RenameFile(const std::string &relativeFrom, const std::string &relativeTo)
+	{
+		if (relativeFrom.empty() || relativeTo.empty())
+			return false;
+		std::string fromPath, toPath;
+		try {
+			fromPath = JoinPathBelow(GetRoot(), relativeFrom);
+			toPath = JoinPathBelow(GetRoot(), relativeTo);
+		} catch (const std::invalid_argument &) {
+			return false;
+		}
+		struct stat fileAttributes;
+		memset(&fileAttributes, 0, sizeof(fileAttributes));
+		if (stat(fromPath.c_str(), &fileAttributes))
+			return false;
+		if (!S_ISREG(fileAttributes.st_mode))
+			return false;
+		if (!IsChildOfRoot(fromPath))
+			return false;
+		return !rename(fromPath.c_str(), toPath.c_str());
+	}
 } // namespace FileSystem
@@ -8,7 +8,9 @@
 
 #include <SDL.h>
 #include <fenv.h>
+#include <fstream>
 #include <sys/time.h>
+#include <time.h>
 #if defined(__APPLE__)
 #include <sys/param.h>
 #include <sys/sysctl.h>
@@ -132,4 +134,38 @@ namespace OS {
 	{
 	}
 
+	static double cpu_clock_ms(clockid_t clock)
+	{
+		timespec ts;
+		if (clock_gettime(clock, &ts) != 0)
+			return 0.0;
+		return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+	}
+
+	double GetProcessCPUTime()
+	{
+		return cpu_clock_ms(CLOCK_PROCESS_CPUTIME_ID);
+	}
+
+	double GetThreadCPUTime()
+	{
+		return cpu_clock_ms(CLOCK_THREAD_CPUTIME_ID);
+	}
+
+	uint64_t GetProcessBytesRead()
+	{
+#if defined(__linux__)
+		// read_bytes is what had to come from the disk, rchar would include
+		// the reads served from the page cache
+		std::ifstream io("/proc/self/io");
+		std::string key;
+		uint64_t value;
+		while (io >> key >> value) {
+			if (key == "read_bytes:")
+				return value;
+		}
+#endif
+		return 0;
+	}
+
 } // namespace OS
@@ -3,85 +3,831 @@
 
 #include "FileSystem.h"
 #include "Json.h"
+#include "JsonUtils.h"
 #include "core/GZipFormat.h"
+#include "core/LZ4Format.h"
 #include <SDL.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <vector>
+
+// Every mode reads the saved game through JsonUtils::SaveDataReader and
+// works on the events of Json::sax_parse as the data is decompressed, so no
+// mode needs more memory than a block of the data and the nesting of the
+// value being read. Saves from before the switch to lz4 are the exception,
+// they are decompressed as a whole.
 
 int info()
 {
 	printf(
 		"savegamedump - Dump saved games to JSON for easy inspection.\n"
 		"All paths are relative to the pioneer data folder.\n"
-		"USAGE: savegamedump [--pretty] <input> [output]\n");
+		"USAGE: savegamedump [--pretty] <input> [output]\n"
+		"       savegamedump --save <input.json> <output>\n"
+		"       savegamedump --summary <input>\n"
+		"       savegamedump --validate <input>\n"
+		"  --save converts a JSON dump back into a saved game.\n"
+		"  --summary shows how much of the decompressed save each section takes.\n"
+		"  --validate checks the save has the sections a game needs to load.\n");
 	return 1;
 }
 
-extern "C" int main(int argc, char **argv)
-{
-	if (argc < 2) return info();
+namespace {
 
-	int indent = -1;
-	int shift = 0;
+	// Turns the events of Json::sax_parse into fewer, simpler ones, and
+	// rejects anything but an object at the root
+	class SaveHandler : public Json::json_sax_t {
+	public:
+		bool null() override { return Scalar(Json()); }
+		bool boolean(bool val) override { return Scalar(Json(val)); }
+		bool number_integer(Json::number_integer_t val) override { return Scalar(Json(val)); }
+		bool number_unsigned(Json::number_unsigned_t val) override { return Scalar(Json(val)); }
+		bool number_float(Json::number_float_t val, const std::string &) override { return Scalar(Json(val)); }
+		bool string(std::string &val) override { return Scalar(Json(std::move(val))); }
 
-	std::string filename = argv[1];
-	if (filename == "--pretty") {
-		indent = 2;
-		shift = 1;
+		bool start_object(std::size_t) override { return Open(Json::value_t::object); }
+		bool key(std::string &val) override { return OnKey(val); }
+		bool end_object() override { return Close(); }
+		bool start_array(std::size_t) override { return Open(Json::value_t::array); }
+		bool end_array() override { return Close(); }
+
+		bool parse_error(std::size_t position, const std::string &, const Json::exception &ex) override
+		{
+			m_error = ex.what();
+			return false;
+		}
+
+		const std::string &GetError() const { return m_error; }
+
+	protected:
+		virtual bool OnScalar(const Json &value) = 0;
+		// the depth is already that of the contents of the container
+		virtual bool OnOpen(Json::value_t type) = 0;
+		virtual bool OnKey(const std::string &key) = 0;
+		// the depth is already that of the closed container
+		virtual bool OnClose() = 0;
+
+		// 1 inside the root object
+		int GetDepth() const { return m_depth; }
+
+		bool Fail(const std::string &error)
+		{
+			m_error = error;
+			return false;
+		}
+
+	private:
+		bool Scalar(const Json &value)
+		{
+			if (m_depth == 0)
+				return Fail("root is not a JSON object");
+			return OnScalar(value);
+		}
+
+		bool Open(Json::value_t type)
+		{
+			if (m_depth == 0 && type != Json::value_t::object)
+				return Fail("root is not a JSON object");
+			m_depth++;
+			return OnOpen(type);
+		}
+
+		bool Close()
+		{
+			m_depth--;
+			return OnClose();
+		}
+
+		int m_depth = 0;
+		std::string m_error;
+	};
+
+	// Parses the save with the handler, and reports why it couldn't
+	bool ParseSave(const std::string &filename, JsonUtils::SaveDataReader &reader, SaveHandler &handler)
+	{
+		if (!reader.Parse(&handler)) {
+			printf("%s is not a valid saved game: %s.\n", filename.c_str(), handler.GetError().c_str());
+			return false;
+		}
+		return true;
 	}
 
-	if (argc < shift+2 || argc > shift+3) return info();
-	filename = argv[shift+1];
-	std::string outname = argc > shift+2 ? argv[shift+2] : filename + ".json";
+	// Writes the save out as JSON text, formatted as Json::dump would but
+	// with the keys in the order they are in the save
+	class JsonTextWriter : public SaveHandler {
+	public:
+		JsonTextWriter(FILE *out, int indent) :
+			m_out(out),
+			m_indent(indent)
+		{}
+
+	protected:
+		bool OnScalar(const Json &value) override
+		{
+			BeginValue();
+			Write(value.dump());
+			return true;
+		}
+
+		bool OnOpen(Json::value_t type) override
+		{
+			BeginValue();
+			const bool object = type == Json::value_t::object;
+			Write(object ? "{" : "[");
+			m_open.push_back({ object ? '}' : ']', true });
+			return true;
+		}
+
+		bool OnKey(const std::string &key) override
+		{
+			NextItem();
+			Write(Json(key).dump());
+			Write(m_indent < 0 ? ":" : ": ");
+			m_afterKey = true;
+			return true;
+		}
+
+		bool OnClose() override
+		{
+			const Container container = m_open.back();
+			m_open.pop_back();
+			if (!container.empty)
+				NewLine();
+			Write(std::string_view(&container.close, 1));
+			return true;
+		}
+
+	private:
+		void Write(std::string_view text) { fwrite(text.data(), 1, text.size(), m_out); }
+
+		void NewLine()
+		{
+			if (m_indent < 0)
+				return;
+			Write("\n");
+			Write(std::string(m_open.size() * m_indent, ' '));
+		}
+
+		void NextItem()
+		{
+			if (!m_open.back().empty)
+				Write(",");
+			m_open.back().empty = false;
+			NewLine();
+		}
+
+		void BeginValue()
+		{
+			if (m_afterKey)
+				m_afterKey = false;
+			else if (!m_open.empty())
+				NextItem();
+		}
+
+		struct Container {
+			char close;
+			// whether anything has been written to it yet
+			bool empty;
+		};
+
+		FILE *m_out;
+		int m_indent;
+		bool m_afterKey = false;
+		std::vector<Container> m_open;
+	};
+
+	// Writes the save out as CBOR as Json::to_cbor would, except that arrays
+	// and objects are written with the indefinite lengths CBOR allows, as
+	// their sizes aren't known until they end
+	class CborWriter : public SaveHandler {
+	public:
+		explicit CborWriter(lz4::StreamCompressor &out) :
+			m_out(out)
+		{}
+
+	protected:
+		bool OnScalar(const Json &value) override
+		{
+			switch (value.type()) {
+			case Json::value_t::boolean:
+				Byte(value.get<bool>() ? 0xF5 : 0xF4);
+				break;
+			case Json::value_t::number_integer: {
+				const int64_t val = value.get<int64_t>();
+				if (val >= 0)
+					Head(0, uint64_t(val));
+				else
+					Head(1, uint64_t(-(val + 1)));
+				break;
+			}
+			case Json::value_t::number_unsigned:
+				Head(0, value.get<uint64_t>());
+				break;
+			case Json::value_t::number_float: {
+				const double val = value.get<double>();
+				uint64_t bits;
+				memcpy(&bits, &val, sizeof(bits));
+				Byte(0xFB);
+				BigEndian(bits, 8);
+				break;
+			}
+			case Json::value_t::string: {
+				const std::string &str = value.get_ref<const std::string &>();
+				Head(3, str.size());
+				m_out.Write(str);
+				break;
+			}
+			default:
+				Byte(0xF6);
+				break;
+			}
+			return true;
+		}
+
+		bool OnOpen(Json::value_t type) override
+		{
+			Byte(type == Json::value_t::object ? 0xBF : 0x9F);
+			return true;
+		}
 
+		bool OnKey(const std::string &key) override
+		{
+			Head(3, key.size());
+			m_out.Write(key);
+			return true;
+		}
+
+		bool OnClose() override
+		{
+			Byte(0xFF);
+			return true;
+		}
+
+	private:
+		void Byte(uint8_t byte)
+		{
+			const char c = char(byte);
+			m_out.Write(std::string_view(&c, 1));
+		}
+
+		void BigEndian(uint64_t value, int size)
+		{
+			char bytes[8];
+			for (int i = 0; i < size; i++)
+				bytes[i] = char((value >> ((size - 1 - i) * 8)) & 0xff);
+			m_out.Write(std::string_view(bytes, size));
+		}
+
+		// the shortest encoding of the major type and its value
+		void Head(uint8_t major, uint64_t value)
+		{
+			major <<= 5;
+			if (value < 24) {
+				Byte(major | uint8_t(value));
+			} else if (value <= 0xff) {
+				Byte(major | 24);
+				BigEndian(value, 1);
+			} else if (value <= 0xffff) {
+				Byte(major | 25);
+				BigEndian(value, 2);
+			} else if (value <= 0xffffffff) {
+				Byte(major | 26);
+				BigEndian(value, 4);
+			} else {
+				Byte(major | 27);
+				BigEndian(value, 8);
+			}
+		}
+
+		lz4::StreamCompressor &m_out;
+	};
+
+	// Keeps the values of the given top level keys, and skips the rest
+	class ValueCollector : public SaveHandler {
+	public:
+		explicit ValueCollector(std::vector<std::string> keys) :
+			m_keys(std::move(keys)),
+			m_values(Json::object())
+		{}
+
+		const Json &GetValues() const { return m_values; }
+
+	protected:
+		bool OnScalar(const Json &value) override
+		{
+			if (Json *target = Target())
+				*target = value;
+			return true;
+		}
+
+		bool OnOpen(Json::value_t type) override
+		{
+			if (GetDepth() == 1)
+				return true;
+
+			Json *target = Target();
+			if (target)
+				*target = Json(type);
+			m_stack.push_back(target);
+			return true;
+		}
+
+		bool OnKey(const std::string &key) override
+		{
+			if (GetDepth() == 1)
+				m_collecting = std::find(m_keys.begin(), m_keys.end(), key) != m_keys.end();
+			m_key = key;
+			return true;
+		}
+
+		bool OnClose() override
+		{
+			if (!m_stack.empty())
+				m_stack.pop_back();
+			return true;
+		}
+
+	private:
+		// where the next value goes, null if it isn't kept
+		Json *Target()
+		{
+			if (!m_collecting)
+				return nullptr;
+			if (m_stack.empty())
+				return &m_values[m_key];
+
+			Json *parent = m_stack.back();
+			if (parent->is_object())
+				return &(*parent)[m_key];
+
+			parent->push_back(Json());
+			return &parent->back();
+		}
+
+		std::vector<std::string> m_keys;
+		Json m_values;
+		bool m_collecting = false;
+		std::string m_key;
+		// the containers being filled in
+		std::vector<Json *> m_stack;
+	};
+
+	// Adds up the decompressed bytes each top and second level section of
+	// the save takes
+	class SectionSizes : public SaveHandler {
+	public:
+		struct Section {
+			std::string name;
+			size_t start = 0;
+			size_t size = 0;
+			// elements of an array, or keys of an object
+			size_t entries = 0;
+			std::vector<Section> sections;
+		};
+
+		explicit SectionSizes(const JsonUtils::SaveDataReader &reader) :
+			m_reader(reader)
+		{}
+
+		std::vector<Section> &GetSections() { return m_sections; }
+
+	protected:
+		bool OnScalar(const Json &value) override
+		{
+			CountEntry(GetDepth());
+			return true;
+		}
+
+		bool OnOpen(Json::value_t type) override
+		{
+			CountEntry(GetDepth() - 1);
+			return true;
+		}
+
+		bool OnKey(const std::string &key) override
+		{
+			const int depth = GetDepth();
+			if (depth > 2)
+				return true;
+
+			EndSections(depth);
+			std::vector<Section> &parent = depth == 1 ? m_sections : m_sections.back().sections;
+			parent.push_back(Section());
+			parent.back().name = key;
+			parent.back().start = m_reader.Tell();
+			m_open = depth;
+			return true;
+		}
+
+		bool OnClose() override
+		{
+			// the object holding the open sections has ended
+			if (GetDepth() < m_open)
+				EndSections(GetDepth() + 1);
+			return true;
+		}
+
+	private:
+		// ends the open sections at depth and below
+		void EndSections(int depth)
+		{
+			const size_t pos = m_reader.Tell();
+			if (m_open >= 2 && depth <= 2 && !m_sections.back().sections.empty()) {
+				Section &section = m_sections.back().sections.back();
+				section.size = pos - section.start;
+			}
+			if (m_open >= 1 && depth <= 1 && !m_sections.empty()) {
+				Section &section = m_sections.back();
+				section.size = pos - section.start;
+			}
+			m_open = depth - 1;
+		}
+
+		// a value was added at depth, which is an entry of the section
+		// above it
+		void CountEntry(int depth)
+		{
+			if (depth == 2 && m_open >= 1)
+				m_sections.back().entries++;
+			else if (depth == 3 && m_open >= 2)
+				m_sections.back().sections.back().entries++;
+		}
+
+		const JsonUtils::SaveDataReader &m_reader;
+		std::vector<Section> m_sections;
+		// the depth of the innermost open section, 0 if there's none
+		int m_open = 0;
+	};
+
+	// The parts of a save a game can't be loaded without, see Game::Game
+	enum class Kind {
+		Integer,
+		Number,
+		Boolean,
+		String,
+		Array,
+		Object
+	};
+
+	struct SchemaField {
+		const char *key;
+		Kind kind;
+		bool required;
+		const std::vector<SchemaField> *fields;
+	};
+
+	const std::vector<SchemaField> s_spaceFields = {
+		{ "frame", Kind::Object, true, nullptr },
+		{ "bodies", Kind::Array, true, nullptr },
+		{ "projectiles", Kind::Array, false, nullptr },
+	};
+
+	const std::vector<SchemaField> s_gameInfoFields = {
+		{ "system", Kind::String, true, nullptr },
+		{ "credits", Kind::Number, true, nullptr },
+		{ "ship", Kind::String, true, nullptr },
+		{ "docked_at", Kind::String, false, nullptr },
+		{ "flight_state", Kind::String, true, nullptr },
+	};
+
+	const std::vector<SchemaField> s_saveFields = {
+		{ "version", Kind::Integer, true, nullptr },
+		{ "time", Kind::Number, true, nullptr },
+		{ "state", Kind::Integer, true, nullptr },
+		{ "want_hyperspace", Kind::Boolean, true, nullptr },
+		{ "hyperspace_progress", Kind::Number, true, nullptr },
+		{ "hyperspace_duration", Kind::Number, true, nullptr },
+		{ "hyperspace_end_time", Kind::Number, true, nullptr },
+		{ "galaxy_generator", Kind::Object, true, nullptr },
+		{ "space", Kind::Object, true, &s_spaceFields },
+		{ "player", Kind::Integer, true, nullptr },
+		{ "hyperspace_clouds", Kind::Array, true, nullptr },
+		{ "sector_view", Kind::Object, true, nullptr },
+		{ "world_view", Kind::Object, true, nullptr },
+		{ "game_info", Kind::Object, true, &s_gameInfoFields },
+	};
+
+	const char *KindName(Kind kind)
+	{
+		switch (kind) {
+		case Kind::Integer: return "an integer";
+		case Kind::Number: return "a number";
+		case Kind::Boolean: return "a boolean";
+		case Kind::String: return "a string";
+		case Kind::Array: return "an array";
+		default: return "an object";
+		}
+	}
+
+	bool IsKind(Json::value_t type, Kind kind)
+	{
+		switch (kind) {
+		case Kind::Integer: return type == Json::value_t::number_integer || type == Json::value_t::number_unsigned;
+		case Kind::Number: return type == Json::value_t::number_integer || type == Json::value_t::number_unsigned || type == Json::value_t::number_float;
+		case Kind::Boolean: return type == Json::value_t::boolean;
+		case Kind::String: return type == Json::value_t::string;
+		case Kind::Array: return type == Json::value_t::array;
+		default: return type == Json::value_t::object;
+		}
+	}
+
+	// Checks the save against s_saveFields
+	class SchemaValidator : public SaveHandler {
+	public:
+		const std::vector<std::string> &GetIssues() const { return m_issues; }
+
+	protected:
+		bool OnScalar(const Json &value) override
+		{
+			CheckValue(value.type());
+			return true;
+		}
+
+		bool OnOpen(Json::value_t type) override
+		{
+			const std::vector<SchemaField> *fields = GetDepth() == 1 ? &s_saveFields : nullptr;
+			if (const SchemaField *field = CheckValue(type))
+				fields = type == Json::value_t::object ? field->fields : nullptr;
+
+			m_stack.push_back({ fields, std::vector<bool>(fields ? fields->size() : 0, false), m_path });
+			return true;
+		}
+
+		bool OnKey(const std::string &key) override
+		{
+			Object &object = m_stack.back();
+			m_path = object.path.empty() ? key : object.path + "." + key;
+			m_field = nullptr;
+			if (!object.fields)
+				return true;
+
+			for (size_t idx = 0; idx < object.fields->size(); idx++) {
+				if (key == (*object.fields)[idx].key) {
+					m_field = &(*object.fields)[idx];
+					object.seen[idx] = true;
+				}
+			}
+			return true;
+		}
+
+		bool OnClose() override
+		{
+			const Object &object = m_stack.back();
+			for (size_t idx = 0; object.fields && idx < object.fields->size(); idx++) {
+				const SchemaField &field = (*object.fields)[idx];
+				if (field.required && !object.seen[idx])
+					m_issues.push_back(fmt::format("{}{}{} is missing", object.path, object.path.empty() ? "" : ".", field.key));
+			}
+			m_stack.pop_back();
+			m_field = nullptr;
+			return true;
+		}
+
+	private:
+		struct Object {
+			const std::vector<SchemaField> *fields;
+			std::vector<bool> seen;
+			std::string path;
+		};
+
+		// the field of the value, if it has a schema and the value is valid
+		const SchemaField *CheckValue(Json::value_t type)
+		{
+			const SchemaField *field = m_field;
+			m_field = nullptr;
+			if (!field)
+				return nullptr;
+
+			if (!IsKind(type, field->kind)) {
+				m_issues.push_back(fmt::format("{} should be {}", m_path, KindName(field->kind)));
+				return nullptr;
+			}
+			return field;
+		}
+
+		std::vector<Object> m_stack;
+		std::string m_path;
+		// the schema of the value following the last key, if it has one
+		const SchemaField *m_field = nullptr;
+		std::vector<std::string> m_issues;
+	};
+
+	std::string FormatSize(size_t size)
+	{
+		if (size >= 1024 * 1024)
+			return fmt::format("{:.1f} MiB", size / (1024.0 * 1024.0));
+		if (size >= 1024)
+			return fmt::format("{:.1f} KiB", size / 1024.0);
+		return fmt::format("{} B", size);
+	}
+
+	void PrintSections(std::vector<SectionSizes::Section> &sections, size_t total, int indent)
+	{
+		std::sort(sections.begin(), sections.end(), [](const SectionSizes::Section &a, const SectionSizes::Section &b) {
+			return a.size > b.size;
+		});
+
+		for (SectionSizes::Section &section : sections) {
+			printf("%*s%-*s %10s %5.1f%% %10zu entries\n", indent, "", 40 - indent, section.name.c_str(),
+				FormatSize(section.size).c_str(), total ? 100.0 * section.size / total : 0.0, section.entries);
+			PrintSections(section.sections, total, indent + 2);
+		}
+	}
+
+} // namespace
+
+// The file is mapped rather than read, the parts which have been read can
+// be dropped again when memory is short
+static RefCountedPtr<FileSystem::FileData> open(const std::string &filename)
+{
 	auto fileinfo = FileSystem::userFiles.Lookup(filename);
 	if (!fileinfo.Exists()) {
 		printf("Input file %s could not be found.\n", filename.c_str());
 		printf("%s\n", fileinfo.GetPath().c_str());
-		return 1;
+		return RefCountedPtr<FileSystem::FileData>();
 	}
 
-	auto file = FileSystem::userFiles.ReadFile(filename);
-	if (!file) {
+	auto file = FileSystem::userFiles.MapFile(filename);
+	if (!file)
 		printf("Could not open file %s.\n", filename.c_str());
+	return file;
+}
+
+// Runs fn with a reader of the saved game, and turns the exceptions of the
+// decompressors into exit codes
+template <typename Fn>
+static int read(const std::string &filename, Fn fn)
+{
+	auto file = open(filename);
+	if (!file)
 		return 1;
-	}
 
-	const auto compressed_data = file->AsByteRange();
-	Json rootNode;
 	try {
-		std::string plain_data;
-		if (gzip::IsGZipFormat(reinterpret_cast<const uint8_t *>(compressed_data.begin), compressed_data.Size()))
-			plain_data = gzip::DecompressDeflateOrGZip(reinterpret_cast<const uint8_t *>(compressed_data.begin), compressed_data.Size());
-		else
-			plain_data = std::string(compressed_data.begin, compressed_data.Size());
+		JsonUtils::SaveDataReader reader(file->AsStringView());
+		return fn(reader);
+	} catch (Json::parse_error &e) {
+		printf("%s is not a valid saved game: %s.\n", filename.c_str(), e.what());
+		return 2;
+	} catch (gzip::DecompressionFailedException) {
+		printf("Decompressing saved data failed - saved game is corrupt.\n");
+		return 3;
+	} catch (const lz4::DecompressionFailedException &) {
+		printf("Decompressing saved data failed - saved game is corrupt.\n");
+		return 3;
+	} catch (const lz4::CompressionFailedException &) {
+		printf("Compressing the saved game failed.\n");
+		return 3;
+	}
+}
 
-		try {
-			// Allow loading files in JSON format as well as CBOR
-			if (plain_data[0] == '{')
-				rootNode = Json::parse(plain_data);
-			else
-				rootNode = Json::from_cbor(plain_data);
-		} catch (Json::parse_error &e) {
-			printf("Saved game is not a valid JSON object: %s.\n", e.what());
+static int close(FILE *outFile, const std::string &outname)
+{
+	const bool failed = ferror(outFile);
+	if (fclose(outFile) != 0 || failed) {
+		printf("Could not write to output file %s.\n", outname.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+static int dump(const std::string &filename, const std::string &outname, int indent)
+{
+	return read(filename, [&](JsonUtils::SaveDataReader &reader) {
+		auto outFile = FileSystem::userFiles.OpenWriteStream(outname);
+		if (!outFile) {
+			printf("Could not open output file %s.\n", outname.c_str());
+			return 1;
+		}
+
+		JsonTextWriter writer(outFile, indent);
+		if (!ParseSave(filename, reader, writer)) {
+			fclose(outFile);
 			return 2;
 		}
 
-		if (!rootNode.is_object()) {
-			printf("Saved game's root is not a JSON object.\n");
+		return close(outFile, outname);
+	});
+}
+
+static int save(const std::string &filename, const std::string &outname)
+{
+	// the summary shown in the list of saves, see Game::SaveGame; a JSON
+	// dump has to be read twice to have it before the rest of the save
+	Json summary;
+	const int result = read(filename, [&](JsonUtils::SaveDataReader &reader) {
+		summary = reader.GetSummary();
+		if (summary.is_object())
+			return 0;
+
+		ValueCollector collector({ "version", "time", "game_info" });
+		if (!ParseSave(filename, reader, collector))
 			return 2;
+
+		summary = collector.GetValues();
+		return 0;
+	});
+	if (result != 0)
+		return result;
+
+	return read(filename, [&](JsonUtils::SaveDataReader &reader) {
+		auto outFile = FileSystem::userFiles.OpenWriteStream(outname);
+		if (!outFile) {
+			printf("Could not open output file %s.\n", outname.c_str());
+			return 1;
 		}
-	} catch (gzip::DecompressionFailedException) {
-		printf("Decompressing saved data failed - saved game is corrupt.\n");
-		return 3;
+
+		const std::string header = JsonUtils::EncodeSaveHeader(summary);
+		fwrite(header.data(), 1, header.size(), outFile);
+
+		try {
+			lz4::StreamCompressor compressor([&](std::string_view block) {
+				fwrite(block.data(), 1, block.size(), outFile);
+			},
+				0);
+
+			CborWriter writer(compressor);
+			if (!ParseSave(filename, reader, writer)) {
+				fclose(outFile);
+				return 2;
+			}
+
+			compressor.Finish();
+		} catch (...) {
+			fclose(outFile);
+			throw;
+		}
+
+		return close(outFile, outname);
+	});
+}
+
+static int summary(const std::string &filename)
+{
+	return read(filename, [&](JsonUtils::SaveDataReader &reader) {
+		SectionSizes sizes(reader);
+		if (!ParseSave(filename, reader, sizes))
+			return 2;
+
+		const size_t total = reader.Tell();
+		printf("%s: %s %s, %s decompressed\n", filename.c_str(), reader.IsCBOR() ? "CBOR" : "JSON",
+			reader.GetSummary().is_object() ? "with a summary" : "without a summary", FormatSize(total).c_str());
+		PrintSections(sizes.GetSections(), total, 0);
+		return 0;
+	});
+}
+
+static int validate(const std::string &filename)
+{
+	return read(filename, [&](JsonUtils::SaveDataReader &reader) {
+		SchemaValidator validator;
+		if (!ParseSave(filename, reader, validator))
+			return 2;
+
+		for (const std::string &issue : validator.GetIssues())
+			printf("%s: %s\n", filename.c_str(), issue.c_str());
+
+		if (!validator.GetIssues().empty())
+			return 2;
+
+		printf("%s is valid.\n", filename.c_str());
+		return 0;
+	});
+}
+
+extern "C" int main(int argc, char **argv)
+{
+	if (argc < 2) return info();
+
+	int indent = -1;
+	int shift = 0;
+
+	std::string filename = argv[1];
+	if (filename == "--save") {
+		if (argc != 4) return info();
+		return save(argv[2], argv[3]);
 	}
 
-	auto outFile = FileSystem::userFiles.OpenWriteStream(outname);
-	if (!outFile) {
-		printf("Could not open output file %s.\n", outname.c_str());
-		return 1;
+	if (filename == "--summary") {
+		if (argc != 3) return info();
+		return summary(argv[2]);
 	}
 
-	fputs(rootNode.dump(indent).c_str(), outFile);
-	fclose(outFile);
+	if (filename == "--validate") {
+		if (argc != 3) return info();
+		return validate(argv[2]);
+	}
 
-	return 0;
+	if (filename == "--pretty") {
+		indent = 2;
+		shift = 1;
+	}
+
+	if (argc < shift+2 || argc > shift+3) return info();
+	filename = argv[shift+1];
+	std::string outname = argc > shift+2 ? argv[shift+2] : filename + ".json";
+
+	return dump(filename, outname, indent);
 }
@@ -3,6 +3,7 @@
 
 #include "Animation.h"
 #include "MathUtil.h"
+#include "NodeCopyCache.h"
 #include "scenegraph/Model.h"
 #include "profiler/Profiler.h"
 #include <iostream>
@@ -15,6 +16,7 @@ namespace SceneGraph {
 	Animation::Animation(const std::string &name, double duration) :
 		m_duration(duration),
 		m_time(0.0),
+		m_interpolatedTime(-1.0),
 		m_name(name)
 	{
 	}
@@ -22,6 +24,7 @@ namespace SceneGraph {
 	Animation::Animation(const Animation &anim) :
 		m_duration(anim.m_duration),
 		m_time(0.0),
+		m_interpolatedTime(-1.0),
 		m_name(anim.m_name)
 	{
 		for (ChannelList::const_iterator chan = anim.m_channels.begin(); chan != anim.m_channels.end(); ++chan) {
@@ -37,25 +40,50 @@ namespace SceneGraph {
 			assert(trans);
 			chan->node = trans;
 		}
+		Invalidate();
 	}
 
-	void Animation::Interpolate()
+	void Animation::UpdateChannelTargets(const NodeCopyCache &cache)
 	{
+		for (AnimationChannel &chan : m_channels)
+			chan.node = cache.GetCopy(chan.node);
+		Invalidate();
+	}
+
+	// The key at or before time, or the first key. Keys are sorted by time
+	// and animations mostly play forwards, so the search starts at the key
+	// found last time.
+	template <typename Key>
+	static unsigned int find_frame(const std::vector<Key> &keys, double time, unsigned int &lastFrame)
+	{
+		unsigned int frame = lastFrame;
+		if (frame >= keys.size() || time < keys[frame].time)
+			frame = 0;
+		while (frame + 1 < keys.size()) {
+			if (time < keys[frame + 1].time)
+				break;
+			frame++;
+		}
+		lastFrame = frame;
+		return frame;
+	}
+
+	bool Animation::Interpolate()
+	{
+		// landing gear that stays down, a docked ship...
+		if (m_time == m_interpolatedTime)
+			return false;
+
 		PROFILE_SCOPED()
 		const double mtime = m_time;
+		m_interpolatedTime = mtime;
 
 		//go through channels and calculate transforms
 		for (ChannelIterator chan = m_channels.begin(); chan != m_channels.end(); ++chan) {
 			matrix4x4f trans = chan->node->GetTransform();
 
 			if (!chan->rotationKeys.empty()) {
-				//find a frame. To optimize, should begin search from previous frame (when mTime > previous mTime)
-				unsigned int frame = 0;
-				while (frame + 1 < chan->rotationKeys.size()) {
-					if (mtime < chan->rotationKeys[frame + 1].time)
-						break;
-					frame++;
-				}
+				const unsigned int frame = find_frame(chan->rotationKeys, mtime, chan->rotationFrame);
 
 				const RotationKey &a = chan->rotationKeys[frame];
 				vector3f saved_position = trans.GetTranslate();
@@ -75,13 +103,7 @@ namespace SceneGraph {
 			//continously scale the transform (would have to add originalTransform or
 			//something to MT)
 			if (!chan->scaleKeys.empty() && !chan->rotationKeys.empty()) {
-				//find a frame. To optimize, should begin search from previous frame (when mTime > previous mTime)
-				unsigned int frame = 0;
-				while (frame + 1 < chan->scaleKeys.size()) {
-					if (mtime < chan->scaleKeys[frame + 1].time)
-						break;
-					frame++;
-				}
+				const unsigned int frame = find_frame(chan->scaleKeys, mtime, chan->scaleFrame);
 
 				const ScaleKey &a = chan->scaleKeys[frame];
 				vector3f out;
@@ -98,13 +120,7 @@ namespace SceneGraph {
 			}
 
 			if (!chan->positionKeys.empty()) {
-				//find a frame. To optimize, should begin search from previous frame (when mTime > previous mTime)
-				unsigned int frame = 0;
-				while (frame + 1 < chan->positionKeys.size()) {
-					if (mtime < chan->positionKeys[frame + 1].time)
-						break;
-					frame++;
-				}
+				const unsigned int frame = find_frame(chan->positionKeys, mtime, chan->positionFrame);
 
 				const PositionKey &a = chan->positionKeys[frame];
 				vector3f out;
@@ -122,6 +138,12 @@ namespace SceneGraph {
 
 			chan->node->SetTransform(trans);
 		}
+		return true;
+	}
+
+	void Animation::Invalidate()
+	{
+		m_interpolatedTime = -1.0;
 	}
 
 	double Animation::GetProgress()
@@ -15,17 +15,25 @@ namespace SceneGraph {
 	class Loader;
 	class BinaryConverter;
 	class Node;
+	class NodeCopyCache;
 
 	class Animation {
 	public:
 		Animation(const std::string &name, double duration);
 		Animation(const Animation &);
 		void UpdateChannelTargets(Node *root);
+		// point the channels to the copies of their nodes
+		void UpdateChannelTargets(const NodeCopyCache &cache);
 		double GetDuration() const { return m_duration; }
 		const std::string &GetName() const { return m_name; }
 		double GetProgress();
 		void SetProgress(double); //0.0 -- 1.0, overrides m_time
-		void Interpolate(); //update transforms according to m_time;
+		//update transforms according to m_time. Does nothing if they were
+		//already updated for this time; returns true if they changed
+		bool Interpolate();
+		//make the next Interpolate update the transforms, e.g. after
+		//something else has moved the nodes
+		void Invalidate();
 		const std::vector<AnimationChannel> &GetChannels() const { return m_channels; }
 
 	private:
@@ -33,6 +41,7 @@ namespace SceneGraph {
 		friend class BinaryConverter;
 		double m_duration;
 		double m_time;
+		double m_interpolatedTime; // m_time at the last Interpolate, negative if none
 		std::string m_name;
 		std::vector<AnimationChannel> m_channels;
 	};
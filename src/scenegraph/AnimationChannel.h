@@ -18,6 +18,11 @@ namespace SceneGraph {
 		std::vector<RotationKey> rotationKeys;
 		std::vector<ScaleKey> scaleKeys;
 		MatrixTransform *node;
+
+		// the keys used last time, to start looking for the next ones from
+		unsigned int positionFrame = 0;
+		unsigned int rotationFrame = 0;
+		unsigned int scaleFrame = 0;
 	};
 
 } // namespace SceneGraph
@@ -5,6 +5,8 @@
 #include "FileSystem.h"
 #include "graphics/RenderState.h"
 #include "graphics/TextureBuilder.h"
+#include "graphics/TextureLoader.h"
+#include "graphics/TextureStreamer.h"
 #include "graphics/Types.h"
 #include "utils.h"
 
@@ -64,35 +66,38 @@ void BaseLoader::ConvertMaterialDefinition(const MaterialDefinition &mdef)
 	if (mdef.opacity < 100)
 		mat->diffuse.a = (float(mdef.opacity) / 100.f) * 255;
 
-	Graphics::Texture *texture0 = nullptr;
-	Graphics::Texture *texture1 = nullptr;
-	Graphics::Texture *texture2 = nullptr;
-	Graphics::Texture *texture3 = nullptr;
-	Graphics::Texture *texture6 = nullptr;
+	//textures are loaded in the background; until then the material uses
+	//placeholders that look neutral in their slot
+	Graphics::Texture *white = Graphics::TextureBuilder::GetWhiteTexture(m_renderer);
+	Graphics::Texture *black = Graphics::TextureBuilder::GetTransparentTexture(m_renderer);
 	if (!diffTex.empty())
-		texture0 = Graphics::TextureBuilder::Model(diffTex).GetOrCreateTexture(m_renderer, "model");
+		SetModelTexture(mat.Get(), "texture0"_hash, Graphics::TextureBuilder::Model(diffTex), white);
 	else
-		texture0 = Graphics::TextureBuilder::GetWhiteTexture(m_renderer);
+		mat->SetTexture("texture0"_hash, white);
 	if (!specTex.empty())
-		texture1 = Graphics::TextureBuilder::Model(specTex).GetOrCreateTexture(m_renderer, "model");
+		SetModelTexture(mat.Get(), "texture1"_hash, Graphics::TextureBuilder::Model(specTex), black);
 	if (!glowTex.empty())
-		texture2 = Graphics::TextureBuilder::Model(glowTex).GetOrCreateTexture(m_renderer, "model");
+		SetModelTexture(mat.Get(), "texture2"_hash, Graphics::TextureBuilder::Model(glowTex), black);
 	if (!ambiTex.empty())
-		texture3 = Graphics::TextureBuilder::Model(ambiTex).GetOrCreateTexture(m_renderer, "model");
+		SetModelTexture(mat.Get(), "texture3"_hash, Graphics::TextureBuilder::Model(ambiTex), white);
 	//texture4 is reserved for pattern
 	//texture5 is reserved for color gradient
 	if (!normTex.empty())
-		texture6 = Graphics::TextureBuilder::Normal(normTex).GetOrCreateTexture(m_renderer, "model");
-
-	mat->SetTexture("texture0"_hash, texture0);
-	mat->SetTexture("texture1"_hash, texture1);
-	mat->SetTexture("texture2"_hash, texture2);
-	mat->SetTexture("texture3"_hash, texture3);
-	mat->SetTexture("texture6"_hash, texture6);
+		SetModelTexture(mat.Get(), "texture6"_hash, Graphics::TextureBuilder::Normal(normTex), Graphics::TextureBuilder::GetFlatNormalTexture(m_renderer));
 
 	m_model->m_materials.push_back(std::make_pair(mdef.name, mat));
 }
 
+void BaseLoader::SetModelTexture(Graphics::Material *mat, size_t name, Graphics::TextureBuilder builder, Graphics::Texture *placeholder)
+{
+	builder.SetStreamed();
+	Graphics::TextureLoader::SetTexture(m_renderer, mat, name, builder, "model", placeholder);
+
+	//the texture may not exist yet, so the model looks it up in the material
+	if (Graphics::TextureStreamer::IsEnabled())
+		m_model->m_streamedTextures.emplace_back(mat, name);
+}
+
 RefCountedPtr<Graphics::Material> BaseLoader::GetDecalMaterial(unsigned int index)
 {
 	assert(index <= Model::MAX_DECAL_MATERIALS);
@@ -10,6 +10,7 @@
 #include "Model.h"
 #include "StaticGeometry.h"
 #include "graphics/Material.h"
+#include "graphics/TextureBuilder.h"
 #include "text/DistanceFieldFont.h"
 
 namespace SceneGraph {
@@ -32,6 +33,8 @@ namespace SceneGraph {
 
 		//create a material from definition and add it to m_model
 		void ConvertMaterialDefinition(const MaterialDefinition &);
+		//bind a model texture to a material, loading it in the background
+		void SetModelTexture(Graphics::Material *mat, size_t name, Graphics::TextureBuilder builder, Graphics::Texture *placeholder);
 		//find pattern texture files from the model directory
 		void FindPatterns(PatternContainer &output);
 		void SetUpPatterns();
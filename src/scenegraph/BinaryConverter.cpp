@@ -54,7 +54,8 @@ public:
 
 BinaryConverter::BinaryConverter(Graphics::Renderer *r) :
 	BaseLoader(r),
-	m_patternsUsed(false)
+	m_patternsUsed(false),
+	m_quantiseVertices(false)
 {
 	//register core loaders
 	RegisterLoader("Group", &Group::Load);
@@ -119,6 +120,7 @@ void BinaryConverter::Save(const std::string &filename, const std::string &savep
 	SaveMaterials(wr, m);
 
 	SaveHelperVisitor sv(&wr, m);
+	sv.db.quantiseVertices = m_quantiseVertices;
 	m->GetRoot()->Accept(sv);
 
 	m->GetCollisionMesh()->Save(wr);
@@ -151,40 +153,92 @@ Model *BinaryConverter::Load(const std::string &filename)
 	return Load(filename, "models");
 }
 
-Model *BinaryConverter::Load(const std::string &name, RefCountedPtr<FileSystem::FileData> binfile)
+// decompress the contents of an SGM file
+static bool decompress_sgm(const std::string &name, const ByteRange &bin, std::string &data)
 {
 	PROFILE_SCOPED()
-	Model *model(nullptr);
-	// decompress the loaded ByteRange in memory
-	const ByteRange bin = binfile->AsByteRange();
 	if (lz4::IsLZ4Format(bin.begin, bin.Size())) {
 		try {
-			std::string decompressedData = lz4::DecompressLZ4({ bin.begin, bin.Size() });
-			// Output("decompressed model file %s (%.2f KB) -> %.2f KB\n", name.c_str(), binfile->GetSize() / 1024.f, decompressedData.size() / 1024.f);
-			Serializer::Reader rd(ByteRange(decompressedData.data(), decompressedData.size()));
-			model = CreateModel(name, rd);
+			data = lz4::DecompressLZ4({ bin.begin, bin.Size() });
+			return true;
 		} catch (std::runtime_error &e) {
 			Log::Error("Error loading SGM model: {}\n", e.what());
+			return false;
 		}
-	} else {
-		void *pDecompressedData;
-		size_t outSize(0);
-		{
-			PROFILE_SCOPED_DESC("tinfl_decompress_mem_to_heap")
-			pDecompressedData = tinfl_decompress_mem_to_heap(&bin[0], bin.Size(), &outSize, 0);
-		}
-		// Output("decompressed model file %s (%.2f KB) -> %.2f KB\n", name.c_str(), binfile->GetSize() / 1024.f, outSize / 1024.f);
-		if (pDecompressedData) {
-			// now parse in-memory representation as new ByteRange.
-			Serializer::Reader rd(ByteRange(static_cast<char *>(pDecompressedData), outSize));
-			model = CreateModel(name, rd);
-			mz_free(pDecompressedData);
-		} else {
-			Log::Warning("BinaryConverter failed to load old-style SGM called: {}\n", name.c_str());
-		}
 	}
 
-	return model;
+	void *pDecompressedData;
+	size_t outSize(0);
+	{
+		PROFILE_SCOPED_DESC("tinfl_decompress_mem_to_heap")
+		pDecompressedData = tinfl_decompress_mem_to_heap(&bin[0], bin.Size(), &outSize, 0);
+	}
+	if (!pDecompressedData) {
+		Log::Warning("BinaryConverter failed to load old-style SGM called: {}\n", name.c_str());
+		return false;
+	}
+
+	data.assign(static_cast<char *>(pDecompressedData), outSize);
+	mz_free(pDecompressedData);
+	return true;
+}
+
+// directory of a file, without a trailing slash
+static std::string model_dir(const FileSystem::FileInfo &info)
+{
+	std::string dir = info.GetDir();
+	if (dir[dir.length() - 1] == '/')
+		dir = dir.substr(0, dir.length() - 1);
+	return dir;
+}
+
+Model *BinaryConverter::Load(const std::string &name, RefCountedPtr<FileSystem::FileData> binfile)
+{
+	PROFILE_SCOPED()
+	std::string data;
+	if (!decompress_sgm(name, binfile->AsByteRange(), data))
+		return nullptr;
+
+	return CreateModelFromData(name, data);
+}
+
+Model *BinaryConverter::LoadFromData(const std::string &shortname, const std::string &dir, const std::string &data)
+{
+	m_curPath = dir;
+	return CreateModelFromData(shortname, data);
+}
+
+bool BinaryConverter::ReadModelData(const std::string &shortname, const std::string &basepath, std::string &dir, std::string &data)
+{
+	PROFILE_SCOPED()
+	FileSystem::FileSource &fileSource = FileSystem::gameDataFiles;
+	for (FileSystem::FileEnumerator files(fileSource, basepath, FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
+		const FileSystem::FileInfo &info = files.Current();
+		const std::string &name = info.GetName();
+		if (!info.IsFile() || !ends_with_ci(name, SGM_EXTENSION) || shortname != name.substr(0, name.length() - SGM_EXTENSION.length()))
+			continue;
+
+		RefCountedPtr<FileSystem::FileData> binfile = info.Read();
+		if (!binfile.Valid())
+			return false;
+
+		dir = model_dir(info);
+		return decompress_sgm(name, binfile->AsByteRange(), data);
+	}
+
+	return false;
+}
+
+Model *BinaryConverter::CreateModelFromData(const std::string &name, const std::string &data)
+{
+	try {
+		// now parse in-memory representation as new ByteRange.
+		Serializer::Reader rd(ByteRange(data.data(), data.size()));
+		return CreateModel(name, rd);
+	} catch (std::runtime_error &e) {
+		Log::Error("Error loading SGM model: {}\n", e.what());
+		return nullptr;
+	}
 }
 
 Model *BinaryConverter::Load(const std::string &shortname, const std::string &basepath)
@@ -203,10 +257,7 @@ Model *BinaryConverter::Load(const std::string &shortname, const std::string &ba
 			if (shortname == name.substr(0, name.length() - SGM_EXTENSION.length())) {
 				//curPath is used to find textures, patterns,
 				//possibly other data files for this model.
-				//Strip trailing slash
-				m_curPath = info.GetDir();
-				if (m_curPath[m_curPath.length() - 1] == '/')
-					m_curPath = m_curPath.substr(0, m_curPath.length() - 1);
+				m_curPath = model_dir(info);
 
 				RefCountedPtr<FileSystem::FileData> binfile = info.Read();
 				if (binfile.Valid()) return Load(name, binfile);
@@ -39,7 +39,11 @@ namespace SceneGraph {
 	// 6.1:	rewrote serialization, use lz4 compression instead of INFLATE/DEFLATE. Still compatible.
 	// 6.2: ignored StaticGeometry::m_blendMode in files. Still write blank value.
 	// 7:   Added discrete Tag node, tags are registered in the model hierarchy instead of at the root.
-	constexpr Uint32 SGM_VERSION = 7;
+	// 8:   GeomTrees store their arrays as raw blobs and compact, quantized BVH trees instead of rebuilding them on load.
+	// 9:   GeomTrees store a 26-DOP convex proxy of their mesh.
+	// 10:  StaticGeometry stores its vertex and index buffers as blobs in the layout they are uploaded in.
+	// 11:  StaticGeometry meshes may use a quantised vertex format, flagged per mesh.
+	constexpr Uint32 SGM_VERSION = 11;
 
 	class BinaryConverter : public BaseLoader {
 	public:
@@ -49,13 +53,25 @@ namespace SceneGraph {
 		Model *Load(const std::string &filename);
 		Model *Load(const std::string &filename, const std::string &path);
 		Model *Load(const std::string &filename, RefCountedPtr<FileSystem::FileData> binfile);
+		//create a model from the data read by ReadModelData
+		Model *LoadFromData(const std::string &shortname, const std::string &dir, const std::string &data);
+
+		//find a model's .sgm file and decompress it, returning the directory
+		//it's in and its contents. Doesn't use the renderer, so it may be
+		//called from a worker thread.
+		static bool ReadModelData(const std::string &shortname, const std::string &basepath, std::string &dir, std::string &data);
 
 		//if you implement any new node types, you must also register a loader function
 		//before calling Load.
 		void RegisterLoader(const std::string &typeName, std::function<Node *(NodeDatabase &)>);
 
+		//save meshes with byte normals and tangents and half float UVs,
+		//roughly halving their size
+		void SetQuantiseVertices(bool quantise) { m_quantiseVertices = quantise; }
+
 	private:
 		Model *CreateModel(const std::string &filename, Serializer::Reader &);
+		Model *CreateModelFromData(const std::string &filename, const std::string &data);
 		void SaveMaterials(Serializer::Writer &, Model *m);
 		void LoadMaterials(Serializer::Reader &);
 		void SaveAnimations(Serializer::Writer &, Model *m);
@@ -67,6 +83,7 @@ namespace SceneGraph {
 		static Label3D *LoadLabel3D(NodeDatabase &);
 
 		bool m_patternsUsed;
+		bool m_quantiseVertices;
 		std::map<std::string, std::function<Node *(NodeDatabase &)>> m_loaders;
 	};
 } // namespace SceneGraph
@@ -8,6 +8,7 @@
 #include "MatrixTransform.h"
 #include "StaticGeometry.h"
 #include "collider/GeomTree.h"
+#include "jenkins/lookup3.h"
 #include "profiler/Profiler.h"
 
 namespace SceneGraph {
@@ -52,7 +53,10 @@ namespace SceneGraph {
 		PROFILE_SCOPED()
 		using std::vector;
 
-		if (cg.IsDynamic()) return ApplyDynamicCollisionGeometry(cg);
+		if (cg.IsDynamic()) {
+			m_dynamicGeoms.push_back(&cg);
+			return;
+		}
 
 		const matrix4x4f matrix = m_matrixStack.empty() ? matrix4x4f::Identity() : m_matrixStack.back();
 
@@ -75,29 +79,6 @@ namespace SceneGraph {
 			m_flags.push_back(cg.GetTriFlag());
 	}
 
-	void CollisionVisitor::ApplyDynamicCollisionGeometry(CollisionGeometry &cg)
-	{
-		PROFILE_SCOPED()
-		//don't transform geometry, one geomtree per cg, create tree right away
-
-		const int numVertices = cg.GetVertices().size();
-		const int numIndices = cg.GetIndices().size();
-		const int numTris = numIndices / 3;
-		std::vector<Uint32> triFlags(numTris, cg.GetTriFlag());
-
-		//create geomtree
-		//copy data
-		GeomTree *gt = new GeomTree(
-			numVertices, numTris,
-			cg.GetVertices(),
-			cg.GetIndices(), triFlags);
-		cg.SetGeomTree(gt);
-
-		m_collMesh->AddDynGeomTree(gt);
-
-		m_totalTris += numTris;
-	}
-
 	void CollisionVisitor::AabbToMesh(const Aabb &bb)
 	{
 		PROFILE_SCOPED()
@@ -160,7 +141,36 @@ namespace SceneGraph {
 			m_flags.push_back(0);
 	}
 
-	RefCountedPtr<CollMesh> CollisionVisitor::CreateCollisionMesh()
+	template <typename T>
+	static void hash_array(const std::vector<T> &v, uint32_t &a, uint32_t &b)
+	{
+		const uint32_t size = v.size();
+		lookup3_hashlittle2(&size, sizeof(size), &a, &b);
+		if (!v.empty())
+			lookup3_hashlittle2(v.data(), v.size() * sizeof(T), &a, &b);
+	}
+
+	uint64_t CollisionVisitor::GetSourceHash() const
+	{
+		PROFILE_SCOPED()
+		uint32_t a = 0, b = 0;
+		hash_array(m_vertices, a, b);
+		hash_array(m_indices, a, b);
+		hash_array(m_flags, a, b);
+		const Aabb &aabb = m_collMesh->GetAabb();
+		const double bounds[6] = { aabb.min.x, aabb.min.y, aabb.min.z, aabb.max.x, aabb.max.y, aabb.max.z };
+		lookup3_hashlittle2(bounds, sizeof(bounds), &a, &b);
+		for (const CollisionGeometry *cg : m_dynamicGeoms) {
+			const Uint32 flag = cg->GetTriFlag();
+			hash_array(cg->GetVertices(), a, b);
+			hash_array(cg->GetIndices(), a, b);
+			lookup3_hashlittle2(&flag, sizeof(flag), &a, &b);
+		}
+		const uint64_t hash = (uint64_t(a) << 32) | b;
+		return hash ? hash : 1;
+	}
+
+	RefCountedPtr<CollMesh> CollisionVisitor::CreateCollisionMesh(const RefCountedPtr<CollMesh> &previous)
 	{
 		PROFILE_SCOPED()
 		Profiler::Timer timer;
@@ -173,6 +183,36 @@ namespace SceneGraph {
 		assert(m_collMesh->GetGeomTree() == 0);
 		assert(!m_vertices.empty() && !m_indices.empty());
 
+		const uint64_t sourceHash = GetSourceHash();
+		if (previous.Valid() && previous->GetSourceHash() == sourceHash &&
+			previous->GetDynGeomTrees().size() == m_dynamicGeoms.size()) {
+			//the dynamic trees are in traversal order
+			for (size_t i = 0; i < m_dynamicGeoms.size(); i++)
+				m_dynamicGeoms[i]->SetGeomTree(previous->GetDynGeomTrees()[i]);
+			m_collMesh = previous;
+			m_boundingRadius = m_collMesh->GetAabb().GetRadius();
+
+			m_vertices.clear();
+			m_indices.clear();
+			m_flags.clear();
+			m_dynamicGeoms.clear();
+			return m_collMesh;
+		}
+
+		//don't transform dynamic geometry, one geomtree per cg
+		for (CollisionGeometry *cg : m_dynamicGeoms) {
+			const int numTris = cg->GetIndices().size() / 3;
+			std::vector<Uint32> triFlags(numTris, cg->GetTriFlag());
+
+			GeomTree *dgt = new GeomTree(
+				cg->GetVertices().size(), numTris,
+				cg->GetVertices(),
+				cg->GetIndices(), triFlags);
+			cg->SetGeomTree(m_collMesh->AddDynGeomTree(dgt));
+
+			m_totalTris += numTris;
+		}
+
 		const size_t numVertices = m_vertices.size();
 		const size_t numIndices = m_indices.size();
 		const size_t numTris = numIndices / 3;
@@ -187,11 +227,13 @@ namespace SceneGraph {
 			m_indices, m_flags);
 		m_collMesh->SetGeomTree(gt);
 		m_collMesh->SetNumTriangles(m_totalTris);
+		m_collMesh->SetSourceHash(sourceHash);
 		m_boundingRadius = m_collMesh->GetAabb().GetRadius();
 
 		m_vertices.clear();
 		m_indices.clear();
 		m_flags.clear();
+		m_dynamicGeoms.clear();
 
 		timer.Stop();
 		//Output(" - CreateCollisionMesh took: %lf milliseconds\n", timer.millicycles());
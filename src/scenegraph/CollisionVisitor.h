@@ -22,13 +22,15 @@ namespace SceneGraph {
 		virtual void ApplyStaticGeometry(StaticGeometry &);
 		virtual void ApplyMatrixTransform(MatrixTransform &);
 		virtual void ApplyCollisionGeometry(CollisionGeometry &);
-		//call after traversal complete
-		RefCountedPtr<CollMesh> CreateCollisionMesh();
+		//call after traversal complete. If the geometry is the same that the
+		//previous mesh (e.g. one of an earlier version of the model) was
+		//made from, that mesh is returned instead of building the trees again
+		RefCountedPtr<CollMesh> CreateCollisionMesh(const RefCountedPtr<CollMesh> &previous = RefCountedPtr<CollMesh>());
 		float GetBoundingRadius() const { return m_boundingRadius; }
 
 	private:
-		void ApplyDynamicCollisionGeometry(CollisionGeometry &);
 		void AabbToMesh(const Aabb &);
+		uint64_t GetSourceHash() const;
 		//geomtree is not built until all nodes are visited and
 		//BuildCollMesh called
 		RefCountedPtr<CollMesh> m_collMesh;
@@ -41,6 +43,9 @@ namespace SceneGraph {
 		std::vector<Uint32> m_indices;
 		std::vector<Uint32> m_flags;
 
+		//dynamic geoms get a tree each, built with the static one
+		std::vector<CollisionGeometry *> m_dynamicGeoms;
+
 		Uint32 m_totalTris;
 	};
 } // namespace SceneGraph
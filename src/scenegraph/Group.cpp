@@ -11,7 +11,8 @@
 namespace SceneGraph {
 
 	Group::Group(Graphics::Renderer *r) :
-		Node(r, NODE_SOLID | NODE_TRANSPARENT)
+		Node(r, NODE_SOLID | NODE_TRANSPARENT),
+		m_treeChanged(true)
 	{
 	}
 
@@ -23,7 +24,8 @@ namespace SceneGraph {
 	}
 
 	Group::Group(const Group &group, NodeCopyCache *cache) :
-		Node(group, cache)
+		Node(group, cache),
+		m_treeChanged(true)
 	{
 		for (std::vector<Node *>::const_iterator itr = group.m_children.begin();
 			 itr != group.m_children.end();
@@ -35,6 +37,8 @@ namespace SceneGraph {
 
 	Node *Group::Clone(NodeCopyCache *cache)
 	{
+		if (cache->IsShared(this))
+			return this;
 		return cache->Copy<Group>(this);
 	}
 
@@ -53,8 +57,12 @@ namespace SceneGraph {
 	void Group::AddChild(Node *child)
 	{
 		child->IncRefCount();
-		child->SetParent(this);
+		// a node shared between model instances keeps the parent it has in
+		// the model they were made from
+		if (!child->GetParent())
+			child->SetParent(this);
 		m_children.push_back(child);
+		MarkTreeChanged();
 	}
 
 	bool Group::RemoveChild(Node *node)
@@ -67,6 +75,7 @@ namespace SceneGraph {
 				itr = m_children.erase(itr);
 				node->SetParent(nullptr);
 				node->DecRefCount();
+				MarkTreeChanged();
 				return true;
 			}
 		}
@@ -80,6 +89,7 @@ namespace SceneGraph {
 		node->SetParent(nullptr);
 		node->DecRefCount();
 		m_children.erase(m_children.begin() + idx);
+		MarkTreeChanged();
 		return true;
 	}
 
@@ -102,6 +112,14 @@ namespace SceneGraph {
 		return result;
 	}
 
+	void Group::MarkTreeChanged()
+	{
+		Group *root = this;
+		while (root->GetParent())
+			root = root->GetParent();
+		root->m_treeChanged = true;
+	}
+
 	matrix4x4f Group::CalcGlobalTransform() const
 	{
 		return GetParent() ? GetParent()->CalcGlobalTransform() : matrix4x4fIdentity;
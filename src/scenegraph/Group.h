@@ -34,11 +34,20 @@ namespace SceneGraph {
 		// The result of this *should* be cached if the model has not changed
 		virtual matrix4x4f CalcGlobalTransform() const;
 
+		// Set on the root of a tree when nodes are added to or removed from
+		// it, so that anything built from the tree knows to rebuild
+		bool HasTreeChanged() const { return m_treeChanged; }
+		void ClearTreeChanged() { m_treeChanged = false; }
+
 	protected:
 		virtual ~Group();
+		void MarkTreeChanged();
 		virtual void RenderChildren(const matrix4x4f &trans, const RenderData *rd);
 		virtual void RenderChildren(const std::vector<matrix4x4f> &trans, const RenderData *rd);
 		std::vector<Node *> m_children;
+
+	private:
+		bool m_treeChanged;
 	};
 
 } // namespace SceneGraph
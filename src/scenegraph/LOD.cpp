@@ -3,6 +3,7 @@
 
 #include "LOD.h"
 #include "BaseLoader.h"
+#include "MathUtil.h"
 #include "NodeCopyCache.h"
 #include "NodeVisitor.h"
 #include "Serializer.h"
@@ -13,17 +14,34 @@
 
 namespace SceneGraph {
 
+	// how far past a threshold the size has to go to change the level
+	static const float HYSTERESIS = 0.1f;
+
+	static float s_detailBias = 1.f;
+
 	LOD::LOD(Graphics::Renderer *r) :
-		Group(r)
+		Group(r),
+		m_level(-1)
 	{
 	}
 
 	LOD::LOD(const LOD &lod, NodeCopyCache *cache) :
 		Group(lod, cache),
-		m_pixelSizes(lod.m_pixelSizes)
+		m_pixelSizes(lod.m_pixelSizes),
+		m_level(-1)
 	{
 	}
 
+	void LOD::SetDetailBias(float bias)
+	{
+		s_detailBias = bias;
+	}
+
+	float LOD::GetDetailBias()
+	{
+		return s_detailBias;
+	}
+
 	Node *LOD::Clone(NodeCopyCache *cache)
 	{
 		return cache->Copy<LOD>(this);
@@ -43,21 +61,45 @@ namespace SceneGraph {
 		AddChild(nod);
 	}
 
-	void LOD::Render(const matrix4x4f &trans, const RenderData *rd)
+	float LOD::GetPixelScale(const RenderData *rd) const
 	{
-		PROFILE_SCOPED()
 		//figure out approximate pixel size of object's bounding radius
-		//on screen and pick a child to render
-		const vector3f cameraPos(-trans[12], -trans[13], -trans[14]);
-		//fov is vertical, so using screen height
-		// FIXME: this should reference a camera object instead of querying the render height
-		const float pixrad = m_renderer->GetWindowHeight() * rd->boundingRadius / (cameraPos.Length() * Graphics::GetFovFactor());
-		if (m_pixelSizes.empty()) return;
+		//on screen, for the projection and viewport it is drawn with.
+		//proj[5] is 1 / tan(fov / 2), and the fov is vertical
+		const float halfHeight = 0.5f * m_renderer->GetViewport().h;
+		return s_detailBias * rd->boundingRadius * m_renderer->GetProjection()[5] * halfHeight;
+	}
+
+	unsigned int LOD::PickLevel(float pixrad) const
+	{
 		unsigned int lod = m_children.size() - 1;
 		for (unsigned int i = m_pixelSizes.size(); i > 0; i--) {
 			if (pixrad < m_pixelSizes[i - 1]) lod = i - 1;
 		}
-		m_children[lod]->Render(trans, rd);
+		return lod;
+	}
+
+	int LOD::SelectLevel(const matrix4x4f &trans, const RenderData *rd)
+	{
+		if (m_pixelSizes.empty()) return -1;
+		const float pixrad = GetPixelScale(rd) / trans.GetTranslate().Length();
+		if (m_level < 0 || m_level >= int(m_children.size())) {
+			m_level = PickLevel(pixrad);
+		} else {
+			//keep the last level unless it's out of the band around the size
+			const int lowest = PickLevel(pixrad * (1.f - HYSTERESIS));
+			const int highest = PickLevel(pixrad * (1.f + HYSTERESIS));
+			m_level = Clamp(m_level, lowest, highest);
+		}
+		return m_level;
+	}
+
+	void LOD::Render(const matrix4x4f &trans, const RenderData *rd)
+	{
+		PROFILE_SCOPED()
+		const int lod = SelectLevel(trans, rd);
+		if (lod >= 0)
+			m_children[lod]->Render(trans, rd);
 	}
 
 	void LOD::Render(const std::vector<matrix4x4f> &trans, const RenderData *rd)
@@ -79,22 +121,11 @@ namespace SceneGraph {
 				transform[i].reserve(tsize);
 			}
 
-			// seperate out the transformations
+			// seperate out the transformations; the instances are drawn
+			// in a different order every frame, so they get no hysteresis
+			const float pixelScale = GetPixelScale(rd);
 			for (auto mt : trans) {
-				//figure out approximate pixel size of object's bounding radius
-				//on screen and pick a child to render
-				const vector3f cameraPos(-mt[12], -mt[13], -mt[14]);
-				//fov is vertical, so using screen height
-				// FIXME: this should reference a camera object instead of querying the window height
-				const float pixrad = m_renderer->GetWindowHeight() * rd->boundingRadius / (cameraPos.Length() * Graphics::GetFovFactor());
-				unsigned int lod = m_children.size() - 1;
-				for (unsigned int i = m_pixelSizes.size(); i > 0; i--) {
-					if (pixrad < m_pixelSizes[i - 1]) {
-						lod = i - 1;
-					}
-				}
-
-				transform[lod].push_back(mt);
+				transform[PickLevel(pixelScale / mt.GetTranslate().Length())].push_back(mt);
 			}
 
 			// now render each of the buffers for each of the lods
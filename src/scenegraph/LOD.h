@@ -5,6 +5,12 @@
 #define _LOD_H
 /*
  * Level of detail switch node
+ *
+ * The level is picked by the radius of the model on screen, in pixels, so
+ * it follows the field of view and the resolution of what is drawn to. Once
+ * a level is picked, the size has to move a bit past the threshold before
+ * the level changes again, so a model sitting at a threshold doesn't keep
+ * switching.
  */
 #include "Group.h"
 
@@ -20,12 +26,24 @@ namespace SceneGraph {
 		virtual void Render(const matrix4x4f &trans, const RenderData *rd) override;
 		virtual void Render(const std::vector<matrix4x4f> &trans, const RenderData *rd) override;
 		void AddLevel(float pixelRadius, Node *child);
+		// The child to draw at the given transform, or -1 if there are none
+		int SelectLevel(const matrix4x4f &trans, const RenderData *rd);
+
+		// Multiplies the on-screen size levels are picked by: above 1 picks
+		// more detailed levels, below 1 less detailed ones
+		static void SetDetailBias(float bias);
+		static float GetDetailBias();
 		virtual void Save(NodeDatabase &) override;
 		static LOD *Load(NodeDatabase &);
 
 	protected:
 		virtual ~LOD() {}
+		// the radius on screen of the model at a distance of 1
+		float GetPixelScale(const RenderData *rd) const;
+		unsigned int PickLevel(float pixrad) const;
+
 		std::vector<unsigned int> m_pixelSizes; // same number as children
+		int m_level; // the level picked last time, -1 if none
 	};
 
 } // namespace SceneGraph
@@ -27,7 +27,6 @@ namespace SceneGraph {
 		rsd.depthWrite = false;
 		rsd.blendMode = Graphics::BLEND_ALPHA;
 
-		m_geometry.reset(font->CreateVertexArray());
 		m_material.Reset(r->CreateMaterial("label", matdesc, rsd));
 		m_material->SetTexture("texture0"_hash, font->GetTexture());
 		m_material->diffuse = Color::WHITE;
@@ -38,9 +37,9 @@ namespace SceneGraph {
 	Label3D::Label3D(const Label3D &label, NodeCopyCache *cache) :
 		Node(label, cache),
 		m_material(label.m_material),
+		m_run(label.m_run),
 		m_font(label.m_font)
 	{
-		m_geometry.reset(m_font->CreateVertexArray());
 	}
 
 	Node *Label3D::Clone(NodeCopyCache *cache)
@@ -50,32 +49,32 @@ namespace SceneGraph {
 
 	void Label3D::SetText(const std::string &text)
 	{
-		//regenerate geometry
-		m_geometry->Clear();
-		m_textMesh.reset();
+		m_run.reset();
 
 		if (!text.empty()) {
-			m_font->GetGeometry(*m_geometry, text, vector2f(0.f));
+			m_run = m_font->GetRun(text, vector2f(0.f));
 
 			// Happens if none of the characters in the string have glyphs in the SDF font.
 			// Most noticeably, this means text consisting of entirely Cyrillic
 			// or Chinese characters will vanish when rendered on a Label3D.
-			if (m_geometry->IsEmpty()) {
+			if (m_run->geometry->IsEmpty()) {
+				m_run.reset();
 				return;
 			}
 
-			//create buffer and upload data
-			m_textMesh.reset(m_renderer->CreateMeshObjectFromArray(m_geometry.get()));
+			//create buffer and upload data, once for all labels showing this text
+			if (!m_run->mesh)
+				m_run->mesh.reset(m_renderer->CreateMeshObjectFromArray(m_run->geometry.get()));
 		}
 	}
 
 	void Label3D::Render(const matrix4x4f &trans, const RenderData *rd)
 	{
 		PROFILE_SCOPED()
-		if (m_textMesh.get()) {
+		if (m_run) {
 			Graphics::Renderer *r = GetRenderer();
 			r->SetTransform(trans);
-			r->DrawMesh(m_textMesh.get(), m_material.Get());
+			r->DrawMesh(m_run->mesh.get(), m_material.Get());
 		}
 	}
 
@@ -32,8 +32,8 @@ namespace SceneGraph {
 
 	private:
 		RefCountedPtr<Graphics::Material> m_material;
-		std::unique_ptr<Graphics::VertexArray> m_geometry;
-		std::unique_ptr<Graphics::MeshObject> m_textMesh;
+		// shared with every label of the same font and text
+		std::shared_ptr<Text::DistanceFieldFont::GlyphRun> m_run;
 		RefCountedPtr<Text::DistanceFieldFont> m_font;
 	};
 
@@ -120,11 +120,102 @@ namespace {
 	private:
 		FileSystem::FileSource &m_fs;
 	};
+
+	bool same_time(const Time::DateTime &a, const Time::DateTime &b)
+	{
+		return (a - b).GetTotalMicroseconds() == 0;
+	}
 } // anonymous namespace
 
 namespace SceneGraph {
+	ImportCache::ImportCache()
+	{
+	}
+
+	ImportCache::~ImportCache()
+	{
+	}
+
+	void ImportCache::Clear()
+	{
+		m_sources.clear();
+		m_scenes.clear();
+		m_collMesh.Reset();
+	}
+
+	std::vector<ImportCache::Source> ImportCache::FindModifiedSources()
+	{
+		PROFILE_SCOPED()
+		// a mounted archive may have been replaced as well, and what is
+		// found in those is cached
+		FileSystem::gameDataFiles.ClearCache();
+
+		std::vector<Source> modified;
+		for (Source &source : m_sources) {
+			const FileSystem::FileInfo info = FileSystem::gameDataFiles.Lookup(source.path);
+			// editors may replace the file when saving, so wait until it's back
+			if (!info.Exists() || same_time(info.GetModificationTime(), source.modTime))
+				continue;
+			source.modTime = info.GetModificationTime();
+			modified.push_back(source);
+		}
+		return modified;
+	}
+
+	void ImportCache::BeginLoad(const std::string &definitionPath)
+	{
+		m_sources.clear();
+		for (auto &it : m_scenes)
+			it.second.used = false;
+		AddSource(definitionPath, SOURCE_DEFINITION);
+	}
+
+	void ImportCache::EndLoad(Model *model)
+	{
+		// drop the files the model doesn't use anymore
+		for (auto it = m_scenes.begin(); it != m_scenes.end();) {
+			if (it->second.used)
+				++it;
+			else
+				it = m_scenes.erase(it);
+		}
+		m_collMesh = model ? model->GetCollisionMesh() : RefCountedPtr<CollMesh>();
+	}
+
+	const ImportCache::Source &ImportCache::AddSource(const std::string &path, SourceType type)
+	{
+		for (const Source &source : m_sources) {
+			if (source.type == type && source.path == path)
+				return source;
+		}
+		const Time::DateTime modTime = FileSystem::gameDataFiles.Lookup(path).GetModificationTime();
+		m_sources.push_back({ path, type, modTime });
+		return m_sources.back();
+	}
+
+	const aiScene *ImportCache::Import(Assimp::Importer &importer, const std::string &path, unsigned int flags, SourceType type)
+	{
+		PROFILE_SCOPED()
+		const Time::DateTime modTime = AddSource(path, type).modTime;
+
+		CachedScene &cached = m_scenes[std::make_pair(path, flags)];
+		cached.used = true;
+		if (cached.scene && same_time(cached.modTime, modTime))
+			return cached.scene.get();
+
+		cached.scene.reset();
+		if (!importer.ReadFile(path, flags))
+			return nullptr;
+
+		// the cache takes the scene over from the importer
+		cached.scene.reset(importer.GetOrphanedScene());
+		cached.modTime = modTime;
+		return cached.scene.get();
+	}
+
 	Loader::Loader(Graphics::Renderer *r, bool logWarnings, bool loadSGMfiles) :
 		BaseLoader(r),
+		m_importCache(nullptr),
 		m_doLog(logWarnings),
 		m_loadSGMs(loadSGMfiles),
 		m_mostDetailedLod(false)
@@ -193,6 +284,9 @@ namespace SceneGraph {
 					if (m_curPath[m_curPath.length() - 1] == '/')
 						m_curPath = m_curPath.substr(0, m_curPath.length() - 1);
 
+					if (m_importCache)
+						m_importCache->BeginLoad(fpath);
+
 					Parser p(fileSource, fpath, m_curPath);
 					p.Parse(&modelDefinition);
 				} catch (ParseError &err) {
@@ -200,7 +294,10 @@ namespace SceneGraph {
 					throw LoadingError(err.what());
 				}
 				modelDefinition.name = shortname;
-				return CreateModel(modelDefinition);
+				Model *model = CreateModel(modelDefinition);
+				if (m_importCache)
+					m_importCache->EndLoad(model);
+				return model;
 			}
 		}
 		throw(LoadingError("File not found"));
@@ -225,6 +322,15 @@ namespace SceneGraph {
 			 it != def.matDefs.end(); ++it) {
 			if (it->use_pattern) patternsUsed = true;
 			ConvertMaterialDefinition(*it);
+
+			if (m_importCache) {
+				for (const std::string *tex : { &it->tex_diff, &it->tex_spec, &it->tex_glow, &it->tex_ambi }) {
+					if (!tex->empty())
+						m_importCache->AddSource(*tex, ImportCache::SOURCE_TEXTURE);
+				}
+				if (!it->tex_norm.empty())
+					m_importCache->AddSource(it->tex_norm, ImportCache::SOURCE_NORMAL_MAP);
+			}
 		}
 		//Output("Loaded %d materials\n", int(model->m_materials.size()));
 
@@ -306,7 +412,7 @@ namespace SceneGraph {
 		// Run CollisionVisitor to create the initial CM and its GeomTree.
 		// If no collision mesh is defined, a simple bounding box will be generated
 		Output("CreateCollisionMesh for : (%s)\n", m_model->m_name.c_str());
-		m_model->CreateCollisionMesh();
+		m_model->CreateCollisionMesh(m_importCache ? m_importCache->m_collMesh : RefCountedPtr<CollMesh>());
 
 		// Do an initial animation update to get all the animation transforms correct
 		m_model->InitAnimations();
@@ -350,7 +456,7 @@ namespace SceneGraph {
 		importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, AI_SLM_DEFAULT_MAX_VERTICES);
 
 		//There are several optimizations assimp can do, intentionally skipping them now
-		const aiScene *scene = importer.ReadFile(
+		const aiScene *scene = ReadScene(importer,
 			filename,
 			aiProcess_RemoveComponent |
 				aiProcess_Triangulate |
@@ -363,7 +469,8 @@ namespace SceneGraph {
 				aiProcess_ImproveCacheLocality |
 				aiProcess_LimitBoneWeights |
 				aiProcess_FindDegenerates |
-				aiProcess_FindInvalidData);
+				aiProcess_FindInvalidData,
+			ImportCache::SOURCE_MESH);
 
 		if (!scene) {
 			// Assimp 3.1.1 doesn't have aiGetVersionPatch(), add it back in at some point
@@ -962,12 +1069,12 @@ namespace SceneGraph {
 				aiComponent_TEXCOORDS |
 				aiComponent_NORMALS |
 				aiComponent_MATERIALS);
-		const aiScene *scene = importer.ReadFile(
+		const aiScene *scene = ReadScene(importer,
 			filename,
 			aiProcess_RemoveComponent |
 				aiProcess_Triangulate |
-				aiProcess_PreTransformVertices //"bake" transformations so we can disregard the structure
-		);
+				aiProcess_PreTransformVertices, //"bake" transformations so we can disregard the structure
+			ImportCache::SOURCE_COLLISION);
 
 		if (!scene)
 			throw LoadingError("Could not load file");
@@ -1006,6 +1113,13 @@ namespace SceneGraph {
 		m_model->GetRoot()->AddChild(new CollisionGeometry(m_renderer, vertices, indices, 0));
 	}
 
+	const aiScene *Loader::ReadScene(Assimp::Importer &importer, const std::string &filename, unsigned int flags, ImportCache::SourceType type)
+	{
+		if (m_importCache)
+			return m_importCache->Import(importer, filename, flags, type);
+		return importer.ReadFile(filename, flags);
+	}
+
 	unsigned int Loader::GetGeomFlagForNodeName(const std::string &nodename)
 	{
 		PROFILE_SCOPED()
@@ -8,8 +8,12 @@
  */
 #include "BaseLoader.h"
 #include "CollisionGeometry.h"
+#include "DateTime.h"
 #include "graphics/Material.h"
 
+#include <map>
+#include <memory>
+
 // Disable some GCC diagnostics errors.
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -27,12 +31,80 @@ struct aiMesh;
 struct aiScene;
 struct aiNodeAnim;
 
+namespace Assimp {
+	class Importer;
+}
+
 namespace SceneGraph {
 
+	// Keeps what went into the last model loaded with it, so the model can be
+	// loaded again after some of its files were edited without redoing the
+	// work for the rest: mesh files that haven't been modified since are not
+	// imported again, and the collision mesh is kept if the collision
+	// geometry is still the same. Textures come from the renderer's cache
+	// as usual. Meant for the editor, which reloads models as they change.
+	class ImportCache {
+	public:
+		enum SourceType : uint8_t {
+			SOURCE_DEFINITION, // the .model file
+			SOURCE_MESH,
+			SOURCE_COLLISION,
+			SOURCE_TEXTURE,
+			SOURCE_NORMAL_MAP
+		};
+
+		struct Source {
+			std::string path;
+			SourceType type;
+			Time::DateTime modTime;
+		};
+
+		ImportCache();
+		~ImportCache();
+
+		ImportCache(const ImportCache &) = delete;
+		ImportCache &operator=(const ImportCache &) = delete;
+
+		// Forget everything, so the next load starts from scratch
+		void Clear();
+
+		// Files of the last model loaded that were modified since they were
+		// loaded or returned from here last
+		std::vector<Source> FindModifiedSources();
+
+		// Watch a file in FileSystem::gameDataFiles; the Loader adds every
+		// file the model is built from
+		const Source &AddSource(const std::string &path, SourceType type);
+		const std::vector<Source> &GetSources() const { return m_sources; }
+
+	private:
+		friend class Loader;
+
+		struct CachedScene {
+			Time::DateTime modTime;
+			std::unique_ptr<aiScene> scene;
+			bool used;
+		};
+
+		void BeginLoad(const std::string &definitionPath);
+		void EndLoad(Model *model);
+		// Returns the scene imported from the file with these flags last
+		// time if the file hasn't been modified since, or imports it
+		const aiScene *Import(Assimp::Importer &importer, const std::string &path, unsigned int flags, SourceType type);
+
+		std::vector<Source> m_sources;
+		std::map<std::pair<std::string, unsigned int>, CachedScene> m_scenes;
+		RefCountedPtr<CollMesh> m_collMesh;
+	};
+
 	class Loader : public BaseLoader {
 	public:
 		Loader(Graphics::Renderer *r, bool logWarnings = false, bool loadSGMfiles = true);
 
+		// Load .model files through the cache (may be null). Binary models
+		// are always loaded in full.
+		void SetImportCache(ImportCache *cache) { m_importCache = cache; }
+
 		//find & attempt to load a model, based on filename (without path or .model suffix)
 		Model *LoadModel(const std::string &name);
 		Model *LoadModel(const std::string &name, const std::string &basepath);
@@ -49,6 +121,7 @@ namespace SceneGraph {
 			WAVEFRONT
 		};
 
+		ImportCache *m_importCache;
 		bool m_doLog;
 		bool m_loadSGMs;
 		bool m_mostDetailedLod;
@@ -73,6 +146,7 @@ namespace SceneGraph {
 		void CreateNavlight(const std::string &name, const matrix4x4f &nodeTrans);
 		RefCountedPtr<CollisionGeometry> CreateCollisionGeometry(RefCountedPtr<StaticGeometry>, unsigned int collFlag);
 		void LoadCollision(const std::string &filename);
+		const aiScene *ReadScene(Assimp::Importer &importer, const std::string &filename, unsigned int flags, ImportCache::SourceType type);
 
 		unsigned int GetGeomFlagForNodeName(const std::string &);
 	};
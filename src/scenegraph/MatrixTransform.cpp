@@ -25,6 +25,8 @@ namespace SceneGraph {
 
 	Node *MatrixTransform::Clone(NodeCopyCache *cache)
 	{
+		if (cache->IsShared(this))
+			return this;
 		return cache->Copy<MatrixTransform>(this);
 	}
 
@@ -3,6 +3,7 @@
 
 #include "Model.h"
 
+#include "CollisionGeometry.h"
 #include "CollisionVisitor.h"
 #include "FindNodeVisitor.h"
 #include "GameSaveError.h"
@@ -15,16 +16,22 @@
 #include "graphics/RenderState.h"
 #include "graphics/Renderer.h"
 #include "graphics/TextureBuilder.h"
+#include "graphics/TextureStreamer.h"
 #include "graphics/VertexArray.h"
 #include "matrix4x4.h"
 #include "scenegraph/Animation.h"
+#include "scenegraph/LOD.h"
 #include "scenegraph/Label3D.h"
 #include "scenegraph/MatrixTransform.h"
 #include "scenegraph/NodeVisitor.h"
+#include "scenegraph/RenderList.h"
 #include "scenegraph/StaticGeometry.h"
 #include "scenegraph/Tag.h"
 #include "utils.h"
 
+#include <limits>
+#include <set>
+
 namespace SceneGraph {
 
 	class LabelUpdateVisitor : public NodeVisitor {
@@ -37,6 +44,80 @@ namespace SceneGraph {
 		std::string label;
 	};
 
+	// Marks the subtrees instances can share with the model they are made
+	// from: the ones nothing changes per instance
+	class SharedNodeVisitor : public NodeVisitor {
+	public:
+		SharedNodeVisitor(NodeCopyCache &cache, const std::set<const MatrixTransform *> &animated) :
+			m_cache(cache),
+			m_animated(animated),
+			m_shared(false)
+		{}
+
+		virtual void ApplyGroup(Group &g) override { SetShared(g, VisitChildren(g)); }
+		virtual void ApplyMatrixTransform(MatrixTransform &m) override
+		{
+			const bool shared = VisitChildren(m);
+			// navlights are attached to these per instance
+			SetShared(m, shared && !m_animated.count(&m) && !starts_with(m.GetName(), "navlight_"));
+		}
+		// tags get models attached, and LODs remember the level they picked
+		virtual void ApplyTag(Tag &t) override
+		{
+			VisitChildren(t);
+			m_shared = false;
+		}
+		virtual void ApplyLOD(LOD &l) override
+		{
+			VisitChildren(l);
+			m_shared = false;
+		}
+
+		virtual void ApplyStaticGeometry(StaticGeometry &g) override { SetShared(g, true); }
+		// these share themselves already
+		virtual void ApplyThruster(Thruster &) override { m_shared = true; }
+		virtual void ApplyCollisionGeometry(CollisionGeometry &g) override { m_shared = !g.IsDynamic(); }
+		// labels, billboards, model nodes...
+		virtual void ApplyNode(Node &) override { m_shared = false; }
+
+		// the root of the tree is never shared
+		void VisitRoot(Group &root) { VisitChildren(root); }
+
+	private:
+		// true if all the children can be shared; groups without children
+		// are where things get attached
+		bool VisitChildren(Group &g)
+		{
+			bool shared = g.GetNumChildren() > 0;
+			for (unsigned int i = 0; i < g.GetNumChildren(); i++) {
+				g.GetChildAt(i)->Accept(*this);
+				shared = shared && m_shared;
+			}
+			return shared;
+		}
+
+		void SetShared(Node &n, bool shared)
+		{
+			m_shared = shared;
+			if (shared)
+				m_cache.SetShared(&n);
+		}
+
+		NodeCopyCache &m_cache;
+		const std::set<const MatrixTransform *> &m_animated;
+		bool m_shared;
+	};
+
+	static std::set<const MatrixTransform *> animated_nodes(const AnimationContainer &animations)
+	{
+		std::set<const MatrixTransform *> animated;
+		for (const Animation *anim : animations) {
+			for (const AnimationChannel &chan : anim->GetChannels())
+				animated.insert(chan.node);
+		}
+		return animated;
+	}
+
 	Model::Model(Graphics::Renderer *r, const std::string &name) :
 		m_boundingRadius(10.f),
 		m_renderer(r),
@@ -44,17 +125,19 @@ namespace SceneGraph {
 		m_activeAnimations(0),
 		m_curPatternIndex(0),
 		m_curPattern(0),
-		m_debugFlags(0)
+		m_debugFlags(0),
+		m_instanceCounter(new RefCounted())
 	{
 		m_root.Reset(new Group(m_renderer));
 		m_root->SetName(name);
 		ClearDecals();
 	}
 
-	Model::Model(const Model &model) :
+	Model::Model(const Model &model, bool shareNodes) :
 		DeleteEmitter(),
 		m_boundingRadius(model.m_boundingRadius),
 		m_materials(model.m_materials),
+		m_streamedTextures(model.m_streamedTextures),
 		m_patterns(model.m_patterns),
 		m_collMesh(model.m_collMesh), //might have to make this per-instance at some point
 		m_renderer(model.m_renderer),
@@ -62,10 +145,15 @@ namespace SceneGraph {
 		m_activeAnimations(0),
 		m_curPatternIndex(model.m_curPatternIndex),
 		m_curPattern(model.m_curPattern),
-		m_debugFlags(0)
+		m_debugFlags(0),
+		m_instanceCounter(model.m_instanceCounter)
 	{
 		//selective copying of node structure
 		NodeCopyCache cache;
+		if (shareNodes) {
+			SharedNodeVisitor shared(cache, animated_nodes(model.m_animations));
+			shared.VisitRoot(*model.m_root.Get());
+		}
 		m_root.Reset(dynamic_cast<Group *>(model.m_root->Clone(&cache)));
 
 		//materials are shared by meshes
@@ -88,14 +176,14 @@ namespace SceneGraph {
 		for (AnimationContainer::const_iterator it = model.m_animations.begin(); it != model.m_animations.end(); ++it) {
 			const Animation *anim = *it;
 			m_animations.push_back(new Animation(*anim));
-			m_animations.back()->UpdateChannelTargets(m_root.Get());
+			m_animations.back()->UpdateChannelTargets(cache);
 		}
 
 		//m_tags needs to be updated
-		for (const Tag *tag : model.m_tags) {
-			Node *node = m_root->FindNode(tag->GetName());
-			assert(node->GetNodeFlags() & NODE_TAG);
-			m_tags.push_back(static_cast<Tag *>(node));
+		for (Tag *tag : model.m_tags) {
+			Tag *copy = cache.GetCopy(tag);
+			assert(copy != tag && (copy->GetNodeFlags() & NODE_TAG));
+			m_tags.push_back(copy);
 		}
 
 		UpdateTagTransforms();
@@ -109,10 +197,15 @@ namespace SceneGraph {
 
 	Model *Model::MakeInstance() const
 	{
-		Model *m = new Model(*this);
+		Model *m = new Model(*this, true);
 		return m;
 	}
 
+	Model *Model::MakeUniqueInstance() const
+	{
+		return new Model(*this, false);
+	}
+
 	void Model::Render(const matrix4x4f &trans, const RenderData *rd)
 	{
 		PROFILE_SCOPED()
@@ -131,6 +224,8 @@ namespace SceneGraph {
 			if (m_decalMaterials[i])
 				m_decalMaterials[i]->SetTexture("texture0"_hash, m_curDecals[i]);
 
+		RequestTextureDetail(trans.GetTranslate().Length());
+
 		//Override renderdata if this model is called from ModelNode
 		RenderData params = (rd != 0) ? (*rd) : m_renderData;
 
@@ -144,13 +239,16 @@ namespace SceneGraph {
 		if (m_debugFlags & DEBUG_WIREFRAME)
 			m_renderer->SetWireFrameMode(true);
 
+		UpdateRenderList();
+		m_renderList->Prepare(trans, &params);
+
 		if (params.nodemask & MASK_IGNORE) {
-			m_root->Render(trans, &params);
+			m_renderList->Render(&params);
 		} else {
 			params.nodemask = NODE_SOLID;
-			m_root->Render(trans, &params);
+			m_renderList->Render(&params);
 			params.nodemask = NODE_TRANSPARENT;
-			m_root->Render(trans, &params);
+			m_renderList->Render(&params);
 		}
 
 		if (!m_debugFlags)
@@ -193,6 +291,14 @@ namespace SceneGraph {
 			if (m_decalMaterials[i])
 				m_decalMaterials[i]->SetTexture("texture0"_hash, m_curDecals[i]);
 
+		//the nearest instance needs the most detail
+		if (!m_streamedTextures.empty()) {
+			float distance = std::numeric_limits<float>::max();
+			for (const matrix4x4f &t : trans)
+				distance = std::min(distance, t.GetTranslate().Length());
+			RequestTextureDetail(distance);
+		}
+
 		//Override renderdata if this model is called from ModelNode
 		RenderData params = (rd != 0) ? (*rd) : m_renderData;
 
@@ -217,11 +323,41 @@ namespace SceneGraph {
 			m_renderer->SetWireFrameMode(false);
 	}
 
-	RefCountedPtr<CollMesh> Model::CreateCollisionMesh()
+	void Model::UpdateRenderList()
+	{
+		if (m_renderList && !m_root->HasTreeChanged())
+			return;
+
+		m_renderList.reset(new RenderList(m_root.Get(), animated_nodes(m_animations)));
+		m_root->ClearTreeChanged();
+	}
+
+	void Model::RequestTextureDetail(float distance) const
+	{
+		if (m_streamedTextures.empty())
+			return;
+
+		//the size of the bounding sphere on screen; assume the textures are
+		//spread over about that many pixels
+		float pixels = std::numeric_limits<float>::max();
+		const float radius = GetDrawClipRadius();
+		if (distance > radius) {
+			const matrix4x4f proj = m_renderer->GetProjection();
+			pixels = radius * proj[5] * float(m_renderer->GetViewport().h) / distance;
+		}
+
+		for (const auto &binding : m_streamedTextures) {
+			Graphics::Texture *texture = binding.first->GetTexture(binding.second);
+			if (texture)
+				Graphics::TextureStreamer::RequestSize(texture, pixels);
+		}
+	}
+
+	RefCountedPtr<CollMesh> Model::CreateCollisionMesh(const RefCountedPtr<CollMesh> &previous)
 	{
 		CollisionVisitor cv;
 		m_root->Accept(cv);
-		m_collMesh = cv.CreateCollisionMesh();
+		m_collMesh = cv.CreateCollisionMesh(previous);
 		m_boundingRadius = cv.GetBoundingRadius();
 		return m_collMesh;
 	}
@@ -362,22 +498,26 @@ namespace SceneGraph {
 
 	void Model::InitAnimations()
 	{
-		for (AnimationContainer::iterator anim = m_animations.begin(); anim != m_animations.end(); ++anim)
+		for (AnimationContainer::iterator anim = m_animations.begin(); anim != m_animations.end(); ++anim) {
+			(*anim)->Invalidate();
 			(*anim)->Interpolate();
+		}
 	}
 
 	void Model::UpdateAnimations()
 	{
+		// animations whose progress hasn't changed are skipped
+		bool changed = false;
 		for (size_t i = 0; i < m_animations.size(); i++) {
 			if (m_activeAnimations & (1 << i))
-				m_animations[i]->Interpolate();
+				changed |= m_animations[i]->Interpolate();
 		}
 
-		// Assume if we're ticking an active animation, our tags most likely need to be updated.
+		// Assume if an animation moved something, our tags most likely need to be updated.
 		// This can be optimized slightly by walking the node hierarchy and looking for a "dirty"
 		// flag to determine if the tag needs to be updated, but at current it's not a significant
 		// performance issue compared to animation interpolation.
-		if (m_activeAnimations)
+		if (changed)
 			UpdateTagTransforms();
 	}
 
@@ -43,6 +43,10 @@
  * Due to format & exporter limitations, animations need to be combined into one timeline
  * and then split into new animations using frame ranges.
  *
+ * Instances share the unanimated parts of the tree with the model they are
+ * made from; animated transforms, tags, LODs, labels and anything else that
+ * changes per instance is copied.
+ *
  * Attaching models to other models (guns etc. to ships): models may specify
  * named hardpoints, known as "tags" (term from Q3).
  * Users can query tags by name or index and create a ModelNode to wrap the sub model
@@ -54,9 +58,13 @@
  *  - 3D labels (well, 2D) on models
  *  - spaceship thrusters
  *
+ * Drawing a single model doesn't walk the tree: it is flattened into a
+ * RenderList on the first draw, with the unanimated transforms premultiplied,
+ * and flattened again whenever nodes are added or removed. Drawing instances
+ * still walks the tree.
+ *
  * Things to optimize:
  *  - model cache
- *  - removing unnecessary nodes from the scene graph: pre-translate unanimated meshes etc.
  */
 #include "CollMesh.h"
 #include "ColorMap.h"
@@ -74,6 +82,7 @@ namespace SceneGraph {
 	class BinaryConverter;
 	class MatrixTransform;
 	class ModelBinarizer;
+	class RenderList;
 	class Tag;
 
 	struct LoadingError : public std::runtime_error {
@@ -93,7 +102,14 @@ namespace SceneGraph {
 		Model(Graphics::Renderer *r, const std::string &name);
 		~Model();
 
+		// An instance shares the parts of the node tree that don't change
+		// per instance with this model; the shared nodes must not be changed
 		Model *MakeInstance() const;
+		// An instance with a copy of every node, for users that change the
+		// geometry, such as Shields
+		Model *MakeUniqueInstance() const;
+		// number of live instances made from this model or its instances
+		int GetNumInstances() const { return m_instanceCounter->GetRefCount() - 1; }
 
 		const std::string &GetName() const { return m_name; }
 
@@ -103,7 +119,8 @@ namespace SceneGraph {
 		void Render(const matrix4x4f &trans, const RenderData *rd = 0);				 //ModelNode can override RD
 		void Render(const std::vector<matrix4x4f> &trans, const RenderData *rd = 0); //ModelNode can override RD
 
-		RefCountedPtr<CollMesh> CreateCollisionMesh();
+		// reuses previous if it was made from the same collision geometry
+		RefCountedPtr<CollMesh> CreateCollisionMesh(const RefCountedPtr<CollMesh> &previous = RefCountedPtr<CollMesh>());
 		RefCountedPtr<CollMesh> GetCollisionMesh() const { return m_collMesh; }
 		void SetCollisionMesh(RefCountedPtr<CollMesh> collMesh) { m_collMesh.Reset(collMesh.Get()); }
 
@@ -182,13 +199,22 @@ namespace SceneGraph {
 		};
 		void SetDebugFlags(Uint32 flags);
 
+		// ask for the streamed textures to be sharp enough for the model to
+		// be drawn at the given distance from the camera; drawing does this
+		// itself, this is for asking ahead of time
+		void RequestTextureDetail(float distance) const;
+
 	private:
-		Model(const Model &);
+		Model(const Model &, bool shareNodes);
+
+		// flatten the tree again if it changed since the last draw
+		void UpdateRenderList();
 
 		static const unsigned int MAX_DECAL_MATERIALS = 4;
 		ColorMap m_colorMap;
 		float m_boundingRadius;
 		MaterialContainer m_materials; //materials are shared throughout the model graph
+		std::vector<std::pair<Graphics::Material *, size_t>> m_streamedTextures; //bindings of m_materials that may use streamed textures
 		PatternContainer m_patterns;
 		RefCountedPtr<CollMesh> m_collMesh;
 		RefCountedPtr<Graphics::Material> m_decalMaterials[MAX_DECAL_MATERIALS]; //spaceship insignia, advertising billboards
@@ -202,6 +228,7 @@ namespace SceneGraph {
 		std::vector<Tag *> m_tags;		 //named attachment points
 
 		RenderData m_renderData;
+		std::unique_ptr<RenderList> m_renderList;
 
 		//per-instance flavour data
 		unsigned int m_curPatternIndex;
@@ -211,6 +238,9 @@ namespace SceneGraph {
 		Uint32 m_debugFlags;
 		bool m_tagsDirty;
 
+		// shared by a model and all its instances, so its refcount counts them
+		RefCountedPtr<RefCounted> m_instanceCounter;
+
 		std::unique_ptr<Graphics::MeshObject> m_debugMesh;
 		std::unique_ptr<Graphics::Material> m_debugLineMat;
 	};
@@ -70,6 +70,8 @@ namespace SceneGraph {
 		Model *model;
 		std::vector<std::pair<std::string, RefCountedPtr<Graphics::Material>>> *materials;
 		BaseLoader *loader;
+		//save meshes in the smaller, quantised vertex format
+		bool quantiseVertices = false;
 	};
 
 	class Node : public RefCounted {
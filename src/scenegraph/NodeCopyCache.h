@@ -6,6 +6,7 @@
 
 #include "RefCounted.h"
 #include <map>
+#include <set>
 
 namespace SceneGraph {
 
@@ -16,20 +17,29 @@ namespace SceneGraph {
 		template <typename T>
 		T *Copy(const T *origNode)
 		{
-			const bool doCache = origNode->GetRefCount() > 1;
-			if (doCache) {
-				std::map<const Node *, Node *>::const_iterator i = m_cache.find(origNode);
-				if (i != m_cache.end())
-					return static_cast<T *>((*i).second);
-			}
+			std::map<const Node *, Node *>::const_iterator i = m_cache.find(origNode);
+			if (i != m_cache.end())
+				return static_cast<T *>((*i).second);
 			T *newNode = new T(*origNode, this);
-			if (doCache)
-				m_cache.insert(std::make_pair(origNode, newNode));
+			m_cache.insert(std::make_pair(origNode, newNode));
 			return newNode;
 		}
 
+		// The copy made of a node, or the node itself if it wasn't copied
+		template <typename T>
+		T *GetCopy(T *origNode) const
+		{
+			std::map<const Node *, Node *>::const_iterator i = m_cache.find(origNode);
+			return i != m_cache.end() ? static_cast<T *>((*i).second) : origNode;
+		}
+
+		// Shared nodes are not copied, the copied tree uses them as they are
+		void SetShared(const Node *node) { m_shared.insert(node); }
+		bool IsShared(const Node *node) const { return m_shared.count(node) > 0; }
+
 	private:
 		std::map<const Node *, Node *> m_cache;
+		std::set<const Node *> m_shared;
 	};
 
 } // namespace SceneGraph
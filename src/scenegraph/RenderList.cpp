@@ -0,0 +1,176 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "RenderList.h"
+
+#include "Group.h"
+#include "LOD.h"
+#include "MatrixTransform.h"
+#include "NodeVisitor.h"
+#include "profiler/Profiler.h"
+
+namespace SceneGraph {
+
+	// bit n is set if a node with this mask is drawn with nodemask n
+	static uint8_t mask_passes(unsigned int mask)
+	{
+		uint8_t passes = 0;
+		for (unsigned int nodemask = 1; nodemask < 8; nodemask++) {
+			if (mask & nodemask)
+				passes |= 1 << nodemask;
+		}
+		return passes;
+	}
+
+	// Walks the tree the same way Group::Render and its overrides do
+	class RenderList::Builder : public NodeVisitor {
+	public:
+		Builder(RenderList &list, const std::set<const MatrixTransform *> &animated) :
+			m_list(list),
+			m_animatedNodes(animated),
+			m_slot(0),
+			m_local(matrix4x4f::Identity()),
+			m_lod(NO_LOD),
+			m_lodLevel(-1),
+			m_passes(0xff),
+			m_checkMask(false) // the root is always drawn
+		{}
+
+		virtual void ApplyGroup(Group &g) override
+		{
+			const uint8_t passes = m_passes;
+			ApplyMask(g);
+			VisitChildren(g);
+			m_passes = passes;
+		}
+
+		virtual void ApplyMatrixTransform(MatrixTransform &m) override
+		{
+			const uint8_t passes = m_passes;
+			const uint32_t slot = m_slot;
+			const matrix4x4f local = m_local;
+			ApplyMask(m);
+
+			if (m_animatedNodes.count(&m)) {
+				m_list.m_animated.push_back({ &m, m_slot, m_local });
+				m_slot = m_list.m_animated.size() - 1;
+				m_local = matrix4x4f::Identity();
+			} else {
+				m_local = m_local * m.GetTransform();
+			}
+
+			VisitChildren(m);
+			m_passes = passes;
+			m_slot = slot;
+			m_local = local;
+		}
+
+		virtual void ApplyLOD(LOD &l) override
+		{
+			const uint8_t passes = m_passes;
+			const uint32_t lod = m_lod;
+			const int lodLevel = m_lodLevel;
+			ApplyMask(l);
+
+			m_list.m_lods.push_back({ &l, m_slot, m_local, m_lod, m_lodLevel, -1 });
+			m_lod = m_list.m_lods.size() - 1;
+			for (unsigned int i = 0; i < l.GetNumChildren(); i++) {
+				m_lodLevel = i;
+				m_checkMask = false;
+				l.GetChildAt(i)->Accept(*this);
+			}
+
+			m_passes = passes;
+			m_lod = lod;
+			m_lodLevel = lodLevel;
+		}
+
+		// nothing to draw
+		virtual void ApplyCollisionGeometry(CollisionGeometry &) override {}
+
+		// everything that isn't a group draws itself
+		virtual void ApplyNode(Node &n) override
+		{
+			m_list.m_entries.push_back({ &n, m_slot, m_local, m_lod, m_lodLevel, m_passes, m_checkMask });
+		}
+
+	private:
+		void ApplyMask(Node &n)
+		{
+			if (m_checkMask)
+				m_passes &= mask_passes(n.GetNodeMask());
+		}
+
+		void VisitChildren(Group &g)
+		{
+			for (unsigned int i = 0; i < g.GetNumChildren(); i++) {
+				m_checkMask = true;
+				g.GetChildAt(i)->Accept(*this);
+			}
+		}
+
+		RenderList &m_list;
+		const std::set<const MatrixTransform *> &m_animatedNodes;
+
+		uint32_t m_slot;
+		matrix4x4f m_local;
+		uint32_t m_lod;
+		int m_lodLevel;
+		uint8_t m_passes;
+		bool m_checkMask;
+	};
+
+	RenderList::RenderList(Group *root, const std::set<const MatrixTransform *> &animated)
+	{
+		PROFILE_SCOPED()
+		m_animated.push_back({ nullptr, 0, matrix4x4f::Identity() });
+
+		Builder builder(*this, animated);
+		root->Accept(builder);
+
+		m_slotTransforms.resize(m_animated.size());
+		m_transforms.resize(m_entries.size());
+		m_visible.resize(m_entries.size());
+	}
+
+	void RenderList::Prepare(const matrix4x4f &trans, const RenderData *rd)
+	{
+		PROFILE_SCOPED()
+		// parents always come before their children
+		m_slotTransforms[0] = trans;
+		for (size_t i = 1; i < m_animated.size(); i++) {
+			const AnimatedSlot &slot = m_animated[i];
+			m_slotTransforms[i] = m_slotTransforms[slot.parent] * (slot.local * slot.node->GetTransform());
+		}
+
+		for (LODEntry &lod : m_lods) {
+			if (lod.parentLod == NO_LOD || m_lods[lod.parentLod].level == lod.parentLevel)
+				lod.level = lod.node->SelectLevel(m_slotTransforms[lod.slot] * lod.local, rd);
+			else
+				lod.level = -1;
+		}
+
+		for (size_t i = 0; i < m_entries.size(); i++) {
+			const Entry &entry = m_entries[i];
+			m_visible[i] = entry.lod == NO_LOD || m_lods[entry.lod].level == entry.lodLevel;
+			if (m_visible[i])
+				m_transforms[i] = m_slotTransforms[entry.slot] * entry.local;
+		}
+	}
+
+	void RenderList::Render(const RenderData *rd)
+	{
+		PROFILE_SCOPED()
+		const unsigned int nodemask = rd->nodemask;
+		const uint8_t pass = 1 << (nodemask & 7);
+		for (size_t i = 0; i < m_entries.size(); i++) {
+			const Entry &entry = m_entries[i];
+			if (!m_visible[i] || !(entry.passes & pass))
+				continue;
+			if (entry.checkMask && !(entry.node->GetNodeMask() & nodemask))
+				continue;
+			entry.node->Render(m_transforms[i], rd);
+		}
+	}
+
+} // namespace SceneGraph
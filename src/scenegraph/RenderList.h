@@ -0,0 +1,94 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SCENEGRAPH_RENDERLIST_H
+#define _SCENEGRAPH_RENDERLIST_H
+/*
+ * A model's node tree flattened into the list of nodes it draws, in the
+ * order the tree draws them.
+ *
+ * Transforms that are never animated are multiplied together when the list
+ * is built, so drawing a node only takes the transform of its nearest
+ * animated ancestor times a precomputed local transform. The transforms of
+ * the animated nodes are recomputed every time the list is drawn.
+ *
+ * The masks of the groups are taken when the list is built; the masks of
+ * the nodes that draw are checked every time.
+ */
+#include "Node.h"
+#include "matrix4x4.h"
+
+#include <cstdint>
+#include <set>
+#include <vector>
+
+namespace SceneGraph {
+
+	class Group;
+	class LOD;
+	class MatrixTransform;
+
+	class RenderList {
+	public:
+		// Animated transforms are recomputed on every draw, all the others
+		// are folded into the nodes below them
+		RenderList(Group *root, const std::set<const MatrixTransform *> &animated);
+
+		// Update the transforms and the detail levels for a model drawn
+		// at trans; call this before drawing the passes
+		void Prepare(const matrix4x4f &trans, const RenderData *rd);
+		// Draw the nodes matching rd->nodemask with the last prepared transform
+		void Render(const RenderData *rd);
+
+		size_t GetNumNodes() const { return m_entries.size(); }
+		size_t GetNumAnimated() const { return m_animated.size() - 1; }
+
+	private:
+		class Builder;
+
+		static constexpr uint32_t NO_LOD = ~0u;
+
+		// an animated MatrixTransform: its transform is the one of the parent
+		// slot times the static transforms between them times its own
+		struct AnimatedSlot {
+			const MatrixTransform *node;
+			uint32_t parent;
+			matrix4x4f local;
+		};
+
+		struct LODEntry {
+			LOD *node;
+			uint32_t slot;
+			matrix4x4f local;
+			uint32_t parentLod;
+			int parentLevel;
+			// set by Prepare
+			int level;
+		};
+
+		struct Entry {
+			Node *node;
+			uint32_t slot;
+			matrix4x4f local;
+			uint32_t lod;
+			int lodLevel;
+			// bit n is set if every group above the node matches nodemask n
+			uint8_t passes;
+			// the children of a LOD are drawn without checking their mask
+			bool checkMask;
+		};
+
+		// index 0 is the model itself
+		std::vector<AnimatedSlot> m_animated;
+		std::vector<LODEntry> m_lods;
+		std::vector<Entry> m_entries;
+
+		// set by Prepare
+		std::vector<matrix4x4f> m_slotTransforms;
+		std::vector<matrix4x4f> m_transforms;
+		std::vector<bool> m_visible;
+	};
+
+} // namespace SceneGraph
+
+#endif
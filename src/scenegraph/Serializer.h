@@ -12,6 +12,8 @@
 #include <cstring>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #if (__GNUC__ && (__BYTE_ORDER_ == __ORDER_BIG_ENDIAN__)) || (__clang__ && __BIG_ENDIAN__)
 #error Serializer.h is incompatible with big-endian architectures!
@@ -86,6 +88,18 @@ namespace Serializer {
 				m_str.append(range.begin, range.Size());
 			}
 		}
+
+		// Write a whole array of plain-old-data values as a single blob
+		template <typename T>
+		void Array(const std::vector<T> &vec)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Serializer::Writer::Array requires trivially copyable types.");
+			if (vec.empty())
+				Blob(ByteRange());
+			else
+				Blob(ByteRange(reinterpret_cast<const char *>(vec.data()), vec.size() * sizeof(T)));
+		}
+
 		void Byte(Uint8 x) { *this << x; }
 		void Bool(bool x) { *this << x; }
 		void Int16(Uint16 x) { *this << x; }
@@ -193,6 +207,20 @@ namespace Serializer {
 			return range;
 		}
 
+		// Read an array written by Writer::Array with a single copy
+		template <typename T>
+		void Array(std::vector<T> &out)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Serializer::Reader::Array requires trivially copyable types.");
+			ByteRange range = Blob();
+			if (range.Size() % sizeof(T) != 0)
+				throw std::out_of_range("Serializer::Reader encountered a truncated array.");
+
+			out.resize(range.Size() / sizeof(T));
+			if (!out.empty())
+				std::memcpy(out.data(), range.begin, range.Size());
+		}
+
 		// Prefer using Reader::operator>> instead; these functions involve creating an unnessesary temporary variable.
 		bool Bool() { return obj<bool>(); }
 		Uint8 Byte() { return obj<Uint8>(); }
@@ -5,6 +5,7 @@
 
 #include "BaseLoader.h"
 #include "Model.h"
+#include "NodeCopyCache.h"
 #include "NodeVisitor.h"
 #include "Serializer.h"
 #include "graphics/Graphics.h"
@@ -15,8 +16,36 @@
 #include "scenegraph/BinaryConverter.h"
 #include "utils.h"
 
+#include <cstring>
+#include <vector>
+
 namespace SceneGraph {
 
+	// the vertex format of meshes in .sgm files. Quantised meshes keep float
+	// positions (collisions, shields and hit tests read them on the CPU) but
+	// store normals and tangents as normalized bytes and UVs as half floats,
+	// which the GL decodes for the shaders: 24 bytes a vertex instead of 44.
+	static Graphics::VertexBufferDesc sgm_vertex_desc(bool hasTangents, bool quantised, Uint32 numVertices)
+	{
+		// XXX evaluate whether we can use VertexBufferDesc::FromAttribSet here
+		const Graphics::VertexAttribFormat vectorFormat = quantised ? Graphics::ATTRIB_FORMAT_BYTE4_NORM : Graphics::ATTRIB_FORMAT_FLOAT3;
+		Graphics::VertexBufferDesc vbDesc;
+		vbDesc.attrib[0].semantic = Graphics::ATTRIB_POSITION;
+		vbDesc.attrib[0].format = Graphics::ATTRIB_FORMAT_FLOAT3;
+		vbDesc.attrib[1].semantic = Graphics::ATTRIB_NORMAL;
+		vbDesc.attrib[1].format = vectorFormat;
+		vbDesc.attrib[2].semantic = Graphics::ATTRIB_UV0;
+		vbDesc.attrib[2].format = quantised ? Graphics::ATTRIB_FORMAT_HALF2 : Graphics::ATTRIB_FORMAT_FLOAT2;
+		if (hasTangents) {
+			vbDesc.attrib[3].semantic = Graphics::ATTRIB_TANGENT;
+			vbDesc.attrib[3].format = vectorFormat;
+		}
+		vbDesc.usage = Graphics::BUFFER_USAGE_STATIC;
+		vbDesc.numVertices = numVertices;
+		vbDesc.CalculateOffsets();
+		return vbDesc;
+	}
+
 	StaticGeometry::StaticGeometry(Graphics::Renderer *r) :
 		Node(r, NODE_SOLID)
 	{
@@ -35,7 +64,10 @@ namespace SceneGraph {
 
 	Node *StaticGeometry::Clone(NodeCopyCache *cache)
 	{
-		return new StaticGeometry(*this, cache); // geometries cannot be shared if material overriding is supported. See Shields.cpp
+		// geometries cannot be shared if material overriding is supported. See Shields.cpp
+		if (cache->IsShared(this))
+			return this;
+		return new StaticGeometry(*this, cache);
 	}
 
 	void StaticGeometry::Accept(NodeVisitor &nv)
@@ -48,8 +80,11 @@ namespace SceneGraph {
 		PROFILE_SCOPED()
 		Graphics::Renderer *r = GetRenderer();
 		r->SetTransform(trans);
-		for (auto &it : m_meshes)
-			r->DrawMesh(it.meshObject.Get(), it.material.Get());
+		CreateInstanceMaterials();
+
+		// repeated draws of this geometry in a frame can be merged by the renderer
+		for (size_t i = 0; i < m_meshes.size(); i++)
+			r->DrawMeshBatched(m_meshes[i].meshObject.Get(), m_meshes[i].material.Get(), m_instanceMaterials[i].Get());
 
 		//DrawBoundingBox(m_boundingBox);
 	}
@@ -80,20 +115,7 @@ namespace SceneGraph {
 
 		// we'll set the transformation within the vertex shader so identity the global one
 		r->SetTransform(matrix4x4f::Identity());
-
-		if (m_instanceMaterials.empty()) {
-			// process each mesh
-			for (auto &it : m_meshes) {
-				// Due to the shader needing to change we have to get the material and force it to the instanced variant
-				Graphics::MaterialDescriptor mdesc = it.material->GetDescriptor();
-				mdesc.instanced = true;
-
-				const Graphics::RenderStateDesc oldDesc = r->GetMaterialRenderState(it.material.Get());
-				// create the "new" material with the instanced description
-				RefCountedPtr<Graphics::Material> mat(r->CloneMaterial(it.material.Get(), mdesc, oldDesc));
-				m_instanceMaterials.push_back(std::move(mat));
-			}
-		}
+		CreateInstanceMaterials();
 
 		// process each mesh
 		int i = 0;
@@ -104,6 +126,25 @@ namespace SceneGraph {
 		}
 	}
 
+	void StaticGeometry::CreateInstanceMaterials()
+	{
+		if (!m_instanceMaterials.empty())
+			return;
+
+		Graphics::Renderer *r = GetRenderer();
+		// process each mesh
+		for (auto &it : m_meshes) {
+			// Due to the shader needing to change we have to get the material and force it to the instanced variant
+			Graphics::MaterialDescriptor mdesc = it.material->GetDescriptor();
+			mdesc.instanced = true;
+
+			const Graphics::RenderStateDesc oldDesc = r->GetMaterialRenderState(it.material.Get());
+			// create the "new" material with the instanced description
+			RefCountedPtr<Graphics::Material> mat(r->CloneMaterial(it.material.Get(), mdesc, oldDesc));
+			m_instanceMaterials.push_back(std::move(mat));
+		}
+	}
+
 	typedef std::vector<std::pair<std::string, RefCountedPtr<Graphics::Material>>> MaterialContainer;
 	void StaticGeometry::Save(NodeDatabase &db)
 	{
@@ -130,39 +171,43 @@ namespace SceneGraph {
 			db.wr->Int32(attribCombo);
 
 			const bool hasTangents = (attribCombo & Graphics::ATTRIB_TANGENT);
-
-			//save positions, normals and uvs interleaved (only known format now)
-			const Uint32 posOffset = vbDesc.GetOffset(Graphics::ATTRIB_POSITION);
-			const Uint32 nrmOffset = vbDesc.GetOffset(Graphics::ATTRIB_NORMAL);
-			const Uint32 uv0Offset = vbDesc.GetOffset(Graphics::ATTRIB_UV0);
-			const Uint32 tanOffset = hasTangents ? vbDesc.GetOffset(Graphics::ATTRIB_TANGENT) : 0;
-			const Uint32 stride = vbDesc.stride;
-			db.wr->Int32(vbDesc.numVertices);
-			Uint8 *vtxPtr = mesh.vertexBuffer->Map<Uint8>(Graphics::BUFFER_MAP_READ);
-			if (hasTangents) {
-				for (Uint32 i = 0; i < vbDesc.numVertices; i++) {
-					db.wr->Vector3f(*reinterpret_cast<vector3f *>(vtxPtr + i * stride + posOffset));
-					db.wr->Vector3f(*reinterpret_cast<vector3f *>(vtxPtr + i * stride + nrmOffset));
-					db.wr->Float(reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset)->x);
-					db.wr->Float(reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset)->y);
-					db.wr->Vector3f(*reinterpret_cast<vector3f *>(vtxPtr + i * stride + tanOffset));
-				}
-			} else {
-				for (Uint32 i = 0; i < vbDesc.numVertices; i++) {
-					db.wr->Vector3f(*reinterpret_cast<vector3f *>(vtxPtr + i * stride + posOffset));
-					db.wr->Vector3f(*reinterpret_cast<vector3f *>(vtxPtr + i * stride + nrmOffset));
-					db.wr->Float(reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset)->x);
-					db.wr->Float(reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset)->y);
+			db.wr->Bool(db.quantiseVertices);
+
+			//save positions, normals and uvs interleaved (only known format now),
+			//in the layout the loader uploads as-is
+			const Graphics::VertexBufferDesc sgmDesc = sgm_vertex_desc(hasTangents, db.quantiseVertices, vbDesc.numVertices);
+			const Uint32 sgmStride = sgmDesc.stride;
+			std::vector<Uint8> vertices(size_t(vbDesc.numVertices) * sgmStride);
+			const Uint8 *vtxPtr = mesh.vertexBuffer->Map<Uint8>(Graphics::BUFFER_MAP_READ);
+			for (Uint32 a = 0; a < Graphics::MAX_ATTRIBS && sgmDesc.attrib[a].semantic != Graphics::ATTRIB_NONE; a++) {
+				const Graphics::VertexAttribDesc &attrib = sgmDesc.attrib[a];
+				const Uint8 *src = vtxPtr + vbDesc.GetOffset(attrib.semantic);
+				Graphics::VertexAttribFormat srcFormat = Graphics::ATTRIB_FORMAT_NONE;
+				for (Uint32 b = 0; b < Graphics::MAX_ATTRIBS; b++)
+					if (vbDesc.attrib[b].semantic == attrib.semantic)
+						srcFormat = vbDesc.attrib[b].format;
+
+				if (srcFormat == attrib.format) {
+					for (Uint32 i = 0; i < vbDesc.numVertices; i++)
+						memcpy(&vertices[i * sgmStride + attrib.offset], src + i * vbDesc.stride,
+							Graphics::VertexBufferDesc::GetAttribSize(attrib.format));
+				} else {
+					float value[4];
+					for (Uint32 i = 0; i < vbDesc.numVertices; i++) {
+						Graphics::VertexBufferDesc::DecodeAttrib(srcFormat, src + i * vbDesc.stride, value);
+						Graphics::VertexBufferDesc::EncodeAttrib(attrib.format, value, &vertices[i * sgmStride + attrib.offset]);
+					}
 				}
 			}
 			mesh.vertexBuffer->Unmap();
 
+			db.wr->Int32(vbDesc.numVertices);
+			db.wr->Blob(ByteRange(reinterpret_cast<const char *>(vertices.data()), vertices.size()));
+
 			//indices
 			const Uint32 *indexPtr = mesh.indexBuffer->Map(Graphics::BUFFER_MAP_READ);
 			const Uint32 numIndices = mesh.indexBuffer->GetSize();
-			db.wr->Int32(numIndices);
-			for (Uint32 i = 0; i < numIndices; i++)
-				db.wr->Int32(indexPtr[i]);
+			db.wr->Blob(ByteRange(reinterpret_cast<const char *>(indexPtr), numIndices * sizeof(Uint32)));
 			mesh.indexBuffer->Unmap();
 		}
 	}
@@ -197,57 +242,24 @@ namespace SceneGraph {
 			}
 
 			const bool hasTangents = (vtxFormat & Graphics::ATTRIB_TANGENT);
+			const bool quantised = db.rd->Bool();
 
-			//vertex buffer
-			// XXX evaluate whether we can use VertexBufferDesc::FromAttribSet here
-			Graphics::VertexBufferDesc vbDesc;
-			vbDesc.attrib[0].semantic = Graphics::ATTRIB_POSITION;
-			vbDesc.attrib[0].format = Graphics::ATTRIB_FORMAT_FLOAT3;
-			vbDesc.attrib[1].semantic = Graphics::ATTRIB_NORMAL;
-			vbDesc.attrib[1].format = Graphics::ATTRIB_FORMAT_FLOAT3;
-			vbDesc.attrib[2].semantic = Graphics::ATTRIB_UV0;
-			vbDesc.attrib[2].format = Graphics::ATTRIB_FORMAT_FLOAT2;
-			if (hasTangents) {
-				vbDesc.attrib[3].semantic = Graphics::ATTRIB_TANGENT;
-				vbDesc.attrib[3].format = Graphics::ATTRIB_FORMAT_FLOAT3;
-			}
-			vbDesc.usage = Graphics::BUFFER_USAGE_STATIC;
-			vbDesc.numVertices = db.rd->Int32();
-
-			RefCountedPtr<Graphics::VertexBuffer> vtxBuffer(db.loader->GetRenderer()->CreateVertexBuffer(vbDesc));
-			const Uint32 posOffset = vtxBuffer->GetDesc().GetOffset(Graphics::ATTRIB_POSITION);
-			const Uint32 nrmOffset = vtxBuffer->GetDesc().GetOffset(Graphics::ATTRIB_NORMAL);
-			const Uint32 uv0Offset = vtxBuffer->GetDesc().GetOffset(Graphics::ATTRIB_UV0);
-			const Uint32 tanOffset = hasTangents ? vtxBuffer->GetDesc().GetOffset(Graphics::ATTRIB_TANGENT) : 0;
-			const Uint32 stride = vtxBuffer->GetDesc().stride;
-			Uint8 *vtxPtr = vtxBuffer->Map<Uint8>(BUFFER_MAP_WRITE);
-			if (hasTangents) {
-				for (Uint32 i = 0; i < vbDesc.numVertices; i++) {
-					*reinterpret_cast<vector3f *>(vtxPtr + i * stride + posOffset) = db.rd->Vector3f();
-					*reinterpret_cast<vector3f *>(vtxPtr + i * stride + nrmOffset) = db.rd->Vector3f();
-					const float uvx = db.rd->Float();
-					const float uvy = db.rd->Float();
-					*reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset) = vector2f(uvx, uvy);
-					*reinterpret_cast<vector3f *>(vtxPtr + i * stride + tanOffset) = db.rd->Vector3f();
-				}
-			} else {
-				for (Uint32 i = 0; i < vbDesc.numVertices; i++) {
-					*reinterpret_cast<vector3f *>(vtxPtr + i * stride + posOffset) = db.rd->Vector3f();
-					*reinterpret_cast<vector3f *>(vtxPtr + i * stride + nrmOffset) = db.rd->Vector3f();
-					const float uvx = db.rd->Float();
-					const float uvy = db.rd->Float();
-					*reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset) = vector2f(uvx, uvy);
-				}
-			}
-			vtxBuffer->Unmap();
+			//vertex buffer, uploaded straight from the file data
+			const Uint32 numVertices = db.rd->Int32();
+			const Graphics::VertexBufferDesc vbDesc = sgm_vertex_desc(hasTangents, quantised, numVertices);
+			const ByteRange vertices = db.rd->Blob();
+			if (vertices.Size() != size_t(numVertices) * vbDesc.stride)
+				throw LoadingError("Vertex data doesn't match the vertex format");
+
+			RefCountedPtr<Graphics::VertexBuffer> vtxBuffer(db.loader->GetRenderer()->CreateVertexBuffer(vbDesc, vertices.begin));
 
 			//index buffer
-			const Uint32 numIndices = db.rd->Int32();
-			RefCountedPtr<Graphics::IndexBuffer> idxBuffer(db.loader->GetRenderer()->CreateIndexBuffer(numIndices, Graphics::BUFFER_USAGE_STATIC));
-			Uint32 *idxPtr = idxBuffer->Map(BUFFER_MAP_WRITE);
-			for (Uint32 i = 0; i < numIndices; i++)
-				idxPtr[i] = db.rd->Int32();
-			idxBuffer->Unmap();
+			const ByteRange indices = db.rd->Blob();
+			if (indices.Size() % sizeof(Uint32) != 0)
+				throw LoadingError("Truncated index data");
+
+			const Uint32 numIndices = indices.Size() / sizeof(Uint32);
+			RefCountedPtr<Graphics::IndexBuffer> idxBuffer(db.loader->GetRenderer()->CreateIndexBuffer(numIndices, Graphics::BUFFER_USAGE_STATIC, Graphics::INDEX_BUFFER_32BIT, indices.begin));
 
 			sg->AddMesh(vtxBuffer, idxBuffer, material);
 		}
@@ -265,10 +277,13 @@ namespace SceneGraph {
 		m.material = mat;
 		m.meshObject.Reset(m_renderer->CreateMeshObject(vb.Get(), ib.Get()));
 		m_meshes.push_back(m);
+		m_instanceMaterials.clear();
 	}
 
 	StaticGeometry::Mesh &StaticGeometry::GetMeshAt(unsigned int i)
 	{
+		// the caller may replace the mesh's material
+		m_instanceMaterials.clear();
 		return m_meshes.at(i);
 	}
 
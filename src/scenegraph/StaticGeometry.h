@@ -45,6 +45,8 @@ namespace SceneGraph {
 
 	protected:
 		~StaticGeometry();
+		void CreateInstanceMaterials();
+
 		std::vector<Mesh> m_meshes;
 		std::vector<RefCountedPtr<Graphics::Material>> m_instanceMaterials;
 		RefCountedPtr<Graphics::InstanceBuffer> m_instBuffer;
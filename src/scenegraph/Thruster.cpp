@@ -15,15 +15,46 @@
 #include "graphics/VertexBuffer.h"
 #include "profiler/Profiler.h"
 
+#include <algorithm>
+
 namespace SceneGraph {
 
 	RefCountedPtr<Graphics::MeshObject> Thruster::s_thrustMesh;
 	RefCountedPtr<Graphics::MeshObject> Thruster::s_glowMesh;
+	RefCountedPtr<Graphics::Material> Thruster::s_tMat;
+	RefCountedPtr<Graphics::Material> Thruster::s_glowMat;
+	RefCountedPtr<Graphics::Material> Thruster::s_tInstMat;
+	RefCountedPtr<Graphics::Material> Thruster::s_glowInstMat;
+
+	bool Thruster::s_batching = false;
+	std::vector<Thruster::BatchEntry> Thruster::s_batch;
 
 	static const std::string thrusterTextureFilename("textures/thruster.dds");
 	static const std::string thrusterGlowTextureFilename("textures/halo.dds");
 	static Color baseColor(178, 153, 255, 255);
 
+	// number of steps the power and the directional fade are rounded to
+	// while batching
+	static constexpr float BATCH_LEVELS = 32.f;
+
+	static float quantize(float v)
+	{
+		return std::round(v * BATCH_LEVELS) / BATCH_LEVELS;
+	}
+
+	static uint32_t color_key(const Color &c)
+	{
+		return uint32_t(c.r) << 24 | uint32_t(c.g) << 16 | uint32_t(c.b) << 8 | c.a;
+	}
+
+	// the instanced variant of a material, for the renderer to merge draws with
+	static Graphics::Material *instanced_material(Graphics::Renderer *r, Graphics::Material *mat)
+	{
+		Graphics::MaterialDescriptor mdesc = mat->GetDescriptor();
+		mdesc.instanced = true;
+		return r->CloneMaterial(mat, mdesc, r->GetMaterialRenderState(mat));
+	}
+
 	Thruster::Thruster(Graphics::Renderer *r, bool _linear, const vector3f &_pos, const vector3f &_dir) :
 		Node(r, NODE_TRANSPARENT),
 		linearOnly(_linear),
@@ -31,31 +62,10 @@ namespace SceneGraph {
 		pos(_pos),
 		currentColor(baseColor)
 	{
-		//set up materials
-		Graphics::MaterialDescriptor desc;
-		desc.textures = 1;
-
-		// glow render state
-		Graphics::RenderStateDesc rsd;
-		rsd.blendMode = Graphics::BLEND_ALPHA_ONE;
-		rsd.depthWrite = false;
-		rsd.cullMode = Graphics::CULL_NONE;
-
-		m_tMat.Reset(r->CreateMaterial("unlit", desc, rsd));
-		m_tMat->SetTexture("texture0"_hash,
-			Graphics::TextureBuilder::Billboard(thrusterTextureFilename).GetOrCreateTexture(r, "billboard"));
-		m_tMat->diffuse = baseColor;
-
-		m_glowMat.Reset(r->CreateMaterial("unlit", desc, rsd));
-		m_glowMat->SetTexture("texture0"_hash,
-			Graphics::TextureBuilder::Billboard(thrusterGlowTextureFilename).GetOrCreateTexture(r, "billboard"));
-		m_glowMat->diffuse = baseColor;
 	}
 
 	Thruster::Thruster(const Thruster &thruster, NodeCopyCache *cache) :
 		Node(thruster, cache),
-		m_tMat(thruster.m_tMat),
-		m_glowMat(thruster.m_glowMat),
 		linearOnly(thruster.linearOnly),
 		dir(thruster.dir),
 		pos(thruster.pos),
@@ -101,22 +111,79 @@ namespace SceneGraph {
 		}
 		if (power < 0.001f) return;
 
-		m_tMat->diffuse = m_glowMat->diffuse = currentColor * power;
-
 		//directional fade
 		vector3f cdir = vector3f(trans * -dir).Normalized();
 		vector3f vdir = vector3f(trans[2], trans[6], -trans[10]).Normalized();
 		// XXX check this for transition to new colors.
-		m_glowMat->diffuse.a = Easing::Circ::EaseIn(Clamp(vdir.Dot(cdir), 0.f, 1.f), 0.f, 1.f, 1.f) * 255;
-		m_tMat->diffuse.a = 255 - m_glowMat->diffuse.a;
+		float fade = Easing::Circ::EaseIn(Clamp(vdir.Dot(cdir), 0.f, 1.f), 0.f, 1.f, 1.f);
+
+		if (s_batching) {
+			power = quantize(power);
+			fade = quantize(fade);
+		}
+
+		Color thrustColor = currentColor * power;
+		Color glowColor = thrustColor;
+		glowColor.a = fade * 255;
+		thrustColor.a = 255 - glowColor.a;
+
+		if (s_batching) {
+			s_batch.push_back({ trans, thrustColor, glowColor });
+			return;
+		}
 
 		Graphics::Renderer *r = GetRenderer();
 		if (!s_thrustMesh.Valid())
 			CreateThrusterGeometry(r);
 
+		s_tMat->diffuse = thrustColor;
+		s_glowMat->diffuse = glowColor;
+
 		r->SetTransform(trans);
-		r->DrawMesh(s_thrustMesh.Get(), m_tMat.Get());
-		r->DrawMesh(s_glowMesh.Get(), m_glowMat.Get());
+		r->DrawMesh(s_thrustMesh.Get(), s_tMat.Get());
+		r->DrawMesh(s_glowMesh.Get(), s_glowMat.Get());
+	}
+
+	void Thruster::BeginBatch()
+	{
+		s_batching = true;
+		s_batch.clear();
+	}
+
+	void Thruster::EndBatch(Graphics::Renderer *r)
+	{
+		PROFILE_SCOPED()
+		s_batching = false;
+		if (s_batch.empty())
+			return;
+
+		if (!s_thrustMesh.Valid())
+			CreateThrusterGeometry(r);
+
+		Graphics::Renderer::MatrixTicket ticket(r);
+
+		// the thrusters blend additively without writing depth, so they can
+		// be drawn in any order: draw the flames and then the glows, each
+		// sorted by colour so the draws of the same colour are consecutive
+		std::sort(s_batch.begin(), s_batch.end(), [](const BatchEntry &a, const BatchEntry &b) {
+			return color_key(a.thrustColor) < color_key(b.thrustColor);
+		});
+		for (const BatchEntry &entry : s_batch) {
+			s_tMat->diffuse = entry.thrustColor;
+			r->SetTransform(entry.trans);
+			r->DrawMeshBatched(s_thrustMesh.Get(), s_tMat.Get(), s_tInstMat.Get());
+		}
+
+		std::sort(s_batch.begin(), s_batch.end(), [](const BatchEntry &a, const BatchEntry &b) {
+			return color_key(a.glowColor) < color_key(b.glowColor);
+		});
+		for (const BatchEntry &entry : s_batch) {
+			s_glowMat->diffuse = entry.glowColor;
+			r->SetTransform(entry.trans);
+			r->DrawMeshBatched(s_glowMesh.Get(), s_glowMat.Get(), s_glowInstMat.Get());
+		}
+
+		s_batch.clear();
 	}
 
 	void Thruster::Save(NodeDatabase &db)
@@ -211,6 +278,28 @@ namespace SceneGraph {
 
 		//create buffer and upload data
 		s_glowMesh.Reset(r->CreateMeshObjectFromArray(&verts));
+
+		//set up materials
+		Graphics::MaterialDescriptor desc;
+		desc.textures = 1;
+
+		// glow render state
+		Graphics::RenderStateDesc rsd;
+		rsd.blendMode = Graphics::BLEND_ALPHA_ONE;
+		rsd.depthWrite = false;
+		rsd.cullMode = Graphics::CULL_NONE;
+
+		s_tMat.Reset(r->CreateMaterial("unlit", desc, rsd));
+		s_tMat->SetTexture("texture0"_hash,
+			Graphics::TextureBuilder::Billboard(thrusterTextureFilename).GetOrCreateTexture(r, "billboard"));
+		s_tMat->diffuse = baseColor;
+		s_tInstMat.Reset(instanced_material(r, s_tMat.Get()));
+
+		s_glowMat.Reset(r->CreateMaterial("unlit", desc, rsd));
+		s_glowMat->SetTexture("texture0"_hash,
+			Graphics::TextureBuilder::Billboard(thrusterGlowTextureFilename).GetOrCreateTexture(r, "billboard"));
+		s_glowMat->diffuse = baseColor;
+		s_glowInstMat.Reset(instanced_material(r, s_glowMat.Get()));
 	}
 
 } // namespace SceneGraph
@@ -5,9 +5,18 @@
 #define _SCENEGRAPH_THRUSTER_H
 /*
  * Spaceship thruster
+ *
+ * Between BeginBatch and EndBatch thrusters are queued instead of drawn.
+ * EndBatch draws the queue sorted by colour, so the renderer can merge the
+ * draws of the same colour into instanced draws. The colours are rounded
+ * to a few levels while batching to make that likely.
  */
 
+#include "Color.h"
 #include "Node.h"
+#include "matrix4x4.h"
+
+#include <vector>
 
 namespace Graphics {
 	class Renderer;
@@ -31,15 +40,32 @@ namespace SceneGraph {
 		void SetColor(const Color c) { currentColor = c; }
 		const vector3f &GetDirection() { return dir; }
 
+		// Queue the thrusters drawn from now on
+		static void BeginBatch();
+		// Draw the queued thrusters with the renderer's current view
+		static void EndBatch(Graphics::Renderer *);
+
 	private:
-		// thruster geometry is shared between all instances of Thruster
+		struct BatchEntry {
+			matrix4x4f trans;
+			Color thrustColor;
+			Color glowColor;
+		};
+
+		// thruster geometry and materials are shared between all instances
+		// of Thruster, the material colours are set for every draw
 		// TODO: load this as a model to allow customization
 		static void CreateThrusterGeometry(Graphics::Renderer *);
 		static RefCountedPtr<Graphics::MeshObject> s_thrustMesh;
 		static RefCountedPtr<Graphics::MeshObject> s_glowMesh;
+		static RefCountedPtr<Graphics::Material> s_tMat;
+		static RefCountedPtr<Graphics::Material> s_glowMat;
+		static RefCountedPtr<Graphics::Material> s_tInstMat;
+		static RefCountedPtr<Graphics::Material> s_glowInstMat;
+
+		static bool s_batching;
+		static std::vector<BatchEntry> s_batch;
 
-		RefCountedPtr<Graphics::Material> m_tMat;
-		RefCountedPtr<Graphics::Material> m_glowMat;
 		bool linearOnly;
 		vector3f dir;
 		vector3f pos;
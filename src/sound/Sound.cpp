@@ -6,6 +6,7 @@
  */
 
 #include "Sound.h"
+#include "SoundMix.h"
 #include "Body.h"
 #include "FileSystem.h"
 #include "JobQueue.h"
@@ -18,17 +19,24 @@
 #include <SDL.h>
 #include <vorbis/vorbisfile.h>
 
+#include <atomic>
 #include <cassert>
 #include <cerrno>
+#include <condition_variable>
 #include <cstdio>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace Sound {
 
 	static const unsigned int FREQ = 44100;
 	static const unsigned int BUF_SIZE = 4096;
-	static const unsigned int MAX_WAVSTREAMS = 10; //first two are for music
+	static const unsigned int MAX_WAVSTREAMS = 16; //first two are for music
+	// sound effects made quieter than this by distance aren't played at all
+	static const float MIN_AUDIBLE_VOLUME = 1.0f / 4096.0f;
 	static const double STREAM_IF_LONGER_THAN = 10.0;
 
 	static SDL_AudioDeviceID m_audioDevice = 0;
@@ -126,17 +134,18 @@ namespace Sound {
 		&OggFileDataStream::ov_callback_tell
 	};
 
-	static float m_masterVol = 1.0f;
+	// read by the mixer for every buffer it fills
+	static std::atomic<float> m_masterVol{ 1.0f };
 	static float m_sfxVol = 1.0f;
 
 	void SetMasterVolume(const float vol)
 	{
-		m_masterVol = vol;
+		m_masterVol.store(vol, std::memory_order_relaxed);
 	}
 
 	float GetMasterVolume()
 	{
-		return m_masterVol;
+		return m_masterVol.load(std::memory_order_relaxed);
 	}
 
 	void SetSfxVolume(const float vol)
@@ -176,13 +185,14 @@ namespace Sound {
 	{
 		float vl, vr;
 		CalculateStereo(b, vol, &vl, &vr);
+		if (std::max(vl, vr) * GetSfxVolume() < MIN_AUDIBLE_VOLUME)
+			return 0;
 		return Sound::PlaySfx(sfx, vl, vr, 0);
 	}
 
 	struct SoundEvent {
 		const Sample *sample;
-		OggVorbis_File *oggv; // if sample->buf = 0 then stream this
-		OggFileDataStream ogg_data_stream;
+		const Uint16 *buf; // the decoded sample when started, or 0 to stream it
 		Uint32 buf_pos;
 		float volume[2]; // left and right channels
 		eventid identifier;
@@ -193,6 +203,210 @@ namespace Sound {
 		bool ascend[2];
 	};
 
+	/*
+	 * Streamed samples (music and long effects) are decoded ahead of the
+	 * mixer by a worker thread, into a ring of PCM per wavstream, so that
+	 * neither reading the file nor decoding it happens in the audio callback.
+	 * The mixer says which event it wants decoded in each stream and takes
+	 * what's ready; if the ring runs dry the rest of the buffer stays silent
+	 * and an underrun is counted.
+	 */
+	class StreamDecoder {
+	public:
+		// a bit under a second of 44.1kHz stereo
+		static constexpr Uint32 RING_SIZE = 1 << 16;
+
+		StreamDecoder() :
+			m_ring(new Sint16[RING_SIZE])
+		{}
+
+		// mixer: decode the sample for this event from the start; 0 stops
+		void Start(eventid id, const Sample *sample, bool repeat)
+		{
+			m_repeat.store(repeat, std::memory_order_relaxed);
+			m_wantedSample.store(sample, std::memory_order_relaxed);
+			m_wanted.store(id, std::memory_order_release);
+		}
+		void Stop() { m_wanted.store(0, std::memory_order_release); }
+		void SetRepeat(bool repeat) { m_repeat.store(repeat, std::memory_order_relaxed); }
+
+		// mixer: whether the ring is filled for this event
+		bool IsReady(eventid id) const { return id && m_ready.load(std::memory_order_acquire) == id; }
+		// mixer: no more samples will come after the ones in the ring
+		bool IsFinished() const { return m_finished.load(std::memory_order_acquire); }
+
+		// mixer: copy up to count samples out of the ring; returns how many
+		Uint32 Read(Sint16 *out, Uint32 count)
+		{
+			const Uint32 read = m_readPos.load(std::memory_order_relaxed);
+			count = std::min(count, m_writePos.load(std::memory_order_acquire) - read);
+			const Uint32 start = read & (RING_SIZE - 1);
+			const Uint32 first = std::min(count, RING_SIZE - start);
+			memcpy(out, &m_ring[start], first * sizeof(Sint16));
+			memcpy(out + first, &m_ring[0], (count - first) * sizeof(Sint16));
+			m_readPos.store(read + count, std::memory_order_release);
+			return count;
+		}
+
+		// decoder thread: follow the mixer's requests and top up the ring;
+		// returns whether there is more decoding to do right away
+		bool Update();
+
+		// decoder thread, or once it is stopped
+		void Close();
+
+	private:
+		bool Open(eventid id, const Sample *sample);
+
+		// requested by the mixer
+		std::atomic<eventid> m_wanted{ 0 };
+		std::atomic<const Sample *> m_wantedSample{ nullptr };
+		std::atomic<bool> m_repeat{ false };
+
+		// published by the decoder
+		std::atomic<eventid> m_ready{ 0 };
+		std::atomic<bool> m_finished{ false };
+
+		std::unique_ptr<Sint16[]> m_ring;
+		std::atomic<Uint32> m_readPos{ 0 };
+		std::atomic<Uint32> m_writePos{ 0 };
+
+		// decoder thread only
+		eventid m_current = 0;
+		bool m_open = false;
+		OggVorbis_File m_oggv;
+		OggFileDataStream m_dataStream;
+	};
+
+	bool StreamDecoder::Open(eventid id, const Sample *sample)
+	{
+		RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(sample->path);
+		if (!oggdata) {
+			Output("Could not open '%s'\n", sample->path.c_str());
+			return false;
+		}
+		m_dataStream.Reset(oggdata);
+		if (ov_open_callbacks(&m_dataStream, &m_oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
+			Output("Vorbis could not understand '%s'\n", sample->path.c_str());
+			m_dataStream.Reset();
+			return false;
+		}
+		m_open = true;
+		return true;
+	}
+
+	void StreamDecoder::Close()
+	{
+		if (m_open) {
+			ov_clear(&m_oggv);
+			m_open = false;
+		}
+		m_dataStream.Reset();
+	}
+
+	bool StreamDecoder::Update()
+	{
+		const eventid wanted = m_wanted.load(std::memory_order_acquire);
+		if (wanted != m_current) {
+			// the mixer has moved on from the old event and won't read the
+			// ring again until it is ready for the new one
+			m_ready.store(0, std::memory_order_release);
+			Close();
+			m_readPos.store(0, std::memory_order_relaxed);
+			m_writePos.store(0, std::memory_order_relaxed);
+			m_finished.store(false, std::memory_order_relaxed);
+			m_current = wanted;
+			if (wanted && !Open(wanted, m_wantedSample.load(std::memory_order_relaxed)))
+				m_finished.store(true, std::memory_order_release);
+		}
+		if (!m_current)
+			return false;
+
+		// decode in pieces, so that a long stream doesn't hold up the others
+		static constexpr Uint32 MAX_DECODE = 8192;
+		Uint32 decoded = 0;
+		while (m_open && decoded < MAX_DECODE) {
+			const Uint32 write = m_writePos.load(std::memory_order_relaxed);
+			const Uint32 space = RING_SIZE - (write - m_readPos.load(std::memory_order_acquire));
+			const Uint32 start = write & (RING_SIZE - 1);
+			const Uint32 wanted_samples = std::min({ space, RING_SIZE - start, MAX_DECODE - decoded });
+			if (wanted_samples < 2)
+				break;
+
+			int music_section;
+			const long amt = ov_read(&m_oggv, reinterpret_cast<char *>(&m_ring[start]),
+				(wanted_samples & ~1u) * sizeof(Sint16), 0, 2, 1, &music_section);
+			if (amt > 0) {
+				decoded += amt / sizeof(Sint16);
+				m_writePos.store(write + amt / sizeof(Sint16), std::memory_order_release);
+			} else if (amt == 0 && m_repeat.load(std::memory_order_relaxed)) {
+				ov_pcm_seek(&m_oggv, 0);
+			} else if (amt == 0) {
+				Close();
+				m_finished.store(true, std::memory_order_release);
+			}
+			// negative is a hole in the data, which vorbisfile skips
+		}
+
+		m_ready.store(m_current, std::memory_order_release);
+		return decoded >= MAX_DECODE;
+	}
+
+	static StreamDecoder *s_decoders = nullptr;
+	static std::atomic<Uint32> s_underruns{ 0 };
+
+	static std::thread s_decoderThread;
+	static std::mutex s_decoderLock;
+	static std::condition_variable s_decoderWake;
+	static bool s_decoderQuit = false;
+
+	static void DecoderThread()
+	{
+		// the ring of a stream lasts most of a second, and a callback takes
+		// a tenth of that, so checking every few milliseconds keeps well ahead
+		std::unique_lock<std::mutex> lock(s_decoderLock);
+		while (!s_decoderQuit) {
+			lock.unlock();
+			bool busy = false;
+			for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++)
+				busy |= s_decoders[i].Update();
+			lock.lock();
+			if (!busy)
+				s_decoderWake.wait_for(lock, std::chrono::milliseconds(5));
+		}
+	}
+
+	static void StartDecoder()
+	{
+		if (s_decoders)
+			return;
+		s_decoders = new StreamDecoder[MAX_WAVSTREAMS];
+		s_decoderQuit = false;
+		s_decoderThread = std::thread(&DecoderThread);
+	}
+
+	static void StopDecoder()
+	{
+		if (!s_decoders)
+			return;
+		{
+			std::lock_guard<std::mutex> lock(s_decoderLock);
+			s_decoderQuit = true;
+		}
+		s_decoderWake.notify_one();
+		s_decoderThread.join();
+
+		for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++)
+			s_decoders[i].Close();
+		delete[] s_decoders;
+		s_decoders = nullptr;
+	}
+
+	Uint32 GetUnderrunCount()
+	{
+		return s_underruns.load(std::memory_order_relaxed);
+	}
+
 	static std::map<std::string, Sample> sfx_samples;
 	struct SoundEvent wavstream[MAX_WAVSTREAMS];
 
@@ -206,78 +420,299 @@ namespace Sound {
 		}
 	}
 
-	static SoundEvent *GetEvent(eventid id)
+	/*
+	 * The wavstreams are only touched by the mixer. The game thread sends it
+	 * commands through a single-producer, single-consumer ring, which the
+	 * mixer applies at the start of each buffer it fills, and keeps its own
+	 * view of which event plays in which stream: the id it last started
+	 * there, which is finished once the mixer publishes it as ended.
+	 */
+	struct Command {
+		enum Type : Uint8 {
+			PLAY,
+			STOP,
+			SET_OP,
+			VOLUME_ANIMATE,
+			SET_VOLUME,
+			// stops the events of every stream from the given one on
+			DESTROY_ALL
+		};
+
+		Type type;
+		Uint8 stream;
+		eventid id;
+		const Sample *sample;
+		Op op;
+		float volume[2];
+		float rateOfChange[2];
+		const Uint16 *buf;
+	};
+
+	class CommandQueue {
+	public:
+		// game thread only
+		bool Push(const Command &cmd)
+		{
+			const Uint32 tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_head.load(std::memory_order_acquire) == SIZE)
+				return false;
+			m_commands[tail & (SIZE - 1)] = cmd;
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// mixer only, or whoever holds the audio device lock
+		bool Pop(Command &cmd)
+		{
+			const Uint32 head = m_head.load(std::memory_order_relaxed);
+			if (head == m_tail.load(std::memory_order_acquire))
+				return false;
+			cmd = m_commands[head & (SIZE - 1)];
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		static constexpr Uint32 SIZE = 256;
+		Command m_commands[SIZE];
+		alignas(64) std::atomic<Uint32> m_head{ 0 };
+		alignas(64) std::atomic<Uint32> m_tail{ 0 };
+	};
+
+	static CommandQueue s_commands;
+
+	// game thread: the event last started in each stream, and the louder of
+	// the volumes it was last given
+	static eventid s_streamEvents[MAX_WAVSTREAMS];
+	static float s_streamLoudness[MAX_WAVSTREAMS];
+	// mixer: the event last finished in each stream, and how far into its
+	// sample the current one is, to pick the oldest event to replace
+	static std::atomic<eventid> s_endedEvents[MAX_WAVSTREAMS];
+	static std::atomic<Uint32> s_streamPositions[MAX_WAVSTREAMS];
+
+	static bool IsStreamBusy(unsigned int stream)
+	{
+		const eventid id = s_streamEvents[stream];
+		return id && s_endedEvents[stream].load(std::memory_order_acquire) != id;
+	}
+
+	// the stream playing this event as far as the game thread knows, or -1
+	static int FindStream(eventid id)
 	{
+		if (id == 0)
+			return -1;
 		for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++) {
-			if (wavstream[i].sample && (wavstream[i].identifier == id))
-				return &wavstream[i];
+			if (s_streamEvents[i] == id)
+				return IsStreamBusy(i) ? int(i) : -1;
 		}
-		return nullptr;
+		return -1;
 	}
 
-	bool SetOp(eventid id, Op op)
+	/*
+	 * Sound effects short enough to keep decoded are decoded the first time
+	 * they are played, by a job, and streamed from their file until it is
+	 * done; only the few that must play at once are decoded at startup.
+	 * Decoded samples are kept while they fit in the budget, and the ones
+	 * played least recently make room for new ones. Music is always streamed.
+	 */
+	static const size_t SAMPLE_CACHE_BUDGET = 16 * 1024 * 1024;
+	// how long the mixer may go on reading a buffer after its event is replaced
+	static const Uint32 EVICT_GRACE_MS = 1000;
+
+	static const char *const s_preloadedSamples[] = {
+		"Click", "OK", "warning", "Hull_hit_Small", "Hull_Hit_Medium",
+		"Pulse_Laser", "Explosion_1", "Missile_launch", "Missile_Inbound"
+	};
+
+	struct CachedSample {
+		Uint32 lastUsed = 0; // SDL_GetTicks
+		Job::Handle decode;
+		bool failed = false;
+	};
+
+	static std::map<Sample *, CachedSample> s_sampleCache;
+	static size_t s_sampleCacheUsed = 0;
+
+	// game thread: the cached sample each stream was last given decoded, and
+	// for which event; the mixer holds on to it until that event ends
+	static Sample *s_streamSamples[MAX_WAVSTREAMS];
+	static eventid s_streamSampleEvents[MAX_WAVSTREAMS];
+
+	static bool IsCacheable(const Sample &sample)
 	{
-		if (id == 0) return false;
-		bool ret = false;
-		SDL_LockAudioDevice(m_audioDevice);
-		SoundEvent *se = GetEvent(id);
-		if (se) {
-			se->op = op;
-			ret = true;
+		const double seconds = sample.buf_len / double(sample.channels) * sample.upsample / FREQ;
+		return !sample.isMusic && seconds < STREAM_IF_LONGER_THAN;
+	}
+
+	static bool IsSampleInUse(const Sample *sample)
+	{
+		for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++) {
+			if (s_streamSamples[i] == sample && s_endedEvents[i].load(std::memory_order_acquire) != s_streamSampleEvents[i])
+				return true;
 		}
-		SDL_UnlockAudioDevice(m_audioDevice);
-		return ret;
+		return false;
 	}
 
-	static void DestroyEvent(SoundEvent *ev)
+	static void TrimSampleCache()
 	{
-		if (ev->oggv) {
-			// streaming ogg
-			ov_clear(ev->oggv);
-			delete ev->oggv;
-			ev->oggv = 0;
-			ev->ogg_data_stream.Reset();
+		const Uint32 now = SDL_GetTicks();
+		while (s_sampleCacheUsed > SAMPLE_CACHE_BUDGET) {
+			Sample *oldest = nullptr;
+			Uint32 oldestAge = 0;
+			for (auto &it : s_sampleCache) {
+				const Uint32 age = now - it.second.lastUsed;
+				if (!it.first->buf || age < EVICT_GRACE_MS || IsSampleInUse(it.first))
+					continue;
+				if (!oldest || age > oldestAge) {
+					oldest = it.first;
+					oldestAge = age;
+				}
+			}
+			// everything decoded is playing; try again when the next one is added
+			if (!oldest)
+				break;
+			s_sampleCacheUsed -= oldest->buf_len * sizeof(Uint16);
+			delete[] oldest->buf;
+			oldest->buf = nullptr;
 		}
+	}
+
+	// marks a sample as played, and returns its buffer if it is decoded
+	static const Uint16 *UseSample(Sample *sample);
+
+	static void DestroyEvent(SoundEvent *ev)
+	{
+		if (ev->sample && !ev->buf && s_decoders)
+			s_decoders[ev - wavstream].Stop();
+		if (ev->sample)
+			s_endedEvents[ev - wavstream].store(ev->identifier, std::memory_order_release);
 		ev->sample = nullptr;
 	}
 
+	static void ApplyCommand(const Command &cmd)
+	{
+		if (cmd.type == Command::DESTROY_ALL) {
+			for (unsigned int idx = cmd.stream; idx < MAX_WAVSTREAMS; idx++)
+				DestroyEvent(&wavstream[idx]);
+			return;
+		}
+
+		SoundEvent &ev = wavstream[cmd.stream];
+		if (cmd.type == Command::PLAY) {
+			if (ev.sample)
+				DestroyEvent(&ev);
+			ev.sample = cmd.sample;
+			ev.buf = cmd.buf;
+			ev.buf_pos = 0;
+			ev.volume[0] = cmd.volume[0];
+			ev.volume[1] = cmd.volume[1];
+			ev.op = cmd.op;
+			ev.identifier = cmd.id;
+			ev.targetVolume[0] = cmd.volume[0];
+			ev.targetVolume[1] = cmd.volume[1];
+			ev.rateOfChange[0] = ev.rateOfChange[1] = 0.0f;
+			s_streamPositions[cmd.stream].store(0, std::memory_order_relaxed);
+			if (ev.sample && !ev.buf && s_decoders)
+				s_decoders[cmd.stream].Start(cmd.id, ev.sample, ev.op & OP_REPEAT);
+			return;
+		}
+
+		// the event may have ended since the command was sent
+		if (!ev.sample || ev.identifier != cmd.id)
+			return;
+
+		switch (cmd.type) {
+		case Command::STOP:
+			DestroyEvent(&ev);
+			break;
+		case Command::SET_OP:
+			ev.op = cmd.op;
+			break;
+		case Command::VOLUME_ANIMATE:
+			ev.targetVolume[0] = cmd.volume[0];
+			ev.targetVolume[1] = cmd.volume[1];
+			ev.rateOfChange[0] = cmd.rateOfChange[0];
+			ev.rateOfChange[1] = cmd.rateOfChange[1];
+			break;
+		case Command::SET_VOLUME:
+			ev.volume[0] = ev.targetVolume[0] = cmd.volume[0];
+			ev.volume[1] = ev.targetVolume[1] = cmd.volume[1];
+			break;
+		default:
+			break;
+		}
+	}
+
+	// called by the mixer, or with the device locked or closed
+	static void ApplyCommands()
+	{
+		Command cmd;
+		while (s_commands.Pop(cmd))
+			ApplyCommand(cmd);
+	}
+
+	static void SendCommand(const Command &cmd)
+	{
+		if (s_commands.Push(cmd))
+			return;
+
+		// the mixer isn't running (paused, or no device) or can't keep up:
+		// apply the queued commands here instead of dropping any
+		SDL_LockAudioDevice(m_audioDevice);
+		ApplyCommands();
+		ApplyCommand(cmd);
+		SDL_UnlockAudioDevice(m_audioDevice);
+	}
+
+	static void SendEventCommand(Command::Type type, int stream, eventid id, Op op = 0, float vol0 = 0.0f, float vol1 = 0.0f, float rate0 = 0.0f, float rate1 = 0.0f)
+	{
+		SendCommand({ type, Uint8(stream), id, nullptr, op, { vol0, vol1 }, { rate0, rate1 } });
+	}
+
+	bool SetOp(eventid id, Op op)
+	{
+		const int stream = FindStream(id);
+		if (stream < 0)
+			return false;
+		SendEventCommand(Command::SET_OP, stream, id, op);
+		return true;
+	}
+
+	static eventid StartEvent(unsigned int stream, const char *fx, const float volume_left, const float volume_right, const Op op);
+
 	/*
  * Volume should be 0-65535
  */
 	static Uint32 identifier = 1;
 	eventid PlaySfx(const char *fx, const float volume_left, const float volume_right, const Op op)
 	{
-		SDL_LockAudioDevice(m_audioDevice);
+		const float vl = volume_left * GetSfxVolume();
+		const float vr = volume_right * GetSfxVolume();
 		unsigned int idx;
-		Uint32 age;
 		/* find free wavstream (first two reserved for music) */
 		for (idx = 2; idx < MAX_WAVSTREAMS; idx++) {
-			if (!wavstream[idx].sample) break;
+			if (!IsStreamBusy(idx)) break;
 		}
 		if (idx == MAX_WAVSTREAMS) {
-			/* otherwise overwrite oldest one */
-			age = 0;
+			/* otherwise overwrite the quietest one, the oldest of those,
+			   so that only the loudest effects of a big fight are mixed */
+			Uint32 age = 0;
+			float quietest = 0.0f;
 			idx = 0;
 			for (unsigned int i = 2; i < MAX_WAVSTREAMS; i++) {
-				if ((i == 0) || (wavstream[i].buf_pos > age)) {
+				const Uint32 pos = s_streamPositions[i].load(std::memory_order_relaxed);
+				const float loudness = s_streamLoudness[i];
+				if ((idx == 0) || (loudness < quietest) || ((loudness == quietest) && (pos > age))) {
 					idx = i;
-					age = wavstream[i].buf_pos;
+					age = pos;
+					quietest = loudness;
 				}
 			}
-			DestroyEvent(&wavstream[idx]);
-		}
-		wavstream[idx].sample = GetSample(fx);
-		wavstream[idx].oggv = 0;
-		wavstream[idx].buf_pos = 0;
-		wavstream[idx].volume[0] = volume_left * GetSfxVolume();
-		wavstream[idx].volume[1] = volume_right * GetSfxVolume();
-		wavstream[idx].op = op;
-		wavstream[idx].identifier = identifier;
-		wavstream[idx].targetVolume[0] = volume_left * GetSfxVolume();
-		wavstream[idx].targetVolume[1] = volume_right * GetSfxVolume();
-		wavstream[idx].rateOfChange[0] = wavstream[idx].rateOfChange[1] = 0.0f;
-		SDL_UnlockAudioDevice(m_audioDevice);
-		return identifier++;
+			// quieter than everything playing: drop it
+			if (std::max(vl, vr) < quietest)
+				return identifier++;
+		}
+		return StartEvent(idx, fx, vl, vr, op);
 	}
 
 	//unlike PlaySfx, we want uninterrupted play and do not care about age
@@ -287,20 +722,24 @@ namespace Sound {
 	{
 		const int idx = nextMusicStream;
 		nextMusicStream ^= 1;
-		SDL_LockAudioDevice(m_audioDevice);
-		if (wavstream[idx].sample)
-			DestroyEvent(&wavstream[idx]);
-		wavstream[idx].sample = GetSample(fx);
-		wavstream[idx].oggv = nullptr;
-		wavstream[idx].buf_pos = 0;
-		wavstream[idx].volume[0] = volume_left;
-		wavstream[idx].volume[1] = volume_right;
-		wavstream[idx].op = op;
-		wavstream[idx].identifier = identifier;
-		wavstream[idx].targetVolume[0] = volume_left; //already scaled in MusicPlayer
-		wavstream[idx].targetVolume[1] = volume_right;
-		wavstream[idx].rateOfChange[0] = wavstream[idx].rateOfChange[1] = 0.0f;
-		SDL_UnlockAudioDevice(m_audioDevice);
+		//already scaled in MusicPlayer
+		return StartEvent(idx, fx, volume_left, volume_right, op);
+	}
+
+	// replaces whatever plays in the stream
+	static eventid StartEvent(unsigned int stream, const char *fx, const float volume_left, const float volume_right, const Op op)
+	{
+		Sample *sample = GetSample(fx);
+		// the mixer lets go of the buffer of the event this replaces shortly
+		if (s_streamSamples[stream])
+			s_sampleCache[s_streamSamples[stream]].lastUsed = SDL_GetTicks();
+		const Uint16 *buf = sample ? UseSample(sample) : nullptr;
+		s_streamSamples[stream] = buf ? sample : nullptr;
+		s_streamSampleEvents[stream] = identifier;
+		// an unknown sample just stops the stream, and is never playing
+		s_streamEvents[stream] = sample ? identifier : 0;
+		s_streamLoudness[stream] = std::max(volume_left, volume_right);
+		SendCommand({ Command::PLAY, Uint8(stream), identifier, sample, op, { volume_left, volume_right }, { 0.0f, 0.0f }, buf });
 		return identifier++;
 	}
 
@@ -310,105 +749,71 @@ namespace Sound {
 	template <int T_channels, int T_upsample>
 	static void fill_audio_1stream(float *buffer, int len, int stream_num)
 	{
-		// inbuf will be smaller for mono and for 22050hz samples
-		Sint16 *inbuf = static_cast<Sint16 *>(alloca(len * T_channels / T_upsample));
-		// hm pity to put this here ^^ since not used by ev.sample->buf case
+		// ringbuf will be smaller for mono and for 22050hz samples
+		Sint16 *ringbuf = static_cast<Sint16 *>(alloca(len * T_channels / T_upsample));
+		// hm pity to put this here ^^ since not used by ev.buf case
+		const Sint16 *inbuf = ringbuf;
 		SoundEvent &ev = wavstream[stream_num];
-		int inbuf_pos = 0;
+		Uint32 inbuf_pos = 0;
+		Uint32 inbuf_len = 0;
 		int pos = 0;
 		while ((pos < len) && ev.sample) {
-			if (ev.sample->buf) {
+			bool drained = false;
+			if (ev.buf) {
 				// already decoded
-				inbuf = reinterpret_cast<Sint16 *>(ev.sample->buf);
+				inbuf = reinterpret_cast<const Sint16 *>(ev.buf);
 				inbuf_pos = ev.buf_pos;
+				inbuf_len = ev.sample->buf_len;
 			} else {
-				// stream ogg vorbis
-				// ogg vorbis streaming
-				if (!ev.oggv) {
-					// open file to start streaming
-					ev.oggv = new OggVorbis_File;
-					RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(ev.sample->path);
-					if (!oggdata) {
-						Output("Could not open '%s'", ev.sample->path.c_str());
-						ev.sample = nullptr;
-						return;
-					}
-					ev.ogg_data_stream.Reset(oggdata);
-					oggdata.Reset();
-					if (ov_open_callbacks(&ev.ogg_data_stream, ev.oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
-						Output("Vorbis could not understand '%s'", ev.sample->path.c_str());
-						ev.sample = nullptr;
+				// streamed, decoded ahead by the decoder thread
+				StreamDecoder &decoder = s_decoders[stream_num];
+				if (!decoder.IsReady(ev.identifier))
+					return; // still opening the file
+				decoder.SetRepeat(ev.op & OP_REPEAT);
+				const Uint32 wanted = (len - pos) * T_channels / (2 * T_upsample);
+				inbuf = ringbuf;
+				inbuf_pos = 0;
+				inbuf_len = decoder.Read(ringbuf, wanted);
+				if (inbuf_len < wanted) {
+					if (!decoder.IsFinished()) {
+						s_underruns.fetch_add(1, std::memory_order_relaxed);
+					} else if (!inbuf_len) {
+						// ended early, or couldn't be opened at all
+						DestroyEvent(&ev);
 						return;
 					}
-				}
-				int i = 0;
-				// (len-pos) = num floats the destination buffer wants.
-				// if we are stereo then to fill this we need (len-pos)*2 bytes
-				// if we are mono we want (len-pos) bytes
-				int wanted_bytes = (len - pos) * T_channels / T_upsample;
-				for (;;) {
-					int music_section;
-					if (wanted_bytes == 0) break;
-					int amt = ov_read(ev.oggv, reinterpret_cast<char *>(inbuf) + i,
-						wanted_bytes, 0, 2, 1, &music_section);
-					i += amt;
-					wanted_bytes -= amt;
-					if (amt == 0) break;
+					drained = true;
 				}
 			}
 
-			while (pos < len) {
-				/* Volume animations */
-				for (int chan = 0; chan < 2; chan++) {
-					if (ev.ascend[chan]) {
-						ev.volume[chan] = std::min(ev.volume[chan] + ev.rateOfChange[chan], ev.targetVolume[chan]);
-					} else {
-						ev.volume[chan] = std::max(ev.volume[chan] - ev.rateOfChange[chan], ev.targetVolume[chan]);
-					}
-				}
-
-				float s0, s1;
-
-				if (T_channels == 1) {
-					s0 = float(inbuf[inbuf_pos++]);
-					s1 = ev.volume[1] * s0;
-					s0 = ev.volume[0] * s0;
-					ev.buf_pos += 1;
-				} else /* stereo */ {
-					s0 = ev.volume[0] * float(inbuf[inbuf_pos++]);
-					s1 = ev.volume[1] * float(inbuf[inbuf_pos++]);
-					ev.buf_pos += 2;
-				}
-
-				if (T_upsample == 1) {
-					buffer[pos] += s0;
-					buffer[pos + 1] += s1;
-					pos += 2;
-				} else {
-					buffer[pos] += s0;
-					buffer[pos + 1] += s1;
-					buffer[pos + 2] += s0;
-					buffer[pos + 3] += s1;
-					pos += 4;
-				}
+			while (pos < len && inbuf_pos + T_channels <= inbuf_len) {
+				// run up to the end of the buffer, of the input, or of the sample
+				const Uint32 frames = std::min({ Uint32(len - pos) / (2 * T_upsample),
+					(inbuf_len - inbuf_pos) / T_channels,
+					(ev.sample->buf_len - ev.buf_pos + T_channels - 1) / T_channels });
+				if (!frames)
+					return; // not a whole output frame left
+				MixVoice(&buffer[pos], &inbuf[inbuf_pos], frames, T_channels, T_upsample,
+					ev.volume, ev.targetVolume, ev.rateOfChange);
+				pos += frames * 2 * T_upsample;
+				inbuf_pos += frames * T_channels;
+				ev.buf_pos += frames * T_channels;
 
 				/* Repeat or end? */
 				if (ev.buf_pos >= ev.sample->buf_len) {
 					ev.buf_pos = 0;
-					inbuf_pos = 0;
 					if (!(ev.op & OP_REPEAT)) {
 						DestroyEvent(&ev);
 						break;
 					}
-					if (ev.oggv) {
-						// streaming ogg
-						ov_pcm_seek(ev.oggv, 0);
-						// repeat outer loop to decode some
-						// more vorbis from the start of the stream
-						break;
-					}
+					// a streamed sample carries on in the ring, as the
+					// decoder goes back to the start by itself
+					if (ev.buf)
+						inbuf_pos = 0;
 				}
 			}
+			if (drained)
+				break;
 		}
 	}
 
@@ -418,6 +823,8 @@ namespace Sound {
 		float *tmpbuf = static_cast<float *>(alloca(sizeof(float) * len_in_floats)); // len is in chars not samples
 		memset(static_cast<void *>(tmpbuf), 0, sizeof(float) * len_in_floats);
 
+		ApplyCommands();
+
 		for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++) {
 			if (!wavstream[i].sample) continue;
 
@@ -453,41 +860,91 @@ namespace Sound {
 					fill_audio_1stream<2, 2>(tmpbuf, len_in_floats, i);
 				}
 			}
+			s_streamPositions[i].store(wavstream[i].buf_pos, std::memory_order_relaxed);
 		}
 
 		/* Convert float sample buffer to Sint16 samples the hardware likes */
+		const float masterVol = m_masterVol.load(std::memory_order_relaxed);
 		for (int pos = 0; pos < len_in_floats; pos++) {
-			const float val = m_masterVol * tmpbuf[pos];
+			const float val = masterVol * tmpbuf[pos];
 			(reinterpret_cast<Sint16 *>(dsp_buf))[pos] = Sint16(Clamp(val, -32768.0f, 32767.0f));
 		}
 	}
 
+	static void DestroyEventsFrom(unsigned int first)
+	{
+		for (unsigned int idx = first; idx < MAX_WAVSTREAMS; idx++)
+			s_streamEvents[idx] = 0;
+		SendCommand({ Command::DESTROY_ALL, Uint8(first), 0, nullptr, 0, { 0.0f, 0.0f }, { 0.0f, 0.0f } });
+	}
+
 	void DestroyAllEvents()
 	{
 		/* silence any sound events */
-		SDL_LockAudioDevice(m_audioDevice);
-		for (unsigned int idx = 0; idx < MAX_WAVSTREAMS; idx++) {
-			DestroyEvent(&wavstream[idx]);
-		}
-		SDL_UnlockAudioDevice(m_audioDevice);
+		DestroyEventsFrom(0);
 	}
 
 	void DestroyAllEventsExceptMusic()
 	{
 		/* silence any sound events EXCEPT music
 		   which are on wavstream[0] and [1] */
-		SDL_LockAudioDevice(m_audioDevice);
-		for (unsigned int idx = 2; idx < MAX_WAVSTREAMS; idx++) {
-			DestroyEvent(&wavstream[idx]);
+		DestroyEventsFrom(2);
+	}
+
+	// decodes the whole of an open file
+	static Uint16 *decode_ogg(OggVorbis_File *oggv, Uint32 buf_len)
+	{
+		Uint16 *buf = new Uint16[buf_len]();
+		Uint32 i = 0;
+		while (i < 2 * buf_len) {
+			int music_section;
+			long amt = ov_read(oggv, reinterpret_cast<char *>(buf) + i,
+				2 * buf_len - i, 0, 2, 1, &music_section);
+			if (amt <= 0) break;
+			i += amt;
 		}
-		SDL_UnlockAudioDevice(m_audioDevice);
+		return buf;
 	}
 
+	static Uint16 *decode_sound(const std::string &path, Uint32 buf_len)
+	{
+		PROFILE_SCOPED()
+		RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(path);
+		if (!oggdata) {
+			Output("Could not read '%s'\n", path.c_str());
+			return nullptr;
+		}
+		OggFileDataStream datastream(oggdata);
+		oggdata.Reset();
+		OggVorbis_File oggv;
+		if (ov_open_callbacks(&datastream, &oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
+			Output("Vorbis could not understand '%s'\n", path.c_str());
+			return nullptr;
+		}
+		Uint16 *buf = decode_ogg(&oggv, buf_len);
+		ov_clear(&oggv);
+		return buf;
+	}
+
+	static bool is_preloaded(const std::string &name)
+	{
+		for (const char *preloaded : s_preloadedSamples) {
+			if (name == preloaded)
+				return true;
+		}
+		return false;
+	}
+
+	// reads the header of a file, and decodes it if it is one of the preloaded sound effects
 	static std::pair<std::string, Sample> load_sound(const std::string &basename, const std::string &path, bool is_music)
 	{
 		PROFILE_SCOPED()
 		if (!ends_with_ci(basename, ".ogg")) return {};
 
+		// music keyed by pathname minus (datapath)/music/ and extension,
+		// sfx keyed by basename minus the .ogg
+		std::string name = is_music ? path.substr(0, path.size() - 4) : basename.substr(0, basename.size() - 4);
+
 		Sample sample;
 		OggVorbis_File oggv;
 
@@ -519,35 +976,14 @@ namespace Sound {
 		sample.channels = info->channels;
 		sample.upsample = resample_multiplier;
 		sample.path = path;
+		sample.isMusic = is_music;
 
-		const float seconds = num_samples / float(info->rate);
-		//Output("%f seconds\n", seconds);
-
-		// immediately decode and store as raw sample if short enough
-		if (seconds < STREAM_IF_LONGER_THAN) {
-			sample.buf = new Uint16[sample.buf_len];
-
-			int i = 0;
-			for (;;) {
-				int music_section;
-				int amt = ov_read(&oggv, reinterpret_cast<char *>(sample.buf) + i,
-					2 * sample.buf_len - i, 0, 2, 1, &music_section);
-				i += amt;
-				if (amt == 0) break;
-			}
-		}
+		if (IsCacheable(sample) && is_preloaded(name))
+			sample.buf = decode_ogg(&oggv, sample.buf_len);
 
 		ov_clear(&oggv);
 
-		if (is_music) {
-			sample.isMusic = true;
-			// music keyed by pathname minus (datapath)/music/ and extension
-			return { path.substr(0, path.size() - 4), sample };
-		} else {
-			sample.isMusic = false;
-			// sfx keyed by basename minus the .ogg
-			return { basename.substr(0, basename.size() - 4), sample };
-		}
+		return { std::move(name), sample };
 	}
 
 	class LoadSoundJob : public Job {
@@ -565,23 +1001,83 @@ namespace Sound {
 				const FileSystem::FileInfo &info = files.Current();
 				assert(info.IsFile());
 				std::pair<std::string, Sample> result = load_sound(info.GetName(), info.GetPath(), m_isMusic);
-				m_loadedSounds.emplace(result);
+				if (!m_loadedSounds.emplace(result).second)
+					delete[] result.second.buf;
 			}
 		}
 
 		virtual void OnFinish() override
 		{
-			for (const auto &pair : m_loadedSounds) {
-				sfx_samples.emplace(std::move(pair));
+			for (auto &pair : m_loadedSounds) {
+				auto result = sfx_samples.emplace(std::move(pair));
+				if (!result.second) {
+					delete[] pair.second.buf;
+					continue;
+				}
+				Sample *sample = &result.first->second;
+				if (IsCacheable(*sample)) {
+					s_sampleCache[sample].lastUsed = SDL_GetTicks();
+					if (sample->buf)
+						s_sampleCacheUsed += sample->buf_len * sizeof(Uint16);
+				}
 			}
 		}
 
+		virtual const char *GetJobName() const override { return "LoadSoundJob"; }
+
 	private:
 		std::string m_directory;
 		bool m_isMusic;
 		std::map<std::string, Sample> m_loadedSounds;
 	};
 
+	class DecodeSampleJob : public Job {
+	public:
+		explicit DecodeSampleJob(Sample *sample) :
+			m_sample(sample),
+			m_path(sample->path),
+			m_bufLen(sample->buf_len)
+		{}
+
+		virtual void OnRun() override
+		{
+			m_buf.reset(decode_sound(m_path, m_bufLen));
+		}
+
+		virtual void OnFinish() override
+		{
+			if (!m_buf) {
+				// leave it streamed
+				s_sampleCache[m_sample].failed = true;
+				return;
+			}
+			m_sample->buf = m_buf.release();
+			s_sampleCacheUsed += m_bufLen * sizeof(Uint16);
+			TrimSampleCache();
+		}
+
+		virtual const char *GetJobName() const override { return "DecodeSampleJob"; }
+
+	private:
+		Sample *m_sample;
+		std::string m_path;
+		Uint32 m_bufLen;
+		std::unique_ptr<Uint16[]> m_buf;
+	};
+
+	static const Uint16 *UseSample(Sample *sample)
+	{
+		auto it = s_sampleCache.find(sample);
+		if (it == s_sampleCache.end())
+			return nullptr; // streamed
+
+		CachedSample &cached = it->second;
+		cached.lastUsed = SDL_GetTicks();
+		if (!sample->buf && !cached.decode.HasJob() && !cached.failed)
+			cached.decode = Pi::GetAsyncJobQueue()->Queue(new DecodeSampleJob(sample));
+		return sample->buf;
+	}
+
 	std::vector<std::string> s_audioDeviceNames = {};
 
 	bool Init(bool automaticallyOpenDevice)
@@ -605,6 +1101,8 @@ namespace Sound {
 
 		UpdateAudioDevices();
 
+		StartDecoder();
+
 		// If we're going to manually pick a device later, don't open a default one now.
 		if (!automaticallyOpenDevice) {
 			return true;
@@ -639,6 +1137,8 @@ namespace Sound {
 			SDL_PauseAudioDevice(m_audioDevice, 1);
 			SDL_CloseAudioDevice(m_audioDevice);
 			m_audioDevice = 0;
+			// the mixer has stopped, the commands it didn't get to are done here
+			ApplyCommands();
 		}
 
 		SDL_AudioSpec wanted = {};
@@ -661,15 +1161,26 @@ namespace Sound {
 
 	void Uninit()
 	{
-		if (!m_audioDevice)
-			return;
+		if (m_audioDevice) {
+			DestroyAllEvents();
+			SDL_CloseAudioDevice(m_audioDevice);
+			m_audioDevice = 0;
+			// the mixer has stopped, the commands it didn't get to are done here
+			ApplyCommands();
+		}
+		StopDecoder();
+
+		// cancels the decodes still going
+		s_sampleCache.clear();
+		s_sampleCacheUsed = 0;
+		for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++)
+			s_streamSamples[i] = nullptr;
 
-		DestroyAllEvents();
 		std::map<std::string, Sample>::iterator i;
-		for (i = sfx_samples.begin(); i != sfx_samples.end(); ++i)
+		for (i = sfx_samples.begin(); i != sfx_samples.end(); ++i) {
 			delete[](*i).second.buf;
-		SDL_CloseAudioDevice(m_audioDevice);
-		m_audioDevice = 0;
+			(*i).second.buf = nullptr;
+		}
 	}
 
 	void UpdateAudioDevices()
@@ -695,71 +1206,42 @@ namespace Sound {
 
 	bool Event::Stop()
 	{
-		if (eid) {
-			SDL_LockAudioDevice(m_audioDevice);
-			SoundEvent *s = GetEvent(eid);
-			if (s) {
-				DestroyEvent(s);
-			}
-			SDL_UnlockAudioDevice(m_audioDevice);
-			return s != nullptr;
-		} else {
+		const int stream = FindStream(eid);
+		if (stream < 0)
 			return false;
-		}
+		s_streamEvents[stream] = 0;
+		SendEventCommand(Command::STOP, stream, eid);
+		return true;
 	}
 
 	bool Event::IsPlaying() const
 	{
-		if (eid == 0)
-			return false;
-		else
-			return GetEvent(eid) != nullptr;
+		return FindStream(eid) >= 0;
 	}
 
 	bool Event::SetOp(Op op)
 	{
-		if (eid == 0) return false;
-		bool ret = false;
-		SDL_LockAudioDevice(m_audioDevice);
-		SoundEvent *se = GetEvent(eid);
-		if (se) {
-			se->op = op;
-			ret = true;
-		}
-		SDL_UnlockAudioDevice(m_audioDevice);
-		return ret;
+		return Sound::SetOp(eid, op);
 	}
 
 	bool Event::VolumeAnimate(const float targetVol1, const float targetVol2, const float dv_dt1, const float dv_dt2)
 	{
-		SDL_LockAudioDevice(m_audioDevice);
-		SoundEvent *ev = GetEvent(eid);
-		if (ev) {
-			ev->targetVolume[0] = targetVol1;
-			ev->targetVolume[1] = targetVol2;
-			ev->rateOfChange[0] = dv_dt1 / float(FREQ);
-			ev->rateOfChange[1] = dv_dt2 / float(FREQ);
-		}
-		SDL_UnlockAudioDevice(m_audioDevice);
-		return (ev != nullptr);
+		const int stream = FindStream(eid);
+		if (stream < 0)
+			return false;
+		s_streamLoudness[stream] = std::max(targetVol1, targetVol2);
+		SendEventCommand(Command::VOLUME_ANIMATE, stream, eid, 0, targetVol1, targetVol2, dv_dt1 / float(FREQ), dv_dt2 / float(FREQ));
+		return true;
 	}
 
 	bool Event::SetVolume(const float vol_left, const float vol_right)
 	{
-		SDL_LockAudioDevice(m_audioDevice);
-		bool status = false;
-		for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++) {
-			if (wavstream[i].sample && (wavstream[i].identifier == eid)) {
-				wavstream[i].volume[0] = vol_left;
-				wavstream[i].volume[1] = vol_right;
-				wavstream[i].targetVolume[0] = vol_left;
-				wavstream[i].targetVolume[1] = vol_right;
-				status = true;
-				break;
-			}
-		}
-		SDL_UnlockAudioDevice(m_audioDevice);
-		return status;
+		const int stream = FindStream(eid);
+		if (stream < 0)
+			return false;
+		s_streamLoudness[stream] = std::max(vol_left, vol_right);
+		SendEventCommand(Command::SET_VOLUME, stream, eid, 0, vol_left, vol_right);
+		return true;
 	}
 
 	const std::map<std::string, Sample> &GetSamples()
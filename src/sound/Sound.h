@@ -24,7 +24,8 @@ namespace Sound {
 		Uint32 buf_len;
 		Uint32 channels;
 		int upsample; // 1 = 44100, 2=22050
-		/* if buf is null, this will be path to an ogg we must stream */
+		/* if buf is null, this will be path to an ogg we must stream, until
+		 * a short sound effect is decoded on first use */
 		std::string path;
 		bool isMusic;
 	};
@@ -79,6 +80,10 @@ namespace Sound {
 	void SetSfxVolume(const float vol);
 	float GetSfxVolume();
 	const std::map<std::string, Sample> &GetSamples();
+	/**
+	 * Times the mixer found a streamed sample not decoded far enough ahead.
+	 */
+	Uint32 GetUnderrunCount();
 
 } /* namespace Sound */
 
@@ -0,0 +1,263 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "SoundMix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOUNDMIX_SSE 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SOUNDMIX_NEON 1
+#endif
+
+#pragma GCC optimize("O3")
+
+namespace {
+	// a full scale sample at this volume changes the output by under half
+	// of the least significant bit
+	constexpr float SILENT_VOLUME = 1.0f / 65536.0f;
+
+	// the volume ramp of both channels, as a function of the number of
+	// input frames mixed so far
+	struct Ramp {
+		Ramp(const float volume[2], const float targetVolume[2], const float rateOfChange[2])
+		{
+			for (int chan = 0; chan < 2; chan++) {
+				start[chan] = volume[chan];
+				target[chan] = targetVolume[chan];
+				ascend[chan] = targetVolume[chan] > volume[chan];
+				step[chan] = ascend[chan] ? rateOfChange[chan] : -rateOfChange[chan];
+			}
+		}
+
+		float Volume(int chan, float frames) const
+		{
+			const float v = start[chan] + frames * step[chan];
+			return ascend[chan] ? std::min(v, target[chan]) : std::max(v, target[chan]);
+		}
+
+		bool IsRamping() const
+		{
+			return (start[0] != target[0] && step[0] != 0.0f) || (start[1] != target[1] && step[1] != 0.0f);
+		}
+
+		bool IsAudible() const
+		{
+			return std::max(std::abs(start[0]), std::abs(target[0])) >= SILENT_VOLUME ||
+				std::max(std::abs(start[1]), std::abs(target[1])) >= SILENT_VOLUME;
+		}
+
+		float start[2];
+		float target[2];
+		float step[2];
+		bool ascend[2];
+	};
+
+	// mixes input frames [first, last); the volume used for frame k is the
+	// one after k + 1 steps of the ramp
+	template <int T_channels, int T_upsample>
+	void MixScalar(float *out, const Sint16 *in, Uint32 first, Uint32 last, const Ramp &ramp)
+	{
+		out += first * 2 * T_upsample;
+		for (Uint32 k = first; k < last; k++) {
+			const float steps = float(k + 1);
+			float s0, s1;
+			if (T_channels == 1) {
+				s0 = s1 = float(in[k]);
+			} else {
+				s0 = float(in[2 * k]);
+				s1 = float(in[2 * k + 1]);
+			}
+			s0 *= ramp.Volume(0, steps);
+			s1 *= ramp.Volume(1, steps);
+			for (int i = 0; i < T_upsample; i++) {
+				out[0] += s0;
+				out[1] += s1;
+				out += 2;
+			}
+		}
+	}
+
+#if defined(SOUNDMIX_SSE) || defined(SOUNDMIX_NEON)
+	// One register holds two output frames, left and right interleaved.
+#if defined(SOUNDMIX_SSE)
+	typedef __m128 float4;
+
+	inline float4 Set(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+	inline float4 Broadcast(float f) { return _mm_set1_ps(f); }
+	inline float4 Load(const float *p) { return _mm_loadu_ps(p); }
+	inline void Store(float *p, float4 a) { _mm_storeu_ps(p, a); }
+	inline float4 Add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+	inline float4 Mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+	inline float4 Min(float4 a, float4 b) { return _mm_min_ps(a, b); }
+	inline float4 Max(float4 a, float4 b) { return _mm_max_ps(a, b); }
+	inline float4 GreaterThan(float4 a, float4 b) { return _mm_cmpgt_ps(a, b); }
+	inline float4 Select(float4 mask, float4 a, float4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+	inline __m128i Load32(const Sint16 *in)
+	{
+		int bits;
+		memcpy(&bits, in, sizeof(bits));
+		return _mm_cvtsi32_si128(bits);
+	}
+
+	// the samples of two output frames
+	template <int T_channels, int T_upsample>
+	inline float4 LoadFrames(const Sint16 *in)
+	{
+		if (T_channels == 2 && T_upsample == 1) {
+			// L0 R0 L1 R1
+			const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in));
+			return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+		} else if (T_channels == 1 && T_upsample == 1) {
+			// M0 M0 M1 M1
+			const __m128i x = _mm_unpacklo_epi16(Load32(in), Load32(in));
+			return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+		} else if (T_channels == 2) {
+			// L0 R0 L0 R0
+			const __m128i x = Load32(in);
+			const __m128i lr = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+			return _mm_cvtepi32_ps(_mm_shuffle_epi32(lr, _MM_SHUFFLE(1, 0, 1, 0)));
+		} else {
+			// M0 M0 M0 M0
+			return _mm_set1_ps(float(in[0]));
+		}
+	}
+#elif defined(SOUNDMIX_NEON)
+	typedef float32x4_t float4;
+
+	inline float4 Set(float a, float b, float c, float d)
+	{
+		const float values[4] = { a, b, c, d };
+		return vld1q_f32(values);
+	}
+	inline float4 Broadcast(float f) { return vdupq_n_f32(f); }
+	inline float4 Load(const float *p) { return vld1q_f32(p); }
+	inline void Store(float *p, float4 a) { vst1q_f32(p, a); }
+	inline float4 Add(float4 a, float4 b) { return vaddq_f32(a, b); }
+	inline float4 Mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+	inline float4 Min(float4 a, float4 b) { return vminq_f32(a, b); }
+	inline float4 Max(float4 a, float4 b) { return vmaxq_f32(a, b); }
+	inline float4 GreaterThan(float4 a, float4 b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+	inline float4 Select(float4 mask, float4 a, float4 b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+
+	// the samples of two output frames
+	template <int T_channels, int T_upsample>
+	inline float4 LoadFrames(const Sint16 *in)
+	{
+		if (T_channels == 2 && T_upsample == 1) {
+			// L0 R0 L1 R1
+			return vcvtq_f32_s32(vmovl_s16(vld1_s16(in)));
+		} else if (T_channels == 1 && T_upsample == 1) {
+			// M0 M0 M1 M1
+			return Set(float(in[0]), float(in[0]), float(in[1]), float(in[1]));
+		} else if (T_channels == 2) {
+			// L0 R0 L0 R0
+			return Set(float(in[0]), float(in[1]), float(in[0]), float(in[1]));
+		} else {
+			// M0 M0 M0 M0
+			return vdupq_n_f32(float(in[0]));
+		}
+	}
+#endif
+
+	template <int T_channels, int T_upsample, bool T_ramp>
+	void MixVector(float *out, const Sint16 *in, Uint32 frames, const Ramp &ramp)
+	{
+		// a register is two input frames, or one written twice
+		constexpr Uint32 FRAMES = 2 / T_upsample;
+		const Uint32 numVectors = frames / FRAMES;
+
+		const float4 start = Set(ramp.start[0], ramp.start[1], ramp.start[0], ramp.start[1]);
+		const float4 target = Set(ramp.target[0], ramp.target[1], ramp.target[0], ramp.target[1]);
+		const float4 step = Set(ramp.step[0], ramp.step[1], ramp.step[0], ramp.step[1]);
+		const float4 ascend = GreaterThan(target, start);
+		const float4 stepsPerVector = Broadcast(float(FRAMES));
+		// ramp steps taken by the frames in each lane
+		float4 steps = T_upsample == 1 ? Set(1.0f, 1.0f, 2.0f, 2.0f) : Broadcast(1.0f);
+
+		for (Uint32 i = 0; i < numVectors; i++) {
+			float4 volume = start;
+			if (T_ramp) {
+				const float4 v = Add(start, Mul(steps, step));
+				volume = Select(ascend, Min(v, target), Max(v, target));
+				steps = Add(steps, stepsPerVector);
+			}
+			const float4 samples = LoadFrames<T_channels, T_upsample>(in + i * FRAMES * T_channels);
+			Store(out, Add(Load(out), Mul(samples, volume)));
+			out += 4;
+		}
+
+		// a frame left over at the output rate
+		MixScalar<T_channels, T_upsample>(out - numVectors * 4, in, numVectors * FRAMES, frames, ramp);
+	}
+#endif
+
+	template <int T_channels, int T_upsample>
+	void MixFrames(float *out, const Sint16 *in, Uint32 frames, const Ramp &ramp, bool vector)
+	{
+#if defined(SOUNDMIX_SSE) || defined(SOUNDMIX_NEON)
+		if (vector) {
+			if (ramp.IsRamping())
+				MixVector<T_channels, T_upsample, true>(out, in, frames, ramp);
+			else
+				MixVector<T_channels, T_upsample, false>(out, in, frames, ramp);
+			return;
+		}
+#endif
+		MixScalar<T_channels, T_upsample>(out, in, 0, frames, ramp);
+	}
+
+	void Mix(float *out, const Sint16 *in, Uint32 frames, int channels, int upsample,
+		float volume[2], const float targetVolume[2], const float rateOfChange[2], bool vector)
+	{
+		const Ramp ramp(volume, targetVolume, rateOfChange);
+		if (ramp.IsAudible()) {
+			if (channels == 1) {
+				if (upsample == 1)
+					MixFrames<1, 1>(out, in, frames, ramp, vector);
+				else
+					MixFrames<1, 2>(out, in, frames, ramp, vector);
+			} else {
+				if (upsample == 1)
+					MixFrames<2, 1>(out, in, frames, ramp, vector);
+				else
+					MixFrames<2, 2>(out, in, frames, ramp, vector);
+			}
+		}
+		volume[0] = ramp.Volume(0, float(frames));
+		volume[1] = ramp.Volume(1, float(frames));
+	}
+} // namespace
+
+namespace Sound {
+
+	void MixVoice(float *out, const Sint16 *in, Uint32 frames, int channels, int upsample,
+		float volume[2], const float targetVolume[2], const float rateOfChange[2])
+	{
+		Mix(out, in, frames, channels, upsample, volume, targetVolume, rateOfChange, true);
+	}
+
+	void MixVoiceScalar(float *out, const Sint16 *in, Uint32 frames, int channels, int upsample,
+		float volume[2], const float targetVolume[2], const float rateOfChange[2])
+	{
+		Mix(out, in, frames, channels, upsample, volume, targetVolume, rateOfChange, false);
+	}
+
+	const char *GetMixKernelName()
+	{
+#if defined(SOUNDMIX_SSE)
+		return "SSE2";
+#elif defined(SOUNDMIX_NEON)
+		return "NEON";
+#else
+		return "scalar";
+#endif
+	}
+
+} // namespace Sound
@@ -0,0 +1,34 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SOUNDMIX_H
+#define _SOUNDMIX_H
+
+#include "SDL_stdinc.h"
+
+/*
+ * The mixing kernel of the sound system: adds a run of one voice to the
+ * interleaved stereo float buffer the mixer builds.
+ *
+ * The input is 16-bit mono or stereo, played at the output rate or at half
+ * of it (each frame written twice). The left and right volumes change by
+ * rateOfChange per input frame towards their targets, without going past
+ * them, and are left where the run ends them.
+ *
+ * MixVoice uses SSE2 or AArch64 NEON where the build targets them, and the
+ * scalar kernel otherwise; they differ only by float rounding. A voice that
+ * is too quiet to change the output at all is skipped.
+ */
+namespace Sound {
+
+	void MixVoice(float *out, const Sint16 *in, Uint32 frames, int channels, int upsample,
+		float volume[2], const float targetVolume[2], const float rateOfChange[2]);
+
+	void MixVoiceScalar(float *out, const Sint16 *in, Uint32 frames, int channels, int upsample,
+		float volume[2], const float targetVolume[2], const float rateOfChange[2]);
+
+	const char *GetMixKernelName();
+
+} // namespace Sound
+
+#endif /* _SOUNDMIX_H */
@@ -46,6 +46,11 @@ public:
 	virtual double GetHeight(const vector3d &p) const = 0;
 	virtual vector3d GetColor(const vector3d &p, double height, const vector3d &norm) const = 0;
 
+	// Evaluate many points with a single virtual call: heights[i] = GetHeight(p[i]) and
+	// colors[i] = GetColor(p[i], heights[i], norms[i]). Patch generation uses these.
+	virtual void GetHeights(const vector3d *p, double *heights, size_t count) const = 0;
+	virtual void GetColors(const vector3d *p, const double *heights, const vector3d *norms, vector3d *colors, size_t count) const = 0;
+
 	virtual const char *GetHeightFractalName() const = 0;
 	virtual const char *GetColorFractalName() const = 0;
 
@@ -127,6 +132,14 @@ public:
 	virtual double GetHeight(const vector3d &p) const;
 	virtual const char *GetHeightFractalName() const;
 
+	// Calls this fractal's GetHeight directly; the busiest fractals specialize it
+	// with an implementation built on the batched TerrainNoise functions
+	virtual void GetHeights(const vector3d *p, double *heights, size_t count) const
+	{
+		for (size_t i = 0; i < count; i++)
+			heights[i] = TerrainHeightFractal::GetHeight(p[i]);
+	}
+
 protected:
 	TerrainHeightFractal(const SystemBody *body);
 
@@ -140,6 +153,12 @@ public:
 	virtual vector3d GetColor(const vector3d &p, double height, const vector3d &norm) const;
 	virtual const char *GetColorFractalName() const;
 
+	virtual void GetColors(const vector3d *p, const double *heights, const vector3d *norms, vector3d *colors, size_t count) const
+	{
+		for (size_t i = 0; i < count; i++)
+			colors[i] = TerrainColorFractal::GetColor(p[i], heights[i], norms[i]);
+	}
+
 protected:
 	TerrainColorFractal(const SystemBody *body);
 
@@ -222,6 +241,14 @@ only terrain to use the much neglected impact crater function
 class TerrainHeightWaterSolidCanyons;
 class TerrainHeightWaterSolid;
 
+// fractals with batched GetHeights implementations
+template <>
+void TerrainHeightFractal<TerrainHeightAsteroid4>::GetHeights(const vector3d *p, double *heights, size_t count) const;
+template <>
+void TerrainHeightFractal<TerrainHeightHillsNormal>::GetHeights(const vector3d *p, double *heights, size_t count) const;
+template <>
+void TerrainHeightFractal<TerrainHeightMountainsRidged>::GetHeights(const vector3d *p, double *heights, size_t count) const;
+
 class TerrainColorAsteroid;
 class TerrainColorBandedRock;
 class TerrainColorBlack;
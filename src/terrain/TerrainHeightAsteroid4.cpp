@@ -33,3 +33,39 @@ double TerrainHeightFractal<TerrainHeightAsteroid4>::GetHeight(const vector3d &p
 
 	return (n > 0.0 ? m_maxHeight * n : 0.0);
 }
+
+template <>
+void TerrainHeightFractal<TerrainHeightAsteroid4>::GetHeights(const vector3d *p, double *heights, size_t count) const
+{
+	// the same steps as GetHeight, one noise function at a time over all points
+	for (size_t start = 0; start < count; start += NOISE_BATCH) {
+		const size_t num = std::min(NOISE_BATCH, count - start);
+		const vector3d *pos = p + start;
+
+		double persistence[NOISE_BATCH], lacunarity[NOISE_BATCH], shape[NOISE_BATCH], ridges[NOISE_BATCH];
+		int octaves[NOISE_BATCH];
+
+		octavenoise(GetFracDef(0), 0.3, pos, persistence, num);
+		ridged_octavenoise(GetFracDef(1), 0.5, pos, lacunarity, num);
+		for (size_t i = 0; i < num; i++) {
+			persistence[i] *= 0.2;
+			lacunarity[i] *= 2.8;
+		}
+		octavenoise(6, persistence, lacunarity, pos, shape, num);
+
+		octavenoise(GetFracDef(2), 0.275, pos, ridges, num);
+		octavenoise(GetFracDef(3), 0.4, pos, persistence, num);
+		ridged_octavenoise(GetFracDef(4), 0.35, pos, lacunarity, num);
+		for (size_t i = 0; i < num; i++) {
+			octaves[i] = int(16 * ridges[i]);
+			persistence[i] *= 0.3;
+			lacunarity[i] *= 2.8;
+		}
+		ridged_octavenoise(octaves, persistence, lacunarity, pos, ridges, num);
+
+		for (size_t i = 0; i < num; i++) {
+			const double n = shape[i] * 0.75 * ridges[i];
+			heights[start + i] = n > 0.0 ? m_maxHeight * n : 0.0;
+		}
+	}
+}
@@ -50,3 +50,65 @@ double TerrainHeightFractal<TerrainHeightHillsNormal>::GetHeight(const vector3d
 	if (n > 0.0) return n * m_maxHeight;
 	return 0.0;
 }
+
+template <>
+void TerrainHeightFractal<TerrainHeightHillsNormal>::GetHeights(const vector3d *p, double *heights, size_t count) const
+{
+	// the same steps as GetHeight, one noise function at a time over all
+	// points, only keeping the points with land for everything after the
+	// continents
+	for (size_t start = 0; start < count; start += NOISE_BATCH) {
+		const size_t num = std::min(NOISE_BATCH, count - start);
+
+		double continents[NOISE_BATCH];
+		octavenoise(GetFracDef(3), 0.65, p + start, continents, num);
+
+		vector3d land[NOISE_BATCH];
+		size_t index[NOISE_BATCH];
+		size_t numLand = 0;
+		for (size_t i = 0; i < num; i++) {
+			continents[numLand] = continents[i] * (1.0 - m_sealevel) - (m_sealevel * 0.1);
+			heights[start + i] = 0.0;
+			if (continents[numLand] < 0) continue;
+			land[numLand] = p[start + i];
+			index[numLand++] = start + i;
+		}
+
+		double distrib[NOISE_BATCH], persistence[NOISE_BATCH], value[NOISE_BATCH], m[NOISE_BATCH];
+		octavenoise(GetFracDef(4), 0.5, land, distrib, numLand);
+		for (size_t i = 0; i < numLand; i++) {
+			distrib[i] *= distrib[i];
+			persistence[i] = 0.55 * distrib[i];
+		}
+
+		octavenoise(GetFracDef(4), persistence, land, m, numLand);
+		billow_octavenoise(GetFracDef(5), persistence, land, value, numLand);
+		for (size_t i = 0; i < numLand; i++) {
+			m[i] = 0.5 * GetFracDef(3).amplitude * m[i] * GetFracDef(5).amplitude;
+			m[i] += 0.25 * value[i];
+			persistence[i] = 0.6 * (1.0 - distrib[i]);
+		}
+
+		//hill footings
+		octavenoise(GetFracDef(2), persistence, land, value, numLand);
+		for (size_t i = 0; i < numLand; i++) {
+			m[i] -= value[i] * Clamp(0.05 - m[i], 0.0, 0.05) * Clamp(0.05 - m[i], 0.0, 0.05);
+			persistence[i] = 0.765 * distrib[i];
+		}
+
+		//hill footings
+		voronoiscam_octavenoise(GetFracDef(6), persistence, land, value, numLand);
+		for (size_t i = 0; i < numLand; i++) {
+			m[i] += value[i] * Clamp(0.025 - m[i], 0.0, 0.025) * Clamp(0.025 - m[i], 0.0, 0.025);
+
+			double n = continents[i];
+			// cliffs at shore
+			if (continents[i] < 0.01)
+				n += m[i] * continents[i] * 100.0f;
+			else
+				n += m[i];
+
+			heights[index[i]] = n > 0.0 ? n * m_maxHeight : 0.0;
+		}
+	}
+}
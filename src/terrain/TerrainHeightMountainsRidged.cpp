@@ -82,3 +82,84 @@ double TerrainHeightFractal<TerrainHeightMountainsRidged>::GetHeight(const vecto
 	n = m_maxHeight * n;
 	return (n > 0.0 ? n : 0.0);
 }
+
+template <>
+void TerrainHeightFractal<TerrainHeightMountainsRidged>::GetHeights(const vector3d *p, double *heights, size_t count) const
+{
+	// the same steps as GetHeight, one noise function at a time over all
+	// points, only keeping the points with land for everything after the
+	// continents
+	for (size_t start = 0; start < count; start += NOISE_BATCH) {
+		const size_t num = std::min(NOISE_BATCH, count - start);
+
+		double continents[NOISE_BATCH];
+		octavenoise(GetFracDef(0), 0.5, p + start, continents, num);
+
+		vector3d land[NOISE_BATCH];
+		size_t index[NOISE_BATCH];
+		size_t numLand = 0;
+		for (size_t i = 0; i < num; i++) {
+			continents[numLand] = continents[i] - m_sealevel;
+			heights[start + i] = 0.0;
+			if (continents[numLand] < 0) continue;
+			land[numLand] = p[start + i];
+			index[numLand++] = start + i;
+		}
+
+		double mountains[NOISE_BATCH], mountains2[NOISE_BATCH], hill_distrib[NOISE_BATCH], hill2_distrib[NOISE_BATCH];
+		double hills[NOISE_BATCH], hills2[NOISE_BATCH], hills3[NOISE_BATCH], hills4[NOISE_BATCH], mountain_distrib[NOISE_BATCH];
+		octavenoise(GetFracDef(2), 0.5, land, mountains, numLand);
+		ridged_octavenoise(GetFracDef(3), 0.5, land, mountains2, numLand);
+		octavenoise(GetFracDef(4), 0.5, land, hill_distrib, numLand);
+		ridged_octavenoise(GetFracDef(5), 0.5, land, hills, numLand);
+		octavenoise(GetFracDef(6), 0.5, land, hills2, numLand);
+		octavenoise(GetFracDef(7), 0.5, land, hill2_distrib, numLand);
+		ridged_octavenoise(GetFracDef(8), 0.5, land, hills3, numLand);
+		ridged_octavenoise(GetFracDef(9), 0.5, land, hills4, numLand);
+		octavenoise(GetFracDef(1), 0.5, land, mountain_distrib, numLand);
+
+		for (size_t i = 0; i < numLand; i++) {
+			hills[i] = hill_distrib[i] * GetFracDef(5).amplitude * hills[i];
+			hills2[i] = hill_distrib[i] * GetFracDef(6).amplitude * hills2[i];
+			hills3[i] = hill2_distrib[i] * GetFracDef(8).amplitude * hills3[i];
+			hills4[i] = hill2_distrib[i] * GetFracDef(9).amplitude * hills4[i];
+
+			double n = continents[i] - (GetFracDef(0).amplitude * m_sealevel);
+
+			if (n > 0.0) {
+				// smooth in hills at shore edges
+				if (n < 0.1)
+					n += hills[i] * n * 10.0f;
+				else
+					n += hills[i];
+				if (n < 0.05)
+					n += hills2[i] * n * 20.0f;
+				else
+					n += hills2[i];
+
+				if (n < 0.1)
+					n += hills3[i] * n * 10.0f;
+				else
+					n += hills3[i];
+				if (n < 0.05)
+					n += hills4[i] * n * 20.0f;
+				else
+					n += hills4[i];
+
+				// GetHeight evaluates the fracdef 4 octaves a second time here
+				const double m = mountain_distrib[i] *
+					GetFracDef(2).amplitude * mountains[i] * mountains[i] * mountains[i];
+				const double m2 = hill_distrib[i] *
+					GetFracDef(3).amplitude * mountains2[i] * mountains2[i] * mountains2[i] * mountains2[i];
+				if (n > 0.2) n += m2 * (n - 0.2);
+				if (n < 0.2)
+					n += m * n * 5.0f;
+				else
+					n += m;
+			}
+
+			n = m_maxHeight * n;
+			heights[index[i]] = n > 0.0 ? n : 0.0;
+		}
+	}
+}
@@ -7,48 +7,88 @@
 #include "perlin.h"
 #include "MathUtil.h"
 
+#include <algorithm>
+#include <array>
+#include <utility>
+
 namespace TerrainNoise {
 
+	namespace detail {
+		// sum of Octaves octaves of noise(frequency * p), scaled by amplitude,
+		// with fabs() applied to each octave if Abs is set. With the octave
+		// count known at compile time the loop can be fully unrolled.
+		template <int Octaves, bool Abs>
+		inline double octave_sum_n(const fracdef_t &def, const double persistence, const vector3d &p)
+		{
+			double n = 0;
+			double amplitude = persistence;
+			double frequency = def.frequency;
+			for (int i = 0; i < Octaves; i++) {
+				n += amplitude * (Abs ? fabs(noise(frequency * p)) : noise(frequency * p));
+				amplitude *= persistence;
+				frequency *= def.lacunarity;
+			}
+			return n;
+		}
+
+		// the same for any number of octaves
+		template <bool Abs>
+		inline double octave_sum_any(const fracdef_t &def, const double persistence, const vector3d &p)
+		{
+			double n = 0;
+			double amplitude = persistence;
+			double frequency = def.frequency;
+			for (int i = 0; i < def.octaves; i++) {
+				n += amplitude * (Abs ? fabs(noise(frequency * p)) : noise(frequency * p));
+				amplitude *= persistence;
+				frequency *= def.lacunarity;
+			}
+			return n;
+		}
+
+		// the octave counts Terrain::SetFracDef usually picks get their own
+		// unrolled sum; with its lacunarity of 2, 16 octaves cover features
+		// up to 65536 times the size of their smallest detail
+		static constexpr int MAX_SPECIALISED_OCTAVES = 16;
+
+		using OctaveSumFn = double (*)(const fracdef_t &, double, const vector3d &);
+
+		template <bool Abs, int... Octaves>
+		constexpr std::array<OctaveSumFn, sizeof...(Octaves)> make_octave_sums(std::integer_sequence<int, Octaves...>)
+		{
+			return { { &octave_sum_n<Octaves, Abs>... } };
+		}
+
+		template <bool Abs>
+		inline double octave_sum(const fracdef_t &def, const double persistence, const vector3d &p)
+		{
+			static constexpr std::array<OctaveSumFn, MAX_SPECIALISED_OCTAVES + 1> sums =
+				make_octave_sums<Abs>(std::make_integer_sequence<int, MAX_SPECIALISED_OCTAVES + 1>());
+			if (def.octaves >= 0 && def.octaves <= MAX_SPECIALISED_OCTAVES)
+				return sums[def.octaves](def, persistence, p);
+			return octave_sum_any<Abs>(def, persistence, p);
+		}
+	} // namespace detail
+
 	// octavenoise functions return range [0,1] if persistence = 0.5
 	inline double octavenoise(const fracdef_t &def, const double persistence, const vector3d &p)
 	{
 		//assert(persistence <= (1.0 / def.lacunarity));
-		double n = 0;
-		double amplitude = persistence;
-		double frequency = def.frequency;
-		for (int i = 0; i < def.octaves; i++) {
-			n += amplitude * noise(frequency * p);
-			amplitude *= persistence;
-			frequency *= def.lacunarity;
-		}
+		const double n = detail::octave_sum<false>(def, persistence, p);
 		return (n + 1.0) * 0.5;
 	}
 
 	inline double river_octavenoise(const fracdef_t &def, const double persistence, const vector3d &p)
 	{
 		//assert(persistence <= (1.0 / def.lacunarity));
-		double n = 0;
-		double amplitude = persistence;
-		double frequency = def.frequency;
-		for (int i = 0; i < def.octaves; i++) {
-			n += amplitude * fabs(noise(frequency * p));
-			amplitude *= persistence;
-			frequency *= def.lacunarity;
-		}
+		const double n = detail::octave_sum<true>(def, persistence, p);
 		return fabs(n);
 	}
 
 	inline double ridged_octavenoise(const fracdef_t &def, const double persistence, const vector3d &p)
 	{
 		//assert(persistence <= (1.0 / def.lacunarity));
-		double n = 0;
-		double amplitude = persistence;
-		double frequency = def.frequency;
-		for (int i = 0; i < def.octaves; i++) {
-			n += amplitude * noise(frequency * p);
-			amplitude *= persistence;
-			frequency *= def.lacunarity;
-		}
+		double n = detail::octave_sum<false>(def, persistence, p);
 		n = 1.0 - fabs(n);
 		n *= n;
 		return n;
@@ -57,42 +97,21 @@ namespace TerrainNoise {
 	inline double billow_octavenoise(const fracdef_t &def, const double persistence, const vector3d &p)
 	{
 		//assert(persistence <= (1.0 / def.lacunarity));
-		double n = 0;
-		double amplitude = persistence;
-		double frequency = def.frequency;
-		for (int i = 0; i < def.octaves; i++) {
-			n += amplitude * noise(frequency * p);
-			amplitude *= persistence;
-			frequency *= def.lacunarity;
-		}
+		const double n = detail::octave_sum<false>(def, persistence, p);
 		return (2.0 * fabs(n) - 1.0) + 1.0;
 	}
 
 	inline double voronoiscam_octavenoise(const fracdef_t &def, const double persistence, const vector3d &p)
 	{
 		//assert(persistence <= (1.0 / def.lacunarity));
-		double n = 0;
-		double amplitude = persistence;
-		double frequency = def.frequency;
-		for (int i = 0; i < def.octaves; i++) {
-			n += amplitude * noise(frequency * p);
-			amplitude *= persistence;
-			frequency *= def.lacunarity;
-		}
+		const double n = detail::octave_sum<false>(def, persistence, p);
 		return sqrt(10.0 * fabs(n));
 	}
 
 	inline double dunes_octavenoise(const fracdef_t &def, const double persistence, const vector3d &p)
 	{
 		//assert(persistence <= (1.0 / def.lacunarity));
-		double n = 0;
-		double amplitude = persistence;
-		double frequency = def.frequency;
-		for (int i = 0; i < 3; i++) {
-			n += amplitude * noise(frequency * p);
-			amplitude *= persistence;
-			frequency *= def.lacunarity;
-		}
+		const double n = detail::octave_sum_n<3, false>(def, persistence, p);
 		return 1.0 - fabs(n);
 	}
 
@@ -169,6 +188,119 @@ namespace TerrainNoise {
 		return sqrt(10.0 * fabs(n));
 	}
 
+	// Batched versions of the octave noise functions above, computing the
+	// same values for count points at once: out[i] belongs to p[i].
+	// Persistence (and for the fracdef-less versions octaves and lacunarity)
+	// can be given per point, since the fractals often derive it from
+	// another noise value. Points are processed NOISE_BATCH at a time using
+	// stack buffers, so any count works without allocating.
+	static constexpr size_t NOISE_BATCH = 64;
+
+	namespace detail {
+		// parameters of an octave sum, either one value for all points or one per point
+		struct OctaveParams {
+			int octaves;
+			const int *octavesPerPoint;
+			double persistence;
+			const double *persistencePerPoint;
+			double frequency;
+			double lacunarity;
+			const double *lacunarityPerPoint;
+		};
+
+		// n[i] = sum over the octaves of point i of amplitude * noise(frequency * p[i]),
+		// with fabs() applied to each octave if Abs is set
+		template <bool Abs>
+		inline void octave_sum(const OctaveParams &params, size_t start, const vector3d *p, double *n, size_t count)
+		{
+			double amplitude[NOISE_BATCH], persistence[NOISE_BATCH], lacunarity[NOISE_BATCH], frequency[NOISE_BATCH], value[NOISE_BATCH];
+			int maxOctaves = params.octaves;
+			for (size_t i = 0; i < count; i++) {
+				n[i] = 0.0;
+				persistence[i] = params.persistencePerPoint ? params.persistencePerPoint[start + i] : params.persistence;
+				lacunarity[i] = params.lacunarityPerPoint ? params.lacunarityPerPoint[start + i] : params.lacunarity;
+				amplitude[i] = persistence[i];
+				frequency[i] = params.frequency;
+				if (params.octavesPerPoint)
+					maxOctaves = std::max(maxOctaves, params.octavesPerPoint[start + i]);
+			}
+
+			for (int octave = 0; octave < maxOctaves; octave++) {
+				noise(p, frequency, value, count);
+				for (size_t i = 0; i < count; i++) {
+					const int octaves = params.octavesPerPoint ? params.octavesPerPoint[start + i] : params.octaves;
+					if (octave < octaves)
+						n[i] += amplitude[i] * (Abs ? fabs(value[i]) : value[i]);
+					amplitude[i] *= persistence[i];
+					frequency[i] *= lacunarity[i];
+				}
+			}
+		}
+
+		// Run octave_sum over all points, NOISE_BATCH at a time, then map each sum with finish()
+		template <bool Abs, typename Finish>
+		inline void octave_noise(const OctaveParams &params, const vector3d *p, double *out, size_t count, Finish finish)
+		{
+			for (size_t start = 0; start < count; start += NOISE_BATCH) {
+				const size_t num = std::min(NOISE_BATCH, count - start);
+				octave_sum<Abs>(params, start, p + start, out + start, num);
+				for (size_t i = start; i < start + num; i++)
+					out[i] = finish(out[i]);
+			}
+		}
+
+		inline OctaveParams fracdef_params(const fracdef_t &def, double persistence, const double *persistencePerPoint)
+		{
+			return { def.octaves, nullptr, persistence, persistencePerPoint, def.frequency, def.lacunarity, nullptr };
+		}
+	} // namespace detail
+
+	inline void octavenoise(const fracdef_t &def, const double persistence, const vector3d *p, double *out, size_t count)
+	{
+		detail::octave_noise<false>(detail::fracdef_params(def, persistence, nullptr), p, out, count, [](double n) { return (n + 1.0) * 0.5; });
+	}
+
+	inline void octavenoise(const fracdef_t &def, const double *persistence, const vector3d *p, double *out, size_t count)
+	{
+		detail::octave_noise<false>(detail::fracdef_params(def, 0.0, persistence), p, out, count, [](double n) { return (n + 1.0) * 0.5; });
+	}
+
+	inline void river_octavenoise(const fracdef_t &def, const double persistence, const vector3d *p, double *out, size_t count)
+	{
+		detail::octave_noise<true>(detail::fracdef_params(def, persistence, nullptr), p, out, count, [](double n) { return fabs(n); });
+	}
+
+	inline void ridged_octavenoise(const fracdef_t &def, const double persistence, const vector3d *p, double *out, size_t count)
+	{
+		detail::octave_noise<false>(detail::fracdef_params(def, persistence, nullptr), p, out, count, [](double n) {
+			n = 1.0 - fabs(n);
+			return n * n;
+		});
+	}
+
+	inline void billow_octavenoise(const fracdef_t &def, const double *persistence, const vector3d *p, double *out, size_t count)
+	{
+		detail::octave_noise<false>(detail::fracdef_params(def, 0.0, persistence), p, out, count, [](double n) { return (2.0 * fabs(n) - 1.0) + 1.0; });
+	}
+
+	inline void voronoiscam_octavenoise(const fracdef_t &def, const double *persistence, const vector3d *p, double *out, size_t count)
+	{
+		detail::octave_noise<false>(detail::fracdef_params(def, 0.0, persistence), p, out, count, [](double n) { return sqrt(10.0 * fabs(n)); });
+	}
+
+	inline void octavenoise(int octaves, const double *persistence, const double *lacunarity, const vector3d *p, double *out, size_t count)
+	{
+		detail::octave_noise<false>({ octaves, nullptr, 0.0, persistence, 1.0, 0.0, lacunarity }, p, out, count, [](double n) { return (n + 1.0) * 0.5; });
+	}
+
+	inline void ridged_octavenoise(const int *octaves, const double *persistence, const double *lacunarity, const vector3d *p, double *out, size_t count)
+	{
+		detail::octave_noise<false>({ 0, octaves, 0.0, persistence, 1.0, 0.0, lacunarity }, p, out, count, [](double n) {
+			n = 1.0 - fabs(n);
+			return n * n;
+		});
+	}
+
 	// not really a noise function but no better place for it
 	inline vector3d interpolate_color(const double n, const vector3d &start, const vector3d &end)
 	{
@@ -0,0 +1,124 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "collider/BVHTree.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "doctest.h"
+
+using Intersection = std::pair<uint32_t, uint32_t>;
+
+static AABBd MakeAabb(const vector3d &pos, double radius)
+{
+	return AABBd{ { pos - radius }, { pos + radius } };
+}
+
+static std::vector<Intersection> ComputeAllOverlaps(const SingleBVHTree &tree, const std::vector<AABBd> &aabbs)
+{
+	std::vector<Intersection> isect;
+	for (uint32_t idx = 0; idx < aabbs.size(); idx++)
+		tree.ComputeOverlap(idx, aabbs[idx], isect);
+
+	std::sort(isect.begin(), isect.end());
+	return isect;
+}
+
+TEST_CASE("SingleBVHTree Refit")
+{
+	static constexpr uint32_t NUM_OBJECTS = 500;
+
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<double> pos(-1000.0, 1000.0);
+	std::uniform_real_distribution<double> step(-20.0, 20.0);
+
+	std::vector<vector3d> positions;
+	std::vector<AABBd> aabbs;
+	AABBd bounds = AABBd::Invalid();
+	for (uint32_t idx = 0; idx < NUM_OBJECTS; idx++) {
+		positions.emplace_back(pos(rng), pos(rng), pos(rng));
+		aabbs.push_back(MakeAabb(positions.back(), 25.0));
+		bounds.Update(aabbs.back());
+	}
+
+	SingleBVHTree tree;
+	tree.Build(bounds, aabbs.data(), aabbs.size());
+	CHECK(tree.GetAreaGrowth() == doctest::Approx(1.0));
+
+	// move every object a little and refit the tree
+	for (uint32_t round = 0; round < 10; round++) {
+		bounds = AABBd::Invalid();
+		for (uint32_t idx = 0; idx < NUM_OBJECTS; idx++) {
+			positions[idx] += vector3d(step(rng), step(rng), step(rng));
+			aabbs[idx] = MakeAabb(positions[idx], 25.0);
+			bounds.Update(aabbs[idx]);
+		}
+
+		tree.Refit(aabbs.data());
+
+		// a refit tree must find exactly the same overlaps as a fresh one
+		std::vector<AABBd> buildAabbs = aabbs;
+		SingleBVHTree fresh;
+		fresh.Build(bounds, buildAabbs.data(), buildAabbs.size());
+
+		CHECK(ComputeAllOverlaps(tree, aabbs) == ComputeAllOverlaps(fresh, aabbs));
+	}
+
+	// the tree loosens as objects move away from where it was built
+	CHECK(tree.GetAreaGrowth() > 1.0);
+}
+
+TEST_CASE("SingleBVHTree TraceRays")
+{
+	static constexpr uint32_t NUM_OBJECTS = 300;
+	static constexpr uint32_t NUM_RAYS = 200;
+
+	std::mt19937 rng(9876);
+	std::uniform_real_distribution<double> pos(-1000.0, 1000.0);
+	std::uniform_real_distribution<double> unit(-1.0, 1.0);
+
+	std::vector<AABBd> aabbs;
+	AABBd bounds = AABBd::Invalid();
+	for (uint32_t idx = 0; idx < NUM_OBJECTS; idx++) {
+		aabbs.push_back(MakeAabb(vector3d(pos(rng), pos(rng), pos(rng)), 40.0));
+		bounds.Update(aabbs.back());
+	}
+
+	SingleBVHTree tree;
+	tree.Build(bounds, aabbs.data(), aabbs.size());
+
+	std::vector<vector3d> starts, invDirs;
+	std::vector<double> lens;
+	std::vector<uint32_t> rayIdx;
+	for (uint32_t idx = 0; idx < NUM_RAYS; idx++) {
+		vector3d dir = vector3d(unit(rng), unit(rng), unit(rng)).Normalized();
+		starts.emplace_back(pos(rng), pos(rng), pos(rng));
+		invDirs.emplace_back(1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z);
+		lens.push_back(1500.0);
+		rayIdx.push_back(idx);
+	}
+
+	// trace the rays in an arbitrary order
+	std::shuffle(rayIdx.begin(), rayIdx.end(), rng);
+
+	std::vector<Intersection> packetHits;
+	tree.TraceRays(NUM_RAYS, rayIdx.data(), starts.data(), invDirs.data(), lens.data(), packetHits);
+
+	size_t numHits = 0;
+	for (uint32_t ray = 0; ray < NUM_RAYS; ray++) {
+		std::vector<uint32_t> single;
+		tree.TraceRay(starts[ray], invDirs[ray], lens[ray], single);
+
+		std::vector<uint32_t> packet;
+		for (const Intersection &hit : packetHits)
+			if (hit.first == ray)
+				packet.push_back(hit.second);
+
+		// same leaves, in the same order
+		CHECK(packet == single);
+		numHits += single.size();
+	}
+
+	CHECK(numHits > 0);
+}
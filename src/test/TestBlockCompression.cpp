@@ -0,0 +1,162 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "graphics/BlockCompression.h"
+
+#include "doctest.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace Graphics;
+
+namespace {
+	void expand_565(uint16_t c, int *rgb)
+	{
+		const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// decode the colour half of a block in four colour mode
+	void decode_colour(const uint8_t *in, uint8_t *rgba)
+	{
+		int palette[4][3];
+		expand_565(in[0] | (in[1] << 8), palette[0]);
+		expand_565(in[2] | (in[3] << 8), palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		const uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | (uint32_t(in[7]) << 24);
+		for (int i = 0; i < 16; i++) {
+			const int index = (bits >> (i * 2)) & 3;
+			for (int c = 0; c < 3; c++)
+				rgba[i * 4 + c] = palette[index][c];
+		}
+	}
+
+	void decode_alpha(const uint8_t *in, uint8_t *rgba)
+	{
+		int palette[8] = { in[0], in[1] };
+		for (int i = 1; i < 7; i++)
+			palette[i + 1] = ((7 - i) * in[0] + i * in[1]) / 7;
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; i++)
+			bits |= uint64_t(in[2 + i]) << (i * 8);
+		for (int i = 0; i < 16; i++)
+			rgba[i * 4 + 3] = palette[(bits >> (i * 3)) & 7];
+	}
+
+	int max_error(const uint8_t *a, const uint8_t *b, int channels)
+	{
+		int error = 0;
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < channels; c++)
+				error = std::max(error, std::abs(int(a[i * 4 + c]) - int(b[i * 4 + c])));
+		return error;
+	}
+} // namespace
+
+TEST_CASE("Block Compression")
+{
+	uint8_t block[64], decoded[64], compressed[16];
+
+	SUBCASE("Solid blocks")
+	{
+		for (int i = 0; i < 16; i++) {
+			block[i * 4 + 0] = 200;
+			block[i * 4 + 1] = 100;
+			block[i * 4 + 2] = 50;
+			block[i * 4 + 3] = 255;
+		}
+		BlockCompression::CompressBlockDXT1(block, compressed);
+		decode_colour(compressed, decoded);
+		// within the precision of 565
+		CHECK(max_error(block, decoded, 3) <= 4);
+	}
+
+	SUBCASE("Gradients along one axis are nearly exact")
+	{
+		for (int i = 0; i < 16; i++) {
+			block[i * 4 + 0] = 16 * i;
+			block[i * 4 + 1] = 255 - 16 * i;
+			block[i * 4 + 2] = 8 * i;
+			block[i * 4 + 3] = 17 * i;
+		}
+		BlockCompression::CompressBlockDXT5(block, compressed);
+		decode_alpha(compressed, decoded);
+		decode_colour(compressed + 8, decoded);
+		CHECK(max_error(block, decoded, 3) <= 40);
+		int alphaError = 0;
+		for (int i = 0; i < 16; i++)
+			alphaError = std::max(alphaError, std::abs(int(block[i * 4 + 3]) - int(decoded[i * 4 + 3])));
+		CHECK(alphaError <= 19);
+
+		// endpoints are ordered for four colour mode
+		CHECK((compressed[8] | (compressed[9] << 8)) >= (compressed[10] | (compressed[11] << 8)));
+	}
+
+	SUBCASE("Two colour blocks are exact")
+	{
+		for (int i = 0; i < 16; i++) {
+			const bool black = (i * 7) % 3 == 0;
+			block[i * 4 + 0] = black ? 0 : 255;
+			block[i * 4 + 1] = black ? 0 : 255;
+			block[i * 4 + 2] = black ? 0 : 255;
+			block[i * 4 + 3] = black ? 0 : 255;
+		}
+		BlockCompression::CompressBlockDXT5(block, compressed);
+		decode_alpha(compressed, decoded);
+		decode_colour(compressed + 8, decoded);
+		CHECK(max_error(block, decoded, 4) == 0);
+	}
+
+	SUBCASE("Images and their mips")
+	{
+		const uint32_t width = 64, height = 32;
+		std::vector<uint8_t> image(width * height * 3);
+		for (uint32_t y = 0; y < height; y++)
+			for (uint32_t x = 0; x < width; x++) {
+				image[(y * width + x) * 3 + 0] = x * 4;
+				image[(y * width + x) * 3 + 1] = y * 8;
+				image[(y * width + x) * 3 + 2] = 128;
+			}
+
+		CHECK(BlockCompression::ChooseFormat(image.data(), width, height, width * 3, 3) == TEXTURE_DXT1);
+
+		std::vector<uint8_t> out;
+		const uint32_t numMips = BlockCompression::CompressImage(image.data(), width, height, width * 3, 3, TEXTURE_DXT1, true, out);
+		CHECK(numMips == 7);
+		// 64x32 down to 1x1, with a block for each mip smaller than one
+		CHECK(out.size() == (128 + 32 + 8 + 2 + 1 + 1 + 1) * 8);
+		CHECK(out.size() == BlockCompression::GetCompressedSize(TEXTURE_DXT1, width, height, numMips));
+
+		CHECK(BlockCompression::CompressImage(image.data(), width, height, width * 3, 3, TEXTURE_DXT1, false, out) == 1);
+		CHECK(out.size() == 128 * 8);
+
+		// the top mip decodes close to the source; a gradient in two
+		// directions isn't on a line, so some pixels are further off
+		int error = 0;
+		double sumSq = 0.0;
+		for (uint32_t by = 0; by < height / 4; by++)
+			for (uint32_t bx = 0; bx < width / 4; bx++) {
+				decode_colour(&out[(by * (width / 4) + bx) * 8], decoded);
+				for (int i = 0; i < 16; i++)
+					for (int c = 0; c < 3; c++) {
+						const uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+						const int d = int(image[(y * width + x) * 3 + c]) - int(decoded[i * 4 + c]);
+						error = std::max(error, std::abs(d));
+						sumSq += d * d;
+					}
+			}
+		CHECK(error <= 16);
+		CHECK(std::sqrt(sumSq / (width * height * 3)) < 4.0);
+
+		std::vector<uint8_t> rgba(width * height * 4, 255);
+		CHECK(BlockCompression::ChooseFormat(rgba.data(), width, height, width * 4, 4) == TEXTURE_DXT1);
+		rgba[4 * 100 + 3] = 254;
+		CHECK(BlockCompression::ChooseFormat(rgba.data(), width, height, width * 4, 4) == TEXTURE_DXT5);
+	}
+}
@@ -0,0 +1,72 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "BodyPool.h"
+
+#include "doctest.h"
+
+#include <set>
+
+TEST_CASE("Body Pool")
+{
+	BodyPool pool("Test", 200, alignof(double));
+
+	SUBCASE("Slots are reused last in, first out")
+	{
+		std::set<void *> slots;
+		std::vector<void *> live;
+		for (int i = 0; i < 100; i++) {
+			live.push_back(pool.Allocate(200));
+			slots.insert(live.back());
+		}
+		CHECK(slots.size() == 100);
+
+		BodyPool::Stats stats = pool.GetStats();
+		CHECK(stats.numInUse == 100);
+		CHECK(stats.highWater == 100);
+		CHECK(stats.numSlots >= 100);
+		CHECK(stats.slotSize >= 200);
+
+		void *last = live.back();
+		pool.Free(last, 200);
+		live.pop_back();
+		CHECK(pool.Allocate(200) == last);
+		live.push_back(last);
+
+		// churning through bodies doesn't grow the pool
+		const size_t numChunks = pool.GetStats().numChunks;
+		for (int i = 0; i < 1000; i++) {
+			pool.Free(live[i % live.size()], 200);
+			live[i % live.size()] = pool.Allocate(200);
+		}
+		stats = pool.GetStats();
+		CHECK(stats.numChunks == numChunks);
+		CHECK(stats.numInUse == 100);
+
+		for (void *ptr : live) {
+			CHECK(slots.count(ptr) == 1);
+			pool.Free(ptr, 200);
+		}
+		CHECK(pool.GetStats().numInUse == 0);
+		CHECK(pool.GetStats().highWater == 100);
+	}
+
+	SUBCASE("Slots of a fresh chunk are handed out in address order")
+	{
+		char *first = static_cast<char *>(pool.Allocate(200));
+		char *second = static_cast<char *>(pool.Allocate(200));
+		CHECK(second - first == ptrdiff_t(pool.GetStats().slotSize));
+		pool.Free(second, 200);
+		pool.Free(first, 200);
+	}
+
+	SUBCASE("Bigger allocations go to the heap")
+	{
+		void *ptr = pool.Allocate(1000);
+		BodyPool::Stats stats = pool.GetStats();
+		CHECK(stats.numInUse == 0);
+		CHECK(stats.numFallbacks == 1);
+		pool.Free(ptr, 1000);
+		CHECK(pool.GetStats().numInUse == 0);
+	}
+}
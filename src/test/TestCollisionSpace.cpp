@@ -0,0 +1,100 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "collider/CollisionContact.h"
+#include "collider/CollisionSpace.h"
+#include "collider/Geom.h"
+#include "collider/GeomTree.h"
+
+#include <memory>
+#include <vector>
+#include "doctest.h"
+
+// A closed box with the given half extents
+static std::unique_ptr<GeomTree> MakeBox(const vector3f &size)
+{
+	std::vector<vector3f> vertices;
+	for (int i = 0; i < 8; i++)
+		vertices.emplace_back(i & 1 ? size.x : -size.x, i & 2 ? size.y : -size.y, i & 4 ? size.z : -size.z);
+
+	const std::vector<Uint32> indices = {
+		0, 2, 1, 1, 2, 3, // -z
+		4, 5, 6, 5, 7, 6, // +z
+		0, 1, 4, 1, 5, 4, // -y
+		2, 6, 3, 3, 6, 7, // +y
+		0, 4, 2, 2, 4, 6, // -x
+		1, 3, 5, 3, 7, 5, // +x
+	};
+	const std::vector<Uint32> triFlags(12, 0);
+
+	return std::make_unique<GeomTree>(8, 12, vertices, indices, triFlags);
+}
+
+static void IgnoreContact(CollisionContact *) {}
+
+TEST_CASE("CollisionSpace SweepRay")
+{
+	// a thin plate, 20m wide and 20cm thick
+	std::unique_ptr<GeomTree> plate = MakeBox(vector3f(10.0f, 10.0f, 0.1f));
+	int plateData = 0;
+
+	CollisionSpace space;
+	Geom geom(plate.get(), matrix4x4d::Identity(), vector3d(0.0, 0.0, 50.0), &plateData);
+	space.AddGeom(&geom);
+
+	// GeomTree::TraceRay skips exactly axis-aligned slabs, keep the paths slightly oblique
+	const double timeStep = 0.1;
+	const vector3d start(0.0, 0.0, 0.0);
+	const vector3d vel(0.01, 0.01, 1.0);
+
+	SUBCASE("Moving geom crosses the path")
+	{
+		// the plate moves from z=50 to z=-50 during the step
+		geom.SetVelocity(vector3d(0.0, 0.0, -1000.0));
+		space.Collide(&IgnoreContact);
+
+		// a discrete test only sees where the plate is now
+		CollisionContact traced;
+		space.TraceRay(start, vel.Normalized(), vel.Length() * timeStep, &traced);
+		CHECK(traced.userData1 == nullptr);
+
+		CollisionContact swept;
+		space.SweepRay(start, vel, timeStep, &swept);
+		REQUIRE(swept.userData1 == &plateData);
+		// the point reaches the near face after (50 - 0.1) / 1001 seconds
+		CHECK(swept.timestep == doctest::Approx(49.9 / 1001.0).epsilon(1e-3));
+		CHECK(swept.distance == doctest::Approx(swept.timestep * vel.Length()));
+		// it hits the face pointing back towards it
+		CHECK(swept.normal.z == doctest::Approx(-1.0));
+	}
+
+	SUBCASE("Moving geom misses the path")
+	{
+		// moving sideways, the plate never reaches the point
+		geom.SetVelocity(vector3d(1000.0, 0.0, 0.0));
+		space.Collide(&IgnoreContact);
+
+		CollisionContact swept;
+		space.SweepRay(start, vel, timeStep, &swept);
+		CHECK(swept.userData1 == nullptr);
+		CHECK(swept.distance == doctest::Approx(vel.Length() * timeStep));
+	}
+
+	SUBCASE("Fast point passes a static geom")
+	{
+		// without geom motion a sweep is the same as a ray over the step
+		space.Collide(&IgnoreContact);
+
+		CollisionContact swept;
+		space.SweepRay(start, vel * 1000.0, timeStep, &swept);
+		REQUIRE(swept.userData1 == &plateData);
+		CHECK(swept.pos.z == doctest::Approx(49.9).epsilon(1e-4));
+		CHECK(swept.distance == doctest::Approx(swept.pos.Length()));
+
+		CollisionContact ignored;
+		space.SweepRay(start, vel * 1000.0, timeStep, &ignored, &geom);
+		CHECK(ignored.userData1 == nullptr);
+	}
+
+	space.RemoveGeom(&geom);
+}
@@ -0,0 +1,221 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "JobQueue.h"
+#include "atomic_queue/atomic_queue.h"
+#include "core/TaskGraph.h"
+#include "doctest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <thread>
+#include <vector>
+
+// Timings of the scheduler's primitives, to measure changes to them by.
+// They take a while and their numbers are only of use when someone reads
+// them, so they are skipped unless asked for:
+//   unittest -ts=benchmark --no-skip
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double NanosecondsBetween(Clock::time_point start, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::nano>(end - start).count();
+	}
+
+	// Prints the distribution of samples, all in nanoseconds
+	void PrintLatency(const char *name, std::vector<double> &samples)
+	{
+		std::sort(samples.begin(), samples.end());
+		auto percentile = [&](double p) { return samples[std::min(size_t(samples.size() * p), samples.size() - 1)]; };
+		printf("%-40s %8zu samples: median %9.0fns  p90 %9.0fns  p99 %9.0fns  max %9.0fns\n",
+			name, samples.size(), percentile(0.5), percentile(0.9), percentile(0.99), samples.back());
+	}
+
+	void PrintThroughput(const char *name, uint32_t producers, uint64_t items, double ns)
+	{
+		printf("%-40s %4u producers: %10" PRIu64 " items in %8.2fms, %8.0fns/item, %10.0f items/s\n",
+			name, producers, items, ns * 1e-6, ns / items, items * 1e9 / ns);
+	}
+
+	// A task graph with a worker on each hardware thread but this one. The
+	// first worker doesn't run jobs, so there are at least three.
+	class ConcurrencyBench {
+	public:
+		ConcurrencyBench() :
+			m_graph(new TaskGraph())
+		{
+			m_numWorkers = std::max(std::thread::hardware_concurrency(), 4U) - 1;
+			m_graph->SetWorkerThreads(m_numWorkers);
+		}
+
+		~ConcurrencyBench()
+		{
+			delete m_graph;
+		}
+
+	protected:
+		TaskGraph *m_graph;
+		uint32_t m_numWorkers;
+	};
+
+	// Does nothing but note when it ran, so the time measured is that of
+	// getting it to a worker and back
+	class StampTask : public Task {
+	public:
+		StampTask(Clock::time_point &executed) :
+			m_executed(executed) {}
+
+		void OnExecute(TaskRange) override { m_executed = Clock::now(); }
+
+	private:
+		Clock::time_point &m_executed;
+	};
+
+	class EmptyJob : public Job {
+	public:
+		EmptyJob(std::atomic<uint32_t> &count) :
+			m_count(count) {}
+
+		void OnRun() override { m_count.fetch_add(1, std::memory_order_relaxed); }
+		void OnFinish() override {}
+
+	private:
+		std::atomic<uint32_t> &m_count;
+	};
+} // namespace
+
+TEST_SUITE("benchmark" * doctest::skip())
+{
+	TEST_CASE_FIXTURE(ConcurrencyBench, "Task spawn and complete latency")
+	{
+		const size_t NUM_SAMPLES = 2000;
+		std::vector<double> spawn, complete;
+
+		for (size_t idx = 0; idx < NUM_SAMPLES; idx++) {
+			Clock::time_point executed;
+			TaskSet *set = new TaskSet();
+			set->AddTask(new StampTask(executed));
+
+			const Clock::time_point start = Clock::now();
+			TaskSet::Handle handle = m_graph->QueueTaskSet(set);
+			m_graph->WaitForTaskSet(handle);
+			const Clock::time_point end = Clock::now();
+
+			spawn.push_back(NanosecondsBetween(start, executed));
+			complete.push_back(NanosecondsBetween(start, end));
+		}
+
+		PrintLatency("task queued to executed", spawn);
+		PrintLatency("task queued to waited for", complete);
+		CHECK(complete.size() == NUM_SAMPLES);
+	}
+
+	TEST_CASE_FIXTURE(ConcurrencyBench, "Task throughput under contention")
+	{
+		const uint32_t NUM_SETS = 64;
+		const uint32_t TASKS_PER_SET = 256;
+
+		// more and more threads queueing sets and waiting on them at once,
+		// with every task hitting the same counter
+		for (uint32_t numProducers = 1; numProducers <= m_numWorkers + 1; numProducers *= 2) {
+			std::atomic<uint32_t> count(0);
+
+			const Clock::time_point start = Clock::now();
+			std::vector<std::thread> producers;
+			for (uint32_t thread = 0; thread < numProducers; thread++) {
+				producers.emplace_back([&]() {
+					for (uint32_t idx = 0; idx < NUM_SETS; idx++) {
+						TaskSet *set = new TaskSet();
+						set->AddTaskRangeLambda({ 0, TASKS_PER_SET }, 1, [&](TaskRange range) {
+							count.fetch_add(range.end - range.begin);
+						});
+						TaskSet::Handle handle = m_graph->QueueTaskSet(set);
+						m_graph->WaitForTaskSet(handle);
+					}
+				});
+			}
+			for (std::thread &producer : producers)
+				producer.join();
+			const Clock::time_point end = Clock::now();
+
+			const uint64_t numTasks = uint64_t(numProducers) * NUM_SETS * TASKS_PER_SET;
+			PrintThroughput("contended tasks", numProducers, numTasks, NanosecondsBetween(start, end));
+			CHECK(count.load() == numTasks);
+		}
+	}
+
+	TEST_CASE_FIXTURE(ConcurrencyBench, "JobQueue Queue and FinishJobs overhead")
+	{
+		// in batches that fit the queues of the task graph, as the workers
+		// wait for room to hand back a finished job
+		const uint32_t NUM_BATCHES = 16;
+		const uint32_t BATCH_SIZE = 256;
+		const uint32_t NUM_JOBS = NUM_BATCHES * BATCH_SIZE;
+		JobQueue *queue = m_graph->GetJobQueue();
+		std::atomic<uint32_t> count(0);
+		std::vector<Job::Handle> handles;
+		handles.reserve(NUM_JOBS);
+
+		double queueNs = 0.0;
+		double finishNs = 0.0;
+		uint32_t numFinished = 0;
+		for (uint32_t batch = 1; batch <= NUM_BATCHES; batch++) {
+			const Clock::time_point queueStart = Clock::now();
+			for (uint32_t idx = 0; idx < BATCH_SIZE; idx++)
+				handles.push_back(queue->Queue(new EmptyJob(count)));
+			queueNs += NanosecondsBetween(queueStart, Clock::now());
+
+			while (count.load() < batch * BATCH_SIZE)
+				std::this_thread::yield();
+
+			// every job of the batch has run, so this is only the cost of
+			// finishing them
+			const Clock::time_point finishStart = Clock::now();
+			while (numFinished < batch * BATCH_SIZE)
+				numFinished += queue->FinishJobs();
+			finishNs += NanosecondsBetween(finishStart, Clock::now());
+		}
+
+		PrintThroughput("JobQueue::Queue", 1, NUM_JOBS, queueNs);
+		PrintThroughput("JobQueue::FinishJobs", 1, NUM_JOBS, finishNs);
+		CHECK(numFinished == NUM_JOBS);
+		CHECK(std::none_of(handles.begin(), handles.end(), [](const Job::Handle &handle) { return handle.HasJob(); }));
+	}
+
+	TEST_CASE("atomic_queue handoff latency")
+	{
+		// both ends spin, which takes a scheduler quantum per handoff on a
+		// single hardware thread
+		if (std::thread::hardware_concurrency() < 2) {
+			MESSAGE("atomic_queue handoff needs two hardware threads, skipped");
+			return;
+		}
+
+		const uint32_t NUM_ROUND_TRIPS = 100000;
+		atomic_queue::AtomicQueue2<uint32_t, 64> ping, pong;
+
+		// a value is passed to the other thread and straight back
+		std::thread echo([&]() {
+			for (uint32_t idx = 0; idx < NUM_ROUND_TRIPS; idx++)
+				pong.push(ping.pop());
+		});
+
+		std::vector<double> samples;
+		samples.reserve(NUM_ROUND_TRIPS);
+		uint32_t numCorrect = 0;
+		for (uint32_t idx = 0; idx < NUM_ROUND_TRIPS; idx++) {
+			const Clock::time_point start = Clock::now();
+			ping.push(uint32_t(idx));
+			numCorrect += pong.pop() == idx;
+			samples.push_back(NanosecondsBetween(start, Clock::now()) / 2);
+		}
+		echo.join();
+
+		PrintLatency("atomic_queue one way handoff", samples);
+		CHECK(numCorrect == NUM_ROUND_TRIPS);
+	}
+}
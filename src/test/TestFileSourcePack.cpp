@@ -0,0 +1,164 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "FileSourcePack.h"
+
+#include "doctest.h"
+
+#include <cstdio>
+#include <map>
+
+using namespace FileSystem;
+
+// A few files held in memory
+class MemorySource : public FileSource {
+public:
+	MemorySource() :
+		FileSource(":memory:") {}
+
+	std::map<std::string, std::string> files;
+
+	FileInfo MakeFile(const std::string &path) { return MakeFileInfo(path, FileInfo::FT_FILE); }
+
+	virtual FileInfo Lookup(const std::string &path) override
+	{
+		if (files.count(path))
+			return MakeFileInfo(path, FileInfo::FT_FILE);
+		if (path.empty() || files.lower_bound(path + "/") != files.lower_bound(path + "0"))
+			return MakeFileInfo(path, FileInfo::FT_DIR);
+		return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
+	}
+
+	virtual RefCountedPtr<FileData> ReadFile(const std::string &path) override
+	{
+		auto it = files.find(path);
+		if (it == files.end())
+			return RefCountedPtr<FileData>();
+		FileDataMalloc *data = new FileDataMalloc(MakeFileInfo(path, FileInfo::FT_FILE), it->second.size());
+		std::copy(it->second.begin(), it->second.end(), const_cast<char *>(data->GetData()));
+		return RefCountedPtr<FileData>(data);
+	}
+
+	virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output) override
+	{
+		const std::string prefix = path.empty() ? path : path + "/";
+		std::string last;
+		for (const auto &file : files) {
+			if (file.first.compare(0, prefix.size(), prefix) != 0)
+				continue;
+			const size_t slash = file.first.find('/', prefix.size());
+			const std::string child = file.first.substr(0, slash);
+			if (child != last)
+				output.push_back(MakeFileInfo(child, slash == std::string::npos ? FileInfo::FT_FILE : FileInfo::FT_DIR));
+			last = child;
+		}
+		return true;
+	}
+};
+
+static RefCountedPtr<FileData> write_pack(MemorySource &source, bool compress)
+{
+	FILE *file = tmpfile();
+	REQUIRE(file);
+	CHECK(FileSourcePack::Write(source, "", file, compress, "data.pack"));
+
+	fseek(file, 0, SEEK_END);
+	const size_t size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	FileDataMalloc *data = new FileDataMalloc(source.MakeFile("data.pack"), size);
+	CHECK(fread(const_cast<char *>(data->GetData()), 1, size, file) == size);
+	fclose(file);
+	return RefCountedPtr<FileData>(data);
+}
+
+TEST_CASE("FileSourcePack")
+{
+	MemorySource source;
+	source.files["data.pack"] = "an old pack";
+	source.files["empty.txt"] = "";
+	source.files["readme.txt"] = "hello";
+	source.files["models/ship.model"] = std::string(20000, 'x');
+	source.files["models/parts/wing.model"] = "wing";
+	source.files["models.txt"] = "a file next to a directory";
+
+	for (bool compress : { false, true }) {
+		FileSourcePack pack(write_pack(source, compress), "data.pack");
+		REQUIRE(pack.IsOpen());
+
+		CHECK(pack.Lookup("data.pack").GetType() == FileInfo::FT_NON_EXISTENT);
+		CHECK(pack.Lookup("models").IsDir());
+		CHECK(pack.Lookup("/models/parts/").IsDir());
+		CHECK(pack.Lookup("models/parts/wing.model").IsFile());
+		CHECK(pack.Lookup("models/wing.model").GetType() == FileInfo::FT_NON_EXISTENT);
+
+		for (const auto &file : source.files) {
+			if (file.first == "data.pack")
+				continue;
+			RefCountedPtr<FileData> data = pack.ReadFile(file.first);
+			REQUIRE(data);
+			CHECK(data->AsStringView() == file.second);
+		}
+
+		std::vector<FileInfo> root;
+		CHECK(pack.ReadDirectory("", root));
+		REQUIRE(root.size() == 4);
+		CHECK(root[0].GetPath() == "empty.txt");
+		CHECK(root[1].GetPath() == "models");
+		CHECK(root[1].IsDir());
+		CHECK(root[2].GetPath() == "models.txt");
+		CHECK(root[3].GetPath() == "readme.txt");
+
+		std::vector<FileInfo> models;
+		CHECK(pack.ReadDirectory("models", models));
+		REQUIRE(models.size() == 2);
+		CHECK(models[0].GetPath() == "models/parts");
+		CHECK(models[1].GetPath() == "models/ship.model");
+
+		std::vector<FileInfo> missing;
+		CHECK(!pack.ReadDirectory("textures", missing));
+	}
+
+	// a truncated pack is rejected as a whole
+	RefCountedPtr<FileData> data = write_pack(source, false);
+	FileDataMalloc *cut = new FileDataMalloc(data->GetInfo(), data->GetSize() - 1);
+	std::copy(data->GetData(), data->GetData() + cut->GetSize(), const_cast<char *>(cut->GetData()));
+	FileSourcePack truncated(RefCountedPtr<FileData>(cut), "truncated.pack");
+	CHECK(!truncated.IsOpen());
+}
+
+TEST_CASE("FileSourceUnion")
+{
+	MemorySource source;
+	source.files["readme.txt"] = "packed";
+	source.files["models/ship.model"] = "ship";
+	FileSourcePack pack(write_pack(source, false), "data.pack");
+	REQUIRE(pack.IsOpen());
+
+	// a loose source over the pack, with files written to it while mounted
+	MemorySource loose;
+	FileSourceUnion files;
+	files.AppendSource(&loose);
+	files.AppendSource(&pack);
+
+	CHECK(&files.Lookup("readme.txt").GetSource() == &pack);
+	CHECK(files.Lookup("models/wing.model").GetType() == FileInfo::FT_NON_EXISTENT);
+	std::vector<FileInfo> models;
+	CHECK(files.ReadDirectory("models", models));
+	CHECK(models.size() == 1);
+
+	loose.files["readme.txt"] = "loose";
+	loose.files["models/wing.model"] = "wing";
+
+	CHECK(&files.Lookup("readme.txt").GetSource() == &loose);
+	CHECK(files.ReadFile("readme.txt")->AsStringView() == "loose");
+	CHECK(files.LookupAll("readme.txt").size() == 2);
+	CHECK(files.Lookup("models/wing.model").IsFile());
+	models.clear();
+	CHECK(files.ReadDirectory("models", models));
+	REQUIRE(models.size() == 2);
+	CHECK(models[0].GetPath() == "models/ship.model");
+	CHECK(models[1].GetPath() == "models/wing.model");
+
+	loose.files.erase("readme.txt");
+	CHECK(files.ReadFile("readme.txt")->AsStringView() == "packed");
+}
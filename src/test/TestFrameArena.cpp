@@ -0,0 +1,59 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "core/FrameArena.h"
+
+#include "doctest.h"
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+TEST_CASE("FrameArena")
+{
+	FrameArena::NextFrame();
+
+	SUBCASE("Allocations are aligned and kept for a frame")
+	{
+		char *a = static_cast<char *>(FrameArena::Allocate(3, 1));
+		double *b = static_cast<double *>(FrameArena::Allocate(sizeof(double), alignof(double)));
+		void *c = FrameArena::Allocate(64, 64);
+		CHECK(reinterpret_cast<uintptr_t>(b) % alignof(double) == 0);
+		CHECK(reinterpret_cast<uintptr_t>(c) % 64 == 0);
+		memcpy(a, "ab", 3);
+
+		// still there in the next frame, and reused in the one after
+		FrameArena::NextFrame();
+		CHECK(FrameArena::Allocate(3, 1) != a);
+		CHECK(strcmp(a, "ab") == 0);
+		FrameArena::NextFrame();
+		CHECK(FrameArena::Allocate(3, 1) == a);
+	}
+
+	SUBCASE("Steady use stops allocating blocks")
+	{
+		const auto frame = []() {
+			FrameArena::NextFrame();
+			FrameVector<int> values;
+			for (int i = 0; i < 10000; i++)
+				values.push_back(i);
+			CHECK(values.back() == 9999);
+		};
+
+		frame();
+		frame();
+		const uint64_t numBlockAllocs = FrameArena::GetStats().numBlockAllocs;
+		for (int i = 0; i < 4; i++)
+			frame();
+		CHECK(FrameArena::GetStats().numBlockAllocs == numBlockAllocs);
+	}
+
+	SUBCASE("Threads have arenas of their own")
+	{
+		void *mine = FrameArena::Allocate(16, 16);
+		void *theirs = nullptr;
+		std::thread([&theirs]() { theirs = FrameArena::Allocate(16, 16); }).join();
+		CHECK(theirs != nullptr);
+		CHECK(theirs != mine);
+	}
+}
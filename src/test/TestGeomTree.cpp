@@ -0,0 +1,178 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "collider/BVHTree.h"
+#include "collider/GeomTree.h"
+#include "collider/KDop.h"
+#include "collider/RayTri.h"
+#include "scenegraph/Serializer.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+#include "doctest.h"
+
+static constexpr int GRID_SIZE = 64;
+static constexpr int NUM_RAYS = 2000;
+
+// A bumpy, station-sized height field with a few thousand triangles
+struct GeomTreeScene {
+	std::vector<vector3f> vertices;
+	std::vector<Uint32> indices;
+	std::vector<Uint32> triFlags;
+	std::vector<vector3f> starts;
+	std::vector<vector3f> dirs;
+
+	GeomTreeScene(Uint32 seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> height(-20.0f, 20.0f);
+		std::uniform_real_distribution<float> pos(-600.0f, 600.0f);
+
+		for (int y = 0; y <= GRID_SIZE; y++)
+			for (int x = 0; x <= GRID_SIZE; x++)
+				vertices.emplace_back((x - GRID_SIZE / 2) * 16.0f, height(rng), (y - GRID_SIZE / 2) * 16.0f);
+
+		for (int y = 0; y < GRID_SIZE; y++) {
+			for (int x = 0; x < GRID_SIZE; x++) {
+				const Uint32 v = y * (GRID_SIZE + 1) + x;
+				indices.insert(indices.end(), { v, v + GRID_SIZE + 1, v + 1 });
+				indices.insert(indices.end(), { v + 1, v + GRID_SIZE + 1, v + GRID_SIZE + 2 });
+				triFlags.insert(triFlags.end(), { 0, 0 });
+			}
+		}
+
+		for (int i = 0; i < NUM_RAYS; i++) {
+			starts.emplace_back(pos(rng), 100.0f, pos(rng));
+			dirs.push_back((vector3f(pos(rng), -150.0f, pos(rng)) - starts.back()).Normalized());
+		}
+	}
+
+	std::unique_ptr<GeomTree> MakeTree() const
+	{
+		return std::make_unique<GeomTree>(int(vertices.size()), int(indices.size() / 3), vertices, indices, triFlags);
+	}
+};
+
+static isect_t TraceTree(const GeomTree &tree, const vector3f &start, const vector3f &dir)
+{
+	isect_t isect = { -1, 2000.0f };
+	tree.TraceRay(start, dir, &isect);
+	return isect;
+}
+
+TEST_CASE("GeomTree Compact BVH")
+{
+	GeomTreeScene scene(2468);
+	std::unique_ptr<GeomTree> tree = scene.MakeTree();
+
+	SUBCASE("TraceRay matches brute force")
+	{
+		std::vector<int> triOffsets;
+		for (int i = 0; i < tree->GetNumTris(); i++)
+			triOffsets.push_back(i * 3);
+
+		int numHits = 0;
+		for (int i = 0; i < NUM_RAYS; i++) {
+			isect_t expected = { -1, 2000.0f };
+			RayTri::RayTrianglesScalar(scene.starts[i], scene.dirs[i], tree->GetVertices().data(), tree->GetIndices(),
+				triOffsets.data(), tree->GetNumTris(), &expected);
+
+			const isect_t isect = TraceTree(*tree, scene.starts[i], scene.dirs[i]);
+			INFO("ray ", i);
+			CHECK(isect.triIdx == expected.triIdx);
+			CHECK(isect.dist == expected.dist);
+			numHits += expected.triIdx >= 0;
+		}
+
+		CHECK(numHits > NUM_RAYS / 2);
+	}
+
+	SUBCASE("Serialization")
+	{
+		Serializer::Writer wr;
+		tree->Save(wr);
+
+		const std::string &data = wr.GetData();
+		Serializer::Reader rd(ByteRange(data.data(), data.size()));
+		GeomTree loaded(rd);
+
+		CHECK(loaded.GetMemoryUsage() == tree->GetMemoryUsage());
+		for (int i = 0; i < NUM_RAYS; i++) {
+			const isect_t a = TraceTree(*tree, scene.starts[i], scene.dirs[i]);
+			const isect_t b = TraceTree(loaded, scene.starts[i], scene.dirs[i]);
+			CHECK(a.triIdx == b.triIdx);
+			CHECK(a.dist == b.dist);
+		}
+	}
+
+	SUBCASE("Convex proxy")
+	{
+		const KDop &hull = tree->GetHull();
+		for (const vector3f &v : tree->GetVertices())
+			for (int i = 0; i < KDop::NUM_AXES; i++) {
+				const float d = KDop::GetAxis(i).Dot(v);
+				CHECK((d >= hull.min[i] && d <= hull.max[i]));
+			}
+
+		// far-field rays aimed around the mesh; the hull must never reject
+		// a ray that hits it
+		std::mt19937 rng(1357);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		int rejected = 0;
+		for (int i = 0; i < NUM_RAYS; i++) {
+			const vector3f start = vector3f(unit(rng), unit(rng), unit(rng)).Normalized() * 30000.0f;
+			const vector3f target(unit(rng) * 520.0f, unit(rng) * 20.0f, unit(rng) * 520.0f);
+			const vector3f dir = (target - start).Normalized();
+
+			isect_t isect = { -1, 40000.0f };
+			tree->TraceRay(tree->GetTriTree()->GetRoot(), tree->GetTriTree()->GetRootBounds(), start, dir, &isect);
+			if (!hull.IntersectsRay(start, dir, 40000.0f)) {
+				CHECK(isect.triIdx == -1);
+				rejected++;
+			}
+		}
+		CHECK(rejected > 0);
+
+		// a box within the AABB of an octahedron, but beyond its diagonal faces
+		KDop octahedron;
+		for (int i = 0; i < 3; i++) {
+			vector3f v(0.0f);
+			v[i] = 1.0f;
+			octahedron.Update(v);
+			octahedron.Update(-v);
+		}
+		const matrix4x4d rotated = matrix4x4d::RotateYMatrix(M_PI / 3);
+		CHECK(octahedron.IsSeparatedFrom(vector3d(0.55), vector3d(0.65), matrix4x4d::Identity()));
+		CHECK(!octahedron.IsSeparatedFrom(vector3d(0.25), vector3d(0.35), matrix4x4d::Identity()));
+		CHECK(!octahedron.IsSeparatedFrom(vector3d(-0.05), vector3d(0.05), matrix4x4d::Translation(vector3d(0.0, 0.9, 0.0)) * rotated));
+	}
+
+	SUBCASE("Sharing")
+	{
+		GeomTree *first = GeomTree::Share(scene.MakeTree().release());
+		GeomTree *second = GeomTree::Share(scene.MakeTree().release());
+		CHECK(second == first);
+
+		GeomTreeScene other(4321);
+		GeomTree *third = GeomTree::Share(other.MakeTree().release());
+		CHECK(third != first);
+
+		GeomTree::SharedStats stats = GeomTree::GetSharedStats();
+		CHECK(stats.numTrees == 2);
+		CHECK(stats.numUses == 3);
+		CHECK(stats.memorySaved == first->GetMemoryUsage());
+
+		GeomTree::Release(first);
+		GeomTree::Release(third);
+		stats = GeomTree::GetSharedStats();
+		CHECK(stats.numTrees == 1);
+		CHECK(stats.memorySaved == 0);
+
+		// still usable until the last release
+		isect_t isect = { -1, 2000.0f };
+		second->TraceRay(scene.starts[0], scene.dirs[0], &isect);
+		GeomTree::Release(second);
+		CHECK(GeomTree::GetSharedStats().numTrees == 0);
+	}
+}
@@ -0,0 +1,64 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "FileSystem.h"
+#include "scenegraph/Loader.h"
+
+#include "doctest.h"
+
+#include <map>
+
+using namespace FileSystem;
+
+// Files that exist only as modification times, which the test changes
+class TouchSource : public FileSource {
+public:
+	TouchSource() :
+		FileSource(":touch:") {}
+
+	std::map<std::string, Time::DateTime> files;
+
+	void Touch(const std::string &path) { files[path] = files[path] + Time::TimeDelta(2, Time::Second); }
+
+	virtual FileInfo Lookup(const std::string &path) override
+	{
+		auto it = files.find(path);
+		if (it == files.end())
+			return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
+		return MakeFileInfo(path, FileInfo::FT_FILE, it->second);
+	}
+
+	virtual RefCountedPtr<FileData> ReadFile(const std::string &) override { return RefCountedPtr<FileData>(); }
+	virtual bool ReadDirectory(const std::string &, std::vector<FileInfo> &) override { return false; }
+};
+
+TEST_CASE("ImportCache")
+{
+	TouchSource source;
+	source.files["models/ship/ship.model"] = Time::DateTime(3200, 1, 1, 12, 0, 0);
+	source.files["models/ship/hull.dae"] = Time::DateTime(3200, 1, 1, 12, 0, 0);
+	gameDataFiles.PrependSource(&source);
+
+	SceneGraph::ImportCache cache;
+	cache.AddSource("models/ship/ship.model", SceneGraph::ImportCache::SOURCE_DEFINITION);
+	cache.AddSource("models/ship/hull.dae", SceneGraph::ImportCache::SOURCE_MESH);
+	CHECK(cache.FindModifiedSources().empty());
+
+	source.Touch("models/ship/hull.dae");
+	std::vector<SceneGraph::ImportCache::Source> modified = cache.FindModifiedSources();
+	REQUIRE(modified.size() == 1);
+	CHECK(modified[0].path == "models/ship/hull.dae");
+	CHECK(modified[0].type == SceneGraph::ImportCache::SOURCE_MESH);
+
+	// reported once per change
+	CHECK(cache.FindModifiedSources().empty());
+	source.Touch("models/ship/hull.dae");
+	source.Touch("models/ship/ship.model");
+	CHECK(cache.FindModifiedSources().size() == 2);
+
+	// while an editor replaces the file it is missing, which isn't a change
+	source.files.erase("models/ship/ship.model");
+	CHECK(cache.FindModifiedSources().empty());
+
+	gameDataFiles.RemoveSource(&source);
+}
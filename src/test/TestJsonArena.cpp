@@ -0,0 +1,81 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Json.h"
+#include "core/JsonArena.h"
+
+#include "doctest.h"
+
+#include <string>
+#include <thread>
+
+static Json MakeTree(int size)
+{
+	Json root = Json::object();
+	for (int i = 0; i < size; i++) {
+		Json body = Json::object();
+		body["index"] = i;
+		body["label"] = "A label too long to fit in the string " + std::to_string(i);
+		body["pos"] = { 1.0 * i, 2.0, 3.0 };
+		root["bodies"].push_back(body);
+	}
+	return root;
+}
+
+TEST_CASE("JsonArena")
+{
+	const Json heapTree = MakeTree(200);
+
+	SUBCASE("Trees built in a scope come from the arena")
+	{
+		JsonArena arena;
+		{
+			JsonArena::Scope scope(arena);
+			Json tree = MakeTree(200);
+			CHECK(tree == heapTree);
+			CHECK(arena.GetUsed() > 200 * sizeof(Json));
+			CHECK(JsonArena::Current() == &arena);
+		}
+		CHECK(JsonArena::Current() == nullptr);
+
+		// nothing is handed back to the arena one value at a time
+		const size_t used = arena.GetUsed();
+		{
+			JsonArena::Scope scope(arena);
+			Json tree = MakeTree(10);
+		}
+		CHECK(arena.GetUsed() > used);
+		CHECK(arena.GetCapacity() >= arena.GetUsed());
+	}
+
+	SUBCASE("Arena and heap values mix and are freed anywhere")
+	{
+		JsonArena arena;
+		Json tree;
+		{
+			JsonArena::Scope scope(arena);
+			tree = MakeTree(50);
+		}
+		CHECK(JsonArena::Owns(tree["bodies"].get_ptr<Json::array_t *>()->data()));
+
+		// grown from the heap outside the scope, copied back to the heap
+		tree["bodies"].push_back(heapTree["bodies"][0]);
+		Json copy = tree["bodies"][3];
+		CHECK(!JsonArena::Owns(copy.get_ptr<Json::object_t *>()));
+
+		// and freed from another thread, as background saves do
+		std::thread([&]() { tree = Json(); }).join();
+		CHECK(copy["index"] == 3);
+	}
+
+	SUBCASE("Memory of destroyed arenas isn't theirs any more")
+	{
+		const void *ptr;
+		{
+			JsonArena arena;
+			ptr = arena.Allocate(16, 8);
+			CHECK(JsonArena::Owns(ptr));
+		}
+		CHECK(!JsonArena::Owns(ptr));
+	}
+}
@@ -0,0 +1,132 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "galaxy/JumpGraph.h"
+#include "galaxy/Sector.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include "doctest.h"
+
+static constexpr int NUM_SECTORS = 24; // along x; a slab 4 sectors thick
+static constexpr int SYSTEMS_PER_SECTOR = 4;
+static constexpr float JUMP_RANGE = 9.0f;
+
+// A hyperdrive whose jumps take longer the further they go, with a bit of
+// overhead for every jump
+static JumpCost MakeCost()
+{
+	JumpCost cost;
+	cost.range = JUMP_RANGE;
+	for (int i = 0; i <= 64; i++) {
+		const float d = JUMP_RANGE * i / 64;
+		cost.durations.push_back(1.0f + d * d);
+	}
+	return cost;
+}
+
+static void AddSectors(JumpGraph &graph, Uint32 seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> pos(0.0f, Sector::SIZE);
+	for (int x = 0; x < NUM_SECTORS; x++)
+		for (int y = 0; y < 4; y++)
+			for (int z = 0; z < 4; z++) {
+				std::vector<vector3f> positions;
+				for (int i = 0; i < SYSTEMS_PER_SECTOR; i++)
+					positions.emplace_back(pos(rng), pos(rng), pos(rng));
+				graph.AddSector(SystemPath(x, y, z), positions);
+			}
+}
+
+// Plain Dijkstra over every node, for reference
+static float QuickestDuration(JumpGraph &graph, const SystemPath &start, const SystemPath &target, const JumpCost &cost)
+{
+	std::vector<float> duration(graph.GetNumNodes(), HUGE_VALF);
+	std::vector<bool> visited(graph.GetNumNodes(), false);
+	duration[graph.FindNode(start)] = 0.0f;
+	for (;;) {
+		Uint32 node = JumpGraph::INVALID_NODE;
+		for (Uint32 i = 0; i < graph.GetNumNodes(); i++)
+			if (!visited[i] && duration[i] < HUGE_VALF && (node == JumpGraph::INVALID_NODE || duration[i] < duration[node]))
+				node = i;
+		if (node == JumpGraph::INVALID_NODE)
+			return HUGE_VALF;
+		if (node == graph.FindNode(target))
+			return duration[node];
+		visited[node] = true;
+		for (const JumpGraph::Edge &edge : graph.GetEdges(node))
+			duration[edge.node] = std::min(duration[edge.node], duration[node] + cost.GetDuration(edge.distance));
+	}
+}
+
+static float RouteDuration(JumpGraph &graph, const SystemPath &start, const std::vector<SystemPath> &route, const JumpCost &cost)
+{
+	float duration = 0.0f;
+	vector3f pos = graph.GetPosition(graph.FindNode(start));
+	for (const SystemPath &path : route) {
+		const vector3f next = graph.GetPosition(graph.FindNode(path));
+		CHECK((next - pos).Length() <= JUMP_RANGE);
+		duration += cost.GetDuration((next - pos).Length());
+		pos = next;
+	}
+	return duration;
+}
+
+TEST_CASE("JumpGraph")
+{
+	const JumpCost cost = MakeCost();
+
+	SUBCASE("Jump cost")
+	{
+		CHECK(cost.GetDuration(0.0f) == doctest::Approx(1.0f));
+		CHECK(cost.GetDuration(JUMP_RANGE) == doctest::Approx(1.0f + JUMP_RANGE * JUMP_RANGE));
+		CHECK(cost.GetDuration(4.5f) == doctest::Approx(1.0f + 4.5f * 4.5f).epsilon(0.01));
+
+		// the heuristic must never overestimate
+		const float rate = cost.GetMinRate();
+		for (float d = 0.1f; d <= JUMP_RANGE; d += 0.1f)
+			CHECK(rate * d <= cost.GetDuration(d) + 1e-4f);
+	}
+
+	SUBCASE("Quickest route")
+	{
+		JumpGraph graph(JUMP_RANGE);
+		AddSectors(graph, 1234);
+		REQUIRE(graph.GetNumNodes() == NUM_SECTORS * 16 * SYSTEMS_PER_SECTOR);
+
+		std::mt19937 rng(5678);
+		std::uniform_int_distribution<int> x(0, NUM_SECTORS - 1), yz(0, 3), idx(0, SYSTEMS_PER_SECTOR - 1);
+		for (int i = 0; i < 20; i++) {
+			const SystemPath start(x(rng), yz(rng), yz(rng), idx(rng));
+			const SystemPath target(x(rng), yz(rng), yz(rng), idx(rng));
+			INFO("route ", i);
+
+			std::vector<SystemPath> route;
+			const float expected = QuickestDuration(graph, start, target, cost);
+			REQUIRE(graph.FindRoute(start, target, cost, route) == (expected < HUGE_VALF));
+			if (route.empty())
+				continue;
+
+			CHECK(route.back() == target);
+			CHECK(RouteDuration(graph, start, route, cost) == doctest::Approx(expected).epsilon(1e-4));
+		}
+	}
+
+	SUBCASE("Sectors added after searching")
+	{
+		// the edges found by the first search must gain the new neighbours
+		JumpGraph graph(JUMP_RANGE);
+		graph.AddSector(SystemPath(0, 0, 0), { vector3f(4.0f) });
+		graph.AddSector(SystemPath(2, 0, 0), { vector3f(4.0f) });
+
+		std::vector<SystemPath> route;
+		CHECK(!graph.FindRoute(SystemPath(0, 0, 0, 0), SystemPath(2, 0, 0, 0), cost, route));
+
+		graph.AddSector(SystemPath(1, 0, 0), { vector3f(4.0f) });
+		REQUIRE(graph.FindRoute(SystemPath(0, 0, 0, 0), SystemPath(2, 0, 0, 0), cost, route));
+		CHECK(route.size() == 2);
+		CHECK(route[0] == SystemPath(1, 0, 0, 0));
+	}
+}
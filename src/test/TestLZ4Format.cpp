@@ -0,0 +1,65 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "core/LZ4Format.h"
+
+#include "doctest.h"
+
+#include <string>
+
+TEST_CASE("LZ4 StreamDecompressor")
+{
+	// several blocks worth, and not too compressible
+	std::string data;
+	for (uint32_t idx = 0; data.size() < 300000; idx++)
+		data += std::to_string(idx * 2654435761u) + ",";
+
+	const std::string compressed = lz4::CompressLZ4(data, 0);
+	REQUIRE(lz4::IsLZ4Format(compressed.data(), compressed.size()));
+
+	SUBCASE("Same as DecompressLZ4")
+	{
+		lz4::StreamDecompressor stream(compressed);
+		std::string out;
+		int blocks = 0;
+		for (std::string_view block = stream.Next(); !block.empty(); block = stream.Next()) {
+			out.append(block.data(), block.size());
+			blocks++;
+		}
+
+		CHECK(blocks > 1);
+		CHECK(out == data);
+		CHECK(out == lz4::DecompressLZ4(compressed));
+	}
+
+	SUBCASE("Truncated")
+	{
+		const std::string truncated = compressed.substr(0, compressed.size() / 2);
+		lz4::StreamDecompressor stream(truncated);
+		CHECK_THROWS_AS(while (!stream.Next().empty()) {}, lz4::DecompressionFailedException);
+	}
+}
+
+TEST_CASE("LZ4 StreamCompressor")
+{
+	std::string data;
+	for (uint32_t idx = 0; data.size() < 300000; idx++)
+		data += std::to_string(idx * 2654435761u) + ",";
+
+	std::string compressed;
+	size_t writes = 0;
+	lz4::StreamCompressor stream([&](std::string_view block) {
+		compressed.append(block.data(), block.size());
+		writes++;
+	},
+		0);
+
+	// in pieces which don't line up with the blocks
+	for (size_t pos = 0; pos < data.size(); pos += 1000)
+		stream.Write(std::string_view(data).substr(pos, 1000));
+	stream.Finish();
+
+	CHECK(writes > 2);
+	REQUIRE(lz4::IsLZ4Format(compressed.data(), compressed.size()));
+	CHECK(lz4::DecompressLZ4(compressed) == data);
+}
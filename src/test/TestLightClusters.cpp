@@ -0,0 +1,125 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "graphics/LightClusters.h"
+
+#include "doctest.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Graphics;
+
+namespace {
+	// a 90 degree vertical field of view at 2:1
+	const float PROJ_X = 0.5f;
+	const float PROJ_Y = 1.0f;
+
+	PointLight MakeLight(const vector3f &pos, float radius)
+	{
+		return { pos, radius, Color::WHITE, 1.0f };
+	}
+
+	Uint32 CountEntries(const LightClusters &clusters)
+	{
+		Uint32 count = 0;
+		for (Uint32 cluster : clusters.GetClusters())
+			count += LightClusters::GetClusterCount(cluster);
+		return count;
+	}
+
+	// whether the cluster the view space point falls in lists the light
+	bool ClusterHasLight(const LightClusters &clusters, const vector3f &pos, Uint32 light)
+	{
+		const float depth = -pos.z;
+		const float ndcX = PROJ_X * pos.x / depth, ndcY = PROJ_Y * pos.y / depth;
+		const Uint32 x = std::min(Uint32((ndcX + 1.0f) * 0.5f * LightClusters::TILES_X), LightClusters::TILES_X - 1);
+		const Uint32 y = std::min(Uint32((ndcY + 1.0f) * 0.5f * LightClusters::TILES_Y), LightClusters::TILES_Y - 1);
+		const Uint32 cluster = clusters.GetClusters()[LightClusters::GetClusterIndex(x, y, LightClusters::GetSlice(depth))];
+
+		const auto begin = clusters.GetIndices().begin() + LightClusters::GetClusterOffset(cluster);
+		return std::find(begin, begin + LightClusters::GetClusterCount(cluster), light) != begin + LightClusters::GetClusterCount(cluster);
+	}
+} // namespace
+
+TEST_CASE("Light Clusters")
+{
+	LightClusters clusters;
+
+	SUBCASE("Slices")
+	{
+		CHECK(LightClusters::GetSlice(0.5f) == 0);
+		CHECK(LightClusters::GetSlice(LightClusters::FAR_DEPTH * 2.0f) == LightClusters::SLICES - 1);
+		for (Uint32 slice = 1; slice < LightClusters::SLICES; slice++) {
+			const float depth = 0.5f * (LightClusters::GetSliceNear(slice) + LightClusters::GetSliceFar(slice));
+			CAPTURE(slice);
+			CHECK(LightClusters::GetSlice(depth) == slice);
+			CHECK(LightClusters::GetSliceNear(slice) == doctest::Approx(LightClusters::GetSliceFar(slice - 1)));
+		}
+	}
+
+	SUBCASE("Lights out of view aren't listed")
+	{
+		const PointLight lights[] = {
+			MakeLight(vector3f(0.f, 0.f, 100.f), 10.f),
+			MakeLight(vector3f(0.f, 0.f, -LightClusters::FAR_DEPTH * 2.0f), 10.f),
+			MakeLight(vector3f(1000.f, 0.f, -100.f), 10.f),
+		};
+		clusters.Build(lights, 3, PROJ_X, PROJ_Y);
+		CHECK(clusters.GetNumLights() == 3);
+		CHECK(clusters.GetIndices().empty());
+		CHECK(CountEntries(clusters) == 0);
+	}
+
+	SUBCASE("Every point of a light is in a cluster listing it")
+	{
+		const PointLight lights[] = {
+			MakeLight(vector3f(0.f, 0.f, -100.f), 5.f),
+			MakeLight(vector3f(-30.f, 12.f, -40.f), 20.f),
+			MakeLight(vector3f(3.f, -2.f, -3.f), 4.f),
+		};
+		clusters.Build(lights, 3, PROJ_X, PROJ_Y);
+		CHECK(clusters.GetNumDropped() == 0);
+		CHECK(clusters.GetIndices().size() == CountEntries(clusters));
+
+		for (Uint32 light = 0; light < 3; light++) {
+			for (int i = 0; i < 200; i++) {
+				// spread over the sphere and inside it
+				const float a = i * 2.399963f, b = std::acos(1.0f - 2.0f * (i + 0.5f) / 200.f);
+				const float r = lights[light].radius * (0.5f + 0.5f * (i % 2));
+				const vector3f pos = lights[light].position + r * vector3f(std::cos(a) * std::sin(b), std::sin(a) * std::sin(b), std::cos(b));
+				const float depth = -pos.z;
+				if (depth <= 0.0f || std::abs(PROJ_X * pos.x / depth) > 1.0f || std::abs(PROJ_Y * pos.y / depth) > 1.0f)
+					continue;
+				CAPTURE(light);
+				CAPTURE(i);
+				CHECK(ClusterHasLight(clusters, pos, light));
+			}
+		}
+	}
+
+	SUBCASE("A light around the camera covers the near slice")
+	{
+		const PointLight light = MakeLight(vector3f(0.f), 0.5f);
+		clusters.Build(&light, 1, PROJ_X, PROJ_Y);
+		for (Uint32 y = 0; y < LightClusters::TILES_Y; y++) {
+			for (Uint32 x = 0; x < LightClusters::TILES_X; x++)
+				CHECK(LightClusters::GetClusterCount(clusters.GetClusters()[LightClusters::GetClusterIndex(x, y, 0)]) == 1);
+		}
+	}
+
+	SUBCASE("Too many lights are dropped")
+	{
+		std::vector<PointLight> lights(LightClusters::MAX_LIGHTS + 10, MakeLight(vector3f(0.f, 0.f, -50.f), 1.f));
+		clusters.Build(lights.data(), lights.size(), PROJ_X, PROJ_Y);
+		CHECK(clusters.GetNumLights() == LightClusters::MAX_LIGHTS);
+		CHECK(clusters.GetNumDropped() >= 10);
+		for (Uint32 cluster : clusters.GetClusters())
+			CHECK(LightClusters::GetClusterCount(cluster) <= LightClusters::MAX_LIGHTS_PER_CLUSTER);
+
+		// and the next build starts afresh
+		clusters.Build(lights.data(), 1, PROJ_X, PROJ_Y);
+		CHECK(clusters.GetNumDropped() == 0);
+		CHECK(clusters.GetIndices().size() == CountEntries(clusters));
+	}
+}
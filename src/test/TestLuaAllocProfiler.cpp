@@ -0,0 +1,85 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "lua/LuaAllocProfiler.h"
+
+#include "doctest.h"
+
+#include <lua.hpp>
+
+#include <cstdlib>
+#include <cstring>
+
+// what LuaManager does, without the memory tags
+static void *ProfiledAlloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	const size_t oldSize = ptr ? osize : 0;
+	if (LuaAllocProfiler::IsRunning())
+		return LuaAllocProfiler::Realloc(ptr, oldSize, nsize);
+	if (nsize == 0) {
+		free(ptr);
+		return nullptr;
+	}
+	return realloc(ptr, nsize);
+}
+
+static const LuaAllocProfiler::Summary *FindLine(const std::vector<LuaAllocProfiler::Summary> &lines, int line)
+{
+	for (const LuaAllocProfiler::Summary &summary : lines)
+		if (summary.source == "[string \"alloctest\"]" && summary.line == line)
+			return &summary;
+	return nullptr;
+}
+
+TEST_CASE("LuaAllocProfiler")
+{
+	lua_State *l = lua_newstate(&ProfiledAlloc, nullptr);
+	luaL_openlibs(l);
+	LuaAllocProfiler::Reset();
+	LuaAllocProfiler::Start(l, 1024);
+
+	const char *script =
+		"keep = {}\n"
+		"for i = 1, 2000 do keep[i] = { i, i, i, i } end\n"
+		"for i = 1, 2000 do local garbage = { i, i, i, i } end\n";
+	REQUIRE(luaL_loadbuffer(l, script, strlen(script), "alloctest") == LUA_OK);
+	REQUIRE(lua_pcall(l, 0, 0, 0) == LUA_OK);
+
+	std::vector<LuaAllocProfiler::Summary> lines;
+	LuaAllocProfiler::GetLines(lines);
+	const LuaAllocProfiler::Summary *kept = FindLine(lines, 2);
+	REQUIRE(kept);
+	CHECK(kept->numSamples > 0);
+	CHECK(kept->allocBytes > 0);
+	CHECK(kept->retainedBytes > 0);
+	const Uint64 keptBytes = kept->allocBytes;
+	const Uint64 retained = kept->retainedBytes;
+
+	// a collection frees what isn't referenced any more
+	lua_gc(l, LUA_GCCOLLECT, 0);
+	LuaAllocProfiler::GetLines(lines);
+	const LuaAllocProfiler::Summary *garbage = FindLine(lines, 3);
+	REQUIRE(garbage);
+	CHECK(garbage->allocBytes > 0);
+	CHECK(garbage->retainedBytes == 0);
+	CHECK(FindLine(lines, 2)->retainedBytes == retained);
+	const Uint64 garbageBytes = garbage->allocBytes;
+
+	luaL_dostring(l, "keep = nil");
+	lua_gc(l, LUA_GCCOLLECT, 0);
+	LuaAllocProfiler::GetLines(lines);
+	CHECK(FindLine(lines, 2)->retainedBytes == 0);
+
+	// the functions add up their lines
+	std::vector<LuaAllocProfiler::Summary> functions;
+	LuaAllocProfiler::GetFunctions(functions);
+	Uint64 total = 0;
+	for (const LuaAllocProfiler::Summary &function : functions)
+		if (function.source == "[string \"alloctest\"]")
+			total += function.allocBytes;
+	CHECK(total >= keptBytes + garbageBytes);
+
+	LuaAllocProfiler::Stop();
+	lua_close(l);
+	LuaAllocProfiler::Reset();
+}
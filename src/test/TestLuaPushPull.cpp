@@ -1,7 +1,9 @@
 // Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
+#include "core/StringName.h"
 #include "lua/Lua.h"
+#include "lua/LuaPropertyMap.h"
 #include "lua/LuaPushPull.h"
 
 #include <fmt/core.h>
@@ -87,5 +89,28 @@ TEST_CASE("Lua Push / Pull Basic Values")
 		CHECK(std::get<2>(tuple) == "test");
 	}
 
+	SUBCASE("StringName")
+	{
+		lua_pushstring(l, "shieldMassLeft");
+		lua_pushstring(l, "shieldMassLeft");
+		lua_pushstring(l, "a property key longer than lua's short strings");
+
+		StringName first = LuaPull<StringName>(l, 1);
+		StringName second = LuaPull<StringName>(l, 2);
+		CHECK(first == "shieldMassLeft");
+		CHECK(first.hash() == StringName("shieldMassLeft").hash());
+		CHECK(second.c_str() == first.c_str());
+		CHECK(LuaPull<StringName>(l, 3) == "a property key longer than lua's short strings");
+
+		// a different string reusing the same memory isn't mistaken for the old one
+		lua_settop(l, 0);
+		lua_gc(l, LUA_GCCOLLECT, 0);
+		lua_pushstring(l, "hullMassLeft");
+		CHECK(LuaPull<StringName>(l, 1) == "hullMassLeft");
+
+		LuaPush(l, first);
+		CHECK(LuaPull<std::string>(l, 2) == "shieldMassLeft");
+	}
+
 	lua_close(l);
 }
@@ -0,0 +1,80 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "galaxy/MarketTable.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "doctest.h"
+
+using namespace GalacticEconomy;
+
+static constexpr int NUM_COMMODITIES = 40;
+
+// Trade levels in the range the system generator produces
+struct MarketScene {
+	std::vector<float> basePrices;
+	std::mt19937 rng;
+
+	MarketScene(uint32_t seed) :
+		rng(seed)
+	{
+		std::uniform_real_distribution<float> price(1.0f, 500.0f);
+		basePrices.push_back(0.0f);
+		for (int i = 1; i <= NUM_COMMODITIES; i++)
+			basePrices.push_back(price(rng));
+	}
+
+	void AddMarkets(MarketTable &table, std::vector<int> &levels, std::vector<bool> &legal, int numMarkets)
+	{
+		std::uniform_int_distribution<int> level(-30, 30);
+		for (int m = 0; m < numMarkets; m++) {
+			const size_t market = table.AddMarket();
+			for (CommodityId c = 1; c <= NUM_COMMODITIES; c++) {
+				levels.push_back(level(rng));
+				legal.push_back(rng() % 8 != 0);
+				table.SetTradeLevel(c, market, levels.back());
+				table.SetLegal(c, market, legal.back());
+			}
+		}
+	}
+};
+
+TEST_CASE("MarketTable")
+{
+	MarketScene scene(13579);
+
+	SUBCASE("matches per-commodity model")
+	{
+		MarketTable table(scene.basePrices);
+		std::vector<int> levels;
+		std::vector<bool> legal;
+		// enough markets for the table to grow a few times
+		scene.AddMarkets(table, levels, legal, 100);
+		table.Update();
+
+		REQUIRE(table.GetNumMarkets() == 100);
+		for (size_t m = 0; m < table.GetNumMarkets(); m++) {
+			for (CommodityId c = 1; c <= NUM_COMMODITIES; c++) {
+				const size_t i = m * NUM_COMMODITIES + c - 1;
+				INFO("market ", m, " commodity ", c);
+				CHECK(table.GetPrice(c, m) == doctest::Approx(scene.basePrices[c] * (1.0 + levels[i] / 100.0)).epsilon(1e-5));
+				CHECK(table.GetDemand(c, m) == float(std::max(levels[i], 0)));
+				CHECK(table.GetStock(c, m) == (legal[i] ? float(std::max(-levels[i], 0)) : 0.0f));
+			}
+		}
+	}
+
+	SUBCASE("new markets are neutral")
+	{
+		MarketTable table(scene.basePrices);
+		const size_t market = table.AddMarket();
+		table.Update();
+		for (CommodityId c = 1; c <= NUM_COMMODITIES; c++) {
+			CHECK(table.GetPrice(c, market) == scene.basePrices[c]);
+			CHECK(table.GetStock(c, market) == 0.0f);
+			CHECK(table.GetDemand(c, market) == 0.0f);
+		}
+	}
+}
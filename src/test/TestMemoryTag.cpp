@@ -0,0 +1,53 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "core/MemoryTag.h"
+
+#include "doctest.h"
+
+#include <thread>
+
+TEST_CASE("MemoryTag")
+{
+	// the untagged counter isn't used by the engine, so it starts out empty
+	const MemoryTag::Tag tag = MemoryTag::UNTAGGED;
+	MemoryTag::ResetHighWater();
+	const MemoryTag::Stats before = MemoryTag::GetStats(tag);
+
+	SUBCASE("Totals and high-water marks")
+	{
+		MemoryTag::Allocate(tag, 1000);
+		MemoryTag::Allocate(tag, 500);
+		MemoryTag::Free(tag, 1000);
+
+		MemoryTag::Stats stats = MemoryTag::GetStats(tag);
+		CHECK(stats.bytes == before.bytes + 500);
+		CHECK(stats.highWater == before.bytes + 1500);
+		CHECK(stats.numAllocs == before.numAllocs + 2);
+
+		MemoryTag::ResetHighWater();
+		CHECK(MemoryTag::GetStats(tag).highWater == before.bytes + 500);
+
+		MemoryTag::Free(tag, 500);
+		CHECK(MemoryTag::GetStats(tag).bytes == before.bytes);
+	}
+
+	SUBCASE("Scopes nest and are per thread")
+	{
+		CHECK(MemoryTag::GetCurrent(MemoryTag::TEXTURES) == MemoryTag::TEXTURES);
+		{
+			MemoryTag::Scope outer(MemoryTag::MODELS);
+			CHECK(MemoryTag::GetCurrent(MemoryTag::TEXTURES) == MemoryTag::MODELS);
+			{
+				MemoryTag::Scope inner(MemoryTag::TERRAIN);
+				CHECK(MemoryTag::GetCurrent() == MemoryTag::TERRAIN);
+
+				MemoryTag::Tag other = MemoryTag::UNTAGGED;
+				std::thread([&other]() { other = MemoryTag::GetCurrent(MemoryTag::GALAXY); }).join();
+				CHECK(other == MemoryTag::GALAXY);
+			}
+			CHECK(MemoryTag::GetCurrent() == MemoryTag::MODELS);
+		}
+		CHECK(MemoryTag::GetCurrent() == MemoryTag::UNTAGGED);
+	}
+}
@@ -0,0 +1,27 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "galaxy/NameGenerator.h"
+
+#include "doctest.h"
+
+TEST_CASE("System name batches")
+{
+	const Uint32 FIRST_SEED = 0xfffffff0;
+	const Uint32 NUM_NAMES = 64;
+
+	// the range wraps around the end of the seeds
+	std::vector<std::string> names;
+	NameGenerator::GetSystemNames(names, FIRST_SEED, NUM_NAMES);
+	REQUIRE(names.size() == NUM_NAMES);
+
+	for (Uint32 idx = 0; idx < NUM_NAMES; idx++) {
+		Random rng(FIRST_SEED + idx);
+		std::string name;
+		NameGenerator::GetSystemName(name, rng);
+
+		CHECK(names[idx] == name);
+		// and again, from the cache
+		CHECK(NameGenerator::GetSystemName(FIRST_SEED + idx) == name);
+	}
+}
@@ -0,0 +1,82 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Orbit.h"
+
+#include "doctest.h"
+
+#include <vector>
+
+static const double EARTH_MASS = 5.972e24;
+
+TEST_CASE("Orbit state")
+{
+	std::vector<Orbit> orbits;
+	// circular, eccentric, nearly parabolic and hyperbolic, around the earth
+	orbits.push_back(Orbit::FromBodyState(vector3d(7e6, 0, 0), vector3d(50, 7546, 0), EARTH_MASS));
+	orbits.push_back(Orbit::FromBodyState(vector3d(7e6, 0, 0), vector3d(300, 9500, 1000), EARTH_MASS));
+	orbits.push_back(Orbit::FromBodyState(vector3d(7e6, 0, 0), vector3d(100, 10600, 0), EARTH_MASS));
+	orbits.push_back(Orbit::FromBodyState(vector3d(7e6, 0, 0), vector3d(500, 14000, 0), EARTH_MASS));
+	orbits.push_back(Orbit::ForStaticBody(vector3d(1, 2, 3)));
+
+	SUBCASE("matches the position and its derivative")
+	{
+		for (const Orbit &orbit : orbits) {
+			for (double t : { 0.0, 1000.0, 4321.0 }) {
+				vector3d pos, vel;
+				orbit.OrbitalStateAtTime(t, pos, vel);
+				const vector3d expected = orbit.OrbitalPosAtTime(t);
+				CHECK((pos - expected).Length() <= 1e-6 * expected.Length());
+
+				const vector3d diff = (orbit.OrbitalPosAtTime(t + 0.01) - orbit.OrbitalPosAtTime(t - 0.01)) / 0.02;
+				CHECK((vel - diff).Length() <= 1e-3 * diff.Length() + 1e-6);
+			}
+		}
+	}
+
+	SUBCASE("the batch matches one by one")
+	{
+		std::vector<const Orbit *> many;
+		for (int i = 0; i < 100; i++)
+			many.push_back(&orbits[i % orbits.size()]);
+
+		std::vector<vector3d> pos(many.size()), vel(many.size());
+		Orbit::OrbitalStatesAtTime(many.data(), many.size(), 2000.0, pos.data(), vel.data(), nullptr);
+		for (size_t i = 0; i < many.size(); i++) {
+			vector3d p, v;
+			many[i]->OrbitalStateAtTime(2000.0, p, v);
+			CHECK(pos[i].ExactlyEqual(p));
+			CHECK(vel[i].ExactlyEqual(v));
+		}
+	}
+}
+
+TEST_CASE("Lambert transfer")
+{
+	// the path between two points of an orbit is that orbit
+	for (const vector3d &vel : { vector3d(50, 7546, 0), vector3d(300, 9500, 1000), vector3d(500, 14000, 0) }) {
+		const Orbit orbit = Orbit::FromBodyState(vector3d(7e6, 0, 0), vel, EARTH_MASS);
+		for (double t : { 600.0, 2500.0 }) {
+			vector3d r1, u1, r2, u2;
+			orbit.OrbitalStateAtTime(0.0, r1, u1);
+			orbit.OrbitalStateAtTime(t, r2, u2);
+
+			vector3d v1, v2;
+			REQUIRE(Orbit::SolveLambert(r1, r2, t, EARTH_MASS, r1.Cross(u1), v1, v2));
+			CHECK((v1 - u1).Length() <= 1e-4 * u1.Length());
+			CHECK((v2 - u2).Length() <= 1e-4 * u2.Length());
+		}
+	}
+
+	// going the other way round takes a different path
+	vector3d v1, v2;
+	const vector3d r1(7e6, 0, 0), r2(0, 8e6, 0);
+	REQUIRE(Orbit::SolveLambert(r1, r2, 3000.0, EARTH_MASS, vector3d(0, 0, 1), v1, v2));
+	CHECK(v1.y > 0.0);
+	REQUIRE(Orbit::SolveLambert(r1, r2, 3000.0, EARTH_MASS, vector3d(0, 0, -1), v1, v2));
+	CHECK(v1.y < 0.0);
+
+	// no plane to go round in
+	CHECK(!Orbit::SolveLambert(r1, -r1, 3000.0, EARTH_MASS, vector3d(0, 0, 1), v1, v2));
+	CHECK(!Orbit::SolveLambert(r1, r2, -1.0, EARTH_MASS, vector3d(0, 0, 1), v1, v2));
+}
@@ -0,0 +1,51 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "PhysicsStore.h"
+
+#include "doctest.h"
+
+TEST_CASE("PhysicsStore")
+{
+	PhysicsStore store;
+	const Uint32 a = store.Add();
+	const Uint32 b = store.Add();
+	REQUIRE(a != b);
+
+	store.mass[a] = 2.0;
+	store.invMass[a] = 0.5;
+	store.force[a] = vector3d(4.0, 0.0, 0.0);
+	store.externalForce[a] = vector3d(0.0, 2.0, 0.0);
+	store.torque[a] = vector3d(0.0, 0.0, 1.0);
+
+	store.force[b] = vector3d(1.0, 0.0, 0.0);
+	store.moving[b] = 0;
+
+	store.pending[a] = store.pending[b] = 1;
+	store.IntegratePending(0.5f);
+
+	CHECK(store.vel[a].x == doctest::Approx(1.0));
+	CHECK(store.vel[a].y == doctest::Approx(0.5));
+	CHECK(store.angVel[a].z == doctest::Approx(0.5));
+	CHECK(store.angDisplacement[a].z == doctest::Approx(0.25));
+	CHECK(store.lastForce[a].x == doctest::Approx(4.0));
+	CHECK(store.force[a].x == 0.0);
+	CHECK(store.torque[a].z == 0.0);
+	CHECK(!store.pending[a]);
+
+	// a body that isn't moving keeps its forces for when it is
+	CHECK(store.vel[b].x == 0.0);
+	CHECK(store.force[b].x == 1.0);
+
+	// only the pending entries are integrated
+	store.force[a] = vector3d(2.0, 0.0, 0.0);
+	store.IntegratePending(1.0f);
+	CHECK(store.vel[a].x == doctest::Approx(1.0));
+
+	// freed entries are reused, as new
+	store.Remove(a);
+	const Uint32 c = store.Add();
+	CHECK(c == a);
+	CHECK(store.vel[c].x == 0.0);
+	CHECK(store.mass[c] == 1.0);
+}
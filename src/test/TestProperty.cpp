@@ -311,3 +311,61 @@ TEST_CASE("PropertyMap")
 		}
 	}
 }
+
+TEST_CASE("PropertyMapObservers")
+{
+	PropertyMap map;
+	std::vector<std::pair<std::string, int64_t>> calls;
+
+	const uint32_t shields = map.Observe("shields", [&](const StringName &key, const Property &value) {
+		calls.push_back({ std::string(key.sv()), value.get_integer() });
+	});
+	uint32_t all = map.Observe("", [&](const StringName &key, const Property &value) {
+		calls.push_back({ "*" + std::string(key.sv()), value.get_integer() });
+	});
+
+	SUBCASE("Coalesced")
+	{
+		for (int idx = 0; idx < 100; idx++) {
+			map.Set("shields", idx);
+			map.Set("fuel", idx);
+		}
+		CHECK(calls.empty());
+
+		PropertyMap::DispatchChanges();
+		REQUIRE(calls.size() == 3);
+		CHECK(calls[0] == std::make_pair(std::string("shields"), int64_t(99)));
+		CHECK(calls[1] == std::make_pair(std::string("*shields"), int64_t(99)));
+		CHECK(calls[2] == std::make_pair(std::string("*fuel"), int64_t(99)));
+
+		calls.clear();
+		PropertyMap::DispatchChanges();
+		CHECK(calls.empty());
+	}
+
+	SUBCASE("Unobserve")
+	{
+		map.Unobserve(shields);
+		map.Set("shields", 1);
+		PropertyMap::DispatchChanges();
+		REQUIRE(calls.size() == 1);
+		CHECK(calls[0].first == "*shields");
+
+		map.Unobserve(all);
+		calls.clear();
+		map.Set("shields", 2);
+		PropertyMap::DispatchChanges();
+		CHECK(calls.empty());
+	}
+
+	SUBCASE("Destroyed")
+	{
+		PropertyMap *other = new PropertyMap();
+		other->Observe("", [&](const StringName &, const Property &) { calls.push_back({ "other", 0 }); });
+		other->Set("fuel", 1);
+		delete other;
+
+		PropertyMap::DispatchChanges();
+		CHECK(calls.empty());
+	}
+}
@@ -0,0 +1,79 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "QualityGovernor.h"
+
+#include "doctest.h"
+
+namespace {
+	// frames of the same time for the given seconds, at that frame rate
+	double RunFrames(QualityGovernor &governor, double time, double seconds, float frameMs, float gpuMs = 0.0f)
+	{
+		const double end = time + seconds;
+		for (; time < end; time += frameMs * 1e-3)
+			governor.Update(time, frameMs, gpuMs);
+		return time;
+	}
+} // namespace
+
+TEST_CASE("Quality Governor")
+{
+	int first = 4, second = 4;
+	bool secondCanChange = true;
+
+	QualityGovernor governor(10.0f);
+	governor.AddKnob({ "first", 2, 4, [&]() { return first; }, [&](int level) { first = level; } });
+	governor.AddKnob({ "second", 0, 4, [&]() { return second; }, [&](int level) { second = level; },
+		[&]() { return secondCanChange; } });
+
+	SUBCASE("Within the budget nothing changes")
+	{
+		RunFrames(governor, 0.0, 60.0, 9.0f);
+		CHECK(first == 4);
+		CHECK(second == 4);
+		CHECK(governor.GetState() == QualityGovernor::STATE_STEADY);
+	}
+
+	SUBCASE("Turns down in order down to the minimum")
+	{
+		double time = RunFrames(governor, 0.0, 20.0, 20.0f);
+		CHECK(first == 2);
+		CHECK(second == 0);
+		CHECK(governor.GetState() == QualityGovernor::STATE_OVER_BUDGET);
+
+		// the last down is the first up, after the hold
+		time = RunFrames(governor, time, QualityGovernor::RAISE_HOLD * 0.5, 5.0f);
+		CHECK(second == 0);
+		RunFrames(governor, time, QualityGovernor::RAISE_HOLD * 0.6, 5.0f);
+		CHECK(second == 1);
+		CHECK(first == 2);
+	}
+
+	SUBCASE("The GPU time counts too")
+	{
+		RunFrames(governor, 0.0, 2.0, 9.0f, 20.0f);
+		CHECK(first < 4);
+	}
+
+	SUBCASE("Waits for a knob to be able to change")
+	{
+		secondCanChange = false;
+		double time = RunFrames(governor, 0.0, 20.0, 20.0f);
+		CHECK(first == 2);
+		CHECK(second == 4);
+
+		secondCanChange = true;
+		RunFrames(governor, time, 2.0, 20.0f);
+		CHECK(second < 4);
+	}
+
+	SUBCASE("Taking back a raise doubles the hold")
+	{
+		double time = RunFrames(governor, 0.0, 2.5, 20.0f);
+		REQUIRE(first < 4);
+		time = RunFrames(governor, time, QualityGovernor::RAISE_HOLD * 1.2, 5.0f);
+		REQUIRE(first == 4);
+		RunFrames(governor, time, 2.0, 20.0f);
+		CHECK(governor.GetRaiseHold() == QualityGovernor::RAISE_HOLD * 2.0);
+	}
+}
@@ -0,0 +1,53 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Random.h"
+
+#include "doctest.h"
+
+#include <vector>
+
+TEST_CASE("Random bulk generators")
+{
+	// short runs, runs of whole lanes and runs with a ragged tail
+	for (size_t count : { 0, 3, 16, 100, 1000, 1003 }) {
+		CAPTURE(count);
+		Random bulk(1234), single(1234);
+
+		std::vector<Uint32> ints(count);
+		bulk.FillInt32(ints.data(), count);
+		size_t numMatching = 0;
+		for (size_t idx = 0; idx < count; idx++)
+			numMatching += ints[idx] == single.Int32();
+		CHECK(numMatching == count);
+
+		bulk.FillInt32(ints.data(), count, 7);
+		numMatching = 0;
+		for (size_t idx = 0; idx < count; idx++)
+			numMatching += ints[idx] == single.Int32(7);
+		CHECK(numMatching == count);
+
+		std::vector<int> ranged(count);
+		bulk.FillInt32(ranged.data(), count, -10, 10);
+		numMatching = 0;
+		for (size_t idx = 0; idx < count; idx++)
+			numMatching += ranged[idx] == single.Int32(-10, 10);
+		CHECK(numMatching == count);
+
+		std::vector<double> doubles(count);
+		bulk.FillDouble(doubles.data(), count);
+		numMatching = 0;
+		for (size_t idx = 0; idx < count; idx++)
+			numMatching += doubles[idx] == single.Double();
+		CHECK(numMatching == count);
+
+		bulk.FillDouble(doubles.data(), count, -3.5, 0.25);
+		numMatching = 0;
+		for (size_t idx = 0; idx < count; idx++)
+			numMatching += doubles[idx] == single.Double(-3.5, 0.25);
+		CHECK(numMatching == count);
+
+		// and both are left at the same point of the sequence
+		CHECK(bulk.Int32() == single.Int32());
+	}
+}
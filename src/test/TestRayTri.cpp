@@ -0,0 +1,110 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "collider/GeomTree.h"
+#include "collider/RayTri.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+#include "doctest.h"
+
+static constexpr int NUM_TRIS = 1024;
+static constexpr int NUM_RAYS = 64;
+
+struct RayTriScene {
+	std::vector<vector3f> vertices;
+	std::vector<Uint32> indices;
+	std::vector<int> triOffsets;
+	std::vector<vector3f> dirs;
+	vector3f origin;
+
+	RayTriScene(Uint32 seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> pos(-10.0f, 10.0f);
+
+		// triangles scattered around the origin, some sharing vertices
+		for (int i = 0; i < NUM_TRIS * 2; i++)
+			vertices.emplace_back(pos(rng), pos(rng), pos(rng));
+
+		std::uniform_int_distribution<Uint32> vtx(0, Uint32(vertices.size() - 1));
+		for (int i = 0; i < NUM_TRIS; i++) {
+			triOffsets.push_back(int(indices.size()));
+			indices.push_back(vtx(rng));
+			indices.push_back(vtx(rng));
+			indices.push_back(vtx(rng));
+		}
+
+		origin = vector3f(pos(rng), pos(rng), pos(rng)) * 0.1f;
+		for (int i = 0; i < NUM_RAYS; i++)
+			dirs.push_back(vector3f(pos(rng), pos(rng), pos(rng)).Normalized());
+
+		// axis-aligned rays exercise the zero and infinite lanes
+		dirs[0] = vector3f(1.0f, 0.0f, 0.0f);
+		dirs[1] = vector3f(0.0f, -1.0f, 0.0f);
+	}
+};
+
+static void ResetIsects(std::vector<isect_t> &isects, size_t count)
+{
+	isects.assign(count, isect_t{ -1, 1e6f });
+}
+
+static bool SameIsect(const isect_t &a, const isect_t &b)
+{
+	return a.triIdx == b.triIdx && std::memcmp(&a.dist, &b.dist, sizeof(float)) == 0;
+}
+
+TEST_CASE("RayTri Kernels")
+{
+	RayTriScene scene(1234);
+	std::vector<isect_t> packet, scalar;
+
+	SUBCASE("Rays against one triangle")
+	{
+		int numHits = 0;
+		for (int numRays : { 1, 3, 4, 7, 8, 13, NUM_RAYS }) {
+			ResetIsects(packet, numRays);
+			ResetIsects(scalar, numRays);
+
+			for (int offset : scene.triOffsets) {
+				const vector3f &a = scene.vertices[scene.indices[offset + 0]];
+				const vector3f &b = scene.vertices[scene.indices[offset + 1]];
+				const vector3f &c = scene.vertices[scene.indices[offset + 2]];
+
+				RayTri::RaysTriangle(scene.origin, scene.dirs.data(), numRays, a, b, c, offset / 3, packet.data());
+				RayTri::RaysTriangleScalar(scene.origin, scene.dirs.data(), numRays, a, b, c, offset / 3, scalar.data());
+			}
+
+			for (int i = 0; i < numRays; i++) {
+				INFO("ray ", i, " of ", numRays);
+				CHECK(SameIsect(packet[i], scalar[i]));
+				numHits += scalar[i].triIdx >= 0;
+			}
+		}
+
+		// make sure the test actually hits something
+		CHECK(numHits > 0);
+	}
+
+	SUBCASE("One ray against triangles")
+	{
+		int numHits = 0;
+		for (int numTris : { 1, 3, 4, 7, 8, 13, NUM_TRIS }) {
+			for (const vector3f &dir : scene.dirs) {
+				isect_t packetIsect = { -1, 1e6f };
+				isect_t scalarIsect = { -1, 1e6f };
+
+				RayTri::RayTriangles(scene.origin, dir, scene.vertices.data(), scene.indices.data(), scene.triOffsets.data(), numTris, &packetIsect);
+				RayTri::RayTrianglesScalar(scene.origin, dir, scene.vertices.data(), scene.indices.data(), scene.triOffsets.data(), numTris, &scalarIsect);
+
+				INFO(numTris, " triangles");
+				CHECK(SameIsect(packetIsect, scalarIsect));
+				numHits += scalarIsect.triIdx >= 0;
+			}
+		}
+
+		CHECK(numHits > 0);
+	}
+}
@@ -0,0 +1,98 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "scenegraph/Group.h"
+#include "scenegraph/MatrixTransform.h"
+#include "scenegraph/RenderList.h"
+
+#include "doctest.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace SceneGraph;
+
+// Records the transforms it is drawn with
+class RecordingNode : public Node {
+public:
+	RecordingNode(unsigned int mask, std::vector<std::pair<const Node *, matrix4x4f>> &draws) :
+		Node(nullptr, mask),
+		m_draws(draws)
+	{}
+
+	virtual Node *Clone(NodeCopyCache *) override { return this; }
+	virtual void Render(const matrix4x4f &trans, const RenderData *rd) override
+	{
+		m_draws.push_back({ this, trans });
+	}
+
+private:
+	std::vector<std::pair<const Node *, matrix4x4f>> &m_draws;
+};
+
+static bool same_draws(const std::vector<std::pair<const Node *, matrix4x4f>> &a, const std::vector<std::pair<const Node *, matrix4x4f>> &b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].first != b[i].first)
+			return false;
+		for (int j = 0; j < 16; j++) {
+			if (std::abs(a[i].second[j] - b[i].second[j]) > 1e-5f)
+				return false;
+		}
+	}
+	return true;
+}
+
+TEST_CASE("RenderList")
+{
+	std::vector<std::pair<const Node *, matrix4x4f>> tree, list;
+
+	RefCountedPtr<Group> root(new Group(nullptr));
+	MatrixTransform *outer = new MatrixTransform(nullptr, matrix4x4f::Translation(1.f, 0.f, 0.f));
+	MatrixTransform *animated = new MatrixTransform(nullptr, matrix4x4f::RotateYMatrix(0.5f));
+	MatrixTransform *inner = new MatrixTransform(nullptr, matrix4x4f::Translation(0.f, 0.f, 3.f));
+	Group *transparent = new Group(nullptr);
+	transparent->SetNodeMask(NODE_TRANSPARENT);
+
+	root->AddChild(outer);
+	outer->AddChild(animated);
+	animated->AddChild(inner);
+	inner->AddChild(new RecordingNode(NODE_SOLID, tree));
+	outer->AddChild(new RecordingNode(NODE_SOLID | NODE_TRANSPARENT, tree));
+	root->AddChild(transparent);
+	transparent->AddChild(new RecordingNode(NODE_SOLID | NODE_TRANSPARENT, tree));
+	CHECK(root->HasTreeChanged());
+
+	RenderList renderList(root.Get(), { animated });
+	CHECK(renderList.GetNumNodes() == 3);
+	CHECK(renderList.GetNumAnimated() == 1);
+
+	const matrix4x4f trans = matrix4x4f::Translation(0.f, -2.f, -10.f);
+	for (int step = 0; step < 2; step++) {
+		for (unsigned int nodemask : { NODE_SOLID, NODE_TRANSPARENT }) {
+			RenderData rd;
+			rd.nodemask = nodemask;
+			tree.clear();
+			root->Render(trans, &rd);
+			const std::vector<std::pair<const Node *, matrix4x4f>> expected = tree;
+
+			// the nodes record into the same list, swap it out
+			tree.clear();
+			renderList.Prepare(trans, &rd);
+			renderList.Render(&rd);
+			list.swap(tree);
+
+			CHECK(!expected.empty());
+			CHECK(same_draws(expected, list));
+		}
+
+		// moving the animated transform moves the nodes below it
+		animated->SetTransform(matrix4x4f::RotateXMatrix(1.f));
+	}
+
+	root->ClearTreeChanged();
+	inner->RemoveChildAt(0);
+	CHECK(root->HasTreeChanged());
+}
@@ -0,0 +1,85 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "graphics/ShaderParser.h"
+
+#include "doctest.h"
+
+#include <map>
+
+using namespace Graphics::ShaderParser;
+
+TEST_CASE("Shader Source Cache")
+{
+	std::map<std::string, std::string> files = {
+		{ "shaders/test.shaderdef", "Shader test\nVertex \"test.vert\"\nFragment \"test.frag\"\n" },
+		{ "shaders/test.vert", "#include \"common.glsl\"\nvoid main() {}\n" },
+		{ "shaders/common.glsl", "#include \"lighting.glsl\"\nuniform float a;\n" },
+		{ "shaders/lighting.glsl", "uniform float b;\n" },
+		{ "shaders/twice.vert", "#include \"lighting.glsl\"\n#include \"lighting.glsl\"\n" },
+	};
+
+	SourceCache cache([&](const std::string &path, std::string &out) {
+		auto iter = files.find(path);
+		if (iter == files.end())
+			return false;
+		out = iter->second;
+		return true;
+	});
+
+	SUBCASE("Includes are expanded once per generation")
+	{
+		auto source = cache.GetExpandedSource("shaders/test.vert", "shaders");
+		REQUIRE(source.get() != nullptr);
+		CHECK(*source == "uniform float b;\n\nuniform float a;\n\nvoid main() {}\n");
+		CHECK(cache.GetNumReads() == 3);
+
+		CHECK(cache.GetExpandedSource("shaders/test.vert", "shaders").get() == source.get());
+		CHECK(cache.GetNumReads() == 3);
+
+		// unchanged files are read again, but the expansion is reused
+		cache.Revalidate();
+		CHECK(cache.GetExpandedSource("shaders/test.vert", "shaders").get() == source.get());
+		CHECK(cache.GetNumReads() == 6);
+
+		// a change deep in the include tree is picked up
+		files["shaders/lighting.glsl"] = "uniform float c;\n";
+		cache.Revalidate();
+		auto changed = cache.GetExpandedSource("shaders/test.vert", "shaders");
+		REQUIRE(changed.get() != nullptr);
+		CHECK(changed.get() != source.get());
+		CHECK(*changed == "uniform float c;\n\nuniform float a;\n\nvoid main() {}\n");
+	}
+
+	SUBCASE("Broken sources aren't cached")
+	{
+		CHECK(cache.GetExpandedSource("shaders/missing.vert", "shaders").get() == nullptr);
+		CHECK(cache.GetExpandedSource("shaders/twice.vert", "shaders").get() == nullptr);
+
+		files["shaders/missing.vert"] = "void main() {}\n";
+		CHECK(cache.GetExpandedSource("shaders/missing.vert", "shaders").get() == nullptr);
+		cache.Revalidate();
+		CHECK(cache.GetExpandedSource("shaders/missing.vert", "shaders").get() != nullptr);
+	}
+
+	SUBCASE("Definitions are parsed again only when they change")
+	{
+		ShaderInfo info;
+		REQUIRE(cache.GetShaderInfo("shaders/test.shaderdef", info));
+		CHECK(info.name == "test");
+		CHECK(info.vertexPath == "test.vert");
+		CHECK(info.fragmentPath == "test.frag");
+
+		cache.Revalidate();
+		REQUIRE(cache.GetShaderInfo("shaders/test.shaderdef", info));
+		CHECK(cache.GetNumParses() == 1);
+
+		files["shaders/test.shaderdef"] = "Shader renamed\nVertex \"test.vert\"\nFragment \"test.frag\"\n";
+		cache.Revalidate();
+		REQUIRE(cache.GetShaderInfo("shaders/test.shaderdef", info));
+		CHECK(cache.GetNumParses() == 2);
+		CHECK(info.name == "renamed");
+
+		CHECK(!cache.GetShaderInfo("shaders/missing.shaderdef", info));
+	}
+}
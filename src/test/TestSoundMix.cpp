@@ -0,0 +1,73 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "sound/SoundMix.h"
+
+#include "doctest.h"
+
+#include <cmath>
+#include <vector>
+
+TEST_CASE("Sound Mix")
+{
+	std::vector<Sint16> in(1001 * 2);
+	for (size_t i = 0; i < in.size(); i++)
+		in[i] = Sint16((i * 7919) % 65536 - 32768);
+
+	SUBCASE("Constant volume")
+	{
+		std::vector<float> out(4, 1.0f);
+		float volume[2] = { 0.5f, 0.25f };
+		const float target[2] = { 0.5f, 0.25f };
+		const float rate[2] = { 0.0f, 0.0f };
+		const Sint16 frames[4] = { 1000, -2000, 3000, 4000 };
+		Sound::MixVoice(out.data(), frames, 2, 2, 1, volume, target, rate);
+		CHECK(out[0] == 501.0f);
+		CHECK(out[1] == -499.0f);
+		CHECK(out[2] == 1501.0f);
+		CHECK(out[3] == 1001.0f);
+		CHECK(volume[0] == 0.5f);
+	}
+
+	SUBCASE("Vector kernel matches the scalar one")
+	{
+		for (int channels = 1; channels <= 2; channels++) {
+			for (int upsample = 1; upsample <= 2; upsample++) {
+				const Uint32 frames = 1001;
+				std::vector<float> scalar(frames * 2 * upsample, 0.0f);
+				std::vector<float> vector(frames * 2 * upsample, 0.0f);
+
+				// one channel ramps up and reaches its target, the other ramps down
+				float scalarVolume[2] = { 0.1f, 0.9f };
+				float vectorVolume[2] = { 0.1f, 0.9f };
+				const float target[2] = { 0.6f, 0.3f };
+				const float rate[2] = { 0.001f, 0.0001f };
+				Sound::MixVoiceScalar(scalar.data(), in.data(), frames, channels, upsample, scalarVolume, target, rate);
+				Sound::MixVoice(vector.data(), in.data(), frames, channels, upsample, vectorVolume, target, rate);
+
+				CAPTURE(channels);
+				CAPTURE(upsample);
+				CHECK(scalarVolume[0] == 0.6f);
+				CHECK(vectorVolume[0] == 0.6f);
+				CHECK(std::abs(scalarVolume[1] - vectorVolume[1]) < 1e-6f);
+				for (size_t i = 0; i < scalar.size(); i++) {
+					if (std::abs(scalar[i] - vector[i]) > 0.01f) {
+						FAIL_CHECK("output " << i << " differs: " << scalar[i] << " vs " << vector[i]);
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	SUBCASE("Silent voices are skipped")
+	{
+		std::vector<float> out(8, 0.0f);
+		float volume[2] = { 0.0f, 0.0f };
+		const float target[2] = { 0.0f, 0.0f };
+		const float rate[2] = { 0.0f, 0.0f };
+		Sound::MixVoice(out.data(), in.data(), 4, 2, 1, volume, target, rate);
+		for (float value : out)
+			CHECK(value == 0.0f);
+	}
+}
@@ -0,0 +1,136 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "doctest.h"
+
+static constexpr uint32_t NUM_OBJECTS = 2000;
+static constexpr uint32_t NUM_QUERIES = 2000;
+static constexpr double CELL_SIZE = 1000.0;
+static constexpr uint32_t NUM_LEVELS = 6;
+static constexpr double RANGES[] = { 100.0, 2000.0, 4000.0, 20000.0, 100000.0 };
+
+// Traffic around one or more stations spread over a star system, queried with
+// the ranges used by missiles, ECM, docking traffic and sensors
+struct GridScene {
+	std::vector<vector3d> positions;
+	std::vector<vector3d> queryPos;
+	std::vector<double> queryRadius;
+
+	GridScene(uint32_t seed, uint32_t numClusters)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<double> system(-1e12, 1e12);
+		std::normal_distribution<double> traffic(0.0, 20000.0);
+		std::uniform_int_distribution<uint32_t> cluster(0, numClusters - 1);
+
+		std::vector<vector3d> centers;
+		for (uint32_t i = 0; i < numClusters; i++)
+			centers.emplace_back(system(rng), system(rng), system(rng) * 0.01);
+
+		for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+			positions.push_back(centers[cluster(rng)] + vector3d(traffic(rng), traffic(rng), traffic(rng)));
+
+		for (uint32_t i = 0; i < NUM_QUERIES; i++) {
+			queryPos.push_back(positions[i % NUM_OBJECTS]);
+			queryRadius.push_back(RANGES[i % 5]);
+		}
+	}
+};
+
+static void TestSpatialGrid(uint32_t numClusters)
+{
+	GridScene scene(1357, numClusters);
+
+	SpatialGrid<uint32_t> grid(CELL_SIZE, NUM_LEVELS);
+	for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+		grid.Add(scene.positions[i], i);
+	grid.Build();
+
+	SUBCASE("Query matches brute force")
+	{
+		size_t numFound = 0;
+		std::vector<uint32_t> found;
+		for (uint32_t q = 0; q < NUM_QUERIES; q++) {
+			found.clear();
+			grid.Query(scene.queryPos[q], scene.queryRadius[q], found);
+			std::sort(found.begin(), found.end());
+
+			std::vector<uint32_t> expected;
+			for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+				if ((scene.positions[i] - scene.queryPos[q]).Length() <= scene.queryRadius[q])
+					expected.push_back(i);
+
+			INFO("query ", q, " radius ", scene.queryRadius[q]);
+			CHECK(found == expected);
+			numFound += found.size();
+		}
+
+		// every query finds at least the object it is centered on
+		CHECK(numFound > NUM_QUERIES);
+	}
+
+	SUBCASE("QueryCone matches brute force")
+	{
+		std::mt19937 rng(2468);
+		std::uniform_real_distribution<double> unit(-1.0, 1.0);
+
+		size_t numFound = 0;
+		for (uint32_t q = 0; q < 200; q++) {
+			const vector3d apex = scene.queryPos[q] + vector3d(unit(rng), unit(rng), unit(rng)) * 5000.0;
+			const vector3d dir = vector3d(unit(rng), unit(rng), unit(rng)).Normalized();
+			const double cosAngle = std::cos(0.05 + 0.5 * (unit(rng) + 1.0));
+
+			std::vector<std::pair<uint32_t, double>> found;
+			grid.QueryCone(apex, dir, cosAngle, [&](uint32_t item, double dist) { found.emplace_back(item, dist); });
+			std::sort(found.begin(), found.end());
+
+			std::vector<std::pair<uint32_t, double>> expected;
+			for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+				const vector3d toObj = scene.positions[i] - apex;
+				if (toObj.Normalized().Dot(dir) >= cosAngle)
+					expected.emplace_back(i, toObj.Length());
+			}
+
+			INFO("cone ", q);
+			REQUIRE(found.size() == expected.size());
+			for (size_t i = 0; i < found.size(); i++) {
+				CHECK(found[i].first == expected[i].first);
+				CHECK(found[i].second == doctest::Approx(expected[i].second));
+			}
+			numFound += found.size();
+		}
+
+		CHECK(numFound > 0);
+	}
+
+	SUBCASE("Rebuild")
+	{
+		grid.Clear();
+		std::vector<uint32_t> found;
+		grid.Query(scene.queryPos[0], 1e6, found);
+		CHECK(found.empty());
+
+		grid.Add(vector3d(0.0), 7);
+		grid.Add(vector3d(-CELL_SIZE * 0.5), 8);
+		grid.Build();
+		grid.Query(vector3d(-1.0, 0.0, 0.0), 1.0, found);
+		CHECK(found == std::vector<uint32_t>{ 7 });
+		CHECK(grid.GetNumCells(0) == 2);
+	}
+}
+
+TEST_CASE("SpatialGrid System")
+{
+	TestSpatialGrid(8);
+}
+
+TEST_CASE("SpatialGrid Station")
+{
+	TestSpatialGrid(1);
+}
@@ -9,18 +9,27 @@
 #include <iostream>
 #include "doctest.h"
 
+#include <thread>
+
 static constexpr uint32_t ITERATIONS = 10000;
 static constexpr uint32_t LOOKUP_ITERATIONS = 20000;
 
+static StringTable::Data intern(StringTable *st, std::string_view str)
+{
+	return st->Intern(str.data(), uint32_t(str.size()), hash_32_fnv1a(str.data(), str.size()));
+}
+
 void insertion_stress_test(StringTable *st, uint32_t test_num)
 {
+	std::vector<std::string> strings(ITERATIONS);
+	for (uint32_t idx = 0; idx < ITERATIONS; idx++)
+		strings[idx] = fmt::format("stress test string {}", idx);
+
 	Profiler::Clock clock{};
 	clock.Start();
 
-	for (uint32_t idx = 0; idx < ITERATIONS; idx++) {
-		uint32_t hash = hash_32_fnv1a(reinterpret_cast<char *>(&idx), sizeof(uint32_t));
-		st->FindOrCreate(hash);
-	}
+	for (uint32_t idx = 0; idx < ITERATIONS; idx++)
+		intern(st, strings[idx]);
 
 	clock.Stop();
 	Log::Info("StringTable[run {}]: Insertion of {} elements took {}ms\n", test_num, ITERATIONS, clock.milliseconds());
@@ -40,66 +49,80 @@ void insertion_stress_test(StringTable *st, uint32_t test_num)
 TEST_CASE("String Table")
 {
 	StringTable *st = new StringTable(1 << 10);
-	uint32_t test_hash = "test12345"_hash32;
+	std::string_view test_str = "test string 12345";
+	uint32_t test_hash = hash_32_fnv1a(test_str.data(), test_str.size());
 
 	REQUIRE(st != nullptr);
 
 	SUBCASE("Creation")
 	{
-		StringTable::Data *entry = st->Find(test_hash);
-
-		CHECK(entry == nullptr);
+		CHECK(st->Find(test_hash) == nullptr);
 
-		entry = st->Create(test_hash);
-		CHECK(entry != nullptr);
-		CHECK(*entry == nullptr);
+		StringTable::Data entry = intern(st, test_str);
+		REQUIRE(entry != nullptr);
+		CHECK(std::string_view(entry->get()) == test_str);
+		CHECK(entry->get_ref() == 1);
+		CHECK(st->Size() == 1);
 
-		StringTable::Data *entry2 = st->Find(test_hash);
-		CHECK(entry == entry2);
+		CHECK(st->Find(test_hash) == entry);
+		CHECK(intern(st, test_str) == entry);
+		CHECK(entry->get_ref() == 2);
+		CHECK(st->Size() == 1);
 	}
 
-	SUBCASE("Deletion")
+	SUBCASE("Reclaim")
 	{
-		StringTable::Data *entry = st->Create(test_hash);
-		StringTable::Data *entry2 = st->Create(test_hash + 1);
-
-		CHECK(entry != nullptr);
-		CHECK(entry2 != nullptr);
+		StringTable::Data entry = intern(st, test_str);
+		StringTable::Data entry2 = intern(st, "another test string");
+		CHECK(st->Size() == 2);
 
-		st->Erase(test_hash);
+		entry->unref();
+		st->Reclaim(true);
 
+		CHECK(st->Size() == 1);
 		CHECK(st->Find(test_hash) == nullptr);
-		CHECK(st->Find(test_hash + 1) == entry2);
+		CHECK(st->Find("another test string"_hash32) == entry2);
+	}
+
+	SUBCASE("Revive")
+	{
+		// unreferenced strings are kept until reclaimed and can be revived
+		StringTable::Data entry = intern(st, test_str);
+		entry->unref();
 
-		st->Erase(test_hash + 1);
+		CHECK(intern(st, test_str) == entry);
+		CHECK(entry->get_ref() == 1);
 
-		CHECK(st->Find(test_hash + 1) == nullptr);
+		st->Reclaim(true);
+		CHECK(st->Size() == 1);
 	}
 
 	SUBCASE("Contention")
 	{
-		// note: more than 256 items sharing the same slot in the hash table
-		// will cause erasure to fail (due to storing item offsets in uint8)
-		// This is *extremely* unlikely to happen outside of synthetic test cases
-		uint32_t mask = uint32_t(st->Capacity() - 1);
-		std::vector<uint32_t> hashes(255, test_hash & mask);
+		// keys sharing a shard are probed linearly within it
+		std::vector<uint32_t> hashes(255, test_hash & 0xF000000F);
 
 		for (uint32_t idx = 0; idx < uint32_t(hashes.size()); idx++) {
-			hashes[idx] |= idx * st->Capacity();
-			CHECK(st->Create(hashes[idx]) != nullptr);
+			hashes[idx] |= (idx + 1) << 4;
+			CHECK(st->Intern("x", 1, hashes[idx]) != nullptr);
 		}
 
 		CHECK(st->Size() == 255);
 
 		for (uint32_t idx = 0; idx < uint32_t(hashes.size()); idx++) {
-			CHECK(st->Find(hashes[idx]) != nullptr);
+			INFO(hashes[idx]);
+			StringTable::Data entry = st->Find(hashes[idx]);
+			REQUIRE(entry != nullptr);
+			if (!(idx % 8))
+				entry->unref();
 		}
 
+		st->Reclaim(true);
+		CHECK(st->Size() == 255 - 32);
+
 		for (uint32_t idx = 0; idx < uint32_t(hashes.size()); idx++) {
 			INFO(hashes[idx]);
-			CHECK(st->Find(hashes[idx]) != nullptr);
-			if (!(idx % 8))
-				st->Erase(hashes[idx]);
+			CHECK((st->Find(hashes[idx]) == nullptr) == !(idx % 8));
 		}
 	}
 
@@ -114,6 +137,85 @@ TEST_CASE("String Table")
 	delete st;
 }
 
+TEST_CASE("String Table Threading")
+{
+	static constexpr uint32_t NUM_THREADS = 8;
+	static constexpr uint32_t NUM_STRINGS = 4096;
+	static constexpr uint32_t NUM_ROUNDS = 16;
+
+	StringTable *st = new StringTable(1 << 10);
+
+	// every thread interns the same strings in a different order, and drops
+	// half of its references each round
+	std::vector<std::string> strings(NUM_STRINGS);
+	for (uint32_t idx = 0; idx < NUM_STRINGS; idx++)
+		strings[idx] = fmt::format("threaded string table test {}", idx);
+
+	std::vector<std::vector<StringTable::Data>> results(NUM_THREADS);
+	std::atomic<uint32_t> numErrors = 0;
+
+	Profiler::Clock clock{};
+	clock.Start();
+
+	std::vector<std::thread> threads;
+	for (uint32_t thread = 0; thread < NUM_THREADS; thread++) {
+		threads.emplace_back([&, thread]() {
+			std::vector<StringTable::Data> &held = results[thread];
+			held.resize(NUM_STRINGS, nullptr);
+
+			for (uint32_t round = 0; round < NUM_ROUNDS; round++) {
+				for (uint32_t count = 0; count < NUM_STRINGS; count++) {
+					uint32_t idx = (count * 7 + thread * 997) % NUM_STRINGS;
+					StringTable::Data data = intern(st, strings[idx]);
+
+					if (strings[idx] != data->get())
+						numErrors++;
+
+					if (held[idx])
+						held[idx]->unref();
+
+					held[idx] = ((idx + round) % 2) ? data : nullptr;
+					if (!held[idx])
+						data->unref();
+				}
+			}
+		});
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	clock.Stop();
+	Log::Info("StringTable: {} threads interning {} strings took {}ms\n", NUM_THREADS, NUM_THREADS * NUM_STRINGS * NUM_ROUNDS, clock.milliseconds());
+
+	CHECK(numErrors == 0);
+	CHECK(st->Size() == NUM_STRINGS);
+
+	// strings held at the same time must share the same storage
+	for (uint32_t idx = 0; idx < NUM_STRINGS; idx++) {
+		StringTable::Data first = nullptr;
+		for (uint32_t thread = 0; thread < NUM_THREADS; thread++) {
+			StringTable::Data data = results[thread][idx];
+			if (!data)
+				continue;
+
+			if (!first)
+				first = data;
+			CHECK(data == first);
+		}
+	}
+
+	for (auto &held : results)
+		for (StringTable::Data data : held)
+			if (data)
+				data->unref();
+
+	st->Reclaim(true);
+	CHECK(st->Size() == 0);
+
+	delete st;
+}
+
 TEST_CASE("StringName")
 {
 
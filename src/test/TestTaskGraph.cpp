@@ -9,6 +9,11 @@
 #include "doctest/doctest.h"
 #include "profiler/Profiler.h"
 
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
 std::atomic<uint32_t> s_numExec = 0;
 
 void busy_wait(uint32_t uSec = 500)
@@ -136,6 +141,89 @@ TEST_CASE("Task Graph")
 			graph->GetJobQueue()->FinishJobs();
 	}
 
+	SUBCASE("Job Continuations")
+	{
+		std::atomic<uint32_t> numRun = 0;
+		std::atomic<uint32_t> runBeforeFanIn = 0;
+
+		class CountingJob : public Job {
+		public:
+			CountingJob(std::atomic<uint32_t> &counter, std::atomic<uint32_t> *seen = nullptr) :
+				m_counter(counter),
+				m_seen(seen) {}
+
+			void OnRun() override
+			{
+				busy_wait(200);
+				if (m_seen)
+					m_seen->store(m_counter.load());
+				m_counter.fetch_add(1);
+			}
+			void OnFinish() override {}
+
+		private:
+			std::atomic<uint32_t> &m_counter;
+			std::atomic<uint32_t> *m_seen;
+		};
+
+		JobQueue *queue = graph->GetJobQueue();
+		Job::Handle a = queue->Queue(new CountingJob(numRun));
+		Job::Handle b = queue->Queue(new CountingJob(numRun));
+		Job::Handle c = queue->Queue(new CountingJob(numRun));
+
+		// fan-in: d must see all of a, b and c complete
+		Job::Handle d = queue->QueueAfter(new CountingJob(numRun, &runBeforeFanIn), { a.GetJob(), b.GetJob(), c.GetJob() });
+		// chain: e runs after d without a main-thread round trip
+		Job::Handle e = queue->QueueAfter(new CountingJob(numRun), { d.GetJob() });
+
+		while (e.HasJob())
+			queue->FinishJobs();
+
+		CHECK(runBeforeFanIn.load() == 3);
+		CHECK(numRun.load() == 5);
+	}
+
+	SUBCASE("Wait for Task Set in a Job")
+	{
+		graph->SetWorkStealing(true);
+
+		class SplitJob : public Job {
+		public:
+			SplitJob(TaskGraph *graph, std::atomic<uint32_t> &counter) :
+				m_graph(graph),
+				m_counter(counter) {}
+
+			void OnRun() override
+			{
+				TaskSet *set = new TaskSet();
+				set->AddTaskRangeLambda({ 0, 64 }, 1, [this](TaskRange r) {
+					busy_wait(50);
+					m_counter.fetch_add(r.end - r.begin);
+				});
+
+				TaskSet::Handle handle = m_graph->QueueTaskSet(set);
+				m_graph->WaitForTaskSet(handle);
+				m_done = m_counter.load();
+			}
+			void OnFinish() override { CHECK(m_done >= 64); }
+
+		private:
+			TaskGraph *m_graph;
+			std::atomic<uint32_t> &m_counter;
+			uint32_t m_done = 0;
+		};
+
+		std::atomic<uint32_t> numElements = 0;
+		JobQueue *queue = graph->GetJobQueue();
+		Job::Handle a = queue->Queue(new SplitJob(graph, numElements));
+		Job::Handle b = queue->Queue(new SplitJob(graph, numElements));
+
+		while (a.HasJob() || b.HasJob())
+			queue->FinishJobs();
+
+		CHECK(numElements.load() == 128);
+	}
+
 	SUBCASE("Wait on Other Threads")
 	{
 		Profiler::reset();
@@ -185,6 +273,43 @@ TEST_CASE("Task Graph")
 		// Profiler::dumpzones(path.c_str());
 	}
 
+	SUBCASE("Work Stealing")
+	{
+		graph->SetWorkStealing(true);
+
+		TaskSet *set = new TaskSet();
+		for (uint32_t idx = 0; idx < 256; idx++) {
+			set->AddTask(new TestTask());
+		}
+
+		TaskSet::Handle handle = graph->QueueTaskSet(set);
+		graph->WaitForTaskSet(handle);
+
+		CHECK(s_numExec.load() == 256);
+	}
+
+	SUBCASE("Split Range Tasks")
+	{
+		graph->SetWorkStealing(true);
+
+		std::atomic<uint32_t> numElements = 0;
+		std::atomic<uint32_t> numRanges = 0;
+
+		TaskSet *set = new TaskSet();
+		set->AddTaskRangeLambda({ 0, 4096 }, 64, [&](TaskRange r) {
+			CHECK(r.end - r.begin <= 64);
+			numElements.fetch_add(r.end - r.begin);
+			numRanges.fetch_add(1);
+			busy_wait(10);
+		});
+
+		TaskSet::Handle handle = graph->QueueTaskSet(set);
+		graph->WaitForTaskSet(handle);
+
+		CHECK(numElements.load() == 4096);
+		CHECK(numRanges.load() == 4096 / 64);
+	}
+
 	/*
 	SUBCASE("Profile Task Set") {
 		Profiler::reset();
@@ -216,3 +341,203 @@ TEST_CASE("Task Graph")
 
 	delete graph;
 }
+
+class OrderedJob : public Job {
+public:
+	OrderedJob(std::vector<int> &order, int id) :
+		m_order(order),
+		m_id(id) {}
+
+	void OnRun() override { m_order.push_back(m_id); }
+	void OnFinish() override {}
+
+private:
+	std::vector<int> &m_order;
+	int m_id;
+};
+
+TEST_CASE("Job Priorities")
+{
+	SyncJobQueue queue;
+	std::vector<int> order;
+
+	Job *low = new OrderedJob(order, 0);
+	low->SetPriority(Job::PRIORITY_LOW);
+	Job *far = new OrderedJob(order, 1);
+	far->SetPriority(Job::PRIORITY_NORMAL, 100.0f);
+	Job *near = new OrderedJob(order, 2);
+	near->SetPriority(Job::PRIORITY_NORMAL, 1.0f);
+	Job *high = new OrderedJob(order, 3);
+	high->SetPriority(Job::PRIORITY_HIGH);
+
+	Job::Handle h0 = queue.Queue(low);
+	Job::Handle h1 = queue.Queue(far);
+	Job::Handle h2 = queue.Queue(near);
+	Job::Handle h3 = queue.Queue(high);
+
+	// the far-away job gets closer while still queued
+	h1.SetPriority(Job::PRIORITY_NORMAL, 0.5f);
+
+	queue.RunJobs(4);
+	queue.FinishJobs();
+
+	CHECK(order == std::vector<int>{ 3, 1, 2, 0 });
+}
+
+TEST_CASE("Budgeted FinishJobs")
+{
+	SyncJobQueue queue;
+	std::vector<int> order;
+
+	std::vector<Job::Handle> handles;
+	for (int idx = 0; idx < 5; idx++)
+		handles.push_back(queue.Queue(new OrderedJob(order, idx)));
+
+	queue.RunJobs(5);
+
+	// count-limited: leaves the rest for the next call
+	CHECK(queue.FinishJobs(1000.0, 2) == 2);
+	CHECK(!handles[1].HasJob());
+	CHECK(handles[2].HasJob());
+
+	// a zero time budget still makes forward progress
+	CHECK(queue.FinishJobs(0.0) == 1);
+	CHECK(queue.FinishJobs() == 2);
+	CHECK(!handles[4].HasJob());
+}
+
+class NamedJob : public OrderedJob {
+public:
+	using OrderedJob::OrderedJob;
+	const char *GetJobName() const override { return "TestNamedJob"; }
+};
+
+static const JobStats::Summary *FindJobStats(const std::vector<JobStats::Summary> &summaries, const std::string &name)
+{
+	for (const JobStats::Summary &summary : summaries)
+		if (summary.name == name)
+			return &summary;
+	return nullptr;
+}
+
+TEST_CASE("Job Stats")
+{
+	SyncJobQueue queue;
+	std::vector<int> order;
+	std::vector<JobStats::Summary> summaries;
+
+	std::vector<Job::Handle> handles;
+	for (int idx = 0; idx < 3; idx++)
+		handles.push_back(queue.Queue(new NamedJob(order, idx)));
+
+	JobStats::GetSummaries(summaries);
+	const JobStats::Summary *stats = FindJobStats(summaries, "TestNamedJob");
+	REQUIRE(stats);
+	CHECK(stats->queueDepth == 3);
+	CHECK(stats->numFinished == 0);
+
+	// cancelled jobs leave the queue without being counted as finished
+	handles[2] = Job::Handle();
+	queue.RunJobs(3);
+	queue.FinishJobs();
+
+	JobStats::GetSummaries(summaries);
+	stats = FindJobStats(summaries, "TestNamedJob");
+	REQUIRE(stats);
+	CHECK(stats->queueDepth == 0);
+	CHECK(stats->numFinished == 2);
+	CHECK(stats->totalMs[JobStats::P99] >= stats->runMs[JobStats::P99]);
+}
+
+TEST_CASE("Job Stats Slow Finishes")
+{
+	SyncJobQueue queue;
+	std::vector<int> order;
+	std::vector<JobStats::FinishCost> finishes;
+	JobStats::TakeSlowFinishes(finishes);
+
+	std::vector<Job::Handle> handles;
+	for (int idx = 0; idx < int(JobStats::MAX_SLOW_FINISHES) + 4; idx++)
+		handles.push_back(queue.Queue(new NamedJob(order, idx)));
+	queue.RunJobs(handles.size());
+	queue.FinishJobs();
+
+	// only the slowest are kept, slowest first, and then they are gone
+	const float totalMs = JobStats::TakeSlowFinishes(finishes);
+	REQUIRE(finishes.size() == JobStats::MAX_SLOW_FINISHES);
+	CHECK(strcmp(finishes[0].name, "TestNamedJob") == 0);
+	for (size_t i = 1; i < finishes.size(); i++)
+		CHECK(finishes[i - 1].ms >= finishes[i].ms);
+	CHECK(totalMs >= finishes[0].ms);
+
+	CHECK(JobStats::TakeSlowFinishes(finishes) == 0.0f);
+	CHECK(finishes.empty());
+}
+
+TEST_CASE("Job Stats Timeline")
+{
+	SyncJobQueue queue;
+	std::vector<int> order;
+	std::vector<JobStats::Span> spans;
+
+	const Uint64 since = JobStats::Now();
+	for (int idx = 0; idx < 3; idx++)
+		queue.Queue(new NamedJob(order, idx));
+	queue.RunJobs(3);
+	queue.FinishJobs();
+
+	// jobs that ended before the window are left out
+	JobStats::GetTimeline(spans, since);
+	REQUIRE(spans.size() >= 3);
+	const JobStats::Span &span = spans.back();
+	CHECK(strcmp(span.name, "TestNamedJob") == 0);
+	CHECK(span.threadNum == 0);
+	CHECK(span.startTime >= since);
+	CHECK(span.endTime >= span.startTime);
+	CHECK(span.finishTime >= span.endTime);
+	CHECK(span.finishEndTime >= span.finishTime);
+
+	JobStats::GetTimeline(spans, JobStats::Now() + 1);
+	CHECK(spans.empty());
+}
+
+// Measure the throughput of a large TaskSet of uneven tasks across increasing
+// worker thread counts, with and without work stealing.
+TEST_CASE("Task Graph Throughput")
+{
+	const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 2U);
+	const uint32_t numTasks = 2048;
+
+	for (bool stealing : { false, true }) {
+		for (uint32_t numThreads = 1; numThreads < maxThreads; numThreads *= 2) {
+			TaskGraph *graph = new TaskGraph();
+			graph->SetWorkerThreads(numThreads);
+			graph->SetWorkStealing(stealing);
+			s_numExec = 0;
+
+			Profiler::Clock clock{};
+			clock.Start();
+
+			TaskSet *set = new TaskSet();
+			set->AddTaskRangeLambda({ 0, numTasks }, 16, [](TaskRange r) {
+				for (uint32_t idx = r.begin; idx < r.end; idx++) {
+					// every eighth element is much more expensive to simulate
+					// long-running terrain or galaxy generation work
+					busy_wait(idx % 8 == 0 ? 200 : 20);
+					s_numExec.fetch_add(1);
+				}
+			});
+
+			TaskSet::Handle handle = graph->QueueTaskSet(set);
+			graph->WaitForTaskSet(handle);
+
+			clock.Stop();
+			printf("%s: %2u threads, %u tasks in %.2f ms (%.1f tasks/ms)\n",
+				stealing ? "work stealing" : "shared queue ", numThreads, numTasks,
+				clock.milliseconds(), numTasks / clock.milliseconds());
+
+			CHECK(s_numExec.load() == numTasks);
+			delete graph;
+		}
+	}
+}
@@ -0,0 +1,134 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "terrain/FracDef.h"
+#include "terrain/TerrainNoise.h"
+
+#include <random>
+#include <vector>
+#include "doctest.h"
+
+using namespace TerrainNoise;
+
+// Not a multiple of NOISE_BATCH, so the last batch is a partial one
+static constexpr size_t NUM_POINTS = 1000;
+
+// Points on the unit sphere and per-point parameters in the ranges the
+// terrain fractals use
+struct NoiseScene {
+	std::vector<vector3d> points;
+	std::vector<double> frequency, persistence, lacunarity;
+	std::vector<int> octaves;
+	fracdef_t def;
+
+	NoiseScene(uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<double> unit(-1.0, 1.0);
+		std::uniform_real_distribution<double> unit01(0.0, 1.0);
+		std::uniform_int_distribution<int> octave(1, 12);
+
+		for (size_t i = 0; i < NUM_POINTS; i++) {
+			points.push_back(vector3d(unit(rng), unit(rng), unit(rng)).Normalized());
+			frequency.push_back(1.0 + 5000.0 * unit01(rng));
+			persistence.push_back(0.3 + 0.4 * unit01(rng));
+			lacunarity.push_back(1.5 + 1.5 * unit01(rng));
+			octaves.push_back(octave(rng));
+		}
+
+		def.frequency = 600.0;
+		def.lacunarity = 2.0;
+		def.octaves = 8;
+	}
+};
+
+TEST_CASE("TerrainNoise batched")
+{
+	NoiseScene scene(97531);
+	const vector3d *p = scene.points.data();
+	std::vector<double> out(NUM_POINTS);
+
+	// the batched functions do the same arithmetic in the same order, so
+	// the results must be identical, not just close
+	SUBCASE("noise matches scalar")
+	{
+		noise(p, scene.frequency.data(), out.data(), NUM_POINTS);
+		for (size_t i = 0; i < NUM_POINTS; i++) {
+			INFO("point ", i);
+			CHECK(out[i] == noise(scene.frequency[i] * p[i]));
+		}
+	}
+
+	SUBCASE("noise matches scalar for any count")
+	{
+		// counts that leave a tail after the vector lanes, and points on
+		// the integer lattice where the floor matters
+		std::vector<vector3d> points(p, p + 16);
+		std::vector<double> frequency(scene.frequency.begin(), scene.frequency.begin() + 16);
+		points[0] = vector3d(-2.0, 0.0, 3.0);
+		points[1] = vector3d(1e5, -1e5, -0.5);
+		frequency[0] = frequency[1] = 1.0;
+		for (size_t count = 1; count <= 16; count++) {
+			noise(points.data(), frequency.data(), out.data(), count);
+			for (size_t i = 0; i < count; i++) {
+				INFO("count ", count, " point ", i);
+				CHECK(out[i] == noise(frequency[i] * points[i]));
+			}
+		}
+	}
+
+	SUBCASE("octave noise matches scalar")
+	{
+		octavenoise(scene.def, 0.5, p, out.data(), NUM_POINTS);
+		for (size_t i = 0; i < NUM_POINTS; i++)
+			CHECK(out[i] == octavenoise(scene.def, 0.5, p[i]));
+
+		octavenoise(scene.def, scene.persistence.data(), p, out.data(), NUM_POINTS);
+		for (size_t i = 0; i < NUM_POINTS; i++)
+			CHECK(out[i] == octavenoise(scene.def, scene.persistence[i], p[i]));
+
+		river_octavenoise(scene.def, 0.6, p, out.data(), NUM_POINTS);
+		for (size_t i = 0; i < NUM_POINTS; i++)
+			CHECK(out[i] == river_octavenoise(scene.def, 0.6, p[i]));
+
+		ridged_octavenoise(scene.def, 0.6, p, out.data(), NUM_POINTS);
+		for (size_t i = 0; i < NUM_POINTS; i++)
+			CHECK(out[i] == ridged_octavenoise(scene.def, 0.6, p[i]));
+
+		billow_octavenoise(scene.def, scene.persistence.data(), p, out.data(), NUM_POINTS);
+		for (size_t i = 0; i < NUM_POINTS; i++)
+			CHECK(out[i] == billow_octavenoise(scene.def, scene.persistence[i], p[i]));
+
+		voronoiscam_octavenoise(scene.def, scene.persistence.data(), p, out.data(), NUM_POINTS);
+		for (size_t i = 0; i < NUM_POINTS; i++)
+			CHECK(out[i] == voronoiscam_octavenoise(scene.def, scene.persistence[i], p[i]));
+
+		octavenoise(8, scene.persistence.data(), scene.lacunarity.data(), p, out.data(), NUM_POINTS);
+		for (size_t i = 0; i < NUM_POINTS; i++)
+			CHECK(out[i] == octavenoise(8, scene.persistence[i], scene.lacunarity[i], p[i]));
+
+		ridged_octavenoise(scene.octaves.data(), scene.persistence.data(), scene.lacunarity.data(), p, out.data(), NUM_POINTS);
+		for (size_t i = 0; i < NUM_POINTS; i++)
+			CHECK(out[i] == ridged_octavenoise(scene.octaves[i], scene.persistence[i], scene.lacunarity[i], p[i]));
+	}
+}
+
+TEST_CASE("TerrainNoise specialised octaves")
+{
+	NoiseScene scene(24680);
+
+	// the unrolled sums must give exactly what the runtime loop gives,
+	// including for octave counts without their own instantiation
+	SUBCASE("matches runtime loop")
+	{
+		for (int octaves = 0; octaves <= detail::MAX_SPECIALISED_OCTAVES + 4; octaves++) {
+			fracdef_t def = scene.def;
+			def.octaves = octaves;
+			INFO("octaves ", octaves);
+			for (size_t i = 0; i < 100; i++) {
+				CHECK(detail::octave_sum<false>(def, scene.persistence[i], scene.points[i]) == detail::octave_sum_any<false>(def, scene.persistence[i], scene.points[i]));
+				CHECK(detail::octave_sum<true>(def, scene.persistence[i], scene.points[i]) == detail::octave_sum_any<true>(def, scene.persistence[i], scene.points[i]));
+			}
+		}
+	}
+}
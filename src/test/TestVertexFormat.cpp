@@ -0,0 +1,87 @@
+// Copyright © 2008-2024 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "graphics/VertexBuffer.h"
+
+#include "doctest.h"
+
+#include <cmath>
+#include <limits>
+
+using Graphics::VertexBufferDesc;
+
+TEST_CASE("Half floats")
+{
+	SUBCASE("Exact values round trip")
+	{
+		for (float f : { 0.f, 1.f, -2.f, 0.5f, 0.25f, 1024.f, 65504.f, -65504.f, 6.1035156e-05f, 5.9604645e-08f })
+			CHECK(VertexBufferDesc::HalfToFloat(VertexBufferDesc::FloatToHalf(f)) == f);
+
+		CHECK(VertexBufferDesc::FloatToHalf(1.f) == 0x3c00);
+		CHECK(VertexBufferDesc::FloatToHalf(-0.f) == 0x8000);
+	}
+
+	SUBCASE("Rounding")
+	{
+		// halfway between 1 and the next half rounds to even (1), just above
+		// it rounds up
+		CHECK(VertexBufferDesc::FloatToHalf(1.f + 1.f / 2048.f) == 0x3c00);
+		CHECK(VertexBufferDesc::FloatToHalf(1.f + 1.1f / 2048.f) == 0x3c01);
+		CHECK(VertexBufferDesc::FloatToHalf(1.f + 3.f / 2048.f) == 0x3c02);
+
+		// every half value in [0, 1] is within half a step of its float
+		for (float f = 0.f; f <= 1.f; f += 1.f / 4099.f)
+			CHECK(std::abs(VertexBufferDesc::HalfToFloat(VertexBufferDesc::FloatToHalf(f)) - f) <= std::ldexp(1.f, -12));
+	}
+
+	SUBCASE("Out of range")
+	{
+		CHECK(VertexBufferDesc::FloatToHalf(65520.f) == 0x7c00);
+		CHECK(VertexBufferDesc::FloatToHalf(-1e10f) == 0xfc00);
+		CHECK(std::isinf(VertexBufferDesc::HalfToFloat(0x7c00)));
+		CHECK(std::isnan(VertexBufferDesc::HalfToFloat(VertexBufferDesc::FloatToHalf(std::numeric_limits<float>::quiet_NaN()))));
+		CHECK(VertexBufferDesc::FloatToHalf(1e-9f) == 0);
+	}
+}
+
+TEST_CASE("Vertex attribute encoding")
+{
+	Uint8 data[16];
+	float out[4];
+
+	SUBCASE("Normalized bytes")
+	{
+		const float normal[4] = { 0.6f, -0.8f, 0.f, 0.f };
+		VertexBufferDesc::EncodeAttrib(Graphics::ATTRIB_FORMAT_BYTE4_NORM, normal, data);
+		VertexBufferDesc::DecodeAttrib(Graphics::ATTRIB_FORMAT_BYTE4_NORM, data, out);
+		for (int i = 0; i < 4; i++)
+			CHECK(std::abs(out[i] - normal[i]) <= 0.5f / 127.f);
+
+		const float outOfRange[4] = { 2.f, -2.f, 1.f, -1.f };
+		VertexBufferDesc::EncodeAttrib(Graphics::ATTRIB_FORMAT_BYTE4_NORM, outOfRange, data);
+		VertexBufferDesc::DecodeAttrib(Graphics::ATTRIB_FORMAT_BYTE4_NORM, data, out);
+		CHECK(out[0] == 1.f);
+		CHECK(out[1] == -1.f);
+		CHECK(out[2] == 1.f);
+		CHECK(out[3] == -1.f);
+	}
+
+	SUBCASE("Missing components decode as zero")
+	{
+		const float uv[4] = { 0.25f, 0.75f, 5.f, 5.f };
+		VertexBufferDesc::EncodeAttrib(Graphics::ATTRIB_FORMAT_HALF2, uv, data);
+		VertexBufferDesc::DecodeAttrib(Graphics::ATTRIB_FORMAT_HALF2, data, out);
+		CHECK(out[0] == 0.25f);
+		CHECK(out[1] == 0.75f);
+		CHECK(out[2] == 0.f);
+		CHECK(out[3] == 0.f);
+
+		const float pos[4] = { 1.5f, -3.f, 1e6f, 7.f };
+		VertexBufferDesc::EncodeAttrib(Graphics::ATTRIB_FORMAT_FLOAT3, pos, data);
+		VertexBufferDesc::DecodeAttrib(Graphics::ATTRIB_FORMAT_FLOAT3, data, out);
+		CHECK(out[0] == 1.5f);
+		CHECK(out[1] == -3.f);
+		CHECK(out[2] == 1e6f);
+		CHECK(out[3] == 0.f);
+	}
+}
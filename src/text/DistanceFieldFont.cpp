@@ -9,10 +9,15 @@
 #include <iostream>
 #include <sstream>
 
+// beyond this many runs in the cache the unused ones are dropped
+static const size_t MAX_CACHED_RUNS = 256;
+
 namespace Text {
 
 	DistanceFieldFont::DistanceFieldFont(const std::string &definition, Graphics::Texture *tex) :
 		m_texture(tex),
+		m_flatGlyphs(FLAT_GLYPHS),
+		m_hasFlatGlyph(FLAT_GLYPHS, false),
 		m_sheetSize(0.f),
 		m_fontSize(0.f)
 	{
@@ -54,12 +59,10 @@ namespace Text {
 				cursor.y--;
 				cursor.x = 0;
 			} else {
-				Uint32 chr = Uint32(text.at(i));
-				std::map<Uint32, Glyph>::const_iterator it = m_glyphs.find(chr);
-				if (it != m_glyphs.end()) {
-					const Glyph &glyph = it->second;
-					AddGlyph(va, cursor + glyph.offset, glyph, bounds);
-					cursor.x += glyph.xAdvance;
+				const Glyph *glyph = FindGlyph(Uint32(text.at(i)));
+				if (glyph) {
+					AddGlyph(va, cursor + glyph->offset, *glyph, bounds);
+					cursor.x += glyph->xAdvance;
 				}
 			}
 		}
@@ -72,6 +75,38 @@ namespace Text {
 		}
 	}
 
+	std::shared_ptr<DistanceFieldFont::GlyphRun> DistanceFieldFont::GetRun(const std::string &text, const vector2f &offset)
+	{
+		auto key = std::make_tuple(text, offset.x, offset.y);
+		auto it = m_runs.find(key);
+		if (it != m_runs.end())
+			return it->second;
+
+		if (m_runs.size() >= MAX_CACHED_RUNS) {
+			for (auto run = m_runs.begin(); run != m_runs.end();) {
+				if (run->second.use_count() == 1)
+					run = m_runs.erase(run);
+				else
+					++run;
+			}
+		}
+
+		std::shared_ptr<GlyphRun> run = std::make_shared<GlyphRun>(CreateVertexArray());
+		if (!text.empty())
+			GetGeometry(*run->geometry, text, offset);
+		m_runs.emplace(std::move(key), run);
+		return run;
+	}
+
+	const DistanceFieldFont::Glyph *DistanceFieldFont::FindGlyph(Uint32 chr) const
+	{
+		if (chr < FLAT_GLYPHS)
+			return m_hasFlatGlyph[chr] ? &m_flatGlyphs[chr] : nullptr;
+
+		std::map<Uint32, Glyph>::const_iterator it = m_glyphs.find(chr);
+		return it != m_glyphs.end() ? &it->second : nullptr;
+	}
+
 	// create a preferred format vertex array
 	Graphics::VertexArray *DistanceFieldFont::CreateVertexArray() const
 	{
@@ -170,7 +205,11 @@ namespace Text {
 		g.size = vector2f(float(uSize), float(vSize)) * scale;
 		g.offset = vector2f(float(xoffset), float(m_lineHeight - vSize - yoffset)) * scale;
 		g.xAdvance = advance * scale;
-		m_glyphs[id] = g;
+		if (id < FLAT_GLYPHS) {
+			m_flatGlyphs[id] = g;
+			m_hasFlatGlyph[id] = true;
+		} else
+			m_glyphs[id] = g;
 	}
 
 	void DistanceFieldFont::ParseCommon(std::string_view line)
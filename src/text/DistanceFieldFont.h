@@ -24,22 +24,38 @@
  */
 
 #include "RefCounted.h"
+#include "graphics/VertexArray.h"
 #include "vector2.h"
 
-#include <string>
 #include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
 
 namespace Graphics {
+	class MeshObject;
 	class Texture;
-	class VertexArray;
 } // namespace Graphics
 
 namespace Text {
 
 	class DistanceFieldFont : public RefCounted {
 	public:
+		// A laid out string, shared by everything showing the same text
+		struct GlyphRun {
+			GlyphRun(Graphics::VertexArray *va) :
+				geometry(va) {}
+			std::unique_ptr<Graphics::VertexArray> geometry;
+			// for the user to upload the geometry to, once
+			std::shared_ptr<Graphics::MeshObject> mesh;
+		};
+
 		DistanceFieldFont(const std::string &definitionFileName, Graphics::Texture *);
 		void GetGeometry(Graphics::VertexArray &, const std::string &, const vector2f &offset);
+		// The laid out text from the cache, or laid out now if it isn't in
+		// there. Runs nothing else holds on to are dropped now and then.
+		std::shared_ptr<GlyphRun> GetRun(const std::string &, const vector2f &offset);
 		Graphics::Texture *GetTexture() const { return m_texture; }
 		Graphics::VertexArray *CreateVertexArray() const;
 
@@ -51,8 +67,17 @@ namespace Text {
 			vector2f offset; //offset applied to the cursor position
 			float xAdvance; //how much the cursor should be moved after a character
 		};
+		// glyphs below this code point are looked up in a flat table
+		static constexpr Uint32 FLAT_GLYPHS = 256;
+
+		const Glyph *FindGlyph(Uint32 chr) const;
+
 		Graphics::Texture *m_texture;
 		std::map<Uint32, Glyph> m_glyphs;
+		std::vector<Glyph> m_flatGlyphs;
+		std::vector<bool> m_hasFlatGlyph;
+		// by text and offset; vector2f doesn't order by component
+		std::map<std::tuple<std::string, float, float>, std::shared_ptr<GlyphRun>> m_runs;
 		vector2f m_sheetSize;
 		float m_lineHeight;
 		float m_fontSize; //32 etc. Glyph size/advance will be scaled to 1/fontSize.
@@ -226,6 +226,42 @@ namespace FileSystem {
 		}
 	}
 
+	class FileDataMapped : public FileData {
+	public:
+		FileDataMapped(const FileInfo &info, size_t size, void *data) :
+			FileData(info, size, static_cast<char *>(data)) {}
+		virtual ~FileDataMapped() { UnmapViewOfFile(m_data); }
+	};
+
+	RefCountedPtr<FileData> FileSourceFS::MapFile(const std::string &path)
+	{
+		const std::string fullpath = JoinPathBelow(GetRoot(), path);
+		const std::wstring wfullpath = transcode_utf8_to_utf16(fullpath);
+		HANDLE filehandle = CreateFileW(wfullpath.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (filehandle == INVALID_HANDLE_VALUE)
+			return RefCountedPtr<FileData>(0);
+
+		const Time::DateTime modtime = file_modtime_for_handle(filehandle);
+		LARGE_INTEGER large_size;
+		if (!GetFileSizeEx(filehandle, &large_size) || large_size.QuadPart == 0) {
+			CloseHandle(filehandle);
+			return ReadFile(path);
+		}
+
+		// the view keeps the mapping and the file open
+		void *data = nullptr;
+		HANDLE mapping = CreateFileMappingW(filehandle, 0, PAGE_READONLY, 0, 0, 0);
+		if (mapping) {
+			data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+		CloseHandle(filehandle);
+		if (!data)
+			return ReadFile(path);
+
+		return RefCountedPtr<FileData>(new FileDataMapped(MakeFileInfo(path, FileInfo::FT_FILE, modtime), size_t(large_size.QuadPart), data));
+	}
+
 	bool FileSourceFS::ReadDirectory(const std::string &dirpath, std::vector<FileInfo> &output)
 	{
 		size_t output_head_size = output.size();
@@ -357,4 +393,23 @@ namespace FileSystem {
 			return false;
 		return DeleteFileW(combinedPath.c_str());
 	}
+
+	bool FileSourceFS::RenameFile(const std::string &relativeFrom, const std::string &relativeTo)
+	{
+		if (relativeFrom.empty() || relativeTo.empty())
+			return false;
+		std::wstring fromPath, toPath;
+		try {
+			fromPath = transcode_utf8_to_utf16(JoinPathBelow(GetRoot(), relativeFrom));
+			toPath = transcode_utf8_to_utf16(JoinPathBelow(GetRoot(), relativeTo));
+		} catch (const std::invalid_argument &) {
+			return false;
+		}
+		const DWORD fileAttributes = GetFileAttributesW(fromPath.c_str());
+		if (file_type_for_attributes(fileAttributes) != FileSystem::FileInfo::FileType::FT_FILE)
+			return false;
+		if (!IsChildOfRoot(transcode_utf16_to_utf8(fromPath)))
+			return false;
+		return MoveFileExW(fromPath.c_str(), toPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+	}
 } // namespace FileSystem
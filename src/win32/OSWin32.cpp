@@ -302,4 +302,37 @@ namespace OS {
 		SetProcessDPIAware();
 	}
 
+	// kernel and user time, in 100ns units
+	static double cpu_time_ms(const FILETIME &kernel, const FILETIME &user)
+	{
+		const uint64_t k = (uint64_t(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+		const uint64_t u = (uint64_t(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+		return (k + u) * 1e-4;
+	}
+
+	double GetProcessCPUTime()
+	{
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+			return 0.0;
+		return cpu_time_ms(kernel, user);
+	}
+
+	double GetThreadCPUTime()
+	{
+		FILETIME creation, exit, kernel, user;
+		if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+			return 0.0;
+		return cpu_time_ms(kernel, user);
+	}
+
+	uint64_t GetProcessBytesRead()
+	{
+		// this counts the reads served from the file cache too
+		IO_COUNTERS counters;
+		if (!GetProcessIoCounters(GetCurrentProcess(), &counters))
+			return 0;
+		return counters.ReadTransferCount;
+	}
+
 } // namespace OS